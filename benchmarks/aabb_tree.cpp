@@ -0,0 +1,174 @@
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmarks/common.h"
+#include "strings/format.h"
+#include "utils/aabb_tree.h"
+#include "utils/random.h"
+
+// Benchmarks for `AabbTree`.
+// Every workload is generated from a fixed seed, so the numbers are comparable between runs.
+
+namespace
+{
+    using Tree = AabbTree<fvec2, int>;
+
+    enum class Layout {uniform, clustered};
+
+    struct Workload
+    {
+        std::string_view name;
+        Layout layout = Layout::uniform;
+        // Which fraction of the objects moves each step.
+        float moving_fraction = 0;
+    };
+
+    constexpr Workload workloads[] = {
+        {.name = "uniform", .layout = Layout::uniform},
+        {.name = "clustered", .layout = Layout::clustered},
+        {.name = "moving", .layout = Layout::uniform, .moving_fraction = 1},
+        {.name = "mostly_static", .layout = Layout::uniform, .moving_fraction = 0.05f},
+    };
+
+    constexpr int sizes[] = {1'000, 10'000, 100'000, 1'000'000};
+
+    // The margins to try for moving workloads, relative to the average object size. Static workloads use zero.
+    constexpr float margins[] = {0.1f, 0.5f, 2};
+
+    constexpr float object_size = 4;
+    constexpr int num_move_steps = 10;
+    constexpr int max_queries = 10'000;
+
+    struct Object
+    {
+        frect2 rect;
+        fvec2 vel;
+    };
+
+    // Generates the objects. The world area is proportional to the object count, so the density is the same for all sizes.
+    [[nodiscard]] std::vector<Object> MakeObjects(Random::DefaultGenerator &gen, Layout layout, int count, float world_size)
+    {
+        Random::DefaultInterfaces ra(gen);
+
+        std::vector<fvec2> cluster_centers;
+        if (layout == Layout::clustered)
+        {
+            for (int i = 0; i < 16; i++)
+                cluster_centers.push_back(ra.fvec2 <= world_size);
+        }
+
+        std::vector<Object> ret;
+        ret.reserve(count);
+        for (int i = 0; i < count; i++)
+        {
+            fvec2 pos;
+            if (layout == Layout::clustered)
+                pos = ra.choose(cluster_centers) + (ra.fvec2.abs() <= world_size / 16);
+            else
+                pos = ra.fvec2 <= world_size;
+
+            fvec2 size = object_size / 2 <= ra.fvec2 <= object_size * 3 / 2;
+            ret.push_back({.rect = pos.rect_size(size), .vel = ra.fvec2.abs() <= object_size / 4});
+        }
+        return ret;
+    }
+
+    void RunWorkload(const Workload &workload, int count, float margin)
+    {
+        std::string name = FMT("aabb_tree/{}/n={}/margin={}", workload.name, count, margin);
+
+        Random::DefaultGenerator gen(1234);
+        Random::DefaultInterfaces ra(gen);
+
+        float world_size = std::sqrt(float(count)) * object_size * 4;
+        std::vector<Object> objects = MakeObjects(gen, workload.layout, count, world_size);
+
+        Tree::Params params(fvec2(margin * object_size));
+
+        // Incremental insertion.
+        Tree tree(params);
+        std::vector<Tree::NodeIndex> indices(count);
+        Bench::Report(name, "ns/insert", Bench::MeasureNs([&]
+        {
+            for (int i = 0; i < count; i++)
+                indices[i] = tree.AddNode(objects[i].rect, i);
+        }) / count);
+        Bench::Report(name, "sah/insert", tree.SahCost());
+
+        // Bulk build.
+        {
+            std::vector<frect2> rects;
+            rects.reserve(count);
+            for (const Object &object : objects)
+                rects.push_back(object.rect);
+
+            Tree built_tree;
+            Bench::Report(name, "ns/build", Bench::Measure([&]
+            {
+                built_tree = Tree(params, rects);
+            }), count);
+            Bench::Report(name, "sah/build", built_tree.SahCost());
+        }
+
+        // Moving.
+        if (workload.moving_fraction > 0)
+        {
+            int num_moving = int(count * workload.moving_fraction);
+            std::size_t num_moves = 0;
+            double move_ns = 0;
+            for (int step = 0; step < num_move_steps; step++)
+            {
+                for (int i = 0; i < num_moving; i++)
+                    objects[i].rect += objects[i].vel;
+
+                move_ns += Bench::MeasureNs([&]
+                {
+                    for (int i = 0; i < num_moving; i++)
+                        tree.ModifyNode(indices[i], objects[i].rect, objects[i].vel);
+                });
+                num_moves += num_moving;
+            }
+            Bench::Report(name, "ns/move", move_ns / num_moves);
+            Bench::Report(name, "sah/moved", tree.SahCost());
+        }
+
+        // Queries.
+        {
+            int num_queries = min(count, max_queries);
+            std::vector<frect2> queries;
+            queries.reserve(num_queries);
+            for (int i = 0; i < num_queries; i++)
+                queries.push_back((ra.fvec2 <= world_size).rect_size(fvec2(object_size * 4)));
+
+            std::size_t num_hits = 0;
+            Bench::Report(name, "ns/query", Bench::Measure([&]
+            {
+                num_hits = 0;
+                for (const frect2 &query : queries)
+                    tree.CollideAabb(query, [&](Tree::NodeIndex){num_hits++; return false;});
+            }), num_queries);
+            Bench::DoNotOptimize(num_hits);
+            Bench::Report(name, "hits/query", double(num_hits) / num_queries);
+        }
+    }
+}
+
+BENCHMARK("aabb_tree")
+{
+    for (const Workload &workload : workloads)
+    for (int count : sizes)
+    {
+        if (workload.moving_fraction > 0)
+        {
+            for (float margin : margins)
+                RunWorkload(workload, count, margin);
+        }
+        else
+        {
+            RunWorkload(workload, count, 0);
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "audio/sound.h"
+#include "benchmarks/common.h"
+#include "stream/readonly_data.h"
+#include "strings/format.h"
+#include "utils/filesystem.h"
+
+// Benchmarks the sound decoding through `Audio::Sound`, and the conversions.
+// Set `IMP_BENCH_AUDIO_DIR` to a directory with `.wav` and `.ogg` files. Otherwise uses a few generated wav files.
+
+namespace
+{
+    constexpr int num_repeats = 5;
+
+    struct SoundFile
+    {
+        std::string name;
+        Audio::Format format{};
+        Stream::ReadOnlyData data;
+    };
+
+    // Generates a 16-bit wav file with a sine-like wave.
+    [[nodiscard]] SoundFile MakeWav(std::string name, Audio::Channels channels, int sampling_rate, int seconds)
+    {
+        std::size_t block_count = std::size_t(sampling_rate) * std::size_t(seconds);
+        std::uint32_t data_size = std::uint32_t(block_count * std::size_t(channels) * 2);
+
+        std::vector<std::uint8_t> bytes;
+        auto Append = [&](std::uint64_t value, int size)
+        {
+            for (int i = 0; i < size; i++)
+                bytes.push_back(std::uint8_t(value >> (i * 8)));
+        };
+        auto AppendString = [&](std::string_view str)
+        {
+            bytes.insert(bytes.end(), str.begin(), str.end());
+        };
+
+        AppendString("RIFF");
+        Append(4 + 8 + 16 + 8 + data_size, 4);
+        AppendString("WAVEfmt ");
+        Append(16, 4);
+        Append(1, 2); // PCM.
+        Append(std::uint64_t(channels), 2);
+        Append(std::uint64_t(sampling_rate), 4);
+        Append(std::uint64_t(sampling_rate) * std::uint64_t(channels) * 2, 4);
+        Append(std::uint64_t(channels) * 2, 2);
+        Append(16, 2);
+        AppendString("data");
+        Append(data_size, 4);
+        for (std::size_t i = 0; i < block_count * std::size_t(channels); i++)
+            Append(std::uint16_t(std::int16_t((i * 37 % 2000) * 16 - 16000)), 2);
+
+        return {.name = std::move(name), .format = Audio::wav, .data = Stream::ReadOnlyData::mem_copy(bytes)};
+    }
+
+    [[nodiscard]] std::vector<SoundFile> LoadSounds()
+    {
+        std::vector<SoundFile> ret;
+
+        if (const char *dir = std::getenv("IMP_BENCH_AUDIO_DIR"))
+        {
+            for (const std::string &file_name : Filesystem::GetDirectoryContents(dir))
+            {
+                bool is_wav = file_name.ends_with(".wav");
+                if (!is_wav && !file_name.ends_with(".ogg"))
+                    continue;
+                ret.push_back({.name = file_name, .format = is_wav ? Audio::wav : Audio::ogg, .data = Stream::ReadOnlyData(std::string(dir) + "/" + file_name)});
+            }
+        }
+
+        if (ret.empty())
+        {
+            ret.push_back(MakeWav("generated_mono.wav", Audio::mono, 44100, 10));
+            ret.push_back(MakeWav("generated_stereo.wav", Audio::stereo, 48000, 10));
+        }
+
+        return ret;
+    }
+
+    // Measures `func`, and reports the time, and the throughput in the decoded bytes.
+    void Measure(std::string_view name, std::size_t bytes, auto &&func)
+    {
+        Bench::Samples samples = Bench::Measure(func, {.min_samples = num_repeats});
+
+        Bench::Report(name, "ms", samples, 1e6);
+        Bench::Report(name, "MB/s", bytes / (samples.median / 1e9) / 1e6);
+    }
+}
+
+BENCHMARK("audio")
+{
+    for (const SoundFile &file : LoadSounds())
+    {
+        Audio::Sound sound(file.format, {}, file.data);
+        Bench::Report(FMT("audio/{}", file.name), "MB", file.data.size() / 1e6);
+
+        Measure(FMT("audio/{}/decode", file.name), sound.ByteSize(), [&]
+        {
+            Audio::Sound decoded(file.format, {}, file.data);
+            Bench::DoNotOptimize(decoded);
+        });
+        Measure(FMT("audio/{}/to_8_bits", file.name), sound.ByteSize(), [&]
+        {
+            Audio::Sound converted = sound.WithResolution(Audio::bits_8);
+            Bench::DoNotOptimize(converted);
+        });
+        Measure(FMT("audio/{}/to_{}", file.name, sound.ChannelCount() == Audio::mono ? "stereo" : "mono"), sound.ByteSize(), [&]
+        {
+            Audio::Sound converted = sound.WithChannelCount(sound.ChannelCount() == Audio::mono ? Audio::stereo : Audio::mono);
+            Bench::DoNotOptimize(converted);
+        });
+        Measure(FMT("audio/{}/resample", file.name), sound.ByteSize(), [&]
+        {
+            Audio::Sound converted = sound.Resampled(sound.SamplingRate() == 44100 ? 48000 : 44100);
+            Bench::DoNotOptimize(converted);
+        });
+    }
+}
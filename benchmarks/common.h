@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils/clock.h"
+
+// A tiny benchmark harness.
+// Each `benchmarks/*.cpp` file registers its benchmarks with `BENCHMARK("name") {...}`.
+// Run with `make benchmarks MODE=release`. Pass benchmark name prefixes in `ARGS` to only run some of them.
+// Also `ARGS` can contain:
+//   `--json=FILE` to save the results, e.g. as a baseline before a change.
+//   `--compare=FILE` to print the change relative to a saved baseline, for every result.
+// Use `Measure()` to time things: it runs a warmup first, then enough samples to be stable, and returns the median and the spread.
+
+namespace Bench
+{
+    struct Benchmark
+    {
+        std::string name;
+        std::function<void()> func;
+    };
+
+    [[nodiscard]] inline std::vector<Benchmark> &GetBenchmarks()
+    {
+        static std::vector<Benchmark> ret;
+        return ret;
+    }
+
+    struct Registration
+    {
+        Registration(std::string name, std::function<void()> func)
+        {
+            GetBenchmarks().push_back({std::move(name), std::move(func)});
+        }
+    };
+
+    // The statistics of the samples collected by `Measure()`, in nanoseconds.
+    struct Samples
+    {
+        int count = 0;
+        double min = 0;
+        double median = 0;
+        double mean = 0;
+        double stddev = 0;
+
+        // The standard deviation relative to the mean.
+        [[nodiscard]] double RelativeSpread() const
+        {
+            return mean > 0 ? stddev / mean : 0;
+        }
+    };
+
+    struct MeasureParams
+    {
+        int warmup = 1; // The number of the runs that are not measured.
+        int min_samples = 5;
+        int max_samples = 1000;
+        double min_seconds = 0.2; // Collect samples at least for this long, unless `max_samples` is reached.
+    };
+
+    // Prints a single measurement, and remembers it for `--json` and `--compare`.
+    // If `relative_spread >= 0`, prints it too.
+    void Report(std::string_view name, std::string_view metric, double value, double relative_spread = -1);
+
+    // Prints the median of the samples divided by `divisor` (e.g. the number of operations per sample), and the spread.
+    inline void Report(std::string_view name, std::string_view metric, const Samples &samples, double divisor = 1)
+    {
+        Report(name, metric, samples.median / divisor, samples.RelativeSpread());
+    }
+
+    // Prevents the compiler from optimizing away the computation of `value`.
+    template <typename T>
+    void DoNotOptimize(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // Measures the time it takes to run `func()`, in nanoseconds.
+    template <typename F>
+    [[nodiscard]] double MeasureNs(F &&func)
+    {
+        std::uint64_t start = Clock::Time();
+        func();
+        return Clock::TicksToSeconds(Clock::Time() - start) * 1e9;
+    }
+
+    // Computes the statistics of the samples, in nanoseconds. Reorders them.
+    [[nodiscard]] Samples ComputeSamples(std::vector<double> &samples_ns);
+
+    // Runs `func()` a few times without measuring, then measures it repeatedly, see `MeasureParams`.
+    template <typename F>
+    [[nodiscard]] Samples Measure(F &&func, const MeasureParams &params = {})
+    {
+        for (int i = 0; i < params.warmup; i++)
+            func();
+
+        std::vector<double> samples;
+        double total_ns = 0;
+        while (samples.size() < std::size_t(params.max_samples) && (samples.size() < std::size_t(params.min_samples) || total_ns < params.min_seconds * 1e9))
+        {
+            double ns = MeasureNs(func);
+            samples.push_back(ns);
+            total_ns += ns;
+        }
+        return ComputeSamples(samples);
+    }
+}
+
+#define BENCHMARK(name) BENCHMARK_impl(name, __LINE__)
+#define BENCHMARK_impl(name, line) BENCHMARK_impl_low(name, line)
+#define BENCHMARK_impl_low(name, line) \
+    static void _bench_func_##line(); \
+    [[maybe_unused]] static const ::Bench::Registration _bench_registration_##line(name, _bench_func_##line); \
+    static void _bench_func_##line()
@@ -0,0 +1,81 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "benchmarks/common.h"
+#include "entities/complete.h"
+#include "strings/format.h"
+
+// Benchmarks for the entity controller: creating, destroying, and iterating over the entities.
+
+namespace
+{
+    struct Game : Ent::BasicTag<Game, Ent::Mixins::GlobalEntityLists> {};
+
+    struct Particle
+    {
+        IMP_STANDALONE_COMPONENT(Game)
+
+        int value = 0;
+
+        Particle() {}
+        Particle(int value) : value(value) {}
+        virtual ~Particle() = default;
+    };
+
+    constexpr int sizes[] = {1'000, 100'000};
+
+    void RunEntities(int count)
+    {
+        std::string name = FMT("entities/n={}", count);
+
+        Game::Controller game = nullptr;
+        game.reserve<Particle>(std::size_t(count));
+
+        std::vector<Particle *> particles;
+        particles.reserve(std::size_t(count));
+
+        auto DestroyAll = [&]
+        {
+            for (Particle *particle : particles)
+                game.destroy(*particle);
+            particles.clear();
+        };
+
+        Bench::Report(name, "ns/create+destroy", Bench::Measure([&]
+        {
+            for (int i = 0; i < count; i++)
+                particles.push_back(&game.create<Particle>(i));
+            DestroyAll();
+        }), count);
+
+        Bench::Report(name, "ns/create_many+destroy", Bench::Measure([&]
+        {
+            game.create_many<Particle>(std::size_t(count), [&](Game::FullEntity<Particle> &particle, std::size_t i)
+            {
+                particle.value = int(i);
+                particles.push_back(&particle);
+            });
+            DestroyAll();
+        }), count);
+
+        for (int i = 0; i < count; i++)
+            particles.push_back(&game.create<Particle>(i));
+
+        Bench::Report(name, "ns/iterate", Bench::Measure([&]
+        {
+            long long sum = 0;
+            for (auto &e : game.get<Game::AllEntitiesOrdered>())
+                sum += e.get<Particle>().value;
+            Bench::DoNotOptimize(sum);
+        }), count);
+
+        DestroyAll();
+    }
+}
+
+BENCHMARK("entities")
+{
+    for (int size : sizes)
+        RunEntities(size);
+}
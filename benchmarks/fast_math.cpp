@@ -0,0 +1,68 @@
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "benchmarks/common.h"
+#include "math/fast_math.h"
+#include "strings/format.h"
+#include "utils/random.h"
+
+// Compares the fast approximations from `math/fast_math.h` with the `std` functions, on big arrays.
+
+namespace
+{
+    constexpr std::size_t num_elems = 1 << 16;
+    constexpr int num_repeats = 20;
+
+    // Measures `func`, and reports the time per element.
+    void Measure(std::string_view name, auto &&func)
+    {
+        Bench::Report(name, "ns/elem", Bench::Measure(func, {.min_samples = num_repeats}), num_elems);
+    }
+
+    void MeasureBoth(std::string_view name, const std::vector<float> &in, std::vector<float> &out, auto std_func, auto fast_func)
+    {
+        Measure(FMT("fast_math/{}/std", name), [&]
+        {
+            for (std::size_t i = 0; i < num_elems; i++)
+                out[i] = std_func(in[i]);
+            Bench::DoNotOptimize(out.data());
+        });
+        Measure(FMT("fast_math/{}/fast", name), [&]
+        {
+            fast_func(in, out);
+            Bench::DoNotOptimize(out.data());
+        });
+    }
+}
+
+BENCHMARK("fast_math")
+{
+    Random::DefaultGenerator gen(42);
+    Random::DefaultInterfaces ra(gen);
+    std::vector<float> angles(num_elems), positive(num_elems), exponents(num_elems), out(num_elems);
+    for (std::size_t i = 0; i < num_elems; i++)
+    {
+        angles[i] = ra.f.abs() <= 100;
+        positive[i] = 0.001f <= ra.f <= 1000;
+        exponents[i] = ra.f.abs() <= 20;
+    }
+
+    MeasureBoth("sin", angles, out, [](float x){return std::sin(x);}, [](std::span<const float> in, std::span<float> out){Math2::FastSin(in, out);});
+    MeasureBoth("rsqrt", positive, out, [](float x){return 1 / std::sqrt(x);}, [](std::span<const float> in, std::span<float> out){Math2::FastRsqrt(in, out);});
+    MeasureBoth("exp", exponents, out, [](float x){return std::exp(x);}, [](std::span<const float> in, std::span<float> out){Math2::FastExp(in, out);});
+
+    Measure("fast_math/atan2/std", [&]
+    {
+        for (std::size_t i = 0; i < num_elems; i++)
+            out[i] = std::atan2(angles[i], positive[i]);
+        Bench::DoNotOptimize(out.data());
+    });
+    Measure("fast_math/atan2/fast", [&]
+    {
+        Math2::FastAtan2(angles, positive, out);
+        Bench::DoNotOptimize(out.data());
+    });
+}
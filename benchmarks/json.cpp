@@ -0,0 +1,150 @@
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmarks/common.h"
+#include "gameutils/tiled_map.h"
+#include "stream/readonly_data.h"
+#include "strings/format.h"
+#include "utils/filesystem.h"
+#include "utils/json.h"
+
+// Benchmarks for the JSON parsers: `Json` (the tree), `FlatJson`, and `Json::ParseSax()`, plus the tile layer loaders built on them.
+// Set `IMP_BENCH_TILED_DIR` to a directory with Tiled maps exported as `.json`. Otherwise uses a few generated maps.
+
+namespace
+{
+    constexpr int json_depth = 32;
+    constexpr int num_repeats = 5;
+
+    struct MapText
+    {
+        std::string name;
+        std::string text;
+        std::string tile_layer; // The first tile layer, or empty if none.
+    };
+
+    // Generates a map resembling a Tiled export. `pretty` adds the indentation, like the Tiled's default export does.
+    [[nodiscard]] MapText MakeMap(std::string name, ivec2 size, int num_layers, int num_points, bool pretty)
+    {
+        std::string indent = pretty ? "\n        " : "";
+        std::string separator = pretty ? ", " : ",";
+
+        std::string text = "{\"height\":" + std::to_string(size.y) + "," + indent + "\"layers\":[";
+        for (int l = 0; l < num_layers; l++)
+        {
+            if (l > 0)
+                text += "," + indent;
+            text += "{" + indent + "\"data\":[";
+            for (int i = 0; i < size.prod(); i++)
+            {
+                if (i > 0)
+                    text += separator;
+                text += std::to_string((i * 31 + l) % 97);
+            }
+            text += "]," + indent + "\"height\":" + std::to_string(size.y) + "," + indent + "\"name\":\"layer" + std::to_string(l) + "\"," + indent;
+            text += "\"type\":\"tilelayer\"," + indent + "\"width\":" + std::to_string(size.x) + "}";
+        }
+        text += "," + indent + "{" + indent + "\"name\":\"points\"," + indent + "\"objects\":[";
+        for (int i = 0; i < num_points; i++)
+        {
+            if (i > 0)
+                text += "," + indent;
+            text += "{" + indent + "\"name\":\"point_" + std::to_string(i % 16) + "\"," + indent + "\"point\":true," + indent;
+            text += "\"x\":" + std::to_string(i % 1000) + ".5," + indent + "\"y\":" + std::to_string(i / 1000) + ".25}";
+        }
+        text += "]," + indent + "\"type\":\"objectgroup\"}]," + indent + "\"width\":" + std::to_string(size.x) + "}";
+
+        return {.name = std::move(name), .text = std::move(text), .tile_layer = "layer0"};
+    }
+
+    [[nodiscard]] std::vector<MapText> LoadMaps()
+    {
+        std::vector<MapText> ret;
+
+        if (const char *dir = std::getenv("IMP_BENCH_TILED_DIR"))
+        {
+            for (const std::string &file_name : Filesystem::GetDirectoryContents(dir))
+            {
+                if (!file_name.ends_with(".json"))
+                    continue;
+
+                MapText &map = ret.emplace_back();
+                map.name = file_name;
+                map.text = Stream::ReadOnlyData(std::string(dir) + "/" + file_name).string();
+
+                FlatJson json(map.text.c_str(), json_depth);
+                json.GetView()["layers"].ForEachArrayElement([&](const Json::View &layer)
+                {
+                    if (map.tile_layer.empty() && layer["type"].GetString() == "tilelayer")
+                        map.tile_layer = layer["name"].GetString();
+                });
+            }
+        }
+
+        if (ret.empty())
+        {
+            ret.push_back(MakeMap("generated_compact", ivec2(1024), 4, 50'000, false));
+            ret.push_back(MakeMap("generated_pretty", ivec2(1024), 4, 50'000, true));
+        }
+
+        return ret;
+    }
+
+    // Measures `func`, and reports the time and the throughput.
+    void Measure(const MapText &map, std::string_view what, auto &&func)
+    {
+        Bench::Samples samples = Bench::Measure(func, {.min_samples = num_repeats});
+
+        std::string name = FMT("json/{}/{}", map.name, what);
+        Bench::Report(name, "ms", samples, 1e6);
+        Bench::Report(name, "MB/s", map.text.size() / (samples.median / 1e9) / 1e6);
+    }
+}
+
+BENCHMARK("json")
+{
+    for (const MapText &map : LoadMaps())
+    {
+        Bench::Report(FMT("json/{}", map.name), "MB", map.text.size() / 1e6);
+
+        Measure(map, "tree", [&]
+        {
+            Json json(map.text.c_str(), json_depth);
+            Bench::DoNotOptimize(json);
+        });
+        Measure(map, "flat", [&]
+        {
+            FlatJson json(map.text.c_str(), json_depth);
+            Bench::DoNotOptimize(json);
+        });
+        Measure(map, "sax", [&]
+        {
+            JsonSaxHandler handler;
+            Json::ParseSax(map.text.c_str(), json_depth, handler);
+        });
+
+        if (map.tile_layer.empty())
+            continue;
+
+        Measure(map, "tile_layer_tree", [&]
+        {
+            Json json(map.text.c_str(), json_depth);
+            Tiled::TileLayer layer = Tiled::LoadTileLayer(Tiled::FindLayer(json.GetView(), map.tile_layer));
+            Bench::DoNotOptimize(layer);
+        });
+        Measure(map, "tile_layer_flat", [&]
+        {
+            FlatJson json(map.text.c_str(), json_depth);
+            Tiled::TileLayer layer = Tiled::LoadTileLayer(Tiled::FindLayer(json.GetView(), map.tile_layer));
+            Bench::DoNotOptimize(layer);
+        });
+        Measure(map, "tile_layer_sax", [&]
+        {
+            Tiled::TileLayer layer = Tiled::LoadTileLayer(map.text.c_str(), map.tile_layer);
+            Bench::DoNotOptimize(layer);
+        });
+    }
+}
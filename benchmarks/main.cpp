@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <numeric>
+
+#include "benchmarks/common.h"
+#include "stream/readonly_data.h"
+#include "stream/save_to_file.h"
+#include "strings/escape.h"
+#include "strings/format.h"
+#include "utils/json.h"
+
+namespace Bench
+{
+    namespace
+    {
+        struct Result
+        {
+            std::string name;
+            std::string metric;
+            double value = 0;
+            double relative_spread = -1;
+        };
+
+        std::vector<Result> results;
+
+        // From `--compare`. The keys are `name` + `'\n'` + `metric`.
+        std::map<std::string, double> baseline;
+
+        [[nodiscard]] std::string ResultKey(std::string_view name, std::string_view metric)
+        {
+            return FMT("{}\n{}", name, metric);
+        }
+
+        void LoadBaseline(const std::string &file_name)
+        {
+            Stream::ReadOnlyData data(file_name);
+            Json json(data.string(), 8);
+            json.GetView()["results"].ForEachArrayElement([&](const Json::View &elem)
+            {
+                baseline[ResultKey(elem["name"].GetString(), elem["metric"].GetString())] = elem["value"].GetReal();
+            });
+        }
+
+        [[nodiscard]] std::string ResultsToJson()
+        {
+            std::string ret = "{\"results\":[\n";
+            for (std::size_t i = 0; i < results.size(); i++)
+            {
+                const Result &result = results[i];
+                if (i > 0)
+                    ret += ",\n";
+                ret += FMT(R"({{"name":"{}","metric":"{}","value":{})",
+                    Strings::Escape(result.name, Strings::EscapeFlags::escape_double_quotes),
+                    Strings::Escape(result.metric, Strings::EscapeFlags::escape_double_quotes),
+                    std::isfinite(result.value) ? result.value : 0
+                );
+                if (result.relative_spread >= 0)
+                    ret += FMT(R"(,"relative_spread":{})", result.relative_spread);
+                ret += "}";
+            }
+            ret += "\n]}\n";
+            return ret;
+        }
+    }
+
+    void Report(std::string_view name, std::string_view metric, double value, double relative_spread)
+    {
+        std::string line = FMT("{:<56} {:>24} {:>14.2f}", name, metric, value);
+        if (relative_spread >= 0)
+            line += FMT(" ±{:>5.1f}%", relative_spread * 100);
+        else
+            line += "        ";
+
+        if (!baseline.empty())
+        {
+            auto it = baseline.find(ResultKey(name, metric));
+            if (it == baseline.end())
+                line += "     (new)";
+            else if (it->second != 0)
+                line += FMT(" {:>+8.1f}%", (value / it->second - 1) * 100);
+        }
+
+        std::cout << line << '\n' << std::flush;
+        results.push_back({.name = std::string(name), .metric = std::string(metric), .value = value, .relative_spread = relative_spread});
+    }
+
+    Samples ComputeSamples(std::vector<double> &samples_ns)
+    {
+        Samples ret;
+        if (samples_ns.empty())
+            return ret;
+
+        ret.count = int(samples_ns.size());
+        std::sort(samples_ns.begin(), samples_ns.end());
+        ret.min = samples_ns.front();
+        std::size_t mid = samples_ns.size() / 2;
+        ret.median = samples_ns.size() % 2 ? samples_ns[mid] : (samples_ns[mid - 1] + samples_ns[mid]) / 2;
+        ret.mean = std::accumulate(samples_ns.begin(), samples_ns.end(), 0.) / ret.count;
+        double variance = 0;
+        for (double sample : samples_ns)
+            variance += (sample - ret.mean) * (sample - ret.mean);
+        ret.stddev = std::sqrt(variance / ret.count);
+        return ret;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string_view> prefixes;
+    std::string json_file_name;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--json="))
+            json_file_name = arg.substr(7);
+        else if (arg.starts_with("--compare="))
+            Bench::LoadBaseline(std::string(arg.substr(10)));
+        else
+            prefixes.push_back(arg);
+    }
+
+    #ifndef NDEBUG
+    std::cout << "WARNING: This is not an optimized build, use `MODE=release`.\n";
+    #endif
+
+    std::vector<Bench::Benchmark> &benchmarks = Bench::GetBenchmarks();
+    std::sort(benchmarks.begin(), benchmarks.end(), [](const Bench::Benchmark &a, const Bench::Benchmark &b){return a.name < b.name;});
+
+    for (const Bench::Benchmark &benchmark : benchmarks)
+    {
+        if (!prefixes.empty() && std::none_of(prefixes.begin(), prefixes.end(), [&](std::string_view prefix){return std::string_view(benchmark.name).starts_with(prefix);}))
+            continue;
+
+        std::cout << "--- " << benchmark.name << '\n';
+        benchmark.func();
+    }
+
+    if (!json_file_name.empty())
+        Stream::SaveFile(json_file_name, Bench::ResultsToJson());
+}
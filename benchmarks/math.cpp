@@ -0,0 +1,245 @@
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "benchmarks/common.h"
+#include "utils/mat.h"
+#include "utils/random.h"
+#include "utils/robust_math.h"
+
+// Benchmarks for the generated math library (`utils/mat.h`, see `gen/make_math.cpp`), and for `Robust` and `Random`.
+// Most of them apply an operation to every element of an array, and report the time per element.
+// Those loops are also run with the auto-vectorization disabled, and report the ratio of the two times as `vectorization`.
+// If that ratio drops to ~1 after a change to the generator, the generated code no longer vectorizes.
+// Compare the results between GCC and Clang too, they vectorize different things. `IMP_MATH_SIMD` also affects some of those.
+
+#if defined(__clang__)
+#  define BENCH_NO_VECTORIZE_FUNC
+#  define BENCH_NO_VECTORIZE_LOOP _Pragma("clang loop vectorize(disable) interleave(disable)")
+#elif defined(__GNUC__)
+#  define BENCH_NO_VECTORIZE_FUNC __attribute__((__optimize__("no-tree-vectorize")))
+#  define BENCH_NO_VECTORIZE_LOOP
+#else
+#  define BENCH_NO_VECTORIZE_FUNC
+#  define BENCH_NO_VECTORIZE_LOOP
+#endif
+
+namespace
+{
+    constexpr std::size_t num_elems = 4096;
+    constexpr int num_repeats = 50;
+
+    template <typename F>
+    void RunLoop(F &func)
+    {
+        for (std::size_t i = 0; i < num_elems; i++)
+            func(i);
+    }
+
+    template <typename F>
+    BENCH_NO_VECTORIZE_FUNC void RunLoopNoVectorize(F &func)
+    {
+        BENCH_NO_VECTORIZE_LOOP
+        for (std::size_t i = 0; i < num_elems; i++)
+            func(i);
+    }
+
+    // Measures `func`, and returns the median time per element.
+    [[nodiscard]] double NsPerElem(auto &&func)
+    {
+        return Bench::Measure(func, {.min_samples = num_repeats}).median / num_elems;
+    }
+
+    // Runs `func(i)` for every element index, with and without the auto-vectorization.
+    // `func` must write its result somewhere, `out` is passed to `DoNotOptimize()` after every run.
+    void MeasureLoop(std::string_view name, const auto &out, auto &&func)
+    {
+        double ns = NsPerElem([&]{RunLoop(func); Bench::DoNotOptimize(out);});
+        double ns_scalar = NsPerElem([&]{RunLoopNoVectorize(func); Bench::DoNotOptimize(out);});
+        Bench::Report(name, "ns/op", ns);
+        Bench::Report(name, "vectorization", ns_scalar / ns);
+    }
+
+    // Same, but for things that aren't expected to vectorize, only reports the time.
+    void Measure(std::string_view name, const auto &out, auto &&func)
+    {
+        Bench::Report(name, "ns/op", NsPerElem([&]{RunLoop(func); Bench::DoNotOptimize(out);}));
+    }
+
+    // Returns `num_elems` random values of type `T`, with the components in `-range..range`.
+    template <typename T>
+    [[nodiscard]] std::vector<T> RandomArray(Random::DefaultGenerator &gen, float range)
+    {
+        Random::Interface<Random::DefaultGenerator, T> random(gen);
+        std::vector<T> ret(num_elems);
+        for (T &elem : ret)
+            elem = random.abs() <= range;
+        return ret;
+    }
+
+    // Returns `num_elems` random invertible square matrices.
+    template <typename M>
+    [[nodiscard]] std::vector<M> RandomMatrices(Random::DefaultGenerator &gen)
+    {
+        Random::Interface<Random::DefaultGenerator, float> random(gen);
+        std::vector<M> ret(num_elems);
+        for (M &m : ret)
+        {
+            // Diagonally dominant, so always invertible.
+            for (int i = 0; i < M::size; i++)
+            {
+                for (int j = 0; j < M::size; j++)
+                    m[i][j] = (i == j ? 8 : 0) + (random.abs() <= 1);
+            }
+        }
+        return ret;
+    }
+}
+
+BENCHMARK("math/vec")
+{
+    Random::DefaultGenerator gen(1);
+
+    auto a2 = RandomArray<fvec2>(gen, 100), b2 = RandomArray<fvec2>(gen, 100);
+    auto a3 = RandomArray<fvec3>(gen, 100), b3 = RandomArray<fvec3>(gen, 100);
+    auto a4 = RandomArray<fvec4>(gen, 100), b4 = RandomArray<fvec4>(gen, 100);
+    std::vector<ivec2> ai(num_elems), bi(num_elems);
+    for (std::size_t i = 0; i < num_elems; i++)
+    {
+        ai[i] = ivec2(a2[i] * 100);
+        bi[i] = ivec2(b2[i] * 100);
+    }
+
+    std::vector<float> out_f(num_elems);
+    std::vector<fvec2> out2(num_elems);
+    std::vector<fvec3> out3(num_elems);
+    std::vector<fvec4> out4(num_elems);
+    std::vector<ivec2> out_i(num_elems);
+
+    MeasureLoop("math/vec/fvec2+fvec2", out2, [&](std::size_t i){out2[i] = a2[i] + b2[i];});
+    MeasureLoop("math/vec/fvec3*float+fvec3", out3, [&](std::size_t i){out3[i] = a3[i] * 2.5f + b3[i];});
+    MeasureLoop("math/vec/fvec4*fvec4", out4, [&](std::size_t i){out4[i] = a4[i] * b4[i];});
+    MeasureLoop("math/vec/ivec2*int+ivec2", out_i, [&](std::size_t i){out_i[i] = ai[i] * 3 + bi[i];});
+    MeasureLoop("math/vec/fvec3.dot", out_f, [&](std::size_t i){out_f[i] = a3[i].dot(b3[i]);});
+    MeasureLoop("math/vec/fvec4.dot", out_f, [&](std::size_t i){out_f[i] = a4[i].dot(b4[i]);});
+    MeasureLoop("math/vec/fvec3.cross", out3, [&](std::size_t i){out3[i] = a3[i].cross(b3[i]);});
+    MeasureLoop("math/vec/fvec2.len", out_f, [&](std::size_t i){out_f[i] = a2[i].len();});
+    MeasureLoop("math/vec/fvec3.norm", out3, [&](std::size_t i){out3[i] = a3[i].norm();});
+    MeasureLoop("math/vec/min(fvec4,fvec4)", out4, [&](std::size_t i){out4[i] = min(a4[i], b4[i]);});
+    MeasureLoop("math/vec/clamp(ivec2)", out_i, [&](std::size_t i){out_i[i] = clamp(ai[i], -1000, 1000);});
+    MeasureLoop("math/vec/mix(fvec3)", out3, [&](std::size_t i){out3[i] = mix(0.25f, a3[i], b3[i]);});
+}
+
+BENCHMARK("math/mat")
+{
+    Random::DefaultGenerator gen(2);
+
+    auto a3 = RandomMatrices<fmat3>(gen), b3 = RandomMatrices<fmat3>(gen);
+    auto a4 = RandomMatrices<fmat4>(gen), b4 = RandomMatrices<fmat4>(gen);
+    auto v4 = RandomArray<fvec4>(gen, 100);
+
+    std::vector<fmat3> out3(num_elems);
+    std::vector<fmat4> out4(num_elems);
+    std::vector<fvec4> out_v4(num_elems);
+
+    MeasureLoop("math/mat/fmat3*fmat3", out3, [&](std::size_t i){out3[i] = a3[i] * b3[i];});
+    MeasureLoop("math/mat/fmat4*fmat4", out4, [&](std::size_t i){out4[i] = a4[i] * b4[i];});
+    MeasureLoop("math/mat/fmat4*fvec4", out_v4, [&](std::size_t i){out_v4[i] = a4[i] * v4[i];});
+    MeasureLoop("math/mat/fmat4.transpose", out4, [&](std::size_t i){out4[i] = a4[i].transpose();});
+    MeasureLoop("math/mat/fmat3.inverse", out3, [&](std::size_t i){out3[i] = a3[i].inverse();});
+    MeasureLoop("math/mat/fmat4.inverse", out4, [&](std::size_t i){out4[i] = a4[i].inverse();});
+}
+
+BENCHMARK("math/rect")
+{
+    Random::DefaultGenerator gen(3);
+    Random::DefaultInterfaces ra(gen);
+
+    std::vector<frect2> a(num_elems), b(num_elems);
+    std::vector<fvec2> points = RandomArray<fvec2>(gen, 100);
+    for (std::size_t i = 0; i < num_elems; i++)
+    {
+        a[i] = (ra.fvec2.abs() <= 100).rect_size(0 <= ra.fvec2 <= 20);
+        b[i] = (ra.fvec2.abs() <= 100).rect_size(0 <= ra.fvec2 <= 20);
+    }
+    std::vector<irect2> ai(num_elems);
+    for (std::size_t i = 0; i < num_elems; i++)
+        ai[i] = ivec2(a[i].a).rect_to(ivec2(a[i].b));
+
+    std::vector<frect2> out(num_elems);
+    std::vector<unsigned char> out_b(num_elems);
+
+    MeasureLoop("math/rect/frect2.intersect", out, [&](std::size_t i){out[i] = a[i].intersect(b[i]);});
+    MeasureLoop("math/rect/frect2.combine", out, [&](std::size_t i){out[i] = a[i].combine(b[i]);});
+    MeasureLoop("math/rect/frect2.expand", out, [&](std::size_t i){out[i] = a[i].expand(1.5f);});
+    MeasureLoop("math/rect/frect2.contains(fvec2)", out_b, [&](std::size_t i){out_b[i] = a[i].contains(points[i]);});
+    MeasureLoop("math/rect/frect2.touches(frect2)", out_b, [&](std::size_t i){out_b[i] = a[i].touches(b[i]);});
+    MeasureLoop("math/rect/irect2.contains(ivec2)", out_b, [&](std::size_t i){out_b[i] = ai[i].contains(ivec2(points[i]));});
+}
+
+BENCHMARK("math/robust")
+{
+    Random::DefaultGenerator gen(4);
+    Random::DefaultInterfaces ra(gen);
+
+    std::vector<int> ints(num_elems);
+    std::vector<unsigned int> uints(num_elems);
+    std::vector<float> floats = RandomArray<float>(gen, 1000);
+    std::vector<double> doubles(num_elems);
+    for (std::size_t i = 0; i < num_elems; i++)
+    {
+        ints[i] = -1000 <= ra.i <= 1000;
+        uints[i] = 0 <= ra.i <= 2000;
+        doubles[i] = floats[i];
+    }
+
+    std::vector<unsigned char> out(num_elems);
+    std::vector<int> out_i(num_elems);
+
+    MeasureLoop("math/robust/less(int,unsigned)", out, [&](std::size_t i){out[i] = Robust::less(ints[i], uints[i]);});
+    MeasureLoop("math/robust/equal(int,float)", out, [&](std::size_t i){out[i] = Robust::equal(ints[i], floats[i]);});
+    Measure("math/robust/less(int,float)", out, [&](std::size_t i){out[i] = Robust::less(ints[i], floats[i]);});
+    Measure("math/robust/less(long long,double)", out, [&](std::size_t i){out[i] = Robust::less((long long)ints[i] << 40, doubles[i]);});
+    Measure("math/robust/compare_three_way(int,float)", out_i, [&](std::size_t i){out_i[i] = Robust::compare_three_way(ints[i], floats[i]) < 0;});
+    Measure("math/robust/representable_as<int>(float)", out, [&](std::size_t i){out[i] = Robust::representable_as<int>(floats[i] * 1e7f);});
+
+    // This one processes the whole array per call, so the time is divided by the array size.
+    std::size_t count = 0;
+    Bench::Report("math/robust/count_in_range(float)", "ns/op", NsPerElem([&]
+    {
+        count = Robust::count_in_range(std::span<const float>(floats), -500, 500);
+        Bench::DoNotOptimize(count);
+    }));
+}
+
+BENCHMARK("math/random")
+{
+    Random::DefaultGenerator gen(5);
+    Random::DefaultInterfaces ra(gen);
+    Random::CounterGenerator counter_gen(5, 42, 0);
+
+    std::vector<float> out(num_elems);
+    std::vector<fvec2> out2(num_elems);
+    std::vector<int> out_i(num_elems);
+    std::vector<std::uint32_t> out_u(num_elems);
+
+    Measure("math/random/generator", out_u, [&](std::size_t i){out_u[i] = std::uint32_t(gen());});
+    Measure("math/random/counter_generator", out_u, [&](std::size_t i){out_u[i] = counter_gen();});
+    Measure("math/random/int", out_i, [&](std::size_t i){out_i[i] = -100 <= ra.i <= 100;});
+    Measure("math/random/float", out, [&](std::size_t i){out[i] = -100 <= ra.f <= 100;});
+    Measure("math/random/fvec2", out2, [&](std::size_t i){out2[i] = ra.fvec2.abs() <= 100;});
+
+    // Those fill the whole array per call, so the time is divided by the array size.
+    Bench::Report("math/random/Fill", "ns/op", NsPerElem([&]
+    {
+        Random::Fill(gen, out, -100, 100);
+        Bench::DoNotOptimize(out);
+    }));
+    Bench::Report("math/random/Fill(counter_generator)", "ns/op", NsPerElem([&]
+    {
+        Random::Fill(counter_gen, out, -100, 100);
+        Bench::DoNotOptimize(out);
+    }));
+}
@@ -0,0 +1,329 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "benchmarks/common.h"
+#include "graph/hierarchical_pathfinding.h"
+#include "graph/pathfinding.h"
+#include "stream/readonly_data.h"
+#include "strings/format.h"
+#include "utils/filesystem.h"
+#include "utils/random.h"
+
+// Benchmarks for the 4-way grid pathfinders.
+// Set `IMP_BENCH_MOVINGAI_DIR` to a directory with movingai-style `.scen` files (https://movingai.com/benchmarks/grids.html),
+//   and the maps they refer to (either next to them, or at the paths written in the scenarios).
+// Otherwise uses a few generated maps. The scenarios' optimal lengths are for 8-way movement, so we ignore them.
+
+namespace
+{
+    constexpr std::size_t max_queries_per_scenario = 1000;
+
+    struct Map
+    {
+        ivec2 size;
+        std::vector<char> solid;
+
+        [[nodiscard]] irect2 Bounds() const
+        {
+            return ivec2().rect_size(size);
+        }
+
+        [[nodiscard]] bool IsSolid(ivec2 pos) const
+        {
+            return !Bounds().contains(pos) || solid[std::size_t(pos.y) * std::size_t(size.x) + std::size_t(pos.x)];
+        }
+    };
+
+    struct Query
+    {
+        ivec2 start;
+        ivec2 goal;
+    };
+
+    struct Scenario
+    {
+        std::string name;
+        Map map;
+        std::vector<Query> queries;
+    };
+
+    // Loads a movingai `.map` file. Only `.`, `G` and `S` are considered passable.
+    [[nodiscard]] Map LoadMovingAiMap(const std::string &file_name)
+    {
+        Stream::ReadOnlyData data(file_name);
+        std::istringstream input{std::string(data.string())};
+
+        Map ret;
+        std::string word;
+        while (input >> word && word != "map")
+        {
+            if (word == "height")
+                input >> ret.size.y;
+            else if (word == "width")
+                input >> ret.size.x;
+            else if (word == "type")
+                input >> word;
+            else
+                throw std::runtime_error(FMT("Unexpected `{}` in the header of `{}`.", word, file_name));
+        }
+        if (!(ret.size > 0).all())
+            throw std::runtime_error(FMT("Bad map size in `{}`.", file_name));
+
+        ret.solid.reserve(std::size_t(ret.size.prod()));
+        for (int y = 0; y < ret.size.y; y++)
+        {
+            std::string line;
+            if (!(input >> line) || int(line.size()) != ret.size.x)
+                throw std::runtime_error(FMT("Bad map row {} in `{}`.", y, file_name));
+            for (char ch : line)
+                ret.solid.push_back(ch != '.' && ch != 'G' && ch != 'S');
+        }
+        return ret;
+    }
+
+    // Loads a movingai `.scen` file, and the map it refers to.
+    [[nodiscard]] Scenario LoadMovingAiScenario(const std::string &dir, const std::string &file_name)
+    {
+        Stream::ReadOnlyData data(dir + "/" + file_name);
+        std::istringstream input{std::string(data.string())};
+
+        std::string word;
+        input >> word >> word; // `version 1`
+
+        Scenario ret;
+        ret.name = file_name;
+        std::string map_name;
+
+        int bucket = 0;
+        std::string line_map_name;
+        ivec2 map_size, start, goal;
+        double optimal_length = 0;
+        while (input >> bucket >> line_map_name >> map_size.x >> map_size.y >> start.x >> start.y >> goal.x >> goal.y >> optimal_length)
+        {
+            if (map_name.empty())
+                map_name = line_map_name;
+            if (ret.queries.size() < max_queries_per_scenario)
+                ret.queries.push_back({.start = start, .goal = goal});
+        }
+        if (map_name.empty())
+            throw std::runtime_error(FMT("No queries in `{}`.", file_name));
+
+        // Try the path as written, then just the file name.
+        std::string map_path = dir + "/" + map_name;
+        bool ok = false;
+        (void)Filesystem::GetObjectInfo(map_path, &ok);
+        if (!ok)
+            map_path = dir + "/" + map_name.substr(map_name.find_last_of('/') + 1);
+
+        ret.map = LoadMovingAiMap(map_path);
+        return ret;
+    }
+
+    // Makes a map with random walls, and random queries on it.
+    [[nodiscard]] Scenario MakeNoiseScenario(ivec2 size, float wall_chance)
+    {
+        Random::DefaultGenerator gen(1234);
+        Random::DefaultInterfaces ra(gen);
+
+        Scenario ret;
+        ret.name = FMT("noise_{}x{}_{}", size.x, size.y, wall_chance);
+        ret.map.size = size;
+        ret.map.solid.resize(std::size_t(size.prod()));
+        for (char &tile : ret.map.solid)
+            tile = (ra.f <= 1) < wall_chance;
+
+        while (ret.queries.size() < max_queries_per_scenario)
+        {
+            Query query{.start = ra.ivec2 < size, .goal = ra.ivec2 < size};
+            if (!ret.map.IsSolid(query.start) && !ret.map.IsSolid(query.goal))
+                ret.queries.push_back(query);
+        }
+        return ret;
+    }
+
+    // Makes a map of square rooms connected by doors in the middle of each wall.
+    [[nodiscard]] Scenario MakeRoomsScenario(ivec2 size, int room_size)
+    {
+        Random::DefaultGenerator gen(1234);
+        Random::DefaultInterfaces ra(gen);
+
+        Scenario ret;
+        ret.name = FMT("rooms_{}x{}_{}", size.x, size.y, room_size);
+        ret.map.size = size;
+        ret.map.solid.resize(std::size_t(size.prod()));
+        for (ivec2 pos : vector_range(size))
+        {
+            ivec2 in_room = mod_ex(pos, room_size);
+            bool wall = in_room(any) == 0;
+            bool door = in_room(any) == room_size / 2;
+            // Close some doors, so that it's not just a grid.
+            bool closed = door && (ra.f <= 1) < 0.3f;
+            ret.map.solid[std::size_t(pos.y) * std::size_t(size.x) + std::size_t(pos.x)] = wall && (!door || closed);
+        }
+
+        while (ret.queries.size() < max_queries_per_scenario)
+        {
+            Query query{.start = ra.ivec2 < size, .goal = ra.ivec2 < size};
+            if (!ret.map.IsSolid(query.start) && !ret.map.IsSolid(query.goal))
+                ret.queries.push_back(query);
+        }
+        return ret;
+    }
+
+    [[nodiscard]] std::vector<Scenario> LoadScenarios()
+    {
+        std::vector<Scenario> ret;
+
+        if (const char *dir = std::getenv("IMP_BENCH_MOVINGAI_DIR"))
+        {
+            for (const std::string &file_name : Filesystem::GetDirectoryContents(dir))
+            {
+                if (file_name.ends_with(".scen"))
+                    ret.push_back(LoadMovingAiScenario(dir, file_name));
+            }
+        }
+
+        if (ret.empty())
+        {
+            ret.push_back(MakeNoiseScenario(ivec2(256), 0.2f));
+            ret.push_back(MakeNoiseScenario(ivec2(256), 0.35f));
+            ret.push_back(MakeRoomsScenario(ivec2(256), 16));
+        }
+
+        return ret;
+    }
+
+    // The number of elements in the node info storage, plus an estimate of its memory usage.
+    struct StorageUsage
+    {
+        std::size_t elems = 0;
+        std::size_t bytes = 0;
+    };
+
+    template <typename M>
+    [[nodiscard]] StorageUsage GetStorageUsage(const M &map)
+    {
+        StorageUsage ret;
+        ret.elems = map.size();
+        if constexpr (requires{map.Bounds();})
+            ret.bytes = std::size_t(map.Bounds().size().prod()) * (sizeof(typename M::value_type) + sizeof(std::uint32_t)); // Plus the generation counter.
+        else
+            ret.bytes = map.capacity() * (sizeof(typename M::value_type) + 1); // Plus the control byte.
+        return ret;
+    }
+
+    // Runs every query through the pathfinder, and reports the stats.
+    // `step` is `(P &pathfinder, ivec2 goal) -> void`.
+    template <typename P>
+    void RunPathfinder(const std::string &name, const Scenario &scenario, P &pathfinder, auto &&step)
+    {
+        std::size_t num_steps = 0, num_found = 0, total_len = 0;
+        StorageUsage max_usage;
+
+        double ns = Bench::MeasureNs([&]
+        {
+            for (const Query &query : scenario.queries)
+            {
+                pathfinder.SetNewTask(query.start);
+                while (pathfinder.HasUnvisitedNodes())
+                {
+                    if (pathfinder.CurrentNode() == query.goal)
+                    {
+                        num_found++;
+                        pathfinder.DumpPathBackwards(query.goal, [&](ivec2){total_len++;});
+                        break;
+                    }
+                    step(pathfinder, query.goal);
+                    num_steps++;
+                }
+
+                StorageUsage usage = GetStorageUsage(pathfinder.GetNodeInfoMap());
+                max_usage.elems = max(max_usage.elems, usage.elems);
+                max_usage.bytes = max(max_usage.bytes, usage.bytes);
+            }
+        });
+
+        std::size_t num_queries = scenario.queries.size();
+        Bench::Report(name, "ns/query", ns / num_queries);
+        Bench::Report(name, "steps/query", double(num_steps) / num_queries);
+        Bench::Report(name, "found/query", double(num_found) / num_queries);
+        Bench::Report(name, "len/found", num_found ? double(total_len) / num_found : 0);
+        Bench::Report(name, "nodes/max", max_usage.elems);
+        Bench::Report(name, "kb/max", max_usage.bytes / 1024.);
+    }
+
+    template <template <typename, typename> typename NodeInfoMapTemplate, template <typename, typename> typename NodeQueueTemplate>
+    void RunAStar(const std::string &name, const Scenario &scenario)
+    {
+        using P = Graph::Pathfinding::Pathfinder_4Way<ivec2, NodeInfoMapTemplate, NodeQueueTemplate>;
+        std::optional<P> pathfinder;
+        if constexpr (std::is_constructible_v<typename P::NodeInfoMap, irect2>)
+            pathfinder.emplace(typename P::NodeInfoMap(scenario.map.Bounds()));
+        else
+            pathfinder.emplace();
+
+        RunPathfinder(name, scenario, *pathfinder, [&](P &p, ivec2 goal){p.Step(goal, [&](ivec2 pos){return scenario.map.IsSolid(pos);});});
+    }
+
+    void RunScenario(const Scenario &scenario)
+    {
+        using namespace Graph::Pathfinding;
+
+        std::string prefix = FMT("pathfinding/{}", scenario.name);
+        auto is_solid = [&](ivec2 pos){return scenario.map.IsSolid(pos);};
+
+        RunAStar<HashNodeInfoMap, BinaryHeapNodeQueue>(prefix + "/a*/hash", scenario);
+        RunAStar<GridNodeInfoMap, BinaryHeapNodeQueue>(prefix + "/a*/grid", scenario);
+        RunAStar<GridNodeInfoMap, IndexedHeapNodeQueue>(prefix + "/a*/grid/indexed_heap", scenario);
+        RunAStar<GridNodeInfoMap, BucketNodeQueue>(prefix + "/a*/grid/buckets", scenario);
+
+        {
+            using P = Pathfinder_4WayJps<ivec2, GridNodeInfoMap>;
+            P pathfinder{P::NodeInfoMap(scenario.map.Bounds())};
+            RunPathfinder(prefix + "/jps/grid", scenario, pathfinder, [&](P &p, ivec2 goal){p.Step(goal, is_solid);});
+
+            JpsTable_4Way<ivec2> table;
+            Bench::Report(prefix + "/jps+/grid", "ns/table", Bench::MeasureNs([&]{table = JpsTable_4Way<ivec2>(scenario.map.Bounds(), is_solid);}));
+            RunPathfinder(prefix + "/jps+/grid", scenario, pathfinder, [&](P &p, ivec2 goal){p.Step(goal, table);});
+        }
+
+        {
+            std::string name = prefix + "/hpa*";
+            std::optional<HierarchicalPathfinder_4Way<ivec2>> pathfinder;
+            Bench::Report(name, "ns/build", Bench::MeasureNs([&]{pathfinder.emplace(scenario.map.Bounds(), ivec2(16), is_solid);}));
+
+            std::size_t num_found = 0, total_len = 0;
+            std::vector<ivec2> path;
+            double ns = Bench::MeasureNs([&]
+            {
+                for (const Query &query : scenario.queries)
+                {
+                    path.clear();
+                    if (pathfinder->FindPath(query.start, query.goal, is_solid, path))
+                    {
+                        num_found++;
+                        total_len += path.size();
+                    }
+                }
+            });
+            std::size_t num_queries = scenario.queries.size();
+            Bench::Report(name, "ns/query", ns / num_queries);
+            Bench::Report(name, "found/query", double(num_found) / num_queries);
+            Bench::Report(name, "len/found", num_found ? double(total_len) / num_found : 0);
+        }
+    }
+}
+
+BENCHMARK("pathfinding")
+{
+    for (const Scenario &scenario : LoadScenarios())
+        RunScenario(scenario);
+}
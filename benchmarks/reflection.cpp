@@ -0,0 +1,147 @@
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmarks/common.h"
+#include "reflection/full.h"
+#include "strings/format.h"
+#include "utils/mat.h"
+
+// Benchmarks for the reflection-based serialization, on a nested state resembling a game save.
+
+namespace
+{
+    constexpr int num_repeats = 5;
+
+    REFL_SIMPLE_STRUCT( Item
+        REFL_DECL(std::string) name
+        REFL_DECL(int) count
+        REFL_DECL(std::optional<float>) durability
+    )
+
+    REFL_SIMPLE_STRUCT( Unit
+        REFL_DECL(fvec2) pos
+        REFL_DECL(fvec2) vel
+        REFL_DECL(float) health
+        REFL_DECL(bool) alive
+        REFL_DECL(std::vector<Item>) items
+        REFL_DECL(std::vector<ivec2>) path
+    )
+
+    REFL_SIMPLE_STRUCT( World
+        REFL_DECL(std::vector<Unit>) units
+        REFL_DECL(std::vector<fvec2>) points
+        REFL_DECL(std::vector<std::string>) names
+    )
+
+    // Mostly numbers, like the settings files.
+    REFL_SIMPLE_STRUCT( Config
+        REFL_DECL(std::string) name
+        REFL_DECL(int) width
+        REFL_DECL(int) height
+        REFL_DECL(float) scale
+        REFL_DECL(double) gamma
+        REFL_DECL(bool) fullscreen
+        REFL_DECL(std::vector<float>) volumes
+        REFL_DECL(std::vector<std::int64_t>) seeds
+    )
+
+    [[nodiscard]] World MakeWorld()
+    {
+        World ret;
+        for (int i = 0; i < 20'000; i++)
+        {
+            Unit &unit = ret.units.emplace_back();
+            unit.pos = fvec2(i % 100, i / 100);
+            unit.vel = fvec2(i % 7, i % 3) * 0.5f;
+            unit.health = i % 100;
+            unit.alive = i % 5 != 0;
+            for (int j = 0; j < i % 4; j++)
+                unit.items.push_back({.name = FMT("item_{}", j), .count = j + 1, .durability = j % 2 ? std::optional<float>(0.75f) : std::nullopt});
+            for (int j = 0; j < i % 16; j++)
+                unit.path.push_back(ivec2(i + j, i - j));
+        }
+        for (int i = 0; i < 200'000; i++)
+            ret.points.push_back(fvec2(i, -i));
+        for (int i = 0; i < 10'000; i++)
+            ret.names.push_back(FMT("name_{}", i));
+        return ret;
+    }
+
+    [[nodiscard]] std::vector<Config> MakeConfigs()
+    {
+        std::vector<Config> ret;
+        for (int i = 0; i < 20'000; i++)
+        {
+            Config &config = ret.emplace_back();
+            config.name = FMT("config_{}", i);
+            config.width = 640 + i % 1280;
+            config.height = 480 + i % 720;
+            config.scale = 1 + i % 8 * 0.125f;
+            config.gamma = 2.2 + i * 1e-4;
+            config.fullscreen = i % 2;
+            for (int j = 0; j < 8; j++)
+                config.volumes.push_back(j / 7.f);
+            for (int j = 0; j < 4; j++)
+                config.seeds.push_back(std::int64_t(i) * 1'000'003 - j * 7919);
+        }
+        return ret;
+    }
+
+    // Measures `func`, and reports the time and the throughput.
+    void Measure(std::string_view what, std::size_t bytes, auto &&func)
+    {
+        Bench::Samples samples = Bench::Measure(func, {.min_samples = num_repeats});
+
+        std::string name = FMT("reflection/{}", what);
+        Bench::Report(name, "ms", samples, 1e6);
+        Bench::Report(name, "MB/s", bytes / (samples.median / 1e9) / 1e6);
+    }
+}
+
+BENCHMARK("reflection")
+{
+    World world = MakeWorld();
+    std::vector<std::uint8_t> binary = Refl::ToBinary<std::vector<std::uint8_t>>(world);
+    std::string text = Refl::ToString(world);
+    Bench::Report("reflection/binary", "MB", binary.size() / 1e6);
+    Bench::Report("reflection/text", "MB", text.size() / 1e6);
+
+    Measure("to_binary", binary.size(), [&]
+    {
+        std::vector<std::uint8_t> result = Refl::ToBinary<std::vector<std::uint8_t>>(world);
+        Bench::DoNotOptimize(result);
+    });
+    Measure("from_binary", binary.size(), [&]
+    {
+        World result = Refl::FromBinary<World>(Stream::ReadOnlyData::mem_reference(binary));
+        Bench::DoNotOptimize(result);
+    });
+    Measure("to_string", text.size(), [&]
+    {
+        std::string result = Refl::ToString(world);
+        Bench::DoNotOptimize(result);
+    });
+    Measure("from_string", text.size(), [&]
+    {
+        World result = Refl::FromString<World>(text);
+        Bench::DoNotOptimize(result);
+    });
+}
+
+BENCHMARK("reflection.config")
+{
+    std::vector<Config> configs = MakeConfigs();
+    std::string text = Refl::ToString(configs, Refl::ToStringOptions::Pretty());
+    Bench::Report("reflection/config_text", "MB", text.size() / 1e6);
+
+    Measure("config_round_trip", text.size(), [&]
+    {
+        std::string result = Refl::ToString(configs, Refl::ToStringOptions::Pretty());
+        std::vector<Config> copy = Refl::FromString<std::vector<Config>>(result);
+        Bench::DoNotOptimize(copy);
+    });
+}
@@ -0,0 +1,96 @@
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "benchmarks/common.h"
+#include "strings/format.h"
+#include "utils/random.h"
+#include "utils/robust_math.h"
+
+// Compares the fast paths in `utils/robust_math.h` (the integral type fits into the floating-point one exactly) with the generic `Robust` comparisons,
+//   and with the builtin operators as the lower bound.
+// `int x double` and `short x float` use the fast paths, `long long x double` and `int x float` use the generic algorithm.
+
+namespace
+{
+    constexpr std::size_t num_elems = 1 << 16;
+    constexpr int num_repeats = 20;
+
+    // Measures `func`, and reports the time per element.
+    void Measure(std::string_view name, auto &&func)
+    {
+        Bench::Report(name, "ns/elem", Bench::Measure(func, {.min_samples = num_repeats}), num_elems);
+    }
+
+    // Measures `Robust::less()` and `Robust::all_in_range()` for the integers `ints` and the floating-point numbers `floats`.
+    template <typename I, typename F>
+    void MeasureTypes(std::string_view name, const std::vector<I> &ints, const std::vector<F> &floats, F min, F max)
+    {
+        Measure(FMT("robust_math/less/{}/robust", name), [&]
+        {
+            std::size_t count = 0;
+            for (std::size_t i = 0; i < num_elems; i++)
+                count += Robust::less(ints[i], floats[i]);
+            Bench::DoNotOptimize(count);
+        });
+
+        Measure(FMT("robust_math/all_in_range/{}/loop", name), [&]
+        {
+            bool ok = true;
+            for (std::size_t i = 0; i < num_elems; i++)
+                ok = ok && Robust::in_range(ints[i], min, max);
+            Bench::DoNotOptimize(ok);
+        });
+        Measure(FMT("robust_math/all_in_range/{}/batch", name), [&]
+        {
+            Bench::DoNotOptimize(Robust::all_in_range(std::span<const I>(ints), min, max));
+        });
+    }
+
+    template <typename I, typename F>
+    [[nodiscard]] std::vector<I> ConvertVector(const std::vector<F> &source)
+    {
+        return std::vector<I>(source.begin(), source.end());
+    }
+}
+
+BENCHMARK("robust_math")
+{
+    Random::DefaultGenerator gen(42);
+    Random::DefaultInterfaces ra(gen);
+
+    // The values are in range, so that the loops don't exit early.
+    std::vector<int> ints(num_elems);
+    std::vector<double> doubles(num_elems);
+    for (std::size_t i = 0; i < num_elems; i++)
+    {
+        ints[i] = ra.i.abs() <= 10000;
+        doubles[i] = ra.f.abs() <= 10000;
+    }
+
+    // The lower bound.
+    Measure("robust_math/less/int_double/builtin", [&]
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < num_elems; i++)
+            count += double(ints[i]) < doubles[i];
+        Bench::DoNotOptimize(count);
+    });
+    Measure("robust_math/all_in_range/int_double/builtin", [&]
+    {
+        bool ok = true;
+        for (int value : ints)
+            ok &= (value >= -10000) & (value <= 10000);
+        Bench::DoNotOptimize(ok);
+    });
+
+    // Fast paths.
+    MeasureTypes<int, double>("int_double", ints, doubles, -10000, 10000);
+    MeasureTypes<short, float>("short_float", ConvertVector<short>(ints), ConvertVector<float>(doubles), -10000, 10000);
+
+    // Generic.
+    MeasureTypes<long long, double>("int64_double", ConvertVector<long long>(ints), doubles, -10000, 10000);
+    MeasureTypes<int, float>("int_float", ints, ConvertVector<float>(doubles), -10000, 10000);
+}
@@ -0,0 +1,94 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "benchmarks/common.h"
+#include "strings/format.h"
+#include "utils/random.h"
+#include "utils/sparse_set.h"
+
+// Benchmarks for `SparseSet`, with and without the occupancy bits.
+// The random elements are generated once from a fixed seed, so only the set operations are measured.
+
+namespace
+{
+    constexpr int sizes[] = {1'000, 100'000, 10'000'000};
+
+    template <bool OccupancyBits>
+    void RunSparseSet(int capacity)
+    {
+        using Set = SparseSet<int, OccupancyBits>;
+
+        std::string name = FMT("sparse_set/occupancy_bits={}/n={}", OccupancyBits, capacity);
+
+        Random::DefaultGenerator gen(1234);
+        Random::DefaultInterfaces ra(gen);
+
+        std::vector<int> random_elems(capacity);
+        for (int &elem : random_elems)
+            elem = ra.i < capacity;
+
+        Set set(capacity);
+
+        Bench::Report(name, "ns/insert", Bench::Measure([&]
+        {
+            set.EraseAllElements();
+            for (int elem : random_elems)
+                set.Insert(elem);
+        }), capacity);
+
+        Bench::Report(name, "ns/contains", Bench::Measure([&]
+        {
+            int count = 0;
+            for (int elem : random_elems)
+                count += set.Contains(elem);
+            Bench::DoNotOptimize(count);
+        }), capacity);
+
+        Bench::Report(name, "ns/iterate", Bench::Measure([&]
+        {
+            long long sum = 0;
+            for (int elem : set.Elems())
+                sum += elem;
+            Bench::DoNotOptimize(sum);
+        }), set.ElemCount());
+
+        // Erasing empties the set, so each sample refills it first. Subtract `ns/insert` to get the erasure alone.
+        Bench::Report(name, "ns/ins+erase_unordered", Bench::Measure([&]
+        {
+            set.EraseAllElements();
+            for (int elem : random_elems)
+                set.Insert(elem);
+            for (int elem : random_elems)
+                set.EraseUnordered(elem);
+        }), capacity);
+
+        Bench::Report(name, "ns/insert_many", Bench::Measure([&]
+        {
+            set.EraseAllElements();
+            Bench::DoNotOptimize(set.InsertMany(capacity).data());
+        }), capacity);
+
+        // `EraseOrdered()` is O(n), so only try it on the small sets.
+        if (capacity <= 1'000)
+        {
+            Bench::Report(name, "ns/ins+erase_ordered", Bench::Measure([&]
+            {
+                set.EraseAllElements();
+                for (int elem : random_elems)
+                    set.Insert(elem);
+                for (int elem : random_elems)
+                    set.EraseOrdered(elem);
+            }), capacity);
+        }
+    }
+}
+
+BENCHMARK("sparse_set")
+{
+    for (int size : sizes)
+    {
+        RunSparseSet<false>(size);
+        RunSparseSet<true>(size);
+    }
+}
@@ -0,0 +1,114 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "benchmarks/common.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "strings/format.h"
+
+// Benchmarks for `Stream::Input` and `Stream::Output`, on memory buffers.
+// Reads and writes the same data one value at a time and in bulk, to see the per-call overhead.
+
+namespace
+{
+    constexpr int num_values = 1'000'000;
+    constexpr int num_words = 100'000;
+
+    void RunOutput()
+    {
+        std::vector<std::uint32_t> values(num_values);
+        for (int i = 0; i < num_values; i++)
+            values[std::size_t(i)] = std::uint32_t(i) * 2654435761u;
+
+        std::vector<std::uint8_t> buffer;
+
+        Bench::Report("stream/output/little_u32", "ns/value", Bench::Measure([&]
+        {
+            buffer.clear();
+            Stream::Output output = Stream::Output::Container(buffer);
+            for (std::uint32_t value : values)
+                output.WriteLittle<std::uint32_t>(value);
+            output.Flush();
+        }), num_values);
+
+        Bench::Report("stream/output/little_u32_bulk", "ns/value", Bench::Measure([&]
+        {
+            buffer.clear();
+            Stream::Output output = Stream::Output::Container(buffer);
+            output.WriteLittle<std::uint32_t>(values.data(), values.size());
+            output.Flush();
+        }), num_values);
+
+        Bench::Report("stream/output/string", "ns/word", Bench::Measure([&]
+        {
+            buffer.clear();
+            Stream::Output output = Stream::Output::Container(buffer);
+            for (int i = 0; i < num_words; i++)
+                output.WriteString("word").WriteChar(' ');
+            output.Flush();
+        }), num_words);
+    }
+
+    void RunInput()
+    {
+        std::vector<std::uint8_t> binary;
+        {
+            Stream::Output output = Stream::Output::Container(binary);
+            for (int i = 0; i < num_values; i++)
+                output.WriteLittle<std::uint32_t>(std::uint32_t(i) * 2654435761u);
+            output.Flush();
+        }
+
+        std::string text;
+        for (int i = 0; i < num_words; i++)
+            text += FMT("word{} ", i);
+
+        std::vector<std::uint32_t> values(num_values);
+
+        Bench::Report("stream/input/little_u32", "ns/value", Bench::Measure([&]
+        {
+            Stream::Input input(Stream::ReadOnlyData::mem_reference(binary));
+            std::uint32_t sum = 0;
+            for (int i = 0; i < num_values; i++)
+                sum += input.ReadLittle<std::uint32_t>();
+            Bench::DoNotOptimize(sum);
+        }), num_values);
+
+        Bench::Report("stream/input/little_u32_bulk", "ns/value", Bench::Measure([&]
+        {
+            Stream::Input input(Stream::ReadOnlyData::mem_reference(binary));
+            input.ReadLittle(values.data(), values.size());
+            Bench::DoNotOptimize(values.data());
+        }), num_values);
+
+        Bench::Report("stream/input/chars", "ns/char", Bench::Measure([&]
+        {
+            Stream::Input input(Stream::ReadOnlyData::mem_reference(text));
+            char sum = 0;
+            for (std::size_t i = 0; i < text.size(); i++)
+                sum += input.ReadChar();
+            Bench::DoNotOptimize(sum);
+        }), double(text.size()));
+
+        Bench::Report("stream/input/extract_words", "ns/word", Bench::Measure([&]
+        {
+            Stream::Input input(Stream::ReadOnlyData::mem_reference(text));
+            std::size_t total_size = 0;
+            for (int i = 0; i < num_words; i++)
+            {
+                total_size += input.Extract(Stream::Char::IsAlphaOrDigit{}).size();
+                input.Discard(' ');
+            }
+            Bench::DoNotOptimize(total_size);
+        }), num_words);
+    }
+}
+
+BENCHMARK("stream")
+{
+    RunOutput();
+    RunInput();
+}
@@ -26,7 +26,7 @@ Interface::Window window(std::string(window_name), screen_size * 2, Interface::w
 static Graphics::DummyVertexArray dummy_vao = nullptr;
 
 Audio::Context audio_context = nullptr;
-Audio::SourceManager audio_controller;
+Audio::SourceManager audio_controller(32);
 
 const Graphics::ShaderConfig shader_config = Graphics::ShaderConfig::Core();
 Interface::ImGuiController gui_controller(Poly::derived<Interface::ImGuiController::GraphicsBackend_Modern>, adjust_(Interface::ImGuiController::Config{}, .shader_header = shader_config.common_header, .store_state_in_file = {}));
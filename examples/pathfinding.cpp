@@ -116,7 +116,7 @@ struct Application : Program::DefaultBasicState
         phmap::flat_hash_set<ivec2> pf_true_visited;
         for (int i = 0; pf.HasUnvisitedNodes() && i < num_iters; i++)
         {
-            pf_true_visited.insert(pf.GetRemainingNodesHeap().front().coord);
+            pf_true_visited.insert(pf.GetRemainingNodes().top().coord);
             if (pf.CurrentNode() == goal)
             {
                 success = true;
@@ -144,9 +144,8 @@ struct Application : Program::DefaultBasicState
         }
 
         phmap::flat_hash_map<ivec2, std::vector<decltype(pf)::estimated_cost_t>> pf_heap;
-        pf_heap.reserve(pf.GetRemainingNodesHeap().size());
-        for (const auto &elem : pf.GetRemainingNodesHeap())
-            pf_heap[elem.coord].push_back(elem.estimated_total_cost);
+        pf_heap.reserve(pf.GetRemainingNodes().size());
+        pf.GetRemainingNodes().ForEachNode([&](const auto &elem){pf_heap[elem.coord].push_back(elem.estimated_total_cost);});
 
         phmap::flat_hash_map<ivec2, int> pf_path;
         if (success)
@@ -160,7 +159,7 @@ struct Application : Program::DefaultBasicState
         ImGui::SameLine();
         ImGui::TextUnformatted(success ? "success" : pf.HasUnvisitedNodes() ? "incomplete" : "fail");
         ImGui::SameLine();
-        ImGui::TextUnformatted(FMT("Remaining nodes in heap: {}", pf.GetRemainingNodesHeap().size()).c_str());
+        ImGui::TextUnformatted(FMT("Remaining nodes in heap: {}", pf.GetRemainingNodes().size()).c_str());
 
         ImGui::Separator();
 
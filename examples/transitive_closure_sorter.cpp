@@ -78,7 +78,14 @@ IMP_MAIN(,)
             if (index_to_char.empty())
                 continue;
 
-            TransitiveClosure::Data data = TransitiveClosure::Compute(index_to_char.size(), [&](std::size_t a, std::size_t b){return pairs.contains({index_to_char[a], index_to_char[b]});});
+            TransitiveClosure::Data data = TransitiveClosure::Compute(index_to_char.size(), [&](std::size_t a, auto &&func)
+            {
+                for (std::size_t b = 0; b < index_to_char.size(); b++)
+                {
+                    if (pairs.contains({index_to_char[a], index_to_char[b]}))
+                        func(b);
+                }
+            });
 
             // std::cout << data.DebugToString() << '\n';
 
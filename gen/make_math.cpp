@@ -7,7 +7,7 @@
 #include <sstream>
 #include <type_traits>
 
-#define VERSION "3.27"
+#define VERSION "3.30"
 
 #pragma GCC diagnostic ignored "-Wpragmas" // Silence GCC warning about the next line disabling a warning that GCC doesn't have.
 #pragma GCC diagnostic ignored "-Wstring-plus-int" // Silence clang warning about `1+R"()"` pattern.
@@ -235,6 +235,26 @@ int main(int argc, char **argv)
             #    define IMP_MATH_SMALL_LAMBDA [[msvc::forceinline]] // There is also `__forceinline`, but it doesn't work on lambdas.
             #  endif
             #endif
+
+            // Define to 1 to use SIMD intrinsics for some `float` operations: `vec4` arithmetic and dot products, `mat4` products and inverse.
+            // Uses SSE on x86, NEON on ARM64, and SIMD128 on WebAssembly (needs `-msimd128`). Does nothing on other targets.
+            // The layout and the API of the types stay the same, but the results can differ from the scalar code in the last bits.
+            #ifndef IMP_MATH_SIMD
+            #  define IMP_MATH_SIMD 0
+            #endif
+
+            #if IMP_MATH_SIMD
+            #  if defined(__wasm_simd128__) // Before SSE, since Emscripten also defines `__SSE__` with `-msse`, but emulates it.
+            #    define IMP_MATH_SIMD_WASM
+            #    include <wasm_simd128.h>
+            #  elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+            #    define IMP_MATH_SIMD_SSE
+            #    include <xmmintrin.h>
+            #  elif defined(__ARM_NEON) && defined(__aarch64__)
+            #    define IMP_MATH_SIMD_NEON
+            #    include <arm_neon.h>
+            #  endif
+            #endif
         )");
         next_line();
     }
@@ -249,7 +269,7 @@ int main(int argc, char **argv)
             output(1+R"(
                 template <typename T> concept cvref_unqualified = std::is_same_v<T, std::remove_cvref_t<T>>;
 
-                // Whether a type is a scalar.
+                // Whether a type is a scalar. Specialize this for custom scalar types, such as fixed-point numbers.
                 template <typename T> struct helper_is_scalar : std::is_arithmetic<T> {}; // Not `std::is_scalar`, because that includes pointers.
                 template <typename T> concept scalar = cvref_unqualified<T> && helper_is_scalar<T>::value;
                 template <typename T> concept scalar_maybe_const = scalar<std::remove_const_t<T>>;
@@ -476,6 +496,9 @@ int main(int argc, char **argv)
                     $   return std::partial_ordering::unordered;
                     else if constexpr (vec_size_v<A> != vec_size_v<B>)
                     $   return std::partial_ordering::unordered;
+                    else if constexpr (std::is_arithmetic_v<vec_base_t<A>> != std::is_arithmetic_v<vec_base_t<B>>)
+                    $   // Custom scalar types are larger than the integral types, and don't mix with the floating-point ones.
+                    $   return integral_vector_or_scalar<A> ? std::partial_ordering::less : integral_vector_or_scalar<B> ? std::partial_ordering::greater : std::partial_ordering::unordered;
                     else if constexpr (floating_point_vector_or_scalar<A> < floating_point_vector_or_scalar<B>)
                     $   return std::partial_ordering::less;
                     else if constexpr (floating_point_vector_or_scalar<A> > floating_point_vector_or_scalar<B>)
@@ -610,6 +633,153 @@ int main(int argc, char **argv)
 
         next_line();
 
+        section("namespace Simd // SIMD helpers", []
+        {
+            output(1+R"(
+                // SIMD implementations of some `float` operations, enabled with `IMP_MATH_SIMD`.
+                // They operate on unaligned arrays, so the vectors and matrices don't need any special alignment. The matrices are column-major, like `mat::as_array()`.
+
+                #if defined(IMP_MATH_SIMD_SSE) || defined(IMP_MATH_SIMD_NEON) || defined(IMP_MATH_SIMD_WASM)
+                inline constexpr bool enabled = true;
+                #else
+                inline constexpr bool enabled = false;
+                #endif
+
+                // Those are only defined if `enabled` is true, and must only be called from `if constexpr (enabled)` branches in templates.
+                IMP_MATH_SMALL_FUNC void add4(const float *a, const float *b, float *out);
+                IMP_MATH_SMALL_FUNC void sub4(const float *a, const float *b, float *out);
+                IMP_MATH_SMALL_FUNC void mul4(const float *a, const float *b, float *out);
+                IMP_MATH_SMALL_FUNC void div4(const float *a, const float *b, float *out);
+                IMP_MATH_SMALL_FUNC float dot4(const float *a, const float *b);
+                IMP_MATH_SMALL_FUNC void mul_mat4_vec4(const float *m, const float *v, float *out);
+                inline void mul_mat4_mat4(const float *a, const float *b, float *out);
+                // Returns false if the matrix is not invertible, without writing to `out`.
+                inline bool inverse_mat4(const float *m, float *out);
+
+                #if defined(IMP_MATH_SIMD_SSE)
+                using f4 = __m128;
+                IMP_MATH_SMALL_FUNC f4 load(const float *p) {return _mm_loadu_ps(p);}
+                IMP_MATH_SMALL_FUNC void store(float *p, f4 v) {_mm_storeu_ps(p, v);}
+                IMP_MATH_SMALL_FUNC f4 splat(float x) {return _mm_set1_ps(x);}
+                IMP_MATH_SMALL_FUNC f4 make(float x, float y, float z, float w) {return _mm_setr_ps(x, y, z, w);}
+                IMP_MATH_SMALL_FUNC f4 add(f4 a, f4 b) {return _mm_add_ps(a, b);}
+                IMP_MATH_SMALL_FUNC f4 sub(f4 a, f4 b) {return _mm_sub_ps(a, b);}
+                IMP_MATH_SMALL_FUNC f4 mul(f4 a, f4 b) {return _mm_mul_ps(a, b);}
+                IMP_MATH_SMALL_FUNC f4 div(f4 a, f4 b) {return _mm_div_ps(a, b);}
+                IMP_MATH_SMALL_FUNC float sum(f4 v) {f4 s = _mm_add_ps(v, _mm_movehl_ps(v, v)); return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));}
+                template <int X, int Y, int Z, int W> IMP_MATH_SMALL_FUNC f4 permute(f4 v) {return _mm_shuffle_ps(v, v, _MM_SHUFFLE(W, Z, Y, X));}
+                IMP_MATH_SMALL_FUNC void transpose(f4 &a, f4 &b, f4 &c, f4 &d) {_MM_TRANSPOSE4_PS(a, b, c, d);}
+                #elif defined(IMP_MATH_SIMD_NEON)
+                using f4 = float32x4_t;
+                IMP_MATH_SMALL_FUNC f4 load(const float *p) {return vld1q_f32(p);}
+                IMP_MATH_SMALL_FUNC void store(float *p, f4 v) {vst1q_f32(p, v);}
+                IMP_MATH_SMALL_FUNC f4 splat(float x) {return vdupq_n_f32(x);}
+                IMP_MATH_SMALL_FUNC f4 make(float x, float y, float z, float w) {const float array[4] = {x, y, z, w}; return vld1q_f32(array);}
+                IMP_MATH_SMALL_FUNC f4 add(f4 a, f4 b) {return vaddq_f32(a, b);}
+                IMP_MATH_SMALL_FUNC f4 sub(f4 a, f4 b) {return vsubq_f32(a, b);}
+                IMP_MATH_SMALL_FUNC f4 mul(f4 a, f4 b) {return vmulq_f32(a, b);}
+                IMP_MATH_SMALL_FUNC f4 div(f4 a, f4 b) {return vdivq_f32(a, b);}
+                IMP_MATH_SMALL_FUNC float sum(f4 v) {return vaddvq_f32(v);}
+                template <int X, int Y, int Z, int W> IMP_MATH_SMALL_FUNC f4 permute(f4 v) {return __builtin_shufflevector(v, v, X, Y, Z, W);}
+                IMP_MATH_SMALL_FUNC void transpose(f4 &a, f4 &b, f4 &c, f4 &d)
+                {
+                    float32x4x2_t ab = vtrnq_f32(a, b), cd = vtrnq_f32(c, d);
+                    a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+                    b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+                    c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+                    d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+                }
+                #elif defined(IMP_MATH_SIMD_WASM)
+                using f4 = v128_t;
+                IMP_MATH_SMALL_FUNC f4 load(const float *p) {return wasm_v128_load(p);}
+                IMP_MATH_SMALL_FUNC void store(float *p, f4 v) {wasm_v128_store(p, v);}
+                IMP_MATH_SMALL_FUNC f4 splat(float x) {return wasm_f32x4_splat(x);}
+                IMP_MATH_SMALL_FUNC f4 make(float x, float y, float z, float w) {return wasm_f32x4_make(x, y, z, w);}
+                IMP_MATH_SMALL_FUNC f4 add(f4 a, f4 b) {return wasm_f32x4_add(a, b);}
+                IMP_MATH_SMALL_FUNC f4 sub(f4 a, f4 b) {return wasm_f32x4_sub(a, b);}
+                IMP_MATH_SMALL_FUNC f4 mul(f4 a, f4 b) {return wasm_f32x4_mul(a, b);}
+                IMP_MATH_SMALL_FUNC f4 div(f4 a, f4 b) {return wasm_f32x4_div(a, b);}
+                IMP_MATH_SMALL_FUNC float sum(f4 v) {return wasm_f32x4_extract_lane(v, 0) + wasm_f32x4_extract_lane(v, 1) + wasm_f32x4_extract_lane(v, 2) + wasm_f32x4_extract_lane(v, 3);}
+                template <int X, int Y, int Z, int W> IMP_MATH_SMALL_FUNC f4 permute(f4 v) {return wasm_i32x4_shuffle(v, v, X, Y, Z, W);}
+                IMP_MATH_SMALL_FUNC void transpose(f4 &a, f4 &b, f4 &c, f4 &d)
+                {
+                    f4 ab_lo = wasm_i32x4_shuffle(a, b, 0, 4, 1, 5), cd_lo = wasm_i32x4_shuffle(c, d, 0, 4, 1, 5);
+                    f4 ab_hi = wasm_i32x4_shuffle(a, b, 2, 6, 3, 7), cd_hi = wasm_i32x4_shuffle(c, d, 2, 6, 3, 7);
+                    a = wasm_i32x4_shuffle(ab_lo, cd_lo, 0, 1, 4, 5);
+                    b = wasm_i32x4_shuffle(ab_lo, cd_lo, 2, 3, 6, 7);
+                    c = wasm_i32x4_shuffle(ab_hi, cd_hi, 0, 1, 4, 5);
+                    d = wasm_i32x4_shuffle(ab_hi, cd_hi, 2, 3, 6, 7);
+                }
+                #endif
+
+                #if defined(IMP_MATH_SIMD_SSE) || defined(IMP_MATH_SIMD_NEON) || defined(IMP_MATH_SIMD_WASM)
+                // The cross product of the first three components. The fourth one is zero, unless the inputs are not finite.
+                IMP_MATH_SMALL_FUNC f4 cross3(f4 a, f4 b) {return sub(mul(permute<1,2,0,3>(a), permute<2,0,1,3>(b)), mul(permute<2,0,1,3>(a), permute<1,2,0,3>(b)));}
+
+                IMP_MATH_SMALL_FUNC void add4(const float *a, const float *b, float *out) {store(out, add(load(a), load(b)));}
+                IMP_MATH_SMALL_FUNC void sub4(const float *a, const float *b, float *out) {store(out, sub(load(a), load(b)));}
+                IMP_MATH_SMALL_FUNC void mul4(const float *a, const float *b, float *out) {store(out, mul(load(a), load(b)));}
+                IMP_MATH_SMALL_FUNC void div4(const float *a, const float *b, float *out) {store(out, div(load(a), load(b)));}
+                IMP_MATH_SMALL_FUNC float dot4(const float *a, const float *b) {return sum(mul(load(a), load(b)));}
+
+                IMP_MATH_SMALL_FUNC void mul_mat4_vec4(const float *m, const float *v, float *out)
+                {
+                    // Same summation order as the scalar code.
+                    f4 ret = mul(load(m), splat(v[0]));
+                    ret = add(ret, mul(load(m + 4), splat(v[1])));
+                    ret = add(ret, mul(load(m + 8), splat(v[2])));
+                    ret = add(ret, mul(load(m + 12), splat(v[3])));
+                    store(out, ret);
+                }
+
+                inline void mul_mat4_mat4(const float *a, const float *b, float *out)
+                {
+                    for (int i = 0; i < 4; i++)
+                    $   mul_mat4_vec4(a, b + i * 4, out + i * 4);
+                }
+
+                inline bool inverse_mat4(const float *m, float *out)
+                {
+                    // From "Foundations of Game Engine Development, Volume 1" by Eric Lengyel.
+                    // The columns `a`,`b`,`c`,`d` are treated as 3D vectors, and `x`,`y`,`z`,`w` is the bottom row.
+                    f4 a = load(m), b = load(m + 4), c = load(m + 8), d = load(m + 12);
+                    float x = m[3], y = m[7], z = m[11], w = m[15];
+
+                    f4 s = cross3(a, b);
+                    f4 t = cross3(c, d);
+                    f4 u = sub(mul(a, splat(y)), mul(b, splat(x)));
+                    f4 v = sub(mul(c, splat(w)), mul(d, splat(z)));
+
+                    // The fourth components of `s` and `t` are zero, so 4D dot products can be used everywhere.
+                    float det = sum(mul(s, v)) + sum(mul(t, u));
+                    if (det == 0)
+                    $   return false;
+                    f4 inv_det = splat(1 / det);
+                    s = mul(s, inv_det);
+                    t = mul(t, inv_det);
+                    u = mul(u, inv_det);
+                    v = mul(v, inv_det);
+
+                    // The rows of the result. Their fourth components are zero, and get replaced after transposing.
+                    f4 r0 = add(cross3(b, v), mul(t, splat(y)));
+                    f4 r1 = sub(cross3(v, a), mul(t, splat(x)));
+                    f4 r2 = add(cross3(d, u), mul(s, splat(w)));
+                    f4 r3 = sub(cross3(u, c), mul(s, splat(z)));
+                    transpose(r0, r1, r2, r3);
+                    r3 = make(-sum(mul(b, t)), sum(mul(a, t)), -sum(mul(d, s)), sum(mul(c, s)));
+
+                    store(out, r0);
+                    store(out + 4, r1);
+                    store(out + 8, r2);
+                    store(out + 12, r3);
+                    return true;
+                }
+                #endif
+            )");
+        });
+
+        next_line();
+
         section("inline namespace Vector // Operators", []
         {
             const std::string
@@ -638,9 +808,18 @@ int main(int argc, char **argv)
 
             for (auto op : ops2)
             {
+                // The operators that have SIMD versions for `vec4<float>`.
+                std::string simd_func = op == "+" ? "add4" : op == "-" ? "sub4" : op == "*" ? "mul4" : op == "/" ? "div4" : "";
+
                 // {vec,scalar} @ {vec,scalar}
-                output("template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator",op,"(const A &a, const B &b)"
-                       " -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() ",op," std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a ",op," b;}, a, b);}\n");
+                // Note `any_vectors_v`, which stops those from being selected for custom scalar types.
+                output("template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator",op,"(const A &a, const B &b)"
+                       " -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() ",op," std::declval<vec_base_t<B>>())> {");
+                if (!simd_func.empty())
+                {
+                    output("if constexpr (Simd::enabled && std::is_same_v<A, vec4<float>> && std::is_same_v<B, vec4<float>>) {if (!std::is_constant_evaluated()) {A ret(uninit{}); Simd::",simd_func,"(a.as_array(), b.as_array(), ret.as_array()); return ret;}} ");
+                }
+                output("return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a ",op," b;}, a, b);}\n");
             }
 
             for (auto op : ops1)
@@ -684,7 +863,7 @@ int main(int argc, char **argv)
 
                 if (!default_mode.empty())
                 {
-                    output("template <",default_concept," A, ",default_concept," B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr ",
+                    output("template <",default_concept," A, ",default_concept," B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr ",
                            default_mode != "elemwise" ? "bool" : "vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool>",
                            " operator",op,"(const A &a, const B &b) {if constexpr (vector<A>) return compare_",default_mode,"(a) ",op," b; else return a ",op," compare_",default_mode,"(b);}\n");
                 }
@@ -790,7 +969,13 @@ int main(int argc, char **argv)
                 {
                     if (w2 == 1 && h1 == 1) // This disables generation of `vec * vec` templates (dot products), which would conflict with member-wise multiplication.
                         continue;
-                    output("template <typename A, typename B> [[nodiscard]] constexpr ",Matrix(w2,h1,"larger_t<A,B>")," operator*(const ",Matrix(w1h2,h1,"A")," &a, const ",Matrix(w2,w1h2,"B")," &b) {return {");
+                    output("template <typename A, typename B> [[nodiscard]] constexpr ",Matrix(w2,h1,"larger_t<A,B>")," operator*(const ",Matrix(w1h2,h1,"A")," &a, const ",Matrix(w2,w1h2,"B")," &b) {");
+                    if (h1 == 4 && w1h2 == 4 && (w2 == 1 || w2 == 4))
+                    {
+                        // `mat4 * vec4` and `mat4 * mat4` have SIMD versions.
+                        output("if constexpr (Simd::enabled && std::is_same_v<A, float> && std::is_same_v<B, float>) {if (!std::is_constant_evaluated()) {",Matrix(w2,h1,"larger_t<A,B>")," ret(uninit{}); Simd::",w2 == 1 ? "mul_mat4_vec4" : "mul_mat4_mat4","(a.as_array(), b.as_array(), ret.as_array()); return ret;}} ");
+                    }
+                    output("return {");
                     for (int y = 0; y < h1; y++)
                     for (int x = 0; x < w2; x++)
                     {
@@ -1903,7 +2088,10 @@ int main(int argc, char **argv)
 
                         { // Dot and cross products
                             // Dot product
-                            output("template <typename U> [[nodiscard]] constexpr auto dot(const vec",w,"<U> &o) const {return ");
+                            output("template <typename U> [[nodiscard]] constexpr auto dot(const vec",w,"<U> &o) const {");
+                            if (w == 4)
+                                output("if constexpr (Simd::enabled && std::is_same_v<type, float> && std::is_same_v<U, float>) {if (!std::is_constant_evaluated()) return Simd::dot4(as_array(), o.as_array());} ");
+                            output("return ");
                             for (int i = 0; i < w; i++)
                             {
                                 if (i != 0)
@@ -2257,6 +2445,17 @@ int main(int argc, char **argv)
                                     output(1+R"(
                                         [[nodiscard]] constexpr mat inverse() const requires is_floating_point
                                         {
+                                            if constexpr (Simd::enabled && std::is_same_v<type, float>)
+                                            {
+                                                if (!std::is_constant_evaluated())
+                                                {
+                                                    mat ret(uninit{});
+                                                    if (!Simd::inverse_mat4(as_array(), ret.as_array()))
+                                                        return {};
+                                                    return ret;
+                                                }
+                                            }
+
                                             mat ret;
 
                                             ret.x.x =  y.y * z.z * w.w - y.y * z.w * w.z - z.y * y.z * w.w + z.y * y.w * w.z + w.y * y.z * z.w - w.y * y.w * z.z;
@@ -2533,12 +2732,38 @@ int main(int argc, char **argv)
 
             template <int D, typename T> struct hash<Math::vec<D,T>>
             {
+                // Multiplies the numbers into 128 bits, and xors the two halves. This is the mixing function from wyhash.
+                [[nodiscard]] static constexpr std::uint64_t mix(std::uint64_t a, std::uint64_t b)
+                {
+                    #ifdef __SIZEOF_INT128__
+                    __extension__ using u128 = unsigned __int128;
+                    u128 r = u128(a) * b;
+                    return std::uint64_t(r) ^ std::uint64_t(r >> 64);
+                    #else
+                    std::uint64_t a_lo = std::uint32_t(a), a_hi = a >> 32, b_lo = std::uint32_t(b), b_hi = b >> 32;
+                    std::uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+                    std::uint64_t cross = (lo_lo >> 32) + std::uint32_t(hi_lo) + lo_hi;
+                    return ((cross << 32) | std::uint32_t(lo_lo)) ^ (hi_hi + (hi_lo >> 32) + (cross >> 32));
+                    #endif
+                }
+
                 std::size_t operator()(const Math::vec<D,T> &v) const
                 {
-                    std::size_t ret = std::hash<decltype(v.x)>{}(v.x);
-                    for (int i = 1; i < D; i++)
-                    $   ret ^= std::hash<decltype(v.x)>{}(v[i]) + std::size_t(0x9E3779B97F4A7C16) + (ret << 6) + (ret >> 2); // Boost uses something similar.
-                    return ret;
+                    if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool> && sizeof(T) * D <= 8)
+                    {
+                        // Small integral vectors (e.g. `ivec2`) are packed into a single 64-bit number, and mixed once.
+                        std::uint64_t packed = 0;
+                        for (int i = 0; i < D; i++)
+                        $   packed |= std::uint64_t(std::make_unsigned_t<T>(v[i])) << (i * sizeof(T) * 8);
+                        return std::size_t(mix(packed ^ 0x2d358dccaa6c78a5, 0x8bb84b93962eacc9));
+                    }
+                    else
+                    {
+                        std::uint64_t ret = 0x4b33a62ed433d4a3;
+                        for (int i = 0; i < D; i++)
+                        $   ret = mix(ret ^ std::hash<T>{}(v[i]), 0x8bb84b93962eacc9);
+                        return std::size_t(ret);
+                    }
                 }
             };
         )");
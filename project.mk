@@ -31,6 +31,25 @@ $(Mode)PROJ_RUNTIME_ENV += LSAN_OPTIONS=suppressions=misc/leak_sanitizer_suppres
 # I previously fixed this error on Fedora, but there the build process of ZLib was broken, using a wrong compiler. That isn't what happens now, though.
 $(Mode)PROJ_RUNTIME_ENV += ASAN_OPTIONS=detect_odr_violation=1
 
+# The multithreaded web build: `release` plus pthreads and WASM SIMD. Emscripten only.
+# Threads need `SharedArrayBuffer`, so the page must be served with `Cross-Origin-Opener-Policy: same-origin` and `Cross-Origin-Embedder-Policy: require-corp`.
+# `-pthread` must be in the global flags, since all libraries have to be built with it too (the libraries are built separately per mode).
+# `-msse2` makes Emscripten translate our SSE2 code paths to WASM SIMD.
+# The workers are spawned in advance (`PTHREAD_POOL_SIZE`), because a new thread can't start until the browser main thread returns to the event loop,
+#   which would deadlock `Jobs::ThreadPool`. The extra ones are for the simulation thread of `PipelinedState` and such.
+# The main loop stays on the browser main thread, which owns the WebGL context. The GL calls from other threads must go through `Jobs::RunOnMainThread()`.
+$(call NewMode,release_web_mt)
+$(Mode)GLOBAL_COMMON_FLAGS := -O3 -pthread -msimd128 -msse2
+$(Mode)GLOBAL_CXXFLAGS := -DNDEBUG
+$(Mode)GLOBAL_LDFLAGS := -s -sPTHREAD_POOL_SIZE=navigator.hardwareConcurrency+2
+$(Mode)PROJ_COMMON_FLAGS := -flto
+$(Mode)PROJ_CXXFLAGS := -DIMP_PLATFORM_FLAG_prod=1 -DIMP_MATH_SIMD=1
+ifeq ($(MODE),release_web_mt)
+ifneq ($(TARGET_OS),emscripten)
+$(error Mode `release_web_mt` is only for Emscripten)
+endif
+endif
+
 DIST_NAME := $(APP)_$(TARGET_OS)_v1.*
 ifneq ($(MODE),release)
 DIST_NAME := $(DIST_NAME)_$(MODE)
@@ -70,6 +89,17 @@ ifeq ($(APP),tests)
 ALLOW_PCH := 0# Force disable PCH for tests, it doesn't make much sense there.
 endif
 
+$(call Project,exe,benchmarks)
+$(call ProjectSetting,source_dirs,src benchmarks)
+$(call ProjectSetting,cxxflags,-DDOCTEST_CONFIG_DISABLE -DIMP_ENTRY_POINT_OVERRIDE=unused_main -DIMP_AUTO_VALIDATE_AABB_TREES=0)
+$(call ProjectSetting,pch,$(_pch_rules))
+$(call ProjectSetting,libs,*)
+$(call ProjectSetting,bad_lib_flags,-Dmain)
+
+# A shorthand for `make run-benchmarks`. Use with `MODE=release`, and pass `ARGS=...` to filter the benchmarks or to save/compare the results, see `benchmarks/common.h`.
+.PHONY: benchmarks
+benchmarks: run-benchmarks
+
 
 # --- Codegen ---
 
@@ -168,9 +198,9 @@ override buildsystem-cglfl = \
 	$(call, ### This directory structure change prevents us from switching GL versions simply by changing the include flags though.)\
 	$(call, ### This isn't a big deal, we just need to rebuild this dep. That is, in addition to all user code, as usual.)\
 	$(call safe_shell_exec,cp -rT $(call quote,$(__source_dir)/include) $(call quote,$(__install_dir)/include))\
-	$(call, ### Popular GL flavors: `gl2.1`, `gl3.2 core`, `gles2.0`)\
+	$(call, ### Popular GL flavors: `gl2.1`, `gl3.2 core`, `gl3.3 core`, `gles2.0`. Instanced rendering needs 3.3 or `gles3.0`.)\
 	$(call, ### Rebuild the library and all user code after switching flavors)\
-	$(call safe_shell_exec,(cd $(call quote,$(__source_dir)) && ./cglfl_generate$(HOST_EXT_exe) gl3.2 core) >>$(call quote,$(__log_path)))\
+	$(call safe_shell_exec,(cd $(call quote,$(__source_dir)) && ./cglfl_generate$(HOST_EXT_exe) gl3.3 core) >>$(call quote,$(__log_path)))\
 	$(call safe_shell_exec,mv $(call quote,$(__source_dir)/include)/*/cglfl_generated $(call quote,$(__install_dir)/include/))\
 	$(call, ### Move the executable away into the build dir)\
 	$(call safe_shell_exec,mv $(call quote,$(__source_dir)/cglfl_generate$(HOST_EXT_exe)) $(call quote,$(__build_dir)))\
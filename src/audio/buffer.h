@@ -4,6 +4,7 @@
 #include <utility>
 
 #include "audio/openal.h"
+#include "audio/stats.h"
 #include "audio/sound.h"
 #include "macros/finally.h"
 #include "program/errors.h"
@@ -83,6 +84,7 @@ namespace Audio
             }
 
             alBufferData(data.handle, format, source, GetBytesPerBlock(resolution, channel_count) * block_count, sampling_rate);
+            Stats::CountAlCalls();
         }
         // Sets the data from memory, in the 8-bit format.
         // Note that the length of the data is measured in blocks. Each block consists of `channel_count` samples, each sample having 8 bits in it.
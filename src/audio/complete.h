@@ -2,10 +2,15 @@
 
 #include "audio/buffer.h"
 #include "audio/context.h"
+#include "audio/emitter_field.h"
 #include "audio/errors.h"
 #include "audio/global_sound_loader.h"
+#include "audio/mixer.h"
+#include "audio/ogg_decoder.h"
 #include "audio/openal.h"
 #include "audio/parameters.h"
 #include "audio/sound.h"
 #include "audio/source_manager.h"
 #include "audio/source.h"
+#include "audio/stats.h"
+#include "audio/streaming_source.h"
@@ -1,12 +1,14 @@
 #pragma once
 
 #include <optional>
+#include <stdexcept>
 #include <tuple>
 #include <utility>
 #include <vector>
 
 #include "audio/openal.h"
 #include "macros/finally.h"
+#include "strings/format.h"
 
 namespace Audio
 {
@@ -157,4 +159,63 @@ namespace Audio
         }
         #endif
     };
+
+    // While this object exists, the changes to the sources and the listener are accumulated, and are then applied all at once when it's destroyed.
+    // This makes a tick's worth of updates atomic, and lets the implementation process them in one go.
+    // Uses `AL_SOFT_deferred_updates` if available, otherwise `alcSuspendContext()` (which does nothing on some implementations).
+    // Can be nested, only the outermost object has an effect.
+    class DeferUpdates
+    {
+        inline static int depth = 0;
+
+        bool active = false;
+
+        [[nodiscard]] static bool HaveDeferredUpdatesExt()
+        {
+            #ifdef AL_SOFT_deferred_updates
+            static const bool ret = alIsExtensionPresent("AL_SOFT_deferred_updates");
+            return ret;
+            #else
+            return false;
+            #endif
+        }
+
+      public:
+        // Does nothing if the context doesn't exist.
+        DeferUpdates()
+        {
+            if (!Context::Exists())
+                return;
+            active = true;
+            if (depth++ > 0)
+                return;
+
+            #ifdef AL_SOFT_deferred_updates
+            if (HaveDeferredUpdatesExt())
+            {
+                alDeferUpdatesSOFT();
+                return;
+            }
+            #endif
+            alcSuspendContext(Context::Get().ContextHandle());
+        }
+
+        DeferUpdates(const DeferUpdates &) = delete;
+        DeferUpdates &operator=(const DeferUpdates &) = delete;
+
+        ~DeferUpdates()
+        {
+            if (!active || --depth > 0 || !Context::Exists())
+                return;
+
+            #ifdef AL_SOFT_deferred_updates
+            if (HaveDeferredUpdatesExt())
+            {
+                alProcessUpdatesSOFT();
+                return;
+            }
+            #endif
+            alcProcessContext(Context::Get().ContextHandle());
+        }
+    };
 }
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "audio/buffer.h"
+#include "audio/source_manager.h"
+#include "program/errors.h"
+#include "utils/aabb_tree.h"
+#include "utils/mat.h"
+
+namespace Audio
+{
+    // Keeps the looping positional sounds (ambience, machinery, and so on) in an AABB tree, keyed by their audible radius.
+    // Each tick, only the emitters whose radius contains the listener are played through the `SourceManager`, the rest are not sent to OpenAL at all.
+    // This keeps the per-tick cost proportional to the amount of emitters near the listener, rather than in the whole level.
+    // The radius should be the distance at which the sound becomes inaudible, e.g. `AL_MAX_DISTANCE` for the linear distance models.
+    // Usage:
+    //     Audio::EmitterField field;
+    //     auto handle = field.Add("waterfall.wav"_sound, pos, 300);
+    //     ...
+    //     field.Tick(source_manager, listener_pos); // Once per tick, before `source_manager.Tick()`.
+    class EmitterField
+    {
+        // The tree nodes store indices into `emitters`, since the nodes are copied around.
+        using Tree = AabbTree<fvec2, std::uint32_t>;
+
+      public:
+        using Handle = Tree::NodeIndex;
+        static constexpr Handle null_handle = Tree::null_index;
+
+      private:
+        struct Emitter
+        {
+            const Buffer *buffer = nullptr;
+            VoiceParams params;
+            float radius = 0;
+            SourceManager::Handle voice; // Null if out of range, or if the manager had no room for it.
+            bool listed = false; // Whether it's in `in_range`.
+            std::uint64_t last_tick = 0; // The last tick where the emitter was in range.
+        };
+
+        Tree tree;
+        std::vector<Emitter> emitters;
+        std::vector<std::uint32_t> free_emitters;
+        std::vector<std::uint32_t> in_range; // The emitters that were in range on the last tick.
+        std::uint64_t tick_counter = 0;
+
+        [[nodiscard]] Emitter &GetEmitter(Handle handle)
+        {
+            return emitters[tree.GetNodeUserData(handle)];
+        }
+
+      public:
+        // `margin` is how far an emitter can move before the tree has to be updated.
+        EmitterField(float margin = 16) : tree(Tree::Params(fvec2(margin))) {}
+
+        // Adds a looping sound at `pos`, audible within `radius`. It starts playing in the next `Tick()`, if the listener is in range.
+        // `params.pos` and `params.loop` are ignored, the emitters are never relative to the listener.
+        // The buffer must remain alive until the emitter is removed.
+        [[nodiscard]] Handle Add(const Buffer &buffer, fvec2 pos, float radius, VoiceParams params = {})
+        {
+            ASSERT(buffer, "Attempt to use a null audio buffer.");
+            ASSERT(radius >= 0, "The audio emitter radius must not be negative.");
+
+            std::uint32_t index;
+            if (free_emitters.empty())
+            {
+                index = std::uint32_t(emitters.size());
+                emitters.emplace_back();
+            }
+            else
+            {
+                index = free_emitters.back();
+                free_emitters.pop_back();
+            }
+
+            Emitter &emitter = emitters[index];
+            emitter = {};
+            emitter.buffer = &buffer;
+            emitter.params = params;
+            emitter.params.pos = pos.to_vec3();
+            emitter.params.relative = false;
+            emitter.params.loop = true;
+            emitter.radius = radius;
+            return tree.AddNode(pos.centered_rect_halfsize(radius), index);
+        }
+
+        // Removes the emitter, stopping its sound.
+        void Remove(SourceManager &manager, Handle handle)
+        {
+            std::uint32_t index = tree.GetNodeUserData(handle);
+            Emitter &emitter = emitters[index];
+            if (emitter.listed)
+            {
+                manager.Stop(emitter.voice);
+                std::erase(in_range, index);
+            }
+            emitter = {};
+            tree.RemoveNode(handle);
+            free_emitters.push_back(index);
+        }
+
+        // Moves the emitter. If it's in range, its sound is updated immediately.
+        void SetPos(SourceManager &manager, Handle handle, fvec2 pos)
+        {
+            Emitter &emitter = GetEmitter(handle);
+            emitter.params.pos = pos.to_vec3();
+            tree.ModifyNode(handle, pos.centered_rect_halfsize(emitter.radius), fvec2());
+            if (emitter.voice)
+                manager.SetPos(emitter.voice, emitter.params.pos);
+        }
+
+        // Starts the emitters that came into range, and stops the ones that went out of range.
+        // Only the emitters near `listener_pos` are visited, and only the ones entering or leaving the range cost AL calls.
+        void Tick(SourceManager &manager, fvec2 listener_pos)
+        {
+            tick_counter++;
+
+            tree.CollidePoint(listener_pos, [&](Handle node)
+            {
+                std::uint32_t index = tree.GetNodeUserData(node);
+                Emitter &emitter = emitters[index];
+                // The tree expands the AABBs, and they are squares anyway, so check the exact distance.
+                if ((emitter.params.pos.to_vec2() - listener_pos).len_sq() > emitter.radius * emitter.radius)
+                    return false;
+
+                emitter.last_tick = tick_counter;
+                if (!emitter.listed)
+                {
+                    emitter.listed = true;
+                    in_range.push_back(index);
+                }
+                // The manager drops the voices if it has too many of them, then we retry on the next tick.
+                if (!manager.IsPlaying(emitter.voice))
+                    emitter.voice = manager.Play(*emitter.buffer, emitter.params);
+                return false;
+            });
+
+            for (std::size_t i = 0; i < in_range.size();)
+            {
+                Emitter &emitter = emitters[in_range[i]];
+                if (emitter.last_tick == tick_counter)
+                {
+                    i++;
+                    continue;
+                }
+                manager.Stop(emitter.voice);
+                emitter.voice = {};
+                emitter.listed = false;
+                in_range[i] = in_range.back();
+                in_range.pop_back();
+            }
+        }
+
+        // Stops all sounds. They start again on the next `Tick()`.
+        void StopAll(SourceManager &manager)
+        {
+            for (std::uint32_t index : in_range)
+            {
+                manager.Stop(emitters[index].voice);
+                emitters[index].voice = {};
+                emitters[index].listed = false;
+            }
+            in_range.clear();
+        }
+
+        // The total amount of emitters.
+        [[nodiscard]] std::size_t EmitterCount() const
+        {
+            return emitters.size() - free_emitters.size();
+        }
+        // The amount of emitters that were in range on the last tick.
+        [[nodiscard]] std::size_t InRangeCount() const
+        {
+            return in_range.size();
+        }
+
+        [[nodiscard]] const Tree &GetTree() const
+        {
+            return tree;
+        }
+    };
+}
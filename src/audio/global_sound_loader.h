@@ -1,16 +1,33 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <map>
+#include <memory>
 #include <optional>
+#include <set>
+#include <string_view>
 #include <string>
+#include <vector>
 
 #include "audio/buffer.h"
 #include "audio/sound.h"
+#include "audio/stats.h"
 #include "meta/common.h"
 #include "meta/const_string.h"
 #include "program/errors.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "stream/save_to_file.h"
+#include "utils/clock.h"
+#include "utils/filesystem.h"
+#include "utils/alloc_tracker.h"
+#include "utils/jobs.h"
+#include "utils/trace.h"
 
 // Provides singletones to conveniently load sounds.
 
@@ -19,6 +36,56 @@ namespace Audio::GlobalData
     template <typename T> concept ChannelsOrNullptr = Meta::same_as_any_of<T, Channels, std::nullptr_t>;
     template <typename T> concept FormatOrNullptr = Meta::same_as_any_of<T, Format, std::nullptr_t>;
 
+    struct LoadParams
+    {
+        // The number of channels and the file format can be overridden by the `Sound()` calls.
+        std::optional<Channels> channels;
+        Format format = wav;
+        // Mandatory, returns the stream to load the sound from. Called from several threads at once.
+        std::function<Stream::Input(const std::string &name, std::optional<Channels> channels, Format format)> get_stream;
+        // Optional. If it returns true, the sound isn't loaded immediately, but on the first `Sound()` call. Use this for the rarely played sounds.
+        std::function<bool(const std::string &name)> is_lazy;
+
+        // Optional. If not empty, the decoded sounds are cached in `<cache_prefix><name>.pcm` files, and loaded from them when the files don't change.
+        // The directories aren't created automatically. The cache files are memory-mapped and uploaded without copying.
+        // Change `cache_version` to invalidate the cache.
+        std::string cache_prefix;
+        std::string cache_version;
+
+        // If not zero, the sounds are resampled to this rate, e.g. to match the device rate.
+        int sampling_rate = 0;
+        // If true, the sounds with the wrong channel count are converted instead of throwing.
+        bool convert_channels = false;
+
+        // The max number of jobs decoding the sounds at once on `Jobs::GlobalPool()`. Zero means the concurrency of the pool.
+        // The buffers are always created on the current thread.
+        int num_threads = 0;
+
+        LoadParams() {}
+
+        // Constructs the minimal viable parameters.
+        LoadParams(std::optional<Channels> channels, Format format, std::string prefix)
+            : channels(channels), format(format), get_stream(LoadFileFromPrefix(std::move(prefix)))
+        {}
+
+        // A default value for `get_stream`, that loads files named `prefix + name + ext`,
+        // where `name` comes from the `Sound()` call, and `ext` is determined from the format (`.wav` or `.ogg`).
+        static decltype(get_stream) LoadFileFromPrefix(std::string prefix)
+        {
+            return [prefix = std::move(prefix)](const std::string &name, std::optional<Channels> channels, Format format) -> Stream::Input
+            {
+                (void)channels;
+                const char *ext = "";
+                switch (format)
+                {
+                    case wav: ext = ".wav"; break;
+                    case ogg: ext = ".ogg"; break;
+                }
+                return prefix + name + ext;
+            };
+        }
+    };
+
     namespace impl
     {
         struct AutoLoadedBuffer
@@ -27,6 +94,8 @@ namespace Audio::GlobalData
             // Those may override the parameters specified when calling `LoadFiles()`.
             std::optional<Channels> channels_override;
             std::optional<Format> format_override;
+            // If not null, the sound was marked as lazy by `Load()`, and will be loaded by this on the first `Sound()` call.
+            std::function<Buffer()> pending_load;
         };
 
         // We rely on `std::map` never invalidating the references.
@@ -41,7 +110,7 @@ namespace Audio::GlobalData
         template <Meta::ConstString Name, ChannelsOrNullptr auto ChannelCount, FormatOrNullptr auto FileFormat>
         struct RegisterBuffer
         {
-            inline static const Buffer &ref = []() -> Buffer &
+            inline static AutoLoadedBuffer &ref = []() -> AutoLoadedBuffer &
             {
                 auto [iter, ok] = GetAutoLoadedBuffers().try_emplace(Name.str);
                 ASSERT(ok, "Attempt to register a duplicate auto-loaded sound file. This shouldn't be possible.");
@@ -49,18 +118,215 @@ namespace Audio::GlobalData
                     iter->second.channels_override = ChannelCount;
                 if constexpr (!std::is_null_pointer_v<decltype(FileFormat)>)
                     iter->second.format_override = FileFormat;
-                return iter->second.buffer; // We rely on `std::map` never invalidating the references.
+                return iter->second; // We rely on `std::map` never invalidating the references.
             }();
         };
+
+        // Calls `func(i)` for each `i` in `[0, count)`, in at most `num_threads` jobs on `Jobs::GlobalPool()`. Zero means the concurrency of the pool.
+        // If anything throws, waits for all jobs to finish, then rethrows the first exception.
+        inline void ParallelFor(std::size_t count, int num_threads, const std::function<void(std::size_t i)> &func)
+        {
+            Jobs::ThreadPool &pool = Jobs::GlobalPool();
+            if (num_threads <= 0)
+                num_threads = pool.Concurrency();
+            num_threads = std::clamp(int(std::min(count, std::size_t(num_threads))), 1, num_threads);
+
+            // The jobs take the sounds one by one, since they can take very different time.
+            std::atomic<std::size_t> next = 0;
+            std::atomic<bool> failed = false;
+            Jobs::ParallelFor(pool, 0, std::size_t(num_threads), [&](std::size_t)
+            {
+                IMP_TRACE_ZONE("Audio::GlobalData::Load (decoding)");
+                IMP_ALLOC_SCOPE("audio");
+                try
+                {
+                    while (!failed.load(std::memory_order_relaxed))
+                    {
+                        std::size_t i = next++;
+                        if (i >= count)
+                            break;
+                        func(i);
+                    }
+                }
+                catch (...)
+                {
+                    failed = true;
+                    throw;
+                }
+            });
+        }
+
+        // The sound cache format: the magic, the format version (`uint32_t`), the key (`uint64_t`), the sampling rate, the channel count,
+        //   the bit resolution (`int32_t`), the block count (`uint64_t`). Then the raw PCM data until the end of file, in the native byte order.
+        // The data isn't compressed, to be uploaded directly from the mapped file.
+        inline constexpr std::string_view sound_cache_magic = "imp.pcms";
+        inline constexpr std::uint32_t sound_cache_version = 1; // Increment when changing the format.
+        inline constexpr std::size_t sound_cache_header_size = sound_cache_magic.size() + 4 + 8 + 4 * 3 + 8;
+
+        // 64-bit FNV-1a. Pass the previous result as `hash` to continue hashing. The hash is stable between runs and platforms.
+        [[nodiscard]] inline std::uint64_t HashBytes(const void *data, std::size_t size, std::uint64_t hash = 0xcbf29ce484222325)
+        {
+            for (std::size_t i = 0; i < size; i++)
+            {
+                hash ^= static_cast<const std::uint8_t *>(data)[i];
+                hash *= 0x100000001b3;
+            }
+            return hash;
+        }
+        [[nodiscard]] inline std::uint64_t HashInt(std::int64_t value, std::uint64_t hash)
+        {
+            std::uint8_t bytes[8];
+            for (int i = 0; i < 8; i++)
+                bytes[i] = std::uint8_t(std::uint64_t(value) >> (i * 8));
+            return HashBytes(bytes, sizeof bytes, hash);
+        }
+
+        // A decoded sound, either in memory or in a mapped cache file.
+        struct DecodedSound
+        {
+            Audio::Sound sound; // If null, the data is in `cache_file`.
+
+            Stream::ReadOnlyData cache_file;
+            int sampling_rate = 0;
+            Channels channel_count = mono;
+            BitResolution resolution = bits_16;
+            std::size_t block_count = 0;
+
+            [[nodiscard]] Buffer MakeBuffer() const
+            {
+                if (sound)
+                    return sound;
+                Buffer ret = nullptr;
+                ret.SetData(sampling_rate, channel_count, resolution, block_count, cache_file.data() + sound_cache_header_size);
+                return ret;
+            }
+        };
+
+        // Maps the cache file, if the key matches. Returns false on a mismatch. Throws if the data is malformed.
+        [[nodiscard]] inline bool LoadSoundCache(const std::string &file_name, std::uint64_t key, DecodedSound &sound)
+        {
+            Stream::ReadOnlyData data = Stream::ReadOnlyData::file_mapped(file_name);
+            Stream::Input input(data);
+            input.WantLocationStyle(Stream::byte_offset);
+
+            if (!input.DiscardChars<Stream::if_present>(sound_cache_magic))
+                throw std::runtime_error(input.GetExceptionPrefix() + "This is not a sound cache.");
+            if (input.ReadLittle<std::uint32_t>() != sound_cache_version || input.ReadLittle<std::uint64_t>() != key)
+                return false;
+
+            sound.sampling_rate = input.ReadLittle<std::int32_t>();
+            std::int32_t channel_count = input.ReadLittle<std::int32_t>();
+            std::int32_t resolution = input.ReadLittle<std::int32_t>();
+            std::uint64_t block_count = input.ReadLittle<std::uint64_t>();
+            if (sound.sampling_rate <= 0 || (channel_count != mono && channel_count != stereo) || (resolution != bits_8 && resolution != bits_16))
+                throw std::runtime_error(input.GetExceptionPrefix() + "Invalid sound parameters.");
+            sound.channel_count = Channels(channel_count);
+            sound.resolution = BitResolution(resolution);
+            std::size_t bytes_per_block = std::size_t(GetBytesPerBlock(sound.resolution, sound.channel_count));
+            if (block_count > input.RemainingBytes() / bytes_per_block || block_count * bytes_per_block != input.RemainingBytes())
+                throw std::runtime_error(input.GetExceptionPrefix() + "Unexpected size of the sound data.");
+            sound.block_count = std::size_t(block_count);
+            sound.cache_file = std::move(data);
+            return true;
+        }
+
+        // Writes a decoded sound to the cache.
+        inline void SaveSoundCache(const std::string &file_name, std::uint64_t key, const Audio::Sound &sound)
+        {
+            std::vector<std::uint8_t> bytes;
+            bytes.reserve(sound_cache_header_size + sound.ByteSize());
+            Stream::Output output = Stream::Output::Container(bytes);
+            output.WriteString(sound_cache_magic.data(), sound_cache_magic.size());
+            output.WriteLittle<std::uint32_t>(sound_cache_version);
+            output.WriteLittle<std::uint64_t>(key);
+            output.WriteLittle<std::int32_t>(sound.SamplingRate());
+            output.WriteLittle<std::int32_t>(sound.ChannelCount());
+            output.WriteLittle<std::int32_t>(sound.Resolution());
+            output.WriteLittle<std::uint64_t>(sound.BlockCount());
+            output.WriteString(reinterpret_cast<const char *>(sound.RawUntypedData()), sound.ByteSize());
+            output.Flush();
+
+            Stream::SaveFileAtomic(file_name, bytes);
+        }
+
+        // Decodes a sound and converts it according to `params`.
+        // Reports the time to `Stats`.
+        [[nodiscard]] inline Audio::Sound DecodeAndConvertSound(const std::string &name, Stream::Input input, std::optional<Channels> channels, Format format, const LoadParams &params)
+        {
+            std::uint64_t start = Clock::Time();
+            Audio::Sound ret(format, params.convert_channels ? std::nullopt : channels, std::move(input));
+            if (channels && ret.ChannelCount() != *channels)
+                ret = ret.WithChannelCount(*channels);
+            if (params.sampling_rate > 0 && ret.SamplingRate() != params.sampling_rate)
+                ret = ret.Resampled(params.sampling_rate);
+            Stats::RecordDecode(name, Clock::TicksToSeconds(Clock::Time() - start), ret.ByteSize());
+            return ret;
+        }
+
+        // Decodes a sound, or loads it from the cache if `params.cache_prefix` isn't empty. Updates the cache if needed.
+        [[nodiscard]] inline DecodedSound DecodeSound(const std::string &name, std::optional<Channels> channels, Format format, const LoadParams &params)
+        {
+            Stream::Input input = params.get_stream(name, channels, format);
+
+            DecodedSound ret;
+            if (params.cache_prefix.empty())
+            {
+                ret.sound = DecodeAndConvertSound(name, std::move(input), channels, format, params);
+                return ret;
+            }
+
+            // Hashing the file is still much cheaper than decoding it.
+            Stream::ReadOnlyData file_data = input.CacheToMemory();
+            std::uint64_t key = HashBytes(params.cache_version.data(), params.cache_version.size());
+            key = HashInt(channels ? int(*channels) : 0, key);
+            key = HashInt(format, key);
+            key = HashInt(params.sampling_rate, key);
+            key = HashInt(params.convert_channels, key);
+            key = HashBytes(file_data.data(), file_data.size(), key);
+
+            std::string file_name = params.cache_prefix + name + ".pcm";
+            bool cache_exists = false;
+            (void)Filesystem::GetObjectInfo(file_name, &cache_exists);
+            if (cache_exists)
+            {
+                try
+                {
+                    if (LoadSoundCache(file_name, key, ret))
+                        return ret;
+                }
+                catch (...)
+                {
+                    // The cache is broken, decode the sound again.
+                }
+            }
+
+            ret.sound = DecodeAndConvertSound(name, std::move(input), channels, format, params);
+            try
+            {
+                SaveSoundCache(file_name, key, ret.sound);
+            }
+            catch (...)
+            {
+                // Failing to write the cache isn't fatal, we'll just decode the sound next time.
+            }
+            return ret;
+        }
     }
 
     // Returns a reference to a buffer, loaded from the filename passed as the parameter.
     // The load doesn't happen at the call point, and is done by `LoadFiles()`, which magically knows all files that it needs to load in this manner.
     // The returned reference is stable across reloads.
+    // If `Load()` marked the sound as lazy, it's loaded by the first call to this function instead.
     template <Meta::ConstString Name, ChannelsOrNullptr auto ChannelCount = nullptr, FormatOrNullptr auto FileFormat = nullptr>
     [[nodiscard]] const Buffer &Sound()
     {
-        return impl::RegisterBuffer<Name, ChannelCount, FileFormat>::ref;
+        impl::AutoLoadedBuffer &data = impl::RegisterBuffer<Name, ChannelCount, FileFormat>::ref;
+        if (data.pending_load) [[unlikely]]
+        {
+            data.buffer = data.pending_load();
+            data.pending_load = nullptr;
+        }
+        return data.buffer;
     }
 
     // Same as `Sound()`, but without the optional parameters.
@@ -70,34 +336,95 @@ namespace Audio::GlobalData
         return Sound<Name>();
     }
 
-    // Loads (or reloads) all files requested with `Audio::GlobalData::Sound()`. Consider using the simplified overload, defined below.
-    // The number of channels and the file format can be overridden by the `Sound()` calls.
-    // `get_stream` is called repeatedly for all needed files.
-    inline void Load(std::optional<Channels> channels, Format format, std::function<Stream::Input(const std::string &name, std::optional<Channels> channels, Format format)> get_stream)
+    namespace impl
     {
-        for (auto &[name, data] : impl::GetAutoLoadedBuffers())
+        // Loads the sounds for which `filter(name)` returns true, or all of them if `filter` is null.
+        inline void LoadMatching(const LoadParams &params, const std::function<bool(const std::string &name)> &filter)
         {
-            std::optional<Channels> file_channels = data.channels_override ? data.channels_override : channels;
-            Format file_format = data.format_override.value_or(format);
-            data.buffer = Audio::Sound(file_format, file_channels, get_stream(name, file_channels, file_format));
+            ASSERT(params.get_stream, "`get_stream` is mandatory.");
+
+            struct Entry
+            {
+                const std::string *name = nullptr;
+                AutoLoadedBuffer *data = nullptr;
+                std::optional<Channels> channels;
+                Format format{};
+                DecodedSound sound = {}; // Filled by the worker threads.
+            };
+            std::vector<Entry> entries;
+            std::shared_ptr<const LoadParams> shared_params; // For the lazy sounds.
+
+            for (auto &[name, data] : GetAutoLoadedBuffers())
+            {
+                if (filter && !filter(name))
+                    continue;
+
+                std::optional<Channels> file_channels = data.channels_override ? data.channels_override : params.channels;
+                Format file_format = data.format_override.value_or(params.format);
+
+                if (params.is_lazy && params.is_lazy(name))
+                {
+                    // The old buffer (if any) stays until the first `Sound()` call.
+                    if (!shared_params)
+                        shared_params = std::make_shared<const LoadParams>(params);
+                    data.pending_load = [&name, shared_params, file_channels, file_format]
+                    {
+                        return DecodeSound(name, file_channels, file_format, *shared_params).MakeBuffer();
+                    };
+                    continue;
+                }
+
+                data.pending_load = nullptr;
+                entries.push_back({.name = &name, .data = &data, .channels = file_channels, .format = file_format});
+            }
+
+            ParallelFor(entries.size(), params.num_threads, [&](std::size_t i)
+            {
+                Entry &entry = entries[i];
+                entry.sound = DecodeSound(*entry.name, entry.channels, entry.format, params);
+            });
+
+            for (Entry &entry : entries)
+            {
+                entry.data->buffer = entry.sound.MakeBuffer();
+                entry.sound = {}; // Free the memory early.
+            }
         }
     }
 
+    // Loads (or reloads) all files requested with `Audio::GlobalData::Sound()`.
+    // The files are decoded in parallel (or loaded from the cache), then uploaded to the buffers on this thread.
+    inline void Load(const LoadParams &params)
+    {
+        IMP_TRACE_ZONE("Audio::GlobalData::Load");
+        IMP_ALLOC_SCOPE("audio");
+        impl::LoadMatching(params, nullptr);
+    }
+
+    // Same, but with the minimal viable parameters.
+    inline void Load(std::optional<Channels> channels, Format format, std::function<Stream::Input(const std::string &name, std::optional<Channels> channels, Format format)> get_stream)
+    {
+        LoadParams params;
+        params.channels = channels;
+        params.format = format;
+        params.get_stream = std::move(get_stream);
+        Load(params);
+    }
+
     // Same, but the sounds are loaded from files named `prefix + name + ext`,
     // where `name` comes from the `Sound()` call, and `ext` is determined from the format (`.wav` or `.ogg`).
     inline void Load(std::optional<Channels> channels, Format format, const std::string &prefix)
     {
-        Load(channels, format, [&prefix](const std::string &name, std::optional<Channels> channels, Format format) -> Stream::Input
-        {
-            (void)channels;
-            const char *ext = "";
-            switch (format)
-            {
-                case wav: ext = ".wav"; break;
-                case ogg: ext = ".ogg"; break;
-            }
-            return prefix + name + ext;
-        });
+        Load(LoadParams(channels, format, prefix));
+    }
+
+    // Reloads only the specified sounds, e.g. the ones reported by `Filesystem::Watcher`. Use this for hot reloading.
+    // The `names` are the ones passed to `Sound()`, the unknown names are ignored.
+    inline void Reload(const LoadParams &params, const std::vector<std::string> &names)
+    {
+        IMP_TRACE_ZONE("Audio::GlobalData::Reload");
+        std::set<std::string_view> name_set(names.begin(), names.end());
+        impl::LoadMatching(params, [&](const std::string &name){return name_set.contains(name);});
     }
 }
 
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "audio/context.h"
+#include "audio/openal.h"
+#include "audio/source.h"
+#include "audio/stats.h"
+#include "program/errors.h"
+
+namespace Audio
+{
+    struct MixerParams
+    {
+        int bus_count = 4;
+        // How often the mixer thread applies the changes. The ramps advance in steps of this length.
+        std::chrono::duration<float> update_interval = std::chrono::milliseconds(10);
+    };
+
+    // Groups the sources into buses, each with its own volume and low-pass filter, e.g. to duck the music or muffle the effects in a pause menu.
+    // The changes can be ramped smoothly. The ramps and the per-source updates run on a separate thread,
+    //   the methods only push commands into a lock-free queue, so they are cheap to call every tick.
+    // The mixing itself is still done by OpenAL: each bus drives an EFX low-pass filter attached to its sources,
+    //   so this doesn't conflict with `Source::volume()`, and the final volume is the product of both.
+    // If the EFX extension is missing, all operations are no-ops (check `IsSupported()`).
+    // The methods must be called from a single thread.
+    // Detach the sources before destroying them, otherwise the mixer thread may touch a dead handle.
+    // Usage:
+    //     Audio::Mixer mixer(adjust_(Audio::MixerParams{}, .bus_count = 2));
+    //     mixer.Attach(music, 1);
+    //     mixer.SetVolume(1, 0.3f, 0.5f); // Duck the music over half a second.
+    class Mixer
+    {
+        enum class CommandType
+        {
+            attach,
+            detach,
+            set_volume,
+            set_low_pass,
+        };
+
+        struct Command
+        {
+            CommandType type{};
+            int bus = 0;
+            ALuint source = 0;
+            float value = 0;
+            float ramp_seconds = 0;
+        };
+
+        // A single-producer single-consumer queue.
+        class CommandQueue
+        {
+            static constexpr std::size_t capacity = 1024;
+            std::array<Command, capacity> commands;
+            std::atomic<std::size_t> head = 0; // Written by the consumer.
+            std::atomic<std::size_t> tail = 0; // Written by the producer.
+
+          public:
+            // Returns false if the queue is full.
+            [[nodiscard]] bool Push(const Command &command)
+            {
+                std::size_t t = tail.load(std::memory_order_relaxed);
+                if (t - head.load(std::memory_order_acquire) == capacity)
+                    return false;
+                commands[t % capacity] = command;
+                tail.store(t + 1, std::memory_order_release);
+                return true;
+            }
+
+            // Returns false if the queue is empty.
+            [[nodiscard]] bool Pop(Command &command)
+            {
+                std::size_t h = head.load(std::memory_order_relaxed);
+                if (h == tail.load(std::memory_order_acquire))
+                    return false;
+                command = commands[h % capacity];
+                head.store(h + 1, std::memory_order_release);
+                return true;
+            }
+        };
+
+        struct Ramp
+        {
+            float current = 1;
+            float target = 1;
+            float step = 0; // Per update, always positive.
+
+            void Set(float new_target, float ramp_seconds, float update_interval)
+            {
+                target = new_target;
+                if (ramp_seconds <= 0)
+                    current = target;
+                else
+                    step = std::abs(target - current) * update_interval / ramp_seconds;
+            }
+
+            // Returns true if the value has changed.
+            bool Advance()
+            {
+                if (current == target)
+                    return false;
+                if (current < target)
+                    current = std::min(current + step, target);
+                else
+                    current = std::max(current - step, target);
+                return true;
+            }
+        };
+
+        struct Bus
+        {
+            ALuint filter = 0;
+            Ramp volume;
+            Ramp low_pass; // The gain of the high frequencies.
+            std::vector<ALuint> sources;
+        };
+
+        struct State
+        {
+            std::mutex mutex; // Only for the condition variable, the commands don't need it.
+            std::condition_variable_any cv;
+
+            CommandQueue queue;
+            std::chrono::duration<float> update_interval{};
+
+            std::vector<Bus> buses; // Only used by the mixer thread, after the construction.
+
+            State() {}
+            State(const State &) = delete;
+            State &operator=(const State &) = delete;
+
+            ~State()
+            {
+                #ifdef AL_FILTER_LOWPASS
+                for (Bus &bus : buses)
+                {
+                    for (ALuint source : bus.sources)
+                    {
+                        if (alIsSource(source))
+                            alSourcei(source, AL_DIRECT_FILTER, AL_FILTER_NULL);
+                    }
+                    if (bus.filter)
+                        alDeleteFilters(1, &bus.filter);
+                }
+                #endif
+            }
+
+            // Applies the filter of the bus to its sources.
+            static void UpdateSources(Bus &bus, const std::vector<ALuint> &sources)
+            {
+                #ifdef AL_FILTER_LOWPASS
+                alFilterf(bus.filter, AL_LOWPASS_GAIN, bus.volume.current);
+                alFilterf(bus.filter, AL_LOWPASS_GAINHF, bus.low_pass.current);
+                for (ALuint source : sources)
+                {
+                    if (alIsSource(source))
+                        alSourcei(source, AL_DIRECT_FILTER, ALint(bus.filter));
+                }
+                Stats::CountAlCalls(2 + sources.size() * 2);
+                #else
+                (void)bus;
+                (void)sources;
+                #endif
+            }
+
+            void Update()
+            {
+                std::vector<bool> dirty(buses.size());
+
+                Command command;
+                while (queue.Pop(command))
+                {
+                    float interval = update_interval.count();
+                    switch (command.type)
+                    {
+                      case CommandType::attach:
+                        for (Bus &bus : buses)
+                            std::erase(bus.sources, command.source);
+                        buses[std::size_t(command.bus)].sources.push_back(command.source);
+                        UpdateSources(buses[std::size_t(command.bus)], {command.source});
+                        break;
+                      case CommandType::detach:
+                        for (Bus &bus : buses)
+                            std::erase(bus.sources, command.source);
+                        #ifdef AL_FILTER_LOWPASS
+                        if (alIsSource(command.source))
+                            alSourcei(command.source, AL_DIRECT_FILTER, AL_FILTER_NULL);
+                        #endif
+                        break;
+                      case CommandType::set_volume:
+                        buses[std::size_t(command.bus)].volume.Set(command.value, command.ramp_seconds, interval);
+                        dirty[std::size_t(command.bus)] = true;
+                        break;
+                      case CommandType::set_low_pass:
+                        buses[std::size_t(command.bus)].low_pass.Set(command.value, command.ramp_seconds, interval);
+                        dirty[std::size_t(command.bus)] = true;
+                        break;
+                    }
+                }
+
+                for (std::size_t i = 0; i < buses.size(); i++)
+                {
+                    Bus &bus = buses[i];
+                    bool changed = bus.volume.Advance();
+                    changed = bus.low_pass.Advance() || changed;
+                    if (changed || dirty[i])
+                        UpdateSources(bus, bus.sources);
+                }
+            }
+        };
+
+        std::unique_ptr<State> state;
+        std::jthread worker; // Must be after `state`, to be destroyed first.
+
+        static void WorkerLoop(std::stop_token stop, State &state)
+        {
+            std::unique_lock lock(state.mutex);
+            while (!stop.stop_requested())
+            {
+                state.Update();
+                state.cv.wait_for(lock, stop, state.update_interval, []{return false;});
+            }
+        }
+
+        void Push(const Command &command)
+        {
+            if (!state)
+                return;
+            ASSERT(command.bus >= 0 && std::size_t(command.bus) < state->buses.size(), "Audio bus index is out of range.");
+            while (!state->queue.Push(command))
+                std::this_thread::yield(); // The queue is full, wait for the mixer thread to catch up.
+        }
+
+      public:
+        // Creates a null mixer.
+        Mixer() {}
+
+        // Creates the buses and starts the mixer thread. If the EFX extension is missing, creates a null mixer.
+        explicit Mixer(MixerParams params)
+        {
+            ASSERT(params.bus_count > 0 && params.update_interval.count() > 0, "Invalid mixer parameters.");
+
+            #ifdef AL_FILTER_LOWPASS
+            if (!alcIsExtensionPresent(Context::Get().DeviceHandle(), "ALC_EXT_EFX"))
+                return;
+
+            state = std::make_unique<State>();
+            state->update_interval = params.update_interval;
+            state->buses.resize(std::size_t(params.bus_count));
+            for (Bus &bus : state->buses)
+            {
+                alGenFilters(1, &bus.filter);
+                if (!bus.filter)
+                    throw std::runtime_error("Unable to create an audio filter.");
+                alFilteri(bus.filter, AL_FILTER_TYPE, AL_FILTER_LOWPASS);
+            }
+
+            worker = std::jthread([state = state.get()](std::stop_token stop){WorkerLoop(std::move(stop), *state);});
+            #endif
+        }
+
+        Mixer(Mixer &&) = default;
+        Mixer &operator=(Mixer other) noexcept
+        {
+            std::swap(state, other.state);
+            std::swap(worker, other.worker);
+            return *this;
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(state);
+        }
+
+        // Returns false if this is a null mixer, e.g. because the EFX extension is missing.
+        [[nodiscard]] bool IsSupported() const
+        {
+            return bool(*this);
+        }
+
+        [[nodiscard]] int BusCount() const
+        {
+            return state ? int(state->buses.size()) : 0;
+        }
+
+        // Moves the source to a bus. A source can be on at most one bus.
+        void Attach(const Source &source, int bus)
+        {
+            if (source)
+                Push({.type = CommandType::attach, .bus = bus, .source = source.Handle()});
+        }
+        // Removes the source from its bus, if any.
+        void Detach(const Source &source)
+        {
+            if (source)
+                Push({.type = CommandType::detach, .source = source.Handle()});
+        }
+
+        // Sets the bus volume, reaching it in `ramp_seconds`. The range is 0..1, defaults to 1.
+        void SetVolume(int bus, float volume, float ramp_seconds = 0)
+        {
+            Push({.type = CommandType::set_volume, .bus = bus, .value = std::clamp(volume, 0.f, 1.f), .ramp_seconds = ramp_seconds});
+        }
+        // Sets the bus low-pass filter, reaching it in `ramp_seconds`. `gain_hf` is the volume of the high frequencies, 0..1. Defaults to 1 (no filtering).
+        void SetLowPass(int bus, float gain_hf, float ramp_seconds = 0)
+        {
+            Push({.type = CommandType::set_low_pass, .bus = bus, .value = std::clamp(gain_hf, 0.f, 1.f), .ramp_seconds = ramp_seconds});
+        }
+    };
+}
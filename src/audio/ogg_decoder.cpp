@@ -0,0 +1,280 @@
+#include "ogg_decoder.h"
+
+#include <utility>
+
+#include <vorbis/vorbisfile.h>
+
+#include "strings/format.h"
+#include "utils/robust_math.h"
+
+namespace Audio
+{
+    struct OggDecoder::State
+    {
+        Stream::Input input; // The callbacks point to this, so the state must not move.
+        std::string target;
+        OggVorbis_File file_handle;
+        bool file_handle_open = false;
+
+        int sampling_rate = 0;
+        Channels channel_count = mono;
+        BitResolution resolution = bits_16;
+        std::size_t total_block_count = 0;
+
+        // An index of the current bitstream (basically a section) of the file.
+        // When it changes, the amount of channels and/or sample rate can also change; if it happens, we throw an exception.
+        int old_bitstream_index = -1;
+
+        State(Stream::Input &&input) : input(std::move(input)), target(this->input.GetTarget()) {}
+
+        State(const State &) = delete;
+        State &operator=(const State &) = delete;
+
+        ~State()
+        {
+            if (file_handle_open)
+                ov_clear(&file_handle);
+        }
+    };
+
+    OggDecoder::OggDecoder() {}
+
+    OggDecoder::OggDecoder(Stream::Input input, BitResolution resolution) : state(std::make_unique<State>(std::move(input)))
+    {
+        try
+        {
+            // Stream exceptions aren't supposed to escape the callbacks anyway,
+            // might as well make constructing them as cheap as possible.
+            state->input.WantExceptionPrefixStyle(Stream::no_prefix);
+
+            // Construct callbacks.
+            ov_callbacks callbacks;
+            callbacks.close_func = nullptr;
+            callbacks.tell_func = [](void *stream_ptr) -> long
+            {
+                try
+                {
+                    long ret;
+                    if (Robust::conversion_fails(static_cast<Stream::Input *>(stream_ptr)->Position(), ret))
+                        return -1;
+                    return ret;
+                }
+                catch (...)
+                {
+                    return -1;
+                }
+            };
+            callbacks.seek_func = [](void *stream_ptr, std::int64_t offset, int mode) -> int
+            {
+                try
+                {
+                    std::ptrdiff_t converted_offset;
+                    if (Robust::conversion_fails(offset, converted_offset))
+                        return -1;
+
+                    Stream::SeekMode converted_mode;
+                    switch (mode)
+                    {
+                      case SEEK_SET:
+                        converted_mode = Stream::absolute;
+                        break;
+                      case SEEK_CUR:
+                        converted_mode = Stream::relative;
+                        break;
+                      case SEEK_END:
+                        converted_mode = Stream::end;
+                        break;
+                      default:
+                        return -1;
+                    }
+
+                    static_cast<Stream::Input *>(stream_ptr)->Seek(converted_offset, converted_mode);
+                    return 0;
+                }
+                catch (...)
+                {
+                    return -1;
+                }
+            };
+            callbacks.read_func = [](void *buffer, std::size_t elem_size, std::size_t elem_count, void *stream_ptr) -> std::size_t
+            {
+                try
+                {
+                    if (elem_size == 0 || elem_count == 0)
+                        return 0;
+
+                    auto &stream = *static_cast<Stream::Input *>(stream_ptr);
+
+                    std::size_t total_size;
+                    bool enough_data = true;
+
+                    // If the read size is larger than the remaining amount of bytes
+                    // OR if the calculation of `total_size` overflowed, clamp the read size.
+                    if ((Robust::value(elem_size) * Robust::value(elem_count) >>= total_size) || total_size > stream.RemainingBytes())
+                    {
+                        total_size = stream.RemainingBytes();
+                        enough_data = false;
+                    }
+
+                    stream.Read(static_cast<char *>(buffer), total_size);
+
+                    if (enough_data)
+                        return elem_count;
+                    else
+                        return total_size / elem_size;
+                }
+                catch (...)
+                {
+                    return -1;
+                }
+            };
+
+            // Open a file with those callbacks.
+            switch (ov_open_callbacks(&state->input, &state->file_handle, nullptr, 0, callbacks))
+            {
+              case 0:
+                break;
+              case OV_EREAD:
+                throw std::runtime_error("Unable to read data from the stream.");
+                break;
+              case OV_ENOTVORBIS:
+                throw std::runtime_error("This is not a vorbis sound.");
+                break;
+              case OV_EVERSION:
+                throw std::runtime_error("Vorbis version mismatch.");
+                break;
+              case OV_EBADHEADER:
+                throw std::runtime_error("Invalid header.");
+                break;
+              case OV_EFAULT:
+                throw std::runtime_error("Internal vorbis error.");
+                break;
+              default:
+                throw std::runtime_error("Unknown vorbis error.");
+                break;
+            }
+            state->file_handle_open = true;
+
+
+            // Get some info about the file. No cleanup appears to be necessary.
+            vorbis_info *info = ov_info(&state->file_handle, -1);
+            if (!info)
+                throw std::runtime_error("Unable to get information about the file.");
+
+            // Get channel count.
+            if (info->channels != 1 && info->channels != 2)
+                throw std::runtime_error("The file has too many channels. Only mono and stereo are supported.");
+            state->channel_count = Channels(info->channels);
+
+            // Get frequency.
+            if (Robust::conversion_fails(info->rate, state->sampling_rate))
+                throw std::runtime_error("The sample rate is too high.");
+
+            // Get the block count.
+            auto total_block_count = ov_pcm_total(&state->file_handle, -1);
+            if (total_block_count == OV_EINVAL)
+                throw std::runtime_error("Unable to determine the file length.");
+            if (Robust::conversion_fails(total_block_count, state->total_block_count))
+                throw std::runtime_error("The file is too long.");
+
+            state->resolution = resolution;
+        }
+        catch (std::exception &e)
+        {
+            throw std::runtime_error(FMT("While reading a vorbis sound from `{}`:\n{}", state->target, e.what()));
+        }
+    }
+
+    OggDecoder::OggDecoder(OggDecoder &&other) noexcept : state(std::move(other.state)) {}
+    OggDecoder &OggDecoder::operator=(OggDecoder other) noexcept
+    {
+        std::swap(state, other.state);
+        return *this;
+    }
+    OggDecoder::~OggDecoder() = default;
+
+    const std::string &OggDecoder::Target() const
+    {
+        ASSERT(*this, "Attempt to use a null ogg decoder.");
+        return state->target;
+    }
+
+    int OggDecoder::SamplingRate() const
+    {
+        ASSERT(*this, "Attempt to use a null ogg decoder.");
+        return state->sampling_rate;
+    }
+    Channels OggDecoder::ChannelCount() const
+    {
+        ASSERT(*this, "Attempt to use a null ogg decoder.");
+        return state->channel_count;
+    }
+    BitResolution OggDecoder::Resolution() const
+    {
+        ASSERT(*this, "Attempt to use a null ogg decoder.");
+        return state->resolution;
+    }
+
+    std::size_t OggDecoder::TotalBlockCount() const
+    {
+        ASSERT(*this, "Attempt to use a null ogg decoder.");
+        return state->total_block_count;
+    }
+
+    std::size_t OggDecoder::Read(std::uint8_t *buffer, std::size_t max_bytes)
+    {
+        ASSERT(*this, "Attempt to use a null ogg decoder.");
+
+        // `ov_read()` takes an `int`.
+        int clamped_max_bytes = max_bytes > 0x7fffffff ? 0x7fffffff : int(max_bytes);
+        clamped_max_bytes -= clamped_max_bytes % BytesPerBlock();
+        if (clamped_max_bytes == 0)
+            return 0;
+
+        try
+        {
+            int bitstream_index;
+            long segment_size = ov_read(&state->file_handle, reinterpret_cast<char *>(buffer), clamped_max_bytes, 0/*little endian*/,
+                GetBytesPerSample(state->resolution), state->resolution == bits_16/*true means numbers are signed*/, &bitstream_index);
+
+            switch (segment_size)
+            {
+              case OV_HOLE:
+                throw std::runtime_error("The file is corrupted.");
+                break;
+              case OV_EBADLINK:
+                throw std::runtime_error("Bad link.");
+                break;
+              case OV_EINVAL:
+                throw std::runtime_error("Invalid header.");
+                break;
+            }
+
+            if (segment_size > 0 && bitstream_index != state->old_bitstream_index)
+            {
+                state->old_bitstream_index = bitstream_index;
+
+                vorbis_info *info = ov_info(&state->file_handle, -1); // `-1` means the current bitstream, we could also use `bitstream_index` here.
+                if (!info)
+                    throw std::runtime_error("Unable to get information about a section of the file.");
+                if (Robust::not_equal(info->channels, int(state->channel_count)))
+                    throw std::runtime_error("Channel count has changed in the middle of the file.");
+                if (Robust::not_equal(info->rate, state->sampling_rate))
+                    throw std::runtime_error("Sampling rate has changed in the middle of the file.");
+            }
+
+            return std::size_t(segment_size);
+        }
+        catch (std::exception &e)
+        {
+            throw std::runtime_error(FMT("While reading a vorbis sound from `{}`:\n{}", state->target, e.what()));
+        }
+    }
+
+    void OggDecoder::Rewind()
+    {
+        ASSERT(*this, "Attempt to use a null ogg decoder.");
+        if (ov_pcm_seek(&state->file_handle, 0) != 0)
+            throw std::runtime_error(FMT("While reading a vorbis sound from `{}`:\nUnable to seek to the beginning.", state->target));
+    }
+}
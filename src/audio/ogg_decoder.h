@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "audio/sound.h"
+#include "stream/input.h"
+
+namespace Audio
+{
+    // Decodes an ogg vorbis stream incrementally. Used by `Sound` to load the whole file, and by `StreamingSource` to play it piece by piece.
+    class OggDecoder
+    {
+        struct State;
+        std::unique_ptr<State> state;
+
+      public:
+        // Construct a null decoder.
+        OggDecoder();
+
+        // Reads the header. Throws on failure.
+        // `resolution` is the resolution of the decoded data, it doesn't depend on the file.
+        OggDecoder(Stream::Input input, BitResolution resolution = bits_16);
+
+        OggDecoder(OggDecoder &&other) noexcept;
+        OggDecoder &operator=(OggDecoder other) noexcept;
+        ~OggDecoder();
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(state);
+        }
+
+        // The name of the underlying stream, for the error messages.
+        [[nodiscard]] const std::string &Target() const;
+
+        [[nodiscard]] int SamplingRate() const;
+        [[nodiscard]] Channels ChannelCount() const;
+        [[nodiscard]] BitResolution Resolution() const;
+        [[nodiscard]] int BytesPerBlock() const
+        {
+            return GetBytesPerBlock(Resolution(), ChannelCount());
+        }
+
+        // The length of the whole stream, in blocks.
+        [[nodiscard]] std::size_t TotalBlockCount() const;
+
+        // Decodes up to `max_bytes` into `buffer`, returns the amount of bytes written, which is always a multiple of `BytesPerBlock()`.
+        // Returns 0 at the end of the stream. Throws on failure.
+        // This can return less than requested even before the end, call it in a loop to fill the buffer.
+        [[nodiscard]] std::size_t Read(std::uint8_t *buffer, std::size_t max_bytes);
+
+        // Seeks to the beginning of the stream. Throws on failure.
+        void Rewind();
+    };
+}
@@ -7,3 +7,6 @@
 #  define AL_ALEXT_PROTOTYPES
 #  include "alext.h"
 #endif
+#if __has_include("efx.h")
+#  include "efx.h"
+#endif
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+
 #include "audio/openal.h"
 #include "utils/mat.h"
 
@@ -110,5 +113,34 @@ namespace Audio
             }
             alDistanceModel(model_enum);
         }
+
+        // Computes the gain (the volume factor) at `dist` according to `model`, which is one of `AL_..._DISTANCE[_CLAMPED]` or `AL_NONE`.
+        // Follows the formulas from the spec, see `Model` above. Used to estimate the audibility of a sound without playing it.
+        [[nodiscard]] inline float ComputeDistanceGain(float dist, float ref_dist, float rolloff_fac, float max_dist, ALenum model = alGetInteger(AL_DISTANCE_MODEL))
+        {
+            if (model == AL_INVERSE_DISTANCE_CLAMPED || model == AL_LINEAR_DISTANCE_CLAMPED || model == AL_EXPONENT_DISTANCE_CLAMPED)
+                dist = std::clamp(dist, ref_dist, std::max(ref_dist, max_dist));
+
+            float ret = 1;
+            switch (model)
+            {
+              case AL_INVERSE_DISTANCE:
+              case AL_INVERSE_DISTANCE_CLAMPED:
+                if (float denominator = ref_dist + rolloff_fac * (dist - ref_dist); denominator > 0)
+                    ret = ref_dist / denominator;
+                break;
+              case AL_LINEAR_DISTANCE:
+              case AL_LINEAR_DISTANCE_CLAMPED:
+                if (max_dist != ref_dist)
+                    ret = 1 - rolloff_fac * (dist - ref_dist) / (max_dist - ref_dist);
+                break;
+              case AL_EXPONENT_DISTANCE:
+              case AL_EXPONENT_DISTANCE_CLAMPED:
+                if (dist > 0 && ref_dist > 0)
+                    ret = std::pow(dist / ref_dist, -rolloff_fac);
+                break;
+            }
+            return std::clamp(ret, 0.f, 1.f);
+        }
     }
 }
@@ -1,10 +1,15 @@
 #include "sound.h"
 
+#include <algorithm>
+#include <cmath>
 #include <string_view>
+#include <utility>
 
-#include <vorbis/vorbisfile.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-#include "macros/finally.h"
+#include "audio/ogg_decoder.h"
 #include "strings/format.h"
 #include "utils/robust_math.h"
 
@@ -12,11 +17,12 @@ namespace Audio
 {
     Sound::Sound(Format format, std::optional<Channels> expected_channel_count, Stream::Input input, BitResolution preferred_resolution)
     {
+        // Note that `input` is moved-from in the ogg branch, but it doesn't have the exception prefix there anyway.
         auto CheckChannelCount = [&]
         {
             if (expected_channel_count && *expected_channel_count != channel_count)
             {
-                throw std::runtime_error(FMT("{}Expected a {} sound, but got {}.", input.GetExceptionPrefix(),
+                throw std::runtime_error(FMT("{}Expected a {} sound, but got {}.", format == wav ? input.GetExceptionPrefix() : "",
                     (*expected_channel_count == mono ? "mono" : "stereo"), (channel_count == mono ? "mono" : "stereo")));
             }
         };
@@ -130,201 +136,203 @@ namespace Audio
             }
             break;
           case ogg:
-            try
             {
-                // Stream exceptions aren't supposed to escape the callbacks anyway,
-                // might as well make constructing them as cheap as possible.
-                input.WantExceptionPrefixStyle(Stream::no_prefix);
-
-                // Construct callbacks.
-                ov_callbacks callbacks;
-                callbacks.close_func = nullptr;
-                callbacks.tell_func = [](void *stream_ptr) -> long
+                OggDecoder decoder(std::move(input), preferred_resolution); // This adds the file name to the exceptions.
+
+                std::size_t storage_size = 0;
+                try
                 {
-                    try
-                    {
-                        long ret;
-                        if (Robust::conversion_fails(static_cast<Stream::Input *>(stream_ptr)->Position(), ret))
-                            return -1;
-                        return ret;
-                    }
-                    catch (...)
-                    {
-                        return -1;
-                    }
-                };
-                callbacks.seek_func = [](void *stream_ptr, std::int64_t offset, int mode) -> int
+                    channel_count = decoder.ChannelCount();
+                    CheckChannelCount();
+                    sampling_rate = decoder.SamplingRate();
+                    resolution = decoder.Resolution();
+
+                    // Compute the necessary storage size.
+                    if (Robust::value(decoder.TotalBlockCount()) * Robust::value(BytesPerBlock()).weakly_typed() >>= storage_size)
+                        throw std::runtime_error("The file is too long.");
+                }
+                catch (std::exception &e)
                 {
-                    try
-                    {
-                        std::ptrdiff_t converted_offset;
-                        if (Robust::conversion_fails(offset, converted_offset))
-                            return -1;
+                    throw std::runtime_error(FMT("While reading a vorbis sound from `{}`:\n{}", decoder.Target(), e.what()));
+                }
 
-                        Stream::SeekMode converted_mode;
-                        switch (mode)
-                        {
-                          case SEEK_SET:
-                            converted_mode = Stream::absolute;
-                            break;
-                          case SEEK_CUR:
-                            converted_mode = Stream::relative;
-                            break;
-                          case SEEK_END:
-                            converted_mode = Stream::end;
-                            break;
-                          default:
-                            return -1;
-                        }
+                data.resize(storage_size);
 
-                        static_cast<Stream::Input *>(stream_ptr)->Seek(converted_offset, converted_mode);
-                        return 0;
-                    }
-                    catch (...)
-                    {
-                        return -1;
-                    }
-                };
-                callbacks.read_func = [](void *buffer, std::size_t elem_size, std::size_t elem_count, void *stream_ptr) -> std::size_t
+                std::size_t current_offset = 0;
+                while (current_offset < storage_size)
                 {
-                    try
-                    {
-                        if (elem_size == 0 || elem_count == 0)
-                            return 0;
-
-                        auto &stream = *static_cast<Stream::Input *>(stream_ptr);
+                    std::size_t segment_size = decoder.Read(data.data() + current_offset, storage_size - current_offset);
+                    if (segment_size == 0)
+                        throw std::runtime_error(FMT("While reading a vorbis sound from `{}`:\nUnexpected end of file.", decoder.Target()));
+                    current_offset += segment_size;
+                }
+            }
+            break;
+        }
+    }
 
-                        std::size_t total_size;
-                        bool enough_data = true;
+    Sound Sound::WithResolution(BitResolution new_resolution) const
+    {
+        if (new_resolution == resolution)
+            return *this;
 
-                        // If the read size is larger than the remaining amount of bytes
-                        // OR if the calculation of `total_size` overflowed, clamp the read size.
-                        if ((Robust::value(elem_size) * Robust::value(elem_count) >>= total_size) || total_size > stream.RemainingBytes())
-                        {
-                            total_size = stream.RemainingBytes();
-                            enough_data = false;
-                        }
+        std::size_t sample_count = BlockCount() * std::size_t(channel_count);
+        Sound ret(sampling_rate, channel_count, new_resolution, BlockCount());
+        std::size_t i = 0;
 
-                        stream.Read(static_cast<char *>(buffer), total_size);
+        if (new_resolution == bits_16)
+        {
+            const std::uint8_t *src = Data<std::uint8_t>();
+            std::int16_t *dst = ret.Data<std::int16_t>();
+
+            #if defined(__SSE2__)
+            // Flipping the high bit makes the samples signed, then they become the high bytes of 16-bit samples.
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i sign = _mm_set1_epi8(char(0x80));
+            for (; i + 16 <= sample_count; i += 16)
+            {
+                __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), sign);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_unpacklo_epi8(zero, v));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), _mm_unpackhi_epi8(zero, v));
+            }
+            #endif
 
-                        if (enough_data)
-                            return elem_count;
-                        else
-                            return total_size / elem_size;
-                    }
-                    catch (...)
-                    {
-                        return -1;
-                    }
-                };
+            for (; i < sample_count; i++)
+                dst[i] = std::int16_t((src[i] - 128) * 256);
+        }
+        else // bits_8
+        {
+            const std::int16_t *src = Data<std::int16_t>();
+            std::uint8_t *dst = ret.Data<std::uint8_t>();
 
-                // Open a file with those callbacks.
-                OggVorbis_File ogg_file_handle;
-                switch (ov_open_callbacks(&input, &ogg_file_handle, nullptr, 0, callbacks))
-                {
-                  case 0:
-                    break;
-                  case OV_EREAD:
-                    throw std::runtime_error("Unable to read data from the stream.");
-                    break;
-                  case OV_ENOTVORBIS:
-                    throw std::runtime_error("This is not a vorbis sound.");
-                    break;
-                  case OV_EVERSION:
-                    throw std::runtime_error("Vorbis version mismatch.");
-                    break;
-                  case OV_EBADHEADER:
-                    throw std::runtime_error("Invalid header.");
-                    break;
-                  case OV_EFAULT:
-                    throw std::runtime_error("Internal vorbis error.");
-                    break;
-                  default:
-                    throw std::runtime_error("Unknown vorbis error.");
-                    break;
-                }
-                FINALLY{ov_clear(&ogg_file_handle);};
+            #if defined(__SSE2__)
+            const __m128i sign = _mm_set1_epi8(char(0x80));
+            for (; i + 16 <= sample_count; i += 16)
+            {
+                __m128i a = _mm_srai_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), 8);
+                __m128i b = _mm_srai_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 8)), 8);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(_mm_packs_epi16(a, b), sign));
+            }
+            #endif
 
+            for (; i < sample_count; i++)
+                dst[i] = std::uint8_t((src[i] >> 8) + 128);
+        }
 
-                // Get some info about the file. No cleanup appears to be necessary.
-                vorbis_info *info = ov_info(&ogg_file_handle, -1);
-                if (!info)
-                    throw std::runtime_error("Unable to get information about the file.");
+        return ret;
+    }
 
-                // Get channel count.
-                if (info->channels != 1 && info->channels != 2)
-                    throw std::runtime_error("The file has too many channels. Only mono and stereo are supported.");
-                channel_count = Channels(info->channels);
-                CheckChannelCount();
+    Sound Sound::WithChannelCount(Channels new_channel_count) const
+    {
+        if (new_channel_count == channel_count)
+            return *this;
 
-                // Get frequency.
-                if (Robust::conversion_fails(info->rate, sampling_rate))
-                    throw std::runtime_error("The sample rate is too high.");
+        std::size_t block_count = BlockCount();
+        Sound ret(sampling_rate, new_channel_count, resolution, block_count);
+        std::size_t i = 0;
 
-                // Get the block count.
-                auto total_block_count = ov_pcm_total(&ogg_file_handle, -1);
-                if (total_block_count == OV_EINVAL)
-                    throw std::runtime_error("Unable to determine the file length.");
+        if (new_channel_count == mono)
+        {
+            if (resolution == bits_16)
+            {
+                const std::int16_t *src = Data<std::int16_t>();
+                std::int16_t *dst = ret.Data<std::int16_t>();
 
-                // Copy bit resolution from the parameter.
-                resolution = preferred_resolution;
+                #if defined(__SSE2__)
+                // `madd` adds the adjacent pairs into 32-bit lanes.
+                const __m128i ones = _mm_set1_epi16(1);
+                for (; i + 8 <= block_count; i += 8)
+                {
+                    __m128i a = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2)), ones), 1);
+                    __m128i b = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2 + 8)), ones), 1);
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(a, b));
+                }
+                #endif
 
-                // Compute the necessary storage size.
-                std::size_t storage_size;
-                if (Robust::value(total_block_count).cast_to<std::size_t>() * Robust::value(BytesPerBlock()).weakly_typed() >>= storage_size)
-                    throw std::runtime_error("The file is too long.");
+                for (; i < block_count; i++)
+                    dst[i] = std::int16_t((src[i * 2] + src[i * 2 + 1]) >> 1);
+            }
+            else // bits_8
+            {
+                const std::uint8_t *src = Data<std::uint8_t>();
+                std::uint8_t *dst = ret.Data<std::uint8_t>();
 
-                data.resize(storage_size);
+                #if defined(__SSE2__)
+                // Split the channels into 16-bit lanes, then average them (rounding up, same as below).
+                const __m128i low_bytes = _mm_set1_epi16(0xff);
+                for (; i + 16 <= block_count; i += 16)
+                {
+                    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2));
+                    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2 + 16));
+                    __m128i avg_a = _mm_avg_epu16(_mm_and_si128(a, low_bytes), _mm_srli_epi16(a, 8));
+                    __m128i avg_b = _mm_avg_epu16(_mm_and_si128(b, low_bytes), _mm_srli_epi16(b, 8));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(avg_a, avg_b));
+                }
+                #endif
 
-                std::size_t current_offset = 0;
+                for (; i < block_count; i++)
+                    dst[i] = std::uint8_t((src[i * 2] + src[i * 2 + 1] + 1) >> 1);
+            }
+        }
+        else // stereo
+        {
+            // The compiler vectorizes this well enough.
+            auto Duplicate = [&]<typename T>(const T *src, T *dst)
+            {
+                for (; i < block_count; i++)
+                    dst[i * 2] = dst[i * 2 + 1] = src[i];
+            };
+            if (resolution == bits_16)
+                Duplicate(Data<std::int16_t>(), ret.Data<std::int16_t>());
+            else
+                Duplicate(Data<std::uint8_t>(), ret.Data<std::uint8_t>());
+        }
 
-                // An index of the current bitstream (basically a section) of the file.
-                // When it changes, the amount of channels and/or sample rate can also change; if it happens, we throw an exception.
-                int old_bitstream_index = -1;
+        return ret;
+    }
 
-                while (current_offset < storage_size)
-                {
-                    int bitstream_index;
-                    auto segment_size = ov_read(&ogg_file_handle, reinterpret_cast<char *>(data.data() + current_offset), storage_size - current_offset, 0/*little endian*/,
-                        BytesPerSample(), resolution == bits_16/*true means numbers are signed*/, &bitstream_index);
+    Sound Sound::Resampled(int new_sampling_rate) const
+    {
+        ASSERT(new_sampling_rate > 0, "Invalid sampling rate.");
+        if (new_sampling_rate == sampling_rate || !*this)
+        {
+            Sound ret = *this;
+            ret.sampling_rate = new_sampling_rate;
+            return ret;
+        }
 
-                    switch (segment_size)
-                    {
-                      case 0:
-                        throw std::runtime_error("Unexpected end of file.");
-                        break;
-                      case OV_HOLE:
-                        throw std::runtime_error("The file is corrupted.");
-                        break;
-                      case OV_EBADLINK:
-                        throw std::runtime_error("Bad link.");
-                        break;
-                      case OV_EINVAL:
-                        throw std::runtime_error("Invalid header.");
-                        break;
-                    }
-                    current_offset += segment_size;
+        std::size_t old_block_count = BlockCount();
+        std::size_t new_block_count = std::max(std::size_t(1), std::size_t(std::llround(double(old_block_count) * new_sampling_rate / sampling_rate)));
+        Sound ret(new_sampling_rate, channel_count, resolution, new_block_count);
 
-                    if (bitstream_index != old_bitstream_index)
-                    {
-                        old_bitstream_index = bitstream_index;
-
-                        info = ov_info(&ogg_file_handle, -1); // `-1` means the current bitstream, we could also use `bitstream_index` here.
-                        if (!info)
-                            throw std::runtime_error("Unable to get information about a section of the file.");
-                        if (Robust::not_equal(info->channels, int(channel_count)))
-                            throw std::runtime_error("Channel count has changed in the middle of the file.");
-                        if (Robust::not_equal(info->rate, sampling_rate))
-                            throw std::runtime_error("Sampling rate has changed in the middle of the file.");
-                    }
-                }
+        // The step is in 32.32 fixed point, to avoid accumulating the rounding errors.
+        std::uint64_t step = (std::uint64_t(sampling_rate) << 32) / std::uint64_t(new_sampling_rate);
+        std::size_t channels = std::size_t(channel_count);
 
-            }
-            catch (std::exception &e)
+        auto Resample = [&]<typename T>(const T *src, T *dst)
+        {
+            std::uint64_t pos = 0;
+            for (std::size_t i = 0; i < new_block_count; i++, pos += step)
             {
-                throw std::runtime_error(FMT("While reading a vorbis sound from `{}`:\n{}", input.GetTarget(), e.what()));
+                std::size_t index = std::size_t(pos >> 32);
+                std::size_t next = std::min(index + 1, old_block_count - 1);
+                index = std::min(index, old_block_count - 1);
+                float frac = float(pos & 0xffffffff) / 4294967296.f;
+
+                for (std::size_t ch = 0; ch < channels; ch++)
+                {
+                    float a = src[index * channels + ch];
+                    float b = src[next * channels + ch];
+                    dst[i * channels + ch] = T(std::lround(a + (b - a) * frac));
+                }
             }
-            break;
-        }
+        };
+
+        if (resolution == bits_16)
+            Resample(Data<std::int16_t>(), ret.Data<std::int16_t>());
+        else
+            Resample(Data<std::uint8_t>(), ret.Data<std::uint8_t>());
+
+        return ret;
     }
 }
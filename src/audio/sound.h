@@ -146,5 +146,16 @@ namespace Audio
         {
             return ByteSize() / BytesPerBlock();
         }
+
+
+        // Conversions. Those return a new sound, and keep this one unchanged.
+
+        // Converts to a different resolution. 8-bit samples are unsigned, 16-bit ones are signed. Converting to 8 bits drops the low byte.
+        [[nodiscard]] Sound WithResolution(BitResolution new_resolution) const;
+        // Converts to a different channel count. Stereo is downmixed to mono by averaging the channels, mono is copied to both channels.
+        [[nodiscard]] Sound WithChannelCount(Channels new_channel_count) const;
+        // Converts to a different sampling rate, using linear interpolation.
+        // This is good enough for the sound effects, but downsampling by a large factor causes some aliasing.
+        [[nodiscard]] Sound Resampled(int new_sampling_rate) const;
     };
 }
@@ -0,0 +1,70 @@
+#include "audio/sound.h"
+
+#include <cstdint>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("audio.sound.resolution")
+{
+    // An odd sample count, to exercise both the vectorized loop and the tail.
+    Audio::Sound sound(44100, Audio::mono, Audio::bits_16, 37);
+    for (int i = 0; i < 37; i++)
+        sound.Data<std::int16_t>()[i] = std::int16_t(i * 1771 - 32768);
+
+    Audio::Sound bits_8 = sound.WithResolution(Audio::bits_8);
+    REQUIRE(bits_8.Resolution() == Audio::bits_8);
+    REQUIRE(bits_8.BlockCount() == 37);
+    for (int i = 0; i < 37; i++)
+        CHECK(bits_8.Data<std::uint8_t>()[i] == (sound.Data<std::int16_t>()[i] >> 8) + 128);
+
+    Audio::Sound bits_16 = bits_8.WithResolution(Audio::bits_16);
+    for (int i = 0; i < 37; i++)
+        CHECK(bits_16.Data<std::int16_t>()[i] == (sound.Data<std::int16_t>()[i] & ~0xff));
+}
+
+TEST_CASE("audio.sound.channels")
+{
+    Audio::Sound stereo_16(44100, Audio::stereo, Audio::bits_16, 19);
+    Audio::Sound stereo_8(44100, Audio::stereo, Audio::bits_8, 37);
+    for (int i = 0; i < 19 * 2; i++)
+        stereo_16.Data<std::int16_t>()[i] = std::int16_t(i % 2 ? -i * 800 : i * 900);
+    for (int i = 0; i < 37 * 2; i++)
+        stereo_8.Data<std::uint8_t>()[i] = std::uint8_t(i * 7);
+
+    Audio::Sound mono_16 = stereo_16.WithChannelCount(Audio::mono);
+    REQUIRE(mono_16.BlockCount() == 19);
+    for (int i = 0; i < 19; i++)
+        CHECK(mono_16.Data<std::int16_t>()[i] == (stereo_16.Data<std::int16_t>()[i * 2] + stereo_16.Data<std::int16_t>()[i * 2 + 1]) >> 1);
+
+    Audio::Sound mono_8 = stereo_8.WithChannelCount(Audio::mono);
+    REQUIRE(mono_8.BlockCount() == 37);
+    for (int i = 0; i < 37; i++)
+        CHECK(mono_8.Data<std::uint8_t>()[i] == (stereo_8.Data<std::uint8_t>()[i * 2] + stereo_8.Data<std::uint8_t>()[i * 2 + 1] + 1) >> 1);
+
+    Audio::Sound back = mono_16.WithChannelCount(Audio::stereo);
+    REQUIRE(back.BlockCount() == 19);
+    for (int i = 0; i < 19; i++)
+    {
+        CHECK(back.Data<std::int16_t>()[i * 2] == mono_16.Data<std::int16_t>()[i]);
+        CHECK(back.Data<std::int16_t>()[i * 2 + 1] == mono_16.Data<std::int16_t>()[i]);
+    }
+}
+
+TEST_CASE("audio.sound.resample")
+{
+    Audio::Sound sound(100, Audio::mono, Audio::bits_16, 4);
+    for (int i = 0; i < 4; i++)
+        sound.Data<std::int16_t>()[i] = std::int16_t(i * 100);
+
+    Audio::Sound up = sound.Resampled(200);
+    REQUIRE(up.SamplingRate() == 200);
+    REQUIRE(up.BlockCount() == 8);
+    const std::int16_t expected[] = {0, 50, 100, 150, 200, 250, 300, 300};
+    for (int i = 0; i < 8; i++)
+        CHECK(up.Data<std::int16_t>()[i] == expected[i]);
+
+    Audio::Sound down = up.Resampled(100);
+    REQUIRE(down.BlockCount() == 4);
+    for (int i = 0; i < 4; i++)
+        CHECK(down.Data<std::int16_t>()[i] == i * 100);
+}
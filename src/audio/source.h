@@ -7,6 +7,7 @@
 
 #include "audio/buffer.h"
 #include "audio/openal.h"
+#include "audio/stats.h"
 #include "program/errors.h"
 #include "utils/mat.h"
 
@@ -30,6 +31,11 @@ namespace Audio
         struct Data
         {
             ALuint handle = 0;
+
+            // The last values set through this class. Setting the same value again is skipped, since every call crosses into the driver.
+            // Those go out of sync if you set the parameters directly with `alSource*()`.
+            fvec3 pos, vel;
+            float gain = 1, raw_pitch = 1;
         };
         Data data;
 
@@ -39,21 +45,24 @@ namespace Audio
         // Create a null source.
         Source() {}
 
-        Source(const Audio::Buffer &buffer)
+        // Create a source without a buffer. Use this to queue the buffers manually, see `StreamingSource`.
+        Source(decltype(nullptr))
         {
-            ASSERT(buffer, "Attempt to use a null audio buffer.");
-
             // We don't throw if the handle is null. Instead, we make sure that any operation on a null handle has no effect.
             alGenSources(1, &data.handle);
 
             if (data.handle)
             {
-                alSourcei(data.handle, AL_BUFFER, buffer.Handle());
-
                 alSourcef(data.handle, AL_REFERENCE_DISTANCE, default_ref_dist);
                 alSourcef(data.handle, AL_ROLLOFF_FACTOR,     default_rolloff_fac);
                 alSourcef(data.handle, AL_MAX_DISTANCE,       default_max_dist);
             }
+            Stats::CountAlCalls(4);
+        }
+
+        Source(const Audio::Buffer &buffer) : Source(nullptr)
+        {
+            this->buffer(buffer);
         }
 
         Source(Source &&other) noexcept : data(std::exchange(other.data, {})) {}
@@ -90,6 +99,7 @@ namespace Audio
                 return SourceState::stopped;
             int state = 0;
             alGetSourcei(data.handle, AL_SOURCE_STATE, &state);
+            Stats::CountAlCalls();
             switch (state)
             {
                 case AL_INITIAL: return SourceState::initial;
@@ -112,10 +122,47 @@ namespace Audio
                 return false;
             int ret = 0;
             alGetSourcei(data.handle, AL_LOOPING, &ret);
+            Stats::CountAlCalls();
             return bool(ret);
         }
 
 
+        // Resets all parameters to the defaults, and detaches the buffer. Stops the source.
+        // Use this to reuse the source for a different sound, see `SourceManager`.
+        Source &reset()
+        {
+            if (!data.handle)
+                return *this;
+            alSourceRewind(data.handle);
+            alSourcei(data.handle, AL_BUFFER, 0);
+            alSourcef(data.handle, AL_REFERENCE_DISTANCE, default_ref_dist);
+            alSourcef(data.handle, AL_ROLLOFF_FACTOR,     default_rolloff_fac);
+            alSourcef(data.handle, AL_MAX_DISTANCE,       default_max_dist);
+            alSourcef(data.handle, AL_GAIN, 1);
+            alSourcef(data.handle, AL_PITCH, 1);
+            alSourcei(data.handle, AL_LOOPING, false);
+            alSourcei(data.handle, AL_SOURCE_RELATIVE, false);
+            alSource3f(data.handle, AL_POSITION, 0, 0, 0);
+            alSource3f(data.handle, AL_VELOCITY, 0, 0, 0);
+            Stats::CountAlCalls(11);
+            data.pos = data.vel = fvec3();
+            data.gain = data.raw_pitch = 1;
+            return *this;
+        }
+
+        // Replaces the buffer. The source must not be playing.
+        Source &buffer(const Audio::Buffer &buffer)
+        {
+            ASSERT(buffer, "Attempt to use a null audio buffer.");
+            if (data.handle)
+            {
+                alSourcei(data.handle, AL_BUFFER, buffer.Handle());
+                Stats::CountAlCalls();
+            }
+            return *this;
+        }
+
+
         // Sound model parameters.
         // See comments for `Audio::Parameters::Model` in `parameters.h` for the meaning of those settings.
 
@@ -135,22 +182,35 @@ namespace Audio
             default_max_dist = d;
         }
 
+        [[nodiscard]] static float DefaultRolloffFactor() {return default_rolloff_fac;}
+        [[nodiscard]] static float DefaultRefDistance() {return default_ref_dist;}
+        [[nodiscard]] static float DefaultMaxDistance() {return default_max_dist;}
+
         Source &rolloff_factor(float f)
         {
             if (data.handle)
+            {
                 alSourcef(data.handle, AL_ROLLOFF_FACTOR, f);
+                Stats::CountAlCalls();
+            }
             return *this;
         }
         Source &max_distance(float d)
         {
             if (data.handle)
+            {
                 alSourcef(data.handle, AL_MAX_DISTANCE, d);
+                Stats::CountAlCalls();
+            }
             return *this;
         }
         Source &ref_distance(float d)
         {
             if (data.handle)
+            {
                 alSourcef(data.handle, AL_REFERENCE_DISTANCE, d);
+                Stats::CountAlCalls();
+            }
             return *this;
         }
 
@@ -159,8 +219,12 @@ namespace Audio
 
         Source &volume(float v) // Defaults to 1.
         {
-            if (data.handle)
+            if (data.handle && v != data.gain)
+            {
                 alSourcef(data.handle, AL_GAIN, v);
+                Stats::CountAlCalls();
+                data.gain = v;
+            }
             return *this;
         }
         Source &pitch(float p) // Defaults to 0. The preferred range is -1..1.
@@ -171,14 +235,21 @@ namespace Audio
         }
         Source &raw_pitch(float p) // Defaults to 1, must be positive. The playback speed is multiplied by this number.
         {
-            if (data.handle)
+            if (data.handle && p != data.raw_pitch)
+            {
                 alSourcef(data.handle, AL_PITCH, p);
+                Stats::CountAlCalls();
+                data.raw_pitch = p;
+            }
             return *this;
         }
         Source &loop(bool l = true)
         {
             if (data.handle)
+            {
                 alSourcei(data.handle, AL_LOOPING, l);
+                Stats::CountAlCalls();
+            }
             return *this;
         }
 
@@ -191,7 +262,10 @@ namespace Audio
         Source &play()
         {
             if (data.handle)
+            {
                 alSourcePlay(data.handle);
+                Stats::CountAlCalls();
+            }
             return *this;
         }
         // Pause if playing.
@@ -199,43 +273,64 @@ namespace Audio
         Source &pause()
         {
             if (data.handle)
+            {
                 alSourcePause(data.handle);
+                Stats::CountAlCalls();
+            }
             return *this;
         }
         // Stop playing, and forget the current position.
         Source &stop()
         {
             if (data.handle)
+            {
                 alSourceStop(data.handle);
+                Stats::CountAlCalls();
+            }
             return *this;
         }
         // Same as `stop()`, but the state becomes `initial` rather than `stopped`.
         Source &rewind()
         {
             if (data.handle)
+            {
                 alSourceRewind(data.handle);
+                Stats::CountAlCalls();
+            }
             return *this;
         }
 
 
         // 3D audio support (makes sense for mono sources only).
+        // When updating many sources at once, consider `Audio::DeferUpdates`.
 
         Source &pos(fvec3 p)
         {
-            if (data.handle)
+            if (data.handle && p != data.pos)
+            {
                 alSourcefv(data.handle, AL_POSITION, p.as_array());
+                Stats::CountAlCalls();
+                data.pos = p;
+            }
             return *this;
         }
         Source &vel(fvec3 v)
         {
-            if (data.handle)
+            if (data.handle && v != data.vel)
+            {
                 alSourcefv(data.handle, AL_VELOCITY, v.as_array());
+                Stats::CountAlCalls();
+                data.vel = v;
+            }
             return *this;
         }
         Source &relative(bool r = true)
         {
             if (data.handle)
+            {
                 alSourcei(data.handle, AL_SOURCE_RELATIVE, r);
+                Stats::CountAlCalls();
+            }
             return *this;
         }
 
@@ -1,69 +1,427 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
-#include <memory>
+#include <cstdint>
 #include <vector>
 
 #include "audio/buffer.h"
+#include "audio/context.h"
+#include "audio/openal.h"
+#include "audio/parameters.h"
 #include "audio/source.h"
+#include "audio/stats.h"
 #include "program/errors.h"
+#include "utils/mat.h"
 
 namespace Audio
 {
-    // Keeps a list of `std::shared_ptr`s to sources.
-    // Automatically releases them when they stop playing.
+    struct VoiceParams
+    {
+        fvec3 pos = fvec3(0);
+        bool relative = false; // If true, `pos` is relative to the listener.
+        float volume = 1;
+        float pitch = 0; // Same as in `Source::pitch()`.
+        bool loop = false;
+        // The sounds with a higher priority get the sources first, regardless of how loud they are.
+        // Among the sounds with the same priority, the louder ones (accounting for the distance) win.
+        int priority = 0;
+    };
+
+    // Plays the short sounds (effects) on a fixed pool of sources, which are reused rather than recreated for each sound.
+    // When there are more sounds than sources, the least important ones become virtual: they don't play,
+    //   but their position is tracked, so they resume from the right place when they get a source back.
+    // The sounds that are too quiet at the listener position (see `SetMinAudibility()`) are always virtual.
+    // The sounds are reassigned to the sources in `Tick()`, and are removed when they finish.
     class SourceManager
     {
-        std::vector<std::shared_ptr<Source>> sources;
+      public:
+        // Refers to a sound played by the manager. Becomes invalid when the sound finishes or is stopped.
+        struct Handle
+        {
+            std::uint32_t index = std::uint32_t(-1);
+            std::uint32_t generation = 0;
+
+            [[nodiscard]] explicit operator bool() const
+            {
+                return index != std::uint32_t(-1);
+            }
+        };
+
+      private:
+        struct Voice
+        {
+            const Buffer *buffer = nullptr;
+            VoiceParams params;
+            float duration = 0; // In seconds.
+            float offset = 0; // The playback position in seconds. Only updated when the voice is virtual, or when it becomes virtual.
+            float audibility = 0; // The volume at the listener position. Updated in `Tick()`.
+            std::uint64_t start_counter = 0; // When the sound started. The newer sounds win the ties.
+            std::uint32_t generation = 0; // Incremented when the voice is removed.
+            int source_index = -1; // -1 if virtual.
+            bool active = false;
+            bool want_source = false; // Temporary, used in `Tick()`.
+        };
+
+        std::vector<Source> sources;
+        std::vector<int> free_sources;
+
+        std::vector<Voice> voices;
+        std::vector<std::uint32_t> free_voices;
+        std::size_t max_voices = 0;
+
+        float min_audibility = 0.001f;
+        std::uint64_t start_counter = 0;
+        std::chrono::steady_clock::time_point last_tick = std::chrono::steady_clock::now();
+        std::vector<std::uint32_t> sorted_voices; // Reused between ticks.
+
+        [[nodiscard]] static bool MoreImportant(const Voice &a, const Voice &b)
+        {
+            if (a.params.priority != b.params.priority)
+                return a.params.priority > b.params.priority;
+            if (a.audibility != b.audibility)
+                return a.audibility > b.audibility;
+            return a.start_counter > b.start_counter;
+        }
+
+        [[nodiscard]] static fvec3 ListenerPos()
+        {
+            fvec3 ret;
+            alGetListener3f(AL_POSITION, &ret.x, &ret.y, &ret.z);
+            Stats::CountAlCalls();
+            return ret;
+        }
+
+        [[nodiscard]] static float ComputeAudibility(const VoiceParams &params, fvec3 listener_pos, ALenum distance_model)
+        {
+            float dist = params.relative ? params.pos.len() : (params.pos - listener_pos).len();
+            return params.volume * Parameters::ComputeDistanceGain(dist, Source::DefaultRefDistance(), Source::DefaultRolloffFactor(), Source::DefaultMaxDistance(), distance_model);
+        }
+
+        // Returns the buffer length in seconds.
+        [[nodiscard]] static float BufferDuration(const Buffer &buffer)
+        {
+            ALint size = 0, frequency = 0, channels = 0, bits = 0;
+            alGetBufferi(buffer.Handle(), AL_SIZE, &size);
+            alGetBufferi(buffer.Handle(), AL_FREQUENCY, &frequency);
+            alGetBufferi(buffer.Handle(), AL_CHANNELS, &channels);
+            alGetBufferi(buffer.Handle(), AL_BITS, &bits);
+            Stats::CountAlCalls(4);
+            if (frequency <= 0 || channels <= 0 || bits <= 0)
+                return 0;
+            return size / float(channels * bits / 8) / frequency;
+        }
+
+        // Gives the voice a free source, and starts playing from the current offset.
+        void MakeReal(Voice &voice)
+        {
+            ASSERT(voice.source_index == -1 && !free_sources.empty(), "Unable to give a source to a voice.");
+            voice.source_index = free_sources.back();
+            free_sources.pop_back();
+
+            Source &source = sources[voice.source_index];
+            source.buffer(*voice.buffer).relative(voice.params.relative).pos(voice.params.pos).volume(voice.params.volume).pitch(voice.params.pitch).loop(voice.params.loop);
+            if (source)
+            {
+                alSourcef(source.Handle(), AL_SEC_OFFSET, voice.offset);
+                Stats::CountAlCalls();
+            }
+            source.play();
+        }
+
+        // Takes the source from the voice, remembering the playback position.
+        void MakeVirtual(Voice &voice)
+        {
+            ASSERT(voice.source_index != -1, "The voice is already virtual.");
+            Source &source = sources[voice.source_index];
+            if (source)
+            {
+                alGetSourcef(source.Handle(), AL_SEC_OFFSET, &voice.offset);
+                Stats::CountAlCalls();
+            }
+            source.reset(); // This detaches the buffer, so it can be destroyed.
+            free_sources.push_back(voice.source_index);
+            voice.source_index = -1;
+        }
+
+        void RemoveVoice(std::uint32_t index)
+        {
+            Voice &voice = voices[index];
+            if (voice.source_index != -1)
+                MakeVirtual(voice);
+            voice.active = false;
+            voice.generation++;
+            free_voices.push_back(index);
+        }
+
+        [[nodiscard]] Voice *GetVoice(Handle handle)
+        {
+            if (!handle || handle.index >= voices.size())
+                return nullptr;
+            Voice &voice = voices[handle.index];
+            if (!voice.active || voice.generation != handle.generation)
+                return nullptr;
+            return &voice;
+        }
 
       public:
-        SourceManager() {}
+        // The amount of sources created by the default constructor.
+        // OpenAL implementations usually allow more, but this is enough for most games.
+        static constexpr int default_max_sources = 32;
+
+        SourceManager() : SourceManager(default_max_sources) {}
 
-        // Add a new source to the manager.
-        // It should be `play()`ed immediately, otherwise it will be removed at the next `Tick()`.
-        void Add(std::shared_ptr<Source> source)
+        // Creates `max_sources` sources. That's the max amount of sounds that can play at the same time.
+        // Up to `max_voices` sounds can exist at the same time, the rest are virtual. More sounds than that are ignored.
+        explicit SourceManager(int max_sources, std::size_t max_voices = 1024) : max_voices(max_voices)
         {
-            ASSERT(source, "Passing a null source.");
-            ASSERT(std::find(sources.begin(), sources.end(), source) == sources.end(), "Adding a duplicate source to `Audio::SourceManager`.");
-            sources.push_back(std::move(source));
+            ASSERT(max_sources > 0 && max_voices >= std::size_t(max_sources), "Invalid voice count.");
+            sources.reserve(std::size_t(max_sources));
+            for (int i = 0; i < max_sources; i++)
+            {
+                sources.emplace_back(nullptr);
+                free_sources.push_back(max_sources - 1 - i);
+            }
         }
-        // Add a new source to the manager.
-        // It should be `play()`ed immediately, otherwise it will be removed at the next `Tick()`.
-        [[nodiscard]] std::shared_ptr<Source> Add(const Buffer &buffer)
+
+        SourceManager(SourceManager &&) = default;
+        SourceManager &operator=(SourceManager &&) = default;
+
+        // The max amount of sounds that play at the same time.
+        [[nodiscard]] int MaxSources() const
         {
-            return sources.emplace_back(std::make_shared<Source>(buffer));
+            return int(sources.size());
         }
 
-        // Add a new source and play it immediately.
-        std::shared_ptr<Source> Play(const Buffer &buffer, fvec3 pos, float volume = 1, float pitch = 0)
+        // The sounds quieter than this at the listener position are virtual. Defaults to 0.001.
+        void SetMinAudibility(float value)
         {
-            std::shared_ptr<Source> ret = Add(buffer);
-            ret->pos(pos).volume(volume).pitch(pitch).play();
-            return ret;
+            min_audibility = value;
         }
-        std::shared_ptr<Source> Play(const Buffer &buffer, fvec2 pos, float volume = 1, float pitch = 0)
+
+        // Starts playing a sound, or makes it virtual if there are more important sounds.
+        // Returns a null handle if there are too many sounds, and this one is the least important.
+        // The buffer must remain alive until the sound finishes.
+        Handle Play(const Buffer &buffer, const VoiceParams &params)
         {
-            std::shared_ptr<Source> ret = Add(buffer);
-            ret->pos(pos).volume(volume).pitch(pitch).play();
-            return ret;
+            ASSERT(buffer, "Attempt to use a null audio buffer.");
+            if (sources.empty())
+                return {};
+
+            Voice new_voice;
+            new_voice.buffer = &buffer;
+            new_voice.params = params;
+            new_voice.duration = BufferDuration(buffer);
+            new_voice.audibility = ComputeAudibility(params, ListenerPos(), alGetInteger(AL_DISTANCE_MODEL));
+            new_voice.start_counter = start_counter++;
+
+            if (free_voices.empty() && voices.size() >= max_voices)
+            {
+                // Replace the least important voice, if it's less important than this one.
+                std::uint32_t least = 0;
+                for (std::uint32_t i = 1; i < voices.size(); i++)
+                {
+                    if (MoreImportant(voices[least], voices[i]))
+                        least = i;
+                }
+                if (!MoreImportant(new_voice, voices[least]))
+                    return {};
+                RemoveVoice(least);
+            }
+
+            std::uint32_t index;
+            if (free_voices.empty())
+            {
+                index = std::uint32_t(voices.size());
+                voices.emplace_back();
+            }
+            else
+            {
+                index = free_voices.back();
+                free_voices.pop_back();
+            }
+
+            Voice &voice = voices[index];
+            new_voice.generation = voice.generation;
+            new_voice.active = true;
+            voice = new_voice;
+
+            if (voice.audibility >= min_audibility)
+            {
+                if (free_sources.empty())
+                {
+                    // Take the source from the least important real voice, if it's less important than this one.
+                    Voice *least = nullptr;
+                    for (Voice &other : voices)
+                    {
+                        if (other.active && other.source_index != -1 && (!least || MoreImportant(*least, other)))
+                            least = &other;
+                    }
+                    if (least && MoreImportant(voice, *least))
+                        MakeVirtual(*least);
+                }
+                if (!free_sources.empty())
+                    MakeReal(voice);
+            }
+
+            return {.index = index, .generation = voice.generation};
         }
-        std::shared_ptr<Source> Play(const Buffer &buffer, float volume = 1, float pitch = 0)
+
+        // Those play a sound at a position, or relative to the listener.
+        Handle Play(const Buffer &buffer, fvec3 pos, float volume = 1, float pitch = 0)
         {
-            std::shared_ptr<Source> ret = Add(buffer);
-            ret->relative().volume(volume).pitch(pitch).play();
-            return ret;
+            return Play(buffer, {.pos = pos, .volume = volume, .pitch = pitch});
+        }
+        Handle Play(const Buffer &buffer, fvec2 pos, float volume = 1, float pitch = 0)
+        {
+            return Play(buffer, pos.to_vec3(), volume, pitch);
+        }
+        Handle Play(const Buffer &buffer, float volume = 1, float pitch = 0)
+        {
+            return Play(buffer, {.relative = true, .volume = volume, .pitch = pitch});
+        }
+
+        // Returns true if the sound is still playing, either for real or virtually.
+        [[nodiscard]] bool IsPlaying(Handle handle)
+        {
+            return bool(GetVoice(handle));
+        }
+        // Returns true if the sound is playing virtually, i.e. doesn't currently have a source.
+        [[nodiscard]] bool IsVirtual(Handle handle)
+        {
+            Voice *voice = GetVoice(handle);
+            return voice && voice->source_index == -1;
+        }
+
+        // Those modify the sounds that are still playing, and do nothing otherwise.
+        void SetPos(Handle handle, fvec3 pos)
+        {
+            if (Voice *voice = GetVoice(handle))
+            {
+                voice->params.pos = pos;
+                if (voice->source_index != -1)
+                    sources[voice->source_index].pos(pos);
+            }
+        }
+        void SetVolume(Handle handle, float volume)
+        {
+            if (Voice *voice = GetVoice(handle))
+            {
+                voice->params.volume = volume;
+                if (voice->source_index != -1)
+                    sources[voice->source_index].volume(volume);
+            }
+        }
+        void SetPitch(Handle handle, float pitch)
+        {
+            if (Voice *voice = GetVoice(handle))
+            {
+                voice->params.pitch = pitch;
+                if (voice->source_index != -1)
+                    sources[voice->source_index].pitch(pitch);
+            }
+        }
+        void Stop(Handle handle)
+        {
+            if (GetVoice(handle))
+                RemoveVoice(handle.index);
         }
 
-        // Releases sources that aren't playing (i.e. are stopped, paused, or not played yet).
-        // Call this at the end of every tick.
+        // Removes the finished sounds, advances the virtual ones, and gives the sources to the most important sounds.
+        // Call this at the end of every tick, after updating the listener position.
         void Tick()
         {
-            std::erase_if(sources, [](const std::shared_ptr<Source> &ptr){return !ptr->IsPlaying();});
+            DeferUpdates defer_updates; // Apply the source reassignments at once.
+
+            auto now = std::chrono::steady_clock::now();
+            float delta = std::chrono::duration<float>(now - last_tick).count();
+            last_tick = now;
+
+            fvec3 listener_pos = ListenerPos();
+            ALenum distance_model = alGetInteger(AL_DISTANCE_MODEL);
+
+            sorted_voices.clear();
+            for (std::uint32_t i = 0; i < voices.size(); i++)
+            {
+                Voice &voice = voices[i];
+                if (!voice.active)
+                    continue;
+
+                if (voice.source_index != -1)
+                {
+                    // Note that this also removes the paused sounds.
+                    if (!sources[voice.source_index].IsPlaying())
+                    {
+                        RemoveVoice(i);
+                        continue;
+                    }
+                }
+                else
+                {
+                    voice.offset += delta * std::exp2(voice.params.pitch);
+                    if (voice.offset >= voice.duration)
+                    {
+                        if (!voice.params.loop || voice.duration <= 0)
+                        {
+                            RemoveVoice(i);
+                            continue;
+                        }
+                        voice.offset = std::fmod(voice.offset, voice.duration);
+                    }
+                }
+
+                voice.audibility = ComputeAudibility(voice.params, listener_pos, distance_model);
+                voice.want_source = false;
+                sorted_voices.push_back(i);
+            }
+
+            // Pick the voices that should have the sources.
+            std::size_t real_count = std::min(sources.size(), sorted_voices.size());
+            std::partial_sort(sorted_voices.begin(), sorted_voices.begin() + std::ptrdiff_t(real_count), sorted_voices.end(),
+                [&](std::uint32_t a, std::uint32_t b){return MoreImportant(voices[a], voices[b]);});
+            for (std::size_t i = 0; i < real_count; i++)
+            {
+                Voice &voice = voices[sorted_voices[i]];
+                if (voice.audibility >= min_audibility)
+                    voice.want_source = true;
+            }
+
+            // Take the sources first, then give them away.
+            for (std::uint32_t index : sorted_voices)
+            {
+                Voice &voice = voices[index];
+                if (!voice.want_source && voice.source_index != -1)
+                    MakeVirtual(voice);
+            }
+            for (std::uint32_t index : sorted_voices)
+            {
+                Voice &voice = voices[index];
+                if (voice.want_source && voice.source_index == -1)
+                    MakeReal(voice);
+            }
+        }
+
+        // Stops all sounds.
+        void StopAll()
+        {
+            for (std::uint32_t i = 0; i < voices.size(); i++)
+            {
+                if (voices[i].active)
+                    RemoveVoice(i);
+            }
         }
 
+        // The amount of sounds that currently have sources.
         [[nodiscard]] std::size_t ActiveSources() const
         {
-            return sources.size();
+            return sources.size() - free_sources.size();
+        }
+        // The amount of sounds, including the virtual ones.
+        [[nodiscard]] std::size_t VoiceCount() const
+        {
+            return voices.size() - free_voices.size();
         }
     };
 }
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Audio
+{
+    // Collects the audio costs: the AL calls per tick, the streaming underruns, and the sound decoding times.
+    // While a `Stats` object exists, the audio classes report to it, otherwise the reporting is a single branch.
+    // The counters are atomic, because the streaming sources and the mixer report from their own threads.
+    // Usage:
+    //     Audio::Stats audio_stats;
+    //     ...
+    //     audio_stats.EndTick(source_manager.ActiveSources()); // Once per tick.
+    //     GameUtils::AudioStatsOverlay(audio_stats);
+    class Stats
+    {
+        inline static std::atomic<Stats *> active = nullptr;
+
+      public:
+        struct Tick
+        {
+            std::uint64_t al_calls = 0;
+            std::uint64_t underruns = 0;
+            std::size_t active_sources = 0;
+        };
+
+        struct Decode
+        {
+            std::string name;
+            double seconds = 0;
+            std::size_t bytes = 0; // The size of the decoded PCM data.
+        };
+
+      private:
+        std::atomic<std::uint64_t> al_calls = 0;
+        std::atomic<std::uint64_t> underruns = 0;
+        std::uint64_t prev_al_calls = 0;
+        std::uint64_t prev_underruns = 0;
+        Tick last_tick;
+
+        mutable std::mutex decodes_mutex;
+        std::vector<Decode> decodes;
+
+      public:
+        // Starts collecting. Only one object can exist at a time.
+        Stats()
+        {
+            Stats *expected = nullptr;
+            if (!active.compare_exchange_strong(expected, this))
+                throw std::runtime_error("Attempt to create multiple audio stats objects.");
+        }
+
+        Stats(const Stats &) = delete;
+        Stats &operator=(const Stats &) = delete;
+
+        ~Stats()
+        {
+            active = nullptr;
+        }
+
+        // Those are called by the audio classes.
+        static void CountAlCalls(std::uint64_t count = 1)
+        {
+            if (Stats *stats = active.load(std::memory_order_relaxed))
+                stats->al_calls.fetch_add(count, std::memory_order_relaxed);
+        }
+        static void CountUnderrun()
+        {
+            if (Stats *stats = active.load(std::memory_order_relaxed))
+                stats->underruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        static void RecordDecode(std::string name, double seconds, std::size_t bytes)
+        {
+            if (Stats *stats = active.load(std::memory_order_relaxed))
+            {
+                std::lock_guard lock(stats->decodes_mutex);
+                stats->decodes.push_back({.name = std::move(name), .seconds = seconds, .bytes = bytes});
+            }
+        }
+
+        // Finishes a tick, making its counters available in `LastTick()`.
+        void EndTick(std::size_t active_sources = 0)
+        {
+            std::uint64_t new_al_calls = al_calls.load(std::memory_order_relaxed);
+            std::uint64_t new_underruns = underruns.load(std::memory_order_relaxed);
+            last_tick = {.al_calls = new_al_calls - prev_al_calls, .underruns = new_underruns - prev_underruns, .active_sources = active_sources};
+            prev_al_calls = new_al_calls;
+            prev_underruns = new_underruns;
+        }
+
+        // The counters of the last finished tick.
+        [[nodiscard]] const Tick &LastTick() const
+        {
+            return last_tick;
+        }
+        [[nodiscard]] std::uint64_t TotalUnderruns() const
+        {
+            return underruns.load(std::memory_order_relaxed);
+        }
+
+        // The decoding times of the sounds loaded while this object existed, in the order they finished.
+        [[nodiscard]] std::vector<Decode> Decodes() const
+        {
+            std::lock_guard lock(decodes_mutex);
+            return decodes;
+        }
+        void ClearDecodes()
+        {
+            std::lock_guard lock(decodes_mutex);
+            decodes.clear();
+        }
+    };
+}
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "audio/buffer.h"
+#include "audio/ogg_decoder.h"
+#include "audio/openal.h"
+#include "audio/source.h"
+#include "audio/stats.h"
+#include "program/errors.h"
+#include "stream/input.h"
+
+namespace Audio
+{
+    struct StreamingSourceParams
+    {
+        int buffer_count = 4;
+        float buffer_seconds = 0.25f; // The length of each buffer. The queue holds `buffer_count * buffer_seconds` of sound.
+        BitResolution resolution = bits_16;
+    };
+
+    // Plays a long ogg sound (music, ambience) without decoding all of it into memory.
+    // A background thread decodes it piece by piece into a small queue of buffers, and refills them as they're played.
+    // Usage:
+    //     StreamingSource music(Stream::ReadOnlyData::file("music.ogg"));
+    //     music.loop().play();
+    //     music.GetSource().volume(0.5f);
+    class StreamingSource
+    {
+        struct State
+        {
+            std::mutex mutex;
+            std::condition_variable_any cv;
+
+            OggDecoder decoder;
+            Source source;
+            std::vector<Buffer> buffers;
+            std::vector<std::uint8_t> pcm; // Reused between the buffers.
+            std::chrono::duration<float> poll_interval{};
+
+            bool looping = false;
+            bool want_playing = false; // False if stopped, paused, or finished.
+            bool end_of_stream = false; // Everything was queued, and we're not looping.
+            std::exception_ptr error;
+
+            // Decodes the next piece of the sound into `buffer`, and queues it. Returns false if there's nothing more to play.
+            bool FillAndQueue(Buffer &buffer)
+            {
+                std::size_t filled = 0;
+                while (filled < pcm.size())
+                {
+                    std::size_t segment_size = decoder.Read(pcm.data() + filled, pcm.size() - filled);
+                    if (segment_size > 0)
+                    {
+                        filled += segment_size;
+                        continue;
+                    }
+
+                    if (!looping || decoder.TotalBlockCount() == 0)
+                    {
+                        end_of_stream = true;
+                        break;
+                    }
+                    decoder.Rewind();
+                }
+
+                if (filled == 0)
+                    return false;
+
+                buffer.SetData(decoder.SamplingRate(), decoder.ChannelCount(), decoder.Resolution(), filled / decoder.BytesPerBlock(), pcm.data());
+                if (source)
+                {
+                    ALuint handle = buffer.Handle();
+                    alSourceQueueBuffers(source.Handle(), 1, &handle);
+                    Stats::CountAlCalls();
+                }
+                return true;
+            }
+
+            // Stops the source, rewinds the sound, and fills the queue again.
+            void Restart()
+            {
+                source.rewind();
+                if (source)
+                    alSourcei(source.Handle(), AL_BUFFER, 0); // Unqueue everything.
+
+                decoder.Rewind();
+                end_of_stream = false;
+                for (Buffer &buffer : buffers)
+                {
+                    if (!FillAndQueue(buffer))
+                        break;
+                }
+            }
+
+            // Refills the played buffers, and resumes the playback after an underrun. Called periodically by the worker thread.
+            void Update()
+            {
+                if (!source)
+                    return;
+
+                ALint processed = 0;
+                alGetSourcei(source.Handle(), AL_BUFFERS_PROCESSED, &processed);
+                Stats::CountAlCalls();
+                while (processed-- > 0)
+                {
+                    ALuint handle = 0;
+                    alSourceUnqueueBuffers(source.Handle(), 1, &handle);
+                    Stats::CountAlCalls();
+                    if (end_of_stream)
+                        continue;
+                    auto it = std::find_if(buffers.begin(), buffers.end(), [&](const Buffer &buffer){return buffer.Handle() == handle;});
+                    ASSERT(it != buffers.end(), "Unqueued an unknown audio buffer.");
+                    FillAndQueue(*it);
+                }
+
+                if (want_playing)
+                {
+                    ALint queued = 0;
+                    alGetSourcei(source.Handle(), AL_BUFFERS_QUEUED, &queued);
+                    Stats::CountAlCalls();
+                    if (queued == 0)
+                    {
+                        want_playing = false; // Finished playing.
+                    }
+                    else if (!source.IsPlaying())
+                    {
+                        source.play(); // The queue ran dry before we refilled it.
+                        Stats::CountUnderrun();
+                    }
+                }
+            }
+        };
+
+        std::unique_ptr<State> state;
+        std::jthread worker; // Must be after `state`, to be destroyed first.
+
+        static void WorkerLoop(std::stop_token stop, State &state)
+        {
+            std::unique_lock lock(state.mutex);
+            while (!stop.stop_requested())
+            {
+                if (!state.error)
+                {
+                    try
+                    {
+                        state.Update();
+                    }
+                    catch (...)
+                    {
+                        state.error = std::current_exception();
+                        state.want_playing = false;
+                        state.source.stop();
+                    }
+                }
+
+                state.cv.wait_for(lock, stop, state.poll_interval, []{return false;});
+            }
+        }
+
+      public:
+        // Create a null source.
+        StreamingSource() {}
+
+        // Reads the header and decodes the first few buffers. Throws on failure.
+        StreamingSource(Stream::Input input, StreamingSourceParams params = {}) : state(std::make_unique<State>())
+        {
+            ASSERT(params.buffer_count >= 2 && params.buffer_seconds > 0, "Invalid streaming source parameters.");
+
+            state->decoder = OggDecoder(std::move(input), params.resolution);
+            state->source = Source(nullptr);
+            for (int i = 0; i < params.buffer_count; i++)
+                state->buffers.emplace_back(nullptr);
+
+            std::size_t blocks_per_buffer = std::size_t(std::max(1.f, state->decoder.SamplingRate() * params.buffer_seconds));
+            state->pcm.resize(blocks_per_buffer * std::size_t(state->decoder.BytesPerBlock()));
+            // Poll often enough to refill a buffer long before the queue runs dry.
+            state->poll_interval = std::chrono::duration<float>(params.buffer_seconds / 4);
+
+            state->Restart();
+
+            worker = std::jthread([state = state.get()](std::stop_token stop){WorkerLoop(std::move(stop), *state);});
+        }
+
+        StreamingSource(StreamingSource &&) = default;
+        StreamingSource &operator=(StreamingSource other) noexcept
+        {
+            std::swap(state, other.state);
+            std::swap(worker, other.worker);
+            return *this;
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(state);
+        }
+
+        // Use this to set the volume, the pitch, the position, and so on.
+        // Don't call `play()`, `pause()`, `stop()`, `rewind()` and `loop()` on it, use the ones from this class instead.
+        [[nodiscard]] Source &GetSource()
+        {
+            ASSERT(*this, "Attempt to use a null streaming source.");
+            return state->source;
+        }
+
+        // Returns true until the sound finishes, or is paused or stopped.
+        [[nodiscard]] bool IsPlaying() const
+        {
+            if (!state)
+                return false;
+            std::lock_guard lock(state->mutex);
+            return state->want_playing;
+        }
+
+        // If the decoding has failed on the background thread, returns the exception. The playback is stopped in that case.
+        [[nodiscard]] std::exception_ptr Error() const
+        {
+            if (!state)
+                return nullptr;
+            std::lock_guard lock(state->mutex);
+            return state->error;
+        }
+
+        StreamingSource &loop(bool l = true)
+        {
+            if (!state)
+                return *this;
+            std::lock_guard lock(state->mutex);
+            state->looping = l;
+            if (l)
+                state->end_of_stream = false; // The next refill will wrap around.
+            return *this;
+        }
+
+        // Start playing.
+        // If the source was paused, resumes from that position, otherwise starts from the beginning.
+        StreamingSource &play()
+        {
+            if (!state)
+                return *this;
+            std::lock_guard lock(state->mutex);
+            if (state->error)
+                return *this;
+            if (state->source)
+            {
+                ALint queued = 0;
+                alGetSourcei(state->source.Handle(), AL_BUFFERS_QUEUED, &queued);
+                if (queued == 0)
+                    state->Restart(); // Finished playing.
+            }
+            state->want_playing = true;
+            state->source.play();
+            return *this;
+        }
+        // Pause if playing.
+        StreamingSource &pause()
+        {
+            if (!state)
+                return *this;
+            std::lock_guard lock(state->mutex);
+            state->want_playing = false;
+            state->source.pause();
+            return *this;
+        }
+        // Stop playing, and rewind to the beginning.
+        StreamingSource &stop()
+        {
+            if (!state)
+                return *this;
+            std::lock_guard lock(state->mutex);
+            state->want_playing = false;
+            if (!state->error)
+                state->Restart();
+            return *this;
+        }
+    };
+}
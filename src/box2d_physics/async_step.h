@@ -0,0 +1,283 @@
+#pragma once
+
+#include <box2d/box2d.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "program/errors.h"
+#include "utils/jobs.h"
+#include "utils/trace.h"
+
+// Runs the Box2D steps on our job system.
+// Usage:
+//     Box2DPhysics::TaskSystem tasks(Jobs::GlobalPool()); // Must outlive the world.
+//     b2WorldDef def = b2DefaultWorldDef();
+//     tasks.Attach(def);
+//     b2WorldId world = b2CreateWorld(&def);
+//     Box2DPhysics::AsyncStepper stepper(world, Jobs::GlobalPool());
+//     stepper.on_body_moved = [](const b2BodyMoveEvent &event){...}; // Update the entity components here.
+//
+//     // Then each tick:
+//     stepper.Finish(); // Waits for the previous step. Then it's safe to touch the world again.
+//     ...; // The game logic that touches the world.
+//     stepper.Start(1 / 60.f, 4);
+//
+//     // When rendering, don't touch the world, since a step might be running. Use the interpolated transforms instead:
+//     b2Transform xf = stepper.GetInterpolatedTransform(body, alpha).value_or(initial_transform);
+
+namespace Box2DPhysics
+{
+    // Lets Box2D split its work between the threads of a `Jobs::ThreadPool`.
+    // The tasks are split into chunks, each chunk gets its own Box2D worker index.
+    // The single-item tasks are the solver workers, which Box2D enqueues in a row and which busy-wait for each other.
+    //   Those all go to the pool, except the first one of each group, which runs on the stepping thread in `FinishTask()`,
+    //   so that it makes progress even if the pool threads are busy.
+    // Note that the Box2D solver busy-waits in its worker tasks, so don't attach this to a world when the pool is busy with long jobs.
+    class TaskSystem
+    {
+        struct Task
+        {
+            Jobs::Counter counter;
+            bool single_item = false;
+
+            // If not null, this task runs on the thread that calls `FinishTask()`, instead of on the pool.
+            b2TaskCallback *deferred_callback = nullptr;
+            void *deferred_context = nullptr;
+        };
+
+        Jobs::ThreadPool *pool = nullptr;
+        int worker_count = 1;
+
+        // The number of single-item tasks that were enqueued but not finished yet.
+        // Box2D enqueues and finishes the tasks on the stepping thread only, so this doesn't need to be atomic.
+        int num_pending_single_item_tasks = 0;
+
+        static void *EnqueueTask(b2TaskCallback *callback, int item_count, int min_range, void *task_context, void *user_context)
+        {
+            TaskSystem &self = *static_cast<TaskSystem *>(user_context);
+
+            if (item_count == 1)
+            {
+                auto task = std::make_unique<Task>();
+                task->single_item = true;
+                int worker_index = self.num_pending_single_item_tasks++ % self.worker_count;
+                if (worker_index == 0)
+                {
+                    task->deferred_callback = callback;
+                    task->deferred_context = task_context;
+                }
+                else
+                {
+                    self.pool->Submit(task->counter, [=]{callback(0, 1, std::uint32_t(worker_index), task_context);});
+                }
+                return task.release();
+            }
+
+            int num_chunks = std::min(self.worker_count, (item_count + min_range - 1) / std::max(min_range, 1));
+            if (num_chunks <= 1)
+            {
+                // Not worth a job. Returning null tells Box2D that the task is already done.
+                callback(0, item_count, 0, task_context);
+                return nullptr;
+            }
+
+            auto task = std::make_unique<Task>();
+            for (int i = 0; i < num_chunks; i++)
+            {
+                int begin = int(std::int64_t(item_count) * i / num_chunks);
+                int end = int(std::int64_t(item_count) * (i + 1) / num_chunks);
+                self.pool->Submit(task->counter, [=]{callback(begin, end, std::uint32_t(i), task_context);});
+            }
+            return task.release();
+        }
+
+        static void FinishTask(void *user_task, void *user_context)
+        {
+            TaskSystem &self = *static_cast<TaskSystem *>(user_context);
+            std::unique_ptr<Task> task(static_cast<Task *>(user_task));
+            if (task->single_item)
+                self.num_pending_single_item_tasks--;
+            if (task->deferred_callback)
+                task->deferred_callback(0, 1, 0, task->deferred_context);
+            self.pool->Wait(task->counter);
+        }
+
+      public:
+        // `worker_count` is how many threads Box2D can use at once. If it's zero or negative, uses `pool.Concurrency()`.
+        explicit TaskSystem(Jobs::ThreadPool &pool, int worker_count = 0)
+            : pool(&pool), worker_count(worker_count > 0 ? worker_count : pool.Concurrency())
+        {}
+
+        // The Box2D callbacks point to this object.
+        TaskSystem(const TaskSystem &) = delete;
+        TaskSystem &operator=(const TaskSystem &) = delete;
+
+        // Configures a world to use this task system. Call before `b2CreateWorld()`.
+        void Attach(b2WorldDef &def)
+        {
+            def.workerCount = worker_count;
+            def.enqueueTask = EnqueueTask;
+            def.finishTask = FinishTask;
+            def.userTaskContext = this;
+        }
+
+        [[nodiscard]] int WorkerCount() const
+        {
+            return worker_count;
+        }
+    };
+
+    // Runs `b2World_Step()` on a worker thread, while the main thread renders.
+    // Remembers the transforms of the bodies before and after the last step, to interpolate them when rendering.
+    // Only the bodies reported by the Box2D move events (i.e. the awake ones) are touched after each step.
+    class AsyncStepper
+    {
+        struct BodyTransforms
+        {
+            std::uint16_t revision = 0; // From `b2BodyId`, to detect reused body slots.
+            std::uint64_t step = 0; // The step number when `cur` was updated.
+            b2Transform prev{};
+            b2Transform cur{};
+        };
+
+        b2WorldId world = b2_nullWorldId;
+        Jobs::ThreadPool *pool = nullptr;
+
+        Jobs::Counter counter; // Tracks the running step.
+        bool stepping = false;
+
+        // Filled by the worker thread, consumed by `Finish()`.
+        std::vector<b2BodyMoveEvent> pending_moves;
+
+        std::uint64_t step_count = 0;
+        std::vector<BodyTransforms> transforms; // Indexed by `b2BodyId::index1`.
+
+      public:
+        // Called by `Finish()` on the calling thread, for each body that moved during the last step. Use this to sync the entity components.
+        // `event.userData` is the body user data, and `event.fellAsleep` tells if the body stopped moving.
+        std::function<void(const b2BodyMoveEvent &event)> on_body_moved;
+
+        AsyncStepper() {}
+
+        // Doesn't own the world. The pool must outlive this object.
+        AsyncStepper(b2WorldId world, Jobs::ThreadPool &pool) : world(world), pool(&pool) {}
+
+        // The running step points to this object.
+        AsyncStepper(const AsyncStepper &) = delete;
+        AsyncStepper &operator=(const AsyncStepper &) = delete;
+
+        // Waits for the running step, if any.
+        ~AsyncStepper()
+        {
+            if (stepping)
+                pool->Wait(counter);
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return B2_IS_NON_NULL(world);
+        }
+
+        [[nodiscard]] b2WorldId World() const
+        {
+            return world;
+        }
+
+        // Returns true between `Start()` and `Finish()`. Don't touch the world during that time.
+        [[nodiscard]] bool IsStepping() const
+        {
+            return stepping;
+        }
+
+        // The number of finished steps.
+        [[nodiscard]] std::uint64_t StepCount() const
+        {
+            return step_count;
+        }
+
+        // Starts a step on the pool, and returns immediately.
+        void Start(float time_step, int sub_step_count)
+        {
+            ASSERT(B2_IS_NON_NULL(world), "The stepper is null.");
+            ASSERT(!stepping, "The previous step isn't finished.");
+            stepping = true;
+            pool->Submit(counter, [this, time_step, sub_step_count]
+            {
+                IMP_TRACE_ZONE("Box2DPhysics::AsyncStepper step");
+                b2World_Step(world, time_step, sub_step_count);
+
+                // The event arrays are only valid until the next step, so copy them.
+                b2BodyEvents events = b2World_GetBodyEvents(world);
+                pending_moves.assign(events.moveEvents, events.moveEvents + events.moveCount);
+            });
+        }
+
+        // Waits for the step started by `Start()`, if any, then updates the transforms and calls `on_body_moved`.
+        // Rethrows the exceptions from the step, if any.
+        void Finish()
+        {
+            if (!stepping)
+                return;
+            stepping = false;
+            pool->Wait(counter);
+
+            IMP_TRACE_ZONE("Box2DPhysics::AsyncStepper::Finish");
+            step_count++;
+            for (const b2BodyMoveEvent &event : pending_moves)
+            {
+                std::size_t index = std::size_t(event.bodyId.index1);
+                if (index >= transforms.size())
+                    transforms.resize(index + 1);
+                BodyTransforms &body = transforms[index];
+                // If the body is new, or the slot was reused, there's nothing to interpolate from.
+                body.prev = body.revision == event.bodyId.revision && body.step != 0 ? body.cur : event.transform;
+                body.cur = event.transform;
+                body.revision = event.bodyId.revision;
+                body.step = step_count;
+
+                if (on_body_moved)
+                    on_body_moved(event);
+            }
+            pending_moves.clear();
+        }
+
+        // Same as `Finish()` followed by `Start()`.
+        void Step(float time_step, int sub_step_count)
+        {
+            Finish();
+            Start(time_step, sub_step_count);
+        }
+
+        // Returns the transform of a body, interpolated between the last two finished steps. `alpha == 0` is the older step, `alpha == 1` is the newer one.
+        // Returns null if the body never moved (or didn't move since its slot was reused), then use the transform you've created it with.
+        // Doesn't touch the world, so this can be called while a step is running.
+        [[nodiscard]] std::optional<b2Transform> GetInterpolatedTransform(b2BodyId body, float alpha) const
+        {
+            std::size_t index = std::size_t(body.index1);
+            if (index >= transforms.size() || transforms[index].step == 0 || transforms[index].revision != body.revision)
+                return std::nullopt;
+            const BodyTransforms &data = transforms[index];
+            if (data.step != step_count)
+                return data.cur; // Didn't move during the last step.
+            return b2Transform{.p = b2Lerp(data.prev.p, data.cur.p, alpha), .q = b2NLerp(data.prev.q, data.cur.q, alpha)};
+        }
+
+        // Forgets the remembered transforms of a body, e.g. after teleporting it with `b2Body_SetTransform()`, so that it's not interpolated from the old position.
+        void ResetInterpolation(b2BodyId body, b2Transform transform)
+        {
+            std::size_t index = std::size_t(body.index1);
+            if (index >= transforms.size())
+                transforms.resize(index + 1);
+            BodyTransforms &data = transforms[index];
+            data.revision = body.revision;
+            data.step = step_count == 0 ? 1 : step_count;
+            data.prev = data.cur = transform;
+        }
+    };
+}
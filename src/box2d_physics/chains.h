@@ -0,0 +1,198 @@
+#pragma once
+
+#include <box2d/box2d.h>
+
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "box2d_physics/math_adapters.h"
+#include "geometry/common.h"
+#include "geometry/tiles_to_edges.h"
+#include "utils/mat.h"
+
+// Creates Box2D chain shapes from the edge loops produced by `Geom::TilesToEdges`.
+// Usage:
+//     Box2DPhysics::ChainBuffer buffer(fvec2(tile_size_in_meters / tileset.tile_size));
+//     Geom::TilesToEdges::ConvertTilesToEdges(tileset, Mode::open, chunk_size, input, buffer.OutputCallback());
+//     chunk_body.Replace(world, buffer);
+// Reuse the buffer and the `ChunkBody` objects between the chunks and the edits, to reuse their memory.
+
+namespace Box2DPhysics
+{
+    // Collects the edge loops into one contiguous array of points, to create the chain shapes from them without per-loop allocations.
+    class ChainBuffer
+    {
+      public:
+        struct Loop
+        {
+            std::size_t begin = 0; // An index in `Points()`.
+            std::size_t count = 0;
+            bool closed = true;
+        };
+
+      private:
+        std::vector<b2Vec2> points;
+        std::vector<Loop> loops;
+        bool in_loop = false;
+
+        fvec2 scale = fvec2(1);
+        fvec2 offset;
+
+      public:
+        ChainBuffer() {}
+
+        // The points are transformed as `pos * scale + offset`.
+        explicit ChainBuffer(fvec2 scale, fvec2 offset = {}) : scale(scale), offset(offset) {}
+
+        // Sets the transformation for the points added after this call.
+        void SetTransform(fvec2 new_scale, fvec2 new_offset = {})
+        {
+            scale = new_scale;
+            offset = new_offset;
+        }
+
+        // Removes all loops. Keeps the capacity.
+        void Clear()
+        {
+            points.clear();
+            loops.clear();
+            in_loop = false;
+        }
+
+        void Reserve(std::size_t point_count, std::size_t loop_count)
+        {
+            points.reserve(point_count);
+            loops.reserve(loop_count);
+        }
+
+        // Adds a point in the format of the `output` callback of `Geom::TilesToEdges::ConvertTilesToEdges()`.
+        // The closed loops repeat the first point at the end, that copy is dropped, since Box2D doesn't want it.
+        void AddPoint(ivec2 pos, Geom::PointInfo info)
+        {
+            if (!in_loop)
+            {
+                loops.push_back({.begin = points.size()});
+                in_loop = true;
+            }
+
+            if (info.type != Geom::PointType::last || !info.closed)
+                points.push_back(fvec2(pos) * scale + offset);
+
+            if (info.type == Geom::PointType::last)
+            {
+                Loop &loop = loops.back();
+                loop.count = points.size() - loop.begin;
+                loop.closed = info.closed;
+                in_loop = false;
+            }
+        }
+
+        // Returns a callback for the `output` parameter of `Geom::TilesToEdges::ConvertTilesToEdges()` and `ConvertTilesToEdgesParallel()`.
+        [[nodiscard]] auto OutputCallback()
+        {
+            return [this](ivec2 pos, Geom::PointInfo info){AddPoint(pos, info);};
+        }
+
+        // Adds a contour from `Geom::TilesToEdges::IncrementalConverter`.
+        void AddContour(const Geom::TilesToEdges::IncrementalConverter::Contour &contour)
+        {
+            for (std::size_t i = 0; i < contour.points.size(); i++)
+                AddPoint(contour.points[i], {.type = i + 1 == contour.points.size() ? Geom::PointType::last : Geom::PointType::normal, .closed = contour.closed});
+        }
+
+        [[nodiscard]] std::span<const b2Vec2> Points() const
+        {
+            return points;
+        }
+
+        // Doesn't include the unfinished loop, if any.
+        [[nodiscard]] std::span<const Loop> Loops() const
+        {
+            return std::span(loops).first(loops.size() - in_loop);
+        }
+
+        // Creates a chain shape on `body` for each loop.
+        // The loops with less than 4 points are skipped, since Box2D doesn't support them.
+        // `def` is a template, its `points`, `count` and `isLoop` are overwritten.
+        // If `chain_ids` isn't null, appends the new chains to it.
+        void CreateChains(b2BodyId body, b2ChainDef def = b2DefaultChainDef(), std::vector<b2ChainId> *chain_ids = nullptr) const
+        {
+            for (const Loop &loop : Loops())
+            {
+                if (loop.count < 4)
+                    continue;
+                def.points = points.data() + loop.begin;
+                def.count = int(loop.count);
+                def.isLoop = loop.closed;
+                b2ChainId id = b2CreateChain(body, &def);
+                if (chain_ids)
+                    chain_ids->push_back(id);
+            }
+        }
+    };
+
+    // Owns a body with the chain shapes of one chunk of the map.
+    class ChunkBody
+    {
+        b2BodyId body = b2_nullBodyId;
+        std::vector<b2ChainId> chains;
+
+      public:
+        ChunkBody() {}
+
+        ChunkBody(ChunkBody &&other) noexcept
+            : body(std::exchange(other.body, b2_nullBodyId)), chains(std::move(other.chains))
+        {}
+        ChunkBody &operator=(ChunkBody other) noexcept
+        {
+            std::swap(body, other.body);
+            std::swap(chains, other.chains);
+            return *this;
+        }
+
+        // Destroys the body, unless the world was already destroyed.
+        ~ChunkBody()
+        {
+            Destroy();
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return B2_IS_NON_NULL(body);
+        }
+
+        // Null if `Replace()` wasn't called yet.
+        [[nodiscard]] b2BodyId Body() const
+        {
+            return body;
+        }
+
+        [[nodiscard]] std::span<const b2ChainId> Chains() const
+        {
+            return chains;
+        }
+
+        // Replaces the body and all its shapes with a new body with the chains from `buffer`, in one go between the physics steps.
+        // The new body is created before the old one is destroyed, so the chunk never has a moment without shapes.
+        // `body_def` is static by default. `chain_def` is a template, see `ChainBuffer::CreateChains()`.
+        void Replace(b2WorldId world, const ChainBuffer &buffer, const b2BodyDef &body_def = b2DefaultBodyDef(), const b2ChainDef &chain_def = b2DefaultChainDef())
+        {
+            b2BodyId old_body = std::exchange(body, b2CreateBody(world, &body_def));
+            chains.clear(); // The old chains are destroyed with their body. This keeps the capacity.
+            buffer.CreateChains(body, chain_def, &chains);
+            if (B2_IS_NON_NULL(old_body) && b2Body_IsValid(old_body))
+                b2DestroyBody(old_body);
+        }
+
+        // Destroys the body with all its shapes.
+        void Destroy()
+        {
+            if (B2_IS_NON_NULL(body) && b2Body_IsValid(body))
+                b2DestroyBody(body);
+            body = b2_nullBodyId;
+            chains.clear();
+        }
+    };
+}
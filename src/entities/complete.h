@@ -3,6 +3,11 @@
 // See "core.h" for a summary.
 #include "entities/core.h"
 #include "entities/lists.h"
+#include "entities/mixin_change_tracking.h"
+#include "entities/mixin_depth_sorting.h"
 #include "entities/mixin_entity_callbacks.h"
 #include "entities/mixin_entity_links.h"
 #include "entities/mixin_global_entity_lists.h"
+#include "entities/mixin_profiling.h"
+#include "entities/mixin_snapshots.h"
+#include "entities/mixin_spatial_index.h"
@@ -2,11 +2,16 @@
 
 // The core implementation of the entity system.
 
+#include <algorithm>
 #include <compare>
 #include <concepts>
 #include <cstddef>
+#include <functional>
 #include <memory>
+#include <new>
+#include <span>
 #include <stdexcept>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -16,7 +21,10 @@
 #include "meta/common.h"
 #include "meta/lists.h"
 #include "meta/type_info.h"
+#include "program/errors.h"
 #include "strings/format.h"
+#include "utils/alloc_tracker.h"
+#include "utils/jobs.h"
 
 /* INTRODUCTION
  *
@@ -51,6 +59,9 @@
  *     predicate taking `EntityDesc`, instead of querying
  *
  * - CONTROLLER - creates and destroys entities, and owns them. Exposes entity lists for all used categories.
+ *
+ *   - `Tag::CommandBuffer` - records entity creations and destructions, to be applied to a controller later in bulk.
+ *     Use it to create or destroy entities while iterating over entity lists.
  */
 
 namespace Ent
@@ -202,6 +213,147 @@ namespace Ent
     template <TagType Tag, EntityType<Tag> T>
     using EntityComponents = impl::EntityComponentsIfAny<Tag, T>;
 
+    // Assigns indices to entity types. Used to find the memory pool for an entity.
+    // Unlike other registries, this one doesn't need to be finalized, because the controllers add pools lazily.
+    template <TagType Tag>
+    class EntityTypeRegistry
+    {
+        static int &GetCount()
+        {
+            static int ret = 0;
+            return ret;
+        }
+
+      public:
+        EntityTypeRegistry() = delete;
+        ~EntityTypeRegistry() = delete;
+
+        // The number of registered entity types for this tag.
+        [[nodiscard]] static int Count() {return GetCount();}
+
+        // Registers an entity type at program startup, and gives its index.
+        template <EntityType<Tag> E>
+        struct Type
+        {
+            inline static const int index = []{return GetCount()++;}();
+
+          private:
+            static constexpr std::integral_constant<const int *, &index> registration_helper;
+        };
+    };
+
+    namespace impl
+    {
+        // A pool allocator for entities of a single type.
+        // Allocates memory in slabs of increasing sizes, and reuses the freed slots via an intrusive free list.
+        // Both allocation and deallocation are O(1), unless a new slab is needed.
+        class EntityPool
+        {
+            // Slabs never grow larger than this many elements.
+            static constexpr std::size_t max_slab_elems = 4096;
+
+            struct SlabDeleter
+            {
+                std::size_t align = 0;
+                void operator()(std::byte *ptr) const noexcept
+                {
+                    ::operator delete(ptr, std::align_val_t(align));
+                }
+            };
+            using slab_ptr = std::unique_ptr<std::byte[], SlabDeleter>;
+
+            // A free slot stores a pointer to the next one.
+            struct FreeSlot
+            {
+                FreeSlot *next = nullptr;
+            };
+
+            std::size_t elem_size = 0;
+            std::size_t elem_align = 0;
+
+            std::vector<slab_ptr> slabs;
+            std::size_t capacity = 0;
+            std::size_t num_allocated = 0;
+            FreeSlot *first_free = nullptr;
+
+            void AddSlab(std::size_t num_elems)
+            {
+                slab_ptr slab((std::byte *)::operator new(elem_size * num_elems, std::align_val_t(elem_align)), SlabDeleter{elem_align});
+                // Link the slots in the order of increasing addresses, so that the new entities are created in that order.
+                for (std::size_t i = num_elems; i-- > 0;)
+                    first_free = ::new((void *)(slab.get() + elem_size * i)) FreeSlot{first_free};
+                slabs.push_back(std::move(slab));
+                capacity += num_elems;
+            }
+
+          public:
+            constexpr EntityPool() {}
+
+            EntityPool(std::size_t new_elem_size, std::size_t new_elem_align)
+                : elem_align(std::max(new_elem_align, alignof(FreeSlot)))
+            {
+                // Round up the element size to the alignment, so that all slots in a slab are aligned.
+                elem_size = (std::max(new_elem_size, sizeof(FreeSlot)) + elem_align - 1) / elem_align * elem_align;
+            }
+
+            EntityPool(EntityPool &&other) noexcept
+                : elem_size(other.elem_size), elem_align(other.elem_align),
+                slabs(std::move(other.slabs)),
+                capacity(std::exchange(other.capacity, 0)),
+                num_allocated(std::exchange(other.num_allocated, 0)),
+                first_free(std::exchange(other.first_free, nullptr))
+            {}
+            EntityPool &operator=(EntityPool other) noexcept
+            {
+                std::swap(elem_size, other.elem_size);
+                std::swap(elem_align, other.elem_align);
+                std::swap(slabs, other.slabs);
+                std::swap(capacity, other.capacity);
+                std::swap(num_allocated, other.num_allocated);
+                std::swap(first_free, other.first_free);
+                return *this;
+            }
+
+            ~EntityPool()
+            {
+                ASSERT(num_allocated == 0, "Entities: Internal error: Destroying a pool with live entities in it.");
+            }
+
+            [[nodiscard]] bool IsNull() const {return elem_size == 0;}
+
+            // The total number of slots, including the occupied ones.
+            [[nodiscard]] std::size_t Capacity() const {return capacity;}
+            // The number of occupied slots.
+            [[nodiscard]] std::size_t NumAllocated() const {return num_allocated;}
+
+            // Makes sure there are at least `n` slots in total, allocating at most one new slab.
+            void Reserve(std::size_t n)
+            {
+                if (n > capacity)
+                    AddSlab(n - capacity);
+            }
+
+            // Returns uninitialized memory for one element.
+            [[nodiscard]] void *Allocate()
+            {
+                if (!first_free)
+                    AddSlab(std::clamp(capacity, std::size_t(16), max_slab_elems));
+                FreeSlot *ret = first_free;
+                first_free = ret->next;
+                num_allocated++;
+                return ret;
+            }
+
+            // Returns the memory obtained from `Allocate()` back to the pool.
+            void Deallocate(void *ptr) noexcept
+            {
+                ASSERT(num_allocated > 0, "Entities: Internal error: Pool deallocation without a matching allocation.");
+                first_free = ::new(ptr) FreeSlot{first_free};
+                num_allocated--;
+            }
+        };
+    }
+
 
     // Lists:
 
@@ -222,6 +374,24 @@ namespace Ent
         virtual void Erase(typename Tag::Entity &entity) noexcept = 0;
         // Return any entity in the list, or null if none.
         [[nodiscard]] virtual typename Tag::Entity *AnyEntity() noexcept = 0;
+
+        // Inserts several entities at once. If this throws, none of them must remain in the list.
+        // The entities are in the order of creation. Override this if the container can do it faster than one by one.
+        virtual void InsertMany(std::span<typename Tag::Entity *const> entities)
+        {
+            std::size_t i = 0;
+            try
+            {
+                for (; i < entities.size(); i++)
+                    Insert(*entities[i]);
+            }
+            catch (...)
+            {
+                while (i-- > 0)
+                    Erase(*entities[i]);
+                throw;
+            }
+        }
     };
 
     // Entity lists add this as a friend.
@@ -351,6 +521,8 @@ namespace Ent
       public:
         struct Desc
         {
+            // The category type name, for debugging and profiling.
+            std::string_view name;
             // Constructs a list for this category.
             std::unique_ptr<ListBase<Tag>> (*make_list)() = nullptr;
             // Checks if an entity belongs in the list.
@@ -388,6 +560,7 @@ namespace Ent
                     throw std::runtime_error("Entities: Internal error: Attempt to register a category too late.\nMake sure any global controllers are null by default, and are initialized later.");
                 int ret = Count();
                 state.descs.push_back({
+                    .name = Meta::TypeName<T>(),
                     .make_list = []() -> std::unique_ptr<ListBase<Tag>>
                     {
                         // `ListFriend::Cast` can't throw so this should be ok.
@@ -447,13 +620,14 @@ namespace Ent
 
             class Controller;
             class Entity;
+            class CommandBuffer;
 
             // Each entity gets an incremental ID of this type.
             // This is mostly a customization point. User code will use `Id` instead.
             // Inside of this class, use `typename Tag::entity_id_underlying_t` to refer to this type, to allow derived classes to override this.
             using entity_id_underlying_t = unsigned int;
 
-            // Stores unique entity IDs. Those are never reused.
+            // Stores unique entity IDs. Those are never reused, unless a mixin customizes them (see `Controller::AcquireEntityId()`).
             class Id
             {
                 friend Entity;
@@ -547,6 +721,9 @@ namespace Ent
                 // Mostly for internal use.
                 // A list of category indices this entity belongs to.
                 [[nodiscard]] virtual const std::vector<int> &EntityCategoryIndices() const = 0;
+                // Mostly for internal use.
+                // The index of the most-derived entity type, from `EntityTypeRegistry`.
+                [[nodiscard]] virtual int EntityTypeIndex() const = 0;
             };
 
             // A helper class that stores an id, and can be constructed either from an entity or from an id.
@@ -578,18 +755,148 @@ namespace Ent
                 {
                     return EntityCategories<Tag, E>();
                 }
+
+                int EntityTypeIndex() const override
+                {
+                    return EntityTypeRegistry<Tag>::template Type<E>::index;
+                }
             };
 
             // An entity controller.
             class Controller
             {
+                friend CommandBuffer;
+
                 struct State
                 {
                     std::vector<std::unique_ptr<ListBase<Tag>>> lists;
+                    // Indexed by `EntityTypeRegistry`. Some of those can be null, if no entities of that type were created yet.
+                    std::vector<impl::EntityPool> pools;
                     typename Tag::entity_id_underlying_t id_counter = 1; // `0` is for null entity IDs.
                 };
                 State state;
 
+                // Returns the memory pool for entities of this type, creating it if necessary.
+                // Don't keep the reference across entity creation, since it can be invalidated.
+                template <EntityType<Tag> E>
+                [[nodiscard]] impl::EntityPool &GetPool()
+                {
+                    using full_entity_t = typename Tag::template FullEntity<E>;
+                    std::size_t index = std::size_t(EntityTypeRegistry<Tag>::template Type<E>::index);
+                    if (index >= state.pools.size())
+                        state.pools.resize(std::size_t(EntityTypeRegistry<Tag>::Count()));
+                    impl::EntityPool &pool = state.pools[index];
+                    if (pool.IsNull())
+                        pool = impl::EntityPool(sizeof(full_entity_t), alignof(full_entity_t));
+                    return pool;
+                }
+
+                // Allocates and constructs an entity, and assigns an ID to it. Doesn't add it to the lists.
+                template <EntityType<Tag> E, typename ...P>
+                [[nodiscard]] typename Tag::template FullEntity<E> *ConstructEntityLow(P &&... params)
+                {
+                    using full_entity_t = typename Tag::template FullEntity<E>;
+                    static_assert(std::derived_from<full_entity_t, Entity>, "Do not inherit from `Entity` manually.");
+
+                    // Entities of the same type are allocated from the same pool, to reduce the allocation costs and to keep them close in memory.
+                    void *memory = GetPool<E>().Allocate();
+                    full_entity_t *ret = nullptr;
+                    try
+                    {
+                        ret = ::new(memory) full_entity_t(std::forward<P>(params)...);
+                    }
+                    catch (...)
+                    {
+                        GetPool<E>().Deallocate(memory);
+                        throw;
+                    }
+
+                    // Assign a unique id.
+                    // This has to be done before inserting to the lists, since they can use it.
+                    // Note: not `typename Tag::Entity`, we don't want anybody to override the id member.
+                    try
+                    {
+                        static_cast<Entity &>(*ret).entity_id = static_cast<typename Tag::Controller &>(*this).AcquireEntityId(*ret);
+                    }
+                    catch (...)
+                    {
+                        std::destroy_at(ret);
+                        GetPool<E>().Deallocate(memory);
+                        throw;
+                    }
+                    return ret;
+                }
+
+                // Destroys and deallocates an entity. Doesn't remove it from the lists.
+                void FreeEntityLow(typename Tag::Entity &entity) noexcept
+                {
+                    // `Entity` always has a virtual destructor, but a component might not have one.
+                    // `dynamic_cast<void *>` gives us the address of the most-derived object, which is what the pool has allocated.
+                    void *memory = dynamic_cast<void *>(&entity);
+                    std::size_t type_index = std::size_t(entity.EntityTypeIndex());
+                    static_cast<typename Tag::Controller &>(*this).ReleaseEntityId(entity);
+                    std::destroy_at(&entity);
+                    state.pools[type_index].Deallocate(memory);
+                }
+
+                // Calls the mixin callback for a newly created entity. This is stored as a function pointer in `CommandBuffer`.
+                template <EntityType<Tag> E>
+                static void RunOnEntityCreatedLow(Controller &self, typename Tag::Entity &entity)
+                {
+                    static_cast<typename Tag::Controller &>(self).OnEntityCreated(static_cast<typename Tag::template FullEntity<E> &>(entity));
+                }
+
+                // Inserts the newly constructed entities into the lists, in bulk.
+                // `entities_for_list` is `(std::size_t list_index) -> std::span<Entity *const>`, it returns the entities for that list, in the order of creation.
+                // If this throws, the entities are removed from the lists and freed.
+                void InsertManyLow(std::span<typename Tag::Entity *const> entities, auto &&entities_for_list)
+                {
+                    std::size_t list_index = 0;
+                    try
+                    {
+                        for (; list_index < state.lists.size(); list_index++)
+                        {
+                            std::span<typename Tag::Entity *const> list_entities = entities_for_list(list_index);
+                            if (!list_entities.empty())
+                                state.lists[list_index]->InsertMany(list_entities);
+                        }
+                    }
+                    catch (...)
+                    {
+                        while (list_index-- > 0)
+                        {
+                            for (typename Tag::Entity *entity : entities_for_list(list_index))
+                                state.lists[list_index]->Erase(*entity);
+                        }
+                        for (typename Tag::Entity *entity : entities)
+                            FreeEntityLow(*entity);
+                        throw;
+                    }
+                }
+
+                // Runs `on_created(std::size_t index, Entity &entity)` for every new entity, which should in turn call `OnEntityCreated()`.
+                // If one throws, destroys that entity and all the following ones, without running their destruction callbacks, like `create()` does.
+                void RunCreationCallbacksLow(std::span<typename Tag::Entity *const> entities, auto &&on_created)
+                {
+                    std::size_t entity_index = 0;
+                    try
+                    {
+                        for (; entity_index < entities.size(); entity_index++)
+                            on_created(entity_index, *entities[entity_index]);
+                    }
+                    catch (...)
+                    {
+                        for (; entity_index < entities.size(); entity_index++)
+                        {
+                            typename Tag::Entity &entity = *entities[entity_index];
+                            for (int list_index : entity.EntityCategoryIndices())
+                                state.lists[std::size_t(list_index)]->Erase(entity);
+                            FreeEntityLow(entity);
+                        }
+                        throw;
+                    }
+                }
+
               public:
                 // Makes a null controller.
                 constexpr Controller() {}
@@ -637,20 +944,48 @@ namespace Ent
                 template <EntityType<Tag> E> void OnEntityCreated(typename Tag::template FullEntity<E> &e) {(void)e;}
                 void OnEntityDestroyed(Entity &e) {(void)e;}
 
+                // Those are for the mixin authors too.
+                // They give out the IDs and take them back. An ID must be nonzero, and unique among the live entities.
+                // The ID is acquired before the entity is inserted to the lists, and released after it's erased from them.
+                // By default the IDs are incremental and never reused.
+                [[nodiscard]] typename Tag::entity_id_underlying_t AcquireEntityId(Entity &e) {(void)e; return state.id_counter++;}
+                void ReleaseEntityId(Entity &e) noexcept {(void)e;}
+
+                // The next ID the default `AcquireEntityId()` will return. This is for the mixins that save and restore the whole state.
+                [[nodiscard]] typename Tag::entity_id_underlying_t NextEntityIdLow() const {return state.id_counter;}
+                void SetNextEntityIdLow(typename Tag::entity_id_underlying_t value) {state.id_counter = value;}
+
               public:
+                // Preallocates memory for at least `n` entities of type `E` in total (including the existing ones).
+                // This is only a hint, the memory is allocated on demand anyway.
+                // Use this before spawning many entities of the same type at once.
+                template <EntityType<Tag> E>
+                void reserve(std::size_t n)
+                {
+                    ThrowIfNull();
+                    GetPool<E>().Reserve(n);
+                }
+
+                // How many entities of type `E` can exist at the same time without allocating more memory.
+                template <EntityType<Tag> E>
+                [[nodiscard]] std::size_t capacity() const
+                {
+                    std::size_t index = std::size_t(EntityTypeRegistry<Tag>::template Type<E>::index);
+                    return index < state.pools.size() ? state.pools[index].Capacity() : 0;
+                }
+
                 // Create an entity in this controller.
                 template <EntityType<Tag> E, typename ...P>
                 requires std::constructible_from<typename Tag::template FullEntity<E>, P &&...>
                 typename Tag::template FullEntity<E> &create(P &&... params)
                 {
                     ThrowIfNull();
-                    using full_entity_t = typename Tag::template FullEntity<E>;
-                    static_assert(std::derived_from<full_entity_t, Entity>, "Do not inherit from `Entity` manually.");
+                    IMP_ALLOC_SCOPE("entities");
 
                     const auto &categories = EntityCategories<Tag, E>();
 
                     // Make the entity.
-                    full_entity_t *ret = new full_entity_t(std::forward<P>(params)...);
+                    auto *ret = ConstructEntityLow<E>(std::forward<P>(params)...);
 
                     // Construct a guard.
                     std::size_t category_index = 0;
@@ -658,7 +993,7 @@ namespace Ent
                     {
                         while (category_index-- > 0)
                             state.lists[categories[category_index]]->Erase(*ret);
-                        delete ret;
+                        FreeEntityLow(*ret);
                     };
                     struct Guard
                     {
@@ -667,11 +1002,6 @@ namespace Ent
                     };
                     Guard guard{&HandleException};
 
-                    // Assign a unique id.
-                    // This has to be done before inserting to the lists, since they can use it.
-                    // Note: not `typename Tag::Entity`, we don't want anybody to override the id member.
-                    static_cast<Entity &>(*ret).entity_id = state.id_counter++;
-
                     // Insert the entity to lists. This part can throw.
                     for (; category_index < categories.size(); category_index++)
                         state.lists[categories[category_index]]->Insert(*ret);
@@ -684,6 +1014,63 @@ namespace Ent
                     return *ret;
                 }
 
+                // Creates `n` entities of type `E` at once, default-constructing them and then calling `init(e, i)` for each,
+                //   where `e` is `FullEntity<E> &`, and `i` is the index from 0 to `n-1`. This happens before they're added to the lists.
+                // This is faster than calling `create()` repeatedly: the memory is reserved in advance,
+                //   and each list receives all entities in a single `InsertMany()` call.
+                // If `init` or a constructor throws, none of the entities are created.
+                // If a creation callback throws, the entities before it remain.
+                template <EntityType<Tag> E, typename F>
+                requires std::default_initializable<typename Tag::template FullEntity<E>> && std::invocable<F &, typename Tag::template FullEntity<E> &, std::size_t>
+                void create_many(std::size_t n, F &&init)
+                {
+                    ThrowIfNull();
+                    IMP_ALLOC_SCOPE("entities");
+                    using full_entity_t = typename Tag::template FullEntity<E>;
+
+                    if (n == 0)
+                        return;
+
+                    {
+                        impl::EntityPool &pool = GetPool<E>();
+                        pool.Reserve(pool.NumAllocated() + n);
+                    }
+
+                    std::vector<typename Tag::Entity *> entities;
+                    entities.reserve(n);
+                    try
+                    {
+                        for (std::size_t i = 0; i < n; i++)
+                        {
+                            full_entity_t *entity = ConstructEntityLow<E>();
+                            entities.push_back(entity); // Can't throw because of `reserve()`.
+                            init(*entity, std::as_const(i));
+                        }
+                    }
+                    catch (...)
+                    {
+                        for (typename Tag::Entity *entity : entities)
+                            FreeEntityLow(*entity);
+                        throw;
+                    }
+
+                    // All of them go to the same lists.
+                    InsertManyLow(entities, [&](std::size_t list_index) -> std::span<typename Tag::Entity *const>
+                    {
+                        const auto &categories = EntityCategories<Tag, E>();
+                        if (std::binary_search(categories.begin(), categories.end(), int(list_index)))
+                            return entities;
+                        else
+                            return {};
+                    });
+
+                    RunCreationCallbacksLow(entities, [&](std::size_t index, typename Tag::Entity &entity)
+                    {
+                        (void)index;
+                        RunOnEntityCreatedLow<E>(*this, entity);
+                    });
+                }
+
                 // Destroy an entity in this controller.
                 template <typename E>
                 requires (EntityType<E, Tag> || Component<E, Tag> || std::same_as<E, typename Tag::Entity>) && std::is_polymorphic_v<E>
@@ -698,8 +1085,7 @@ namespace Ent
                     for (int list_index : categories)
                         state.lists[list_index]->Erase(entity);
                     // Destroy the entity.
-                    // `Entity` always has a virtual destructor, but a component might not have one.
-                    delete &entity;
+                    FreeEntityLow(entity);
                 }
 
                 // Return an entity category.
@@ -716,6 +1102,66 @@ namespace Ent
                     return const_cast<Controller *>(this)->get<Cat>();
                 }
 
+                // Calls `func(const Entity &e, Comp &...comps)` for every entity in the category, splitting them into jobs for `pool` (see `utils/jobs.h`).
+                // The callback receives the entity as const, and mutable references only to the listed components of that entity,
+                //   so the entities don't compete for the same data (unless you `const_cast` or touch other entities or global state).
+                // Don't create or destroy entities from the callback, use a `CommandBuffer` per thread for that.
+                // Each job gets at least `min_chunk_size` entities (unless there are fewer), increase it if the callback is very cheap.
+                // The lists exposing contiguous `entities()` (such as `DenseColumn`) are split by index, other lists are split
+                //   into ranges of equal length by walking the iterators once. Single-entity lists just run on the current thread.
+                // The jobs are balanced by work stealing. Blocks until all of them finish, running them on this thread too.
+                // If anything throws, waits for all jobs to finish, then rethrows the first exception.
+                template <UnpreparedEntityCategory<Tag> Cat, Component<Tag> ...Comp, typename F>
+                requires std::invocable<F &, const typename Tag::Entity &, Comp &...>
+                void parallel_for_each(F &&func, std::size_t min_chunk_size = 64, Jobs::ThreadPool &pool = Jobs::GlobalPool())
+                {
+                    auto &list = get<Cat>();
+
+                    auto Call = [&](typename Tag::Entity &entity)
+                    {
+                        func(std::as_const(entity), entity.template get<Comp>()...);
+                    };
+
+                    if constexpr (requires{list.get_opt();})
+                    {
+                        if (auto *elem = list.get_opt())
+                            Call(dynamic_cast<typename Tag::Entity &>(*elem));
+                        return;
+                    }
+                    else if constexpr (requires{list.entities();})
+                    {
+                        auto entities = list.entities();
+                        Jobs::ParallelFor(pool, 0, entities.size(), [&](std::size_t i){Call(*entities[i]);}, min_chunk_size);
+                    }
+                    else
+                    {
+                        // Same number of ranges as `Jobs::ParallelFor()` would make, since we can't split the ranges further.
+                        std::size_t size = std::size_t(list.size());
+                        std::size_t num_ranges = std::clamp(size / std::max(min_chunk_size, std::size_t(1)), std::size_t(1), std::size_t(pool.Concurrency()) * 4);
+
+                        // Find the iterators at the range boundaries.
+                        using iter_t = decltype(list.begin());
+                        std::vector<iter_t> bounds;
+                        bounds.reserve(num_ranges + 1);
+                        iter_t iter = list.begin();
+                        std::size_t pos = 0;
+                        for (std::size_t i = 0; i < num_ranges; i++)
+                        {
+                            std::size_t target = size * i / num_ranges;
+                            for (; pos < target; pos++)
+                                ++iter;
+                            bounds.push_back(iter);
+                        }
+                        bounds.push_back(list.end());
+
+                        Jobs::ParallelFor(pool, 0, num_ranges, [&](std::size_t range_index)
+                        {
+                            for (iter_t it = bounds[range_index]; it != bounds[range_index + 1]; ++it)
+                                Call(*it);
+                        });
+                    }
+                }
+
                 // Destroys all entities in the controller.
                 void DestroyAllEntities()
                 {
@@ -728,6 +1174,144 @@ namespace Ent
                     }
                 }
             };
+
+            // Records entity creations and destructions, to be applied to a controller later with `Flush()`.
+            // This lets you create and destroy entities while iterating over the entity lists.
+            // Reuse the same buffer between the flushes, to preserve its capacity.
+            class CommandBuffer
+            {
+                struct Creation
+                {
+                    // Constructs the entity and assigns the ID, but doesn't insert it to the lists.
+                    std::function<typename Tag::Entity *(Controller &controller)> construct;
+                    // Runs the mixin callbacks.
+                    void (*on_created)(Controller &controller, typename Tag::Entity &entity) = nullptr;
+                };
+
+                std::vector<Creation> creations;
+                std::vector<typename Tag::Entity *> destructions;
+
+                // Those are reused between the flushes.
+                std::vector<typename Tag::Entity *> new_entities;
+                std::vector<std::vector<typename Tag::Entity *>> new_entities_per_list;
+
+              public:
+                CommandBuffer() {}
+
+                [[nodiscard]] bool empty() const {return creations.empty() && destructions.empty();}
+
+                // Drops all recorded commands.
+                void clear()
+                {
+                    creations.clear();
+                    destructions.clear();
+                }
+
+                // Records an entity creation. The parameters are copied or moved into the buffer, and are passed as rvalues to the constructor.
+                template <EntityType<Tag> E, typename ...P>
+                requires std::constructible_from<typename Tag::template FullEntity<E>, std::decay_t<P> &&...>
+                void create(P &&... params)
+                {
+                    creations.push_back({
+                        .construct = Meta::fake_copyable([...params = std::forward<P>(params)](Controller &controller) mutable -> typename Tag::Entity *
+                        {
+                            return controller.template ConstructEntityLow<E>(std::move(params)...);
+                        }),
+                        .on_created = &Controller::template RunOnEntityCreatedLow<E>,
+                    });
+                }
+
+                // Records an entity destruction. Destroying the same entity several times is allowed.
+                // The entity must not be destroyed by other means before the flush.
+                template <typename E>
+                requires (EntityType<E, Tag> || Component<E, Tag> || std::same_as<E, typename Tag::Entity>) && std::is_polymorphic_v<E>
+                void destroy(E &entity_or_component)
+                {
+                    destructions.push_back(&dynamic_cast<typename Tag::Entity &>(entity_or_component));
+                }
+
+                // Applies the recorded commands to the controller, and clears the buffer.
+                // First destroys the entities, then creates the new ones. The new entities are inserted into each list in bulk.
+                // The commands recorded during the flush (e.g. from the entity callbacks) are kept for the next flush.
+                // If a constructor throws, none of the new entities are created. If a creation callback throws, the entities before it remain.
+                void Flush(typename Tag::Controller &derived_controller)
+                {
+                    Controller &controller = derived_controller;
+                    controller.ThrowIfNull();
+
+                    // Move everything out, so that the callbacks can record new commands, or even flush this buffer recursively.
+                    // The guard gives back the memory when we're done, unless the vectors were reused in the meantime.
+                    struct Guard
+                    {
+                        CommandBuffer &self;
+                        std::vector<Creation> cur_creations = std::exchange(self.creations, {});
+                        std::vector<typename Tag::Entity *> cur_destructions = std::exchange(self.destructions, {});
+                        std::vector<typename Tag::Entity *> new_entities = std::exchange(self.new_entities, {});
+                        std::vector<std::vector<typename Tag::Entity *>> new_entities_per_list = std::exchange(self.new_entities_per_list, {});
+
+                        ~Guard()
+                        {
+                            cur_creations.clear();
+                            cur_destructions.clear();
+                            if (self.creations.empty())
+                                std::swap(self.creations, cur_creations);
+                            if (self.destructions.empty())
+                                std::swap(self.destructions, cur_destructions);
+                            std::swap(self.new_entities, new_entities);
+                            std::swap(self.new_entities_per_list, new_entities_per_list);
+                        }
+                    };
+                    Guard guard{*this};
+                    std::vector<Creation> &cur_creations = guard.cur_creations;
+                    std::vector<typename Tag::Entity *> &cur_destructions = guard.cur_destructions;
+                    std::vector<typename Tag::Entity *> &new_entities = guard.new_entities;
+                    std::vector<std::vector<typename Tag::Entity *>> &new_entities_per_list = guard.new_entities_per_list;
+
+                    // Destroy.
+                    std::sort(cur_destructions.begin(), cur_destructions.end());
+                    cur_destructions.erase(std::unique(cur_destructions.begin(), cur_destructions.end()), cur_destructions.end());
+                    for (typename Tag::Entity *entity : cur_destructions)
+                        controller.destroy(*entity);
+
+                    if (cur_creations.empty())
+                        return;
+
+                    // Construct, and sort by lists.
+                    new_entities.clear();
+                    new_entities.reserve(cur_creations.size());
+                    new_entities_per_list.resize(controller.state.lists.size());
+                    for (auto &list : new_entities_per_list)
+                        list.clear();
+                    try
+                    {
+                        for (Creation &creation : cur_creations)
+                            new_entities.push_back(creation.construct(controller)); // Can't throw after constructing because of `reserve()`.
+                        for (typename Tag::Entity *entity : new_entities)
+                        {
+                            for (int list_index : entity->EntityCategoryIndices())
+                                new_entities_per_list[std::size_t(list_index)].push_back(entity);
+                        }
+                    }
+                    catch (...)
+                    {
+                        for (typename Tag::Entity *entity : new_entities)
+                            controller.FreeEntityLow(*entity);
+                        throw;
+                    }
+
+                    // Insert into the lists.
+                    controller.InsertManyLow(new_entities, [&](std::size_t list_index) -> std::span<typename Tag::Entity *const>
+                    {
+                        return new_entities_per_list[list_index];
+                    });
+
+                    // Run the callbacks.
+                    controller.RunCreationCallbacksLow(new_entities, [&](std::size_t index, typename Tag::Entity &entity)
+                    {
+                        cur_creations[index].on_created(controller, entity);
+                    });
+                }
+            };
         };
 
         template <typename Tag>
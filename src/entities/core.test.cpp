@@ -0,0 +1,543 @@
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+#include <entities/complete.h>
+#include <reflection/short_macros.h>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    struct Game : Ent::BasicTag<Game, Ent::Mixins::GlobalEntityLists> {};
+
+    struct Bullet
+    {
+        IMP_STANDALONE_COMPONENT(Game)
+
+        int value = 0;
+
+        Bullet() {}
+        Bullet(int value) : value(value)
+        {
+            if (value < 0)
+                throw std::runtime_error("Bad bullet!");
+        }
+        virtual ~Bullet() = default;
+    };
+
+    struct alignas(64) BigParticle
+    {
+        IMP_STANDALONE_COMPONENT(Game)
+
+        char data[100]{};
+    };
+
+    struct Game2 : Ent::BasicTag<Game2, Ent::Mixins::GenerationalEntityIds, Ent::Mixins::GlobalEntityLists> {};
+
+    struct Particle
+    {
+        IMP_STANDALONE_COMPONENT(Game2)
+
+        int value = 0;
+
+        Particle(int value) : value(value) {}
+        virtual ~Particle() = default;
+    };
+
+    struct Game3 : Ent::BasicTag<Game3, Ent::Mixins::ChangeTracking, Ent::Mixins::GlobalEntityLists> {};
+
+    struct Transform
+    {
+        IMP_COMPONENT(Game3)
+        int pos = 0;
+    };
+    struct Sprite
+    {
+        IMP_COMPONENT(Game3)
+        int frame = 0;
+    };
+    struct Actor : Transform, Sprite
+    {
+        virtual ~Actor() = default;
+    };
+
+    struct Game4 : Ent::BasicTag<Game4, Ent::Mixins::Snapshots, Ent::Mixins::GlobalEntityLists> {};
+
+    struct Position
+    {
+        IMP_COMPONENT(Game4)
+        int x = 0, y = 0;
+    };
+    struct Name
+    {
+        IMP_COMPONENT(Game4)
+        MEMBERS( DECL(std::string) name )
+    };
+    struct Player : Position, Name
+    {
+        virtual ~Player() = default;
+    };
+    struct Rock : Position
+    {
+        virtual ~Rock() = default;
+    };
+
+    struct Hitbox;
+    struct Game6 : Ent::BasicTag<Game6, Ent::Mixins::SpatialIndex, Ent::Mixins::ChangeTracking, Ent::Mixins::GlobalEntityLists>
+    {
+        using spatial_index_component = Hitbox;
+    };
+
+    struct Hitbox
+    {
+        IMP_COMPONENT(Game6)
+        irect2 rect;
+        [[nodiscard]] irect2 spatial_aabb() const {return rect;}
+    };
+    struct Crate : Hitbox
+    {
+        Crate(ivec2 pos) {rect = pos.rect_size(2);}
+        virtual ~Crate() = default;
+    };
+    struct Marker
+    {
+        IMP_STANDALONE_COMPONENT(Game6)
+        int value = 0;
+        virtual ~Marker() = default;
+    };
+
+    struct Game5 : Ent::BasicTag<Game5, Ent::Mixins::Profiling, Ent::Mixins::EntityCallbacks, Ent::Mixins::GlobalEntityLists> {};
+
+    struct Spark
+    {
+        IMP_STANDALONE_COMPONENT(Game5)
+        int inits = 0;
+
+      private:
+        void _init(Game5::Controller &c, Game5::Entity &e) {(void)c; (void)e; inits++;}
+    };
+}
+
+TEST_CASE("entities.pool")
+{
+    Game::Controller game = nullptr;
+    REQUIRE(game.capacity<Bullet>() == 0);
+
+    game.reserve<Bullet>(100);
+    REQUIRE(game.capacity<Bullet>() >= 100);
+    std::size_t reserved = game.capacity<Bullet>();
+
+    // Create and destroy, make sure the memory is reused.
+    std::vector<Bullet *> bullets;
+    std::set<void *> addresses;
+    for (int i = 0; i < 100; i++)
+    {
+        bullets.push_back(&game.create<Bullet>(i));
+        addresses.insert(bullets.back());
+    }
+    REQUIRE(game.capacity<Bullet>() == reserved);
+    REQUIRE(game.get<Game::AllEntitiesUnordered>().size() == 100);
+
+    for (int i = 0; i < 100; i += 2)
+        game.destroy(*bullets[std::size_t(i)]);
+    for (int i = 0; i < 50; i++)
+        REQUIRE(addresses.contains(static_cast<Bullet *>(&game.create<Bullet>(i))));
+    REQUIRE(game.capacity<Bullet>() == reserved);
+
+    // A throwing constructor doesn't leak the slot.
+    REQUIRE_THROWS(game.create<Bullet>(-1));
+    REQUIRE(game.get<Game::AllEntitiesUnordered>().size() == 100);
+
+    // Over-aligned entities.
+    for (int i = 0; i < 50; i++)
+    {
+        auto &p = game.create<BigParticle>();
+        REQUIRE(reinterpret_cast<std::uintptr_t>(&p) % alignof(BigParticle) == 0);
+    }
+    REQUIRE(game.capacity<BigParticle>() >= 50);
+    REQUIRE(game.get<Game::AllEntitiesUnordered>().size() == 150);
+
+    // Destroying entities keeps the memory.
+    std::size_t capacity = game.capacity<Bullet>();
+    game.DestroyAllEntities();
+    REQUIRE(game.get<Game::AllEntitiesUnordered>().size() == 0);
+    REQUIRE(game.capacity<Bullet>() == capacity);
+}
+
+TEST_CASE("entities.command_buffer")
+{
+    Game::Controller game = nullptr;
+    Game::CommandBuffer buffer;
+    REQUIRE(buffer.empty());
+
+    for (int i = 0; i < 10; i++)
+        game.create<Bullet>(i);
+
+    // Destroy the odd bullets and clone the even ones while iterating.
+    for (auto &e : game.get<Game::AllEntitiesOrdered>())
+    {
+        auto &bullet = e.get<Bullet>();
+        if (bullet.value % 2)
+        {
+            buffer.destroy(bullet);
+            buffer.destroy(e); // Duplicates are allowed.
+        }
+        else
+        {
+            buffer.create<Bullet>(bullet.value + 100);
+        }
+    }
+    REQUIRE(!buffer.empty());
+    REQUIRE(game.get<Game::AllEntitiesUnordered>().size() == 10);
+
+    buffer.Flush(game);
+    REQUIRE(buffer.empty());
+
+    std::vector<int> values;
+    for (auto &e : game.get<Game::AllEntitiesOrdered>())
+        values.push_back(e.get<Bullet>().value);
+    REQUIRE(values == std::vector<int>{0, 2, 4, 6, 8, 100, 102, 104, 106, 108});
+
+    // If a constructor throws, nothing is created.
+    buffer.create<Bullet>(42);
+    buffer.create<Bullet>(-1);
+    REQUIRE_THROWS(buffer.Flush(game));
+    REQUIRE(buffer.empty());
+    REQUIRE(game.get<Game::AllEntitiesUnordered>().size() == 10);
+}
+
+TEST_CASE("entities.dense_ordered_list")
+{
+    using DenseBullets = Game::Category<Ent::DenseOrderedList, Bullet>;
+
+    Game::Controller game = nullptr;
+    std::vector<Game::Entity *> bullets;
+    for (int i = 0; i < 100; i++)
+        bullets.push_back(&game.create<Bullet>(i));
+
+    Game::Id destroyed_id = bullets[14]->id();
+
+    // Destroy most of them, to trigger the compaction.
+    for (int i = 0; i < 100; i++)
+    {
+        if (i % 10 != 3)
+            game.destroy(*bullets[std::size_t(i)]);
+    }
+    for (int i = 0; i < 5; i++)
+        game.create<Bullet>(100 + i);
+
+    auto &list = game.get<DenseBullets>();
+    REQUIRE(list.size() == 15);
+
+    std::vector<int> values, expected_values;
+    for (auto &e : list)
+        values.push_back(e.get<Bullet>().value);
+    for (auto &e : game.get<Game::AllEntitiesOrdered>())
+        expected_values.push_back(e.get<Bullet>().value);
+    REQUIRE(values == expected_values);
+    REQUIRE(values.front() == 3);
+    REQUIRE(values.back() == 104);
+
+    REQUIRE(&list.entity_with_id(bullets[13]->id()) == bullets[13]);
+    REQUIRE(!list.has_entity_with_id(destroyed_id));
+}
+
+TEST_CASE("entities.dense_column")
+{
+    using BulletPositions = Game::Category<Ent::DenseColumn<int>, Bullet>;
+
+    Game::Controller game = nullptr;
+    auto &list = game.get<BulletPositions>();
+
+    std::vector<Game::Entity *> bullets;
+    for (int i = 0; i < 10; i++)
+    {
+        auto &bullet = game.create<Bullet>(i);
+        bullets.push_back(&bullet);
+        REQUIRE(list.at(bullet) == 0);
+        list.at(bullet) = i * 10;
+    }
+    REQUIRE(list.size() == 10);
+
+    for (int &value : list.values())
+        value++;
+
+    for (int i = 0; i < 10; i += 3)
+        game.destroy(*bullets[std::size_t(i)]);
+    REQUIRE(list.size() == 6);
+
+    for (std::size_t i = 0; i < list.values().size(); i++)
+        REQUIRE(list.values()[i] == list.entities()[i]->get<Bullet>().value * 10 + 1);
+    for (auto &e : list)
+        REQUIRE(list.at(e) == e.get<Bullet>().value * 10 + 1);
+    REQUIRE(list.get_opt(*bullets[0]) == nullptr);
+}
+
+TEST_CASE("entities.parallel_for_each")
+{
+    using BulletPositions = Game::Category<Ent::DenseColumn<int>, Bullet>;
+
+    Jobs::ThreadPool pool(3);
+
+    Game::Controller game = nullptr;
+    for (int i = 0; i < 1000; i++)
+        game.create<Bullet>(i);
+
+    int pass = 0;
+    for (std::size_t min_chunk_size : {1, 7, 2000})
+    {
+        pass++;
+        game.parallel_for_each<Game::AllEntitiesOrdered, Bullet>([](const Game::Entity &e, Bullet &bullet)
+        {
+            (void)e;
+            bullet.value++;
+        }, min_chunk_size, pool);
+
+        std::atomic<int> sum = 0;
+        game.parallel_for_each<BulletPositions>([&](const Game::Entity &e)
+        {
+            sum += e.get<Bullet>().value;
+        }, min_chunk_size, pool);
+        REQUIRE(sum == 1000 * 999 / 2 + 1000 * pass);
+    }
+
+    REQUIRE_THROWS(game.parallel_for_each<Game::AllEntitiesUnordered>([](const Game::Entity &e)
+    {
+        if (e.get<Bullet>().value == 500)
+            throw std::runtime_error("Bad bullet!");
+    }, 4, pool));
+}
+
+TEST_CASE("entities.generational_ids")
+{
+    Game2::Controller game = nullptr;
+
+    std::vector<Game2::Id> ids;
+    for (int i = 0; i < 10; i++)
+        ids.push_back(game.create<Particle>(i).id());
+
+    for (int i = 0; i < 10; i++)
+    {
+        REQUIRE(game.valid(ids[std::size_t(i)]));
+        REQUIRE(game.get(ids[std::size_t(i)]).get<Particle>().value == i);
+    }
+    REQUIRE(!game.valid(nullptr));
+    REQUIRE(game.get_opt(nullptr) == nullptr);
+
+    // The slots are reused, but the stale IDs are detected.
+    game.destroy(game.get(ids[3]));
+    REQUIRE(!game.valid(ids[3]));
+    REQUIRE(game.get_opt(ids[3]) == nullptr);
+    REQUIRE_THROWS(game.get(ids[3]));
+
+    Game2::Id new_id = game.create<Particle>(42).id();
+    REQUIRE(new_id != ids[3]);
+    REQUIRE((new_id.get_value() & 0xffffffff) == (ids[3].get_value() & 0xffffffff));
+    REQUIRE(!game.valid(ids[3]));
+    REQUIRE(game.get(new_id).get<Particle>().value == 42);
+    REQUIRE(game.get<Game2::AllEntitiesUnordered>().size() == 10);
+
+    // Moving the controller keeps the IDs.
+    Game2::Controller other = std::move(game);
+    REQUIRE(other.valid(new_id));
+    REQUIRE(!game);
+    game = std::move(other);
+    REQUIRE(game.valid(new_id));
+}
+
+TEST_CASE("entities.create_many")
+{
+    using BulletPositions = Game::Category<Ent::DenseColumn<int>, Bullet>;
+
+    Game::Controller game = nullptr;
+    game.create_many<Bullet>(100, [](Game::FullEntity<Bullet> &bullet, std::size_t i)
+    {
+        bullet.value = int(i);
+    });
+    REQUIRE(game.get<Game::AllEntitiesUnordered>().size() == 100);
+    REQUIRE(game.get<BulletPositions>().size() == 100);
+    REQUIRE(game.capacity<Bullet>() >= 100);
+
+    int i = 0;
+    for (auto &e : game.get<Game::AllEntitiesOrdered>())
+        REQUIRE(e.get<Bullet>().value == i++);
+
+    // If `init` throws, nothing is created.
+    REQUIRE_THROWS(game.create_many<Bullet>(10, [](Game::FullEntity<Bullet> &bullet, std::size_t i)
+    {
+        (void)bullet;
+        if (i == 5)
+            throw std::runtime_error("Bad bullet!");
+    }));
+    REQUIRE(game.get<Game::AllEntitiesUnordered>().size() == 100);
+    REQUIRE(game.get<BulletPositions>().size() == 100);
+}
+
+TEST_CASE("entities.change_tracking")
+{
+    Game3::Controller game = nullptr;
+
+    std::vector<Game3::Entity *> actors;
+    for (int i = 0; i < 200; i++)
+        actors.push_back(&game.create<Actor>());
+
+    REQUIRE(game.num_dirty<Transform>() == 0);
+    game.mark_dirty<Transform>(*actors[5]);
+    game.mark_dirty<Transform>(*actors[150]);
+    game.mark_dirty<Transform>(*actors[5]);
+    game.mark_dirty<Sprite>(*actors[7]);
+    REQUIRE(game.num_dirty<Transform>() == 2);
+    REQUIRE(game.num_dirty<Sprite>() == 1);
+    REQUIRE(game.is_dirty<Transform>(*actors[150]));
+    REQUIRE(!game.is_dirty<Sprite>(*actors[150]));
+
+    std::vector<Game3::Entity *> visited;
+    game.for_each_dirty<Transform>([&](Game3::Entity &e, Transform &t)
+    {
+        (void)t;
+        visited.push_back(&e);
+    });
+    REQUIRE(visited == std::vector<Game3::Entity *>{actors[5], actors[150]});
+
+    // Destroying a dirty entity unmarks it, and the index is reused.
+    game.destroy(*actors[150]);
+    REQUIRE(game.num_dirty<Transform>() == 1);
+    auto &new_actor = game.create<Actor>();
+    REQUIRE(!game.is_dirty<Transform>(new_actor));
+
+    REQUIRE(game.get<Game3::AllEntitiesUnordered>().size() == 200);
+
+    game.clear_dirty<Transform>();
+    REQUIRE(game.num_dirty<Transform>() == 0);
+    REQUIRE(!game.is_dirty<Transform>(*actors[5]));
+    REQUIRE(game.num_dirty<Sprite>() == 1);
+}
+
+TEST_CASE("entities.spatial_index")
+{
+    Game6::Controller game = nullptr;
+
+    auto &a = game.create<Crate>(ivec2(0, 0));
+    auto &b = game.create<Crate>(ivec2(10, 0));
+    (void)game.create<Marker>(); // Has no bounds, so it's not in the tree.
+
+    auto CollectIds = [&](irect2 rect)
+    {
+        std::set<Game6::Id> ret;
+        game.spatial_collide_aabb(rect, [&](Game6::Entity &e){ret.insert(e.id()); return false;});
+        return ret;
+    };
+
+    REQUIRE(CollectIds(ivec2(-5).rect_size(20)) == std::set{a.id(), b.id()});
+    REQUIRE(CollectIds(ivec2(9, 0).rect_size(2)) == std::set{b.id()});
+    REQUIRE(CollectIds(ivec2(8, 0).rect_size(2)).empty()); // The rects that only share an edge don't touch.
+
+    // The tree isn't updated until `update_spatial_index()`.
+    a.rect = ivec2(10, 0).rect_size(2);
+    game.mark_dirty<Hitbox>(a);
+    REQUIRE(CollectIds(ivec2(10, 0).rect_size(1)) == std::set{b.id()});
+    game.update_spatial_index();
+    REQUIRE(game.num_dirty<Hitbox>() == 0);
+    REQUIRE(CollectIds(ivec2(10, 0).rect_size(1)) == std::set{a.id(), b.id()});
+    REQUIRE(CollectIds(ivec2(0, 0).rect_size(1)).empty());
+
+    int pairs = 0;
+    game.spatial_collide_all_pairs([&](Game6::Entity &x, Game6::Entity &y){REQUIRE(&x != &y); pairs++; return false;});
+    REQUIRE(pairs == 1);
+
+    REQUIRE(game.spatial_collide_point(ivec2(11, 1), [&](Game6::Entity &e){return &e == &b;}));
+
+    game.destroy(b);
+    REQUIRE(CollectIds(ivec2(10, 0).rect_size(1)) == std::set{a.id()});
+    REQUIRE(!game.spatial_index().IsEmpty());
+    game.destroy(a);
+    REQUIRE(game.spatial_index().IsEmpty());
+}
+
+TEST_CASE("entities.snapshots")
+{
+    Game4::Controller game = nullptr;
+
+    std::vector<Game4::Id> ids;
+    for (int i = 0; i < 5; i++)
+    {
+        auto &player = game.create<Player>();
+        player.x = i;
+        player.name = "player" + std::to_string(i);
+        ids.push_back(player.id());
+        game.create<Rock>().y = i * 10;
+    }
+    game.destroy(*game.get<Game4::AllEntitiesOrdered>().begin()); // Leave a gap in the IDs.
+
+    std::vector<std::uint8_t> snapshot;
+    game.save_snapshot(snapshot);
+
+    // Modify the state, then restore it.
+    std::vector<std::uint8_t> snapshot2;
+    game.get(ids[2]).get<Position>().x = 42;
+    game.create<Rock>();
+    game.save_snapshot(snapshot2);
+    game.load_snapshot(snapshot);
+
+    REQUIRE(game.get<Game4::AllEntitiesUnordered>().size() == 9);
+    REQUIRE(!game.get_opt(ids[0]));
+    for (int i = 1; i < 5; i++)
+    {
+        const auto &e = game.get(ids[std::size_t(i)]);
+        REQUIRE(e.get<Position>().x == i);
+        REQUIRE(e.get<Name>().name == "player" + std::to_string(i));
+    }
+    // New IDs don't collide with the restored ones.
+    REQUIRE(game.create<Rock>().id().get_value() == 11);
+
+    // Deltas.
+    std::vector<std::uint8_t> delta, restored;
+    Ent::MakeSnapshotDelta(snapshot, snapshot2, delta);
+    REQUIRE(delta.size() < snapshot2.size());
+    Ent::ApplySnapshotDelta(snapshot, delta, restored);
+    REQUIRE(restored == snapshot2);
+    Ent::MakeSnapshotDelta(snapshot2, snapshot, delta);
+    Ent::ApplySnapshotDelta(snapshot2, delta, restored);
+    REQUIRE(restored == snapshot);
+    REQUIRE_THROWS(Ent::ApplySnapshotDelta({}, delta, restored));
+
+    // Malformed snapshots.
+    snapshot.pop_back();
+    REQUIRE_THROWS(game.load_snapshot(snapshot));
+}
+
+TEST_CASE("entities.profiling")
+{
+    Game5::Controller game = nullptr;
+    REQUIRE(game.profiling_categories().empty());
+
+    std::vector<Game5::Entity *> sparks;
+    for (int i = 0; i < 10; i++)
+        sparks.push_back(&game.create<Spark>());
+    for (int i = 0; i < 4; i++)
+        game.destroy(*sparks[std::size_t(i)]);
+
+    if constexpr (!Ent::profiling_enabled)
+        return;
+
+    auto types = game.profiling_entity_types();
+    std::size_t type_index = std::size_t(Ent::EntityTypeRegistry<Game5>::Type<Spark>::index);
+    REQUIRE(types.size() > type_index);
+    REQUIRE(types[type_index].name.ends_with("Spark"));
+    REQUIRE(types[type_index].num_created == 10);
+    REQUIRE(types[type_index].num_destroyed == 4);
+
+    std::size_t category_index = std::size_t(Ent::CategoryRegistry<Game5>::Type<Game5::PrepareCategoryType<Game5::AllEntitiesOrdered>::type>::index);
+    auto categories = game.profiling_categories();
+    REQUIRE(!categories[category_index].name.empty());
+    REQUIRE(categories[category_index].num_inserted == 10);
+    REQUIRE(categories[category_index].num_erased == 4);
+
+    game.reset_profiling();
+    REQUIRE(game.profiling_entity_types()[type_index].num_created == 0);
+    REQUIRE(game.profiling_entity_types()[type_index].name.ends_with("Spark"));
+}
@@ -2,9 +2,14 @@
 
 // Some predefined entity list types for the entity system.
 
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <span>
 #include <stdexcept>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "program/compiler.h"
 
@@ -131,6 +136,12 @@ namespace Ent
                     else
                         set.insert(&value);
                 }
+                void InsertMany(std::span<typename Tag::Entity *const> entities) override
+                {
+                    if constexpr (!Ordered)
+                        set.reserve(set.size() + entities.size());
+                    ListBase<Tag>::InsertMany(entities);
+                }
                 void Erase(typename Tag::Entity &value) noexcept override
                 {
                     [[maybe_unused]] bool ok = set.erase(&value) > 0;
@@ -229,6 +240,374 @@ namespace Ent
     // An unordered entity list.
     using UnorderedList = impl::MaybeOrderedList<false>;
 
+    // Same interface as `OrderedList` (iterates in the order of IDs), but stores the entities in a contiguous array.
+    // Since the default IDs only grow, new entities are appended to the end. Erased entities leave holes that are skipped when iterating,
+    //   and the array is compacted when the holes outnumber the entities. This makes the iteration a linear scan, and insertion and erasure amortized O(1).
+    // If an entity with a smaller ID is inserted (e.g. with `Mixins::GenerationalEntityIds`, which reuses the IDs), it's inserted in the middle, which is O(n).
+    struct DenseOrderedList
+    {
+        template <TagType Tag, Predicate<Tag> Pred>
+        class Type : ListBase<Tag>
+        {
+            friend ListFriend;
+
+            // Sorted by ID. Null pointers are the holes left by the erased entities.
+            std::vector<typename Tag::Entity *> slots;
+            // Maps entities to their indices in `slots`. Can be searched by ID.
+            phmap::flat_hash_map<typename Tag::Entity *, std::size_t, impl::UniqueIdHash<Tag>, impl::UniqueIdEq<Tag>> indices;
+            std::size_t num_holes = 0;
+
+            // Removes the holes. Doesn't allocate.
+            void Compact() noexcept
+            {
+                std::size_t out = 0;
+                for (std::size_t i = 0; i < slots.size(); i++)
+                {
+                    if (!slots[i])
+                        continue;
+                    if (out != i)
+                    {
+                        slots[out] = slots[i];
+                        indices.find(slots[out])->second = out;
+                    }
+                    out++;
+                }
+                slots.resize(out);
+                num_holes = 0;
+            }
+
+            void Insert(typename Tag::Entity &entity) override
+            {
+                // There are never holes at the end.
+                typename Tag::Entity *last = slots.empty() ? nullptr : slots.back();
+
+                if (!last || last->id() < entity.id())
+                {
+                    slots.reserve(slots.size() + 1);
+                    // Only this can throw.
+                    [[maybe_unused]] bool ok = indices.try_emplace(&entity, slots.size()).second;
+                    ASSERT(ok, "Attempt to insert a duplicate entity into a dense ordered list.");
+                    slots.push_back(&entity);
+                    return;
+                }
+
+                // The slow path, an out-of-order ID.
+                Compact();
+                std::size_t index = std::size_t(std::lower_bound(slots.begin(), slots.end(), entity.id(), impl::UniqueIdLess<Tag>{}) - slots.begin());
+                slots.reserve(slots.size() + 1);
+                // Only this can throw.
+                [[maybe_unused]] bool ok = indices.try_emplace(&entity, index).second;
+                ASSERT(ok, "Attempt to insert a duplicate entity into a dense ordered list.");
+                slots.insert(slots.begin() + std::ptrdiff_t(index), &entity);
+                for (std::size_t i = index + 1; i < slots.size(); i++)
+                    indices.find(slots[i])->second = i;
+            }
+            void InsertMany(std::span<typename Tag::Entity *const> entities) override
+            {
+                slots.reserve(slots.size() + entities.size());
+                indices.reserve(indices.size() + entities.size());
+                ListBase<Tag>::InsertMany(entities);
+            }
+            void Erase(typename Tag::Entity &entity) noexcept override
+            {
+                auto iter = indices.find(&entity);
+                ASSERT(iter != indices.end(), "Attempt to erase a non-existent element from a list.");
+                std::size_t index = iter->second;
+                indices.erase(iter);
+
+                if (index + 1 == slots.size())
+                {
+                    // Erasing from the end doesn't leave a hole. Also drop the holes before it, if any.
+                    slots.pop_back();
+                    while (!slots.empty() && !slots.back())
+                    {
+                        slots.pop_back();
+                        num_holes--;
+                    }
+                    return;
+                }
+
+                slots[index] = nullptr;
+                num_holes++;
+                if (num_holes > indices.size() && num_holes >= 16)
+                    Compact();
+            }
+            typename Tag::Entity *AnyEntity() noexcept override
+            {
+                // There are never holes at the end.
+                return slots.empty() ? nullptr : slots.back();
+            }
+
+            template <bool IsConst>
+            class Iter
+            {
+                typename Tag::Entity *const *cur = nullptr;
+                typename Tag::Entity *const *end = nullptr;
+
+                void SkipHoles()
+                {
+                    while (cur != end && !*cur)
+                        cur++;
+                }
+
+              public:
+                using iterator_category = std::forward_iterator_tag;
+                using difference_type = std::ptrdiff_t;
+                using value_type = typename Tag::Entity;
+                using reference = std::conditional_t<IsConst, const typename Tag::Entity &, typename Tag::Entity &>;
+                using pointer = std::remove_reference_t<reference> *;
+
+                Iter() {}
+                Iter(typename Tag::Entity *const *cur, typename Tag::Entity *const *end) : cur(cur), end(end)
+                {
+                    SkipHoles();
+                }
+
+                reference operator*() const
+                {
+                    return **cur;
+                }
+                pointer operator->() const
+                {
+                    return *cur;
+                }
+
+                Iter &operator++()
+                {
+                    cur++;
+                    SkipHoles();
+                    return *this;
+                }
+                Iter operator++(int)
+                {
+                    Iter ret = *this;
+                    ++*this;
+                    return ret;
+                }
+
+                friend bool operator==(const Iter &a, const Iter &b)
+                {
+                    return a.cur == b.cur;
+                }
+            };
+
+            template <bool IsConst>
+            [[nodiscard]] Iter<IsConst> MakeBegin() const
+            {
+                return Iter<IsConst>(slots.data(), slots.data() + slots.size());
+            }
+            template <bool IsConst>
+            [[nodiscard]] Iter<IsConst> MakeEnd() const
+            {
+                return Iter<IsConst>(slots.data() + slots.size(), slots.data() + slots.size());
+            }
+
+            template <bool IsConst>
+            struct MaybeConstRange
+            {
+                const Type &target;
+
+                [[nodiscard]] auto begin() const {return target.template MakeBegin<IsConst>();}
+                [[nodiscard]] auto end() const {return target.template MakeEnd<IsConst>();}
+            };
+            using Range = MaybeConstRange<false>;
+            using ConstRange = MaybeConstRange<true>;
+
+          public:
+            [[nodiscard]] int size() const {return int(indices.size());}
+            [[nodiscard]] bool has_elems() const {return !indices.empty();}
+
+            [[nodiscard]] auto begin() {return MakeBegin<false>();}
+            [[nodiscard]] auto end() {return MakeEnd<false>();}
+            [[nodiscard]] auto begin() const {return MakeBegin<true>();}
+            [[nodiscard]] auto end() const {return MakeEnd<true>();}
+
+            // Return one or zero elements, throw otherwise.
+            [[nodiscard]] typename Tag::Entity *single_opt()
+            {
+                if (indices.size() > 1)
+                    throw std::runtime_error(FMT("Expected at most one entity in this list, but got {}.", indices.size()));
+                return AnyEntity();
+            }
+            [[nodiscard]] const typename Tag::Entity *single_opt() const
+            {
+                return const_cast<Type *>(this)->single_opt();
+            }
+            // Return one element, throw otherwise.
+            [[nodiscard]] typename Tag::Entity &single()
+            {
+                if (indices.size() != 1)
+                    throw std::runtime_error(FMT("Expected one entity in this list, but got {}.", indices.size()));
+                return *AnyEntity();
+            }
+            [[nodiscard]] const typename Tag::Entity &single() const
+            {
+                return const_cast<Type *>(this)->single();
+            }
+            // Return at least one element, throw otherwise.
+            [[nodiscard]] Range at_least_one()
+            {
+                if (indices.empty())
+                    throw std::runtime_error("Expected at least one entity in this list.");
+                return Range{*this};
+            }
+            [[nodiscard]] ConstRange at_least_one() const
+            {
+                return {const_cast<Type *>(this)->at_least_one().target};
+            }
+
+            // Find entity by id.
+            [[nodiscard]] bool has_entity_with_id(typename Tag::Id id) const
+            {
+                return bool(entity_with_id_opt(id));
+            }
+            [[nodiscard]] typename Tag::Entity &entity_with_id(typename Tag::Id id)
+            {
+                auto ret = entity_with_id_opt(id);
+                if (!ret)
+                    throw std::runtime_error("No entity with this ID in this list.");
+                return *ret;
+            }
+            [[nodiscard]] const typename Tag::Entity &entity_with_id(typename Tag::Id id) const
+            {
+                return const_cast<Type *>(this)->entity_with_id(id);
+            }
+            [[nodiscard]] typename Tag::Entity *entity_with_id_opt(typename Tag::Id id)
+            {
+                auto it = indices.find(id);
+                return it == indices.end() ? nullptr : it->first;
+            }
+            [[nodiscard]] const typename Tag::Entity *entity_with_id_opt(typename Tag::Id id) const
+            {
+                return const_cast<Type *>(this)->entity_with_id_opt(id);
+            }
+        };
+    };
+
+
+    // Dense column lists:
+
+    // A list that additionally stores a value of type `T` for each entity, in a contiguous array.
+    // Use this for hot data that's processed for all entities in a category at once, e.g. positions that are integrated every tick.
+    // Iterating over `values()` is a linear loop without pointer chasing, unlike accessing components through the entity pointers.
+    // The values are default-constructed when an entity is added. Set them from `_init()` (see `entities/mixin_entity_callbacks.h`) or after creating the entity.
+    // The order is unspecified, and changes when entities are removed (the last element is moved into the hole).
+    // Usage:
+    //   using Movable = Game::Category<Ent::DenseColumn<fvec2>, Velocity>;
+    //   auto &list = game.get<Movable>();
+    //   for (std::size_t i = 0; i < list.size(); i++)
+    //       list.values()[i] += list.entities()[i]->get<Velocity>().value;
+    template <typename T>
+    struct DenseColumn
+    {
+        static_assert(std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>, "The column type must be trivially copyable and default-constructible.");
+
+        template <TagType Tag, Predicate<Tag> Pred>
+        class Type : ListBase<Tag>
+        {
+            friend ListFriend;
+
+            std::vector<T> column;
+            std::vector<typename Tag::Entity *> column_entities;
+            // Maps entities to the indices in the arrays.
+            phmap::flat_hash_map<typename Tag::Entity *, std::size_t> indices;
+
+            void Insert(typename Tag::Entity &entity) override
+            {
+                column.reserve(column.size() + 1);
+                column_entities.reserve(column_entities.size() + 1);
+                // Only this can throw.
+                [[maybe_unused]] bool ok = indices.try_emplace(&entity, column.size()).second;
+                ASSERT(ok, "Attempt to insert a duplicate entity into a dense column list.");
+                column.emplace_back();
+                column_entities.push_back(&entity);
+            }
+            void Erase(typename Tag::Entity &entity) noexcept override
+            {
+                auto iter = indices.find(&entity);
+                ASSERT(iter != indices.end(), "Attempt to erase a non-existent element from a list.");
+                std::size_t index = iter->second;
+                indices.erase(iter);
+                if (index + 1 != column.size())
+                {
+                    column[index] = column.back();
+                    column_entities[index] = column_entities.back();
+                    indices.find(column_entities[index])->second = index;
+                }
+                column.pop_back();
+                column_entities.pop_back();
+            }
+            typename Tag::Entity *AnyEntity() noexcept override
+            {
+                return column_entities.empty() ? nullptr : column_entities.back();
+            }
+            void InsertMany(std::span<typename Tag::Entity *const> entities) override
+            {
+                column.reserve(column.size() + entities.size());
+                column_entities.reserve(column_entities.size() + entities.size());
+                indices.reserve(indices.size() + entities.size());
+                ListBase<Tag>::InsertMany(entities);
+            }
+
+            using entity_iter_t = typename std::vector<typename Tag::Entity *>::const_iterator;
+
+            class Iter : public entity_iter_t
+            {
+              public:
+                Iter(entity_iter_t base) : entity_iter_t(std::move(base)) {}
+
+                using value_type = typename Tag::Entity;
+                using reference = typename Tag::Entity &;
+                using pointer = typename Tag::Entity *;
+
+                reference operator*() const
+                {
+                    return *entity_iter_t::operator*();
+                }
+                pointer operator->() const
+                {
+                    return entity_iter_t::operator*();
+                }
+            };
+
+          public:
+            [[nodiscard]] int size() const {return int(column.size());}
+            [[nodiscard]] bool has_elems() const {return !column.empty();}
+
+            // Iterates over the entities, in the same order as `values()`.
+            [[nodiscard]] Iter begin() const {return column_entities.begin();}
+            [[nodiscard]] Iter end() const {return column_entities.end();}
+
+            // The values, with the same indices as in `entities()`.
+            [[nodiscard]] std::span<T> values() {return column;}
+            [[nodiscard]] std::span<const T> values() const {return column;}
+            // The entities, with the same indices as in `values()`.
+            [[nodiscard]] std::span<typename Tag::Entity *const> entities() const {return column_entities;}
+
+            // Returns the value for the entity, or throws if it's not in this list.
+            [[nodiscard]] T &at(const typename Tag::Entity &entity)
+            {
+                if (T *ret = get_opt(entity))
+                    return *ret;
+                throw std::runtime_error("This entity is not in this dense column list.");
+            }
+            [[nodiscard]] const T &at(const typename Tag::Entity &entity) const
+            {
+                return const_cast<Type *>(this)->at(entity);
+            }
+            // Returns the value for the entity, or null if it's not in this list.
+            [[nodiscard]] T *get_opt(const typename Tag::Entity &entity)
+            {
+                auto iter = indices.find(const_cast<typename Tag::Entity *>(&entity));
+                return iter == indices.end() ? nullptr : &column[iter->second];
+            }
+            [[nodiscard]] const T *get_opt(const typename Tag::Entity &entity) const
+            {
+                return const_cast<Type *>(this)->get_opt(entity);
+            }
+        };
+    };
+
 
     // Single-entity lists:
 
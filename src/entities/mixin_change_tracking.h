@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "entities/core.h"
+#include "program/errors.h"
+
+// Tracks which components of which entities were changed, so the systems can process only those.
+// Usage:
+//   game.mark_dirty<Transform>(entity); // After modifying the component.
+//   game.for_each_dirty<Transform>([&](Game::Entity &e, Transform &t){...}); // E.g. once per frame, to upload the transforms.
+//   game.clear_dirty<Transform>();
+// Each entity gets a dense index (reused after destruction), and each component gets a bitset indexed by it, plus a list of the set bits.
+// Marking is O(1), iterating is O(number of dirty entities). Destroying a dirty entity is O(number of dirty entities) for each component it's dirty in.
+// NOTE: The dirty flags are not set automatically, call `mark_dirty()` yourself.
+// NOTE: If you want to mark the entities from `_init()` (see `entities/mixin_entity_callbacks.h`), list this mixin before `EntityCallbacks`.
+
+namespace Ent
+{
+    namespace Mixins
+    {
+        template <typename Tag, typename NextBase>
+        struct ChangeTracking : NextBase
+        {
+          public:
+            struct Controller;
+
+            class Entity : public NextBase::Entity
+            {
+                friend Controller;
+                std::uint32_t change_tracking_index = 0;
+            };
+
+            struct Controller : NextBase::Controller
+            {
+              private:
+                struct DirtySet
+                {
+                    std::vector<std::uint64_t> bits;
+                    // The indices that have the bits set, in the order of marking.
+                    std::vector<std::uint32_t> indices;
+
+                    [[nodiscard]] bool Has(std::uint32_t index) const
+                    {
+                        return index / 64 < bits.size() && (bits[index / 64] >> (index % 64) & 1);
+                    }
+                };
+
+                // Indexed by `change_tracking_index`, null for unused indices.
+                std::vector<typename Tag::Entity *> entities_by_index;
+                std::vector<std::uint32_t> free_indices;
+                // Indexed by `ComponentRegistry<Tag>`.
+                std::vector<DirtySet> dirty_sets;
+
+                template <Component<Tag> C>
+                [[nodiscard]] DirtySet &GetDirtySet()
+                {
+                    std::size_t comp_index = std::size_t(ComponentRegistry<Tag>::template Type<C>::index);
+                    if (comp_index >= dirty_sets.size())
+                        dirty_sets.resize(std::size_t(ComponentRegistry<Tag>::Count()));
+                    return dirty_sets[comp_index];
+                }
+
+                template <Component<Tag> C>
+                [[nodiscard]] const DirtySet *GetDirtySetOpt() const
+                {
+                    std::size_t comp_index = std::size_t(ComponentRegistry<Tag>::template Type<C>::index);
+                    return comp_index < dirty_sets.size() ? &dirty_sets[comp_index] : nullptr;
+                }
+
+                [[nodiscard]] static std::uint32_t IndexOf(const typename Tag::Entity &e)
+                {
+                    return static_cast<const Entity &>(e).change_tracking_index;
+                }
+
+              public:
+                using NextBase::Controller::Controller;
+
+                constexpr Controller() {}
+
+                Controller(Controller &&other) noexcept
+                    : NextBase::Controller(std::move(other)),
+                    entities_by_index(std::exchange(other.entities_by_index, {})),
+                    free_indices(std::exchange(other.free_indices, {})),
+                    dirty_sets(std::exchange(other.dirty_sets, {}))
+                {}
+                Controller &operator=(Controller other) noexcept
+                {
+                    // Swapping the bases never destroys any entities, which would need our members.
+                    std::swap(static_cast<typename NextBase::Controller &>(*this), static_cast<typename NextBase::Controller &>(other));
+                    std::swap(entities_by_index, other.entities_by_index);
+                    std::swap(free_indices, other.free_indices);
+                    std::swap(dirty_sets, other.dirty_sets);
+                    return *this;
+                }
+
+                ~Controller()
+                {
+                    // Do it here, since the base destructor would run after our members are destroyed.
+                    this->DestroyAllEntities();
+                }
+
+                template <EntityType<Tag> E>
+                void OnEntityCreated(typename Tag::template FullEntity<E> &e)
+                {
+                    std::uint32_t index = 0;
+                    if (free_indices.empty())
+                    {
+                        entities_by_index.push_back(&e);
+                        // This makes sure `OnEntityDestroyed()` never allocates.
+                        free_indices.reserve(entities_by_index.capacity());
+                        index = std::uint32_t(entities_by_index.size() - 1);
+                    }
+                    else
+                    {
+                        index = free_indices.back();
+                        free_indices.pop_back();
+                        entities_by_index[index] = &e;
+                    }
+                    static_cast<Entity &>(e).change_tracking_index = index;
+
+                    try
+                    {
+                        NextBase::Controller::OnEntityCreated(e);
+                    }
+                    catch (...)
+                    {
+                        entities_by_index[index] = nullptr;
+                        free_indices.push_back(index);
+                        throw;
+                    }
+                }
+
+                void OnEntityDestroyed(Entity &e)
+                {
+                    NextBase::Controller::OnEntityDestroyed(e);
+
+                    std::uint32_t index = e.change_tracking_index;
+                    for (DirtySet &set : dirty_sets)
+                    {
+                        if (set.Has(index))
+                        {
+                            set.bits[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+                            auto iter = std::find(set.indices.begin(), set.indices.end(), index);
+                            ASSERT(iter != set.indices.end(), "Entities: Internal error: The dirty set is inconsistent.");
+                            set.indices.erase(iter);
+                        }
+                    }
+                    entities_by_index[index] = nullptr;
+                    free_indices.push_back(index);
+                }
+
+                // Marks a component of an entity as changed. Does nothing if it's already marked.
+                // Throws if the entity doesn't have this component.
+                template <Component<Tag> C>
+                void mark_dirty(typename Tag::Entity &e)
+                {
+                    (void)e.template get<C>(); // Check that the component exists.
+
+                    DirtySet &set = GetDirtySet<C>();
+                    std::uint32_t index = IndexOf(e);
+                    if (set.Has(index))
+                        return;
+                    if (index / 64 >= set.bits.size())
+                        set.bits.resize(entities_by_index.size() / 64 + 1);
+                    set.indices.push_back(index);
+                    set.bits[index / 64] |= std::uint64_t(1) << (index % 64);
+                }
+
+                // Whether the component of this entity was marked as changed since the last `clear_dirty()`.
+                template <Component<Tag> C>
+                [[nodiscard]] bool is_dirty(const typename Tag::Entity &e) const
+                {
+                    const DirtySet *set = GetDirtySetOpt<C>();
+                    return set && set->Has(IndexOf(e));
+                }
+
+                // The number of entities with this component marked as changed.
+                template <Component<Tag> C>
+                [[nodiscard]] std::size_t num_dirty() const
+                {
+                    const DirtySet *set = GetDirtySetOpt<C>();
+                    return set ? set->indices.size() : 0;
+                }
+
+                // Calls `func(Entity &e, C &comp)` for each entity with the component marked as changed, in the order of marking.
+                // Don't create or destroy entities from the callback, nor mark more of them.
+                template <Component<Tag> C>
+                void for_each_dirty(auto &&func)
+                {
+                    const DirtySet *set = GetDirtySetOpt<C>();
+                    if (!set)
+                        return;
+                    for (std::uint32_t index : set->indices)
+                    {
+                        typename Tag::Entity &e = *entities_by_index[index];
+                        func(e, e.template get<C>());
+                    }
+                }
+
+                // Unmarks all entities for this component.
+                template <Component<Tag> C>
+                void clear_dirty()
+                {
+                    DirtySet &set = GetDirtySet<C>();
+                    for (std::uint32_t index : set.indices)
+                        set.bits[index / 64] = 0; // Clearing the whole word is fine, since all set bits are in `indices` anyway.
+                    set.indices.clear();
+                }
+            };
+        };
+    }
+}
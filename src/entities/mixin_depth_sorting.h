@@ -0,0 +1,150 @@
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <utility>
+
+#include "entities/core.h"
+#include "utils/depth_sorted_list.h"
+
+// Keeps the entities with a designated component in a `DepthSortedList`, to draw them in order without sorting all of them every frame.
+// Requires `Ent::Mixins::ChangeTracking`.
+// Usage:
+//   struct Sprite;
+//   struct Game : Ent::BasicTag<Game, Ent::Mixins::DepthSorting, Ent::Mixins::ChangeTracking>
+//   {
+//       using depth_sort_component = Sprite;
+//   };
+//   struct Sprite
+//   {
+//       IMP_COMPONENT(Game)
+//       fvec2 pos;
+//       std::uint8_t layer = 0;
+//       [[nodiscard]] std::uint32_t depth_sort_key() const {return DepthSortedList<int>::LayeredKey(layer, pos.y);} // Required.
+//   };
+//
+//   game.mark_dirty<Sprite>(entity); // After modifying the key, same as with any other component.
+//   game.update_depth_sorting(); // Once per frame, before rendering. Clears the dirty set of the sprite component.
+//   game.for_each_depth_sorted([](Game::Entity &e){...}); // Draw the entities.
+// The entities are added to the list when created, and removed when destroyed.
+// The new keys are applied by `update_depth_sorting()`, and `DepthSortedList::Sort()` then reuses the previous order,
+//   which is much cheaper than a full sort when few keys change, or when many keys change slightly.
+// NOTE: If the component is also used by another mixin that clears its dirty set (e.g. `Ent::Mixins::SpatialIndex`),
+//   call `update_depth_sorting(false)` first, then the update of that mixin.
+// NOTE: If `_init()` (see `entities/mixin_entity_callbacks.h`) changes the key, mark it as dirty there.
+
+namespace Ent
+{
+    namespace Mixins
+    {
+        template <typename Tag, typename NextBase>
+        struct DepthSorting : NextBase
+        {
+          public:
+            struct Controller;
+
+            class Entity : public NextBase::Entity
+            {
+                friend Controller;
+                std::uint32_t depth_sort_handle = std::uint32_t(-1); // `DepthSortedList::null_handle` if the entity isn't in the list.
+            };
+
+            struct Controller : NextBase::Controller
+            {
+              public:
+                // The component that provides the sort keys, see above.
+                using DepthSortComponent = typename Tag::depth_sort_component;
+                using DepthSortList = DepthSortedList<typename Tag::Entity *>;
+
+              private:
+                DepthSortList depth_list;
+
+              public:
+                using NextBase::Controller::Controller;
+
+                Controller() {}
+
+                Controller(Controller &&other) noexcept
+                    : NextBase::Controller(std::move(other)), depth_list(std::exchange(other.depth_list, {}))
+                {}
+                Controller &operator=(Controller other) noexcept
+                {
+                    // Swapping the bases never destroys any entities, which would need the list.
+                    std::swap(static_cast<typename NextBase::Controller &>(*this), static_cast<typename NextBase::Controller &>(other));
+                    std::swap(depth_list, other.depth_list);
+                    return *this;
+                }
+
+                ~Controller()
+                {
+                    // Do it here, since the base destructor would run after the list is destroyed.
+                    this->DestroyAllEntities();
+                }
+
+                template <EntityType<Tag> E>
+                void OnEntityCreated(typename Tag::template FullEntity<E> &e)
+                {
+                    if constexpr (std::derived_from<E, DepthSortComponent>)
+                    {
+                        const DepthSortComponent &comp = e;
+                        typename DepthSortList::Handle handle = depth_list.Insert(&e, comp.depth_sort_key());
+                        static_cast<Entity &>(e).depth_sort_handle = handle;
+                        try
+                        {
+                            NextBase::Controller::OnEntityCreated(e);
+                        }
+                        catch (...)
+                        {
+                            depth_list.Erase(handle);
+                            static_cast<Entity &>(e).depth_sort_handle = DepthSortList::null_handle;
+                            throw;
+                        }
+                    }
+                    else
+                    {
+                        NextBase::Controller::OnEntityCreated(e);
+                    }
+                }
+
+                void OnEntityDestroyed(Entity &e)
+                {
+                    NextBase::Controller::OnEntityDestroyed(e);
+
+                    if (e.depth_sort_handle != DepthSortList::null_handle)
+                    {
+                        depth_list.Erase(e.depth_sort_handle); // This never allocates.
+                        e.depth_sort_handle = DepthSortList::null_handle;
+                    }
+                }
+
+                // Updates the keys of all entities with the component marked as dirty, then restores the order.
+                // If `clear_dirty` is true, also clears the dirty set of that component. Call this once per frame, before rendering.
+                void update_depth_sorting(bool clear_dirty = true)
+                {
+                    auto &self = static_cast<typename Tag::Controller &>(*this);
+                    self.template for_each_dirty<DepthSortComponent>([&](typename Tag::Entity &e, DepthSortComponent &comp)
+                    {
+                        depth_list.SetKey(static_cast<Entity &>(e).depth_sort_handle, comp.depth_sort_key());
+                    });
+                    if (clear_dirty)
+                        self.template clear_dirty<DepthSortComponent>();
+                    depth_list.Sort();
+                }
+
+                // Calls `func(Entity &e)` for all entities with the component, in the order of their keys as of the last `update_depth_sorting()`.
+                // The entities created since then are visited last. Don't create or destroy entities from the callback.
+                template <typename F>
+                void for_each_depth_sorted(F &&func)
+                {
+                    depth_list.ForEach([&](typename Tag::Entity *e){func(*e);});
+                }
+
+                // The list itself. The values are the entity pointers.
+                [[nodiscard]] const DepthSortList &depth_sorted_list() const
+                {
+                    return depth_list;
+                }
+            };
+        };
+    }
+}
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <concepts>
+#include <cstddef>
 #include <iterator>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
 #include <string_view>
 #include <string>
 #include <utility>
@@ -22,6 +28,7 @@ Manual:
   * `LinkOne<"name">` to add a link to a single other entity.
   * `LinkMany<"name">` to add a link to several other entities.
     This uses a vector under the hood, but the container can be customized, and/or extra user data can be added. See code for details.
+  * `LinkManySmall<"name", N>` is the same, but stores up to `N` targets without allocating. Use it when most entities have only a few targets.
 
 NOTE: The names must be unique in an entity.
 
@@ -45,6 +52,8 @@ Functions:
     controller.unlink<"a">(a)`
 * Remove link to a specific entity. Throws if not linked.
     controller.unlink<"a">(a, target)
+* Replace all targets of a multi-target link at once. Only the links that actually change are updated on the other side.
+    controller.relink<"a">(a, "b", targets)
 
 * Check if a link has (at least one) target.
     controller.has_link<"a">(a)
@@ -85,6 +94,7 @@ namespace Ent
             constexpr void _adl_link_single_target() {}
             constexpr void _adl_link_multi_target() {} // This one is not type-erased, because the return type can vary.
             constexpr void _adl_link_has_target() {}
+            constexpr void _adl_link_relink() {}
 
             // Returns true if `T` is a `Link??<"...">` entity component.
             template <typename T>
@@ -103,6 +113,131 @@ namespace Ent
             struct MaybeAddContiguousIteratorConcept {};
             template <std::contiguous_iterator T>
             struct MaybeAddContiguousIteratorConcept<T> {using iterator_concept = std::contiguous_iterator_tag;};
+
+            // A vector that stores up to `N` elements without allocating. The default container of `LinkManySmall`.
+            // Implements only what `LinkContainerTraits` needs. Not copyable, since the links are never copied.
+            template <typename T, std::size_t N>
+            class SmallVector
+            {
+                static_assert(N > 0);
+
+                alignas(T) unsigned char storage[sizeof(T) * N];
+                T *heap = nullptr; // Null if the elements are in `storage`.
+                std::size_t count = 0;
+                std::size_t cap = N;
+
+                [[nodiscard]] T *Data() {return heap ? heap : std::launder(reinterpret_cast<T *>(storage));}
+                [[nodiscard]] const T *Data() const {return const_cast<SmallVector *>(this)->Data();}
+
+                void Reallocate(std::size_t new_cap)
+                {
+                    T *new_data = std::allocator<T>{}.allocate(new_cap);
+                    std::uninitialized_move(begin(), end(), new_data);
+                    std::destroy(begin(), end());
+                    if (heap)
+                        std::allocator<T>{}.deallocate(heap, cap);
+                    heap = new_data;
+                    cap = new_cap;
+                }
+
+                void Reset() noexcept
+                {
+                    std::destroy(begin(), end());
+                    if (heap)
+                        std::allocator<T>{}.deallocate(heap, cap);
+                    heap = nullptr;
+                    count = 0;
+                    cap = N;
+                }
+
+              public:
+                using value_type = T;
+                using iterator = T *;
+                using const_iterator = const T *;
+
+                constexpr SmallVector() {}
+
+                SmallVector(SmallVector &&other) noexcept
+                {
+                    *this = std::move(other);
+                }
+                SmallVector &operator=(SmallVector &&other) noexcept
+                {
+                    if (&other == this)
+                        return *this;
+                    Reset();
+                    if (other.heap)
+                    {
+                        heap = std::exchange(other.heap, nullptr);
+                        count = std::exchange(other.count, 0);
+                        cap = std::exchange(other.cap, N);
+                    }
+                    else
+                    {
+                        static_assert(std::is_nothrow_move_constructible_v<T>);
+                        std::uninitialized_move(other.begin(), other.end(), Data());
+                        count = other.count;
+                        other.Reset();
+                    }
+                    return *this;
+                }
+
+                ~SmallVector()
+                {
+                    Reset();
+                }
+
+                [[nodiscard]] bool empty() const {return count == 0;}
+                [[nodiscard]] std::size_t size() const {return count;}
+                [[nodiscard]] std::size_t capacity() const {return cap;}
+                // Whether the elements are stored in the internal buffer.
+                [[nodiscard]] bool is_small() const {return !heap;}
+
+                [[nodiscard]] iterator begin() {return Data();}
+                [[nodiscard]] iterator end() {return Data() + count;}
+                [[nodiscard]] const_iterator begin() const {return Data();}
+                [[nodiscard]] const_iterator end() const {return Data() + count;}
+
+                [[nodiscard]] T &at(std::size_t i)
+                {
+                    if (i >= count)
+                        throw std::out_of_range("Small vector index is out of range.");
+                    return Data()[i];
+                }
+                [[nodiscard]] const T &at(std::size_t i) const {return const_cast<SmallVector *>(this)->at(i);}
+
+                [[nodiscard]] T &back() {return Data()[count - 1];}
+                [[nodiscard]] const T &back() const {return Data()[count - 1];}
+
+                template <typename ...P>
+                T &emplace_back(P &&... params)
+                {
+                    if (count == cap)
+                        Reallocate(cap * 2);
+                    T *ret = std::construct_at(Data() + count, std::forward<P>(params)...);
+                    count++;
+                    return *ret;
+                }
+
+                void pop_back()
+                {
+                    std::destroy_at(Data() + count - 1);
+                    count--;
+                }
+
+                iterator erase(const_iterator first, const_iterator last)
+                {
+                    iterator mut_first = begin() + (first - begin());
+                    iterator new_end = std::move(mut_first + (last - first), end(), mut_first);
+                    std::destroy(new_end, end());
+                    count = std::size_t(new_end - begin());
+                    return mut_first;
+                }
+                iterator erase(const_iterator iter)
+                {
+                    return erase(iter, iter + 1);
+                }
+            };
         }
 
         template <typename Tag, typename NextBase>
@@ -451,6 +586,8 @@ namespace Ent
 
                 LinkElem(const LinkElem &) = default;
                 LinkElem &operator=(const LinkElem &) = default;
+                LinkElem(LinkElem &&) = default;
+                LinkElem &operator=(LinkElem &&) = default;
                 ~LinkElem() = default;
 
               public:
@@ -546,6 +683,14 @@ namespace Ent
                     std::forward<U>(cont).erase(std::forward<I>(iter));
                 }
 
+                // Erases all elements for which `pred(elem)` returns true. `pred` is called exactly once per element.
+                // NOTE: This is optional, only `relink()` needs it.
+                template <typename U, typename F>
+                static void erase_if(U &&cont, F &&pred)
+                {
+                    cont.erase(std::remove_if(cont.begin(), cont.end(), pred), cont.end());
+                }
+
                 // Erases all elements.
                 template <typename U>
                 static void clear(U &&cont)
@@ -623,13 +768,14 @@ namespace Ent
                     using iterator_category = typename std::iterator_traits<Base>::iterator_category;
                     using iterator_concept = std::contiguous_iterator_tag;
 
-                    reference operator*() const {return base.operator*();}
-                    pointer operator->() const {return base.operator->();}
+                    // Not `.operator*()` and `.operator->()`, to support raw pointers.
+                    reference operator*() const {return *base;}
+                    pointer operator->() const {return std::to_address(base);}
 
                     reference operator[](const difference_type &i) const
-                    requires requires{base.operator[](i);}
+                    requires requires{base[i];}
                     {
-                        return base.operator[](i);
+                        return base[i];
                     }
 
                     friend bool operator==(const Iter &a, const Iter &b) requires requires{a.base == b.base;} {return a.base == b.base;}
@@ -761,6 +907,10 @@ namespace Ent
                 [[nodiscard]] const LinkElem<Data> &back() const {ThrowIfEmpty(); return *std::prev(end());}
             };
 
+            // A `LinkMany` container that stores up to `N` targets without allocating.
+            template <typename Data, std::size_t N>
+            using SmallLinkContainer = impl::EntityLinks::SmallVector<LinkElemLow<Data>, N>;
+
             // Inherit your entity/component from this to add a multi-target entity link.
             template <
                 Meta::ConstString Name,
@@ -836,21 +986,15 @@ namespace Ent
                     }
                     else
                     {
-                        // Unlink all.
+                        // Unlink all. Update the other sides in one pass, then clear the container at once.
+                        // This is fine, since the other sides are detached asymmetrically, and don't touch our container.
 
                         if (con)
                         {
-                            while (!self_link.elems.empty())
-                            {
-                                auto &one = ContainerTraits::peek_one(self_link.GetCont());
-                                con->get(one.id())._detail_link_detach(nullptr, static_cast<LinkElemLow<Data> &>(one).target_link, self->id());
-                                ContainerTraits::pop_one(self_link.GetCont());
-                            }
-                        }
-                        else
-                        {
-                            ContainerTraits::clear(self_link.GetCont());
+                            for (auto &elem : self_link.elems)
+                                con->get(elem.id())._detail_link_detach(nullptr, static_cast<LinkElemLow<Data> &>(elem).target_link, self->id());
                         }
+                        ContainerTraits::clear(self_link.GetCont());
                     }
 
                     return true;
@@ -876,6 +1020,45 @@ namespace Ent
                     return self_link.elems;
                 }
 
+                // Replaces all targets with `targets` (in this order, ignoring duplicates), all linked using `linked_name` on their side.
+                // The targets that are already linked with this name stay as is, and their other side isn't touched.
+                // Throws if any target is null, doesn't exist, or has no such link. Does nothing in that case.
+                template <auto SelfName> requires impl::EntityLinks::matches_name_or_null<SelfName, Name>
+                friend void _adl_link_relink(LinkMany &self_link, typename Tag::Controller &con, typename Tag::Entity &self, std::span<const typename Tag::Id> targets, std::string_view linked_name)
+                {
+                    std::vector<typename Tag::Id> sorted_targets(targets.begin(), targets.end());
+                    std::sort(sorted_targets.begin(), sorted_targets.end());
+                    sorted_targets.erase(std::unique(sorted_targets.begin(), sorted_targets.end()), sorted_targets.end());
+
+                    for (typename Tag::Id id : sorted_targets)
+                    {
+                        if (!id.is_nonzero())
+                            throw std::runtime_error("Can't link a null entity.");
+                        (void)con.get(id)._detail_link_num_targets(linked_name); // Throws if the entity or the link doesn't exist.
+                    }
+
+                    [&]() noexcept
+                    {
+                        auto IsWanted = [&](typename Tag::Id id){return std::binary_search(sorted_targets.begin(), sorted_targets.end(), id);};
+
+                        ContainerTraits::erase_if(self_link.GetCont(), [&](LinkElemLow<Data> &elem)
+                        {
+                            if (IsWanted(elem.target_id) && elem.target_link == linked_name)
+                                return false;
+                            con.get(elem.target_id)._detail_link_detach(nullptr, elem.target_link, self.id());
+                            return true;
+                        });
+
+                        for (typename Tag::Id id : targets)
+                        {
+                            if (ContainerTraits::find(self_link.GetCont(), id) != ContainerTraits::end(self_link.GetCont()))
+                                continue; // Already linked, or a duplicate.
+                            con.get(id)._detail_link_attach(con, false, linked_name, self.id(), std::string(Name.view()));
+                            ContainerTraits::insert(self_link.GetCont(), id, std::string(linked_name));
+                        }
+                    }();
+                }
+
                 // Returns true if the list of targets contains `linked_id`.
                 template <auto SelfName> requires impl::EntityLinks::matches_name_or_null<SelfName, Name>
                 friend bool _adl_link_has_target(const LinkMany &self_link, typename Tag::Id linked_id, std::string_view maybe_linked_name) noexcept
@@ -906,6 +1089,10 @@ namespace Ent
                 }
             };
 
+            // Inherit your entity/component from this to add a multi-target entity link, which doesn't allocate for up to `N` targets.
+            template <Meta::ConstString Name, std::size_t N = 4, typename Data = NoLinkData>
+            using LinkManySmall = LinkMany<Name, Data, SmallLinkContainer<Data, N>>;
+
             struct Controller : NextBase::Controller
             {
                 using NextBase::Controller::Controller;
@@ -1170,6 +1357,21 @@ namespace Ent
                     if (!e._detail_link_detach(static_cast<typename Tag::Controller *>(this), name, target.value))
                         throw std::runtime_error("That entity isn't linked.");
                 }
+
+
+                // Replacing links:
+
+                // Replaces all targets of a multi-target link with `targets`, using the link `other_name` on their side.
+                // This is cheaper than unlinking everything and linking again, since only the links that change are updated on the other side.
+                // Throws if any target is null, doesn't exist, or has no such link, and does nothing in that case.
+                // Doesn't compile if this is not a multi-target link. There's no type-erased overload, for simplicity.
+                template <Meta::ConstString Name, Meta::deduce..., typename T>
+                requires valid_multi_target_link_owner<T, Name> && link_dynamic_castable_to_entity<T>
+                void relink(T &e, std::string_view other_name, std::span<const typename Tag::Id> targets)
+                {
+                    using impl::EntityLinks::_adl_link_relink;
+                    _adl_link_relink<Name>(e, static_cast<typename Tag::Controller &>(*this), dynamic_cast<typename Tag::Entity &>(e), targets, other_name);
+                }
             };
         };
     }
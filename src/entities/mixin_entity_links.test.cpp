@@ -216,6 +216,11 @@ namespace
     {
         IMP_STANDALONE_COMPONENT(Game)
     };
+    struct S : Game::LinkManySmall<"s", 2>
+    {
+        IMP_STANDALONE_COMPONENT(Game)
+        virtual ~S() = default;
+    };
 }
 
 TEST_CASE("entities.links.single")
@@ -603,6 +608,60 @@ TEST_CASE("entities.links.multi")
     }
 }
 
+TEST_CASE("entities.links.small_and_relink")
+{
+    Game::Controller game = nullptr;
+
+    auto &s = game.create<S>();
+    std::vector<Game::FullEntity<W> *> targets;
+    for (int i = 0; i < 5; i++)
+        targets.push_back(&game.create<W>());
+
+    // Growing past the internal buffer.
+    for (int i = 0; i < 5; i++)
+    {
+        game.link<"s", "w1">(s, *targets[std::size_t(i)]);
+        REQUIRE(game.get_links<"s">(s).size() == std::size_t(i + 1));
+    }
+    for (int i = 0; i < 5; i++)
+    {
+        REQUIRE(game.get_links<"s">(s)[std::size_t(i)].id() == targets[std::size_t(i)]->id());
+        REQUIRE(game.has_link_to<"w1", "s">(*targets[std::size_t(i)], s));
+    }
+
+    // Relinking keeps the common targets, and updates the rest.
+    std::vector<Game::Id> ids = {targets[1]->id(), targets[4]->id(), targets[1]->id()};
+    game.relink<"s">(s, "w1", ids);
+    REQUIRE(game.get_links<"s">(s).size() == 2);
+    REQUIRE(game.get_links<"s">(s)[0].id() == targets[1]->id());
+    REQUIRE(game.get_links<"s">(s)[1].id() == targets[4]->id());
+    for (int i : {0, 2, 3})
+        REQUIRE(!game.has_link<"w1">(*targets[std::size_t(i)]));
+
+    // Changing the link name on the other side.
+    ids = {targets[4]->id(), targets[0]->id()};
+    game.relink<"s">(s, "w2", ids);
+    REQUIRE(game.get_links<"s">(s).size() == 2);
+    REQUIRE(!game.has_link<"w1">(*targets[4]));
+    REQUIRE(game.has_link_to<"w2", "s">(*targets[4], s));
+    REQUIRE(game.has_link_to<"w2", "s">(*targets[0], s));
+
+    // Invalid targets change nothing.
+    ids = {targets[1]->id(), Game::Id{}};
+    REQUIRE_THROWS(game.relink<"s">(s, "w1", ids));
+    ids = {targets[1]->id()};
+    REQUIRE_THROWS(game.relink<"s">(s, "bad", ids));
+    REQUIRE(game.get_links<"s">(s).size() == 2);
+
+    // Destroying unlinks everything.
+    game.destroy(s);
+    for (auto *target : targets)
+    {
+        REQUIRE(!game.has_link<"w1">(*target));
+        REQUIRE(!game.has_link<"w2">(*target));
+    }
+}
+
 // Signature checks.
 namespace
 {
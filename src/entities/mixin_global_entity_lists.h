@@ -1,11 +1,22 @@
 #pragma once
 
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
 #include "entities/core.h"
 #include "entities/lists.h"
 
 // This mixin provides a global entity list.
 // It also provides extra methods for the controller to look up entities by id, using such a list.
 
+// `GenerationalEntityIds` is an alternative that provides the same lookup methods using a dense slot table instead of a hash set.
+// The IDs then consist of a slot index and a generation counter, so the lookups are a bounds check and one comparison,
+//   and the stale IDs are still detected. The slots are reused, so the IDs are no longer incremental,
+//   which means that `OrderedList` no longer iterates in the order of creation.
+// If you use both mixins, list `GenerationalEntityIds` first, to make its lookup methods take priority.
+
 namespace Ent
 {
     namespace Mixins
@@ -38,5 +49,124 @@ namespace Ent
                 [[nodiscard]] const typename Tag::Entity *get_opt(typename NextBase::Id id) const {return this->template get<AllEntitiesUnordered>().entity_with_id_opt(id);}
             };
         };
+
+        template <typename Tag, typename NextBase>
+        struct GenerationalEntityIds : NextBase
+        {
+            // The low half is the slot index, the high half is the generation (which is never zero).
+            using entity_id_underlying_t = std::uint64_t;
+
+            struct Controller : NextBase::Controller
+            {
+              private:
+                struct Slot
+                {
+                    // The ID of the entity currently in this slot, or of the last one if `entity` is null.
+                    std::uint64_t id = 0;
+                    typename Tag::Entity *entity = nullptr;
+                };
+
+                std::vector<Slot> slots;
+                std::vector<std::uint32_t> free_slots;
+
+                [[nodiscard]] const Slot *FindSlot(typename NextBase::Id id) const
+                {
+                    std::uint64_t value = id.get_value();
+                    std::size_t index = std::uint32_t(value);
+                    if (index >= slots.size() || slots[index].id != value || !slots[index].entity)
+                        return nullptr;
+                    return &slots[index];
+                }
+
+              public:
+                using NextBase::Controller::Controller;
+
+                constexpr Controller() {}
+
+                Controller(Controller &&other) noexcept
+                    : NextBase::Controller(std::move(other)), slots(std::exchange(other.slots, {})), free_slots(std::exchange(other.free_slots, {}))
+                {}
+                Controller &operator=(Controller other) noexcept
+                {
+                    // Swapping the bases never destroys any entities, which would need the slots.
+                    std::swap(static_cast<typename NextBase::Controller &>(*this), static_cast<typename NextBase::Controller &>(other));
+                    std::swap(slots, other.slots);
+                    std::swap(free_slots, other.free_slots);
+                    return *this;
+                }
+
+                ~Controller()
+                {
+                    // Do it here, since the base destructor would run after the slots are destroyed.
+                    this->DestroyAllEntities();
+                }
+
+                [[nodiscard]] typename Tag::entity_id_underlying_t AcquireEntityId(typename Tag::Entity &e)
+                {
+                    std::uint32_t index = 0;
+                    if (free_slots.empty())
+                    {
+                        ASSERT(slots.size() < 0xffffffff, "Too many entities.");
+                        slots.emplace_back();
+                        // This makes sure `ReleaseEntityId()` never allocates.
+                        free_slots.reserve(slots.capacity());
+                        index = std::uint32_t(slots.size() - 1);
+                    }
+                    else
+                    {
+                        index = free_slots.back();
+                        free_slots.pop_back();
+                    }
+
+                    Slot &slot = slots[index];
+                    std::uint32_t generation = std::uint32_t(slot.id >> 32) + 1;
+                    if (generation == 0)
+                        generation = 1;
+                    slot.id = std::uint64_t(generation) << 32 | index;
+                    slot.entity = &e;
+                    return slot.id;
+                }
+
+                void ReleaseEntityId(typename Tag::Entity &e) noexcept
+                {
+                    std::uint32_t index = std::uint32_t(e.id().get_value());
+                    ASSERT(index < slots.size() && slots[index].entity == &e, "Entities: Internal error: Bad entity slot.");
+                    slots[index].entity = nullptr;
+                    // This doesn't allocate, see `AcquireEntityId()`.
+                    free_slots.push_back(index);
+                }
+
+                using NextBase::Controller::get;
+
+                // Check an entity ID for validity.
+                [[nodiscard]] bool valid(typename NextBase::Id id) const
+                {
+                    return bool(FindSlot(id));
+                }
+
+                // Get entity by ID, throw if invalid.
+                [[nodiscard]] typename Tag::Entity &get(typename NextBase::Id id)
+                {
+                    if (auto ret = get_opt(id))
+                        return *ret;
+                    throw std::runtime_error("No entity with this ID.");
+                }
+                [[nodiscard]] const typename Tag::Entity &get(typename NextBase::Id id) const
+                {
+                    return const_cast<Controller *>(this)->get(id);
+                }
+
+                // Get entity by ID, or null if invalid.
+                [[nodiscard]] typename Tag::Entity *get_opt(typename NextBase::Id id)
+                {
+                    const Slot *slot = FindSlot(id);
+                    return slot ? slot->entity : nullptr;
+                }
+                [[nodiscard]] const typename Tag::Entity *get_opt(typename NextBase::Id id) const
+                {
+                    return const_cast<Controller *>(this)->get_opt(id);
+                }
+            };
+        };
     }
 }
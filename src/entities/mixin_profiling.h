@@ -0,0 +1,157 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "entities/core.h"
+#include "program/platform.h"
+
+// Collects statistics about creating and destroying entities, to find the spawning hot spots.
+// Usage:
+//   for (const auto &row : game.profiling_entity_types())
+//       ImGui::Text("%.*s: %d created, %.3f ms", int(row.name.size()), row.name.data(), int(row.num_created), row.time_created.count() / 1e6);
+// For each category, counts the entities inserted into and erased from its list.
+// For each entity type, counts the entities created and destroyed, and measures the time spent in `OnEntityCreated()` and `OnEntityDestroyed()`.
+//   This includes the `_init()` and `_deinit()` callbacks (see `entities/mixin_entity_callbacks.h`) and the work of all mixins listed after this one,
+//   so list this mixin as early as possible.
+// In release builds (with `IMP_PLATFORM_FLAG_prod`), this does nothing, and the tables are always empty.
+
+namespace Ent
+{
+    // Whether `Mixins::Profiling` actually collects anything.
+    inline constexpr bool profiling_enabled = !IMP_PLATFORM_IS(prod);
+
+    namespace Mixins
+    {
+        template <typename Tag, typename NextBase>
+        struct Profiling : NextBase
+        {
+            struct ProfilingCategoryStats
+            {
+                std::string_view name;
+                std::uint64_t num_inserted = 0;
+                std::uint64_t num_erased = 0;
+            };
+
+            struct ProfilingEntityTypeStats
+            {
+                std::string_view name; // Empty if no entities of this type were created yet.
+                std::uint64_t num_created = 0;
+                std::uint64_t num_destroyed = 0;
+                std::chrono::nanoseconds time_created{};
+                std::chrono::nanoseconds time_destroyed{};
+            };
+
+            struct Controller : NextBase::Controller
+            {
+              private:
+                // Indexed by `CategoryRegistry<Tag>`.
+                std::vector<ProfilingCategoryStats> category_stats;
+                // Indexed by `EntityTypeRegistry<Tag>`.
+                std::vector<ProfilingEntityTypeStats> entity_type_stats;
+
+                using clock = std::chrono::steady_clock;
+
+              public:
+                using NextBase::Controller::Controller;
+
+                constexpr Controller() {}
+
+                Controller(Controller &&other) noexcept
+                    : NextBase::Controller(std::move(other)),
+                    category_stats(std::exchange(other.category_stats, {})),
+                    entity_type_stats(std::exchange(other.entity_type_stats, {}))
+                {}
+                Controller &operator=(Controller other) noexcept
+                {
+                    // Swapping the bases never destroys any entities, which would need our members.
+                    std::swap(static_cast<typename NextBase::Controller &>(*this), static_cast<typename NextBase::Controller &>(other));
+                    std::swap(category_stats, other.category_stats);
+                    std::swap(entity_type_stats, other.entity_type_stats);
+                    return *this;
+                }
+
+                ~Controller()
+                {
+                    // Do it here, since the base destructor would run after our members are destroyed.
+                    this->DestroyAllEntities();
+                }
+
+                template <EntityType<Tag> E>
+                void OnEntityCreated(typename Tag::template FullEntity<E> &e)
+                {
+                    if constexpr (!profiling_enabled)
+                    {
+                        NextBase::Controller::OnEntityCreated(e);
+                    }
+                    else
+                    {
+                        // Allocate before starting the timer. This also makes sure `OnEntityDestroyed()` never allocates.
+                        if (category_stats.empty())
+                        {
+                            category_stats.resize(std::size_t(CategoryRegistry<Tag>::Count()));
+                            for (std::size_t i = 0; i < category_stats.size(); i++)
+                                category_stats[i].name = CategoryRegistry<Tag>::Descriptions()[i].name;
+                        }
+                        std::size_t type_index = std::size_t(EntityTypeRegistry<Tag>::template Type<E>::index);
+                        if (type_index >= entity_type_stats.size())
+                            entity_type_stats.resize(std::size_t(EntityTypeRegistry<Tag>::Count()));
+
+                        auto start = clock::now();
+                        NextBase::Controller::OnEntityCreated(e);
+                        auto time = clock::now() - start;
+
+                        ProfilingEntityTypeStats &type_stats = entity_type_stats[type_index];
+                        type_stats.name = Meta::TypeName<E>();
+                        type_stats.num_created++;
+                        type_stats.time_created += time;
+                        for (int list_index : e.EntityCategoryIndices())
+                            category_stats[std::size_t(list_index)].num_inserted++;
+                    }
+                }
+
+                void OnEntityDestroyed(typename Tag::Entity &e)
+                {
+                    if constexpr (!profiling_enabled)
+                    {
+                        NextBase::Controller::OnEntityDestroyed(e);
+                    }
+                    else
+                    {
+                        auto start = clock::now();
+                        NextBase::Controller::OnEntityDestroyed(e);
+                        auto time = clock::now() - start;
+
+                        // The entity was created before, so the vectors have the right sizes.
+                        ProfilingEntityTypeStats &type_stats = entity_type_stats[std::size_t(e.EntityTypeIndex())];
+                        type_stats.num_destroyed++;
+                        type_stats.time_destroyed += time;
+                        for (int list_index : e.EntityCategoryIndices())
+                            category_stats[std::size_t(list_index)].num_erased++;
+                    }
+                }
+
+                // The statistics per category, indexed by `CategoryRegistry<Tag>`.
+                // Empty if nothing was created yet since the last reset, or if the profiling is disabled.
+                [[nodiscard]] std::span<const ProfilingCategoryStats> profiling_categories() const {return category_stats;}
+                // The statistics per entity type, indexed by `EntityTypeRegistry<Tag>`. Skip the rows with empty names.
+                // Empty if nothing was created yet since the last reset, or if the profiling is disabled.
+                [[nodiscard]] std::span<const ProfilingEntityTypeStats> profiling_entity_types() const {return entity_type_stats;}
+
+                // Zeroes all statistics.
+                void reset_profiling()
+                {
+                    for (ProfilingCategoryStats &stats : category_stats)
+                        stats = {.name = stats.name};
+                    for (ProfilingEntityTypeStats &stats : entity_type_stats)
+                        stats = {.name = stats.name};
+                }
+            };
+        };
+    }
+}
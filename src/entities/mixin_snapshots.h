@@ -0,0 +1,345 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "entities/core.h"
+#include "entities/mixin_global_entity_lists.h"
+#include "meta/common.h"
+#include "meta/type_info.h"
+#include "reflection/full.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "strings/format.h"
+
+// Saves and restores the whole state of a controller, e.g. for quick-saves or rollback netcode.
+// Usage:
+//   std::vector<std::uint8_t> snapshot; // Reuse this between the snapshots, to preserve the capacity.
+//   game.save_snapshot(snapshot);
+//   ...
+//   game.load_snapshot(snapshot);
+// Only the components are saved, not the other members of the entity classes. Each component must be either trivially copyable
+//   (then its bytes are copied as is), or reflected (then it's serialized with `Refl::ToBinary()`). Empty components are skipped.
+// The entity types are saved by name, so the snapshots survive recompilation, as long as the components don't change.
+// Loading destroys all entities (running the destruction callbacks), then creates them anew with the same IDs (running the creation callbacks,
+//   after the components are loaded). The entity types must be default-constructible to be loaded.
+// Requires `GlobalEntityLists`. Not compatible with `GenerationalEntityIds`, since it assumes the default incremental IDs.
+// To send the snapshots over network, use `MakeSnapshotDelta()` and `ApplySnapshotDelta()` to encode the difference between two snapshots.
+//   The entities are saved in the order of IDs, so the delta is small when only a few entities change, and the new entities are added at the end.
+
+namespace Ent
+{
+    namespace impl::Snapshots
+    {
+        // Passed to the entity constructor to load it from a snapshot.
+        struct LoadTag {};
+
+        // The number of equal bytes that ends a run of changed bytes in a delta.
+        // Shorter runs of equal bytes are stored as changed, since each run costs 8 bytes of overhead.
+        inline constexpr std::size_t min_equal_run = 8;
+
+        inline void WriteU64(std::vector<std::uint8_t> &out, std::uint64_t value)
+        {
+            for (int i = 0; i < 8; i++)
+                out.push_back(std::uint8_t(value >> (i * 8)));
+        }
+        [[nodiscard]] inline std::uint64_t ReadU64(std::span<const std::uint8_t> data, std::size_t &pos)
+        {
+            if (data.size() - pos < 8)
+                throw std::runtime_error("Unexpected end of a snapshot delta.");
+            std::uint64_t ret = 0;
+            for (int i = 0; i < 8; i++)
+                ret |= std::uint64_t(data[pos++]) << (i * 8);
+            return ret;
+        }
+    }
+
+    // Encodes the difference between two snapshots (or any two byte arrays) into `delta`, replacing its contents.
+    // The format is the size of `cur`, followed by pairs of runs: the number of bytes equal to `prev`, then the number of changed bytes followed by those bytes.
+    inline void MakeSnapshotDelta(std::span<const std::uint8_t> prev, std::span<const std::uint8_t> cur, std::vector<std::uint8_t> &delta)
+    {
+        using namespace impl::Snapshots;
+
+        delta.clear();
+        WriteU64(delta, cur.size());
+
+        auto IsEqual = [&](std::size_t i) {return i < prev.size() && prev[i] == cur[i];};
+
+        std::size_t i = 0;
+        while (i < cur.size())
+        {
+            std::size_t equal_begin = i;
+            while (i < cur.size() && IsEqual(i))
+                i++;
+            std::size_t changed_begin = i;
+            while (i < cur.size())
+            {
+                // Stop at a long enough run of equal bytes, or at a run of equal bytes reaching the end.
+                std::size_t j = i;
+                while (j < cur.size() && j - i < min_equal_run && IsEqual(j))
+                    j++;
+                if (j > i && (j - i == min_equal_run || j == cur.size()))
+                    break;
+                i = j + 1;
+            }
+            i = std::min(i, cur.size());
+
+            WriteU64(delta, changed_begin - equal_begin);
+            WriteU64(delta, i - changed_begin);
+            delta.insert(delta.end(), cur.begin() + std::ptrdiff_t(changed_begin), cur.begin() + std::ptrdiff_t(i));
+        }
+    }
+
+    // Reconstructs a snapshot from the previous one and a delta produced by `MakeSnapshotDelta()`, replacing the contents of `cur`.
+    // Throws if the delta is malformed or doesn't match `prev`.
+    inline void ApplySnapshotDelta(std::span<const std::uint8_t> prev, std::span<const std::uint8_t> delta, std::vector<std::uint8_t> &cur)
+    {
+        using namespace impl::Snapshots;
+
+        std::size_t pos = 0;
+        std::uint64_t size = ReadU64(delta, pos);
+        cur.clear();
+        cur.reserve(size);
+
+        while (cur.size() < size)
+        {
+            std::uint64_t num_equal = ReadU64(delta, pos);
+            std::uint64_t num_changed = ReadU64(delta, pos);
+            if (num_equal > size - cur.size() || num_changed > size - cur.size() - num_equal || cur.size() + num_equal > prev.size() || num_changed > delta.size() - pos)
+                throw std::runtime_error("Malformed snapshot delta, or it doesn't match the previous snapshot.");
+            cur.insert(cur.end(), prev.begin() + std::ptrdiff_t(cur.size()), prev.begin() + std::ptrdiff_t(cur.size() + num_equal));
+            cur.insert(cur.end(), delta.begin() + std::ptrdiff_t(pos), delta.begin() + std::ptrdiff_t(pos + num_changed));
+            pos += num_changed;
+        }
+
+        if (pos != delta.size())
+            throw std::runtime_error("Junk at the end of a snapshot delta.");
+    }
+
+    namespace Mixins
+    {
+        template <typename Tag, typename NextBase>
+        struct Snapshots : NextBase
+        {
+          public:
+            struct Controller;
+
+            class Entity : public NextBase::Entity
+            {
+                friend Controller;
+                virtual void SaveSnapshotLow(Stream::Output &output) const = 0;
+                [[nodiscard]] virtual std::string_view SnapshotTypeNameLow() const = 0;
+            };
+
+          private:
+            using loader_func_t = void (*)(Controller &controller, Stream::Input &input);
+
+            // Maps entity type names to the functions that create them from snapshots.
+            [[nodiscard]] static std::map<std::string_view, loader_func_t> &Loaders()
+            {
+                static std::map<std::string_view, loader_func_t> ret;
+                return ret;
+            }
+
+            template <typename C>
+            static void SaveComponent(const C &comp, Stream::Output &output)
+            {
+                if constexpr (std::is_empty_v<C>)
+                    return;
+                else if constexpr (std::is_trivially_copyable_v<C>)
+                {
+                    // Copy first, to not touch the tail padding of the base subobject, which could be reused by the derived class.
+                    C copy = comp;
+                    output.WriteBytes(reinterpret_cast<const std::uint8_t *>(&copy), sizeof(C));
+                }
+                else if constexpr (Refl::reflected<C>)
+                    Refl::ToBinary(comp, output);
+                else
+                    static_assert(Meta::always_false<C>, "To be saved in snapshots, a component must be either trivially copyable or reflected.");
+            }
+
+            template <typename C>
+            static void LoadComponent(C &comp, Stream::Input &input)
+            {
+                if constexpr (std::is_empty_v<C>)
+                    return;
+                else if constexpr (std::is_trivially_copyable_v<C>)
+                {
+                    C copy;
+                    input.Read(reinterpret_cast<std::uint8_t *>(&copy), sizeof(C));
+                    comp = copy;
+                }
+                else if constexpr (Refl::reflected<C>)
+                    Refl::InterfaceFor(comp).FromBinary(comp, input, {}, Refl::initial_state); // Not `Refl::FromBinary()`, since it expects the end of input.
+                else
+                    static_assert(Meta::always_false<C>, "To be saved in snapshots, a component must be either trivially copyable or reflected.");
+            }
+
+          public:
+            template <EntityType<Tag> E>
+            class FullEntity : public NextBase::template FullEntity<E>
+            {
+                using base_t = typename NextBase::template FullEntity<E>;
+
+                inline static const std::nullptr_t registration = []{
+                    if constexpr (std::default_initializable<E>)
+                    {
+                        Loaders().try_emplace(Meta::TypeName<E>(), [](Controller &controller, Stream::Input &input)
+                        {
+                            (void)static_cast<typename Tag::Controller &>(controller).template create<E>(Ent::impl::Snapshots::LoadTag{}, input);
+                        });
+                    }
+                    return nullptr;
+                }();
+
+              public:
+                using base_t::base_t;
+
+                FullEntity(Ent::impl::Snapshots::LoadTag, Stream::Input &input) requires std::default_initializable<E>
+                    : base_t()
+                {
+                    [&]<typename ...C>(Meta::type_list<C...>)
+                    {
+                        (LoadComponent(static_cast<C &>(*this), input), ...);
+                    }(Ent::EntityComponents<Tag, E>{});
+                }
+
+              private:
+                friend Controller;
+
+                void SaveSnapshotLow(Stream::Output &output) const override
+                {
+                    [&]<typename ...C>(Meta::type_list<C...>)
+                    {
+                        (SaveComponent(static_cast<const C &>(*this), output), ...);
+                    }(Ent::EntityComponents<Tag, E>{});
+                }
+
+                std::string_view SnapshotTypeNameLow() const override
+                {
+                    // Virtual functions are always instantiated, so this makes sure the type is registered.
+                    (void)registration;
+                    return Meta::TypeName<E>();
+                }
+            };
+
+            struct Controller : NextBase::Controller
+            {
+              private:
+                // If nonzero, the next entity gets this ID.
+                typename Tag::entity_id_underlying_t forced_id = 0;
+
+                // Those are reused between the snapshots.
+                std::vector<std::string_view> type_names;
+                std::vector<loader_func_t> type_loaders;
+
+              public:
+                using NextBase::Controller::Controller;
+
+                [[nodiscard]] typename Tag::entity_id_underlying_t AcquireEntityId(typename Tag::Entity &e)
+                {
+                    if (forced_id)
+                        return std::exchange(forced_id, 0);
+                    return NextBase::Controller::AcquireEntityId(e);
+                }
+
+                // Saves all entities to `buffer`, replacing its contents.
+                void save_snapshot(std::vector<std::uint8_t> &buffer)
+                {
+                    this->ThrowIfNull();
+                    buffer.clear();
+
+                    const auto &entities = this->template get<typename Tag::AllEntitiesOrdered>();
+
+                    // Collect the type names. There are usually few of them, so a linear search is fine.
+                    type_names.clear();
+                    for (const typename Tag::Entity &e : entities)
+                    {
+                        std::string_view name = e.SnapshotTypeNameLow();
+                        if (std::find(type_names.begin(), type_names.end(), name) == type_names.end())
+                            type_names.push_back(name);
+                    }
+
+                    Stream::Output output = Stream::Output::ContainerDirect(buffer);
+                    output.WriteLittle<std::uint64_t>(this->NextEntityIdLow());
+                    output.WriteLittle<std::uint32_t>(std::uint32_t(type_names.size()));
+                    for (std::string_view name : type_names)
+                    {
+                        output.WriteLittle<std::uint32_t>(std::uint32_t(name.size()));
+                        output.WriteString(name.data(), name.size());
+                    }
+
+                    output.WriteLittle<std::uint32_t>(std::uint32_t(entities.size()));
+                    for (const typename Tag::Entity &e : entities)
+                    {
+                        output.WriteLittle<std::uint32_t>(std::uint32_t(std::find(type_names.begin(), type_names.end(), e.SnapshotTypeNameLow()) - type_names.begin()));
+                        output.WriteLittle<std::uint64_t>(e.id().get_value());
+                        e.SaveSnapshotLow(output);
+                    }
+                    output.Flush();
+                }
+
+                // Destroys all entities and loads them from a snapshot produced by `save_snapshot()`.
+                // Throws if the snapshot is malformed or has unknown entity types. In that case, the entities loaded so far remain.
+                void load_snapshot(std::span<const std::uint8_t> data)
+                {
+                    this->ThrowIfNull();
+
+                    Stream::Input input(Stream::ReadOnlyData::mem_reference(data.data(), data.data() + data.size()));
+                    input.WantLocationStyle(Stream::byte_offset);
+
+                    auto next_id = typename Tag::entity_id_underlying_t(input.ReadLittle<std::uint64_t>());
+
+                    type_loaders.clear();
+                    std::string name;
+                    for (std::uint32_t i = input.ReadLittle<std::uint32_t>(); i > 0; i--)
+                    {
+                        name.resize(input.ReadLittle<std::uint32_t>());
+                        input.Read(name.data(), name.size());
+                        auto iter = Loaders().find(name);
+                        if (iter == Loaders().end())
+                            throw std::runtime_error(FMT("Unknown or non-default-constructible entity type in a snapshot: `{}`.", name));
+                        type_loaders.push_back(iter->second);
+                    }
+
+                    this->DestroyAllEntities();
+
+                    for (std::uint32_t i = input.ReadLittle<std::uint32_t>(); i > 0; i--)
+                    {
+                        std::uint32_t type_index = input.ReadLittle<std::uint32_t>();
+                        if (type_index >= type_loaders.size())
+                            throw std::runtime_error(input.GetExceptionPrefix() + "Invalid entity type index in a snapshot.");
+                        auto id = typename Tag::entity_id_underlying_t(input.ReadLittle<std::uint64_t>());
+                        if (id == 0 || id >= next_id)
+                            throw std::runtime_error(input.GetExceptionPrefix() + "Invalid entity ID in a snapshot.");
+
+                        forced_id = id;
+                        try
+                        {
+                            type_loaders[type_index](*this, input);
+                        }
+                        catch (...)
+                        {
+                            forced_id = 0;
+                            throw;
+                        }
+                    }
+                    input.ExpectEnd();
+
+                    this->SetNextEntityIdLow(next_id);
+                }
+            };
+        };
+    }
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <concepts>
+#include <type_traits>
+#include <utility>
+
+#include "entities/core.h"
+#include "utils/aabb_tree.h"
+
+// Keeps an `AabbTree` in sync with the entities that have a designated bounds component, and runs spatial queries on it.
+// Requires `Ent::Mixins::ChangeTracking` and `Ent::Mixins::GlobalEntityLists`.
+// Usage:
+//   struct Bounds;
+//   struct Game : Ent::BasicTag<Game, Ent::Mixins::SpatialIndex, Ent::Mixins::ChangeTracking, Ent::Mixins::GlobalEntityLists>
+//   {
+//       using spatial_index_component = Bounds;
+//       // Optional, otherwise the default parameters are used:
+//       static AabbTree<fvec2>::Params spatial_index_params() {return AabbTree<fvec2>::Params(fvec2(4));}
+//   };
+//   struct Bounds
+//   {
+//       IMP_COMPONENT(Game)
+//       frect2 rect;
+//       [[nodiscard]] frect2 spatial_aabb() const {return rect;} // Required.
+//       [[nodiscard]] fvec2 spatial_velocity() const {return ...;} // Optional, expands the tree node in the direction of movement.
+//   };
+//
+//   game.mark_dirty<Bounds>(entity); // After modifying the bounds, same as with any other component.
+//   game.update_spatial_index(); // Once per tick, after the movement. Clears the dirty set of the bounds component.
+//   game.spatial_collide_aabb(rect, [](Game::Entity &e){...; return false;});
+// The entities are added to the tree when created, and removed when destroyed. The tree nodes store the entity IDs as the user data.
+// NOTE: The bounds of the entities marked dirty are not updated until `update_spatial_index()`, so the queries may return stale results until then.
+// NOTE: If `_init()` (see `entities/mixin_entity_callbacks.h`) changes the bounds, mark them as dirty there.
+
+namespace Ent
+{
+    namespace Mixins
+    {
+        template <typename Tag, typename NextBase>
+        struct SpatialIndex : NextBase
+        {
+          public:
+            struct Controller;
+
+            class Entity : public NextBase::Entity
+            {
+                friend Controller;
+                int spatial_index_node = -1; // `AabbTree::null_index` if the entity isn't in the tree. The tree type isn't known here yet.
+            };
+
+            struct Controller : NextBase::Controller
+            {
+              public:
+                // The component that holds the bounds, see above.
+                using SpatialIndexComponent = typename Tag::spatial_index_component;
+                using SpatialIndexRect = std::remove_cvref_t<decltype(std::declval<const SpatialIndexComponent &>().spatial_aabb())>;
+                using SpatialIndexTree = AabbTree<std::remove_cvref_t<decltype(SpatialIndexRect::a)>, typename Tag::Id>;
+
+              private:
+                SpatialIndexTree tree = MakeTree();
+
+                [[nodiscard]] static SpatialIndexTree MakeTree()
+                {
+                    if constexpr (requires{Tag::spatial_index_params();})
+                        return SpatialIndexTree(Tag::spatial_index_params());
+                    else
+                        return SpatialIndexTree(typename SpatialIndexTree::Params{});
+                }
+
+                [[nodiscard]] static int &NodeOf(typename Tag::Entity &e)
+                {
+                    return static_cast<Entity &>(e).spatial_index_node;
+                }
+
+                [[nodiscard]] static typename SpatialIndexTree::vector VelocityOf(const SpatialIndexComponent &comp)
+                {
+                    if constexpr (requires{comp.spatial_velocity();})
+                        return comp.spatial_velocity();
+                    else
+                        return {};
+                }
+
+                // Wraps `bool func(Entity &e)` into a callback for the tree queries.
+                [[nodiscard]] auto WrapQueryCallback(auto &func)
+                {
+                    return [this, &func](typename SpatialIndexTree::NodeIndex node)
+                    {
+                        return bool(func(static_cast<typename Tag::Controller &>(*this).get(tree.GetNodeUserData(node))));
+                    };
+                }
+
+              public:
+                using NextBase::Controller::Controller;
+
+                Controller() {}
+
+                Controller(Controller &&other) noexcept
+                    : NextBase::Controller(std::move(other)), tree(std::exchange(other.tree, MakeTree()))
+                {}
+                Controller &operator=(Controller other) noexcept
+                {
+                    // Swapping the bases never destroys any entities, which would need the tree.
+                    std::swap(static_cast<typename NextBase::Controller &>(*this), static_cast<typename NextBase::Controller &>(other));
+                    std::swap(tree, other.tree);
+                    return *this;
+                }
+
+                ~Controller()
+                {
+                    // Do it here, since the base destructor would run after the tree is destroyed.
+                    this->DestroyAllEntities();
+                }
+
+                template <EntityType<Tag> E>
+                void OnEntityCreated(typename Tag::template FullEntity<E> &e)
+                {
+                    if constexpr (std::derived_from<E, SpatialIndexComponent>)
+                    {
+                        // `AddNode()` and `RemoveNode()` are `noexcept`, so the rollback is simple.
+                        const SpatialIndexComponent &comp = e;
+                        int node = tree.AddNode(comp.spatial_aabb(), e.id());
+                        static_cast<Entity &>(e).spatial_index_node = node;
+                        try
+                        {
+                            NextBase::Controller::OnEntityCreated(e);
+                        }
+                        catch (...)
+                        {
+                            tree.RemoveNode(node);
+                            static_cast<Entity &>(e).spatial_index_node = -1;
+                            throw;
+                        }
+                    }
+                    else
+                    {
+                        NextBase::Controller::OnEntityCreated(e);
+                    }
+                }
+
+                void OnEntityDestroyed(Entity &e)
+                {
+                    NextBase::Controller::OnEntityDestroyed(e);
+
+                    if (e.spatial_index_node != -1)
+                    {
+                        tree.RemoveNode(e.spatial_index_node);
+                        e.spatial_index_node = -1;
+                    }
+                }
+
+                // Moves the tree nodes of all entities with the bounds component marked as dirty, then clears the dirty set of that component.
+                // Call this once per tick, after the movement.
+                void update_spatial_index()
+                {
+                    auto &self = static_cast<typename Tag::Controller &>(*this);
+                    self.template for_each_dirty<SpatialIndexComponent>([&](typename Tag::Entity &e, SpatialIndexComponent &comp)
+                    {
+                        tree.ModifyNode(NodeOf(e), comp.spatial_aabb(), VelocityOf(comp));
+                    });
+                    self.template clear_dirty<SpatialIndexComponent>();
+                }
+
+                // The tree itself, e.g. for ray casts. The user data of the nodes is the entity ID.
+                [[nodiscard]] const SpatialIndexTree &spatial_index() const
+                {
+                    return tree;
+                }
+
+                // Calls `func(Entity &e)` for all entities whose tree nodes contain the point. If it returns true, stops and also returns true.
+                // Like in `AabbTree`, the nodes are expanded, so check the exact collision manually.
+                template <typename F>
+                bool spatial_collide_point(typename SpatialIndexTree::vector point, F &&func)
+                {
+                    return tree.CollidePoint(point, WrapQueryCallback(func));
+                }
+
+                // Calls `func(Entity &e)` for all entities whose tree nodes touch the rect. If it returns true, stops and also returns true.
+                // Like in `AabbTree`, the nodes are expanded, so check the exact collision manually.
+                template <typename F>
+                bool spatial_collide_aabb(typename SpatialIndexTree::rect aabb, F &&func)
+                {
+                    return tree.CollideAabb(aabb, WrapQueryCallback(func));
+                }
+
+                // Calls `func(Entity &a, Entity &b)` for all pairs of entities whose tree nodes touch. If it returns true, stops and also returns true.
+                template <typename F>
+                bool spatial_collide_all_pairs(F &&func)
+                {
+                    auto &self = static_cast<typename Tag::Controller &>(*this);
+                    return tree.CollideAllPairs([&](typename SpatialIndexTree::NodeIndex a, typename SpatialIndexTree::NodeIndex b)
+                    {
+                        return bool(func(self.get(tree.GetNodeUserData(a)), self.get(tree.GetNodeUserData(b))));
+                    });
+                }
+            };
+        };
+    }
+}
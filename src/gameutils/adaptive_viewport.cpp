@@ -1,9 +1,14 @@
 #include "adaptive_viewport.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+
 #include "graphics/clear.h"
 #include "graphics/framebuffer.h"
 #include "graphics/shader.h"
 #include "graphics/texture.h"
+#include "graphics/timer_query.h"
 #include "graphics/vertex_buffer.h"
 #include "graphics/viewport.h"
 #include "interface/window.h"
@@ -21,13 +26,14 @@ namespace GameUtils
 
         REFL_SIMPLE_STRUCT( ShaderUniforms
             REFL_DECL(Graphics::Uniform<Graphics::TexUnit> REFL_ATTR Graphics::Frag) texture
+            REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Vert) tex_scale // The used part of the texture.
         )
 
         static constexpr const char *shader_vert_src = R"(
     varying vec2 v_texcoord;
     void main()
     {
-        v_texcoord = a_pos * 0.5 + 0.5;
+        v_texcoord = (a_pos * 0.5 + 0.5) * u_tex_scale;
         gl_Position = vec4(a_pos, 0, 1);
     })";
         static constexpr const char *shader_frag_src = R"(
@@ -44,6 +50,44 @@ namespace GameUtils
         Graphics::TexUnit tex_unit;
         Graphics::FrameBuffer fbuf, fbuf_intermediate;
         Graphics::VertexBuffer<ShaderAttribs> vertex_buf;
+
+        // Those are used to skip the redundant texture reallocations.
+        bool target_size_outdated = true;
+        ivec2 intermediate_tex_size = ivec2(0);
+
+        DynamicResolution dyn_res;
+        float render_scale = 1;
+        ivec2 render_size = ivec2(0);
+        double smoothed_frame_time = -1; // Negative if there are no measurements yet.
+
+        #ifdef IMP_HAVE_TIMER_QUERIES
+        // The queries are read a few frames later, to not stall the pipeline.
+        struct FrameQueries
+        {
+            Graphics::TimerQuery begin, end;
+            bool pending = false;
+        };
+        std::array<FrameQueries, 3> queries;
+        int query_index = 0;
+        #endif
+
+        void UpdateRenderSize()
+        {
+            render_size = clamp_min(iround(details.Size() * render_scale), 1);
+            render_size = min(render_size, details.Size());
+        }
+
+        void ResetDynamicResolution()
+        {
+            render_scale = 1;
+            smoothed_frame_time = -1;
+            UpdateRenderSize();
+
+            #ifdef IMP_HAVE_TIMER_QUERIES
+            for (FrameQueries &q : queries)
+                q.pending = false;
+            #endif
+        }
     };
 
     AdaptiveViewport::AdaptiveViewport() {}
@@ -55,6 +99,7 @@ namespace GameUtils
         data->fbuf_tex_intermediate = nullptr;
         data->tex_unit = nullptr;
         data->shader_uni.texture = data->tex_unit;
+        data->shader_uni.tex_scale = fvec2(1);
         data->tex_unit.Attach(data->fbuf_tex).Wrap(Graphics::clamp).Interpolation(Graphics::nearest);
         data->tex_unit.Attach(data->fbuf_tex_intermediate).Wrap(Graphics::clamp).Interpolation(Graphics::linear);
         data->fbuf = Graphics::FrameBuffer(nullptr).Attach(data->fbuf_tex);
@@ -81,14 +126,21 @@ namespace GameUtils
 
     void AdaptiveViewport::SetSize(ivec2 new_size)
     {
+        if (new_size == data->details.Size())
+            return;
         data->details.SetSize(new_size);
         data->tex_unit.Attach(data->fbuf_tex).SetData(new_size);
+        data->target_size_outdated = true;
+        data->ResetDynamicResolution();
     }
 
     void AdaptiveViewport::Update(ivec2 new_target_size)
     {
+        if (!data->target_size_outdated && new_target_size == data->details.TargetSize())
+            return;
+        data->target_size_outdated = false;
         data->details.Update(new_target_size);
-        data->tex_unit.Attach(data->fbuf_tex_intermediate).SetData(data->details.IntermediateSize());
+        // The intermediate texture is allocated lazily in `FinishFrame()`, since it's not needed for the integer scales.
     }
 
     void AdaptiveViewport::Update()
@@ -98,29 +150,119 @@ namespace GameUtils
 
     void AdaptiveViewport::BeginFrame()
     {
+        #ifdef IMP_HAVE_TIMER_QUERIES
+        if (data->dyn_res.enabled && data->dyn_res.measure_automatically)
+        {
+            Data::FrameQueries &q = data->queries[data->query_index];
+            // If the queries are still not ready after a few frames, drop this measurement instead of stalling.
+            if (q.pending && q.end.Available())
+                ReportFrameTime((q.end.Nanoseconds() - q.begin.Nanoseconds()) / 1e9);
+            if (!q.begin)
+            {
+                q.begin = nullptr;
+                q.end = nullptr;
+            }
+            q.begin.Record();
+            q.pending = false;
+        }
+        #endif
+
         data->fbuf.Bind();
-        Graphics::Viewport(data->details.Size());
+        Graphics::Viewport(data->render_size);
     }
 
     void AdaptiveViewport::FinishFrame(const Graphics::FrameBuffer *fbuf)
     {
+        #ifdef IMP_HAVE_TIMER_QUERIES
+        if (data->dyn_res.enabled && data->dyn_res.measure_automatically)
+        {
+            Data::FrameQueries &q = data->queries[data->query_index];
+            if (q.begin)
+            {
+                q.end.Record();
+                q.pending = true;
+                data->query_index = (data->query_index + 1) % int(data->queries.size());
+            }
+        }
+        #endif
+
+        const Details &details = data->details;
+        bool full_res = data->render_size == details.Size();
+
         data->shader.Bind();
 
-        data->fbuf_intermediate.Bind();
-        Graphics::Viewport(data->details.IntermediateSize());
-        data->tex_unit.Attach(data->fbuf_tex);
-        data->vertex_buf.Draw(Graphics::triangles);
+        // With an integer scale, the first pass alone gives the same result, so we skip the second one.
+        if (!full_res || !details.IsIntegerScale())
+        {
+            if (data->intermediate_tex_size != details.IntermediateSize())
+            {
+                data->intermediate_tex_size = details.IntermediateSize();
+                data->tex_unit.Attach(data->fbuf_tex_intermediate).SetData(data->intermediate_tex_size);
+            }
+
+            data->fbuf_intermediate.Bind();
+            Graphics::Viewport(details.IntermediateSize());
+            data->tex_unit.Attach(data->fbuf_tex);
+            data->shader_uni.tex_scale = fvec2(data->render_size) / fvec2(details.Size());
+            data->vertex_buf.Draw(Graphics::triangles);
+        }
 
         if (fbuf)
             fbuf->Bind();
         else
             Graphics::FrameBuffer::BindDefault();
-        Graphics::Viewport(data->details.ViewportPos(), data->details.ViewportSize());
+        Graphics::Viewport(details.ViewportPos(), details.ViewportSize());
         Graphics::Clear();
-        data->tex_unit.Attach(data->fbuf_tex_intermediate);
+        data->tex_unit.Attach(full_res && details.IsIntegerScale() ? data->fbuf_tex : data->fbuf_tex_intermediate);
+        data->shader_uni.tex_scale = fvec2(1);
         data->vertex_buf.Draw(Graphics::triangles);
     }
 
+    void AdaptiveViewport::SetDynamicResolution(const DynamicResolution &params)
+    {
+        data->dyn_res = params;
+        data->ResetDynamicResolution();
+    }
+
+    const AdaptiveViewport::DynamicResolution &AdaptiveViewport::GetDynamicResolution() const
+    {
+        return data->dyn_res;
+    }
+
+    void AdaptiveViewport::ReportFrameTime(double seconds)
+    {
+        if (!data->dyn_res.enabled || !(seconds > 0))
+            return;
+
+        double &time = data->smoothed_frame_time;
+        time = time < 0 ? seconds : time * 0.9 + seconds * 0.1;
+
+        float old_scale = data->render_scale;
+        if (time > data->dyn_res.budget)
+        {
+            // The GPU time is roughly proportional to the pixel count, hence the square root. Don't drop more than 10% per frame, since the measurements are noisy.
+            data->render_scale *= float(std::clamp(std::sqrt(data->dyn_res.budget / time), 0.9, 1.));
+        }
+        else if (time < data->dyn_res.budget * 0.75)
+        {
+            // Grow slowly, to not oscillate.
+            data->render_scale += 0.01f;
+        }
+        data->render_scale = std::clamp(data->render_scale, std::min(data->dyn_res.min_scale, 1.f), 1.f);
+
+        if (data->render_scale != old_scale)
+        {
+            // Predict the new time, so that the lagging average doesn't keep changing the scale.
+            time *= (data->render_scale * data->render_scale) / (old_scale * old_scale);
+            data->UpdateRenderSize();
+        }
+    }
+
+    ivec2 AdaptiveViewport::RenderSize() const
+    {
+        return data->render_size;
+    }
+
     Graphics::FrameBuffer &AdaptiveViewport::GetFrameBuffer()
     {
         return data->fbuf;
@@ -29,6 +29,10 @@ namespace GameUtils
             ivec2 viewport_pos = ivec2(0); // Output viewport position.
             ivec2 viewport_size = ivec2(0); // Output viewport size. Same as `target_size`, but shrinked to proportion.
 
+            // Cached matrices.
+            fmat4 matrix, matrix_centered; // Updated by `SetSize()`.
+            fmat3 mouse_matrix, mouse_matrix_centered; // Updated by `Update()`.
+
           public:
             Details() {}
 
@@ -42,6 +46,11 @@ namespace GameUtils
             void SetSize(ivec2 new_size)
             {
                 size = new_size;
+
+                ivec2 a = -size/2;
+                ivec2 b = a + size;
+                matrix_centered = fmat4::ortho(ivec2(a.x, b.y), ivec2(b.x, a.y), -1, 1);
+                matrix = fmat4::ortho(ivec2(0, size.y), ivec2(size.x, 0), -1, 1);
             }
 
             // Recalculates viewport based on previously selected size and `new_target_size` (normally the window size).
@@ -53,6 +62,9 @@ namespace GameUtils
                 intermediate_size = size * scale_floor;
                 viewport_size = min(iround(size * scale), new_target_size);
                 viewport_pos = (new_target_size - viewport_size)/2;
+
+                mouse_matrix_centered = fmat3::scale(fvec2(1 / scale)) * fmat3::translate(-viewport_pos - viewport_size/2);
+                mouse_matrix = fmat3::scale(fvec2(1 / scale)) * fmat3::translate(-viewport_pos);
             }
 
             // Source size.
@@ -86,33 +98,64 @@ namespace GameUtils
                 return viewport_size;
             }
 
+            // Returns true if the scale is an integer, then the frame is upscaled in a single pass, without the intermediate texture.
+            [[nodiscard]] bool IsIntegerScale() const
+            {
+                return viewport_size == intermediate_size;
+            }
+
             // Provides a matrix for rendering shaders. Puts the origin in the middle of the screen.
             // Doesn't depend on target size and works without `Update()`.
-            [[nodiscard]] fmat4 MatrixCentered() const
+            [[nodiscard]] const fmat4 &MatrixCentered() const
             {
-                ivec2 a = -size/2;
-                ivec2 b = a + size;
-                return fmat4::ortho(ivec2(a.x, b.y), ivec2(b.x, a.y), -1, 1);
+                return matrix_centered;
             }
             // Provides a matrix for rendering shaders. Puts the origin in the corner.
             // Doesn't depend on target size and works without Update().
-            [[nodiscard]] fmat4 Matrix() const
+            [[nodiscard]] const fmat4 &Matrix() const
             {
-                return fmat4::ortho(ivec2(0, size.y), ivec2(size.x, 0), -1, 1);
+                return matrix;
+            }
+
+            // The visible area in the source coordinate system, with the origin in the middle of the screen, as in `MatrixCentered()`.
+            // Offset it by the camera position to get the visible part of the world, e.g. for `VisibilitySet`.
+            [[nodiscard]] irect2 RectCentered() const
+            {
+                return (-size/2).rect_size(size);
+            }
+            // Same, but with the origin in the corner, as in `Matrix()`.
+            [[nodiscard]] irect2 Rect() const
+            {
+                return ivec2().rect_size(size);
             }
 
             // The inverse matrix, to map mouse position to the source coordinate system. Puts the origin in the middle of the screen.
-            [[nodiscard]] fmat3 MouseMatrixCentered() const
+            [[nodiscard]] const fmat3 &MouseMatrixCentered() const
             {
-                return fmat3::scale(fvec2(1 / scale)) * fmat3::translate(-ViewportPos() - ViewportSize()/2);
+                return mouse_matrix_centered;
             }
             // The inverse matrix, to map mouse position to the source coordinate system. Puts the origin in the corner.
-            [[nodiscard]] fmat3 MouseMatrix() const
+            [[nodiscard]] const fmat3 &MouseMatrix() const
             {
-                return fmat3::scale(fvec2(1 / scale)) * fmat3::translate(-ViewportPos());
+                return mouse_matrix;
             }
         };
 
+        // Lowers the resolution of the rendering when the GPU can't keep up.
+        // The frame is rendered into the corner of the framebuffer (see `RenderSize()`), and then upscaled as usual.
+        // The matrices don't change, but don't rely on one source unit being one pixel when this is enabled.
+        struct DynamicResolution
+        {
+            bool enabled = false;
+            // The target GPU time of the rendering between `BeginFrame()` and `FinishFrame()`, in seconds.
+            double budget = 0.010;
+            // The lowest allowed render size, relative to `Details::Size()`.
+            float min_scale = 0.5f;
+            // If true, the GPU time is measured with timer queries, if they are supported.
+            // Otherwise you need to measure it yourself, and call `ReportFrameTime()`.
+            bool measure_automatically = true;
+        };
+
         AdaptiveViewport();
 
         // After this you need to call `SetSize` to set the source size.
@@ -130,6 +173,7 @@ namespace GameUtils
         void SetSize(ivec2 new_size);
 
         // Recalculates viewport based on previously selected size and `new_target_size` (normally the window size).
+        // Does nothing if neither the sizes changed since the last call, so it's cheap to call every frame.
         void Update(ivec2 new_target_size);
         // Same, but uses current window size.
         void Update();
@@ -137,8 +181,21 @@ namespace GameUtils
         // Binds the internal framebuffer and sets a proper viewport for it.
         void BeginFrame();
         // Rescales and outputs the frame to the passed framebuffer.
+        // If the scale is an integer (and the dynamic resolution didn't lower the resolution), draws directly to it, without the intermediate texture.
         void FinishFrame(const Graphics::FrameBuffer *fbuf = 0);
 
+        // Configures the dynamic resolution. It's disabled by default. Disabling it restores the full resolution.
+        void SetDynamicResolution(const DynamicResolution &params);
+        [[nodiscard]] const DynamicResolution &GetDynamicResolution() const;
+
+        // Reports the GPU time of the last frame (between `BeginFrame()` and `FinishFrame()`) in seconds, for the dynamic resolution.
+        // Use this if `DynamicResolution::measure_automatically` is false, or if timer queries aren't supported.
+        void ReportFrameTime(double seconds);
+
+        // The size of the framebuffer area that's rendered to, starting from the corner. `BeginFrame()` sets the viewport to it.
+        // Equal to `GetDetails().Size()`, unless the dynamic resolution lowered it.
+        [[nodiscard]] ivec2 RenderSize() const;
+
         // Returns the internal framebuffer.
         // It's bound by default when you call `BeginFrame()`.
         [[nodiscard]] Graphics::FrameBuffer &GetFrameBuffer();
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+#include "graphics/image.h"
+#include "graphics/pixel_readback.h"
+#include "utils/jobs.h"
+#include "utils/mat.h"
+
+// Captures the rendered frames for screenshots or continuous video capture, without stalling the main thread.
+// The pixels are read back asynchronously (see `Graphics::PixelReadback`), and are flipped and passed to `on_frame` on a thread pool.
+// Usage:
+//     GameUtils::FrameCapture capture(Jobs::GlobalPool(), window_size);
+//     capture.on_frame = [](Graphics::Image image, std::uint64_t index){image.Save(FMT("capture/{:06}.png", index));}; // Runs on a worker thread.
+//
+//     // Each frame, after rendering, before swapping the buffers:
+//     capture.Update();
+//     if (want_to_capture)
+//         capture.Capture();
+//
+//     // Before destroying the GL context:
+//     capture.Finish();
+
+namespace GameUtils
+{
+    #ifdef IMP_HAVE_ASYNC_PIXEL_READBACK
+    class FrameCapture
+    {
+        enum class SlotState {idle, reading, processing};
+
+        struct Slot
+        {
+            Graphics::PixelReadback readback;
+            Jobs::Counter job;
+            SlotState state = SlotState::idle;
+            std::uint64_t frame_index = 0;
+        };
+
+        Jobs::ThreadPool *pool = nullptr;
+        ivec2 size;
+        int slot_count = 0;
+        std::unique_ptr<Slot[]> slots;
+        std::uint64_t next_frame_index = 0;
+        std::uint64_t dropped_frames = 0;
+
+        // Maps the finished readback, and passes it to the pool. Waits for the readback if it's not finished yet.
+        void BeginProcessing(Slot &slot)
+        {
+            slot.readback.Map();
+            slot.state = SlotState::processing;
+            pool->Submit(slot.job, [this, &slot]
+            {
+                if (on_frame)
+                    on_frame(slot.readback.ToImage(), slot.frame_index);
+            });
+        }
+
+        // Waits for the job, and makes the slot reusable. Rethrows the exceptions from `on_frame`.
+        void EndProcessing(Slot &slot)
+        {
+            slot.state = SlotState::idle;
+            pool->Wait(slot.job);
+            slot.readback.Unmap();
+        }
+
+      public:
+        // Called on the pool threads for each captured frame, possibly for several frames at once, not necessarily in order.
+        // `frame_index` counts the `Capture()` calls that weren't dropped, starting from zero.
+        std::function<void(Graphics::Image image, std::uint64_t frame_index)> on_frame;
+
+        FrameCapture() {}
+
+        // The pool must outlive this object. `size` is the size of the captured area.
+        // `slot_count` is how many frames can be in flight at once (being read back or processed). If they're all busy, `Capture()` drops the frame.
+        FrameCapture(Jobs::ThreadPool &pool, ivec2 size, int slot_count = 3)
+            : pool(&pool), size(size), slot_count(slot_count)
+        {
+            if (slot_count <= 0)
+                throw std::runtime_error("The frame capture needs at least one slot.");
+            slots = std::make_unique<Slot[]>(slot_count);
+            for (int i = 0; i < slot_count; i++)
+                slots[i].readback = Graphics::PixelReadback(nullptr, size);
+        }
+
+        // The running jobs point to this object.
+        FrameCapture(const FrameCapture &) = delete;
+        FrameCapture &operator=(const FrameCapture &) = delete;
+
+        // Waits for the running jobs, but drops the frames that are still being read back.
+        ~FrameCapture()
+        {
+            for (int i = 0; i < slot_count; i++)
+            {
+                if (slots[i].state == SlotState::processing)
+                    pool->Wait(slots[i].job);
+            }
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(slots);
+        }
+
+        [[nodiscard]] ivec2 Size() const
+        {
+            return size;
+        }
+
+        // How many `Capture()` calls were ignored because all slots were busy.
+        [[nodiscard]] std::uint64_t DroppedFrames() const
+        {
+            return dropped_frames;
+        }
+
+        // Starts reading `Size()` pixels at `pos` from the framebuffer bound for reading. Returns immediately.
+        // Returns false and drops the frame if all slots are busy.
+        bool Capture(ivec2 pos = ivec2(0))
+        {
+            for (int i = 0; i < slot_count; i++)
+            {
+                Slot &slot = slots[i];
+                if (slot.state != SlotState::idle)
+                    continue;
+                slot.readback.Start(pos);
+                slot.state = SlotState::reading;
+                slot.frame_index = next_frame_index++;
+                return true;
+            }
+            dropped_frames++;
+            return false;
+        }
+
+        // Call once per frame. Passes the finished readbacks to the pool, and reclaims the slots of the finished jobs. Never waits.
+        // Rethrows the exceptions from `on_frame`.
+        void Update()
+        {
+            for (int i = 0; i < slot_count; i++)
+            {
+                Slot &slot = slots[i];
+                if (slot.state == SlotState::processing && slot.job.IsDone())
+                    EndProcessing(slot);
+                if (slot.state == SlotState::reading && slot.readback.Done())
+                    BeginProcessing(slot);
+            }
+        }
+
+        // Waits until all captured frames are passed to `on_frame`, e.g. before exiting or to take a single screenshot synchronously.
+        // Rethrows the exceptions from `on_frame`.
+        void Finish()
+        {
+            for (int i = 0; i < slot_count; i++)
+            {
+                if (slots[i].state == SlotState::reading)
+                    BeginProcessing(slots[i]);
+            }
+            for (int i = 0; i < slot_count; i++)
+            {
+                if (slots[i].state == SlotState::processing)
+                    EndProcessing(slots[i]);
+            }
+        }
+    };
+    #endif
+}
@@ -1,21 +1,26 @@
 #pragma once
 
 #include <concepts>
+#include <cstring>
 #include <functional>
 #include <map>
+#include <span>
 #include <string>
+#include <utility>
 #include <variant>
 
 #include "meta/common.h"
 #include "reflection/full.h"
 #include "stream/input.h"
 #include "strings/format.h"
+#include "utils/byte_order.h"
 #include "utils/mat.h"
 #include "utils/robust_math.h"
 
 namespace GameUtils
 {
     // Contains code that parses `.ply` models.
+    // Supports both the text and the binary files. Prefer the binary ones, they load much faster, especially if the `Stream::Input` is backed by memory.
     class GeometryPly
     {
       public:
@@ -23,14 +28,30 @@ namespace GameUtils
         {
             int index = 0; // Index of the property in the file. Not useful to user.
             bool is_uint8 = false; // Type of the property. `uint8_t` if true, `float` otherwise.
+            std::size_t byte_offset = 0; // Offset of the property in a vertex, in binary files. Not useful to user.
+        };
+
+        enum class Encoding
+        {
+            ascii,
+            binary_little_endian,
+            binary_big_endian,
         };
 
       private:
         std::map<std::string, Property, std::less<>> properties;
         std::size_t vertex_count = 0;
         std::size_t face_count = 0;
+        std::size_t vertex_byte_size = 0; // The size of one vertex in binary files.
+        Encoding encoding = Encoding::ascii;
+        bool vertices_parsed = false;
         Stream::Input input;
 
+        [[nodiscard]] ByteOrder::Order GetByteOrder() const
+        {
+            return encoding == Encoding::binary_big_endian ? ByteOrder::big : ByteOrder::little;
+        }
+
       public:
         // Parses the file header. You can inspect it using the functions below, then finish the parsing by calling `ParseBody()`.
         // If you don't need to inspect the header, call `Parse` instead, which combines the effects of those two functions.
@@ -40,7 +61,16 @@ namespace GameUtils
 
             input.WantLocationStyle(Stream::text_byte_position);
             input.DiscardChars("ply\n");
-            input.DiscardChars("format ascii 1.0\n");
+            input.DiscardChars("format ");
+            if (input.DiscardChars<Stream::if_present>("ascii "))
+                ret.encoding = Encoding::ascii;
+            else if (input.DiscardChars<Stream::if_present>("binary_little_endian "))
+                ret.encoding = Encoding::binary_little_endian;
+            else if (input.DiscardChars<Stream::if_present>("binary_big_endian "))
+                ret.encoding = Encoding::binary_big_endian;
+            else
+                throw std::runtime_error(input.GetExceptionPrefix() + "Unknown format, expected `ascii`, `binary_little_endian`, or `binary_big_endian`.");
+            input.DiscardChars("1.0\n");
             if (input.DiscardChars<Stream::if_present>("comment "))
             {
                 input.Discard<Stream::any>(!Stream::Char::EqualTo('\n'));
@@ -53,12 +83,14 @@ namespace GameUtils
             {
                 Property new_property;
                 new_property.index = ret.properties.size();
+                new_property.byte_offset = ret.vertex_byte_size;
                 if (input.DiscardChars<Stream::if_present>("float "))
                     new_property.is_uint8 = false;
                 else if (input.DiscardChars<Stream::if_present>("uchar "))
                     new_property.is_uint8 = true;
                 else
                     throw std::runtime_error(input.GetExceptionPrefix() + "Unknown property type, expected `float` or `uchar`.");
+                ret.vertex_byte_size += new_property.is_uint8 ? 1 : sizeof(float);
                 std::string property_name = input.Extract(Stream::Char::IsAlpha());
                 input.Discard('\n');
 
@@ -81,6 +113,9 @@ namespace GameUtils
         // and we don't know the exact amount until we parse the remaining data.
         [[nodiscard]] std::size_t VertexCount() const {return vertex_count;}
 
+        // Returns the encoding of the file body.
+        [[nodiscard]] Encoding GetEncoding() const {return encoding;}
+
         // Returns true if the file contains a property called `name`.
         [[nodiscard]] bool HasProperty(std::string_view name) const {return properties.contains(name);}
 
@@ -133,13 +168,14 @@ namespace GameUtils
             requires is_valid_member_ptr_v<MemPtr> && (sizeof...(names) == Math::vec_size_v<mem_ptr_target_t<MemPtr>>)
             {
                 std::string names_array[] = {std::string(names)...};
-                for (int i = 0; i < Math::vec_size_v<mem_ptr_target_t<MemPtr>>; i++)
+                // The element index must be a constant, since the lambdas are converted to plain function pointers.
+                [&]<int ...I>(std::integer_sequence<int, I...>)
                 {
-                    funcs.insert_or_assign(std::move(names_array[i]), [i](VertexType &obj, Math::vec_base_t<mem_ptr_target_t<MemPtr>> value)
+                    (void(funcs.insert_or_assign(std::move(names_array[I]), +[](VertexType &obj, Math::vec_base_t<mem_ptr_target_t<MemPtr>> value)
                     {
-                        Math::vec_elem(i, obj.*MemPtr) = value;
-                    });
-                }
+                        Math::vec_elem(I, obj.*MemPtr) = value;
+                    })), ...);
+                }(std::make_integer_sequence<int, Math::vec_size_v<mem_ptr_target_t<MemPtr>>>{});
                 return *this;
             }
 
@@ -159,41 +195,121 @@ namespace GameUtils
             std::vector<IndexType> indices;
         };
 
-        // Finishes the file parsing started by `ParseHeader`.
-        template <typename IndexType, typename VertexType>
-        [[nodiscard]] Data<IndexType, VertexType> ParseBody(const Format<VertexType> &format)
+      private:
+        // Maps a property of the file to a function that writes it to a vertex.
+        template <typename VertexType>
+        struct Entry
         {
-            static_assert(std::is_same_v<IndexType, std::uint8_t> || std::is_same_v<IndexType, std::uint16_t> || std::is_same_v<IndexType, std::uint32_t>);
+            bool property_is_uint8 = false; // Type of the property. `uint8_t` if true, `float` otherwise.
+            std::size_t byte_offset = 0; // See `Property::byte_offset`.
+            func_variant_t<VertexType> func;
 
-            // Make a table mapping property indices to various info about them.
-            struct Entry
+            void Apply(VertexType &vertex, std::uint8_t number) const
             {
-                bool property_is_uint8 = false; // Type of the property. `uint8_t` if true, `float` otherwise.
-                func_variant_t<VertexType> func;
-            };
-            std::vector<Entry> table(properties.size());
-            for (const auto &[name, func] : format.funcs)
+                std::visit(Meta::overload
+                {
+                    [&](std::monostate) {}, // Unused property.
+                    [&](func_uint8_t<VertexType> func) {func(vertex, number);}, // Exact type match.
+                    [&](func_float_t<VertexType> func) {func(vertex, number / 255.f);}, // Convert to float.
+                }, func);
+            }
+
+            void Apply(VertexType &vertex, float number) const
             {
-                const Property &property = GetPropertyInfo(name);
-                Entry &entry = table[property.index];
+                std::visit(Meta::overload
+                {
+                    [&](std::monostate) {}, // Unused property.
+                    [&](func_float_t<VertexType> func) {func(vertex, number);}, // Exact type match.
+                    [&](func_uint8_t<VertexType> func) {func(vertex, clamp_max(int(clamp(number) * 255.f + 0.5f), 255));}, // Convert to `uint8_t`, with saturation.
+                }, func);
+            }
+        };
+
+        // Makes a table mapping property indices to various info about them.
+        template <typename VertexType>
+        [[nodiscard]] std::vector<Entry<VertexType>> MakeEntryTable(const Format<VertexType> &format) const
+        {
+            std::vector<Entry<VertexType>> table(properties.size());
+            for (const auto &[name, property] : properties)
+            {
+                Entry<VertexType> &entry = table[property.index];
                 entry.property_is_uint8 = property.is_uint8;
-                entry.func = func;
+                entry.byte_offset = property.byte_offset;
             }
+            for (const auto &[name, func] : format.funcs)
+                table[GetPropertyInfo(name).index].func = func;
+            return table;
+        }
 
-            Data<IndexType, VertexType> ret;
+      public:
+        // Parses the vertices directly into `target`, which must have exactly `VertexCount()` elements.
+        // This lets you decode straight into the buffer that you're going to upload (e.g. to `Graphics::VertexBuffer::SetData()`), without an extra copy.
+        // Must be called once, after `ParseHeader()`, and before `ParseIndices()`.
+        // For binary files, if `input` is backed by memory, the vertices are decoded directly from it.
+        template <typename VertexType>
+        void ParseVertices(const Format<VertexType> &format, std::span<VertexType> target)
+        {
+            if (vertices_parsed)
+                throw std::runtime_error("The vertices of this `.ply` file were already parsed.");
+            if (target.size() != vertex_count)
+                throw std::runtime_error(FMT("Wrong size of the target buffer for `.ply` vertices: {}, expected {}.", target.size(), vertex_count));
+            vertices_parsed = true;
+
+            std::vector<Entry<VertexType>> table = MakeEntryTable(format);
+
+            if (encoding != Encoding::ascii)
+            {
+                // Skip the unused properties completely.
+                std::erase_if(table, [](const Entry<VertexType> &entry){return std::holds_alternative<std::monostate>(entry.func);});
+
+                ByteOrder::Order order = GetByteOrder();
+
+                // If the stream is backed by memory, decode directly from it. Otherwise read one vertex at a time,
+                //   rather than copying all of them at once, since the vertex count comes from the file.
+                const std::uint8_t *all_bytes = nullptr;
+                std::size_t total_size = Robust::checked_mul<std::size_t>(vertex_count, vertex_byte_size);
+                std::vector<std::uint8_t> vertex_buffer;
+                if (input.IsContiguous())
+                    all_bytes = input.PeekSpan(total_size).data();
+                else
+                    vertex_buffer.resize(vertex_byte_size);
+
+                for (std::size_t i = 0; i < vertex_count; i++)
+                {
+                    VertexType &vertex = target[i];
+                    const std::uint8_t *vertex_bytes = all_bytes ? all_bytes + i * vertex_byte_size : vertex_buffer.data();
+                    if (!all_bytes)
+                        input.Read(vertex_buffer.data(), vertex_byte_size);
+                    for (const Entry<VertexType> &entry : table)
+                    {
+                        if (entry.property_is_uint8)
+                        {
+                            entry.Apply(vertex, vertex_bytes[entry.byte_offset]);
+                        }
+                        else
+                        {
+                            float number;
+                            std::memcpy(&number, vertex_bytes + entry.byte_offset, sizeof number);
+                            ByteOrder::Convert(number, order);
+                            entry.Apply(vertex, number);
+                        }
+                    }
+                }
+                if (all_bytes)
+                    input.Skip(total_size);
+                return;
+            }
 
-            // Read vertices.
-            ret.vertices.resize(vertex_count);
             for (std::size_t i = 0; i < vertex_count; i++)
             {
-                VertexType &vertex = ret.vertices[i];
+                VertexType &vertex = target[i];
                 // Read each property of this vertex.
                 for (std::size_t j = 0; j < table.size(); j++)
                 {
                     bool is_last = j == table.size() - 1;
                     char terminating_char = is_last ? '\n' : ' ';
 
-                    const Entry &entry = table[j];
+                    const Entry<VertexType> &entry = table[j];
 
                     // Parse the property.
                     if (std::holds_alternative<std::monostate>(entry.func))
@@ -206,38 +322,44 @@ namespace GameUtils
                         // `uint8_t` property.
                         std::uint8_t number = 0;
                         Refl::InterfaceFor(number).FromString(number, input, {}, Refl::initial_state);
-                        std::visit(Meta::overload
-                        {
-                            [&](std::monostate) {}, // Shouldn't happen.
-                            [&](func_uint8_t<VertexType> func) {func(vertex, number);}, // Exact type match.
-                            [&](func_float_t<VertexType> func) {func(vertex, number / 255.f);}, // Convert to float.
-                        }, entry.func);
+                        entry.Apply(vertex, number);
                     }
                     else
                     {
                         // `float` property.
                         float number = 0;
                         Refl::InterfaceFor(number).FromString(number, input, {}, Refl::initial_state);
-                        std::visit(Meta::overload
-                        {
-                            [&](std::monostate) {}, // Shouldn't happen.
-                            [&](func_float_t<VertexType> func) {func(vertex, number);}, // Exact type match.
-                            [&](func_uint8_t<VertexType> func) {func(vertex, clamp_max(int(clamp(number) * 255.f + 0.5f), 255));}, // Convert to `uint8_t`, with saturation.
-                        }, entry.func);
+                        entry.Apply(vertex, number);
                     }
 
                     // Skip the separator.
                     input.Discard(terminating_char);
                 }
             }
+        }
+
+        // Parses the faces, triangulates them, and appends the resulting indices to `indices`.
+        // Must be called once, after `ParseVertices()`. Finishes the parsing.
+        template <typename IndexType, typename VertexType>
+        void ParseIndices(const Format<VertexType> &format, std::vector<IndexType> &indices)
+        {
+            static_assert(std::is_same_v<IndexType, std::uint8_t> || std::is_same_v<IndexType, std::uint16_t> || std::is_same_v<IndexType, std::uint32_t>);
+
+            if (!vertices_parsed)
+                throw std::runtime_error("Must parse the vertices of a `.ply` file before the indices.");
+
+            bool is_binary = encoding != Encoding::ascii;
+            ByteOrder::Order order = GetByteOrder();
 
-            // Read indices.
             if (format.allow_triangle_faces_only)
-                ret.indices.reserve(face_count * 3);
+                indices.reserve(indices.size() + face_count * 3);
             for (std::size_t i = 0; i < face_count; i++)
             {
                 std::uint8_t list_size; // This type is selected intentionally, to match the `property list ...` line in the files.
-                Refl::InterfaceFor(list_size).FromString(list_size, input, {}, Refl::initial_state);
+                if (is_binary)
+                    list_size = input.ReadByte();
+                else
+                    Refl::InterfaceFor(list_size).FromString(list_size, input, {}, Refl::initial_state);
                 if (format.allow_triangle_faces_only && list_size != 3)
                     throw std::runtime_error(input.GetExceptionPrefix() + STR("Expected exactly three elements in the list."));
                 else if (!format.allow_triangle_faces_only && list_size < 2)
@@ -247,28 +369,45 @@ namespace GameUtils
                 tmp_index_t prev_indices[2];
                 for (decltype(list_size) j = 0; j < list_size; j++)
                 {
-                    input.Discard(' ');
                     tmp_index_t this_index;
-                    Refl::InterfaceFor(this_index).FromString(this_index, input, {}, Refl::initial_state);
+                    if (is_binary)
+                    {
+                        this_index = input.ReadWithByteOrder<tmp_index_t>(order);
+                    }
+                    else
+                    {
+                        input.Discard(' ');
+                        Refl::InterfaceFor(this_index).FromString(this_index, input, {}, Refl::initial_state);
+                    }
                     if (!Robust::representable_as<IndexType>(this_index))
                         throw std::runtime_error(input.GetExceptionPrefix() + "The index is not representable in the target type.");
 
                     if (j > 1)
                     {
                         for (tmp_index_t index : prev_indices)
-                            ret.indices.push_back(index);
-                        ret.indices.push_back(this_index);
+                            indices.push_back(index);
+                        indices.push_back(this_index);
                     }
 
                     prev_indices[int(j != 0)] = this_index;
                 }
 
-                if (i != face_count - 1)
+                if (!is_binary && i != face_count - 1)
                     input.Discard('\n');
             }
-            input.Discard<Stream::if_present>('\n');
+            if (!is_binary)
+                input.Discard<Stream::if_present>('\n');
             input.ExpectEnd();
+        }
 
+        // Finishes the file parsing started by `ParseHeader`.
+        template <typename IndexType, typename VertexType>
+        [[nodiscard]] Data<IndexType, VertexType> ParseBody(const Format<VertexType> &format)
+        {
+            Data<IndexType, VertexType> ret;
+            ret.vertices.resize(vertex_count);
+            ParseVertices(format, std::span(ret.vertices));
+            ParseIndices(format, ret.indices);
             return ret;
         }
 
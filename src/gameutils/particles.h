@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <span>
+#include <vector>
+
+#include "gameutils/render.h"
+#include "utils/jobs.h"
+#include "utils/mat.h"
+#include "utils/random.h"
+
+// A lightweight particle system, for the effects that would be too expensive as entities.
+// The particles are stored as separate arrays (structure of arrays), so the update loops vectorize, and are drawn with `Render::Sprites()`.
+// Usage:
+//     GameUtils::ParticleSystem particles;
+//     particles.gravity = fvec2(0, 200);
+//     particles.sprites = {spark_region}; // Texture rects, indexed by `ParticleParams::sprite`.
+//
+//     GameUtils::ParticleEmitter emitter;
+//     emitter.base.life = 0.5f;
+//     emitter.rate = 1000;
+//     emitter.speed_min = 50;
+//     emitter.speed_max = 100;
+//
+//     // Each tick:
+//     emitter.pos = ...;
+//     emitter.Emit(particles, random_generator, tick_len);
+//     particles.Update(tick_len, &Jobs::GlobalPool());
+//
+//     // When rendering:
+//     render.SetAtlas(...);
+//     particles.Draw(render);
+
+namespace GameUtils
+{
+    // The initial parameters of a particle.
+    struct ParticleParams
+    {
+        fvec2 pos;
+        fvec2 vel;
+        float life = 1; // In seconds.
+        float angle = 0; // In radians.
+        float angular_vel = 0;
+        float size_begin = 1, size_end = 1; // Interpolated over the lifetime.
+        fvec4 color_begin = fvec4(1), color_end = fvec4(1, 1, 1, 0); // The last component is alpha. Interpolated over the lifetime.
+        std::uint16_t sprite = 0; // An index in `ParticleSystem::sprites`, or `ParticleSystem::no_sprite` to draw a plain color.
+    };
+
+    class ParticleSystem
+    {
+        // The arrays are always the same size.
+        std::vector<float> x, y, vx, vy;
+        std::vector<float> angle, angular_vel;
+        std::vector<float> age; // From 0 to 1. The particle dies when this reaches 1.
+        std::vector<float> age_step; // The inverse lifetime.
+        std::vector<float> size_begin, size_end;
+        std::vector<fvec4> color_begin, color_end;
+        std::vector<std::uint16_t> sprite;
+
+        std::vector<Render::Sprite> draw_buffer;
+
+        // The update runs on the pool in chunks of this many particles.
+        static constexpr std::size_t chunk_size = 4096;
+
+        void UpdateChunk(std::size_t begin, std::size_t end, float dt, float drag_factor)
+        {
+            // Separate loops over the plain float arrays, so each of them vectorizes.
+            float gx = gravity.x * dt, gy = gravity.y * dt;
+            for (std::size_t i = begin; i < end; i++)
+                vx[i] = (vx[i] + gx) * drag_factor;
+            for (std::size_t i = begin; i < end; i++)
+                vy[i] = (vy[i] + gy) * drag_factor;
+            for (std::size_t i = begin; i < end; i++)
+                x[i] += vx[i] * dt;
+            for (std::size_t i = begin; i < end; i++)
+                y[i] += vy[i] * dt;
+            for (std::size_t i = begin; i < end; i++)
+                angle[i] += angular_vel[i] * dt;
+            for (std::size_t i = begin; i < end; i++)
+                age[i] += age_step[i] * dt;
+        }
+
+        void SwapRemove(std::size_t i)
+        {
+            auto Remove = [i](auto &vec)
+            {
+                vec[i] = vec.back();
+                vec.pop_back();
+            };
+            Remove(x); Remove(y); Remove(vx); Remove(vy);
+            Remove(angle); Remove(angular_vel);
+            Remove(age); Remove(age_step);
+            Remove(size_begin); Remove(size_end);
+            Remove(color_begin); Remove(color_end);
+            Remove(sprite);
+        }
+
+      public:
+        static constexpr std::uint16_t no_sprite = 0xffff;
+
+        fvec2 gravity; // Acceleration, in units per second squared.
+        float drag = 0; // The velocity is multiplied by `exp(-drag * dt)` every update.
+        std::size_t max_particles = 1 << 20; // `Add()` ignores the new particles past this limit.
+
+        // The texture rects of the particles, in texels. Indexed by `ParticleParams::sprite`.
+        std::vector<irect2> sprites;
+
+        ParticleSystem() {}
+
+        [[nodiscard]] std::size_t Count() const
+        {
+            return x.size();
+        }
+
+        void Reserve(std::size_t count)
+        {
+            x.reserve(count); y.reserve(count); vx.reserve(count); vy.reserve(count);
+            angle.reserve(count); angular_vel.reserve(count);
+            age.reserve(count); age_step.reserve(count);
+            size_begin.reserve(count); size_end.reserve(count);
+            color_begin.reserve(count); color_end.reserve(count);
+            sprite.reserve(count);
+        }
+
+        // Removes all particles. Keeps the capacity.
+        void Clear()
+        {
+            x.clear(); y.clear(); vx.clear(); vy.clear();
+            angle.clear(); angular_vel.clear();
+            age.clear(); age_step.clear();
+            size_begin.clear(); size_end.clear();
+            color_begin.clear(); color_end.clear();
+            sprite.clear();
+        }
+
+        // Returns false if the limit was reached, then the particle is not added.
+        bool Add(const ParticleParams &params)
+        {
+            if (Count() >= max_particles || params.life <= 0)
+                return false;
+            x.push_back(params.pos.x);
+            y.push_back(params.pos.y);
+            vx.push_back(params.vel.x);
+            vy.push_back(params.vel.y);
+            angle.push_back(params.angle);
+            angular_vel.push_back(params.angular_vel);
+            age.push_back(0);
+            age_step.push_back(1 / params.life);
+            size_begin.push_back(params.size_begin);
+            size_end.push_back(params.size_end);
+            color_begin.push_back(params.color_begin);
+            color_end.push_back(params.color_end);
+            sprite.push_back(params.sprite);
+            return true;
+        }
+
+        // Moves the particles and removes the dead ones. The removal doesn't preserve the order.
+        // If `pool` isn't null and there are enough particles, the movement is split between its threads.
+        void Update(float dt, Jobs::ThreadPool *pool = nullptr)
+        {
+            std::size_t count = Count();
+            float drag_factor = std::exp(-drag * dt);
+
+            if (pool && count > chunk_size)
+            {
+                std::size_t num_chunks = (count + chunk_size - 1) / chunk_size;
+                Jobs::ParallelFor(*pool, 0, num_chunks, [&](std::size_t chunk)
+                {
+                    UpdateChunk(chunk * chunk_size, std::min((chunk + 1) * chunk_size, count), dt, drag_factor);
+                });
+            }
+            else
+            {
+                UpdateChunk(0, count, dt, drag_factor);
+            }
+
+            // Backwards, so the particles moved into the freed slots were already checked.
+            for (std::size_t i = count; i-- > 0;)
+            {
+                if (age[i] >= 1)
+                    SwapRemove(i);
+            }
+        }
+
+        // Draws all particles. Set the texture (e.g. with `Render::SetAtlas()`) first, if `sprites` are used.
+        void Draw(Render &render)
+        {
+            std::size_t count = Count();
+            draw_buffer.resize(count);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                float t = age[i];
+                fvec4 color = color_begin[i] + (color_end[i] - color_begin[i]) * t;
+                float size = size_begin[i] + (size_end[i] - size_begin[i]) * t;
+
+                Render::Sprite &out = draw_buffer[i];
+                out.pos = fvec2(x[i], y[i]);
+                out.dir = fvec2(std::cos(angle[i]), std::sin(angle[i]));
+                out.color = color.to_vec3();
+                out.alpha = color.a();
+                out.beta = 1;
+                if (sprite[i] < sprites.size())
+                {
+                    const irect2 &rect = sprites[sprite[i]];
+                    out.size = rect.size() * size;
+                    out.tex_pos = rect.a;
+                    out.tex_size = rect.size();
+                    out.mix = 1;
+                }
+                else
+                {
+                    out.size = fvec2(size);
+                    out.tex_pos = out.tex_size = fvec2(0);
+                    out.mix = 0;
+                }
+            }
+            render.Sprites(draw_buffer);
+        }
+    };
+
+    // Spawns particles with randomized parameters.
+    struct ParticleEmitter
+    {
+        ParticleParams base; // The position and the velocity in here are added to the random ones.
+
+        fvec2 pos;
+        fvec2 area; // The half-size of the rectangle around `pos` where the particles appear.
+
+        float direction = 0; // The center of the velocity directions, in radians.
+        float spread = std::numbers::pi_v<float>; // The max deviation from `direction`, in radians. The default covers all directions.
+        float speed_min = 0, speed_max = 0;
+        float life_min = 1, life_max = 1; // Replace `base.life`.
+
+        float rate = 0; // Particles per second, for `Emit()`.
+        float accumulator = 0; // The fractional part of the particle count, carried between the `Emit()` calls.
+
+        // Spawns `count` particles at once. The random numbers are generated in batches with `Random::Fill()`.
+        template <typename Generator>
+        void Burst(ParticleSystem &system, Generator &gen, std::size_t count)
+        {
+            constexpr std::size_t batch_size = 256;
+            float rand_x[batch_size], rand_y[batch_size], rand_dir[batch_size], rand_speed[batch_size], rand_life[batch_size];
+
+            while (count > 0)
+            {
+                std::size_t n = std::min(count, batch_size);
+                Random::Fill(gen, std::span(rand_x, n), -area.x, area.x);
+                Random::Fill(gen, std::span(rand_y, n), -area.y, area.y);
+                Random::Fill(gen, std::span(rand_dir, n), direction - spread, direction + spread);
+                Random::Fill(gen, std::span(rand_speed, n), speed_min, speed_max);
+                Random::Fill(gen, std::span(rand_life, n), life_min, life_max);
+
+                ParticleParams params = base;
+                for (std::size_t i = 0; i < n; i++)
+                {
+                    params.pos = base.pos + pos + fvec2(rand_x[i], rand_y[i]);
+                    params.vel = base.vel + fvec2(std::cos(rand_dir[i]), std::sin(rand_dir[i])) * rand_speed[i];
+                    params.life = rand_life[i];
+                    if (!system.Add(params))
+                        return;
+                }
+                count -= n;
+            }
+        }
+
+        // Spawns the particles for a `dt`-long time step, according to `rate`.
+        template <typename Generator>
+        void Emit(ParticleSystem &system, Generator &gen, float dt)
+        {
+            accumulator += rate * dt;
+            float whole = std::floor(accumulator);
+            accumulator -= whole;
+            if (whole > 0)
+                Burst(system, gen, std::size_t(whole));
+        }
+    };
+}
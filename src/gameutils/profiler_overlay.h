@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <imgui.h>
+
+#include "audio/stats.h"
+#include "graphics/profiler.h"
+#include "macros/finally.h"
+#include "utils/alloc_tracker.h"
+
+namespace GameUtils
+{
+    // Draws the last complete frame of the profiler as a flame graph, in an ImGui window.
+    // The top half shows the CPU times, the bottom half shows the GPU times (if known).
+    // If `audio_stats` is specified, also shows the audio costs below.
+    // Call this between `ImGui::NewFrame()` and `ImGui::Render()`.
+    inline void ProfilerOverlay(const Graphics::Profiler &profiler, bool *open = nullptr, const Audio::Stats *audio_stats = nullptr)
+    {
+        if (!ImGui::Begin("Profiler", open))
+        {
+            ImGui::End();
+            return;
+        }
+        FINALLY{ImGui::End();};
+
+        const Graphics::Profiler::Frame &frame = profiler.LastFrame();
+
+        if (frame.gpu_duration < 0)
+            ImGui::Text("CPU %.3f ms, GPU unknown", frame.cpu_duration * 1000);
+        else
+            ImGui::Text("CPU %.3f ms, GPU %.3f ms", frame.cpu_duration * 1000, frame.gpu_duration * 1000);
+        ImGui::Text("Dropped frames: %d", profiler.DroppedFrames());
+
+        int max_depth = 0;
+        for (const auto &entry : frame.entries)
+            max_depth = std::max(max_depth, entry.depth);
+
+        const float row_height = ImGui::GetTextLineHeightWithSpacing();
+        const float width = std::max(ImGui::GetContentRegionAvail().x, 1.f);
+        const double duration = std::max({frame.cpu_duration, frame.gpu_duration, 1e-9});
+
+        auto DrawRows = [&](const char *label, bool gpu)
+        {
+            ImGui::TextUnformatted(label);
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            ImGui::InvisibleButton(label, ImVec2(width, row_height * (max_depth + 1)));
+            bool hovered = ImGui::IsItemHovered();
+            ImVec2 mouse = ImGui::GetMousePos();
+            ImDrawList &list = *ImGui::GetWindowDrawList();
+
+            for (const auto &entry : frame.entries)
+            {
+                double begin = gpu ? entry.gpu_begin : entry.cpu_begin;
+                double end = gpu ? entry.gpu_end : entry.cpu_end;
+                if (begin < 0 || end < 0)
+                    continue;
+
+                ImVec2 a(origin.x + float(begin / duration) * width, origin.y + entry.depth * row_height);
+                ImVec2 b(std::max(origin.x + float(end / duration) * width, a.x + 1), a.y + row_height - 1);
+                ImU32 color = entry.is_pass ? IM_COL32(80, 120, 200, 255) : ImGui::GetColorU32(ImGuiCol_PlotHistogram);
+                list.AddRectFilled(a, b, color);
+                list.PushClipRect(a, b, true);
+                list.AddText(ImVec2(a.x + 2, a.y), IM_COL32(255, 255, 255, 255), entry.name.c_str());
+                list.PopClipRect();
+
+                if (hovered && mouse.x >= a.x && mouse.x < b.x && mouse.y >= a.y && mouse.y < b.y)
+                    ImGui::SetTooltip("%s\n%.3f ms", entry.name.c_str(), (end - begin) * 1000);
+            }
+        };
+
+        DrawRows("CPU", false);
+        if (frame.gpu_duration >= 0)
+            DrawRows("GPU", true);
+
+        if (audio_stats && ImGui::CollapsingHeader("Audio"))
+        {
+            const Audio::Stats::Tick &tick = audio_stats->LastTick();
+            ImGui::Text("Active sources: %zu", tick.active_sources);
+            ImGui::Text("AL calls per tick: %llu", (unsigned long long)tick.al_calls);
+            ImGui::Text("Streaming underruns: %llu (total %llu)", (unsigned long long)tick.underruns, (unsigned long long)audio_stats->TotalUnderruns());
+
+            std::vector<Audio::Stats::Decode> decodes = audio_stats->Decodes();
+            if (!decodes.empty() && ImGui::TreeNode("Decoding", "Decoding (%zu sounds)", decodes.size()))
+            {
+                std::sort(decodes.begin(), decodes.end(), [](const Audio::Stats::Decode &a, const Audio::Stats::Decode &b){return a.seconds > b.seconds;});
+                for (const Audio::Stats::Decode &decode : decodes)
+                    ImGui::Text("%8.3f ms %8.1f KB  %s", decode.seconds * 1000, decode.bytes / 1024., decode.name.c_str());
+                ImGui::TreePop();
+            }
+        }
+    }
+
+    // Shows the heap allocation stats from `AllocTracker`, per tag, and the top call sites if they're being recorded.
+    // Call `AllocTracker::EndFrame()` once per frame for the per-frame columns to work.
+    // Call this between `ImGui::NewFrame()` and `ImGui::Render()`.
+    inline void AllocTrackerOverlay(bool *open = nullptr)
+    {
+        if (!ImGui::Begin("Allocations", open))
+        {
+            ImGui::End();
+            return;
+        }
+        FINALLY{ImGui::End();};
+
+        if (!AllocTracker::enabled)
+        {
+            ImGui::TextUnformatted("Allocation tracking is disabled in this build, see `IMP_ALLOC_TRACKING`.");
+            return;
+        }
+
+        AllocTracker::Stats stats = AllocTracker::GetStats();
+
+        if (ImGui::BeginTable("tags", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+        {
+            ImGui::TableSetupColumn("Tag");
+            ImGui::TableSetupColumn("Live KB");
+            ImGui::TableSetupColumn("Live count");
+            ImGui::TableSetupColumn("Allocs/frame");
+            ImGui::TableSetupColumn("KB/frame");
+            ImGui::TableHeadersRow();
+
+            auto Row = [](const AllocTracker::TagStats &tag)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(tag.name);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", tag.live_bytes / 1024.);
+                ImGui::TableNextColumn(); ImGui::Text("%lld", (long long)tag.live_count);
+                ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)tag.frame_count);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", tag.frame_bytes / 1024.);
+            };
+            for (const AllocTracker::TagStats &tag : stats.tags)
+                Row(tag);
+            Row(stats.total);
+
+            ImGui::EndTable();
+        }
+
+        if (ImGui::CollapsingHeader("Call sites"))
+        {
+            bool recording = AllocTracker::IsRecordingCallSites();
+            if (ImGui::Checkbox("Record (slow)", &recording))
+                AllocTracker::SetRecordCallSites(recording);
+            ImGui::SameLine();
+            if (ImGui::Button("Reset"))
+                AllocTracker::ResetCallSites();
+
+            // Symbolizing is slow, so only do this when the list is visible.
+            std::vector<AllocTracker::CallSite> sites = AllocTracker::GetTopCallSites(20);
+            for (std::size_t i = 0; i < sites.size(); i++)
+            {
+                const AllocTracker::CallSite &site = sites[i];
+                if (ImGui::TreeNode((void *)i, "%8llu allocs %10.1f KB  [%s]  %s", (unsigned long long)site.count, site.bytes / 1024., site.tag, site.frames.front().c_str()))
+                {
+                    for (const std::string &frame : site.frames)
+                        ImGui::TextUnformatted(frame.c_str());
+                    ImGui::TreePop();
+                }
+            }
+        }
+    }
+}
@@ -1,9 +1,20 @@
 #include "render.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
 
 #include "graphics/complete.h"
 #include "reflection/structs.h"
+#include "utils/alloc_tracker.h"
+#include "utils/trace.h"
 
 struct Render::Data
 {
@@ -11,7 +22,24 @@ struct Render::Data
         REFL_DECL(fvec2) pos
         REFL_DECL(fvec4) color
         REFL_DECL(fvec2) texcoord
-        REFL_DECL(fvec3) factors
+        REFL_DECL(fvec4) factors // Texture/color mix, texture alpha mix, beta, and the SDF edge half-width (zero if the texture isn't an SDF).
+    )
+
+    // A whole quad, expanded to the vertices by `instanced_vertex_source`.
+    // The per-corner values are in the same order as in `Quad_t`, and are packed, so quads that don't fit into [0;1] use `Attribs` instead.
+    REFL_SIMPLE_STRUCT( QuadAttribs
+        REFL_DECL(fvec2) pos // Includes the translation from the matrix.
+        REFL_DECL(fvec4) matrix // The two columns of a 2x2 matrix.
+        REFL_DECL(fvec4) rect // Two opposite corners, before the matrix is applied.
+        REFL_DECL(fvec4) tex_rect // The texture coordinates of those corners.
+        REFL_DECL(u8vec4 REFL_ATTR Graphics::Normalized) color0
+        REFL_DECL(u8vec4 REFL_ATTR Graphics::Normalized) color1
+        REFL_DECL(u8vec4 REFL_ATTR Graphics::Normalized) color2
+        REFL_DECL(u8vec4 REFL_ATTR Graphics::Normalized) color3
+        REFL_DECL(u8vec4 REFL_ATTR Graphics::Normalized) factors0
+        REFL_DECL(u8vec4 REFL_ATTR Graphics::Normalized) factors1
+        REFL_DECL(u8vec4 REFL_ATTR Graphics::Normalized) factors2
+        REFL_DECL(u8vec4 REFL_ATTR Graphics::Normalized) factors3
     )
 
     REFL_SIMPLE_STRUCT( Uniforms
@@ -21,10 +49,38 @@ struct Render::Data
         REFL_DECL(Graphics::Uniform<fmat4> REFL_ATTR Graphics::Frag) color_matrix
     )
 
+    // Used instead of `matrix`, `tex_size` and `color_matrix` from `Uniforms` if the uniform buffers are supported,
+    // to upload them once for both shaders. Matches the `std140` layout of `common_block_source`.
+    struct CommonUniforms
+    {
+        fmat4 matrix;
+        fmat4 color_matrix;
+        fvec4 tex_size; // Only `xy` are used.
+    };
+    static constexpr GLuint common_uniforms_binding_point = 0;
+
+    // Prepended to the shader sources when using `CommonUniforms`.
+    // The uniforms declared from `Uniforms` are then unused, and redirected to the block by the macros.
+    // If the GLSL version is too old, this fails to compile, and we fall back to the plain uniforms.
+    static constexpr const char *common_block_source = R"(
+#if __VERSION__ < 140
+#error Uniform blocks are not supported.
+#endif
+layout(std140) uniform Common
+{
+    mat4 c_matrix;
+    mat4 c_color_matrix;
+    vec4 c_tex_size;
+};
+#define u_matrix c_matrix
+#define u_color_matrix c_color_matrix
+#define u_tex_size c_tex_size.xy
+)";
+
     static constexpr const char *vertex_source = R"(
 varying vec4 v_color;
 varying vec2 v_texcoord;
-varying vec3 v_factors;
+varying vec4 v_factors;
 void main()
 {
     gl_Position = u_matrix * vec4(a_pos, 0, 1);
@@ -33,13 +89,51 @@ void main()
     v_factors   = a_factors;
 })";
 
+    // Needs `gl_VertexID`, so if the GLSL version is too old, this fails to compile, and we don't use instancing.
+    static constexpr const char *instanced_vertex_source = R"(
+#if __VERSION__ < 130
+#error `gl_VertexID` is not supported.
+#endif
+varying vec4 v_color;
+varying vec2 v_texcoord;
+varying vec4 v_factors;
+void main()
+{
+    // The strip goes through the corners 0, 1, 3, 2.
+    vec2 t = vec2(gl_VertexID % 2, gl_VertexID / 2);
+    gl_Position = u_matrix * vec4(a_pos + mat2(a_matrix.xy, a_matrix.zw) * mix(a_rect.xy, a_rect.zw, t), 0, 1);
+    v_texcoord  = mix(a_tex_rect.xy, a_tex_rect.zw, t) / u_tex_size;
+    if (gl_VertexID == 0)
+    {
+        v_color = a_color0;
+        v_factors = a_factors0;
+    }
+    else if (gl_VertexID == 1)
+    {
+        v_color = a_color1;
+        v_factors = a_factors1;
+    }
+    else if (gl_VertexID == 2)
+    {
+        v_color = a_color3;
+        v_factors = a_factors3;
+    }
+    else
+    {
+        v_color = a_color2;
+        v_factors = a_factors2;
+    }
+})";
+
     static constexpr const char *fragment_source = R"(
 varying vec4 v_color;
 varying vec2 v_texcoord;
-varying vec3 v_factors;
+varying vec4 v_factors;
 void main()
 {
     vec4 tex_color = texture2D(u_texture, v_texcoord);
+    if (v_factors.w > 0.0)
+        tex_color.a = smoothstep(0.5 - v_factors.w, 0.5 + v_factors.w, tex_color.a); // A signed distance field, see `FontFile::sdf`.
     gl_FragColor = vec4(mix(v_color.rgb, tex_color.rgb, v_factors.x),
                         mix(v_color.a  , tex_color.a  , v_factors.y));
     vec4 result = u_color_matrix * vec4(gl_FragColor.rgb, 1);
@@ -48,20 +142,275 @@ void main()
     gl_FragColor.a *= v_factors.z;
 })";
 
-    Graphics::SimpleRenderQueue<Attribs, 3> queue; // Note that the queue has to be the first field.
+    // At most one of the queues is non-empty at a time, to preserve the drawing order.
+    Graphics::SimpleRenderQueue<Attribs, 3> queue;
+    Graphics::QuadRenderQueue<Attribs> indexed_quad_queue; // The quads that don't fit into `quad_queue`.
+    Graphics::InstancedRenderQueue<QuadAttribs, 4> quad_queue; // Only if `instanced_shader` is not null.
     Uniforms uni;
+    Uniforms instanced_uni;
     Graphics::Shader shader;
+    Graphics::Shader instanced_shader; // Null if instancing is not supported.
     Graphics::TexUnit tex_unit; // This is used when working with textures without their own units.
+    #ifdef IMP_HAVE_UNIFORM_BUFFERS
+    Graphics::UniformBuffer<CommonUniforms> common_uniforms; // Null if the shaders use the plain uniforms.
+    #endif
 
     std::optional<std::string> current_atlas;
 
-    Data(std::size_t queue_size, const Graphics::ShaderConfig &config) : queue(queue_size), shader("Main", config, Graphics::ShaderPreferences{}, Meta::tag<Attribs>{}, uni, vertex_source, fragment_source) {}
-};
+    // Everything that's set by `Render::Set...()`.
+    struct State
+    {
+        const Graphics::TexUnit *texture_unit = nullptr;
+        const Graphics::TexObject *atlas_texture = nullptr; // If not null, this is attached to `tex_unit` and used instead of `texture_unit`.
+        fvec2 tex_size;
+        fmat4 matrix;
+        fmat4 color_matrix;
+
+        [[nodiscard]] bool operator==(const State &) const = default;
+    };
+    State state;
+
+    // The deferred mode.
+    struct Command
+    {
+        std::uint64_t key = 0; // The layer and the state index.
+        std::variant<QuadAttribs, std::array<Attribs, 3>, std::array<Attribs, 4>> primitive;
+    };
+    bool deferred = false;
+    int layer = 0;
+    std::vector<State> deferred_states;
+    std::optional<std::uint32_t> deferred_state_index; // The index of `state` in `deferred_states`, if known.
+    std::vector<Command> commands;
+
+    Graphics::Text::Stats text_stats; // Reused by `Text_t`.
+
+    Data(std::size_t queue_size, const Graphics::ShaderConfig &config)
+        : queue(queue_size), indexed_quad_queue(std::clamp(queue_size / 2, std::size_t(1), decltype(indexed_quad_queue)::max_size))
+    {
+        std::string source_prefix;
 
-void *Render::GetRenderQueuePtr()
-{
-    return &data->queue;
-}
+        #ifdef IMP_HAVE_UNIFORM_BUFFERS
+        try
+        {
+            shader = Graphics::Shader("Main", config, Graphics::ShaderPreferences{}, Meta::tag<Attribs>{}, uni, common_block_source + std::string(vertex_source), common_block_source + std::string(fragment_source));
+            shader.BindUniformBlock("Common", common_uniforms_binding_point);
+            common_uniforms = nullptr;
+            source_prefix = common_block_source;
+        }
+        catch (std::exception &)
+        {
+            // The GLSL version is too old, use the plain uniforms.
+            shader = {};
+        }
+        #endif
+
+        if (!shader)
+            shader = Graphics::Shader("Main", config, Graphics::ShaderPreferences{}, Meta::tag<Attribs>{}, uni, vertex_source, fragment_source);
+
+        if constexpr (Graphics::VertexBuffers::instancing_supported)
+        {
+            try
+            {
+                instanced_shader = Graphics::Shader("Main (instanced)", config, Graphics::ShaderPreferences{}, Meta::tag<QuadAttribs>{}, instanced_uni, source_prefix + instanced_vertex_source, source_prefix + fragment_source);
+                #ifdef IMP_HAVE_UNIFORM_BUFFERS
+                if (common_uniforms)
+                    instanced_shader.BindUniformBlock("Common", common_uniforms_binding_point);
+                #endif
+                quad_queue = decltype(quad_queue)(std::max(queue_size / 2, std::size_t(1))); // The same number of quads as `queue` holds.
+            }
+            catch (std::exception &)
+            {
+                // The GLSL version is too old, fall back to `queue`.
+                instanced_shader = {};
+            }
+        }
+    }
+
+    // Sets the uniform in both shaders. Leaves `shader` bound, like setting a single uniform would.
+    template <typename T>
+    void SetUniform(Graphics::Uniform<T> Uniforms::*member, const std::type_identity_t<T> &value)
+    {
+        if (instanced_shader)
+            instanced_uni.*member = value;
+        uni.*member = value;
+    }
+
+    void FlushQuads()
+    {
+        if (quad_queue.Pos() == 0)
+            return;
+        bool rebind = shader.Bound();
+        instanced_shader.Bind();
+        quad_queue.Flush();
+        if (rebind)
+            shader.Bind();
+    }
+
+    void FlushAll()
+    {
+        queue.Flush();
+        indexed_quad_queue.Flush();
+        FlushQuads();
+    }
+
+    // Sets the uniforms from `new_state`.
+    void ApplyState(const State &new_state)
+    {
+        if (new_state.atlas_texture)
+        {
+            if (!tex_unit)
+                tex_unit = nullptr;
+            tex_unit.Attach(*new_state.atlas_texture);
+            SetUniform(&Uniforms::texture, tex_unit);
+        }
+        else if (new_state.texture_unit)
+        {
+            SetUniform(&Uniforms::texture, *new_state.texture_unit);
+        }
+
+        #ifdef IMP_HAVE_UNIFORM_BUFFERS
+        if (common_uniforms)
+        {
+            common_uniforms.Set({.matrix = new_state.matrix, .color_matrix = new_state.color_matrix, .tex_size = new_state.tex_size.to_vec4()});
+            common_uniforms.BindToPoint(common_uniforms_binding_point);
+            shader.Bind(); // Like `SetUniform()` does.
+            return;
+        }
+        #endif
+
+        SetUniform(&Uniforms::tex_size, new_state.tex_size);
+        SetUniform(&Uniforms::matrix, new_state.matrix);
+        SetUniform(&Uniforms::color_matrix, new_state.color_matrix);
+    }
+
+    // Modifies `state` with `func`. In the immediate mode, flushes the queues first and then applies the state.
+    void ChangeState(auto &&func)
+    {
+        if (!deferred)
+            FlushAll();
+        func(state);
+        if (deferred)
+            deferred_state_index.reset();
+        else
+            ApplyState(state);
+    }
+
+    void Record(std::variant<QuadAttribs, std::array<Attribs, 3>, std::array<Attribs, 4>> primitive)
+    {
+        if (!deferred_state_index)
+        {
+            auto it = std::find(deferred_states.begin(), deferred_states.end(), state);
+            if (it == deferred_states.end())
+                it = deferred_states.insert(it, state);
+            deferred_state_index = std::uint32_t(it - deferred_states.begin());
+        }
+
+        std::uint64_t key = std::uint64_t(std::uint32_t(layer) ^ (std::uint32_t(1) << 31)) << 32 | *deferred_state_index; // Flip the sign bit, so negative layers sort first.
+        commands.push_back({.key = key, .primitive = std::move(primitive)});
+    }
+
+    // Draws the recorded primitives, sorted by the layer and then by the state.
+    // The stable sort preserves the order of the primitives with the same layer and state.
+    void DrawDeferred()
+    {
+        if (commands.empty())
+            return;
+
+        std::stable_sort(commands.begin(), commands.end(), [](const Command &a, const Command &b){return a.key < b.key;});
+
+        std::uint32_t cur_state_index = std::numeric_limits<std::uint32_t>::max();
+        for (const Command &command : commands)
+        {
+            std::uint32_t state_index = std::uint32_t(command.key);
+            if (state_index != cur_state_index)
+            {
+                FlushAll();
+                ApplyState(deferred_states[state_index]);
+                cur_state_index = state_index;
+            }
+
+            if (auto quad = std::get_if<QuadAttribs>(&command.primitive))
+            {
+                queue.Flush();
+                indexed_quad_queue.Flush();
+                quad_queue.Add(*quad);
+            }
+            else if (auto vertices = std::get_if<std::array<Attribs, 4>>(&command.primitive))
+            {
+                queue.Flush();
+                FlushQuads();
+                indexed_quad_queue.Add((*vertices)[0], (*vertices)[1], (*vertices)[2], (*vertices)[3]);
+            }
+            else
+            {
+                const auto &triangle = std::get<std::array<Attribs, 3>>(command.primitive);
+                indexed_quad_queue.Flush();
+                FlushQuads();
+                queue.Add(triangle[0], triangle[1], triangle[2]);
+            }
+        }
+        FlushAll();
+
+        // Restore the current state, for the immediate mode and for the next frame.
+        ApplyState(state);
+        commands.clear();
+        deferred_states.clear();
+        deferred_state_index.reset();
+    }
+
+    void AddVertices(const Attribs &a, const Attribs &b, const Attribs &c)
+    {
+        if (deferred)
+        {
+            Record(std::array{a, b, c});
+            return;
+        }
+        indexed_quad_queue.Flush();
+        FlushQuads();
+        queue.Add(a, b, c);
+    }
+    void AddVertices(const Attribs &a, const Attribs &b, const Attribs &c, const Attribs &d)
+    {
+        if (deferred)
+        {
+            Record(std::array{a, b, c, d});
+            return;
+        }
+        queue.Flush();
+        FlushQuads();
+        indexed_quad_queue.Add(a, b, c, d);
+    }
+
+    void AddQuad(const QuadAttribs &quad)
+    {
+        if (deferred)
+        {
+            Record(quad);
+            return;
+        }
+        queue.Flush();
+        indexed_quad_queue.Flush();
+        quad_queue.Add(quad);
+    }
+
+    // Packs the per-corner values of `corners` into `quad`. Returns false if they don't fit.
+    [[nodiscard]] static bool PackCorners(const Attribs (&corners)[4], QuadAttribs &quad)
+    {
+        static constexpr u8vec4 QuadAttribs::*colors[4] = {&QuadAttribs::color0, &QuadAttribs::color1, &QuadAttribs::color2, &QuadAttribs::color3};
+        static constexpr u8vec4 QuadAttribs::*factors[4] = {&QuadAttribs::factors0, &QuadAttribs::factors1, &QuadAttribs::factors2, &QuadAttribs::factors3};
+
+        for (int i = 0; i < 4; i++)
+        {
+            fvec4 color = corners[i].color;
+            fvec4 factor = corners[i].factors;
+            if (std::min(color.min(), factor.min()) < 0 || std::max(color.max(), factor.max()) > 1)
+                return false;
+            quad.*colors[i] = iround(color * 255).to<std::uint8_t>();
+            quad.*factors[i] = iround(factor * 255).to<std::uint8_t>();
+        }
+        return true;
+    }
+};
 
 void Render::ExpectAtlas(std::string_view name)
 {
@@ -94,7 +443,33 @@ void Render::BindShader() const
 
 void Render::Finish()
 {
-    data->queue.Flush();
+    IMP_TRACE_ZONE("Render::Finish");
+    IMP_ALLOC_SCOPE("render");
+    auto profiler_scope = Graphics::Profiler::MeasureIfActive("Render::Finish");
+    if (data->deferred)
+        data->DrawDeferred();
+    data->FlushAll();
+}
+
+void Render::SetDeferred(bool deferred)
+{
+    Finish();
+    data->deferred = deferred;
+}
+
+bool Render::IsDeferred() const
+{
+    return data->deferred;
+}
+
+void Render::SetLayer(int layer)
+{
+    data->layer = layer;
+}
+
+int Render::GetLayer() const
+{
+    return data->layer;
 }
 
 void Render::SetAtlas(std::string_view name)
@@ -103,27 +478,29 @@ void Render::SetAtlas(std::string_view name)
     if (it == Graphics::GlobalData::GetAtlases().end())
         throw std::runtime_error(FMT("2D poly renderer: No such texture atlas: `{}`.", name));
 
-    Finish(); // Since we're planning to clobber `data->tex_unit`.
-
-    if (!data->tex_unit)
-        data->tex_unit = nullptr;
-    data->tex_unit.Attach(it->second.texture);
-    SetTextureUnit(data->tex_unit);
-    SetTextureSize(it->second.size);
+    // The texture is attached to `data->tex_unit` when the state is applied.
+    data->ChangeState([&](Data::State &state)
+    {
+        state.texture_unit = nullptr;
+        state.atlas_texture = &it->second.texture;
+        state.tex_size = it->second.size;
+    });
     data->current_atlas = std::move(name);
 }
 
 void Render::SetTextureUnit(const Graphics::TexUnit &unit)
 {
-    Finish();
-    data->uni.texture = unit;
+    data->ChangeState([&](Data::State &state)
+    {
+        state.texture_unit = &unit;
+        state.atlas_texture = nullptr;
+    });
     data->current_atlas.reset();
 }
 
 void Render::SetTextureSize(ivec2 size)
 {
-    Finish();
-    data->uni.tex_size = size;
+    data->ChangeState([&](Data::State &state){state.tex_size = size;});
 }
 
 void Render::SetTexture(const Graphics::Texture &tex)
@@ -134,19 +511,61 @@ void Render::SetTexture(const Graphics::Texture &tex)
 
 void Render::SetMatrix(const fmat4 &m)
 {
-    Finish();
-    data->uni.matrix = m;
+    data->ChangeState([&](Data::State &state){state.matrix = m;});
 }
 
 void Render::SetColorMatrix(const fmat4 &m)
 {
-    Finish();
-    data->uni.color_matrix = m;
+    data->ChangeState([&](Data::State &state){state.color_matrix = m;});
+}
+
+void Render::Sprites(std::span<const Sprite> sprites)
+{
+    for (const Sprite &sprite : sprites)
+    {
+        fvec2 half_size = sprite.size / 2;
+        fvec2 tex_end = sprite.tex_pos + sprite.tex_size;
+
+        // The shader mixes the color alpha with the texture alpha, so we get `texture_alpha * alpha` by mixing it with zero.
+        bool textured = sprite.mix > 0;
+        fvec4 color = sprite.color.to_vec4(textured ? 0 : sprite.alpha);
+        fvec4 factors(sprite.mix, textured ? sprite.alpha : 0, sprite.beta, 0);
+
+        if (data->instanced_shader)
+        {
+            Data::QuadAttribs quad;
+            quad.pos = sprite.pos;
+            quad.matrix = fvec4(sprite.dir.x, sprite.dir.y, -sprite.dir.y, sprite.dir.x);
+            quad.rect = fvec4(-half_size.x, -half_size.y, half_size.x, half_size.y);
+            quad.tex_rect = fvec4(sprite.tex_pos.x, sprite.tex_pos.y, tex_end.x, tex_end.y);
+            quad.color0 = quad.color1 = quad.color2 = quad.color3 = iround(clamp(color, 0, 1) * 255).to<std::uint8_t>();
+            quad.factors0 = quad.factors1 = quad.factors2 = quad.factors3 = iround(clamp(factors, 0, 1) * 255).to<std::uint8_t>();
+            data->AddQuad(quad);
+            continue;
+        }
+
+        Data::Attribs out[4];
+        for (Data::Attribs &it : out)
+        {
+            it.color = color;
+            it.factors = factors;
+        }
+        fvec2 dir_x = sprite.dir * half_size.x, dir_y = sprite.dir.rot90() * half_size.y;
+        out[0].pos = sprite.pos - dir_x - dir_y;
+        out[1].pos = sprite.pos + dir_x - dir_y;
+        out[2].pos = sprite.pos + dir_x + dir_y;
+        out[3].pos = sprite.pos - dir_x + dir_y;
+        out[0].texcoord = sprite.tex_pos;
+        out[1].texcoord = fvec2(tex_end.x, sprite.tex_pos.y);
+        out[2].texcoord = tex_end;
+        out[3].texcoord = fvec2(sprite.tex_pos.x, tex_end.y);
+        data->AddVertices(out[0], out[1], out[2], out[3]);
+    }
 }
 
 Render::Quad_t::~Quad_t()
 {
-    if (!queue)
+    if (!render_data)
         return;
 
     ASSERT(data.has_texture || data.has_color, "2D poly renderer: Quad with no texture nor color specified.");
@@ -173,10 +592,11 @@ Render::Quad_t::~Quad_t()
 
         if (data.center_pos_tex)
         {
-            if (data.tex_size.x)
-                data.center.x *= data.size.x / data.tex_size.x;
-            if (data.tex_size.y)
-                data.center.y *= data.size.y / data.tex_size.y;
+            fvec2 full_tex_size = data.has_trim ? data.trim_full_size : data.tex_size;
+            if (full_tex_size.x)
+                data.center.x *= data.size.x / full_tex_size.x;
+            if (full_tex_size.y)
+                data.center.y *= data.size.y / full_tex_size.y;
         }
     }
     else
@@ -189,7 +609,10 @@ Render::Quad_t::~Quad_t()
     }
 
     for (int i = 0; i < 4; i++)
+    {
         out[i].factors.z = data.beta[i];
+        out[i].factors.w = data.sdf_edge;
+    }
 
     if (data.flip_x)
     {
@@ -206,8 +629,43 @@ Render::Quad_t::~Quad_t()
             data.center.y = data.size.y - data.center.y;
     }
 
-    out[0].pos = -data.center;
-    out[2].pos = data.size - data.center;
+    // The part of the quad that's actually drawn, relative to `data.pos`, before applying the matrix.
+    fvec2 rect_begin = -data.center, rect_end = data.size - data.center;
+    if (data.has_trim)
+    {
+        fvec2 scale = data.size / data.trim_full_size;
+        fvec2 trimmed_size(std::abs(data.tex_size.x), std::abs(data.tex_size.y)); // The texture could be flipped already.
+        fvec2 offset = data.trim_offset;
+        if (data.flip_x)
+            offset.x = data.trim_full_size.x - offset.x - trimmed_size.x;
+        if (data.flip_y)
+            offset.y = data.trim_full_size.y - offset.y - trimmed_size.y;
+        rect_begin += offset * scale;
+        rect_end = rect_begin + trimmed_size * scale;
+    }
+
+    if (render_data->instanced_shader)
+    {
+        Render::Data::QuadAttribs quad;
+        if (Render::Data::PackCorners(out, quad))
+        {
+            quad.pos = data.pos;
+            quad.matrix = fvec4(1, 0, 0, 1);
+            if (data.has_matrix)
+            {
+                quad.pos += data.matrix.z.to_vec2();
+                quad.matrix = fvec4(data.matrix.x.x, data.matrix.x.y, data.matrix.y.x, data.matrix.y.y);
+            }
+            fvec2 tex_end = data.tex_pos + data.tex_size;
+            quad.rect = fvec4(rect_begin.x, rect_begin.y, rect_end.x, rect_end.y);
+            quad.tex_rect = fvec4(data.tex_pos.x, data.tex_pos.y, tex_end.x, tex_end.y);
+            render_data->AddQuad(quad);
+            return;
+        }
+    }
+
+    out[0].pos = rect_begin;
+    out[2].pos = rect_end;
     out[1].pos = fvec2(out[2].pos.x, out[0].pos.y);
     out[3].pos = fvec2(out[0].pos.x, out[2].pos.y);
 
@@ -227,12 +685,12 @@ Render::Quad_t::~Quad_t()
     out[1].texcoord = {out[2].texcoord.x, out[0].texcoord.y};
     out[3].texcoord = {out[0].texcoord.x, out[2].texcoord.y};
 
-    ((decltype(Render::Data::queue) *)queue)->Add(out[0], out[1], out[2], out[3]);
+    render_data->AddVertices(out[0], out[1], out[2], out[3]);
 }
 
 Render::Triangle_t::~Triangle_t()
 {
-    if (!queue)
+    if (!render_data)
         return;
 
     ASSERT(data.has_texture || data.has_color, "2D poly renderer: Triangle with no texture nor color specified.");
@@ -259,7 +717,10 @@ Render::Triangle_t::~Triangle_t()
     }
 
     for (int i = 0; i < 3; i++)
+    {
         out[i].factors.z = data.beta[i];
+        out[i].factors.w = 0;
+    }
 
     for (int i = 0; i < 3; i++)
     {
@@ -273,7 +734,7 @@ Render::Triangle_t::~Triangle_t()
             it.pos = (data.matrix * it.pos.to_vec3(1)).to_vec2();
     }
 
-    ((decltype(Render::Data::queue) *)queue)->Add(out[0], out[1], out[2]);
+    render_data->AddVertices(out[0], out[1], out[2]);
 }
 
 Render::Text_t::~Text_t()
@@ -281,26 +742,39 @@ Render::Text_t::~Text_t()
     if (!renderer)
         return;
 
-    Graphics::Text::Stats stats = data.text.ComputeStats();
+    // The cached texts come with precomputed stats.
+    if (!data.cached)
+        data.text.ComputeStats(renderer->data->text_stats);
+    const Graphics::Text &text = data.cached ? data.cached->text : data.text;
+    const Graphics::Text::Stats &stats = data.cached ? data.cached->stats : renderer->data->text_stats;
 
     ivec2 align_box(data.has_box_alignment ? data.align_box_x : data.align.x, data.align.y);
 
     fvec2 pos = data.pos;
 
+    // One screen pixel, in the units of the distance field. See `FontFile::GetGlyph()` for the encoding.
+    float sdf_edge = 0;
+    if (data.sdf_spread > 0)
+    {
+        float scale = data.sdf_scale;
+        if (data.has_matrix)
+            scale *= std::sqrt(std::abs(data.matrix.x.x * data.matrix.y.y - data.matrix.x.y * data.matrix.y.x));
+        sdf_edge = 0.25f / (data.sdf_spread * scale);
+    }
+
     fvec2 offset = -stats.size * (1 + align_box) / 2;
     offset.x += stats.size.x * (1 + data.align.x) / 2; // Note that we don't change vertical position here.
 
     float line_start_offset_x = offset.x;
 
-    for (size_t line_index = 0; line_index < data.text.lines.size(); line_index++)
+    for (size_t line_index = 0; line_index < text.lines.size(); line_index++)
     {
-        const Graphics::Text::Line &line = data.text.lines[line_index];
         const Graphics::Text::Stats::Line &line_stats = stats.lines[line_index];
 
         offset.x = line_start_offset_x - line_stats.width * (1 + data.align.x) / 2;
         offset.y += line_stats.ascent;
 
-        for (const Graphics::Text::Symbol &symbol : line.symbols)
+        for (const Graphics::Text::Symbol &symbol : text.LineSymbols(line_index))
         {
             fvec2 symbol_pos;
 
@@ -312,6 +786,8 @@ Render::Text_t::~Text_t()
             auto quad = renderer->fquad(symbol_pos, symbol.size).tex(symbol.texture_pos).color(data.color).mix(0).alpha(data.alpha).beta(data.beta);
             if (data.has_matrix)
                 quad.matrix(data.matrix.to_mat2()).pixel_center(fvec2(0));
+            if (sdf_edge > 0)
+                quad.sdf(sdf_edge);
 
             offset.x += symbol.advance + symbol.kerning;
         }
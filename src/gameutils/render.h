@@ -1,10 +1,12 @@
 #pragma once
 
 #include <memory>
+#include <span>
 #include <utility>
 
 #include "graphics/global_image_loader.h"
 #include "graphics/text.h"
+#include "graphics/text_cache.h"
 #include "program/errors.h"
 #include "utils/mat.h"
 
@@ -20,8 +22,6 @@ class Render
     struct Data;
     std::unique_ptr<Data> data;
 
-    void *GetRenderQueuePtr();
-
     // Throws if we're not using a global texture atlas named `name`.
     void ExpectAtlas(std::string_view name);
 
@@ -37,8 +37,21 @@ class Render
 
     void BindShader() const;
 
+    // Draws everything that's queued. In the deferred mode, call this at the end of the frame.
     void Finish();
 
+    // In the deferred mode, the primitives are recorded instead of being drawn, and the state changes (`Set...()`) don't cause flushes.
+    // `Finish()` then draws them sorted by the layer, and within each layer grouped by the state, which needs much fewer draw calls.
+    // The order is preserved only for the primitives with the same layer and state, so the overlapping ones with different textures should be on different layers.
+    // The texture units and atlases must stay alive until `Finish()`.
+    // Switching modes calls `Finish()`.
+    void SetDeferred(bool deferred);
+    [[nodiscard]] bool IsDeferred() const;
+
+    // The layer for the following primitives in the deferred mode. Lower layers are drawn first. Ignored in the immediate mode.
+    void SetLayer(int layer);
+    [[nodiscard]] int GetLayer() const;
+
     // Enables a global texture atlas (see `graphics/global_image_loader.h`).
     // Calls `SetTexture??` internally.
     void SetAtlas(std::string_view name);
@@ -58,13 +71,29 @@ class Render
 
     void SetColorMatrix(const fmat4 &m);
 
+    // A rotated quad with a single color, for drawing many of them at once with `Sprites()`, e.g. for particles.
+    struct Sprite
+    {
+        fvec2 pos; // The center.
+        fvec2 size;
+        fvec2 dir = fvec2(1, 0); // The direction of the local X axis, normalized. Rotates the quad.
+        fvec2 tex_pos, tex_size; // In texels.
+        fvec3 color; // Mixed with the texture color, see `mix`.
+        float mix = 1; // 0 - fill with color, 1 - use texture.
+        float alpha = 1; // If `mix > 0`, multiplies the texture alpha. Otherwise this is the alpha of the color.
+        float beta = 1; // Same as `Quad_t::beta()`.
+    };
+
+    // Draws the sprites. Much cheaper than calling `fquad()` for each of them, and goes straight into the instanced path if it's available.
+    void Sprites(std::span<const Sprite> sprites);
+
     class Quad_t
     {
         friend class Render;
 
         using ref = Quad_t &&;
 
-        void *queue = 0; // Actually the type should be `Graphics::SimpleRenderQueue<Attribs, 3> *`, but we don't include "graphics/simple_render_queue.h" for better compilation times.
+        Render::Data *render_data = nullptr;
 
         struct Data
         {
@@ -93,19 +122,24 @@ class Render
             bool abs_tex_pos = false;
 
             bool flip_x = false, flip_y = false;
+
+            float sdf_edge = 0;
+
+            bool has_trim = false;
+            fvec2 trim_offset = fvec2(0), trim_full_size = fvec2(0);
         };
         Data data;
 
-        Quad_t(void *queue, fvec2 pos, fvec2 size) : queue(queue)
+        Quad_t(Render::Data *render_data, fvec2 pos, fvec2 size) : render_data(render_data)
         {
             data.pos = pos;
             data.size = size;
         }
       public:
-        Quad_t(Quad_t &&other) noexcept : queue(std::exchange(other.queue, {})), data(std::move(other.data)) {}
+        Quad_t(Quad_t &&other) noexcept : render_data(std::exchange(other.render_data, {})), data(std::move(other.data)) {}
         Quad_t &operator=(Quad_t other) noexcept
         {
-            std::swap(queue, other.queue);
+            std::swap(render_data, other.render_data);
             std::swap(data, other.data);
             return *this;
         }
@@ -279,6 +313,21 @@ class Render
             data.flip_y = f;
             return (ref)*this;
         }
+        ref sdf(float edge) // The texture alpha is a signed distance field (see `FontFile::sdf`), and `edge` is the half-width of the antialiased edge in its units.
+        {
+            ASSERT(data.has_texture, "2D poly renderer: Quad_t signed distance field without a texture.");
+            data.sdf_edge = clamp(edge, 1 / 255.f, 0.5f); // The instanced quads store it in 8 bits.
+            return (ref)*this;
+        }
+        ref trimmed(fvec2 offset, fvec2 full_tex_size) // The texture is a part of a larger image (see `Graphics::AtlasFlags::trim_alpha`), at `offset`. The size and the center refer to the whole image, but only the texture part is drawn.
+        {
+            ASSERT(data.has_texture, "2D poly renderer: Quad_t trimming without a texture.");
+            ASSERT(!data.has_trim, "2D poly renderer: Quad_t trimming specified twice.");
+            data.has_trim = true;
+            data.trim_offset = offset;
+            data.trim_full_size = full_tex_size;
+            return (ref)*this;
+        }
     };
 
     class Triangle_t
@@ -287,7 +336,7 @@ class Render
 
         using ref = Triangle_t &&;
 
-        void *queue = 0; // Actually the type should be `Graphics::SimpleRenderQueue<Attribs, 3> *`, but we don't include "graphics/simple_render_queue.h" for better compilation times.
+        Render::Data *render_data = nullptr;
 
         struct Data
         {
@@ -310,17 +359,17 @@ class Render
         };
         Data data;
 
-        Triangle_t(void *queue, fvec2 a, fvec2 b, fvec2 c) : queue(queue)
+        Triangle_t(Render::Data *render_data, fvec2 a, fvec2 b, fvec2 c) : render_data(render_data)
         {
             data.pos[0] = a;
             data.pos[1] = b;
             data.pos[2] = c;
         }
       public:
-        Triangle_t(Triangle_t &&other) noexcept : queue(std::exchange(other.queue, {})), data(std::move(other.data)) {}
+        Triangle_t(Triangle_t &&other) noexcept : render_data(std::exchange(other.render_data, {})), data(std::move(other.data)) {}
         Triangle_t &operator=(Triangle_t other)
         {
-            std::swap(queue, other.queue);
+            std::swap(render_data, other.render_data);
             std::swap(data, other.data);
             return *this;
         }
@@ -433,13 +482,14 @@ class Render
 
         using ref = Text_t &&;
 
-        Render *renderer = 0; // For `Text_t` we store renderer pointer rather than queue pointer.
+        Render *renderer = 0; // For `Text_t` we store the renderer pointer rather than the data pointer.
 
         struct Data
         {
             // The constructor sets those:
             fvec2 pos;
             Graphics::Text text;
+            const Graphics::CachedText *cached = nullptr; // If not null, this is used instead of `text`.
 
             ivec2 align = ivec2(0);
 
@@ -452,6 +502,9 @@ class Render
 
             bool has_matrix = 0;
             fmat3 matrix = {};
+
+            int sdf_spread = 0;
+            float sdf_scale = 1;
         };
         Data data;
 
@@ -460,6 +513,11 @@ class Render
             data.pos = pos;
             data.text = std::move(text);
         }
+        Text_t(Render *renderer, fvec2 pos, const Graphics::CachedText &cached) : renderer(renderer)
+        {
+            data.pos = pos;
+            data.cached = &cached;
+        }
       public:
         Text_t(Text_t &&other) noexcept : renderer(std::exchange(other.renderer, {})), data(std::move(other.data)) {}
         Text_t &operator=(Text_t other)
@@ -550,22 +608,33 @@ class Render
             scale(fvec2(s));
             return (ref)*this;
         }
+        // The font was rendered with `FontFile::sdf` and this spread. Scale the text with `scale()`, the edges stay sharp.
+        // `extra_scale` is the scale not known to the text, e.g. from the camera, to antialias the edges correctly.
+        ref sdf(int spread, float extra_scale = 1)
+        {
+            data.sdf_spread = spread;
+            data.sdf_scale = extra_scale;
+            return (ref)*this;
+        }
 
         ~Text_t();
     };
 
     Quad_t fquad(fvec2 pos, fvec2 size)
     {
-        return Quad_t(GetRenderQueuePtr(), pos, size);
+        return Quad_t(data.get(), pos, size);
     }
     Quad_t iquad(ivec2 pos, ivec2 size)
     {
-        return Quad_t(GetRenderQueuePtr(), pos, size);
+        return Quad_t(data.get(), pos, size);
     }
 
+    // If the image was trimmed, only draws the trimmed part, but the position and the center still refer to the original image.
     Quad_t fquad(fvec2 pos, const Graphics::Region &image)
     {
         ExpectAtlas(image.atlas);
+        if (image.IsTrimmed())
+            return fquad(pos, image.full_size).tex(image).trimmed(image.trim_offset, image.full_size);
         return fquad(pos, image.size()).tex(image);
     }
     Quad_t iquad(ivec2 pos, const Graphics::Region &image)
@@ -585,13 +654,13 @@ class Render
 
     Triangle_t ftriangle(fvec2 a, fvec2 b, fvec2 c)
     {
-        return Triangle_t(GetRenderQueuePtr(), a, b, c);
+        return Triangle_t(data.get(), a, b, c);
     }
 
     Triangle_t itriangle(fvec2 a, fvec2 b, fvec2 c) = delete;
     Triangle_t itriangle(ivec2 a, ivec2 b, ivec2 c)
     {
-        return Triangle_t(GetRenderQueuePtr(), a, b, c);
+        return Triangle_t(data.get(), a, b, c);
     }
 
     Text_t ftext(fvec2 pos, Graphics::Text text)
@@ -603,4 +672,17 @@ class Render
     {
         return Text_t(this, pos, std::move(text));
     }
+
+    // Those draw a text from `Graphics::TextCache` without copying it. The text must remain valid until the end of the statement.
+    Text_t ftext(fvec2 pos, const Graphics::CachedText &text)
+    {
+        return Text_t(this, pos, text);
+    }
+    Text_t ftext(fvec2 pos, const Graphics::CachedText &&text) = delete;
+    Text_t itext(fvec2 pos, const Graphics::CachedText &text) = delete;
+    Text_t itext(ivec2 pos, const Graphics::CachedText &text)
+    {
+        return Text_t(this, pos, text);
+    }
+    Text_t itext(ivec2 pos, const Graphics::CachedText &&text) = delete;
 };
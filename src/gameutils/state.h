@@ -1,11 +1,16 @@
 #pragma once
 
+#include <exception>
+#include <memory>
 #include <string_view>
 #include <string>
 #include <type_traits>
+#include <utility>
 
 #include "macros/qualifiers.h"
 #include "reflection/full_with_poly.h"
+#include "utils/jobs.h"
+#include "utils/trace.h"
 
 namespace GameUtils::State
 {
@@ -20,7 +25,12 @@ namespace GameUtils::State
         Base &operator=(const Base &) = default;
         virtual ~Base() {}
 
-        // This will be called once, right after the state is constructed and after its fields are deserialized.
+        // This will be called once, right after the state is constructed and after its fields are deserialized, before `Init()`.
+        // With asynchronous transitions (see `Manager::EnableAsyncTransitions()`) this runs on a worker thread,
+        //   so do the slow loading here (reading and decoding the assets), but don't touch the window, GL or AL.
+        virtual void Load() {}
+
+        // This will be called once, after `Load()`, always on the main thread. Upload the loaded assets to the GPU here.
         virtual void Init() {}
 
         // `next_state` is empty by default, assign to it to change state.
@@ -28,6 +38,10 @@ namespace GameUtils::State
         // Remember that classes with unnamed fields use `()` instead of `{}`.
         // Use `"0"` to set a null state.
         virtual void Tick(std::string &next_state) = 0;
+
+        // With asynchronous transitions, this is called instead of `Tick()` while the next state is loading.
+        // Use this to keep a loading screen running.
+        virtual void TickWhileLoading() {}
     };
 
     // Manages a state.
@@ -38,14 +52,81 @@ namespace GameUtils::State
         Refl::PolyStorage<T> state;
         std::string next_state;
 
+        struct Loading
+        {
+            Jobs::ThreadPool *pool = nullptr;
+            Jobs::Counter counter;
+            Refl::PolyStorage<T> state;
+        };
+        Jobs::ThreadPool *async_pool = nullptr; // Null if the transitions are synchronous.
+        std::unique_ptr<Loading> loading; // The state being loaded asynchronously, if any.
+
+        // Waits for the state being loaded (if any), and discards it.
+        void CancelLoading() noexcept
+        {
+            if (!loading)
+                return;
+            try
+            {
+                loading->pool->Wait(loading->counter);
+            }
+            catch (...) {}
+            loading = nullptr;
+        }
+
+        // Switches to the loaded state. The loading must be finished.
+        void FinishLoading()
+        {
+            std::unique_ptr<Loading> finished = std::move(loading);
+            finished->pool->Wait(finished->counter); // Rethrows the exception from `Load()`, if any.
+            state = std::move(finished->state);
+            if (state)
+                state->Init();
+        }
+
       public:
         Manager() {}
 
-        // Returns true if the state is not null.
+        Manager(Manager &&) = default;
+        Manager &operator=(Manager &&other) noexcept
+        {
+            CancelLoading();
+            state = std::move(other.state);
+            next_state = std::move(other.next_state);
+            async_pool = other.async_pool;
+            loading = std::move(other.loading);
+            return *this;
+        }
+
+        ~Manager()
+        {
+            CancelLoading();
+        }
+
+        // Returns true if the state is not null, or if a state is being loaded.
         // If this returns false, you probably should stop the main loop.
         [[nodiscard]] explicit operator bool() const
         {
-            return bool(state);
+            return state || loading;
+        }
+
+        // Makes the state changes requested by the states asynchronous: the new state is constructed and `Load()`ed on a worker thread,
+        //   while the current state receives `TickWhileLoading()` instead of `Tick()`. Once it's loaded, the states are swapped at the beginning
+        //   of the next `Tick()`, and the new state is `Init()`ed and ticked on the main thread.
+        // If `Load()` throws, the exception is rethrown from `Tick()`, and the old state remains.
+        void EnableAsyncTransitions(Jobs::ThreadPool &pool = Jobs::GlobalPool())
+        {
+            async_pool = &pool;
+        }
+        void DisableAsyncTransitions()
+        {
+            async_pool = nullptr;
+        }
+
+        // Returns true if the next state is being loaded asynchronously.
+        [[nodiscard]] bool IsLoading() const
+        {
+            return bool(loading);
         }
 
         QUAL_MAYBE_CONST(
@@ -58,23 +139,60 @@ namespace GameUtils::State
             }
         )
 
+        // Changes the state immediately. Cancels the asynchronous loading, if any.
         void SetState(std::string_view state_str)
         {
+            CancelLoading();
             Refl::FromString(state, state_str);
             if (state)
+            {
+                state->Load();
                 state->Init();
+            }
+        }
+
+        // Starts loading a state on the thread pool. The current state is replaced by it in the first `Tick()` after the loading finishes.
+        // Cancels the previous asynchronous loading, if any.
+        void SetStateAsync(std::string state_str, Jobs::ThreadPool &pool = Jobs::GlobalPool())
+        {
+            CancelLoading();
+            loading = std::make_unique<Loading>();
+            loading->pool = &pool;
+            pool.Submit(loading->counter, [target = loading.get(), state_str = std::move(state_str)]
+            {
+                IMP_TRACE_ZONE("State::Load");
+                Refl::FromString(target->state, state_str);
+                if (target->state)
+                    target->state->Load();
+            });
         }
 
         void Tick()
         {
+            IMP_TRACE_ZONE("State::Tick");
+
             // Note that we change state right before `state->Tick()`.
             // This way, you can never have a state that wasn't `Tick`ed yet (e.g. you can't accidentally render it).
             if (!next_state.empty())
             {
-                SetState(next_state);
+                if (async_pool)
+                    SetStateAsync(std::move(next_state), *async_pool);
+                else
+                    SetState(next_state);
                 next_state.clear();
             }
 
+            if (loading)
+            {
+                if (!loading->counter.IsDone())
+                {
+                    if (state)
+                        state->TickWhileLoading();
+                    return;
+                }
+                FinishLoading();
+            }
+
             if (state)
                 state->Tick(next_state);
         }
@@ -1,10 +1,122 @@
 #include "tiled_map.h"
 
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "stream/input.h"
+#include "stream/save_to_file.h"
 #include "strings/format.h"
+#include "utils/archive.h"
+#include "utils/filesystem.h"
 #include "utils/mat.h"
 
 namespace Tiled
 {
+    namespace
+    {
+        // Decodes base64, ignoring whitespace. Throws on invalid characters.
+        [[nodiscard]] std::vector<std::uint8_t> DecodeBase64(std::string_view str)
+        {
+            std::vector<std::uint8_t> ret;
+            ret.reserve(str.size() / 4 * 3);
+
+            std::uint32_t bits = 0;
+            int num_bits = 0;
+            for (char ch : str)
+            {
+                int value;
+                if (ch >= 'A' && ch <= 'Z')
+                    value = ch - 'A';
+                else if (ch >= 'a' && ch <= 'z')
+                    value = ch - 'a' + 26;
+                else if (ch >= '0' && ch <= '9')
+                    value = ch - '0' + 52;
+                else if (ch == '+')
+                    value = 62;
+                else if (ch == '/')
+                    value = 63;
+                else if (ch == '=')
+                    break;
+                else if (ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t')
+                    continue;
+                else
+                    throw std::runtime_error(FMT("Invalid character in base64 data: `{}`.", ch));
+
+                bits = bits << 6 | std::uint32_t(value);
+                num_bits += 6;
+                if (num_bits >= 8)
+                {
+                    num_bits -= 8;
+                    ret.push_back(std::uint8_t(bits >> num_bits));
+                }
+            }
+
+            return ret;
+        }
+
+        // Reads the tiles stored as little-endian `uint32_t`s, in the same order as our storage. `layer` must already have the right size.
+        // The high bits are the flip flags, they end up in the sign bit and below.
+        void ReadLittleEndianTiles(TileLayer &layer, const std::uint8_t *bytes)
+        {
+            int *tiles = layer.elements();
+            for (std::size_t i = 0; i < std::size_t(layer.element_count()); i++)
+            {
+                const std::uint8_t *tile = bytes + i * 4;
+                tiles[i] = int(std::uint32_t(tile[0]) | std::uint32_t(tile[1]) << 8 | std::uint32_t(tile[2]) << 16 | std::uint32_t(tile[3]) << 24);
+            }
+        }
+
+        // The inverse of `ReadLittleEndianTiles()`.
+        [[nodiscard]] std::vector<std::uint8_t> WriteLittleEndianTiles(const TileLayer &layer)
+        {
+            std::vector<std::uint8_t> ret(std::size_t(layer.element_count()) * 4);
+            const int *tiles = layer.elements();
+            for (std::size_t i = 0; i < std::size_t(layer.element_count()); i++)
+            {
+                std::uint32_t tile = std::uint32_t(tiles[i]);
+                for (int j = 0; j < 4; j++)
+                    ret[i * 4 + j] = std::uint8_t(tile >> (j * 8));
+            }
+            return ret;
+        }
+
+        // Decodes the tile data stored as a string (with `"encoding": "base64"`).
+        // `layer` must already have the right size.
+        void DecodeTileData(TileLayer &layer, std::string_view layer_name, std::string_view compression, std::string_view data)
+        {
+            std::vector<std::uint8_t> bytes = DecodeBase64(data);
+
+            std::size_t expected_size = std::size_t(layer.element_count()) * 4;
+            if (compression == "zlib" || compression == "gzip")
+            {
+                std::vector<std::uint8_t> uncompressed(expected_size);
+                try
+                {
+                    Archive::Raw::UncompressZlibOrGzip(bytes.data(), bytes.data() + bytes.size(), uncompressed.data(), uncompressed.data() + uncompressed.size());
+                }
+                catch (std::exception &e)
+                {
+                    throw std::runtime_error(FMT("Unable to decompress tile layer `{}`: {}", layer_name, e.what()));
+                }
+                bytes = std::move(uncompressed);
+            }
+            else if (compression == "zstd")
+            {
+                throw std::runtime_error(FMT("Tile layer `{}` uses zstd compression, which isn't supported. Export the map with zlib or gzip compression, or without compression.", layer_name));
+            }
+            else if (!compression.empty())
+            {
+                throw std::runtime_error(FMT("Tile layer `{}` uses unknown compression `{}`.", layer_name, compression));
+            }
+
+            if (bytes.size() != expected_size)
+                throw std::runtime_error(FMT("Expected the layer of size {} to have exactly {} tiles.", layer.size(), layer.element_count()));
+
+            ReadLittleEndianTiles(layer, bytes.data());
+        }
+    }
+
     Json::View FindLayer(Json::View map, std::string name)
     {
         Json::View ret = FindLayerOpt(map, name);
@@ -39,8 +151,23 @@ namespace Tiled
         if (source["type"].GetString() != "tilelayer")
             throw std::runtime_error(FMT("Expected `{}` to be a tile layer.", source["name"].GetString()));
 
+        if (source.HasElement("chunks"))
+            throw std::runtime_error(FMT("Tile layer `{}` is split into chunks (the map is infinite), load it with `LoadChunkedTileLayers()`.", source["name"].GetString()));
+
         ivec2 size(source["width"].GetInt(), source["height"].GetInt());
 
+        std::string encoding = source.HasElement("encoding") ? source["encoding"].GetString() : "csv";
+        if (encoding == "base64")
+        {
+            TileLayer ret(size);
+            DecodeTileData(ret, source["name"].GetString(), source.HasElement("compression") ? source["compression"].GetString() : "", source["data"].GetString());
+            return ret;
+        }
+        else if (encoding != "csv")
+        {
+            throw std::runtime_error(FMT("Tile layer `{}` uses unknown encoding `{}`.", source["name"].GetString(), encoding));
+        }
+
         Json::View array_view = source["data"];
         if (array_view.GetArraySize() != size.prod())
             throw std::runtime_error(FMT("Expected the layer of size {} to have exactly {} tiles.", size, size.prod()));
@@ -55,6 +182,223 @@ namespace Tiled
         return ret;
     }
 
+    TileLayer LoadTileLayer(const char *map_json, std::string name, int allowed_json_depth)
+    {
+        // Looks for `.layers[i]` with the matching name. Only the tile data of the current layer is kept, in `data`.
+        struct Handler : JsonSaxHandler
+        {
+            std::string target_name;
+
+            int depth = 0; // The number of open arrays and objects. The map is at depth 1, the layers at depth 3, their data at depth 4.
+            std::string map_key, layer_key; // The last keys at depths 1 and 3.
+            bool in_layers = false;
+            bool in_data = false;
+
+            std::string layer_name, layer_type, layer_encoding, layer_compression;
+            ivec2 layer_size = ivec2(-1);
+            std::vector<int> data;
+            bool data_is_valid = true; // False if there are non-integers in `data`.
+            std::string data_string; // The data, if it's encoded as a string.
+
+            bool found = false;
+            std::string found_type, found_encoding, found_compression;
+            ivec2 found_size;
+            bool found_data_is_valid = false;
+            std::vector<int> found_data;
+            std::string found_data_string;
+
+            void BeginArray() override
+            {
+                depth++;
+                if (depth == 2 && map_key == "layers")
+                {
+                    in_layers = true;
+                }
+                else if (depth == 4 && in_layers && layer_key == "data")
+                {
+                    in_data = true;
+                    data.clear();
+                    data_is_valid = true;
+                }
+            }
+            void EndArray() override
+            {
+                if (depth == 2)
+                    in_layers = false;
+                else if (depth == 4)
+                    in_data = false;
+                depth--;
+            }
+            void BeginObject() override
+            {
+                depth++;
+                if (depth == 3 && in_layers)
+                {
+                    layer_name.clear();
+                    layer_type.clear();
+                    layer_encoding = "csv";
+                    layer_compression.clear();
+                    layer_size = ivec2(-1);
+                    data.clear();
+                    data_is_valid = true;
+                    data_string.clear();
+                }
+            }
+            void EndObject() override
+            {
+                if (depth == 3 && in_layers && layer_name == target_name)
+                {
+                    if (found)
+                        throw std::runtime_error(FMT("More than one layer is named `{}`.", target_name));
+                    found = true;
+                    found_type = layer_type;
+                    found_encoding = layer_encoding;
+                    found_compression = layer_compression;
+                    found_size = layer_size;
+                    found_data_is_valid = data_is_valid;
+                    std::swap(found_data, data);
+                    std::swap(found_data_string, data_string);
+                }
+                depth--;
+            }
+            void Key(std::string_view key) override
+            {
+                if (depth == 1)
+                    map_key = key;
+                else if (depth == 3)
+                    layer_key = key;
+            }
+
+            void Int(int value) override
+            {
+                if (depth == 4 && in_data)
+                {
+                    data.push_back(value);
+                }
+                else if (depth == 3 && in_layers)
+                {
+                    if (layer_key == "width")
+                        layer_size.x = value;
+                    else if (layer_key == "height")
+                        layer_size.y = value;
+                }
+            }
+            void Real(double) override
+            {
+                if (depth == 4 && in_data)
+                    data_is_valid = false;
+            }
+            void String(std::string_view value) override
+            {
+                if (depth == 4 && in_data)
+                {
+                    data_is_valid = false;
+                }
+                else if (depth == 3 && in_layers)
+                {
+                    if (layer_key == "name")
+                        layer_name = value;
+                    else if (layer_key == "type")
+                        layer_type = value;
+                    else if (layer_key == "encoding")
+                        layer_encoding = value;
+                    else if (layer_key == "compression")
+                        layer_compression = value;
+                    else if (layer_key == "data")
+                        data_string = value;
+                }
+            }
+            void Null() override
+            {
+                if (depth == 4 && in_data)
+                    data_is_valid = false;
+            }
+            void Bool(bool) override
+            {
+                if (depth == 4 && in_data)
+                    data_is_valid = false;
+            }
+        };
+
+        Handler handler;
+        handler.target_name = name;
+        Json::ParseSax(map_json, allowed_json_depth, handler);
+
+        if (!handler.found)
+            throw std::runtime_error(FMT("Map layer `{}` is missing.", name));
+
+        if (handler.found_type != "tilelayer")
+            throw std::runtime_error(FMT("Expected `{}` to be a tile layer.", name));
+
+        ivec2 size = handler.found_size;
+        if ((size < 0).any())
+            throw std::runtime_error(FMT("Expected tile layer `{}` to have integer `width` and `height`.", name));
+
+        if (handler.found_encoding == "base64")
+        {
+            TileLayer ret(size);
+            DecodeTileData(ret, name, handler.found_compression, handler.found_data_string);
+            return ret;
+        }
+        else if (handler.found_encoding != "csv")
+        {
+            throw std::runtime_error(FMT("Tile layer `{}` uses unknown encoding `{}`.", name, handler.found_encoding));
+        }
+
+        if (!handler.found_data_is_valid)
+            throw std::runtime_error(FMT("Expected the data of tile layer `{}` to only contain integers.", name));
+        if (int(handler.found_data.size()) != size.prod())
+            throw std::runtime_error(FMT("Expected the layer of size {} to have exactly {} tiles.", size, size.prod()));
+
+        TileLayer ret(size);
+        int index = 0;
+
+        for (int y = 0; y < ret.size().y; y++)
+        for (int x = 0; x < ret.size().x; x++)
+            ret.at(ivec2(x,y)) = handler.found_data[index++];
+
+        return ret;
+    }
+
+    PointLayer::PointLayer(std::vector<Point> new_points)
+    {
+        if (new_points.size() > std::uint32_t(-1))
+            throw std::runtime_error("Too many points in a point layer.");
+
+        std::stable_sort(new_points.begin(), new_points.end(), [](const Point &a, const Point &b){return a.name < b.name;});
+
+        points.reserve(new_points.size());
+        for (Point &point : new_points)
+        {
+            if (names.empty() || names.back().name != point.name)
+                names.push_back({.name = std::move(point.name), .begin = std::uint32_t(points.size())});
+            points.push_back(point.pos);
+            names.back().end = std::uint32_t(points.size());
+        }
+    }
+
+    void PointLayer::BuildSpatialIndex(float cell_size)
+    {
+        if (!(cell_size > 0))
+            throw std::runtime_error("The cell size of a point layer spatial index must be positive.");
+
+        std::vector<frect2> rects;
+        std::vector<std::uint32_t> name_indices;
+        rects.reserve(points.size());
+        name_indices.reserve(points.size());
+        for (std::size_t i = 0; i < names.size(); i++)
+        {
+            for (fvec2 pos : PointsOf(names[i]))
+            {
+                rects.push_back(pos.tiny_rect()); // So that it touches exactly the rects that contain it.
+                name_indices.push_back(std::uint32_t(i));
+            }
+        }
+
+        spatial_index.emplace(SpatialHashGrid<fvec2, std::uint32_t>::Params{.cell_size = fvec2(cell_size)});
+        spatial_index->Build(rects, name_indices);
+    }
+
     PointLayer LoadPointLayer(Json::View source)
     {
         if (!source)
@@ -63,17 +407,17 @@ namespace Tiled
         if (source["type"].GetString() != "objectgroup")
             throw std::runtime_error(FMT("Expected `{}` to be an object layer.", source["name"].GetString()));
 
-        PointLayer ret;
+        std::vector<PointLayer::Point> points;
 
         source["objects"].ForEachArrayElement([&](Json::View elem)
         {
             if (!elem.HasElement("point") || elem["point"].GetBool() != true)
                 throw std::runtime_error(FMT("Expected every object on layer `{}` to be a point.", source["name"].GetString()));
 
-            ret.points.insert({elem["name"].GetString(), fvec2(elem["x"].GetReal(), elem["y"].GetReal())});
+            points.push_back({.name = elem["name"].GetString(), .pos = fvec2(elem["x"].GetReal(), elem["y"].GetReal())});
         });
 
-        return ret;
+        return PointLayer(std::move(points));
     }
 
     Properties LoadProperties(Json::View map)
@@ -87,4 +431,669 @@ namespace Tiled
         });
         return ret;
     }
+
+    namespace
+    {
+        // The compiled map format: the magic, the format version (`uint32_t`), the source hash (`uint64_t`),
+        //   then the string properties, the tile layers, and the point layers. All numbers are little-endian.
+        // Each of the three is a count (`uint32_t`) followed by the elements. Strings are a size (`uint32_t`) followed by the bytes.
+        // A property is: name, value. A tile layer is: name, width, height (`int32_t`), then the tiles (`int32_t`).
+        // A point layer is: name, then the count of distinct point names (`uint32_t`), then for each point name in sorted order:
+        //   name, the point count (`uint32_t`), then x, y (`float`) for each point.
+        constexpr std::string_view compiled_magic = "imp.tmap";
+        constexpr std::uint32_t compiled_version = 2; // Increment when changing the format.
+
+        void WriteCompiledString(Stream::Output &output, std::string_view str)
+        {
+            output.WriteLittle<std::uint32_t>(str.size());
+            output.WriteString(str.data(), str.size());
+        }
+
+        [[nodiscard]] std::string ReadCompiledString(Stream::Input &input)
+        {
+            std::uint32_t size = input.ReadLittle<std::uint32_t>();
+            if (size > input.RemainingBytes())
+                throw std::runtime_error(input.GetExceptionPrefix() + "String size is out of bounds.");
+            std::string ret(size, '\0');
+            input.Read(reinterpret_cast<std::uint8_t *>(ret.data()), size);
+            return ret;
+        }
+
+        // Whether `source` is an object layer that consists only of points, so `LoadPointLayer()` accepts it.
+        [[nodiscard]] bool IsPointLayer(Json::View source)
+        {
+            if (source["type"].GetString() != "objectgroup")
+                return false;
+            bool ret = true;
+            source["objects"].ForEachArrayElement([&](Json::View elem)
+            {
+                if (!elem.HasElement("point") || !elem["point"].IsBool() || !elem["point"].GetBool())
+                    ret = false;
+            });
+            return ret;
+        }
+    }
+
+    CompiledMap::CompiledMap(Json::View map)
+    {
+        map["layers"].ForEachArrayElement([&](Json::View elem)
+        {
+            std::string name = elem["name"].GetString();
+            if (tile_layers.contains(name) || point_layers.contains(name))
+                throw std::runtime_error(FMT("More than one layer is named `{}`.", name));
+
+            if (elem["type"].GetString() == "tilelayer")
+                tile_layers.try_emplace(std::move(name), LoadTileLayer(elem));
+            else if (IsPointLayer(elem))
+                point_layers.try_emplace(std::move(name), LoadPointLayer(elem));
+        });
+
+        if (map.HasElement("properties"))
+            properties = LoadProperties(map);
+    }
+
+    std::uint64_t CompiledMap::HashSource(const std::uint8_t *begin, const std::uint8_t *end)
+    {
+        // 64-bit FNV-1a.
+        std::uint64_t ret = 0xcbf29ce484222325;
+        for (const std::uint8_t *cur = begin; cur != end; cur++)
+        {
+            ret ^= *cur;
+            ret *= 0x100000001b3;
+        }
+        return ret;
+    }
+
+    std::optional<CompiledMap> CompiledMap::LoadOpt(const Stream::ReadOnlyData &data, std::uint64_t source_hash)
+    {
+        Stream::Input input(data);
+        input.WantLocationStyle(Stream::byte_offset);
+
+        if (!input.DiscardChars<Stream::if_present>(compiled_magic))
+            throw std::runtime_error(input.GetExceptionPrefix() + "This is not a compiled map.");
+        if (input.ReadLittle<std::uint32_t>() != compiled_version || input.ReadLittle<std::uint64_t>() != source_hash)
+            return {};
+
+        CompiledMap ret;
+
+        std::uint32_t num_properties = input.ReadLittle<std::uint32_t>();
+        for (std::uint32_t i = 0; i < num_properties; i++)
+        {
+            std::string name = ReadCompiledString(input);
+            ret.properties.strings.insert_or_assign(std::move(name), ReadCompiledString(input));
+        }
+
+        std::uint32_t num_tile_layers = input.ReadLittle<std::uint32_t>();
+        for (std::uint32_t i = 0; i < num_tile_layers; i++)
+        {
+            std::string name = ReadCompiledString(input);
+            ivec2 size;
+            size.x = input.ReadLittle<std::int32_t>();
+            size.y = input.ReadLittle<std::int32_t>();
+            if ((size < 0).any() || std::uint64_t(size.x) * std::uint64_t(size.y) > input.RemainingBytes() / sizeof(std::int32_t))
+                throw std::runtime_error(input.GetExceptionPrefix() + FMT("Tile layer `{}` has invalid size {}.", name, size));
+
+            TileLayer layer(size);
+            input.ReadLittle(layer.elements(), std::size_t(layer.element_count()));
+            ret.tile_layers.insert_or_assign(std::move(name), std::move(layer));
+        }
+
+        std::uint32_t num_point_layers = input.ReadLittle<std::uint32_t>();
+        for (std::uint32_t i = 0; i < num_point_layers; i++)
+        {
+            std::string name = ReadCompiledString(input);
+            PointLayer layer;
+            std::uint32_t num_names = input.ReadLittle<std::uint32_t>();
+            for (std::uint32_t j = 0; j < num_names; j++)
+            {
+                PointLayer::NameEntry &entry = layer.names.emplace_back();
+                entry.name = ReadCompiledString(input);
+                if (j > 0 && !(layer.names[j - 1].name < entry.name))
+                    throw std::runtime_error(input.GetExceptionPrefix() + FMT("The point names in layer `{}` are not sorted.", name));
+
+                std::uint32_t num_points = input.ReadLittle<std::uint32_t>();
+                if (num_points > input.RemainingBytes() / (sizeof(float) * 2))
+                    throw std::runtime_error(input.GetExceptionPrefix() + FMT("Point layer `{}` has too many points named `{}`.", name, entry.name));
+                entry.begin = std::uint32_t(layer.points.size());
+                for (std::uint32_t k = 0; k < num_points; k++)
+                {
+                    fvec2 pos;
+                    pos.x = input.ReadLittle<float>();
+                    pos.y = input.ReadLittle<float>();
+                    layer.points.push_back(pos);
+                }
+                entry.end = std::uint32_t(layer.points.size());
+            }
+            ret.point_layers.insert_or_assign(std::move(name), std::move(layer));
+        }
+
+        return ret;
+    }
+
+    void CompiledMap::Save(Stream::Output &output, std::uint64_t source_hash) const
+    {
+        output.WriteString(compiled_magic.data(), compiled_magic.size());
+        output.WriteLittle<std::uint32_t>(compiled_version);
+        output.WriteLittle<std::uint64_t>(source_hash);
+
+        output.WriteLittle<std::uint32_t>(properties.strings.size());
+        for (const auto &[name, value] : properties.strings)
+        {
+            WriteCompiledString(output, name);
+            WriteCompiledString(output, value);
+        }
+
+        output.WriteLittle<std::uint32_t>(tile_layers.size());
+        for (const auto &[name, layer] : tile_layers)
+        {
+            WriteCompiledString(output, name);
+            output.WriteLittle<std::int32_t>(layer.size().x);
+            output.WriteLittle<std::int32_t>(layer.size().y);
+            output.WriteLittle<std::int32_t>(layer.elements(), std::size_t(layer.element_count()));
+        }
+
+        output.WriteLittle<std::uint32_t>(point_layers.size());
+        for (const auto &[name, layer] : point_layers)
+        {
+            WriteCompiledString(output, name);
+            output.WriteLittle<std::uint32_t>(layer.NumNames());
+            layer.ForEachName([&](std::string_view point_name, std::span<const fvec2> points)
+            {
+                WriteCompiledString(output, point_name);
+                output.WriteLittle<std::uint32_t>(points.size());
+                for (fvec2 pos : points)
+                {
+                    output.WriteLittle<float>(pos.x);
+                    output.WriteLittle<float>(pos.y);
+                }
+            });
+        }
+    }
+
+    const TileLayer *CompiledMap::GetTileLayerOpt(std::string_view name) const
+    {
+        auto it = tile_layers.find(name);
+        return it == tile_layers.end() ? nullptr : &it->second;
+    }
+
+    const TileLayer &CompiledMap::GetTileLayer(std::string_view name) const
+    {
+        const TileLayer *ret = GetTileLayerOpt(name);
+        if (!ret)
+            throw std::runtime_error(FMT("Map tile layer `{}` is missing.", name));
+        return *ret;
+    }
+
+    const PointLayer *CompiledMap::GetPointLayerOpt(std::string_view name) const
+    {
+        auto it = point_layers.find(name);
+        return it == point_layers.end() ? nullptr : &it->second;
+    }
+
+    const PointLayer &CompiledMap::GetPointLayer(std::string_view name) const
+    {
+        const PointLayer *ret = GetPointLayerOpt(name);
+        if (!ret)
+            throw std::runtime_error(FMT("Map point layer `{}` is missing.", name));
+        return *ret;
+    }
+
+    CompiledMap LoadCompiledMap(const std::string &json_file_name, std::string cache_file_name)
+    {
+        if (cache_file_name.empty())
+            cache_file_name = json_file_name + ".bin";
+
+        Stream::ReadOnlyData source = Stream::ReadOnlyData::file(json_file_name);
+        std::uint64_t source_hash = CompiledMap::HashSource(source.begin(), source.end());
+
+        bool cache_exists = false;
+        (void)Filesystem::GetObjectInfo(cache_file_name, &cache_exists);
+        if (cache_exists)
+        {
+            try
+            {
+                if (auto ret = CompiledMap::LoadOpt(Stream::ReadOnlyData::file_mapped(cache_file_name), source_hash))
+                    return std::move(*ret);
+            }
+            catch (...)
+            {
+                // The cache is broken, recompile it.
+            }
+        }
+
+        CompiledMap ret(FlatJson(source.null_terminate().data_char(), 64).GetView());
+
+        try
+        {
+            std::vector<std::uint8_t> compiled;
+            Stream::Output output = Stream::Output::Container(compiled);
+            ret.Save(output, source_hash);
+            output.Flush();
+            Stream::SaveFileAtomic(cache_file_name, compiled);
+        }
+        catch (...)
+        {
+            // Failing to write the cache isn't fatal, we'll just recompile the map next time.
+        }
+
+        return ret;
+    }
+
+    namespace
+    {
+        // The chunked layers format: the magic, the format version (`uint32_t`), the source hash (`uint64_t`), the layer count (`uint32_t`),
+        //   then for each layer: name, chunk width, chunk height (`int32_t`), chunk count (`uint32_t`), then for each chunk: x, y (`int32_t`, in chunks), compressed size (`uint64_t`).
+        // Then the compressed chunks themselves, in the same order, compressed by `Archive::Compress()`. All numbers are little-endian. Strings are written as in `CompiledMap`.
+        constexpr std::string_view chunked_magic = "imp.tchk";
+        constexpr std::uint32_t chunked_version = 1; // Increment when changing the format.
+
+        [[nodiscard]] std::vector<std::uint8_t> CompressChunk(const TileLayer &tiles)
+        {
+            std::vector<std::uint8_t> bytes = WriteLittleEndianTiles(tiles);
+            std::vector<std::uint8_t> ret(Archive::MaxCompressedSize(bytes.data(), bytes.data() + bytes.size(), Archive::Codec::zlib_fast));
+            ret.resize(std::size_t(Archive::Compress(bytes.data(), bytes.data() + bytes.size(), ret.data(), ret.data() + ret.size(), Archive::Codec::zlib_fast) - ret.data()));
+            return ret;
+        }
+    }
+
+    void ChunkedTileLayers::Compile(const char *map_json, Stream::Output &output, std::uint64_t source_hash, int allowed_json_depth)
+    {
+        struct Chunk
+        {
+            ivec2 pos; // In tiles.
+            ivec2 size;
+            std::vector<std::uint8_t> compressed;
+            std::string data_string; // The data, if it's encoded as a string. It's decoded when the layer ends, since the encoding can come after the chunks.
+            bool needs_decoding = false; // Whether `data_string` is used instead of `compressed`.
+        };
+
+        struct CompiledLayer
+        {
+            std::string name;
+            ivec2 chunk_size;
+            std::vector<Chunk> chunks;
+        };
+
+        // Compresses each chunk of `.layers[i].chunks[j]` when it ends.
+        struct Handler : JsonSaxHandler
+        {
+            int depth = 0; // The number of open arrays and objects. The map is at depth 1, the layers at depth 3, the chunks at depth 5, their data at depth 6.
+            std::string map_key, layer_key, chunk_key; // The last keys at depths 1, 3 and 5.
+            bool in_layers = false;
+            bool in_chunks = false;
+            bool in_data = false;
+
+            std::string layer_name, layer_type, layer_encoding, layer_compression;
+            bool layer_is_chunked = false;
+            std::vector<Chunk> layer_chunks;
+
+            std::optional<int> chunk_x, chunk_y;
+            ivec2 chunk_size = ivec2(-1);
+            std::vector<int> data;
+            bool data_is_valid = true; // False if there are non-integers in `data`.
+            std::string data_string;
+            bool data_is_string = false;
+
+            std::vector<CompiledLayer> layers;
+
+            void FinishChunk()
+            {
+                if (!chunk_x || !chunk_y || (chunk_size < 0).any())
+                    throw std::runtime_error("Expected every tile chunk to have integer `x`, `y`, `width`, and `height`.");
+
+                Chunk &chunk = layer_chunks.emplace_back();
+                chunk.pos = ivec2(*chunk_x, *chunk_y);
+                chunk.size = chunk_size;
+
+                if (data_is_string)
+                {
+                    std::swap(chunk.data_string, data_string);
+                    chunk.needs_decoding = true;
+                    return;
+                }
+
+                if (!data_is_valid)
+                    throw std::runtime_error("Expected the data of tile chunks to only contain integers.");
+                if (int(data.size()) != chunk_size.prod())
+                    throw std::runtime_error(FMT("Expected the chunk of size {} to have exactly {} tiles.", chunk_size, chunk_size.prod()));
+
+                TileLayer tiles(chunk_size);
+                std::copy(data.begin(), data.end(), tiles.elements());
+                chunk.compressed = CompressChunk(tiles);
+            }
+
+            void FinishLayer()
+            {
+                if (layer_type != "tilelayer")
+                    throw std::runtime_error(FMT("Expected `{}` to be a tile layer.", layer_name));
+
+                for (Chunk &chunk : layer_chunks)
+                {
+                    if (!chunk.needs_decoding)
+                        continue;
+
+                    if (layer_encoding == "csv")
+                        throw std::runtime_error(FMT("Expected the data of tile layer `{}` to only contain integers.", layer_name));
+                    if (layer_encoding != "base64")
+                        throw std::runtime_error(FMT("Tile layer `{}` uses unknown encoding `{}`.", layer_name, layer_encoding));
+
+                    TileLayer tiles(chunk.size);
+                    DecodeTileData(tiles, layer_name, layer_compression, chunk.data_string);
+                    chunk.compressed = CompressChunk(tiles);
+                    chunk.data_string = {};
+                    chunk.needs_decoding = false;
+                }
+
+                CompiledLayer &layer = layers.emplace_back();
+                layer.name = layer_name;
+                layer.chunk_size = layer_chunks.empty() ? ivec2(1) : layer_chunks.front().size;
+                if ((layer.chunk_size <= 0).any())
+                    throw std::runtime_error(FMT("Tile layer `{}` has chunks of invalid size {}.", layer_name, layer.chunk_size));
+
+                for (const Chunk &chunk : layer_chunks)
+                {
+                    if (chunk.size != layer.chunk_size)
+                        throw std::runtime_error(FMT("Expected all chunks of tile layer `{}` to have the same size.", layer_name));
+                    if (mod_ex(chunk.pos, chunk.size) != ivec2())
+                        throw std::runtime_error(FMT("Expected the chunk positions of tile layer `{}` to be multiples of the chunk size.", layer_name));
+                }
+
+                layer.chunks = std::move(layer_chunks);
+                layer_chunks.clear();
+            }
+
+            void BeginArray() override
+            {
+                depth++;
+                if (depth == 2 && map_key == "layers")
+                {
+                    in_layers = true;
+                }
+                else if (depth == 4 && in_layers && layer_key == "chunks")
+                {
+                    in_chunks = true;
+                    layer_is_chunked = true;
+                }
+                else if (depth == 6 && in_chunks && chunk_key == "data")
+                {
+                    in_data = true;
+                    data.clear();
+                    data_is_valid = true;
+                }
+            }
+            void EndArray() override
+            {
+                if (depth == 2)
+                    in_layers = false;
+                else if (depth == 4)
+                    in_chunks = false;
+                else if (depth == 6)
+                    in_data = false;
+                depth--;
+            }
+            void BeginObject() override
+            {
+                depth++;
+                if (depth == 3 && in_layers)
+                {
+                    layer_name.clear();
+                    layer_type.clear();
+                    layer_encoding = "csv";
+                    layer_compression.clear();
+                    layer_is_chunked = false;
+                    layer_chunks.clear();
+                }
+                else if (depth == 5 && in_chunks)
+                {
+                    chunk_x.reset();
+                    chunk_y.reset();
+                    chunk_size = ivec2(-1);
+                    data.clear();
+                    data_is_valid = true;
+                    data_string.clear();
+                    data_is_string = false;
+                }
+            }
+            void EndObject() override
+            {
+                if (depth == 3 && in_layers && layer_is_chunked)
+                    FinishLayer();
+                else if (depth == 5 && in_chunks)
+                    FinishChunk();
+                depth--;
+            }
+            void Key(std::string_view key) override
+            {
+                if (depth == 1)
+                    map_key = key;
+                else if (depth == 3)
+                    layer_key = key;
+                else if (depth == 5)
+                    chunk_key = key;
+            }
+
+            void Int(int value) override
+            {
+                if (depth == 6 && in_data)
+                {
+                    data.push_back(value);
+                }
+                else if (depth == 5 && in_chunks)
+                {
+                    if (chunk_key == "x")
+                        chunk_x = value;
+                    else if (chunk_key == "y")
+                        chunk_y = value;
+                    else if (chunk_key == "width")
+                        chunk_size.x = value;
+                    else if (chunk_key == "height")
+                        chunk_size.y = value;
+                }
+            }
+            void Real(double) override
+            {
+                if (depth == 6 && in_data)
+                    data_is_valid = false;
+            }
+            void String(std::string_view value) override
+            {
+                if (depth == 6 && in_data)
+                {
+                    data_is_valid = false;
+                }
+                else if (depth == 5 && in_chunks)
+                {
+                    if (chunk_key == "data")
+                    {
+                        data_string = value;
+                        data_is_string = true;
+                    }
+                }
+                else if (depth == 3 && in_layers)
+                {
+                    if (layer_key == "name")
+                        layer_name = value;
+                    else if (layer_key == "type")
+                        layer_type = value;
+                    else if (layer_key == "encoding")
+                        layer_encoding = value;
+                    else if (layer_key == "compression")
+                        layer_compression = value;
+                }
+            }
+            void Null() override
+            {
+                if (depth == 6 && in_data)
+                    data_is_valid = false;
+            }
+            void Bool(bool) override
+            {
+                if (depth == 6 && in_data)
+                    data_is_valid = false;
+            }
+        };
+
+        Handler handler;
+        Json::ParseSax(map_json, allowed_json_depth, handler);
+
+        std::sort(handler.layers.begin(), handler.layers.end(), [](const CompiledLayer &a, const CompiledLayer &b){return a.name < b.name;});
+        for (std::size_t i = 1; i < handler.layers.size(); i++)
+        {
+            if (handler.layers[i - 1].name == handler.layers[i].name)
+                throw std::runtime_error(FMT("More than one layer is named `{}`.", handler.layers[i].name));
+        }
+
+        output.WriteString(chunked_magic.data(), chunked_magic.size());
+        output.WriteLittle<std::uint32_t>(chunked_version);
+        output.WriteLittle<std::uint64_t>(source_hash);
+
+        output.WriteLittle<std::uint32_t>(handler.layers.size());
+        for (const CompiledLayer &layer : handler.layers)
+        {
+            WriteCompiledString(output, layer.name);
+            output.WriteLittle<std::int32_t>(layer.chunk_size.x);
+            output.WriteLittle<std::int32_t>(layer.chunk_size.y);
+            output.WriteLittle<std::uint32_t>(layer.chunks.size());
+            for (const Chunk &chunk : layer.chunks)
+            {
+                ivec2 chunk_pos = chunk.pos / layer.chunk_size;
+                output.WriteLittle<std::int32_t>(chunk_pos.x);
+                output.WriteLittle<std::int32_t>(chunk_pos.y);
+                output.WriteLittle<std::uint64_t>(chunk.compressed.size());
+            }
+        }
+
+        for (const CompiledLayer &layer : handler.layers)
+        {
+            for (const Chunk &chunk : layer.chunks)
+                output.WriteLittle<std::uint8_t>(chunk.compressed.data(), chunk.compressed.size());
+        }
+    }
+
+    std::optional<ChunkedTileLayers> ChunkedTileLayers::LoadOpt(Stream::ReadOnlyData data, std::uint64_t source_hash)
+    {
+        Stream::Input input(data);
+        input.WantLocationStyle(Stream::byte_offset);
+
+        if (!input.DiscardChars<Stream::if_present>(chunked_magic))
+            throw std::runtime_error(input.GetExceptionPrefix() + "This is not a compiled chunked map.");
+        if (input.ReadLittle<std::uint32_t>() != chunked_version || input.ReadLittle<std::uint64_t>() != source_hash)
+            return {};
+
+        ChunkedTileLayers ret;
+        std::size_t total_size = 0;
+
+        std::uint32_t num_layers = input.ReadLittle<std::uint32_t>();
+        for (std::uint32_t i = 0; i < num_layers; i++)
+        {
+            std::string name = ReadCompiledString(input);
+            Layer layer;
+            layer.chunk_size.x = input.ReadLittle<std::int32_t>();
+            layer.chunk_size.y = input.ReadLittle<std::int32_t>();
+            if ((layer.chunk_size <= 0).any())
+                throw std::runtime_error(input.GetExceptionPrefix() + FMT("Tile layer `{}` has chunks of invalid size.", name));
+
+            std::uint32_t num_chunks = input.ReadLittle<std::uint32_t>();
+            for (std::uint32_t j = 0; j < num_chunks; j++)
+            {
+                ivec2 chunk;
+                chunk.x = input.ReadLittle<std::int32_t>();
+                chunk.y = input.ReadLittle<std::int32_t>();
+                std::uint64_t size = input.ReadLittle<std::uint64_t>();
+                if (size > data.size())
+                    throw std::runtime_error(input.GetExceptionPrefix() + "Chunk size is out of bounds.");
+                if (!layer.chunks.try_emplace(chunk, ChunkLocation{.offset = total_size, .size = std::size_t(size)}).second)
+                    throw std::runtime_error(input.GetExceptionPrefix() + FMT("Duplicate chunk in tile layer `{}`.", name));
+                total_size += std::size_t(size);
+            }
+
+            if (!ret.layers.try_emplace(std::move(name), std::move(layer)).second)
+                throw std::runtime_error(input.GetExceptionPrefix() + "Duplicate layer name.");
+        }
+
+        if (total_size > input.RemainingBytes())
+            throw std::runtime_error(input.GetExceptionPrefix() + "The chunk data is truncated.");
+
+        ret.data_offset = data.size() - input.RemainingBytes();
+        ret.data = std::move(data);
+        return ret;
+    }
+
+    const ChunkedTileLayers::Layer *ChunkedTileLayers::GetLayerOpt(std::string_view name) const
+    {
+        auto it = layers.find(name);
+        return it == layers.end() ? nullptr : &it->second;
+    }
+
+    const ChunkedTileLayers::Layer &ChunkedTileLayers::GetLayer(std::string_view name) const
+    {
+        const Layer *ret = GetLayerOpt(name);
+        if (!ret)
+            throw std::runtime_error(FMT("Chunked map layer `{}` is missing.", name));
+        return *ret;
+    }
+
+    TileLayer ChunkedTileLayers::LoadChunk(const Layer &layer, ivec2 chunk) const
+    {
+        TileLayer ret(layer.chunk_size);
+
+        auto it = layer.chunks.find(chunk);
+        if (it == layer.chunks.end())
+            return ret;
+
+        const std::uint8_t *begin = data.begin() + data_offset + it->second.offset;
+        const std::uint8_t *end = begin + it->second.size;
+        if (Archive::UncompressedSize(begin, end) != std::size_t(ret.element_count()) * 4)
+            throw std::runtime_error(FMT("Chunk {} of a chunked map has invalid size.", chunk));
+
+        std::vector<std::uint8_t> bytes(std::size_t(ret.element_count()) * 4);
+        Archive::Uncompress(begin, end, bytes.data());
+        ReadLittleEndianTiles(ret, bytes.data());
+        return ret;
+    }
+
+    ChunkedTileLayers LoadChunkedTileLayers(const std::string &json_file_name, std::string cache_file_name)
+    {
+        if (cache_file_name.empty())
+            cache_file_name = json_file_name + ".chunks";
+
+        std::uint64_t source_hash = 0;
+        {
+            Stream::ReadOnlyData source = Stream::ReadOnlyData::file(json_file_name);
+            source_hash = CompiledMap::HashSource(source.begin(), source.end());
+
+            bool cache_exists = false;
+            (void)Filesystem::GetObjectInfo(cache_file_name, &cache_exists);
+            if (cache_exists)
+            {
+                try
+                {
+                    if (auto ret = ChunkedTileLayers::LoadOpt(Stream::ReadOnlyData::file_mapped(cache_file_name), source_hash))
+                        return std::move(*ret);
+                }
+                catch (...)
+                {
+                    // The cache is broken, recompile it.
+                }
+            }
+
+            std::vector<std::uint8_t> compiled;
+            Stream::Output output = Stream::Output::Container(compiled);
+            ChunkedTileLayers::Compile(source.null_terminate().data_char(), output, source_hash, 64);
+            output.Flush();
+
+            try
+            {
+                Stream::SaveFileAtomic(cache_file_name, compiled);
+            }
+            catch (...)
+            {
+                // Failing to write the cache isn't fatal, keep the compiled layers in memory.
+                return std::move(*ChunkedTileLayers::LoadOpt(Stream::ReadOnlyData::mem_copy(compiled), source_hash));
+            }
+        }
+
+        // Reopen the cache, to avoid keeping all chunks in memory.
+        return std::move(*ChunkedTileLayers::LoadOpt(Stream::ReadOnlyData::file_mapped(cache_file_name), source_hash));
+    }
 }
@@ -1,15 +1,24 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <iterator>
 #include <map>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
+#include "stream/output.h"
+#include "stream/readonly_data.h"
 #include "strings/common.h"
 #include "utils/json.h"
 #include "utils/mat.h"
 #include "utils/multiarray.h"
+#include "utils/spatial_hash_grid.h"
 
 namespace Tiled
 {
@@ -18,58 +27,156 @@ namespace Tiled
 
     using TileLayer = MultiArray<2, int>;
     TileLayer LoadTileLayer(Json::View source);
+    // Loads the layer named `name` directly from the text of the map, without building a JSON document.
+    // This is cheaper for large maps, where the tile arrays would otherwise become a huge amount of JSON nodes.
+    TileLayer LoadTileLayer(const char *map_json, std::string name, int allowed_json_depth = 32);
 
-    struct PointLayer
+    // The points of an object layer, grouped by name.
+    // Each name is stored once, in a sorted table, and the points with the same name are next to each other in one array,
+    //   in the order they were added. This makes the lookups by name or by name prefix cheap, and loading doesn't allocate per point.
+    // Call `BuildSpatialIndex()` to speed up `ForEachPointInRect()`.
+    class PointLayer
     {
-        std::multimap<std::string, fvec2> points;
+        friend class CompiledMap; // Loads the names and the points directly.
+
+      public:
+        struct Point
+        {
+            std::string name;
+            fvec2 pos;
+        };
+
+      private:
+        struct NameEntry
+        {
+            std::string name;
+            // The points with this name are `points[begin..end)`.
+            std::uint32_t begin = 0;
+            std::uint32_t end = 0;
+        };
+
+        std::vector<NameEntry> names; // Sorted by name.
+        std::vector<fvec2> points;
+        std::optional<SpatialHashGrid<fvec2, std::uint32_t>> spatial_index; // The user data is the index in `names`.
+
+        // Returns the first name that is not less than `name`.
+        [[nodiscard]] std::vector<NameEntry>::const_iterator LowerBound(std::string_view name) const
+        {
+            return std::lower_bound(names.begin(), names.end(), name, [](const NameEntry &entry, std::string_view name){return entry.name < name;});
+        }
+
+        [[nodiscard]] std::span<const fvec2> PointsOf(const NameEntry &entry) const
+        {
+            return std::span(points.data() + entry.begin, points.data() + entry.end);
+        }
+
+      public:
+        PointLayer() {}
+
+        // The points with the same name keep their relative order.
+        explicit PointLayer(std::vector<Point> new_points);
+
+        [[nodiscard]] std::size_t NumPoints() const
+        {
+            return points.size();
+        }
+        [[nodiscard]] std::size_t NumNames() const
+        {
+            return names.size();
+        }
+
+        // Returns all points with this name, or an empty span if none.
+        [[nodiscard]] std::span<const fvec2> GetPoints(std::string_view name) const
+        {
+            auto it = LowerBound(name);
+            if (it == names.end() || it->name != name)
+                return {};
+            return PointsOf(*it);
+        }
 
         template <typename F>
-        void ForEachPointNamed(std::string name, F &&func) const // `func` is `void func(fvec2 pos)`.
+        void ForEachPointNamed(std::string_view name, F &&func) const // `func` is `void func(fvec2 pos)`.
         {
-            auto [begin, end] = points.equal_range(name);
-            while (begin != end)
-            {
-                func(begin->second);
-                begin++;
-            }
+            for (fvec2 pos : GetPoints(name))
+                func(pos);
         }
 
         template <typename F>
-        void ForEachPointWithNamePrefix(std::string prefix, F &&func) const // `func` is `void func(std::string_view suffix, fvec2 pos)`.
+        void ForEachPointWithNamePrefix(std::string_view prefix, F &&func) const // `func` is `void func(std::string_view suffix, fvec2 pos)`.
         {
-            auto begin = points.lower_bound(prefix);
-            while (begin != points.end() && begin->first.starts_with(prefix))
+            for (auto it = LowerBound(prefix); it != names.end() && it->name.starts_with(prefix); it++)
             {
-                func(std::string_view(begin->first.begin() + prefix.size(), begin->first.end()), begin->second);
-                begin++;
+                std::string_view suffix = std::string_view(it->name).substr(prefix.size());
+                for (fvec2 pos : PointsOf(*it))
+                    func(suffix, pos);
             }
         }
 
-        std::optional<fvec2> GetSinglePointOpt(std::string name) const
+        // Visits all distinct names, in sorted order. `func` is `void func(std::string_view name, std::span<const fvec2> points)`.
+        template <typename F>
+        void ForEachName(F &&func) const
+        {
+            for (const NameEntry &entry : names)
+                func(std::string_view(entry.name), PointsOf(entry));
+        }
+
+        std::optional<fvec2> GetSinglePointOpt(std::string_view name) const
         {
-            auto [begin, end] = points.equal_range(name);
-            if (begin == end)
+            std::span<const fvec2> found = GetPoints(name);
+            if (found.empty())
                 return {};
-            if (std::next(begin) != end)
+            if (found.size() > 1)
                 throw std::runtime_error(FMT("Expected the map to contain at most one point named `{}`.", name));
-            return begin->second;
+            return found.front();
         }
 
-        fvec2 GetSinglePoint(std::string name) const
+        fvec2 GetSinglePoint(std::string_view name) const
         {
-            auto [begin, end] = points.equal_range(name);
-            if (begin == points.end() || std::next(begin) != end)
+            std::span<const fvec2> found = GetPoints(name);
+            if (found.size() != 1)
                 throw std::runtime_error(FMT("Expected the map to contain exactly one point named `{}`.", name));
-            return begin->second;
+            return found.front();
         }
 
-        std::vector<fvec2> GetPointList(std::string name) const
+        std::vector<fvec2> GetPointList(std::string_view name) const
         {
-            auto [begin, end] = points.equal_range(name);
-            std::vector<fvec2> ret;
-            ret.reserve(std::distance(begin, end));
-            std::transform(begin, end, std::back_inserter(ret), [](const auto &pair){return pair.second;});
-            return ret;
+            std::span<const fvec2> found = GetPoints(name);
+            return std::vector<fvec2>(found.begin(), found.end());
+        }
+
+        // Builds a spatial index for `ForEachPointInRect()`. `cell_size` should be comparable to the typical query size.
+        void BuildSpatialIndex(float cell_size);
+        [[nodiscard]] bool HasSpatialIndex() const
+        {
+            return spatial_index.has_value();
+        }
+
+        // Visits the points in `rect` (including the lower bound, excluding the upper one), in no particular order.
+        // `func` is `void func(std::string_view name, fvec2 pos)`. Without `BuildSpatialIndex()`, this checks every point.
+        template <typename F>
+        void ForEachPointInRect(frect2 rect, F &&func) const
+        {
+            if (spatial_index)
+            {
+                spatial_index->CollideAabb(rect, [&](int index)
+                {
+                    fvec2 pos = points[std::size_t(index)];
+                    if (rect.contains(pos))
+                        func(std::string_view(names[spatial_index->GetUserData(index)].name), pos);
+                    return false;
+                });
+            }
+            else
+            {
+                for (const NameEntry &entry : names)
+                {
+                    for (fvec2 pos : PointsOf(entry))
+                    {
+                        if (rect.contains(pos))
+                            func(std::string_view(entry.name), pos);
+                    }
+                }
+            }
         }
     };
 
@@ -93,4 +200,95 @@ namespace Tiled
     };
 
     Properties LoadProperties(Json::View map);
+
+    // A map compiled into a binary form, which loads much faster than JSON.
+    // Contains all tile layers, the object layers where every object is a point, and the string properties.
+    // Use `LoadCompiledMap()` to cache the compiled map next to the JSON file.
+    class CompiledMap
+    {
+        std::map<std::string, TileLayer, std::less<>> tile_layers;
+        std::map<std::string, PointLayer, std::less<>> point_layers;
+        Properties properties;
+
+      public:
+        CompiledMap() {}
+
+        // Compiles a parsed map. Throws on failure.
+        explicit CompiledMap(Json::View map);
+
+        // Computes the hash of the JSON source, to detect stale compiled maps. The hash is stable between runs and platforms.
+        [[nodiscard]] static std::uint64_t HashSource(const std::uint8_t *begin, const std::uint8_t *end);
+
+        // Loads a compiled map. Returns null if it was compiled from a different source, or by an incompatible version of this code.
+        // Throws if the data is malformed.
+        [[nodiscard]] static std::optional<CompiledMap> LoadOpt(const Stream::ReadOnlyData &data, std::uint64_t source_hash);
+        // Writes the compiled map. `source_hash` is checked by `LoadOpt()`.
+        void Save(Stream::Output &output, std::uint64_t source_hash) const;
+
+        // Returns null if there is no such layer.
+        [[nodiscard]] const TileLayer *GetTileLayerOpt(std::string_view name) const;
+        [[nodiscard]] const TileLayer &GetTileLayer(std::string_view name) const;
+        // Returns null if there is no such layer.
+        [[nodiscard]] const PointLayer *GetPointLayerOpt(std::string_view name) const;
+        [[nodiscard]] const PointLayer &GetPointLayer(std::string_view name) const;
+
+        [[nodiscard]] const Properties &GetProperties() const {return properties;}
+    };
+
+    // Loads a map from `cache_file_name` if it was compiled from the current contents of `json_file_name`.
+    // Otherwise compiles the JSON file, and writes `cache_file_name` (if that fails, the map is still returned).
+    // If `cache_file_name` is empty, uses `json_file_name` with the `.bin` suffix.
+    [[nodiscard]] CompiledMap LoadCompiledMap(const std::string &json_file_name, std::string cache_file_name = "");
+
+    // The tile layers of an infinite map. Those are split into chunks, each compressed separately, so they can be loaded one at a time.
+    // Use `LoadChunkedTileLayers()` to compile them from the JSON map and cache them next to it,
+    //   and `StreamingTileLayer` (from `gameutils/tiled_streaming_layer.h`) to keep the chunks around the camera in memory.
+    class ChunkedTileLayers
+    {
+      public:
+        struct ChunkLocation
+        {
+            std::size_t offset = 0; // Relative to the beginning of the chunk data.
+            std::size_t size = 0;
+        };
+
+        struct Layer
+        {
+            ivec2 chunk_size; // In tiles.
+            // The keys are the chunk coordinates, which are the tile coordinates divided by `chunk_size`. The missing chunks are empty.
+            std::unordered_map<ivec2, ChunkLocation> chunks;
+
+            [[nodiscard]] bool HasChunk(ivec2 chunk) const {return chunks.contains(chunk);}
+        };
+
+      private:
+        Stream::ReadOnlyData data;
+        std::size_t data_offset = 0; // Where the chunk data starts in `data`.
+        std::map<std::string, Layer, std::less<>> layers;
+
+      public:
+        ChunkedTileLayers() {}
+
+        // Compiles all chunked tile layers of a map from its JSON text, and writes them to `output`. Throws on failure.
+        // Only one chunk at a time is kept uncompressed (except for base64-encoded layers, where the encoded chunks are kept until the end of the layer).
+        // `source_hash` should be `CompiledMap::HashSource()` of the JSON, it's checked by `LoadOpt()`.
+        static void Compile(const char *map_json, Stream::Output &output, std::uint64_t source_hash, int allowed_json_depth = 32);
+
+        // Loads compiled layers. Only reads the index, the chunks are decompressed later by `LoadChunk()`, so `data` should preferably be memory-mapped.
+        // Returns null if they were compiled from a different source, or by an incompatible version of this code. Throws if the data is malformed.
+        [[nodiscard]] static std::optional<ChunkedTileLayers> LoadOpt(Stream::ReadOnlyData data, std::uint64_t source_hash);
+
+        // Returns null if there is no such layer.
+        [[nodiscard]] const Layer *GetLayerOpt(std::string_view name) const;
+        [[nodiscard]] const Layer &GetLayer(std::string_view name) const;
+
+        // Decompresses a chunk of `layer` (which must belong to this object). Returns zeroes for missing chunks. Throws if the data is malformed.
+        // Can be called from several threads at once.
+        [[nodiscard]] TileLayer LoadChunk(const Layer &layer, ivec2 chunk) const;
+    };
+
+    // Loads the chunked layers from `cache_file_name` if it was compiled from the current contents of `json_file_name`.
+    // Otherwise compiles the JSON file, and writes `cache_file_name` (if that fails, the layers are kept in memory).
+    // If `cache_file_name` is empty, uses `json_file_name` with the `.chunks` suffix.
+    [[nodiscard]] ChunkedTileLayers LoadChunkedTileLayers(const std::string &json_file_name, std::string cache_file_name = "");
 }
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gameutils/tiled_map.h"
+#include "utils/mat.h"
+#include "utils/ring_multiarray.h"
+
+namespace Tiled
+{
+    // Keeps the tiles of a chunked layer (of an infinite map) around a view rectangle in memory,
+    //   loading the chunks on a background thread as the view moves, and forgetting the chunks that leave it.
+    // The memory usage depends only on the view size, not on the size of the world.
+    // Call `SetView()` when the camera moves, and `Update()` once per frame to receive the loaded chunks.
+    class StreamingTileLayer
+    {
+        enum class ChunkState : std::uint8_t
+        {
+            missing, // Not requested yet. Must be zero, since `RingMultiarray` zeroes the new elements.
+            queued,
+            loaded,
+        };
+
+        struct LoadedChunk
+        {
+            ivec2 chunk;
+            TileLayer tiles;
+        };
+
+        std::shared_ptr<const ChunkedTileLayers> source;
+        const ChunkedTileLayers::Layer *layer = nullptr; // Points into `source`.
+        int margin = 0; // In chunks.
+
+        TileGrids::RingMultiarray<2, int, int> tiles; // In tile coordinates. The bounds are always aligned to chunks.
+        TileGrids::RingMultiarray<2, ChunkState, int> chunk_states; // In chunk coordinates.
+
+        std::mutex mutex;
+        std::condition_variable cv, idle_cv;
+        std::deque<ivec2> requests; // The chunks to load, nearest to the view first.
+        std::vector<LoadedChunk> results;
+        std::exception_ptr error;
+        bool busy = false; // Whether the worker is loading a chunk that was removed from `requests`.
+        bool stop = false;
+
+        std::jthread worker; // Must be the last member, to stop first.
+
+        void WorkerLoop()
+        {
+            std::unique_lock lock(mutex);
+            while (true)
+            {
+                cv.wait(lock, [&]{return stop || !requests.empty();});
+                if (stop)
+                    return;
+
+                ivec2 chunk = requests.front();
+                requests.pop_front();
+                busy = true;
+                lock.unlock();
+
+                LoadedChunk result;
+                std::exception_ptr new_error;
+                try
+                {
+                    result = {chunk, source->LoadChunk(*layer, chunk)};
+                }
+                catch (...)
+                {
+                    new_error = std::current_exception();
+                }
+
+                lock.lock();
+                if (new_error)
+                {
+                    if (!error)
+                        error = new_error;
+                }
+                else
+                {
+                    results.push_back(std::move(result));
+                }
+                busy = false;
+                idle_cv.notify_all();
+            }
+        }
+
+      public:
+        StreamingTileLayer() {}
+
+        // `layer_name` is a layer in `source`. Throws if it's missing.
+        // `margin` is the number of chunks to load around the view in each direction, so they're ready before they become visible.
+        StreamingTileLayer(std::shared_ptr<const ChunkedTileLayers> new_source, std::string_view layer_name, int margin = 1)
+            : source(std::move(new_source)), layer(&source->GetLayer(layer_name)), margin(margin)
+        {
+            worker = std::jthread([this]{WorkerLoop();});
+        }
+
+        StreamingTileLayer(const StreamingTileLayer &) = delete;
+        StreamingTileLayer &operator=(const StreamingTileLayer &) = delete;
+
+        ~StreamingTileLayer()
+        {
+            if (!worker.joinable())
+                return;
+            {
+                std::lock_guard lock(mutex);
+                stop = true;
+            }
+            cv.notify_all();
+        }
+
+        [[nodiscard]] ivec2 ChunkSize() const {return layer->chunk_size;}
+
+        // The tiles that are currently kept in memory (loaded or not), aligned to chunks.
+        [[nodiscard]] irect2 Bounds() const {return tiles.bounds();}
+
+        // Returns the tile, or zero if it's outside of `Bounds()` or not loaded yet.
+        [[nodiscard]] int at(ivec2 pos) const
+        {
+            if (!tiles.bounds().contains(pos))
+                return 0;
+            return tiles.at(pos);
+        }
+
+        // Whether the chunk containing the tile is loaded. Returns false outside of `Bounds()`.
+        [[nodiscard]] bool IsLoaded(ivec2 pos) const
+        {
+            ivec2 chunk = div_ex(pos, layer->chunk_size);
+            return chunk_states.bounds().contains(chunk) && chunk_states.at(chunk) == ChunkState::loaded;
+        }
+
+        // Whether all chunks in `Bounds()` are loaded.
+        [[nodiscard]] bool IsFullyLoaded() const
+        {
+            for (ivec2 chunk : vector_range(chunk_states.bounds()))
+            {
+                if (chunk_states.at(chunk) != ChunkState::loaded)
+                    return false;
+            }
+            return true;
+        }
+
+        // Moves the window to cover `view` (in tiles), plus the margin.
+        // Queues the chunks that entered the window for loading, and drops the ones that left it (including the pending requests).
+        void SetView(irect2 view)
+        {
+            ivec2 chunk_size = layer->chunk_size;
+            irect2 new_bounds = div_ex(view.a, chunk_size).rect_to(div_ex(max(view.b - 1, view.a), chunk_size) + 1).expand(margin);
+            if (new_bounds == chunk_states.bounds())
+                return;
+
+            chunk_states.resize(new_bounds);
+            tiles.resize(new_bounds * chunk_size);
+
+            std::vector<ivec2> new_requests;
+            for (ivec2 chunk : vector_range(new_bounds))
+            {
+                ChunkState &state = chunk_states.at(chunk);
+                if (state != ChunkState::missing)
+                    continue;
+
+                if (layer->HasChunk(chunk))
+                {
+                    state = ChunkState::queued;
+                    new_requests.push_back(chunk);
+                }
+                else
+                {
+                    state = ChunkState::loaded; // Missing chunks are empty, and the new tiles are already zeroed.
+                }
+            }
+
+            // Load the chunks closest to the view first.
+            ivec2 center = div_ex(view.center(), chunk_size);
+            std::sort(new_requests.begin(), new_requests.end(), [&](ivec2 a, ivec2 b){return (a - center).len_sq() < (b - center).len_sq();});
+
+            {
+                std::lock_guard lock(mutex);
+                std::erase_if(requests, [&](ivec2 chunk){return !new_bounds.contains(chunk);});
+                requests.insert(requests.end(), new_requests.begin(), new_requests.end());
+            }
+            cv.notify_all();
+        }
+
+        // Copies the chunks loaded in the background into the window. Call this once per frame.
+        // Rethrows the exceptions from the loading thread.
+        void Update()
+        {
+            std::vector<LoadedChunk> new_results;
+            {
+                std::lock_guard lock(mutex);
+                if (error)
+                    std::rethrow_exception(error);
+                std::swap(new_results, results);
+            }
+
+            for (const LoadedChunk &result : new_results)
+            {
+                // The chunk could've left the window while it was loading.
+                if (!chunk_states.bounds().contains(result.chunk) || chunk_states.at(result.chunk) != ChunkState::queued)
+                    continue;
+
+                ivec2 base = result.chunk * layer->chunk_size;
+                for (ivec2 pos : vector_range(layer->chunk_size))
+                    tiles.at(base + pos) = result.tiles.at(pos);
+                chunk_states.at(result.chunk) = ChunkState::loaded;
+            }
+        }
+
+        // Blocks until all requested chunks are loaded, then calls `Update()`.
+        void WaitUntilLoaded()
+        {
+            {
+                std::unique_lock lock(mutex);
+                idle_cv.wait(lock, [&]{return error || (requests.empty() && !busy);});
+            }
+            Update();
+        }
+    };
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+#include "utils/aabb_tree.h"
+#include "utils/mat.h"
+
+namespace GameUtils
+{
+    // Keeps the bounding boxes of renderable objects, and finds the ones visible by one or more cameras.
+    // Usage:
+    //     VisibilitySet<Entity *> set;
+    //     auto handle = set.Add(bounds, &entity);
+    //     set.Move(handle, new_bounds); // When the object moves.
+    //     for (Entity *entity : set.Query(camera_pos + viewport.GetDetails().RectCentered())) ...
+    // `T` is stored in the nodes of an `AabbTree`, so keep it small, e.g. a pointer or an index.
+    template <typename T>
+    class VisibilitySet
+    {
+        struct Object
+        {
+            frect2 bounds; // The tree expands the AABBs, so we store the exact ones to filter the results.
+            T value{};
+        };
+
+        using Tree = AabbTree<fvec2, Object>;
+
+        Tree tree;
+        std::vector<typename Tree::NodeIndex> found;
+        std::vector<T> visible;
+
+      public:
+        using Handle = typename Tree::NodeIndex;
+        static constexpr Handle null_handle = Tree::null_index;
+
+        // `margin` is how far an object can move before the tree has to be updated.
+        VisibilitySet(float margin = 16) : tree(typename Tree::Params(fvec2(margin))) {}
+
+        [[nodiscard]] Handle Add(frect2 bounds, T value)
+        {
+            sort_two_var(bounds.a, bounds.b);
+            return tree.AddNode(bounds, Object{.bounds = bounds, .value = std::move(value)});
+        }
+
+        // `velocity` is optional. It's used to predictively expand the box, so a moving object doesn't update the tree every frame.
+        void Move(Handle handle, frect2 bounds, fvec2 velocity = {})
+        {
+            sort_two_var(bounds.a, bounds.b);
+            tree.ModifyNode(handle, bounds, velocity);
+            tree.GetNodeUserData(handle).bounds = bounds;
+        }
+
+        void Remove(Handle handle)
+        {
+            tree.RemoveNode(handle);
+        }
+
+        [[nodiscard]] T &Get(Handle handle)
+        {
+            return tree.GetNodeUserData(handle).value;
+        }
+        [[nodiscard]] const T &Get(Handle handle) const
+        {
+            return tree.GetNodeUserData(handle).value;
+        }
+
+        // Returns the objects touching any of the `views` (e.g. the main camera and a minimap), each object once.
+        // The order is unspecified. The returned span is invalidated by the next query.
+        [[nodiscard]] std::span<const T> Query(std::span<const frect2> views)
+        {
+            found.clear();
+            visible.clear();
+
+            for (frect2 view : views)
+            {
+                sort_two_var(view.a, view.b);
+                tree.CollideAabb(view, [&](Handle handle)
+                {
+                    if (tree.GetNodeUserData(handle).bounds.touches(view))
+                        found.push_back(handle);
+                    return false;
+                });
+            }
+
+            if (views.size() > 1)
+            {
+                std::sort(found.begin(), found.end());
+                found.erase(std::unique(found.begin(), found.end()), found.end());
+            }
+
+            visible.reserve(found.size());
+            for (Handle handle : found)
+                visible.push_back(tree.GetNodeUserData(handle).value);
+            return visible;
+        }
+        [[nodiscard]] std::span<const T> Query(frect2 view)
+        {
+            return Query(std::span(&view, 1));
+        }
+
+        [[nodiscard]] const Tree &GetTree() const
+        {
+            return tree;
+        }
+    };
+}
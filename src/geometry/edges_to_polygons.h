@@ -6,11 +6,14 @@
 #include "utils/sparse_set.h"
 
 #include <CDT/CDT.h> // For the constructor of Topology that fills it from a triangulation.
+#include <parallel_hashmap/phmap.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 // Converts multiple edges to triangles (using the CDT library, which you can also use directly),
 //   and then combines triangles into polygons using our own code.
@@ -167,11 +170,10 @@ namespace Geom::EdgesToPolygons
     };
 
     // Must manually specify output type T. CDT requires it to be floating-point.
+    // `ret` must be a new triangulation (its `vertices` and `triangles` can have some capacity reserved).
     template <std::floating_point T, typename U>
-    [[nodiscard]] CDT::Triangulation<T> Triangulate(const TriangulationInput<U> &input)
+    void Triangulate(const TriangulationInput<U> &input, CDT::Triangulation<T> &ret)
     {
-        CDT::Triangulation<T> ret;
-
         // I insert everything at once, because the first insertion is somehow privileged? Weird.
         // Not sure if this is actually beneficial, but it probably is (because otherwise it probably updates the triangulation on every insertion).
         ret.insertVertices(
@@ -185,7 +187,12 @@ namespace Geom::EdgesToPolygons
             [](const TriangulationInput<T>::Edge &e) {return e.second;}
         );
         ret.eraseOuterTrianglesAndHoles(); // This finalizes the triangulation.
-
+    }
+    template <std::floating_point T, typename U>
+    [[nodiscard]] CDT::Triangulation<T> Triangulate(const TriangulationInput<U> &input)
+    {
+        CDT::Triangulation<T> ret;
+        Triangulate(input, ret);
         return ret;
     }
 
@@ -236,6 +243,14 @@ namespace Geom::EdgesToPolygons
         SparseSet<std::underlying_type_t<EdgeId>> edge_set;
         SparseSet<std::underlying_type_t<FaceId>> face_set;
 
+        struct EdgeQueueEntry
+        {
+            EdgeId edge_id;
+            double length_sq = 0;
+        };
+        // Used by `CombineToConvexPolygons()`, stored here to reuse the memory.
+        std::vector<EdgeQueueEntry> edge_queue;
+
       public:
         Topology() {}
 
@@ -243,16 +258,34 @@ namespace Geom::EdgesToPolygons
         template <typename T>
         Topology(const CDT::Triangulation<T> &input)
         {
+            Reset(input);
+        }
+
+        // Removes everything, but keeps the memory for reuse.
+        void Reset()
+        {
+            edges.clear();
+            faces.clear();
+            edge_set.EraseAllElements();
+            face_set.EraseAllElements();
+        }
+
+        // Same as constructing from `input`, but reuses the existing memory.
+        template <typename T>
+        void Reset(const CDT::Triangulation<T> &input)
+        {
+            Reset();
+
             ASSERT(input.triangles.size() > 0); // Not strictly necessary?
             if (input.triangles.empty())
                 return;
 
             // Reserve memory:
 
-            faces.resize(input.triangles.size());
+            faces.assign(input.triangles.size(), Face{});
             face_set.Reserve(faces.size());
 
-            edges.resize(input.triangles.size() * 3);
+            edges.assign(input.triangles.size() * 3, Edge{});
             edge_set.Reserve(edges.size());
 
             for (std::size_t i = 0; i < input.triangles.size(); i++)
@@ -308,13 +341,7 @@ namespace Geom::EdgesToPolygons
         template <typename T>
         void CombineToConvexPolygons(const TriangulationInput<T> &input, int max_verts_per_polygon)
         {
-            struct EdgeEntry
-            {
-                EdgeId edge_id;
-                T length_sq = 0;
-            };
-
-            std::vector<EdgeEntry> edge_queue;
+            edge_queue.clear();
             // Divide by two because we skip mirrored edges. We also don't need space for the contour edges, hence the subtraction.
             edge_queue.reserve((edge_set.ElemCount() - input.edges.size()) / 2);
 
@@ -350,13 +377,13 @@ namespace Geom::EdgesToPolygons
 
                 edge_queue.push_back({
                     .edge_id = edge_id,
-                    .length_sq = (input.points[std::to_underlying(edge.origin_vert)] - input.points[std::to_underlying(neighbor_edge.origin_vert)]).len_sq(),
+                    .length_sq = double((input.points[std::to_underlying(edge.origin_vert)] - input.points[std::to_underlying(neighbor_edge.origin_vert)]).len_sq()),
                 });
             }
 
             // Sort the queue to have longer edges first.
             // One guy on stackoverflow says this is a decent metric.
-            std::ranges::sort(edge_queue, std::greater{}, &EdgeEntry::length_sq);
+            std::ranges::sort(edge_queue, std::greater{}, &EdgeQueueEntry::length_sq);
 
             auto GetEdgeCurvature = [&](VertexId va, VertexId vb, VertexId vc) -> int
             {
@@ -366,7 +393,7 @@ namespace Geom::EdgesToPolygons
                 return sign((b - a) /cross/ (c - b));
             };
 
-            for (const EdgeEntry &entry : edge_queue)
+            for (const EdgeQueueEntry &entry : edge_queue)
             {
                 Edge &edge = GetMutEdge(entry.edge_id);
                 Edge &neighbor_edge = GetMutEdge(edge.neighbor);
@@ -568,4 +595,296 @@ namespace Geom::EdgesToPolygons
         topo.CombineToConvexPolygons(tri_input, max_verts_per_polygon);
         topo.DumpPolygons(tri_input, output);
     }
+
+    // Same as `ConvertToPolygons()`, but keeps the memory between the calls. Use this when converting often, e.g. when remeshing the chunks on each edit.
+    // Keeps the topology, and the vertex and triangle arrays of the triangulation (CDT doesn't let us reuse the rest of it).
+    // `T` is the internal type for triangulation, see `ConvertToPolygons()`.
+    template <std::floating_point T>
+    class Workspace
+    {
+        decltype(CDT::Triangulation<T>::vertices) spare_vertices;
+        decltype(CDT::Triangulation<T>::triangles) spare_triangles;
+        Topology topology;
+
+      public:
+        Workspace() {}
+
+        // See `ConvertToPolygons()` for the parameters.
+        template <typename U, typename F>
+        void ConvertToPolygons(const TriangulationInput<U> &tri_input, int max_verts_per_polygon, F &&output)
+        {
+            CDT::Triangulation<T> tri;
+            tri.vertices = std::move(spare_vertices);
+            tri.vertices.clear();
+            tri.triangles = std::move(spare_triangles);
+            tri.triangles.clear();
+
+            Triangulate(tri_input, tri);
+            topology.Reset(tri);
+
+            spare_vertices = std::move(tri.vertices);
+            spare_triangles = std::move(tri.triangles);
+
+            topology.CombineToConvexPolygons(tri_input, max_verts_per_polygon);
+            topology.DumpPolygons(tri_input, output);
+        }
+    };
+
+    // Converts the edges to polygons like `ConvertToPolygons()`, but only redoes the parts of the shape that changed since the last call.
+    // The input is split into islands: groups of contours that don't touch and aren't nested in each other (by their bounding boxes).
+    // The islands can be triangulated separately, and we only triangulate the ones that are new (compared by content), reusing the rest.
+    // So after a small edit only the affected islands are triangulated, and only their polygons are reported as removed and re-added.
+    // `T` is the internal type for triangulation, see `ConvertToPolygons()`. `U` is the coordinate type of the input.
+    template <std::floating_point T, typename U>
+    class IncrementalConverter
+    {
+      public:
+        enum class IslandId : std::uint32_t {invalid = std::uint32_t(-1)};
+
+        struct Island
+        {
+            // The polygons, in the same format as the output of `ConvertToPolygons()`.
+            std::vector<vec2<U>> points;
+            std::vector<PointInfo> infos;
+        };
+
+      private:
+        using VertIndex = typename TriangulationInput<U>::VertIndex;
+
+        struct IslandData
+        {
+            Island island;
+            std::uint64_t hash = 0;
+            bool alive = false;
+            bool kept = false; // Temporary, used in `Update()`.
+        };
+
+        std::vector<IslandData> islands;
+        std::vector<IslandId> free_islands;
+        phmap::flat_hash_map<std::uint64_t, IslandId> islands_by_hash;
+
+        Workspace<T> workspace;
+
+        // Temporary state for `Update()`, stored here to reuse the memory.
+        std::vector<VertIndex> parents; // Union-find over the vertices.
+        std::vector<VertIndex> group_roots; // The root vertex of each group.
+        std::vector<rect2<U>> group_bounds;
+        std::vector<std::uint64_t> group_hashes;
+        std::vector<char/*bool*/> group_has_edges;
+        std::vector<std::uint32_t> group_order;
+        std::vector<VertIndex> local_indices;
+        TriangulationInput<U> group_input;
+
+        [[nodiscard]] VertIndex FindRoot(VertIndex v)
+        {
+            while (parents[v] != v)
+            {
+                parents[v] = parents[parents[v]];
+                v = parents[v];
+            }
+            return v;
+        }
+        // Returns false if already joined.
+        bool Join(VertIndex a, VertIndex b)
+        {
+            a = FindRoot(a);
+            b = FindRoot(b);
+            if (a == b)
+                return false;
+            parents[std::max(a, b)] = std::min(a, b);
+            return true;
+        }
+
+        [[nodiscard]] static std::uint64_t HashEdge(vec2<U> a, vec2<U> b)
+        {
+            // FNV-1a, then a final mix, since we add the edge hashes together.
+            std::uint64_t ret = 0xcbf29ce484222325;
+            for (const vec2<U> &point : {a, b})
+            {
+                const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&point);
+                for (std::size_t i = 0; i < sizeof(point); i++)
+                    ret = (ret ^ bytes[i]) * 0x100000001b3;
+            }
+            ret ^= ret >> 33;
+            ret *= 0xff51afd7ed558ccd;
+            ret ^= ret >> 33;
+            return ret;
+        }
+
+        // Fills `group_roots` and `group_bounds`, and makes `FindRoot()` return the same root for all vertices of a group.
+        void FindGroups(const TriangulationInput<U> &input)
+        {
+            parents.resize(input.points.size());
+            for (std::size_t i = 0; i < parents.size(); i++)
+                parents[i] = VertIndex(i);
+
+            // The contours are connected through the shared vertices.
+            for (const auto &edge : input.edges)
+                Join(edge.first, edge.second);
+
+            // Then join the groups with overlapping bounds, until there's nothing left to join, since the bounds grow when joining.
+            // Those can be nested in each other, and can't be triangulated separately.
+            bool changed = true;
+            while (changed)
+            {
+                changed = false;
+
+                group_roots.clear();
+                group_bounds.clear();
+                local_indices.assign(input.points.size(), VertIndex(-1)); // Root vertex -> group index.
+                for (std::size_t i = 0; i < input.points.size(); i++)
+                {
+                    VertIndex root = FindRoot(VertIndex(i));
+                    vec2<U> point = input.points[i];
+                    if (local_indices[root] == VertIndex(-1))
+                    {
+                        local_indices[root] = VertIndex(group_roots.size());
+                        group_roots.push_back(root);
+                        group_bounds.push_back(point.rect_to(point));
+                    }
+                    else
+                    {
+                        rect2<U> &bounds = group_bounds[local_indices[root]];
+                        bounds = min(bounds.a, point).rect_to(max(bounds.b, point));
+                    }
+                }
+
+                // Sweep along X.
+                group_order.resize(group_roots.size());
+                for (std::size_t i = 0; i < group_order.size(); i++)
+                    group_order[i] = std::uint32_t(i);
+                std::sort(group_order.begin(), group_order.end(), [&](std::uint32_t a, std::uint32_t b){return group_bounds[a].a.x < group_bounds[b].a.x;});
+                for (std::size_t i = 0; i < group_order.size(); i++)
+                {
+                    const rect2<U> &a = group_bounds[group_order[i]];
+                    for (std::size_t j = i + 1; j < group_order.size(); j++)
+                    {
+                        const rect2<U> &b = group_bounds[group_order[j]];
+                        if (b.a.x >= a.b.x)
+                            break;
+                        if (b.a.y < a.b.y && a.a.y < b.b.y && Join(group_roots[group_order[i]], group_roots[group_order[j]]))
+                            changed = true;
+                    }
+                }
+            }
+        }
+
+        // Triangulates the group with the specified root vertex into `island`.
+        void ConvertGroup(const TriangulationInput<U> &input, VertIndex root, int max_verts_per_polygon, Island &island)
+        {
+            group_input.points.clear();
+            group_input.point_convexity.clear();
+            group_input.edges.clear();
+
+            local_indices.assign(input.points.size(), VertIndex(-1));
+            for (std::size_t i = 0; i < input.points.size(); i++)
+            {
+                if (FindRoot(VertIndex(i)) != root)
+                    continue;
+                local_indices[i] = VertIndex(group_input.points.size());
+                group_input.points.push_back(input.points[i]);
+                group_input.point_convexity.push_back(input.point_convexity[i]);
+            }
+            for (const auto &edge : input.edges)
+            {
+                if (local_indices[edge.first] != VertIndex(-1))
+                    group_input.edges.push_back({local_indices[edge.first], local_indices[edge.second]});
+            }
+
+            island.points.clear();
+            island.infos.clear();
+            workspace.ConvertToPolygons(group_input, max_verts_per_polygon, [&](vec2<U> pos, PointInfo info)
+            {
+                island.points.push_back(pos);
+                island.infos.push_back(info);
+            });
+        }
+
+      public:
+        IncrementalConverter() {}
+
+        // Converts the new input. See `ConvertToPolygons()` for the parameters.
+        // `on_removed` and `on_added` are `(IslandId id, const Island &island) -> void`. The removed IDs can be reused by the added islands.
+        // Pass the complete input every time. The unchanged islands are found by content, so there's no need to specify what changed.
+        template <typename R, typename A>
+        void Update(const TriangulationInput<U> &input, int max_verts_per_polygon, R &&on_removed, A &&on_added)
+        {
+            FindGroups(input);
+
+            group_hashes.assign(group_roots.size(), std::uint64_t(max_verts_per_polygon));
+            group_has_edges.assign(group_roots.size(), false);
+            for (const auto &edge : input.edges)
+            {
+                // `local_indices` still maps the roots to the group indices.
+                VertIndex group = local_indices[FindRoot(edge.first)];
+                group_hashes[group] += HashEdge(input.points[edge.first], input.points[edge.second]);
+                group_has_edges[group] = true;
+            }
+
+            // Find the islands to keep.
+            for (std::size_t i = 0; i < group_hashes.size(); i++)
+            {
+                if (auto it = islands_by_hash.find(group_hashes[i]); it != islands_by_hash.end())
+                    islands[std::to_underlying(it->second)].kept = true;
+            }
+
+            // Remove the rest.
+            for (std::size_t i = 0; i < islands.size(); i++)
+            {
+                IslandData &data = islands[i];
+                if (!data.alive)
+                    continue;
+                if (data.kept)
+                {
+                    data.kept = false;
+                    continue;
+                }
+                on_removed(IslandId(i), std::as_const(data.island));
+                islands_by_hash.erase(data.hash);
+                data.alive = false;
+                free_islands.push_back(IslandId(i));
+            }
+
+            // Triangulate the new islands.
+            for (std::size_t i = 0; i < group_roots.size(); i++)
+            {
+                if (!group_has_edges[i] || islands_by_hash.contains(group_hashes[i]))
+                    continue;
+
+                IslandId id;
+                if (free_islands.empty())
+                {
+                    id = IslandId(islands.size());
+                    islands.emplace_back();
+                }
+                else
+                {
+                    id = free_islands.back();
+                    free_islands.pop_back();
+                }
+
+                IslandData &data = islands[std::to_underlying(id)];
+                ConvertGroup(input, group_roots[i], max_verts_per_polygon, data.island);
+                data.hash = group_hashes[i];
+                data.alive = true;
+                islands_by_hash.try_emplace(data.hash, id);
+                on_added(std::as_const(id), std::as_const(data.island));
+            }
+        }
+
+        // Calls `func` for every island. `func` is `(IslandId id, const Island &island) -> void`.
+        void ForEachIsland(auto &&func) const
+        {
+            for (std::size_t i = 0; i < islands.size(); i++)
+            {
+                if (islands[i].alive)
+                    func(IslandId(i), std::as_const(islands[i].island));
+            }
+        }
+
+        [[nodiscard]] std::size_t IslandCount() const
+        {
+            return islands.size() - free_islands.size();
+        }
+    };
 }
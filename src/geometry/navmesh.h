@@ -0,0 +1,428 @@
+#pragma once
+
+#include "geometry/common.h"
+#include "graph/pathfinding.h"
+#include "program/errors.h"
+#include "utils/aabb_tree.h"
+#include "utils/mat.h"
+
+#include <parallel_hashmap/phmap.h>
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+// A navigation mesh: convex walkable polygons, connected by portals (the shared parts of their edges).
+// Pathfinding runs on the polygons rather than on the tiles, which needs far fewer expansions,
+//   and then the polygon corridor is turned into a path using the funnel algorithm.
+
+/* How to use.
+
+Geom::EdgesToPolygons::TriangulationInput<int> tri_input;
+Geom::TilesToEdges::ConvertTilesToEdges(..., tri_input.InsertionCallback()); // With the walkable tiles being "solid".
+
+Geom::NavMesh<float> navmesh;
+// Pass 0 as the vertex limit, larger polygons mean less nodes to visit.
+Geom::EdgesToPolygons::ConvertToPolygons<float>(tri_input, 0, navmesh.InsertionCallback());
+navmesh.Finalize();
+
+std::vector<fvec2> path;
+if (navmesh.FindPath(start, goal, path))
+    ...
+
+*/
+
+namespace Geom
+{
+    // `T` is the coordinate type, must be floating-point.
+    template <std::floating_point T>
+    class NavMesh
+    {
+      public:
+        using vector = vec2<T>;
+        using rect = rect2<T>;
+
+        enum class PolygonId : std::uint32_t {invalid = std::uint32_t(-1)};
+
+        struct Portal
+        {
+            // The polygon on the other side.
+            PolygonId target = PolygonId::invalid;
+            // The portal ends, as seen when moving from this polygon to `target` in direction `dir`: `dir /cross/ (left - right) > 0`.
+            vector left, right;
+        };
+
+        struct Polygon
+        {
+            // Convex, the winding is normalized so that `(b - a) /cross/ (c - b) > 0` for any consecutive vertices.
+            std::vector<vector> points;
+            // The average of the vertices. Used as the node position when pathfinding.
+            vector center;
+            std::vector<Portal> portals;
+        };
+
+      private:
+        using Tree = AabbTree<vector>;
+        using Pathfinder = Graph::Pathfinding::Pathfinder<PolygonId, T>;
+
+        std::vector<Polygon> polygons;
+        // The leaf indices match the polygon indices.
+        Tree tree;
+        bool finalized = false;
+
+        // Those are reused between queries to preserve their capacity.
+        Pathfinder pathfinder;
+        std::vector<PolygonId> temp_corridor;
+        std::vector<Portal> temp_portals;
+
+        // Unlike `rect::touches()`, treats the touching rects as overlapping.
+        [[nodiscard]] static bool RectsOverlapOrTouch(const rect &a, const rect &b)
+        {
+            return (a.a <= b.b).all() && (b.a <= a.b).all();
+        }
+
+        // Returns the squared tolerance for the `(b - a) /cross/ (p - a)` checks, relative to the length of `b - a`.
+        [[nodiscard]] static T CrossTolerance(vector a, vector b)
+        {
+            return (b - a).len_sq() * std::numeric_limits<T>::epsilon() * 16;
+        }
+
+        // The node position of `id` for pathfinding. The start and goal polygons use the start and goal points instead of the centers.
+        [[nodiscard]] vector NodePos(PolygonId id, PolygonId start_id, vector start, PolygonId goal_id, vector goal) const
+        {
+            if (id == start_id)
+                return start;
+            if (id == goal_id)
+                return goal;
+            return GetPolygon(id).center;
+        }
+
+      public:
+        // Creates an empty navmesh. Add the polygons and call `Finalize()`.
+        NavMesh() {}
+
+        // Removes all polygons.
+        void Reset()
+        {
+            polygons.clear();
+            tree = {};
+            finalized = false;
+        }
+
+        // Adds a convex polygon, with any winding. Call `Finalize()` after adding all of them.
+        void AddPolygon(std::span<const vector> points)
+        {
+            ASSERT(points.size() >= 3, "A degenerate navmesh polygon.");
+            Polygon &polygon = polygons.emplace_back();
+            polygon.points.assign(points.begin(), points.end());
+            finalized = false;
+        }
+
+        // Returns a callback to add polygons, compatible with the output of `EdgesToPolygons::ConvertToPolygons()`.
+        // The returned callback is `(vec2<U> pos, PointInfo info) -> void`, where the first point of each loop is repeated at the end with `info.type == last`.
+        // NOTE: The callback is stateful, keep it alive for all insertion operations.
+        [[nodiscard]] auto InsertionCallback()
+        {
+            return [this, points = std::vector<vector>{}](auto pos, PointInfo info) mutable
+            {
+                if (info.type == PointType::last)
+                {
+                    AddPolygon(points);
+                    points.clear();
+                }
+                else
+                {
+                    points.push_back(vector(pos));
+                }
+            };
+        }
+
+        // Connects the polygons with portals, and builds the acceleration structure for `FindPolygon()`.
+        // The polygons are connected if they share a part of an edge. Their vertices don't have to match,
+        //   e.g. a polygon edge can be shared by several smaller polygons on the other side.
+        void Finalize()
+        {
+            std::vector<rect> aabbs;
+            aabbs.reserve(polygons.size());
+
+            for (Polygon &polygon : polygons)
+            {
+                T area = 0;
+                for (std::size_t i = 0; i < polygon.points.size(); i++)
+                    area += polygon.points[i] /cross/ polygon.points[(i + 1) % polygon.points.size()];
+                if (area < 0)
+                    std::reverse(polygon.points.begin(), polygon.points.end());
+
+                vector sum{}, min = polygon.points.front(), max = polygon.points.front();
+                for (vector point : polygon.points)
+                {
+                    sum += point;
+                    min = Math::min(min, point);
+                    max = Math::max(max, point);
+                }
+                polygon.center = sum / T(polygon.points.size());
+                polygon.portals.clear();
+                aabbs.push_back(min.rect_to(max));
+            }
+
+            tree = Tree(typename Tree::Params(vector()), aabbs);
+
+            // Split the edges at the vertices of other polygons lying on them, then match the resulting pieces by their ends.
+            phmap::flat_hash_map<vector, std::uint32_t> vertex_ids;
+            std::vector<vector> vertices;
+            auto VertexId = [&](vector pos)
+            {
+                auto [iter, is_new] = vertex_ids.try_emplace(pos, std::uint32_t(vertices.size()));
+                if (is_new)
+                    vertices.push_back(pos);
+                return iter->second;
+            };
+
+            struct Piece
+            {
+                std::uint32_t a = 0, b = 0;
+                std::uint32_t edge = 0; // The index of the original edge in the polygon.
+            };
+            std::vector<std::vector<Piece>> pieces(polygons.size());
+            phmap::flat_hash_map<std::pair<std::uint32_t, std::uint32_t>, PolygonId> piece_owners;
+
+            std::vector<std::pair<T, std::uint32_t>> splits;
+            for (std::size_t i = 0; i < polygons.size(); i++)
+            {
+                const Polygon &polygon = polygons[i];
+                for (std::size_t j = 0; j < polygon.points.size(); j++)
+                {
+                    vector a = polygon.points[j];
+                    vector b = polygon.points[(j + 1) % polygon.points.size()];
+                    vector delta = b - a;
+                    T len_sq = delta.len_sq();
+                    T tolerance = CrossTolerance(a, b);
+
+                    splits.clear();
+                    rect edge_rect = Math::min(a, b).rect_to(Math::max(a, b));
+                    tree.CollideCustom([&](const rect &aabb){return RectsOverlapOrTouch(aabb, edge_rect);}, [&](typename Tree::NodeIndex node)
+                    {
+                        if (std::size_t(node) == i)
+                            return false;
+                        for (vector point : polygons[std::size_t(node)].points)
+                        {
+                            T t = delta /dot/ (point - a);
+                            if (t <= 0 || t >= len_sq || std::abs(delta /cross/ (point - a)) > tolerance)
+                                continue;
+                            splits.emplace_back(t, VertexId(point));
+                        }
+                        return false;
+                    });
+                    std::sort(splits.begin(), splits.end());
+
+                    std::uint32_t prev = VertexId(a);
+                    auto AddPiece = [&](std::uint32_t next)
+                    {
+                        if (next == prev)
+                            return; // A duplicate split point.
+                        pieces[i].push_back({.a = prev, .b = next, .edge = std::uint32_t(j)});
+                        piece_owners.try_emplace(std::pair(prev, next), PolygonId(i));
+                        prev = next;
+                    };
+                    for (const auto &split : splits)
+                        AddPiece(split.second);
+                    AddPiece(VertexId(b));
+                }
+            }
+
+            // Merge the consecutive pieces of the same edge that lead into the same polygon.
+            for (std::size_t i = 0; i < polygons.size(); i++)
+            {
+                Polygon &polygon = polygons[i];
+                std::uint32_t prev_edge = std::uint32_t(-1);
+                for (const Piece &piece : pieces[i])
+                {
+                    auto iter = piece_owners.find(std::pair(piece.b, piece.a));
+                    if (iter == piece_owners.end())
+                    {
+                        prev_edge = std::uint32_t(-1);
+                        continue;
+                    }
+
+                    // Moving out of a positively wound polygon, its vertex order goes from right to left.
+                    if (piece.edge == prev_edge && polygon.portals.back().target == iter->second)
+                        polygon.portals.back().left = vertices[piece.b];
+                    else
+                        polygon.portals.push_back({.target = iter->second, .left = vertices[piece.b], .right = vertices[piece.a]});
+                    prev_edge = piece.edge;
+                }
+            }
+
+            finalized = true;
+        }
+
+        // Returns the polygon containing `point`, or `PolygonId::invalid` if none.
+        // If the point is on the border of several polygons, returns any of them.
+        [[nodiscard]] PolygonId FindPolygon(vector point) const
+        {
+            ASSERT(finalized, "Must call `Finalize()` on the navmesh first.");
+
+            PolygonId ret = PolygonId::invalid;
+            tree.CollideCustom([&](const rect &aabb){return RectsOverlapOrTouch(aabb, point.rect_to(point));}, [&](typename Tree::NodeIndex node)
+            {
+                const std::vector<vector> &points = polygons[std::size_t(node)].points;
+                for (std::size_t i = 0; i < points.size(); i++)
+                {
+                    vector a = points[i];
+                    vector b = points[(i + 1) % points.size()];
+                    if ((b - a) /cross/ (point - a) < -CrossTolerance(a, b))
+                        return false;
+                }
+                ret = PolygonId(node);
+                return true;
+            });
+            return ret;
+        }
+
+        // Calls `func` for every neighbor of `id`. This matches the `neighbors` parameter of `Pathfinder::Step()`.
+        // `func` is `(PolygonId neighbor, T cost) -> void`, where the cost is the distance between the centers, going through the middle of the portal.
+        void ForEachNeighbor(PolygonId id, auto &&func) const
+        {
+            const Polygon &polygon = GetPolygon(id);
+            for (const Portal &portal : polygon.portals)
+            {
+                vector middle = (portal.left + portal.right) / 2;
+                func(portal.target, (middle - polygon.center).len() + (GetPolygon(portal.target).center - middle).len());
+            }
+        }
+
+        // Finds the polygons that the path from `start` to `goal` goes through, in order, including the ones containing `start` and `goal`.
+        // Returns false if there's no path, or if either point is outside of the navmesh, then `corridor` is empty.
+        bool FindCorridor(vector start, vector goal, std::vector<PolygonId> &corridor)
+        {
+            corridor.clear();
+
+            PolygonId start_id = FindPolygon(start);
+            PolygonId goal_id = FindPolygon(goal);
+            if (start_id == PolygonId::invalid || goal_id == PolygonId::invalid)
+                return false;
+
+            // The path is dumped backwards, so search from the goal.
+            pathfinder.SetNewTask(goal_id);
+            while (pathfinder.HasUnvisitedNodes())
+            {
+                if (pathfinder.CurrentNode() == start_id)
+                {
+                    pathfinder.DumpPathBackwards(start_id, [&](PolygonId id){corridor.push_back(id);});
+                    return true;
+                }
+
+                pathfinder.Step(
+                    [&](PolygonId id, auto step)
+                    {
+                        vector pos = NodePos(id, start_id, start, goal_id, goal);
+                        for (const Portal &portal : GetPolygon(id).portals)
+                        {
+                            vector middle = (portal.left + portal.right) / 2;
+                            step(portal.target, (middle - pos).len() + (NodePos(portal.target, start_id, start, goal_id, goal) - middle).len());
+                        }
+                    },
+                    [&](T cost, PolygonId id)
+                    {
+                        return cost + (NodePos(id, start_id, start, goal_id, goal) - start).len();
+                    }
+                );
+            }
+            return false;
+        }
+
+        // Turns a corridor from `FindCorridor()` into the shortest path through it, using the funnel algorithm ("simple stupid funnel").
+        // Writes the points to `path`, from `start` to `goal` inclusive. The intermediate points are the portal ends that the path bends around.
+        void SmoothPath(vector start, vector goal, std::span<const PolygonId> corridor, std::vector<vector> &path)
+        {
+            path.clear();
+
+            temp_portals.clear();
+            temp_portals.push_back({.left = start, .right = start});
+            for (std::size_t i = 0; i + 1 < corridor.size(); i++)
+            {
+                const Polygon &polygon = GetPolygon(corridor[i]);
+                auto iter = std::find_if(polygon.portals.begin(), polygon.portals.end(), [&](const Portal &portal){return portal.target == corridor[i + 1];});
+                ASSERT(iter != polygon.portals.end(), "The navmesh polygons in the corridor are not adjacent.");
+                temp_portals.push_back(*iter);
+            }
+            temp_portals.push_back({.left = goal, .right = goal});
+
+            // Positive if `c` is on the left of `a -> b`.
+            auto Area = [](vector a, vector b, vector c){return (b - a) /cross/ (c - a);};
+
+            path.push_back(start);
+            vector apex = start, left = start, right = start;
+            std::size_t left_index = 0, right_index = 0;
+
+            for (std::size_t i = 1; i < temp_portals.size(); i++)
+            {
+                const Portal &portal = temp_portals[i];
+
+                // Try to narrow the funnel from the right.
+                if (Area(apex, right, portal.right) >= 0)
+                {
+                    if (apex == right || Area(apex, left, portal.right) < 0)
+                    {
+                        right = portal.right;
+                        right_index = i;
+                    }
+                    else
+                    {
+                        // The right side crossed the left one, so the path bends around the left point. Restart from there.
+                        path.push_back(left);
+                        apex = right = left;
+                        i = right_index = left_index;
+                        continue;
+                    }
+                }
+
+                // Try to narrow the funnel from the left.
+                if (Area(apex, left, portal.left) <= 0)
+                {
+                    if (apex == left || Area(apex, right, portal.left) > 0)
+                    {
+                        left = portal.left;
+                        left_index = i;
+                    }
+                    else
+                    {
+                        // Same, but the other way around.
+                        path.push_back(right);
+                        apex = left = right;
+                        i = left_index = right_index;
+                        continue;
+                    }
+                }
+            }
+
+            if (path.back() != goal)
+                path.push_back(goal);
+        }
+
+        // Finds a path from `start` to `goal`, see `FindCorridor()` and `SmoothPath()`.
+        // Returns false if there's no path, then `path` is empty.
+        bool FindPath(vector start, vector goal, std::vector<vector> &path)
+        {
+            path.clear();
+            if (!FindCorridor(start, goal, temp_corridor))
+                return false;
+            SmoothPath(start, goal, temp_corridor, path);
+            return true;
+        }
+
+        // Various getters:
+
+        [[nodiscard]] std::size_t PolygonCount() const {return polygons.size();}
+        [[nodiscard]] const Polygon &GetPolygon(PolygonId id) const
+        {
+            ASSERT(std::to_underlying(id) < polygons.size(), "Navmesh polygon index is out of range.");
+            return polygons[std::to_underlying(id)];
+        }
+        [[nodiscard]] const Tree &GetTree() const {return tree;}
+    };
+}
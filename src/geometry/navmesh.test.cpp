@@ -0,0 +1,56 @@
+#include "navmesh.h"
+
+#include <vector>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    using NavMesh = Geom::NavMesh<float>;
+
+    void AddRect(NavMesh &navmesh, fvec2 a, fvec2 b)
+    {
+        std::vector<fvec2> points = {a, fvec2(b.x, a.y), b, fvec2(a.x, b.y)};
+        navmesh.AddPolygon(points);
+    }
+}
+
+TEST_CASE("geometry.navmesh")
+{
+    NavMesh navmesh;
+
+    // An L-shaped corridor. The top edge of the first rect is shared with a part of the bottom edge of the second one.
+    AddRect(navmesh, fvec2(0, 0), fvec2(10, 2));
+    AddRect(navmesh, fvec2(8, 2), fvec2(10, 10));
+    // A separate room.
+    AddRect(navmesh, fvec2(20, 0), fvec2(30, 10));
+    navmesh.Finalize();
+
+    CHECK(navmesh.FindPolygon(fvec2(1, 1)) == NavMesh::PolygonId(0));
+    CHECK(navmesh.FindPolygon(fvec2(9, 5)) == NavMesh::PolygonId(1));
+    CHECK(navmesh.FindPolygon(fvec2(5, 5)) == NavMesh::PolygonId::invalid);
+
+    REQUIRE(navmesh.GetPolygon(NavMesh::PolygonId(0)).portals.size() == 1);
+    NavMesh::Portal portal = navmesh.GetPolygon(NavMesh::PolygonId(0)).portals.front();
+    CHECK(portal.target == NavMesh::PolygonId(1));
+    // Moving up from the first rect, the smaller x is on the left.
+    CHECK(portal.left == fvec2(8, 2));
+    CHECK(portal.right == fvec2(10, 2));
+    CHECK(navmesh.GetPolygon(NavMesh::PolygonId(2)).portals.empty());
+
+    std::vector<fvec2> path;
+
+    // The path bends around the inner corner.
+    REQUIRE(navmesh.FindPath(fvec2(1, 1), fvec2(9, 9), path));
+    CHECK(path == std::vector{fvec2(1, 1), fvec2(8, 2), fvec2(9, 9)});
+    REQUIRE(navmesh.FindPath(fvec2(9, 9), fvec2(1, 1), path));
+    CHECK(path == std::vector{fvec2(9, 9), fvec2(8, 2), fvec2(1, 1)});
+
+    // A straight line through the portal.
+    REQUIRE(navmesh.FindPath(fvec2(9, 1), fvec2(9, 9), path));
+    CHECK(path == std::vector{fvec2(9, 1), fvec2(9, 9)});
+
+    // No path to the separate room.
+    CHECK(!navmesh.FindPath(fvec2(1, 1), fvec2(25, 5), path));
+    CHECK(path.empty());
+}
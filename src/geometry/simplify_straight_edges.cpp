@@ -3,6 +3,7 @@
 #include <doctest/doctest.h>
 
 #include <sstream>
+#include <vector>
 
 TEST_CASE("geometry.simplify_straight_edges")
 {
@@ -73,3 +74,34 @@ TEST_CASE("geometry.simplify_straight_edges")
 [6,2]10
 )");
 }
+
+TEST_CASE("geometry.simplify_straight_edges.loop")
+{
+    std::vector<ivec2> output;
+    std::vector<char> convexity;
+
+    // Starts in the middle of an edge, and has a concave corner.
+    std::vector<ivec2> loop = {ivec2(1,0), ivec2(2,0), ivec2(2,2), ivec2(1,2), ivec2(1,1), ivec2(0,1), ivec2(0,0)};
+    Geom::SimplifyStraightEdgesInLoop<int>(loop, true, output, &convexity);
+    REQUIRE(output == std::vector{ivec2(2,0), ivec2(2,2), ivec2(1,2), ivec2(1,1), ivec2(0,1), ivec2(0,0)});
+    REQUIRE(convexity == std::vector<char>{1, 1, 1, 0, 1, 1});
+
+    output.clear();
+    std::vector<ivec2> chain = {ivec2(4,0), ivec2(5,0), ivec2(6,0), ivec2(6,1), ivec2(6,2)};
+    Geom::SimplifyStraightEdgesInLoop<int>(chain, false, output);
+    REQUIRE(output == std::vector{ivec2(4,0), ivec2(6,0), ivec2(6,2)});
+
+    // Longer than one block.
+    output.clear();
+    std::vector<ivec2> square;
+    for (int i = 0; i < 1000; i++)
+        square.push_back(ivec2(i, 0));
+    for (int i = 0; i < 1000; i++)
+        square.push_back(ivec2(1000, i));
+    for (int i = 0; i < 1000; i++)
+        square.push_back(ivec2(1000 - i, 1000));
+    for (int i = 0; i < 1000; i++)
+        square.push_back(ivec2(0, 1000 - i));
+    Geom::SimplifyStraightEdgesInLoop<int>(square, true, output);
+    REQUIRE(output == std::vector{ivec2(0,0), ivec2(1000,0), ivec2(1000,1000), ivec2(0,1000)});
+}
@@ -3,6 +3,11 @@
 #include "geometry/common.h"
 #include "utils/mat.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <vector>
+
 namespace Geom
 {
     // Given a `TilesToEdges`-compatible functor, returns a similar functor that skips redundant points,
@@ -109,4 +114,77 @@ namespace Geom
             }
         };
     }
+
+    namespace impl
+    {
+        // For each `i` in `0..count-1`, writes the turn at `points[i+1]` to `out[i]`: `(points[i+1] - points[i]) /cross/ (points[i+2] - points[i+1])`.
+        // This is a plain loop over the components, so the compiler vectorizes it.
+        template <typename T, typename C>
+        void ComputeTurns(const vec2<T> *points, std::size_t count, C *out)
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                C ax = points[i].x,     ay = points[i].y;
+                C bx = points[i + 1].x, by = points[i + 1].y;
+                C cx = points[i + 2].x, cy = points[i + 2].y;
+                out[i] = (bx - ax) * (cy - by) - (by - ay) * (cx - bx);
+            }
+        }
+    }
+
+    // Same as `SimplifyStraightEdges()` above, but processes a whole loop at once, which is faster for long loops.
+    // If `closed`, `points` is a closed loop, without repeating the first point at the end. Otherwise it's an open chain,
+    //   and its first and last points are always kept.
+    // Appends the remaining points to `output`, in the same order. Unlike `SimplifyStraightEdges()`, the closed loops start from
+    //   the first non-redundant point, and the first point isn't repeated at the end. If all points are on a line, nothing is appended.
+    // If `convexity` is specified, appends true for each convex point (the ends of open chains count as convex).
+    template <typename T>
+    void SimplifyStraightEdgesInLoop(std::span<const vec2<T>> points, bool closed, std::vector<vec2<T>> &output, std::vector<char/*bool*/> *convexity = nullptr)
+    {
+        using C = decltype(vec2<T>{} /cross/ vec2<T>{});
+
+        auto Emit = [&](vec2<T> point, bool convex)
+        {
+            output.push_back(point);
+            if (convexity)
+                convexity->push_back(convex);
+        };
+        auto EmitIfCorner = [&](vec2<T> point, C turn)
+        {
+            if (turn)
+                Emit(point, turn > 0);
+        };
+
+        const std::size_t n = points.size();
+        if (n < 3)
+        {
+            if (!closed)
+            {
+                for (vec2<T> point : points)
+                    Emit(point, true);
+            }
+            return;
+        }
+
+        if (closed)
+            EmitIfCorner(points[0], (points[0] - points[n - 1]) /cross/ (points[1] - points[0]));
+        else
+            Emit(points[0], true);
+
+        // The points `1..n-2`, in blocks.
+        constexpr std::size_t block_size = 256;
+        C turns[block_size];
+        for (std::size_t begin = 0; begin < n - 2; begin += block_size)
+        {
+            std::size_t count = std::min(block_size, n - 2 - begin);
+            impl::ComputeTurns(points.data() + begin, count, turns);
+            for (std::size_t i = 0; i < count; i++)
+                EmitIfCorner(points[begin + i + 1], turns[i]);
+        }
+
+        if (closed)
+            EmitIfCorner(points[n - 1], (points[n - 1] - points[n - 2]) /cross/ (points[0] - points[n - 1]));
+        else
+            Emit(points[n - 1], true);
+    }
 }
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "geometry/tiles_to_edges.h"
+#include "program/errors.h"
+#include "utils/mat.h"
+#include "utils/multiarray.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <utility>
+
+// Sweeps AABBs directly against a tile map, using the tile shapes from `TilesToEdges::BakedTileset`.
+// This is an alternative to converting the map to edges and feeding them to a physics engine, when you only need to move boxes around.
+// The tiles near the path of the box are visited in order using a DDA traversal, so the cost depends on the length of the sweep, not on the map size.
+// The edges are one-sided: only the edges facing the box are solid, so a box that starts inside of a tile can leave it freely.
+// The edges between two solid tiles are skipped, so the boxes don't snag on the seams.
+// How to use:
+//     Array2D<int> map = ...; // Tile indices in `tileset`.
+//     fvec2 offset = Geom::TileCollision::SlideBox(tileset, map, box, velocity * dt);
+//     box += offset;
+
+namespace Geom::TileCollision
+{
+    struct Params
+    {
+        // If the box already penetrates an edge by this distance or less, it still collides with it (at `time == 0`).
+        // This makes the sweeps robust against rounding errors, when the box was moved exactly to the contact point.
+        float penetration_tolerance = 1 / 64.f;
+    };
+
+    struct Hit
+    {
+        // The fraction of the offset at which the box touches the tile, `0..1`.
+        float time = 1;
+        // The contact normal, pointing from the tile towards the box. Has length 1.
+        fvec2 normal;
+        // The tile position.
+        ivec2 tile;
+    };
+
+    namespace impl
+    {
+        // Sweeps `box` by `offset` against the edge `a -> b` of a tile, with the outward normal `normal` (not necessarily normalized).
+        // Updates `hit` if the contact happens earlier than `hit.time`, and returns true in that case.
+        [[nodiscard]] inline bool SweepBoxAgainstEdge(frect2 box, fvec2 offset, fvec2 a, fvec2 b, fvec2 normal, const Params &params, Hit &hit)
+        {
+            // The separating axis test, with the axes being X, Y, and the edge normal.
+            float t_enter = -std::numeric_limits<float>::infinity();
+            float t_exit = std::numeric_limits<float>::infinity();
+            fvec2 hit_normal;
+
+            // `lo` and `hi` are the box projection, `edge_lo` and `edge_hi` are the edge projection, `vel` is the box velocity along the axis.
+            // `axis` must be normalized. Returns false if the box never overlaps the edge on this axis.
+            auto Axis = [&](fvec2 axis, float lo, float hi, float edge_lo, float edge_hi, float vel)
+            {
+                if (vel == 0)
+                    return hi > edge_lo && lo < edge_hi;
+
+                float t0 = (edge_lo - hi) / vel;
+                float t1 = (edge_hi - lo) / vel;
+                if (t0 > t1)
+                    std::swap(t0, t1);
+
+                if (t0 > t_enter)
+                {
+                    t_enter = t0;
+                    hit_normal = vel > 0 ? -axis : axis;
+                }
+                t_exit = std::min(t_exit, t1);
+                return true;
+            };
+
+            if (!Axis(fvec2(1, 0), box.a.x, box.b.x, std::min(a.x, b.x), std::max(a.x, b.x), offset.x))
+                return false;
+            if (!Axis(fvec2(0, 1), box.a.y, box.b.y, std::min(a.y, b.y), std::max(a.y, b.y), offset.y))
+                return false;
+
+            fvec2 n = normal.norm();
+            fvec2 center = box.center();
+            float radius = (box.size() / 2 * abs(n)).sum();
+            float edge_pos = a /dot/ n;
+            if (!Axis(n, center /dot/ n - radius, center /dot/ n + radius, edge_pos, edge_pos, offset /dot/ n))
+                return false;
+
+            if (t_enter >= t_exit || t_enter >= hit.time)
+                return false;
+
+            if (t_enter < 0)
+            {
+                // Already overlapping. Only collide if the penetration is small, and the box is moving deeper.
+                if (-t_enter * std::abs(offset /dot/ hit_normal) > params.penetration_tolerance || offset /dot/ hit_normal >= 0)
+                    return false;
+                t_enter = 0;
+            }
+
+            hit.time = t_enter;
+            hit.normal = hit_normal;
+            return true;
+        }
+
+        // Sweeps `box` against all solid edges of the tile at `tile_pos`.
+        [[nodiscard]] bool SweepBoxAgainstTile(const TilesToEdges::BakedTileset &tileset, irect2 map_bounds, auto &&input, ivec2 tile_pos, frect2 box, fvec2 offset, const Params &params, Hit &hit)
+        {
+            using TileId = TilesToEdges::BakedTileset::TileId;
+            using EdgeId = TilesToEdges::BakedTileset::EdgeId;
+
+            auto ReadTile = [&](ivec2 pos)
+            {
+                return map_bounds.contains(pos) ? TileId(input(std::as_const(pos))) : TileId(0);
+            };
+
+            TileId tile = ReadTile(tile_pos);
+            if (std::to_underlying(tile) >= tileset.NumTileTypes())
+                return false;
+
+            fvec2 tile_offset(tile_pos * tileset.tile_size);
+            bool ret = false;
+
+            for (EdgeId starting_edge : tileset.GetTileStartingEdges(tile))
+            {
+                tileset.ForEveryEdgeInEdgeLoop(tile, starting_edge, [&](EdgeId edge)
+                {
+                    const auto &info = tileset.GetEdgeInfo(edge);
+
+                    // Skip the edges that are covered by the adjacent tiles (or by the same tile).
+                    if (info.opposite_edge != EdgeId::invalid)
+                    {
+                        TileId other_tile = info.opposite_edge_dir ? ReadTile(tile_pos + info.opposite_edge_dir) : tile;
+                        if (std::to_underlying(other_tile) < tileset.NumTileTypes() && tileset.TileHasEdge(other_tile, info.opposite_edge))
+                            return false;
+                    }
+
+                    fvec2 a = tile_offset + fvec2(tileset.GetVertexPos(info.vert_a));
+                    fvec2 b = tile_offset + fvec2(tileset.GetVertexPos(info.vert_b));
+                    // The loops are clockwise if Y points downwards, so the normal points to the left of the edge direction (when Y points up).
+                    fvec2 normal((b - a).y, -(b - a).x);
+                    if (normal /dot/ offset >= 0)
+                        return false; // Moving away from the edge, or along it.
+
+                    if (SweepBoxAgainstEdge(box, offset, a, b, normal, params, hit))
+                    {
+                        hit.tile = tile_pos;
+                        ret = true;
+                    }
+                    return false;
+                });
+            }
+
+            return ret;
+        }
+    }
+
+    // Sweeps `box` (in pixels, the tile `(0,0)` starts at the origin) by `offset`, against the solid tiles.
+    // `map_bounds` are the tile bounds, the tiles outside of them are not read, and are considered to be empty (tile 0).
+    // `input` is `(ivec2 pos) -> SomeIntegralType`, the same as in `TilesToEdges::ConvertTilesToEdges()`. Tile indices out of the tileset range are also considered empty.
+    // Returns the first contact, or null if the box can move by the whole `offset`.
+    [[nodiscard]] std::optional<Hit> SweepBox(const TilesToEdges::BakedTileset &tileset, irect2 map_bounds, auto &&input, frect2 box, fvec2 offset, const Params &params = {})
+    {
+        if (!offset)
+            return {};
+
+        fvec2 tile_size(tileset.tile_size);
+        fvec2 half_extent = box.size() / 2;
+        // How many tiles around the center tile can the box overlap.
+        ivec2 reach(ceil(half_extent / tile_size));
+
+        // The DDA traversal of the box center, in tiles.
+        fvec2 start = box.center() / tile_size;
+        fvec2 dir = offset / tile_size;
+        ivec2 cell(floor(start));
+        ivec2 step(sign(dir));
+        fvec2 t_delta, t_max;
+        for (int i = 0; i < 2; i++)
+        {
+            if (step[i] == 0)
+            {
+                t_delta[i] = t_max[i] = std::numeric_limits<float>::infinity();
+                continue;
+            }
+            t_delta[i] = std::abs(1 / dir[i]);
+            t_max[i] = (step[i] > 0 ? cell[i] + 1 - start[i] : start[i] - cell[i]) * t_delta[i];
+        }
+
+        Hit hit;
+        bool found = false;
+        // The tiles checked on the previous step. The rects move monotonically, so we only need to check the tiles outside of the previous one.
+        irect2 prev_rect;
+        float t_cell = 0; // When the center enters the current cell.
+
+        // When the box collides with a tile, its center is in the current cell, and the tile is in `cell +- reach`.
+        // So once we enter a cell after the best hit so far, we can stop.
+        while (t_cell <= 1 && t_cell <= hit.time)
+        {
+            irect2 rect = (cell - reach).rect_to(cell + reach + 1).intersect(map_bounds);
+            for (ivec2 pos : rect.a <= vector_range < rect.b)
+            {
+                if (prev_rect.contains(pos))
+                    continue;
+                if (impl::SweepBoxAgainstTile(tileset, map_bounds, input, pos, box, offset, params, hit))
+                    found = true;
+            }
+            prev_rect = rect;
+
+            int axis = t_max.x < t_max.y ? 0 : 1;
+            t_cell = t_max[axis];
+            t_max[axis] += t_delta[axis];
+            cell[axis] += step[axis];
+        }
+
+        if (!found)
+            return {};
+        return hit;
+    }
+
+    // Same, but reads the tiles from `map`.
+    [[nodiscard]] inline std::optional<Hit> SweepBox(const TilesToEdges::BakedTileset &tileset, const MultiArray<2, int> &map, frect2 box, fvec2 offset, const Params &params = {})
+    {
+        return SweepBox(tileset, ivec2().rect_size(ivec2(map.size())), [&](ivec2 pos){return map.at(xvec2(pos));}, box, offset, params);
+    }
+
+    // Moves `box` by `offset` as far as possible, sliding along the tiles it hits.
+    // Returns the actual offset. `max_iterations` limits the number of contacts processed.
+    [[nodiscard]] fvec2 SlideBox(const TilesToEdges::BakedTileset &tileset, irect2 map_bounds, auto &&input, frect2 box, fvec2 offset, int max_iterations = 4, const Params &params = {})
+    {
+        fvec2 ret;
+        for (int i = 0; i < max_iterations && offset; i++)
+        {
+            std::optional<Hit> hit = SweepBox(tileset, map_bounds, input, box, offset, params);
+            if (!hit)
+            {
+                ret += offset;
+                return ret;
+            }
+
+            fvec2 step = offset * hit->time;
+            ret += step;
+            box += step;
+            offset -= step;
+            // Remove the component going into the tile.
+            offset -= hit->normal * (offset /dot/ hit->normal);
+        }
+        return ret;
+    }
+
+    // Same, but reads the tiles from `map`.
+    [[nodiscard]] inline fvec2 SlideBox(const TilesToEdges::BakedTileset &tileset, const MultiArray<2, int> &map, frect2 box, fvec2 offset, int max_iterations = 4, const Params &params = {})
+    {
+        return SlideBox(tileset, ivec2().rect_size(ivec2(map.size())), [&](ivec2 pos){return map.at(xvec2(pos));}, box, offset, max_iterations, params);
+    }
+}
@@ -0,0 +1,89 @@
+#include "tile_collision.h"
+
+#include <random>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    using namespace Geom::TileCollision;
+    using Geom::TilesToEdges::BakedTileset;
+
+    // Tile 0 is empty, tile 1 is a full square.
+    [[nodiscard]] BakedTileset MakeTileset()
+    {
+        Geom::TilesToEdges::Tileset tileset;
+        tileset.tile_size = ivec2(16);
+        tileset.vertices = {ivec2(0, 0), ivec2(16, 0), ivec2(16, 16), ivec2(0, 16)};
+        tileset.tiles = {{}, {{0, 1, 2, 3}}};
+        return BakedTileset(std::move(tileset));
+    }
+}
+
+TEST_CASE("geometry.tile_collision")
+{
+    const BakedTileset tileset = MakeTileset();
+
+    // A floor at `y == 8`, and a wall at `x == 7` above it.
+    Array2D<int> map(xvec2(10));
+    for (int i = 0; i < 10; i++)
+        map.at(xvec2(i, 8)) = 1;
+    for (int i = 0; i < 8; i++)
+        map.at(xvec2(7, i)) = 1;
+
+    // Falling onto the floor.
+    std::optional<Hit> hit = SweepBox(tileset, map, fvec2(36).rect_to(fvec2(44)), fvec2(0, 200));
+    REQUIRE(hit);
+    CHECK(hit->time == (128 - 44) / 200.f);
+    CHECK(hit->normal == fvec2(0, -1));
+    CHECK(hit->tile.y == 8);
+
+    // A large box, overlapping several tiles.
+    hit = SweepBox(tileset, map, fvec2(0).rect_to(fvec2(40)), fvec2(0, 100));
+    REQUIRE(hit);
+    CHECK(hit->time == (128 - 40) / 100.f);
+
+    // Moving along the floor doesn't snag on the seams between the tiles.
+    CHECK(!SweepBox(tileset, map, fvec2(36, 120).rect_to(fvec2(44, 128)), fvec2(50, 0)));
+    hit = SweepBox(tileset, map, fvec2(36, 120).rect_to(fvec2(44, 128)), fvec2(100, 0));
+    REQUIRE(hit);
+    CHECK(hit->time == (112 - 44) / 100.f);
+    CHECK(hit->normal == fvec2(-1, 0));
+    CHECK(hit->tile == ivec2(7, 7));
+
+    // The edges are one-sided, so we can leave a tile.
+    CHECK(!SweepBox(tileset, map, fvec2(116).rect_to(fvec2(124)), fvec2(-50, 0)));
+
+    // Sliding along the floor into the wall.
+    fvec2 offset = SlideBox(tileset, ivec2().rect_size(10), [&](ivec2 pos){return map.at(xvec2(pos));}, fvec2(36, 100).rect_to(fvec2(44, 108)), fvec2(200, 100));
+    CHECK((offset - fvec2(68, 20)).len() < 0.01f);
+
+    // Compare with checking all tiles on a random map.
+    std::mt19937 gen(42);
+    Array2D<int> random_map(xvec2(20));
+    for (ivec2 pos : vector_range(ivec2(20)))
+        random_map.at(xvec2(pos)) = std::bernoulli_distribution(0.2)(gen);
+    auto input = [&](ivec2 pos){return random_map.at(xvec2(pos));};
+    irect2 bounds = ivec2().rect_size(20);
+
+    std::uniform_real_distribution<float> pos_dist(-16, 336), size_dist(1, 40), offset_dist(-150, 150);
+    for (int i = 0; i < 500; i++)
+    {
+        fvec2 a(pos_dist(gen), pos_dist(gen));
+        frect2 box = a.rect_size(fvec2(size_dist(gen), size_dist(gen)));
+        fvec2 box_offset(offset_dist(gen), offset_dist(gen));
+
+        Hit expected;
+        bool expected_found = false;
+        for (ivec2 pos : vector_range(ivec2(20)))
+        {
+            if (impl::SweepBoxAgainstTile(tileset, bounds, input, pos, box, box_offset, {}, expected))
+                expected_found = true;
+        }
+
+        std::optional<Hit> actual = SweepBox(tileset, bounds, input, box, box_offset);
+        REQUIRE(bool(actual) == expected_found);
+        if (actual)
+            REQUIRE(actual->time == expected.time);
+    }
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include "program/errors.h"
+#include "utils/mat.h"
+#include "utils/multiarray.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Propagates integer light levels over a tile grid, and updates them incrementally when the light sources or the walls change.
+// Each tile is lit to `max(own emission, brightest 4-neighbor - 1)`. Opaque tiles receive light (so the walls around a lit room are lit too),
+//   but don't pass it on, only their own emission. This also works as fog of war: use the view radius as the emission of the observers.
+// The changes are batched: `SetEmission()` and `SetOpaque()` only record them, and `Update()` applies all of them at once (e.g. once per tick).
+// `Update()` uses the two-queue algorithm from the voxel engines: first it darkens everything that could've been lit by the changed tiles
+//   (a flood fill limited by the old light levels), then re-propagates the light into the darkened area from its lit boundary and from the sources.
+// The cost depends on the light radius around the changed tiles, not on the map size.
+// How to use:
+//     Geom::TileLight light(map_size);
+//     light.SetOpaque(wall_pos, true);
+//     light.SetEmission(torch_pos, 8);
+//     light.Update();
+//     for (ivec2 tile : light.ChangedTiles())
+//         ...; // Redraw this tile with `light.Light(tile)`.
+namespace Geom
+{
+    class TileLight
+    {
+      public:
+        using level_t = std::uint8_t;
+
+      private:
+        struct Tile
+        {
+            level_t light = 0;
+            level_t emission = 0;
+            bool opaque = false;
+            bool pending = false; // Whether it's in `pending`.
+            bool changed = false; // Whether it's in `changed_tiles`.
+        };
+
+        struct PendingChange
+        {
+            ivec2 pos;
+            level_t old_output = 0; // What the tile passed to its neighbors before the change, see `Output()`.
+        };
+
+        struct Removal
+        {
+            ivec2 pos;
+            level_t old_light = 0;
+        };
+
+        static constexpr ivec2 directions[4] = {ivec2(1, 0), ivec2(0, 1), ivec2(-1, 0), ivec2(0, -1)};
+
+        Array2D<Tile, int> tiles;
+        std::vector<PendingChange> pending;
+        std::vector<ivec2> changed_tiles;
+
+        // Those are only used in `Update()`, but are stored here to reuse the memory.
+        std::vector<Removal> removal_queue;
+        std::vector<ivec2> propagation_queue;
+        std::vector<ivec2> darkened_opaque_tiles;
+
+        // The light level that this tile passes to its neighbors, plus one.
+        [[nodiscard]] static level_t Output(const Tile &tile)
+        {
+            return tile.opaque ? tile.emission : tile.light;
+        }
+
+        void SetLight(ivec2 pos, Tile &tile, level_t light)
+        {
+            if (tile.light == light)
+                return;
+            tile.light = light;
+            if (!tile.changed)
+            {
+                tile.changed = true;
+                changed_tiles.push_back(pos);
+            }
+        }
+
+        void AddPending(ivec2 pos, Tile &tile)
+        {
+            if (tile.pending)
+                return;
+            tile.pending = true;
+            pending.push_back({.pos = pos, .old_output = Output(tile)});
+        }
+
+        // Darkens the tiles that could've been lit by `removal_queue`. Queues the lit boundary of the darkened area for propagation.
+        void RunRemoval()
+        {
+            while (!removal_queue.empty())
+            {
+                Removal removal = removal_queue.back();
+                removal_queue.pop_back();
+
+                for (ivec2 dir : directions)
+                {
+                    ivec2 next_pos = removal.pos + dir;
+                    if (!tiles.pos_in_range(next_pos))
+                        continue;
+                    Tile &next = tiles.at(next_pos);
+                    if (next.light == 0)
+                        continue;
+
+                    if (next.light < removal.old_light)
+                    {
+                        // Could've been lit by us, darken it.
+                        level_t old_light = next.light;
+                        if (old_light == next.emission)
+                        {
+                            // Lit only by itself, so it stays lit and re-propagates.
+                            propagation_queue.push_back(next_pos);
+                            continue;
+                        }
+                        SetLight(next_pos, next, next.emission);
+                        if (next.emission > 0)
+                            propagation_queue.push_back(next_pos);
+                        if (next.opaque)
+                            darkened_opaque_tiles.push_back(next_pos); // Doesn't pass the received light further, but might need it from the other neighbors.
+                        else
+                            removal_queue.push_back({.pos = next_pos, .old_light = old_light});
+                    }
+                    else
+                    {
+                        // Lit from elsewhere, re-propagate from it.
+                        propagation_queue.push_back(next_pos);
+                    }
+                }
+            }
+
+            // The opaque tiles don't pass the light, so their other neighbors would never re-propagate into them. Relight them from all neighbors now.
+            for (ivec2 pos : darkened_opaque_tiles)
+            {
+                Tile &tile = tiles.at(pos);
+                level_t light = tile.emission;
+                for (ivec2 dir : directions)
+                {
+                    ivec2 next_pos = pos + dir;
+                    if (tiles.pos_in_range(next_pos))
+                    {
+                        level_t next_output = Output(tiles.at(next_pos));
+                        if (next_output > light + 1)
+                            light = next_output - 1;
+                    }
+                }
+                SetLight(pos, tile, light);
+            }
+            darkened_opaque_tiles.clear();
+        }
+
+        // Spreads the light from `propagation_queue`.
+        void RunPropagation()
+        {
+            while (!propagation_queue.empty())
+            {
+                ivec2 pos = propagation_queue.back();
+                propagation_queue.pop_back();
+
+                level_t output = Output(tiles.at(pos));
+                if (output <= 1)
+                    continue;
+                level_t next_light = output - 1;
+
+                for (ivec2 dir : directions)
+                {
+                    ivec2 next_pos = pos + dir;
+                    if (!tiles.pos_in_range(next_pos))
+                        continue;
+                    Tile &next = tiles.at(next_pos);
+                    if (next.light >= next_light)
+                        continue;
+                    SetLight(next_pos, next, next_light);
+                    if (!next.opaque)
+                        propagation_queue.push_back(next_pos);
+                }
+            }
+        }
+
+      public:
+        TileLight() {}
+
+        // Makes a dark map without walls.
+        TileLight(ivec2 size) : tiles(size) {}
+
+        [[nodiscard]] ivec2 Size() const
+        {
+            return tiles.size();
+        }
+
+        // The light level, as of the last `Update()`.
+        [[nodiscard]] level_t Light(ivec2 pos) const
+        {
+            return tiles.at(pos).light;
+        }
+
+        // Those return the new values, even before `Update()`.
+        [[nodiscard]] level_t Emission(ivec2 pos) const
+        {
+            return tiles.at(pos).emission;
+        }
+        [[nodiscard]] bool IsOpaque(ivec2 pos) const
+        {
+            return tiles.at(pos).opaque;
+        }
+
+        // Adds, removes (with `level == 0`), or changes a light source. Applied in the next `Update()`.
+        void SetEmission(ivec2 pos, level_t level)
+        {
+            Tile &tile = tiles.at(pos);
+            if (tile.emission == level)
+                return;
+            AddPending(pos, tile);
+            tile.emission = level;
+        }
+
+        // Adds or removes a wall. Applied in the next `Update()`.
+        void SetOpaque(ivec2 pos, bool opaque)
+        {
+            Tile &tile = tiles.at(pos);
+            if (tile.opaque == opaque)
+                return;
+            AddPending(pos, tile);
+            tile.opaque = opaque;
+        }
+
+        // Whether `Update()` has something to do.
+        [[nodiscard]] bool HasPendingChanges() const
+        {
+            return !pending.empty();
+        }
+
+        // Applies all changes since the last call. Then `ChangedTiles()` returns the tiles whose light level has changed.
+        void Update()
+        {
+            for (ivec2 pos : changed_tiles)
+                tiles.at(pos).changed = false;
+            changed_tiles.clear();
+
+            // Darken around the changed tiles, using what they used to pass to the neighbors.
+            for (const PendingChange &change : pending)
+            {
+                Tile &tile = tiles.at(change.pos);
+                tile.pending = false;
+
+                SetLight(change.pos, tile, tile.emission);
+                if (tile.emission > 0)
+                    propagation_queue.push_back(change.pos);
+                if (tile.opaque)
+                    darkened_opaque_tiles.push_back(change.pos); // The transparent ones are relit by the neighbors during the propagation.
+                removal_queue.push_back({.pos = change.pos, .old_light = change.old_output});
+            }
+            pending.clear();
+
+            RunRemoval();
+            RunPropagation();
+        }
+
+        // Recomputes everything from scratch. Equivalent to `Update()`, but faster if most of the map has changed.
+        void RecomputeAll()
+        {
+            for (ivec2 pos : changed_tiles)
+                tiles.at(pos).changed = false;
+            changed_tiles.clear();
+            pending.clear();
+
+            tiles.for_each_element([&](ivec2 pos, Tile &tile)
+            {
+                tile.pending = false;
+                SetLight(pos, tile, tile.emission);
+                if (tile.emission > 0)
+                    propagation_queue.push_back(pos);
+            });
+            RunPropagation();
+        }
+
+        // The tiles whose light level has changed in the last `Update()` or `RecomputeAll()`, in no particular order.
+        // Might include tiles that were darkened and then relit to the same level.
+        [[nodiscard]] std::span<const ivec2> ChangedTiles() const
+        {
+            return changed_tiles;
+        }
+    };
+}
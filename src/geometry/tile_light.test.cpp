@@ -0,0 +1,61 @@
+#include "tile_light.h"
+
+#include <random>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("geometry.tile_light")
+{
+    { // A simple case.
+        Geom::TileLight light(ivec2(10, 1));
+        light.SetOpaque(ivec2(6, 0), true);
+        light.SetEmission(ivec2(2, 0), 4);
+        light.Update();
+        for (int x = 0; x < 10; x++)
+            REQUIRE(light.Light(ivec2(x, 0)) == std::array{2, 3, 4, 3, 2, 1, 0, 0, 0, 0}[x]);
+        REQUIRE(light.ChangedTiles().size() == 6);
+
+        // Moving the wall closer, the wall itself is lit.
+        light.SetOpaque(ivec2(6, 0), false);
+        light.SetOpaque(ivec2(3, 0), true);
+        light.Update();
+        for (int x = 0; x < 10; x++)
+            REQUIRE(light.Light(ivec2(x, 0)) == std::array{2, 3, 4, 3, 0, 0, 0, 0, 0, 0}[x]);
+
+        // Removing the light.
+        light.SetEmission(ivec2(2, 0), 0);
+        light.Update();
+        for (int x = 0; x < 10; x++)
+            REQUIRE(light.Light(ivec2(x, 0)) == 0);
+    }
+
+    { // Random changes, compared with a full recompute.
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<int> pos_dist(0, 31), level_dist(0, 12), kind_dist(0, 2);
+
+        Geom::TileLight light(ivec2(32));
+        for (int tick = 0; tick < 200; tick++)
+        {
+            int num_changes = tick % 5 + 1;
+            for (int i = 0; i < num_changes; i++)
+            {
+                ivec2 pos(pos_dist(gen), pos_dist(gen));
+                if (kind_dist(gen) == 0)
+                    light.SetEmission(pos, Geom::TileLight::level_t(level_dist(gen)));
+                else
+                    light.SetOpaque(pos, !light.IsOpaque(pos));
+            }
+            light.Update();
+            REQUIRE_FALSE(light.HasPendingChanges());
+
+            Geom::TileLight expected = light;
+            expected.RecomputeAll();
+            for (ivec2 pos : ivec2() <= vector_range < light.Size())
+            {
+                CAPTURE(tick);
+                CAPTURE(pos);
+                REQUIRE(light.Light(pos) == expected.Light(pos));
+            }
+        }
+    }
+}
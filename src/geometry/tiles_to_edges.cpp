@@ -2,6 +2,15 @@
 
 #include <parallel_hashmap/phmap.h>
 
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+#include "stream/input.h"
+#include "utils/jobs.h"
+
 namespace Geom::TilesToEdges
 {
     BakedTileset::BakedTileset(Tileset &&input)
@@ -129,4 +138,246 @@ namespace Geom::TilesToEdges
             }
         }
     }
+
+    namespace
+    {
+        // The baked tileset format: the magic, the format version (`uint32_t`), the tile size (2x `int32_t`),
+        //   the vertex count (`uint32_t`) and the vertices (2x `int32_t` each),
+        //   the edge type count (`uint32_t`) and the edge types (`vert_a`, `vert_b`, `opposite_edge` as `uint32_t`, then `opposite_edge_dir` as 2x `int32_t`),
+        //   the tile type count (`uint32_t`), then `per_tile_edge_info` for every tile and edge (`prev`, `next` as `uint32_t`, `loop_index` as `int32_t`),
+        //   then for every tile the starting edge count (`uint32_t`) and the starting edges (`uint32_t`). All numbers are little-endian.
+        constexpr std::string_view baked_tileset_magic = "imp.btil";
+        constexpr std::uint32_t baked_tileset_version = 1; // Increment when changing the format.
+    }
+
+    BakedTileset BakedTileset::Load(const Stream::ReadOnlyData &data)
+    {
+        Stream::Input input(data);
+        input.WantLocationStyle(Stream::byte_offset);
+
+        if (!input.DiscardChars<Stream::if_present>(baked_tileset_magic))
+            throw std::runtime_error(input.GetExceptionPrefix() + "This is not a baked tileset.");
+        if (input.ReadLittle<std::uint32_t>() != baked_tileset_version)
+            throw std::runtime_error(input.GetExceptionPrefix() + "The baked tileset was saved by an incompatible version, rebake it.");
+
+        // Reads a count, checking that there are enough bytes for that many elements of `elem_size` bytes.
+        auto ReadCount = [&](std::size_t elem_size)
+        {
+            std::uint32_t ret = input.ReadLittle<std::uint32_t>();
+            if (ret > input.RemainingBytes() / elem_size)
+                throw std::runtime_error(input.GetExceptionPrefix() + "Element count is out of bounds.");
+            return ret;
+        };
+        // Reads an ID, which must be either less than `count`, or invalid if `allow_invalid` is true.
+        auto ReadId = [&]<typename T>(std::type_identity<T>, std::size_t count, bool allow_invalid)
+        {
+            T ret = T(input.ReadLittle<std::uint32_t>());
+            if (ret == T::invalid ? !allow_invalid : std::to_underlying(ret) >= count)
+                throw std::runtime_error(input.GetExceptionPrefix() + "ID is out of bounds.");
+            return ret;
+        };
+
+        BakedTileset ret;
+
+        ret.tile_size.x = input.ReadLittle<std::int32_t>();
+        ret.tile_size.y = input.ReadLittle<std::int32_t>();
+
+        ret.vertices.resize(ReadCount(sizeof(std::int32_t) * 2));
+        for (ivec2 &vertex : ret.vertices)
+        {
+            vertex.x = input.ReadLittle<std::int32_t>();
+            vertex.y = input.ReadLittle<std::int32_t>();
+        }
+
+        ret.edge_types.resize(ReadCount(sizeof(std::uint32_t) * 5));
+        for (EdgeType &edge_type : ret.edge_types)
+        {
+            edge_type.vert_a = ReadId(std::type_identity<VertexId>{}, ret.vertices.size(), false);
+            edge_type.vert_b = ReadId(std::type_identity<VertexId>{}, ret.vertices.size(), false);
+            edge_type.opposite_edge = ReadId(std::type_identity<EdgeId>{}, ret.edge_types.size(), true);
+            edge_type.opposite_edge_dir.x = input.ReadLittle<std::int32_t>();
+            edge_type.opposite_edge_dir.y = input.ReadLittle<std::int32_t>();
+        }
+
+        // Each tile stores 3 numbers per edge type, and the number of its starting edges.
+        std::uint32_t num_tiles = ReadCount(sizeof(std::uint32_t) * (ret.edge_types.size() * 3 + 1));
+
+        ret.per_tile_edge_info.resize(xvec2(ret.edge_types.size(), num_tiles));
+        for (std::size_t tile = 0; tile < num_tiles; tile++)
+        for (std::size_t edge = 0; edge < ret.edge_types.size(); edge++)
+        {
+            PerTileEdgeInfo &info = ret.per_tile_edge_info.at(xvec2(edge, tile));
+            info.prev = ReadId(std::type_identity<EdgeId>{}, ret.edge_types.size(), true);
+            info.next = ReadId(std::type_identity<EdgeId>{}, ret.edge_types.size(), true);
+            info.loop_index = input.ReadLittle<std::int32_t>();
+        }
+
+        ret.tile_starting_edges.resize(num_tiles);
+        for (std::vector<EdgeId> &edges : ret.tile_starting_edges)
+        {
+            edges.resize(ReadCount(sizeof(std::uint32_t)));
+            for (EdgeId &edge : edges)
+                edge = ReadId(std::type_identity<EdgeId>{}, ret.edge_types.size(), false);
+        }
+
+        if (input.RemainingBytes() != 0)
+            throw std::runtime_error(input.GetExceptionPrefix() + "Junk after the end of the baked tileset.");
+
+        return ret;
+    }
+
+    void BakedTileset::Save(Stream::Output &output) const
+    {
+        output.WriteString(baked_tileset_magic.data(), baked_tileset_magic.size());
+        output.WriteLittle<std::uint32_t>(baked_tileset_version);
+
+        output.WriteLittle<std::int32_t>(tile_size.x);
+        output.WriteLittle<std::int32_t>(tile_size.y);
+
+        output.WriteLittle<std::uint32_t>(vertices.size());
+        for (ivec2 vertex : vertices)
+        {
+            output.WriteLittle<std::int32_t>(vertex.x);
+            output.WriteLittle<std::int32_t>(vertex.y);
+        }
+
+        output.WriteLittle<std::uint32_t>(edge_types.size());
+        for (const EdgeType &edge_type : edge_types)
+        {
+            output.WriteLittle<std::uint32_t>(std::to_underlying(edge_type.vert_a));
+            output.WriteLittle<std::uint32_t>(std::to_underlying(edge_type.vert_b));
+            output.WriteLittle<std::uint32_t>(std::to_underlying(edge_type.opposite_edge));
+            output.WriteLittle<std::int32_t>(edge_type.opposite_edge_dir.x);
+            output.WriteLittle<std::int32_t>(edge_type.opposite_edge_dir.y);
+        }
+
+        output.WriteLittle<std::uint32_t>(NumTileTypes());
+        for (std::size_t tile = 0; tile < NumTileTypes(); tile++)
+        for (std::size_t edge = 0; edge < edge_types.size(); edge++)
+        {
+            const PerTileEdgeInfo &info = per_tile_edge_info.at(xvec2(edge, tile));
+            output.WriteLittle<std::uint32_t>(std::to_underlying(info.prev));
+            output.WriteLittle<std::uint32_t>(std::to_underlying(info.next));
+            output.WriteLittle<std::int32_t>(info.loop_index);
+        }
+
+        for (const std::vector<EdgeId> &edges : tile_starting_edges)
+        {
+            output.WriteLittle<std::uint32_t>(edges.size());
+            for (EdgeId edge : edges)
+                output.WriteLittle<std::uint32_t>(std::to_underlying(edge));
+        }
+    }
+
+    namespace impl
+    {
+        void ParallelFor(std::size_t count, int num_threads, const std::function<void(std::size_t i)> &func)
+        {
+            Jobs::ThreadPool &pool = Jobs::GlobalPool();
+            if (num_threads <= 0)
+                num_threads = pool.Concurrency();
+            num_threads = std::clamp(int(std::min(count, std::size_t(num_threads))), 1, num_threads);
+
+            // Run `num_threads` jobs, each taking the chunks one by one, since the chunks can take very different time.
+            std::atomic<std::size_t> next = 0;
+            std::atomic<bool> failed = false;
+            Jobs::ParallelFor(pool, 0, std::size_t(num_threads), [&](std::size_t)
+            {
+                try
+                {
+                    while (!failed.load(std::memory_order_relaxed))
+                    {
+                        std::size_t i = next++;
+                        if (i >= count)
+                            break;
+                        func(i);
+                    }
+                }
+                catch (...)
+                {
+                    failed = true;
+                    throw;
+                }
+            });
+        }
+
+        ChunkContours StitchChunkContours(std::span<const ChunkContours> chunks)
+        {
+            ChunkContours ret;
+
+            // An open contour, the points `[begin, end)` of a chunk.
+            // The first and the last edge are outside of the chunk, and the last one is the first inner edge of the next chain in the same loop.
+            struct Chain
+            {
+                const ChunkContours *chunk = nullptr;
+                std::size_t begin = 0;
+                std::size_t end = 0;
+            };
+            std::vector<Chain> chains;
+
+            // Copy the closed contours as is, and collect the open ones.
+            for (const ChunkContours &chunk : chunks)
+            {
+                std::size_t begin = 0;
+                for (std::size_t i = 0; i < chunk.points.size(); i++)
+                {
+                    if (chunk.infos[i].type != PointType::last)
+                        continue;
+
+                    if (chunk.infos[i].closed)
+                    {
+                        ret.points.insert(ret.points.end(), chunk.points.begin() + std::ptrdiff_t(begin), chunk.points.begin() + std::ptrdiff_t(i + 1));
+                        ret.infos.insert(ret.infos.end(), chunk.infos.begin() + std::ptrdiff_t(begin), chunk.infos.begin() + std::ptrdiff_t(i + 1));
+                    }
+                    else
+                    {
+                        ASSERT(i + 1 - begin >= 4, "Open contours should have at least 4 points.");
+                        chains.push_back({.chunk = &chunk, .begin = begin, .end = i + 1});
+                    }
+                    begin = i + 1;
+                }
+            }
+
+            // Maps the first inner edge of each chain to the chain index.
+            phmap::flat_hash_map<std::pair<ivec2, ivec2>, std::size_t> first_edge_to_chain;
+            for (std::size_t i = 0; i < chains.size(); i++)
+            {
+                const Chain &chain = chains[i];
+                first_edge_to_chain.try_emplace({chain.chunk->points[chain.begin + 1], chain.chunk->points[chain.begin + 2]}, i);
+            }
+
+            std::vector<bool> used_chains(chains.size());
+            for (std::size_t first = 0; first < chains.size(); first++)
+            {
+                if (used_chains[first])
+                    continue;
+
+                std::size_t cur = first;
+                do
+                {
+                    used_chains[cur] = true;
+                    const Chain &chain = chains[cur];
+
+                    // Skip the outer edges, and the end of the last inner edge (which is the start of the next chain).
+                    for (std::size_t i = chain.begin + 1; i < chain.end - 2; i++)
+                    {
+                        ret.points.push_back(chain.chunk->points[i]);
+                        ret.infos.push_back({.type = PointType::normal, .closed = true});
+                    }
+
+                    auto it = first_edge_to_chain.find({chain.chunk->points[chain.end - 2], chain.chunk->points[chain.end - 1]});
+                    if (it == first_edge_to_chain.end() || (used_chains[it->second] && it->second != first))
+                        throw std::runtime_error("Unable to join the tile contours across the chunk borders.");
+                    cur = it->second;
+                }
+                while (cur != first);
+
+                // Repeat the first point, like the closed contours do.
+                ret.points.push_back(chains[first].chunk->points[chains[first].begin + 1]);
+                ret.infos.push_back({.type = PointType::last, .closed = true});
+            }
+
+            return ret;
+        }
+    }
 }
@@ -2,18 +2,24 @@
 
 #include "geometry/common.h"
 #include "program/errors.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
 #include "utils/mat.h"
 #include "utils/multiarray.h"
 
 #include <cassert>
+#include <cstdint>
+#include <functional>
+#include <span>
 #include <utility>
 #include <vector>
 
 // Converts tile maps to edge loops (closed or open), good for Box2D "chain" shapes (for static tiles).
 // How to use:
 // * Construct `Tileset`.
-// * Bake it into `BakedTileset`.
-// * Call `ConvertTilesToEdges(...)`.
+// * Bake it into `BakedTileset`. The baked tables can be saved with `BakedTileset::Save()` at asset-build time and loaded with `BakedTileset::Load()`.
+// * Call `ConvertTilesToEdges(...)`, or use `IncrementalConverter` if the tiles change often.
+//   For large maps, `ConvertTilesToEdgesParallel(...)` converts the chunks on several threads.
 // We can operate in two modes: either outputting only closed loops,
 //   or peeking one tile outside of the map and outputting both closed and open loops (open when the tiles are on the map edge).
 // The latter is good for chunking.
@@ -92,6 +98,12 @@ namespace Geom::TilesToEdges
 
         explicit BakedTileset(Tileset &&input);
 
+        // Loads a tileset baked and saved with `Save()`, so you don't have to bake it at runtime.
+        // Throws if the data is malformed, or was saved by an incompatible version of this code.
+        [[nodiscard]] static BakedTileset Load(const Stream::ReadOnlyData &data);
+        // Writes the baked tables, to be loaded with `Load()`.
+        void Save(Stream::Output &output) const;
+
         // Number of registered tile types.
         [[nodiscard]] std::underlying_type_t<TileId> NumTileTypes() const
         {
@@ -174,6 +186,226 @@ namespace Geom::TilesToEdges
         open,
     };
 
+    namespace impl
+    {
+        // One bit per edge type, for each tile.
+        using EdgeBitMaskType = std::uint64_t;
+
+        // The tiles that `ConvertTilesToEdges()` reads in each mode.
+        [[nodiscard]] inline irect2 ExistingTiles(Mode mode, ivec2 region_size)
+        {
+            return mode == Mode::closed ? ivec2().rect_size(region_size) : ivec2(-1).rect_size(region_size + 2);
+        }
+
+        // The implementation of `ConvertTilesToEdges()` and `IncrementalConverter`.
+        // Only starts the contours in `starting_tiles` (a range of `ivec2`), and skips the edges already marked in `visited_edges`.
+        // The tiles outside of `existing_tiles` are never read, as if they had no edges. This must include the region,
+        //   and can extend one tile outside of it in `Mode::open` (then the contours can pass through those tiles).
+        // `edge_visited` is `(ivec2 tile_pos, BakedTileset::EdgeId edge) -> void`, it's called for every edge marked as visited.
+        template <typename IsConnectedFunc, typename NewContourStartsFunc>
+        void TraceContours(
+            const BakedTileset &tileset,
+            Mode mode,
+            ivec2 region_size,
+            irect2 existing_tiles,
+            auto &&starting_tiles,
+            Array2D<EdgeBitMaskType> &visited_edges,
+            auto &&input,
+            auto &&output,
+            IsConnectedFunc &&is_connected,
+            NewContourStartsFunc &&new_contour_starts,
+            auto &&edge_visited
+        )
+        {
+            // Check if `tile_pos` is in bounds.
+            auto TileIsInBounds = [&](ivec2 tile_pos) -> bool
+            {
+                return tile_pos(all) >= 0 && tile_pos(all) < region_size;
+            };
+
+            // Check if we can read the tile at `tile_pos`.
+            auto TileExists = [&](ivec2 tile_pos) -> bool
+            {
+                return existing_tiles.contains(tile_pos);
+            };
+
+            // Get a tile at a specific position using `input(...)`.
+            auto GetTileAt = [&](ivec2 tile_pos) -> BakedTileset::TileId
+            {
+                // Check the bounds, just in case.
+                // In `mode == open`, we can look one tile outside of the `region_size`.
+                ASSERT(TileExists(tile_pos));
+
+                return BakedTileset::TileId(input(std::as_const(tile_pos)));
+            };
+
+            struct Cursor
+            {
+                ivec2 tile_pos;
+                BakedTileset::TileId tile = BakedTileset::TileId::invalid; // Caches the tile ID at `tile_pos`.
+                BakedTileset::EdgeId edge = BakedTileset::EdgeId::invalid;
+            };
+            // Moves forward or backward along an edge loop, across tiles.
+            // Returns true on success. Can return false only in `mode == open`, when reaching a map boundary.
+            auto MoveToNextEdge = [&](Cursor &cur, bool forward) -> bool
+            {
+                while (true)
+                {
+                    cur.edge = tileset.GetPerTileEdgeInfo(cur.tile, cur.edge).PrevOrNext(forward);
+
+                    const BakedTileset::EdgeType &edge_info = tileset.GetEdgeInfo(cur.edge);
+                    if (edge_info.opposite_edge == BakedTileset::EdgeId::invalid)
+                        return true; // No opposite edge for this edge type, nothing to check.
+                    ivec2 next_tile_pos = cur.tile_pos + edge_info.opposite_edge_dir;
+                    if (!TileExists(next_tile_pos))
+                        return true; // The possible opposite edge is outside of the map, will not check it.
+                    BakedTileset::TileId next_tile = GetTileAt(next_tile_pos);
+                    if (!tileset.TileHasEdge(next_tile, edge_info.opposite_edge))
+                        return true; // The adjacent tile doesn't have our opposite edge.
+
+                    if constexpr (!std::is_null_pointer_v<IsConnectedFunc>)
+                    {
+                        if (!bool(is_connected(std::as_const(cur.tile_pos), tileset.GetPerTileEdgeInfo(cur.tile, cur.edge).loop_index, std::as_const(edge_info.opposite_edge_dir), tileset.GetPerTileEdgeInfo(next_tile, edge_info.opposite_edge).loop_index)))
+                            return true; // The user callback says we shouldn't respect this connection.
+                    }
+
+                    // At this point the adjacent tile DOES have our opposite edge.
+                    cur.tile_pos = next_tile_pos;
+                    cur.tile = next_tile;
+                    cur.edge = edge_info.opposite_edge;
+                }
+            };
+
+            ASSERT(tileset.NumEdgeTypes() <= sizeof(EdgeBitMaskType) * 8);
+            ASSERT(visited_edges.size() == region_size);
+            ASSERT(existing_tiles.contains(ivec2().rect_size(region_size)) && ivec2(-1).rect_size(region_size + 2).contains(existing_tiles));
+            ASSERT(mode == Mode::open || existing_tiles == ivec2().rect_size(region_size));
+
+            for (const ivec2 starting_tile_pos : starting_tiles)
+            {
+                const BakedTileset::TileId tile = GetTileAt(starting_tile_pos);
+
+                for (const BakedTileset::EdgeId loop_starting_edge : tileset.GetTileStartingEdges(tile))
+                {
+                    tileset.ForEveryEdgeInEdgeLoop(tile, loop_starting_edge, [&](const BakedTileset::EdgeId starting_edge)
+                    {
+                        if ((visited_edges.at(starting_tile_pos) >> std::to_underlying(starting_edge)) & 1)
+                            return false; // Already visited this edge.
+
+                        const BakedTileset::EdgeType &starting_edge_info = tileset.GetEdgeInfo(starting_edge);
+
+                        // Make sure this edge is not covered by an opposite edge on an adjacent tile.
+                        if (starting_edge_info.opposite_edge != BakedTileset::EdgeId::invalid)
+                        {
+                            const ivec2 other_tile_pos = starting_tile_pos + starting_edge_info.opposite_edge_dir;
+
+                            // Make sure we don't go outside of the boundary when `mode == closed`.
+                            if (TileExists(other_tile_pos))
+                            {
+                                // If the opposite edge covers this one, don't visit it.
+                                const BakedTileset::TileId other_tile = GetTileAt(other_tile_pos);
+                                if (tileset.TileHasEdge(other_tile, starting_edge_info.opposite_edge))
+                                {
+                                    if constexpr (!std::is_null_pointer_v<IsConnectedFunc>)
+                                    {
+                                        if (bool(is_connected(starting_tile_pos, tileset.GetPerTileEdgeInfo(tile, loop_starting_edge).loop_index, starting_edge_info.opposite_edge_dir, tileset.GetPerTileEdgeInfo(other_tile, starting_edge_info.opposite_edge).loop_index)))
+                                            return false;
+                                    }
+                                    else
+                                    {
+                                        return false;
+                                    }
+                                }
+                            }
+                        }
+
+                        // A new contour starts! Run the callback.
+                        if constexpr (!std::is_null_pointer_v<NewContourStartsFunc>)
+                            new_contour_starts(starting_tile_pos, tileset.GetPerTileEdgeInfo(tile, loop_starting_edge).loop_index);
+
+                        Cursor cursor{
+                            .tile_pos = starting_tile_pos,
+                            .tile = tile,
+                            .edge = starting_edge,
+                        };
+                        auto CursorIsAtStart = [&]
+                        {
+                            return cursor.tile_pos == starting_tile_pos && cursor.edge == starting_edge;
+                        };
+
+                        auto PointEmittingLoop = [&](bool loop_is_closed)
+                        {
+                            bool first_when_open = !loop_is_closed;
+                            do
+                            {
+                                // Output vertex.
+                                output(tileset.GetVertexPos(tileset.GetEdgeInfo(cursor.edge).vert_a) + cursor.tile_pos * tileset.tile_size,
+                                    PointInfo{
+                                        .type = first_when_open ? PointType::extra_edge_first : PointType::normal,
+                                        .closed = loop_is_closed,
+                                    }
+                                );
+
+                                // Mark edge as visited.
+                                if (first_when_open)
+                                {
+                                    first_when_open = false;
+                                }
+                                else
+                                {
+                                    visited_edges.at(cursor.tile_pos) |= EdgeBitMaskType(1) << std::to_underlying(cursor.edge);
+                                    edge_visited(std::as_const(cursor.tile_pos), std::as_const(cursor.edge));
+                                }
+
+                                // Move to the next edge.
+                                MoveToNextEdge(cursor, true);
+                            }
+                            while (loop_is_closed ? !CursorIsAtStart() : TileIsInBounds(cursor.tile_pos));
+
+                            // Output the final vertex.
+                            output(tileset.GetVertexPos(tileset.GetEdgeInfo(cursor.edge).vert_a) + cursor.tile_pos * tileset.tile_size,
+                                PointInfo{
+                                    .type = loop_is_closed ? PointType::last : PointType::extra_edge_pre_last,
+                                    .closed = loop_is_closed,
+                                }
+                            );
+
+                            // When in an open loop, output the actually final vertex.
+                            if (!loop_is_closed)
+                            {
+                                output(tileset.GetVertexPos(tileset.GetEdgeInfo(cursor.edge).vert_b) + cursor.tile_pos * tileset.tile_size,
+                                    PointInfo{
+                                        .type = PointType::last,
+                                        .closed = loop_is_closed,
+                                    }
+                                );
+                            }
+                        };
+
+                        if (mode == Mode::closed)
+                        {
+                            PointEmittingLoop(true);
+                        }
+                        else // mode == Mode::open
+                        {
+                            // Backtrack until we go out of bounds or do a full circle.
+                            do
+                            {
+                                MoveToNextEdge(cursor, false);
+                            }
+                            while (!CursorIsAtStart() && TileIsInBounds(cursor.tile_pos));
+
+                            // Then start emitting points.
+                            PointEmittingLoop(CursorIsAtStart());
+                        }
+
+                        return false;
+                    });
+                }
+            }
+        }
+    }
+
     // Coverts tiles to edges.
     // See the commends in `enum class Mode` above for the explanation of modes.
     template <typename IsConnectedFunc = std::nullptr_t, typename NewContourStartsFunc = std::nullptr_t>
@@ -202,180 +434,266 @@ namespace Geom::TilesToEdges
         NewContourStartsFunc &&new_contour_starts = nullptr
     )
     {
-        // Check if `tile_pos` is in bounds.
-        auto TileIsInBounds = [&](ivec2 tile_pos) -> bool
-        {
-            return tile_pos(all) >= 0 && tile_pos(all) < region_size;
-        };
+        Array2D<impl::EdgeBitMaskType> visited_edges(region_size);
+        impl::TraceContours<IsConnectedFunc, NewContourStartsFunc>(tileset, mode, region_size, impl::ExistingTiles(mode, region_size), vector_range(region_size), visited_edges, input, output,
+            std::forward<IsConnectedFunc>(is_connected), std::forward<NewContourStartsFunc>(new_contour_starts), [](ivec2, BakedTileset::EdgeId){});
+    }
 
-        // Get a tile at a specific position using `input(...)`.
-        auto GetTileAt = [&](ivec2 tile_pos) -> BakedTileset::TileId
-        {
-            // Check the bounds, just in case.
-            // In `mode == open`, we can look one tile outside of the `region_size`.
-            ASSERT(mode == Mode::closed ? TileIsInBounds(tile_pos) : tile_pos(any) >= -1 && tile_pos(any) <= region_size);
+    // Keeps the contours of a tile map, and updates only the affected ones when some tiles change, instead of rerunning `ConvertTilesToEdges()`.
+    // Remembers which contours pass through each tile. On a change, removes the contours passing through the changed tiles and their neighbors,
+    //   and retraces only the edges that were freed.
+    // The contours are reported to the callbacks, so you can create and destroy e.g. the Box2D chain shapes one by one.
+    // The contours are the same as the ones produced by `ConvertTilesToEdges()`, except that the closed ones can start at a different point.
+    // Usage:
+    //     Geom::TilesToEdges::IncrementalConverter converter(tileset, Mode::open, chunk_size);
+    //     converter.Rebuild(input, on_removed, on_added); // Once.
+    //     converter.Update(input, changed_tiles, on_removed, on_added); // When the tiles change.
+    class IncrementalConverter
+    {
+      public:
+        enum class ContourId : std::uint32_t {invalid = std::uint32_t(-1)};
 
-            return BakedTileset::TileId(input(std::as_const(tile_pos)));
+        struct Contour
+        {
+            // The points in the same format as the ones passed to `output` by `ConvertTilesToEdges()`, including the extra ones.
+            std::vector<ivec2> points;
+            // Same as `PointInfo::closed`.
+            bool closed = true;
         };
 
-        struct Cursor
+      private:
+        struct ContourData
         {
-            ivec2 tile_pos;
-            BakedTileset::TileId tile = BakedTileset::TileId::invalid; // Caches the tile ID at `tile_pos`.
-            BakedTileset::EdgeId edge = BakedTileset::EdgeId::invalid;
+            Contour contour;
+            // The tiles (in the region) and the edges this contour consists of. A tile can repeat.
+            std::vector<std::pair<ivec2, BakedTileset::EdgeId>> edges;
+            bool alive = false;
         };
-        // Moves forward or backward along an edge loop, across tiles.
-        // Returns true on success. Can return false only in `mode == open`, when reaching a map boundary.
-        auto MoveToNextEdge = [&](Cursor &cur, bool forward) -> bool
-        {
-            while (true)
-            {
-                cur.edge = tileset.GetPerTileEdgeInfo(cur.tile, cur.edge).PrevOrNext(forward);
-
-                const BakedTileset::EdgeType &edge_info = tileset.GetEdgeInfo(cur.edge);
-                if (edge_info.opposite_edge == BakedTileset::EdgeId::invalid)
-                    return true; // No opposite edge for this edge type, nothing to check.
-                ivec2 next_tile_pos = cur.tile_pos + edge_info.opposite_edge_dir;
-                if (mode == Mode::closed && !TileIsInBounds(next_tile_pos))
-                    return true; // The possible opposite edge is outside of the map, will not check it.
-                BakedTileset::TileId next_tile = GetTileAt(next_tile_pos);
-                if (!tileset.TileHasEdge(next_tile, edge_info.opposite_edge))
-                    return true; // The adjacent tile doesn't have our opposite edge.
-
-                if constexpr (!std::is_null_pointer_v<IsConnectedFunc>)
-                {
-                    if (!bool(is_connected(std::as_const(cur.tile_pos), tileset.GetPerTileEdgeInfo(cur.tile, cur.edge).loop_index, std::as_const(edge_info.opposite_edge_dir), tileset.GetPerTileEdgeInfo(next_tile, edge_info.opposite_edge).loop_index)))
-                        return true; // The user callback says we shouldn't respect this connection.
-                }
 
-                // At this point the adjacent tile DOES have our opposite edge.
-                cur.tile_pos = next_tile_pos;
-                cur.tile = next_tile;
-                cur.edge = edge_info.opposite_edge;
-            }
-        };
+        const BakedTileset *tileset = nullptr;
+        Mode mode = Mode::closed;
+        ivec2 region_size;
 
-        using EdgeBitMaskType = std::uint64_t;
-        ASSERT(tileset.NumEdgeTypes() <= sizeof(EdgeBitMaskType) * 8);
+        Array2D<impl::EdgeBitMaskType> visited_edges;
+        // For each tile, the contours passing through it.
+        Array2D<std::vector<ContourId>> tile_contours;
+        std::vector<ContourData> contours;
+        std::vector<ContourId> free_contours;
 
-        Array2D<EdgeBitMaskType> visited_edges(region_size);
+        // Temporary state for `Update()`.
+        Array2D<char> retrace_mask;
+        std::vector<ivec2> retrace_tiles;
 
-        for (const ivec2 starting_tile_pos : vector_range(region_size))
+        void AddRetraceTile(ivec2 tile_pos)
         {
-            const BakedTileset::TileId tile = GetTileAt(starting_tile_pos);
+            if (!retrace_mask.pos_in_range(tile_pos) || retrace_mask.at(tile_pos))
+                return;
+            retrace_mask.at(tile_pos) = true;
+            retrace_tiles.push_back(tile_pos);
+        }
 
-            for (const BakedTileset::EdgeId loop_starting_edge : tileset.GetTileStartingEdges(tile))
+        void RemoveContour(ContourId id, auto &&on_removed)
+        {
+            ContourData &data = contours[std::to_underlying(id)];
+            on_removed(std::as_const(id), std::as_const(data.contour));
+            for (const auto &[tile_pos, edge] : data.edges)
             {
-                tileset.ForEveryEdgeInEdgeLoop(tile, loop_starting_edge, [&](const BakedTileset::EdgeId starting_edge)
-                {
-                    if ((visited_edges.at(starting_tile_pos) >> std::to_underlying(starting_edge)) & 1)
-                        return false; // Already visited this edge.
+                visited_edges.at(tile_pos) &= ~(impl::EdgeBitMaskType(1) << std::to_underlying(edge));
+                std::erase(tile_contours.at(tile_pos), id);
+                AddRetraceTile(tile_pos);
+            }
+            data = {};
+            free_contours.push_back(id);
+        }
 
-                    const BakedTileset::EdgeType &starting_edge_info = tileset.GetEdgeInfo(starting_edge);
+        // Traces the contours starting in `retrace_tiles`, and clears them.
+        template <typename IsConnectedFunc>
+        void Retrace(auto &&input, auto &&on_added, IsConnectedFunc &&is_connected)
+        {
+            ContourId cur_id = ContourId::invalid;
 
-                    // Make sure this edge is not covered by an opposite edge on an adjacent tile.
-                    if (starting_edge_info.opposite_edge != BakedTileset::EdgeId::invalid)
+            impl::TraceContours<IsConnectedFunc, std::nullptr_t>(*tileset, mode, region_size, impl::ExistingTiles(mode, region_size), retrace_tiles, visited_edges, input,
+                [&](ivec2 pos, PointInfo info)
+                {
+                    if (cur_id == ContourId::invalid)
                     {
-                        const ivec2 other_tile_pos = starting_tile_pos + starting_edge_info.opposite_edge_dir;
-
-                        // Make sure we don't go outside of the boundary when `mode == closed`.
-                        if (mode == Mode::open || TileIsInBounds(other_tile_pos))
+                        if (free_contours.empty())
                         {
-                            // If the opposite edge covers this one, don't visit it.
-                            const BakedTileset::TileId other_tile = GetTileAt(other_tile_pos);
-                            if (tileset.TileHasEdge(other_tile, starting_edge_info.opposite_edge))
-                            {
-                                if constexpr (!std::is_null_pointer_v<IsConnectedFunc>)
-                                {
-                                    if (bool(is_connected(starting_tile_pos, tileset.GetPerTileEdgeInfo(tile, loop_starting_edge).loop_index, starting_edge_info.opposite_edge_dir, tileset.GetPerTileEdgeInfo(other_tile, starting_edge_info.opposite_edge).loop_index)))
-                                        return false;
-                                }
-                                else
-                                {
-                                    return false;
-                                }
-                            }
+                            cur_id = ContourId(contours.size());
+                            contours.emplace_back();
+                        }
+                        else
+                        {
+                            cur_id = free_contours.back();
+                            free_contours.pop_back();
                         }
+                        contours[std::to_underlying(cur_id)].alive = true;
                     }
 
-                    // A new contour starts! Run the callback.
-                    if constexpr (!std::is_null_pointer_v<NewContourStartsFunc>)
-                        new_contour_starts(starting_tile_pos, tileset.GetPerTileEdgeInfo(tile, loop_starting_edge).loop_index);
-
-                    Cursor cursor{
-                        .tile_pos = starting_tile_pos,
-                        .tile = tile,
-                        .edge = starting_edge,
-                    };
-                    auto CursorIsAtStart = [&]
-                    {
-                        return cursor.tile_pos == starting_tile_pos && cursor.edge == starting_edge;
-                    };
-
-                    auto PointEmittingLoop = [&](bool loop_is_closed)
+                    ContourData &data = contours[std::to_underlying(cur_id)];
+                    data.contour.points.push_back(pos);
+                    data.contour.closed = info.closed;
+                    if (info.type == PointType::last)
                     {
-                        bool first_when_open = !loop_is_closed;
-                        do
+                        for (const auto &edge : data.edges)
                         {
-                            // Output vertex.
-                            output(tileset.GetVertexPos(tileset.GetEdgeInfo(cursor.edge).vert_a) + cursor.tile_pos * tileset.tile_size,
-                                PointInfo{
-                                    .type = first_when_open ? PointType::extra_edge_first : PointType::normal,
-                                    .closed = loop_is_closed,
-                                }
-                            );
+                            std::vector<ContourId> &list = tile_contours.at(edge.first);
+                            if (list.empty() || list.back() != cur_id)
+                                list.push_back(cur_id);
+                        }
+                        on_added(std::as_const(cur_id), std::as_const(data.contour));
+                        cur_id = ContourId::invalid;
+                    }
+                },
+                std::forward<IsConnectedFunc>(is_connected), nullptr,
+                [&](ivec2 tile_pos, BakedTileset::EdgeId edge)
+                {
+                    ASSERT(cur_id != ContourId::invalid);
+                    contours[std::to_underlying(cur_id)].edges.emplace_back(tile_pos, edge);
+                }
+            );
+            ASSERT(cur_id == ContourId::invalid, "Unfinished contour.");
 
-                            // Mark edge as visited.
-                            if (first_when_open)
-                                first_when_open = false;
-                            else
-                                visited_edges.at(cursor.tile_pos) |= 1 << std::to_underlying(cursor.edge);
+            for (ivec2 tile_pos : retrace_tiles)
+                retrace_mask.at(tile_pos) = false;
+            retrace_tiles.clear();
+        }
 
-                            // Move to the next edge.
-                            MoveToNextEdge(cursor, true);
-                        }
-                        while (loop_is_closed ? !CursorIsAtStart() : TileIsInBounds(cursor.tile_pos));
+      public:
+        IncrementalConverter() {}
 
-                        // Output the final vertex.
-                        output(tileset.GetVertexPos(tileset.GetEdgeInfo(cursor.edge).vert_a) + cursor.tile_pos * tileset.tile_size,
-                            PointInfo{
-                                .type = loop_is_closed ? PointType::last : PointType::extra_edge_pre_last,
-                                .closed = loop_is_closed,
-                            }
-                        );
+        // The tileset must remain alive as long as this object. See `ConvertTilesToEdges()` for the meaning of `mode` and `region_size`.
+        IncrementalConverter(const BakedTileset &tileset, Mode mode, ivec2 region_size)
+            : tileset(&tileset), mode(mode), region_size(region_size),
+            visited_edges(region_size), tile_contours(region_size), retrace_mask(region_size)
+        {}
 
-                        // When in an open loop, output the actually final vertex.
-                        if (!loop_is_closed)
-                        {
-                            output(tileset.GetVertexPos(tileset.GetEdgeInfo(cursor.edge).vert_b) + cursor.tile_pos * tileset.tile_size,
-                                PointInfo{
-                                    .type = PointType::last,
-                                    .closed = loop_is_closed,
-                                }
-                            );
-                        }
-                    };
+        // Removes all contours and traces the whole region again.
+        // `input` and `is_connected` are the same as in `ConvertTilesToEdges()`.
+        // `on_removed` and `on_added` are `(ContourId id, const Contour &contour) -> void`. The removed IDs can be reused by the added contours.
+        template <typename IsConnectedFunc = std::nullptr_t>
+        void Rebuild(auto &&input, auto &&on_removed, auto &&on_added, IsConnectedFunc &&is_connected = nullptr)
+        {
+            for (std::size_t i = 0; i < contours.size(); i++)
+            {
+                if (contours[i].alive)
+                    RemoveContour(ContourId(i), on_removed);
+            }
+            for (ivec2 tile_pos : vector_range(region_size))
+                AddRetraceTile(tile_pos);
+            Retrace(input, on_added, std::forward<IsConnectedFunc>(is_connected));
+        }
 
-                    if (mode == Mode::closed)
-                    {
-                        PointEmittingLoop(true);
-                    }
-                    else // mode == Mode::open
-                    {
-                        // Backtrack until we go out of bounds or do a full circle.
-                        do
-                        {
-                            MoveToNextEdge(cursor, false);
-                        }
-                        while (!CursorIsAtStart() && TileIsInBounds(cursor.tile_pos));
+        // Updates the contours after the tiles in `changed_tiles` have changed. The tiles can repeat.
+        // In `Mode::open`, the tiles can be one tile outside of the region.
+        // If `is_connected` depends on something other than the tiles, report the tiles where its result changes.
+        template <typename IsConnectedFunc = std::nullptr_t>
+        void Update(auto &&input, std::span<const ivec2> changed_tiles, auto &&on_removed, auto &&on_added, IsConnectedFunc &&is_connected = nullptr)
+        {
+            // The contours depend on the adjacent tiles (to check which edges are covered), so we also retrace around the changed tiles.
+            for (ivec2 changed_tile : changed_tiles)
+            for (ivec2 offset : vector_range(ivec2(3)))
+            {
+                ivec2 tile_pos = changed_tile + offset - 1;
+                if (!tile_contours.pos_in_range(tile_pos))
+                    continue;
+                // Copy the list, since the removal modifies it.
+                for (ContourId id : std::vector<ContourId>(tile_contours.at(tile_pos)))
+                    RemoveContour(id, on_removed);
+                AddRetraceTile(tile_pos);
+            }
+            Retrace(input, on_added, std::forward<IsConnectedFunc>(is_connected));
+        }
 
-                        // Then start emitting points.
-                        PointEmittingLoop(CursorIsAtStart());
-                    }
+        [[nodiscard]] const Contour &GetContour(ContourId id) const
+        {
+            ASSERT(std::to_underlying(id) < contours.size() && contours[std::to_underlying(id)].alive);
+            return contours[std::to_underlying(id)].contour;
+        }
 
-                    return false;
-                });
+        // Calls `func` for every contour. `func` is `(ContourId id, const Contour &contour) -> void`.
+        void ForEachContour(auto &&func) const
+        {
+            for (std::size_t i = 0; i < contours.size(); i++)
+            {
+                if (contours[i].alive)
+                    func(ContourId(i), std::as_const(contours[i].contour));
             }
         }
+
+        [[nodiscard]] std::size_t ContourCount() const
+        {
+            return contours.size() - free_contours.size();
+        }
+    };
+
+    struct ParallelParams
+    {
+        // The map is split into chunks of this size, which are converted independently.
+        ivec2 chunk_size = ivec2(64);
+        // The max number of jobs running at once on `Jobs::GlobalPool()`. If zero or less, uses the concurrency of the pool.
+        int num_threads = 0;
+    };
+
+    namespace impl
+    {
+        // The `Mode::open` output of a single chunk, in map coordinates.
+        struct ChunkContours
+        {
+            std::vector<ivec2> points;
+            std::vector<PointInfo> infos;
+        };
+
+        // Calls `func(i)` for `i` in `0..count-1` on `Jobs::GlobalPool()`. Rethrows the first exception, if any.
+        void ParallelFor(std::size_t count, int num_threads, const std::function<void(std::size_t i)> &func);
+
+        // Joins the open contours of the chunks across the chunk borders. Returns all contours in the `Mode::closed` format.
+        // The result only depends on the order of the chunks.
+        [[nodiscard]] ChunkContours StitchChunkContours(std::span<const ChunkContours> chunks);
+    }
+
+    // Same as `ConvertTilesToEdges()` with `Mode::closed`, but splits the map into chunks, converts them on several threads,
+    //   and then joins the contours crossing the chunk borders.
+    // Produces the same loops, but the loops can start from different points, and come in a different order. The result is deterministic.
+    // `input` and `is_connected` (see `ConvertTilesToEdges()`) are called from several threads at once. `output` is called on this thread.
+    template <typename IsConnectedFunc = std::nullptr_t>
+    void ConvertTilesToEdgesParallel(const BakedTileset &tileset, ivec2 map_size, auto &&input, auto &&output, const ParallelParams &params = {}, IsConnectedFunc &&is_connected = nullptr)
+    {
+        ASSERT(params.chunk_size(all) > 0, "Invalid chunk size.");
+
+        const ivec2 chunk_count = (map_size + params.chunk_size - 1) / params.chunk_size;
+        std::vector<impl::ChunkContours> chunks(std::size_t(chunk_count.prod()));
+
+        impl::ParallelFor(chunks.size(), params.num_threads, [&](std::size_t i)
+        {
+            const ivec2 chunk_offset = ivec2(int(i) % chunk_count.x, int(i) / chunk_count.x) * params.chunk_size;
+            const ivec2 region_size = min(params.chunk_size, map_size - chunk_offset);
+            // Read one tile outside of the chunk, but not outside of the map.
+            const irect2 existing_tiles = (-chunk_offset).rect_size(map_size).intersect(impl::ExistingTiles(Mode::open, region_size));
+
+            auto chunk_is_connected = [&]
+            {
+                if constexpr (std::is_null_pointer_v<std::remove_cvref_t<IsConnectedFunc>>)
+                    return nullptr;
+                else
+                    return [&](ivec2 pos, int loop_index, ivec2 offset, int other_loop_index){return is_connected(pos + chunk_offset, loop_index, offset, other_loop_index);};
+            }();
+
+            impl::ChunkContours &chunk = chunks[i];
+            Array2D<impl::EdgeBitMaskType> visited_edges(region_size);
+            impl::TraceContours<decltype(chunk_is_connected), std::nullptr_t>(tileset, Mode::open, region_size, existing_tiles, vector_range(region_size), visited_edges,
+                [&](ivec2 pos){return input(pos + chunk_offset);},
+                [&](ivec2 pos, PointInfo info)
+                {
+                    chunk.points.push_back(pos + chunk_offset * tileset.tile_size);
+                    chunk.infos.push_back(info);
+                },
+                std::move(chunk_is_connected), nullptr, [](ivec2, BakedTileset::EdgeId){}
+            );
+        });
+
+        const impl::ChunkContours result = impl::StitchChunkContours(chunks);
+        for (std::size_t i = 0; i < result.points.size(); i++)
+            output(result.points[i], result.infos[i]);
     }
 }
@@ -0,0 +1,218 @@
+#include "tiles_to_edges.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    using namespace Geom::TilesToEdges;
+
+    // Tile 0 is empty, tile 1 is a full square.
+    [[nodiscard]] BakedTileset MakeTileset()
+    {
+        Tileset tileset;
+        tileset.tile_size = ivec2(4);
+        tileset.vertices = {ivec2(0, 0), ivec2(4, 0), ivec2(4, 4), ivec2(0, 4)};
+        tileset.tiles = {{}, {{0, 1, 2, 3}}};
+        return BakedTileset(std::move(tileset));
+    }
+
+    // Makes the closed contours start from the smallest point, and sorts the contours, to make them comparable.
+    [[nodiscard]] std::vector<std::vector<ivec2>> Normalize(std::vector<std::vector<ivec2>> contours, const std::vector<bool> &closed)
+    {
+        for (std::size_t i = 0; i < contours.size(); i++)
+        {
+            if (!closed[i])
+                continue;
+            std::vector<ivec2> &points = contours[i];
+            points.pop_back(); // The first point is repeated at the end.
+            std::rotate(points.begin(), std::min_element(points.begin(), points.end(), [](ivec2 a, ivec2 b){return std::pair(a.x, a.y) < std::pair(b.x, b.y);}), points.end());
+        }
+        std::sort(contours.begin(), contours.end(), [](const auto &a, const auto &b)
+        {
+            return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](ivec2 a, ivec2 b){return std::pair(a.x, a.y) < std::pair(b.x, b.y);});
+        });
+        return contours;
+    }
+
+    // Calls `convert(output)` and returns the normalized contours.
+    [[nodiscard]] std::vector<std::vector<ivec2>> CollectContours(auto &&convert)
+    {
+        std::vector<std::vector<ivec2>> contours;
+        std::vector<bool> closed;
+        bool contour_finished = true;
+        convert([&](ivec2 pos, Geom::PointInfo info)
+        {
+            if (contour_finished)
+            {
+                contours.emplace_back();
+                closed.push_back(info.closed);
+            }
+            contours.back().push_back(pos);
+            contour_finished = info.type == Geom::PointType::last;
+        });
+        return Normalize(std::move(contours), closed);
+    }
+}
+
+TEST_CASE("tiles_to_edges.incremental")
+{
+    const BakedTileset tileset = MakeTileset();
+    std::mt19937 gen(42);
+
+    for (Mode mode : {Mode::closed, Mode::open})
+    {
+        CAPTURE(int(mode));
+
+        const ivec2 size(12, 10);
+        // With one extra tile on each side, for `Mode::open`.
+        Array2D<int> map(xvec2(size + 2));
+        for (ivec2 pos : vector_range(size + 2))
+            map.at(pos) = std::uniform_int_distribution(0, 1)(gen);
+        auto input = [&](ivec2 pos){return map.at(pos + 1);};
+
+        IncrementalConverter converter(tileset, mode, size);
+        converter.Rebuild(input, [](auto, auto &){FAIL("Nothing to remove.");}, [](auto, auto &){});
+
+        for (int i = 0; i < 50; i++)
+        {
+            std::vector<ivec2> changed;
+            int count = std::uniform_int_distribution(1, 3)(gen);
+            for (int j = 0; j < count; j++)
+            {
+                ivec2 pos(std::uniform_int_distribution(-1, size.x)(gen), std::uniform_int_distribution(-1, size.y)(gen));
+                if (mode == Mode::closed)
+                    clamp_var(pos, 0, size - 1);
+                map.at(pos + 1) ^= 1;
+                changed.push_back(pos);
+            }
+
+            converter.Update(input, changed, [](auto, auto &){}, [](auto, auto &){});
+
+            std::vector<std::vector<ivec2>> expected = CollectContours([&](auto &&output){ConvertTilesToEdges(tileset, mode, size, input, output);});
+
+            std::vector<std::vector<ivec2>> actual;
+            std::vector<bool> actual_closed;
+            converter.ForEachContour([&](IncrementalConverter::ContourId, const IncrementalConverter::Contour &contour)
+            {
+                actual.push_back(contour.points);
+                actual_closed.push_back(contour.closed);
+            });
+
+            REQUIRE(Normalize(std::move(actual), actual_closed) == expected);
+        }
+    }
+}
+
+TEST_CASE("tiles_to_edges.parallel")
+{
+    const BakedTileset tileset = MakeTileset();
+    std::mt19937 gen(42);
+
+    const ivec2 size(37, 29);
+    Array2D<int> map(size);
+    for (ivec2 pos : vector_range(size))
+        map.at(pos) = std::uniform_int_distribution(0, 2)(gen) != 0;
+    auto input = [&](ivec2 pos){return map.at(pos);};
+
+    std::vector<std::vector<ivec2>> expected = CollectContours([&](auto &&output){ConvertTilesToEdges(tileset, Mode::closed, size, input, output);});
+
+    for (ivec2 chunk_size : {ivec2(1), ivec2(3, 4), ivec2(16), ivec2(64)})
+    {
+        CAPTURE(chunk_size);
+        std::vector<std::vector<ivec2>> actual = CollectContours([&](auto &&output)
+        {
+            ConvertTilesToEdgesParallel(tileset, size, input, output, {.chunk_size = chunk_size, .num_threads = 4});
+        });
+        REQUIRE(actual == expected);
+    }
+}
+
+TEST_CASE("tiles_to_edges.baked_tileset_serialization")
+{
+    const BakedTileset tileset = MakeTileset();
+
+    std::string blob;
+    Stream::Output output = Stream::Output::Container(blob);
+    tileset.Save(output);
+    output.Flush();
+
+    const BakedTileset loaded = BakedTileset::Load(Stream::ReadOnlyData::mem_reference(blob));
+    REQUIRE(loaded.tile_size == tileset.tile_size);
+    REQUIRE(loaded.vertices == tileset.vertices);
+    REQUIRE(loaded.NumEdgeTypes() == tileset.NumEdgeTypes());
+    REQUIRE(loaded.NumTileTypes() == tileset.NumTileTypes());
+    for (std::uint32_t tile = 0; tile < tileset.NumTileTypes(); tile++)
+    {
+        REQUIRE(loaded.GetTileStartingEdges(BakedTileset::TileId(tile)) == tileset.GetTileStartingEdges(BakedTileset::TileId(tile)));
+        for (std::uint32_t edge = 0; edge < tileset.NumEdgeTypes(); edge++)
+        {
+            const auto &a = loaded.GetPerTileEdgeInfo(BakedTileset::TileId(tile), BakedTileset::EdgeId(edge));
+            const auto &b = tileset.GetPerTileEdgeInfo(BakedTileset::TileId(tile), BakedTileset::EdgeId(edge));
+            REQUIRE((a.prev == b.prev && a.next == b.next && a.loop_index == b.loop_index));
+        }
+    }
+
+    // The loaded tileset produces the same contours.
+    std::mt19937 gen(42);
+    const ivec2 size(20, 15);
+    Array2D<int> map(size);
+    for (ivec2 pos : vector_range(size))
+        map.at(pos) = std::uniform_int_distribution(0, 1)(gen);
+    auto input = [&](ivec2 pos){return map.at(pos);};
+    REQUIRE(CollectContours([&](auto &&output){ConvertTilesToEdges(loaded, Mode::closed, size, input, output);})
+        == CollectContours([&](auto &&output){ConvertTilesToEdges(tileset, Mode::closed, size, input, output);}));
+
+    // Rejects garbage and truncated data.
+    std::string garbage = "not a tileset, definitely not";
+    REQUIRE_THROWS(BakedTileset::Load(Stream::ReadOnlyData::mem_reference(garbage)));
+    for (std::size_t size = 0; size < blob.size(); size++)
+    {
+        CAPTURE(size);
+        REQUIRE_THROWS(BakedTileset::Load(Stream::ReadOnlyData::mem_reference(std::string_view(blob).substr(0, size))));
+    }
+
+    // Corrupted data either throws or loads.
+    for (int i = 0; i < 1000; i++)
+    {
+        std::string corrupted = blob;
+        corrupted[gen() % corrupted.size()] = char(gen());
+        try
+        {
+            (void)BakedTileset::Load(Stream::ReadOnlyData::mem_reference(corrupted));
+        }
+        catch (std::runtime_error &) {}
+    }
+}
+
+TEST_CASE("tiles_to_edges.baked_tileset_serialization_no_edges")
+{
+    // A tileset without edges, so the tile count is the last thing that bounds the allocations.
+    Tileset source;
+    source.tile_size = ivec2(4);
+    source.tiles = {{}, {}};
+    const BakedTileset tileset(std::move(source));
+    REQUIRE(tileset.NumEdgeTypes() == 0);
+
+    std::string blob;
+    Stream::Output output = Stream::Output::Container(blob);
+    tileset.Save(output);
+    output.Flush();
+
+    const BakedTileset loaded = BakedTileset::Load(Stream::ReadOnlyData::mem_reference(blob));
+    REQUIRE(loaded.NumTileTypes() == 2);
+    REQUIRE(loaded.GetTileStartingEdges(BakedTileset::TileId(1)).empty());
+
+    // The tile count is followed by one starting edge count per tile. A huge tile count must be rejected before allocating.
+    std::string corrupted = blob;
+    std::uint32_t huge_count = 0xffffffff;
+    std::memcpy(corrupted.data() + corrupted.size() - sizeof(std::uint32_t) * 3, &huge_count, sizeof huge_count);
+    REQUIRE_THROWS_WITH(BakedTileset::Load(Stream::ReadOnlyData::mem_reference(corrupted)), doctest::Contains("out of bounds"));
+}
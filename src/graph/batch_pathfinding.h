@@ -0,0 +1,200 @@
+#pragma once
+
+#include "graph/pathfinding.h"
+#include "utils/alloc_tracker.h"
+#include "utils/jobs.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+// This header implements solving many independent path queries at once, split between the threads of `Jobs::GlobalPool()`.
+// The queries are split between several workers, and every worker reuses its own pathfinder between the batches, preserving its capacity.
+// The resulting paths are written to a single contiguous buffer, so a batch doesn't allocate per path (after the buffers grow enough).
+// For example:
+//   BatchPathfinder<Pathfinder_4Way<ivec2>> batch;
+//   BatchPathfinder<Pathfinder_4Way<ivec2>>::Results results;
+//   batch.Solve(queries, [&](ivec2 pos){return layer.at(pos) != 0;}, results);
+//   for (std::size_t i = 0; i < queries.size(); i++)
+//       if (results.Found(i)) for (ivec2 pos : results.Path(i)) ...
+
+namespace Graph::Pathfinding
+{
+    // `PathfinderType` is a pathfinder with a `Step(CoordType goal, auto &&tile_is_solid)` overload, such as `Pathfinder_4Way` or `Pathfinder_4WayJps`.
+    template <typename PathfinderType>
+    class BatchPathfinder
+    {
+      public:
+        using pathfinder_t = PathfinderType;
+        using coord_t = typename PathfinderType::coord_t;
+
+        struct Query
+        {
+            coord_t start{};
+            coord_t goal{};
+        };
+
+        // The results of a batch. Reuse the same object between the batches to preserve its capacity.
+        class Results
+        {
+            friend BatchPathfinder;
+
+            struct Entry
+            {
+                bool found = false;
+                // The range in `points`.
+                std::size_t begin = 0;
+                std::size_t end = 0;
+            };
+
+            std::vector<Entry> entries;
+            std::vector<coord_t> points;
+
+          public:
+            // The number of queries in the last batch.
+            [[nodiscard]] std::size_t size() const {return entries.size();}
+
+            // Whether the path for the query with this index was found.
+            [[nodiscard]] bool Found(std::size_t index) const
+            {
+                return entries.at(index).found;
+            }
+
+            // The path for the query with this index, from the start to the goal (both inclusive). Empty if not found.
+            [[nodiscard]] std::span<const coord_t> Path(std::size_t index) const
+            {
+                const Entry &entry = entries.at(index);
+                return std::span(points).subspan(entry.begin, entry.end - entry.begin);
+            }
+
+            // All paths one after another, in the order of the queries.
+            [[nodiscard]] std::span<const coord_t> AllPoints() const
+            {
+                return points;
+            }
+        };
+
+      private:
+        struct Worker
+        {
+            PathfinderType pathfinder;
+            // The paths found by this worker, in the order of its queries.
+            std::vector<coord_t> points;
+            // The number of steps taken in the last batch, for statistics.
+            std::size_t num_steps = 0;
+        };
+
+        std::vector<Worker> workers;
+
+      public:
+        // Makes `num_threads` workers, each worker is a job for `Jobs::GlobalPool()`. If it's zero, uses `Jobs::GlobalPool().Concurrency()`.
+        // `make_pathfinder` is `() -> PathfinderType`, called once per worker. Use it to reserve capacity or to pass a custom node info storage.
+        BatchPathfinder(int num_threads, auto &&make_pathfinder)
+        {
+            if (num_threads <= 0)
+                num_threads = Jobs::GlobalPool().Concurrency();
+            workers.reserve(std::size_t(num_threads));
+            for (int i = 0; i < num_threads; i++)
+                workers.push_back({.pathfinder = make_pathfinder(), .points = {}});
+        }
+
+        // Makes `num_threads` workers with pathfinders of the specified starting capacity.
+        explicit BatchPathfinder(int num_threads = 0, std::size_t starting_capacity = 16)
+            : BatchPathfinder(num_threads, [&]{return PathfinderType(starting_capacity);})
+        {}
+
+        [[nodiscard]] int NumThreads() const
+        {
+            return int(workers.size());
+        }
+
+        // The total number of pathfinding steps in the last batch.
+        [[nodiscard]] std::size_t NumSteps() const
+        {
+            std::size_t ret = 0;
+            for (const Worker &worker : workers)
+                ret += worker.num_steps;
+            return ret;
+        }
+
+        // Solves all `queries`, writing the paths to `results`.
+        // `tile_is_solid` is `(coord_t pos) -> bool`, it's called from several threads at once, so it must not modify anything.
+        // `max_steps_per_query` limits the number of steps per query, when it's exhausted, the path is considered not found.
+        // Each worker gets a contiguous range of queries.
+        // If anything throws in any worker, waits for all workers to finish, then rethrows the first exception.
+        void Solve(std::span<const Query> queries, auto &&tile_is_solid, Results &results, std::size_t max_steps_per_query = std::numeric_limits<std::size_t>::max())
+        {
+            results.entries.assign(queries.size(), {});
+            results.points.clear();
+
+            int num_threads = std::clamp(int(queries.size()), 1, NumThreads());
+
+            auto ProcessWorker = [&](std::size_t worker_index)
+            {
+                IMP_TRACE_ZONE("BatchPathfinder::Solve");
+                IMP_ALLOC_SCOPE("pathfinding");
+                Worker &worker = workers[worker_index];
+                worker.points.clear();
+                worker.num_steps = 0;
+
+                std::size_t begin = queries.size() * worker_index / std::size_t(num_threads);
+                std::size_t end = queries.size() * (worker_index + 1) / std::size_t(num_threads);
+                for (std::size_t query_index = begin; query_index < end; query_index++)
+                {
+                    const Query &query = queries[query_index];
+                    typename Results::Entry &entry = results.entries[query_index];
+
+                    // Search from the goal towards the start, so that dumping the path backwards gives it in the right order.
+                    worker.pathfinder.SetNewTask(query.goal);
+                    std::size_t steps = 0;
+                    while (worker.pathfinder.HasUnvisitedNodes() && steps < max_steps_per_query)
+                    {
+                        if (worker.pathfinder.CurrentNode() == query.start)
+                        {
+                            entry.found = true;
+                            break;
+                        }
+                        worker.pathfinder.Step(query.start, tile_is_solid);
+                        steps++;
+                    }
+                    worker.num_steps += steps;
+
+                    // Those are offsets in the worker's buffer for now, they are adjusted after joining.
+                    entry.begin = worker.points.size();
+                    if (entry.found)
+                        worker.pathfinder.DumpPathBackwards(query.start, [&](const coord_t &pos){worker.points.push_back(pos);});
+                    entry.end = worker.points.size();
+                }
+            };
+
+            // One job per worker. This waits for all of them, and rethrows the first exception.
+            Jobs::ParallelFor(Jobs::GlobalPool(), 0, std::size_t(num_threads), ProcessWorker);
+
+            // Concatenate the paths.
+            std::size_t total_points = 0;
+            for (int i = 0; i < num_threads; i++)
+                total_points += workers[std::size_t(i)].points.size();
+            results.points.reserve(total_points);
+
+            for (int i = 0; i < num_threads; i++)
+            {
+                std::size_t offset = results.points.size();
+                std::size_t begin = queries.size() * std::size_t(i) / std::size_t(num_threads);
+                std::size_t end = queries.size() * std::size_t(i + 1) / std::size_t(num_threads);
+                for (std::size_t query_index = begin; query_index < end; query_index++)
+                {
+                    results.entries[query_index].begin += offset;
+                    results.entries[query_index].end += offset;
+                }
+
+                const std::vector<coord_t> &points = workers[std::size_t(i)].points;
+                results.points.insert(results.points.end(), points.begin(), points.end());
+            }
+        }
+    };
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+#include "program/errors.h"
+#include "utils/mat.h"
+#include "utils/multiarray.h"
+
+#include <parallel_hashmap/phmap.h>
+
+#include <algorithm>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+
+// This header implements flow fields, for many agents moving to the same goal (or to the closest one of several goals).
+// It's a multi-source Dijkstra's search from the goals over a bounded grid, which stores the cost and the next tile for every reachable tile.
+// Then every agent reads its next step in O(1), instead of running its own search.
+
+namespace Graph::Pathfinding
+{
+    // `CoordType` is an integral vector. `CostType` is the cost type, must overload `+` and `<`, and be default-constructible to zero.
+    template <typename CoordType = ivec2, typename CostType = typename CoordType::type>
+    class FlowField
+    {
+        static_assert(Math::vector<CoordType> && std::is_integral_v<typename CoordType::type>, "The coordinate type must be an integral vector.");
+
+      public:
+        using coord_t = CoordType;
+        using cost_t = CostType;
+        using rect_type = typename CoordType::rect_type;
+
+      private:
+        struct Cell
+        {
+            bool reached = false;
+            // The cost to the closest goal.
+            CostType cost{};
+            // The next tile towards the goal. For the goals, points to themselves.
+            CoordType next{};
+            // The goal this tile leads to.
+            CoordType source{};
+        };
+
+        struct QueueEntry
+        {
+            CostType cost{};
+            CoordType coord{};
+        };
+
+        using array_t = MultiArray<CoordType::size, Cell>;
+        using index_t = typename array_t::index_t;
+
+        CoordType offset{};
+        array_t cells;
+        phmap::flat_hash_set<CoordType> goals;
+
+        // This is reused to preserve capacity.
+        std::vector<QueueEntry> queue;
+
+        [[nodiscard]] Cell *FindCell(CoordType pos)
+        {
+            auto index = (pos - offset).template to<index_t>();
+            return cells.pos_in_range(index) ? &cells.at(index) : nullptr;
+        }
+        [[nodiscard]] const Cell *FindCell(CoordType pos) const
+        {
+            return const_cast<FlowField *>(this)->FindCell(pos);
+        }
+
+        void Push(CostType cost, CoordType coord)
+        {
+            queue.push_back({.cost = std::move(cost), .coord = coord});
+            std::ranges::push_heap(queue, std::greater{}, &QueueEntry::cost);
+        }
+
+        // Runs the search until the queue is empty. Only ever lowers the costs of the tiles.
+        void Propagate(auto &neighbors)
+        {
+            while (!queue.empty())
+            {
+                QueueEntry entry = std::move(queue.front());
+                std::ranges::pop_heap(queue, std::greater{}, &QueueEntry::cost);
+                queue.pop_back();
+
+                const Cell &cell = *FindCell(entry.coord);
+                if (cell.cost < entry.cost)
+                    continue; // An outdated entry.
+                CoordType source = cell.source;
+
+                neighbors(std::as_const(entry.coord), [&](CoordType neighbor_coord, CostType step_cost)
+                {
+                    Cell *neighbor = FindCell(neighbor_coord);
+                    if (!neighbor)
+                        return; // Out of bounds.
+
+                    CostType new_cost = entry.cost + step_cost;
+                    if (neighbor->reached && !(new_cost < neighbor->cost))
+                        return;
+
+                    neighbor->reached = true;
+                    neighbor->cost = new_cost;
+                    neighbor->next = entry.coord;
+                    neighbor->source = source;
+                    Push(std::move(new_cost), neighbor_coord);
+                });
+            }
+        }
+
+        // Makes `pos` a goal, if it has a lower cost than it had before.
+        void SeedGoal(CoordType pos)
+        {
+            Cell *cell = FindCell(pos);
+            if (!cell)
+                throw std::runtime_error(FMT("Flow field goal {} is out of bounds.", pos));
+            if (cell->reached && !(CostType{} < cell->cost))
+                return;
+            cell->reached = true;
+            cell->cost = CostType{};
+            cell->next = pos;
+            cell->source = pos;
+            Push(CostType{}, pos);
+        }
+
+      public:
+        // Constructs an empty field of size zero.
+        FlowField() {}
+
+        // Constructs a field covering `bounds`, with no goals (everything is unreachable).
+        explicit FlowField(rect_type bounds)
+            : offset(bounds.a), cells(bounds.size().template to<index_t>())
+        {}
+
+        // The tiles covered by this field.
+        [[nodiscard]] rect_type Bounds() const
+        {
+            return offset.rect_size(cells.size().template to<typename CoordType::type>());
+        }
+
+        // The current goals.
+        [[nodiscard]] const phmap::flat_hash_set<CoordType> &Goals() const
+        {
+            return goals;
+        }
+
+        // Recomputes the field from scratch.
+        // `neighbors` is the same as in `Pathfinder::Step()`: `(CoordType pos, auto func) -> void`, where `func` must be called for every
+        //   viable neighbor of `pos`, it's `(CoordType neighbor_coord, CostType step_cost) -> void`. The neighbors out of bounds are ignored.
+        // Since we search from the goals outwards, the step costs must be symmetric (moving `a -> b` must cost the same as `b -> a`).
+        // Throws if any goal is out of bounds.
+        void Build(std::span<const CoordType> new_goals, auto &&neighbors)
+        {
+            std::fill_n(cells.elements(), cells.element_count(), Cell{});
+            goals.clear();
+            queue.clear();
+
+            for (CoordType goal : new_goals)
+            {
+                goals.insert(goal);
+                SeedGoal(goal);
+            }
+            Propagate(neighbors);
+        }
+
+        // Changes the goals, and incrementally updates the field. The parameters are the same as in `Build()`.
+        // The tiles closer to the added goals than to the existing ones, and the tiles that led to the removed goals, are recomputed.
+        // This is a lot cheaper than `Build()` if most removed goals are replaced with nearby ones, or if there are many goals and only a few of them change.
+        void UpdateGoals(std::span<const CoordType> new_goals, auto &&neighbors)
+        {
+            phmap::flat_hash_set<CoordType> new_goal_set(new_goals.begin(), new_goals.end());
+            phmap::flat_hash_set<CoordType> removed_goals;
+            for (CoordType goal : goals)
+            {
+                if (!new_goal_set.contains(goal))
+                    removed_goals.insert(goal);
+            }
+
+            // Lower the costs around the added goals.
+            queue.clear();
+            for (CoordType goal : new_goal_set)
+            {
+                if (!goals.contains(goal))
+                    SeedGoal(goal);
+            }
+            goals = std::move(new_goal_set);
+            Propagate(neighbors);
+
+            if (removed_goals.empty())
+                return;
+
+            // Invalidate everything that still leads to the removed goals.
+            std::vector<CoordType> invalidated;
+            for (auto pos : vector_range(cells.size()))
+            {
+                Cell &cell = cells.at(pos);
+                if (cell.reached && removed_goals.contains(cell.source))
+                {
+                    cell = {};
+                    invalidated.push_back(pos.template to<typename CoordType::type>() + offset);
+                }
+            }
+
+            // Continue the search into the invalidated area from its borders.
+            for (CoordType pos : invalidated)
+            {
+                neighbors(std::as_const(pos), [&](CoordType neighbor_coord, CostType step_cost)
+                {
+                    const Cell *neighbor = FindCell(neighbor_coord);
+                    if (!neighbor || !neighbor->reached)
+                        return;
+
+                    Cell &cell = *FindCell(pos);
+                    CostType new_cost = neighbor->cost + step_cost;
+                    if (cell.reached && !(new_cost < cell.cost))
+                        return;
+
+                    cell.reached = true;
+                    cell.cost = new_cost;
+                    cell.next = neighbor_coord;
+                    cell.source = neighbor->source;
+                    Push(std::move(new_cost), pos);
+                });
+            }
+            Propagate(neighbors);
+        }
+
+        // Returns true if the tile can reach a goal. Returns false for the tiles out of bounds.
+        [[nodiscard]] bool IsReachable(CoordType pos) const
+        {
+            const Cell *cell = FindCell(pos);
+            return cell && cell->reached;
+        }
+
+        // Returns the cost from this tile to the closest goal. Throws if the tile is unreachable.
+        [[nodiscard]] const CostType &Cost(CoordType pos) const
+        {
+            return GetReachableCell(pos).cost;
+        }
+
+        // Returns the next tile towards the closest goal. For the goals, returns the same tile. Throws if the tile is unreachable.
+        [[nodiscard]] CoordType NextTile(CoordType pos) const
+        {
+            return GetReachableCell(pos).next;
+        }
+
+        // Returns the direction towards the next tile, `NextTile(pos) - pos`. Returns zero for the goals and the unreachable tiles.
+        [[nodiscard]] CoordType Direction(CoordType pos) const
+        {
+            const Cell *cell = FindCell(pos);
+            return cell && cell->reached ? cell->next - pos : CoordType{};
+        }
+
+        // Returns the goal that this tile leads to. Throws if the tile is unreachable.
+        [[nodiscard]] CoordType Goal(CoordType pos) const
+        {
+            return GetReachableCell(pos).source;
+        }
+
+      private:
+        [[nodiscard]] const Cell &GetReachableCell(CoordType pos) const
+        {
+            const Cell *cell = FindCell(pos);
+            if (!cell || !cell->reached)
+                throw std::runtime_error(FMT("Tile {} is unreachable in the flow field.", pos));
+            return *cell;
+        }
+    };
+}
@@ -0,0 +1,435 @@
+#pragma once
+
+#include "graph/pathfinding.h"
+#include "program/errors.h"
+#include "utils/mat.h"
+#include "utils/multiarray.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// This header implements hierarchical pathfinding (HPA*) for 4-way grid movement.
+// The map is split into rectangular clusters. The free tiles on both sides of each cluster border become "entrances",
+//   and the path costs between the entrances of each cluster are precomputed (with `Pathfinder`).
+// A query first finds a path on this abstract graph, which is cheap, and then refines it into tiles one segment at a time,
+//   each segment staying inside of a single cluster.
+// The resulting paths are near-optimal, but not always the shortest.
+// For example, for a `Tiled::TileLayer layer`, where non-zero tiles are solid:
+//   HierarchicalPathfinder_4Way<ivec2> p(irect2(layer.bounds()), ivec2(16), [&](ivec2 pos){return layer.at(pos) != 0;});
+
+namespace Graph::Pathfinding
+{
+    template <typename CoordType = ivec2>
+    class HierarchicalPathfinder_4Way
+    {
+        static_assert(Math::vector<CoordType> && CoordType::size == 2 && std::is_integral_v<typename CoordType::type>, "The coordinate type must be a 2D integral vector.");
+
+      public:
+        using coord_t = CoordType;
+        using cost_t = typename CoordType::type;
+        using rect_type = typename CoordType::rect_type;
+
+        // Border runs of free tiles this long or longer get two entrances (at both ends), shorter runs get one in the middle.
+        // This is the value from the original HPA* paper.
+        static constexpr cost_t long_entrance_len = 6;
+
+      private:
+        // Marks unreachable pairs of entrances.
+        static constexpr cost_t unreachable = -1;
+
+        struct Entrance
+        {
+            CoordType pos;
+            // The tiles in the neighboring clusters this entrance connects to. They are entrances of those clusters.
+            std::vector<CoordType> across;
+
+            [[nodiscard]] friend bool operator==(const Entrance &, const Entrance &) = default;
+        };
+
+        struct Cluster
+        {
+            std::vector<Entrance> entrances;
+            // `costs[i * entrances.size() + j]` is the cost from entrance `i` to entrance `j`, or `unreachable`.
+            std::vector<cost_t> costs;
+        };
+
+        rect_type bounds;
+        CoordType cluster_size;
+
+        using array_t = MultiArray<2, Cluster>;
+        using index_t = typename array_t::index_t;
+        array_t clusters;
+
+        // Those are reused between queries to preserve their capacity.
+        Pathfinder<CoordType, cost_t> dijkstra_pathfinder;
+        Pathfinder_4Way<CoordType> local_pathfinder;
+        Pathfinder<CoordType, cost_t, std::pair<cost_t, cost_t>> abstract_pathfinder;
+        std::vector<CoordType> temp_path;
+
+        [[nodiscard]] CoordType ClusterOf(CoordType pos) const
+        {
+            return div_ex(pos - bounds.a, cluster_size);
+        }
+
+        [[nodiscard]] Cluster &GetCluster(CoordType cluster)
+        {
+            return clusters.at(cluster.template to<index_t>());
+        }
+        [[nodiscard]] const Cluster &GetCluster(CoordType cluster) const
+        {
+            return clusters.at(cluster.template to<index_t>());
+        }
+
+        [[nodiscard]] const Entrance *FindEntrance(const Cluster &cluster, CoordType pos) const
+        {
+            auto it = std::find_if(cluster.entrances.begin(), cluster.entrances.end(), [&](const Entrance &e){return e.pos == pos;});
+            return it == cluster.entrances.end() ? nullptr : &*it;
+        }
+
+        // Calls `func(inner, outer)` for every transition through the border of `cluster` in direction `dir` (for `CoordType::dir4()`).
+        // This gives consistent results when called for the both sides of the same border.
+        template <typename S, typename F>
+        void ForEachTransition(CoordType cluster, int dir, S &is_solid, F &&func) const
+        {
+            rect_type rect = ClusterRect(cluster);
+            CoordType step = CoordType::dir4(dir);
+            int axis = dir % 2; // The axis perpendicular to the border.
+
+            // The first tile along the border, on the inner side.
+            CoordType first = step[axis] > 0 ? rect.b - 1 : rect.a;
+            first[!axis] = rect.a[!axis];
+            cost_t len = rect.size()[!axis];
+
+            if (!bounds.contains(first + step))
+                return;
+
+            CoordType along{};
+            along[!axis] = 1;
+
+            // Make the sides of the border consistent by always walking the lower-coordinate side.
+            // The tile on the other side is `+ step`, or `- step` if we're walking from the other side.
+            CoordType lower_first = step[axis] > 0 ? first : first + step;
+            CoordType border_step = step[axis] > 0 ? step : -step;
+
+            auto EmitTransition = [&](cost_t i)
+            {
+                CoordType lower = lower_first + along * i;
+                if (step[axis] > 0)
+                    func(lower, lower + border_step);
+                else
+                    func(lower + border_step, lower);
+            };
+
+            cost_t run_start = -1;
+            for (cost_t i = 0; i <= len; i++)
+            {
+                bool free = i < len && !is_solid(lower_first + along * i) && !is_solid(lower_first + along * i + border_step);
+                if (free && run_start == -1)
+                {
+                    run_start = i;
+                }
+                else if (!free && run_start != -1)
+                {
+                    cost_t run_len = i - run_start;
+                    if (run_len >= long_entrance_len)
+                    {
+                        EmitTransition(run_start);
+                        EmitTransition(i - 1);
+                    }
+                    else
+                    {
+                        EmitTransition(run_start + (run_len - 1) / 2);
+                    }
+                    run_start = -1;
+                }
+            }
+        }
+
+        // Returns the new entrance list for a cluster.
+        template <typename S>
+        [[nodiscard]] std::vector<Entrance> ComputeEntrances(CoordType cluster, S &is_solid) const
+        {
+            std::vector<Entrance> ret;
+            for (int dir = 0; dir < 4; dir++)
+            {
+                ForEachTransition(cluster, dir, is_solid, [&](CoordType inner, CoordType outer)
+                {
+                    auto it = std::find_if(ret.begin(), ret.end(), [&](const Entrance &e){return e.pos == inner;});
+                    if (it == ret.end())
+                        it = ret.insert(ret.end(), {.pos = inner, .across = {}});
+                    it->across.push_back(outer);
+                });
+            }
+            return ret;
+        }
+
+        // Runs Dijkstra's search from `start` inside of `rect`, then calls `func(i, cost)` for every target `i` that was reached.
+        template <typename S, typename F>
+        void CostsInsideRect(CoordType start, rect_type rect, S &is_solid, const std::vector<Entrance> &targets, F &&func)
+        {
+            dijkstra_pathfinder.SetNewTask(start);
+            while (dijkstra_pathfinder.HasUnvisitedNodes())
+            {
+                dijkstra_pathfinder.Step(
+                    [&](CoordType pos, auto step)
+                    {
+                        for (int i = 0; i < 4; i++)
+                        {
+                            CoordType next = pos + CoordType::dir4(i);
+                            if (rect.contains(next) && !is_solid(next))
+                                step(next, cost_t(1));
+                        }
+                    },
+                    [](cost_t cost, CoordType pos){(void)pos; return cost;}
+                );
+            }
+
+            const auto &info = dijkstra_pathfinder.GetNodeInfoMap();
+            for (std::size_t i = 0; i < targets.size(); i++)
+            {
+                auto it = info.find(targets[i].pos);
+                if (it != info.end())
+                    func(i, it->second.cost);
+            }
+        }
+
+        template <typename S>
+        void ComputeCosts(CoordType cluster_coord, S &is_solid)
+        {
+            Cluster &cluster = GetCluster(cluster_coord);
+            std::size_t n = cluster.entrances.size();
+            cluster.costs.assign(n * n, unreachable);
+            for (std::size_t i = 0; i < n; i++)
+            {
+                cluster.costs[i * n + i] = 0;
+                CostsInsideRect(cluster.entrances[i].pos, ClusterRect(cluster_coord), is_solid, cluster.entrances, [&](std::size_t j, cost_t cost)
+                {
+                    cluster.costs[i * n + j] = cost;
+                });
+            }
+        }
+
+        // Wraps the user predicate to also treat everything outside of the bounds as solid.
+        [[nodiscard]] auto WrapPredicate(auto &tile_is_solid) const
+        {
+            return [this, &tile_is_solid](CoordType pos) -> bool {return !bounds.contains(pos) || bool(tile_is_solid(std::as_const(pos)));};
+        }
+
+        // Finds a path from `a` to `b` that doesn't leave `rect`. Appends it to `path`, excluding `a`.
+        template <typename S>
+        [[nodiscard]] bool LocalPath(CoordType a, CoordType b, rect_type rect, S &is_solid, std::vector<CoordType> &path)
+        {
+            local_pathfinder.SetNewTask(a);
+            while (local_pathfinder.HasUnvisitedNodes())
+            {
+                if (local_pathfinder.CurrentNode() == b)
+                {
+                    std::size_t old_size = path.size();
+                    local_pathfinder.DumpPathBackwards(b, [&](CoordType pos){path.push_back(pos);});
+                    path.pop_back(); // Remove `a`.
+                    std::reverse(path.begin() + std::ptrdiff_t(old_size), path.end());
+                    return true;
+                }
+                local_pathfinder.Step(b, [&](CoordType pos){return !rect.contains(pos) || is_solid(pos);});
+            }
+            return false;
+        }
+
+      public:
+        // Constructs an empty object. Use the other constructor to make a proper one.
+        HierarchicalPathfinder_4Way() {}
+
+        // `bounds` is the map rect, and everything outside of it is considered solid.
+        // `tile_is_solid` is `(CoordType pos) -> bool` that returns true if the tile is solid and can't be moved through.
+        HierarchicalPathfinder_4Way(rect_type bounds, CoordType cluster_size, auto &&tile_is_solid)
+            : bounds(bounds), cluster_size(cluster_size), clusters(div_ex(bounds.size() + cluster_size - 1, cluster_size).template to<index_t>())
+        {
+            ASSERT(cluster_size.min() > 0, "Invalid cluster size.");
+
+            auto is_solid = WrapPredicate(tile_is_solid);
+            for (CoordType cluster : vector_range(NumClusters()))
+            {
+                GetCluster(cluster).entrances = ComputeEntrances(cluster, is_solid);
+                ComputeCosts(cluster, is_solid);
+            }
+        }
+
+        // The rect passed to the constructor.
+        [[nodiscard]] rect_type Bounds() const {return bounds;}
+        // The cluster size passed to the constructor. The last row and column of clusters can be smaller.
+        [[nodiscard]] CoordType ClusterSize() const {return cluster_size;}
+        // The number of clusters in each dimension.
+        [[nodiscard]] CoordType NumClusters() const {return clusters.size().template to<cost_t>();}
+
+        // The tiles covered by a cluster.
+        [[nodiscard]] rect_type ClusterRect(CoordType cluster) const
+        {
+            return (bounds.a + cluster * cluster_size).rect_size(cluster_size).intersect(bounds);
+        }
+
+        // The total number of entrances (nodes of the abstract graph), mostly for debugging.
+        [[nodiscard]] std::size_t NumEntrances() const
+        {
+            std::size_t ret = 0;
+            for (CoordType cluster : vector_range(NumClusters()))
+                ret += GetCluster(cluster).entrances.size();
+            return ret;
+        }
+
+        // Call this after changing some tiles. Recomputes the clusters containing `changed_tiles`,
+        //   and the neighboring clusters if their entrances changed.
+        // Returns the number of clusters that had their costs recomputed.
+        int UpdateTiles(rect_type changed_tiles, auto &&tile_is_solid)
+        {
+            changed_tiles = changed_tiles.intersect(bounds);
+            if (!changed_tiles.has_area())
+                return 0;
+
+            auto is_solid = WrapPredicate(tile_is_solid);
+
+            CoordType changed_a = ClusterOf(changed_tiles.a);
+            CoordType changed_b = ClusterOf(changed_tiles.b - 1) + 1;
+            // The neighbors can only be affected through the shared borders.
+            CoordType affected_a = max(changed_a - 1, CoordType{});
+            CoordType affected_b = min(changed_b + 1, NumClusters());
+
+            int ret = 0;
+            for (CoordType cluster : affected_a <= vector_range < affected_b)
+            {
+                bool is_changed = changed_a.rect_to(changed_b).contains(cluster);
+                if (!is_changed && (cluster - clamp(cluster, changed_a, changed_b - 1)).abs().sum() != 1)
+                    continue; // A diagonal neighbor.
+
+                std::vector<Entrance> entrances = ComputeEntrances(cluster, is_solid);
+                if (!is_changed && entrances == GetCluster(cluster).entrances)
+                    continue;
+
+                GetCluster(cluster).entrances = std::move(entrances);
+                ComputeCosts(cluster, is_solid);
+                ret++;
+            }
+            return ret;
+        }
+
+        // Finds a path on the abstract graph. Writes the waypoints to `waypoints`, from `start` to `goal` inclusive.
+        // Each pair of consecutive waypoints is either adjacent, or in the same cluster. Use `RefineSegment()` to turn them into tiles.
+        // Returns false if there's no path, then `waypoints` is empty.
+        bool FindAbstractPath(CoordType start, CoordType goal, auto &&tile_is_solid, std::vector<CoordType> &waypoints)
+        {
+            waypoints.clear();
+
+            auto is_solid = WrapPredicate(tile_is_solid);
+            if (is_solid(start) || is_solid(goal))
+                return false;
+
+            CoordType start_cluster = ClusterOf(start);
+            CoordType goal_cluster = ClusterOf(goal);
+
+            // Try the direct path first.
+            if (start_cluster == goal_cluster && LocalPath(start, goal, ClusterRect(start_cluster), is_solid, temp_path))
+            {
+                temp_path.clear();
+                waypoints.push_back(start);
+                waypoints.push_back(goal);
+                return true;
+            }
+
+            // Connect the start and the goal to the entrances of their clusters.
+            const Cluster &start_cluster_data = GetCluster(start_cluster);
+            const Cluster &goal_cluster_data = GetCluster(goal_cluster);
+            std::vector<cost_t> start_costs(start_cluster_data.entrances.size(), unreachable);
+            std::vector<cost_t> goal_costs(goal_cluster_data.entrances.size(), unreachable);
+            CostsInsideRect(start, ClusterRect(start_cluster), is_solid, start_cluster_data.entrances, [&](std::size_t i, cost_t cost){start_costs[i] = cost;});
+            CostsInsideRect(goal, ClusterRect(goal_cluster), is_solid, goal_cluster_data.entrances, [&](std::size_t i, cost_t cost){goal_costs[i] = cost;});
+
+            abstract_pathfinder.SetNewTask(start);
+            while (abstract_pathfinder.HasUnvisitedNodes())
+            {
+                if (abstract_pathfinder.CurrentNode() == goal)
+                {
+                    abstract_pathfinder.DumpPathBackwards(goal, [&](CoordType pos){waypoints.push_back(pos);});
+                    std::reverse(waypoints.begin(), waypoints.end());
+                    return true;
+                }
+
+                abstract_pathfinder.Step(
+                    [&](CoordType pos, auto step)
+                    {
+                        if (pos == start)
+                        {
+                            for (std::size_t i = 0; i < start_costs.size(); i++)
+                            {
+                                if (start_costs[i] != unreachable)
+                                    step(start_cluster_data.entrances[i].pos, start_costs[i]);
+                            }
+                        }
+
+                        CoordType cluster_coord = ClusterOf(pos);
+                        const Cluster &cluster = GetCluster(cluster_coord);
+                        const Entrance *entrance = FindEntrance(cluster, pos);
+                        if (!entrance)
+                            return; // This is the start.
+
+                        std::size_t n = cluster.entrances.size();
+                        std::size_t i = std::size_t(entrance - cluster.entrances.data());
+                        for (std::size_t j = 0; j < n; j++)
+                        {
+                            if (j != i && cluster.costs[i * n + j] != unreachable)
+                                step(cluster.entrances[j].pos, cluster.costs[i * n + j]);
+                        }
+                        for (CoordType across : entrance->across)
+                            step(across, cost_t(1));
+
+                        if (cluster_coord == goal_cluster && goal_costs[i] != unreachable)
+                            step(goal, goal_costs[i]);
+                    },
+                    [&](cost_t cost, CoordType pos) -> std::pair<cost_t, cost_t>
+                    {
+                        CoordType delta = goal - pos;
+                        return {cost + delta.abs().sum(), delta.len_sq()};
+                    }
+                );
+            }
+            return false;
+        }
+
+        // Refines a segment of the abstract path, appending the tiles from `a` (exclusive) to `b` (inclusive) to `path`.
+        // `a` and `b` must be consecutive waypoints from `FindAbstractPath()`. Returns false if the map changed and there's no path anymore.
+        bool RefineSegment(CoordType a, CoordType b, auto &&tile_is_solid, std::vector<CoordType> &path)
+        {
+            if ((b - a).abs().sum() == 1)
+            {
+                path.push_back(b);
+                return true;
+            }
+
+            auto is_solid = WrapPredicate(tile_is_solid);
+            ASSERT(ClusterOf(a) == ClusterOf(b), "The segment endpoints must be in the same cluster.");
+            return LocalPath(a, b, ClusterRect(ClusterOf(a)), is_solid, path);
+        }
+
+        // Finds a full path from `start` to `goal` inclusive, by refining all segments of the abstract path.
+        // Returns false if there's no path, then `path` is empty.
+        bool FindPath(CoordType start, CoordType goal, auto &&tile_is_solid, std::vector<CoordType> &path)
+        {
+            path.clear();
+
+            std::vector<CoordType> waypoints;
+            if (!FindAbstractPath(start, goal, tile_is_solid, waypoints))
+                return false;
+
+            path.push_back(start);
+            for (std::size_t i = 1; i < waypoints.size(); i++)
+            {
+                if (!RefineSegment(waypoints[i - 1], waypoints[i], tile_is_solid, path))
+                {
+                    path.clear();
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+}
@@ -0,0 +1,351 @@
+#pragma once
+
+#include "graph/pathfinding.h"
+#include "utils/mat.h" // Only for `IncrementalPathfinder_4Way`.
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// This header implements incremental pathfinding (D* Lite), for when the edge costs change often and the start point moves along the path.
+// Unlike `Pathfinder`, this keeps its search state between the queries, and when the graph changes only repairs the affected part of it.
+// The search goes from the goal towards the start, so moving the start (e.g. when the agent walks along the path) is cheap too.
+
+namespace Graph::Pathfinding
+{
+    // `CoordType` is normally the coordinate type, such as `ivec2`. But it can be anything that represents a position in your graph.
+    // `CostType` must be arithmetic. Its maximum value (or the infinity for floating-point types) is reserved to mean "unreachable".
+    // `NodeInfoMapTemplate` is the node info storage policy, see `HashNodeInfoMap` and `GridNodeInfoMap`.
+    // The graph must be undirected (moving `a -> b` must cost the same as `b -> a`).
+    //
+    // How to use:
+    // * Set the start and the goal using `SetNewTask()`.
+    // * Run `ComputePath()` until it returns true (you can limit the number of steps per call, to spread the work across several frames).
+    // * If `PathExists()`, read the path with `DumpPath()` or `NextNode()`.
+    // * When the agent moves, call `MoveStart()`. When the edge costs change, call `NodesChanged()`. Then run `ComputePath()` again.
+    //
+    // `neighbors` is the same as in `Pathfinder::Step()`: `(CoordType pos, auto func) -> void`, where `func` must be called for every
+    //   viable neighbor of `pos`, it's `(CoordType neighbor_coord, CostType step_cost) -> void`.
+    // `heuristic` is `(CoordType a, CoordType b) -> CostType`, it estimates the cost between two nodes.
+    //   It must be consistent (never overestimate, and satisfy the triangle inequality), such as the manhattan distance for 4-way movement.
+    template <typename CoordType, typename CostType, template <typename, typename> typename NodeInfoMapTemplate = HashNodeInfoMap>
+    class IncrementalPathfinder
+    {
+        static_assert(std::is_arithmetic_v<CostType>, "The cost type must be arithmetic.");
+
+      public:
+        using coord_t = CoordType;
+        using cost_t = CostType;
+        // The primary key and the tiebreaker.
+        using key_t = std::pair<CostType, CostType>;
+
+        static constexpr CostType infinity = std::numeric_limits<CostType>::has_infinity ? std::numeric_limits<CostType>::infinity() : std::numeric_limits<CostType>::max();
+
+        struct NodeInfo
+        {
+            // The cost from this node to the goal, as of the last expansion of this node.
+            CostType g = infinity;
+            // The one-step lookahead cost, computed from the neighbors. The node is "consistent" when this matches `g`.
+            CostType rhs = infinity;
+        };
+        using NodeInfoMap = NodeInfoMapTemplate<CoordType, NodeInfo>;
+
+      private:
+        // The inconsistent nodes. Needs a queue that can change or remove the entries.
+        IndexedHeapNodeQueue<CoordType, key_t> queue;
+
+        NodeInfoMap node_info;
+
+        CoordType start{};
+        CoordType goal{};
+        // The start point as of the last `MoveStart()`, and the accumulated heuristic correction for the moved start point.
+        CoordType last_start{};
+        CostType key_modifier{};
+
+        std::size_t num_expansions = 0;
+
+        [[nodiscard]] static CostType AddCosts(CostType a, CostType b)
+        {
+            if (a == infinity || b == infinity)
+                return infinity;
+            return a + b;
+        }
+
+        [[nodiscard]] const NodeInfo &GetInfo(const CoordType &coord) const
+        {
+            static const NodeInfo unvisited;
+            auto iter = node_info.find(coord);
+            return iter == node_info.end() ? unvisited : iter->second;
+        }
+
+        [[nodiscard]] key_t CalculateKey(const CoordType &coord, auto &heuristic) const
+        {
+            const NodeInfo &info = GetInfo(coord);
+            CostType cost = std::min(info.g, info.rhs);
+            return {AddCosts(AddCosts(cost, CostType(heuristic(std::as_const(start), coord))), key_modifier), cost};
+        }
+
+        // Recomputes `rhs` of the node from its neighbors, and adds or removes it from the queue.
+        void UpdateNode(const CoordType &coord, auto &neighbors, auto &heuristic)
+        {
+            if (coord != goal)
+            {
+                CostType rhs = infinity;
+                neighbors(coord, [&](CoordType neighbor_coord, CostType step_cost)
+                {
+                    rhs = std::min(rhs, AddCosts(GetInfo(neighbor_coord).g, step_cost));
+                });
+                // Don't insert the unvisited nodes that stay unreachable.
+                if (rhs != infinity || node_info.contains(coord))
+                    node_info.try_emplace(coord).first->second.rhs = rhs;
+            }
+
+            const NodeInfo &info = GetInfo(coord);
+            if (info.g != info.rhs)
+                queue.push({.coord = coord, .estimated_total_cost = CalculateKey(coord, heuristic)});
+            else
+                queue.erase(coord);
+        }
+
+        // Calls `UpdateNode()` on all neighbors of `coord`.
+        void UpdateNeighbors(const CoordType &coord, auto &neighbors, auto &heuristic)
+        {
+            // Collect the neighbors first, to avoid calling `neighbors` recursively.
+            std::vector<CoordType> list;
+            neighbors(coord, [&](CoordType neighbor_coord, CostType step_cost)
+            {
+                (void)step_cost;
+                list.push_back(neighbor_coord);
+            });
+            for (const CoordType &neighbor : list)
+                UpdateNode(neighbor, neighbors, heuristic);
+        }
+
+      public:
+        IncrementalPathfinder() {}
+
+        // Initializes with a custom node info storage. Use this with storages that can't be default-constructed, such as `GridNodeInfoMap`.
+        // Must call `SetNewTask()` before using the object.
+        explicit IncrementalPathfinder(NodeInfoMap new_node_info)
+            : node_info(std::move(new_node_info))
+        {}
+
+        // Resets the object for a new start and goal. Preserves the capacity.
+        void SetNewTask(CoordType new_start, CoordType new_goal, auto &&heuristic)
+        {
+            queue.clear();
+            node_info.clear();
+            start = new_start;
+            last_start = new_start;
+            goal = new_goal;
+            key_modifier = CostType{};
+            num_expansions = 0;
+
+            node_info.try_emplace(goal).first->second.rhs = CostType{};
+            queue.push({.coord = goal, .estimated_total_cost = CalculateKey(goal, heuristic)});
+        }
+
+        // Moves the start point, e.g. when the agent takes a step along the path. This preserves the search state.
+        void MoveStart(CoordType new_start, auto &&heuristic)
+        {
+            key_modifier = AddCosts(key_modifier, CostType(heuristic(std::as_const(last_start), std::as_const(new_start))));
+            last_start = new_start;
+            start = new_start;
+        }
+
+        // Call this after the costs of some edges change, passing both ends of every changed edge.
+        // (For tile maps, that's normally the changed tiles and their neighbors.) `neighbors` must reflect the new costs.
+        void NodesChanged(std::span<const CoordType> nodes, auto &&neighbors, auto &&heuristic)
+        {
+            for (const CoordType &node : nodes)
+                UpdateNode(node, neighbors, heuristic);
+        }
+
+        // Repairs the path from the start to the goal.
+        // Returns true when done (even if there's no path, check `PathExists()`). Returns false if ran out of steps, then call it again.
+        bool ComputePath(auto &&neighbors, auto &&heuristic, std::size_t max_steps = std::numeric_limits<std::size_t>::max())
+        {
+            for (std::size_t steps = 0;; steps++)
+            {
+                if (queue.empty())
+                    return true;
+
+                const NodeInfo &start_info = GetInfo(start);
+                if (!(queue.top().estimated_total_cost < CalculateKey(start, heuristic)) && start_info.g == start_info.rhs)
+                    return true;
+
+                if (steps >= max_steps)
+                    return false;
+                num_expansions++;
+
+                CoordType coord = queue.top().coord;
+                key_t old_key = queue.top().estimated_total_cost;
+                key_t new_key = CalculateKey(coord, heuristic);
+
+                if (old_key < new_key)
+                {
+                    // The key is outdated because the start has moved.
+                    queue.push({.coord = coord, .estimated_total_cost = new_key});
+                    continue;
+                }
+
+                NodeInfo &info = node_info.try_emplace(coord).first->second;
+                if (info.rhs < info.g)
+                {
+                    // Became cheaper.
+                    info.g = info.rhs;
+                    queue.pop();
+                    UpdateNeighbors(coord, neighbors, heuristic);
+                }
+                else
+                {
+                    // Became more expensive, recompute this node and everything that could depend on it.
+                    info.g = infinity;
+                    UpdateNode(coord, neighbors, heuristic);
+                    UpdateNeighbors(coord, neighbors, heuristic);
+                }
+            }
+        }
+
+        // Whether there's a path from the start to the goal. Only valid after `ComputePath()` returns true.
+        [[nodiscard]] bool PathExists() const
+        {
+            return GetInfo(start).g != infinity;
+        }
+
+        // The cost of the path from the start to the goal, or `infinity` if there's none. Only valid after `ComputePath()` returns true.
+        [[nodiscard]] CostType PathCost() const
+        {
+            return GetInfo(start).g;
+        }
+
+        // Returns the next node after `pos` towards the goal, or nothing if it's the goal or if there's no path.
+        // This only makes sense for the nodes on the path, since the search stops as soon as the path from the start is known.
+        [[nodiscard]] std::optional<CoordType> NextNode(CoordType pos, auto &&neighbors) const
+        {
+            if (pos == goal)
+                return {};
+
+            std::optional<CoordType> ret;
+            CostType best_cost = infinity;
+            neighbors(std::as_const(pos), [&](CoordType neighbor_coord, CostType step_cost)
+            {
+                CostType cost = AddCosts(GetInfo(neighbor_coord).g, step_cost);
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    ret = neighbor_coord;
+                }
+            });
+            return ret;
+        }
+
+        // Dumps the path from the start to the goal (unlike `Pathfinder::DumpPathBackwards()`, this goes forward).
+        // Passes each coordinate to `func`, which is `(CoordType point) -> void`. Returns false and doesn't call `func` if there's no path.
+        // Only valid after `ComputePath()` returns true.
+        bool DumpPath(auto &&neighbors, auto &&func) const
+        {
+            if (!PathExists())
+                return false;
+
+            CoordType pos = start;
+            // The path can't be longer than the number of known nodes, this protects from infinite loops in case of bugs or bad inputs.
+            std::size_t max_len = node_info.size();
+            while (true)
+            {
+                func(std::as_const(pos));
+                if (pos == goal)
+                    return true;
+
+                std::optional<CoordType> next = NextNode(pos, neighbors);
+                if (!next || max_len-- == 0)
+                    throw std::logic_error("Incremental pathfinding internal error: the path is broken.");
+                pos = *next;
+            }
+        }
+
+        // Various getters:
+
+        [[nodiscard]] CoordType Start() const {return start;}
+        [[nodiscard]] CoordType Goal() const {return goal;}
+        // The total number of node expansions since the last `SetNewTask()`.
+        [[nodiscard]] std::size_t NumExpansions() const {return num_expansions;}
+        // Returns the map with some node information.
+        [[nodiscard]] const NodeInfoMap &GetNodeInfoMap() const {return node_info;}
+    };
+
+    // A version of `IncrementalPathfinder` for 4-way grid movement, with the manhattan distance as the heuristic.
+    // `tile_is_solid` is `(CoordType pos) -> bool` that returns true if the tile is solid and can't be moved through.
+    template <typename CoordType = ivec2, template <typename, typename> typename NodeInfoMapTemplate = HashNodeInfoMap>
+    class IncrementalPathfinder_4Way : public IncrementalPathfinder<CoordType, typename CoordType::type, NodeInfoMapTemplate>
+    {
+        using CostType = typename CoordType::type;
+        using Base = IncrementalPathfinder<CoordType, CostType, NodeInfoMapTemplate>;
+
+        [[nodiscard]] static CostType Heuristic(CoordType a, CoordType b)
+        {
+            return (b - a).abs().sum();
+        }
+
+        [[nodiscard]] static auto MakeNeighbors(auto &tile_is_solid)
+        {
+            return [&tile_is_solid](CoordType pos, auto &&func)
+            {
+                for (int i = 0; i < 4; i++)
+                {
+                    CoordType next_pos = pos + CoordType::dir4(i);
+                    if (!bool(tile_is_solid(std::as_const(next_pos))))
+                        func(next_pos, CostType(1));
+                }
+            };
+        }
+
+      public:
+        using Base::Base;
+
+        void SetNewTask(CoordType new_start, CoordType new_goal)
+        {
+            Base::SetNewTask(new_start, new_goal, Heuristic);
+        }
+
+        void MoveStart(CoordType new_start)
+        {
+            Base::MoveStart(new_start, Heuristic);
+        }
+
+        // Call this after changing the solidity of some tiles.
+        void TilesChanged(std::span<const CoordType> tiles, auto &&tile_is_solid)
+        {
+            std::vector<CoordType> nodes;
+            nodes.reserve(tiles.size() * 5);
+            for (const CoordType &tile : tiles)
+            {
+                nodes.push_back(tile);
+                for (int i = 0; i < 4; i++)
+                    nodes.push_back(tile + CoordType::dir4(i));
+            }
+            Base::NodesChanged(nodes, MakeNeighbors(tile_is_solid), Heuristic);
+        }
+
+        bool ComputePath(auto &&tile_is_solid, std::size_t max_steps = std::numeric_limits<std::size_t>::max())
+        {
+            return Base::ComputePath(MakeNeighbors(tile_is_solid), Heuristic, max_steps);
+        }
+
+        [[nodiscard]] std::optional<CoordType> NextNode(CoordType pos, auto &&tile_is_solid) const
+        {
+            return Base::NextNode(pos, MakeNeighbors(tile_is_solid));
+        }
+
+        bool DumpPath(auto &&tile_is_solid, auto &&func) const
+        {
+            return Base::DumpPath(MakeNeighbors(tile_is_solid), func);
+        }
+    };
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "program/errors.h"
+#include "utils/mat.h"
+
+#include <parallel_hashmap/phmap.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <list>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// This header implements a cache for the path search results, for when many agents request similar paths between the same areas.
+// The map is split into rectangular regions, and the paths are keyed by the regions of their start and goal.
+// The paths are stored compressed, only as the waypoints where the direction changes.
+// When tiles change, the paths passing through the affected regions are dropped.
+// For example:
+//   if (auto cached = cache.Find(start, goal); !cached.empty())
+//       ... // Walk to `cached.front()` (it's in the same region as `start`), then along the waypoints. From `cached.back()`, walk to the goal.
+//   else
+//       ... // Find the path and `cache.Insert(path)`.
+
+namespace Graph::Pathfinding
+{
+    template <typename CoordType = ivec2>
+    class PathCache
+    {
+        static_assert(Math::vector<CoordType> && CoordType::size == 2 && std::is_integral_v<typename CoordType::type>, "The coordinate type must be a 2D integral vector.");
+
+      public:
+        using coord_t = CoordType;
+        using scalar = typename CoordType::type;
+        using rect_type = typename CoordType::rect_type;
+
+      private:
+        // The start region and the goal region.
+        using key_t = Math::vec4<scalar>;
+
+        struct Entry
+        {
+            std::vector<CoordType> waypoints;
+            // The regions the path passes through, without duplicates.
+            std::vector<CoordType> regions;
+            typename std::list<key_t>::iterator lru_iter;
+        };
+
+        CoordType region_size;
+        std::size_t max_entries = 0;
+
+        phmap::flat_hash_map<key_t, Entry> entries;
+        // The most recently used entries come first.
+        std::list<key_t> lru;
+        // For each region, the entries passing through it.
+        phmap::flat_hash_map<CoordType, std::vector<key_t>> region_entries;
+
+        std::size_t num_hits = 0;
+        std::size_t num_misses = 0;
+
+        [[nodiscard]] key_t MakeKey(CoordType start, CoordType goal) const
+        {
+            CoordType start_region = RegionOf(start);
+            CoordType goal_region = RegionOf(goal);
+            return start_region.to_vec4(goal_region.x, goal_region.y);
+        }
+
+        void EraseEntry(typename phmap::flat_hash_map<key_t, Entry>::iterator iter)
+        {
+            for (CoordType region : iter->second.regions)
+            {
+                auto region_iter = region_entries.find(region);
+                ASSERT(region_iter != region_entries.end(), "Path cache internal error: a region is missing.");
+                std::vector<key_t> &keys = region_iter->second;
+                auto key_iter = std::find(keys.begin(), keys.end(), iter->first);
+                ASSERT(key_iter != keys.end(), "Path cache internal error: a region doesn't list the path.");
+                *key_iter = keys.back();
+                keys.pop_back();
+                if (keys.empty())
+                    region_entries.erase(region_iter);
+            }
+            lru.erase(iter->second.lru_iter);
+            entries.erase(iter);
+        }
+
+      public:
+        PathCache() {}
+
+        // `max_entries` is the maximum number of cached paths, when it's exceeded the least recently used paths are dropped.
+        PathCache(CoordType region_size, std::size_t max_entries)
+            : region_size(region_size), max_entries(max_entries)
+        {
+            if (!(region_size > 0).all())
+                throw std::runtime_error(FMT("Path cache region size must be positive, but got [{},{}].", region_size.x, region_size.y));
+        }
+
+        [[nodiscard]] CoordType RegionSize() const {return region_size;}
+        [[nodiscard]] CoordType RegionOf(CoordType pos) const {return div_ex(pos, region_size);}
+
+        [[nodiscard]] std::size_t NumEntries() const {return entries.size();}
+        [[nodiscard]] std::size_t NumHits() const {return num_hits;}
+        [[nodiscard]] std::size_t NumMisses() const {return num_misses;}
+        // The fraction of `Find()` calls that found a path, or zero if there were none.
+        [[nodiscard]] double HitRate() const
+        {
+            std::size_t total = num_hits + num_misses;
+            return total == 0 ? 0 : num_hits / double(total);
+        }
+
+        // Returns the waypoints of a cached path from the region of `start` to the region of `goal`, or an empty span if there's none.
+        // The first waypoint is in the same region as `start`, and the last one is in the same region as `goal`, but they're not necessarily the same tiles.
+        // The span is valid until the cache is modified.
+        [[nodiscard]] std::span<const CoordType> Find(CoordType start, CoordType goal)
+        {
+            auto iter = entries.find(MakeKey(start, goal));
+            if (iter == entries.end())
+            {
+                num_misses++;
+                return {};
+            }
+            num_hits++;
+            lru.splice(lru.begin(), lru, iter->second.lru_iter);
+            return iter->second.waypoints;
+        }
+
+        // Caches a path, replacing the existing one for the same pair of regions.
+        // `path` is a list of tiles, where each consecutive pair of tiles is a single step (4-way or 8-way).
+        // Throws if the path is empty.
+        void Insert(std::span<const CoordType> path)
+        {
+            if (path.empty())
+                throw std::runtime_error("Attempt to cache an empty path.");
+
+            if (max_entries == 0)
+                return;
+
+            key_t key = MakeKey(path.front(), path.back());
+            if (auto iter = entries.find(key); iter != entries.end())
+                EraseEntry(iter);
+            while (entries.size() >= max_entries)
+                EraseEntry(entries.find(lru.back()));
+
+            Entry entry;
+
+            // Keep only the points where the direction changes.
+            entry.waypoints.push_back(path.front());
+            for (std::size_t i = 1; i + 1 < path.size(); i++)
+            {
+                if (path[i] - path[i - 1] != path[i + 1] - path[i])
+                    entry.waypoints.push_back(path[i]);
+            }
+            if (path.size() > 1)
+                entry.waypoints.push_back(path.back());
+
+            for (CoordType pos : path)
+            {
+                CoordType region = RegionOf(pos);
+                if (std::find(entry.regions.begin(), entry.regions.end(), region) == entry.regions.end())
+                    entry.regions.push_back(region);
+            }
+            for (CoordType region : entry.regions)
+                region_entries[region].push_back(key);
+
+            lru.push_front(key);
+            entry.lru_iter = lru.begin();
+            entries.try_emplace(key, std::move(entry));
+        }
+
+        // Drops all paths passing through the regions touching `tiles`. Call this after modifying the map.
+        // Note that the paths that don't pass through those regions are kept, even if the change made a shorter path possible.
+        // Returns the number of dropped paths.
+        std::size_t InvalidateTiles(rect_type tiles)
+        {
+            if (!tiles.has_area())
+                return 0;
+
+            std::size_t ret = 0;
+            CoordType first_region = RegionOf(tiles.a);
+            CoordType last_region = RegionOf(tiles.b - 1);
+            for (CoordType region : first_region <= vector_range <= last_region)
+            {
+                while (true)
+                {
+                    auto region_iter = region_entries.find(region);
+                    if (region_iter == region_entries.end())
+                        break;
+                    // This removes the key from the region list, and possibly the region itself.
+                    EraseEntry(entries.find(region_iter->second.back()));
+                    ret++;
+                }
+            }
+            return ret;
+        }
+
+        // Drops all paths and resets the statistics.
+        void Clear()
+        {
+            entries.clear();
+            lru.clear();
+            region_entries.clear();
+            num_hits = 0;
+            num_misses = 0;
+        }
+
+        // Expands the waypoints back into individual tiles, passing each one to `func`, which is `(CoordType pos) -> void`.
+        static void ExpandWaypoints(std::span<const CoordType> waypoints, auto &&func)
+        {
+            if (waypoints.empty())
+                return;
+
+            func(std::as_const(waypoints.front()));
+            for (std::size_t i = 1; i < waypoints.size(); i++)
+            {
+                CoordType pos = waypoints[i - 1];
+                CoordType step = sign(waypoints[i] - pos);
+                while (pos != waypoints[i])
+                {
+                    pos += step;
+                    func(std::as_const(pos));
+                }
+            }
+        }
+    };
+}
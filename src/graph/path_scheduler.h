@@ -0,0 +1,239 @@
+#pragma once
+
+#include "graph/pathfinding.h"
+#include "utils/alloc_tracker.h"
+#include "utils/trace.h"
+
+#include <parallel_hashmap/phmap.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+// This header implements a scheduler for time-sliced pathfinding.
+// It owns a queue of pathfinding jobs, and advances them by a limited number of steps per tick, to avoid frame time spikes
+//   when many agents request paths at once. The most urgent jobs are processed first, and the results are reported via callbacks.
+// Call `Tick()` once per tick, e.g. from `Program::DefaultBasicState::Tick()`:
+//   PathScheduler<Pathfinder_4Way<ivec2>> scheduler(2000);
+//   void Tick() override {scheduler.Tick([&](ivec2 pos){return map.IsSolid(pos);});}
+
+namespace Graph::Pathfinding
+{
+    // `PathfinderType` is a pathfinder with a `Step(CoordType goal, auto &&tile_is_solid)` overload, such as `Pathfinder_4Way` or `Pathfinder_4WayJps`.
+    template <typename PathfinderType>
+    class PathScheduler
+    {
+      public:
+        using pathfinder_t = PathfinderType;
+        using coord_t = typename PathfinderType::coord_t;
+
+        // Zero is never used as an ID.
+        using JobId = std::uint64_t;
+
+        // Called when a job finishes. `path` goes from the start to the goal (both inclusive), and is empty if the path wasn't found.
+        // The path is only valid until the callback returns. It's safe to submit and cancel jobs from the callback.
+        using Callback = std::function<void(JobId id, std::span<const coord_t> path)>;
+
+        struct JobParams
+        {
+            coord_t start{};
+            coord_t goal{};
+            // The jobs with larger values are processed first. The jobs with the same priority are processed in the order of submission.
+            int priority = 0;
+            // If the job takes more steps than this, it fails.
+            std::size_t max_steps = std::numeric_limits<std::size_t>::max();
+            Callback callback;
+        };
+
+      private:
+        struct Job
+        {
+            JobParams params;
+            std::size_t steps_taken = 0;
+            // An index in `pathfinders`, once the job starts.
+            std::optional<std::size_t> pathfinder_index;
+        };
+
+        // The jobs are sorted by the decreasing priority, then by the increasing ID.
+        struct JobKey
+        {
+            int priority = 0;
+            JobId id = 0;
+
+            [[nodiscard]] friend bool operator<(const JobKey &a, const JobKey &b)
+            {
+                if (a.priority != b.priority)
+                    return a.priority > b.priority;
+                return a.id < b.id;
+            }
+        };
+
+        std::map<JobKey, Job> jobs;
+        phmap::flat_hash_map<JobId, int> job_priorities;
+        JobId next_id = 1;
+
+        std::function<PathfinderType()> make_pathfinder;
+        std::vector<PathfinderType> pathfinders;
+        std::vector<std::size_t> free_pathfinders;
+
+        std::size_t steps_per_tick = 0;
+        std::size_t steps_last_tick = 0;
+
+        // This is reused to preserve capacity.
+        std::vector<coord_t> path;
+
+        // Removes the job and calls its callback.
+        void FinishJob(typename std::map<JobKey, Job>::iterator iter, bool found)
+        {
+            Job &job = iter->second;
+            JobId id = iter->first.id;
+
+            path.clear();
+            if (job.pathfinder_index)
+            {
+                // The search goes from the goal, so dumping the path backwards gives it in the right order.
+                if (found)
+                    pathfinders[*job.pathfinder_index].DumpPathBackwards(job.params.start, [&](const coord_t &pos){path.push_back(pos);});
+                free_pathfinders.push_back(*job.pathfinder_index);
+            }
+
+            Callback callback = std::move(job.params.callback);
+            job_priorities.erase(id);
+            jobs.erase(iter);
+
+            if (callback)
+                callback(id, path);
+        }
+
+      public:
+        // `make_pathfinder` is `() -> PathfinderType`, called every time all existing pathfinders are busy.
+        // Use it to reserve capacity or to pass a custom node info storage.
+        PathScheduler(std::size_t new_steps_per_tick, std::function<PathfinderType()> new_make_pathfinder)
+            : make_pathfinder(std::move(new_make_pathfinder)), steps_per_tick(new_steps_per_tick)
+        {}
+
+        explicit PathScheduler(std::size_t new_steps_per_tick = 1000, std::size_t starting_capacity = 16)
+            : PathScheduler(new_steps_per_tick, [starting_capacity]{return PathfinderType(starting_capacity);})
+        {}
+
+        // The maximum number of pathfinding steps per `Tick()`, shared between all jobs.
+        [[nodiscard]] std::size_t StepsPerTick() const {return steps_per_tick;}
+        void SetStepsPerTick(std::size_t value) {steps_per_tick = value;}
+
+        // The number of steps taken in the last `Tick()`.
+        [[nodiscard]] std::size_t StepsLastTick() const {return steps_last_tick;}
+
+        // The number of unfinished jobs.
+        [[nodiscard]] std::size_t NumJobs() const {return jobs.size();}
+
+        // Adds a new job. It doesn't start until the next `Tick()`.
+        JobId Submit(JobParams params)
+        {
+            JobId id = next_id++;
+            int priority = params.priority;
+            jobs.try_emplace({.priority = priority, .id = id}, Job{.params = std::move(params), .pathfinder_index = {}});
+            job_priorities.try_emplace(id, priority);
+            return id;
+        }
+
+        // Whether the job is still waiting or in progress.
+        [[nodiscard]] bool IsPending(JobId id) const
+        {
+            return job_priorities.contains(id);
+        }
+
+        // Changes the priority of a pending job, preserving its progress. Returns false if there's no such job.
+        bool SetPriority(JobId id, int new_priority)
+        {
+            auto iter = job_priorities.find(id);
+            if (iter == job_priorities.end())
+                return false;
+
+            auto node = jobs.extract({.priority = iter->second, .id = id});
+            node.key().priority = new_priority;
+            node.mapped().params.priority = new_priority;
+            jobs.insert(std::move(node));
+            iter->second = new_priority;
+            return true;
+        }
+
+        // Removes a pending job without calling its callback. Returns false if there's no such job.
+        bool Cancel(JobId id)
+        {
+            auto iter = job_priorities.find(id);
+            if (iter == job_priorities.end())
+                return false;
+
+            auto job_iter = jobs.find({.priority = iter->second, .id = id});
+            if (job_iter->second.pathfinder_index)
+                free_pathfinders.push_back(*job_iter->second.pathfinder_index);
+            jobs.erase(job_iter);
+            job_priorities.erase(iter);
+            return true;
+        }
+
+        // Advances the jobs, in the order of priority, until the step budget runs out.
+        // `tile_is_solid` is `(coord_t pos) -> bool`. Every job that finishes gets its callback called.
+        // A job preempted by a more urgent one keeps its progress, but also keeps its pathfinder, so the number of pathfinders
+        //   can grow up to the number of jobs in progress at once.
+        void Tick(auto &&tile_is_solid)
+        {
+            IMP_TRACE_ZONE("PathScheduler::Tick");
+            IMP_ALLOC_SCOPE("pathfinding");
+            IMP_TRACE_COUNTER("Pathfinding jobs", jobs.size());
+            steps_last_tick = 0;
+
+            while (steps_last_tick < steps_per_tick && !jobs.empty())
+            {
+                auto iter = jobs.begin();
+                Job &job = iter->second;
+
+                if (!job.pathfinder_index)
+                {
+                    if (free_pathfinders.empty())
+                    {
+                        pathfinders.push_back(make_pathfinder());
+                        free_pathfinders.push_back(pathfinders.size() - 1);
+                    }
+                    job.pathfinder_index = free_pathfinders.back();
+                    free_pathfinders.pop_back();
+                    pathfinders[*job.pathfinder_index].SetNewTask(job.params.goal);
+                }
+
+                PathfinderType &pathfinder = pathfinders[*job.pathfinder_index];
+                std::optional<bool> result;
+                while (steps_last_tick < steps_per_tick)
+                {
+                    if (!pathfinder.HasUnvisitedNodes())
+                    {
+                        result = false;
+                        break;
+                    }
+                    if (pathfinder.CurrentNode() == job.params.start)
+                    {
+                        result = true;
+                        break;
+                    }
+                    if (job.steps_taken >= job.params.max_steps)
+                    {
+                        result = false;
+                        break;
+                    }
+
+                    pathfinder.Step(job.params.start, tile_is_solid);
+                    job.steps_taken++;
+                    steps_last_tick++;
+                }
+
+                if (result)
+                    FinishJob(iter, *result);
+            }
+        }
+    };
+}
@@ -0,0 +1,810 @@
+#include "pathfinding.h"
+#include "batch_pathfinding.h"
+#include "flow_field.h"
+#include "hierarchical_pathfinding.h"
+#include "incremental_pathfinding.h"
+#include "path_cache.h"
+#include "path_scheduler.h"
+#include "math/fixed_point.h"
+
+#include <algorithm>
+#include <deque>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // A random tile map. Everything outside of the bounds is solid.
+    struct TestMap
+    {
+        ivec2 size;
+        std::vector<char> solid;
+
+        TestMap(std::mt19937 &gen, ivec2 size, float wall_chance) : size(size), solid(size.prod())
+        {
+            std::bernoulli_distribution dist(wall_chance);
+            for (auto &tile : solid)
+                tile = dist(gen);
+        }
+
+        [[nodiscard]] irect2 Bounds() const
+        {
+            return ivec2().rect_size(size);
+        }
+
+        [[nodiscard]] bool IsSolid(ivec2 pos) const
+        {
+            return !Bounds().contains(pos) || solid[pos.y * size.x + pos.x];
+        }
+
+        // Returns the length of the shortest 4-way path in tiles, computed with a BFS.
+        [[nodiscard]] std::optional<int> ShortestPathLength(ivec2 start, ivec2 goal) const
+        {
+            std::vector<int> dist(size.prod(), -1);
+            std::deque<ivec2> queue = {start};
+            dist[start.y * size.x + start.x] = 0;
+            while (!queue.empty())
+            {
+                ivec2 pos = queue.front();
+                queue.pop_front();
+                if (pos == goal)
+                    return dist[pos.y * size.x + pos.x];
+                for (int i = 0; i < 4; i++)
+                {
+                    ivec2 next = pos + ivec2::dir4(i);
+                    if (IsSolid(next) || dist[next.y * size.x + next.x] != -1)
+                        continue;
+                    dist[next.y * size.x + next.x] = dist[pos.y * size.x + pos.x] + 1;
+                    queue.push_back(next);
+                }
+            }
+            return {};
+        }
+
+        // Returns a random non-solid tile.
+        [[nodiscard]] ivec2 RandomFreeTile(std::mt19937 &gen) const
+        {
+            std::uniform_int_distribution<int> x_dist(0, size.x - 1), y_dist(0, size.y - 1);
+            while (true)
+            {
+                ivec2 pos(x_dist(gen), y_dist(gen));
+                if (!IsSolid(pos))
+                    return pos;
+            }
+        }
+    };
+
+    // Checks that `path` (from the goal to the start) is a valid 4-way path on `map`.
+    void CheckPath(const TestMap &map, const std::vector<ivec2> &path, ivec2 start, ivec2 goal)
+    {
+        REQUIRE(!path.empty());
+        REQUIRE(path.front() == goal);
+        REQUIRE(path.back() == start);
+        for (std::size_t i = 0; i < path.size(); i++)
+        {
+            REQUIRE(!map.IsSolid(path[i]));
+            if (i > 0)
+                REQUIRE((path[i] - path[i - 1]).abs().sum() == 1);
+        }
+    }
+
+    // Runs a 4-way pathfinder until it reaches the goal. Returns the path from the goal to the start, or nothing if there's no path.
+    template <typename P>
+    [[nodiscard]] std::optional<std::vector<ivec2>> FindPath4Way(P &pathfinder, const TestMap &map, ivec2 start, ivec2 goal)
+    {
+        pathfinder.SetNewTask(start);
+        while (pathfinder.HasUnvisitedNodes())
+        {
+            if (pathfinder.CurrentNode() == goal)
+            {
+                std::vector<ivec2> path;
+                pathfinder.DumpPathBackwards(goal, [&](ivec2 pos){path.push_back(pos);});
+                return path;
+            }
+            pathfinder.Step(goal, [&](ivec2 pos){return map.IsSolid(pos);});
+        }
+        return {};
+    }
+}
+
+TEST_CASE("pathfinding.node_info_storage")
+{
+    std::mt19937 gen(50);
+    TestMap map(gen, ivec2(40, 30), 0.3f);
+
+    using GridPathfinder = Graph::Pathfinding::Pathfinder_4Way<ivec2, Graph::Pathfinding::GridNodeInfoMap>;
+    using TiledGridPathfinder = Graph::Pathfinding::Pathfinder_4Way<ivec2, Graph::Pathfinding::TiledGridNodeInfoMap>;
+    Graph::Pathfinding::Pathfinder_4Way<ivec2> hash_pathfinder;
+    GridPathfinder grid_pathfinder(GridPathfinder::NodeInfoMap(map.Bounds()));
+    TiledGridPathfinder tiled_grid_pathfinder(TiledGridPathfinder::NodeInfoMap(map.Bounds()));
+
+    // The same pathfinder object is reused, to make sure `SetNewTask()` properly clears the grid storage.
+    for (int i = 0; i < 100; i++)
+    {
+        ivec2 start = map.RandomFreeTile(gen);
+        ivec2 goal = map.RandomFreeTile(gen);
+        CAPTURE(start);
+        CAPTURE(goal);
+
+        std::optional<int> expected_length = map.ShortestPathLength(start, goal);
+        auto hash_path = FindPath4Way(hash_pathfinder, map, start, goal);
+        auto grid_path = FindPath4Way(grid_pathfinder, map, start, goal);
+        auto tiled_grid_path = FindPath4Way(tiled_grid_pathfinder, map, start, goal);
+
+        REQUIRE(hash_path.has_value() == expected_length.has_value());
+        REQUIRE(grid_path.has_value() == expected_length.has_value());
+        REQUIRE(tiled_grid_path == grid_path);
+        if (expected_length)
+        {
+            CheckPath(map, *hash_path, start, goal);
+            CheckPath(map, *grid_path, start, goal);
+            REQUIRE(int(hash_path->size()) == *expected_length + 1);
+            REQUIRE(int(grid_path->size()) == *expected_length + 1);
+        }
+
+        REQUIRE(grid_pathfinder.GetNodeInfoMap().size() == hash_pathfinder.GetNodeInfoMap().size());
+        REQUIRE(tiled_grid_pathfinder.GetNodeInfoMap().size() == hash_pathfinder.GetNodeInfoMap().size());
+    }
+
+    // Out-of-bounds coordinates throw on insertion, and are never found.
+    Graph::Pathfinding::GridNodeInfoMap<ivec2, int> grid_map(ivec2(-2).rect_to(ivec2(3)));
+    REQUIRE(grid_map.try_emplace(ivec2(-2)).second);
+    REQUIRE_FALSE(grid_map.try_emplace(ivec2(-2)).second);
+    REQUIRE(grid_map.contains(ivec2(-2)));
+    REQUIRE_THROWS(grid_map.try_emplace(ivec2(3)));
+    REQUIRE_FALSE(grid_map.contains(ivec2(3)));
+    REQUIRE_THROWS((void)grid_map.at(ivec2(0)));
+    grid_map.clear();
+    REQUIRE_FALSE(grid_map.contains(ivec2(-2)));
+    REQUIRE(grid_map.size() == 0);
+}
+
+TEST_CASE("pathfinding.fixed_point_costs")
+{
+    // 8-way movement on an empty map, with fixed-point costs.
+    using P = Graph::Pathfinding::Pathfinder<ivec2, fixed16, std::pair<fixed16, fixed16>>;
+    const fixed16 diagonal = sqrt(fixed16(2));
+    auto octile = [&](ivec2 delta)
+    {
+        delta = delta.abs();
+        return fixed16(max(delta.x, delta.y) - min(delta.x, delta.y)) + diagonal * min(delta.x, delta.y);
+    };
+
+    const irect2 bounds = ivec2(-20).rect_to(ivec2(20));
+    const ivec2 start(-15, 3), goal(12, -7);
+    P pathfinder(start);
+    while (pathfinder.HasUnvisitedNodes() && pathfinder.CurrentNode() != goal)
+    {
+        pathfinder.Step([&](ivec2 pos, auto func)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                if (bounds.contains(pos + ivec2::dir8(i)))
+                    func(pos + ivec2::dir8(i), i % 2 ? diagonal : fixed16(1));
+            }
+        },
+        [&](fixed16 cost, ivec2 pos){return std::pair(cost + octile(goal - pos), fixed16((goal - pos).len_sq()));});
+    }
+    REQUIRE(pathfinder.HasUnvisitedNodes());
+    CHECK(pathfinder.GetNodeInfoMap().at(goal).cost == octile(goal - start));
+}
+
+TEST_CASE("pathfinding.jps")
+{
+    std::mt19937 gen(51);
+
+    for (float wall_chance : {0.f, 0.1f, 0.3f, 0.45f})
+    {
+        CAPTURE(wall_chance);
+        TestMap map(gen, ivec2(37, 29), wall_chance);
+        Graph::Pathfinding::JpsTable_4Way<ivec2> table(map.Bounds(), [&](ivec2 pos){return map.IsSolid(pos);});
+
+        Graph::Pathfinding::Pathfinder_4Way<ivec2> pathfinder;
+        Graph::Pathfinding::Pathfinder_4WayJps<ivec2> jps_pathfinder;
+        std::size_t num_expanded = 0, num_expanded_jps = 0;
+
+        for (int i = 0; i < 100; i++)
+        {
+            ivec2 start = map.RandomFreeTile(gen);
+            ivec2 goal = map.RandomFreeTile(gen);
+            CAPTURE(start);
+            CAPTURE(goal);
+
+            std::optional<int> expected_length = map.ShortestPathLength(start, goal);
+
+            auto path = FindPath4Way(pathfinder, map, start, goal);
+            num_expanded += pathfinder.GetNodeInfoMap().size();
+            auto jps_path = FindPath4Way(jps_pathfinder, map, start, goal);
+            num_expanded_jps += jps_pathfinder.GetNodeInfoMap().size();
+
+            // With the precomputed table.
+            std::optional<std::vector<ivec2>> table_path;
+            jps_pathfinder.SetNewTask(start);
+            while (jps_pathfinder.HasUnvisitedNodes())
+            {
+                if (jps_pathfinder.CurrentNode() == goal)
+                {
+                    table_path.emplace();
+                    jps_pathfinder.DumpPathBackwards(goal, [&](ivec2 pos){table_path->push_back(pos);});
+                    break;
+                }
+                jps_pathfinder.Step(goal, table);
+            }
+
+            REQUIRE(path.has_value() == expected_length.has_value());
+            REQUIRE(jps_path.has_value() == expected_length.has_value());
+            REQUIRE(table_path.has_value() == expected_length.has_value());
+            if (expected_length)
+            {
+                CheckPath(map, *jps_path, start, goal);
+                CheckPath(map, *table_path, start, goal);
+                REQUIRE(int(jps_path->size()) == *expected_length + 1);
+                REQUIRE(int(table_path->size()) == *expected_length + 1);
+            }
+        }
+
+        // On open maps JPS stores far fewer nodes. (With random noise there are forced tiles everywhere, so it doesn't help much.)
+        if (wall_chance == 0)
+            REQUIRE(num_expanded_jps * 10 < num_expanded);
+    }
+}
+
+TEST_CASE("pathfinding.hierarchical")
+{
+    std::mt19937 gen(52);
+    TestMap map(gen, ivec2(61, 45), 0.3f);
+    auto is_solid = [&](ivec2 pos){return map.IsSolid(pos);};
+
+    Graph::Pathfinding::HierarchicalPathfinder_4Way<ivec2> pathfinder(map.Bounds(), ivec2(8), is_solid);
+    REQUIRE(pathfinder.NumClusters() == ivec2(8, 6));
+
+    auto CheckQueries = [&]
+    {
+        int total_len = 0, total_expected_len = 0;
+        for (int i = 0; i < 100; i++)
+        {
+            ivec2 start = map.RandomFreeTile(gen);
+            ivec2 goal = map.RandomFreeTile(gen);
+            CAPTURE(start);
+            CAPTURE(goal);
+
+            std::optional<int> expected_length = map.ShortestPathLength(start, goal);
+
+            std::vector<ivec2> path;
+            REQUIRE(pathfinder.FindPath(start, goal, is_solid, path) == expected_length.has_value());
+            if (!expected_length)
+                continue;
+
+            std::reverse(path.begin(), path.end());
+            CheckPath(map, path, start, goal);
+            REQUIRE(int(path.size()) >= *expected_length + 1);
+            total_len += int(path.size()) - 1;
+            total_expected_len += *expected_length;
+        }
+        // The paths should be near-optimal.
+        REQUIRE(total_len <= total_expected_len * 6 / 5);
+    };
+    CheckQueries();
+
+    // Change some tiles, and make sure the incremental update matches a full rebuild.
+    for (int i = 0; i < 20; i++)
+    {
+        ivec2 pos = map.RandomFreeTile(gen);
+        irect2 changed = pos.rect_size(ivec2(3, 2)).intersect(map.Bounds());
+        for (ivec2 tile : changed.a <= vector_range < changed.b)
+            map.solid[tile.y * map.size.x + tile.x] = !map.solid[tile.y * map.size.x + tile.x];
+        REQUIRE(pathfinder.UpdateTiles(changed, is_solid) >= 1);
+    }
+    Graph::Pathfinding::HierarchicalPathfinder_4Way<ivec2> rebuilt(map.Bounds(), ivec2(8), is_solid);
+    REQUIRE(pathfinder.NumEntrances() == rebuilt.NumEntrances());
+    CheckQueries();
+}
+
+TEST_CASE("pathfinding.flow_field")
+{
+    std::mt19937 gen(53);
+    TestMap map(gen, ivec2(40, 30), 0.3f);
+    auto neighbors = [&](ivec2 pos, auto func)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            ivec2 next = pos + ivec2::dir4(i);
+            if (!map.IsSolid(next))
+                func(next, 1);
+        }
+    };
+
+    // Compares the field against a BFS from every goal, and follows the directions from every tile.
+    auto CheckField = [&](const Graph::Pathfinding::FlowField<ivec2> &field, const std::vector<ivec2> &goals)
+    {
+        for (ivec2 pos : vector_range(map.size))
+        {
+            CAPTURE(pos);
+            std::optional<int> expected;
+            if (!map.IsSolid(pos))
+            {
+                for (ivec2 goal : goals)
+                {
+                    std::optional<int> len = map.ShortestPathLength(pos, goal);
+                    if (len && (!expected || *len < *expected))
+                        expected = len;
+                }
+            }
+
+            REQUIRE(field.IsReachable(pos) == expected.has_value());
+            if (!expected)
+            {
+                REQUIRE(field.Direction(pos) == ivec2());
+                continue;
+            }
+            REQUIRE(field.Cost(pos) == *expected);
+
+            ivec2 cur = pos;
+            for (int i = 0; i < *expected; i++)
+            {
+                REQUIRE(field.Direction(cur).abs().sum() == 1);
+                cur = field.NextTile(cur);
+                REQUIRE(!map.IsSolid(cur));
+            }
+            REQUIRE(field.NextTile(cur) == cur);
+            REQUIRE(field.Goal(pos) == cur);
+        }
+    };
+
+    std::vector<ivec2> goals = {map.RandomFreeTile(gen), map.RandomFreeTile(gen), map.RandomFreeTile(gen)};
+    Graph::Pathfinding::FlowField<ivec2> field(map.Bounds());
+    field.Build(goals, neighbors);
+    CheckField(field, goals);
+
+    REQUIRE_FALSE(field.IsReachable(ivec2(-1, 0)));
+    REQUIRE_THROWS((void)field.Cost(ivec2(-1, 0)));
+    REQUIRE_THROWS(field.Build(std::vector{ivec2(-1, 0)}, neighbors));
+
+    // Move the goals around, and update the field incrementally.
+    for (int i = 0; i < 10; i++)
+    {
+        ivec2 &goal = goals[i % goals.size()];
+        for (int j = 0; j < 3; j++)
+        {
+            ivec2 next = goal + ivec2::dir4(std::uniform_int_distribution<int>(0, 3)(gen));
+            if (!map.IsSolid(next))
+                goal = next;
+        }
+        if (i == 7)
+            goals.push_back(map.RandomFreeTile(gen));
+        if (i == 8)
+            goals.erase(goals.begin());
+
+        field.UpdateGoals(goals, neighbors);
+        CheckField(field, goals);
+    }
+}
+
+TEST_CASE("pathfinding.node_queues")
+{
+    std::mt19937 gen(54);
+    TestMap map(gen, ivec2(40, 30), 0.3f);
+
+    Graph::Pathfinding::Pathfinder_4Way<ivec2> heap_pathfinder;
+    Graph::Pathfinding::Pathfinder_4Way<ivec2, Graph::Pathfinding::HashNodeInfoMap, Graph::Pathfinding::IndexedHeapNodeQueue> indexed_pathfinder;
+    Graph::Pathfinding::Pathfinder_4Way<ivec2, Graph::Pathfinding::HashNodeInfoMap, Graph::Pathfinding::BucketNodeQueue> bucket_pathfinder;
+
+    for (int i = 0; i < 100; i++)
+    {
+        ivec2 start = map.RandomFreeTile(gen);
+        ivec2 goal = map.RandomFreeTile(gen);
+        CAPTURE(start);
+        CAPTURE(goal);
+
+        std::optional<int> expected_length = map.ShortestPathLength(start, goal);
+
+        auto CheckResult = [&](const std::optional<std::vector<ivec2>> &path)
+        {
+            REQUIRE(path.has_value() == expected_length.has_value());
+            if (path)
+            {
+                CheckPath(map, *path, start, goal);
+                REQUIRE(int(path->size()) == *expected_length + 1);
+            }
+        };
+        CheckResult(FindPath4Way(heap_pathfinder, map, start, goal));
+        CheckResult(FindPath4Way(indexed_pathfinder, map, start, goal));
+        CheckResult(FindPath4Way(bucket_pathfinder, map, start, goal));
+
+        // The indexed heap never contains duplicates.
+        std::vector<ivec2> queued;
+        indexed_pathfinder.GetRemainingNodes().ForEachNode([&](const auto &node){queued.push_back(node.coord);});
+        std::sort(queued.begin(), queued.end(), [](ivec2 a, ivec2 b){return std::pair(a.y, a.x) < std::pair(b.y, b.x);});
+        REQUIRE(std::adjacent_find(queued.begin(), queued.end()) == queued.end());
+    }
+
+    // Popping from the bucket queue in order, including the keys below the first one.
+    Graph::Pathfinding::BucketNodeQueue<int, std::pair<int, int>> queue;
+    for (int key : {5, 3, 9, 3, 7, 0})
+        queue.push({.coord = key, .estimated_total_cost = {key, 0}});
+    REQUIRE(queue.size() == 6);
+    std::vector<int> keys;
+    while (!queue.empty())
+    {
+        keys.push_back(queue.top().coord);
+        queue.pop();
+    }
+    REQUIRE(keys == std::vector{0, 3, 3, 5, 7, 9});
+    REQUIRE_THROWS(queue.pop());
+}
+
+TEST_CASE("pathfinding.batch")
+{
+    std::mt19937 gen(55);
+    TestMap map(gen, ivec2(40, 30), 0.3f);
+
+    using Batch = Graph::Pathfinding::BatchPathfinder<Graph::Pathfinding::Pathfinder_4Way<ivec2, Graph::Pathfinding::GridNodeInfoMap>>;
+    Batch batch(4, [&]{return Batch::pathfinder_t(Batch::pathfinder_t::NodeInfoMap(map.Bounds()));});
+    REQUIRE(batch.NumThreads() == 4);
+
+    std::vector<Batch::Query> queries;
+    for (int i = 0; i < 200; i++)
+        queries.push_back({.start = map.RandomFreeTile(gen), .goal = map.RandomFreeTile(gen)});
+
+    Batch::Results results;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        batch.Solve(queries, [&](ivec2 pos){return map.IsSolid(pos);}, results);
+        REQUIRE(results.size() == queries.size());
+
+        std::size_t total_points = 0;
+        for (std::size_t i = 0; i < queries.size(); i++)
+        {
+            CAPTURE(i);
+            std::optional<int> expected_length = map.ShortestPathLength(queries[i].start, queries[i].goal);
+            REQUIRE(results.Found(i) == expected_length.has_value());
+            total_points += results.Path(i).size();
+            if (!expected_length)
+            {
+                REQUIRE(results.Path(i).empty());
+                continue;
+            }
+
+            // The batch returns the paths from the start to the goal, while `CheckPath()` expects them backwards.
+            std::vector<ivec2> path(results.Path(i).rbegin(), results.Path(i).rend());
+            CheckPath(map, path, queries[i].start, queries[i].goal);
+            REQUIRE(int(path.size()) == *expected_length + 1);
+        }
+        REQUIRE(total_points == results.AllPoints().size());
+    }
+
+    // Running out of steps.
+    batch.Solve(queries, [&](ivec2 pos){return map.IsSolid(pos);}, results, 1);
+    for (std::size_t i = 0; i < queries.size(); i++)
+        REQUIRE(results.Found(i) == (queries[i].start == queries[i].goal));
+}
+
+TEST_CASE("pathfinding.incremental")
+{
+    std::mt19937 gen(56);
+    TestMap map(gen, ivec2(40, 30), 0.25f);
+    auto is_solid = [&](ivec2 pos){return map.IsSolid(pos);};
+
+    Graph::Pathfinding::IncrementalPathfinder_4Way<ivec2> pathfinder;
+
+    for (int task = 0; task < 10; task++)
+    {
+        ivec2 start = map.RandomFreeTile(gen);
+        ivec2 goal = map.RandomFreeTile(gen);
+        pathfinder.SetNewTask(start, goal);
+
+        for (int change = 0; change < 30; change++)
+        {
+            CAPTURE(start);
+            CAPTURE(goal);
+
+            // Spread the search over several calls.
+            while (!pathfinder.ComputePath(is_solid, 20)) {}
+
+            std::optional<int> expected_length = map.ShortestPathLength(start, goal);
+            REQUIRE(pathfinder.PathExists() == expected_length.has_value());
+
+            std::vector<ivec2> path;
+            REQUIRE(pathfinder.DumpPath(is_solid, [&](ivec2 pos){path.push_back(pos);}) == expected_length.has_value());
+            if (expected_length)
+            {
+                REQUIRE(pathfinder.PathCost() == *expected_length);
+                std::reverse(path.begin(), path.end());
+                CheckPath(map, path, start, goal);
+                REQUIRE(int(path.size()) == *expected_length + 1);
+
+                // Walk a few steps along the path.
+                for (int i = 0; i < 3 && start != goal; i++)
+                {
+                    start = *pathfinder.NextNode(start, is_solid);
+                    pathfinder.MoveStart(start);
+                }
+            }
+
+            // Toggle a few tiles, but not the start and the goal.
+            std::vector<ivec2> changed;
+            for (int i = 0; i < 3; i++)
+            {
+                ivec2 tile(std::uniform_int_distribution<int>(0, map.size.x - 1)(gen), std::uniform_int_distribution<int>(0, map.size.y - 1)(gen));
+                if (tile == start || tile == goal)
+                    continue;
+                map.solid[tile.y * map.size.x + tile.x] = !map.solid[tile.y * map.size.x + tile.x];
+                changed.push_back(tile);
+            }
+            pathfinder.TilesChanged(changed, is_solid);
+        }
+    }
+}
+
+TEST_CASE("pathfinding.scheduler")
+{
+    std::mt19937 gen(57);
+    TestMap map(gen, ivec2(40, 30), 0.3f);
+    auto is_solid = [&](ivec2 pos){return map.IsSolid(pos);};
+
+    using Scheduler = Graph::Pathfinding::PathScheduler<Graph::Pathfinding::Pathfinder_4Way<ivec2>>;
+    Scheduler scheduler(50);
+
+    struct Request
+    {
+        ivec2 start, goal;
+        int priority = 0;
+        bool done = false;
+    };
+    std::vector<Request> requests;
+    std::vector<int> finished_priorities;
+    for (int i = 0; i < 40; i++)
+        requests.push_back({.start = map.RandomFreeTile(gen), .goal = map.RandomFreeTile(gen), .priority = i % 3});
+
+    for (std::size_t i = 0; i < requests.size(); i++)
+    {
+        scheduler.Submit({
+            .start = requests[i].start,
+            .goal = requests[i].goal,
+            .priority = requests[i].priority,
+            .callback = [&, i](Scheduler::JobId id, std::span<const ivec2> path)
+            {
+                (void)id;
+                Request &request = requests[i];
+                REQUIRE_FALSE(request.done);
+                request.done = true;
+                finished_priorities.push_back(request.priority);
+
+                std::optional<int> expected_length = map.ShortestPathLength(request.start, request.goal);
+                REQUIRE(path.empty() == !expected_length);
+                if (expected_length)
+                {
+                    std::vector<ivec2> backward_path(path.rbegin(), path.rend());
+                    CheckPath(map, backward_path, request.start, request.goal);
+                    REQUIRE(int(path.size()) == *expected_length + 1);
+                }
+            },
+        });
+    }
+
+    // Cancel one job, and bump the priority of another.
+    bool cancelled_job_finished = false;
+    Scheduler::JobId cancelled = scheduler.Submit({.start = requests[0].start, .goal = requests[0].goal, .callback = [&](auto &&...){cancelled_job_finished = true;}});
+    REQUIRE(scheduler.Cancel(cancelled));
+    REQUIRE_FALSE(scheduler.Cancel(cancelled));
+    REQUIRE(scheduler.SetPriority(1, 10)); // This is the first job.
+    requests[0].priority = 10;
+
+    int num_ticks = 0;
+    while (scheduler.NumJobs() > 0)
+    {
+        scheduler.Tick(is_solid);
+        REQUIRE(scheduler.StepsLastTick() <= scheduler.StepsPerTick());
+        REQUIRE(++num_ticks < 100000);
+    }
+    REQUIRE(num_ticks > 1);
+    REQUIRE_FALSE(cancelled_job_finished);
+
+    for (const Request &request : requests)
+        REQUIRE(request.done);
+    REQUIRE(std::is_sorted(finished_priorities.begin(), finished_priorities.end(), std::greater{}));
+}
+
+TEST_CASE("pathfinding.path_cache")
+{
+    std::mt19937 gen(58);
+    TestMap map(gen, ivec2(40, 30), 0.2f);
+
+    Graph::Pathfinding::PathCache<ivec2> cache(ivec2(10), 4);
+    Graph::Pathfinding::Pathfinder_4Way<ivec2> pathfinder;
+
+    // Find some paths, then expand the cached waypoints and compare.
+    std::vector<std::vector<ivec2>> paths;
+    while (paths.size() < 4)
+    {
+        ivec2 start = map.RandomFreeTile(gen);
+        ivec2 goal = map.RandomFreeTile(gen);
+        if (cache.RegionOf(start) == cache.RegionOf(goal) || !cache.Find(start, goal).empty())
+            continue;
+        std::optional<std::vector<ivec2>> path = FindPath4Way(pathfinder, map, start, goal);
+        if (!path)
+            continue;
+        std::reverse(path->begin(), path->end());
+        cache.Insert(*path);
+        paths.push_back(std::move(*path));
+    }
+    REQUIRE(cache.NumEntries() == 4);
+
+    for (const std::vector<ivec2> &path : paths)
+    {
+        // Any tiles in the same regions should hit.
+        ivec2 start = cache.RegionOf(path.front()) * 10 + 9 - mod_ex(path.front(), 10);
+        ivec2 goal = cache.RegionOf(path.back()) * 10 + mod_ex(path.back(), 10) / 2;
+        std::span<const ivec2> waypoints = cache.Find(start, goal);
+        REQUIRE(!waypoints.empty());
+        REQUIRE(waypoints.size() <= path.size());
+
+        std::vector<ivec2> expanded;
+        Graph::Pathfinding::PathCache<ivec2>::ExpandWaypoints(waypoints, [&](ivec2 pos){expanded.push_back(pos);});
+        REQUIRE(expanded == path);
+    }
+    REQUIRE(cache.NumHits() == 4);
+    REQUIRE(cache.HitRate() > 0);
+
+    // Invalidating the tiles drops the paths passing through them.
+    ivec2 tile = paths[0][paths[0].size() / 2];
+    std::size_t expected_dropped = 0;
+    for (const std::vector<ivec2> &path : paths)
+        expected_dropped += std::any_of(path.begin(), path.end(), [&](ivec2 pos){return cache.RegionOf(pos) == cache.RegionOf(tile);});
+    REQUIRE(cache.InvalidateTiles(tile.rect_size(1)) == expected_dropped);
+    REQUIRE(cache.NumEntries() == 4 - expected_dropped);
+    REQUIRE(cache.Find(paths[0].front(), paths[0].back()).empty());
+
+    // Evicting the least recently used paths.
+    Graph::Pathfinding::PathCache<ivec2> small_cache(ivec2(10), 2);
+    small_cache.Insert(std::vector{ivec2(0, 0), ivec2(1, 0)});
+    small_cache.Insert(std::vector{ivec2(10, 0), ivec2(11, 0)});
+    REQUIRE(!small_cache.Find(ivec2(0, 0), ivec2(1, 0)).empty());
+    small_cache.Insert(std::vector{ivec2(20, 0), ivec2(21, 0)});
+    REQUIRE(small_cache.NumEntries() == 2);
+    REQUIRE(!small_cache.Find(ivec2(0, 0), ivec2(1, 0)).empty());
+    REQUIRE(small_cache.Find(ivec2(10, 0), ivec2(11, 0)).empty());
+    REQUIRE(!small_cache.Find(ivec2(20, 0), ivec2(21, 0)).empty());
+
+    REQUIRE_THROWS(cache.Insert(std::vector<ivec2>{}));
+}
+
+TEST_CASE("pathfinding.bidirectional")
+{
+    std::mt19937 gen(53);
+
+    Graph::Pathfinding::BidirectionalPathfinder<ivec2, int> pathfinder;
+    auto manhattan = [](ivec2 a, ivec2 b){return (b - a).abs().sum();};
+    auto zero = [](ivec2, ivec2){return 0;};
+
+    for (float wall_chance : {0.f, 0.3f})
+    {
+        CAPTURE(wall_chance);
+        TestMap map(gen, ivec2(41, 33), wall_chance);
+        auto neighbors = [&](ivec2 pos, auto func)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                ivec2 next = pos + ivec2::dir4(i);
+                if (!map.IsSolid(next))
+                    func(next, 1);
+            }
+        };
+
+        std::size_t num_visited = 0, num_visited_bidirectional = 0;
+
+        for (int i = 0; i < 100; i++)
+        {
+            ivec2 start = map.RandomFreeTile(gen);
+            ivec2 goal = map.RandomFreeTile(gen);
+            CAPTURE(start);
+            CAPTURE(goal);
+
+            std::optional<int> expected_length = map.ShortestPathLength(start, goal);
+
+            for (bool use_estimate : {false, true})
+            {
+                CAPTURE(use_estimate);
+                pathfinder.SetNewTask(start, goal);
+                while (!pathfinder.IsFinished())
+                {
+                    if (use_estimate)
+                        pathfinder.Step(neighbors, manhattan);
+                    else
+                        pathfinder.Step(neighbors, zero);
+                }
+
+                REQUIRE(pathfinder.PathFound() == expected_length.has_value());
+                if (expected_length)
+                {
+                    REQUIRE(pathfinder.BestCost() == expected_length);
+                    std::vector<ivec2> path;
+                    pathfinder.DumpPathBackwards([&](ivec2 pos){path.push_back(pos);});
+                    CheckPath(map, path, start, goal);
+                    REQUIRE(int(path.size()) == *expected_length + 1);
+                }
+
+                if (!use_estimate)
+                    num_visited_bidirectional += pathfinder.GetForwardSearch().GetNodeInfoMap().size() + pathfinder.GetBackwardSearch().GetNodeInfoMap().size();
+            }
+
+            // The unidirectional Dijkstra's algorithm, for comparison.
+            Graph::Pathfinding::Pathfinder<ivec2, int> dijkstra(start);
+            while (dijkstra.HasUnvisitedNodes() && dijkstra.CurrentNode() != goal)
+                dijkstra.Step(neighbors, [](int cost, ivec2){return cost;});
+            num_visited += dijkstra.GetNodeInfoMap().size();
+        }
+
+        // On open maps the two frontiers together are smaller than one. (The map is small, so the frontiers get clipped by its bounds.)
+        if (wall_chance == 0)
+            REQUIRE(num_visited_bidirectional < num_visited);
+    }
+
+    // A directed graph: moving along each axis costs differently in each direction. Compare with the unidirectional Dijkstra's algorithm.
+    TestMap map(gen, ivec2(30, 20), 0.2f);
+    auto StepCost = [](int dir){return 1 + dir;};
+    auto neighbors = [&](ivec2 pos, auto func)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            ivec2 next = pos + ivec2::dir4(i);
+            if (!map.IsSolid(next))
+                func(next, StepCost(i));
+        }
+    };
+    auto reverse_neighbors = [&](ivec2 pos, auto func)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            ivec2 prev = pos - ivec2::dir4(i);
+            if (!map.IsSolid(prev))
+                func(prev, StepCost(i));
+        }
+    };
+    // The cheapest step along each axis.
+    auto estimate = [](ivec2 a, ivec2 b){ivec2 delta = (b - a).abs(); return delta.x * 1 + delta.y * 2;};
+
+    for (int i = 0; i < 100; i++)
+    {
+        ivec2 start = map.RandomFreeTile(gen);
+        ivec2 goal = map.RandomFreeTile(gen);
+        CAPTURE(start);
+        CAPTURE(goal);
+
+        Graph::Pathfinding::Pathfinder<ivec2, int> dijkstra(start);
+        while (dijkstra.HasUnvisitedNodes() && dijkstra.CurrentNode() != goal)
+            dijkstra.Step(neighbors, [](int cost, ivec2){return cost;});
+        std::optional<int> expected_cost;
+        if (dijkstra.HasUnvisitedNodes())
+            expected_cost = dijkstra.GetNodeInfoMap().at(goal).cost;
+
+        pathfinder.SetNewTask(start, goal);
+        while (!pathfinder.IsFinished())
+            pathfinder.Step(neighbors, reverse_neighbors, estimate);
+
+        REQUIRE(pathfinder.BestCost() == expected_cost);
+        if (expected_cost)
+        {
+            std::vector<ivec2> path;
+            pathfinder.DumpPathBackwards([&](ivec2 pos){path.push_back(pos);});
+            REQUIRE(path.front() == goal);
+            REQUIRE(path.back() == start);
+            int cost = 0;
+            for (std::size_t j = 1; j < path.size(); j++)
+            {
+                ivec2 delta = path[j - 1] - path[j];
+                REQUIRE(delta.abs().sum() == 1);
+                REQUIRE(!map.IsSolid(path[j - 1]));
+                for (int dir = 0; dir < 4; dir++)
+                {
+                    if (delta == ivec2::dir4(dir))
+                        cost += StepCost(dir);
+                }
+            }
+            REQUIRE(cost == *expected_cost);
+        }
+    }
+}
@@ -2,20 +2,35 @@
 
 #include "graphics/blending.h"
 #include "graphics/clear.h"
+#include "graphics/compressed_image.h"
 #include "graphics/dummy_vertex_array.h"
+#include "graphics/dynamic_atlas.h"
 #include "graphics/errors.h"
 #include "graphics/font_file.h"
 #include "graphics/font.h"
 #include "graphics/framebuffer.h"
 #include "graphics/global_image_loader.h"
+#include "graphics/glyph_cache.h"
 #include "graphics/image.h"
 #include "graphics/index_buffer.h"
+#include "graphics/instanced_render_queue.h"
+#include "graphics/pixel_readback.h"
+#include "graphics/profiler.h"
+#include "graphics/program_binary_cache.h"
+#include "graphics/qoi.h"
+#include "graphics/quad_render_queue.h"
+#include "graphics/render_target_pool.h"
 #include "graphics/scissor.h"
 #include "graphics/shader.h"
 #include "graphics/simple_render_queue.h"
+#include "graphics/static_batch.h"
 #include "graphics/text.h"
+#include "graphics/text_cache.h"
+#include "graphics/timer_query.h"
 #include "graphics/texture_atlas.h"
 #include "graphics/texture.h"
+#include "graphics/texture_upload.h"
 #include "graphics/types.h"
+#include "graphics/uniform_buffer.h"
 #include "graphics/vertex_buffer.h"
 #include "graphics/viewport.h"
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "stream/readonly_data.h"
+#include "strings/format.h"
+#include "utils/byte_order.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    // An image in a GPU-compressed format (BCn, ETC2, ASTC), or in plain RGBA8, with a chain of mipmaps.
+    // Loaded from KTX2 files. Supercompressed files (Basis Universal, Zstandard) are not supported.
+    // Upload it with `TexUnit::SetData()`. Which formats are usable depends on the platform, see `CompressedFormatSupported()`.
+    // Usually that's BCn on desktop, and ETC2 or ASTC on GLES and WebGL.
+    class CompressedImage
+    {
+      public:
+        // The format of the pixels, as understood by GL.
+        struct Format
+        {
+            std::uint32_t internal_format = 0; // A `GL_COMPRESSED_...` constant, or `GL_RGBA8` or `GL_SRGB8_ALPHA8` if not compressed.
+            bool compressed = false;
+            ivec2 block_size = ivec2(1); // In pixels.
+            int block_bytes = 4;
+
+            // The size of a level with this size, in bytes.
+            [[nodiscard]] std::size_t LevelBytes(ivec2 size) const
+            {
+                ivec2 blocks = (size + block_size - 1) / block_size;
+                return std::size_t(blocks.x) * std::size_t(blocks.y) * std::size_t(block_bytes);
+            }
+        };
+
+        struct Level
+        {
+            ivec2 size;
+            std::span<const std::uint8_t> bytes; // Points into the file.
+        };
+
+      private:
+        Stream::ReadOnlyData file;
+        Format format;
+        std::vector<Level> levels;
+
+        // Maps the KTX2 `vkFormat` values to the GL formats.
+        [[nodiscard]] static Format VulkanToGlFormat(std::uint32_t vk_format)
+        {
+            // The GL constants are spelled out, since some of them are only in the extension headers.
+            switch (vk_format)
+            {
+              case 37:  return {0x8058, false, ivec2(1), 4}; // R8G8B8A8_UNORM -> GL_RGBA8
+              case 43:  return {0x8c43, false, ivec2(1), 4}; // R8G8B8A8_SRGB -> GL_SRGB8_ALPHA8
+              case 131:
+              case 132: return {vk_format == 131 ? 0x83f0u : 0x8c4cu, true, ivec2(4), 8}; // BC1_RGB -> GL_COMPRESSED_RGB_S3TC_DXT1_EXT / SRGB
+              case 133:
+              case 134: return {vk_format == 133 ? 0x83f1u : 0x8c4du, true, ivec2(4), 8}; // BC1_RGBA -> GL_COMPRESSED_RGBA_S3TC_DXT1_EXT / SRGB
+              case 135:
+              case 136: return {vk_format == 135 ? 0x83f2u : 0x8c4eu, true, ivec2(4), 16}; // BC2 -> GL_COMPRESSED_RGBA_S3TC_DXT3_EXT / SRGB
+              case 137:
+              case 138: return {vk_format == 137 ? 0x83f3u : 0x8c4fu, true, ivec2(4), 16}; // BC3 -> GL_COMPRESSED_RGBA_S3TC_DXT5_EXT / SRGB
+              case 145:
+              case 146: return {vk_format == 145 ? 0x8e8cu : 0x8e8du, true, ivec2(4), 16}; // BC7 -> GL_COMPRESSED_RGBA_BPTC_UNORM / SRGB
+              case 147:
+              case 148: return {vk_format == 147 ? 0x9274u : 0x9275u, true, ivec2(4), 8}; // ETC2_R8G8B8 -> GL_COMPRESSED_RGB8_ETC2 / SRGB
+              case 149:
+              case 150: return {vk_format == 149 ? 0x9276u : 0x9277u, true, ivec2(4), 8}; // ETC2_R8G8B8A1 -> GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2 / SRGB
+              case 151:
+              case 152: return {vk_format == 151 ? 0x9278u : 0x9279u, true, ivec2(4), 16}; // ETC2_R8G8B8A8 -> GL_COMPRESSED_RGBA8_ETC2_EAC / SRGB
+            }
+
+            // ASTC, from 4x4 to 12x12. The UNORM and SRGB variants alternate.
+            if (vk_format >= 157 && vk_format <= 184)
+            {
+                static constexpr std::array<ivec2, 14> astc_block_sizes = {
+                    ivec2(4,4), ivec2(5,4), ivec2(5,5), ivec2(6,5), ivec2(6,6), ivec2(8,5), ivec2(8,6),
+                    ivec2(8,8), ivec2(10,5), ivec2(10,6), ivec2(10,8), ivec2(10,10), ivec2(12,10), ivec2(12,12),
+                };
+                std::uint32_t index = (vk_format - 157) / 2;
+                bool srgb = (vk_format - 157) % 2;
+                return {(srgb ? 0x93d0u : 0x93b0u) + index, true, astc_block_sizes[index], 16}; // GL_COMPRESSED_RGBA_ASTC_..._KHR / SRGB
+            }
+
+            throw std::runtime_error(FMT("Unsupported KTX2 texture format: {}.", vk_format));
+        }
+
+      public:
+        CompressedImage() {}
+
+        // Throws on failure. Keeps a reference to the file.
+        CompressedImage(Stream::ReadOnlyData new_file) : file(std::move(new_file))
+        {
+            static constexpr std::uint8_t identifier[12] = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+            static constexpr std::size_t header_size = 80, level_index_entry_size = 24;
+
+            auto Fail = [&](std::string_view message)
+            {
+                throw std::runtime_error(FMT("Unable to parse KTX2 image `{}`: {}", file.name(), message));
+            };
+
+            auto Read = [&]<typename T>(std::size_t offset) -> T
+            {
+                T ret;
+                std::memcpy(&ret, file.data() + offset, sizeof ret);
+                return ByteOrder::Little(ret);
+            };
+
+            if (file.size() < header_size || !std::equal(std::begin(identifier), std::end(identifier), file.data()))
+                Fail("Not a KTX2 file.");
+
+            std::uint32_t vk_format = Read.operator()<std::uint32_t>(12);
+            ivec2 size(int(Read.operator()<std::uint32_t>(20)), int(Read.operator()<std::uint32_t>(24)));
+            std::uint32_t depth = Read.operator()<std::uint32_t>(28);
+            std::uint32_t layer_count = Read.operator()<std::uint32_t>(32);
+            std::uint32_t face_count = Read.operator()<std::uint32_t>(36);
+            std::uint32_t level_count = std::max(Read.operator()<std::uint32_t>(40), std::uint32_t(1)); // Zero means that the mipmaps should be generated.
+            std::uint32_t supercompression = Read.operator()<std::uint32_t>(44);
+
+            if (size(any) <= 0 || depth != 0 || layer_count > 1 || face_count != 1)
+                Fail("Only the plain 2D textures are supported.");
+            if (supercompression != 0)
+                Fail("Supercompression is not supported.");
+            if (level_count > 32 || file.size() < header_size + level_count * level_index_entry_size)
+                Fail("Invalid mipmap count.");
+
+            format = VulkanToGlFormat(vk_format);
+
+            levels.reserve(level_count);
+            for (std::uint32_t i = 0; i < level_count; i++)
+            {
+                std::size_t entry = header_size + i * level_index_entry_size;
+                std::uint64_t offset = Read.operator()<std::uint64_t>(entry);
+                std::uint64_t length = Read.operator()<std::uint64_t>(entry + 8);
+
+                ivec2 level_size = max(size >> int(i), 1);
+                if (length != format.LevelBytes(level_size))
+                    Fail(FMT("Unexpected size of mipmap level {}.", i));
+                if (offset > file.size() || length > file.size() - offset)
+                    Fail(FMT("Mipmap level {} is out of bounds.", i));
+
+                levels.push_back({.size = level_size, .bytes = {file.data() + offset, std::size_t(length)}});
+            }
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return !levels.empty();
+        }
+
+        [[nodiscard]] const Format &GetFormat() const
+        {
+            return format;
+        }
+
+        // The size of the first level.
+        [[nodiscard]] ivec2 Size() const
+        {
+            return levels.empty() ? ivec2(0) : levels.front().size;
+        }
+
+        // The mipmaps, starting from the full-sized image.
+        [[nodiscard]] const std::vector<Level> &Levels() const
+        {
+            return levels;
+        }
+    };
+}
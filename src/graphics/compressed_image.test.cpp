@@ -0,0 +1,74 @@
+#include "graphics/compressed_image.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    void Append(std::vector<std::uint8_t> &bytes, std::uint64_t value, int size)
+    {
+        for (int i = 0; i < size; i++)
+            bytes.push_back(std::uint8_t(value >> (i * 8)));
+    }
+
+    // A BC1 image with a full mipmap chain, each level filled with its index.
+    [[nodiscard]] std::vector<std::uint8_t> MakeKtx2(ivec2 size, std::uint32_t level_count)
+    {
+        std::vector<std::uint8_t> ret = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+        Append(ret, 131, 4); // vkFormat
+        Append(ret, 1, 4); // typeSize
+        Append(ret, size.x, 4);
+        Append(ret, size.y, 4);
+        Append(ret, 0, 4); // pixelDepth
+        Append(ret, 0, 4); // layerCount
+        Append(ret, 1, 4); // faceCount
+        Append(ret, level_count, 4);
+        Append(ret, 0, 4); // supercompressionScheme
+        for (int i = 0; i < 4; i++)
+            Append(ret, 0, 4); // DFD and key/value data
+        for (int i = 0; i < 2; i++)
+            Append(ret, 0, 8); // Supercompression global data.
+
+        std::uint64_t offset = ret.size() + level_count * 24;
+        std::vector<std::uint8_t> data;
+        for (std::uint32_t i = 0; i < level_count; i++)
+        {
+            ivec2 level_size = max(size >> int(i), 1);
+            std::uint64_t length = std::uint64_t((level_size.x + 3) / 4) * ((level_size.y + 3) / 4) * 8;
+            Append(ret, offset + data.size(), 8);
+            Append(ret, length, 8);
+            Append(ret, length, 8);
+            data.insert(data.end(), length, std::uint8_t(i));
+        }
+        ret.insert(ret.end(), data.begin(), data.end());
+        return ret;
+    }
+}
+
+TEST_CASE("graphics.compressed_image")
+{
+    std::vector<std::uint8_t> bytes = MakeKtx2(ivec2(16, 8), 5);
+    Graphics::CompressedImage image(Stream::ReadOnlyData::mem_reference(bytes));
+
+    REQUIRE(image.Size() == ivec2(16, 8));
+    REQUIRE(image.GetFormat().compressed);
+    REQUIRE(image.GetFormat().internal_format == 0x83f0);
+    REQUIRE(image.Levels().size() == 5);
+    REQUIRE(image.Levels()[1].size == ivec2(8, 4));
+    REQUIRE(image.Levels()[4].size == ivec2(1, 1));
+    REQUIRE(image.Levels()[0].bytes.size() == 8 * 4 * 2);
+    REQUIRE(image.Levels()[3].bytes.size() == 8);
+    REQUIRE(image.Levels()[3].bytes[0] == 3);
+
+    // A truncated file is rejected.
+    std::vector<std::uint8_t> truncated(bytes.begin(), bytes.end() - 1);
+    REQUIRE_THROWS_AS(Graphics::CompressedImage(Stream::ReadOnlyData::mem_reference(truncated)), std::runtime_error);
+
+    // So is an unknown format.
+    std::vector<std::uint8_t> unknown = bytes;
+    unknown[12] = 1;
+    REQUIRE_THROWS_AS(Graphics::CompressedImage(Stream::ReadOnlyData::mem_reference(unknown)), std::runtime_error);
+}
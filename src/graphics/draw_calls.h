@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Graphics
+{
+    // The number of draw calls since the start of the program, made by `VertexBuffer` and `IndexBuffer`.
+    // Subtract two readings to get the number of draw calls in a frame, e.g. `Program::InputReplay` does that.
+    // Only the thread with the GL context draws, so this isn't atomic.
+    inline std::uint64_t draw_call_counter = 0;
+}
@@ -4,11 +4,12 @@
 
 #include <cglfl/cglfl.hpp>
 
+#include "graphics/vertex_buffer.h"
 #include "macros/finally.h"
 
 namespace Graphics
 {
-    class DummyVertexArray // Good for core profile
+    class DummyVertexArray // Good for core profile. Becomes the default vertex array for `VertexBuffers::BindDraw()`.
     {
         GLuint handle = 0;
 
@@ -23,7 +24,7 @@ namespace Graphics
                 throw std::runtime_error("Unable to create a dummy vertex array object.");
             // Not needed because nothing can throw below this point:
             // FINALLY_ON_THROW{glDeleteVertexArrays(1, &handle);};
-            glBindVertexArray(handle);
+            VertexBuffers::SetDefaultVertexArray(handle);
             #endif
         }
 
@@ -39,7 +40,10 @@ namespace Graphics
             #ifdef GL_VERTEX_ARRAY_BINDING
             // The object is unbound automatically.
             if (handle)
+            {
+                VertexBuffers::ForgetVertexArray(handle);
                 glDeleteVertexArrays(1, &handle); // Deleting 0 is a no-op, but GL could be unloaded at this point.
+            }
             #endif
         }
     };
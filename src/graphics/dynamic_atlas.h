@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "graphics/image.h"
+#include "graphics/texture.h"
+#include "program/errors.h"
+#include "strings/format.h"
+#include "utils/dynamic_packing.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    // A texture atlas that images can be added to and removed from at runtime (e.g. mod content, generated portraits, hot-reloaded sprites).
+    // Only the changed rect is uploaded. When a page is full, another page (a separate texture) is added.
+    // Unlike `MakeAtlas()`, this packs less tightly, so prefer that for the images known in advance.
+    // Usage:
+    //     DynamicAtlas atlas(ivec2(1024));
+    //     auto region = atlas.Insert(image);
+    //     ... atlas.PageTexture(region.page), region.rect ...
+    //     atlas.Replace(region, new_image); // When the file changes.
+    //     atlas.Free(region);
+    class DynamicAtlas
+    {
+      public:
+        struct Region
+        {
+            int page = -1;
+            irect2 rect; // In pixels. Doesn't include the gap.
+
+            [[nodiscard]] explicit operator bool() const
+            {
+                return page >= 0;
+            }
+        };
+
+      private:
+        struct Page
+        {
+            TexObject texture;
+            Packing::DynamicPacker packer;
+        };
+
+        ivec2 page_size = ivec2(0);
+        int gap = 0;
+        InterpolationMode interpolation = nearest;
+        std::vector<std::unique_ptr<Page>> pages;
+        TexUnit tex_unit; // Used to upload the images.
+        std::vector<u8vec4> transparent_pixels; // Used to clear the gaps.
+
+        // Uploads the image, and clears the gap to the right and below it, which can contain the leftovers of a freed image.
+        void Upload(const Region &region, const Image &image)
+        {
+            if (!tex_unit)
+                tex_unit = nullptr;
+
+            tex_unit.Attach(pages[region.page]->texture);
+            tex_unit.SetDataPart(region.rect.a, image.Size(), image.Data());
+
+            if (gap > 0)
+            {
+                ivec2 size = image.Size();
+                transparent_pixels.resize(std::size_t(max(size.x + gap, size.y) * gap));
+                const std::uint8_t *transparent = reinterpret_cast<const std::uint8_t *>(transparent_pixels.data());
+                if (region.rect.b.x < page_size.x)
+                    tex_unit.SetDataPart(ivec2(region.rect.b.x, region.rect.a.y), ivec2(min(gap, page_size.x - region.rect.b.x), size.y), transparent);
+                if (region.rect.b.y < page_size.y)
+                    tex_unit.SetDataPart(ivec2(region.rect.a.x, region.rect.b.y), ivec2(min(size.x + gap, page_size.x - region.rect.a.x), min(gap, page_size.y - region.rect.b.y)), transparent);
+            }
+
+            tex_unit.Detach();
+        }
+
+      public:
+        DynamicAtlas() {}
+
+        // `gap` is the empty space between the images, to stop them from bleeding into each other with linear interpolation.
+        DynamicAtlas(ivec2 page_size, int gap = 1, InterpolationMode interpolation = nearest)
+            : page_size(page_size), gap(gap), interpolation(interpolation)
+        {
+            if (page_size(any) <= 0 || gap < 0)
+                throw std::runtime_error("Invalid dynamic atlas parameters.");
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return page_size(all) > 0;
+        }
+
+        [[nodiscard]] ivec2 PageSize() const
+        {
+            return page_size;
+        }
+        [[nodiscard]] int PageCount() const
+        {
+            return int(pages.size());
+        }
+        [[nodiscard]] const TexObject &PageTexture(int page) const
+        {
+            ASSERT(page >= 0 && page < PageCount(), "Atlas page index is out of range.");
+            return pages[page]->texture;
+        }
+
+        // Adds an image, uploads it, and returns its location. Adds a new page if necessary. Throws if the image is larger than a page.
+        [[nodiscard]] Region Insert(const Image &image)
+        {
+            ASSERT(*this, "Attempt to use a null dynamic atlas.");
+            ivec2 size = image.Size();
+            if (size(any) <= 0 || size(any) > page_size)
+                throw std::runtime_error(FMT("Can't insert a {}x{} image into a dynamic atlas with {}x{} pages.", size.x, size.y, page_size.x, page_size.y));
+
+            // The gap isn't needed past the page edge.
+            ivec2 padded_size = min(size + gap, page_size);
+
+            Region ret;
+            for (int i = 0; i < PageCount(); i++)
+            {
+                if (auto pos = pages[i]->packer.Allocate(padded_size))
+                {
+                    ret = {.page = i, .rect = pos->rect_size(size)};
+                    break;
+                }
+            }
+
+            if (!ret)
+            {
+                if (!tex_unit)
+                    tex_unit = nullptr;
+
+                auto &page = *pages.emplace_back(std::make_unique<Page>());
+                page.texture = nullptr;
+                page.packer = Packing::DynamicPacker(page_size);
+                tex_unit.Attach(page.texture).SetData(Image(page_size)).Interpolation(interpolation).Wrap(clamp);
+                tex_unit.Detach();
+
+                ret = {.page = PageCount() - 1, .rect = page.packer.Allocate(padded_size).value().rect_size(size)};
+            }
+
+            Upload(ret, image);
+            return ret;
+        }
+
+        // Frees the space taken by an image. Doesn't touch the texture.
+        void Free(Region &region)
+        {
+            if (!region)
+                return;
+            ASSERT(region.page < PageCount(), "Atlas page index is out of range.");
+            pages[region.page]->packer.Free(region.rect.a.rect_size(min(region.rect.size() + gap, page_size)));
+            region = {};
+        }
+
+        // Replaces an image, e.g. when it's hot-reloaded. If the size is the same, it stays in place, otherwise it's moved.
+        void Replace(Region &region, const Image &image)
+        {
+            if (region && image.Size() == region.rect.size())
+            {
+                Upload(region, image);
+                return;
+            }
+
+            Free(region);
+            region = Insert(image);
+        }
+    };
+}
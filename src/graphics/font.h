@@ -27,6 +27,10 @@ namespace Graphics
         using kerning_func_t = std::function<int(uint32_t, uint32_t)>;
         kerning_func_t kerning_func = 0;
 
+        // Called for the glyphs that are missing from `glyphs`. Returns null if there's no such glyph either. See `GlyphCache`.
+        using missing_glyph_func_t = std::function<const Glyph *(uint32_t)>;
+        missing_glyph_func_t missing_glyph_func = 0;
+
         // Some code might rely on references not being invalidated on insertion. Keep that in mind if you decide to change the container.
         std::unordered_map<uint32_t, Glyph> glyphs;
         Glyph default_glyph;
@@ -70,6 +74,11 @@ namespace Graphics
             return line_skip - Height();
         }
 
+        void SetMissingGlyphFunc(missing_glyph_func_t new_missing_glyph_func) // You can use null function if you don't need it.
+        {
+            missing_glyph_func = std::move(new_missing_glyph_func);
+        }
+
         const kerning_func_t KerningFunc() const
         {
             return kerning_func;
@@ -96,12 +105,17 @@ namespace Graphics
         }
 
         // Note that returned references remain valid even after insertions.
+        // But the ones returned by the missing glyph func follow its rules, see `GlyphCache`.
         const Glyph &Get(uint32_t ch) const
         {
             if (auto it = glyphs.find(ch); it != glyphs.end())
                 return it->second;
-            else
-                return default_glyph;
+            if (missing_glyph_func)
+            {
+                if (const Glyph *glyph = missing_glyph_func(ch))
+                    return *glyph;
+            }
+            return default_glyph;
         }
         // If the glyph already exists, returns a reference to it instead of creating a new one.
         Glyph &Insert(uint32_t ch)
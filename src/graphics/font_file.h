@@ -1,9 +1,12 @@
 #pragma once
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <exception>
+#include <limits>
 #include <utility>
+#include <vector>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H // Ugh.
@@ -38,6 +41,86 @@ namespace Graphics
 
         Data data;
 
+        // The squared Euclidean distance transform of a 1D function, see "Distance Transforms of Sampled Functions" by Felzenszwalb and Huttenlocher.
+        // Reads `count` values from `src` and writes to `dst`, with the stride `stride`. `v` and `z` are scratch buffers of size `count` and `count + 1`.
+        static void DistanceTransform1D(const float *src, float *dst, int count, int stride, int *v, float *z)
+        {
+            int k = 0;
+            v[0] = 0;
+            z[0] = -std::numeric_limits<float>::infinity();
+            z[1] = std::numeric_limits<float>::infinity();
+            auto Intersection = [&](int q)
+            {
+                return ((src[q * stride] + q * q) - (src[v[k] * stride] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+            };
+            for (int q = 1; q < count; q++)
+            {
+                float s = Intersection(q);
+                while (s <= z[k])
+                {
+                    k--;
+                    s = Intersection(q);
+                }
+                k++;
+                v[k] = q;
+                z[k] = s;
+                z[k + 1] = std::numeric_limits<float>::infinity();
+            }
+            k = 0;
+            for (int q = 0; q < count; q++)
+            {
+                while (z[k + 1] < q)
+                    k++;
+                dst[q * stride] = (q - v[k]) * (q - v[k]) + src[v[k] * stride];
+            }
+        }
+
+        // For each pixel, the distance to the closest pixel where `grid` is 0. The other pixels of `grid` must be `far_distance`.
+        [[nodiscard]] static std::vector<float> DistanceTransform(ivec2 size, std::vector<float> grid)
+        {
+            std::vector<float> ret(grid.size());
+            int max_side = max(size.x, size.y);
+            std::vector<int> v(max_side);
+            std::vector<float> z(max_side + 1);
+            for (int x = 0; x < size.x; x++)
+                DistanceTransform1D(grid.data() + x, ret.data() + x, size.y, size.x, v.data(), z.data());
+            for (int y = 0; y < size.y; y++)
+                DistanceTransform1D(ret.data() + y * size.x, grid.data() + y * size.x, size.x, 1, v.data(), z.data());
+            for (std::size_t i = 0; i < grid.size(); i++)
+                ret[i] = std::sqrt(grid[i]);
+            return ret;
+        }
+
+        static constexpr float far_distance = 1e20f; // Not infinity, since that would give NaNs in `DistanceTransform1D()`.
+
+        // Converts a glyph to a signed distance field, adding `spread` pixels on each side.
+        static void MakeSignedDistanceField(Image &image, int spread)
+        {
+            ivec2 size = image.Size() + spread * 2;
+            std::vector<float> inside(std::size_t(size.prod()), far_distance), outside = inside;
+            for (int y = 0; y < size.y; y++)
+            for (int x = 0; x < size.x; x++)
+            {
+                ivec2 pos(x, y), image_pos = pos - spread;
+                bool is_inside = image.Bounds().contains(image_pos) && image.UnsafeAt(image_pos).a() >= 128;
+                (is_inside ? inside : outside)[std::size_t(y * size.x + x)] = 0;
+            }
+
+            std::vector<float> distance_to_inside = DistanceTransform(size, std::move(inside));
+            std::vector<float> distance_to_outside = DistanceTransform(size, std::move(outside));
+
+            image = Image(size);
+            for (int y = 0; y < size.y; y++)
+            for (int x = 0; x < size.x; x++)
+            {
+                std::size_t i = std::size_t(y * size.x + x);
+                // Positive inside. The edge is between the pixel centers, hence the `0.5`.
+                float distance = distance_to_inside[i] > 0 ? 0.5f - distance_to_inside[i] : distance_to_outside[i] - 0.5f;
+                float value = std::clamp(0.5f + distance / (2 * spread), 0.f, 1.f);
+                image.UnsafeAt(ivec2(x, y)) = u8vec3(255).to_vec4(iround(value * 255));
+            }
+        }
+
       public:
         FontFile() {}
 
@@ -201,6 +284,7 @@ namespace Graphics
             hinting_disable_autohinter = 1 << 4, // Disable auto-hinter. (It's already avoided by default.)
             hinting_mode_light         = 1 << 5, // Alternative hinting mode.
             hinting_mode_monochrome    = 1 << 6, // Hinting mode for monochrome rendering.
+            sdf                        = 1 << 7, // Output a signed distance field in the alpha channel, which can be drawn at any scale. See `GetGlyph()`.
 
             monochrome_with_hinting = monochrome | hinting_mode_monochrome,
         };
@@ -214,8 +298,13 @@ namespace Graphics
             int advance;
         };
 
+        static constexpr int default_sdf_spread = 8;
+
         // Throws on failure. In particular, throws if the font has no such glyph.
-        GlyphData GetGlyph(uint32_t ch, RenderFlags flags) const
+        // With the `sdf` flag, the alpha channel is `0.5 + distance / (2 * sdf_spread)`, where the distance to the edge is in pixels, and positive inside.
+        // The image then has `sdf_spread` extra pixels on each side, and the offset is adjusted accordingly.
+        // Since the field is computed from the rasterized glyph, load the font at a large size (e.g. 64) for this, and scale the glyphs down when drawing.
+        GlyphData GetGlyph(uint32_t ch, RenderFlags flags, int sdf_spread = default_sdf_spread) const
         {
             try
             {
@@ -239,7 +328,7 @@ namespace Graphics
 
                     // We can't render the default character (aka [?]), try the plain question mark instead.
                     if (HasGlyph('?'))
-                        return GetGlyph('?', flags);
+                        return GetGlyph('?', flags, sdf_spread);
 
                     // Return an empty glyph.
                     GlyphData ret;
@@ -293,6 +382,12 @@ namespace Graphics
                     }
                 }
 
+                if ((flags & sdf) && ret.image)
+                {
+                    MakeSignedDistanceField(ret.image, sdf_spread);
+                    ret.offset -= sdf_spread;
+                }
+
                 return ret;
             }
             catch (std::exception &e)
@@ -318,6 +413,7 @@ namespace Graphics
         const Unicode::CharSet *glyphs = 0;
         FontFile::RenderFlags render_flags = FontFile::none;
         Flags flags = none;
+        int sdf_spread = FontFile::default_sdf_spread; // Only used with `FontFile::sdf`.
 
         FontAtlasEntry() {}
         FontAtlasEntry(Font &target, const FontFile &source, const Unicode::CharSet &glyphs, FontFile::RenderFlags render_flags = FontFile::none, Flags flags = none)
@@ -352,7 +448,7 @@ namespace Graphics
                     return;
 
                 // Copy glyph to the font.
-                FontFile::GlyphData glyph_data = entry.source->GetGlyph(ch, entry.render_flags);
+                FontFile::GlyphData glyph_data = entry.source->GetGlyph(ch, entry.render_flags, entry.sdf_spread);
                 Font::Glyph &font_glyph = (ch != Unicode::default_char ? entry.target->Insert(ch) : entry.target->DefaultGlyph());
                 font_glyph.size = glyph_data.image.Size();
                 font_glyph.offset = glyph_data.offset;
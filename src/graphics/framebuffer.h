@@ -1,11 +1,15 @@
 #pragma once
 
 #include <numeric>
+#include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include <cglfl/cglfl.hpp>
 
+#include "graphics/profiler.h"
+#include "graphics/state_cache.h"
 #include "graphics/texture.h"
 #include "program/errors.h"
 #include "macros/finally.h"
@@ -27,8 +31,6 @@ namespace Graphics
 
         Data data;
 
-        inline static GLuint binding = 0;
-
         static constexpr GLenum binding_point =
         #ifdef GL_DRAW_FRAMEBUFFER
             GL_DRAW_FRAMEBUFFER;
@@ -91,10 +93,11 @@ namespace Graphics
 
         ~FrameBuffer()
         {
-            if (Bound())
-                binding = 0; // Deleting a framebuffer unbinds it. We just need to adjust the saved binding.
             if (data.handle)
+            {
                 glDeleteFramebuffers(1, &data.handle); // Deleting 0 is a no-op, but GL could be unloaded at this point.
+                StateCache::OnFramebufferDeleted(data.handle); // Deleting a framebuffer unbinds it. We just need to adjust the saved binding.
+            }
         }
 
         explicit operator bool() const
@@ -109,10 +112,10 @@ namespace Graphics
 
         static void BindHandle(GLuint handle)
         {
-            if (binding == handle)
+            if (!StateCache::BindFramebuffer(binding_point, handle))
                 return;
-            glBindFramebuffer(binding_point, handle);
-            binding = handle;
+            if (Profiler::active)
+                Profiler::active->Pass(handle ? "framebuffer " + std::to_string(handle) : "default framebuffer");
         }
 
         void Bind() const
@@ -126,9 +129,22 @@ namespace Graphics
         {
             BindHandle(0);
         }
+        // The currently bound framebuffer. Asks GL if the state cache doesn't know it.
+        [[nodiscard]] static GLuint CurrentBinding()
+        {
+            if (std::optional<GLuint> binding = StateCache::BoundFramebuffer())
+                return *binding;
+            GLint ret = 0;
+            #ifdef GL_DRAW_FRAMEBUFFER_BINDING
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &ret);
+            #else
+            glGetIntegerv(GL_FRAMEBUFFER_BINDING, &ret);
+            #endif
+            return GLuint(ret);
+        }
         [[nodiscard]] bool Bound() const
         {
-            return data.handle && binding == data.handle;
+            return data.handle && StateCache::BoundFramebuffer() == data.handle;
         }
 
         FrameBuffer &&Attach(Attachment att) // Old non-depth attachments are discarded.
@@ -137,7 +153,7 @@ namespace Graphics
             if (!*this)
                 return std::move(*this);
 
-            GLuint old_binding = binding;
+            GLuint old_binding = CurrentBinding();
             Bind();
             FINALLY{BindHandle(old_binding);};
 
@@ -156,7 +172,7 @@ namespace Graphics
             if (!*this)
                 return std::move(*this);
 
-            GLuint old_binding = binding;
+            GLuint old_binding = CurrentBinding();
             Bind();
             FINALLY{BindHandle(old_binding);};
 
@@ -177,7 +193,7 @@ namespace Graphics
             if (!*this)
                 return std::move(*this);
 
-            GLuint old_binding = binding;
+            GLuint old_binding = CurrentBinding();
             Bind();
             FINALLY{BindHandle(old_binding);};
 
@@ -192,7 +208,7 @@ namespace Graphics
             if (!*this)
                 return std::move(*this);
 
-            GLuint old_binding = binding;
+            GLuint old_binding = CurrentBinding();
             Bind();
             FINALLY{BindHandle(old_binding);};
 
@@ -1,18 +1,31 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <map>
+#include <stdexcept>
 #include <string_view>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "graphics/compressed_image.h"
 #include "graphics/image.h"
 #include "graphics/texture_atlas.h"
 #include "graphics/texture.h"
 #include "macros/enum_flag_operators.h"
 #include "meta/const_string.h"
+#include "stream/input.h"
+#include "stream/output.h"
 #include "stream/readonly_data.h"
+#include "stream/save_to_file.h"
+#include "utils/archive.h"
+#include "utils/filesystem.h"
+#include "utils/jobs.h"
 #include "utils/mat.h"
+#include "utils/trace.h"
 
 namespace Graphics
 {
@@ -21,6 +34,22 @@ namespace Graphics
     {
         std::string_view atlas;
 
+        // If the image was trimmed by `AtlasFlags::trim_alpha`, the position of this rect in the original image, and the size of the original image.
+        // Otherwise both are zero.
+        ivec2 trim_offset;
+        ivec2 full_size;
+
+        [[nodiscard]] bool IsTrimmed() const
+        {
+            return full_size != ivec2(0);
+        }
+
+        // The size of the original image, before trimming.
+        [[nodiscard]] ivec2 UntrimmedSize() const
+        {
+            return IsTrimmed() ? full_size : size();
+        }
+
         // This lets us do `Region(...) with(().shrink(n))`, and so on.
         // Slightly more flexible than `using irect2::operator=;`.
         Region &operator=(irect2 r)
@@ -40,10 +69,20 @@ namespace Graphics::GlobalData
         TexObject texture;
         ivec2 size; // Since `image` can be null, and the texture doesn't remember its size, we also store it here.
         Image image; // Normally null, unless `Flags::keep_images` is used.
+
+        #ifdef IMP_HAVE_TEXTURE_ARRAYS
+        // If `AtlasParams::texture_array` was used, the name of that array (see `GetTextureArrays()`) and the layer of this atlas in it.
+        std::string texture_array;
+        int texture_array_layer = -1;
+        #endif
     };
 
     using AtlasMap = std::map<std::string, Atlas, std::less<>>;
 
+    #ifdef IMP_HAVE_TEXTURE_ARRAYS
+    using TextureArrayMap = std::map<std::string, TextureArray, std::less<>>;
+    #endif
+
     // Derive from this to generate an image, see `Image()` below.
     // An instance is created when the image is generated.
     // `Size()` is called first, then `Generate()` is called. Then the object is destroyed.
@@ -52,6 +91,8 @@ namespace Graphics::GlobalData
         virtual ~Generator() = default;
         [[nodiscard]] virtual ivec2 Size() const = 0;
         virtual void Generate(Image &image, irect2 rect) = 0;
+        // Return true if `Generate()` can run at the same time as the other generators (each writes only to its own `rect`).
+        [[nodiscard]] virtual bool ThreadSafe() const {return false;}
     };
 
     namespace impl
@@ -69,6 +110,9 @@ namespace Graphics::GlobalData
             using RegionPair = decltype(regions)::value_type;
 
             AtlasMap atlases;
+            #ifdef IMP_HAVE_TEXTURE_ARRAYS
+            TextureArrayMap texture_arrays;
+            #endif
         };
 
         [[nodiscard]] inline State &GetState()
@@ -77,6 +121,164 @@ namespace Graphics::GlobalData
             return ret;
         }
 
+        // Calls `func(i)` for each `i` in `[0, count)`, in at most `num_threads` jobs on `Jobs::GlobalPool()`. Zero means the concurrency of the pool.
+        // `on_progress(done)` is called on this thread, after it finishes an element.
+        // If anything throws, waits for all jobs to finish, then rethrows the first exception.
+        inline void ParallelFor(std::size_t count, int num_threads, const std::function<void(std::size_t i)> &func, const std::function<void(std::size_t done)> &on_progress)
+        {
+            Jobs::ThreadPool &pool = Jobs::GlobalPool();
+            if (num_threads <= 0)
+                num_threads = pool.Concurrency();
+            num_threads = std::clamp(int(std::min(count, std::size_t(num_threads))), 1, num_threads);
+
+            const std::thread::id this_thread = std::this_thread::get_id();
+            std::atomic<std::size_t> next = 0, done = 0;
+            std::atomic<bool> failed = false;
+
+            // The jobs take the elements one by one, since they can take very different time.
+            Jobs::ParallelFor(pool, 0, std::size_t(num_threads), [&](std::size_t)
+            {
+                try
+                {
+                    while (!failed.load(std::memory_order_relaxed))
+                    {
+                        std::size_t i = next++;
+                        if (i >= count)
+                            break;
+                        func(i);
+                        std::size_t new_done = ++done;
+                        if (on_progress && std::this_thread::get_id() == this_thread)
+                            on_progress(new_done);
+                    }
+                }
+                catch (...)
+                {
+                    failed = true;
+                    throw;
+                }
+            });
+        }
+
+        // The atlas cache format: the magic, the format version (`uint32_t`), the key (`uint64_t`), the atlas width and height (`int32_t`),
+        //   the region count (`uint32_t`), then for each region: the name (a size as `uint32_t`, then the bytes), x, y, width, height,
+        //   then the trim offset x, y, and the full width, height (`int32_t`, see `Region`).
+        // Then the pixels until the end of file, compressed by `Archive::Compress()`. All numbers are little-endian.
+        inline constexpr std::string_view atlas_cache_magic = "imp.atls";
+        inline constexpr std::uint32_t atlas_cache_version = 2; // Increment when changing the format.
+
+        // 64-bit FNV-1a. Pass the previous result as `hash` to continue hashing. The hash is stable between runs and platforms.
+        [[nodiscard]] inline std::uint64_t HashBytes(const void *data, std::size_t size, std::uint64_t hash = 0xcbf29ce484222325)
+        {
+            for (std::size_t i = 0; i < size; i++)
+            {
+                hash ^= static_cast<const std::uint8_t *>(data)[i];
+                hash *= 0x100000001b3;
+            }
+            return hash;
+        }
+        [[nodiscard]] inline std::uint64_t HashInt(std::int64_t value, std::uint64_t hash)
+        {
+            std::uint8_t bytes[8];
+            for (int i = 0; i < 8; i++)
+                bytes[i] = std::uint8_t(std::uint64_t(value) >> (i * 8));
+            return HashBytes(bytes, sizeof bytes, hash);
+        }
+
+        // Loads the regions and the image of an atlas from the cache, if the key matches. Returns false on a mismatch. Throws if the data is malformed.
+        [[nodiscard]] inline bool LoadAtlasCache(const Stream::ReadOnlyData &data, std::uint64_t key, const std::vector<State::RegionPair *> &regions, Graphics::Image &image)
+        {
+            Stream::Input input(data);
+            input.WantLocationStyle(Stream::byte_offset);
+
+            if (!input.DiscardChars<Stream::if_present>(atlas_cache_magic))
+                throw std::runtime_error(input.GetExceptionPrefix() + "This is not an atlas cache.");
+            if (input.ReadLittle<std::uint32_t>() != atlas_cache_version || input.ReadLittle<std::uint64_t>() != key)
+                return false;
+
+            ivec2 size;
+            size.x = input.ReadLittle<std::int32_t>();
+            size.y = input.ReadLittle<std::int32_t>();
+            if (size(any) <= 0)
+                throw std::runtime_error(input.GetExceptionPrefix() + "Invalid atlas size.");
+
+            if (input.ReadLittle<std::uint32_t>() != regions.size())
+                return false;
+            std::vector<Region> rects;
+            rects.reserve(regions.size());
+            for (const State::RegionPair *pair : regions)
+            {
+                std::uint32_t name_size = input.ReadLittle<std::uint32_t>();
+                if (name_size > input.RemainingBytes())
+                    throw std::runtime_error(input.GetExceptionPrefix() + "String size is out of bounds.");
+                std::string name(name_size, '\0');
+                input.Read(name.data(), name_size);
+                if (name != pair->first)
+                    return false;
+
+                Region &rect = rects.emplace_back();
+                rect.a.x = input.ReadLittle<std::int32_t>();
+                rect.a.y = input.ReadLittle<std::int32_t>();
+                rect.b.x = input.ReadLittle<std::int32_t>();
+                rect.b.y = input.ReadLittle<std::int32_t>();
+                rect.b += rect.a;
+                rect.trim_offset.x = input.ReadLittle<std::int32_t>();
+                rect.trim_offset.y = input.ReadLittle<std::int32_t>();
+                rect.full_size.x = input.ReadLittle<std::int32_t>();
+                rect.full_size.y = input.ReadLittle<std::int32_t>();
+            }
+
+            const std::uint8_t *pixels_begin = data.data() + input.Position();
+            if (Archive::UncompressedSize(pixels_begin, data.end()) != std::size_t(size.prod()) * sizeof(u8vec4))
+                throw std::runtime_error(input.GetExceptionPrefix() + "Unexpected size of the atlas pixels.");
+            std::vector<std::uint8_t> pixels(std::size_t(size.prod()) * sizeof(u8vec4));
+            Archive::Uncompress(pixels_begin, data.end(), pixels.data());
+            image = Graphics::Image(size, pixels.data());
+
+            for (std::size_t i = 0; i < regions.size(); i++)
+            {
+                Region &region = regions[i]->second.region;
+                region = irect2(rects[i]); // Not the whole `Region`, to keep the atlas name.
+                region.trim_offset = rects[i].trim_offset;
+                region.full_size = rects[i].full_size;
+            }
+            return true;
+        }
+
+        // Writes the regions and the image of an atlas to the cache.
+        inline void SaveAtlasCache(const std::string &file_name, std::uint64_t key, const std::vector<State::RegionPair *> &regions, const Graphics::Image &image)
+        {
+            std::vector<std::uint8_t> bytes;
+            Stream::Output output = Stream::Output::Container(bytes);
+            output.WriteString(atlas_cache_magic.data(), atlas_cache_magic.size());
+            output.WriteLittle<std::uint32_t>(atlas_cache_version);
+            output.WriteLittle<std::uint64_t>(key);
+            output.WriteLittle<std::int32_t>(image.Size().x);
+            output.WriteLittle<std::int32_t>(image.Size().y);
+            output.WriteLittle<std::uint32_t>(regions.size());
+            for (const State::RegionPair *pair : regions)
+            {
+                output.WriteLittle<std::uint32_t>(pair->first.size());
+                output.WriteString(pair->first);
+                const Region &rect = pair->second.region;
+                output.WriteLittle<std::int32_t>(rect.a.x);
+                output.WriteLittle<std::int32_t>(rect.a.y);
+                output.WriteLittle<std::int32_t>(rect.size().x);
+                output.WriteLittle<std::int32_t>(rect.size().y);
+                output.WriteLittle<std::int32_t>(rect.trim_offset.x);
+                output.WriteLittle<std::int32_t>(rect.trim_offset.y);
+                output.WriteLittle<std::int32_t>(rect.full_size.x);
+                output.WriteLittle<std::int32_t>(rect.full_size.y);
+            }
+
+            const std::uint8_t *pixels_begin = image.Data(), *pixels_end = pixels_begin + std::size_t(image.Size().prod()) * sizeof(u8vec4);
+            std::vector<std::uint8_t> compressed(Archive::MaxCompressedSize(pixels_begin, pixels_end, Archive::Codec::zlib_fast));
+            compressed.resize(std::size_t(Archive::Compress(pixels_begin, pixels_end, compressed.data(), compressed.data() + compressed.size(), Archive::Codec::zlib_fast) - compressed.data()));
+            output.WriteString(reinterpret_cast<const char *>(compressed.data()), compressed.size());
+            output.Flush();
+
+            Stream::SaveFileAtomic(file_name, bytes);
+        }
+
         template <Meta::ConstString Name, typename Generate>
         struct RegisterImage
         {
@@ -130,13 +332,36 @@ namespace Graphics::GlobalData
 
         // Optional, modifies an image after it's loaded, before generating a texture.
         std::function<void(Graphics::Image &image)> modify_image;
+
+        #ifdef IMP_HAVE_TEXTURE_ARRAYS
+        // Optional. The atlases with the same non-empty name here are additionally uploaded as the layers of one array texture (see `GetTextureArrays()`),
+        //   so the images from all of them can be drawn without switching textures. Those atlases must have the same size.
+        // The wrap and interpolation modes of the array come from the first of its atlases, in the order of their names.
+        // The array texture is always made from the atlas image, even if `LoadParams::get_compressed_atlas` is used.
+        std::string texture_array;
+        #endif
     };
 
     struct LoadParams
     {
-        std::function<Stream::ReadOnlyData(const std::string &name)> get_data; // Mandatory, returns the memory to load the image from.
+        std::function<Stream::ReadOnlyData(const std::string &name)> get_data; // Mandatory, returns the memory to load the image from. Called from several threads at once.
         std::function<std::string(const std::string &name)> name_to_atlas; // Optional, maps images to atlases. Assumed to return an empty string by default, putting all images into a single atlas.
         std::function<AtlasParams(const std::string &atlas)> atlas_params; // Optional, returns per-atlas parameters. Returns default-constructed parameters by default.
+        // Optional, returns a KTX2 file (see `CompressedImage`) to use as the atlas texture instead of the generated atlas image, or null data to use the image.
+        // The file must be made from the image generated with the same parameters (e.g. saved with `keep_image`), and then compressed offline.
+        // The image is still generated (or loaded from `cache_prefix`), because the regions come from it.
+        std::function<Stream::ReadOnlyData(const std::string &atlas)> get_compressed_atlas;
+
+        // Optional. If not empty, the packed atlases are cached in `<cache_prefix><atlas name>.atlas` files, and loaded from them when the inputs don't change.
+        // The cache is keyed by the contents of the images, the sizes of the generated images, and the atlas sizes and flags.
+        // It can't see the changes to the generators and to `AtlasParams::modify_image`, so change `cache_version` along with them.
+        std::string cache_prefix;
+        std::string cache_version;
+
+        // The max number of jobs decoding the images and running the thread-safe generators at once on `Jobs::GlobalPool()`. Zero means the concurrency of the pool.
+        int num_threads = 0;
+        // Optional, called on the current thread as the images are decoded, e.g. for a loading screen.
+        std::function<void(std::size_t done, std::size_t total)> on_progress;
 
         LoadParams() {}
 
@@ -153,62 +378,207 @@ namespace Graphics::GlobalData
         }
     };
 
+    namespace impl
+    {
+        // Whether the atlas is also uploaded into an array texture. Always false if those aren't supported.
+        [[nodiscard]] inline bool InTextureArray(const AtlasParams &atlas_params)
+        {
+            #ifdef IMP_HAVE_TEXTURE_ARRAYS
+            return !atlas_params.texture_array.empty();
+            #else
+            (void)atlas_params;
+            return false;
+            #endif
+        }
+    }
+
     // Loads all images mentioned in `Image()` calls into atlases.
     inline void Load(const LoadParams &params)
     {
+        IMP_TRACE_ZONE("Graphics::GlobalData::Load");
+
         // In case the list of atlases changes.
         impl::GetState().atlases.clear();
+        #ifdef IMP_HAVE_TEXTURE_ARRAYS
+        impl::GetState().texture_arrays.clear();
+        #endif
 
         // Group the regions by atlases.
         std::map<std::string, std::vector<impl::State::RegionPair *>, std::less<>> regions_per_atlas;
         for (auto &elem : impl::GetState().regions)
             regions_per_atlas[params.name_to_atlas ? params.name_to_atlas(elem.first) : std::string{}].push_back(&elem);
 
+        std::map<std::string, AtlasParams, std::less<>> params_per_atlas;
+        for (const auto &[atlas_name, regions] : regions_per_atlas)
+            params_per_atlas.try_emplace(atlas_name, params.atlas_params ? params.atlas_params(atlas_name) : AtlasParams{});
+
         TexUnit tex_unit = nullptr; // We need this to upload images to textures.
 
-        // For each atlas...
-        for (auto &[atlas_name, regions] : regions_per_atlas)
+        // Try loading the atlases from the cache.
+        std::map<std::string, std::uint64_t, std::less<>> cache_keys;
+        if (!params.cache_prefix.empty())
         {
-            Atlas &atlas = impl::GetState().atlases.try_emplace(atlas_name).first->second;
-
-            AtlasParams atlas_params;
-            if (params.atlas_params)
-                atlas_params = params.atlas_params(atlas_name);
-
-            struct GeneratedImage
+            // Hash the image files in parallel. This still reads them, but it's much cheaper than decoding them.
+            std::vector<std::pair<const impl::State::RegionPair *, std::uint64_t>> file_hashes;
+            for (const auto &[atlas_name, regions] : regions_per_atlas)
             {
-                std::unique_ptr<Generator> generator;
-                impl::State::RegionPair *region = nullptr;
-            };
-            std::vector<GeneratedImage> generated_images;
+                for (const impl::State::RegionPair *pair : regions)
+                {
+                    if (!pair->second.make_generator)
+                        file_hashes.emplace_back(pair, 0);
+                }
+            }
+            impl::ParallelFor(file_hashes.size(), params.num_threads, [&](std::size_t i)
+            {
+                Stream::ReadOnlyData data = params.get_data(file_hashes[i].first->first);
+                file_hashes[i].second = impl::HashBytes(data.data(), data.size());
+            }, nullptr);
 
-            // Generate the atlas.
-            atlas.image = MakeAtlas(atlas_params.size, [&, &regions = regions](AtlasInputFunc func)
+            std::size_t next_file_hash = 0;
+            for (const auto &[atlas_name, regions] : regions_per_atlas)
             {
-                for (impl::State::RegionPair *pair : regions)
+                const AtlasParams &atlas_params = params_per_atlas.at(atlas_name);
+
+                std::uint64_t key = impl::HashBytes(params.cache_version.data(), params.cache_version.size());
+                key = impl::HashInt(atlas_params.size.x, key);
+                key = impl::HashInt(atlas_params.size.y, key);
+                key = impl::HashInt(std::int64_t(atlas_params.atlas_flags), key);
+                for (const impl::State::RegionPair *pair : regions)
                 {
+                    key = impl::HashBytes(pair->first.c_str(), pair->first.size() + 1, key); // Including the null terminator, to separate the names.
                     if (pair->second.make_generator)
                     {
-                        if (generated_images.empty())
-                            generated_images.reserve(regions.size());
-                        generated_images.push_back({.generator = pair->second.make_generator(), .region = pair});
-                        func(generated_images.back().generator->Size(), pair->second.region);
+                        ivec2 size = pair->second.make_generator()->Size();
+                        key = impl::HashInt(size.x, key);
+                        key = impl::HashInt(size.y, key);
                     }
                     else
                     {
-                        func(params.get_data(pair->first), pair->second.region);
+                        key = impl::HashInt(std::int64_t(file_hashes[next_file_hash++].second), key);
+                    }
+                }
+
+                std::string file_name = params.cache_prefix + atlas_name + ".atlas";
+                bool cache_exists = false;
+                (void)Filesystem::GetObjectInfo(file_name, &cache_exists);
+                if (cache_exists)
+                {
+                    try
+                    {
+                        Atlas &atlas = impl::GetState().atlases.try_emplace(atlas_name).first->second;
+                        if (impl::LoadAtlasCache(Stream::ReadOnlyData::file_mapped(file_name), key, regions, atlas.image))
+                            continue; // Don't remember the key, to not overwrite the file.
+                        atlas.image = {};
+                    }
+                    catch (...)
+                    {
+                        // The cache is broken, regenerate it.
+                    }
+                }
+
+                cache_keys.try_emplace(atlas_name, key);
+            }
+        }
+        auto IsCached = [&](const std::string &atlas_name)
+        {
+            return !params.cache_prefix.empty() && !cache_keys.contains(atlas_name);
+        };
+
+        // Decode all images in parallel, in the same order as they are consumed below.
+        std::vector<std::pair<const impl::State::RegionPair *, Graphics::Image>> decoded_images;
+        for (const auto &[atlas_name, regions] : regions_per_atlas)
+        {
+            if (IsCached(atlas_name))
+                continue;
+            for (const impl::State::RegionPair *pair : regions)
+            {
+                if (!pair->second.make_generator)
+                    decoded_images.emplace_back(pair, Graphics::Image{});
+            }
+        }
+        impl::ParallelFor(decoded_images.size(), params.num_threads, [&](std::size_t i)
+        {
+            decoded_images[i].second = Graphics::Image(params.get_data(decoded_images[i].first->first));
+        }, [&](std::size_t done)
+        {
+            if (params.on_progress)
+                params.on_progress(done, decoded_images.size());
+        });
+        if (params.on_progress)
+            params.on_progress(decoded_images.size(), decoded_images.size());
+        std::size_t next_decoded_image = 0;
+
+        // For each atlas...
+        for (auto &[atlas_name, regions] : regions_per_atlas)
+        {
+            Atlas &atlas = impl::GetState().atlases.try_emplace(atlas_name).first->second;
+            const AtlasParams &atlas_params = params_per_atlas.at(atlas_name);
+
+            if (!IsCached(atlas_name))
+            {
+                struct GeneratedImage
+                {
+                    std::unique_ptr<Generator> generator;
+                    impl::State::RegionPair *region = nullptr;
+                };
+                std::vector<GeneratedImage> generated_images;
+
+                // Generate the atlas.
+                atlas.image = MakeAtlas(atlas_params.size, [&, &regions = regions](AtlasInputFunc func)
+                {
+                    for (impl::State::RegionPair *pair : regions)
+                    {
+                        if (pair->second.make_generator)
+                        {
+                            if (generated_images.empty())
+                                generated_images.reserve(regions.size());
+                            generated_images.push_back({.generator = pair->second.make_generator(), .region = pair});
+                            func(generated_images.back().generator->Size(), pair->second.region, nullptr);
+                            pair->second.region.trim_offset = pair->second.region.full_size = ivec2(0);
+                        }
+                        else
+                        {
+                            ASSERT(decoded_images[next_decoded_image].first == pair);
+                            AtlasTrim trim;
+                            func(std::move(decoded_images[next_decoded_image++].second), pair->second.region, &trim);
+                            bool trimmed = trim.full_size != pair->second.region.size();
+                            pair->second.region.trim_offset = trimmed ? trim.offset : ivec2(0);
+                            pair->second.region.full_size = trimmed ? trim.full_size : ivec2(0);
+                        }
                     }
+                }, atlas_params.atlas_flags);
+
+                // Insert the custom images into the atlas, if any. The thread-safe generators run in parallel.
+                std::vector<GeneratedImage *> parallel_generated_images;
+                for (GeneratedImage &generated : generated_images)
+                {
+                    if (generated.generator->ThreadSafe())
+                        parallel_generated_images.push_back(&generated);
+                    else
+                        generated.generator->Generate(atlas.image, generated.region->second.region);
                 }
-            }, atlas_params.atlas_flags);
+                impl::ParallelFor(parallel_generated_images.size(), params.num_threads, [&](std::size_t i)
+                {
+                    parallel_generated_images[i]->generator->Generate(atlas.image, parallel_generated_images[i]->region->second.region);
+                }, nullptr);
+                generated_images.clear();
 
-            // Insert the custom images into the atlas, if any.
-            for (GeneratedImage &generated : generated_images)
-                generated.generator->Generate(atlas.image, generated.region->second.region);
-            generated_images.clear();
+                // Run a custom callback on the image, if any.
+                if (atlas_params.modify_image)
+                    atlas_params.modify_image(atlas.image);
 
-            // Run a custom callback on the image, if any.
-            if (atlas_params.modify_image)
-                atlas_params.modify_image(atlas.image);
+                if (auto it = cache_keys.find(atlas_name); it != cache_keys.end())
+                {
+                    try
+                    {
+                        impl::SaveAtlasCache(params.cache_prefix + atlas_name + ".atlas", it->second, regions, atlas.image);
+                    }
+                    catch (...)
+                    {
+                        // Failing to write the cache isn't fatal, we'll just regenerate the atlas next time.
+                    }
+                }
+            }
 
             atlas.size = atlas.image.Size();
 
@@ -216,11 +586,142 @@ namespace Graphics::GlobalData
             if (!bool(atlas_params.flags & Flags::no_texture))
             {
                 atlas.texture = nullptr;
-                tex_unit.Attach(atlas.texture).SetData(atlas.image).Wrap(atlas_params.texture_wrap).Interpolation(atlas_params.texture_interpolation);
-                if (!bool(atlas_params.flags & Flags::keep_image))
+                tex_unit.Attach(atlas.texture);
+
+                Stream::ReadOnlyData compressed_file;
+                if (params.get_compressed_atlas)
+                    compressed_file = params.get_compressed_atlas(atlas_name);
+                if (compressed_file)
+                {
+                    CompressedImage compressed(std::move(compressed_file));
+                    if (compressed.Size() != atlas.size)
+                        throw std::runtime_error(FMT("The compressed texture for atlas `{}` has size [{},{}], but the atlas has size [{},{}].", atlas_name, compressed.Size().x, compressed.Size().y, atlas.size.x, atlas.size.y));
+                    tex_unit.SetData(compressed);
+                }
+                else
+                {
+                    tex_unit.SetData(atlas.image);
+                }
+
+                tex_unit.Wrap(atlas_params.texture_wrap).Interpolation(atlas_params.texture_interpolation);
+                if (!bool(atlas_params.flags & Flags::keep_image) && !impl::InTextureArray(atlas_params))
                     atlas.image = {};
             }
         }
+
+        #ifdef IMP_HAVE_TEXTURE_ARRAYS
+        // Upload the atlases into the array textures.
+        std::map<std::string, std::vector<std::pair<Atlas *, const AtlasParams *>>, std::less<>> atlases_per_array;
+        for (auto &[atlas_name, atlas] : impl::GetState().atlases)
+        {
+            const AtlasParams &atlas_params = params_per_atlas.at(atlas_name);
+            if (impl::InTextureArray(atlas_params))
+                atlases_per_array[atlas_params.texture_array].emplace_back(&atlas, &atlas_params);
+        }
+        for (const auto &[array_name, atlases] : atlases_per_array)
+        {
+            ivec2 size = atlases.front().first->size;
+            TextureArray &array = impl::GetState().texture_arrays.try_emplace(array_name, nullptr).first->second;
+            array.SetData(size, int(atlases.size()));
+
+            for (int layer = 0; auto [atlas, atlas_params] : atlases)
+            {
+                if (atlas->size != size)
+                    throw std::runtime_error(FMT("The atlases in the texture array `{}` have different sizes: [{},{}] and [{},{}].", array_name, size.x, size.y, atlas->size.x, atlas->size.y));
+                atlas->texture_array = array_name;
+                atlas->texture_array_layer = layer;
+                array.SetLayer(layer, atlas->image);
+                if (!bool(atlas_params->flags & (Flags::keep_image | Flags::no_texture)))
+                    atlas->image = {};
+                layer++;
+            }
+
+            const AtlasParams &first_params = *atlases.front().second;
+            array.Wrap(first_params.texture_wrap).Interpolation(first_params.texture_interpolation);
+        }
+        #endif
+    }
+
+    // Reloads only the specified images, e.g. the ones reported by `Filesystem::Watcher`. Use this for hot reloading.
+    // The `names` are the ones passed to `Image()`. The unknown names and the generated images are ignored.
+    // The images that kept their size are written into the existing atlases in place. If some image changed its size,
+    //   or its atlas uses `AtlasParams::modify_image`, `AtlasFlags::trim_alpha`, or `LoadParams::get_compressed_atlas`, falls back to a full `Load()`.
+    // Returns true if everything was updated in place, false if `Load()` was called.
+    // The atlas cache isn't updated, it will be regenerated by the next `Load()`.
+    inline bool Reload(const LoadParams &params, const std::vector<std::string> &names)
+    {
+        IMP_TRACE_ZONE("Graphics::GlobalData::Reload");
+
+        std::vector<std::pair<const impl::State::RegionPair *, Graphics::Image>> decoded_images;
+        for (const std::string &name : names)
+        {
+            auto it = impl::GetState().regions.find(name);
+            if (it != impl::GetState().regions.end() && !it->second.make_generator)
+                decoded_images.emplace_back(&*it, Graphics::Image{});
+        }
+        if (decoded_images.empty())
+            return true;
+
+        impl::ParallelFor(decoded_images.size(), params.num_threads, [&](std::size_t i)
+        {
+            decoded_images[i].second = Graphics::Image(params.get_data(decoded_images[i].first->first));
+        }, nullptr);
+
+        // Check that everything can be updated in place.
+        std::map<std::string, AtlasParams, std::less<>> params_per_atlas;
+        std::vector<std::pair<Atlas *, const AtlasParams *>> targets;
+        targets.reserve(decoded_images.size());
+        for (const auto &[pair, image] : decoded_images)
+        {
+            std::string atlas_name = params.name_to_atlas ? params.name_to_atlas(pair->first) : std::string{};
+            auto atlas_it = impl::GetState().atlases.find(atlas_name);
+            if (atlas_it == impl::GetState().atlases.end() || image.Size() != pair->second.region.size())
+            {
+                Load(params);
+                return false;
+            }
+
+            auto [params_it, is_new_atlas] = params_per_atlas.try_emplace(atlas_name);
+            if (is_new_atlas)
+            {
+                if (params.atlas_params)
+                    params_it->second = params.atlas_params(atlas_name);
+                if (params_it->second.modify_image || bool(params_it->second.atlas_flags & AtlasFlags::trim_alpha) || (params.get_compressed_atlas && params.get_compressed_atlas(atlas_name)))
+                {
+                    Load(params);
+                    return false;
+                }
+            }
+
+            targets.emplace_back(&atlas_it->second, &params_it->second);
+        }
+
+        // Write the images into the atlases.
+        TexUnit tex_unit = nullptr;
+        for (std::size_t i = 0; i < decoded_images.size(); i++)
+        {
+            auto &[pair, image] = decoded_images[i];
+            auto [atlas, atlas_params] = targets[i];
+
+            if (bool(atlas_params->atlas_flags & AtlasFlags::premultiply_alpha))
+                image.PremultiplyAlpha();
+
+            if (atlas->image)
+                atlas->image.UnsafeDrawImage(image, pair->second.region.a);
+
+            if (!bool(atlas_params->flags & Flags::no_texture))
+            {
+                tex_unit.Attach(atlas->texture);
+                tex_unit.SetDataPart(pair->second.region.a, image.Size(), image.Data());
+            }
+
+            #ifdef IMP_HAVE_TEXTURE_ARRAYS
+            if (atlas->texture_array_layer != -1)
+                impl::GetState().texture_arrays.at(atlas->texture_array).SetLayerPart(atlas->texture_array_layer, pair->second.region.a, image.Size(), image.Data());
+            #endif
+        }
+
+        return true;
     }
 
     // Returns a map of all loaded atlases.
@@ -229,6 +730,15 @@ namespace Graphics::GlobalData
     {
         return impl::GetState().atlases;
     }
+
+    #ifdef IMP_HAVE_TEXTURE_ARRAYS
+    // Returns a map of the array textures made with `AtlasParams::texture_array`. Use `Atlas::texture_array_layer` to find the layers.
+    // The addresses are NOT stable across reloads.
+    [[nodiscard]] inline const TextureArrayMap &GetTextureArrays()
+    {
+        return impl::GetState().texture_arrays;
+    }
+    #endif
 }
 
 using Graphics::GlobalData::operator""_image;
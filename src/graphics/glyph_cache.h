@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "graphics/font_file.h"
+#include "graphics/font.h"
+#include "graphics/image.h"
+#include "graphics/texture.h"
+#include "utils/dynamic_packing.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    // Rasterizes the glyphs of a `FontFile` on first use, into a rect of an existing texture (e.g. a free part of the main atlas).
+    // Attach it to a `Font` to serve the glyphs that weren't baked by `MakeFontAtlas()`, which is useful for huge char sets such as CJK.
+    // When the rect is full, the least recently used glyphs are evicted, except for the ones used since the last `NextFrame()`.
+    // Evicted glyphs are overwritten, so rebuild any `Text` kept across frames when `Generation()` changes.
+    // Usage:
+    //     GlyphCache cache(font_file, texture, irect2(...));
+    //     cache.Attach(font); // Now `font.Get()` rasterizes the missing glyphs.
+    //     ...
+    //     cache.NextFrame(); // Once per frame.
+    class GlyphCache
+    {
+        struct Entry
+        {
+            Font::Glyph glyph;
+            irect2 allocated_rect; // Relative to `rect`, including the gap. Has no area if the glyph is empty.
+            std::uint64_t last_used_frame = 0;
+            std::list<std::uint32_t>::iterator lru_iter;
+        };
+
+        const FontFile *source = nullptr;
+        const TexObject *texture = nullptr;
+        irect2 rect;
+        FontFile::RenderFlags render_flags = FontFile::none;
+
+        Packing::DynamicPacker packer;
+        std::unordered_map<std::uint32_t, Entry> entries;
+        std::list<std::uint32_t> lru; // The most recently used glyphs are at the front.
+        std::uint64_t frame = 1;
+        std::uint64_t generation = 0;
+        TexUnit tex_unit; // Used to upload the glyphs.
+
+        static constexpr int gap = 1;
+
+        void Evict(std::unordered_map<std::uint32_t, Entry>::iterator it)
+        {
+            if (it->second.allocated_rect.has_area())
+                packer.Free(it->second.allocated_rect);
+            lru.erase(it->second.lru_iter);
+            entries.erase(it);
+            generation++;
+        }
+
+        // Allocates space for a glyph, evicting the old glyphs if necessary. Returns null if there's no space even after that.
+        [[nodiscard]] std::optional<irect2> Allocate(ivec2 size)
+        {
+            if (size(any) > packer.Size())
+                return {};
+
+            while (true)
+            {
+                if (auto pos = packer.Allocate(size))
+                    return pos->rect_size(size);
+
+                if (lru.empty())
+                    return {};
+                auto it = entries.find(lru.back());
+                if (it->second.last_used_frame == frame)
+                    return {}; // Everything is in use this frame.
+                Evict(it);
+            }
+        }
+
+      public:
+        GlyphCache() {}
+
+        // The font and the texture must outlive the cache. The texture must already have storage covering `rect`.
+        GlyphCache(const FontFile &source, const TexObject &texture, irect2 rect, FontFile::RenderFlags render_flags = FontFile::none)
+            : source(&source), texture(&texture), rect(rect), render_flags(render_flags), packer(rect.size())
+        {
+            if (!rect.has_area())
+                throw std::runtime_error("Invalid glyph cache rect.");
+        }
+
+        GlyphCache(GlyphCache &&) = delete; // `Attach()` captures a pointer to this.
+        GlyphCache &operator=(GlyphCache &&) = delete;
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(source);
+        }
+
+        // Makes `font` use this cache for the missing glyphs, and copies the metrics and kerning from the font file.
+        void Attach(Font &font)
+        {
+            font.SetAscent(source->Ascent());
+            font.SetDescent(source->Descent());
+            font.SetLineSkip(source->LineSkip());
+            font.SetKerningFunc(source->KerningFunc());
+            font.SetMissingGlyphFunc([this](std::uint32_t ch){return Get(ch);});
+        }
+
+        // Call this once per frame. The glyphs used before this call can be evicted.
+        void NextFrame()
+        {
+            frame++;
+        }
+
+        // Incremented when a glyph is evicted.
+        [[nodiscard]] std::uint64_t Generation() const
+        {
+            return generation;
+        }
+
+        [[nodiscard]] std::size_t GlyphCount() const
+        {
+            return entries.size();
+        }
+
+        // Evicts all glyphs.
+        void Clear()
+        {
+            entries.clear();
+            lru.clear();
+            packer.Clear();
+            generation++;
+        }
+
+        // Returns a glyph, rasterizing it if necessary. Returns null if the font doesn't have this glyph, or if the cache is full.
+        // The glyph position is relative to the texture. The reference remains valid until the glyph is evicted.
+        [[nodiscard]] const Font::Glyph *Get(std::uint32_t ch)
+        {
+            ASSERT(*this, "Attempt to use a null glyph cache.");
+
+            if (auto it = entries.find(ch); it != entries.end())
+            {
+                it->second.last_used_frame = frame;
+                lru.splice(lru.begin(), lru, it->second.lru_iter);
+                return &it->second.glyph;
+            }
+
+            if (!source->HasGlyph(ch))
+                return nullptr;
+
+            FontFile::GlyphData glyph_data = source->GetGlyph(ch, render_flags);
+
+            Entry entry;
+            entry.glyph.size = glyph_data.image.Size();
+            entry.glyph.offset = glyph_data.offset;
+            entry.glyph.advance = glyph_data.advance;
+            entry.last_used_frame = frame;
+
+            if (glyph_data.image && glyph_data.image.Size()(all) > 0)
+            {
+                // The gap is uploaded as well, to erase the remains of the evicted glyphs.
+                ivec2 padded_size = glyph_data.image.Size() + gap;
+                auto allocated = Allocate(padded_size);
+                if (!allocated)
+                    return nullptr;
+                entry.allocated_rect = *allocated;
+                entry.glyph.texture_pos = rect.a + allocated->a;
+
+                Image padded(padded_size);
+                padded.UnsafeDrawImage(glyph_data.image, ivec2(0));
+
+                if (!tex_unit)
+                    tex_unit = nullptr;
+                tex_unit.Attach(*texture);
+                tex_unit.SetDataPart(entry.glyph.texture_pos, padded_size, padded.Data());
+                tex_unit.Detach();
+            }
+
+            lru.push_front(ch);
+            entry.lru_iter = lru.begin();
+            return &entries.insert_or_assign(ch, entry).first->second.glyph;
+        }
+    };
+}
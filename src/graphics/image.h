@@ -1,17 +1,26 @@
 #pragma once
 
 #include <algorithm>
-#include <vector>
+#include <cstddef>
+#include <cstdint>
 #include <utility>
+#include <vector>
 
 #include <stb_image.h>
 #include <stb_image_write.h>
 
+#include "graphics/qoi.h"
 #include "macros/finally.h"
+#include "program/errors.h"
 #include "stream/readonly_data.h"
+#include "stream/save_to_file.h"
 #include "strings/format.h"
 #include "utils/mat.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace Graphics
 {
     class Image
@@ -22,7 +31,12 @@ namespace Graphics
         std::vector<u8vec4> data;
 
       public:
-        enum Format {png, tga};
+        enum Format
+        {
+            png,
+            tga,
+            qoi, // Much faster than PNG, but the files are larger. See `Qoi::Encode()`.
+        };
         enum FlipMode {no_flip, flip_y};
 
         Image() {}
@@ -39,7 +53,28 @@ namespace Graphics
         }
         Image(Stream::ReadOnlyData file, FlipMode flip_mode = no_flip) // Throws on failure.
         {
-            stbi_set_flip_vertically_on_load(flip_mode == flip_y);
+            if (Qoi::HasMagic(file.data(), file.size()))
+            {
+                Qoi::DecodedImage decoded;
+                try
+                {
+                    decoded = Qoi::Decode(file.data(), file.size());
+                }
+                catch (std::exception &e)
+                {
+                    throw std::runtime_error(FMT("Unable to parse image: {}: {}", file.name(), e.what()));
+                }
+                size = decoded.size;
+                data = std::move(decoded.pixels);
+                if (flip_mode == flip_y)
+                {
+                    for (int y = 0; y < size.y / 2; y++)
+                        std::swap_ranges(&UnsafeAt(ivec2(0, y)), &UnsafeAt(ivec2(0, y)) + size.x, &UnsafeAt(ivec2(0, size.y - 1 - y)));
+                }
+                return;
+            }
+
+            stbi_set_flip_vertically_on_load_thread(flip_mode == flip_y); // The thread-local flag, to allow decoding on several threads at once.
             ivec2 img_size;
             uint8_t *bytes = stbi_load_from_memory(file.data(), file.size(), &img_size.x, &img_size.y, 0, 4);
             if (!bytes)
@@ -70,6 +105,10 @@ namespace Graphics
               case tga:
                 ok = stbi_write_tga(file_name.c_str(), size.x, size.y, 4, data.data());
                 break;
+              case qoi:
+                Stream::SaveFile(file_name, Qoi::Encode(data.data(), size)); // This throws on failure.
+                ok = 1;
+                break;
             }
 
             if (!ok)
@@ -130,5 +169,125 @@ namespace Graphics
         {
             UnsafeDrawImagePickMaxAlpha(other, pos, other.Bounds());
         }
+
+        // Returns a copy of a part of this image.
+        [[nodiscard]] Image UnsafeCrop(irect2 rect) const
+        {
+            Image ret(rect.size());
+            for (int y = 0; y < rect.size().y; y++)
+            {
+                auto source_address = &UnsafeAt(ivec2(rect.a.x, rect.a.y + y));
+                std::copy(source_address, source_address + rect.size().x, &ret.UnsafeAt(ivec2(0, y)));
+            }
+            return ret;
+        }
+
+        // Returns the smallest rect containing all pixels with non-zero alpha, or an empty rect at zero if there are none.
+        [[nodiscard]] irect2 NonTransparentBounds() const
+        {
+            irect2 ret = size.rect_to(ivec2(0)); // Inverted, so that it can only grow.
+            for (int y = 0; y < size.y; y++)
+            {
+                const u8vec4 *row = &UnsafeAt(ivec2(0, y));
+                int x_begin = 0;
+                while (x_begin < size.x && row[x_begin].a() == 0)
+                    x_begin++;
+                if (x_begin == size.x)
+                    continue;
+                int x_end = size.x;
+                while (row[x_end - 1].a() == 0)
+                    x_end--;
+
+                ret.a.x = std::min(ret.a.x, x_begin);
+                ret.b.x = std::max(ret.b.x, x_end);
+                ret.a.y = std::min(ret.a.y, y);
+                ret.b.y = y + 1;
+            }
+            if (ret.b.y == 0)
+                return {};
+            return ret;
+        }
+
+        // Multiplies the colors by alpha, for use with `Blending::FuncNormalPre()`. This avoids dark fringes with linear interpolation.
+        void PremultiplyAlpha()
+        {
+            std::size_t i = 0;
+
+            #if defined(__SSE2__)
+            // Two pixels at a time, in 16-bit lanes.
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i round = _mm_set1_epi16(128);
+            const __m128i alpha_mask = _mm_set1_epi32(std::int32_t(0xff000000));
+            for (; i + 4 <= data.size(); i += 4)
+            {
+                __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data.data() + i));
+                auto Multiply = [&](__m128i half)
+                {
+                    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(half, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+                    // `x * a / 255`, rounded: `t = x * a + 128; (t + t / 256) / 256`.
+                    __m128i t = _mm_add_epi16(_mm_mullo_epi16(half, alpha), round);
+                    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+                };
+                __m128i result = _mm_packus_epi16(Multiply(_mm_unpacklo_epi8(pixels, zero)), Multiply(_mm_unpackhi_epi8(pixels, zero)));
+                result = _mm_or_si128(_mm_andnot_si128(alpha_mask, result), _mm_and_si128(alpha_mask, pixels));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(data.data() + i), result);
+            }
+            #endif
+
+            for (; i < data.size(); i++)
+            {
+                u8vec4 &pixel = data[i];
+                for (int j = 0; j < 3; j++)
+                {
+                    unsigned int t = pixel[j] * unsigned(pixel.a()) + 128;
+                    pixel[j] = std::uint8_t((t + (t >> 8)) >> 8);
+                }
+            }
+        }
+
+        // The opposite of `PremultiplyAlpha()`. The fully transparent pixels become transparent black.
+        // The colors of the very transparent pixels lose precision, so avoid round trips.
+        void UnpremultiplyAlpha()
+        {
+            for (u8vec4 &pixel : data)
+            {
+                unsigned int alpha = pixel.a();
+                if (alpha == 255)
+                    continue;
+                for (int j = 0; j < 3; j++)
+                    pixel[j] = alpha == 0 ? 0 : std::uint8_t(std::min((pixel[j] * 255u + alpha / 2) / alpha, 255u));
+            }
+        }
+
+        // Rearranges the channels. Each parameter is a source channel index, e.g. `SwizzleChannels(2, 1, 0, 3)` converts between RGBA and BGRA.
+        void SwizzleChannels(int r, int g, int b, int a)
+        {
+            ASSERT(r >= 0 && r < 4 && g >= 0 && g < 4 && b >= 0 && b < 4 && a >= 0 && a < 4, "Invalid channel index.");
+            for (u8vec4 &pixel : data)
+                pixel = u8vec4(pixel[r], pixel[g], pixel[b], pixel[a]);
+        }
+
+        // Returns the image halved in size (rounding up), with each pixel being the average of a 2x2 block. Use this to make mipmaps.
+        // Premultiply the alpha first, otherwise the colors of the transparent pixels bleed into the visible ones.
+        [[nodiscard]] Image Downscaled() const
+        {
+            ivec2 new_size = (size + 1) / 2;
+            Image ret(new_size);
+            for (int y = 0; y < new_size.y; y++)
+            {
+                const u8vec4 *row_a = &UnsafeAt(ivec2(0, y * 2));
+                const u8vec4 *row_b = &UnsafeAt(ivec2(0, std::min(y * 2 + 1, size.y - 1)));
+                u8vec4 *out = &ret.UnsafeAt(ivec2(0, y));
+
+                for (int x = 0; x < new_size.x; x++)
+                {
+                    int x1 = x * 2;
+                    int x2 = std::min(x1 + 1, size.x - 1);
+                    for (int j = 0; j < 4; j++)
+                        out[x][j] = std::uint8_t((row_a[x1][j] + row_a[x2][j] + row_b[x1][j] + row_b[x2][j] + 2) / 4);
+                }
+            }
+            return ret;
+        }
     };
 }
@@ -0,0 +1,88 @@
+#include "graphics/image.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("graphics.image.premultiply_alpha")
+{
+    // An odd pixel count, to exercise both the vectorized loop and the tail.
+    Graphics::Image image(ivec2(7, 1));
+    for (int x = 0; x < 7; x++)
+        image.UnsafeAt(ivec2(x, 0)) = u8vec4(255, 128, std::uint8_t(x * 40), std::uint8_t(x * 42));
+
+    Graphics::Image copy = image;
+    copy.PremultiplyAlpha();
+    for (int x = 0; x < 7; x++)
+    {
+        u8vec4 source = image.UnsafeAt(ivec2(x, 0));
+        u8vec4 result = copy.UnsafeAt(ivec2(x, 0));
+        for (int j = 0; j < 3; j++)
+            CHECK(result[j] == (source[j] * source.a() + 127) / 255);
+        CHECK(result.a() == source.a());
+    }
+
+    copy.UnpremultiplyAlpha();
+    CHECK(copy.UnsafeAt(ivec2(0, 0)) == u8vec4(0));
+    CHECK(copy.UnsafeAt(ivec2(6, 0)) == image.UnsafeAt(ivec2(6, 0)));
+}
+
+TEST_CASE("graphics.image.downscaled")
+{
+    Graphics::Image image(ivec2(3, 2), u8vec4(10, 20, 30, 40));
+    image.UnsafeAt(ivec2(0, 0)) = u8vec4(50, 20, 30, 40);
+
+    Graphics::Image result = image.Downscaled();
+    CHECK(result.Size() == ivec2(2, 1));
+    CHECK(result.UnsafeAt(ivec2(0, 0)) == u8vec4(20, 20, 30, 40));
+    CHECK(result.UnsafeAt(ivec2(1, 0)) == u8vec4(10, 20, 30, 40)); // The last column is repeated.
+
+    result.SwizzleChannels(2, 1, 0, 3);
+    CHECK(result.UnsafeAt(ivec2(0, 0)) == u8vec4(30, 20, 20, 40));
+}
+
+TEST_CASE("graphics.image.qoi")
+{
+    // Exercise all ops: runs (including ones longer than the limit), the index, small and large differences, and alpha changes.
+    Graphics::Image image(ivec2(13, 11));
+    for (int y = 0; y < 11; y++)
+    for (int x = 0; x < 13; x++)
+    {
+        u8vec4 &pixel = image.UnsafeAt(ivec2(x, y));
+        if (y < 6)
+            pixel = u8vec4(1, 2, 3, 255);
+        else if (y < 8)
+            pixel = u8vec4(std::uint8_t(x), std::uint8_t(x * 20), std::uint8_t(x * 3), 255);
+        else
+            pixel = u8vec4(std::uint8_t(x * 77), std::uint8_t(y * 13), 7, std::uint8_t(x % 3 * 100));
+    }
+
+    std::vector<std::uint8_t> encoded = Graphics::Qoi::Encode(image.Pixels(), image.Size());
+    Graphics::Image decoded(Stream::ReadOnlyData::mem_reference(encoded));
+    CHECK(decoded.Size() == image.Size());
+    for (int i = 0; i < image.Size().prod(); i++)
+        CHECK(decoded.Pixels()[i] == image.Pixels()[i]);
+
+    encoded.resize(encoded.size() - 20);
+    REQUIRE_THROWS((void)Graphics::Image(Stream::ReadOnlyData::mem_reference(encoded)));
+}
+
+TEST_CASE("graphics.image.trimming")
+{
+    Graphics::Image image(ivec2(8, 6), u8vec4(0));
+    image.UnsafeAt(ivec2(2, 1)) = u8vec4(10, 20, 30, 40);
+    image.UnsafeAt(ivec2(5, 3)) = u8vec4(1, 2, 3, 4);
+
+    irect2 bounds = image.NonTransparentBounds();
+    CHECK(bounds.a == ivec2(2, 1));
+    CHECK(bounds.b == ivec2(6, 4));
+
+    Graphics::Image cropped = image.UnsafeCrop(bounds);
+    CHECK(cropped.Size() == ivec2(4, 3));
+    CHECK(cropped.UnsafeAt(ivec2(0, 0)) == u8vec4(10, 20, 30, 40));
+    CHECK(cropped.UnsafeAt(ivec2(3, 2)) == u8vec4(1, 2, 3, 4));
+    CHECK(cropped.UnsafeAt(ivec2(1, 1)) == u8vec4(0));
+
+    CHECK_FALSE(Graphics::Image(ivec2(3), u8vec4(1, 1, 1, 0)).NonTransparentBounds().has_area());
+}
@@ -6,6 +6,7 @@
 
 #include <cglfl/cglfl.hpp>
 
+#include "graphics/draw_calls.h"
 #include "graphics/vertex_buffer.h"
 #include "macros/finally.h"
 #include "meta/common.h"
@@ -18,15 +19,18 @@ namespace Graphics
         IndexBuffers() = delete;
         ~IndexBuffers() = delete;
 
+        // The index buffer binding is a part of the vertex array state, so we remember which vertex array `binding` belongs to.
         inline static GLuint binding = 0;
+        inline static GLuint binding_vertex_array = 0;
 
       public:
         static void Bind(GLuint handle)
         {
-            if (binding == handle)
+            if (binding == handle && binding_vertex_array == VertexBuffers::VertexArrayBinding())
                 return;
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle);
             binding = handle;
+            binding_vertex_array = VertexBuffers::VertexArrayBinding();
         }
 
         static void ForgetBoundBuffer()
@@ -34,9 +38,10 @@ namespace Graphics
             binding = 0;
         }
 
+        // Returns 0 if the vertex array was changed since the last `Bind()`, since then we don't know what's bound.
         static GLuint Binding()
         {
-            return binding;
+            return binding_vertex_array == VertexBuffers::VertexArrayBinding() ? binding : 0;
         }
     };
 
@@ -159,6 +164,7 @@ namespace Graphics
                 return;
             Bind();
             glDrawElements(m, count, IndexTypeEnum(), (void *)(uintptr_t)(offset * sizeof(T)));
+            draw_call_counter++;
         }
         void DrawFromBoundBuffer(DrawMode m, int count) const // Binds the buffer.
         {
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+
+#include "graphics/vertex_buffer.h"
+
+namespace Graphics
+{
+    // Like `SimpleRenderQueue`, but each element is a per-instance record, drawn as `VertexCount` vertices.
+    // The vertex shader must expand the records itself, using `gl_VertexID`.
+    // Only usable if `VertexBuffers::instancing_supported` is true.
+    template <typename T, int VertexCount, DrawMode Mode = triangle_strip>
+    class InstancedRenderQueue
+    {
+        static_assert(Graphics::VertexBuffer<T>::is_reflected, "The type must be reflected.");
+
+        static constexpr bool use_mapping = Graphics::VertexBuffer<T>::can_map;
+
+        // Same as in `SimpleRenderQueue`, the buffer holds several batches, and is orphaned when exhausted.
+
+        std::size_t pos = 0, size = 0; // These are measured in instances.
+        std::size_t buffer_pos = 0; // The first unused instance in `buffer`.
+        T *target = nullptr; // Where the current batch is written. Either a mapped part of `buffer`, or `storage`.
+        std::unique_ptr<T[]> storage; // Only used if the buffers can't be mapped.
+        Graphics::VertexBuffer<T> buffer;
+
+        void BeginBatch()
+        {
+            if (buffer_pos + size > std::size_t(buffer.Size()))
+            {
+                buffer.Orphan(Graphics::stream_draw);
+                buffer_pos = 0;
+            }
+
+            if constexpr (use_mapping)
+                target = buffer.MapForWriting(buffer_pos, size);
+            else
+                target = storage.get();
+        }
+
+      public:
+        InstancedRenderQueue() {}
+
+        // `batches` is how many flushes fit into the vertex buffer before it has to be orphaned.
+        InstancedRenderQueue(std::size_t size, std::size_t batches = 3)
+            : size(size), buffer(size * batches, 0, Graphics::stream_draw)
+        {
+            if constexpr (!use_mapping)
+                storage = std::make_unique<T[]>(size);
+        }
+
+        [[nodiscard]] explicit operator bool()
+        {
+            return bool(buffer);
+        }
+
+        // How many instances are currently in the queue.
+        [[nodiscard]] std::size_t Pos() const
+        {
+            return pos;
+        }
+
+        // The max number of instances the queue can hold.
+        [[nodiscard]] std::size_t Size() const
+        {
+            return size;
+        }
+
+        void Flush()
+        {
+            if (pos <= 0)
+                return;
+            if constexpr (use_mapping)
+            {
+                buffer.FlushMapped(0, pos);
+                buffer.Unmap();
+            }
+            else
+            {
+                buffer.SetDataPart(buffer_pos, pos, storage.get());
+            }
+            target = nullptr;
+            buffer.DrawInstanced(Mode, VertexCount, buffer_pos, pos);
+            buffer_pos += pos;
+            pos = 0;
+        }
+
+        void Add(const T &instance)
+        {
+            if (pos >= size)
+                Flush();
+            if (!target)
+                BeginBatch();
+            std::copy_n(&instance, 1, target + pos);
+            pos++;
+        }
+    };
+}
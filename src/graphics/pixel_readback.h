@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <cglfl/cglfl.hpp>
+
+#include "graphics/image.h"
+#include "macros/finally.h"
+#include "program/errors.h"
+#include "program/platform.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    #if defined(GL_PIXEL_PACK_BUFFER) && defined(GL_MAP_READ_BIT) && !IMP_PLATFORM_IS(web) // WebGL can't map buffers.
+    #  define IMP_HAVE_ASYNC_PIXEL_READBACK
+    #endif
+
+    #ifdef IMP_HAVE_ASYNC_PIXEL_READBACK
+    // Reads RGBA8 pixels from a framebuffer into a pixel buffer object, without waiting for the GPU to finish rendering.
+    // This is the reverse of `TextureUpload`.
+    // Usage:
+    //     PixelReadback readback(nullptr, size); // On the main thread.
+    //     readback.Start(); // After rendering the frame, reads from the framebuffer bound for reading (the default one, or a bound `FrameBuffer`).
+    //     if (readback.Done()) // A frame or two later. Never waits.
+    //     {
+    //         readback.Map();
+    //         Image image = readback.ToImage(); // Can be called on a different thread, while the buffer stays mapped.
+    //         readback.Unmap(); // On the main thread, after `Pixels()` is no longer used. Then `Start()` can be called again.
+    //     }
+    // All functions except for `Pixels()` and `ToImage()` must be called on the thread that owns the GL context.
+    class PixelReadback
+    {
+        struct Data
+        {
+            GLuint handle = 0;
+            GLsync fence = 0;
+            ivec2 size;
+            const std::uint8_t *pixels = nullptr; // Non-null while mapped.
+        };
+        Data data;
+
+        static constexpr int bytes_per_pixel = 4;
+
+        void Bind() const
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, data.handle);
+        }
+        static void Unbind()
+        {
+            // Otherwise the regular `glReadPixels()` calls would write to the buffer.
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        void DeleteFence()
+        {
+            if (data.fence)
+                glDeleteSync(std::exchange(data.fence, {}));
+        }
+
+      public:
+        PixelReadback() {}
+
+        // Creates the buffer.
+        PixelReadback(decltype(nullptr), ivec2 size)
+        {
+            if (size(any) <= 0)
+                throw std::runtime_error("Invalid pixel readback size.");
+            data.size = size;
+
+            glGenBuffers(1, &data.handle);
+            if (!data.handle)
+                throw std::runtime_error("Unable to create a pixel buffer.");
+            FINALLY_ON_THROW{glDeleteBuffers(1, &data.handle);};
+
+            Bind();
+            glBufferData(GL_PIXEL_PACK_BUFFER, ByteSize(), nullptr, GL_STREAM_READ);
+            Unbind();
+        }
+
+        PixelReadback(PixelReadback &&other) noexcept : data(std::exchange(other.data, {})) {}
+        PixelReadback &operator=(PixelReadback other) noexcept // Note the pass by value to utilize copy&swap idiom.
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~PixelReadback()
+        {
+            DeleteFence();
+            if (data.handle)
+                glDeleteBuffers(1, &data.handle); // This also unmaps it. Deleting 0 is a no-op, but GL could be unloaded at this point.
+        }
+
+        explicit operator bool() const
+        {
+            return bool(data.handle);
+        }
+
+        [[nodiscard]] ivec2 Size() const
+        {
+            return data.size;
+        }
+        [[nodiscard]] std::size_t ByteSize() const
+        {
+            return std::size_t(data.size.prod()) * bytes_per_pixel;
+        }
+
+        // Whether `Pixels()` can be read.
+        [[nodiscard]] bool Mapped() const
+        {
+            return bool(data.pixels);
+        }
+
+        // Starts copying the `Size()` pixels at `pos` from the framebuffer bound for reading. Returns immediately.
+        void Start(ivec2 pos = ivec2(0))
+        {
+            ASSERT(*this, "Attempt to use a null pixel readback.");
+            ASSERT(!Mapped(), "The pixel readback is still mapped.");
+
+            Bind();
+            FINALLY{Unbind();};
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(pos.x, pos.y, data.size.x, data.size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr); // The pointer is an offset into the buffer.
+
+            DeleteFence();
+            data.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        // Returns true if the last `Start()` has finished on the GPU, or if there was no readback. Never waits.
+        [[nodiscard]] bool Done()
+        {
+            if (!data.fence)
+                return true;
+            GLenum status = glClientWaitSync(data.fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+                return false;
+            DeleteFence();
+            return true;
+        }
+
+        // Maps the buffer to read the pixels. If the readback isn't `Done()` yet, this waits for it.
+        void Map()
+        {
+            ASSERT(*this, "Attempt to use a null pixel readback.");
+            if (Mapped())
+                return;
+            Bind();
+            FINALLY{Unbind();};
+            data.pixels = static_cast<const std::uint8_t *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, ByteSize(), GL_MAP_READ_BIT));
+            if (!data.pixels)
+                throw std::runtime_error("Unable to map a pixel buffer.");
+            DeleteFence();
+        }
+
+        void Unmap()
+        {
+            if (!Mapped())
+                return;
+            Bind();
+            FINALLY{Unbind();};
+            data.pixels = nullptr;
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER); // If this fails, the contents were lost, but we've either read them already or don't care.
+        }
+
+        // The mapped memory, `ByteSize()` bytes, the rows are tightly packed. The rows go from bottom to top, as usual in GL.
+        // Can be read from any thread, but must not be touched after `Unmap()`.
+        [[nodiscard]] const std::uint8_t *Pixels() const
+        {
+            ASSERT(Mapped(), "The pixel readback is not mapped.");
+            return data.pixels;
+        }
+
+        // Copies the mapped pixels into an image, flipping the rows to go from top to bottom.
+        // Can be called from any thread, same as `Pixels()`.
+        [[nodiscard]] Image ToImage() const
+        {
+            Image ret(data.size);
+            std::size_t row_bytes = std::size_t(data.size.x) * bytes_per_pixel;
+            const std::uint8_t *source = Pixels();
+            for (int y = 0; y < data.size.y; y++)
+                std::memcpy(&ret.UnsafeAt(ivec2(0, data.size.y - 1 - y)), source + row_bytes * y, row_bytes);
+            return ret;
+        }
+    };
+    #endif
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "graphics/timer_query.h"
+#include "program/errors.h"
+#include "utils/clock.h"
+
+namespace Graphics
+{
+    // Measures the CPU and GPU time of the scopes in a frame.
+    // The GPU times are read a few frames later, when they become available, so this never waits for the GPU.
+    // Without the timer queries (e.g. on GLES 2), only the CPU times are measured.
+    // Usage:
+    //     profiler.BeginFrame();
+    //     {
+    //         auto scope = profiler.Measure("world");
+    //         ...
+    //     }
+    //     profiler.EndFrame();
+    //     ... = profiler.LastFrame(); // Some previous frame.
+    class Profiler
+    {
+      public:
+        struct Entry
+        {
+            std::string name;
+            int depth = 0; // The nesting level. The passes are always at 0, and the scopes are nested in them.
+            bool is_pass = false; // Passes are started by `Pass()`, and last until the next pass or the end of the frame.
+
+            // In seconds, relative to the beginning of the frame.
+            double cpu_begin = 0, cpu_end = 0;
+            // Same, but negative if unknown.
+            double gpu_begin = -1, gpu_end = -1;
+        };
+
+        struct Frame
+        {
+            std::vector<Entry> entries;
+            double cpu_duration = 0;
+            double gpu_duration = -1; // Negative if unknown.
+        };
+
+        // The profiler between `BeginFrame()` and `EndFrame()`, if any.
+        // The renderer and the framebuffers report to it automatically.
+        inline static Profiler *active = nullptr;
+
+        // Ends the measurement when destroyed.
+        class Scope
+        {
+            friend Profiler;
+            Profiler *profiler = nullptr;
+            std::size_t index = 0;
+
+            Scope(Profiler *profiler, std::size_t index) : profiler(profiler), index(index) {}
+
+          public:
+            Scope() {}
+
+            Scope(Scope &&other) noexcept : profiler(std::exchange(other.profiler, {})), index(other.index) {}
+            Scope &operator=(Scope other) noexcept
+            {
+                std::swap(profiler, other.profiler);
+                std::swap(index, other.index);
+                return *this;
+            }
+
+            ~Scope()
+            {
+                if (profiler)
+                    profiler->EndEntry(index);
+            }
+        };
+
+      private:
+        static constexpr int frames_in_flight = 3;
+
+        struct FrameSlot
+        {
+            Frame frame;
+            std::uint64_t cpu_start = 0;
+            bool pending = false; // The frame has ended, but the GPU results aren't read yet.
+
+            #ifdef IMP_HAVE_TIMER_QUERIES
+            // The first and the last one are for the frame itself.
+            std::vector<TimerQuery> queries;
+            std::size_t used_queries = 0;
+            std::vector<std::array<std::size_t, 2>> entry_queries; // Begin and end query for each entry.
+
+            std::size_t RecordQuery()
+            {
+                if (used_queries == queries.size())
+                    queries.emplace_back(nullptr);
+                queries[used_queries].Record();
+                return used_queries++;
+            }
+            #endif
+        };
+
+        std::array<FrameSlot, frames_in_flight> slots;
+        int cur_slot = 0;
+        bool in_frame = false;
+        int depth = 0;
+        std::size_t cur_pass = -1;
+
+        Frame last_frame;
+        int dropped_frames = 0;
+
+        [[nodiscard]] double CpuTime(const FrameSlot &slot) const
+        {
+            return Clock::TicksToSeconds(Clock::Time() - slot.cpu_start);
+        }
+
+        std::size_t BeginEntry(std::string_view name, bool is_pass)
+        {
+            ASSERT(in_frame, "Profiler: Measuring outside of a frame.");
+            FrameSlot &slot = slots[cur_slot];
+            Entry &entry = slot.frame.entries.emplace_back();
+            entry.name = name;
+            entry.depth = is_pass ? 0 : depth++ + (cur_pass != std::size_t(-1));
+            entry.is_pass = is_pass;
+            entry.cpu_begin = CpuTime(slot);
+            #ifdef IMP_HAVE_TIMER_QUERIES
+            slot.entry_queries.push_back({slot.RecordQuery(), 0});
+            #endif
+            return slot.frame.entries.size() - 1;
+        }
+
+        void EndEntry(std::size_t index)
+        {
+            FrameSlot &slot = slots[cur_slot];
+            Entry &entry = slot.frame.entries[index];
+            if (!entry.is_pass)
+                depth--;
+            entry.cpu_end = CpuTime(slot);
+            #ifdef IMP_HAVE_TIMER_QUERIES
+            slot.entry_queries[index][1] = slot.RecordQuery();
+            #endif
+        }
+
+        void EndPass()
+        {
+            if (cur_pass == std::size_t(-1))
+                return;
+            EndEntry(std::exchange(cur_pass, -1));
+        }
+
+        // Reads the GPU results of the slot if they are available. Returns false if they're not.
+        bool TryResolve(FrameSlot &slot)
+        {
+            if (!slot.pending)
+                return true;
+
+            #ifdef IMP_HAVE_TIMER_QUERIES
+            // The queries complete in order, so checking the last one is enough.
+            if (slot.used_queries > 0 && !slot.queries[slot.used_queries - 1].Available())
+                return false;
+
+            std::uint64_t start = slot.queries[0].Nanoseconds();
+            auto GpuTime = [&](std::size_t query) {return (slot.queries[query].Nanoseconds() - start) / 1e9;};
+            slot.frame.gpu_duration = GpuTime(slot.used_queries - 1);
+            for (std::size_t i = 0; i < slot.frame.entries.size(); i++)
+            {
+                slot.frame.entries[i].gpu_begin = GpuTime(slot.entry_queries[i][0]);
+                slot.frame.entries[i].gpu_end = GpuTime(slot.entry_queries[i][1]);
+            }
+            #endif
+
+            last_frame = slot.frame;
+            slot.pending = false;
+            return true;
+        }
+
+      public:
+        Profiler() {}
+
+        Profiler(Profiler &&) = delete;
+        Profiler &operator=(Profiler &&) = delete;
+
+        ~Profiler()
+        {
+            if (active == this)
+                active = nullptr;
+        }
+
+        void BeginFrame()
+        {
+            ASSERT(!in_frame, "Profiler: `BeginFrame()` called twice.");
+
+            // Collect the finished frames, oldest first.
+            for (int i = 1; i <= frames_in_flight; i++)
+                TryResolve(slots[(cur_slot + i) % frames_in_flight]);
+
+            cur_slot = (cur_slot + 1) % frames_in_flight;
+            FrameSlot &slot = slots[cur_slot];
+            if (!TryResolve(slot))
+            {
+                // The GPU is too far behind, don't wait for it.
+                slot.pending = false;
+                dropped_frames++;
+            }
+
+            slot.frame.entries.clear();
+            slot.frame.gpu_duration = -1;
+            slot.cpu_start = Clock::Time();
+            #ifdef IMP_HAVE_TIMER_QUERIES
+            slot.used_queries = 0;
+            slot.entry_queries.clear();
+            slot.RecordQuery();
+            #endif
+
+            in_frame = true;
+            depth = 0;
+            cur_pass = -1;
+            active = this;
+        }
+
+        void EndFrame()
+        {
+            ASSERT(in_frame, "Profiler: `EndFrame()` without `BeginFrame()`.");
+            ASSERT(depth == 0, "Profiler: Some scopes are still open at the end of the frame.");
+            EndPass();
+
+            FrameSlot &slot = slots[cur_slot];
+            slot.frame.cpu_duration = CpuTime(slot);
+            #ifdef IMP_HAVE_TIMER_QUERIES
+            slot.RecordQuery();
+            #endif
+            slot.pending = true;
+
+            in_frame = false;
+            if (active == this)
+                active = nullptr;
+        }
+
+        // Measures until the returned object is destroyed.
+        [[nodiscard]] Scope Measure(std::string_view name)
+        {
+            return Scope(this, BeginEntry(name, false));
+        }
+
+        // Same, but only if there's an active profiler.
+        [[nodiscard]] static Scope MeasureIfActive(std::string_view name)
+        {
+            if (!active)
+                return {};
+            return active->Measure(name);
+        }
+
+        // Starts a new pass, ending the previous one. The pass lasts until the next one or the end of the frame.
+        // The passes don't have to nest with the scopes. The framebuffers call this automatically when they're bound.
+        void Pass(std::string_view name)
+        {
+            EndPass();
+            cur_pass = BeginEntry(name, true);
+        }
+
+        // The latest frame for which all results are available.
+        [[nodiscard]] const Frame &LastFrame() const
+        {
+            return last_frame;
+        }
+
+        // How many frames were discarded because the GPU results weren't ready in time.
+        [[nodiscard]] int DroppedFrames() const
+        {
+            return dropped_frames;
+        }
+    };
+}
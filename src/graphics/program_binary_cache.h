@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <string>
+#include <vector>
+
+#include <cglfl/cglfl.hpp>
+
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "stream/save_to_file.h"
+#include "utils/filesystem.h"
+
+namespace Graphics
+{
+    #ifdef GL_PROGRAM_BINARY_LENGTH
+    #  define IMP_HAVE_PROGRAM_BINARIES
+    #endif
+
+    #ifdef IMP_HAVE_PROGRAM_BINARIES
+    // Stores the linked shader programs, to skip compiling and linking them on the next launch.
+    // Usage:
+    //     Graphics::ProgramBinaryCache cache = nullptr; // After creating the context.
+    //     cache.LoadFromFile("shaders.cache"); // Does nothing if the file is missing or was made by a different driver.
+    //     Graphics::Shader::SetBinaryCache(&cache);
+    //     ...; // Create the shaders.
+    //     if (cache.Modified())
+    //         cache.SaveToFile("shaders.cache");
+    // The programs are keyed by the hash of their final sources and attribute locations, and the whole cache is keyed by the GL vendor, renderer and version strings.
+    // If the driver rejects a cached binary, the `Shader` falls back to compiling, and replaces the entry.
+    class ProgramBinaryCache
+    {
+      public:
+        struct Entry
+        {
+            GLenum format = 0;
+            std::vector<std::uint8_t> bytes;
+        };
+
+      private:
+        // The file format: the magic, the format version (`uint32_t`), the driver key (`uint64_t`), the entry count (`uint32_t`),
+        //   then for each entry: the key (`uint64_t`), the binary format (`uint32_t`), the size (`uint32_t`), then the bytes. All numbers are little-endian.
+        static constexpr std::string_view magic = "imp.prog";
+        static constexpr std::uint32_t version = 1; // Increment when changing the format.
+
+        std::uint64_t driver_key = 0;
+        std::map<std::uint64_t, Entry> entries;
+        bool modified = false;
+
+      public:
+        // 64-bit FNV-1a. Pass the previous result as `hash` to continue hashing.
+        [[nodiscard]] static std::uint64_t HashBytes(std::string_view bytes, std::uint64_t hash = 0xcbf29ce484222325)
+        {
+            for (char ch : bytes)
+            {
+                hash ^= std::uint8_t(ch);
+                hash *= 0x100000001b3;
+            }
+            return hash;
+        }
+
+        // Returns false if the driver doesn't support any binary formats, then the cache is never used.
+        [[nodiscard]] static bool Supported()
+        {
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+            return count > 0;
+        }
+
+        ProgramBinaryCache() {}
+
+        // Remembers the current driver. Needs a GL context.
+        ProgramBinaryCache(decltype(nullptr))
+        {
+            std::uint64_t hash = HashBytes(magic);
+            for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+            {
+                const char *str = reinterpret_cast<const char *>(glGetString(name));
+                hash = HashBytes(str ? str : "", hash);
+                hash = HashBytes("\n", hash);
+            }
+            driver_key = hash;
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return driver_key != 0;
+        }
+
+        // True if some entries were added or removed since the construction or the last `Load()` or `Save()`.
+        [[nodiscard]] bool Modified() const
+        {
+            return modified;
+        }
+
+        [[nodiscard]] std::size_t EntryCount() const
+        {
+            return entries.size();
+        }
+
+        // Returns null if there's no such entry.
+        [[nodiscard]] const Entry *Find(std::uint64_t key) const
+        {
+            auto it = entries.find(key);
+            return it == entries.end() ? nullptr : &it->second;
+        }
+
+        void Insert(std::uint64_t key, Entry entry)
+        {
+            entries.insert_or_assign(key, std::move(entry));
+            modified = true;
+        }
+
+        void Erase(std::uint64_t key)
+        {
+            if (entries.erase(key))
+                modified = true;
+        }
+
+        // Replaces the contents with the data saved by `Save()`.
+        // Returns false and leaves the cache empty if the data was made by a different driver or a different version of this class. Throws if the data is malformed.
+        bool Load(const Stream::ReadOnlyData &data)
+        {
+            entries.clear();
+            modified = false;
+
+            Stream::Input input(data);
+            input.WantLocationStyle(Stream::byte_offset);
+
+            if (!input.DiscardChars<Stream::if_present>(magic))
+                throw std::runtime_error(input.GetExceptionPrefix() + "This is not a shader program cache.");
+            if (input.ReadLittle<std::uint32_t>() != version || input.ReadLittle<std::uint64_t>() != driver_key)
+                return false;
+
+            std::uint32_t count = input.ReadLittle<std::uint32_t>();
+            for (std::uint32_t i = 0; i < count; i++)
+            {
+                std::uint64_t key = input.ReadLittle<std::uint64_t>();
+                Entry entry;
+                entry.format = input.ReadLittle<std::uint32_t>();
+                std::uint32_t size = input.ReadLittle<std::uint32_t>();
+                if (size > input.RemainingBytes())
+                    throw std::runtime_error(input.GetExceptionPrefix() + "Program binary size is out of bounds.");
+                entry.bytes.resize(size);
+                input.Read(entry.bytes.data(), size);
+                entries.insert_or_assign(key, std::move(entry));
+            }
+            input.ExpectEnd();
+            return true;
+        }
+
+        // Same as `Load()`, but does nothing and returns false if the file doesn't exist.
+        bool LoadFromFile(const std::string &file_name)
+        {
+            bool exists = false;
+            (void)Filesystem::GetObjectInfo(file_name, &exists);
+            if (!exists)
+                return false;
+            return Load(Stream::ReadOnlyData::file(file_name));
+        }
+
+        [[nodiscard]] std::vector<std::uint8_t> Save()
+        {
+            std::vector<std::uint8_t> bytes;
+            Stream::Output output = Stream::Output::Container(bytes);
+            output.WriteString(magic.data(), magic.size());
+            output.WriteLittle<std::uint32_t>(version);
+            output.WriteLittle<std::uint64_t>(driver_key);
+            output.WriteLittle<std::uint32_t>(entries.size());
+            for (const auto &[key, entry] : entries)
+            {
+                output.WriteLittle<std::uint64_t>(key);
+                output.WriteLittle<std::uint32_t>(entry.format);
+                output.WriteLittle<std::uint32_t>(entry.bytes.size());
+                output.WriteString(reinterpret_cast<const char *>(entry.bytes.data()), entry.bytes.size());
+            }
+            output.Flush();
+            modified = false;
+            return bytes;
+        }
+
+        // Saves atomically, see `Stream::SaveFileAtomic()`.
+        void SaveToFile(const std::string &file_name)
+        {
+            Stream::SaveFileAtomic(file_name, Save());
+        }
+    };
+    #endif
+}
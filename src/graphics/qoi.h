@@ -0,0 +1,232 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "utils/mat.h"
+
+namespace Graphics::Qoi
+{
+    // The "Quite OK Image" format (https://qoiformat.org). Lossless, compresses worse than PNG, but encodes and decodes many times faster.
+    // Good for the caches and the intermediate files, where speed matters more than size.
+
+    inline constexpr char magic[4] = {'q', 'o', 'i', 'f'};
+    inline constexpr std::size_t header_size = 14;
+    inline constexpr std::uint8_t end_marker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+    // The spec recommends this limit, to protect the decoders from huge allocations.
+    inline constexpr std::uint64_t max_pixels = 400'000'000;
+
+    namespace impl
+    {
+        enum Op : std::uint8_t
+        {
+            op_index = 0x00, // 2-bit tag.
+            op_diff  = 0x40, // 2-bit tag.
+            op_luma  = 0x80, // 2-bit tag.
+            op_run   = 0xc0, // 2-bit tag.
+            op_rgb   = 0xfe, // 8-bit tag.
+            op_rgba  = 0xff, // 8-bit tag.
+        };
+        inline constexpr std::uint8_t tag_mask = 0xc0;
+
+        [[nodiscard]] inline int Hash(u8vec4 pixel)
+        {
+            return (pixel.x * 3 + pixel.y * 5 + pixel.z * 7 + pixel.w * 11) % 64;
+        }
+    }
+
+    // Returns true if the data starts with the QOI magic.
+    [[nodiscard]] inline bool HasMagic(const std::uint8_t *data, std::size_t size)
+    {
+        return size >= sizeof magic && std::memcmp(data, magic, sizeof magic) == 0;
+    }
+
+    // Encodes RGBA pixels, row by row, top to bottom.
+    [[nodiscard]] inline std::vector<std::uint8_t> Encode(const u8vec4 *pixels, ivec2 size)
+    {
+        if (size(any) <= 0)
+            throw std::runtime_error("Attempt to encode an empty image as QOI.");
+
+        std::vector<std::uint8_t> ret;
+        ret.reserve(header_size + std::size_t(size.prod()) * 2 + sizeof end_marker); // A rough guess.
+
+        ret.insert(ret.end(), magic, magic + sizeof magic);
+        for (int value : {size.x, size.y})
+        {
+            for (int i = 3; i >= 0; i--)
+                ret.push_back(std::uint8_t(std::uint32_t(value) >> (i * 8)));
+        }
+        ret.push_back(4); // Channels.
+        ret.push_back(0); // sRGB with linear alpha.
+
+        std::array<u8vec4, 64> index{};
+        u8vec4 prev(0, 0, 0, 255);
+        int run = 0;
+
+        std::size_t pixel_count = std::size_t(size.prod());
+        for (std::size_t i = 0; i < pixel_count; i++)
+        {
+            u8vec4 pixel = pixels[i];
+
+            if (pixel == prev)
+            {
+                run++;
+                if (run == 62 || i + 1 == pixel_count)
+                {
+                    ret.push_back(std::uint8_t(impl::op_run | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                ret.push_back(std::uint8_t(impl::op_run | (run - 1)));
+                run = 0;
+            }
+
+            int hash = impl::Hash(pixel);
+            if (index[hash] == pixel)
+            {
+                ret.push_back(std::uint8_t(impl::op_index | hash));
+            }
+            else
+            {
+                index[hash] = pixel;
+
+                if (pixel.w == prev.w)
+                {
+                    // The differences wrap around.
+                    int dr = std::int8_t(pixel.x - prev.x);
+                    int dg = std::int8_t(pixel.y - prev.y);
+                    int db = std::int8_t(pixel.z - prev.z);
+                    int dr_dg = dr - dg;
+                    int db_dg = db - dg;
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    {
+                        ret.push_back(std::uint8_t(impl::op_diff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                    }
+                    else if (dr_dg >= -8 && dr_dg <= 7 && dg >= -32 && dg <= 31 && db_dg >= -8 && db_dg <= 7)
+                    {
+                        ret.push_back(std::uint8_t(impl::op_luma | (dg + 32)));
+                        ret.push_back(std::uint8_t((dr_dg + 8) << 4 | (db_dg + 8)));
+                    }
+                    else
+                    {
+                        ret.insert(ret.end(), {impl::op_rgb, pixel.x, pixel.y, pixel.z});
+                    }
+                }
+                else
+                {
+                    ret.insert(ret.end(), {impl::op_rgba, pixel.x, pixel.y, pixel.z, pixel.w});
+                }
+            }
+
+            prev = pixel;
+        }
+
+        ret.insert(ret.end(), end_marker, end_marker + sizeof end_marker);
+        return ret;
+    }
+
+    struct DecodedImage
+    {
+        ivec2 size;
+        std::vector<u8vec4> pixels;
+    };
+
+    // Decodes to RGBA pixels, row by row, top to bottom. Throws on failure.
+    [[nodiscard]] inline DecodedImage Decode(const std::uint8_t *data, std::size_t size)
+    {
+        if (size < header_size + sizeof end_marker || !HasMagic(data, size))
+            throw std::runtime_error("Not a QOI image.");
+
+        auto ReadU32 = [&](std::size_t offset)
+        {
+            return std::uint32_t(data[offset]) << 24 | std::uint32_t(data[offset + 1]) << 16 | std::uint32_t(data[offset + 2]) << 8 | std::uint32_t(data[offset + 3]);
+        };
+        std::uint32_t width = ReadU32(4);
+        std::uint32_t height = ReadU32(8);
+        std::uint8_t channels = data[12];
+        if (width == 0 || height == 0 || std::uint64_t(width) * height > max_pixels || (channels != 3 && channels != 4))
+            throw std::runtime_error("Invalid QOI header.");
+
+        DecodedImage ret;
+        ret.size = ivec2(int(width), int(height));
+        ret.pixels.resize(std::size_t(width) * height);
+
+        std::array<u8vec4, 64> index{};
+        u8vec4 pixel(0, 0, 0, 255);
+        int run = 0;
+
+        // The padding can't contain the ops, so we stop at it.
+        std::size_t pos = header_size;
+        std::size_t data_end = size - sizeof end_marker;
+
+        for (u8vec4 &out : ret.pixels)
+        {
+            if (run > 0)
+            {
+                run--;
+                out = pixel;
+                continue;
+            }
+
+            if (pos >= data_end)
+                throw std::runtime_error("Truncated QOI image.");
+
+            std::uint8_t byte = data[pos++];
+            if (byte == impl::op_rgb || byte == impl::op_rgba)
+            {
+                std::size_t length = byte == impl::op_rgb ? 3 : 4;
+                if (data_end - pos < length)
+                    throw std::runtime_error("Truncated QOI image.");
+                pixel.x = data[pos];
+                pixel.y = data[pos + 1];
+                pixel.z = data[pos + 2];
+                if (byte == impl::op_rgba)
+                    pixel.w = data[pos + 3];
+                pos += length;
+            }
+            else
+            {
+                switch (byte & impl::tag_mask)
+                {
+                  case impl::op_index:
+                    pixel = index[byte];
+                    break;
+                  case impl::op_diff:
+                    pixel.x += (byte >> 4 & 3) - 2;
+                    pixel.y += (byte >> 2 & 3) - 2;
+                    pixel.z += (byte & 3) - 2;
+                    break;
+                  case impl::op_luma:
+                    {
+                        if (pos >= data_end)
+                            throw std::runtime_error("Truncated QOI image.");
+                        std::uint8_t second = data[pos++];
+                        int dg = (byte & 0x3f) - 32;
+                        pixel.x += dg - 8 + (second >> 4);
+                        pixel.y += dg;
+                        pixel.z += dg - 8 + (second & 0xf);
+                    }
+                    break;
+                  case impl::op_run:
+                    run = byte & 0x3f;
+                    break;
+                }
+            }
+
+            index[impl::Hash(pixel)] = pixel;
+            out = pixel;
+        }
+
+        return ret;
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "graphics/index_buffer.h"
+#include "graphics/vertex_buffer.h"
+#include "strings/format.h"
+
+namespace Graphics
+{
+    // Like `SimpleRenderQueue<T, 3>`, but for quads. Stores 4 vertices per quad instead of 6, and draws them with a prebuilt index buffer.
+    // The quads are split into triangles along the same diagonal as `SimpleRenderQueue::Add()` with four vertices does.
+    template <typename T, typename IndexType = std::uint16_t>
+    class QuadRenderQueue
+    {
+        static_assert(Graphics::VertexBuffer<T>::is_reflected, "The type must be reflected.");
+
+        static constexpr bool use_mapping = Graphics::VertexBuffer<T>::can_map;
+
+        // Same as in `SimpleRenderQueue`, the buffer holds several batches, and is orphaned when exhausted.
+        // The index buffer covers one batch. Each batch is drawn with the attribute offsets pointing to its first vertex, so the indices never change.
+
+        std::size_t pos = 0, size = 0; // These are measured in quads.
+        std::size_t buffer_pos = 0; // The first unused vertex in `buffer`.
+        T *target = nullptr; // Where the current batch is written. Either a mapped part of `buffer`, or `storage`.
+        std::unique_ptr<T[]> storage; // Only used if the buffers can't be mapped.
+        Graphics::VertexBuffer<T> buffer;
+        Graphics::IndexBuffer<IndexType> index_buffer;
+
+        void BeginBatch()
+        {
+            if (buffer_pos + size * 4 > std::size_t(buffer.Size()))
+            {
+                buffer.Orphan(Graphics::stream_draw);
+                buffer_pos = 0;
+            }
+
+            if constexpr (use_mapping)
+                target = buffer.MapForWriting(buffer_pos, size * 4);
+            else
+                target = storage.get();
+        }
+
+      public:
+        // The max number of quads that fit into `IndexType`.
+        static constexpr std::size_t max_size = (std::size_t(std::numeric_limits<IndexType>::max()) + 1) / 4;
+
+        QuadRenderQueue() {}
+
+        // The size is measured in quads, and can't be larger than `max_size`.
+        // `batches` is how many flushes fit into the vertex buffer before it has to be orphaned.
+        QuadRenderQueue(std::size_t size, std::size_t batches = 3)
+            : size(size)
+        {
+            if (size > max_size)
+                throw std::runtime_error(FMT("The size of a quad render queue is too large: {}, at most {} is allowed for this index type.", size, max_size));
+
+            buffer = Graphics::VertexBuffer<T>(size * 4 * batches, 0, Graphics::stream_draw);
+
+            std::vector<IndexType> indices(size * 6);
+            for (std::size_t i = 0; i < size; i++)
+            {
+                IndexType first = IndexType(i * 4);
+                static constexpr IndexType pattern[6] = {0, 1, 3, 3, 1, 2};
+                for (int j = 0; j < 6; j++)
+                    indices[i * 6 + j] = first + pattern[j];
+            }
+            index_buffer = Graphics::IndexBuffer<IndexType>(indices.size(), indices.data());
+
+            if constexpr (!use_mapping)
+                storage = std::make_unique<T[]>(size * 4);
+        }
+
+        [[nodiscard]] explicit operator bool()
+        {
+            return bool(buffer);
+        }
+
+        // Returns true if the next operation would flush.
+        [[nodiscard]] bool Full()
+        {
+            return pos == size;
+        }
+
+        // How many quads are currently in the queue.
+        [[nodiscard]] std::size_t Pos() const
+        {
+            return pos;
+        }
+
+        // The max number of quads the queue can hold.
+        [[nodiscard]] std::size_t Size() const
+        {
+            return size;
+        }
+
+        void Flush()
+        {
+            if (pos <= 0)
+                return;
+            if constexpr (use_mapping)
+            {
+                buffer.FlushMapped(0, pos * 4);
+                buffer.Unmap();
+            }
+            else
+            {
+                buffer.SetDataPart(buffer_pos, pos * 4, storage.get());
+            }
+            target = nullptr;
+            // This doesn't need `glDrawElementsBaseVertex()`, which is missing from the older GL and GLES versions.
+            VertexBuffers::BindDraw(buffer.Handle(), T{}, buffer_pos * sizeof(T));
+            index_buffer.DrawFromBoundBuffer(triangles, pos * 6);
+            buffer_pos += pos * 4;
+            pos = 0;
+        }
+
+        // The vertices go around the quad, in either direction.
+        void Add(const T &a, const T &b, const T &c, const T &d)
+        {
+            if (pos >= size)
+                Flush();
+            if (!target)
+                BeginBatch();
+            T *quad = target + pos * 4;
+            quad[0] = a;
+            quad[1] = b;
+            quad[2] = c;
+            quad[3] = d;
+            pos++;
+        }
+    };
+}
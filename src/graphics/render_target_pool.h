@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <cglfl/cglfl.hpp>
+
+#include "graphics/framebuffer.h"
+#include "graphics/texture.h"
+#include "program/errors.h"
+#include "utils/mat.h"
+
+#ifdef IMP_HAVE_FRAMEBUFFERS
+
+namespace Graphics
+{
+    // The texture parameters of a `RenderTargetPool` target.
+    struct RenderTargetFormat
+    {
+        GLenum internal_format =
+        #ifdef GL_RGBA8
+            GL_RGBA8;
+        #else
+            GL_RGBA;
+        #endif
+        GLenum format = GL_RGBA;
+        GLenum type = GL_UNSIGNED_BYTE;
+        InterpolationMode interpolation = linear;
+        WrapMode wrap = clamp;
+
+        [[nodiscard]] bool operator==(const RenderTargetFormat &) const = default;
+    };
+
+    // Hands out the temporary render targets (a texture with a framebuffer) for post-processing passes, and reuses them.
+    // A target returns to the pool when the handle is destroyed, and can then be given to a later pass in the same frame.
+    // The targets that weren't used for a few frames (e.g. after a resize) are destroyed in `EndFrame()`.
+    // Usage:
+    //     {
+    //         auto target = pool.Acquire(size);
+    //         target.Buffer().Bind();
+    //         ...
+    //     } // Now some other pass can reuse the same target.
+    //     pool.EndFrame();
+    class RenderTargetPool
+    {
+      public:
+        using Format = RenderTargetFormat;
+
+      private:
+        struct Entry
+        {
+            ivec2 size;
+            Format format;
+            TexObject texture;
+            FrameBuffer buffer;
+            bool in_use = false;
+            int unused_frames = 0;
+        };
+
+      public:
+        // A target borrowed from the pool. Returns it when destroyed. Must not outlive the pool.
+        class Target
+        {
+            friend RenderTargetPool;
+            Entry *entry = nullptr;
+
+            Target(Entry *entry) : entry(entry) {}
+
+          public:
+            Target() {}
+
+            Target(Target &&other) noexcept : entry(std::exchange(other.entry, {})) {}
+            Target &operator=(Target other) noexcept
+            {
+                std::swap(entry, other.entry);
+                return *this;
+            }
+
+            ~Target()
+            {
+                if (entry)
+                    entry->in_use = false;
+            }
+
+            [[nodiscard]] explicit operator bool() const
+            {
+                return bool(entry);
+            }
+
+            [[nodiscard]] ivec2 Size() const
+            {
+                ASSERT(entry, "Attempt to use a null render target.");
+                return entry->size;
+            }
+            [[nodiscard]] const TexObject &Texture() const
+            {
+                ASSERT(entry, "Attempt to use a null render target.");
+                return entry->texture;
+            }
+            [[nodiscard]] FrameBuffer &Buffer() const
+            {
+                ASSERT(entry, "Attempt to use a null render target.");
+                return entry->buffer;
+            }
+        };
+
+      private:
+        std::vector<std::unique_ptr<Entry>> entries; // The pointers keep the entries stable for `Target`.
+        TexUnit tex_unit; // Used to create the textures.
+        int max_unused_frames = 2;
+
+      public:
+        RenderTargetPool() {}
+
+        // The targets not used for more than `max_unused_frames` frames are destroyed.
+        explicit RenderTargetPool(int max_unused_frames) : max_unused_frames(max_unused_frames) {}
+
+        // Returns a free target with this size and format, or creates a new one. The contents are undefined.
+        [[nodiscard]] Target Acquire(ivec2 size, const Format &format = {})
+        {
+            for (const auto &entry : entries)
+            {
+                if (!entry->in_use && entry->size == size && entry->format == format)
+                {
+                    entry->in_use = true;
+                    entry->unused_frames = 0;
+                    return Target(entry.get());
+                }
+            }
+
+            if (!tex_unit)
+                tex_unit = nullptr;
+
+            auto entry = std::make_unique<Entry>();
+            entry->size = size;
+            entry->format = format;
+            entry->texture = nullptr;
+            tex_unit.Attach(entry->texture).SetData(format.internal_format, format.format, format.type, size).Interpolation(format.interpolation).Wrap(format.wrap);
+            entry->buffer = FrameBuffer(nullptr).Attach(entry->texture);
+            entry->in_use = true;
+            tex_unit.Detach();
+
+            return Target(entries.emplace_back(std::move(entry)).get());
+        }
+
+        // Call this once per frame. Destroys the targets that weren't used recently.
+        void EndFrame()
+        {
+            for (const auto &entry : entries)
+            {
+                if (!entry->in_use)
+                    entry->unused_frames++;
+            }
+            std::erase_if(entries, [&](const std::unique_ptr<Entry> &entry){return !entry->in_use && entry->unused_frames > max_unused_frames;});
+        }
+
+        // Destroys all targets that are not in use.
+        void Clear()
+        {
+            std::erase_if(entries, [](const std::unique_ptr<Entry> &entry){return !entry->in_use;});
+        }
+
+        // How many targets exist, including the ones in use.
+        [[nodiscard]] std::size_t TargetCount() const
+        {
+            return entries.size();
+        }
+    };
+}
+
+#endif
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <cstdint>
+#include <optional>
+#include <string_view>
 #include <string>
 #include <type_traits>
 #include <utility>
 
 #include <cglfl/cglfl.hpp>
 
+#include "graphics/program_binary_cache.h"
+#include "graphics/state_cache.h"
 #include "graphics/texture.h"
 #include "graphics/types.h"
 #include "macros/finally.h"
@@ -118,17 +123,61 @@ namespace Graphics
         };
         Data data;
 
-        inline static GLuint binding = 0;
+        #ifdef IMP_HAVE_PROGRAM_BINARIES
+        inline static ProgramBinaryCache *binary_cache = nullptr;
+
+        // Tries to load the program from `binary_cache`. Returns false on failure, then the program must be compiled normally.
+        [[nodiscard]] bool LoadFromBinaryCache(std::uint64_t key)
+        {
+            const ProgramBinaryCache::Entry *entry = binary_cache->Find(key);
+            if (!entry)
+                return false;
+            glProgramBinary(data.handle, entry->format, entry->bytes.data(), GLsizei(entry->bytes.size()));
+            GLint status = 0;
+            glGetProgramiv(data.handle, GL_LINK_STATUS, &status);
+            if (status)
+                return true;
+            binary_cache->Erase(key); // E.g. the driver was updated without changing its version string.
+            return false;
+        }
+
+        // Adds the linked program to `binary_cache`.
+        void SaveToBinaryCache(std::uint64_t key)
+        {
+            GLint size = 0;
+            glGetProgramiv(data.handle, GL_PROGRAM_BINARY_LENGTH, &size);
+            if (size <= 0)
+                return;
+            ProgramBinaryCache::Entry entry;
+            entry.bytes.resize(std::size_t(size));
+            GLsizei written = 0;
+            glGetProgramBinary(data.handle, size, &written, &entry.format, entry.bytes.data());
+            entry.bytes.resize(std::size_t(written));
+            if (!entry.bytes.empty())
+                binary_cache->Insert(key, std::move(entry));
+        }
+        #endif
 
       public:
         static void BindHandle(GLuint handle)
         {
-            if (binding == handle)
-                return;
-            binding = handle;
-            glUseProgram(handle);
+            StateCache::UseProgram(handle); // This skips the redundant calls.
         }
 
+        #ifdef IMP_HAVE_PROGRAM_BINARIES
+        // If not null, the shaders created after this call are loaded from this cache when possible, and are added to it otherwise.
+        // The cache must outlive all shader construction. Pass null to stop using it.
+        // Does nothing if `ProgramBinaryCache::Supported()` is false.
+        static void SetBinaryCache(ProgramBinaryCache *cache)
+        {
+            binary_cache = cache && ProgramBinaryCache::Supported() ? cache : nullptr;
+        }
+        [[nodiscard]] static ProgramBinaryCache *GetBinaryCache()
+        {
+            return binary_cache;
+        }
+        #endif
+
         template <typename T> static std::string AppendAttributesToSource(const std::string &source, const ShaderConfig &cfg, const ShaderPreferences &pref)
         {
             if constexpr (std::is_same_v<std::remove_cv_t<T>, none_t>)
@@ -239,13 +288,35 @@ namespace Graphics
                 throw std::runtime_error(FMT("Unable to create shader program: `{}`.", name));
             FINALLY_ON_THROW{glDeleteProgram(data.handle);};
 
+            vert_source = cfg.common_header + "\n" + cfg.vertex_header + "\n" + vert_source;
+            frag_source = cfg.common_header + "\n" + cfg.fragment_header + "\n" + frag_source;
+
+            #ifdef IMP_HAVE_PROGRAM_BINARIES
+            std::uint64_t cache_key = 0;
+            if (binary_cache)
+            {
+                // The sources are separated by null bytes, which can't appear in them.
+                cache_key = ProgramBinaryCache::HashBytes(vert_source);
+                cache_key = ProgramBinaryCache::HashBytes(std::string_view("", 1), cache_key);
+                cache_key = ProgramBinaryCache::HashBytes(frag_source, cache_key);
+                for (const std::string &attrib : attributes)
+                {
+                    cache_key = ProgramBinaryCache::HashBytes(std::string_view("", 1), cache_key);
+                    cache_key = ProgramBinaryCache::HashBytes(attrib, cache_key);
+                }
+
+                if (LoadFromBinaryCache(cache_key))
+                    return;
+
+                // Otherwise the driver might not let us read the binary.
+                glProgramParameteri(data.handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            }
+            #endif
+
             for (std::string *source_ptr : {&vert_source, &frag_source})
             {
                 bool is_vertex = source_ptr == &vert_source;
-                std::string &source = *source_ptr;
-
-                std::string header = cfg.common_header + "\n" + (is_vertex ? cfg.vertex_header : cfg.fragment_header) + "\n";
-                source = header + source;
+                const std::string &source = *source_ptr;
 
                 // Uncomment to dump source:
                 // std::cout << "\n==================\n" << source << "\n==================\n";
@@ -311,6 +382,11 @@ namespace Graphics
 
                 throw std::runtime_error(FMT("Unable to link shader program: `{}`.\nLog:\n{}", name, Strings::Trim(log)));
             }
+
+            #ifdef IMP_HAVE_PROGRAM_BINARIES
+            if (binary_cache)
+                SaveToBinaryCache(cache_key);
+            #endif
         }
 
         // Advanced constructor.
@@ -369,7 +445,7 @@ namespace Graphics
 
         [[nodiscard]] bool Bound() const
         {
-            return data.handle && data.handle == binding;
+            return data.handle && StateCache::BoundProgram() == data.handle;
         }
 
         GLuint Handle() const
@@ -388,31 +464,56 @@ namespace Graphics
         {
             BindHandle(0);
         }
+
+        #ifdef GL_UNIFORM_BUFFER
+        // Makes the uniform block `name` read from the uniform buffer bound to `binding_point` (see `UniformBuffer`).
+        // Returns false if there's no such active block.
+        bool BindUniformBlock(const std::string &name, GLuint binding_point) const
+        {
+            ASSERT(*this, "Attempt to use a null shader.");
+            GLuint index = glGetUniformBlockIndex(data.handle, name.c_str());
+            if (index == GL_INVALID_INDEX)
+                return false;
+            glUniformBlockBinding(data.handle, index, binding_point);
+            return true;
+        }
+        #endif
     };
 
     template <typename T>
     class Uniform
     {
+      public:
+        using type_with_extent = T;
+        using type = std::remove_extent_t<T>;
+
+      private:
         GLuint handle = 0;
         int location = -1;
 
+        // The last value assigned with `operator=`, to skip the redundant `glUniform*` calls. Not used for arrays.
+        // This assumes that the uniform is only modified through this object, so copies of it don't know about each other's changes.
+        mutable std::optional<std::conditional_t<std::is_same_v<type, TexUnit> || std::is_same_v<type, TexArrayUnit>, GLint, type>> last_value;
+
         friend class Shader;
 
         void modify(GLuint new_handle, int new_location)
         {
             handle = new_handle;
             location = new_location;
+            last_value.reset();
         }
 
       public:
-        using type_with_extent = T;
-        using type = std::remove_extent_t<T>;
 
         static_assert(!std::is_same_v<type, TexObject> && !std::is_same_v<type, Texture>, "Use `TexUnit` template parameter for texture uniforms.");
+        #ifdef IMP_HAVE_TEXTURE_ARRAYS
+        static_assert(!std::is_same_v<type, TextureArray>, "Use `TexArrayUnit` template parameter for array texture uniforms.");
+        #endif
 
         inline static constexpr bool
             is_array   = std::is_array_v<type_with_extent>,
-            is_texture = std::is_same_v<type, TexUnit>,
+            is_texture = std::is_same_v<type, TexUnit> || std::is_same_v<type, TexArrayUnit>,
             is_bool    = std::is_same_v<Math::vec_base_weak_t<type>, bool>;
 
         inline static constexpr int array_elements = std::extent_v<std::conditional_t<is_array, type_with_extent, type_with_extent[1]>>;
@@ -435,6 +536,19 @@ namespace Graphics
 
             Shader::BindHandle(handle);
 
+            if constexpr (is_texture)
+            {
+                if (last_value == GLint(object.Index()))
+                    return object;
+                last_value = object.Index();
+            }
+            else
+            {
+                if (last_value && *last_value == object)
+                    return object;
+                last_value = object;
+            }
+
             if      constexpr (is_texture) glUniform1i(location, object.Index());
             else if constexpr (std::is_same_v<effective_type, float       >) glUniform1f (location, object);
             else if constexpr (std::is_same_v<effective_type, fvec2       >) glUniform2f (location, object.x, object.y);
@@ -462,6 +576,7 @@ namespace Graphics
 
             Shader::BindHandle(handle);
 
+            last_value.reset();
             set_no_bind(ptr, count, offset);
         }
 
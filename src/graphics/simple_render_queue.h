@@ -16,10 +16,31 @@ namespace Graphics
         static_assert(Graphics::VertexBuffer<T>::is_reflected, "The type must be reflected.");
         static_assert(N >= 1 && N <= 3, "N must be 1 (points), 2 (lines), or 3 (triangles).");
 
+        static constexpr bool use_mapping = Graphics::VertexBuffer<T>::can_map;
+
+        // The vertex buffer holds several batches, which are used in a round-robin fashion.
+        // When it's exhausted, it's orphaned, so we never overwrite the vertices the GPU might still be reading, and never wait for it.
+
         std::size_t pos = 0, size = 0; // These are measured in primitives, not vertices.
-        std::unique_ptr<T[]> storage;
+        std::size_t buffer_pos = 0; // The first unused vertex in `buffer`.
+        T *target = nullptr; // Where the current batch is written. Either a mapped part of `buffer`, or `storage`.
+        std::unique_ptr<T[]> storage; // Only used if the buffers can't be mapped.
         Graphics::VertexBuffer<T> buffer;
 
+        void BeginBatch()
+        {
+            if (buffer_pos + size * N > std::size_t(buffer.Size()))
+            {
+                buffer.Orphan(Graphics::stream_draw);
+                buffer_pos = 0;
+            }
+
+            if constexpr (use_mapping)
+                target = buffer.MapForWriting(buffer_pos, size * N);
+            else
+                target = storage.get();
+        }
+
         template <typename ...P>
         void AddLow(const P &... p)
         {
@@ -27,8 +48,10 @@ namespace Graphics
             static_assert((std::is_same_v<P, T> && ...));
             if (pos >= size)
                 Flush();
+            if (!target)
+                BeginBatch();
             int offset = 0;
-            (std::copy_n(&p, 1, storage.get() + N * pos + offset++) , ...);
+            (std::copy_n(&p, 1, target + N * pos + offset++) , ...);
             pos++;
         }
 
@@ -36,11 +59,17 @@ namespace Graphics
         SimpleRenderQueue() {}
 
         // The size is measured in primitives, not vertices.
-        SimpleRenderQueue(std::size_t size) : size(size), storage(std::make_unique<T[]>(size * N)), buffer(size * N, 0, Graphics::stream_draw) {}
+        // `batches` is how many flushes fit into the vertex buffer before it has to be orphaned.
+        SimpleRenderQueue(std::size_t size, std::size_t batches = 3)
+            : size(size), buffer(size * N * batches, 0, Graphics::stream_draw)
+        {
+            if constexpr (!use_mapping)
+                storage = std::make_unique<T[]>(size * N);
+        }
 
         [[nodiscard]] explicit operator bool()
         {
-            return bool(storage);
+            return bool(buffer);
         }
 
         // Returns true if the next operation would flush.
@@ -65,8 +94,18 @@ namespace Graphics
         {
             if (pos <= 0)
                 return;
-            buffer.SetDataPart(0, pos * N, storage.get());
-            buffer.Draw(std::array{points, lines, triangles}[N-1], pos * N);
+            if constexpr (use_mapping)
+            {
+                buffer.FlushMapped(0, pos * N);
+                buffer.Unmap();
+            }
+            else
+            {
+                buffer.SetDataPart(buffer_pos, pos * N, storage.get());
+            }
+            target = nullptr;
+            buffer.Draw(std::array{points, lines, triangles}[N-1], buffer_pos, pos * N);
+            buffer_pos += pos * N;
             pos = 0;
         }
 
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#include <cglfl/cglfl.hpp>
+
+#include "program/errors.h"
+#include "utils/mat.h"
+
+// Remembers the GL state set through this library, and skips the GL calls that wouldn't change it.
+// Redundant state changes are cheap on most desktop drivers, but not on WebGL (where every call is validated and goes through JS) and on some mobile drivers.
+// Tracks the active texture unit and the `GL_TEXTURE_2D` binding of each unit, the shader program, the draw framebuffer, blending, the scissor test, and the viewport.
+// `TexUnit`, `Shader`, `FrameBuffer`, `Blending`, `Scissor` and `Viewport()` go through here, so you normally don't need to call this directly.
+// If some other code changes this state with raw GL calls and doesn't restore it, call `Invalidate()` after it.
+// Only the thread with the GL context uses this, so nothing here is atomic.
+namespace Graphics::StateCache
+{
+    // The number of state changes sent to GL, and the number of skipped ones, since the start of the program.
+    // Subtract two readings to get the numbers for a frame, same as with `draw_call_counter`.
+    struct Counters
+    {
+        std::uint64_t issued = 0;
+        std::uint64_t elided = 0;
+    };
+    inline Counters counters;
+
+    // `TexUnit` never allocates more units than this.
+    inline constexpr int max_texture_units = 64;
+
+    namespace impl
+    {
+        struct BlendFunc
+        {
+            GLenum src = GL_ONE, dst = GL_ZERO, src_a = GL_ONE, dst_a = GL_ZERO;
+            friend bool operator==(const BlendFunc &, const BlendFunc &) = default;
+        };
+
+        struct BlendEquation
+        {
+            GLenum eq = GL_FUNC_ADD, eq_a = GL_FUNC_ADD;
+            friend bool operator==(const BlendEquation &, const BlendEquation &) = default;
+        };
+
+        struct Rect
+        {
+            ivec2 pos, size;
+            friend bool operator==(const Rect &, const Rect &) = default;
+        };
+
+        // Null means unknown, then the next change is never skipped.
+        struct State
+        {
+            std::optional<int> active_texture;
+            std::array<std::optional<GLuint>, max_texture_units> textures_2d;
+            std::optional<GLuint> program;
+            std::optional<GLuint> framebuffer;
+            std::optional<bool> blending;
+            std::optional<BlendFunc> blend_func;
+            std::optional<BlendEquation> blend_equation;
+            std::optional<bool> scissor_test;
+            std::optional<Rect> scissor;
+            std::optional<Rect> viewport;
+        };
+
+        // The bindings start at the GL defaults, everything else starts unknown, in case the window setup changed it.
+        [[nodiscard]] inline State InitialState()
+        {
+            State ret;
+            ret.active_texture = 0;
+            ret.program = 0;
+            ret.framebuffer = 0;
+            return ret;
+        }
+
+        inline State state = InitialState();
+
+        // If `value` differs from `cached` (or it's unknown), updates it and returns true. Otherwise returns false. Updates the counters.
+        template <typename T>
+        [[nodiscard]] bool Change(std::optional<T> &cached, const T &value)
+        {
+            if (cached == value)
+            {
+                counters.elided++;
+                return false;
+            }
+            cached = value;
+            counters.issued++;
+            return true;
+        }
+    }
+
+    // Forgets all state, so the next changes are never skipped.
+    inline void Invalidate()
+    {
+        impl::state = {};
+    }
+
+    inline void ActiveTexture(int unit)
+    {
+        if (impl::Change(impl::state.active_texture, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    [[nodiscard]] inline std::optional<int> ActiveTextureUnit()
+    {
+        return impl::state.active_texture;
+    }
+
+    // Binds a `GL_TEXTURE_2D` to a unit. If it's already bound, doesn't even activate the unit.
+    inline void BindTexture2D(int unit, GLuint handle)
+    {
+        ASSERT(unit >= 0 && unit < max_texture_units, "Texture unit index is out of range.");
+        if (!impl::Change(impl::state.textures_2d[unit], handle))
+            return;
+        ActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_2D, handle);
+    }
+    // Call this after deleting a texture. GL unbinds the deleted textures from all units.
+    inline void OnTextureDeleted(GLuint handle)
+    {
+        for (std::optional<GLuint> &binding : impl::state.textures_2d)
+        {
+            if (binding == handle)
+                binding = 0;
+        }
+    }
+
+    inline void UseProgram(GLuint handle)
+    {
+        if (impl::Change(impl::state.program, handle))
+            glUseProgram(handle);
+    }
+    [[nodiscard]] inline std::optional<GLuint> BoundProgram()
+    {
+        return impl::state.program;
+    }
+
+    // `target` is either `GL_FRAMEBUFFER` or `GL_DRAW_FRAMEBUFFER`, only the draw binding is tracked. Returns true if the binding changed.
+    inline bool BindFramebuffer(GLenum target, GLuint handle)
+    {
+        if (!impl::Change(impl::state.framebuffer, handle))
+            return false;
+        glBindFramebuffer(target, handle);
+        return true;
+    }
+    [[nodiscard]] inline std::optional<GLuint> BoundFramebuffer()
+    {
+        return impl::state.framebuffer;
+    }
+    // Call this after deleting a framebuffer. GL binds the default one instead if it was bound.
+    inline void OnFramebufferDeleted(GLuint handle)
+    {
+        if (impl::state.framebuffer == handle)
+            impl::state.framebuffer = 0;
+    }
+
+    inline void SetBlending(bool enable)
+    {
+        if (!impl::Change(impl::state.blending, enable))
+            return;
+        if (enable)
+            glEnable(GL_BLEND);
+        else
+            glDisable(GL_BLEND);
+    }
+    // Uses `glBlendFunc()` if the color and alpha factors are the same, otherwise `glBlendFuncSeparate()`.
+    inline void BlendFunc(GLenum src, GLenum dst, GLenum src_a, GLenum dst_a)
+    {
+        if (!impl::Change(impl::state.blend_func, impl::BlendFunc{src, dst, src_a, dst_a}))
+            return;
+        if (src == src_a && dst == dst_a)
+            glBlendFunc(src, dst);
+        else
+            glBlendFuncSeparate(src, dst, src_a, dst_a);
+    }
+    // Uses `glBlendEquation()` if the color and alpha equations are the same, otherwise `glBlendEquationSeparate()`.
+    inline void BlendEquation(GLenum eq, GLenum eq_a)
+    {
+        if (!impl::Change(impl::state.blend_equation, impl::BlendEquation{eq, eq_a}))
+            return;
+        if (eq == eq_a)
+            glBlendEquation(eq);
+        else
+            glBlendEquationSeparate(eq, eq_a);
+    }
+
+    inline void SetScissorTest(bool enable)
+    {
+        if (!impl::Change(impl::state.scissor_test, enable))
+            return;
+        if (enable)
+            glEnable(GL_SCISSOR_TEST);
+        else
+            glDisable(GL_SCISSOR_TEST);
+    }
+    // Same as `glScissor()`, the Y axis points up.
+    inline void Scissor(ivec2 pos, ivec2 size)
+    {
+        if (impl::Change(impl::state.scissor, impl::Rect{pos, size}))
+            glScissor(pos.x, pos.y, size.x, size.y);
+    }
+
+    // Same as `glViewport()`, the Y axis points up.
+    inline void Viewport(ivec2 pos, ivec2 size)
+    {
+        if (impl::Change(impl::state.viewport, impl::Rect{pos, size}))
+            glViewport(pos.x, pos.y, size.x, size.y);
+    }
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include <cglfl/cglfl.hpp>
+
+#include "graphics/index_buffer.h"
+#include "graphics/vertex_buffer.h"
+#include "program/errors.h"
+
+namespace Graphics
+{
+    // Geometry that doesn't change (e.g. the level tiles), split into chunks, and uploaded once.
+    // Then any subset of the chunks (e.g. the visible ones) can be drawn in a single call.
+    // Usage:
+    //     StaticBatch<Vertex>::Builder builder;
+    //     int chunk = builder.AddChunk(vertices, indices);
+    //     StaticBatch<Vertex> batch(builder);
+    //     batch.Draw(visible_chunks); // With a bound shader.
+    template <typename V, typename I = std::uint32_t, DrawMode Mode = triangles>
+    class StaticBatch
+    {
+        static_assert(VertexBuffer<V>::is_reflected, "The vertex type must be reflected.");
+
+        struct Range
+        {
+            std::size_t first_index = 0;
+            std::size_t index_count = 0;
+        };
+
+        VertexBuffer<V> vertex_buffer;
+        IndexBuffer<I> index_buffer;
+        std::vector<Range> chunks;
+
+        // Reused between the draw calls.
+        mutable std::vector<Range> merged_ranges;
+        #ifdef glMultiDrawElements
+        mutable std::vector<GLsizei> draw_counts;
+        mutable std::vector<const void *> draw_offsets;
+        #endif
+
+      public:
+        class Builder
+        {
+            friend StaticBatch;
+
+            std::vector<V> vertices;
+            std::vector<I> indices;
+            std::vector<Range> chunks;
+
+          public:
+            // Adds a chunk, returns its index. The indices are relative to `chunk_vertices`.
+            int AddChunk(std::span<const V> chunk_vertices, std::span<const I> chunk_indices)
+            {
+                std::size_t base = vertices.size();
+                if (chunk_vertices.size() > std::size_t(std::numeric_limits<I>::max()) + 1 - base)
+                    throw std::runtime_error("Too many vertices in a static batch for this index type.");
+
+                vertices.insert(vertices.end(), chunk_vertices.begin(), chunk_vertices.end());
+                chunks.push_back({.first_index = indices.size(), .index_count = chunk_indices.size()});
+                for (I index : chunk_indices)
+                {
+                    ASSERT(index < chunk_vertices.size(), "Vertex index is out of range.");
+                    indices.push_back(I(base + index));
+                }
+                return int(chunks.size() - 1);
+            }
+
+            [[nodiscard]] int ChunkCount() const
+            {
+                return int(chunks.size());
+            }
+        };
+
+        StaticBatch() {}
+
+        // Uploads the geometry.
+        StaticBatch(const Builder &builder)
+            : vertex_buffer(int(builder.vertices.size()), builder.vertices.data()),
+            index_buffer(int(builder.indices.size()), builder.indices.data()),
+            chunks(builder.chunks)
+        {}
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(vertex_buffer);
+        }
+
+        [[nodiscard]] int ChunkCount() const
+        {
+            return int(chunks.size());
+        }
+
+        // Draws the chunks with the currently bound shader.
+        // If the indices are sorted, the consecutive chunks are merged into a single range.
+        void Draw(std::span<const int> chunk_indices) const
+        {
+            merged_ranges.clear();
+            for (int chunk_index : chunk_indices)
+            {
+                ASSERT(chunk_index >= 0 && chunk_index < ChunkCount(), "Chunk index is out of range.");
+                const Range &range = chunks[chunk_index];
+                if (range.index_count == 0)
+                    continue;
+                if (!merged_ranges.empty() && merged_ranges.back().first_index + merged_ranges.back().index_count == range.first_index)
+                    merged_ranges.back().index_count += range.index_count;
+                else
+                    merged_ranges.push_back(range);
+            }
+            if (merged_ranges.empty())
+                return;
+
+            vertex_buffer.BindDraw();
+            index_buffer.Bind();
+
+            #ifdef glMultiDrawElements
+            draw_counts.clear();
+            draw_offsets.clear();
+            for (const Range &range : merged_ranges)
+            {
+                draw_counts.push_back(GLsizei(range.index_count));
+                draw_offsets.push_back(reinterpret_cast<const void *>(range.first_index * sizeof(I)));
+            }
+            glMultiDrawElements(Mode, draw_counts.data(), IndexBuffer<I>::IndexTypeEnum(), draw_offsets.data(), GLsizei(merged_ranges.size()));
+            #else
+            // GLES doesn't have multi-draw.
+            for (const Range &range : merged_ranges)
+                index_buffer.DrawFromBoundBuffer(Mode, int(range.first_index), int(range.index_count));
+            #endif
+        }
+
+        // Draws all chunks with the currently bound shader.
+        void DrawAll() const
+        {
+            if (index_buffer.Size() == 0)
+                return;
+            vertex_buffer.BindDraw();
+            index_buffer.DrawFromBoundBuffer(Mode);
+        }
+    };
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <limits>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -29,14 +31,26 @@ namespace Graphics
 
         struct Line
         {
-            std::vector<Symbol> symbols;
+            std::size_t first_symbol = 0; // The symbols of this line are in `[first_symbol, next_line.first_symbol)`.
             int default_ascent = 0;
             int default_descent = 0;
             int default_line_gap = 0;
         };
 
+        // The storage is flat, to avoid allocating per line. Use `LineSymbols()` to get the symbols of a single line.
+        std::vector<Symbol> symbols;
         std::vector<Line> lines = {{}}; // We start with one line by default.
 
+        [[nodiscard]] std::span<Symbol> LineSymbols(std::size_t line_index)
+        {
+            std::size_t end = line_index + 1 < lines.size() ? lines[line_index + 1].first_symbol : symbols.size();
+            return std::span(symbols).subspan(lines[line_index].first_symbol, end - lines[line_index].first_symbol);
+        }
+        [[nodiscard]] std::span<const Symbol> LineSymbols(std::size_t line_index) const
+        {
+            return const_cast<Text &>(*this).LineSymbols(line_index);
+        }
+
 
         struct Stats
         {
@@ -54,14 +68,24 @@ namespace Graphics
         Stats ComputeStats() const
         {
             Stats ret;
+            ComputeStats(ret);
+            return ret;
+        }
+        // Same, but reuses the memory of `ret`.
+        void ComputeStats(Stats &ret) const
+        {
+            ret.lines.clear();
+            ret.size = ivec2(0);
 
-            for (const Line &line : lines)
+            for (std::size_t line_index = 0; line_index < lines.size(); line_index++)
             {
+                const Line &line = lines[line_index];
+                std::span<const Symbol> line_symbols = LineSymbols(line_index);
                 Stats::Line &line_stats = ret.lines.emplace_back();
 
                 line_stats.width = 0;
 
-                if (line.symbols.size() == 0)
+                if (line_symbols.empty())
                 {
                     line_stats.ascent = line.default_ascent;
                     line_stats.descent = line.default_descent;
@@ -73,7 +97,7 @@ namespace Graphics
                     line_stats.descent = 0;
                     line_stats.line_gap = 0;
 
-                    for (const Symbol &symbol : line.symbols)
+                    for (const Symbol &symbol : line_symbols)
                     {
                         line_stats.width += symbol.advance + symbol.kerning;
                         clamp_var_min(line_stats.ascent, symbol.ascent);
@@ -88,8 +112,6 @@ namespace Graphics
             }
 
             ret.size.y -= ret.lines.back().line_gap;
-
-            return ret;
         }
 
 
@@ -104,18 +126,27 @@ namespace Graphics
         }
 
 
+        // Removes all symbols, but keeps the memory for reuse.
+        void Clear()
+        {
+            symbols.clear();
+            lines.resize(1);
+            lines.front() = {};
+        }
+
         void AddSymbol(const Symbol &glyph)
         {
             if (glyph.ch == '\n')
             {
                 Line &line = lines.emplace_back();
+                line.first_symbol = symbols.size();
                 line.default_ascent = glyph.ascent;
                 line.default_descent = glyph.descent;
                 line.default_line_gap = glyph.line_gap;
             }
             else
             {
-                lines.back().symbols.push_back(glyph);
+                symbols.push_back(glyph);
             }
         }
         void AddSymbol(const Font &font, uint32_t ch)
@@ -123,6 +154,7 @@ namespace Graphics
             if (ch == '\n')
             {
                 Line &line = lines.emplace_back();
+                line.first_symbol = symbols.size();
                 line.default_ascent = font.Ascent();
                 line.default_descent = font.Descent();
                 line.default_line_gap = font.LineGap();
@@ -140,14 +172,13 @@ namespace Graphics
                 symbol.ascent = font.Ascent();
                 symbol.descent = font.Descent();
                 symbol.line_gap = font.LineGap();
-                lines.back().symbols.push_back(symbol);
+                symbols.push_back(symbol);
             }
         }
 
         void KernLastTwoSymbols(const Font &font)
         {
-            auto &symbols = lines.back().symbols;
-            if (symbols.size() < 2)
+            if (symbols.size() < lines.back().first_symbol + 2)
                 return;
             symbols[symbols.size() - 2].kerning = font.Kerning(symbols[symbols.size() - 2].ch, symbols[symbols.size() - 1].ch);
         }
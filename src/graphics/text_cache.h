@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "graphics/font.h"
+#include "graphics/text.h"
+#include "utils/hash.h"
+
+namespace Graphics
+{
+    // A laid out text, with its precomputed stats.
+    struct CachedText
+    {
+        Text text;
+        Text::Stats stats;
+    };
+
+    // Caches the layouts of the strings that are drawn every frame, e.g. the HUD text, so they aren't rebuilt every time.
+    // The layouts that weren't used for a few frames are evicted in `EndFrame()`, and their memory is reused for the new ones.
+    // If a font changes (e.g. it's reloaded, or a `GlyphCache` evicts glyphs), call `Clear()`.
+    // Usage:
+    //     r.ftext(pos, cache.Get(font, str))...;
+    //     cache.EndFrame();
+    class TextCache
+    {
+        using Key = std::pair<const Font *, std::string>;
+
+        struct KeyHasher
+        {
+            using is_transparent = void;
+            [[nodiscard]] std::size_t operator()(const std::pair<const Font *, std::string_view> &key) const
+            {
+                return Hash::Compute(key.first, key.second);
+            }
+            [[nodiscard]] std::size_t operator()(const Key &key) const
+            {
+                return (*this)({key.first, std::string_view(key.second)});
+            }
+        };
+        struct KeyEqual
+        {
+            using is_transparent = void;
+            [[nodiscard]] bool operator()(const std::pair<const Font *, std::string_view> &a, const std::pair<const Font *, std::string_view> &b) const
+            {
+                return a == b;
+            }
+        };
+
+        struct Entry
+        {
+            CachedText value;
+            std::uint64_t last_used_frame = 0;
+        };
+
+        // We rely on `std::unordered_map` never invalidating the references to the elements.
+        std::unordered_map<Key, Entry, KeyHasher, KeyEqual> entries;
+        std::vector<CachedText> unused_texts; // The evicted texts, to reuse their memory.
+        std::uint64_t frame = 0;
+        int max_unused_frames = 2;
+
+      public:
+        TextCache() {}
+
+        // The texts not used for more than `max_unused_frames` frames are evicted.
+        explicit TextCache(int max_unused_frames) : max_unused_frames(max_unused_frames) {}
+
+        // Returns the layout of `str`, building it if necessary.
+        // The reference remains valid until the text is evicted, i.e. at least until the next `EndFrame()`.
+        [[nodiscard]] const CachedText &Get(const Font &font, std::string_view str)
+        {
+            auto it = entries.find(std::pair(&font, str));
+            if (it == entries.end())
+            {
+                Entry entry;
+                if (!unused_texts.empty())
+                {
+                    entry.value = std::move(unused_texts.back());
+                    unused_texts.pop_back();
+                }
+                entry.value.text.Clear();
+                entry.value.text.AddString(font, str);
+                entry.value.text.ComputeStats(entry.value.stats);
+                it = entries.try_emplace(Key(&font, str), std::move(entry)).first;
+            }
+
+            it->second.last_used_frame = frame;
+            return it->second.value;
+        }
+
+        // Call this once per frame. Evicts the texts that weren't used recently.
+        void EndFrame()
+        {
+            std::erase_if(entries, [&](auto &elem)
+            {
+                if (frame - elem.second.last_used_frame < std::uint64_t(max_unused_frames))
+                    return false;
+                unused_texts.push_back(std::move(elem.second.value));
+                return true;
+            });
+            frame++;
+        }
+
+        // Evicts all texts.
+        void Clear()
+        {
+            entries.clear();
+            unused_texts.clear();
+        }
+
+        [[nodiscard]] std::size_t TextCount() const
+        {
+            return entries.size();
+        }
+    };
+}
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <utility>
+#include <vector>
 
 #include <cglfl/cglfl.hpp>
 
+#include "graphics/compressed_image.h"
 #include "graphics/image.h"
+#include "graphics/state_cache.h"
 #include "macros/finally.h"
 #include "utils/mat.h"
 #include "utils/sparse_set.h"
@@ -18,8 +22,21 @@ namespace Graphics
         linear,
         min_nearest_mag_linear,
         min_linear_mag_nearest,
+        linear_mipmaps, // Like `linear`, but also blends between the mipmaps. The texture must have them.
     };
 
+    // Returns true if the compressed format can be uploaded with `glCompressedTexImage2D()`.
+    // This relies on `GL_COMPRESSED_TEXTURE_FORMATS`, which some drivers don't fill completely, so a false negative is possible.
+    [[nodiscard]] inline bool CompressedFormatSupported(GLenum internal_format)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+        std::vector<GLint> formats(std::max(count, 0));
+        if (count > 0)
+            glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+        return std::find(formats.begin(), formats.end(), GLint(internal_format)) != formats.end();
+    }
+
     enum WrapMode
     {
         clamp  = GL_CLAMP_TO_EDGE,
@@ -62,7 +79,10 @@ namespace Graphics
         {
             // Deleting a texture unbinds it.
             if (data.handle)
+            {
                 glDeleteTextures(1, &data.handle); // Deleting 0 is a no-op, but GL could be unloaded at this point.
+                StateCache::OnTextureDeleted(data.handle);
+            }
         }
 
         explicit operator bool() const
@@ -82,7 +102,7 @@ namespace Graphics
 
         static index_alloc_t &Allocator() // Wrapped into a function to prevent the static init order fiasco.
         {
-            static index_alloc_t ret(64);
+            static index_alloc_t ret(StateCache::max_texture_units);
             return ret;
         }
 
@@ -94,8 +114,6 @@ namespace Graphics
 
         Data data;
 
-        inline static int active_index = 0;
-
       public:
         TexUnit()
         {
@@ -143,10 +161,7 @@ namespace Graphics
 
         static void ActivateIndex(int index)
         {
-            if (active_index == index)
-                return;
-            glActiveTexture(GL_TEXTURE0 + index);
-            active_index = index;
+            StateCache::ActiveTexture(index);
         }
         void Activate()
         {
@@ -157,7 +172,7 @@ namespace Graphics
         }
         [[nodiscard]] bool Active()
         {
-            return bool(*this) && active_index == data.index;
+            return bool(*this) && StateCache::ActiveTextureUnit() == data.index;
         }
 
         TexUnit &&AttachHandle(GLuint handle)
@@ -166,9 +181,9 @@ namespace Graphics
             if (!*this)
                 return std::move(*this);
 
-            Activate();
+            // This doesn't activate the unit if the texture is already bound to it. The functions below activate it themselves.
             data.handle = handle;
-            glBindTexture(GL_TEXTURE_2D, handle);
+            StateCache::BindTexture2D(data.index, handle);
             return std::move(*this);
         }
         TexUnit &&Attach(const TexObject &texture)
@@ -199,7 +214,7 @@ namespace Graphics
 
             Activate();
 
-            GLenum min_mode = (mode == nearest || mode == min_nearest_mag_linear ? GL_NEAREST : GL_LINEAR);
+            GLenum min_mode = (mode == nearest || mode == min_nearest_mag_linear ? GL_NEAREST : mode == linear_mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
             GLenum mag_mode = (mode == nearest || mode == min_linear_mag_nearest ? GL_NEAREST : GL_LINEAR);
 
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_mode);
@@ -264,6 +279,43 @@ namespace Graphics
             return std::move(*this);
         }
 
+        // Uploads all mipmaps of the image.
+        TexUnit &&SetData(const CompressedImage &image)
+        {
+            ASSERT(image, "Attempt to use a null image.");
+            ASSERT(HasAttachedHandle(), "Attempt to use a texture unit without an attached texture.");
+            if (!HasAttachedHandle())
+                return std::move(*this);
+
+            Activate();
+            const CompressedImage::Format &format = image.GetFormat();
+            for (int i = 0; const CompressedImage::Level &level : image.Levels())
+            {
+                if (format.compressed)
+                    glCompressedTexImage2D(GL_TEXTURE_2D, i, format.internal_format, level.size.x, level.size.y, 0, level.bytes.size(), level.bytes.data());
+                else
+                    glTexImage2D(GL_TEXTURE_2D, i, format.internal_format, level.size.x, level.size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, level.bytes.data());
+                i++;
+            }
+            #ifdef GL_TEXTURE_MAX_LEVEL
+            // Otherwise the texture is incomplete if the chain doesn't go down to 1x1.
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, int(image.Levels().size()) - 1);
+            #endif
+            return std::move(*this);
+        }
+
+        // Generates the mipmaps from the first level, for `linear_mipmaps` interpolation.
+        TexUnit &&GenerateMipmaps()
+        {
+            ASSERT(HasAttachedHandle(), "Attempt to use a texture unit without an attached texture.");
+            if (!HasAttachedHandle())
+                return std::move(*this);
+
+            Activate();
+            glGenerateMipmap(GL_TEXTURE_2D);
+            return std::move(*this);
+        }
+
         TexUnit &&SetDataPart(ivec2 pos, ivec2 size, const uint8_t *pixels)
         {
             SetDataPart(GL_RGBA, GL_UNSIGNED_BYTE, pos, size, pixels);
@@ -336,6 +388,19 @@ namespace Graphics
             return std::move(*this);
         }
 
+        Texture &&SetData(const CompressedImage &image)
+        {
+            unit.SetData(image);
+            size = image.Size();
+            return std::move(*this);
+        }
+
+        Texture &&GenerateMipmaps()
+        {
+            unit.GenerateMipmaps();
+            return std::move(*this);
+        }
+
         Texture &&SetDataPart(ivec2 part_pos, ivec2 part_size, const uint8_t *pixels)
         {
             unit.SetDataPart(part_pos, part_size, pixels);
@@ -372,4 +437,268 @@ namespace Graphics
         operator       TexUnit &()       {return unit;}
         operator const TexUnit &() const {return unit;}
     };
+
+    // Defined below if the array textures are supported. `Uniform<TexArrayUnit>` is a `sampler2DArray`.
+    class TexArrayUnit;
+
+    #ifdef GL_TEXTURE_2D_ARRAY
+    #  define IMP_HAVE_TEXTURE_ARRAYS
+    #endif
+
+    #ifdef IMP_HAVE_TEXTURE_ARRAYS
+    // Like `TexUnit`, but for `GL_TEXTURE_2D_ARRAY` textures. Each layer is a separate 2D image of the same size.
+    // Sampling from different layers doesn't need rebinding, so e.g. the sprites from several same-size atlases can be drawn in one draw call.
+    // Allocates its own index from the same pool as `TexUnit`.
+    class TexArrayUnit
+    {
+        TexUnit unit;
+        GLuint handle = 0;
+
+      public:
+        TexArrayUnit() {}
+
+        TexArrayUnit(decltype(nullptr)) : unit(nullptr) {}
+        explicit TexArrayUnit(const TexObject &texture) : TexArrayUnit(nullptr)
+        {
+            Attach(texture);
+        }
+
+        TexArrayUnit(TexArrayUnit &&other) noexcept : unit(std::move(other.unit)), handle(std::exchange(other.handle, 0)) {}
+        TexArrayUnit &operator=(TexArrayUnit other) noexcept
+        {
+            std::swap(unit, other.unit);
+            std::swap(handle, other.handle);
+            return *this;
+        }
+
+        explicit operator bool() const
+        {
+            return bool(unit);
+        }
+
+        int Index() const
+        {
+            return unit.Index();
+        }
+
+        void Activate()
+        {
+            unit.Activate();
+        }
+
+        TexArrayUnit &&AttachHandle(GLuint new_handle)
+        {
+            ASSERT(*this, "Attempt to use a null texture unit.");
+            if (!*this)
+                return std::move(*this);
+
+            Activate();
+            handle = new_handle;
+            glBindTexture(GL_TEXTURE_2D_ARRAY, new_handle);
+            return std::move(*this);
+        }
+        TexArrayUnit &&Attach(const TexObject &texture)
+        {
+            AttachHandle(texture.Handle());
+            return std::move(*this);
+        }
+        TexArrayUnit &&Detach()
+        {
+            AttachHandle(0);
+            return std::move(*this);
+        }
+
+        GLuint AttachedHandle() const
+        {
+            return handle;
+        }
+        bool HasAttachedHandle() const
+        {
+            return bool(handle);
+        }
+
+        TexArrayUnit &&Interpolation(InterpolationMode mode)
+        {
+            ASSERT(HasAttachedHandle(), "Attempt to use a texture unit without an attached texture.");
+            if (!HasAttachedHandle())
+                return std::move(*this);
+
+            Activate();
+
+            GLenum min_mode = (mode == nearest || mode == min_nearest_mag_linear ? GL_NEAREST : mode == linear_mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            GLenum mag_mode = (mode == nearest || mode == min_linear_mag_nearest ? GL_NEAREST : GL_LINEAR);
+
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, min_mode);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, mag_mode);
+
+            return std::move(*this);
+        }
+
+        TexArrayUnit &&WrapX(WrapMode mode)
+        {
+            ASSERT(HasAttachedHandle(), "Attempt to use a texture unit without an attached texture.");
+            if (!HasAttachedHandle())
+                return std::move(*this);
+
+            Activate();
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GLuint(mode));
+            return std::move(*this);
+        }
+        TexArrayUnit &&WrapY(WrapMode mode)
+        {
+            ASSERT(HasAttachedHandle(), "Attempt to use a texture unit without an attached texture.");
+            if (!HasAttachedHandle())
+                return std::move(*this);
+
+            Activate();
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GLuint(mode));
+            return std::move(*this);
+        }
+        TexArrayUnit &&Wrap(WrapMode mode)
+        {
+            WrapX(mode);
+            WrapY(mode);
+            return std::move(*this);
+        }
+
+        // Allocates storage for `layers` images of size `size`. If `pixels` isn't null, it must contain all layers one after another.
+        TexArrayUnit &&SetData(ivec2 size, int layers, const uint8_t *pixels = 0)
+        {
+            ASSERT(HasAttachedHandle(), "Attempt to use a texture unit without an attached texture.");
+            if (!HasAttachedHandle())
+                return std::move(*this);
+
+            Activate();
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size.x, size.y, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            return std::move(*this);
+        }
+
+        // Overwrites a part of one layer. The storage must be allocated with `SetData()` first.
+        TexArrayUnit &&SetLayerPart(int layer, ivec2 pos, ivec2 size, const uint8_t *pixels)
+        {
+            ASSERT(HasAttachedHandle(), "Attempt to use a texture unit without an attached texture.");
+            if (!HasAttachedHandle())
+                return std::move(*this);
+
+            Activate();
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, pos.x, pos.y, layer, size.x, size.y, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            return std::move(*this);
+        }
+        // Overwrites one layer completely. The image must have the same size as the layers.
+        TexArrayUnit &&SetLayer(int layer, const Image &image)
+        {
+            ASSERT(image, "Attempt to use a null image.");
+            SetLayerPart(layer, ivec2(0), image.Size(), image.Data());
+            return std::move(*this);
+        }
+
+        // Generates the mipmaps of all layers from their first levels, for `linear_mipmaps` interpolation.
+        TexArrayUnit &&GenerateMipmaps()
+        {
+            ASSERT(HasAttachedHandle(), "Attempt to use a texture unit without an attached texture.");
+            if (!HasAttachedHandle())
+                return std::move(*this);
+
+            Activate();
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            return std::move(*this);
+        }
+    };
+
+    // Like `Texture`, but for array textures.
+    class TextureArray
+    {
+        TexObject object;
+        TexArrayUnit unit;
+        ivec2 size = ivec2(0);
+        int layers = 0;
+
+      public:
+        TextureArray() {}
+
+        TextureArray(decltype(nullptr)) : object(nullptr), unit(nullptr)
+        {
+            unit.Attach(object);
+        }
+
+        TextureArray &&Interpolation(InterpolationMode mode)
+        {
+            unit.Interpolation(mode);
+            return std::move(*this);
+        }
+
+        TextureArray &&WrapX(WrapMode mode)
+        {
+            unit.WrapX(mode);
+            return std::move(*this);
+        }
+        TextureArray &&WrapY(WrapMode mode)
+        {
+            unit.WrapY(mode);
+            return std::move(*this);
+        }
+        TextureArray &&Wrap(WrapMode mode)
+        {
+            unit.Wrap(mode);
+            return std::move(*this);
+        }
+
+        TextureArray &&SetData(ivec2 new_size, int new_layers, const uint8_t *pixels = 0)
+        {
+            unit.SetData(new_size, new_layers, pixels);
+            size = new_size;
+            layers = new_layers;
+            return std::move(*this);
+        }
+
+        TextureArray &&SetLayer(int layer, const Image &image)
+        {
+            ASSERT(layer >= 0 && layer < layers, "Texture array layer is out of range.");
+            ASSERT(image.Size() == size, "The image size doesn't match the texture array size.");
+            unit.SetLayer(layer, image);
+            return std::move(*this);
+        }
+        TextureArray &&SetLayerPart(int layer, ivec2 part_pos, ivec2 part_size, const uint8_t *pixels)
+        {
+            ASSERT(layer >= 0 && layer < layers, "Texture array layer is out of range.");
+            unit.SetLayerPart(layer, part_pos, part_size, pixels);
+            return std::move(*this);
+        }
+
+        TextureArray &&GenerateMipmaps()
+        {
+            unit.GenerateMipmaps();
+            return std::move(*this);
+        }
+
+        ivec2 Size() const
+        {
+            return size;
+        }
+        int Layers() const
+        {
+            return layers;
+        }
+        int Handle() const
+        {
+            return object.Handle();
+        }
+        int Index() const
+        {
+            return unit.Index();
+        }
+
+              TexObject &Object()       {return object;}
+        const TexObject &Object() const {return object;}
+
+              TexArrayUnit &Unit()       {return unit;}
+        const TexArrayUnit &Unit() const {return unit;}
+
+        operator       TexObject &()       {return object;}
+        operator const TexObject &() const {return object;}
+
+        operator       TexArrayUnit &()       {return unit;}
+        operator const TexArrayUnit &() const {return unit;}
+    };
+    #endif
 }
@@ -1,5 +1,6 @@
 #include "texture_atlas.h"
 
+#include <utility>
 #include <vector>
 
 #include "meta/common.h"
@@ -17,7 +18,7 @@ namespace Graphics
             irect2 *texcoords = nullptr;
         };
         std::vector<Elem> elem_list;
-        func([&](std::variant<Stream::ReadOnlyData, ivec2> data, irect2 &texcoords)
+        func([&](std::variant<Stream::ReadOnlyData, ivec2, Image> data, irect2 &texcoords, AtlasTrim *trim)
         {
             Elem &new_elem = elem_list.emplace_back();
             new_elem.texcoords = &texcoords;
@@ -31,7 +32,29 @@ namespace Graphics
                 {
                     texcoords = ivec2().rect_size(size);
                 },
+                [&](Image &image)
+                {
+                    new_elem.image = std::move(image);
+                    texcoords = ivec2().rect_size(new_elem.image.Size());
+                },
             }, data);
+
+            AtlasTrim trim_info = {.offset = ivec2(0), .full_size = texcoords.size()};
+
+            // Trim the transparent borders. The completely transparent images are left as is.
+            if (bool(flags & AtlasFlags::trim_alpha) && new_elem.image)
+            {
+                irect2 bounds = new_elem.image.NonTransparentBounds();
+                if (bounds.has_area() && bounds.size() != new_elem.image.Size())
+                {
+                    new_elem.image = new_elem.image.UnsafeCrop(bounds);
+                    texcoords = ivec2().rect_size(bounds.size());
+                    trim_info.offset = bounds.a;
+                }
+            }
+
+            if (trim)
+                *trim = trim_info;
         });
 
         // Construct the rectangle list for packing.
@@ -41,7 +64,12 @@ namespace Graphics
             rect_list.push_back(elem.texcoords->size());
 
         // Try packing the rectangles.
-        if (Packing::PackRects(target_size, rect_list.data(), rect_list.size(), bool(flags & AtlasFlags::add_gaps)))
+        int rects_not_packed = 0;
+        if (bool(flags & AtlasFlags::dense))
+            rects_not_packed = Packing::PackRectsMultiPage(target_size, rect_list.data(), rect_list.size(), {.inner_gaps = bool(flags & AtlasFlags::add_gaps), .max_pages = 1}).rects_not_packed;
+        else
+            rects_not_packed = Packing::PackRects(target_size, rect_list.data(), rect_list.size(), bool(flags & AtlasFlags::add_gaps));
+        if (rects_not_packed)
             throw std::runtime_error(FMT("Unable to fit texture atlas into a {}x{} texture.", target_size.x, target_size.y));
 
         // Construct the final image, and output the texture coords.
@@ -56,6 +84,9 @@ namespace Graphics
             *elem_list[i].texcoords = rect_list[i].pos.rect_size(elem_list[i].texcoords->size());
         }
 
+        if (bool(flags & AtlasFlags::premultiply_alpha))
+            ret.PremultiplyAlpha();
+
         return ret;
     }
 }
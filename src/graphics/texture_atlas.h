@@ -10,15 +10,26 @@
 
 namespace Graphics
 {
+    // Describes how an image was trimmed by `AtlasFlags::trim_alpha`.
+    struct AtlasTrim
+    {
+        ivec2 offset; // The position of the trimmed part in the original image.
+        ivec2 full_size; // The size of the original image.
+    };
+
     // Call this to add an image to the atlas.
-    // `data` is either the image data or the size of an empty image.
+    // `data` is either the image data, an already decoded image, or the size of an empty image.
     // `texcoords` receives the texture coords.
-    using AtlasInputFunc = std::function<void(std::variant<Stream::ReadOnlyData, ivec2> data, irect2 &texcoords)>;
+    // `trim` is optional. If not null, receives the trimming info. If the image wasn't trimmed, the offset is zero and the full size matches `texcoords`.
+    using AtlasInputFunc = std::function<void(std::variant<Stream::ReadOnlyData, ivec2, Image> data, irect2 &texcoords, AtlasTrim *trim)>;
 
     enum class AtlasFlags
     {
         none = 0,
         add_gaps = 1 << 0,
+        dense = 1 << 1, // Pack with `Packing::PackRectsMultiPage()` (on a single page), which is denser but slower.
+        premultiply_alpha = 1 << 2, // Premultiply the alpha of the resulting image, see `Image::PremultiplyAlpha()`.
+        trim_alpha = 1 << 3, // Cut the fully transparent borders off the images before packing. Check `AtlasTrim` to position them correctly. The empty images (specified by size) are not trimmed.
     };
     IMP_ENUM_FLAG_OPERATORS(AtlasFlags)
 
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#include <cglfl/cglfl.hpp>
+
+#include "graphics/texture.h"
+#include "macros/finally.h"
+#include "program/errors.h"
+#include "program/platform.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    #if defined(GL_PIXEL_UNPACK_BUFFER) && defined(GL_MAP_WRITE_BIT) && !IMP_PLATFORM_IS(web) // WebGL can't map buffers.
+    #  define IMP_HAVE_ASYNC_TEXTURE_UPLOADS
+    #endif
+
+    #ifdef IMP_HAVE_ASYNC_TEXTURE_UPLOADS
+    // Uploads RGBA8 pixels to a texture through a pixel buffer object, without blocking on the copy.
+    // Usage:
+    //     TextureUpload upload(nullptr, size); // On the main thread.
+    //     ... = upload.Pixels(); // Fill the memory, possibly on a different thread.
+    //     upload.Upload(texture); // On the main thread, after the memory is filled. The texture must already have enough storage.
+    //     if (upload.Done()) ... // The texture was updated on the GPU, the upload can be reused with `Map()`.
+    // All functions except for `Pixels()` must be called on the thread that owns the GL context.
+    class TextureUpload
+    {
+        struct Data
+        {
+            GLuint handle = 0;
+            GLsync fence = 0;
+            ivec2 size;
+            std::uint8_t *pixels = nullptr; // Non-null while mapped.
+        };
+        Data data;
+
+        static constexpr int bytes_per_pixel = 4;
+
+        void Bind() const
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, data.handle);
+        }
+        static void Unbind()
+        {
+            // Otherwise the regular texture uploads would read from the buffer.
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        void DeleteFence()
+        {
+            if (data.fence)
+                glDeleteSync(std::exchange(data.fence, {}));
+        }
+
+      public:
+        TextureUpload() {}
+
+        // Creates the buffer and maps it.
+        TextureUpload(decltype(nullptr), ivec2 size)
+        {
+            if (size(any) <= 0)
+                throw std::runtime_error("Invalid texture upload size.");
+            data.size = size;
+
+            glGenBuffers(1, &data.handle);
+            if (!data.handle)
+                throw std::runtime_error("Unable to create a pixel buffer.");
+            FINALLY_ON_THROW{glDeleteBuffers(1, &data.handle);};
+
+            Bind();
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, ByteSize(), nullptr, GL_STREAM_DRAW);
+            Unbind();
+            Map();
+        }
+
+        TextureUpload(TextureUpload &&other) noexcept : data(std::exchange(other.data, {})) {}
+        TextureUpload &operator=(TextureUpload other) noexcept // Note the pass by value to utilize copy&swap idiom.
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~TextureUpload()
+        {
+            DeleteFence();
+            if (data.handle)
+                glDeleteBuffers(1, &data.handle); // This also unmaps it. Deleting 0 is a no-op, but GL could be unloaded at this point.
+        }
+
+        explicit operator bool() const
+        {
+            return bool(data.handle);
+        }
+
+        [[nodiscard]] ivec2 Size() const
+        {
+            return data.size;
+        }
+        [[nodiscard]] std::size_t ByteSize() const
+        {
+            return std::size_t(data.size.prod()) * bytes_per_pixel;
+        }
+
+        // Whether `Pixels()` can be written to.
+        [[nodiscard]] bool Mapped() const
+        {
+            return bool(data.pixels);
+        }
+
+        // The mapped memory, `ByteSize()` bytes, the rows are tightly packed.
+        // Can be written to from any thread, but must not be touched after `Upload()`.
+        [[nodiscard]] std::uint8_t *Pixels() const
+        {
+            ASSERT(Mapped(), "The texture upload is not mapped.");
+            return data.pixels;
+        }
+
+        // Maps the buffer again after `Upload()`. Doesn't wait for the previous upload to finish, the old contents are orphaned.
+        void Map()
+        {
+            ASSERT(*this, "Attempt to use a null texture upload.");
+            if (Mapped())
+                return;
+            Bind();
+            FINALLY{Unbind();};
+            data.pixels = static_cast<std::uint8_t *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ByteSize(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+            if (!data.pixels)
+                throw std::runtime_error("Unable to map a pixel buffer.");
+        }
+
+        // Unmaps the buffer, and starts copying it to the texture at `pos`.
+        // The texture must already have storage for this region, e.g. from `SetData(size)` with null pixels.
+        void Upload(TexUnit &unit, ivec2 pos = ivec2(0))
+        {
+            ASSERT(Mapped(), "The texture upload is not mapped.");
+            ASSERT(unit.HasAttachedHandle(), "Attempt to use a texture unit without an attached texture.");
+
+            Bind();
+            FINALLY{Unbind();};
+            data.pixels = nullptr;
+            if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+                throw std::runtime_error("The pixel buffer contents were lost while it was mapped.");
+
+            unit.Activate();
+            glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, data.size.x, data.size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr); // The pointer is an offset into the buffer.
+
+            DeleteFence();
+            data.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        // Returns true if the last `Upload()` has finished on the GPU, or if there was no upload. Never waits.
+        [[nodiscard]] bool Done()
+        {
+            if (!data.fence)
+                return true;
+            GLenum status = glClientWaitSync(data.fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+                return false;
+            DeleteFence();
+            return true;
+        }
+    };
+    #endif
+}
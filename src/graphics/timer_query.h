@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#include <cglfl/cglfl.hpp>
+
+#include "program/errors.h"
+
+namespace Graphics
+{
+    #ifdef GL_TIMESTAMP
+    #  define IMP_HAVE_TIMER_QUERIES
+    #endif
+
+    #ifdef IMP_HAVE_TIMER_QUERIES
+    // Records the GPU time at which all the previous commands are finished.
+    // We use timestamps rather than `GL_TIME_ELAPSED`, because the latter can't be nested.
+    class TimerQuery
+    {
+        struct Data
+        {
+            GLuint handle = 0;
+        };
+        Data data;
+
+      public:
+        TimerQuery() {}
+
+        TimerQuery(decltype(nullptr))
+        {
+            glGenQueries(1, &data.handle);
+            if (!data.handle)
+                throw std::runtime_error("Unable to create a timer query.");
+        }
+
+        TimerQuery(TimerQuery &&other) noexcept : data(std::exchange(other.data, {})) {}
+        TimerQuery &operator=(TimerQuery other) noexcept // Note the pass by value to utilize copy&swap idiom.
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~TimerQuery()
+        {
+            if (data.handle)
+                glDeleteQueries(1, &data.handle); // Deleting 0 is a no-op, but GL could be unloaded at this point.
+        }
+
+        explicit operator bool() const
+        {
+            return bool(data.handle);
+        }
+
+        GLuint Handle() const
+        {
+            return data.handle;
+        }
+
+        // Requests the timestamp. The result becomes available later.
+        void Record()
+        {
+            ASSERT(*this, "Attempt to use a null timer query.");
+            glQueryCounter(data.handle, GL_TIMESTAMP);
+        }
+
+        // Returns true if the result of the last `Record()` can be read without waiting.
+        [[nodiscard]] bool Available() const
+        {
+            GLint ret = 0;
+            glGetQueryObjectiv(data.handle, GL_QUERY_RESULT_AVAILABLE, &ret);
+            return ret;
+        }
+
+        // Returns the timestamp in nanoseconds. Waits for it if it's not `Available()` yet.
+        [[nodiscard]] std::uint64_t Nanoseconds() const
+        {
+            GLuint64 ret = 0;
+            glGetQueryObjectui64v(data.handle, GL_QUERY_RESULT, &ret);
+            return ret;
+        }
+    };
+    #endif
+}
@@ -44,6 +44,7 @@ namespace Graphics
             return ret;
         }
         else if constexpr (std::is_same_v<T, TexUnit     >) return "sampler2D";
+        else if constexpr (std::is_same_v<T, TexArrayUnit>) return "sampler2DArray";
         else if constexpr (std::is_same_v<T, bool        >) return "bool";
         else if constexpr (std::is_same_v<T, float       >) return "float";
         else if constexpr (std::is_same_v<T, double      >) return "double";
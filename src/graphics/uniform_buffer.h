@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include <cglfl/cglfl.hpp>
+
+#include "macros/finally.h"
+#include "program/errors.h"
+
+namespace Graphics
+{
+    #ifdef GL_UNIFORM_BUFFER
+    #  define IMP_HAVE_UNIFORM_BUFFERS
+    #endif
+
+    #ifdef IMP_HAVE_UNIFORM_BUFFERS
+    // A buffer holding the values of a uniform block, which can be shared by several shaders (see `Shader::BindUniformBlock()`).
+    // `T` must match the `std140` layout of the block. Prefer `fvec4` and `fmat4` members, since the smaller vectors are padded.
+    // Not available on GLES 2 and WebGL 1.
+    template <typename T>
+    class UniformBuffer
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "The type must be trivially copyable.");
+
+        struct Data
+        {
+            GLuint handle = 0;
+        };
+        Data data;
+
+        std::optional<T> last_value; // To skip the redundant uploads.
+
+      public:
+        UniformBuffer() {}
+
+        UniformBuffer(decltype(nullptr))
+        {
+            glGenBuffers(1, &data.handle);
+            if (!data.handle)
+                throw std::runtime_error("Unable to create a uniform buffer.");
+            FINALLY_ON_THROW{glDeleteBuffers(1, &data.handle);};
+            glBindBuffer(GL_UNIFORM_BUFFER, data.handle);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        }
+
+        UniformBuffer(UniformBuffer &&other) noexcept : data(std::exchange(other.data, {})), last_value(std::exchange(other.last_value, {})) {}
+        UniformBuffer &operator=(UniformBuffer other) noexcept // Note the pass by value to utilize copy&swap idiom.
+        {
+            std::swap(data, other.data);
+            std::swap(last_value, other.last_value);
+            return *this;
+        }
+
+        ~UniformBuffer()
+        {
+            if (data.handle)
+                glDeleteBuffers(1, &data.handle); // Deleting 0 is a no-op, but GL could be unloaded at this point.
+        }
+
+        explicit operator bool() const
+        {
+            return bool(data.handle);
+        }
+
+        GLuint Handle() const
+        {
+            return data.handle;
+        }
+
+        // Uploads the value, unless it's the same as the last one.
+        void Set(const T &value)
+        {
+            ASSERT(*this, "Attempt to use a null uniform buffer.");
+            if (last_value && std::memcmp(&*last_value, &value, sizeof(T)) == 0)
+                return;
+            last_value = value;
+            glBindBuffer(GL_UNIFORM_BUFFER, data.handle);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &value);
+        }
+
+        // Makes the blocks associated with `binding_point` read from this buffer.
+        void BindToPoint(GLuint binding_point) const
+        {
+            ASSERT(*this, "Attempt to use a null uniform buffer.");
+            glBindBufferBase(GL_UNIFORM_BUFFER, binding_point, data.handle);
+        }
+    };
+    #endif
+}
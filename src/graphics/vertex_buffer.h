@@ -1,14 +1,18 @@
 #pragma once
 
+#include <cstdint>
+#include <stdexcept>
 #include <type_traits>
 #include <utility>
 
 #include <cglfl/cglfl.hpp>
 
+#include "graphics/draw_calls.h"
 #include "graphics/types.h"
 #include "macros/finally.h"
 #include "meta/common.h"
 #include "program/errors.h"
+#include "program/platform.h"
 #include "reflection/structs.h"
 #include "utils/mat.h"
 
@@ -43,8 +47,17 @@ namespace Graphics
         // Only one buffer can be bound at a time. Optionally it can be draw-bound at the same time.
         inline static GLuint binding = 0;
         inline static GLuint binding_draw = 0;
+        inline static std::uintptr_t binding_draw_offset = 0; // In bytes.
+        inline static bool binding_draw_per_instance = false;
 
         inline static int active_attrib_count = 0;
+        inline static int per_instance_attrib_count = 0; // This many first attributes have the divisor set to 1.
+
+        // The vertex array objects. The reflected `VertexBuffer`s have their own ones, with the attributes set up once.
+        // Everything else uses the default one (normally the `DummyVertexArray`, or 0), and the variables above describe its state.
+        inline static GLuint vertex_array_binding = 0;
+        inline static GLuint default_vertex_array = 0;
+        inline static GLuint vertex_array_draw_handle = 0; // The buffer used by `vertex_array_binding`, if it's not the default one.
 
         static void SetActiveAttribCount(int count)
         {
@@ -56,7 +69,81 @@ namespace Graphics
                 do glDisableVertexAttribArray(--active_attrib_count); while (active_attrib_count > count);
         }
 
+        static void SetPerInstanceAttribCount(int count)
+        {
+            if (count == per_instance_attrib_count)
+                return;
+            #ifdef GL_VERTEX_ATTRIB_ARRAY_DIVISOR
+            if (per_instance_attrib_count < count)
+                do glVertexAttribDivisor(per_instance_attrib_count++, 1); while (per_instance_attrib_count < count);
+            else
+                do glVertexAttribDivisor(--per_instance_attrib_count, 0); while (per_instance_attrib_count > count);
+            #endif
+        }
+
+        static void BindDefaultVertexArray()
+        {
+            #ifdef GL_VERTEX_ARRAY_BINDING
+            if (vertex_array_binding == default_vertex_array)
+                return;
+            glBindVertexArray(default_vertex_array);
+            vertex_array_binding = default_vertex_array;
+            #endif
+        }
+
+        // Sets the attribute pointers for the buffer currently bound with `BindStorage()`.
+        template <typename T>
+        static void SetAttribPointers(const T &attributes, std::uintptr_t offset)
+        {
+            int attrib_index = 0;
+
+            Meta::const_for<Refl::Class::member_count<T>>([&](auto index)
+            {
+                constexpr auto i = index.value;
+                using field_type = Refl::Class::member_type<T, i>;
+                using base_type = Math::vec_base_t<field_type>;
+
+                GLint type_enum;
+
+                if constexpr (std::is_same_v<base_type, char>)
+                    type_enum = (std::is_signed_v<char> ? GL_BYTE : GL_UNSIGNED_BYTE);
+                else if constexpr (std::is_same_v<base_type, signed char>)
+                    type_enum = GL_BYTE;
+                else if constexpr (std::is_same_v<base_type, unsigned char>)
+                    type_enum = GL_UNSIGNED_BYTE;
+                else if constexpr (std::is_same_v<base_type, short>)
+                    type_enum = GL_SHORT;
+                else if constexpr (std::is_same_v<base_type, unsigned short>)
+                    type_enum = GL_UNSIGNED_SHORT;
+                #ifdef GL_INT
+                else if constexpr (std::is_same_v<base_type, int>)
+                    type_enum = GL_INT;
+                else if constexpr (std::is_same_v<base_type, unsigned int>)
+                    type_enum = GL_UNSIGNED_INT;
+                #endif
+                else if constexpr (std::is_same_v<base_type, float>)
+                    type_enum = GL_FLOAT;
+                else
+                    static_assert(Meta::always_false<T, decltype(index)>, "Attributes of this type are not supported.");
+
+                uintptr_t member_offset = offset + (reinterpret_cast<const char *>(&Refl::Class::Member<i>(attributes)) - reinterpret_cast<const char *>(&attributes));
+                glVertexAttribPointer(attrib_index++, Math::vec_size_v<field_type>, type_enum, Refl::Class::member_has_attrib<T, i, Normalized>, sizeof(T), (void *)member_offset);
+            });
+        }
+
       public:
+        #ifdef GL_VERTEX_ATTRIB_ARRAY_DIVISOR
+        static constexpr bool instancing_supported = true;
+        #else
+        static constexpr bool instancing_supported = false;
+        #endif
+
+        #ifdef GL_VERTEX_ARRAY_BINDING
+        static constexpr bool vertex_arrays_supported = true;
+        #else
+        static constexpr bool vertex_arrays_supported = false;
+        #endif
+
         // Simply binds the VBO if it's not already bound.
         static void BindStorage(GLuint handle)
         {
@@ -70,9 +157,12 @@ namespace Graphics
         // First, binds storage for the same handle if necessary. Then sets attribute pointers if T is reflected, otherwise disables all attributes.
         // BindDraw(0) is a special case. It disables all attributes, and thus strips draw binding from currently bound buffer (if any).
         // `attributes` is effectively unused. We need it to compute attribute offsets.
+        // `offset` is added to the attribute offsets, in bytes. If `per_instance` is true, the attributes advance once per instance (requires `instancing_supported`).
         template <typename T>
-        static void BindDraw(GLuint handle, const T &attributes)
+        static void BindDraw(GLuint handle, const T &attributes, std::uintptr_t offset = 0, bool per_instance = false)
         {
+            BindDefaultVertexArray();
+
             if (handle == 0) // Null handle is a special case.
             {
                 // Note that we disable attributes unconditionally. We don't want to insert `if (binding_draw != 0)` here.
@@ -81,7 +171,7 @@ namespace Graphics
                 return;
             }
 
-            if (binding_draw == handle)
+            if (binding_draw == handle && binding_draw_offset == offset && binding_draw_per_instance == per_instance)
                 return;
             BindStorage(handle);
 
@@ -89,46 +179,15 @@ namespace Graphics
             constexpr auto field_count = Refl::Class::member_count<T>; // 0 if not reflected.
 
             SetActiveAttribCount(field_count);
+            ASSERT(!per_instance || instancing_supported, "Instanced rendering is not supported.");
+            SetPerInstanceAttribCount(per_instance ? field_count : 0);
 
             if constexpr (is_reflected)
-            {
-                int attrib_index = 0;
-
-                Meta::const_for<Refl::Class::member_count<T>>([&](auto index)
-                {
-                    constexpr auto i = index.value;
-                    using field_type = Refl::Class::member_type<T, i>;
-                    using base_type = Math::vec_base_t<field_type>;
-
-                    GLint type_enum;
-
-                    if constexpr (std::is_same_v<base_type, char>)
-                        type_enum = (std::is_signed_v<char> ? GL_BYTE : GL_UNSIGNED_BYTE);
-                    else if constexpr (std::is_same_v<base_type, signed char>)
-                        type_enum = GL_BYTE;
-                    else if constexpr (std::is_same_v<base_type, unsigned char>)
-                        type_enum = GL_UNSIGNED_BYTE;
-                    else if constexpr (std::is_same_v<base_type, short>)
-                        type_enum = GL_SHORT;
-                    else if constexpr (std::is_same_v<base_type, unsigned short>)
-                        type_enum = GL_UNSIGNED_SHORT;
-                    #ifdef GL_INT
-                    else if constexpr (std::is_same_v<base_type, int>)
-                        type_enum = GL_INT;
-                    else if constexpr (std::is_same_v<base_type, unsigned int>)
-                        type_enum = GL_UNSIGNED_INT;
-                    #endif
-                    else if constexpr (std::is_same_v<base_type, float>)
-                        type_enum = GL_FLOAT;
-                    else
-                        static_assert(Meta::always_false<T, decltype(index)>, "Attributes of this type are not supported.");
-
-                    uintptr_t offset = reinterpret_cast<const char *>(&Refl::Class::Member<i>(attributes)) - reinterpret_cast<const char *>(&attributes);
-                    glVertexAttribPointer(attrib_index++, Math::vec_size_v<field_type>, type_enum, Refl::Class::member_has_attrib<T, i, Normalized>, sizeof(T), (void *)offset);
-                });
-            }
+                SetAttribPointers(attributes, offset);
 
             binding_draw = handle;
+            binding_draw_offset = offset;
+            binding_draw_per_instance = per_instance;
         }
 
         static void ForgetBoundBuffer() // Assume no buffer is bound, but don't actually unbind anything. Useful if currently bound buffer is going to be deleted immediately.
@@ -137,13 +196,72 @@ namespace Graphics
             binding_draw = 0;
         }
 
+        // Binds a vertex array object that reads from the buffer `draw_handle`, if it's not already bound. Requires `vertex_arrays_supported`.
+        // If `attributes` isn't null, this is a new vertex array, and its attributes are set up as in `BindDraw()`. Binds storage in that case.
+        template <typename T>
+        static void BindVertexArray(GLuint vao, GLuint draw_handle, const T *attributes = nullptr)
+        {
+            #ifdef GL_VERTEX_ARRAY_BINDING
+            if (vertex_array_binding != vao)
+            {
+                glBindVertexArray(vao);
+                vertex_array_binding = vao;
+            }
+            vertex_array_draw_handle = draw_handle;
+
+            if (attributes)
+            {
+                BindStorage(draw_handle);
+                for (int i = 0; i < int(Refl::Class::member_count<T>); i++)
+                    glEnableVertexAttribArray(i);
+                SetAttribPointers(*attributes, 0);
+            }
+            #else
+            (void)vao; (void)draw_handle; (void)attributes;
+            ASSERT(false, "Vertex array objects are not supported.");
+            #endif
+        }
+
+        // Call this before deleting a vertex array object.
+        static void ForgetVertexArray(GLuint vao)
+        {
+            if (vertex_array_binding == vao)
+                vertex_array_binding = 0; // GL unbinds it automatically.
+            if (default_vertex_array == vao)
+            {
+                // Fall back to the vertex array 0. We know nothing about its state.
+                default_vertex_array = 0;
+                active_attrib_count = 0;
+                per_instance_attrib_count = 0;
+                binding_draw = 0;
+            }
+        }
+
+        // Sets the vertex array used by `BindDraw()`, and binds it. `DummyVertexArray` calls this automatically.
+        static void SetDefaultVertexArray(GLuint vao)
+        {
+            default_vertex_array = vao;
+            #ifdef GL_VERTEX_ARRAY_BINDING
+            glBindVertexArray(vao);
+            vertex_array_binding = vao;
+            #endif
+            // This is a different object, so we know nothing about its state.
+            active_attrib_count = 0;
+            per_instance_attrib_count = 0;
+            binding_draw = 0;
+        }
+
         static GLuint StorageBinding()
         {
             return binding;
         }
         static GLuint DrawBinding()
         {
-            return binding_draw;
+            return vertex_array_binding == default_vertex_array ? binding_draw : vertex_array_draw_handle;
+        }
+        static GLuint VertexArrayBinding()
+        {
+            return vertex_array_binding;
         }
     };
 
@@ -156,12 +274,16 @@ namespace Graphics
         {
             GLuint handle = 0;
             int size = 0;
+            mutable GLuint vertex_array = 0; // Created by the first `BindDraw()`, if `use_vertex_array` is true.
         };
         Data data;
 
       public:
         static constexpr bool is_reflected = Refl::Class::members_known<T>;
 
+        // If true, `BindDraw()` uses a vertex array object, with the attributes set up once, so switching between the buffers is cheap.
+        static constexpr bool use_vertex_array = is_reflected && VertexBuffers::vertex_arrays_supported;
+
         VertexBuffer() {}
 
         VertexBuffer(decltype(nullptr))
@@ -186,6 +308,13 @@ namespace Graphics
 
         ~VertexBuffer()
         {
+            #ifdef GL_VERTEX_ARRAY_BINDING
+            if (data.vertex_array)
+            {
+                VertexBuffers::ForgetVertexArray(data.vertex_array);
+                glDeleteVertexArrays(1, &data.vertex_array);
+            }
+            #endif
             if (StorageBound())
                 VertexBuffers::ForgetBoundBuffer(); // GL unbinds the buffer automatically.
             if (data.handle)
@@ -223,9 +352,28 @@ namespace Graphics
             ASSERT(*this, "Attempt to use a null vertex buffer.");
             if (!*this)
                 return;
+
+            #ifdef GL_VERTEX_ARRAY_BINDING
+            if constexpr (use_vertex_array)
+            {
+                if (data.vertex_array)
+                {
+                    VertexBuffers::BindVertexArray<T>(data.vertex_array, data.handle);
+                }
+                else
+                {
+                    glGenVertexArrays(1, &data.vertex_array);
+                    if (!data.vertex_array)
+                        throw std::runtime_error("Unable to create a vertex array object.");
+                    VertexBuffers::BindVertexArray(data.vertex_array, data.handle, &attributes);
+                }
+                return;
+            }
+            #endif
+
             VertexBuffers::BindDraw(data.handle, attributes);
         }
-        static void UnbindDraw() // Disables all attributes. If any buffer is currently bound, this results in stripping draw binding from it.
+        static void UnbindDraw() // Binds the default vertex array and disables all its attributes. If any buffer is currently bound, this results in stripping draw binding from it.
         {
             VertexBuffers::BindDraw(0, nullptr);
         }
@@ -262,6 +410,45 @@ namespace Graphics
             glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, source);
         }
 
+        // Replaces the storage with a new uninitialized one of the same size. Binds storage.
+        // The pending draws keep using the old storage, so unlike `SetDataPart()` this never waits for them. Useful for streaming.
+        void Orphan(Usage usage = stream_draw)
+        {
+            SetData(data.size, nullptr, usage);
+        }
+
+        #if defined(GL_MAP_UNSYNCHRONIZED_BIT) && !IMP_PLATFORM_IS(web) // WebGL can't map buffers.
+        static constexpr bool can_map = true;
+
+        // Maps a part of the buffer for writing, without waiting for the pending draws. Binds storage.
+        // You must not write to the parts that are still being read by the GPU (`Orphan()` first if necessary).
+        // The previous contents of the range are lost. Call `FlushMapped()` for the parts you've written, then `Unmap()` before drawing.
+        [[nodiscard]] T *MapForWriting(int elem_offset, int elem_count)
+        {
+            ASSERT(*this, "Attempt to use a null vertex buffer.");
+            BindStorage();
+            void *ret = glMapBufferRange(GL_ARRAY_BUFFER, elem_offset * sizeof(T), elem_count * sizeof(T),
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (!ret)
+                throw std::runtime_error("Unable to map a vertex buffer.");
+            return static_cast<T *>(ret);
+        }
+        // The offset is relative to the beginning of the mapped range. Binds storage.
+        void FlushMapped(int elem_offset, int elem_count)
+        {
+            BindStorage();
+            glFlushMappedBufferRange(GL_ARRAY_BUFFER, elem_offset * sizeof(T), elem_count * sizeof(T));
+        }
+        void Unmap() // Binds storage.
+        {
+            BindStorage();
+            // This returns false if the contents were lost (e.g. due to a screen mode change), but then they'll be redrawn on the next frame anyway.
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        #else
+        static constexpr bool can_map = false;
+        #endif
+
         void Draw(DrawMode m, int offset, int count) const // Binds for drawing.
         {
             static_assert(is_reflected, "Element type of this buffer is not reflected, unable to draw.");
@@ -270,6 +457,7 @@ namespace Graphics
                 return;
             BindDraw();
             glDrawArrays(m, offset, count);
+            draw_call_counter++;
         }
         void Draw(DrawMode m, int count) const // Binds for drawing.
         {
@@ -279,5 +467,24 @@ namespace Graphics
         {
             Draw(m, 0, Size());
         }
+
+        // Draws `instance_count` instances of `vertex_count` vertices each. The elements are used as per-instance attributes, starting from `first_instance`.
+        // The shader can use `gl_VertexID` to tell the vertices apart. Binds for drawing.
+        // Throws if `VertexBuffers::instancing_supported` is false.
+        void DrawInstanced(DrawMode m, int vertex_count, int first_instance, int instance_count) const
+        {
+            static_assert(is_reflected, "Element type of this buffer is not reflected, unable to draw.");
+            ASSERT(*this, "Attempt to use a null vertex buffer.");
+            if (!*this)
+                return;
+            #ifdef GL_VERTEX_ATTRIB_ARRAY_DIVISOR
+            VertexBuffers::BindDraw(data.handle, T{}, first_instance * sizeof(T), true);
+            glDrawArraysInstanced(m, 0, vertex_count, instance_count);
+            draw_call_counter++;
+            #else
+            (void)m; (void)vertex_count; (void)first_instance; (void)instance_count;
+            throw std::runtime_error("Instanced rendering is not supported by this OpenGL version.");
+            #endif
+        }
     };
 }
@@ -2,13 +2,15 @@
 
 #include <cglfl/cglfl.hpp>
 
+#include "graphics/state_cache.h"
 #include "utils/mat.h"
 
 namespace Graphics
 {
+    // The redundant calls are skipped, see `graphics/state_cache.h`.
     inline void Viewport(ivec2 pos, ivec2 size)
     {
-        glViewport(pos.x, pos.y, size.x, size.y);
+        StateCache::Viewport(pos, size);
     }
     inline void Viewport(ivec2 size)
     {
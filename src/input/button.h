@@ -1,7 +1,9 @@
 #pragma once
 
-#include <functional>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include "input/enum.h"
 #include "interface/window.h"
@@ -14,29 +16,22 @@ namespace Input
 
         bool Assign(Enum begin, Enum end)
         {
-            auto window = Interface::Window::Get();
-            uint64_t tick = window.Ticks();
-
-            for (auto i = begin; i < end; i = Enum(i+1))
-            {
-                if (window.GetInputData(i).press == tick)
-                {
-                    index = i;
-                    return true;
-                }
-            }
-
-            return false;
+            using State = Interface::Window::InputState;
+            Enum i = State::First(Interface::Window::Get().GetInputState().pressed, State::RangeMask(begin, end));
+            if (i == None)
+                return false;
+            index = i;
+            return true;
         }
 
       public:
         Button() {}
         Button(Enum index) : index(index) {}
 
-        [[nodiscard]] bool pressed () const {auto window = Interface::Window::Get(); return window.GetInputData(index).press   == window.Ticks();}
-        [[nodiscard]] bool released() const {auto window = Interface::Window::Get(); return window.GetInputData(index).release == window.Ticks();}
-        [[nodiscard]] bool repeated() const {auto window = Interface::Window::Get(); return window.GetInputData(index).repeat  == window.Ticks();}
-        [[nodiscard]] bool down    () const {return Interface::Window::Get().GetInputData(index).is_down;}
+        [[nodiscard]] bool pressed () const {return Interface::Window::Get().GetInputState().IsPressed (index);}
+        [[nodiscard]] bool released() const {return Interface::Window::Get().GetInputState().IsReleased(index);}
+        [[nodiscard]] bool repeated() const {return Interface::Window::Get().GetInputState().IsRepeated(index);}
+        [[nodiscard]] bool down    () const {return Interface::Window::Get().GetInputState().IsDown    (index);}
         [[nodiscard]] bool up      () const {return !down();}
 
         // Returns true if the key is not null.
@@ -130,21 +125,32 @@ namespace Input
 
     class ButtonList
     {
+        using State = Interface::Window::InputState;
+
         std::vector<Button> buttons;
-        mutable std::uint64_t cached_time = 0;
-        mutable std::optional<bool> cached_pressed, cached_released, cached_repeated, cached_down;
+        mutable State::Bits mask{}; // The bits of all `buttons`.
+        mutable bool mask_outdated = true;
 
-        void UpdateCache() const
+        const State::Bits &Mask() const
         {
-            auto cur_time = Interface::Window::Get().Ticks();
-            if (cur_time == cached_time)
-                return;
-            cached_time = cur_time;
-
-            cached_pressed.reset();
-            cached_released.reset();
-            cached_repeated.reset();
-            cached_down.reset();
+            if (mask_outdated)
+            {
+                mask = {};
+                for (const Button &button : buttons)
+                    State::Set(mask, button.Index(), true);
+                mask_outdated = false;
+            }
+            return mask;
+        }
+
+        // Returns true if `mask & a & ~b & ~c` is not empty.
+        [[nodiscard]] bool AnyAndNot(const State::Bits &a, const State::Bits &b, const State::Bits &c) const
+        {
+            const State::Bits &m = Mask();
+            std::uint64_t ret = 0;
+            for (std::size_t i = 0; i < State::num_words; i++)
+                ret |= m[i] & a[i] & ~b[i] & ~c[i];
+            return ret != 0;
         }
 
       public:
@@ -152,68 +158,33 @@ namespace Input
         ButtonList(std::vector<Button> buttons) : buttons(buttons) {}
 
         [[nodiscard]] const std::vector<Button> &GetButtons() const {return buttons;}
-        [[nodiscard]] std::vector<Button> &ModifyButtons() {cached_time = 0; return buttons;}
+        [[nodiscard]] std::vector<Button> &ModifyButtons() {mask_outdated = true; return buttons;}
 
         [[nodiscard]] bool pressed() const
         {
             // Return true if at least one button is pressed, and none of them are down and not pressed at the same time.
-            UpdateCache();
-            if (!cached_pressed)
-            {
-                cached_pressed = false;
-                for (const Button &button : buttons)
-                {
-                    bool button_pressed = button.pressed();
-                    if (!button_pressed && button.down())
-                    {
-                        *cached_pressed = false;
-                        break;
-                    }
-                    if (button_pressed)
-                        *cached_pressed = true;
-                }
-            }
-            return *cached_pressed;
+            const State &state = Interface::Window::Get().GetInputState();
+            return State::Any(state.pressed, Mask()) && !AnyAndNot(state.down, state.pressed, {});
         }
 
         [[nodiscard]] bool released() const
         {
             // Return true if at least one button is released, and none of them are down.
-            UpdateCache();
-            if (!cached_released)
-            {
-                cached_released = false;
-                for (const Button &button : buttons)
-                {
-                    bool button_released = button.released();
-                    if (!button_released && !button.pressed() && button.down()) // This can't be just `button.down()` to properly handle regrabbing the (same or different) button on the same tick.
-                    {
-                        *cached_released = false;
-                        break;
-                    }
-                    if (button_released)
-                        *cached_released = true;
-                }
-            }
-            return *cached_released;
+            // Not just "none of them are down", to properly handle regrabbing the (same or different) button on the same tick.
+            const State &state = Interface::Window::Get().GetInputState();
+            return State::Any(state.released, Mask()) && !AnyAndNot(state.down, state.released, state.pressed);
         }
 
         [[nodiscard]] bool repeated() const
         {
             // Return true if any of the buttons is repeated.
-            UpdateCache();
-            if (!cached_repeated)
-                cached_repeated = std::any_of(buttons.begin(), buttons.end(), std::mem_fn(&Button::repeated));
-            return *cached_repeated;
+            return State::Any(Interface::Window::Get().GetInputState().repeated, Mask());
         }
 
         [[nodiscard]] bool down() const
         {
             // Return true if any of the buttons is down.
-            UpdateCache();
-            if (!cached_down)
-                cached_down = std::any_of(buttons.begin(), buttons.end(), std::mem_fn(&Button::down));
-            return *cached_down;
+            return State::Any(Interface::Window::Get().GetInputState().down, Mask());
         }
 
         [[nodiscard]] bool up() const
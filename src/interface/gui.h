@@ -1,8 +1,12 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
 
 #include <imgui.h>
@@ -12,12 +16,17 @@
 #include <imgui_impl_sdl2.h>
 #include <imgui_stdlib.h>
 
+#include "graphics/blending.h"
+#include "graphics/framebuffer.h"
+#include "graphics/state_cache.h"
+#include "graphics/texture.h"
 #include "interface/window.h"
 #include "macros/finally.h"
 #include "meta/common.h"
 #include "program/errors.h"
 #include "stream/readonly_data.h"
 #include "strings/format.h"
+#include "utils/clock.h"
 #include "utils/poly_storage.h"
 
 namespace Interface
@@ -31,6 +40,18 @@ namespace Interface
             std::string store_state_in_file = "imgui.ini"; // Set to empty string to not store state.
         };
 
+        // Rendering the GUI into a cached texture, to avoid resubmitting big static panels every frame.
+        struct CacheSettings
+        {
+            // If false, the GUI is drawn directly every frame, as usual.
+            // If true, it's drawn into a texture only when it changes, and the texture is drawn every frame.
+            // Requires framebuffer support, otherwise ignored.
+            bool enabled = false;
+            // When the GUI changes without any input (e.g. animated plots), the texture is updated at most this many times per second.
+            // 0 = no limit. The input always updates it immediately.
+            double max_refresh_rate = 0;
+        };
+
         class GraphicsBackend : Meta::with_virtual_destructor<GraphicsBackend>
         {
           public:
@@ -40,6 +61,8 @@ namespace Interface
             virtual void RenderFrame(ImDrawData *data) = 0;
             virtual bool Reload() = 0; // Returns `false` on failure.
         };
+        // The backends change the GL state directly (and call our blending callbacks from the middle of rendering),
+        //   so the state cache is reset after them. See `graphics/state_cache.h`.
 
         class GraphicsBackend_FixedFunction : public GraphicsBackend
         {
@@ -54,16 +77,20 @@ namespace Interface
             }
             void NewFrame() override
             {
-                ImGui_ImplOpenGL2_NewFrame();
+                ImGui_ImplOpenGL2_NewFrame(); // This creates the device objects on the first call.
+                Graphics::StateCache::Invalidate();
             }
             void RenderFrame(ImDrawData *data) override
             {
                 ImGui_ImplOpenGL2_RenderDrawData(data);
+                Graphics::StateCache::Invalidate();
             }
             bool Reload() override
             {
                 ImGui_ImplOpenGL2_DestroyDeviceObjects();
-                return ImGui_ImplOpenGL2_CreateDeviceObjects();
+                bool ok = ImGui_ImplOpenGL2_CreateDeviceObjects();
+                Graphics::StateCache::Invalidate();
+                return ok;
             }
         };
 
@@ -80,16 +107,20 @@ namespace Interface
             }
             void NewFrame() override
             {
-                ImGui_ImplOpenGL3_NewFrame();
+                ImGui_ImplOpenGL3_NewFrame(); // This creates the device objects on the first call.
+                Graphics::StateCache::Invalidate();
             }
             void RenderFrame(ImDrawData *data) override
             {
                 ImGui_ImplOpenGL3_RenderDrawData(data);
+                Graphics::StateCache::Invalidate();
             }
             bool Reload() override
             {
                 ImGui_ImplOpenGL3_DestroyDeviceObjects();
-                return ImGui_ImplOpenGL3_CreateDeviceObjects();
+                bool ok = ImGui_ImplOpenGL3_CreateDeviceObjects();
+                Graphics::StateCache::Invalidate();
+                return ok;
             }
         };
 
@@ -109,9 +140,144 @@ namespace Interface
             std::unique_ptr<std::string> state_file_name;
 
             std::vector<Stream::ReadOnlyData> font_storage;
+
+            CacheSettings cache_settings;
+            #ifdef IMP_HAVE_FRAMEBUFFERS
+            struct Cache
+            {
+                Graphics::TexObject texture;
+                Graphics::FrameBuffer framebuffer;
+                ivec2 size = ivec2(0);
+                std::size_t draw_data_hash = 0;
+                std::uint64_t last_refresh_time = 0; // `Clock::Time()`.
+                bool had_input = true; // ImGui consumed some input since the last refresh.
+                bool used_last_frame = false; // Whether the last frame reused the texture instead of updating it.
+            };
+            Cache cache;
+            #endif
         };
         Data data;
 
+        #ifdef IMP_HAVE_FRAMEBUFFERS
+        // Hashes everything that affects the appearance of the draw data.
+        [[nodiscard]] static std::size_t HashDrawData(const ImDrawData &draw_data)
+        {
+            std::size_t ret = 0;
+            auto Combine = [&](std::string_view bytes)
+            {
+                ret ^= std::hash<std::string_view>{}(bytes) + 0x9e3779b97f4a7c15 + (ret << 6) + (ret >> 2);
+            };
+            auto CombineValue = [&](const auto &value)
+            {
+                Combine(std::string_view(reinterpret_cast<const char *>(&value), sizeof value));
+            };
+
+            CombineValue(draw_data.DisplayPos);
+            CombineValue(draw_data.DisplaySize);
+            CombineValue(draw_data.FramebufferScale);
+            for (const ImDrawList *list : draw_data.CmdLists)
+            {
+                Combine(std::string_view(reinterpret_cast<const char *>(list->VtxBuffer.Data), list->VtxBuffer.size_in_bytes()));
+                Combine(std::string_view(reinterpret_cast<const char *>(list->IdxBuffer.Data), list->IdxBuffer.size_in_bytes()));
+                for (const ImDrawCmd &cmd : list->CmdBuffer)
+                {
+                    // Not hashing the whole struct, because of the padding.
+                    CombineValue(cmd.ClipRect);
+                    CombineValue(cmd.TextureId);
+                    CombineValue(cmd.VtxOffset);
+                    CombineValue(cmd.IdxOffset);
+                    CombineValue(cmd.ElemCount);
+                    CombineValue(cmd.UserCallback);
+                    CombineValue(cmd.UserCallbackData);
+                }
+            }
+            return ret;
+        }
+
+        // Draws the GUI into the cache texture if it changed, then draws the texture. Returns false if the cache can't be used.
+        bool RenderFrameCached(ImDrawData *draw_data)
+        {
+            ivec2 size = iround(fvec2(draw_data->DisplaySize.x * draw_data->FramebufferScale.x, draw_data->DisplaySize.y * draw_data->FramebufferScale.y));
+            if (size.x <= 0 || size.y <= 0)
+                return false;
+
+            Data::Cache &cache = data.cache;
+            cache.used_last_frame = false;
+
+            std::uint64_t now = Clock::Time();
+
+            if (cache.size != size)
+            {
+                cache.texture = nullptr;
+                Graphics::TexUnit unit(cache.texture);
+                unit.SetData(size).Interpolation(Graphics::nearest).Wrap(Graphics::clamp);
+                unit.Detach();
+                cache.framebuffer = Graphics::FrameBuffer(cache.texture);
+                cache.size = size;
+                cache.draw_data_hash = 0;
+                cache.had_input = true;
+            }
+
+            std::size_t hash = HashDrawData(*draw_data);
+            double max_rate = data.cache_settings.max_refresh_rate;
+            bool refresh = hash != cache.draw_data_hash &&
+                (cache.had_input || max_rate <= 0 || now - cache.last_refresh_time >= Clock::SecondsToTicks(1 / max_rate));
+            if (refresh)
+            {
+                GLint old_framebuffer = 0;
+                #ifdef GL_DRAW_FRAMEBUFFER_BINDING
+                glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &old_framebuffer);
+                #else
+                glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_framebuffer);
+                #endif
+                GLfloat old_clear_color[4];
+                glGetFloatv(GL_COLOR_CLEAR_VALUE, old_clear_color);
+
+                cache.framebuffer.Bind();
+                FINALLY{Graphics::FrameBuffer::BindHandle(GLuint(old_framebuffer));};
+
+                glClearColor(0, 0, 0, 0);
+                glClear(GL_COLOR_BUFFER_BIT);
+                glClearColor(old_clear_color[0], old_clear_color[1], old_clear_color[2], old_clear_color[3]);
+
+                // Premultiply the alpha while drawing, so that the texture can then be blended correctly.
+                // The backend sets its own blending mode, so we change it in a callback that runs first.
+                ImDrawList setup_list(ImGui::GetDrawListSharedData());
+                setup_list._ResetForNewFrame();
+                setup_list.AddCallback([](const ImDrawList *, const ImDrawCmd *){Graphics::Blending::FuncNormalSimpleToPre();}, nullptr);
+                ImDrawData cache_draw_data = *draw_data;
+                cache_draw_data.CmdLists.push_front(&setup_list);
+                cache_draw_data.CmdListsCount++;
+                data.graphics_backend->RenderFrame(&cache_draw_data);
+
+                cache.draw_data_hash = hash;
+                cache.last_refresh_time = now;
+                cache.had_input = false;
+            }
+            else
+            {
+                cache.used_last_frame = true;
+            }
+
+            // Draw the texture, with the same backend. The Y axis is flipped, since the texture origin is at the bottom.
+            ImDrawList list(ImGui::GetDrawListSharedData());
+            list._ResetForNewFrame();
+            list.PushClipRect(draw_data->DisplayPos, ImVec2(draw_data->DisplayPos.x + draw_data->DisplaySize.x, draw_data->DisplayPos.y + draw_data->DisplaySize.y));
+            list.AddCallback([](const ImDrawList *, const ImDrawCmd *){Graphics::Blending::FuncNormalPre();}, nullptr);
+            list.AddImage(ImTextureID(std::intptr_t(cache.texture.Handle())), draw_data->DisplayPos,
+                ImVec2(draw_data->DisplayPos.x + draw_data->DisplaySize.x, draw_data->DisplayPos.y + draw_data->DisplaySize.y), ImVec2(0, 1), ImVec2(1, 0));
+            ImDrawData composite_draw_data = *draw_data;
+            composite_draw_data.CmdLists.clear();
+            composite_draw_data.CmdListsCount = 0;
+            composite_draw_data.TotalVtxCount = 0;
+            composite_draw_data.TotalIdxCount = 0;
+            composite_draw_data.AddDrawList(&list);
+            data.graphics_backend->RenderFrame(&composite_draw_data);
+
+            return true;
+        }
+        #endif
+
       public:
         ImGuiController() {}
 
@@ -203,6 +369,10 @@ namespace Interface
                 if (!event_used)
                     return false;
 
+                #ifdef IMP_HAVE_FRAMEBUFFERS
+                data.cache.had_input = true;
+                #endif
+
                 // Discard keyboard events if the keyboard is captured.
                 // Note that we don't discard `SDL_KEYUP` to prevent keys from getting stuck.
                 if (ImGui::GetIO().WantCaptureKeyboard && (event.type == SDL_KEYDOWN || event.type == SDL_TEXTINPUT || event.type == SDL_TEXTEDITING))
@@ -259,10 +429,42 @@ namespace Interface
             if (data.frame_rendered)
             {
                 // Here we don't reset `frame_rendered` back to 0. Its sole purpose is to avoid segfault on the first frame.
-                data.graphics_backend->RenderFrame(ImGui::GetDrawData());
+                ImDrawData *draw_data = ImGui::GetDrawData();
+                if (draw_data->CmdListsCount == 0)
+                    return; // Nothing to draw, e.g. all windows are hidden.
+
+                #ifdef IMP_HAVE_FRAMEBUFFERS
+                if (data.cache_settings.enabled && RenderFrameCached(draw_data))
+                    return;
+                #endif
+                data.graphics_backend->RenderFrame(draw_data);
             }
         }
 
+        // See `CacheSettings` for details.
+        void SetCacheSettings(const CacheSettings &settings)
+        {
+            data.cache_settings = settings;
+            #ifdef IMP_HAVE_FRAMEBUFFERS
+            if (!settings.enabled)
+                data.cache = {}; // Free the texture.
+            #endif
+        }
+        [[nodiscard]] const CacheSettings &GetCacheSettings() const
+        {
+            return data.cache_settings;
+        }
+
+        // Returns true if the last frame was drawn from the cached texture without updating it.
+        [[nodiscard]] bool LastFrameReusedCache() const
+        {
+            #ifdef IMP_HAVE_FRAMEBUFFERS
+            return data.cache.used_last_frame;
+            #else
+            return false;
+            #endif
+        }
+
         // Reload graphics backend.
         // Good for updating font settings.
         // Call this after rendering a frame, but before ticking.
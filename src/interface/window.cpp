@@ -1,10 +1,14 @@
 #include "window.h"
 
+#include <algorithm>
+#include <deque>
+
 #include <cglfl/cglfl.hpp>
 
 #include "macros/finally.h"
 #include "program/platform.h"
 #include "strings/format.h"
+#include "utils/clock.h"
 
 
 // Export some variables to advise video drivers to use the best available video card for the application.
@@ -92,9 +96,19 @@ namespace Interface
         bool keyboard_focus = false, mouse_focus = false;
 
         std::vector<InputData> input;
+        InputState input_state;
+        std::vector<InputEvent> input_events; // Only for the last tick.
 
         std::vector<std::string> dropped_files, dropped_strings;
 
+        struct QueuedEvent
+        {
+            SDL_Event event;
+            uint64_t time = 0; // In `Clock::Time()` units.
+        };
+        std::deque<QueuedEvent> queued_events; // Pumped, but not processed yet.
+        bool os_input_blocked = false;
+
 
         Data() {}
         Data(const Data &) = delete;
@@ -105,6 +119,12 @@ namespace Interface
 
         ~Data()
         {
+            for (QueuedEvent &queued : queued_events)
+            {
+                if ((queued.event.type == SDL_DROPFILE || queued.event.type == SDL_DROPTEXT) && queued.event.drop.file)
+                    SDL_free(queued.event.drop.file);
+            }
+
             if (is_complete)
             {
                 SDL_GL_DeleteContext(context);
@@ -433,21 +453,108 @@ namespace Interface
         return data->mode;
     }
 
-    void Window::ProcessEvents(const std::vector<std::function<bool(SDL_Event &)>> &hooks)
+    // Whether `SetOsInputBlocked()` discards this event.
+    [[nodiscard]] static bool IsUserInputEvent(const SDL_Event &event)
+    {
+        switch (event.type)
+        {
+          case SDL_KEYDOWN:
+          case SDL_KEYUP:
+          case SDL_TEXTEDITING:
+          case SDL_TEXTINPUT:
+          case SDL_MOUSEMOTION:
+          case SDL_MOUSEBUTTONDOWN:
+          case SDL_MOUSEBUTTONUP:
+          case SDL_MOUSEWHEEL:
+          case SDL_DROPFILE:
+          case SDL_DROPTEXT:
+          case SDL_DROPBEGIN:
+          case SDL_DROPCOMPLETE:
+            return true;
+          default:
+            return false;
+        }
+    }
+
+    void Window::PumpEvents()
+    {
+        // SDL timestamps are in milliseconds since the initialization, convert them to our clock.
+        uint64_t now = Clock::Time();
+        uint32_t now_ms = SDL_GetTicks();
+
+        SDL_Event event;
+        while (SDL_PollEvent(&event))
+        {
+            if (data->os_input_blocked && IsUserInputEvent(event))
+            {
+                if ((event.type == SDL_DROPFILE || event.type == SDL_DROPTEXT) && event.drop.file)
+                    SDL_free(event.drop.file);
+                continue;
+            }
+
+            uint32_t age_ms = now_ms - event.common.timestamp; // This wraps around correctly.
+            if (age_ms > 1000) // Something is off, perhaps the timestamp is missing.
+                age_ms = 0;
+            uint64_t time = now - std::min(now, Clock::SecondsToTicks(age_ms / 1000.));
+
+            // Don't let the events go out of order because of the rounding, since we process them in order.
+            if (!data->queued_events.empty())
+                time = std::max(time, data->queued_events.back().time);
+
+            data->queued_events.push_back({.event = event, .time = time});
+        }
+    }
+
+    void Window::QueueEvent(const SDL_Event &event)
+    {
+        uint64_t time = Clock::Time();
+        if (!data->queued_events.empty())
+            time = std::max(time, data->queued_events.back().time);
+        data->queued_events.push_back({.event = event, .time = time});
+    }
+
+    void Window::SetOsInputBlocked(bool blocked)
+    {
+        data->os_input_blocked = blocked;
+    }
+
+    bool Window::OsInputBlocked() const
+    {
+        return data->os_input_blocked;
+    }
+
+    void Window::ProcessEvents(const std::vector<std::function<bool(SDL_Event &)>> &hooks, std::uint64_t until_time)
+    {
+        std::vector<EventHookRef> refs(hooks.begin(), hooks.end());
+        ProcessEvents(refs, until_time);
+    }
+
+    void Window::ProcessEvents(std::span<const EventHookRef> hooks, std::uint64_t until_time)
     {
         data->tick_counter++;
 
         data->text_input.clear();
         data->mouse_movement = ivec2(0);
 
+        data->input_events.clear();
+        data->input_state.prev_down = data->input_state.down;
+        data->input_state.pressed = {};
+        data->input_state.released = {};
+        data->input_state.repeated = {};
+
         data->dropped_files.clear();
         data->dropped_strings.clear();
 
-        SDL_Event event;
-        while (SDL_PollEvent(&event))
+        PumpEvents();
+
+        while (!data->queued_events.empty() && data->queued_events.front().time <= until_time)
         {
+            SDL_Event event = data->queued_events.front().event;
+            uint64_t time = data->queued_events.front().time;
+            data->queued_events.pop_front();
+
             bool drop_event = false;
-            for (auto &hook : hooks)
+            for (const EventHookRef &hook : hooks)
             {
                 if (hook(event))
                 {
@@ -456,7 +563,34 @@ namespace Interface
                 }
             }
             if (drop_event)
+            {
+                if ((event.type == SDL_DROPFILE || event.type == SDL_DROPTEXT) && event.drop.file)
+                    SDL_free(event.drop.file);
                 continue;
+            }
+
+            auto AddInputEvent = [&](Input::Enum button, InputEventKind kind)
+            {
+                data->input_events.push_back({.button = button, .kind = kind, .time = time});
+
+                InputState &state = data->input_state;
+                switch (kind)
+                {
+                  case InputEventKind::press:
+                    InputState::Set(state.pressed, button, true);
+                    InputState::Set(state.repeated, button, true);
+                    if (button < Input::BeginMouseWheel) // The wheel is never down.
+                        InputState::Set(state.down, button, true);
+                    break;
+                  case InputEventKind::release:
+                    InputState::Set(state.released, button, true);
+                    InputState::Set(state.down, button, false);
+                    break;
+                  case InputEventKind::repeat:
+                    InputState::Set(state.repeated, button, true);
+                    break;
+                }
+            };
 
             switch (event.type)
             {
@@ -472,9 +606,14 @@ namespace Interface
                     auto &elem = data->input[Input::BeginKeys + index];
                     elem.repeat = data->tick_counter;
                     if (event.key.repeat)
+                    {
+                        AddInputEvent(Input::Enum(Input::BeginKeys + index), InputEventKind::repeat);
                         break;
+                    }
                     elem.press = data->tick_counter;
+                    elem.press_time = time;
                     elem.is_down = true;
+                    AddInputEvent(Input::Enum(Input::BeginKeys + index), InputEventKind::press);
                 }
                 break;
               case SDL_KEYUP:
@@ -486,7 +625,9 @@ namespace Interface
                         break;
                     auto &elem = data->input[Input::BeginKeys + index];
                     elem.release = data->tick_counter;
+                    elem.release_time = time;
                     elem.is_down = false;
+                    AddInputEvent(Input::Enum(Input::BeginKeys + index), InputEventKind::release);
                 }
                 break;
 
@@ -497,8 +638,10 @@ namespace Interface
                         break;
                     auto &elem = data->input[Input::BeginMouseButtons + index];
                     elem.press = data->tick_counter;
+                    elem.press_time = time;
                     elem.repeat = data->tick_counter;
                     elem.is_down = true;
+                    AddInputEvent(Input::Enum(Input::BeginMouseButtons + index), InputEventKind::press);
                 }
                 break;
               case SDL_MOUSEBUTTONUP:
@@ -508,7 +651,9 @@ namespace Interface
                         break;
                     auto &elem = data->input[Input::BeginMouseButtons + index];
                     elem.release = data->tick_counter;
+                    elem.release_time = time;
                     elem.is_down = false;
+                    AddInputEvent(Input::Enum(Input::BeginMouseButtons + index), InputEventKind::release);
                 }
                 break;
 
@@ -524,6 +669,10 @@ namespace Interface
                     data->input[wheel_enum].press = data->tick_counter;
                     data->input[wheel_enum].release = data->tick_counter;
                     data->input[wheel_enum].repeat = data->tick_counter;
+                    data->input[wheel_enum].press_time = time;
+                    data->input[wheel_enum].release_time = time;
+                    AddInputEvent(wheel_enum, InputEventKind::press);
+                    AddInputEvent(wheel_enum, InputEventKind::release);
                 }
                 break;
 
@@ -617,6 +766,16 @@ namespace Interface
         return data->input[index];
     }
 
+    const Window::InputState &Window::GetInputState() const
+    {
+        return data->input_state;
+    }
+
+    std::span<const Window::InputEvent> Window::InputEvents() const
+    {
+        return data->input_events;
+    }
+
     ivec2 Window::MousePos() const
     {
         return data->mouse_pos;
@@ -1,8 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <initializer_list>
 #include <memory>
+#include <span>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -57,6 +65,28 @@ namespace Interface
         int depth_bits = 0, stencil_bits = 0; // Same.
     };
 
+    // A non-owning reference to an event hook, for `Window::ProcessEvents()`.
+    // A hook returns true to discard the event. Unlike `std::function`, this never allocates and is cheap to call.
+    // The referenced callable must outlive the reference, so only use these as function parameters.
+    class EventHookRef
+    {
+        void *object = nullptr;
+        bool (*func)(void *, SDL_Event &) = nullptr;
+
+      public:
+        template <typename F>
+        requires (!std::is_same_v<std::remove_cvref_t<F>, EventHookRef>) && std::is_object_v<std::remove_reference_t<F>> && std::is_invocable_r_v<bool, F &, SDL_Event &>
+        EventHookRef(F &&hook)
+            : object(const_cast<void *>(static_cast<const void *>(std::addressof(hook)))),
+            func([](void *object, SDL_Event &event) -> bool {return std::invoke(*static_cast<std::remove_reference_t<F> *>(object), event);})
+        {}
+
+        bool operator()(SDL_Event &event) const
+        {
+            return func(object, event);
+        }
+    };
+
     // A window class.
     // It's reference-counted, but only one actual window can exist at a time.
     class Window
@@ -108,9 +138,33 @@ namespace Interface
         void SetMode(FullscreenMode new_mode);
         [[nodiscard]] FullscreenMode Mode() const;
 
-        // Processes events, increments the tick counter.
+        // Moves the pending OS events into an internal queue, remembering when each one happened. Doesn't process them.
+        // `ProcessEvents()` calls this automatically, but calling it more often (e.g. between the ticks, or while waiting for the next frame)
+        //   makes the event timestamps more precise, since SDL only records them with millisecond precision.
+        // Like the rest of the event handling, this must be called on the main thread. (SDL can't pump the events on any other thread,
+        //   so this is what we have instead of a dedicated input thread.)
+        void PumpEvents();
+
+        // Processes the queued events, increments the tick counter.
+        // Only processes the events that happened no later than `until_time` (in `Clock::Time()` units), the rest are left for the following ticks.
+        //   When running several ticks per frame, pass the time each tick corresponds to, so that the input is spread over them
+        //   in the same way it arrived, instead of all arriving on the first tick.
         // If hooks are specified, applies them in order to each event. If a hook returns true, the current event is discarded.
-        void ProcessEvents(const std::vector<std::function<bool(SDL_Event &)>> &hooks = {});
+        void ProcessEvents(std::span<const EventHookRef> hooks, std::uint64_t until_time = -1);
+        void ProcessEvents(std::initializer_list<EventHookRef> hooks = {}, std::uint64_t until_time = -1)
+        {
+            ProcessEvents(std::span(hooks.begin(), hooks.size()), until_time);
+        }
+        // This one is slower, prefer the overloads above.
+        void ProcessEvents(const std::vector<std::function<bool(SDL_Event &)>> &hooks, std::uint64_t until_time = -1);
+
+        // Adds an event to the queue, as if it came from the OS right now. `ProcessEvents()` takes ownership of `event.drop.file`, if any.
+        // `Program::InputReplay` uses this to play back the recorded input.
+        void QueueEvent(const SDL_Event &event);
+        // If enabled, `PumpEvents()` discards the user input from the OS (keyboard, mouse, text input, drag and drop),
+        //   but still keeps the window events and the quit requests. `QueueEvent()` is not affected.
+        void SetOsInputBlocked(bool blocked);
+        [[nodiscard]] bool OsInputBlocked() const;
 
         // Updates the picture on the screen, increments the frame counter.
         void SwapBuffers();
@@ -136,14 +190,110 @@ namespace Interface
         struct InputData
         {
             uint64_t press = 0, release = 0, repeat = 0;
+            // The same, but in `Clock::Time()` units, when the events actually happened.
+            uint64_t press_time = 0, release_time = 0;
             // This can't be deduced from the timing alone, since multiple press and release events can arrive at the same tick.
             bool is_down = false;
         };
         // Returns the information about a specific button.
         // The values represent the last time points when a specific action happened to the button.
-        // They are taken from the `Ticks()` counter.
+        // They are taken from the `Ticks()` counter, except for `..._time`.
         [[nodiscard]] InputData GetInputData(Input::Enum index) const;
 
+        // The state of all buttons as packed bitsets, indexed by `Input::Enum`.
+        // This is faster than calling `GetInputData()` for each button, and lets you check many buttons at once.
+        struct InputState
+        {
+            static constexpr std::size_t num_words = (Input::IndexCount + 63) / 64;
+            using Bits = std::array<std::uint64_t, num_words>;
+
+            Bits down{};
+            Bits prev_down{}; // `down` at the end of the previous tick.
+            // Those are reset every tick. Unlike comparing `down` with `prev_down`, they catch the presses and releases within a single tick.
+            Bits pressed{}, released{}, repeated{};
+
+            [[nodiscard]] static bool Test(const Bits &bits, Input::Enum index)
+            {
+                return std::size_t(index) < Input::IndexCount && (bits[index / 64] >> (index % 64) & 1);
+            }
+            static void Set(Bits &bits, Input::Enum index, bool value)
+            {
+                if (std::size_t(index) >= Input::IndexCount)
+                    return;
+                std::uint64_t mask = std::uint64_t(1) << (index % 64);
+                if (value)
+                    bits[index / 64] |= mask;
+                else
+                    bits[index / 64] &= ~mask;
+            }
+
+            [[nodiscard]] bool IsDown    (Input::Enum index) const {return Test(down,     index);}
+            [[nodiscard]] bool WasDown   (Input::Enum index) const {return Test(prev_down, index);}
+            [[nodiscard]] bool IsPressed (Input::Enum index) const {return Test(pressed,  index);}
+            [[nodiscard]] bool IsReleased(Input::Enum index) const {return Test(released, index);}
+            [[nodiscard]] bool IsRepeated(Input::Enum index) const {return Test(repeated, index);}
+
+            // A mask with the bits in `[begin, end)` set.
+            [[nodiscard]] static Bits RangeMask(Input::Enum begin, Input::Enum end)
+            {
+                Bits ret{};
+                for (std::size_t i = 0; i < num_words; i++)
+                {
+                    std::size_t word_begin = i * 64;
+                    std::size_t a = std::clamp(std::size_t(begin), word_begin, word_begin + 64) - word_begin;
+                    std::size_t b = std::clamp(std::size_t(end), word_begin, word_begin + 64) - word_begin;
+                    if (a < b)
+                        ret[i] = (b - a == 64 ? ~std::uint64_t(0) : ((std::uint64_t(1) << (b - a)) - 1) << a);
+                }
+                return ret;
+            }
+
+            // Returns true if `bits & mask` is not empty.
+            [[nodiscard]] static bool Any(const Bits &bits, const Bits &mask)
+            {
+                std::uint64_t ret = 0;
+                for (std::size_t i = 0; i < num_words; i++)
+                    ret |= bits[i] & mask[i];
+                return ret != 0;
+            }
+            // Returns the first index set in `bits & mask`, or `Input::None` if none.
+            [[nodiscard]] static Input::Enum First(const Bits &bits, const Bits &mask)
+            {
+                for (std::size_t i = 0; i < num_words; i++)
+                {
+                    if (std::uint64_t word = bits[i] & mask[i])
+                        return Input::Enum(i * 64 + std::size_t(std::countr_zero(word)));
+                }
+                return Input::None;
+            }
+
+            [[nodiscard]] bool AnyPressed() const
+            {
+                return Any(pressed, RangeMask(Input::BeginKeys, Input::IndexCount));
+            }
+            [[nodiscard]] bool AnyPressed(Input::Enum begin, Input::Enum end) const
+            {
+                return Any(pressed, RangeMask(begin, end));
+            }
+            [[nodiscard]] bool AnyDown(Input::Enum begin, Input::Enum end) const
+            {
+                return Any(down, RangeMask(begin, end));
+            }
+        };
+        // The bitsets are updated by `ProcessEvents()`.
+        [[nodiscard]] const InputState &GetInputState() const;
+
+        enum class InputEventKind {press, release, repeat};
+        struct InputEvent
+        {
+            Input::Enum button = Input::None;
+            InputEventKind kind = InputEventKind::press;
+            uint64_t time = 0; // In `Clock::Time()` units.
+        };
+        // All button events processed during the last tick, in order.
+        // Use this when it matters exactly when a button was pressed, or when it was pressed several times during one tick.
+        [[nodiscard]] std::span<const InputEvent> InputEvents() const;
+
         // Returns mouse position.
         [[nodiscard]] ivec2 MousePos() const;
         // Returns the change in mouse position since the last tick.
@@ -0,0 +1,50 @@
+#include "fast_math.h"
+
+#include <cstddef>
+
+#include "program/errors.h"
+
+namespace Math2
+{
+    namespace
+    {
+        void Bulk(std::span<const float> in, std::span<float> out, auto func)
+        {
+            ASSERT(in.size() == out.size(), "Span size mismatch.");
+            for (std::size_t i = 0; i < in.size(); i++)
+                out[i] = func(in[i]);
+        }
+    }
+
+    void FastSin(std::span<const float> in, std::span<float> out)
+    {
+        Bulk(in, out, impl::FastSinScalar);
+    }
+
+    void FastCos(std::span<const float> in, std::span<float> out)
+    {
+        Bulk(in, out, impl::FastCosScalar);
+    }
+
+    void FastRsqrt(std::span<const float> in, std::span<float> out)
+    {
+        Bulk(in, out, impl::FastRsqrtScalar);
+    }
+
+    void FastSqrt(std::span<const float> in, std::span<float> out)
+    {
+        Bulk(in, out, [](float x){return x * impl::FastRsqrtScalar(x);});
+    }
+
+    void FastExp(std::span<const float> in, std::span<float> out)
+    {
+        Bulk(in, out, impl::FastExpScalar);
+    }
+
+    void FastAtan2(std::span<const float> y, std::span<const float> x, std::span<float> out)
+    {
+        ASSERT(y.size() == out.size() && x.size() == out.size(), "Span size mismatch.");
+        for (std::size_t i = 0; i < out.size(); i++)
+            out[i] = impl::FastAtan2Scalar(y[i], x[i]);
+    }
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "utils/mat.h"
+
+#include <bit>
+#include <cstdint>
+#include <span>
+
+// Fast approximations of some transcendental functions, for `float`, for the cases where the full precision isn't needed.
+// They accept scalars and vectors, and there are also span overloads (`out[i] = f(in[i])`) that vectorize well.
+// Unlike the `std` functions, those are branch-free and never set `errno`, which is what allows the vectorization.
+// The error bounds below were measured over the whole documented input ranges.
+//
+//   Function     Max error                       Valid input range
+//   FastSin/Cos  1e-7 absolute                   |x| <= 1e4 (the error grows with |x| after that, due to the range reduction)
+//   FastAtan2    2e-6 absolute (radians)         Any, except (0,0), which returns 0.
+//   FastRsqrt    7e-4 relative                   Positive normal numbers.
+//   FastSqrt     7e-4 relative                   Zero and positive normal numbers.
+//   FastExp      4e-6 relative                   -87 <= x <= 88 (clamped outside of it, so no infinities or denormals).
+//                                                  (Mostly from rounding `x * log2(e)`, it's about 3e-7 for |x| <= 1.)
+//
+// NaNs and infinities are not supported (the results are unspecified).
+
+namespace Math2
+{
+    namespace impl
+    {
+        // The functions below avoid the conditional operator in favor of bit manipulation, otherwise GCC refuses to vectorize the loops.
+
+        // `cond ? a : b`.
+        [[nodiscard]] constexpr float FastSelect(bool cond, float a, float b)
+        {
+            std::uint32_t mask = -std::uint32_t(cond);
+            return std::bit_cast<float>((std::bit_cast<std::uint32_t>(a) & mask) | (std::bit_cast<std::uint32_t>(b) & ~mask));
+        }
+
+        // Rounds to the nearest integer, for `|x| < 2^22`.
+        [[nodiscard]] constexpr float FastRound(float x)
+        {
+            constexpr float magic = 12582912; // 1.5 * 2^23
+            return x + magic - magic;
+        }
+
+        // `sin(x)` if `quadrant_offset == 0`, or `cos(x)` if it's 1.
+        [[nodiscard]] constexpr float FastSinCos(float x, int quadrant_offset)
+        {
+            // Reduce to `-pi/4..pi/4`. The pi/2 is split in three parts, the first two are exact when multiplied by `q` (Cody-Waite).
+            float q = FastRound(x * 0.63661977236f);
+            float r = x - q * 1.5703125f - q * 4.837512969970703125e-4f - q * 7.54978995489188216e-8f;
+            std::uint32_t quadrant = std::uint32_t(int(q) + quadrant_offset);
+
+            // Minimax polynomials, from Cephes.
+            float r2 = r * r;
+            float s = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+            float c = 1 - r2 * 0.5f + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+            float ret = FastSelect(quadrant & 1, c, s);
+            return std::bit_cast<float>(std::bit_cast<std::uint32_t>(ret) ^ (quadrant & 2) << 30);
+        }
+
+        [[nodiscard]] constexpr float FastSinScalar(float x)
+        {
+            return FastSinCos(x, 0);
+        }
+
+        [[nodiscard]] constexpr float FastCosScalar(float x)
+        {
+            // Shifting the quadrant instead of adding pi/2 to the argument, to not lose precision.
+            return FastSinCos(x, 1);
+        }
+
+        [[nodiscard]] constexpr float FastAtan2Scalar(float y, float x)
+        {
+            std::uint32_t sign_x = std::bit_cast<std::uint32_t>(x) & 0x80000000;
+            std::uint32_t sign_y = std::bit_cast<std::uint32_t>(y) & 0x80000000;
+            float abs_x = std::bit_cast<float>(std::bit_cast<std::uint32_t>(x) ^ sign_x);
+            float abs_y = std::bit_cast<float>(std::bit_cast<std::uint32_t>(y) ^ sign_y);
+            bool swap = abs_y > abs_x;
+            float max_xy = FastSelect(swap, abs_y, abs_x);
+            float min_xy = FastSelect(swap, abs_x, abs_y);
+            // Avoid dividing by zero, the result is 0 for `(0,0)` anyway.
+            float z = min_xy / FastSelect(max_xy == 0, 1, max_xy);
+
+            // A minimax polynomial for `atan(z)` on `0..1`.
+            float z2 = z * z;
+            float ret = z * (0.99997726f + z2 * (-0.33262347f + z2 * (0.19354346f + z2 * (-0.11643287f + z2 * (0.05265332f + z2 * -0.01172120f)))));
+
+            ret = FastSelect(swap, 1.57079632679f - ret, ret);
+            ret = FastSelect(sign_x, 3.14159265359f - ret, ret);
+            return std::bit_cast<float>(std::bit_cast<std::uint32_t>(ret) ^ sign_y);
+        }
+
+        [[nodiscard]] constexpr float FastRsqrtScalar(float x)
+        {
+            // The bit trick, with the improved constants by Jan Kadlec, followed by one Newton iteration.
+            float y = std::bit_cast<float>(0x5f1ffff9 - (std::bit_cast<std::uint32_t>(x) >> 1));
+            return y * 0.703952253f * (2.38924456f - x * y * y);
+        }
+
+        [[nodiscard]] constexpr float FastExpScalar(float x)
+        {
+            x = FastSelect(x < -87, -87, x);
+            x = FastSelect(x > 88, 88, x);
+
+            // `exp(x) = 2^n * 2^f`, where `n` is integral and `f` is in `-0.5..0.5`.
+            float t = x * 1.44269504089f;
+            float n = FastRound(t);
+            float f = t - n;
+
+            // A minimax polynomial for `2^f`, from Cephes.
+            float p = 1 + f * (6.931472028550421e-1f + f * (2.402264791363012e-1f + f * (5.550332471162809e-2f + f * (9.618437357674640e-3f + f * (1.339887440266574e-3f + f * 1.535336188319500e-4f)))));
+            return p * std::bit_cast<float>(std::uint32_t(int(n) + 127) << 23);
+        }
+    }
+
+    template <Math::vector_or_scalar_with_base<float> T>
+    [[nodiscard]] constexpr T FastSin(T x)
+    {
+        return Math::apply_elementwise(impl::FastSinScalar, x);
+    }
+    template <Math::vector_or_scalar_with_base<float> T>
+    [[nodiscard]] constexpr T FastCos(T x)
+    {
+        return Math::apply_elementwise(impl::FastCosScalar, x);
+    }
+    template <Math::vector_or_scalar_with_base<float> T>
+    [[nodiscard]] constexpr T FastAtan2(T y, T x)
+    {
+        return Math::apply_elementwise(impl::FastAtan2Scalar, y, x);
+    }
+    template <Math::vector_or_scalar_with_base<float> T>
+    [[nodiscard]] constexpr T FastRsqrt(T x)
+    {
+        return Math::apply_elementwise(impl::FastRsqrtScalar, x);
+    }
+    template <Math::vector_or_scalar_with_base<float> T>
+    [[nodiscard]] constexpr T FastSqrt(T x)
+    {
+        // `x * rsqrt(x)` conveniently returns 0 for 0, since the bit trick gives a finite value for it.
+        return x * FastRsqrt(x);
+    }
+    template <Math::vector_or_scalar_with_base<float> T>
+    [[nodiscard]] constexpr T FastExp(T x)
+    {
+        return Math::apply_elementwise(impl::FastExpScalar, x);
+    }
+    // The angle of the vector, like `vec.angle()`.
+    [[nodiscard]] constexpr float FastAngle(fvec2 v)
+    {
+        return impl::FastAtan2Scalar(v.y, v.x);
+    }
+
+    // Bulk versions. `out` must have the same size as `in`, and can be the same span.
+    // Those are defined in the `.cpp` file, because GCC only vectorizes the loops reliably when they're not inlined into bigger functions.
+    void FastSin(std::span<const float> in, std::span<float> out);
+    void FastCos(std::span<const float> in, std::span<float> out);
+    void FastRsqrt(std::span<const float> in, std::span<float> out);
+    void FastSqrt(std::span<const float> in, std::span<float> out);
+    void FastExp(std::span<const float> in, std::span<float> out);
+    void FastAtan2(std::span<const float> y, std::span<const float> x, std::span<float> out);
+}
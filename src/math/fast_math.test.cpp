@@ -0,0 +1,57 @@
+#include "fast_math.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("math.fast_math")
+{
+    // Check the error bounds documented in the header.
+    // Comparing with the exact values computed in `double`.
+    double err_sin = 0, err_cos = 0, err_atan2 = 0, err_rsqrt = 0, err_exp = 0;
+    for (int i = -100000; i <= 100000; i++)
+    {
+        float x = i * 0.1f;
+        err_sin = std::max(err_sin, std::abs(Math2::FastSin(x) - std::sin(double(x))));
+        err_cos = std::max(err_cos, std::abs(Math2::FastCos(x) - std::cos(double(x))));
+
+        float y = (i % 1000) * 0.37f;
+        err_atan2 = std::max(err_atan2, std::abs(Math2::FastAtan2(y, x) - std::atan2(double(y), double(x))));
+
+        float pos = std::abs(x) + 1e-4f;
+        err_rsqrt = std::max(err_rsqrt, std::abs(Math2::FastRsqrt(pos) * std::sqrt(double(pos)) - 1));
+
+        float e = i * 0.00087f;
+        err_exp = std::max(err_exp, std::abs(Math2::FastExp(e) / std::exp(double(e)) - 1));
+    }
+    CHECK(err_sin < 1e-7);
+    CHECK(err_cos < 1e-7);
+    CHECK(err_atan2 < 2e-6);
+    CHECK(err_rsqrt < 7e-4);
+    CHECK(err_exp < 4e-6);
+
+    // Special cases.
+    CHECK(Math2::FastSqrt(0.f) == 0);
+    CHECK(Math2::FastAtan2(0.f, 0.f) == 0);
+    CHECK(Math2::FastAtan2(0.f, -1.f) == doctest::Approx(3.14159265f));
+    CHECK(Math2::FastAtan2(-1.f, 0.f) == doctest::Approx(-1.57079632f));
+    CHECK(Math2::FastExp(-1000.f) > 0);
+    CHECK(std::isfinite(Math2::FastExp(1000.f)));
+
+    // Vectors.
+    CHECK(Math2::FastSin(fvec2(0, 1.5707963f)) == fvec2(0, 1));
+    CHECK(Math2::FastAngle(fvec2(1, 1)) == doctest::Approx(0.78539816f));
+
+    // Spans, including in-place.
+    std::vector<float> in = {-3, -0.5f, 0, 0.25f, 2, 7}, out(in.size());
+    Math2::FastExp(in, out);
+    for (std::size_t i = 0; i < in.size(); i++)
+        CHECK(out[i] == Math2::FastExp(in[i]));
+    Math2::FastSin(out, out);
+    for (std::size_t i = 0; i < in.size(); i++)
+        CHECK(out[i] == Math2::FastSin(Math2::FastExp(in[i])));
+    Math2::FastAtan2(in, out, out);
+    CHECK(out[2] == 0);
+}
@@ -0,0 +1,358 @@
+#pragma once
+
+#include "utils/mat.h"
+
+#include <array>
+#include <cmath>
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+
+// Fixed-point numbers, for deterministic simulation (e.g. for lockstep networking).
+// Unlike `float`, all operations here (including `sqrt()` and the trigonometry) give bit-identical results
+//   on every platform, regardless of the compiler flags, because they only use integer arithmetic.
+// `fixed16` is 16.16 stored in `int32_t`, `fixed32` is 32.32 stored in `int64_t`.
+// They can be used as the element types of `vec`, `rect` and `mat`, and mix with integers (but not with floating-point types) in the vector operations.
+// How to use:
+//     vec2<fixed16> pos(1, 2), vel = vec2<fixed16>(fixed16(0.5), 0);
+//     pos += vel * 3;
+//     fixed16 dist = sqrt(pos.len_sq());
+// The conversions from floating-point types are explicit, and are deterministic too (they are exact or correctly rounded).
+// The conversions to floating-point types are for debugging and rendering only, don't feed them back into the simulation.
+//
+// Overflow wraps around. Multiplication rounds down, division rounds towards zero (like for integers). Division by zero is UB.
+
+namespace Math2
+{
+    namespace impl
+    {
+        __extension__ using int128 = __int128;
+        __extension__ using uint128 = unsigned __int128;
+
+        // The integer type twice as large as `I`, for intermediate results.
+        template <typename I> struct FixedWide {};
+        template <> struct FixedWide<std::int32_t> {using type = std::int64_t; using unsigned_type = std::uint64_t;};
+        template <> struct FixedWide<std::int64_t> {using type = int128; using unsigned_type = uint128;};
+    }
+
+    // `FracBits` is the number of fractional bits.
+    template <std::signed_integral I, int FracBits>
+    requires (FracBits > 0 && FracBits < std::numeric_limits<I>::digits)
+    class Fixed
+    {
+      public:
+        using raw_type = I;
+        using wide_type = typename impl::FixedWide<I>::type;
+        using wide_unsigned_type = typename impl::FixedWide<I>::unsigned_type;
+        static constexpr int frac_bits = FracBits;
+        static constexpr raw_type one_raw = raw_type(1) << FracBits;
+
+        // The underlying integer, the value multiplied by `2^FracBits`.
+        raw_type raw = 0;
+
+        constexpr Fixed() {}
+
+        template <std::integral T>
+        constexpr Fixed(T value) : raw(raw_type(std::make_unsigned_t<raw_type>(value) << FracBits)) {}
+
+        // Rounds to the nearest representable value.
+        template <std::floating_point T>
+        explicit constexpr Fixed(T value) : raw(raw_type(std::round(value * T(one_raw)))) {}
+
+        [[nodiscard]] static constexpr Fixed FromRaw(raw_type raw)
+        {
+            Fixed ret;
+            ret.raw = raw;
+            return ret;
+        }
+
+        // Rounds down.
+        template <std::integral T> requires (!std::same_as<T, bool>)
+        [[nodiscard]] explicit constexpr operator T() const {return T(raw >> FracBits);}
+
+        template <std::floating_point T>
+        [[nodiscard]] explicit constexpr operator T() const {return T(raw) / T(one_raw);}
+
+        [[nodiscard]] explicit constexpr operator bool() const {return raw != 0;}
+
+        [[nodiscard]] friend constexpr bool operator==(Fixed, Fixed) = default;
+        [[nodiscard]] friend constexpr std::strong_ordering operator<=>(Fixed, Fixed) = default;
+
+        [[nodiscard]] constexpr Fixed operator+() const {return *this;}
+        [[nodiscard]] constexpr Fixed operator-() const {return FromRaw(raw_type(-std::make_unsigned_t<raw_type>(raw)));}
+
+        [[nodiscard]] friend constexpr Fixed operator+(Fixed a, Fixed b) {return FromRaw(raw_type(std::make_unsigned_t<raw_type>(a.raw) + std::make_unsigned_t<raw_type>(b.raw)));}
+        [[nodiscard]] friend constexpr Fixed operator-(Fixed a, Fixed b) {return FromRaw(raw_type(std::make_unsigned_t<raw_type>(a.raw) - std::make_unsigned_t<raw_type>(b.raw)));}
+        [[nodiscard]] friend constexpr Fixed operator*(Fixed a, Fixed b) {return FromRaw(raw_type(wide_type(a.raw) * b.raw >> FracBits));}
+        [[nodiscard]] friend constexpr Fixed operator/(Fixed a, Fixed b) {return FromRaw(raw_type((wide_type(a.raw) << FracBits) / b.raw));}
+
+        constexpr Fixed &operator+=(Fixed other) {return *this = *this + other;}
+        constexpr Fixed &operator-=(Fixed other) {return *this = *this - other;}
+        constexpr Fixed &operator*=(Fixed other) {return *this = *this * other;}
+        constexpr Fixed &operator/=(Fixed other) {return *this = *this / other;}
+
+        template <typename A, typename B>
+        friend std::basic_ostream<A, B> &operator<<(std::basic_ostream<A, B> &s, Fixed value)
+        {
+            return s << double(value);
+        }
+
+        // Some constants, see below for the definitions.
+        static const Fixed pi, half_pi, two_pi;
+    };
+
+    using fixed16 = Fixed<std::int32_t, 16>;
+    using fixed32 = Fixed<std::int64_t, 32>;
+
+    template <typename T> struct helper_is_fixed : std::false_type {};
+    template <std::signed_integral I, int FracBits> struct helper_is_fixed<Fixed<I, FracBits>> : std::true_type {};
+    template <typename T> concept fixed_point_scalar = helper_is_fixed<T>::value;
+
+    namespace impl
+    {
+        // The tables below are computed at compile time using only the basic floating-point operations (which are always correctly rounded),
+        //   so they are the same on all platforms. The values are in the 32.32 format.
+
+        inline constexpr int fixed_sin_table_bits = 10;
+        inline constexpr int fixed_atan_table_bits = 10;
+
+        [[nodiscard]] constexpr std::int64_t RoundToQ32(double value)
+        {
+            value *= 4294967296.0;
+            std::int64_t ret = std::int64_t(value);
+            if (value - double(ret) >= 0.5)
+                ret++;
+            return ret;
+        }
+
+        // `pi * 2^32`.
+        inline constexpr std::int64_t fixed_pi_q32 = 13493037705;
+
+        // `sin(i / N * pi/2)` for `i` in `0..N`.
+        inline constexpr auto fixed_sin_table = []{
+            constexpr int n = 1 << fixed_sin_table_bits;
+            std::array<std::int64_t, n + 1> ret{};
+            for (int i = 0; i <= n; i++)
+            {
+                // Taylor series. The argument is at most `pi/2`, so 15 terms are more than enough.
+                double x = 1.5707963267948966 * i / n, term = x, sum = 0;
+                for (int k = 1; k < 30; k += 2)
+                {
+                    sum += term;
+                    term *= -x * x / ((k + 1) * (k + 2));
+                }
+                ret[i] = RoundToQ32(sum);
+            }
+            return ret;
+        }();
+
+        // `atan(i / N)` for `i` in `0..N`.
+        inline constexpr auto fixed_atan_table = []{
+            constexpr int n = 1 << fixed_atan_table_bits;
+            std::array<std::int64_t, n + 1> ret{};
+            for (int i = 0; i <= n; i++)
+            {
+                // Euler's series: `atan(x) = sum[k] (2^2k (k!)^2 / (2k+1)!) * x^(2k+1) / (1+x^2)^(k+1)`. The ratio of the terms is at most 1/2.
+                double x = double(i) / n, y = x * x / (1 + x * x), term = x / (1 + x * x), sum = 0;
+                for (int k = 0; k < 80; k++)
+                {
+                    sum += term;
+                    term *= y * (2 * k + 2) / (2 * k + 3);
+                }
+                ret[i] = RoundToQ32(sum);
+            }
+            return ret;
+        }();
+
+        // Linear interpolation in one of the tables above. `pos` is in `0..2^(Bits+20)`.
+        template <std::size_t N>
+        [[nodiscard]] constexpr std::int64_t LerpTable(const std::array<std::int64_t, N> &table, std::uint32_t pos)
+        {
+            std::uint32_t index = pos >> 20;
+            std::int64_t frac = pos & ((1 << 20) - 1);
+            if (index == N - 1)
+                return table[index];
+            return table[index] + ((table[index + 1] - table[index]) * frac >> 20);
+        }
+
+        // Converts a 32.32 value to `T`, rounding to nearest (half away from zero), so that the results are symmetric around zero.
+        template <fixed_point_scalar T>
+        [[nodiscard]] constexpr T FromQ32(std::int64_t value)
+        {
+            static_assert(T::frac_bits <= 32, "Trigonometry is only implemented for at most 32 fractional bits.");
+            constexpr int shift = 32 - T::frac_bits;
+            std::int64_t magnitude = value < 0 ? -value : value;
+            if constexpr (shift > 0)
+                magnitude = (magnitude + (std::int64_t(1) << (shift - 1))) >> shift;
+            T ret = T::FromRaw(typename T::raw_type(magnitude));
+            return value < 0 ? -ret : ret;
+        }
+
+        // `sin(2pi * phase / 2^32)`, in 32.32.
+        [[nodiscard]] constexpr std::int64_t SinOfPhase(std::uint32_t phase)
+        {
+            constexpr std::uint32_t quarter = std::uint32_t(1) << 30;
+            std::uint32_t pos = phase & (quarter - 1);
+            if (phase & quarter)
+                pos = quarter - pos;
+            std::int64_t ret = LerpTable(fixed_sin_table, pos);
+            return phase & (quarter << 1) ? -ret : ret;
+        }
+
+        // Converts an angle in radians to a fraction of the full turn, multiplied by `2^32`, modulo `2^32`.
+        template <fixed_point_scalar T>
+        [[nodiscard]] constexpr std::uint32_t AngleToPhase(T angle)
+        {
+            // `2^64 / 2pi`.
+            constexpr int128 inv_two_pi_q64 = 2935890503282001226;
+            return std::uint32_t(uint128(int128(angle.raw) * inv_two_pi_q64 >> (T::frac_bits + 32)));
+        }
+    }
+
+    template <std::signed_integral I, int FracBits> requires (FracBits > 0 && FracBits < std::numeric_limits<I>::digits)
+    constexpr Fixed<I, FracBits> Fixed<I, FracBits>::pi = impl::FromQ32<Fixed<I, FracBits>>(impl::fixed_pi_q32);
+    template <std::signed_integral I, int FracBits> requires (FracBits > 0 && FracBits < std::numeric_limits<I>::digits)
+    constexpr Fixed<I, FracBits> Fixed<I, FracBits>::half_pi = impl::FromQ32<Fixed<I, FracBits>>(impl::fixed_pi_q32 / 2);
+    template <std::signed_integral I, int FracBits> requires (FracBits > 0 && FracBits < std::numeric_limits<I>::digits)
+    constexpr Fixed<I, FracBits> Fixed<I, FracBits>::two_pi = impl::FromQ32<Fixed<I, FracBits>>(impl::fixed_pi_q32 * 2);
+
+    template <fixed_point_scalar T>
+    [[nodiscard]] constexpr T abs(T value)
+    {
+        return value.raw < 0 ? -value : value;
+    }
+
+    template <fixed_point_scalar T>
+    [[nodiscard]] constexpr T floor(T value)
+    {
+        return T::FromRaw(value.raw & ~(T::one_raw - 1));
+    }
+
+    template <fixed_point_scalar T>
+    [[nodiscard]] constexpr T ceil(T value)
+    {
+        return -floor(-value);
+    }
+
+    // Rounds half up.
+    template <fixed_point_scalar T>
+    [[nodiscard]] constexpr T round(T value)
+    {
+        return floor(value + T::FromRaw(T::one_raw / 2));
+    }
+
+    // Returns 0 for negative values. The result is rounded down.
+    template <fixed_point_scalar T>
+    [[nodiscard]] constexpr T sqrt(T value)
+    {
+        if (value.raw <= 0)
+            return T{};
+
+        // The square root of `raw * 2^FracBits`, bit by bit.
+        using U = typename T::wide_unsigned_type;
+        U x = U(value.raw) << T::frac_bits;
+        U ret = 0;
+        U bit = U(1) << (std::numeric_limits<U>::digits - 2);
+        while (bit > x)
+            bit >>= 2;
+        while (bit != 0)
+        {
+            if (x >= ret + bit)
+            {
+                x -= ret + bit;
+                ret = (ret >> 1) + bit;
+            }
+            else
+            {
+                ret >>= 1;
+            }
+            bit >>= 2;
+        }
+        return T::FromRaw(typename T::raw_type(ret));
+    }
+
+    // The trigonometric functions use lookup tables with linear interpolation.
+    // The absolute error is around `1e-6`, so for `fixed16` they are accurate to the last bit or two.
+
+    template <fixed_point_scalar T>
+    [[nodiscard]] constexpr T sin(T angle)
+    {
+        return impl::FromQ32<T>(impl::SinOfPhase(impl::AngleToPhase(angle)));
+    }
+
+    template <fixed_point_scalar T>
+    [[nodiscard]] constexpr T cos(T angle)
+    {
+        return impl::FromQ32<T>(impl::SinOfPhase(impl::AngleToPhase(angle) + (std::uint32_t(1) << 30)));
+    }
+
+    // Returns the angle in `-pi..pi`. Returns 0 if both arguments are zero.
+    template <fixed_point_scalar T>
+    [[nodiscard]] constexpr T atan2(T y, T x)
+    {
+        using U = typename T::wide_unsigned_type;
+        U abs_x = x.raw < 0 ? U(-typename T::wide_type(x.raw)) : U(x.raw);
+        U abs_y = y.raw < 0 ? U(-typename T::wide_type(y.raw)) : U(y.raw);
+        if (abs_x == 0 && abs_y == 0)
+            return T{};
+
+        bool swap = abs_y > abs_x;
+        U num = swap ? abs_x : abs_y;
+        U den = swap ? abs_y : abs_x;
+
+        // The ratio is in `0..1`, scaled to the table position.
+        constexpr int pos_bits = impl::fixed_atan_table_bits + 20;
+        std::int64_t ret = impl::LerpTable(impl::fixed_atan_table, std::uint32_t((num << pos_bits) / den));
+
+        if (swap)
+            ret = impl::fixed_pi_q32 / 2 - ret;
+        if (x.raw < 0)
+            ret = impl::fixed_pi_q32 - ret;
+        if (y.raw < 0)
+            ret = -ret;
+        return impl::FromQ32<T>(ret);
+    }
+}
+
+template <std::signed_integral I, int FracBits>
+struct Math::helper_is_scalar<Math2::Fixed<I, FracBits>> : std::true_type {};
+
+template <std::signed_integral I, int FracBits>
+struct std::hash<Math2::Fixed<I, FracBits>>
+{
+    [[nodiscard]] std::size_t operator()(Math2::Fixed<I, FracBits> value) const
+    {
+        return std::hash<I>{}(value.raw);
+    }
+};
+
+template <std::signed_integral I, int FracBits>
+struct std::numeric_limits<Math2::Fixed<I, FracBits>>
+{
+    using type = Math2::Fixed<I, FracBits>;
+
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = true;
+    static constexpr bool is_integer = false;
+    static constexpr bool is_exact = true;
+    static constexpr bool has_infinity = false;
+    static constexpr bool has_quiet_NaN = false;
+    static constexpr bool is_bounded = true;
+    static constexpr bool is_modulo = true;
+    static constexpr int radix = 2;
+    static constexpr int digits = std::numeric_limits<I>::digits;
+
+    // The smallest positive value.
+    [[nodiscard]] static constexpr type min() noexcept {return type::FromRaw(1);}
+    [[nodiscard]] static constexpr type max() noexcept {return type::FromRaw(std::numeric_limits<I>::max());}
+    [[nodiscard]] static constexpr type lowest() noexcept {return type::FromRaw(std::numeric_limits<I>::min());}
+    [[nodiscard]] static constexpr type epsilon() noexcept {return type::FromRaw(1);}
+};
+
+using Math2::fixed16;
+using Math2::fixed32;
@@ -0,0 +1,60 @@
+#include "fixed_point.h"
+
+#include <cmath>
+#include <numbers>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("math.fixed_point")
+{
+    // Basic arithmetic.
+    CHECK(fixed16(3) + 2 == 5);
+    CHECK(fixed16(1.5) * fixed16(-2.25) == fixed16(-3.375));
+    CHECK(fixed16(7) / 2 == fixed16(3.5));
+    CHECK(fixed16(-7) / 2 == fixed16(-3.5));
+    CHECK(int(fixed16(-2.5)) == -3);
+    CHECK(fixed16(0.1).raw == 6554);
+    CHECK(fixed32(1) / 3 * 3 < 1);
+    CHECK(floor(fixed16(-2.5)) == -3);
+    CHECK(ceil(fixed16(-2.5)) == -2);
+    CHECK(round(fixed16(2.5)) == 3);
+    CHECK(abs(fixed16(-2.5)) == fixed16(2.5));
+
+    // Square root, rounded down.
+    CHECK(sqrt(fixed16(16)) == 4);
+    CHECK(sqrt(fixed32(2)).raw == 6074000999);
+    CHECK(sqrt(fixed16(-1)) == 0);
+    for (int i = 1; i < 100000; i += 7)
+    {
+        fixed16 x = fixed16::FromRaw(i * 977);
+        fixed16 r = sqrt(x);
+        REQUIRE(r * r <= x);
+        fixed16 next = fixed16::FromRaw(r.raw + 1);
+        REQUIRE(std::int64_t(next.raw) * next.raw > std::int64_t(x.raw) << 16);
+    }
+
+    // Trigonometry.
+    CHECK(sin(fixed16(0)) == 0);
+    CHECK(cos(fixed16(0)) == 1);
+    CHECK(sin(fixed16::half_pi) == 1);
+    CHECK(atan2(fixed16(1), fixed16(0)) == fixed16::half_pi);
+    CHECK(atan2(fixed16(0), fixed16(-1)) == fixed16::pi);
+    double max_error = 0;
+    for (int i = -2000; i <= 2000; i++)
+    {
+        fixed32 a = fixed32(i) / 100;
+        max_error = std::max(max_error, std::abs(double(sin(a)) - std::sin(double(a))));
+        max_error = std::max(max_error, std::abs(double(cos(a)) - std::cos(double(a))));
+        fixed32 y = fixed32(i % 37 - 18), x = fixed32(i % 23 - 11) / 3;
+        max_error = std::max(max_error, std::abs(double(atan2(y, x)) - std::atan2(double(y), double(x))));
+    }
+    CHECK(max_error < 2e-6);
+
+    // Vectors.
+    vec2<fixed16> pos(1, 2), vel(fixed16(0.5), 0);
+    pos += vel * 3;
+    CHECK(pos == vec2<fixed16>(fixed16(2.5), 2));
+    CHECK(sqrt(vec2<fixed16>(3, 4).len_sq()) == 5);
+    CHECK((ivec2(1, 2) + vec2<fixed16>(fixed16(0.5))).x == fixed16(1.5));
+    CHECK(vec2<fixed16>(1, 2).rect_to(vec2<fixed16>(3, 5)).size() == vec2<fixed16>(2, 3));
+}
@@ -3,9 +3,10 @@
 #include "macros/enum_flag_operators.h"
 #include "utils/mat.h"
 
+#include <array>
 #include <iterator>
 
-// Iterating over every point of the difference between two rects.
+// Iterating over every point of the difference between two rects, or over the difference as a list of rects.
 // For now we only support 2-dimensional integral rects.
 
 namespace Math2
@@ -322,4 +323,52 @@ namespace Math2
             return ret;
         }
     };
+
+    // The difference between two rects, as a list of at most 4 non-overlapping rects. Use this with CTAD.
+    // This is a faster alternative to `RectDiffIterator`, since it lets you process whole rows at once, instead of one point at a time.
+    // The rects are: the rows above `sub_rect`, then the parts to the left and to the right of it, then the rows below it.
+    // Each of those is omitted if it's empty.
+    template <int D, Math::scalar T>
+    requires (D == 2) // Only 2D for now, for simplicity.
+    class RectDiffRects
+    {
+        using rect_t = rect<D,T>;
+
+        std::array<rect_t, 4> rects{};
+        int count = 0;
+
+        constexpr void Add(rect_t r)
+        {
+            if (r.has_area())
+                rects[std::size_t(count++)] = r;
+        }
+
+      public:
+        constexpr RectDiffRects() {}
+
+        constexpr RectDiffRects(rect_t rect, rect_t sub_rect)
+        {
+            if (!rect.has_area())
+                return;
+
+            if (!rect.touches(sub_rect) || !sub_rect.has_area())
+            {
+                Add(rect);
+                return;
+            }
+
+            sub_rect = sub_rect.intersect(rect);
+
+            Add(rect.a.rect_to(vec<D,T>(rect.b.x, sub_rect.a.y)));
+            Add(vec<D,T>(rect.a.x, sub_rect.a.y).rect_to(vec<D,T>(sub_rect.a.x, sub_rect.b.y)));
+            Add(vec<D,T>(sub_rect.b.x, sub_rect.a.y).rect_to(vec<D,T>(rect.b.x, sub_rect.b.y)));
+            Add(vec<D,T>(rect.a.x, sub_rect.b.y).rect_to(rect.b));
+        }
+
+        [[nodiscard]] constexpr const rect_t *begin() const {return rects.data();}
+        [[nodiscard]] constexpr const rect_t *end() const {return rects.data() + count;}
+        [[nodiscard]] constexpr int size() const {return count;}
+        [[nodiscard]] constexpr bool empty() const {return count == 0;}
+        [[nodiscard]] constexpr const rect_t &operator[](int i) const {return rects[std::size_t(i)];}
+    };
 }
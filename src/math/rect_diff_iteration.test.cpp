@@ -304,3 +304,34 @@ TEST_CASE("math.rect_diff_iteration")
         TestCase(ivec2(10,5).rect_size(ivec2(7,6)), ivec2(a,c).rect_to(ivec2(b,d)), target);
     }
 }
+
+TEST_CASE("math.rect_diff_rects")
+{
+    const irect2 a = ivec2(10,5).rect_size(ivec2(7,6));
+
+    // Compare against `RectDiffIterator`, for all sub-rect positions around `a`.
+    for (ivec2 sub_a : ivec2(8,3) <= vector_range <= ivec2(18,12))
+    for (ivec2 sub_size : ivec2(0) <= vector_range <= ivec2(9,8))
+    {
+        irect2 b = sub_a.rect_size(sub_size);
+        CAPTURE(b);
+
+        Array2D<int> expected(a.size());
+        for (ivec2 pos : Math2::RectDiffIterator(a, b))
+            expected.at(pos - a.a)++;
+
+        Array2D<int> actual(a.size());
+        Math2::RectDiffRects rects(a, b);
+        REQUIRE(rects.size() <= 4);
+        for (irect2 r : rects)
+        {
+            REQUIRE(r.has_area());
+            for (ivec2 pos : r.a <= vector_range < r.b)
+                actual.at(pos - a.a)++;
+        }
+        REQUIRE(actual == expected);
+    }
+
+    // An empty rect.
+    REQUIRE(Math2::RectDiffRects(irect2{}, ivec2(1).rect_size(ivec2(2))).empty());
+}
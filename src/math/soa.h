@@ -0,0 +1,240 @@
+#pragma once
+
+#include "program/errors.h"
+#include "utils/mat.h"
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <vector>
+
+// Arrays of vectors stored as "structure of arrays", one contiguous array per component, and bulk operations on them.
+// The loops over the separate components vectorize well, unlike the loops over arrays of `fvec2`/`fvec3`.
+// How to use:
+//     Math2::SoA<fvec2> pos, vel;
+//     pos.PushBack(fvec2(1, 2));
+//     vel.PushBack(fvec2(3, 4));
+//     Math2::Axpy(dt, vel, pos); // `pos += vel * dt`
+//     frect2 bounds = Math2::Bounds(pos);
+
+namespace Math2
+{
+    template <Math::vector V>
+    requires Math::floating_point_scalar<typename V::type>
+    class SoA
+    {
+      public:
+        using vec_t = V;
+        using type = typename V::type;
+        static constexpr int dim = V::size;
+
+      private:
+        std::array<std::vector<type>, dim> components;
+
+      public:
+        SoA() {}
+
+        // Copies the vectors from an "array of structures".
+        explicit SoA(std::span<const V> vecs)
+        {
+            Resize(vecs.size());
+            for (std::size_t i = 0; i < vecs.size(); i++)
+                Set(i, vecs[i]);
+        }
+
+        [[nodiscard]] std::size_t Size() const {return components[0].size();}
+        [[nodiscard]] bool IsEmpty() const {return components[0].empty();}
+
+        // The new elements are zeroed.
+        void Resize(std::size_t new_size)
+        {
+            for (auto &c : components)
+                c.resize(new_size);
+        }
+        void Reserve(std::size_t new_capacity)
+        {
+            for (auto &c : components)
+                c.reserve(new_capacity);
+        }
+        void Clear()
+        {
+            for (auto &c : components)
+                c.clear();
+        }
+
+        void PushBack(V value)
+        {
+            for (int i = 0; i < dim; i++)
+                components[i].push_back(value[i]);
+        }
+
+        // Removes an element by moving the last one in its place.
+        void SwapRemove(std::size_t i)
+        {
+            ASSERT(i < Size(), "SoA index is out of range.");
+            for (auto &c : components)
+            {
+                c[i] = c.back();
+                c.pop_back();
+            }
+        }
+
+        [[nodiscard]] V Get(std::size_t i) const
+        {
+            ASSERT(i < Size(), "SoA index is out of range.");
+            V ret;
+            for (int j = 0; j < dim; j++)
+                ret[j] = components[j][i];
+            return ret;
+        }
+        void Set(std::size_t i, V value)
+        {
+            ASSERT(i < Size(), "SoA index is out of range.");
+            for (int j = 0; j < dim; j++)
+                components[j][i] = value[j];
+        }
+
+        // Returns all values of the `i`-th component (0 for `x`, 1 for `y`, etc).
+        [[nodiscard]] std::span<      type> Component(int i)       {return components[i];}
+        [[nodiscard]] std::span<const type> Component(int i) const {return components[i];}
+
+        // Copies the vectors to an "array of structures". `out.size()` must match `Size()`.
+        void CopyTo(std::span<V> out) const
+        {
+            ASSERT(out.size() == Size(), "SoA size mismatch.");
+            for (std::size_t i = 0; i < out.size(); i++)
+                out[i] = Get(i);
+        }
+    };
+
+    namespace impl
+    {
+        // Folds `values` with `func`, using several independent accumulators, so that the loop vectorizes without `-ffast-math`.
+        template <typename T, typename F>
+        [[nodiscard]] T ReduceLanes(std::span<const T> values, T init, F &&func)
+        {
+            constexpr std::size_t num_lanes = 8;
+            std::array<T, num_lanes> lanes;
+            lanes.fill(init);
+
+            std::size_t i = 0;
+            for (; i + num_lanes <= values.size(); i += num_lanes)
+            {
+                for (std::size_t j = 0; j < num_lanes; j++)
+                    lanes[j] = func(lanes[j], values[i + j]);
+            }
+            for (; i < values.size(); i++)
+                lanes[0] = func(lanes[0], values[i]);
+
+            T ret = init;
+            for (T lane : lanes)
+                ret = func(ret, lane);
+            return ret;
+        }
+    }
+
+    // `y += a * x`. The sizes must match.
+    template <typename V>
+    void Axpy(typename SoA<V>::type a, const SoA<V> &x, SoA<V> &y)
+    {
+        ASSERT(x.Size() == y.Size(), "SoA size mismatch.");
+        for (int j = 0; j < SoA<V>::dim; j++)
+        {
+            std::span<const typename SoA<V>::type> in = x.Component(j);
+            std::span<typename SoA<V>::type> out = y.Component(j);
+            for (std::size_t i = 0; i < in.size(); i++)
+                out[i] += a * in[i];
+        }
+    }
+
+    // `out = m * in`, for every element. Resizes `out` to match `in`. `in` and `out` can be the same object.
+    template <typename V>
+    void TransformVectors(const Math::mat<V::size, V::size, typename V::type> &m, const SoA<V> &in, SoA<V> &out)
+    {
+        constexpr int dim = SoA<V>::dim;
+        using type = typename SoA<V>::type;
+
+        out.Resize(in.Size());
+        std::array<const type *, dim> src;
+        std::array<type *, dim> dst;
+        for (int j = 0; j < dim; j++)
+        {
+            src[j] = in.Component(j).data();
+            dst[j] = out.Component(j).data();
+        }
+
+        for (std::size_t i = 0; i < in.Size(); i++)
+        {
+            V v;
+            for (int j = 0; j < dim; j++)
+                v[j] = src[j][i];
+            v = m * v;
+            for (int j = 0; j < dim; j++)
+                dst[j][i] = v[j];
+        }
+    }
+
+    // `out = m * in` with an implicit `1` appended to `in`, for every element, i.e. transforms points by an affine matrix (e.g. `fmat3` for `fvec2`, or `fmat4` for `fvec3`).
+    // The last row of the matrix is ignored. Resizes `out` to match `in`. `in` and `out` can be the same object.
+    template <typename V>
+    void TransformPoints(const Math::mat<V::size + 1, V::size + 1, typename V::type> &m, const SoA<V> &in, SoA<V> &out)
+    {
+        constexpr int dim = SoA<V>::dim;
+        using type = typename SoA<V>::type;
+
+        out.Resize(in.Size());
+        std::array<const type *, dim> src;
+        std::array<type *, dim> dst;
+        for (int j = 0; j < dim; j++)
+        {
+            src[j] = in.Component(j).data();
+            dst[j] = out.Component(j).data();
+        }
+
+        for (std::size_t i = 0; i < in.Size(); i++)
+        {
+            V v;
+            for (int j = 0; j < dim; j++)
+                v[j] = src[j][i];
+
+            for (int j = 0; j < dim; j++)
+            {
+                type value = m[0][j] * v[0];
+                for (int k = 1; k < dim; k++)
+                    value += m[k][j] * v[k];
+                dst[j][i] = value + m[dim][j]; // Add the translation last, to get the same result as the matrix product.
+            }
+        }
+    }
+
+    // The component-wise minimum. Returns positive infinity for an empty array.
+    template <typename V>
+    [[nodiscard]] V Min(const SoA<V> &soa)
+    {
+        using type = typename SoA<V>::type;
+        V ret;
+        for (int j = 0; j < SoA<V>::dim; j++)
+            ret[j] = impl::ReduceLanes(soa.Component(j), std::numeric_limits<type>::infinity(), [](type a, type b){return b < a ? b : a;});
+        return ret;
+    }
+
+    // The component-wise maximum. Returns negative infinity for an empty array.
+    template <typename V>
+    [[nodiscard]] V Max(const SoA<V> &soa)
+    {
+        using type = typename SoA<V>::type;
+        V ret;
+        for (int j = 0; j < SoA<V>::dim; j++)
+            ret[j] = impl::ReduceLanes(soa.Component(j), -std::numeric_limits<type>::infinity(), [](type a, type b){return b > a ? b : a;});
+        return ret;
+    }
+
+    // The bounding box of all points, as `Min(soa).rect_to(Max(soa))`.
+    // Note that `b` is inclusive. For an empty array, `a` is positive infinity and `b` is negative infinity.
+    template <typename V>
+    [[nodiscard]] Math::rect<V::size, typename V::type> Bounds(const SoA<V> &soa)
+    {
+        return Min(soa).rect_to(Max(soa));
+    }
+}
@@ -0,0 +1,46 @@
+#include "soa.h"
+
+#include <limits>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("math.soa")
+{
+    std::vector<fvec2> points;
+    for (int i = 0; i < 19; i++)
+        points.push_back(fvec2(i * 2 - 5, 7 - i));
+
+    Math2::SoA<fvec2> pos(points);
+    REQUIRE(pos.Size() == points.size());
+    CHECK(pos.Get(3) == points[3]);
+
+    CHECK(Math2::Bounds(pos) == fvec2(-5, -11).rect_to(fvec2(31, 7)));
+    CHECK(Math2::Bounds(Math2::SoA<fvec2>{}).a == fvec2(std::numeric_limits<float>::infinity()));
+
+    // Integration.
+    Math2::SoA<fvec2> vel;
+    vel.Resize(pos.Size());
+    vel.Set(4, fvec2(2, -4));
+    Math2::Axpy(0.5f, vel, pos);
+    CHECK(pos.Get(4) == points[4] + fvec2(1, -2));
+    CHECK(pos.Get(5) == points[5]);
+
+    // Transforms, in place.
+    fmat3 m = fmat3::translate(fvec2(10, 20)) * fmat2::rotate(f_pi / 2).to_mat3();
+    Math2::TransformPoints(m, pos, pos);
+    CHECK(pos.Get(5) == (m * points[5].to_vec3(1)).to_vec2());
+    Math2::TransformVectors(fmat2(2, 0, 0, 3), pos, pos);
+    CHECK(pos.Get(5) == (m * points[5].to_vec3(1)).to_vec2() * fvec2(2, 3));
+
+    Math2::SoA<fvec3> points3;
+    points3.PushBack(fvec3(1, 2, 3));
+    Math2::TransformPoints(fmat4::translate(fvec3(1, 1, 1)), points3, points3);
+    CHECK(points3.Get(0) == fvec3(2, 3, 4));
+
+    std::vector<fvec2> out(pos.Size());
+    pos.CopyTo(out);
+    pos.SwapRemove(0);
+    CHECK(pos.Size() == 18);
+    CHECK(pos.Get(0) == out.back());
+}
@@ -0,0 +1,118 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "program/platform.h"
+#include "utils/clock.h"
+
+#if IMP_PLATFORM_IS(windows)
+#include <windows.h>
+#elif IMP_PLATFORM_IS(linux) || IMP_PLATFORM_IS(android)
+#include <cerrno>
+#include <time.h>
+#endif
+
+namespace Program
+{
+    FramePacer::FramePacer()
+    {
+        #if IMP_PLATFORM_IS(windows)
+        #ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+        #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+        #endif
+        timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        // Older Windows versions don't support high-resolution timers. Then we fall back to `SDL_Delay()`.
+        #endif
+    }
+
+    FramePacer::~FramePacer()
+    {
+        #if IMP_PLATFORM_IS(windows)
+        if (timer)
+            CloseHandle(timer);
+        #endif
+    }
+
+    void FramePacer::SleepFor(std::uint64_t clock_ticks)
+    {
+        double seconds = Clock::TicksToSeconds(clock_ticks);
+
+        #if IMP_PLATFORM_IS(windows)
+        if (timer)
+        {
+            LARGE_INTEGER due_time;
+            due_time.QuadPart = -LONGLONG(seconds * 10'000'000); // Negative means relative, in 100ns units.
+            if (SetWaitableTimer(timer, &due_time, 0, nullptr, nullptr, FALSE))
+            {
+                WaitForSingleObject(timer, INFINITE);
+                return;
+            }
+        }
+        SDL_Delay(std::uint32_t(seconds * 1000));
+        #elif IMP_PLATFORM_IS(linux) || IMP_PLATFORM_IS(android)
+        // An absolute deadline, so that the signals interrupting the sleep don't make us oversleep.
+        timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        std::uint64_t ns = std::uint64_t(seconds * 1'000'000'000);
+        deadline.tv_sec += time_t(ns / 1'000'000'000);
+        deadline.tv_nsec += long(ns % 1'000'000'000);
+        if (deadline.tv_nsec >= 1'000'000'000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1'000'000'000;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {}
+        #else
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        #endif
+    }
+
+    void FramePacer::WaitUntil(std::uint64_t deadline, std::int64_t min_busy_loop_ticks)
+    {
+        std::uint64_t now = Clock::Time();
+        if (now >= deadline)
+            return;
+
+        bool busy_loop = min_busy_loop_ticks >= 0;
+
+        // Sleep until shortly before the deadline.
+        std::uint64_t margin = busy_loop ? std::uint64_t(min_busy_loop_ticks) + std::uint64_t(timer_lateness) : 0;
+        if (deadline - now > margin)
+        {
+            std::uint64_t wake_up = deadline - margin;
+            SleepFor(wake_up - now);
+
+            // Track how late the timer is. Grow the estimate quickly, but shrink it slowly, since oversleeping is worse.
+            std::uint64_t woke_up = Clock::Time();
+            double lateness = woke_up > wake_up ? double(woke_up - wake_up) : 0;
+            timer_lateness += (lateness - timer_lateness) * (lateness > timer_lateness ? 0.5 : 0.05);
+            // Don't let one huge stall (e.g. the window being dragged) disable the sleeping for a long time.
+            timer_lateness = std::min(timer_lateness, double(Clock::TicksPerSecond()) / 100);
+        }
+
+        // Busy loop for the rest.
+        if (busy_loop)
+        {
+            while (Clock::Time() < deadline) {}
+        }
+    }
+
+    void FramePacer::WaitForNextFrame(double fps, std::int64_t min_busy_loop_ticks)
+    {
+        std::uint64_t now = Clock::Time();
+        std::uint64_t period = std::uint64_t(Clock::TicksPerSecond() / fps);
+
+        std::uint64_t deadline = last_deadline + period;
+        if (last_deadline == 0 || deadline + period < now)
+        {
+            // Either the first frame, or we're too far behind to catch up.
+            last_deadline = now;
+            return;
+        }
+
+        WaitUntil(deadline, min_busy_loop_ticks);
+        last_deadline = deadline;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Program
+{
+    // Waits between frames to cap the FPS, using the most precise timers the OS has,
+    //   so that only a short busy loop (or none at all) is needed at the end of the wait.
+    // On Windows this is a high-resolution waitable timer (if supported, Windows 10 1803+), on Linux it's `clock_nanosleep()` with an absolute deadline.
+    // The pacer measures how late the OS wakes it up, and starts the busy loop that much earlier next time.
+    // All times are in `Clock::Time()` units.
+    class FramePacer
+    {
+        void *timer = nullptr; // Windows only, the waitable timer handle.
+
+        std::uint64_t last_deadline = 0; // 0 if none yet.
+        double timer_lateness = 0; // An estimate of how late the timer fires.
+
+        // Sleeps for approximately this long. Can wake up late, but never early.
+        void SleepFor(std::uint64_t clock_ticks);
+
+      public:
+        FramePacer();
+
+        FramePacer(const FramePacer &) = delete;
+        FramePacer &operator=(const FramePacer &) = delete;
+
+        ~FramePacer();
+
+        // Waits until `deadline`.
+        // If `min_busy_loop_ticks` is negative, never busy-waits, only sleeps. This is lighter on the CPU, but less precise.
+        // Otherwise the busy loop takes at least `min_busy_loop_ticks` plus the estimated timer lateness.
+        void WaitUntil(std::uint64_t deadline, std::int64_t min_busy_loop_ticks = 0);
+
+        // Waits until the next frame should start, to run at `fps` frames per second.
+        // The deadlines are spaced evenly, counting from the previous deadline rather than from when this is called,
+        //   so that a slightly long frame is compensated by the next one, and the average FPS doesn't drift.
+        // If we fall behind by more than one frame, the schedule is reset.
+        void WaitForNextFrame(double fps, std::int64_t min_busy_loop_ticks = 0);
+
+        // Forgets the previous deadline, so that the next `WaitForNextFrame()` counts from the current time.
+        void ResetSchedule()
+        {
+            last_deadline = 0;
+        }
+
+        // How late the OS timer is estimated to fire, in clock ticks.
+        [[nodiscard]] double TimerLateness() const
+        {
+            return timer_lateness;
+        }
+    };
+}
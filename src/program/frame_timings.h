@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "utils/clock.h"
+
+namespace Program
+{
+    // The parts of a frame measured by `FrameTimings`.
+    enum class FramePhase
+    {
+        begin_frame,
+        tick, // All ticks of the frame together.
+        render,
+        end_frame, // This usually includes the buffer swap, i.e. waiting for the vsync.
+        fps_cap, // The delay added by the FPS cap.
+        _count,
+    };
+
+    [[nodiscard]] inline const char *FramePhaseName(FramePhase phase)
+    {
+        switch (phase)
+        {
+            case FramePhase::begin_frame: return "begin_frame";
+            case FramePhase::tick:        return "tick";
+            case FramePhase::render:      return "render";
+            case FramePhase::end_frame:   return "end_frame";
+            case FramePhase::fps_cap:     return "fps_cap";
+            case FramePhase::_count:      break;
+        }
+        return "??";
+    }
+
+    // Records the durations of the last N frames, split by phases, to find the hitches that the average FPS hides.
+    // `DefaultBasicState` fills it automatically, see `DefaultBasicState::GetFrameTimings()`.
+    // All durations are in clock ticks, see `Clock::TicksToSeconds()`.
+    class FrameTimings
+    {
+      public:
+        static constexpr std::size_t num_phases = std::size_t(FramePhase::_count);
+
+        struct Frame
+        {
+            std::uint64_t start = 0; // `Clock::Time()` at the beginning of the frame.
+            std::array<std::uint64_t, num_phases> phases{};
+            int num_ticks = 0;
+
+            // The whole frame, including the FPS cap delay.
+            [[nodiscard]] std::uint64_t Total() const
+            {
+                std::uint64_t ret = 0;
+                for (std::uint64_t phase : phases)
+                    ret += phase;
+                return ret;
+            }
+
+            [[nodiscard]] std::uint64_t Phase(FramePhase phase) const
+            {
+                return phases[std::size_t(phase)];
+            }
+        };
+
+        struct Stats
+        {
+            std::uint64_t p50 = 0;
+            std::uint64_t p99 = 0;
+            std::uint64_t max = 0;
+        };
+
+      private:
+        std::vector<Frame> frames; // A ring buffer.
+        std::size_t next_frame = 0;
+        std::size_t num_frames = 0;
+
+        std::uint64_t budget = 0;
+        std::uint64_t num_hitches = 0;
+
+        mutable std::vector<std::uint64_t> scratch;
+
+        [[nodiscard]] Stats ComputeStats(auto &&get_value) const
+        {
+            Stats ret;
+            if (num_frames == 0)
+                return ret;
+
+            scratch.clear();
+            for (std::size_t i = 0; i < num_frames; i++)
+                scratch.push_back(get_value(GetFrame(i)));
+
+            auto Percentile = [&](std::size_t percent)
+            {
+                auto it = scratch.begin() + std::ptrdiff_t((scratch.size() - 1) * percent / 100);
+                std::nth_element(scratch.begin(), it, scratch.end());
+                return *it;
+            };
+            ret.p50 = Percentile(50);
+            ret.p99 = Percentile(99);
+            ret.max = *std::max_element(scratch.begin(), scratch.end());
+            return ret;
+        }
+
+      public:
+        // Remembers up to `capacity` last frames.
+        explicit FrameTimings(std::size_t capacity = 600)
+        {
+            if (capacity == 0)
+                throw std::runtime_error("The capacity of `FrameTimings` can't be zero.");
+            frames.resize(capacity);
+        }
+
+        // The frames longer than this are counted as hitches, and `Record()` returns true for them. 0 disables the detection.
+        // Set this to the frame length you're targeting (plus some margin), e.g. `Clock::SecondsToTicks(1.5 / 60)`.
+        void SetBudget(std::uint64_t clock_ticks)
+        {
+            budget = clock_ticks;
+        }
+        [[nodiscard]] std::uint64_t Budget() const
+        {
+            return budget;
+        }
+
+        // Adds a frame, overwriting the oldest one if the buffer is full. Returns true if the frame exceeds the budget.
+        bool Record(const Frame &frame)
+        {
+            frames[next_frame] = frame;
+            next_frame = (next_frame + 1) % frames.size();
+            num_frames = std::min(num_frames + 1, frames.size());
+
+            bool hitch = budget > 0 && frame.Total() > budget;
+            if (hitch)
+                num_hitches++;
+            return hitch;
+        }
+
+        void Clear()
+        {
+            next_frame = 0;
+            num_frames = 0;
+            num_hitches = 0;
+        }
+
+        [[nodiscard]] std::size_t Capacity() const
+        {
+            return frames.size();
+        }
+        // The number of remembered frames.
+        [[nodiscard]] std::size_t NumFrames() const
+        {
+            return num_frames;
+        }
+        // The number of frames over the budget since the last `Clear()`, including the ones that were already forgotten.
+        [[nodiscard]] std::uint64_t NumHitches() const
+        {
+            return num_hitches;
+        }
+
+        // 0 is the oldest remembered frame, `NumFrames() - 1` is the latest one.
+        [[nodiscard]] const Frame &GetFrame(std::size_t index) const
+        {
+            if (index >= num_frames)
+                throw std::runtime_error("Frame timing index is out of range.");
+            return frames[(next_frame + frames.size() - num_frames + index) % frames.size()];
+        }
+        [[nodiscard]] const Frame &LastFrame() const
+        {
+            return GetFrame(num_frames - 1);
+        }
+
+        // The statistics of the whole frame durations, over the remembered frames.
+        [[nodiscard]] Stats TotalStats() const
+        {
+            return ComputeStats([](const Frame &frame){return frame.Total();});
+        }
+        // The statistics of a single phase, over the remembered frames.
+        [[nodiscard]] Stats PhaseStats(FramePhase phase) const
+        {
+            return ComputeStats([phase](const Frame &frame){return frame.Phase(phase);});
+        }
+
+        // Returns a human-readable summary, and the breakdown of the last `num_last_frames` frames. The times are in milliseconds.
+        // Call this when `Record()` returns true to see what led to the hitch.
+        [[nodiscard]] std::string DumpTrace(std::size_t num_last_frames = 30) const
+        {
+            auto Ms = [](std::uint64_t ticks){return Clock::TicksToSeconds(ticks) * 1000;};
+
+            std::string ret;
+            Stats total = TotalStats();
+            ret += fmt::format("{} frames, {} hitches. Total: p50={:.3f} p99={:.3f} max={:.3f}\n", num_frames, num_hitches, Ms(total.p50), Ms(total.p99), Ms(total.max));
+            for (std::size_t i = 0; i < num_phases; i++)
+            {
+                Stats phase = PhaseStats(FramePhase(i));
+                ret += fmt::format("  {:<12} p50={:.3f} p99={:.3f} max={:.3f}\n", FramePhaseName(FramePhase(i)), Ms(phase.p50), Ms(phase.p99), Ms(phase.max));
+            }
+
+            num_last_frames = std::min(num_last_frames, num_frames);
+            if (num_last_frames > 0)
+            {
+                ret += "  total      ";
+                for (std::size_t i = 0; i < num_phases; i++)
+                    ret += fmt::format(" {:>11}", FramePhaseName(FramePhase(i)));
+                ret += "  ticks\n";
+
+                for (std::size_t i = num_frames - num_last_frames; i < num_frames; i++)
+                {
+                    const Frame &frame = GetFrame(i);
+                    ret += fmt::format("{} {:>10.3f}", budget > 0 && frame.Total() > budget ? '!' : ' ', Ms(frame.Total()));
+                    for (std::uint64_t phase : frame.phases)
+                        ret += fmt::format(" {:>11.3f}", Ms(phase));
+                    ret += fmt::format("  {}\n", frame.num_ticks);
+                }
+            }
+            return ret;
+        }
+    };
+}
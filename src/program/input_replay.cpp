@@ -0,0 +1,321 @@
+#include "input_replay.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+
+#include <fmt/format.h>
+
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "stream/save_to_file.h"
+#include "utils/clock.h"
+
+namespace Program
+{
+    namespace
+    {
+        // The file format: the magic, the format version and `sizeof(SDL_Event)` (`uint32_t`), the seed (`uint64_t`),
+        //   then the tick counts of the frames, the event counts of the ticks, and the events.
+        // Each of the three is a count (`uint32_t`) followed by the elements. The counts are `uint32_t`, the events are copied as is.
+        // All numbers are little-endian, except for the event contents, which are native.
+        constexpr std::string_view file_magic = "imp.input_replay";
+        constexpr std::uint32_t file_version = 1; // Increment when changing the format.
+
+        // Whether this event can be saved to a file. The other ones point to some memory.
+        [[nodiscard]] bool IsRecordableEvent(const SDL_Event &event)
+        {
+            switch (event.type)
+            {
+              case SDL_DROPFILE:
+              case SDL_DROPTEXT:
+              case SDL_DROPBEGIN:
+              case SDL_DROPCOMPLETE:
+              case SDL_SYSWMEVENT:
+              #if SDL_VERSION_ATLEAST(2,0,22)
+              case SDL_TEXTEDITING_EXT:
+              #endif
+                return false;
+              default:
+                return event.type < SDL_USEREVENT;
+            }
+        }
+
+        template <typename T>
+        void WriteVector(Stream::Output &output, const std::vector<T> &vec)
+        {
+            output.WriteLittle<std::uint32_t>(vec.size());
+            output.WriteLittle<T>(vec.data(), vec.size());
+        }
+
+        template <typename T>
+        void ReadVector(Stream::Input &input, std::vector<T> &vec)
+        {
+            std::uint32_t size = input.ReadLittle<std::uint32_t>();
+            if (size > input.RemainingBytes() / sizeof(T))
+                throw std::runtime_error(input.GetExceptionPrefix() + "The element count is out of bounds.");
+            vec.resize(size);
+            input.ReadLittle(vec.data(), vec.size());
+        }
+
+        [[nodiscard]] InputReplay::Distribution ComputeDistribution(std::vector<std::uint64_t> values)
+        {
+            InputReplay::Distribution ret;
+            if (values.empty())
+                return ret;
+
+            std::sort(values.begin(), values.end());
+            auto Percentile = [&](std::size_t percent)
+            {
+                return values[(values.size() - 1) * percent / 100];
+            };
+            ret.mean = std::accumulate(values.begin(), values.end(), 0.) / double(values.size());
+            ret.p50 = Percentile(50);
+            ret.p90 = Percentile(90);
+            ret.p99 = Percentile(99);
+            ret.max = values.back();
+            return ret;
+        }
+    }
+
+    void InputReplay::Reset()
+    {
+        mode = Mode::disabled;
+        seed = 0;
+        events.clear();
+        tick_event_counts.clear();
+        frame_tick_counts.clear();
+        cur_event = 0;
+        cur_tick = 0;
+        cur_frame = 0;
+        frame_first_tick = 0;
+        replay_started = false;
+        replay_start_time = 0;
+        replay_end_time = 0;
+        tick_times.clear();
+        tick_allocations.clear();
+        render_times.clear();
+        frame_draw_calls.clear();
+    }
+
+    void InputReplay::StartRecording(std::uint64_t new_seed)
+    {
+        Reset();
+        mode = Mode::record;
+        seed = new_seed;
+    }
+
+    void InputReplay::Save(const std::string &file_name) const
+    {
+        std::vector<std::uint8_t> data;
+        Stream::Output output = Stream::Output::Container(data);
+        output.WriteString(file_magic.data(), file_magic.size());
+        output.WriteLittle<std::uint32_t>(file_version);
+        output.WriteLittle<std::uint32_t>(sizeof(SDL_Event));
+        output.WriteLittle<std::uint64_t>(seed);
+        WriteVector(output, frame_tick_counts);
+        WriteVector(output, tick_event_counts);
+        output.WriteLittle<std::uint32_t>(events.size());
+        output.WriteBytes(reinterpret_cast<const std::uint8_t *>(events.data()), events.size() * sizeof(SDL_Event));
+        output.Flush();
+        Stream::SaveFile(file_name, data);
+    }
+
+    void InputReplay::StartReplay(const std::string &file_name)
+    {
+        Reset();
+
+        Stream::Input input = Stream::ReadOnlyData(file_name);
+        input.WantLocationStyle(Stream::byte_offset);
+
+        if (!input.DiscardChars<Stream::if_present>(file_magic))
+            throw std::runtime_error(input.GetExceptionPrefix() + "This is not an input replay.");
+        if (input.ReadLittle<std::uint32_t>() != file_version)
+            throw std::runtime_error(input.GetExceptionPrefix() + "Unsupported input replay version.");
+        if (input.ReadLittle<std::uint32_t>() != sizeof(SDL_Event))
+            throw std::runtime_error(input.GetExceptionPrefix() + "This input replay was recorded on a different platform.");
+        seed = input.ReadLittle<std::uint64_t>();
+        ReadVector(input, frame_tick_counts);
+        ReadVector(input, tick_event_counts);
+
+        std::uint32_t num_events = input.ReadLittle<std::uint32_t>();
+        if (num_events > input.RemainingBytes() / sizeof(SDL_Event))
+            throw std::runtime_error(input.GetExceptionPrefix() + "The event count is out of bounds.");
+        events.resize(num_events);
+        input.Read(reinterpret_cast<std::uint8_t *>(events.data()), events.size() * sizeof(SDL_Event));
+        input.ExpectEnd();
+
+        if (std::accumulate(frame_tick_counts.begin(), frame_tick_counts.end(), std::size_t(0)) != tick_event_counts.size() ||
+            std::accumulate(tick_event_counts.begin(), tick_event_counts.end(), std::size_t(0)) != events.size())
+        {
+            Reset();
+            throw std::runtime_error(fmt::format("The input replay `{}` is inconsistent.", file_name));
+        }
+
+        mode = Mode::replay;
+    }
+
+    bool InputReplay::ReplayFinished() const
+    {
+        return replay_started && cur_frame >= frame_tick_counts.size();
+    }
+
+    void InputReplay::Stop()
+    {
+        if (mode == Mode::replay && Interface::Window::IsOpen())
+            Interface::Window::Get().SetOsInputBlocked(false);
+        mode = Mode::disabled;
+    }
+
+    std::uint64_t InputReplay::TickSeed() const
+    {
+        // SplitMix64.
+        std::uint64_t ret = seed + (std::uint64_t(cur_tick) + 1) * 0x9e3779b97f4a7c15;
+        ret = (ret ^ (ret >> 30)) * 0xbf58476d1ce4e5b9;
+        ret = (ret ^ (ret >> 27)) * 0x94d049bb133111eb;
+        return ret ^ (ret >> 31);
+    }
+
+    void InputReplay::ProcessEvents(Interface::Window &window, std::span<const Interface::EventHookRef> hooks, std::uint64_t until_time)
+    {
+        switch (mode)
+        {
+          case Mode::disabled:
+            window.ProcessEvents(hooks, until_time);
+            break;
+
+          case Mode::record:
+            {
+                std::uint32_t &num_events = tick_event_counts.emplace_back();
+                auto recorder = [&](SDL_Event &event)
+                {
+                    if (IsRecordableEvent(event))
+                    {
+                        events.push_back(event);
+                        num_events++;
+                    }
+                    return false;
+                };
+
+                hooks_with_recorder.clear();
+                hooks_with_recorder.push_back(recorder);
+                hooks_with_recorder.insert(hooks_with_recorder.end(), hooks.begin(), hooks.end());
+                window.ProcessEvents(hooks_with_recorder, until_time);
+                hooks_with_recorder.clear();
+
+                cur_event = events.size();
+                cur_tick = tick_event_counts.size();
+            }
+            break;
+
+          case Mode::replay:
+            window.SetOsInputBlocked(true);
+            if (cur_tick < tick_event_counts.size())
+            {
+                for (std::uint32_t i = 0; i < tick_event_counts[cur_tick]; i++)
+                    window.QueueEvent(events[cur_event++]);
+                cur_tick++;
+            }
+            window.ProcessEvents(hooks);
+            break;
+        }
+    }
+
+    int InputReplay::BeginReplayFrame()
+    {
+        if (mode != Mode::replay)
+            return -1;
+
+        if (!replay_started)
+        {
+            replay_started = true;
+            replay_start_time = Clock::Time();
+            if (Interface::Window::IsOpen())
+                Interface::Window::Get().SetVSyncMode(Interface::VSync::disabled);
+        }
+
+        if (cur_frame >= frame_tick_counts.size())
+        {
+            Stop();
+            return -1;
+        }
+
+        // If the previous frame called `ProcessEvents()` a wrong number of times, skip or drop the ticks to stay in sync with the recording.
+        if (cur_tick != frame_first_tick)
+        {
+            cur_tick = frame_first_tick;
+            cur_event = std::accumulate(tick_event_counts.begin(), tick_event_counts.begin() + std::ptrdiff_t(cur_tick), std::size_t(0));
+        }
+
+        return int(frame_tick_counts[cur_frame++]);
+    }
+
+    void InputReplay::EndFrame()
+    {
+        if (mode == Mode::record)
+        {
+            frame_tick_counts.push_back(std::uint32_t(cur_tick - frame_first_tick));
+            frame_first_tick = cur_tick;
+        }
+        else if (mode == Mode::replay && cur_frame > 0)
+        {
+            frame_first_tick += frame_tick_counts[cur_frame - 1];
+            replay_end_time = Clock::Time();
+        }
+    }
+
+    void InputReplay::AddTickSample(std::uint64_t time, std::uint64_t num_allocations)
+    {
+        if (mode != Mode::replay)
+            return;
+        tick_times.push_back(time);
+        tick_allocations.push_back(num_allocations);
+    }
+
+    void InputReplay::AddFrameSample(std::uint64_t render_time, std::uint64_t num_draw_calls)
+    {
+        if (mode != Mode::replay)
+            return;
+        render_times.push_back(render_time);
+        frame_draw_calls.push_back(num_draw_calls);
+    }
+
+    InputReplay::Report InputReplay::GetReport() const
+    {
+        Report ret;
+        ret.num_ticks = tick_times.size();
+        ret.num_frames = render_times.size();
+        ret.total_time = replay_end_time - replay_start_time;
+        ret.tick_time = ComputeDistribution(tick_times);
+        ret.tick_allocations = ComputeDistribution(tick_allocations);
+        ret.render_time = ComputeDistribution(render_times);
+        ret.frame_draw_calls = ComputeDistribution(frame_draw_calls);
+        return ret;
+    }
+
+    std::string InputReplay::Summary() const
+    {
+        Report report = GetReport();
+
+        auto Ms = [](double ticks){return ticks / double(Clock::TicksPerSecond()) * 1000;};
+
+        std::string ret = fmt::format("{} ticks, {} frames in {:.1f} s.\n", report.num_ticks, report.num_frames, Clock::TicksToSeconds(report.total_time));
+        ret += fmt::format("  {:<17} {:>10} {:>10} {:>10} {:>10} {:>10}\n", "", "mean", "p50", "p90", "p99", "max");
+        auto AddTimeRow = [&](const char *name, const Distribution &dist)
+        {
+            ret += fmt::format("  {:<17} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f}\n", name,
+                Ms(dist.mean), Ms(double(dist.p50)), Ms(double(dist.p90)), Ms(double(dist.p99)), Ms(double(dist.max)));
+        };
+        auto AddCountRow = [&](const char *name, const Distribution &dist)
+        {
+            ret += fmt::format("  {:<17} {:>10.1f} {:>10} {:>10} {:>10} {:>10}\n", name, dist.mean, dist.p50, dist.p90, dist.p99, dist.max);
+        };
+        AddTimeRow("tick, ms", report.tick_time);
+        AddTimeRow("render, ms", report.render_time);
+        AddCountRow("tick allocations", report.tick_allocations);
+        AddCountRow("frame draw calls", report.frame_draw_calls);
+        return ret;
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <SDL.h>
+
+#include "interface/window.h"
+
+// Records the input of a play session, and plays it back, to measure the performance of the same gameplay every time.
+// The recording stores the input events of each tick, the number of ticks in each frame, and a random seed.
+// The replay feeds the same events to the same ticks, and runs the frames as fast as possible (no FPS cap, no vsync, no waiting for the metronome).
+// While replaying, it measures the CPU time and the allocations of each tick, and the render time and the draw calls of each frame.
+// How to use:
+//     class State : public Program::DefaultBasicState
+//     {
+//         Program::InputReplay replay;
+//         Program::InputReplay *GetInputReplay() override {return &replay;}
+//
+//         void Tick() override
+//         {
+//             replay.ProcessEvents(window, {gui_hook}); // Instead of `window.ProcessEvents(...)`.
+//             random.Seed(replay.TickSeed()); // If the ticks use random numbers.
+//             ...
+//         }
+//     };
+//
+//     // Either:
+//     state.replay.StartRecording(std::random_device{}());
+//     state.RunMainLoop();
+//     state.replay.Save("session.replay");
+//     // Or:
+//     state.replay.StartReplay("session.replay");
+//     state.RunMainLoop(); // Stops when the replay ends.
+//     std::cout << state.replay.Summary();
+// The ticks must be deterministic given the input and the seeds, otherwise the replay diverges from the recording (e.g. don't use the wall clock time).
+// The events are replayed at the start of their tick, the sub-tick timestamps (`Window::InputEvent::time`) are not reproduced.
+// Drag and drop isn't recorded, since those events point to memory owned by SDL.
+// The files are only meant to be replayed by the same build on the same platform.
+namespace Program
+{
+    class InputReplay
+    {
+      public:
+        enum class Mode {disabled, record, replay};
+
+        // All values are per tick or per frame. The times are in clock ticks, see `Clock::TicksToSeconds()`.
+        struct Distribution
+        {
+            double mean = 0;
+            std::uint64_t p50 = 0;
+            std::uint64_t p90 = 0;
+            std::uint64_t p99 = 0;
+            std::uint64_t max = 0;
+        };
+
+        struct Report
+        {
+            std::size_t num_ticks = 0;
+            std::size_t num_frames = 0;
+            std::uint64_t total_time = 0; // From the first replayed frame to the last one.
+
+            Distribution tick_time; // The `Tick()` calls.
+            Distribution tick_allocations; // See `AllocTracker`, always zero if it's disabled.
+            Distribution render_time; // The `Render()` calls.
+            Distribution frame_draw_calls; // See `Graphics::draw_call_counter`.
+        };
+
+      private:
+        Mode mode = Mode::disabled;
+        std::uint64_t seed = 0;
+
+        std::vector<SDL_Event> events;
+        std::vector<std::uint32_t> tick_event_counts;
+        std::vector<std::uint32_t> frame_tick_counts;
+
+        // The current position. In the record mode, those are the sizes of the vectors above.
+        std::size_t cur_event = 0;
+        std::size_t cur_tick = 0;
+        std::size_t cur_frame = 0;
+        std::size_t frame_first_tick = 0; // The first tick of the current frame.
+
+        std::vector<Interface::EventHookRef> hooks_with_recorder; // Reused by `ProcessEvents()`, to not allocate every tick.
+
+        bool replay_started = false;
+        std::uint64_t replay_start_time = 0;
+        std::uint64_t replay_end_time = 0;
+        std::vector<std::uint64_t> tick_times, tick_allocations, render_times, frame_draw_calls;
+
+        void Reset();
+
+      public:
+        InputReplay() {}
+
+        [[nodiscard]] Mode GetMode() const {return mode;}
+        [[nodiscard]] bool IsRecording() const {return mode == Mode::record;}
+        [[nodiscard]] bool IsReplaying() const {return mode == Mode::replay;}
+
+        // Starts recording, discarding the previous recording or replay. The ticks get their seeds from `seed`, see `TickSeed()`.
+        void StartRecording(std::uint64_t new_seed);
+        // Saves the recording so far. Throws on failure.
+        void Save(const std::string &file_name) const;
+
+        // Loads a recording and starts replaying it. Throws on failure.
+        void StartReplay(const std::string &file_name);
+        // Whether all recorded frames were replayed. Then `DefaultBasicState` stops the main loop, and this stays true until the next `Start...()`.
+        [[nodiscard]] bool ReplayFinished() const;
+
+        // Stops recording or replaying. Keeps the recorded data for `Save()`, and the measurements for `GetReport()`.
+        void Stop();
+
+        // The seed passed to `StartRecording()`, or loaded from the file.
+        [[nodiscard]] std::uint64_t Seed() const {return seed;}
+        // A seed for the current tick, derived from `Seed()` and the tick index. Use it to reseed the random generators in `Tick()`.
+        [[nodiscard]] std::uint64_t TickSeed() const;
+
+        // Use this instead of `Window::ProcessEvents()` in `Tick()`. Call it exactly once per tick, since it also counts the ticks.
+        // When recording, remembers the events before passing them to `hooks`.
+        // When replaying, discards the OS input and processes the recorded events instead. Then `until_time` is ignored.
+        void ProcessEvents(Interface::Window &window, std::span<const Interface::EventHookRef> hooks, std::uint64_t until_time = -1);
+        void ProcessEvents(Interface::Window &window, std::initializer_list<Interface::EventHookRef> hooks = {}, std::uint64_t until_time = -1)
+        {
+            ProcessEvents(window, std::span(hooks.begin(), hooks.size()), until_time);
+        }
+
+        // Those are called by `DefaultBasicState`.
+        // When replaying, returns the number of ticks to run in the next frame, or -1 if the replay has ended. Otherwise returns -1.
+        [[nodiscard]] int BeginReplayFrame();
+        // When recording, remembers how many ticks were in the frame.
+        void EndFrame();
+        // Records the measurements when replaying, otherwise does nothing.
+        void AddTickSample(std::uint64_t time, std::uint64_t num_allocations);
+        void AddFrameSample(std::uint64_t render_time, std::uint64_t num_draw_calls);
+
+        // The measurements of the last replay.
+        [[nodiscard]] Report GetReport() const;
+        // A human-readable summary of `GetReport()`. The times are in milliseconds.
+        [[nodiscard]] std::string Summary() const;
+    };
+}
@@ -1,21 +1,38 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <exception>
 #include <functional>
+#include <mutex>
 #include <optional>
+#include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include <utility>
 
 #include <SDL_timer.h>
 
+#include "graphics/draw_calls.h"
 #include "interface/window.h"
 #include "macros/finally.h"
+#include "program/frame_pacer.h"
+#include "program/frame_timings.h"
+#include "program/input_replay.h"
+#include "utils/alloc_tracker.h"
 #include "utils/clock.h"
 #include "utils/metronome.h"
+#include "utils/trace.h"
+#include "utils/triple_buffer.h"
 #include "program/platform.h"
 
 #if IMP_PLATFORM_IS(emscripten)
 #include <emscripten.h>
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include "utils/jobs.h"
+#endif
 #endif
 
 namespace Program
@@ -47,7 +64,14 @@ namespace Program
             #if !IMP_PLATFORM_IS(emscripten)
             while (RunSingleFrame()) {}
             #else
-            emscripten_set_main_loop_arg([](void *self){static_cast<BasicState *>(self)->RunSingleFrame();}, this, -1, true);
+            emscripten_set_main_loop_arg([](void *self)
+            {
+                #ifdef __EMSCRIPTEN_PTHREADS__
+                // The browser main thread can't block between the frames, so run the GL calls from the workers (see `Jobs::RunOnMainThread()`) here.
+                Jobs::GlobalPool().RunMainThreadJobs();
+                #endif
+                static_cast<BasicState *>(self)->RunSingleFrame();
+            }, this, -1, true);
             #endif
         }
     };
@@ -56,15 +80,48 @@ namespace Program
     {
         bool executing_frame = false;
         std::uint64_t frame_start = -1;
+        FramePacer frame_pacer;
 
       protected:
         bool stop = false;
 
+        // Calls `Tick()` as many times as the metronome says, or once if it's null. Returns the number of ticks.
+        virtual int RunTicks(Metronome *metronome, std::uint64_t delta)
+        {
+            if (metronome)
+            {
+                int num_ticks = 0;
+                while (metronome->Tick(delta))
+                {
+                    Tick();
+                    num_ticks++;
+                }
+                return num_ticks;
+            }
+            else
+            {
+                Tick();
+                return 1;
+            }
+        }
+
       public:
         // Returns the tick metronome, or `nullptr` if want to run one tick per frame.
         // The intended way of overriding is to add a metronome as a class member, and return a pointer to it.
         virtual Metronome *GetTickMetronome() {return nullptr;}
 
+        // Returns the frame timing collector, or `nullptr` if the frames shouldn't be measured.
+        // Override it the same way as `GetTickMetronome()`.
+        virtual FrameTimings *GetFrameTimings() {return nullptr;}
+
+        // Called after a frame exceeds the budget of `GetFrameTimings()`. E.g. print `timings.DumpTrace()` here.
+        virtual void OnFrameHitch(const FrameTimings &timings) {(void)timings;}
+
+        // Returns the input recorder, or `nullptr` if not needed. Override it the same way as `GetTickMetronome()`.
+        // While it's replaying, the frames run the recorded numbers of ticks regardless of the metronome and without the FPS cap,
+        //   and the loop stops when the replay ends. See `InputReplay` for details.
+        virtual InputReplay *GetInputReplay() {return nullptr;}
+
         // Returns true if it's advisable to have a FPS cap. That is, when vsync is disabled.
         // See comment on `GetFpsCap` for the intended use of this function.
         [[nodiscard]] static bool NeedFpsCap()
@@ -78,13 +135,13 @@ namespace Program
         virtual int GetFpsCap() {return 0;}
 
         // Ignored if FPS cap is disabled.
-        // FPS is capped by adding a delay after frames that are too short.
-        // The delay will be partially created using a `sleep` function, and partially using a busy loop.
-        // This function returns the preferred duration of the busy loop.
+        // FPS is capped by adding a delay after frames that are too short, see `FramePacer`.
+        // The delay is created using a high-precision OS timer, followed by a short busy loop to absorb the timer imprecision.
+        // The busy loop is automatically lengthened by how late the timer was observed to fire. This function returns its minimal duration.
         // If it returns -1, the busy loop will not be used. It lowers CPU load, but might make the timing less precise.
         // If it returns 0, the busy loop will be used as little as possible.
         // If it returns a large value, `sleep` will not be used at all, which increases CPU loads but improves precision.
-        virtual int GetFpsCapPreferredBusyLoopDurationMs() {return 1;}
+        virtual int GetFpsCapPreferredBusyLoopDurationMs() {return 0;}
 
         bool RunSingleFrame() override
         {
@@ -93,10 +150,40 @@ namespace Program
             executing_frame = true;
             FINALLY{executing_frame = false;};
 
+            IMP_TRACE_ZONE("Frame");
+
             // Load some basic config from state.
             auto *metronome = GetTickMetronome();
+            auto *timings = GetFrameTimings();
             auto fps_cap = GetFpsCap();
-            bool have_fps_cap = fps_cap > 0 && !IMP_PLATFORM_IS(emscripten);
+            auto *replay = GetInputReplay();
+
+            int num_replayed_ticks = -1;
+            if (replay && replay->IsReplaying())
+            {
+                num_replayed_ticks = replay->BeginReplayFrame();
+                if (num_replayed_ticks < 0)
+                {
+                    stop = true;
+                    return false;
+                }
+            }
+
+            bool have_fps_cap = fps_cap > 0 && !IMP_PLATFORM_IS(emscripten) && num_replayed_ticks < 0;
+
+            // Measure the frame phases if needed.
+            FrameTimings::Frame frame_timing;
+            std::uint64_t phase_start = 0;
+            if (timings)
+                frame_timing.start = phase_start = Clock::Time();
+            auto EndPhase = [&](FramePhase phase)
+            {
+                if (!timings)
+                    return;
+                std::uint64_t now = Clock::Time();
+                frame_timing.phases[std::size_t(phase)] = now - phase_start;
+                phase_start = now;
+            };
 
             // Compute timings if needed.
             std::uint64_t delta = 0;
@@ -112,56 +199,252 @@ namespace Program
 
             // Begin frame.
             BeginFrame();
+            EndPhase(FramePhase::begin_frame);
 
             // Tick.
-            if (metronome)
+            if (num_replayed_ticks >= 0)
             {
-                while (metronome->Tick(delta))
+                for (int i = 0; i < num_replayed_ticks; i++)
+                {
+                    std::uint64_t num_allocations = AllocTracker::TotalAllocationCount();
+                    std::uint64_t tick_start = Clock::Time();
                     Tick();
+                    replay->AddTickSample(Clock::Time() - tick_start, AllocTracker::TotalAllocationCount() - num_allocations);
+                }
+                frame_timing.num_ticks = num_replayed_ticks;
             }
             else
             {
-                Tick();
+                frame_timing.num_ticks = RunTicks(metronome, delta);
             }
+            EndPhase(FramePhase::tick);
 
             // Render.
+            std::uint64_t num_draw_calls = Graphics::draw_call_counter;
+            std::uint64_t render_start = replay ? Clock::Time() : 0;
             Render();
+            if (replay)
+                replay->AddFrameSample(Clock::Time() - render_start, Graphics::draw_call_counter - num_draw_calls);
+            EndPhase(FramePhase::render);
 
             // End frame.
             EndFrame();
+            if (replay)
+                replay->EndFrame();
+            EndPhase(FramePhase::end_frame);
 
             // Cap FPS.
             if (have_fps_cap)
             {
-                std::uint64_t clock_ticks_per_sec = Clock::TicksPerSecond();
-                std::uint64_t desired_frame_len = 1.0 / fps_cap * clock_ticks_per_sec;
-                std::uint64_t frame_end = Clock::Time(), frame_len = frame_end - frame_start;
+                auto busy_loop_len_ms = GetFpsCapPreferredBusyLoopDurationMs();
+                frame_pacer.WaitForNextFrame(fps_cap, busy_loop_len_ms < 0 ? -1 : std::int64_t(Clock::SecondsToTicks(busy_loop_len_ms / 1000.)));
+            }
+            else
+            {
+                frame_pacer.ResetSchedule();
+            }
+            EndPhase(FramePhase::fps_cap);
 
-                // If necessary, add a delay.
-                if (frame_len < desired_frame_len)
-                {
-                    int sleep_ms = (desired_frame_len - frame_len) * 1000 / clock_ticks_per_sec;
+            if (timings && timings->Record(frame_timing))
+                OnFrameHitch(*timings);
+
+            return !stop;
+        }
+    };
+
+    // Like `DefaultBasicState`, but the ticks run on a separate simulation thread, so that they can overlap with the rendering.
+    // After each batch of ticks, the simulation thread copies everything the rendering needs into a `Snapshot`,
+    //   and the main thread renders the latest complete snapshot.
+    //
+    // Override these instead of `Tick()` and `Render()`:
+    //     void Tick() override; // Runs on the simulation thread.
+    //     void MakeSnapshot(Snapshot &snapshot) override; // Runs on the simulation thread. `snapshot` holds some older value, overwrite it completely.
+    //     void RenderSnapshot(const Snapshot &snapshot, double alpha) override; // Runs on the main thread.
+    // `alpha` is the time passed since the snapshot was made, in ticks, clamped to `[0,1]`. To interpolate, store both the previous
+    //   and the current positions in the snapshot, and mix them with `alpha`.
+    // The simulation thread must not touch the same data as the main thread (other than the snapshots), and vice versa.
+    // `GetTickMetronome()` must be overridden, and the metronome is only used by the simulation thread.
+    //
+    // The simulation thread starts on the first frame, and stops when `RunSingleFrame()` returns false or throws.
+    // The exceptions thrown on the simulation thread are rethrown by the next `RunSingleFrame()`.
+    // If you destroy the state without stopping the loop, call `StopSimulation()` in the destructor of the derived class,
+    //   since the simulation thread calls its virtual functions.
+    //
+    // On Emscripten without pthreads, everything runs on the main thread, like in `DefaultBasicState`.
+    template <typename Snapshot>
+    class PipelinedState : public DefaultBasicState
+    {
+        struct PublishedSnapshot
+        {
+            Snapshot value;
+            std::uint64_t time = 0; // When it was made, according to `Clock::Time()`.
+            std::uint64_t tick_len = 0; // `Metronome::ClockTicksPerTick()` at that time.
+        };
+        Concurrent::TripleBuffer<PublishedSnapshot> snapshots;
+
+        std::jthread simulation_thread;
+
+        std::mutex exception_mutex;
+        std::exception_ptr simulation_exception; // Protected by `exception_mutex`.
+
+        bool made_first_snapshot = false;
+
+        #if IMP_PLATFORM_IS(emscripten) && !defined(__EMSCRIPTEN_PTHREADS__)
+        static constexpr bool use_simulation_thread = false;
+        #else
+        static constexpr bool use_simulation_thread = true;
+        #endif
+
+        [[nodiscard]] Metronome &GetMetronomeOrThrow()
+        {
+            Metronome *metronome = GetTickMetronome();
+            if (!metronome)
+                throw std::runtime_error("`PipelinedState` requires `GetTickMetronome()` to return a metronome.");
+            return *metronome;
+        }
 
-                    auto busy_loop_len_ms = GetFpsCapPreferredBusyLoopDurationMs();
-                    bool busy_loop_allowed = busy_loop_len_ms >= 0;
+        void Publish(const Metronome &metronome)
+        {
+            PublishedSnapshot &snapshot = snapshots.Write();
+            MakeSnapshot(snapshot.value);
+            snapshot.time = Clock::Time();
+            snapshot.tick_len = metronome.ClockTicksPerTick();
+            snapshots.Publish();
+        }
 
-                    if (busy_loop_allowed)
-                        sleep_ms -= busy_loop_len_ms;
+        void SimulationLoop(std::stop_token stop_token)
+        {
+            IMP_TRACE_THREAD_NAME("Simulation");
 
-                    // Sleep.
-                    if (sleep_ms > 0)
-                        SDL_Delay(sleep_ms);
+            try
+            {
+                Metronome &metronome = GetMetronomeOrThrow();
+                Clock::DeltaTimer delta_timer;
 
-                    // Busy loop.
-                    if (busy_loop_allowed)
+                while (!stop_token.stop_requested())
+                {
+                    std::uint64_t delta = delta_timer();
+                    bool ticked = false;
+                    while (metronome.Tick(delta))
                     {
-                        std::uint64_t busy_loop_end = frame_start + desired_frame_len;
-                        while (Clock::Time() < busy_loop_end) {}
+                        Tick();
+                        ticked = true;
                     }
+                    if (ticked)
+                        Publish(metronome);
+
+                    // Sleep until the next tick is due.
+                    double sleep_ticks = (1 - metronome.Time()) * double(metronome.ClockTicksPerTick());
+                    std::this_thread::sleep_for(std::chrono::duration<double>(Clock::TicksToSeconds(std::uint64_t(std::max(0., sleep_ticks)))));
                 }
             }
+            catch (...)
+            {
+                std::lock_guard lock(exception_mutex);
+                simulation_exception = std::current_exception();
+            }
+        }
 
-            return !stop;
+        void StartSimulation()
+        {
+            if (simulation_thread.joinable())
+                return;
+            simulation_thread = std::jthread([this](std::stop_token stop_token){SimulationLoop(std::move(stop_token));});
+        }
+
+        void RethrowSimulationException()
+        {
+            std::exception_ptr exception;
+            {
+                std::lock_guard lock(exception_mutex);
+                exception = std::exchange(simulation_exception, nullptr);
+            }
+            if (exception)
+                std::rethrow_exception(exception);
+        }
+
+      protected:
+        int RunTicks(Metronome *metronome, std::uint64_t delta) override
+        {
+            if constexpr (use_simulation_thread)
+            {
+                (void)metronome;
+                (void)delta;
+                return 0; // The ticks run on the simulation thread.
+            }
+            else
+            {
+                Metronome &m = GetMetronomeOrThrow();
+                int num_ticks = 0;
+                while (m.Tick(delta))
+                {
+                    Tick();
+                    num_ticks++;
+                }
+                if (num_ticks > 0)
+                    Publish(m);
+                return num_ticks;
+            }
+        }
+
+      public:
+        PipelinedState() {}
+
+        PipelinedState(const PipelinedState &) = delete;
+        PipelinedState &operator=(const PipelinedState &) = delete;
+
+        ~PipelinedState()
+        {
+            StopSimulation();
+        }
+
+        // Runs on the simulation thread after each batch of ticks. Should copy everything `RenderSnapshot()` needs into `snapshot`.
+        virtual void MakeSnapshot(Snapshot &snapshot) = 0;
+        // Runs on the main thread. `alpha` is the fraction of the tick passed since the snapshot was made, for interpolation.
+        virtual void RenderSnapshot(const Snapshot &snapshot, double alpha) = 0;
+
+        // Stops the simulation thread, if it's running. It's restarted on the next frame.
+        void StopSimulation()
+        {
+            if (simulation_thread.joinable())
+            {
+                simulation_thread.request_stop();
+                simulation_thread.join();
+            }
+        }
+
+        void Render() override final
+        {
+            snapshots.Update();
+            const PublishedSnapshot &snapshot = snapshots.Read();
+            double alpha = 0;
+            if (snapshot.tick_len > 0)
+                alpha = std::clamp((Clock::Time() - snapshot.time) / double(snapshot.tick_len), 0., 1.);
+            RenderSnapshot(snapshot.value, alpha);
+        }
+
+        bool RunSingleFrame() override
+        {
+            bool ok = false;
+            FINALLY
+            {
+                if (!ok)
+                    StopSimulation();
+            };
+
+            RethrowSimulationException();
+            if (GetInputReplay())
+                throw std::runtime_error("`PipelinedState` doesn't support `InputReplay`, since the ticks run on a separate thread.");
+            if (!made_first_snapshot)
+            {
+                Publish(GetMetronomeOrThrow()); // So that the first frame has something to render.
+                made_first_snapshot = true;
+            }
+            if constexpr (use_simulation_thread)
+                StartSimulation();
+
+            ok = DefaultBasicState::RunSingleFrame();
+            return ok;
         }
     };
 }
@@ -0,0 +1,210 @@
+#include "startup.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "strings/format.h"
+
+namespace Program
+{
+    Startup &Startup::Step(std::string name, std::vector<std::string> dependencies, std::function<void()> func, Thread thread)
+    {
+        steps.push_back({.name = std::move(name), .dependencies = std::move(dependencies), .func = std::move(func), .thread = thread});
+        return *this;
+    }
+
+    void Startup::Run(Jobs::ThreadPool &pool)
+    {
+        using clock = std::chrono::steady_clock;
+
+        // Resolve the dependencies.
+        std::map<std::string, std::size_t, std::less<>> step_indices;
+        for (std::size_t i = 0; i < steps.size(); i++)
+        {
+            if (!step_indices.try_emplace(steps[i].name, i).second)
+                throw std::runtime_error(FMT("Duplicate startup step `{}`.", steps[i].name));
+        }
+
+        std::vector<std::vector<std::size_t>> dependents(steps.size());
+        std::vector<std::size_t> num_pending_deps(steps.size());
+        for (std::size_t i = 0; i < steps.size(); i++)
+        {
+            for (const std::string &dep : steps[i].dependencies)
+            {
+                auto it = step_indices.find(dep);
+                if (it == step_indices.end())
+                    throw std::runtime_error(FMT("Startup step `{}` depends on `{}`, which doesn't exist.", steps[i].name, dep));
+                dependents[it->second].push_back(i);
+                num_pending_deps[i]++;
+            }
+        }
+
+        { // Check for cycles.
+            std::vector<std::size_t> pending = num_pending_deps;
+            std::vector<std::size_t> queue;
+            for (std::size_t i = 0; i < steps.size(); i++)
+            {
+                if (pending[i] == 0)
+                    queue.push_back(i);
+            }
+            for (std::size_t j = 0; j < queue.size(); j++)
+            {
+                for (std::size_t dependent : dependents[queue[j]])
+                {
+                    if (--pending[dependent] == 0)
+                        queue.push_back(dependent);
+                }
+            }
+            if (queue.size() != steps.size())
+                throw std::runtime_error("Circular dependencies between the startup steps.");
+        }
+
+        timings.clear();
+        timings.resize(steps.size());
+        total_time = 0;
+
+        const clock::time_point start = clock::now();
+        auto Seconds = [&]{return std::chrono::duration<double>(clock::now() - start).count();};
+
+        // Protects the variables below.
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<std::size_t> main_thread_ready;
+        std::size_t num_finished = 0;
+        std::size_t num_started = 0;
+        bool failed = false;
+
+        Jobs::Counter counter;
+
+        // Marks the steps as started, and queues the main thread ones. Returns the rest, which should be submitted to the pool.
+        // Assumes the mutex is locked.
+        auto StartStepsLow = [&](const std::vector<std::size_t> &ready)
+        {
+            std::vector<std::size_t> ret;
+            num_started += ready.size();
+            for (std::size_t index : ready)
+            {
+                if (steps[index].thread == Thread::main)
+                    main_thread_ready.push_back(index);
+                else
+                    ret.push_back(index);
+            }
+            cond.notify_all();
+            return ret;
+        };
+
+        // Runs a step, then returns the dependents that became ready and should be submitted to the pool.
+        // The dependents are marked as started in the same critical section, so that the main thread doesn't think that everything is done.
+        // If the step throws, stops scheduling the new steps, and rethrows.
+        auto RunStep = [&](std::size_t index)
+        {
+            timings[index].name = steps[index].name;
+            timings[index].thread = steps[index].thread;
+            timings[index].begin = Seconds();
+
+            std::vector<std::size_t> ready;
+            try
+            {
+                steps[index].func();
+            }
+            catch (...)
+            {
+                std::lock_guard lock(mutex);
+                failed = true;
+                num_finished++;
+                cond.notify_all();
+                throw;
+            }
+
+            timings[index].end = Seconds();
+
+            std::lock_guard lock(mutex);
+            num_finished++;
+            cond.notify_all();
+            if (failed)
+                return ready;
+            for (std::size_t dependent : dependents[index])
+            {
+                if (--num_pending_deps[dependent] == 0)
+                    ready.push_back(dependent);
+            }
+            return StartStepsLow(ready);
+        };
+
+        std::function<void(const std::vector<std::size_t> &)> Submit = [&](const std::vector<std::size_t> &indices)
+        {
+            for (std::size_t index : indices)
+                pool.Submit(counter, [&, index]{Submit(RunStep(index));});
+        };
+
+        std::exception_ptr main_thread_exception;
+        try
+        {
+            std::vector<std::size_t> initial;
+            for (std::size_t i = 0; i < steps.size(); i++)
+            {
+                if (num_pending_deps[i] == 0)
+                    initial.push_back(i);
+            }
+            {
+                std::lock_guard lock(mutex);
+                initial = StartStepsLow(initial);
+            }
+            Submit(initial);
+
+            // Run the main thread steps as they become ready.
+            while (true)
+            {
+                std::size_t index;
+                {
+                    std::unique_lock lock(mutex);
+                    cond.wait(lock, [&]{return failed || !main_thread_ready.empty() || num_finished == num_started;});
+                    if (failed || main_thread_ready.empty())
+                        break; // Either failed, or everything that was started has finished, so there's nothing else to run.
+                    index = main_thread_ready.front();
+                    main_thread_ready.pop_front();
+                }
+                Submit(RunStep(index));
+            }
+        }
+        catch (...)
+        {
+            main_thread_exception = std::current_exception();
+        }
+
+        // Wait for the running steps, and rethrow their exceptions.
+        pool.Wait(counter);
+        if (main_thread_exception)
+            std::rethrow_exception(main_thread_exception);
+
+        total_time = Seconds();
+    }
+
+    std::string Startup::Report() const
+    {
+        std::vector<const StepTiming *> sorted;
+        double serial_time = 0;
+        for (const StepTiming &timing : timings)
+        {
+            sorted.push_back(&timing);
+            serial_time += timing.end - timing.begin;
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const StepTiming *a, const StepTiming *b){return a->begin < b->begin;});
+
+        std::string ret = fmt::format("Startup took {:.1f} ms ({:.1f} ms if run serially):\n", total_time * 1000, serial_time * 1000);
+        for (const StepTiming *timing : sorted)
+        {
+            ret += fmt::format("  {:>8.1f} ms  {:>8.1f} .. {:>8.1f}  {}{}\n", (timing->end - timing->begin) * 1000, timing->begin * 1000, timing->end * 1000,
+                timing->name, timing->thread == Thread::main ? " (main thread)" : "");
+        }
+        return ret;
+    }
+}
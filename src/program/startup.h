@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "utils/jobs.h"
+
+namespace Program
+{
+    // Runs the initialization steps of the program, in parallel where the dependencies allow it, and measures how long each one takes.
+    // Usage:
+    //     Program::Startup startup;
+    //     startup.Step("window", {}, []{...}, Program::Startup::Thread::main);
+    //     startup.Step("sounds", {}, []{...}); // Decodes in parallel with the window creation.
+    //     startup.Step("images", {"window"}, []{...}, Program::Startup::Thread::main); // Needs the GL context.
+    //     startup.Run();
+    //     std::cout << startup.Report();
+    // The steps marked with `Thread::main` run on the thread calling `Run()` (use this for everything touching the window, GL or AL contexts),
+    //   and the rest run on the thread pool.
+    class Startup
+    {
+      public:
+        enum class Thread {any, main};
+
+        struct StepTiming
+        {
+            std::string name;
+            Thread thread = Thread::any;
+            // In seconds, relative to the beginning of `Run()`.
+            double begin = 0;
+            double end = 0;
+        };
+
+      private:
+        struct StepData
+        {
+            std::string name;
+            std::vector<std::string> dependencies;
+            std::function<void()> func;
+            Thread thread = Thread::any;
+        };
+        std::vector<StepData> steps;
+
+        std::vector<StepTiming> timings; // Indices match `steps`.
+        double total_time = 0;
+
+      public:
+        Startup() {}
+
+        // Adds a step. `dependencies` are the names of the steps that must finish before this one starts, they can be added later.
+        Startup &Step(std::string name, std::vector<std::string> dependencies, std::function<void()> func, Thread thread = Thread::any);
+
+        // Runs all steps, and waits for them to finish.
+        // If a step throws, the steps depending on it don't run, and the first exception is rethrown after the running steps finish.
+        // Throws if a dependency doesn't exist or if the dependencies are circular, without running anything.
+        void Run(Jobs::ThreadPool &pool = Jobs::GlobalPool());
+
+        // The timings of the steps that ran during the last `Run()`, in the order of the `Step()` calls.
+        [[nodiscard]] const std::vector<StepTiming> &Timings() const
+        {
+            return timings;
+        }
+
+        // The duration of the last `Run()`, in seconds.
+        [[nodiscard]] double TotalTime() const
+        {
+            return total_time;
+        }
+
+        // A human-readable table of the step timings, sorted by the start time.
+        [[nodiscard]] std::string Report() const;
+    };
+}
@@ -0,0 +1,70 @@
+#include "startup.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("startup")
+{
+    for (int num_workers : {3, 1})
+    {
+        Jobs::ThreadPool pool(num_workers);
+
+        std::mutex mutex;
+        std::string log;
+        auto Log = [&](char ch)
+        {
+            std::lock_guard lock(mutex);
+            log += ch;
+        };
+
+        std::atomic<bool> window_on_main_thread = false;
+
+        Program::Startup startup;
+        startup.Step("images", {"window", "decode"}, [&]{Log('i');}, Program::Startup::Thread::main);
+        startup.Step("window", {}, [&]
+        {
+            window_on_main_thread = pool.IsMainThread();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            Log('w');
+        }, Program::Startup::Thread::main);
+        startup.Step("decode", {}, [&]{std::this_thread::sleep_for(std::chrono::milliseconds(20)); Log('d');});
+        startup.Step("sounds", {"decode"}, [&]{Log('s');});
+        startup.Step("json", {}, [&]{Log('j');});
+        startup.Run(pool);
+
+        CHECK(window_on_main_thread);
+        CHECK(log.size() == 5);
+        CHECK(log.find('i') > log.find('w'));
+        CHECK(log.find('i') > log.find('d'));
+        CHECK(log.find('s') > log.find('d'));
+        CHECK(startup.Timings().size() == 5);
+        CHECK(startup.Timings()[0].name == "images");
+        CHECK(startup.Timings()[0].begin >= startup.Timings()[1].end);
+        CHECK(startup.Report().find("window (main thread)") != std::string::npos);
+        // `window` and `decode` overlap.
+        CHECK(startup.TotalTime() < 0.039);
+
+        // Errors.
+        Program::Startup bad;
+        bad.Step("a", {"b"}, []{});
+        bad.Step("b", {"a"}, []{});
+        REQUIRE_THROWS(bad.Run(pool));
+
+        Program::Startup missing;
+        missing.Step("a", {"b"}, []{});
+        REQUIRE_THROWS(missing.Run(pool));
+
+        // Exceptions stop the dependent steps.
+        bool ran_dependent = false;
+        Program::Startup throwing;
+        throwing.Step("a", {}, []{throw std::runtime_error("Blah!");});
+        throwing.Step("b", {"a"}, [&]{ran_dependent = true;}, Program::Startup::Thread::main);
+        throwing.Step("c", {}, []{});
+        REQUIRE_THROWS(throwing.Run(pool));
+        CHECK(!ran_dependent);
+    }
+}
@@ -0,0 +1,222 @@
+#include "reflection/full.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "stream/output.h"
+#include "utils/mat.h"
+
+namespace
+{
+    REFL_SIMPLE_STRUCT( Plain
+        REFL_DECL(int) a
+        REFL_DECL(float) b
+        REFL_DECL(fvec2) c
+    )
+
+    REFL_SIMPLE_STRUCT( Padded
+        REFL_DECL(char) a
+        REFL_DECL(int) b
+    )
+
+    REFL_SIMPLE_STRUCT( WithBool
+        REFL_DECL(bool) a
+        REFL_DECL(char) b
+    )
+
+    REFL_SIMPLE_STRUCT( Renamed
+        REFL_DECL(int) x
+        REFL_DECL(float) b
+        REFL_DECL(fvec2) c
+    )
+
+    REFL_STRUCT( SaveV1 REFL_ATTR Refl::BinarySections REFL_TERSE
+        REFL_DECL(int) version
+        REFL_DECL(std::string) name
+        REFL_DECL(std::vector<fvec2>) points
+    )
+
+    // Has a removed member, a new member, and a different member order.
+    REFL_STRUCT( SaveV2 REFL_ATTR Refl::BinarySections REFL_TERSE
+        REFL_DECL(std::vector<fvec2>) points
+        REFL_DECL(int) version
+        REFL_DECL(std::optional<int>) score
+    )
+
+    // Serializes the fields one by one, like the reflection does without the fast path.
+    template <typename F>
+    [[nodiscard]] std::string Expected(F &&func)
+    {
+        std::string ret;
+        Stream::Output output = Stream::Output::Container(ret);
+        func(output);
+        output.Flush();
+        return ret;
+    }
+}
+
+TEST_CASE("reflection.binary.plain")
+{
+    REQUIRE(Refl::impl::IsPlainBinary(int{}));
+    REQUIRE(Refl::impl::IsPlainBinary(fvec2{}));
+    REQUIRE(Refl::impl::IsPlainBinary(Plain{}));
+    REQUIRE(!Refl::impl::IsPlainBinary(Padded{}));
+    REQUIRE(!Refl::impl::IsPlainBinary(WithBool{}));
+    REQUIRE(!Refl::impl::IsPlainBinary(fmat2{})); // The elements are serialized in a different order than they're stored.
+
+    Plain plain{.a = -3, .b = 1.5f, .c = fvec2(2, -4)};
+    std::string plain_bin = Refl::ToBinary<std::string>(plain);
+    REQUIRE(plain_bin == Expected([&](Stream::Output &output)
+    {
+        output.WriteLittle<std::int32_t>(-3).WriteLittle<float>(1.5f).WriteLittle<float>(2).WriteLittle<float>(-4);
+    }));
+    Plain plain_copy = Refl::FromBinary<Plain>(plain_bin);
+    REQUIRE(plain_copy.a == plain.a);
+    REQUIRE(plain_copy.b == plain.b);
+    REQUIRE(plain_copy.c == plain.c);
+
+    Padded padded{.a = 'x', .b = 42};
+    std::string padded_bin = Refl::ToBinary<std::string>(padded);
+    REQUIRE(padded_bin == Expected([&](Stream::Output &output)
+    {
+        output.WriteChar('x').WriteLittle<std::int32_t>(42);
+    }));
+
+    fmat2 mat(1, 2, 3, 4);
+    REQUIRE(Refl::ToBinary<std::string>(mat) == Expected([&](Stream::Output &output)
+    {
+        for (float x : {1, 2, 3, 4})
+            output.WriteLittle<float>(x);
+    }));
+    REQUIRE(Refl::FromBinary<fmat2>(Refl::ToBinary<std::string>(mat)) == mat);
+}
+
+TEST_CASE("reflection.binary.containers")
+{
+    std::vector<fvec2> points;
+    for (int i = 0; i < 1000; i++)
+        points.push_back(fvec2(i, -i * 0.5f));
+
+    std::string points_bin = Refl::ToBinary<std::string>(points);
+    REQUIRE(points_bin == Expected([&](Stream::Output &output)
+    {
+        output.WriteLittle<std::uint32_t>(points.size());
+        for (fvec2 point : points)
+            output.WriteLittle<float>(point.x).WriteLittle<float>(point.y);
+    }));
+
+    // A small reserve limit makes the elements arrive in several batches.
+    std::vector<fvec2> points_copy = {fvec2(9, 9)};
+    Refl::FromBinary(points_copy, points_bin, {.max_reserved_size = 24});
+    REQUIRE(points_copy == points);
+
+    REQUIRE(Refl::FromBinary<std::vector<fvec2>>(Refl::ToBinary<std::string>(std::vector<fvec2>{})).empty());
+
+    std::vector<Padded> padded = {{.a = 'a', .b = 1}, {.a = 'b', .b = 2}};
+    std::vector<Padded> padded_copy = Refl::FromBinary<std::vector<Padded>>(Refl::ToBinary<std::string>(padded));
+    REQUIRE(padded_copy.size() == 2);
+    REQUIRE(padded_copy[1].a == 'b');
+    REQUIRE(padded_copy[1].b == 2);
+
+    // A malformed length shouldn't allocate much before the input runs out.
+    std::string truncated = Expected([&](Stream::Output &output)
+    {
+        output.WriteLittle<std::uint32_t>(0xffffffff).WriteLittle<float>(1);
+    });
+    REQUIRE_THROWS_AS(Refl::FromBinary<std::vector<fvec2>>(truncated), std::runtime_error);
+}
+
+TEST_CASE("reflection.binary.schema")
+{
+    static_assert(Refl::SchemaHash<int>() == Refl::SchemaHash<std::int32_t>());
+    static_assert(Refl::SchemaHash<int>() != Refl::SchemaHash<unsigned int>());
+    static_assert(Refl::SchemaHash<std::vector<int>>() != Refl::SchemaHash<std::vector<float>>());
+    static_assert(Refl::SchemaHash<std::map<int, float>>() == Refl::SchemaHash<std::vector<std::pair<int, float>>>());
+    static_assert(Refl::SchemaHash<Plain>() != Refl::SchemaHash<Renamed>());
+    static_assert(Refl::SchemaHash<SaveV1>() != Refl::SchemaHash<SaveV2>());
+
+    Plain plain{.a = 1, .b = 2, .c = fvec2(3, 4)};
+    std::string bin = Refl::ToBinaryWithSchema<std::string>(plain);
+    REQUIRE(bin.size() == 4 + sizeof(Plain));
+
+    Stream::Input input(Stream::ReadOnlyData::mem_reference(bin));
+    REQUIRE(Refl::CheckBinarySchema<Plain>(input));
+    REQUIRE(Refl::FromBinaryWithSchema<Plain>(bin).c == plain.c);
+    REQUIRE_THROWS_AS(Refl::FromBinaryWithSchema<Renamed>(bin), std::runtime_error);
+}
+
+TEST_CASE("reflection.binary.sections")
+{
+    SaveV1 v1{.version = 7, .name = "foo", .points = {fvec2(1, 2), fvec2(3, 4)}};
+    std::string bin = Refl::ToBinary<std::string>(v1);
+
+    SaveV1 v1_copy = Refl::FromBinary<SaveV1>(bin);
+    REQUIRE(v1_copy.version == 7);
+    REQUIRE(v1_copy.name == "foo");
+    REQUIRE(v1_copy.points == v1.points);
+
+    // The unknown members are skipped, and the missing ones keep their values.
+    SaveV2 v2{.score = 42};
+    Refl::FromBinary(v2, bin);
+    REQUIRE(v2.version == 7);
+    REQUIRE(v2.points == v1.points);
+    REQUIRE(v2.score == 42);
+
+    // The unneeded members are skipped too.
+    std::vector<std::string> seen;
+    SaveV1 partial;
+    Refl::FromBinary(partial, bin, {.load_section = [&](std::string_view type_name, std::string_view member_name)
+    {
+        REQUIRE(type_name == Meta::TypeName<SaveV1>());
+        seen.emplace_back(member_name);
+        return member_name == "version";
+    }});
+    REQUIRE(seen == std::vector<std::string>{"version", "name", "points"});
+    REQUIRE(partial.version == 7);
+    REQUIRE(partial.name.empty());
+    REQUIRE(partial.points.empty());
+
+    // A section length that doesn't match its contents is an error.
+    std::string broken = bin;
+    broken[8] = char(broken[8] + 1); // The length of the first section.
+    REQUIRE_THROWS_AS(Refl::FromBinary<SaveV1>(broken), std::runtime_error);
+}
+
+TEST_CASE("reflection.binary.strings")
+{
+    std::string str(10000, 'x');
+    for (std::size_t i = 0; i < str.size(); i++)
+        str[i] = char('a' + i % 26);
+    std::string str_bin = Refl::ToBinary<std::string>(str);
+
+    // Contiguous input.
+    REQUIRE(Refl::FromBinary<std::string>(str_bin) == str);
+
+    // A stream that isn't contiguous, the string is read in chunks.
+    auto make_buffered_input = [](const std::string &bin)
+    {
+        return Stream::Input("buffered", bin.size(), [&bin](Stream::Input &, std::size_t offset, std::size_t size, std::uint8_t *dst)
+        {
+            std::copy_n(bin.data() + offset, size, dst);
+        }, Stream::capacity_t(64));
+    };
+    std::string str_copy = "old";
+    Refl::FromBinary(str_copy, make_buffered_input(str_bin), {.max_reserved_size = 100});
+    REQUIRE(str_copy == str);
+
+    // A malformed length shouldn't allocate much before the input runs out.
+    std::string truncated = Expected([&](Stream::Output &output)
+    {
+        output.WriteLittle<std::uint32_t>(0xfffffff0).WriteString("abc");
+    });
+    REQUIRE_THROWS_AS(Refl::FromBinary<std::string>(truncated), std::runtime_error);
+    REQUIRE_THROWS_AS(Refl::FromBinary<std::string>(make_buffered_input(truncated)), std::runtime_error);
+}
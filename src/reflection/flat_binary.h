@@ -0,0 +1,456 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "meta/common.h"
+#include "meta/const_string.h"
+#include "meta/constexpr_hash.h"
+#include "meta/lists.h"
+#include "program/errors.h"
+#include "reflection/interface_basic.h"
+#include "reflection/interface_container.h"
+#include "reflection/interface_enum.h"
+#include "reflection/interface_scalar.h"
+#include "reflection/interface_std_string.h"
+#include "reflection/interface_struct.h"
+#include "stream/readonly_data.h"
+#include "strings/format.h"
+#include "utils/byte_order.h"
+#include "utils/robust_math.h"
+
+// A flat binary format, which is accessed in place without deserializing it, somewhat like flatbuffers.
+// This is good for large read-mostly data: memory-map the file with `Stream::ReadOnlyData::file_mapped()`, and only the parts you touch are read.
+//
+// Supports scalars, enums, `std::string`s, reflected structs, and containers of those.
+// Structs are stored inline, their bases and members following each other without padding.
+// Strings and containers are stored as an offset and a length, and their contents are placed later in the buffer.
+// All numbers are little-endian. The buffer starts with a hash of the layout, which is checked when loading.
+// Struct callbacks are not called, and enum values are not validated.
+//
+// Usage:
+//     auto bytes = Refl::ToFlatBinary<std::vector<std::uint8_t>>(items); // `std::vector<Item> items`
+//     ...
+//     Refl::FlatBinary<std::vector<Item>> flat(Stream::ReadOnlyData::file_mapped("items.bin"));
+//     for (Refl::FlatView<Item> item : flat.Root())
+//         std::cout << item.get<"name">() << ' ' << item.get<"price">() << '\n';
+//     Item item = flat.Root()[42].Load(); // Deserialize a single element.
+
+namespace Refl
+{
+    template <typename T> class FlatView;
+
+    namespace impl::Flat
+    {
+        // The type of offsets and lengths.
+        using offset_t = std::uint32_t;
+        inline constexpr auto byte_order = ByteOrder::little;
+
+        // The buffer starts with this hash.
+        using header_t = std::uint32_t;
+        inline constexpr std::size_t header_size = sizeof(header_t);
+        template <typename T> inline constexpr header_t layout_hash = impl::CombineSchemaHash(Meta::const_hash("flat"), SchemaHash<T>());
+
+        // A buffer being read.
+        struct Source
+        {
+            const std::uint8_t *data = nullptr;
+            std::size_t size = 0;
+
+            template <typename U>
+            [[nodiscard]] U ReadScalar(std::size_t pos) const
+            {
+                U ret;
+                std::memcpy(&ret, data + pos, sizeof ret);
+                ByteOrder::Convert(ret, byte_order);
+                return ret;
+            }
+
+            // Reads an offset and a length (in elements), checks that they fit into the buffer, and returns them.
+            [[nodiscard]] std::pair<std::size_t, std::size_t> ReadRange(std::size_t pos, std::size_t elem_size) const
+            {
+                std::size_t offset = ReadScalar<offset_t>(pos);
+                std::size_t count = ReadScalar<offset_t>(pos + sizeof(offset_t));
+                if (offset > size || (elem_size > 0 && count > (size - offset) / elem_size))
+                    throw std::runtime_error("The flat binary data is corrupted: an offset is out of bounds.");
+                return {offset, count};
+            }
+        };
+
+        // A buffer being written. `C` is a contiguous container of bytes.
+        template <typename C>
+        struct Writer
+        {
+            C &buffer;
+
+            // Appends `len` zeroed bytes, and returns their position.
+            [[nodiscard]] std::size_t Allocate(std::size_t len)
+            {
+                std::size_t ret = buffer.size();
+                buffer.resize(ret + len);
+                return ret;
+            }
+
+            template <typename U>
+            void WriteScalar(std::size_t pos, U value)
+            {
+                ByteOrder::Convert(value, byte_order);
+                std::memcpy(reinterpret_cast<std::uint8_t *>(buffer.data()) + pos, &value, sizeof value);
+            }
+
+            void WriteRange(std::size_t pos, std::size_t offset, std::size_t count)
+            {
+                offset_t small_offset, small_count;
+                if (Robust::conversion_fails(offset, small_offset) || Robust::conversion_fails(count, small_count))
+                    throw std::runtime_error("The flat binary data is too large.");
+                WriteScalar(pos, small_offset);
+                WriteScalar(pos + sizeof(offset_t), small_count);
+            }
+        };
+
+        // Describes how `T` is stored. Specializations must have:
+        //   `static constexpr std::size_t size` - the size when stored inline, in bytes.
+        //   `static void Write(auto &writer, std::size_t pos, const T &object)` - writes to the space allocated at `pos`, allocating more space if needed.
+        //   `static auto Read(const Source &source, std::size_t pos)` - returns the value, or a `FlatView`.
+        //   `static void Load(T &object, const Source &source, std::size_t pos)` - deserializes the object.
+        template <typename T, typename = void>
+        struct Traits {};
+
+        template <typename T>
+        concept supported = requires{Traits<T>::size;};
+
+        template <typename T>
+        struct Traits<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, long double>>>
+        {
+            using stored_t = std::conditional_t<std::is_same_v<T, bool>, std::uint8_t, T>;
+            static constexpr std::size_t size = sizeof(stored_t);
+
+            static void Write(auto &writer, std::size_t pos, const T &object)
+            {
+                writer.WriteScalar(pos, stored_t(object));
+            }
+            [[nodiscard]] static T Read(const Source &source, std::size_t pos)
+            {
+                return T(source.ReadScalar<stored_t>(pos));
+            }
+            static void Load(T &object, const Source &source, std::size_t pos)
+            {
+                object = Read(source, pos);
+            }
+        };
+
+        template <typename T>
+        struct Traits<T, std::enable_if_t<std::is_enum_v<T>>>
+        {
+            using underlying_traits = Traits<std::underlying_type_t<T>>;
+            static constexpr std::size_t size = underlying_traits::size;
+
+            static void Write(auto &writer, std::size_t pos, const T &object)
+            {
+                underlying_traits::Write(writer, pos, std::to_underlying(object));
+            }
+            [[nodiscard]] static T Read(const Source &source, std::size_t pos)
+            {
+                return T(underlying_traits::Read(source, pos));
+            }
+            static void Load(T &object, const Source &source, std::size_t pos)
+            {
+                object = Read(source, pos);
+            }
+        };
+
+        template <typename T>
+        struct Traits<T, std::enable_if_t<std::is_same_v<T, std::string>>>
+        {
+            static constexpr std::size_t size = sizeof(offset_t) * 2;
+
+            static void Write(auto &writer, std::size_t pos, const T &object)
+            {
+                std::size_t data_pos = writer.Allocate(object.size());
+                std::memcpy(reinterpret_cast<std::uint8_t *>(writer.buffer.data()) + data_pos, object.data(), object.size());
+                writer.WriteRange(pos, data_pos, object.size());
+            }
+            [[nodiscard]] static std::string_view Read(const Source &source, std::size_t pos)
+            {
+                auto [offset, len] = source.ReadRange(pos, 1);
+                return {reinterpret_cast<const char *>(source.data) + offset, len};
+            }
+            static void Load(T &object, const Source &source, std::size_t pos)
+            {
+                object = Read(source, pos);
+            }
+        };
+
+        template <typename T>
+        struct Traits<T, std::enable_if_t<StdContainer::is_container<T>>>
+        {
+            using elem_t = typename Interface_StdContainer<T>::mutable_elem_t;
+            static_assert(supported<elem_t>, "The container element type is not supported by the flat binary format.");
+            using elem_traits = Traits<elem_t>;
+
+            static constexpr std::size_t size = sizeof(offset_t) * 2;
+
+            static void Write(auto &writer, std::size_t pos, const T &object)
+            {
+                std::size_t data_pos = writer.Allocate(object.size() * elem_traits::size);
+                writer.WriteRange(pos, data_pos, object.size());
+                for (const elem_t &elem : object)
+                {
+                    elem_traits::Write(writer, data_pos, elem);
+                    data_pos += elem_traits::size;
+                }
+            }
+            [[nodiscard]] static FlatView<T> Read(const Source &source, std::size_t pos)
+            {
+                auto [offset, count] = source.ReadRange(pos, elem_traits::size);
+                return FlatView<T>(source, offset, count);
+            }
+            static void LoadElems(T &object, const Source &source, std::size_t pos, std::size_t count)
+            {
+                auto interface = Interface<T>();
+                interface.Clear(object);
+                interface.Reserve(object, count);
+                for (std::size_t i = 0; i < count; i++)
+                {
+                    elem_t elem{};
+                    elem_traits::Load(elem, source, pos + i * elem_traits::size);
+                    interface.PushBack(object, std::move(elem));
+                }
+            }
+            static void Load(T &object, const Source &source, std::size_t pos)
+            {
+                auto [offset, count] = source.ReadRange(pos, elem_traits::size);
+                LoadElems(object, source, offset, count);
+            }
+        };
+
+        template <typename T>
+        struct Traits<T, std::enable_if_t<Refl::Class::members_known<T>>>
+        {
+            using bases = Refl::Class::combined_bases<T>;
+            static constexpr std::size_t num_bases = Meta::list_size<bases>;
+            static constexpr std::size_t num_members = Refl::Class::member_count<T>;
+
+            // The offsets of the bases, then of the members, then the total size. The skipped bases and members take no space.
+            static constexpr auto offsets = []{
+                std::array<std::size_t, num_bases + num_members + 1> ret{};
+                std::size_t offset = 0;
+                Meta::const_for<num_bases>([&](auto index)
+                {
+                    using base_type = Meta::list_type_at<bases, index.value>;
+                    ret[index.value] = offset;
+                    if constexpr (!impl::Class::skip_base<base_type>)
+                    {
+                        static_assert(supported<base_type>, "A base class is not supported by the flat binary format.");
+                        offset += Traits<base_type>::size;
+                    }
+                });
+                Meta::const_for<num_members>([&](auto index)
+                {
+                    using type = std::remove_cv_t<Refl::Class::member_type<T, index.value>>;
+                    ret[num_bases + index.value] = offset;
+                    if constexpr (!impl::Class::skip_member<type>)
+                    {
+                        static_assert(supported<type>, "A member type is not supported by the flat binary format.");
+                        offset += Traits<type>::size;
+                    }
+                });
+                ret.back() = offset;
+                return ret;
+            }();
+
+            static constexpr std::size_t size = offsets.back();
+
+            // Calls `func(base_or_member, offset)` for every base and member that isn't skipped. `object` is `T` or `const T`.
+            static void ForEachEntry(auto &object, auto &&func)
+            {
+                using object_t = std::remove_reference_t<decltype(object)>;
+                Meta::const_for<num_bases>([&](auto index)
+                {
+                    using base_type = Meta::list_type_at<bases, index.value>;
+                    if constexpr (!impl::Class::skip_base<base_type>)
+                        func(*static_cast<Meta::copy_cv<object_t, base_type> *>(&object), offsets[index.value]);
+                });
+                Meta::const_for<num_members>([&](auto index)
+                {
+                    using type = std::remove_cv_t<Refl::Class::member_type<T, index.value>>;
+                    if constexpr (!impl::Class::skip_member<type>)
+                        func(Refl::Class::Member<index.value>(object), offsets[num_bases + index.value]);
+                });
+            }
+
+            static void Write(auto &writer, std::size_t pos, const T &object)
+            {
+                ForEachEntry(object, [&]<typename U>(const U &entry, std::size_t offset)
+                {
+                    Traits<U>::Write(writer, pos + offset, entry);
+                });
+            }
+            [[nodiscard]] static FlatView<T> Read(const Source &source, std::size_t pos)
+            {
+                return FlatView<T>(source, pos);
+            }
+            static void Load(T &object, const Source &source, std::size_t pos)
+            {
+                ForEachEntry(object, [&]<typename U>(U &entry, std::size_t offset)
+                {
+                    Traits<U>::Load(entry, source, pos + offset);
+                });
+            }
+
+            // Returns the index of a member with this name, or -1 if none.
+            [[nodiscard]] static constexpr std::size_t MemberIndex(std::string_view name)
+            {
+                static_assert(Refl::Class::member_names_known<T>, "The member names of this struct are not known.");
+                for (std::size_t i = 0; i < num_members; i++)
+                {
+                    if (Refl::Class::MemberName<T>(i) == name)
+                        return i;
+                }
+                return std::size_t(-1);
+            }
+        };
+    }
+
+    // Refers to a struct or a container in a flat binary buffer. See the top of this file.
+    // This is a lightweight handle that doesn't own the buffer, so keep the `FlatBinary` alive while using it.
+    template <typename T>
+    class FlatView
+    {
+        static_assert(impl::Flat::supported<T>, "This type is not supported by the flat binary format.");
+
+        using traits = impl::Flat::Traits<T>;
+        static constexpr bool is_container = impl::StdContainer::is_container<T>;
+
+        friend traits;
+        template <typename> friend class FlatView;
+
+        impl::Flat::Source source;
+        std::size_t pos = 0; // For structs, the object position. For containers, the position of the first element.
+        std::size_t count = 0; // For containers, the number of elements.
+
+        FlatView(const impl::Flat::Source &source, std::size_t pos, std::size_t count = 0) : source(source), pos(pos), count(count) {}
+
+      public:
+        FlatView() {}
+
+        // Deserializes the object.
+        [[nodiscard]] T Load() const
+        {
+            T ret{};
+            if constexpr (is_container)
+                traits::LoadElems(ret, source, pos, count);
+            else
+                traits::Load(ret, source, pos);
+            return ret;
+        }
+
+        // --- Structs:
+
+        // Returns a member: the value of a scalar or an enum, a `std::string_view` for a string, otherwise a `FlatView`.
+        template <std::size_t I> requires(!is_container)
+        [[nodiscard]] auto get() const
+        {
+            using type = std::remove_cv_t<Class::member_type<T, I>>;
+            static_assert(!impl::Class::skip_member<type>, "This member is not serialized.");
+            return impl::Flat::Traits<type>::Read(source, pos + traits::offsets[traits::num_bases + I]);
+        }
+        template <Meta::ConstString Name> requires(!is_container)
+        [[nodiscard]] auto get() const
+        {
+            constexpr std::size_t index = traits::MemberIndex(Name.view());
+            static_assert(index != std::size_t(-1), "No member with this name.");
+            return get<index>();
+        }
+
+        // Returns a direct base, or a virtual base.
+        template <typename B> requires(!is_container)
+        [[nodiscard]] FlatView<B> base() const
+        {
+            constexpr std::size_t index = Meta::list_find_type<typename traits::bases, B>::value;
+            static_assert(index < traits::num_bases, "No such base class.");
+            static_assert(!impl::Class::skip_base<B>, "This base is not serialized.");
+            return FlatView<B>(source, pos + traits::offsets[index]);
+        }
+
+        // --- Containers:
+
+        [[nodiscard]] std::size_t size() const requires is_container {return count;}
+        [[nodiscard]] bool empty() const requires is_container {return count == 0;}
+
+        // Returns an element, same as `get()` does for members.
+        [[nodiscard]] auto operator[](std::size_t i) const requires is_container
+        {
+            ASSERT(i < count, "Flat binary container index is out of range.");
+            return traits::elem_traits::Read(source, pos + i * traits::elem_traits::size);
+        }
+
+        class iterator
+        {
+            const FlatView *view = nullptr;
+            std::size_t index = 0;
+
+          public:
+            iterator() {}
+            iterator(const FlatView *view, std::size_t index) : view(view), index(index) {}
+
+            [[nodiscard]] auto operator*() const {return (*view)[index];}
+            iterator &operator++() {index++; return *this;}
+            iterator operator++(int) {iterator ret = *this; ++*this; return ret;}
+            [[nodiscard]] bool operator==(const iterator &other) const {return index == other.index;}
+        };
+
+        [[nodiscard]] iterator begin() const requires is_container {return iterator(this, 0);}
+        [[nodiscard]] iterator end() const requires is_container {return iterator(this, count);}
+    };
+
+    // Owns a flat binary buffer. See the top of this file.
+    template <typename T>
+    class FlatBinary
+    {
+        static_assert(impl::Flat::supported<T>, "This type is not supported by the flat binary format.");
+
+        Stream::ReadOnlyData data;
+
+      public:
+        FlatBinary() {}
+
+        // Throws if the data is too small, or was written for a different layout of `T`.
+        explicit FlatBinary(Stream::ReadOnlyData new_data) : data(std::move(new_data))
+        {
+            if (data.size() < impl::Flat::header_size + impl::Flat::Traits<T>::size)
+                throw std::runtime_error(FMT("The flat binary data `{}` is too small.", data.name()));
+            if (impl::Flat::Source{data.data(), data.size()}.ReadScalar<impl::Flat::header_t>(0) != impl::Flat::layout_hash<T>)
+                throw std::runtime_error(FMT("The flat binary data `{}` has an incompatible layout.", data.name()));
+        }
+
+        [[nodiscard]] explicit operator bool() const {return bool(data);}
+
+        [[nodiscard]] const Stream::ReadOnlyData &Data() const {return data;}
+
+        // Returns the root object, same as `FlatView::get()` does for members.
+        [[nodiscard]] auto Root() const
+        {
+            return impl::Flat::Traits<T>::Read({data.data(), data.size()}, impl::Flat::header_size);
+        }
+    };
+
+    // Writes an object in the flat binary format. `C` is a contiguous container of bytes, such as `std::vector<std::uint8_t>` or `std::string`.
+    template <typename C, typename T> requires impl::Flat::supported<T> && requires(C c){c.resize(std::size_t{}); c.data();}
+    [[nodiscard]] C ToFlatBinary(const T &object)
+    {
+        C ret;
+        impl::Flat::Writer<C> writer{ret};
+        std::size_t pos = writer.Allocate(impl::Flat::header_size + impl::Flat::Traits<T>::size);
+        writer.WriteScalar(pos, impl::Flat::layout_hash<T>);
+        impl::Flat::Traits<T>::Write(writer, pos + impl::Flat::header_size, object);
+        return ret;
+    }
+}
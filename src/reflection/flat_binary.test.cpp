@@ -0,0 +1,92 @@
+#include "reflection/flat_binary.h"
+
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "reflection/full.h"
+#include "utils/mat.h"
+
+namespace
+{
+    REFL_ENUM( Rarity REFL_ENUM_CLASS, (common)(rare) )
+
+    REFL_STRUCT( Stats REFL_TERSE
+        REFL_DECL(int) attack
+        REFL_DECL(float) weight
+    )
+
+    REFL_STRUCT( Item REFL_EXTENDS Stats REFL_TERSE
+        REFL_DECL(std::string) name
+        REFL_DECL(Rarity) rarity
+        REFL_DECL(bool) stackable
+        REFL_DECL(fvec2) icon_pos
+        REFL_DECL(std::vector<std::string>) tags
+        REFL_DECL(std::map<int, float>) prices
+    )
+
+    [[nodiscard]] std::vector<Item> MakeItems()
+    {
+        std::vector<Item> ret;
+        for (int i = 0; i < 100; i++)
+        {
+            Item &item = ret.emplace_back();
+            item.attack = i;
+            item.weight = i * 0.5f;
+            item.name = "item_" + std::to_string(i);
+            item.rarity = i % 3 ? Rarity::common : Rarity::rare;
+            item.stackable = i % 2;
+            item.icon_pos = fvec2(i, -i);
+            for (int j = 0; j < i % 4; j++)
+                item.tags.push_back("tag_" + std::to_string(j));
+            item.prices[i] = i * 10.f;
+        }
+        return ret;
+    }
+}
+
+TEST_CASE("reflection.flat_binary")
+{
+    std::vector<Item> items = MakeItems();
+    std::vector<std::uint8_t> bytes = Refl::ToFlatBinary<std::vector<std::uint8_t>>(items);
+
+    Refl::FlatBinary<std::vector<Item>> flat(Stream::ReadOnlyData::mem_reference(bytes));
+    Refl::FlatView<std::vector<Item>> root = flat.Root();
+    REQUIRE(root.size() == items.size());
+
+    std::size_t i = 0;
+    for (Refl::FlatView<Item> item : root)
+    {
+        const Item &expected = items[i++];
+        REQUIRE(item.base<Stats>().get<"attack">() == expected.attack);
+        REQUIRE(item.base<Stats>().get<"weight">() == expected.weight);
+        REQUIRE(item.get<"name">() == expected.name);
+        REQUIRE(item.get<"rarity">() == expected.rarity);
+        REQUIRE(item.get<"stackable">() == expected.stackable);
+        REQUIRE(item.get<"icon_pos">().Load() == expected.icon_pos);
+        REQUIRE(item.get<"tags">().size() == expected.tags.size());
+        for (std::size_t j = 0; j < expected.tags.size(); j++)
+            REQUIRE(item.get<"tags">()[j] == expected.tags[j]);
+        REQUIRE(item.get<"prices">().Load() == expected.prices);
+    }
+
+    Item loaded = root[42].Load();
+    REQUIRE(loaded.name == "item_42");
+    REQUIRE(loaded.attack == 42);
+    REQUIRE(loaded.tags == items[42].tags);
+
+    REQUIRE(root.Load().size() == items.size());
+
+    // A different layout is rejected.
+    REQUIRE_THROWS_AS(Refl::FlatBinary<std::vector<Stats>>(Stream::ReadOnlyData::mem_reference(bytes)), std::runtime_error);
+
+    // So are the offsets pointing outside of the buffer.
+    std::vector<std::uint8_t> broken = bytes;
+    broken[4] = 0xff; // The offset of the root vector.
+    broken[7] = 0xff;
+    REQUIRE_THROWS_AS(Refl::FlatBinary<std::vector<Item>>(Stream::ReadOnlyData::mem_reference(broken)).Root(), std::runtime_error);
+}
@@ -2,16 +2,22 @@
 
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <optional>
+#include <stdexcept>
 #include <string_view>
 #include <string>
 #include <type_traits>
 #include <utility>
 
 #include "meta/common.h"
+#include "meta/constexpr_hash.h"
+#include "meta/type_info.h"
 #include "reflection/utils.h"
 #include "stream/input.h"
 #include "stream/output.h"
+#include "utils/byte_order.h"
 
 namespace Refl
 {
@@ -44,6 +50,11 @@ namespace Refl
         // This prevents malformed serialized data from causing
         // too much temporary memory to be allocated.
         std::size_t max_reserved_size = 1024 * 1024;
+
+        // Only affects the structs with the `Refl::BinarySections` attribute.
+        // If set, the members for which this returns false are skipped without decoding, and keep their old values.
+        // Receives `Meta::TypeName()` of the struct and the member name.
+        std::function<bool(std::string_view type_name, std::string_view member_name)> load_section;
     };
 
 
@@ -202,6 +213,62 @@ namespace Refl
         // that all nested objects have this flag set too), otherwise conversion to string can yield weird results.
         template <typename T, typename = void>
         struct HasShortStringRepresentation : std::false_type {};
+
+        // Specialize this for types that `ToBinary()` writes as their exact memory representation, and for which `FromBinary()` accepts any bytes.
+        // Such types (and contiguous containers of them) are then [de]serialized with a single copy. See `IsPlainBinary()`.
+        // The layout of reflected structs can't be fully checked at compile-time, so `maybe` is a compile-time approximation,
+        //   and `Check()` makes the final decision. It receives an arbitrary object of this type, to examine its layout.
+        template <typename T, typename = void>
+        struct PlainBinary
+        {
+            static constexpr bool maybe = false;
+            [[nodiscard]] static bool Check(const T &sample) {(void)sample; return false;}
+        };
+
+        // Whether `T` can be [de]serialized by copying its bytes. `sample` is an arbitrary object of this type.
+        // The result of `PlainBinary<T>::Check()` is cached, so this is cheap.
+        template <typename T>
+        [[nodiscard]] bool IsPlainBinary(const T &sample)
+        {
+            if constexpr (!PlainBinary<T>::maybe)
+            {
+                (void)sample;
+                return false;
+            }
+            else
+            {
+                static const bool ret = PlainBinary<T>::Check(sample);
+                return ret;
+            }
+        }
+
+        // Describes the binary representation of `T`, see `SchemaHash()`.
+        // Specialize this along with `SelectInterface`, combining the hashes of the nested types with `CombineSchemaHash()`.
+        // The default uses the type name, which is exact but compiler-specific.
+        template <typename T, typename = void>
+        struct BinarySchema
+        {
+            static constexpr Meta::hash_t hash = Meta::TypeHash<T>();
+        };
+
+        [[nodiscard]] constexpr Meta::hash_t CombineSchemaHash(Meta::hash_t seed, Meta::hash_t value)
+        {
+            const char bytes[4] = {char(value), char(value >> 8), char(value >> 16), char(value >> 24)};
+            return Meta::const_hash(bytes, 4, seed);
+        }
+
+        // The header that `ToBinaryWithSchema()` writes.
+        using schema_hash_binary_t = std::uint32_t;
+        inline constexpr auto schema_hash_byte_order = ByteOrder::little;
+    }
+
+    // A compile-time hash of the binary representation of `T`: the member names and types of the structs, the kinds of the containers, and so on.
+    // If it changes, the old data produced by `ToBinary()` can't be loaded (except the `BinarySections` structs, which tolerate added and removed members).
+    // Recursive types are not supported, except through `Poly::Storage`.
+    template <typename T>
+    [[nodiscard]] constexpr Meta::hash_t SchemaHash()
+    {
+        return impl::BinarySchema<std::remove_cv_t<T>>::hash;
     }
 
 
@@ -213,6 +280,8 @@ namespace Refl
     };
 
     // Constructs an interface for a type.
+    // The interfaces are returned by value and the concrete ones are `final`, so the calls on them are dispatched statically
+    //   and can be inlined all the way down. Only `Poly::Storage` dispatches at runtime, since the dynamic type isn't known in advance.
     template <typename T>
     auto Interface() -> typename impl::SelectInterface<std::remove_cv_t<T>>::type
     {
@@ -226,6 +295,19 @@ namespace Refl
     };
 
 
+    namespace impl
+    {
+        // Returns a stream appending to `container`. Prefers the direct-write mode, which skips the intermediate buffer.
+        template <typename C>
+        [[nodiscard]] Stream::Output OutputToContainer(C &container)
+        {
+            if constexpr (requires{Stream::Output::ContainerDirect(container);})
+                return Stream::Output::ContainerDirect(container);
+            else
+                return Stream::Output::Container(container);
+        }
+    }
+
     inline namespace Shorthands
     {
         // The functions below use this wrapper for safery and convenience.
@@ -270,7 +352,7 @@ namespace Refl
         [[nodiscard]] std::string ToString(const T &object, const ToStringOptions &options = {})
         {
             std::string ret;
-            Stream::Output output = Stream::Output::Container(ret);
+            Stream::Output output = impl::OutputToContainer(ret);
             ToString(object, output, options);
             output.Flush();
             return ret;
@@ -304,7 +386,7 @@ namespace Refl
         [[nodiscard]] C ToBinary(const T &object, const ToBinaryOptions &options = {})
         {
             C ret;
-            Stream::Output output = Stream::Output::Container(ret);
+            Stream::Output output = impl::OutputToContainer(ret);
             ToBinary(object, output, options);
             output.Flush();
             return ret;
@@ -325,6 +407,48 @@ namespace Refl
             FromBinary(ret, std::move(input), options);
             return ret;
         }
+
+        // Same as `ToBinary()`, but prepends the `SchemaHash()` of `T`.
+        template <reflected T>
+        void ToBinaryWithSchema(const T &object, Stream::Output &output, const ToBinaryOptions &options = {})
+        {
+            output.WriteWithByteOrder<impl::schema_hash_binary_t>(impl::schema_hash_byte_order, SchemaHash<T>());
+            ToBinary(object, output, options);
+        }
+        template <typename C, reflected T> requires requires(C c){Stream::Output::Container(c);}
+        [[nodiscard]] C ToBinaryWithSchema(const T &object, const ToBinaryOptions &options = {})
+        {
+            C ret;
+            Stream::Output output = impl::OutputToContainer(ret);
+            ToBinaryWithSchema(object, output, options);
+            output.Flush();
+            return ret;
+        }
+
+        // Reads the header written by `ToBinaryWithSchema()`, and returns true if it matches `T`. Doesn't read anything else.
+        // This is a cheap way to check the compatibility of the data.
+        template <reflected T>
+        [[nodiscard]] bool CheckBinarySchema(Stream::Input &input)
+        {
+            return input.ReadWithByteOrder<impl::schema_hash_binary_t>(impl::schema_hash_byte_order) == SchemaHash<T>();
+        }
+
+        // Reads the data written by `ToBinaryWithSchema()`. Throws if the schema hash doesn't match.
+        template <reflected T>
+        void FromBinaryWithSchema(T &object, InputStreamWrapper input, const FromBinaryOptions &options = {})
+        {
+            input.stream.WantLocationStyle(Stream::byte_offset);
+            if (!CheckBinarySchema<T>(input.stream))
+                throw std::runtime_error(input.stream.GetExceptionPrefix() + "The binary data has an incompatible schema.");
+            FromBinary(object, std::move(input), options);
+        }
+        template <reflected T> requires std::default_initializable<T>
+        [[nodiscard]] T FromBinaryWithSchema(InputStreamWrapper input, const FromBinaryOptions &options = {})
+        {
+            T ret{};
+            FromBinaryWithSchema(ret, std::move(input), options);
+            return ret;
+        }
     }
 }
 
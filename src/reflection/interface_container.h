@@ -1,8 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <ranges>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -70,6 +75,31 @@ namespace Refl
 
 
         void ToString(const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state) const override
+        {
+            ToStringLow(object, output, options, state, [&](auto &&func){ForEach(object, func);});
+        }
+
+        void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
+        {
+            FromStringLow(object, input, options, state, [&](mutable_elem_t &&elem){PushBack(object, std::move(elem));});
+        }
+
+        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        {
+            ToBinaryLow(object, output, options, state, [&](auto &&func){ForEach(object, func);});
+        }
+
+        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        {
+            FromBinaryLow(object, input, options, state, [&](mutable_elem_t &&elem){PushBack(object, std::move(elem));});
+        }
+
+      protected:
+        // The implementations of the functions above, parametrized by the iteration and insertion.
+        // `for_each(func)` must call `func(const elem_t &)` for every element, and `push_back(mutable_elem_t &&)` must insert one.
+        // The derived classes that know the container type pass direct loops here, to avoid the virtual call and the `std::function` per element.
+
+        void ToStringLow(const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state, auto &&for_each) const
         {
             constexpr bool force_single_line = impl::HasShortStringRepresentation<elem_t>::value;
 
@@ -78,7 +108,7 @@ namespace Refl
             auto next_state = state.MemberOrElem(options);
 
             std::size_t index = 0, size = Size(object);
-            ForEach(object, [&](const elem_t &elem)
+            for_each([&](const elem_t &elem)
             {
                 if (options.pretty && !force_single_line)
                     output.WriteChar('\n').WriteChar(' ', state.CurIndent() + options.indent);
@@ -101,7 +131,7 @@ namespace Refl
             output.WriteChar(']');
         }
 
-        void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
+        void FromStringLow(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state, auto &&push_back) const
         {
             Clear(object);
 
@@ -120,7 +150,7 @@ namespace Refl
 
                 try
                 {
-                    PushBack(object, std::move(elem));
+                    push_back(std::move(elem));
                 }
                 catch (std::exception &e)
                 {
@@ -137,22 +167,22 @@ namespace Refl
             }
         }
 
-        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        void ToBinaryLow(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state, auto &&for_each) const
         {
             impl::container_length_binary_t len;
-            if (Robust::conversion_fails(object.size(), len))
+            if (Robust::conversion_fails(Size(object), len))
                 throw std::runtime_error(output.GetExceptionPrefix() + "The container is too long.");
             output.WriteWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order, len);
 
             auto next_state = state.MemberOrElem(options);
 
-            ForEach(object, [&](const elem_t &elem)
+            for_each([&](const elem_t &elem)
             {
                 Interface<mutable_elem_t>().ToBinary(elem, output, options, next_state);
             });
         }
 
-        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        void FromBinaryLow(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state, auto &&push_back) const
         {
             std::size_t len;
             if (Robust::conversion_fails(input.ReadWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order), len))
@@ -172,7 +202,7 @@ namespace Refl
 
                 try
                 {
-                    PushBack(object, std::move(elem));
+                    push_back(std::move(elem));
                 }
                 catch (std::exception &e)
                 {
@@ -216,8 +246,31 @@ namespace Refl
     {
         static constexpr bool has_push_back = Meta::is_detected<impl::StdContainer::has_push_back, T>;
 
+        // Whether we can copy the elements in bulk, if they're plain (see `impl::PlainBinary`).
+        static constexpr bool maybe_plain_binary = []{
+            if constexpr (std::ranges::contiguous_range<T> && requires(T &t){t.resize(std::size_t{});})
+                return impl::PlainBinary<std::ranges::range_value_t<T>>::maybe;
+            else
+                return false;
+        }();
+
+        // The non-virtual versions of `PushBack()` and `ForEach()`, which the serialization functions below use directly.
+        static void PushBackLow(T &object, auto &&elem)
+        {
+            if constexpr (has_push_back)
+                object.push_back(std::forward<decltype(elem)>(elem));
+            else
+                object.insert(std::forward<decltype(elem)>(elem));
+        }
+        static void ForEachLow(const T &object, auto &&func)
+        {
+            for (auto it = object.begin(); it != object.end(); it++)
+                func(*it);
+        }
+
       public:
         using typename Interface_BasicContainer<T>::elem_t;
+        using typename Interface_BasicContainer<T>::mutable_elem_t;
 
         [[nodiscard]] virtual std::size_t Size(const T &object) const override
         {
@@ -239,16 +292,69 @@ namespace Refl
 
         virtual void PushBack(T &object, elem_t &&elem) const override
         {
-            if constexpr (has_push_back)
-                object.push_back(std::move(elem));
-            else
-                object.insert(std::move(elem));
+            PushBackLow(object, std::move(elem));
         }
 
         virtual void ForEach(const T &object, std::function<void(const elem_t &elem)> func) const override
         {
-            for (auto it = object.begin(); it != object.end(); it++)
-                func(*it);
+            ForEachLow(object, func);
+        }
+
+        void ToString(const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state) const override
+        {
+            this->ToStringLow(object, output, options, state, [&](auto &&func){ForEachLow(object, func);});
+        }
+
+        void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
+        {
+            this->FromStringLow(object, input, options, state, [&](mutable_elem_t &&elem){PushBackLow(object, std::move(elem));});
+        }
+
+        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        {
+            if constexpr (maybe_plain_binary)
+            {
+                if (object.size() > 0 && impl::IsPlainBinary(*object.begin()))
+                {
+                    impl::container_length_binary_t len;
+                    if (Robust::conversion_fails(object.size(), len))
+                        throw std::runtime_error(output.GetExceptionPrefix() + "The container is too long.");
+                    output.WriteWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order, len);
+                    output.WriteBytes(reinterpret_cast<const std::uint8_t *>(std::to_address(object.begin())), object.size() * sizeof(elem_t));
+                    return;
+                }
+            }
+
+            this->ToBinaryLow(object, output, options, state, [&](auto &&func){ForEachLow(object, func);});
+        }
+
+        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        {
+            if constexpr (maybe_plain_binary)
+            {
+                if (impl::IsPlainBinary(elem_t{}))
+                {
+                    std::size_t len;
+                    if (Robust::conversion_fails(input.ReadWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order), len))
+                        throw std::runtime_error(input.GetExceptionPrefix() + "The string is too long.");
+
+                    Clear(object);
+
+                    // Read in batches, so that a malformed length can't make us allocate too much memory before the input runs out.
+                    std::size_t max_batch_elems = std::max(std::size_t(1), options.max_reserved_size / sizeof(elem_t));
+                    while (len > 0)
+                    {
+                        std::size_t batch = std::min(len, max_batch_elems);
+                        std::size_t old_size = object.size();
+                        object.resize(old_size + batch);
+                        input.Read(reinterpret_cast<std::uint8_t *>(std::to_address(object.begin()) + old_size), batch * sizeof(elem_t));
+                        len -= batch;
+                    }
+                    return;
+                }
+            }
+
+            this->FromBinaryLow(object, input, options, state, [&](mutable_elem_t &&elem){PushBackLow(object, std::move(elem));});
         }
     };
 
@@ -258,6 +364,13 @@ namespace Refl
         using type = Interface_StdContainer<T>;
     };
 
+    // Sets and sequences are interchangeable, since they're stored in the same way.
+    template <typename T>
+    struct impl::BinarySchema<T, std::enable_if_t<impl::StdContainer::is_container<T>>>
+    {
+        static constexpr Meta::hash_t hash = impl::CombineSchemaHash(Meta::const_hash("container"), SchemaHash<typename impl::MakeMutable<typename impl::ContainerElem<T>::type>::type>());
+    };
+
     template <typename T>
     struct impl::ContainerElem<T, std::enable_if_t<Meta::is_detected<impl::StdContainer::has_sane_begin_end, T>>> // Note that we can't use `impl::StdContainer::is_container<T>` here, since it relies on `ContainerElem`.
     {
@@ -116,7 +116,7 @@ namespace Refl
     }
 
     template <typename T>
-    class Interface_Enum : public InterfaceBasic<T>
+    class Interface_Enum final : public InterfaceBasic<T>
     {
         using underlying = std::underlying_type_t<T>;
 
@@ -200,6 +200,13 @@ namespace Refl
 
     template <typename T>
     struct impl::HasShortStringRepresentation<T, Meta::void_type<impl::Enum::detect_enum<T>>> : std::true_type {};
+
+    // The enum values are not included, since renaming or adding them doesn't affect the old data.
+    template <typename T>
+    struct impl::BinarySchema<T, Meta::void_type<impl::Enum::detect_enum<T>>>
+    {
+        static constexpr Meta::hash_t hash = impl::CombineSchemaHash(Meta::const_hash("enum"), SchemaHash<std::underlying_type_t<T>>());
+    };
 }
 
 
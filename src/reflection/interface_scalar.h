@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <exception>
+#include <span>
+#include <string>
 #include <type_traits>
 
 #include "reflection/interface_basic.h"
@@ -11,10 +15,32 @@ namespace Refl
     namespace impl
     {
         inline constexpr auto scalar_byte_order = ByteOrder::little;
+
+        // The characters that can appear in a number. Has a lookup table, because numbers are by far the most common thing to parse.
+        template <bool IsFloat>
+        struct ScalarChars : Stream::Char::Category
+        {
+            [[nodiscard]] static bool Matches(char ch)
+            {
+                bool ok = Stream::Char::IsAlphaOrDigit{}(ch) || ch == '+' || ch == '-' || ch == Strings::CharDigitSeparator();
+                if constexpr (IsFloat)
+                    ok = ok || ch == '.' || ch == Strings::CharLongDoublePartsSeparator();
+                return ok;
+            }
+
+            [[nodiscard]] bool operator()(char ch) const override {return Matches(ch);}
+            [[nodiscard]] std::string name() const override {return IsFloat ? "a real number" : "an integer";}
+
+            [[nodiscard]] const Stream::Char::LookupTable *GetLookupTable() const override
+            {
+                static const Stream::Char::LookupTable ret(Matches);
+                return &ret;
+            }
+        };
     }
 
     template <typename T>
-    class Interface_Scalar : public InterfaceBasic<T>
+    class Interface_Scalar final : public InterfaceBasic<T>
     {
       public:
         void ToString(const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state) const override
@@ -22,9 +48,12 @@ namespace Refl
             (void)options;
             (void)state;
 
-            char buf[Strings::ToStringMaxBufferLen()];
-            Strings::ToString(buf, sizeof buf, object);
-            output.WriteString(buf);
+            // Format directly into the stream buffer, to avoid a copy.
+            std::span<std::uint8_t> span = output.GetWriteSpan(Strings::ToStringMaxBufferLen());
+            char *buf = reinterpret_cast<char *>(span.data());
+            if (!Strings::ToString(buf, span.size(), object))
+                *buf = '\0';
+            output.Commit(std::strlen(buf));
         }
 
         void FromString(T &object, Stream::Input &input, const FromStringOptions &options, impl::FromStringState state) const override
@@ -32,15 +61,7 @@ namespace Refl
             (void)options;
             (void)state;
 
-            constexpr bool is_fp = std::is_floating_point_v<T>;
-
-            auto category = Stream::Char::Is(is_fp ? "a real number" : "an integer", [](char ch)
-            {
-                bool ok = Stream::Char::IsAlphaOrDigit{}(ch) || ch == '+' || ch == '-' || ch == Strings::CharDigitSeparator();
-                if constexpr (is_fp)
-                    ok = ok || ch == '.' || ch == Strings::CharLongDoublePartsSeparator();
-                return ok;
-            });
+            impl::ScalarChars<std::is_floating_point_v<T>> category;
 
             std::string str = input.Extract(category);
             try
@@ -78,4 +99,19 @@ namespace Refl
 
     template <typename T>
     struct impl::HasShortStringRepresentation<T, std::enable_if_t<std::is_arithmetic_v<T>>> : std::true_type {};
+
+    template <typename T>
+    struct impl::PlainBinary<T, std::enable_if_t<std::is_arithmetic_v<T>>>
+    {
+        // `bool` is excluded because not every byte is a valid `bool`, and `long double` because of its padding.
+        static constexpr bool maybe = ByteOrder::native == impl::scalar_byte_order && !std::is_same_v<T, bool> && !std::is_same_v<T, long double>;
+        [[nodiscard]] static bool Check(const T &sample) {(void)sample; return maybe;}
+    };
+
+    // Only the kind and the size matter, so e.g. `long` and `long long` of the same size are interchangeable.
+    template <typename T>
+    struct impl::BinarySchema<T, std::enable_if_t<std::is_arithmetic_v<T>>>
+    {
+        static constexpr Meta::hash_t hash = Meta::const_hash(std::is_same_v<T, bool> ? "bool" : std::is_floating_point_v<T> ? "float" : std::is_signed_v<T> ? "int" : "uint", sizeof(T));
+    };
 }
@@ -10,7 +10,7 @@
 namespace Refl
 {
     template <typename T>
-    class Interface_StdOptional : public InterfaceBasic<T>
+    class Interface_StdOptional final : public InterfaceBasic<T>
     {
         using elem_t = typename T::value_type;
       public:
@@ -93,4 +93,10 @@ namespace Refl
 
     template <typename U>
     struct impl::HasShortStringRepresentation<std::optional<U>> : impl::HasShortStringRepresentation<U> {};
+
+    template <typename U>
+    struct impl::BinarySchema<std::optional<U>>
+    {
+        static constexpr Meta::hash_t hash = impl::CombineSchemaHash(Meta::const_hash("optional"), SchemaHash<U>());
+    };
 }
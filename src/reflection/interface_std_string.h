@@ -13,7 +13,7 @@
 
 namespace Refl
 {
-    class Interface_StdString : public InterfaceBasic<std::string>
+    class Interface_StdString final : public InterfaceBasic<std::string>
     {
       public:
         void ToString(const std::string &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state) const override
@@ -78,10 +78,27 @@ namespace Refl
             if (Robust::conversion_fails(input.ReadWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order), len))
                 throw std::runtime_error(input.GetExceptionPrefix() + "The string is too long.");
 
+            if (input.IsContiguous())
+            {
+                // This throws if there's not enough data, before we allocate anything. Doesn't copy anything either.
+                auto bytes = input.PeekSpan(len);
+                object.assign(bytes.begin(), bytes.end());
+                input.Skip(len);
+                return;
+            }
+
+            // The size of other streams can be untrusted (e.g. it comes from a compressed file), so don't allocate more than we've actually read.
+            constexpr std::size_t chunk_size = 4096;
             object = {};
             object.reserve(len < options.max_reserved_size ? len : options.max_reserved_size);
-            while (len-- > 0)
-                object += input.ReadChar();
+            while (len > 0)
+            {
+                std::size_t old_size = object.size();
+                std::size_t this_chunk = len < chunk_size ? len : chunk_size;
+                object.resize(old_size + this_chunk);
+                input.Read(object.data() + old_size, this_chunk);
+                len -= this_chunk;
+            }
         }
     };
 
@@ -93,4 +110,10 @@ namespace Refl
 
     template <>
     struct impl::ForceNotContainer<std::string> : std::true_type {};
+
+    template <typename T>
+    struct impl::BinarySchema<T, std::enable_if_t<std::is_same_v<T, std::string>>>
+    {
+        static constexpr Meta::hash_t hash = Meta::const_hash("string");
+    };
 }
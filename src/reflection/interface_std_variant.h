@@ -22,7 +22,7 @@ namespace Refl
     }
 
     template <typename T>
-    class Interface_StdVariant : public InterfaceBasic<T>
+    class Interface_StdVariant final : public InterfaceBasic<T>
     {
         static_assert(Robust::less_eq(std::variant_size_v<T>, std::numeric_limits<impl::variant_index_binary_t>::max()), "The variant is too large.");
 
@@ -137,4 +137,14 @@ namespace Refl
 
     template <typename ...P>
     struct impl::HasShortStringRepresentation<std::variant<P...>> : std::bool_constant<(impl::HasShortStringRepresentation<P>::value && ...)> {};
+
+    template <typename ...P>
+    struct impl::BinarySchema<std::variant<P...>>
+    {
+        static constexpr Meta::hash_t hash = []{
+            Meta::hash_t ret = Meta::const_hash("variant");
+            ((ret = impl::CombineSchemaHash(ret, SchemaHash<P>())), ...);
+            return ret;
+        }();
+    };
 }
@@ -4,7 +4,9 @@
 #include <array>
 #include <cctype>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
+#include <string>
 #include <string_view>
 #include <type_traits>
 #include <utility>
@@ -12,11 +14,13 @@
 #include "macros/generated.h"
 #include "macros/named_macro_parameters.h"
 #include "meta/common.h"
+#include "meta/constexpr_hash.h"
 #include "meta/lists.h"
 #include "reflection/interface_basic.h"
 #include "reflection/structs.h"
 #include "strings/common.h"
 #include "strings/format.h"
+#include "utils/robust_math.h"
 
 namespace Refl
 {
@@ -74,8 +78,44 @@ namespace Refl
     template <typename T>
     struct StructCallbacks : DefaultStructCallbacks<T> {};
 
+    namespace impl::Class
+    {
+        // Whether the members of `T` are written as sections, see `Refl::BinarySections`.
+        template <typename T> inline constexpr bool binary_sections = Refl::Class::class_has_attrib<T, BinarySections>;
+
+        // The keys of the member sections, zero for skipped members.
+        template <typename T> constexpr auto section_keys = []{
+            static_assert(Refl::Class::member_names_known<T>, "`Refl::BinarySections` requires the member names to be known.");
+            std::array<Meta::hash_t, Refl::Class::member_count<T>> ret{};
+            Meta::const_for<Refl::Class::member_count<T>>([&](auto index)
+            {
+                if constexpr (!skip_member<Refl::Class::member_type<T, index.value>>)
+                    ret[index.value] = Meta::const_hash(Refl::Class::MemberName<T>(index.value));
+            });
+            return ret;
+        }();
+        template <typename T> constexpr bool section_keys_unique = []{
+            constexpr auto &keys = section_keys<T>;
+            for (std::size_t i = 0; i < keys.size(); i++)
+            {
+                for (std::size_t j = 0; j < i; j++)
+                {
+                    if (keys[i] != 0 && keys[i] == keys[j])
+                        return false;
+                }
+            }
+            return true;
+        }();
+
+        // Binary section headers.
+        using section_count_binary_t = std::uint32_t;
+        using section_key_binary_t = std::uint32_t;
+        using section_length_binary_t = std::uint32_t;
+        inline constexpr auto section_byte_order = ByteOrder::little;
+    }
+
     template <typename T>
-    class Interface_Struct : public InterfaceBasic<T>
+    class Interface_Struct final : public InterfaceBasic<T>
     {
       public:
         void ToString(const T &object, Stream::Output &output, const ToStringOptions &options, impl::ToStringState state) const override
@@ -453,6 +493,12 @@ namespace Refl
 
         void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
         {
+            if (impl::IsPlainBinary(object))
+            {
+                output.WriteBytes(reinterpret_cast<const std::uint8_t *>(&object), sizeof(T));
+                return;
+            }
+
             // Initial callback.
             try
             {
@@ -495,13 +541,45 @@ namespace Refl
             });
 
             // Write members.
-            Meta::const_for<Class::member_count<T>>([&](auto index)
+            if constexpr (impl::Class::binary_sections<T>)
             {
-                constexpr auto i = index.value;
-                using type = const Class::member_type<T, i>;
-                if constexpr (!impl::Class::skip_member<type>)
-                    WriteEntry(Class::Member<i>(object), next_member_state);
-            });
+                static_assert(impl::Class::section_keys_unique<T>, "Member name hash collision. Rename one of the members.");
+                constexpr auto &keys = impl::Class::section_keys<T>;
+                output.WriteWithByteOrder<impl::Class::section_count_binary_t>(impl::Class::section_byte_order, std::count_if(keys.begin(), keys.end(), [](Meta::hash_t key){return key != 0;}));
+
+                std::string buffer;
+                Meta::const_for<Class::member_count<T>>([&](auto index)
+                {
+                    constexpr auto i = index.value;
+                    using type = const Class::member_type<T, i>;
+                    if constexpr (!impl::Class::skip_member<type>)
+                    {
+                        // Serialize to a buffer first, to know the length.
+                        buffer.clear();
+                        Stream::Output section_output = Stream::Output::Container(buffer);
+                        const auto &ref = Class::Member<i>(object);
+                        InterfaceFor(ref).ToBinary(ref, section_output, options, next_member_state); // A qualified call prevents unwanted ADL.
+                        section_output.Flush();
+
+                        impl::Class::section_length_binary_t len;
+                        if (Robust::conversion_fails(buffer.size(), len))
+                            throw std::runtime_error(FMT("{}The member `{}` is too large.", output.GetExceptionPrefix(), Class::MemberName<T>(i)));
+                        output.WriteWithByteOrder<impl::Class::section_key_binary_t>(impl::Class::section_byte_order, keys[i]);
+                        output.WriteWithByteOrder<impl::Class::section_length_binary_t>(impl::Class::section_byte_order, len);
+                        output.WriteString(buffer);
+                    }
+                });
+            }
+            else
+            {
+                Meta::const_for<Class::member_count<T>>([&](auto index)
+                {
+                    constexpr auto i = index.value;
+                    using type = const Class::member_type<T, i>;
+                    if constexpr (!impl::Class::skip_member<type>)
+                        WriteEntry(Class::Member<i>(object), next_member_state);
+                });
+            }
 
             // Final callback.
             try
@@ -516,6 +594,12 @@ namespace Refl
 
         void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
         {
+            if (impl::IsPlainBinary(object))
+            {
+                input.Read(reinterpret_cast<std::uint8_t *>(&object), sizeof(T));
+                return;
+            }
+
             // Initial callback.
             try
             {
@@ -557,14 +641,47 @@ namespace Refl
                     ReadEntry(*static_cast<base_type *>(&object), next_base_state);
             });
 
-            // Write members.
-            Meta::const_for<Class::member_count<T>>([&](auto index)
+            // Read members.
+            if constexpr (impl::Class::binary_sections<T>)
             {
-                constexpr auto i = index.value;
-                using type = const Class::member_type<T, i>;
-                if constexpr (!impl::Class::skip_member<type>)
-                    ReadEntry(Class::Member<i>(object), next_member_state);
-            });
+                static_assert(impl::Class::section_keys_unique<T>, "Member name hash collision. Rename one of the members.");
+                constexpr auto &keys = impl::Class::section_keys<T>;
+                auto count = input.ReadWithByteOrder<impl::Class::section_count_binary_t>(impl::Class::section_byte_order);
+                while (count-- > 0)
+                {
+                    auto key = input.ReadWithByteOrder<impl::Class::section_key_binary_t>(impl::Class::section_byte_order);
+                    std::size_t len = input.ReadWithByteOrder<impl::Class::section_length_binary_t>(impl::Class::section_byte_order);
+
+                    // The unknown sections could belong to the members that were removed since the data was written.
+                    std::size_t member_index = key == 0 ? keys.size() : std::size_t(std::find(keys.begin(), keys.end(), key) - keys.begin());
+                    if (member_index == keys.size() || (options.load_section && !options.load_section(Meta::TypeName<T>(), Class::MemberName<T>(member_index))))
+                    {
+                        input.Skip(len);
+                        continue;
+                    }
+
+                    std::size_t start = input.Position();
+                    Meta::with_const_value<Class::member_count<T>>(member_index, [&](auto index)
+                    {
+                        constexpr auto i = index.value;
+                        using type = const Class::member_type<T, i>;
+                        if constexpr (!impl::Class::skip_member<type>)
+                            ReadEntry(Class::Member<i>(object), next_member_state);
+                    });
+                    if (input.Position() - start != len)
+                        throw std::runtime_error(FMT("{}The length of the member `{}` doesn't match the data.", input.GetExceptionPrefix(), Class::MemberName<T>(member_index)));
+                }
+            }
+            else
+            {
+                Meta::const_for<Class::member_count<T>>([&](auto index)
+                {
+                    constexpr auto i = index.value;
+                    using type = const Class::member_type<T, i>;
+                    if constexpr (!impl::Class::skip_member<type>)
+                        ReadEntry(Class::Member<i>(object), next_member_state);
+                });
+            }
 
             // Final callback.
             try
@@ -584,6 +701,90 @@ namespace Refl
         using type = Interface_Struct<T>;
     };
 
+    // A struct is plain if it has no padding, no bases, no custom callbacks, all its members are plain, and they're laid out in the order they're serialized in.
+    template <typename T>
+    struct impl::PlainBinary<T, std::enable_if_t<Class::members_known<T>>>
+    {
+        static constexpr bool maybe = []{
+            if constexpr (!std::is_trivially_copyable_v<T> || std::is_polymorphic_v<T> || Meta::list_size<Refl::Class::combined_bases<T>> != 0 || impl::Class::binary_sections<T>)
+            {
+                return false;
+            }
+            else
+            {
+                if (&StructCallbacks<T>::PreSerialize != &DefaultStructCallbacks<T>::PreSerialize ||
+                    &StructCallbacks<T>::PostSerialize != &DefaultStructCallbacks<T>::PostSerialize ||
+                    &StructCallbacks<T>::PreDeserialize != &DefaultStructCallbacks<T>::PreDeserialize ||
+                    &StructCallbacks<T>::PostDeserialize != &DefaultStructCallbacks<T>::PostDeserialize)
+                    return false;
+
+                bool ret = true;
+                std::size_t size = 0;
+                Meta::const_for<Refl::Class::member_count<T>>([&](auto index)
+                {
+                    using type = std::remove_cv_t<Refl::Class::member_type<T, index.value>>;
+                    if (impl::Class::skip_member<type> || !impl::PlainBinary<type>::maybe)
+                        ret = false;
+                    size += sizeof(type);
+                });
+                return ret && size == sizeof(T);
+            }
+        }();
+
+        [[nodiscard]] static bool Check(const T &sample)
+        {
+            if constexpr (!maybe)
+            {
+                (void)sample;
+                return false;
+            }
+            else
+            {
+                // `maybe` has already checked that the member sizes add up to the struct size, so only the offsets remain.
+                bool ret = true;
+                std::size_t offset = 0;
+                Meta::const_for<Refl::Class::member_count<T>>([&](auto index)
+                {
+                    const auto &member = Refl::Class::Member<index.value>(sample);
+                    if (std::size_t(reinterpret_cast<const char *>(&member) - reinterpret_cast<const char *>(&sample)) != offset || !impl::IsPlainBinary(member))
+                        ret = false;
+                    offset += sizeof(member);
+                });
+                return ret;
+            }
+        }
+    };
+
+    // The member names are included if known, so renaming a member changes the hash.
+    template <typename T>
+    struct impl::BinarySchema<T, std::enable_if_t<Class::members_known<T>>>
+    {
+        static constexpr Meta::hash_t hash = []{
+            Meta::hash_t ret = Meta::const_hash(impl::Class::binary_sections<T> ? "struct_with_sections" : "struct");
+
+            using combined_bases = Refl::Class::combined_bases<T>;
+            Meta::const_for<Meta::list_size<combined_bases>>([&](auto index)
+            {
+                using base_type = Meta::list_type_at<combined_bases, index.value>;
+                if constexpr (!impl::Class::skip_base<base_type>)
+                    ret = impl::CombineSchemaHash(ret, SchemaHash<base_type>());
+            });
+
+            Meta::const_for<Refl::Class::member_count<T>>([&](auto index)
+            {
+                using type = std::remove_cv_t<Refl::Class::member_type<T, index.value>>;
+                if constexpr (!impl::Class::skip_member<type>)
+                {
+                    if constexpr (Refl::Class::member_names_known<T>)
+                        ret = impl::CombineSchemaHash(ret, Meta::const_hash(Refl::Class::MemberName<T>(index.value)));
+                    ret = impl::CombineSchemaHash(ret, SchemaHash<type>());
+                }
+            });
+
+            return ret;
+        }();
+    };
+
     template <typename T>
     struct impl::HasShortStringRepresentation<T, std::enable_if_t<Class::members_known<T>>>
     {
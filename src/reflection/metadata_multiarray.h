@@ -5,56 +5,59 @@
 #include "reflection/interface_struct.h"
 #include "utils/multiarray.h"
 
-template <int D, typename T, std::signed_integral Index> struct MultiArray<D, T, Index>::ReflHelper
+// The storage is serialized as is, so for non-row-major layouts it's in the layout order and includes the padding.
+template <int D, typename T, std::signed_integral Index, typename Layout> struct MultiArray<D, T, Index, Layout>::ReflHelper
 {
-    static auto &GetSizeVec(MultiArray<D, T> &array)
+    static auto &GetSizeVec(MultiArray &array)
     {
         return array.size_vec;
     }
 
-    static auto &GetStorage(MultiArray<D, T> &array)
+    static auto &GetStorage(MultiArray &array)
     {
         return array.storage;
     }
 
-    static void CheckInvariant(const MultiArray<D, T> &object)
+    static void CheckInvariant(const MultiArray &object)
     {
         if ((object.size_vec < 0).any())
             throw std::runtime_error("Multiarray can't have a negative size.");
 
-        if (std::size_t(object.size_vec.prod()) != object.storage.size())
+        if (StorageSize(object.size_vec) != object.storage.size())
             throw std::runtime_error("Multiarray size doesn't match the number of elements in the storage.");
     }
 };
 
 namespace Refl::Class::Custom
 {
-    template <int D, typename T> struct name<MultiArray<D, T>>
+    template <int D, typename T, typename Layout> struct name<MultiArray<D, T, std::ptrdiff_t, Layout>>
     {
         static constexpr const char *value = "MultiArray";
     };
-    template <int D, typename T> struct members<MultiArray<D, T>>
+    template <int D, typename T, typename Layout> struct members<MultiArray<D, T, std::ptrdiff_t, Layout>>
     {
+        using array_t = MultiArray<D, T, std::ptrdiff_t, Layout>;
+
         static constexpr std::size_t count = 2;
-        template <std::size_t I> static constexpr auto &at(MultiArray<D, T> &object)
+        template <std::size_t I> static constexpr auto &at(array_t &object)
         {
             if constexpr (I == 0)
-                return MultiArray<D, T>::ReflHelper::GetSizeVec(object);
+                return array_t::ReflHelper::GetSizeVec(object);
             else
-                return MultiArray<D, T>::ReflHelper::GetStorage(object);
+                return array_t::ReflHelper::GetStorage(object);
         }
     };
 }
 
-template <int D, typename T>
-struct Refl::StructCallbacks<MultiArray<D, T>> : Refl::DefaultStructCallbacks<MultiArray<D, T>>
+template <int D, typename T, typename Layout>
+struct Refl::StructCallbacks<MultiArray<D, T, std::ptrdiff_t, Layout>> : Refl::DefaultStructCallbacks<MultiArray<D, T, std::ptrdiff_t, Layout>>
 {
-    static void PreSerialize(const MultiArray<D, T> &object)
+    static void PreSerialize(const MultiArray<D, T, std::ptrdiff_t, Layout> &object)
     {
-        MultiArray<D, T>::ReflHelper::CheckInvariant(object);
+        MultiArray<D, T, std::ptrdiff_t, Layout>::ReflHelper::CheckInvariant(object);
     }
-    static void PostDeserialize(MultiArray<D, T> &object)
+    static void PostDeserialize(MultiArray<D, T, std::ptrdiff_t, Layout> &object)
     {
-        MultiArray<D, T>::ReflHelper::CheckInvariant(object);
+        MultiArray<D, T, std::ptrdiff_t, Layout>::ReflHelper::CheckInvariant(object);
     }
 };
@@ -444,7 +444,7 @@ namespace Refl
 
 
     template <typename T>
-    class Interface_Polymorphic : public InterfaceBasic<T>
+    class Interface_Polymorphic final : public InterfaceBasic<T>
     {
         using elem_t = typename T::base_type;
       public:
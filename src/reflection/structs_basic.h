@@ -27,6 +27,11 @@ namespace Refl
         // When used as a field attribute, makes the field optional.
         // When used as a class attribute of a base class, makes the base optional when deserializing a derived class.
         struct Optional : BasicAttribute, BasicClassAttribute {};
+
+        // A class attribute. Affects converting structs to/from binary.
+        // Writes each member as a section prefixed with its name hash and byte length. This allows adding and removing members without breaking the old data,
+        //   and skipping the members without decoding them (see `FromBinaryOptions::load_section`). The bases are written as usual, before the sections.
+        struct BinarySections : BasicClassAttribute {};
     }
 
     namespace impl::Class
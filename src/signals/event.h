@@ -0,0 +1,206 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "macros/finally.h"
+
+namespace Sig
+{
+    // A list of listeners that are called when the event is triggered.
+    // The listeners are stored contiguously as function pointers, so triggering doesn't allocate and doesn't go through `std::function`.
+    // Each listener is owned by a `Connection`, which disconnects it when destroyed.
+    // Not thread-safe. The order of the calls is unspecified.
+    // Connecting and disconnecting from inside of the listeners is allowed. The listeners connected while the event is being triggered are not called until the next time.
+    // Usage:
+    //     Sig::Event<int> on_damage;
+    //     struct Hud {void OnDamage(int amount); Sig::Event<int>::Connection connection;} hud;
+    //     hud.connection = on_damage.Connect<&Hud::OnDamage>(hud);
+    //     on_damage(42);
+    template <typename ...P>
+    class Event
+    {
+      public:
+        class Connection;
+
+      private:
+        struct Entry
+        {
+            void *object = nullptr;
+            void (*func)(void *, P...) = nullptr; // Null if disconnected while triggering, then it's removed afterwards.
+            Connection *connection = nullptr;
+        };
+        std::vector<Entry> entries;
+
+        int trigger_depth = 0;
+        bool has_removed_entries = false;
+
+        [[nodiscard]] Connection AddEntry(void *object, void (*func)(void *, P...))
+        {
+            entries.push_back({.object = object, .func = func});
+            return Connection(this, entries.size() - 1);
+        }
+
+        void RemoveEntry(std::size_t index) noexcept
+        {
+            if (trigger_depth > 0)
+            {
+                // Can't move the entries while triggering, so only mark this one.
+                entries[index].func = nullptr;
+                entries[index].connection = nullptr;
+                has_removed_entries = true;
+                return;
+            }
+
+            if (index != entries.size() - 1)
+            {
+                entries[index] = entries.back();
+                if (entries[index].connection)
+                    entries[index].connection->index = index;
+            }
+            entries.pop_back();
+        }
+
+        void RemoveMarkedEntries() noexcept
+        {
+            has_removed_entries = false;
+            for (std::size_t i = 0; i < entries.size();)
+            {
+                if (entries[i].func)
+                    i++;
+                else
+                    RemoveEntry(i); // This moves the last entry to `i`, so we check it again.
+            }
+        }
+
+      public:
+        // Owns a listener. Disconnects it when destroyed. Must not outlive the event, unless disconnected first.
+        class Connection
+        {
+            friend Event;
+
+            Event *event = nullptr;
+            std::size_t index = 0;
+
+            Connection(Event *event, std::size_t index) : event(event), index(index)
+            {
+                event->entries[index].connection = this;
+            }
+
+          public:
+            Connection() {}
+
+            Connection(Connection &&other) noexcept
+                : event(std::exchange(other.event, nullptr)), index(other.index)
+            {
+                if (event)
+                    event->entries[index].connection = this;
+            }
+            Connection &operator=(Connection &&other) noexcept
+            {
+                if (&other == this)
+                    return *this;
+                Disconnect();
+                event = std::exchange(other.event, nullptr);
+                index = other.index;
+                if (event)
+                    event->entries[index].connection = this;
+                return *this;
+            }
+
+            ~Connection()
+            {
+                Disconnect();
+            }
+
+            // Returns true if the listener is still connected.
+            [[nodiscard]] explicit operator bool() const
+            {
+                return bool(event);
+            }
+
+            void Disconnect() noexcept
+            {
+                if (!event)
+                    return;
+                event->RemoveEntry(index);
+                event = nullptr;
+            }
+        };
+
+        Event() {}
+
+        // The connections point to the event, so it can't be moved.
+        Event(const Event &) = delete;
+        Event &operator=(const Event &) = delete;
+
+        ~Event()
+        {
+            for (Entry &entry : entries)
+            {
+                if (entry.connection)
+                    entry.connection->event = nullptr;
+            }
+        }
+
+        // Connects a member function (or any other callable that accepts `T &` and the parameters), which is called on `object`.
+        // `object` must outlive the connection.
+        template <auto Func, typename T>
+        requires std::invocable<decltype(Func), T &, P...>
+        [[nodiscard]] Connection Connect(T &object)
+        {
+            return AddEntry(const_cast<void *>(static_cast<const void *>(std::addressof(object))), [](void *object, P ...params)
+            {
+                std::invoke(Func, *static_cast<T *>(object), std::forward<P>(params)...);
+            });
+        }
+
+        // Connects a callable object, such as a lambda. It's not copied, so it must outlive the connection.
+        template <typename F>
+        requires std::invocable<F &, P...>
+        [[nodiscard]] Connection Connect(F &func)
+        {
+            return AddEntry(const_cast<void *>(static_cast<const void *>(std::addressof(func))), [](void *func, P ...params)
+            {
+                std::invoke(*static_cast<F *>(func), std::forward<P>(params)...);
+            });
+        }
+
+        // The number of connected listeners.
+        [[nodiscard]] std::size_t ListenerCount() const
+        {
+            std::size_t ret = entries.size();
+            if (has_removed_entries)
+            {
+                for (const Entry &entry : entries)
+                    ret -= !entry.func;
+            }
+            return ret;
+        }
+
+        // Calls all listeners.
+        // The parameters are passed to each listener in turn, so don't use rvalue references as `P`.
+        void operator()(P ...params)
+        {
+            trigger_depth++;
+            FINALLY
+            {
+                if (--trigger_depth == 0 && has_removed_entries)
+                    RemoveMarkedEntries();
+            };
+
+            // Not calling the listeners added while triggering.
+            std::size_t count = entries.size();
+            for (std::size_t i = 0; i < count; i++)
+            {
+                const Entry &entry = entries[i];
+                if (entry.func)
+                    entry.func(entry.object, params...);
+            }
+        }
+    };
+}
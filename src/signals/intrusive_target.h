@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+#include "signals/interface.h"
+
+namespace Sig
+{
+    // Same as `Target` and `Pointer`, but the pointers bound to a target form an intrusive doubly linked list.
+    // This doesn't allocate and doesn't use atomics, but isn't thread-safe, and moving a target walks the list of its pointers.
+    // Prefer those over `Target` and `Pointer` when the bindings change often, e.g. for the objects that are created and destroyed every tick.
+
+    template <typename> class IntrusivePointer;
+    template <typename> class IntrusiveTarget;
+
+    namespace impl
+    {
+        // This is a CRTP base.
+        template <typename D>
+        class IntrusiveTarget
+        {
+            static_assert(std::is_class_v<D> && !std::is_const_v<D> && !std::is_volatile_v<D>, "The template parameter must be a cv-unqualified class.");
+
+            friend IntrusivePointer<D>;
+
+            IntrusivePointer<D> *first_pointer = nullptr;
+            std::size_t pointer_count = 0;
+
+            // Takes the pointers from `other`, which must have no pointers.
+            void TakePointers(IntrusiveTarget &other) noexcept
+            {
+                first_pointer = std::exchange(other.first_pointer, nullptr);
+                pointer_count = std::exchange(other.pointer_count, 0);
+                for (IntrusivePointer<D> *ptr = first_pointer; ptr; ptr = ptr->next)
+                    ptr->target = this;
+            }
+
+          public:
+            constexpr IntrusiveTarget() noexcept {}
+
+            IntrusiveTarget(IntrusiveTarget &&other) noexcept
+            {
+                TakePointers(other);
+            }
+
+            IntrusiveTarget &operator=(IntrusiveTarget &&other) noexcept
+            {
+                if (&other == this)
+                    return *this;
+                UnbindAll();
+                TakePointers(other);
+                return *this;
+            }
+
+            ~IntrusiveTarget()
+            {
+                UnbindAll();
+            }
+
+            // Returns true if at least one pointer is bound to this target.
+            [[nodiscard]] explicit operator bool() const
+            {
+                return bool(first_pointer);
+            }
+
+            // Returns the number of pointers bound to this target.
+            [[nodiscard]] std::size_t BoundPointerCount() const
+            {
+                return pointer_count;
+            }
+
+            // Unbinds all pointers bound to this target.
+            void UnbindAll() noexcept
+            {
+                while (first_pointer)
+                    first_pointer->Unbind();
+            }
+        };
+    }
+
+    // This is a CRTP base.
+    // The actual implementation is in the private base.
+    // Apply `Interface()` to classes derived from this to access the interface.
+    template <typename D>
+    class IntrusiveTarget : impl::IntrusiveTarget<D>
+    {
+        friend impl::InterfaceHelper;
+        using interface_helper = impl::InterfaceHelper;
+        using interface_type = impl::IntrusiveTarget<D>;
+
+        friend IntrusivePointer<D>;
+
+        [[nodiscard]] static D *ToDerived(impl::IntrusiveTarget<D> *target) noexcept
+        {
+            return static_cast<D *>(static_cast<IntrusiveTarget *>(target));
+        }
+    };
+
+    // Observes a class derived from `IntrusiveTarget<D>`.
+    template <typename D>
+    class IntrusivePointer
+    {
+        using TargetImpl = impl::IntrusiveTarget<D>;
+        friend TargetImpl;
+
+        TargetImpl *target = nullptr;
+        IntrusivePointer *prev = nullptr;
+        IntrusivePointer *next = nullptr;
+
+        void Link(TargetImpl &new_target) noexcept
+        {
+            target = &new_target;
+            prev = nullptr;
+            next = new_target.first_pointer;
+            if (next)
+                next->prev = this;
+            new_target.first_pointer = this;
+            new_target.pointer_count++;
+        }
+
+      public:
+        constexpr IntrusivePointer(std::nullptr_t = nullptr) noexcept {}
+
+        IntrusivePointer(IntrusiveTarget<D> &target) noexcept
+        {
+            Bind(target);
+        }
+
+        IntrusivePointer(const IntrusivePointer &other) noexcept
+        {
+            if (other.target)
+                Link(*other.target);
+        }
+        IntrusivePointer &operator=(const IntrusivePointer &other) noexcept
+        {
+            if (other.target != target)
+            {
+                Unbind();
+                if (other.target)
+                    Link(*other.target);
+            }
+            return *this;
+        }
+
+        ~IntrusivePointer()
+        {
+            Unbind();
+        }
+
+        // Attaches the pointer to a target.
+        void Bind(IntrusiveTarget<D> &new_target) noexcept
+        {
+            TargetImpl &target_interface = Interface(new_target);
+            if (target == &target_interface)
+                return;
+            Unbind();
+            Link(target_interface);
+        }
+
+        // Detaches the pointer from the target.
+        void Unbind() noexcept
+        {
+            if (!target)
+                return;
+            if (prev)
+                prev->next = next;
+            else
+                target->first_pointer = next;
+            if (next)
+                next->prev = prev;
+            target->pointer_count--;
+            target = nullptr;
+            prev = next = nullptr;
+        }
+
+        // Returns true if a remote object is bound to this one.
+        [[nodiscard]] explicit operator bool() const noexcept
+        {
+            return bool(target);
+        }
+
+        // Returns the bound remote object, or null if not bound.
+        [[nodiscard]] D *GetTarget() noexcept
+        {
+            return target ? IntrusiveTarget<D>::ToDerived(target) : nullptr;
+        }
+
+        [[nodiscard]] const D *GetTarget() const noexcept
+        {
+            return target ? IntrusiveTarget<D>::ToDerived(target) : nullptr;
+        }
+
+        // Returns the bound remote object, might crash if none is bound.
+        [[nodiscard]]       D &operator*()       {return *GetTarget();}
+        [[nodiscard]] const D &operator*() const {return *GetTarget();}
+
+        [[nodiscard]]       D *operator->()       {return GetTarget();}
+        [[nodiscard]] const D *operator->() const {return GetTarget();}
+    };
+}
@@ -1,20 +1,28 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <concepts>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <exception>
 #include <initializer_list>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "meta/common.h"
 #include "program/errors.h"
+#include "program/platform.h"
 #include "stream/better_fopen.h"
 #include "stream/readonly_data.h"
 #include "stream/utils.h"
@@ -26,15 +34,122 @@
 #include "utils/robust_math.h"
 #include "utils/unicode.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace Stream
 {
     namespace Char
     {
+        // A precomputed set of bytes, for the category fast paths in `Input`.
+        // If the set consists of few byte ranges (which is true for all the built-in ASCII categories), it's checked 16 bytes at a time with SSE2.
+        class LookupTable
+        {
+            static constexpr int max_ranges = 4;
+
+            std::array<bool, 256> matches{};
+            int num_ranges = -1; // -1 if there are too many ranges to use SIMD.
+            std::array<std::uint8_t, max_ranges> range_begin{}, range_last_offset{}; // `range_last_offset` is the size minus one.
+
+            void FindRanges()
+            {
+                num_ranges = 0;
+                for (int i = 0; i < 256;)
+                {
+                    if (!matches[i])
+                    {
+                        i++;
+                        continue;
+                    }
+                    int j = i;
+                    while (j < 256 && matches[j])
+                        j++;
+                    if (num_ranges == max_ranges)
+                    {
+                        num_ranges = -1;
+                        return;
+                    }
+                    range_begin[num_ranges] = std::uint8_t(i);
+                    range_last_offset[num_ranges] = std::uint8_t(j - i - 1);
+                    num_ranges++;
+                    i = j;
+                }
+            }
+
+          public:
+            LookupTable() {}
+
+            // `pred` is `(char ch) -> bool`.
+            explicit LookupTable(auto &&pred)
+            {
+                for (int i = 0; i < 256; i++)
+                    matches[i] = pred(char(i));
+                FindRanges();
+            }
+
+            [[nodiscard]] bool operator()(char ch) const
+            {
+                return matches[(unsigned char)ch];
+            }
+
+            [[nodiscard]] LookupTable Inverted() const
+            {
+                LookupTable ret;
+                for (int i = 0; i < 256; i++)
+                    ret.matches[i] = !matches[i];
+                ret.FindRanges();
+                return ret;
+            }
+
+            // Returns the number of matching bytes at the beginning of the range.
+            [[nodiscard]] std::size_t CountMatching(const std::uint8_t *begin, const std::uint8_t *end) const
+            {
+                const std::uint8_t *cur = begin;
+
+                #if defined(__SSE2__)
+                if (num_ranges >= 0)
+                {
+                    // `x` is in a range if `x - begin <= last_offset`, unsigned and with wraparound.
+                    __m128i begins[max_ranges], last_offsets[max_ranges];
+                    for (int i = 0; i < num_ranges; i++)
+                    {
+                        begins[i] = _mm_set1_epi8(char(range_begin[i]));
+                        last_offsets[i] = _mm_set1_epi8(char(range_last_offset[i]));
+                    }
+
+                    while (end - cur >= 16)
+                    {
+                        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+                        __m128i matching = _mm_setzero_si128();
+                        for (int i = 0; i < num_ranges; i++)
+                        {
+                            __m128i offset = _mm_sub_epi8(bytes, begins[i]);
+                            matching = _mm_or_si128(matching, _mm_cmpeq_epi8(_mm_max_epu8(offset, last_offsets[i]), last_offsets[i]));
+                        }
+                        unsigned int mismatches = ~unsigned(_mm_movemask_epi8(matching)) & 0xffff;
+                        if (mismatches)
+                            return std::size_t(cur - begin) + std::size_t(std::countr_zero(mismatches));
+                        cur += 16;
+                    }
+                }
+                #endif
+
+                while (cur != end && matches[*cur])
+                    cur++;
+                return std::size_t(cur - begin);
+            }
+        };
+
         // A base class for character categories.
         struct Category
         {
             [[nodiscard]] virtual bool operator()(char ch) const = 0;
             [[nodiscard]] virtual std::string name() const = 0;
+
+            // Stateless categories can return a table of the matching bytes, which lets `Input` skip the per-byte virtual calls.
+            // The table shouldn't change between the calls. Stateful categories can return it once the state stops changing (see `SeqIdentifier`).
+            [[nodiscard]] virtual const LookupTable *GetLookupTable() const {return nullptr;}
         };
 
         // A category matching a single character.
@@ -97,6 +212,14 @@ namespace Stream
                 {
                     return "not " + T::name();
                 }
+                [[nodiscard]] const LookupTable *GetLookupTable() const override
+                {
+                    const LookupTable *base_table = base::GetLookupTable();
+                    if (!base_table)
+                        return nullptr;
+                    static const LookupTable ret = base_table->Inverted();
+                    return &ret;
+                }
             };
         }
         // Returns an inverted category.
@@ -120,6 +243,11 @@ namespace Stream
             { \
                 [[nodiscard]] bool operator()(char ch) const override {return expr_;} \
                 [[nodiscard]] std::string name() const override {return string_;} \
+                [[nodiscard]] const LookupTable *GetLookupTable() const override \
+                { \
+                    static const LookupTable ret([](char ch){return expr_;}); \
+                    return &ret; \
+                } \
             };
 
         // Character categories corresponding to the functions from `<cctype>`:
@@ -158,6 +286,15 @@ namespace Stream
             }
 
             [[nodiscard]] std::string name() const override {return "an identifier";}
+
+            // After the first character, this becomes stateless.
+            [[nodiscard]] const LookupTable *GetLookupTable() const override
+            {
+                if (first_char)
+                    return nullptr;
+                static const LookupTable ret([](char ch){return IsAlphaOrDigit{}(ch) || ch == '_';});
+                return &ret;
+            }
         };
     }
 
@@ -191,6 +328,16 @@ namespace Stream
         text_byte_position,
     };
 
+    // Pass this to the `Input` constructor to read a file on a background thread, ahead of the cursor.
+    // This overlaps the IO with the parsing, for large files that are read sequentially.
+    struct ReadAhead
+    {
+        // How many chunks to prefetch. If zero, or if the platform has no threads, the file is read normally.
+        std::size_t depth = 4;
+        // The chunk size in bytes.
+        std::size_t chunk_size = 1 << 16;
+    };
+
     enum ExtractMode
     {
         one, // Exactly one.
@@ -243,6 +390,9 @@ namespace Stream
             std::string name;
 
             ReadOnlyData readonly_data_storage; // Optional. Set if the stream is based on a ReadOnlyData.
+            const std::uint8_t *contiguous_data = nullptr; // Set if the stream is based on a ReadOnlyData, then the reads bypass the buffers.
+
+            std::vector<std::uint8_t> peek_storage; // `PeekSpan()` uses this for the streams that aren't contiguous.
         };
         Data data;
 
@@ -301,6 +451,149 @@ namespace Stream
             last_offset = offset + size;
         }
 
+        // Reads a file on a background thread, prefetching the chunks that follow the last read one. See `ReadAhead`.
+        // Reading out of order works too, but restarts the prefetching from the new position.
+        class ReadAheadReader
+        {
+            struct Chunk
+            {
+                std::unique_ptr<std::uint8_t[]> storage;
+                std::size_t index = -1; // -1 if nothing is loaded.
+                bool ready = false;
+            };
+
+            std::unique_ptr<FILE, void(*)(FILE *)> handle;
+            std::size_t file_size = 0;
+            std::size_t chunk_size = 0;
+            std::size_t num_chunks = 0;
+
+            std::mutex mutex;
+            std::condition_variable worker_cv, reader_cv;
+            // Chunk `i` is stored in `chunks[i % chunks.size()]`.
+            std::vector<Chunk> chunks;
+            // The first chunk the reader needs. The worker loads this one and the ones following it.
+            std::size_t window_begin = 0;
+            std::exception_ptr error;
+            bool stop = false;
+
+            std::jthread worker; // Must be the last member, to stop first.
+
+            [[nodiscard]] Chunk &ChunkFor(std::size_t index) {return chunks[index % chunks.size()];}
+
+            void WorkerLoop()
+            {
+                std::unique_lock lock(mutex);
+                while (true)
+                {
+                    // Find the first chunk in the window that isn't loaded yet.
+                    std::size_t target = -1;
+                    worker_cv.wait(lock, [&]
+                    {
+                        if (stop)
+                            return true;
+                        if (error)
+                            return false;
+                        std::size_t window_end = std::min(window_begin + chunks.size(), num_chunks);
+                        for (std::size_t i = window_begin; i < window_end; i++)
+                        {
+                            if (ChunkFor(i).index != i)
+                            {
+                                target = i;
+                                return true;
+                            }
+                        }
+                        return false;
+                    });
+                    if (stop)
+                        return;
+
+                    // The reader only touches ready chunks with the matching index, under the lock, so we can fill this one without the lock.
+                    Chunk &chunk = ChunkFor(target);
+                    chunk.index = target;
+                    chunk.ready = false;
+                    lock.unlock();
+
+                    std::exception_ptr new_error;
+                    std::size_t offset = target * chunk_size;
+                    std::size_t size = std::min(chunk_size, file_size - offset);
+                    if (std::fseek(handle.get(), long(offset), SEEK_SET))
+                        new_error = std::make_exception_ptr(std::runtime_error("Unable to seek in the file."));
+                    else if (std::fread(chunk.storage.get(), size, 1, handle.get()) != 1)
+                        new_error = std::make_exception_ptr(std::runtime_error(FMT("Unable to read from the file: {}", std::feof(handle.get()) ? "EOF was reported." : std::strerror(errno))));
+
+                    lock.lock();
+                    if (new_error)
+                    {
+                        chunk.index = -1;
+                        error = new_error;
+                    }
+                    else
+                    {
+                        chunk.ready = true;
+                    }
+                    reader_cv.notify_all();
+                }
+            }
+
+          public:
+            ReadAheadReader(std::unique_ptr<FILE, void(*)(FILE *)> new_handle, std::size_t file_size, ReadAhead params)
+                : handle(std::move(new_handle)), file_size(file_size), chunk_size(std::max(params.chunk_size, std::size_t(1))),
+                num_chunks(file_size / chunk_size + (file_size % chunk_size != 0)), chunks(params.depth)
+            {
+                for (Chunk &chunk : chunks)
+                    chunk.storage = std::make_unique<std::uint8_t[]>(chunk_size);
+                worker = std::jthread([this]{WorkerLoop();});
+            }
+
+            ReadAheadReader(const ReadAheadReader &) = delete;
+            ReadAheadReader &operator=(const ReadAheadReader &) = delete;
+
+            ~ReadAheadReader()
+            {
+                {
+                    std::lock_guard lock(mutex);
+                    stop = true;
+                }
+                worker_cv.notify_all();
+            }
+
+            void Read(Input &stream, std::size_t offset, std::size_t size, std::uint8_t *dst)
+            {
+                std::unique_lock lock(mutex);
+                while (size > 0)
+                {
+                    std::size_t index = offset / chunk_size;
+                    if (index != window_begin)
+                    {
+                        // Move the window, either forward, or to a new place if we're reading out of order.
+                        window_begin = index;
+                        worker_cv.notify_all();
+                    }
+
+                    Chunk &chunk = ChunkFor(index);
+                    reader_cv.wait(lock, [&]{return error || (chunk.index == index && chunk.ready);});
+                    if (error)
+                    {
+                        try
+                        {
+                            std::rethrow_exception(error);
+                        }
+                        catch (std::exception &e)
+                        {
+                            throw std::runtime_error(FMT("{}{}", stream.GetExceptionPrefix(), e.what()));
+                        }
+                    }
+
+                    std::size_t offset_in_chunk = offset - index * chunk_size;
+                    std::size_t part_size = std::min(size, chunk_size - offset_in_chunk);
+                    std::copy_n(chunk.storage.get() + offset_in_chunk, part_size, dst);
+                    offset += part_size;
+                    dst += part_size;
+                    size -= part_size;
+                }
+            }
+        };
+
         // Rounds the position down to a multiple of the buffer capacity.
         std::size_t PositionToSegmentOffset(std::size_t pos)
         {
@@ -350,7 +643,8 @@ namespace Stream
 
         void ThrowIfNoData(std::size_t bytes)
         {
-            if (data.position + bytes > data.size)
+            std::size_t end;
+            if (Robust::addition_fails(data.position, bytes, end) || end > data.size)
                 throw std::runtime_error(GetExceptionPrefix() + "Unexpected end of input.");
         }
 
@@ -387,6 +681,7 @@ namespace Stream
             data.buffer_capacity = std::numeric_limits<std::size_t>::max() / 2 + 1;
             data.buffer_a.position = 0;
             data.buffer_a.storage = const_cast<std::uint8_t *>(source.data()); // Since our functor is a null, this is safe.
+            data.contiguous_data = source.data();
 
             data.readonly_data_storage = std::move(source);
         }
@@ -420,6 +715,13 @@ namespace Stream
         // Attaches the stream to a file.
         Input(std::string file_name, capacity_t buffer_capacity = default_capacity)
         {
+            // If the file is served from memory (e.g. from a pack file, see `stream/pack_file.h`), read it from there.
+            if (ReadOnlyData override = ReadOnlyData::TryFileOverride(file_name))
+            {
+                *this = Input(std::move(override));
+                return;
+            }
+
             auto deleter = [](FILE *file)
             {
                 // We don't check for errors here, since there is nothing we could do.
@@ -454,6 +756,43 @@ namespace Stream
             *this = Input(std::move(file_name), info.size, std::move(lambda), buffer_capacity);
         }
 
+        // Attaches the stream to a file, and reads it ahead on a background thread. See `ReadAhead` for details.
+        Input(std::string file_name, ReadAhead read_ahead, capacity_t buffer_capacity = default_capacity)
+        {
+            // If the file overrides are enabled, let the plain constructor handle them (then the read-ahead is skipped).
+            if (read_ahead.depth == 0 || IMP_PLATFORM_IS(web) || ReadOnlyData::FileOverride())
+            {
+                *this = Input(std::move(file_name), buffer_capacity);
+                return;
+            }
+
+            std::unique_ptr<FILE, void(*)(FILE *)> handle(better_fopen(file_name.c_str(), "rb"), [](FILE *file){std::fclose(file);});
+            if (!handle)
+                throw std::runtime_error(FMT("Unable to open `{}` for reading.", file_name));
+
+            // Our chunks are the buffers.
+            std::setbuf(handle.get(), nullptr);
+
+            FileHandleInfo info;
+
+            try
+            {
+                info = CollectFileHandleInfo(handle.get(), true);
+            }
+            catch (std::exception &e)
+            {
+                throw std::runtime_error(FMT("Unable to attach an input stream to `{}`:\n{}", file_name, e.what()));
+            }
+
+            auto reader = std::make_unique<ReadAheadReader>(std::move(handle), info.size, read_ahead);
+            auto lambda = Meta::fake_copyable([reader = std::move(reader)](Input &stream, std::size_t offset, std::size_t size, std::uint8_t *dst)
+            {
+                reader->Read(stream, offset, size, dst);
+            });
+
+            *this = Input(std::move(file_name), info.size, std::move(lambda), buffer_capacity);
+        }
+
         // Attaches the stream to a file.
         // Without this helper, `Input(ReadOnlyData source)` would cause an ambiguity.
         Input(const char *file_name, capacity_t buffer_capacity = default_capacity) : Input(std::string(file_name), buffer_capacity) {}
@@ -678,10 +1017,42 @@ namespace Stream
                 throw std::runtime_error(GetExceptionPrefix() + "Unexpected junk at the end of input.");
         }
 
+        // Whether the stream is backed by contiguous memory, i.e. is based on a `ReadOnlyData`.
+        // Then the reads don't go through the buffers, and `PeekSpan()` doesn't copy.
+        [[nodiscard]] bool IsContiguous() const
+        {
+            return bool(data.contiguous_data);
+        }
+
+        // Returns the next `size` bytes, without advancing the cursor. Throws if there's not enough data.
+        // If the stream `IsContiguous()`, this points directly to the underlying memory, and stays valid as long as the stream exists.
+        // Otherwise the bytes are copied to an internal buffer, and the span stays valid until the next call of this function.
+        // NOTE: In the latter case, this allocates `size` bytes before reading them, and the size of a non-contiguous stream
+        //   can come from untrusted data (e.g. a compressed file), so don't pass the sizes read from the stream itself here.
+        [[nodiscard]] std::span<const std::uint8_t> PeekSpan(std::size_t size)
+        {
+            ThrowIfNoData(size);
+
+            if (data.contiguous_data)
+                return {data.contiguous_data + data.position, size};
+
+            // Don't keep a large buffer for the whole lifetime of the stream after a single large peek.
+            if (data.peek_storage.capacity() > std::max(size * 4, std::size_t(4096)))
+                data.peek_storage = {};
+
+            std::size_t old_pos = data.position;
+            data.peek_storage.resize(size);
+            Read(data.peek_storage.data(), size);
+            data.position = old_pos;
+            return data.peek_storage;
+        }
+
         // Returns the next byte, without advancing the cursor.
         [[nodiscard]] std::uint8_t PeekByte()
         {
             ThrowIfNoData(1);
+            if (data.contiguous_data)
+                return data.contiguous_data[data.position];
             return NeedSegment(PositionToSegmentOffset(data.position)).ReadByte(data.position);
         }
         [[nodiscard]] char PeekChar()
@@ -752,6 +1123,13 @@ namespace Stream
                 return;
             ThrowIfNoData(size);
 
+            if (data.contiguous_data)
+            {
+                std::copy_n(data.contiguous_data + data.position, size, buffer);
+                data.position += size;
+                return;
+            }
+
             std::size_t first_segment = PositionToSegmentOffset(data.position);
             std::size_t last_segment = PositionToSegmentOffset(data.position + size - 1);
 
@@ -821,7 +1199,7 @@ namespace Stream
         template <typename T>
         void ReadWithByteOrder(ByteOrder::Order order, T *buffer, std::size_t count)
         {
-            Read(reinterpret_cast<std::uint8_t *>(buffer), count * sizeof *buffer);
+            Read(reinterpret_cast<std::uint8_t *>(buffer), Robust::checked_mul<std::size_t>(count, sizeof *buffer));
             for (std::size_t i = 0; i < count; i++)
                 ByteOrder::Convert(buffer[i], order);
         }
@@ -854,6 +1232,64 @@ namespace Stream
 
             std::size_t count = 0;
 
+            if (data.contiguous_data)
+            {
+                // Scan the memory directly, then append everything at once.
+                const std::uint8_t *begin = data.contiguous_data + data.position, *end = data.contiguous_data + data.size, *cur = begin;
+
+                const Char::LookupTable *table = nullptr;
+                bool stop = false;
+                if constexpr (several)
+                {
+                    table = category.GetLookupTable();
+                    if (!table && cur != end)
+                    {
+                        // The stateful categories can provide the table after the first character.
+                        if (category(char(*cur)))
+                        {
+                            cur++;
+                            table = category.GetLookupTable();
+                        }
+                        else
+                        {
+                            stop = true;
+                        }
+                    }
+                }
+
+                if (table)
+                {
+                    cur += table->CountMatching(cur, end);
+                }
+                else if (!stop)
+                {
+                    while (cur != end && category(char(*cur)))
+                    {
+                        cur++;
+                        if (!several)
+                            break;
+                    }
+                }
+                count = std::size_t(cur - begin);
+                data.position += count;
+
+                if constexpr (!std::is_null_pointer_v<T>)
+                {
+                    if (append_to)
+                    {
+                        if constexpr (requires{append_to->insert(append_to->end(), begin, cur);})
+                            append_to->insert(append_to->end(), begin, cur);
+                        else
+                            std::for_each(begin, cur, [&](std::uint8_t byte){append_to->push_back(byte);});
+                    }
+                }
+
+                if (throw_if_none && count == 0)
+                    throw std::runtime_error(GetExceptionPrefix() + "Expected " + category.name() + ".");
+
+                return count;
+            }
+
             do
             {
                 if (!MoreData())
@@ -938,6 +1374,12 @@ namespace Stream
         requires (mode == one) || (mode == if_present)
         bool DiscardBytes(const std::uint8_t *bytes, std::size_t count)
         {
+            if (data.contiguous_data && count <= RemainingBytes() && std::equal(bytes, bytes + count, data.contiguous_data + data.position))
+            {
+                data.position += count;
+                return true;
+            }
+
             auto pos = Position();
             for (std::size_t i = 0; i < count; i++)
             {
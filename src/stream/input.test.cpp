@@ -0,0 +1,89 @@
+#include "input.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // A stream that isn't contiguous, with a tiny buffer so that the reads cross the buffer boundaries.
+    [[nodiscard]] Stream::Input MakeBufferedInput(std::string str)
+    {
+        std::size_t size = str.size();
+        return Stream::Input("buffered", size, [str = std::move(str)](Stream::Input &, std::size_t offset, std::size_t size, std::uint8_t *dst)
+        {
+            std::memcpy(dst, str.data() + offset, size);
+        }, Stream::capacity_t(4));
+    }
+}
+
+TEST_CASE("stream.input.peek_span")
+{
+    std::string str = "0123456789abcdefghij";
+
+    { // Contiguous, points directly to the memory.
+        Stream::Input input(Stream::ReadOnlyData::mem_reference(str));
+        REQUIRE(input.IsContiguous());
+        input.Skip(2);
+        auto span = input.PeekSpan(10);
+        REQUIRE(static_cast<const void *>(span.data()) == str.data() + 2);
+        REQUIRE(span.size() == 10);
+        REQUIRE(input.Position() == 2);
+        REQUIRE(input.PeekSpan(18).size() == 18);
+        REQUIRE_THROWS_AS((void)input.PeekSpan(19), std::runtime_error);
+        REQUIRE(input.Position() == 2);
+    }
+
+    { // Not contiguous, copies the bytes.
+        Stream::Input input = MakeBufferedInput(str);
+        REQUIRE_FALSE(input.IsContiguous());
+        input.Skip(2);
+        auto span = input.PeekSpan(10);
+        REQUIRE(std::string(span.begin(), span.end()) == "23456789ab");
+        REQUIRE(input.Position() == 2);
+        REQUIRE(input.ReadChar() == '2');
+        span = input.PeekSpan(17);
+        REQUIRE(std::string(span.begin(), span.end()) == str.substr(3));
+        REQUIRE_THROWS_AS((void)input.PeekSpan(18), std::runtime_error);
+        REQUIRE(input.Position() == 3);
+    }
+}
+
+TEST_CASE("stream.input.contiguous")
+{
+    // Run the same checks on both kinds of streams, since the contiguous ones use separate code paths.
+    for (bool contiguous : {true, false})
+    {
+        CAPTURE(contiguous);
+        std::string str = "abc123  def456";
+        Stream::Input input = contiguous ? Stream::Input(Stream::ReadOnlyData::mem_copy(str)) : MakeBufferedInput(str);
+        REQUIRE(input.IsContiguous() == contiguous);
+
+        char buf[3] = {};
+        input.Read(buf, 3);
+        REQUIRE(std::string(buf, 3) == "abc");
+
+        // Categories.
+        REQUIRE(input.Extract(Stream::Char::IsDigit{}) == "123");
+        REQUIRE(input.Extract<Stream::any>(Stream::Char::IsDigit{}).empty());
+        REQUIRE_THROWS_AS((void)input.Extract(Stream::Char::IsDigit{}), std::runtime_error);
+        REQUIRE(input.Discard<Stream::at_least_one>(' ') == 2);
+
+        // Sequences of bytes.
+        REQUIRE_FALSE(input.DiscardChars<Stream::if_present>("dex"));
+        REQUIRE(input.Position() == 8);
+        REQUIRE_THROWS_AS(input.DiscardChars("dex"), std::runtime_error);
+        REQUIRE(input.Position() == 8);
+        REQUIRE(input.DiscardChars("def"));
+        REQUIRE_FALSE(input.DiscardChars<Stream::if_present>("4567"));
+        REQUIRE(input.Position() == 11);
+
+        // Reading to the end.
+        REQUIRE(input.Extract(Stream::Char::IsDigit{}) == "456");
+        REQUIRE_FALSE(input.MoreData());
+        REQUIRE_THROWS_AS(input.Read(buf, 1), std::runtime_error);
+    }
+}
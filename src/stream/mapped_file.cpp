@@ -0,0 +1,89 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#include "program/platform.h"
+#include "strings/format.h"
+
+#if IMP_PLATFORM_IS(windows)
+#include <filesystem>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "macros/finally.h"
+
+namespace Stream
+{
+    MappedFile::MappedFile(const std::string &file_name)
+    {
+        #if IMP_PLATFORM_IS(windows)
+        SYSTEM_INFO system_info;
+        GetSystemInfo(&system_info);
+        page_size = system_info.dwPageSize;
+
+        HANDLE file = CreateFileW(std::filesystem::u8path(file_name).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error(FMT("Unable to open file `{}`.", file_name));
+        FINALLY{CloseHandle(file);}; // The mapping keeps the file open.
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size))
+            throw std::runtime_error(FMT("Unable to get size of file `{}`.", file_name));
+        if (file_size.QuadPart == 0)
+            throw std::runtime_error(FMT("Unable to map file `{}` to memory, because it's empty.", file_name));
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            throw std::runtime_error(FMT("Unable to map file `{}` to memory.", file_name));
+
+        void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view)
+        {
+            CloseHandle(mapping);
+            throw std::runtime_error(FMT("Unable to map file `{}` to memory.", file_name));
+        }
+
+        address = static_cast<const std::uint8_t *>(view);
+        mapped_size = std::size_t(file_size.QuadPart);
+        handle = mapping;
+        #else
+        page_size = std::size_t(sysconf(_SC_PAGESIZE));
+
+        int file = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file == -1)
+            throw std::runtime_error(FMT("Unable to open file `{}`.", file_name));
+        FINALLY{close(file);}; // The mapping keeps the file open.
+
+        struct stat info;
+        if (fstat(file, &info))
+            throw std::runtime_error(FMT("Unable to get size of file `{}`.", file_name));
+        if (info.st_size == 0)
+            throw std::runtime_error(FMT("Unable to map file `{}` to memory, because it's empty.", file_name));
+
+        void *view = mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (view == MAP_FAILED)
+            throw std::runtime_error(FMT("Unable to map file `{}` to memory.", file_name));
+
+        address = static_cast<const std::uint8_t *>(view);
+        mapped_size = std::size_t(info.st_size);
+        #endif
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (!address)
+            return;
+
+        #if IMP_PLATFORM_IS(windows)
+        UnmapViewOfFile(address);
+        CloseHandle(handle);
+        #else
+        munmap(const_cast<std::uint8_t *>(address), mapped_size);
+        #endif
+    }
+}
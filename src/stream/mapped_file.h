@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace Stream
+{
+    // A read-only memory mapping of an entire file.
+    // The OS loads the pages on demand, and they are backed by the page cache, so large files don't cost a copy.
+    class MappedFile
+    {
+        const std::uint8_t *address = nullptr;
+        std::size_t mapped_size = 0;
+        std::size_t page_size = 0;
+        void *handle = nullptr; // The file mapping object on Windows, unused elsewhere.
+
+      public:
+        MappedFile() {}
+
+        // Maps a file. Throws on failure, including when the file is empty (since empty files can't be mapped).
+        explicit MappedFile(const std::string &file_name);
+
+        MappedFile(MappedFile &&other) noexcept
+            : address(std::exchange(other.address, nullptr)),
+            mapped_size(std::exchange(other.mapped_size, 0)),
+            page_size(std::exchange(other.page_size, 0)),
+            handle(std::exchange(other.handle, nullptr))
+        {}
+        MappedFile &operator=(MappedFile other) noexcept
+        {
+            std::swap(address, other.address);
+            std::swap(mapped_size, other.mapped_size);
+            std::swap(page_size, other.page_size);
+            std::swap(handle, other.handle);
+            return *this;
+        }
+
+        ~MappedFile();
+
+        [[nodiscard]] explicit operator bool() const {return bool(address);}
+
+        [[nodiscard]] const std::uint8_t *data() const {return address;}
+        [[nodiscard]] std::size_t size() const {return mapped_size;}
+
+        // Whether the mapping has a zero byte right past the end of the file.
+        // This is the case when the file size is not a multiple of the page size, since the rest of the last page is zero-filled.
+        [[nodiscard]] bool has_null_terminator() const {return address && mapped_size % page_size != 0;}
+    };
+}
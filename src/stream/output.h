@@ -9,6 +9,7 @@
 #include <iterator>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <type_traits>
 #include <vector>
@@ -22,6 +23,7 @@
 #include "stream/utils.h"
 #include "strings/format.h"
 #include "utils/byte_order.h"
+#include "utils/robust_math.h"
 #include "utils/unicode.h"
 
 namespace Stream
@@ -36,24 +38,62 @@ namespace Stream
         // Will never be copied. If your functor is non-copyable, consider using `Meta::fake_copyable`.
         using flush_func_t = std::function<void(Output &, const std::uint8_t *, std::size_t)>;
 
+        // For the direct-write mode. Resizes the underlying container and returns a pointer to its storage.
+        // Can throw on failure.
+        using resize_func_t = std::function<std::uint8_t *(std::size_t)>;
+
       private:
         struct Data
         {
-            std::unique_ptr<std::uint8_t[]> buffer;
+            std::unique_ptr<std::uint8_t[]> buffer; // Null in the direct-write mode.
+            std::uint8_t *buffer_ptr = nullptr; // Either `buffer.get()`, or a pointer into the container storage in the direct-write mode.
             std::size_t buffer_pos = 0;
             std::size_t buffer_capacity = 0;
             flush_func_t flush;
 
+            // Only in the direct-write mode.
+            resize_func_t resize;
+            // How many bytes of the container are already committed. The window starting at `buffer_ptr` follows them.
+            std::size_t direct_size = 0;
+
             std::optional<ExceptionPrefixStyle> exception_prefix_style;
 
             std::string name;
         };
         Data data;
 
+        [[nodiscard]] bool IsDirect() const
+        {
+            return bool(data.resize);
+        }
+
+        // Makes sure at least `size` bytes are free in the buffer.
+        void MakeBufferSpace(std::size_t size)
+        {
+            if (IsDirect())
+            {
+                // Commit the written bytes and grow the window, geometrically.
+                data.direct_size += data.buffer_pos;
+                data.buffer_pos = 0;
+                std::size_t window = std::max({size, data.direct_size, std::size_t(default_capacity)});
+                data.buffer_ptr = data.resize(Robust::checked_add<std::size_t>(data.direct_size, window)) + data.direct_size;
+                data.buffer_capacity = window;
+                return;
+            }
+
+            Flush();
+            if (size > data.buffer_capacity)
+            {
+                data.buffer = std::make_unique<std::uint8_t[]>(size);
+                data.buffer_ptr = data.buffer.get();
+                data.buffer_capacity = size;
+            }
+        }
+
         void NeedBufferSpace()
         {
             if (data.buffer_pos == data.buffer_capacity)
-                Flush();
+                MakeBufferSpace(1);
         }
 
       public:
@@ -85,6 +125,7 @@ namespace Stream
         Output(std::string name, flush_func_t flush, capacity_t capacity = default_capacity)
         {
             data.buffer = std::make_unique<std::uint8_t[]>(std::size_t(capacity));
+            data.buffer_ptr = data.buffer.get();
             data.buffer_capacity = std::size_t(capacity);
             data.flush = std::move(flush);
             data.name = std::move(name);
@@ -148,9 +189,42 @@ namespace Stream
                 capacity);
         }
 
+        // Constructs a stream in the direct-write mode, with an arbitrary underlying container.
+        // The bytes are written directly into the container storage, with no intermediate buffer.
+        // `resize` is called with the total size, and should return a pointer to the storage. The existing contents are preserved.
+        [[nodiscard]] static Output Direct(std::string name, std::size_t initial_size, resize_func_t resize)
+        {
+            Output ret;
+            ret.data.resize = std::move(resize);
+            ret.data.direct_size = initial_size;
+            ret.data.name = std::move(name);
+            return ret;
+        }
+
+        // Constructs a stream in the direct-write mode, bound to a sequential container. The data is appended to it.
+        // Unlike `Container()`, this writes directly into the container storage, skipping the intermediate buffer.
+        // The container has some extra bytes at the end (the free space for writing) until you `Flush()` the stream,
+        // and it must not be accessed before that.
+        template <typename T>
+        requires requires(T t)
+        {
+            t.resize(std::size_t{});
+            t.data();
+            requires sizeof(typename T::value_type) == 1;
+        }
+        [[nodiscard]] static Output ContainerDirect(T &container)
+        {
+            return Direct(STR("Container at ", ((void *)&container)), container.size(),
+                [&container](std::size_t size)
+                {
+                    container.resize(size);
+                    return reinterpret_cast<std::uint8_t *>(container.data());
+                });
+        }
+
         [[nodiscard]] explicit operator bool() const
         {
-            return bool(data.buffer);
+            return bool(data.buffer) || IsDirect();
         }
 
         // Returns a name of the data source the stream is bound to.
@@ -201,11 +275,23 @@ namespace Stream
         // is a bad idea (and silently ignoring the exception isn't good too).
         // In a debug build, destroying an unflushed stream raises an assertion;
         // in a release build it's flushed automatically, ignoring any possible exceptions.
+        // In the direct-write mode, this commits the written bytes and trims the container to them.
         void Flush()
         {
-            if (data.buffer_pos > 0)
+            if (IsDirect())
+            {
+                data.direct_size += data.buffer_pos;
+                data.buffer_pos = 0;
+                if (data.buffer_capacity > 0)
+                {
+                    data.resize(data.direct_size);
+                    data.buffer_ptr = nullptr;
+                    data.buffer_capacity = 0;
+                }
+            }
+            else if (data.buffer_pos > 0)
             {
-                data.flush(*this, data.buffer.get(), data.buffer_pos);
+                data.flush(*this, data.buffer_ptr, data.buffer_pos);
                 data.buffer_pos = 0;
             }
             else if (!*this)
@@ -218,7 +304,7 @@ namespace Stream
         Output &WriteByte(std::uint8_t byte)
         {
             NeedBufferSpace();
-            data.buffer[data.buffer_pos++] = byte;
+            data.buffer_ptr[data.buffer_pos++] = byte;
             return *this;
         }
         Output &WriteChar(char ch)
@@ -251,9 +337,19 @@ namespace Stream
         // Writes several bytes.
         Output &WriteBytes(const std::uint8_t *ptr, std::size_t size)
         {
+            // In the direct-write mode, just grow the window as needed.
+            if (IsDirect())
+            {
+                if (data.buffer_capacity - data.buffer_pos < size)
+                    MakeBufferSpace(size);
+                std::copy_n(ptr, size, data.buffer_ptr + data.buffer_pos);
+                data.buffer_pos += size;
+                return *this;
+            }
+
             // If there is a free space in the buffer, fill it.
             std::size_t segment_size = std::min(data.buffer_capacity - data.buffer_pos, size);
-            std::copy_n(ptr, segment_size, data.buffer.get() + data.buffer_pos);
+            std::copy_n(ptr, segment_size, data.buffer_ptr + data.buffer_pos);
             data.buffer_pos += segment_size;
             ptr += segment_size;
             size -= segment_size;
@@ -268,7 +364,7 @@ namespace Stream
             // Note the `<` instead of `<=`, there is no point in putting the data in the buffer in that case.
             if (size < data.buffer_capacity)
             {
-                std::copy_n(ptr, size, data.buffer.get());
+                std::copy_n(ptr, size, data.buffer_ptr);
                 data.buffer_pos = size;
                 return *this;
             }
@@ -293,6 +389,33 @@ namespace Stream
             return WriteString(string.data(), string.size());
         }
 
+        // Lets the stream know that at least `size` more bytes are going to be written.
+        // In the direct-write mode, this grows the container once, instead of several times. Otherwise does nothing.
+        Output &ReserveHint(std::size_t size)
+        {
+            if (IsDirect() && data.buffer_capacity - data.buffer_pos < size)
+                MakeBufferSpace(size);
+            return *this;
+        }
+
+        // Returns a span of at least `size` bytes that you can write to directly, then call `Commit()` with the number of bytes you've actually written.
+        // The span is invalidated by any other operation on the stream.
+        // In the direct-write mode, this is a part of the container storage. Otherwise it's the stream buffer, which is enlarged if necessary.
+        [[nodiscard]] std::span<std::uint8_t> GetWriteSpan(std::size_t size)
+        {
+            if (data.buffer_capacity - data.buffer_pos < size)
+                MakeBufferSpace(size);
+            return {data.buffer_ptr + data.buffer_pos, data.buffer_capacity - data.buffer_pos};
+        }
+
+        // Marks `size` bytes of the span returned by `GetWriteSpan()` as written.
+        Output &Commit(std::size_t size)
+        {
+            ASSERT(size <= data.buffer_capacity - data.buffer_pos, "Committing more bytes than `GetWriteSpan()` returned.");
+            data.buffer_pos += size;
+            return *this;
+        }
+
         // Writes an arithmetic value with a specified byte order.
         template <typename T>
         Output &WriteWithByteOrder(ByteOrder::Order order, std::type_identity_t<T> value)
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "strings/format.h"
+#include "utils/archive.h"
+
+// Pack files: many files stored in one, with an index. Opening a file from a pack costs a binary search, with no file system calls.
+// The format is: the magic `imp.pack`, the number of entries (little-endian `uint32_t`), then for each entry:
+//   the name size (`uint32_t`), the name, the data offset from the beginning of the pack, the data size (both `uint64_t`), the flags (`uint8_t`).
+// Then the file contents. The entries are sorted by name. The compressed entries use the format from `utils/archive.h`.
+// Usage:
+//   Stream::PackFileWriter writer;
+//   writer.Add("images/foo.png", Stream::ReadOnlyData("assets/images/foo.png"));
+//   writer.Save("assets.pack");
+//
+//   Stream::MountPackFile(Stream::PackFile("assets.pack"), "assets/");
+//   Stream::ReadOnlyData data("assets/images/foo.png"); // Served from the pack.
+// The mounted packs are used by `ReadOnlyData::file()` and everything based on it (see `ReadOnlyData::FileOverride()`),
+// so the global image and sound loaders read from them too.
+
+namespace Stream
+{
+    namespace impl::Pack
+    {
+        inline constexpr std::string_view magic = "imp.pack";
+
+        enum EntryFlags : std::uint8_t
+        {
+            compressed = 1,
+        };
+    }
+
+    // Reads a pack file.
+    class PackFile
+    {
+        struct Entry
+        {
+            std::string_view name; // Points into `data`.
+            std::size_t offset = 0;
+            std::size_t size = 0;
+            std::uint8_t flags = 0;
+        };
+
+        ReadOnlyData data;
+        std::vector<Entry> entries; // Sorted by name.
+
+        [[nodiscard]] const Entry *Find(std::string_view name) const
+        {
+            auto iter = std::lower_bound(entries.begin(), entries.end(), name, [](const Entry &entry, std::string_view name){return entry.name < name;});
+            return iter != entries.end() && iter->name == name ? &*iter : nullptr;
+        }
+
+      public:
+        PackFile() {}
+
+        // Parses the pack index. Throws if it's malformed.
+        explicit PackFile(ReadOnlyData new_data) : data(std::move(new_data))
+        {
+            Input input(data);
+            input.WantLocationStyle(byte_offset);
+
+            if (!input.DiscardChars<if_present>(impl::Pack::magic))
+                throw std::runtime_error(input.GetExceptionPrefix() + "This is not a pack file.");
+
+            std::uint32_t num_entries = input.ReadLittle<std::uint32_t>();
+            entries.reserve(std::min<std::size_t>(num_entries, input.RemainingBytes()));
+            for (std::uint32_t i = 0; i < num_entries; i++)
+            {
+                Entry &entry = entries.emplace_back();
+
+                std::uint32_t name_size = input.ReadLittle<std::uint32_t>();
+                std::size_t name_pos = input.Position();
+                input.Skip(name_size);
+                entry.name = std::string_view(data.data_char() + name_pos, name_size);
+
+                std::uint64_t offset = input.ReadLittle<std::uint64_t>();
+                std::uint64_t size = input.ReadLittle<std::uint64_t>();
+                if (offset > data.size() || size > data.size() - offset)
+                    throw std::runtime_error(input.GetExceptionPrefix() + FMT("The data of `{}` is out of bounds.", entry.name));
+                entry.offset = std::size_t(offset);
+                entry.size = std::size_t(size);
+
+                entry.flags = input.ReadLittle<std::uint8_t>();
+
+                if (i > 0 && entries[i - 1].name >= entry.name)
+                    throw std::runtime_error(input.GetExceptionPrefix() + FMT("The entry `{}` is out of order or duplicated.", entry.name));
+            }
+        }
+
+        // Maps the pack file to memory, and parses the index.
+        explicit PackFile(std::string file_name) : PackFile(ReadOnlyData::file_mapped(std::move(file_name))) {}
+        // Without this helper, `PackFile(ReadOnlyData)` would cause an ambiguity.
+        explicit PackFile(const char *file_name) : PackFile(std::string(file_name)) {}
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(data);
+        }
+
+        // Returns the name of the pack file.
+        [[nodiscard]] std::string name() const
+        {
+            return data.name();
+        }
+
+        [[nodiscard]] std::size_t NumFiles() const
+        {
+            return entries.size();
+        }
+        // Returns the name of the `i`-th file, in the alphabetical order.
+        [[nodiscard]] std::string_view FileName(std::size_t i) const
+        {
+            return entries.at(i).name;
+        }
+
+        [[nodiscard]] bool Contains(std::string_view file_name) const
+        {
+            return Find(file_name);
+        }
+
+        // Returns the file contents, or null if there is no such file.
+        // The uncompressed files are returned as slices of the pack (see `ReadOnlyData::slice()`), with no copy.
+        [[nodiscard]] ReadOnlyData OpenOpt(std::string_view file_name) const
+        {
+            const Entry *entry = Find(file_name);
+            if (!entry)
+                return {};
+
+            ReadOnlyData ret = data.slice(entry->offset, entry->size, FMT("{} (in `{}`)", entry->name, data.name()));
+            if (entry->flags & impl::Pack::compressed)
+                ret = ret.uncompress();
+            return ret;
+        }
+
+        // Returns the file contents. Throws if there is no such file.
+        [[nodiscard]] ReadOnlyData Open(std::string_view file_name) const
+        {
+            ReadOnlyData ret = OpenOpt(file_name);
+            if (!ret)
+                throw std::runtime_error(FMT("No file `{}` in the pack file `{}`.", file_name, data.name()));
+            return ret;
+        }
+    };
+
+    // Writes a pack file.
+    class PackFileWriter
+    {
+        struct Entry
+        {
+            std::string name;
+            ReadOnlyData data;
+            bool compressed = false;
+        };
+
+        std::vector<Entry> entries;
+
+      public:
+        PackFileWriter() {}
+
+        // Adds a file. If `codec` is specified, the file is compressed (see `utils/archive.h`).
+        // Throws if the name is already used.
+        void Add(std::string name, ReadOnlyData data, std::optional<Archive::Codec> codec = {})
+        {
+            if (std::any_of(entries.begin(), entries.end(), [&](const Entry &entry){return entry.name == name;}))
+                throw std::runtime_error(FMT("Duplicate file name in a pack file: `{}`.", name));
+
+            Entry &entry = entries.emplace_back();
+            entry.name = std::move(name);
+            if (codec)
+            {
+                std::vector<std::uint8_t> buffer(Archive::MaxCompressedSize(data.begin(), data.end(), *codec));
+                buffer.resize(std::size_t(Archive::Compress(data.begin(), data.end(), buffer.data(), buffer.data() + buffer.size(), *codec) - buffer.data()));
+                entry.data = ReadOnlyData::mem_copy(buffer);
+                entry.compressed = true;
+            }
+            else
+            {
+                entry.data = std::move(data);
+            }
+        }
+
+        // Writes the pack to a stream.
+        void Save(Output &output)
+        {
+            std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b){return a.name < b.name;});
+
+            std::size_t offset = impl::Pack::magic.size() + sizeof(std::uint32_t);
+            for (const Entry &entry : entries)
+                offset += sizeof(std::uint32_t) + entry.name.size() + sizeof(std::uint64_t) * 2 + sizeof(std::uint8_t);
+
+            output.WriteString(impl::Pack::magic.data(), impl::Pack::magic.size());
+            output.WriteLittle<std::uint32_t>(std::uint32_t(entries.size()));
+            for (const Entry &entry : entries)
+            {
+                output.WriteLittle<std::uint32_t>(std::uint32_t(entry.name.size()));
+                output.WriteString(entry.name);
+                output.WriteLittle<std::uint64_t>(offset);
+                output.WriteLittle<std::uint64_t>(entry.data.size());
+                output.WriteLittle<std::uint8_t>(entry.compressed ? impl::Pack::compressed : 0);
+                offset += entry.data.size();
+            }
+
+            for (const Entry &entry : entries)
+                output.WriteBytes(entry.data.data(), entry.data.size());
+        }
+
+        // Writes the pack to a file.
+        void Save(std::string file_name)
+        {
+            Output output(std::move(file_name));
+            Save(output);
+            output.Flush();
+        }
+    };
+
+    namespace impl::Pack
+    {
+        struct Mount
+        {
+            std::string prefix;
+            PackFile pack;
+        };
+
+        [[nodiscard]] inline std::vector<Mount> &GetMounts()
+        {
+            static std::vector<Mount> ret;
+            return ret;
+        }
+    }
+
+    // Makes files `prefix + name` load from the pack, where `name` is the name in the pack.
+    // The packs mounted later take priority. The files missing from all packs are loaded from the file system as usual.
+    // Not thread-safe, mount the packs once on startup.
+    inline void MountPackFile(PackFile pack, std::string prefix = "")
+    {
+        impl::Pack::GetMounts().push_back({std::move(prefix), std::move(pack)});
+
+        ReadOnlyData::FileOverride() = [](const std::string &file_name) -> ReadOnlyData
+        {
+            const auto &mounts = impl::Pack::GetMounts();
+            for (auto iter = mounts.rbegin(); iter != mounts.rend(); iter++)
+            {
+                if (file_name.starts_with(iter->prefix))
+                {
+                    if (ReadOnlyData ret = iter->pack.OpenOpt(std::string_view(file_name).substr(iter->prefix.size())))
+                        return ret;
+                }
+            }
+            return {};
+        };
+    }
+
+    // Unmounts all packs mounted with `MountPackFile()`.
+    inline void UnmountAllPackFiles()
+    {
+        impl::Pack::GetMounts().clear();
+        ReadOnlyData::FileOverride() = nullptr;
+    }
+}
@@ -13,6 +13,7 @@
 
 #include "macros/finally.h"
 #include "stream/better_fopen.h"
+#include "stream/mapped_file.h"
 #include "stream/utils.h"
 #include "strings/format.h"
 #include "utils/archive.h"
@@ -26,6 +27,8 @@ namespace Stream
         struct Data
         {
             std::unique_ptr<std::uint8_t[]> storage;
+            MappedFile mapping; // Used instead of `storage` for the memory-mapped files.
+            std::shared_ptr<const Data> owner; // Used instead of `storage` for the slices of other objects, to keep them alive.
 
             const std::uint8_t *begin = 0, *end = 0;
             bool extra_null_terminator = false; // If this is `true`, there is an extra null terminator past the `end`.
@@ -36,6 +39,20 @@ namespace Stream
         std::shared_ptr<Data> ref;
 
       public:
+        // If set, `file()` and `file_mapped()` call this first, and use the result instead of the actual file if it's not null.
+        // `stream/pack_file.h` uses this to serve the files from the pack files. Not thread-safe, set it once on startup.
+        using file_override_func_t = std::function<ReadOnlyData(const std::string &file_name)>;
+        [[nodiscard]] static file_override_func_t &FileOverride()
+        {
+            static file_override_func_t ret;
+            return ret;
+        }
+        // Returns the result of `FileOverride()`, or null if it's not set.
+        [[nodiscard]] static ReadOnlyData TryFileOverride(const std::string &file_name)
+        {
+            return FileOverride() ? FileOverride()(file_name) : ReadOnlyData{};
+        }
+
         ReadOnlyData() {}
 
         ReadOnlyData(std::string file_name)
@@ -131,6 +148,9 @@ namespace Stream
         // Loads an entire file to memory, adds a null-terminator.
         [[nodiscard]] static ReadOnlyData file(std::string file_name)
         {
+            if (ReadOnlyData ret = TryFileOverride(file_name))
+                return ret;
+
             ReadOnlyData ret;
             ret.ref = std::make_shared<Data>();
 
@@ -161,6 +181,37 @@ namespace Stream
             return ret;
         }
 
+        // Maps an entire file to memory, instead of reading it. This avoids the copy, and the pages are loaded on demand.
+        // Prefer this for large files. Falls back to `file()` if the file can't be mapped (e.g. if it's empty).
+        // The null-terminator is only present if the file size isn't a multiple of the page size (then the rest of the page is zero-filled).
+        //   Otherwise `string()` and `null_terminate()` make a copy.
+        [[nodiscard]] static ReadOnlyData file_mapped(std::string file_name)
+        {
+            if (ReadOnlyData ret = TryFileOverride(file_name))
+                return ret;
+
+            MappedFile mapping;
+            try
+            {
+                mapping = MappedFile(file_name);
+            }
+            catch (...)
+            {
+                return file(std::move(file_name));
+            }
+
+            ReadOnlyData ret;
+            ret.ref = std::make_shared<Data>();
+
+            ret.ref->begin = mapping.data();
+            ret.ref->end = mapping.data() + mapping.size();
+            ret.ref->extra_null_terminator = mapping.has_null_terminator();
+            ret.ref->mapping = std::move(mapping);
+            ret.ref->name = std::move(file_name);
+
+            return ret;
+        }
+
         [[nodiscard]] explicit operator bool() const
         {
             return bool(ref);
@@ -219,6 +270,27 @@ namespace Stream
             return reinterpret_cast<const char *>(ref->end);
         }
 
+        // Returns a part of the data, without copying it. The result keeps this object alive.
+        // The slice has no null-terminator, unless it extends to the end and this object has one.
+        [[nodiscard]] ReadOnlyData slice(std::size_t offset, std::size_t size, std::string new_name) const
+        {
+            if (!ref)
+                return {};
+            if (offset > this->size() || size > this->size() - offset)
+                throw std::runtime_error(FMT("The slice at {} of {} bytes is out of bounds of `{}`.", offset, size, ref->name));
+
+            ReadOnlyData ret;
+            ret.ref = std::make_shared<Data>();
+
+            ret.ref->begin = ref->begin + offset;
+            ret.ref->end = ret.ref->begin + size;
+            ret.ref->extra_null_terminator = ret.ref->end == ref->end && ref->extra_null_terminator;
+            ret.ref->owner = ref;
+            ret.ref->name = std::move(new_name);
+
+            return ret;
+        }
+
         // Returns an uncompressed copy of the file.
         // The data is assumed to be size-prefixed, see `archive.h` for the details.
         [[nodiscard]] ReadOnlyData uncompress() const
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "stream/save_to_file.h"
+
+namespace Stream
+{
+    // Saves files on a background thread, using `SaveFileAtomic()`.
+    // The files are written in the order they were queued. The destructor finishes all pending saves.
+    // Combine with `Output::Container()` or `Output::ContainerDirect()` to serialize into a vector, then move the vector here.
+    class SaveQueue
+    {
+        struct Task
+        {
+            std::string file_name;
+            std::vector<std::uint8_t> data;
+            bool sync = false;
+            std::function<void(std::exception_ptr error)> on_done; // Receives null on success.
+        };
+
+        std::mutex mutex;
+        std::condition_variable cv, idle_cv;
+        std::deque<Task> tasks;
+        bool busy = false; // Whether the worker is processing a task that was removed from `tasks`.
+        bool stop = false;
+
+        std::jthread worker; // Must be the last member, to stop first.
+
+        void WorkerLoop()
+        {
+            std::unique_lock lock(mutex);
+            while (true)
+            {
+                cv.wait(lock, [&]{return stop || !tasks.empty();});
+                if (tasks.empty())
+                    return; // Only stop after the queue is drained.
+
+                Task task = std::move(tasks.front());
+                tasks.pop_front();
+                busy = true;
+                lock.unlock();
+
+                std::exception_ptr error;
+                try
+                {
+                    SaveFileAtomic(task.file_name, task.data, task.sync);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                task.data = {}; // Free the memory early.
+                if (task.on_done)
+                    task.on_done(error);
+
+                lock.lock();
+                busy = false;
+                idle_cv.notify_all();
+            }
+        }
+
+      public:
+        SaveQueue()
+        {
+            worker = std::jthread([this]{WorkerLoop();});
+        }
+
+        SaveQueue(const SaveQueue &) = delete;
+        SaveQueue &operator=(const SaveQueue &) = delete;
+
+        ~SaveQueue()
+        {
+            {
+                std::lock_guard lock(mutex);
+                stop = true;
+            }
+            cv.notify_all();
+        }
+
+        // Queues a file for saving. `on_done` is called on the worker thread, with null on success or the exception on failure.
+        void Save(std::string file_name, std::vector<std::uint8_t> data, bool sync, std::function<void(std::exception_ptr error)> on_done)
+        {
+            {
+                std::lock_guard lock(mutex);
+                tasks.push_back({std::move(file_name), std::move(data), sync, std::move(on_done)});
+            }
+            cv.notify_all();
+        }
+
+        // Queues a file for saving. The returned future rethrows on failure.
+        std::future<void> Save(std::string file_name, std::vector<std::uint8_t> data, bool sync = false)
+        {
+            auto promise = std::make_shared<std::promise<void>>();
+            std::future<void> ret = promise->get_future();
+            Save(std::move(file_name), std::move(data), sync, [promise](std::exception_ptr error)
+            {
+                if (error)
+                    promise->set_exception(error);
+                else
+                    promise->set_value();
+            });
+            return ret;
+        }
+
+        // Blocks until all queued files are saved.
+        void WaitUntilIdle()
+        {
+            std::unique_lock lock(mutex);
+            idle_cv.wait(lock, [&]{return tasks.empty() && !busy;});
+        }
+
+        // Whether there are files that aren't saved yet.
+        [[nodiscard]] bool IsBusy()
+        {
+            std::lock_guard lock(mutex);
+            return !tasks.empty() || busy;
+        }
+    };
+}
@@ -0,0 +1,58 @@
+#include "save_to_file.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+#include "program/platform.h"
+
+#if IMP_PLATFORM_IS(windows)
+#include <filesystem>
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace Stream
+{
+    void SaveFileAtomic(const std::string &file_name, const std::uint8_t *begin, const std::uint8_t *end, bool sync)
+    {
+        std::string temp_name = file_name + ".tmp";
+
+        FILE *file = better_fopen(temp_name.c_str(), "wb");
+        if (!file)
+            throw std::runtime_error(FMT("Unable to open file `{}` for writing.", temp_name));
+
+        bool ok = true;
+        {
+            FINALLY{if (std::fclose(file)) ok = false;};
+            if (begin != end && !std::fwrite(begin, end - begin, 1, file))
+                ok = false;
+            else if (sync)
+            {
+                #if IMP_PLATFORM_IS(windows)
+                ok = std::fflush(file) == 0 && _commit(_fileno(file)) == 0;
+                #else
+                ok = std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+                #endif
+            }
+        }
+        if (!ok)
+        {
+            std::remove(temp_name.c_str());
+            throw std::runtime_error(FMT("Unable to write to file `{}`.", temp_name));
+        }
+
+        // On POSIX, `rename()` atomically replaces the target. On Windows it refuses to replace existing files, so we use `MoveFileExW()`.
+        #if IMP_PLATFORM_IS(windows)
+        ok = MoveFileExW(std::filesystem::u8path(temp_name).c_str(), std::filesystem::u8path(file_name).c_str(), MOVEFILE_REPLACE_EXISTING | (sync ? MOVEFILE_WRITE_THROUGH : 0));
+        #else
+        ok = std::rename(temp_name.c_str(), file_name.c_str()) == 0;
+        #endif
+        if (!ok)
+        {
+            std::remove(temp_name.c_str());
+            throw std::runtime_error(FMT("Unable to rename `{}` to `{}`.", temp_name, file_name));
+        }
+    }
+}
@@ -66,26 +66,40 @@ namespace Stream
     }
 
 
+    // Saves a block of memory to a file, without ever leaving a partially written file in its place. Throws on failure.
+    // Writes to `<file_name>.tmp` first, then renames it over the target.
+    // If `sync` is true, flushes the data to the disk before renaming, so that the file survives a power loss. This is slow, so don't do it every frame.
+    void SaveFileAtomic(const std::string &file_name, const std::uint8_t *begin, const std::uint8_t *end, bool sync = false);
+
+    // Saves a container to a file, atomically. See above. Throws on failure.
+    template <impl::FlatByteContainer T>
+    void SaveFileAtomic(const std::string &file_name, const T &container, bool sync = false)
+    {
+        const std::uint8_t *ptr = reinterpret_cast<const std::uint8_t *>(std::data(container));
+        SaveFileAtomic(file_name, ptr, ptr + std::size(container), sync);
+    }
+
+
     // Saves a block of memory to a file, in a compressed form (see `archive.h` for details). Throws on failure.
-    inline void SaveFileCompressed(std::string file_name, const std::uint8_t *begin, const std::uint8_t *end)
+    inline void SaveFileCompressed(std::string file_name, const std::uint8_t *begin, const std::uint8_t *end, Archive::Codec codec = Archive::Codec::zlib)
     {
-        auto buffer_size = Archive::MaxCompressedSize(begin, end);
+        auto buffer_size = Archive::MaxCompressedSize(begin, end, codec);
         auto buffer = std::make_unique<std::uint8_t[]>(buffer_size);
-        auto compressed_end = Archive::Compress(begin, end, buffer.get(), buffer.get() + buffer_size);
+        auto compressed_end = Archive::Compress(begin, end, buffer.get(), buffer.get() + buffer_size, codec);
         SaveFile(file_name, buffer.get(), compressed_end);
     }
 
     // Saves a block of memory to a file, in a compressed form (see `archive.h` for details). Throws on failure.
-    inline void SaveFileCompressed(std::string file_name, const char *begin, const char *end)
+    inline void SaveFileCompressed(std::string file_name, const char *begin, const char *end, Archive::Codec codec = Archive::Codec::zlib)
     {
-        SaveFileCompressed(std::move(file_name), reinterpret_cast<const std::uint8_t *>(begin), reinterpret_cast<const std::uint8_t *>(end));
+        SaveFileCompressed(std::move(file_name), reinterpret_cast<const std::uint8_t *>(begin), reinterpret_cast<const std::uint8_t *>(end), codec);
     }
 
     // Saves a container to a file, in a compressed form (see `archive.h` for details). Throws on failure.
     template <impl::FlatByteContainer T>
-    void SaveFileCompressed(std::string file_name, const T &container)
+    void SaveFileCompressed(std::string file_name, const T &container, Archive::Codec codec = Archive::Codec::zlib)
     {
         const std::uint8_t *ptr = reinterpret_cast<const std::uint8_t *>(std::data(container));
-        SaveFileCompressed(std::move(file_name), ptr, ptr + std::size(container));
+        SaveFileCompressed(std::move(file_name), ptr, ptr + std::size(container), codec);
     }
 }
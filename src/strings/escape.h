@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cctype>
+#include <cstddef>
 #include <cstdio>
 #include <iterator>
 #include <string>
@@ -12,6 +15,10 @@
 #include "strings/format.h"
 #include "utils/unicode.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace Strings
 {
     enum class EscapeFlags
@@ -27,70 +34,164 @@ namespace Strings
     [[nodiscard]] inline EscapeFlags operator&(EscapeFlags a, EscapeFlags b) {return EscapeFlags(int(a) & int(b));}
     [[nodiscard]] inline EscapeFlags operator|(EscapeFlags a, EscapeFlags b) {return EscapeFlags(int(a) | int(b));}
 
-    // Escapes a string.
-    // By default, all control characters are escaped, including `\n` and `\r`, and extended (>= 128) characters are not escaped.
-    // If a character can't be escaped with a single symbol (\?), then \xNN is always used.
-    template <typename Iter> requires requires(Iter i){*i++ = char();}
-    void Escape(std::string_view str, Iter output_iter, EscapeFlags flags = EscapeFlags::no_flags)
+    namespace impl::EscapeLow
     {
-        auto OutputString = [&](const char *ptr)
+        // Output adaptors, so that the whole runs of characters can be appended to strings at once.
+        template <typename Iter>
+        struct IterOutput
         {
-            while (*ptr)
-                *output_iter++ = *ptr++;
+            Iter &iter;
+            void operator()(char ch) {*iter++ = ch;}
+            void Run(const char *ptr, std::size_t size) {iter = std::copy_n(ptr, size, iter);}
+        };
+        struct StringOutput
+        {
+            std::string &str;
+            void operator()(char ch) {str += ch;}
+            void Run(const char *ptr, std::size_t size) {str.append(ptr, size);}
         };
 
-        for (unsigned char ch : str)
+        // Returns the number of bytes at the beginning of the range that are not `a`, `b`, or `c`.
+        [[nodiscard]] inline std::size_t PrefixWithout(const char *begin, const char *end, char a, char b, char c)
         {
-            // Skip `\r` if we have the `strip_cr` flag.
-            if (bool(flags & EscapeFlags::strip_cr) && ch == '\r')
-                continue;
-
-            bool should_escape =
-                // Escape 0..31, except for `\n` if we have the `multiline` flag.
-                (ch < ' ' && (!bool(flags & EscapeFlags::multiline) || ch != '\n')) ||
-                // Escape `DEL`.
-                ch == 0x7f ||
-                // Escape 128..255 if we have the `escape_extended_chars` flag.
-                (bool(flags & EscapeFlags::escape_extended_chars) && ch >= 128) ||
-                // Escape single quotes if the corresponding flag is set.
-                (bool(flags & EscapeFlags::escape_single_quotes) && ch == '\'') ||
-                // Escape double quotes if the corresponding flag is set.
-                (bool(flags & EscapeFlags::escape_double_quotes) && ch == '\"');
-
-            if (!should_escape)
+            const char *cur = begin;
+            #if defined(__SSE2__)
+            const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), vc = _mm_set1_epi8(c);
+            while (end - cur >= 16)
             {
-                *output_iter++ = ch;
-                continue;
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+                __m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, va), _mm_cmpeq_epi8(bytes, vb)), _mm_cmpeq_epi8(bytes, vc));
+                if (unsigned int mask = unsigned(_mm_movemask_epi8(found)))
+                    return std::size_t(cur - begin) + std::size_t(std::countr_zero(mask));
+                cur += 16;
             }
+            #endif
+            while (cur != end && *cur != a && *cur != b && *cur != c)
+                cur++;
+            return std::size_t(cur - begin);
+        }
+
+        // Returns the number of bytes at the beginning of the range that `Escape()` copies as is.
+        // Can return less than that (e.g. it stops at `\n` even in the multiline mode), then the slow path handles the rest.
+        [[nodiscard]] inline std::size_t CleanPrefixLength(const char *begin, const char *end, EscapeFlags flags)
+        {
+            bool extended = bool(flags & EscapeFlags::escape_extended_chars);
+            // `0x7f` is always escaped, so we use it when there's no quote to look for.
+            char quote_a = bool(flags & EscapeFlags::escape_single_quotes) ? '\'' : 0x7f;
+            char quote_b = bool(flags & EscapeFlags::escape_double_quotes) ? '\"' : 0x7f;
+
+            auto IsClean = [&](unsigned char ch)
+            {
+                return ch >= ' ' && ch != 0x7f && ch != (unsigned char)quote_a && ch != (unsigned char)quote_b && (!extended || ch < 128);
+            };
+
+            const char *cur = begin;
+            #if defined(__SSE2__)
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i del = _mm_set1_epi8(0x7f);
+            const __m128i va = _mm_set1_epi8(quote_a), vb = _mm_set1_epi8(quote_b);
+            while (end - cur >= 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+                __m128i at_least_space = _mm_cmpeq_epi8(_mm_max_epu8(bytes, space), bytes);
+                __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, del), _mm_cmpeq_epi8(bytes, va)), _mm_cmpeq_epi8(bytes, vb));
+                unsigned int mask = unsigned(_mm_movemask_epi8(_mm_andnot_si128(at_least_space, _mm_set1_epi8(-1)))) | unsigned(_mm_movemask_epi8(special));
+                if (extended)
+                    mask |= unsigned(_mm_movemask_epi8(bytes));
+                if (mask)
+                    return std::size_t(cur - begin) + std::size_t(std::countr_zero(mask));
+                cur += 16;
+            }
+            #endif
+            while (cur != end && IsClean(*cur))
+                cur++;
+            return std::size_t(cur - begin);
+        }
+
+        template <typename Output>
+        void Escape(std::string_view str, Output output, EscapeFlags flags)
+        {
+            auto OutputString = [&](const char *ptr)
+            {
+                while (*ptr)
+                    output(*ptr++);
+            };
 
-            switch (ch)
+            const char *cur = str.data();
+            const char *end = cur + str.size();
+            while (cur != end)
             {
-                case '\0': OutputString(R"(\0)"); break;
-                case '\'': OutputString(R"(\')"); break;
-                case '\"': OutputString(R"(\")"); break;
-                case '\\': OutputString(R"(\\)"); break;
-                case '\a': OutputString(R"(\a)"); break;
-                case '\b': OutputString(R"(\b)"); break;
-                case '\f': OutputString(R"(\f)"); break;
-                case '\n': OutputString(R"(\n)"); break;
-                case '\r': OutputString(R"(\r)"); break;
-                case '\t': OutputString(R"(\t)"); break;
-                case '\v': OutputString(R"(\v)"); break;
-
-              default:
+                // Copy the characters that don't need escaping in bulk.
+                std::size_t clean = CleanPrefixLength(cur, end, flags);
+                output.Run(cur, clean);
+                cur += clean;
+                if (cur == end)
+                    break;
+
+                unsigned char ch = *cur++;
+
+                // Skip `\r` if we have the `strip_cr` flag.
+                if (bool(flags & EscapeFlags::strip_cr) && ch == '\r')
+                    continue;
+
+                bool should_escape =
+                    // Escape 0..31, except for `\n` if we have the `multiline` flag.
+                    (ch < ' ' && (!bool(flags & EscapeFlags::multiline) || ch != '\n')) ||
+                    // Escape `DEL`.
+                    ch == 0x7f ||
+                    // Escape 128..255 if we have the `escape_extended_chars` flag.
+                    (bool(flags & EscapeFlags::escape_extended_chars) && ch >= 128) ||
+                    // Escape single quotes if the corresponding flag is set.
+                    (bool(flags & EscapeFlags::escape_single_quotes) && ch == '\'') ||
+                    // Escape double quotes if the corresponding flag is set.
+                    (bool(flags & EscapeFlags::escape_double_quotes) && ch == '\"');
+
+                if (!should_escape)
                 {
-                    char buffer[5]; // 5 bytes for: \ x N N \0
-                    std::snprintf(buffer, sizeof buffer, "\\x%02X", ch);
-                    OutputString(buffer);
+                    output(ch);
+                    continue;
+                }
+
+                switch (ch)
+                {
+                    case '\0': OutputString(R"(\0)"); break;
+                    case '\'': OutputString(R"(\')"); break;
+                    case '\"': OutputString(R"(\")"); break;
+                    case '\\': OutputString(R"(\\)"); break;
+                    case '\a': OutputString(R"(\a)"); break;
+                    case '\b': OutputString(R"(\b)"); break;
+                    case '\f': OutputString(R"(\f)"); break;
+                    case '\n': OutputString(R"(\n)"); break;
+                    case '\r': OutputString(R"(\r)"); break;
+                    case '\t': OutputString(R"(\t)"); break;
+                    case '\v': OutputString(R"(\v)"); break;
+
+                  default:
+                    {
+                        char buffer[5]; // 5 bytes for: \ x N N \0
+                        std::snprintf(buffer, sizeof buffer, "\\x%02X", ch);
+                        OutputString(buffer);
+                    }
+                    break;
                 }
-                break;
             }
         }
     }
+
+    // Escapes a string.
+    // By default, all control characters are escaped, including `\n` and `\r`, and extended (>= 128) characters are not escaped.
+    // If a character can't be escaped with a single symbol (\?), then \xNN is always used.
+    // The runs of characters that don't need escaping are copied in bulk.
+    template <typename Iter> requires requires(Iter i){*i++ = char();}
+    void Escape(std::string_view str, Iter output_iter, EscapeFlags flags = EscapeFlags::no_flags)
+    {
+        impl::EscapeLow::Escape(str, impl::EscapeLow::IterOutput<Iter>{output_iter}, flags);
+    }
     [[nodiscard]] inline std::string Escape(std::string_view str, EscapeFlags flags = EscapeFlags::no_flags)
     {
         std::string ret;
-        Escape(str, std::back_inserter(ret), flags);
+        ret.reserve(str.size());
+        impl::EscapeLow::Escape(str, impl::EscapeLow::StringOutput{ret}, flags);
         return ret;
     }
 
@@ -108,131 +209,145 @@ namespace Strings
     [[nodiscard]] inline UnescapeFlags operator&(UnescapeFlags a, UnescapeFlags b) {return UnescapeFlags(int(a) & int(b));}
     [[nodiscard]] inline UnescapeFlags operator|(UnescapeFlags a, UnescapeFlags b) {return UnescapeFlags(int(a) | int(b));}
 
-    // Unescapes a string. Throws on failure.
-    // Supports following escape sequences: \', \", \\, \a, \b, \f, \n, \r, \t, \v.
-    // Doesn't support \?, because it's stupid.
-    // Additionally supports octal \[0-7]{1,3}, hex \x[a-zA-Z0-9]{1,2}, and unicode \u[a-zA-Z0-9]{4}, \U[a-zA-Z0-9]{8} escapes.
-    template <typename Iter> requires requires(Iter i){*i++ = char();}
-    void Unescape(std::string_view str, Iter output_iter, UnescapeFlags flags = UnescapeFlags::no_flags)
+    namespace impl::EscapeLow
     {
-        auto cur = str.begin();
-        const auto end = str.end();
-
-        std::array<char, 9> buffer; // The max amount of digits we might need to read is 8 (for \U escape), and we need room for a null-terminator.
-
-        // `pred` is `bool pred(char)`.
-        // Fills `buffer` with at most `max_count` symbols, stops if `pred` returns `false` for a symbol.
-        // Adds a null terminator.
-        // Returns the amount of extracted symbols, not including the null-terminator.
-        auto ReadSeveralSymbols = [&cur, &end, &buffer](std::size_t max_count, auto pred) -> int
+        template <typename Output>
+        void Unescape(std::string_view str, Output output, UnescapeFlags flags)
         {
-            assert(max_count <= buffer.size() - 1);
-            std::size_t buf_pos = 0;
-            while (cur < end && buf_pos < max_count && pred(*cur))
-                buffer[buf_pos++] = *cur++;
-            buffer[buf_pos] = '\0';
-            return buf_pos;
-        };
+            const char *cur = str.data();
+            const char *end = cur + str.size();
 
-        auto IsOctalDigit = [](char ch){return ch >= '0' && ch <= '7';};
-        auto IsHexDigit = [](char ch){return std::isxdigit((unsigned char)ch);};
+            std::array<char, 9> buffer; // The max amount of digits we might need to read is 8 (for \U escape), and we need room for a null-terminator.
 
-        while (cur < end)
-        {
-            if (*cur != '\\')
+            // `pred` is `bool pred(char)`.
+            // Fills `buffer` with at most `max_count` symbols, stops if `pred` returns `false` for a symbol.
+            // Adds a null terminator.
+            // Returns the amount of extracted symbols, not including the null-terminator.
+            auto ReadSeveralSymbols = [&cur, &end, &buffer](std::size_t max_count, auto pred) -> int
             {
-                if (!bool(flags & UnescapeFlags::strip_cr_bytes) || *cur != '\r')
-                    *output_iter++ = *cur;
-                cur++;
-            }
-            else
-            {
-                cur++; // Skip `\`.
-                if (cur == end)
-                    throw std::runtime_error("Unfinished escape sequence at the end of string.");
+                assert(max_count <= buffer.size() - 1);
+                std::size_t buf_pos = 0;
+                while (cur < end && buf_pos < max_count && pred(*cur))
+                    buffer[buf_pos++] = *cur++;
+                buffer[buf_pos] = '\0';
+                return buf_pos;
+            };
 
-                switch (*cur++)
+            auto IsOctalDigit = [](char ch){return ch >= '0' && ch <= '7';};
+            auto IsHexDigit = [](char ch){return std::isxdigit((unsigned char)ch);};
+
+            while (cur < end)
+            {
+                if (*cur != '\\')
                 {
-                    // Don't handle `\?`, because it's stupid.
-                    case '\'': *output_iter++ = '\''; break;
-                    case '\"': *output_iter++ = '\"'; break;
-                    case '\\': *output_iter++ = '\\'; break;
-                    case 'a': *output_iter++ = '\a'; break;
-                    case 'b': *output_iter++ = '\b'; break;
-                    case 'f': *output_iter++ = '\f'; break;
-                    case 'n': *output_iter++ = '\n'; break;
-                    case 'r': *output_iter++ = '\r'; break;
-                    case 't': *output_iter++ = '\t'; break;
-                    case 'v': *output_iter++ = '\v'; break;
+                    // Copy the characters up to the next backslash (or `\r`, if we're stripping them) in bulk.
+                    bool strip_cr = bool(flags & UnescapeFlags::strip_cr_bytes);
+                    std::size_t clean = PrefixWithout(cur, end, '\\', strip_cr ? '\r' : '\\', '\\');
+                    output.Run(cur, clean);
+                    cur += clean;
+                    if (cur != end && *cur == '\r')
+                        cur++; // Strip it.
+                }
+                else
+                {
+                    cur++; // Skip `\`.
+                    if (cur == end)
+                        throw std::runtime_error("Unfinished escape sequence at the end of string.");
 
-                  default:
+                    switch (*cur++)
                     {
-                        cur--;
-                        if (!IsOctalDigit(*cur))
-                            throw std::runtime_error(FMT("Invalid escape sequence: `\\{}`.", *cur));
+                        // Don't handle `\?`, because it's stupid.
+                        case '\'': output('\''); break;
+                        case '\"': output('\"'); break;
+                        case '\\': output('\\'); break;
+                        case 'a': output('\a'); break;
+                        case 'b': output('\b'); break;
+                        case 'f': output('\f'); break;
+                        case 'n': output('\n'); break;
+                        case 'r': output('\r'); break;
+                        case 't': output('\t'); break;
+                        case 'v': output('\v'); break;
 
-                        ReadSeveralSymbols(3, IsOctalDigit);
+                      default:
+                        {
+                            cur--;
+                            if (!IsOctalDigit(*cur))
+                                throw std::runtime_error(FMT("Invalid escape sequence: `\\{}`.", *cur));
 
-                        unsigned int value = 0;
-                        std::sscanf(buffer.data(), "%o", &value);
-                        if (value > 255)
-                            throw std::runtime_error("Octal escape sequence with a value larger than 255.");
+                            ReadSeveralSymbols(3, IsOctalDigit);
 
-                        *output_iter++ = char(value);
-                    }
-                    break;
+                            unsigned int value = 0;
+                            std::sscanf(buffer.data(), "%o", &value);
+                            if (value > 255)
+                                throw std::runtime_error("Octal escape sequence with a value larger than 255.");
 
-                  case 'x':
-                    {
-                        if (ReadSeveralSymbols(2, IsHexDigit) == 0)
-                            throw std::runtime_error("Expected at least one hex digit after `\\x`");
+                            output(char(value));
+                        }
+                        break;
 
-                        unsigned int value = 0;
-                        std::sscanf(buffer.data(), "%x", &value);
+                      case 'x':
+                        {
+                            if (ReadSeveralSymbols(2, IsHexDigit) == 0)
+                                throw std::runtime_error("Expected at least one hex digit after `\\x`");
 
-                        *output_iter++ = char(value);
-                    }
-                    break;
+                            unsigned int value = 0;
+                            std::sscanf(buffer.data(), "%x", &value);
 
-                  case 'u':
-                    {
-                        if (ReadSeveralSymbols(4, IsHexDigit) != 4)
-                            throw std::runtime_error("Expected 4 hex digits after `\\u`");
-
-                        unsigned int value = 0;
-                        std::sscanf(buffer.data(), "%x", &value);
-                        char output_buf[Unicode::max_char_len];
-                        int output_len = Unicode::Encode(value, output_buf);
-                        for (int i = 0; i < output_len; i++)
-                            *output_iter++ = output_buf[i];
-                    }
-                    break;
+                            output(char(value));
+                        }
+                        break;
 
-                  case 'U':
-                    {
-                        if (ReadSeveralSymbols(8, IsHexDigit) != 8)
-                            throw std::runtime_error("Expected 8 hex digits after `\\U`");
+                      case 'u':
+                        {
+                            if (ReadSeveralSymbols(4, IsHexDigit) != 4)
+                                throw std::runtime_error("Expected 4 hex digits after `\\u`");
+
+                            unsigned int value = 0;
+                            std::sscanf(buffer.data(), "%x", &value);
+                            char output_buf[Unicode::max_char_len];
+                            int output_len = Unicode::Encode(value, output_buf);
+                            for (int i = 0; i < output_len; i++)
+                                output(output_buf[i]);
+                        }
+                        break;
+
+                      case 'U':
+                        {
+                            if (ReadSeveralSymbols(8, IsHexDigit) != 8)
+                                throw std::runtime_error("Expected 8 hex digits after `\\U`");
 
-                        unsigned int value = 0;
-                        std::sscanf(buffer.data(), "%x", &value);
+                            unsigned int value = 0;
+                            std::sscanf(buffer.data(), "%x", &value);
 
-                        if (!Unicode::IsValidCharacterCode(value))
-                            throw std::runtime_error("Unicode codepoint specified in the escape sequence is too large.");
+                            if (!Unicode::IsValidCharacterCode(value))
+                                throw std::runtime_error("Unicode codepoint specified in the escape sequence is too large.");
 
-                        char output_buf[Unicode::max_char_len];
-                        int output_len = Unicode::Encode(value, output_buf);
-                        for (int i = 0; i < output_len; i++)
-                            *output_iter++ = output_buf[i];
+                            char output_buf[Unicode::max_char_len];
+                            int output_len = Unicode::Encode(value, output_buf);
+                            for (int i = 0; i < output_len; i++)
+                                output(output_buf[i]);
+                        }
+                        break;
                     }
-                    break;
                 }
             }
         }
     }
+
+    // Unescapes a string. Throws on failure.
+    // Supports following escape sequences: \', \", \\, \a, \b, \f, \n, \r, \t, \v.
+    // Doesn't support \?, because it's stupid.
+    // Additionally supports octal \[0-7]{1,3}, hex \x[a-zA-Z0-9]{1,2}, and unicode \u[a-zA-Z0-9]{4}, \U[a-zA-Z0-9]{8} escapes.
+    template <typename Iter> requires requires(Iter i){*i++ = char();}
+    void Unescape(std::string_view str, Iter output_iter, UnescapeFlags flags = UnescapeFlags::no_flags)
+    {
+        impl::EscapeLow::Unescape(str, impl::EscapeLow::IterOutput<Iter>{output_iter}, flags);
+    }
     [[nodiscard]] inline std::string Unescape(std::string_view str, UnescapeFlags flags = UnescapeFlags::no_flags)
     {
         std::string ret;
-        Unescape(str, std::back_inserter(ret), flags);
+        ret.reserve(str.size());
+        impl::EscapeLow::Unescape(str, impl::EscapeLow::StringOutput{ret}, flags);
         return ret;
     }
 }
@@ -0,0 +1,178 @@
+#include "escape.h"
+
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    using Strings::EscapeFlags;
+    using Strings::UnescapeFlags;
+
+    // All combinations of the escape flags.
+    [[nodiscard]] std::vector<EscapeFlags> AllEscapeFlags()
+    {
+        std::vector<EscapeFlags> ret;
+        for (int i = 0; i < 32; i++)
+            ret.push_back(EscapeFlags(i));
+        return ret;
+    }
+
+    // The per-character implementation that `Escape()` used before the bulk copying, to compare against.
+    [[nodiscard]] std::string ReferenceEscape(std::string_view str, EscapeFlags flags)
+    {
+        std::string ret;
+        for (unsigned char ch : str)
+        {
+            if (bool(flags & EscapeFlags::strip_cr) && ch == '\r')
+                continue;
+
+            bool should_escape =
+                (ch < ' ' && (!bool(flags & EscapeFlags::multiline) || ch != '\n')) ||
+                ch == 0x7f ||
+                (bool(flags & EscapeFlags::escape_extended_chars) && ch >= 128) ||
+                (bool(flags & EscapeFlags::escape_single_quotes) && ch == '\'') ||
+                (bool(flags & EscapeFlags::escape_double_quotes) && ch == '\"');
+
+            if (!should_escape)
+            {
+                ret += char(ch);
+                continue;
+            }
+
+            switch (ch)
+            {
+                case '\0': ret += R"(\0)"; break;
+                case '\'': ret += R"(\')"; break;
+                case '\"': ret += R"(\")"; break;
+                case '\a': ret += R"(\a)"; break;
+                case '\b': ret += R"(\b)"; break;
+                case '\f': ret += R"(\f)"; break;
+                case '\n': ret += R"(\n)"; break;
+                case '\r': ret += R"(\r)"; break;
+                case '\t': ret += R"(\t)"; break;
+                case '\v': ret += R"(\v)"; break;
+                default: ret += FMT("\\x{:02X}", ch); break;
+            }
+        }
+        return ret;
+    }
+
+    // Random strings made mostly of long clean runs (longer than the 16-byte SIMD blocks), with some special bytes in between.
+    [[nodiscard]] std::string RandomString(std::mt19937 &gen)
+    {
+        static constexpr char special[] = {'\0', '\n', '\r', '\t', '\x01', '\x1f', '\x7f', '\'', '\"', '\\', ' ', '~', '\x80', '\xff'};
+
+        std::string ret;
+        int num_runs = int(gen() % 5);
+        for (int i = 0; i < num_runs; i++)
+        {
+            std::size_t run_len = gen() % 50;
+            for (std::size_t j = 0; j < run_len; j++)
+                ret += char(' ' + gen() % ('~' - ' ' + 1));
+            std::size_t num_special = gen() % 3;
+            for (std::size_t j = 0; j < num_special; j++)
+                ret += gen() % 4 == 0 ? char(gen()) : special[gen() % std::size(special)];
+        }
+        return ret;
+    }
+}
+
+TEST_CASE("escape.basic")
+{
+    REQUIRE(Strings::Escape("hello, world") == "hello, world");
+    REQUIRE(Strings::Escape("a\nb\r\tc\x7f") == R"(a\nb\r\tc\x7F)");
+    REQUIRE(Strings::Escape("a\nb\r\n", EscapeFlags::multiline) == "a\nb\\r\n");
+    REQUIRE(Strings::Escape("a\nb\r\n", EscapeFlags::multiline_without_cr) == "a\nb\n");
+    REQUIRE(Strings::Escape(R"('")") == R"('")");
+    REQUIRE(Strings::Escape(R"('")", EscapeFlags::escape_single_quotes) == R"(\'")");
+    REQUIRE(Strings::Escape(R"('")", EscapeFlags::escape_double_quotes) == R"('\")");
+    REQUIRE(Strings::Escape("\xd0\xb9") == "\xd0\xb9");
+    REQUIRE(Strings::Escape("\xd0\xb9", EscapeFlags::escape_extended_chars) == R"(\xD0\xB9)");
+    REQUIRE(Strings::Escape(std::string_view("\0", 1)) == R"(\0)");
+    REQUIRE(Strings::Escape('\n') == R"(\n)");
+
+    // The special characters past the first 16-byte block.
+    std::string long_clean(40, 'x');
+    REQUIRE(Strings::Escape(long_clean) == long_clean);
+    REQUIRE(Strings::Escape(long_clean + "\n" + long_clean + "\x7f") == long_clean + R"(\n)" + long_clean + R"(\x7F)");
+    REQUIRE(Strings::Escape(long_clean + "\"", EscapeFlags::escape_double_quotes) == long_clean + R"(\")");
+    REQUIRE(Strings::Escape(long_clean + "\x80", EscapeFlags::escape_extended_chars) == long_clean + R"(\x80)");
+
+    // The iterator overload.
+    std::string out;
+    Strings::Escape(long_clean + "\t", std::back_inserter(out));
+    REQUIRE(out == long_clean + R"(\t)");
+}
+
+TEST_CASE("escape.unescape_basic")
+{
+    REQUIRE(Strings::Unescape("hello, world") == "hello, world");
+    REQUIRE(Strings::Unescape(R"(\'\"\\\a\b\f\n\r\t\v)") == "\'\"\\\a\b\f\n\r\t\v");
+    REQUIRE(Strings::Unescape(R"(\0\101\x41\x4)") == std::string("\0AA\x04", 4));
+    REQUIRE(Strings::Unescape(R"(й\U0001F600)") == "\xd0\xb9\xf0\x9f\x98\x80");
+
+    std::string long_clean(40, 'x');
+    REQUIRE(Strings::Unescape(long_clean + R"(\n)" + long_clean) == long_clean + "\n" + long_clean);
+    REQUIRE(Strings::Unescape(long_clean + "\r\n" + long_clean + "\r") == long_clean + "\r\n" + long_clean + "\r");
+    REQUIRE(Strings::Unescape(long_clean + "\r\n" + long_clean + "\r", UnescapeFlags::strip_cr_bytes) == long_clean + "\n" + long_clean);
+    REQUIRE(Strings::Unescape(long_clean + "\r" + R"(\r)", UnescapeFlags::strip_cr_bytes) == long_clean + "\r");
+
+    // The iterator overload.
+    std::string out;
+    Strings::Unescape(long_clean + R"(\t)", std::back_inserter(out));
+    REQUIRE(out == long_clean + "\t");
+}
+
+TEST_CASE("escape.unescape_errors")
+{
+    std::string long_clean(40, 'x');
+    for (std::string prefix : {std::string(), long_clean})
+    {
+        CAPTURE(prefix);
+        REQUIRE_THROWS_AS((void)Strings::Unescape(prefix + "\\"), std::runtime_error);
+        REQUIRE_THROWS_AS((void)Strings::Unescape(prefix + R"(\q)"), std::runtime_error);
+        REQUIRE_THROWS_AS((void)Strings::Unescape(prefix + R"(\?)"), std::runtime_error);
+        REQUIRE_THROWS_AS((void)Strings::Unescape(prefix + R"(\777)"), std::runtime_error);
+        REQUIRE_THROWS_AS((void)Strings::Unescape(prefix + R"(\xg)"), std::runtime_error);
+        REQUIRE_THROWS_AS((void)Strings::Unescape(prefix + R"(\u123)"), std::runtime_error);
+        REQUIRE_THROWS_AS((void)Strings::Unescape(prefix + R"(\U0010FFF)"), std::runtime_error);
+        REQUIRE_THROWS_AS((void)Strings::Unescape(prefix + R"(\U00110000)"), std::runtime_error);
+        REQUIRE_THROWS_AS((void)Strings::Unescape(prefix + R"(\n\)" + long_clean), std::runtime_error);
+    }
+}
+
+TEST_CASE("escape.random")
+{
+    std::mt19937 gen(42);
+    for (int i = 0; i < 2000; i++)
+    {
+        std::string str = RandomString(gen);
+        for (EscapeFlags flags : AllEscapeFlags())
+        {
+            CAPTURE(str);
+            CAPTURE(int(flags));
+            std::string escaped = Strings::Escape(str, flags);
+            REQUIRE(escaped == ReferenceEscape(str, flags));
+
+            // Backslashes are not escaped, and `\0` followed by an octal digit is read back as a single octal escape,
+            //   so the round trip only works without those.
+            std::string expected;
+            bool can_round_trip = true;
+            for (std::size_t j = 0; j < str.size(); j++)
+            {
+                if (str[j] == '\\' || (str[j] == '\0' && j + 1 < str.size() && str[j + 1] >= '0' && str[j + 1] <= '7'))
+                    can_round_trip = false;
+                if (!bool(flags & EscapeFlags::strip_cr) || str[j] != '\r')
+                    expected += str[j];
+            }
+            if (can_round_trip)
+                REQUIRE(Strings::Unescape(escaped) == expected);
+        }
+    }
+}
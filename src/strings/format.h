@@ -31,8 +31,13 @@
  *   that can be passed into various libfmt functions.
  *   `FORMAT_ARGS_SIMPLE` is mostly useless, because you might as well use `FMT_STRING` directly.
  *
+ * Formatting without allocations: `FMT_TO(buffer, "format", ...)` and `STR_TO(buffer, ...)`.
+ *   Same syntax and checks as above, but write into an existing buffer and return a `std::string_view`.
+ *   The buffer can be a reusable `fmt::memory_buffer`, a `char` array, or a `Storage::MonotonicPool` (such as a per-frame arena).
+ *
  * Alternative prefixed names:
  *   If `FMT` and `STR` interfer with something, you can undefine them and use `FORMAT_FMT` and `FORMAT_STR` instead.
+ *   Same for `FORMAT_FMT_TO` and `FORMAT_STR_TO`.
  *
  * Non-`char` strings support:
  *   `FMT` and related macros support non-char strings natively.
@@ -40,7 +45,9 @@
  *   for the string literal prefix (e.g. `L`), which can be empty.
  */
 
+#include <algorithm>
 #include <array>
+#include <concepts>
 #include <cstddef>
 #include <initializer_list>
 #include <iterator>
@@ -60,6 +67,11 @@
 // Instead of `_format`, use the `FMT()` macro defined below.
 using fmt::literals::operator""_a;
 
+namespace Storage
+{
+    class MonotonicPool;
+}
+
 
 namespace Strings
 {
@@ -89,6 +101,40 @@ namespace Strings
     }
 
 
+
+    // Those format into an existing buffer, replacing its contents, and return a view of the result. See also `FMT_TO()` and `STR_TO()`.
+    // Reuse the buffers between frames, then this doesn't allocate (unless the buffer needs to grow).
+    // The result is valid until the buffer is modified.
+    template <typename ...P>
+    std::string_view FormatTo(fmt::memory_buffer &buffer, fmt::format_string<P...> format, P &&... params)
+    {
+        buffer.clear();
+        fmt::format_to(std::back_inserter(buffer), format, std::forward<P>(params)...);
+        return std::string_view(buffer.data(), buffer.size());
+    }
+    // The result is truncated to fit, and is null-terminated.
+    template <std::size_t N, typename ...P>
+    requires(N > 0)
+    std::string_view FormatTo(char (&buffer)[N], fmt::format_string<P...> format, P &&... params)
+    {
+        std::size_t size = std::min(fmt::format_to_n(buffer, N - 1, format, std::forward<P>(params)...).size, N - 1);
+        buffer[size] = '\0';
+        return std::string_view(buffer, size);
+    }
+    // Allocates the result in the pool, so it lives until the pool is cleared. It's null-terminated.
+    // Include `utils/monotonic_pool.h` to use this.
+    template <std::same_as<Storage::MonotonicPool> Pool, typename ...P>
+    std::string_view FormatTo(Pool &pool, fmt::format_string<P...> format, P &&... params)
+    {
+        fmt::memory_buffer buffer; // This has some inline storage, so short strings don't allocate here.
+        fmt::format_to(std::back_inserter(buffer), format, std::forward<P>(params)...);
+        char *ret = reinterpret_cast<char *>(pool.AllocateRawMemory(buffer.size() + 1));
+        std::copy_n(buffer.data(), buffer.size(), ret);
+        ret[buffer.size()] = '\0';
+        return std::string_view(ret, buffer.size());
+    }
+
+
     // Internal, used by the macros below.
     namespace impl::Format
     {
@@ -139,6 +185,10 @@ namespace Strings
 #define FMT(...) FORMAT_FMT(__VA_ARGS__)
 #define FORMAT_FMT(...) ::fmt::format(FORMAT_ARGS_SIMPLE(__VA_ARGS__))
 
+// Like `FMT(...)`, but formats into `buffer` without allocating a string, and returns a `std::string_view`. See `Strings::FormatTo()`.
+#define FMT_TO(buffer, ...) FORMAT_FMT_TO(buffer, __VA_ARGS__)
+#define FORMAT_FMT_TO(buffer, ...) ::Strings::FormatTo(buffer, FORMAT_ARGS_SIMPLE(__VA_ARGS__))
+
 // A convenience macro. On MSVC `FORMAT_ARGS_SIMPLE(string, ...)` expands to `FMT_STRING(string), ...`,
 // where `FMT_STRING` is a libfmt macro that enables the compile-time format string validation.
 // On other compilers it's an identity macro, since the validation works without `FMT_STRING` (which sometimes causes weird warnings on Clang).
@@ -171,6 +221,10 @@ namespace Strings
 #define FORMAT_STR(...) ::fmt::format(FORMAT_ARGS(__VA_ARGS__))
 // Another name for `STR_(...)`.
 #define FORMAT_STR_(prefix, ...) ::fmt::format(FORMAT_ARGS_(prefix, __VA_ARGS__))
+// Like `STR(...)`, but formats into `buffer` without allocating a string, and returns a `std::string_view`. See `Strings::FormatTo()`.
+#define STR_TO(buffer, ...) FORMAT_STR_TO(buffer, __VA_ARGS__)
+// Another name for `STR_TO(...)`.
+#define FORMAT_STR_TO(buffer, ...) ::Strings::FormatTo(buffer, FORMAT_ARGS(__VA_ARGS__))
 
 // A convenience macro. Expands to a compile-time format string (similar to `FMT_STRING`), followed by a comma-separate argument list.
 // See the comments on `STR(...)` for the syntax.
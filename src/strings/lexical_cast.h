@@ -3,13 +3,18 @@
 #include <algorithm>
 #include <cctype>
 #include <cerrno>
+#include <charconv>
 #include <cmath>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <ranges>
+#include <span>
 #include <string>
+#include <system_error>
+#include <vector>
 
 #include <double-conversion/double-conversion.h>
 
@@ -79,6 +84,26 @@ namespace Strings
         // The numeric parameters passed to the constructor come from the `DoubleToStringConverter::EcmaScriptConverter()`, aka the default converter settings.
         // They should be sensible enough.
         inline const double_conversion::DoubleToStringConverter conv_real_to_str(conv_real_to_str.EMIT_POSITIVE_EXPONENT_SIGN, string_inf, string_nan, char_exp, -6, 21, 6, 0);
+
+        // Whether `std::to_chars()` in the fixed notation prints `number` exactly like `conv_real_to_str` does.
+        // `conv_real_to_str` uses the fixed notation for `1e-6 <= abs(x) < 1e21`, with the shortest digits padded with zeros.
+        // `std::to_chars()` prints the exact value of the integer part instead, so we also require it to be exactly representable.
+        template <typename T>
+        [[nodiscard]] bool RealToCharsMatches(T number)
+        {
+            T abs = std::abs(number);
+            return abs == 0 || (abs >= T(1e-6) && abs < T(std::uint64_t(1) << std::numeric_limits<T>::digits));
+        }
+
+        // Whether `str` is a plain decimal integer, without separators, leading zeros, or a plus sign. `std::from_chars()` parses those exactly like `strto*()` does.
+        [[nodiscard]] constexpr bool IsPlainDecimalInteger(std::string_view str)
+        {
+            if (str.starts_with('-'))
+                str.remove_prefix(1);
+            if (str.empty() || (str[0] == '0' && str.size() > 1))
+                return false;
+            return std::all_of(str.begin(), str.end(), [](char ch){return ch >= '0' && ch <= '9';});
+        }
     }
 
     // Converts a string to a number using one of the standard `strto*` functions.
@@ -144,15 +169,14 @@ namespace Strings
                 return false;
             std::strcpy(buffer, number ? "true" : "false");
         }
-        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+        else if constexpr (std::is_integral_v<T>)
         {
-            if (std::snprintf(buffer, buffer_size, "%lld", (long long)number) <= 0)
+            if (buffer_size == 0)
                 return false;
-        }
-        else if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>)
-        {
-            if (std::snprintf(buffer, buffer_size, "%llu", (unsigned long long)number) <= 0)
+            auto [end, error] = std::to_chars(buffer, buffer + buffer_size - 1, number);
+            if (error != std::errc{})
                 return false;
+            *end = '\0';
         }
         else if constexpr (sizeof(T) <= sizeof(double))
         {
@@ -161,6 +185,16 @@ namespace Strings
             if (buffer_size == 0)
                 return false;
 
+            // The fast path for the common numbers.
+            if (impl::RealToCharsMatches(number))
+            {
+                auto [end, error] = std::to_chars(buffer, buffer + buffer_size - 1, number, std::chars_format::fixed);
+                if (error != std::errc{})
+                    return false;
+                *end = '\0';
+                return true;
+            }
+
             double_conversion::StringBuilder str(buffer, buffer_size);
 
             bool ok;
@@ -264,6 +298,18 @@ namespace Strings
 
         if constexpr (std::is_integral_v<T>)
         {
+            // The fast path for the common numbers. Unsigned negative numbers are handled below, since `std::from_chars()` rejects them.
+            if constexpr (!std::is_same_v<T, bool>)
+            {
+                if (impl::IsPlainDecimalInteger(str) && (std::is_signed_v<T> || !str.starts_with('-')))
+                {
+                    T result{};
+                    auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), result);
+                    if (error == std::errc{} && end == str.data() + str.size())
+                        return result;
+                }
+            }
+
             // Copy the string to a temporary buffer to strip any character separators.
             char buf[ToStringMaxBufferLen()];
             std::size_t buf_pos = 0;
@@ -308,6 +354,16 @@ namespace Strings
             if (str.size() == 0)
                 impl::ConversionFailure<T>(str);
 
+            // The fast path for the common numbers. Both parsers round correctly, so the results match.
+            // This rejects hex numbers, separators, a leading plus sign, and special values, which are handled below.
+            if (std::isdigit((unsigned char)str[0]) || (str[0] == '-' && str.size() > 1 && std::isdigit((unsigned char)str[1])))
+            {
+                T result{};
+                auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), result);
+                if (error == std::errc{} && end == str.data() + str.size())
+                    return result;
+            }
+
             int chars_consumed = 0;
             T result;
             if constexpr (sizeof(T) <= sizeof(float))
@@ -337,6 +393,146 @@ namespace Strings
         }
     }
 
+    namespace impl
+    {
+        // Characters that separate the numbers in `FromStringList()`. The comma is handled separately.
+        [[nodiscard]] constexpr bool IsListWhitespace(char ch)
+        {
+            return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t' || ch == '\v' || ch == '\f';
+        }
+
+        // Parses one number of a list, using `std::from_chars()` if it accepts the number exactly like `FromString()` would.
+        // `str` must start with a non-separator character. Returns the position after the number.
+        template <SupportedScalar T>
+        [[nodiscard]] const char *ParseListElement(const char *str, const char *str_end, T &result)
+        {
+            // `bool` needs `true`/`false`, and `long double` has its own format, so those always use the slow path.
+            if constexpr (!std::is_same_v<T, bool> && sizeof(T) <= sizeof(double))
+            {
+                const char *digits = str;
+                if (std::is_signed_v<T> && *digits == '-')
+                    digits++;
+
+                // Leading zeros are rejected for integers, since `FromString()` parses those as octal.
+                bool ok = digits < str_end && *digits >= '0' && *digits <= '9';
+                if constexpr (std::is_integral_v<T>)
+                    ok = ok && !(*digits == '0' && digits + 1 < str_end && digits[1] >= '0' && digits[1] <= '9');
+
+                if (ok)
+                {
+                    auto [end, error] = std::from_chars(str, str_end, result);
+                    if (error == std::errc{} && (end == str_end || *end == ',' || IsListWhitespace(*end)))
+                        return end;
+                }
+            }
+
+            const char *end = str;
+            while (end < str_end && *end != ',' && !IsListWhitespace(*end))
+                end++;
+            result = FromString<T>(std::string_view(str, end));
+            return end;
+        }
+    }
+
+    // Parses a list of numbers, separated with commas and/or whitespace, e.g. `1, 2, 3` or `1 2 3`. Calls `func(T)` for each number, and returns their count.
+    // Leading and trailing whitespace is allowed, but empty elements (`1,,2`, or a comma at the beginning or the end) are not. An empty or whitespace-only string is an empty list.
+    // Accepts everything `FromString()` accepts, but the common numbers are parsed with `std::from_chars()` directly, which is much faster than calling `FromString()` for each one.
+    // Throws on failure.
+    template <impl::SupportedScalar T, typename F>
+    std::size_t ForEachInStringList(std::string_view str, F &&func)
+    {
+        const char *cur = str.data();
+        const char *end = str.data() + str.size();
+        std::size_t count = 0;
+
+        while (true)
+        {
+            while (cur < end && impl::IsListWhitespace(*cur))
+                cur++;
+            if (cur == end)
+            {
+                if (count == 0)
+                    return 0;
+                impl::ConversionFailure<T>(str, "expected a number after a comma");
+            }
+            if (*cur == ',')
+                impl::ConversionFailure<T>(str, FMT("empty element at position {}", cur - str.data()));
+
+            T value{};
+            cur = impl::ParseListElement(cur, end, value);
+            func(value);
+            count++;
+
+            while (cur < end && impl::IsListWhitespace(*cur))
+                cur++;
+            if (cur == end)
+                return count;
+            if (*cur == ',')
+                cur++;
+        }
+    }
+
+    // Parses a list of numbers (see `ForEachInStringList()`) into `output`. Throws if the number count doesn't match its size.
+    template <impl::SupportedScalar T, std::size_t N>
+    void FromStringList(std::string_view str, std::span<T, N> output)
+    {
+        std::size_t count = ForEachInStringList<T>(str, [&, pos = std::size_t(0)](T value) mutable
+        {
+            if (pos == output.size())
+                impl::ConversionFailure<T>(str, FMT("expected {} numbers, got more", output.size()));
+            output[pos++] = value;
+        });
+        if (count != output.size())
+            impl::ConversionFailure<T>(str, FMT("expected {} numbers, got {}", output.size(), count));
+    }
+
+    // Parses a list of numbers (see `ForEachInStringList()`), and appends them to `output`.
+    // On failure, the successfully parsed numbers are kept.
+    template <impl::SupportedScalar T>
+    void FromStringList(std::string_view str, std::vector<T> &output)
+    {
+        // A rough upper estimate, to avoid reallocations. Every number is at least one byte long plus one separator.
+        output.reserve(output.size() + (str.size() + 1) / 2);
+        ForEachInStringList<T>(str, [&](T value){output.push_back(value);});
+    }
+
+    template <impl::SupportedScalar T>
+    [[nodiscard]] std::vector<T> FromStringList(std::string_view str)
+    {
+        std::vector<T> ret;
+        FromStringList(str, ret);
+        return ret;
+    }
+
+    // Appends the numbers to `output`, separated with `separator`. Uses the same format as `ToString()`, so `FromStringList()` can parse the result.
+    // The numbers are written directly to `output`, without temporary strings.
+    template <std::ranges::contiguous_range R> requires impl::SupportedScalar<std::ranges::range_value_t<R>>
+    void ToStringList(std::string &output, const R &numbers, std::string_view separator = ", ")
+    {
+        std::size_t pos = output.size();
+        output.resize(pos + std::ranges::size(numbers) * (ToStringMaxBufferLen() + separator.size()));
+        for (std::size_t i = 0; i < std::ranges::size(numbers); i++)
+        {
+            if (i > 0)
+            {
+                std::memcpy(output.data() + pos, separator.data(), separator.size());
+                pos += separator.size();
+            }
+            [[maybe_unused]] bool ok = ToString(output.data() + pos, ToStringMaxBufferLen(), std::ranges::data(numbers)[i]);
+            ASSERT(ok, "The buffer allocated by `ToStringList` ended up being too small, huh.");
+            pos += std::strlen(output.data() + pos);
+        }
+        output.resize(pos);
+    }
+
+    template <std::ranges::contiguous_range R> requires impl::SupportedScalar<std::ranges::range_value_t<R>>
+    [[nodiscard]] std::string ToStringList(const R &numbers, std::string_view separator = ", ")
+    {
+        std::string ret;
+        ToStringList(ret, numbers, separator);
+        return ret;
+    }
+
     // Works as either `ToString` (T = std::string) or `FromString()` (T is arithmetic).
     // Throws on failure.
     template <std::same_as<std::string> T, Meta::deduce..., typename U>
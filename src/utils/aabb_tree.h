@@ -1,10 +1,25 @@
 #pragma once
 
+#include <algorithm>
 #include <concepts>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include "macros/finally.h"
+#include "math/fixed_point.h"
 #include "program/platform.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "utils/byte_order.h"
+#include "utils/jobs.h"
 #include "utils/mat.h"
 #include "utils/sparse_set.h"
 
@@ -21,7 +36,8 @@
 #  endif
 #endif
 
-// `T` is a vector type, either integral or floating-point.
+// `T` is a vector type, either integral, floating-point, or fixed-point (see `math/fixed_point.h`).
+// For fixed-point vectors everything except the ray casts and the nearest neighbor queries (which use `float`) is deterministic.
 // Only 2D vectors have been tested properly, the cost heuristics may not work in higher dimensions.
 // `UserData` is an arbitrary type, an instance of which will be stored in each node.
 // Keep it small, since it'll also be stored in internal non-leaf nodes, and copied around on a whim.
@@ -36,6 +52,19 @@ class AabbTree
     using NodeIndex = int;
     using UserData = std::conditional_t<std::is_void_v<UserDataT>, Empty, UserDataT>;
 
+    // The floating-point vector type for ray casts.
+    using fvector = Math::floating_point_t<T>;
+    using fscalar = typename fvector::type;
+
+    // A segment for `SegmentCastBatch()`.
+    struct Segment
+    {
+        fvector a, b;
+    };
+
+    // How many segments `SegmentCastBatch()` processes at once.
+    static constexpr int cast_packet_size = 4;
+
     // A node index that's guaranteed to be unused.
     static constexpr NodeIndex null_index = -1;
 
@@ -59,6 +88,15 @@ class AabbTree
         // It's unclear if it's harmful or not though. Setting this to 2 fixes oscillations, but again, it's unclear if it's helpful or not.
         // Must be >= 1. Values larger than 2 seem to be useless.
         int balance_threshold = 1;
+
+        // If true, the tree remembers which leaves were created or reinserted, for `CollideMovedPairs()`.
+        // Off by default, since otherwise the list would grow indefinitely if nobody reads it.
+        bool track_moved_nodes = false;
+
+        // If true, each internal node additionally stores the AABBs of both its children together, in the structure-of-arrays form.
+        // This makes `CollideAabb()` and `CollidePoint()` faster (they test both children at once, which vectorizes well),
+        //   at the cost of extra memory and slightly slower modification. Doesn't affect `CollideCustom()`.
+        bool soa_child_bounds = false;
     };
 
     // This is used to judge how large a rect is.
@@ -73,6 +111,58 @@ class AabbTree
     // Makes an empty tree.
     AabbTree(Params params) : params(std::move(params)) {}
 
+    // Makes a tree from a list of AABBs. See `Build()` for details.
+    AabbTree(Params params, std::span<const rect> aabbs, std::span<const UserData> userdata = {}) : params(std::move(params))
+    {
+        Build(aabbs, userdata);
+    }
+
+    // Destroys all nodes, and then builds the tree top-down from the specified AABBs.
+    // This is much faster than calling `AddNode()` repeatedly, and usually produces a better tree. Uses binned SAH partitioning.
+    // The leaf node `i` will have the AABB `aabbs[i]` and the user data `userdata[i]`, the internal nodes get the indices after that.
+    // `userdata` must be either empty (then it's default-constructed) or have the same size as `aabbs`.
+    // The resulting tree can be modified as usual.
+    void Build(std::span<const rect> aabbs, std::span<const UserData> userdata = {})
+    {
+        ASSERT(userdata.empty() || userdata.size() == aabbs.size(), "The number of user data objects doesn't match the number of AABBs.");
+
+        node_set = {};
+        nodes.clear();
+        child_bounds.clear();
+        moved_nodes.clear();
+        root_index = null_index;
+
+        if (aabbs.empty())
+            return;
+
+        #if IMP_AUTO_VALIDATE_AABB_TREES
+        FINALLY{Validate();};
+        #endif
+
+        NodeIndex num_leaves = NodeIndex(aabbs.size());
+        Reserve(num_leaves * 2 - 1);
+
+        std::vector<NodeIndex> leaves(num_leaves);
+
+        for (NodeIndex i = 0; i < num_leaves; i++)
+        {
+            [[maybe_unused]] NodeIndex index = node_set.InsertAny();
+            ASSERT(index == i);
+
+            Node &node = nodes[i];
+            node = {};
+            node.aabb = aabbs[i].fix().expand(params.extra_margin);
+            if (!userdata.empty())
+                node.userdata = userdata[i];
+
+            leaves[i] = i;
+
+            MarkMoved(i);
+        }
+
+        root_index = BuildSubtree(leaves);
+    }
+
     // Returns true if there are no nodes in the tree.
     // Also returns true for default-constructed trees.
     [[nodiscard]] bool IsEmpty() const
@@ -115,8 +205,8 @@ class AabbTree
         // Don't want to create a reference to `nodes[new_index]` yet, since it can become dangling later.
         nodes[new_index] = {}; // Reset the node.
         nodes[new_index].aabb = new_aabb;
-        // nodes[new_index].moved = true; // See `struct Node` below.
         nodes[new_index].userdata = std::move(new_data);
+        MarkMoved(new_index);
 
         if (node_set.ElemCount() == 1)
         {
@@ -317,9 +407,8 @@ class AabbTree
         if (IsEmpty())
             return null_index;
         NodeIndex ret = root_index;
-        NodeIndex next = nodes[ret].childen[0];
-        while (next)
-            ret = std::exchange(next, nodes[next].childen[0]);
+        while (!nodes[ret].IsLeaf())
+            ret = nodes[ret].children[0];
         return ret;
     }
 
@@ -329,6 +418,16 @@ class AabbTree
     template <typename F>
     bool CollidePoint(T point, F &&func) const
     {
+        if (params.soa_child_bounds)
+        {
+            return CollideChildBounds([&point](const ChildBounds &bounds, bool (&result)[2])
+            {
+                for (int i = 0; i < T::size; i++)
+                for (int j = 0; j < 2; j++)
+                    result[j] &= (point[i] >= bounds.a[i * 2 + j]) & (point[i] < bounds.b[i * 2 + j]);
+            }, [&point](const rect &aabb){return aabb.contains(point);}, std::forward<F>(func));
+        }
+
         return CollideCustom([&point](const rect &aabb){return aabb.contains(point);}, std::forward<F>(func));
     }
 
@@ -339,6 +438,17 @@ class AabbTree
     bool CollideAabb(rect aabb, F &&func) const
     {
         sort_two_var(aabb.a, aabb.b);
+
+        if (params.soa_child_bounds)
+        {
+            return CollideChildBounds([&aabb](const ChildBounds &bounds, bool (&result)[2])
+            {
+                for (int i = 0; i < T::size; i++)
+                for (int j = 0; j < 2; j++)
+                    result[j] &= (aabb.b[i] > bounds.a[i * 2 + j]) & (aabb.a[i] < bounds.b[i * 2 + j]);
+            }, [&aabb](const rect &node_aabb){return aabb.touches(node_aabb);}, std::forward<F>(func));
+        }
+
         return CollideCustom([&aabb](const rect &node_aabb){return aabb.touches(node_aabb);}, std::forward<F>(func));
     }
 
@@ -373,6 +483,867 @@ class AabbTree
         return root_index == null_index ? false : lambda(*this, root_index, check_collision, func);
     }
 
+    // Casts a segment from `from` to `to`, looking for the closest hit.
+    // `func` is `fscalar func(NodeIndex node, fscalar max_fraction)`. It's called for the leaves whose AABBs are crossed by the segment, approximately from the closest to the farthest.
+    // The fraction is the position on the segment, `0` at `from` and `1` at `to`.
+    // `func` returns the new max fraction: return `max_fraction` to ignore the node, the exact hit fraction to only look for closer hits from now on,
+    //   or `0` to stop immediately. The nodes beyond the max fraction are skipped.
+    // Returns the final max fraction, which is `1` if `func` never reduced it.
+    // Since we expand AABBs, you must manually check the collision with the actual shape in `func`.
+    template <typename F>
+    fscalar SegmentCast(fvector from, fvector to, F &&func) const
+    {
+        return CastImpl(from, to - from, 1, func);
+    }
+
+    // Same as `SegmentCast()`, but the ray is infinite, and the fractions are measured in the multiples of `dir`.
+    // Returns infinity if `func` never reduced the max fraction.
+    template <typename F>
+    fscalar RayCast(fvector from, fvector dir, F &&func) const
+    {
+        return CastImpl(from, dir, std::numeric_limits<fscalar>::infinity(), func);
+    }
+
+    // Casts many segments at once. Same as calling `SegmentCast()` for each of them, but traverses the tree once per `cast_packet_size` segments,
+    //   testing the whole packet against each node at once. This is faster if the segments in a packet are close to each other
+    //   (e.g. a fan of line-of-sight checks from one point), so sort them accordingly.
+    // `func` is `fscalar func(std::size_t segment_index, NodeIndex node, fscalar max_fraction)`, otherwise it works like in `SegmentCast()`.
+    // If `out_fractions` isn't empty, it must have the same size as `segments`, and receives the final max fractions.
+    template <typename F>
+    void SegmentCastBatch(std::span<const Segment> segments, F &&func, std::span<fscalar> out_fractions = {}) const
+    {
+        ASSERT(out_fractions.empty() || out_fractions.size() == segments.size());
+
+        for (std::size_t base = 0; base < segments.size(); base += cast_packet_size)
+        {
+            CastPacket packet;
+            packet.base_index = base;
+
+            for (int lane = 0; lane < cast_packet_size; lane++)
+            {
+                if (base + lane >= segments.size())
+                {
+                    packet.active[lane] = false;
+                    continue;
+                }
+
+                const Segment &segment = segments[base + lane];
+                fvector inv_dir = RayInvDir(segment.b - segment.a);
+                for (int i = 0; i < T::size; i++)
+                {
+                    packet.origin[i][lane] = segment.a[i];
+                    packet.inv_dir[i][lane] = inv_dir[i];
+                }
+            }
+
+            if (root_index != null_index && PacketTouchesAabb(packet, nodes[root_index].aabb).any())
+                CastPacketImpl(root_index, packet, func);
+
+            if (!out_fractions.empty())
+            {
+                for (int lane = 0; lane < cast_packet_size && base + lane < segments.size(); lane++)
+                    out_fractions[base + lane] = packet.max_fraction[lane];
+            }
+        }
+    }
+
+    // Returns the squared distance from a point to a rect, or zero if the point is inside.
+    [[nodiscard]] static fscalar PointToRectDistSq(fvector point, const rect &aabb)
+    {
+        fscalar ret = 0;
+        for (int i = 0; i < T::size; i++)
+        {
+            fscalar delta = max(fscalar(aabb.a[i]) - point[i], fscalar(0), point[i] - fscalar(aabb.b[i]));
+            ret += delta * delta;
+        }
+        return ret;
+    }
+
+    // Finds up to `count` leaves closest to `point`, and writes them to `out` (which is cleared first), from the closest to the farthest.
+    // The distances are measured to the leaf AABBs (which are expanded, so this is approximate). See `FindNearestLeavesCustom()` for exact distances.
+    // Only considers the leaves closer than `max_dist`.
+    void FindNearestLeaves(fvector point, int count, std::vector<NodeIndex> &out, fscalar max_dist = std::numeric_limits<fscalar>::infinity()) const
+    {
+        FindNearestLeavesCustom(point, count, out, [&](NodeIndex index){return PointToRectDistSq(point, nodes[index].aabb);}, max_dist);
+    }
+
+    // Same as `FindNearestLeaves()`, but uses a custom distance to the leaves.
+    // `exact_dist_sq` is `fscalar exact_dist_sq(NodeIndex leaf)`, it should return the squared distance from `point` to the actual shape.
+    // It must never be less than the squared distance to the leaf AABB (which is the case when the shape is inside of its AABB), otherwise the results are wrong.
+    // The search is best-first: the nodes are visited in the order of their distance lower bounds, and it stops as soon as all of them are farther than the found leaves.
+    template <typename F>
+    void FindNearestLeavesCustom(fvector point, int count, std::vector<NodeIndex> &out, F &&exact_dist_sq, fscalar max_dist = std::numeric_limits<fscalar>::infinity()) const
+    {
+        out.clear();
+        if (root_index == null_index || count <= 0)
+            return;
+
+        fscalar max_dist_sq = max_dist * max_dist;
+
+        using Entry = std::pair<fscalar, NodeIndex>;
+        auto Greater = [](const Entry &a, const Entry &b){return a.first > b.first;};
+
+        // A max-heap of the found leaves, no longer than `count`.
+        std::vector<Entry> found;
+        found.reserve(std::size_t(count));
+        // A min-heap of the nodes to visit, by the distance lower bound.
+        std::vector<Entry> queue;
+
+        auto CurrentBoundSq = [&]{return int(found.size()) < count ? max_dist_sq : found.front().first;};
+
+        queue.emplace_back(PointToRectDistSq(point, nodes[root_index].aabb), root_index);
+
+        while (!queue.empty())
+        {
+            std::pop_heap(queue.begin(), queue.end(), Greater);
+            auto [bound_sq, index] = queue.back();
+            queue.pop_back();
+
+            if (bound_sq >= CurrentBoundSq())
+                break; // Everything else is farther.
+
+            const Node &node = nodes[index];
+            if (node.IsLeaf())
+            {
+                fscalar dist_sq = exact_dist_sq(std::as_const(index));
+                if (dist_sq >= CurrentBoundSq())
+                    continue;
+
+                if (int(found.size()) == count)
+                {
+                    std::pop_heap(found.begin(), found.end());
+                    found.pop_back();
+                }
+                found.emplace_back(dist_sq, index);
+                std::push_heap(found.begin(), found.end());
+            }
+            else
+            {
+                for (NodeIndex child : node.children)
+                {
+                    fscalar child_bound_sq = PointToRectDistSq(point, nodes[child].aabb);
+                    if (child_bound_sq < CurrentBoundSq())
+                    {
+                        queue.emplace_back(child_bound_sq, child);
+                        std::push_heap(queue.begin(), queue.end(), Greater);
+                    }
+                }
+            }
+        }
+
+        std::sort_heap(found.begin(), found.end());
+        out.reserve(found.size());
+        for (const Entry &entry : found)
+            out.push_back(entry.second);
+    }
+
+    // Returns the leaf closest to `point`, or `null_index` if there are no leaves closer than `max_dist`.
+    // Like in `FindNearestLeaves()`, the distances are measured to the leaf AABBs.
+    [[nodiscard]] NodeIndex FindNearestLeaf(fvector point, fscalar max_dist = std::numeric_limits<fscalar>::infinity()) const
+    {
+        std::vector<NodeIndex> result;
+        FindNearestLeaves(point, 1, result, max_dist);
+        return result.empty() ? null_index : result.front();
+    }
+
+    // Finds all pairs of colliding leaves. Each pair is reported exactly once, in an arbitrary order.
+    // `func` is `bool func(NodeIndex a, NodeIndex b)`. If it returns true, the function stops immediately and also returns true.
+    // Since we expand AABBs, you might get false positive pairs. Manually check if the collision is exact.
+    // This is faster than calling `CollideAabb()` for every leaf, since it doesn't visit the shared subtrees repeatedly.
+    template <typename F>
+    bool CollideAllPairs(F &&func) const
+    {
+        static constexpr bool (*self_lambda)(const AabbTree &, NodeIndex, F &) =
+        [](const AabbTree &self, NodeIndex index, F &func) -> bool
+        {
+            const Node &node = self.nodes[index];
+            if (node.IsLeaf())
+                return false;
+            return
+                self_lambda(self, node.children[0], func) ||
+                self_lambda(self, node.children[1], func) ||
+                self.CollideSubtreePair(node.children[0], node.children[1], func);
+        };
+        return root_index == null_index ? false : self_lambda(*this, root_index, func);
+    }
+
+    // Like `CollideAllPairs()`, but only reports the pairs where at least one leaf was created or reinserted since the last call.
+    // Requires `params.track_moved_nodes` to be true.
+    // A leaf is reinserted by `ModifyNode()` only when its AABB no longer fits, so slightly moving objects are not reported.
+    // Unlike `CollideAllPairs()`, this is a normal AABB query per moved leaf, so it's faster when few leaves move.
+    // Forgets the moved leaves afterwards, even if `func` stops early.
+    template <typename F>
+    bool CollideMovedPairs(F &&func)
+    {
+        ASSERT(params.track_moved_nodes, "Must enable `track_moved_nodes` in the parameters to use this function.");
+
+        FINALLY{ForgetMovedNodes();};
+
+        for (NodeIndex moved_index : moved_nodes)
+        {
+            // Skip destroyed nodes, and the duplicate entries.
+            if (!node_set.Contains(moved_index) || !nodes[moved_index].moved)
+                continue;
+            // This makes sure we skip the duplicates, and don't report pairs of two moved nodes twice.
+            nodes[moved_index].moved = false;
+
+            bool stop = CollideAabb(nodes[moved_index].aabb, [&](NodeIndex other_index)
+            {
+                if (other_index == moved_index || nodes[other_index].moved)
+                    return false;
+                return bool(func(std::as_const(moved_index), std::as_const(other_index)));
+            });
+            if (stop)
+                return true;
+        }
+
+        return false;
+    }
+
+    // Forgets all moved leaves, see `CollideMovedPairs()`.
+    void ForgetMovedNodes()
+    {
+        for (NodeIndex moved_index : moved_nodes)
+        {
+            if (node_set.Contains(moved_index))
+                nodes[moved_index].moved = false;
+        }
+        moved_nodes.clear();
+    }
+
+    // An immutable flattened copy of a tree, see `MakeSnapshot()`.
+    // Since it's immutable, it can be queried from several threads at once, while the original tree is being modified.
+    // The nodes are stored in the depth-first order, and each node knows where its subtree ends, so the queries don't need a stack.
+    class Snapshot
+    {
+        friend AabbTree;
+
+        struct FlatNode
+        {
+            rect aabb;
+            // The original index of this node, or `null_index` if this is an internal node.
+            NodeIndex leaf_index = null_index;
+            // The index of the first node after this subtree.
+            NodeIndex next = 0;
+            // Arbitrary data, only meaningful for leaves.
+            [[no_unique_address]] UserData userdata;
+        };
+        std::vector<FlatNode> nodes;
+
+        template <typename F>
+        static bool CallFunc(F &func, const FlatNode &node)
+        {
+            if constexpr (std::is_invocable_v<F &, const NodeIndex &, const UserData &>)
+                return bool(func(std::as_const(node.leaf_index), std::as_const(node.userdata)));
+            else
+                return bool(func(std::as_const(node.leaf_index)));
+        }
+
+      public:
+        // Constructs an empty snapshot.
+        Snapshot() {}
+
+        // Returns true if there are no nodes in the snapshot.
+        [[nodiscard]] bool IsEmpty() const
+        {
+            return nodes.empty();
+        }
+
+        // Returns the bounds of the whole snapshot, or a default-constructed rect if it's empty.
+        [[nodiscard]] rect Bounds() const
+        {
+            return IsEmpty() ? rect{} : nodes.front().aabb;
+        }
+
+        // Same as `AabbTree::CollidePoint()`.
+        // `func` is either `bool func(NodeIndex node)` or `bool func(NodeIndex node, const UserData &userdata)`.
+        // The node indices are the ones from the original tree.
+        template <typename F>
+        bool CollidePoint(T point, F &&func) const
+        {
+            return CollideCustom([&point](const rect &aabb){return aabb.contains(point);}, std::forward<F>(func));
+        }
+
+        // Same as `AabbTree::CollideAabb()`.
+        // `func` is either `bool func(NodeIndex node)` or `bool func(NodeIndex node, const UserData &userdata)`.
+        template <typename F>
+        bool CollideAabb(rect aabb, F &&func) const
+        {
+            sort_two_var(aabb.a, aabb.b);
+            return CollideCustom([&aabb](const rect &node_aabb){return aabb.touches(node_aabb);}, std::forward<F>(func));
+        }
+
+        // Same as `AabbTree::CollideCustom()`.
+        // `func` is either `bool func(NodeIndex node)` or `bool func(NodeIndex node, const UserData &userdata)`.
+        template <typename C, typename F>
+        bool CollideCustom(C &&check_collision, F &&func) const
+        {
+            std::size_t i = 0;
+            while (i < nodes.size())
+            {
+                const FlatNode &node = nodes[i];
+                if (!check_collision(std::as_const(node.aabb)))
+                {
+                    i = std::size_t(node.next);
+                    continue;
+                }
+
+                if (node.leaf_index != null_index && CallFunc(func, node))
+                    return true;
+                i++;
+            }
+            return false;
+        }
+
+        // Runs `CollideAabb()` for every rect in `queries`, splitting them into `num_threads` ranges, which run as jobs on `Jobs::GlobalPool()`.
+        // `func` is `void func(int thread_index, std::size_t query_index, NodeIndex node)`,
+        //   or `void func(int thread_index, std::size_t query_index, NodeIndex node, const UserData &userdata)`.
+        // `thread_index` is the index of the range, in `[0, num_threads)`. Each range runs on one thread at a time,
+        //   so write the results to per-range (or per-query) storage to avoid locking.
+        // If `num_threads` is zero, uses `Jobs::GlobalPool().Concurrency()`.
+        // If `func` throws anywhere, waits for all ranges to finish, then rethrows the first exception.
+        template <typename F>
+        void CollideAabbParallel(std::span<const rect> queries, F &&func, int num_threads = 0) const
+        {
+            if (num_threads <= 0)
+                num_threads = Jobs::GlobalPool().Concurrency();
+            clamp_var_max(num_threads, max(1, int(queries.size())));
+
+            auto ProcessRange = [&](std::size_t range_index)
+            {
+                const int thread_index = int(range_index);
+                std::size_t begin = queries.size() * range_index / std::size_t(num_threads);
+                std::size_t end = queries.size() * (range_index + 1) / std::size_t(num_threads);
+                for (std::size_t query_index = begin; query_index < end; query_index++)
+                {
+                    CollideAabb(queries[query_index], [&](const NodeIndex &node, const UserData &userdata)
+                    {
+                        if constexpr (std::is_invocable_v<F &, const int &, const std::size_t &, const NodeIndex &, const UserData &>)
+                            func(thread_index, std::as_const(query_index), node, userdata);
+                        else
+                            func(thread_index, std::as_const(query_index), node);
+                        return false;
+                    });
+                }
+            };
+
+            Jobs::ParallelFor(Jobs::GlobalPool(), 0, std::size_t(num_threads), ProcessRange);
+        }
+    };
+
+    // Makes an immutable flattened copy of the tree, which can be queried from other threads while this tree is being modified.
+    // The user data is copied as well.
+    [[nodiscard]] Snapshot MakeSnapshot() const
+    {
+        Snapshot ret;
+        if (root_index == null_index)
+            return ret;
+
+        ret.nodes.reserve(std::size_t(node_set.ElemCount()));
+
+        auto lambda = [&](auto &lambda, NodeIndex index) -> void
+        {
+            const Node &node = nodes[index];
+            std::size_t pos = ret.nodes.size();
+
+            typename Snapshot::FlatNode &flat_node = ret.nodes.emplace_back();
+            flat_node.aabb = node.aabb;
+            if (node.IsLeaf())
+            {
+                flat_node.leaf_index = index;
+                flat_node.userdata = node.userdata;
+            }
+            else
+            {
+                lambda(lambda, node.children[0]);
+                lambda(lambda, node.children[1]);
+            }
+
+            ret.nodes[pos].next = NodeIndex(ret.nodes.size());
+        };
+        lambda(lambda, root_index);
+
+        return ret;
+    }
+
+    // Like `Snapshot`, but stores the bounds in a compressed form, which takes roughly half the memory.
+    // Each internal node stores the AABBs of both its children as 16-bit offsets relative to its own AABB. They are rounded outwards,
+    //   so the queries can return slightly more leaves than `Snapshot` would, but never less. Since we expand AABBs anyway, this shouldn't matter.
+    // Node AABBs are decoded on the fly during traversal.
+    class QuantizedSnapshot
+    {
+        friend AabbTree;
+
+        using quant_t = std::uint16_t;
+        static constexpr quant_t quant_max = std::numeric_limits<quant_t>::max();
+
+        struct QuantizedNode
+        {
+            // `a[j][i]` is the `i`-th coordinate of the `a` corner of the `j`-th child. Same for `b`.
+            quant_t a[2][T::size]{};
+            quant_t b[2][T::size]{};
+            // Non-negative values are indices in `nodes`, negative values are `~i` where `i` is an index in `leaves`.
+            NodeIndex children[2] = {};
+        };
+        std::vector<QuantizedNode> nodes;
+
+        struct Leaf
+        {
+            // The original index of this node.
+            NodeIndex index = null_index;
+            // Arbitrary data.
+            [[no_unique_address]] UserData userdata;
+        };
+        std::vector<Leaf> leaves;
+
+        // The exact bounds of the whole tree.
+        rect bounds;
+        // Same meaning as the elements of `QuantizedNode::children`. Only meaningful if not empty.
+        NodeIndex root = 0;
+
+        // Converts a quantized coordinate back to a scalar, relative to the range `lo..hi`.
+        [[nodiscard]] static scalar Dequantize(scalar lo, scalar hi, quant_t q)
+        {
+            if constexpr (std::is_floating_point_v<scalar>)
+                return q == quant_max ? hi : lo + (hi - lo) * (scalar(q) / quant_max);
+            else if constexpr (Math2::fixed_point_scalar<scalar>)
+                return scalar::FromRaw(typename scalar::raw_type(lo.raw + (typename scalar::wide_type(hi.raw) - lo.raw) * q / quant_max));
+            else
+                return scalar(lo + (std::int64_t(hi) - lo) * q / quant_max);
+        }
+
+        // Quantizes a coordinate in the range `lo..hi`, rounding it down (if `upper == false`) or up (if `upper == true`).
+        // We don't trust the rounding of the initial guess, and adjust it until `Dequantize()` gives us a conservative value.
+        [[nodiscard]] static quant_t Quantize(scalar lo, scalar hi, scalar value, bool upper)
+        {
+            if (!(hi > lo))
+                return upper ? quant_max : 0;
+
+            double guess = (double(value) - double(lo)) / (double(hi) - double(lo)) * quant_max;
+            guess = upper ? std::ceil(guess) : std::floor(guess);
+            quant_t q = quant_t(clamp(guess, 0., double(quant_max)));
+
+            if (upper)
+            {
+                while (q < quant_max && Dequantize(lo, hi, q) < value)
+                    q++;
+            }
+            else
+            {
+                while (q > 0 && Dequantize(lo, hi, q) > value)
+                    q--;
+            }
+            return q;
+        }
+
+        // Decodes the AABB of the `j`-th child of a node, given the AABB of that node.
+        [[nodiscard]] static rect DequantizeChild(const QuantizedNode &node, int j, const rect &parent)
+        {
+            rect ret;
+            for (int i = 0; i < T::size; i++)
+            {
+                ret.a[i] = Dequantize(parent.a[i], parent.b[i], node.a[j][i]);
+                ret.b[i] = Dequantize(parent.a[i], parent.b[i], node.b[j][i]);
+            }
+            return ret;
+        }
+
+        template <typename F>
+        static bool CallFunc(F &func, const Leaf &leaf)
+        {
+            if constexpr (std::is_invocable_v<F &, const NodeIndex &, const UserData &>)
+                return bool(func(std::as_const(leaf.index), std::as_const(leaf.userdata)));
+            else
+                return bool(func(std::as_const(leaf.index)));
+        }
+
+      public:
+        // Constructs an empty snapshot.
+        QuantizedSnapshot() {}
+
+        // Returns true if there are no nodes in the snapshot.
+        [[nodiscard]] bool IsEmpty() const
+        {
+            return leaves.empty();
+        }
+
+        // Returns the exact bounds of the whole snapshot, or a default-constructed rect if it's empty.
+        [[nodiscard]] rect Bounds() const
+        {
+            return IsEmpty() ? rect{} : bounds;
+        }
+
+        // Same as `Snapshot::CollidePoint()`.
+        template <typename F>
+        bool CollidePoint(T point, F &&func) const
+        {
+            return CollideCustom([&point](const rect &aabb){return aabb.contains(point);}, std::forward<F>(func));
+        }
+
+        // Same as `Snapshot::CollideAabb()`.
+        template <typename F>
+        bool CollideAabb(rect aabb, F &&func) const
+        {
+            sort_two_var(aabb.a, aabb.b);
+            return CollideCustom([&aabb](const rect &node_aabb){return aabb.touches(node_aabb);}, std::forward<F>(func));
+        }
+
+        // Same as `Snapshot::CollideCustom()`.
+        // `check_collision` receives the decoded (slightly enlarged) AABBs.
+        template <typename C, typename F>
+        bool CollideCustom(C &&check_collision, F &&func) const
+        {
+            if (IsEmpty() || !check_collision(std::as_const(bounds)))
+                return false;
+
+            static constexpr bool (*lambda)(const QuantizedSnapshot &, NodeIndex, const rect &, C &, F &) =
+            [](const QuantizedSnapshot &self, NodeIndex ref, const rect &aabb, C &check_collision, F &func) -> bool
+            {
+                if (ref < 0)
+                    return CallFunc(func, self.leaves[~ref]);
+
+                const QuantizedNode &node = self.nodes[ref];
+                for (int j = 0; j < 2; j++)
+                {
+                    rect child_aabb = DequantizeChild(node, j, aabb);
+                    if (check_collision(std::as_const(child_aabb)) && lambda(self, node.children[j], child_aabb, check_collision, func))
+                        return true;
+                }
+                return false;
+            };
+            return lambda(*this, root, bounds, check_collision, func);
+        }
+    };
+
+    // Makes an immutable compressed copy of the tree. See `QuantizedSnapshot` for details.
+    // The user data is copied as well.
+    [[nodiscard]] QuantizedSnapshot MakeQuantizedSnapshot() const
+    {
+        using Q = QuantizedSnapshot;
+
+        Q ret;
+        if (root_index == null_index)
+            return ret;
+
+        ret.nodes.reserve(std::size_t(node_set.ElemCount() / 2));
+        ret.leaves.reserve(std::size_t(node_set.ElemCount() / 2 + 1));
+
+        // `aabb` is the decoded AABB of this node, which can be larger than `node.aabb`.
+        auto lambda = [&](auto &lambda, NodeIndex index, const rect &aabb) -> NodeIndex
+        {
+            const Node &node = nodes[index];
+            if (node.IsLeaf())
+            {
+                ret.leaves.push_back({.index = index, .userdata = node.userdata});
+                return ~NodeIndex(ret.leaves.size() - 1);
+            }
+
+            NodeIndex pos = NodeIndex(ret.nodes.size());
+            ret.nodes.emplace_back();
+
+            for (int j = 0; j < 2; j++)
+            {
+                const rect &child_aabb = nodes[node.children[j]].aabb;
+                for (int i = 0; i < T::size; i++)
+                {
+                    ret.nodes[pos].a[j][i] = Q::Quantize(aabb.a[i], aabb.b[i], child_aabb.a[i], false);
+                    ret.nodes[pos].b[j][i] = Q::Quantize(aabb.a[i], aabb.b[i], child_aabb.b[i], true);
+                }
+
+                // Note that the children are encoded relative to the decoded AABB of their parent, which is what the queries will see.
+                rect decoded_child_aabb = Q::DequantizeChild(ret.nodes[pos], j, aabb);
+                NodeIndex child_ref = lambda(lambda, node.children[j], decoded_child_aabb);
+                ret.nodes[pos].children[j] = child_ref;
+            }
+            return pos;
+        };
+        ret.bounds = nodes[root_index].aabb;
+        ret.root = lambda(lambda, root_index, ret.bounds);
+
+        return ret;
+    }
+
+    // Returns the surface area heuristic cost of the tree, which estimates the average query cost. Lower is better.
+    // This is the sum of `RectWeight()` of the internal nodes, divided by that of the root. Returns zero if there are no internal nodes.
+    [[nodiscard]] double SahCost() const
+    {
+        if (root_index == null_index || nodes[root_index].IsLeaf())
+            return 0;
+
+        double sum = 0;
+        for (NodeIndex i = 0; i < node_set.ElemCount(); i++)
+        {
+            const Node &node = nodes[node_set.GetElem(i)];
+            if (!node.IsLeaf())
+                sum += double(RectWeight(node.aabb));
+        }
+
+        double root_weight = double(RectWeight(nodes[root_index].aabb));
+        return root_weight > 0 ? sum / root_weight : 0;
+    }
+
+    // Incrementally improves the tree quality, which degrades over time as the nodes are modified.
+    // Call this periodically (e.g. once per frame). It examines some internal nodes (continuing from where the last call stopped),
+    //   picks the ones that waste the most space (as judged by `RectWeight()` of a node compared to its children),
+    //   and rebuilds the subtrees around them from scratch, using the same algorithm as `Build()`. Then it applies tree rotations to their ancestors.
+    // `leaf_budget` is the max number of leaves to rebuild per call, this controls the time spent.
+    // Node indices of the leaves are preserved. Returns the number of leaves that were rebuilt. Use `SahCost()` to monitor the tree quality.
+    int Optimize(int leaf_budget = 64)
+    {
+        if (root_index == null_index || leaf_budget < 2)
+            return 0;
+
+        #if IMP_AUTO_VALIDATE_AABB_TREES
+        FINALLY{Validate();};
+        #endif
+
+        // Find the worst node in a window of the node list.
+        NodeIndex num_to_scan = min(node_set.ElemCount(), NodeIndex(leaf_budget * 4));
+        NodeIndex worst_index = null_index;
+        double worst_badness = 0;
+        for (NodeIndex i = 0; i < num_to_scan; i++)
+        {
+            if (optimize_cursor >= node_set.ElemCount())
+                optimize_cursor = 0;
+            NodeIndex index = node_set.GetElem(optimize_cursor++);
+
+            const Node &node = nodes[index];
+            if (node.IsLeaf())
+                continue;
+
+            // This is the `m_min` metric from "Fast Insertion-Based Optimization of Bounding Volume Hierarchies" by Bittner et al.
+            double min_child_weight = min(double(RectWeight(nodes[node.children[0]].aabb)), double(RectWeight(nodes[node.children[1]].aabb)));
+            double badness = double(RectWeight(node.aabb)) / max(min_child_weight, 1e-6);
+
+            if (worst_index == null_index || badness > worst_badness)
+            {
+                worst_index = index;
+                worst_badness = badness;
+            }
+        }
+
+        if (worst_index == null_index)
+            return 0;
+
+        // Go down if the subtree is too large, then go up as much as the budget allows, to give the builder more freedom.
+        int num_leaves = CountLeaves(worst_index, leaf_budget);
+        while (num_leaves > leaf_budget)
+        {
+            const Node &node = nodes[worst_index];
+            int counts[2] = {CountLeaves(node.children[0], leaf_budget), CountLeaves(node.children[1], leaf_budget)};
+            int j = counts[0] >= counts[1] ? 0 : 1; // Take the larger child, it's more likely to contain the bad part.
+            worst_index = node.children[j];
+            num_leaves = counts[j];
+        }
+        while (nodes[worst_index].parent != null_index)
+        {
+            NodeIndex parent_index = nodes[worst_index].parent;
+            const Node &parent_node = nodes[parent_index];
+            int parent_num_leaves = num_leaves + CountLeaves(parent_node.children[parent_node.children[0] == worst_index ? 1 : 0], leaf_budget - num_leaves);
+            if (parent_num_leaves > leaf_budget)
+                break;
+            worst_index = parent_index;
+            num_leaves = parent_num_leaves;
+        }
+        if (num_leaves < 2)
+            return 0;
+
+        // Collect the leaves and destroy the internal nodes.
+        std::vector<NodeIndex> leaves;
+        auto lambda = [&](auto &lambda, NodeIndex index) -> void
+        {
+            const Node &node = nodes[index];
+            if (node.IsLeaf())
+            {
+                leaves.push_back(index);
+                return;
+            }
+            lambda(lambda, node.children[0]);
+            lambda(lambda, node.children[1]);
+            node_set.EraseUnordered(index);
+        };
+        NodeIndex parent_index = nodes[worst_index].parent;
+        lambda(lambda, worst_index);
+
+        // Rebuild and reattach.
+        NodeIndex new_index = BuildSubtree(leaves);
+        nodes[new_index].parent = parent_index;
+        if (parent_index == null_index)
+        {
+            root_index = new_index;
+        }
+        else
+        {
+            Node &parent_node = nodes[parent_index];
+            parent_node.children[parent_node.children[0] == worst_index ? 0 : 1] = new_index;
+        }
+
+        // The rebuild can't fix the upper levels, so rotate the ancestors where it helps.
+        for (NodeIndex index = parent_index; index != null_index; index = nodes[index].parent)
+        {
+            RotateForCost(index);
+
+            Node &node = nodes[index];
+            node.height = 1 + max(nodes[node.children[0]].height, nodes[node.children[1]].height);
+            node.aabb = nodes[node.children[0]].aabb.combine(nodes[node.children[1]].aabb);
+            UpdateChildBounds(index);
+        }
+
+        return int(leaves.size());
+    }
+
+    // Writes the tree to a flat binary blob, to be restored later with `Load()`.
+    // The node array is written as is, so the format depends on the platform and on the template parameters (the header records enough to detect a mismatch).
+    // The parameters are not saved.
+    void Save(Stream::Output &output) const requires std::is_trivially_copyable_v<UserData>
+    {
+        output.WriteLittle<std::uint32_t>(save_magic);
+        output.WriteLittle<std::uint32_t>(SaveFormatSignature());
+
+        NodeIndex capacity = node_set.Capacity();
+        output.WriteLittle<NodeIndex>(capacity);
+        output.WriteLittle<NodeIndex>(node_set.ElemCount());
+        output.WriteLittle<NodeIndex>(root_index);
+        output.WriteLittle<NodeIndex>(optimize_cursor);
+
+        for (NodeIndex i = 0; i < capacity; i++)
+            output.WriteLittle<NodeIndex>(node_set.GetElem(i));
+
+        // Copy the nodes member by member into a zeroed buffer, so that the padding is written as zeros instead of leaking whatever was in memory.
+        constexpr NodeIndex chunk_size = 256;
+        std::vector<std::uint8_t> buffer;
+        for (NodeIndex begin = 0; begin < capacity; begin += chunk_size)
+        {
+            NodeIndex end = min(capacity, begin + chunk_size);
+            buffer.assign(std::size_t(end - begin) * sizeof(Node), 0);
+            for (NodeIndex i = begin; i < end; i++)
+            {
+                const Node &node = nodes[i];
+                std::uint8_t *node_bytes = buffer.data() + std::size_t(i - begin) * sizeof(Node);
+                auto copy_member = [&](const auto &member)
+                {
+                    std::memcpy(node_bytes + (reinterpret_cast<const std::uint8_t *>(&member) - reinterpret_cast<const std::uint8_t *>(&node)), &member, sizeof member);
+                };
+                copy_member(node.aabb);
+                copy_member(node.height);
+                copy_member(node.moved);
+                copy_member(node.parent);
+                copy_member(node.children);
+                if constexpr (!std::is_empty_v<UserData>)
+                    copy_member(node.userdata);
+            }
+            output.WriteBytes(buffer.data(), buffer.size());
+        }
+    }
+
+    // Destroys all nodes, and then restores the tree written by `Save()`. The parameters are left as is.
+    // Unlike `Build()`, this doesn't recompute anything (other than the child bounds if `soa_child_bounds` is enabled), so it's basically as fast as copying the data.
+    // In particular, the node indices and the internal structure are exactly the same as in the saved tree.
+    // If `track_moved_nodes` is enabled, all leaves are marked as moved, same as in `Build()`.
+    // Throws on failure, then the tree is left empty. The tree structure is checked before it's used, so malformed data throws instead of causing out-of-bounds accesses.
+    void Load(Stream::Input input) requires std::is_trivially_copyable_v<UserData>
+    {
+        node_set = {};
+        nodes.clear();
+        child_bounds.clear();
+        moved_nodes.clear();
+        root_index = null_index;
+        optimize_cursor = 0;
+
+        FINALLY_ON_THROW
+        {
+            node_set = {};
+            nodes.clear();
+            child_bounds.clear();
+            moved_nodes.clear();
+            root_index = null_index;
+            optimize_cursor = 0;
+        };
+
+        if (input.ReadLittle<std::uint32_t>() != save_magic)
+            throw std::runtime_error(input.GetExceptionPrefix() + "This is not a serialized AABB tree.");
+        if (input.ReadLittle<std::uint32_t>() != SaveFormatSignature())
+            throw std::runtime_error(input.GetExceptionPrefix() + "This AABB tree was saved with different template parameters or on a different platform.");
+
+        NodeIndex capacity = input.ReadLittle<NodeIndex>();
+        NodeIndex count = input.ReadLittle<NodeIndex>();
+        NodeIndex new_root_index = input.ReadLittle<NodeIndex>();
+        NodeIndex new_optimize_cursor = input.ReadLittle<NodeIndex>();
+        if (capacity < 0 || count < 0 || count > capacity || new_root_index < null_index || new_root_index >= capacity || (new_root_index == null_index) != (count == 0))
+            throw std::runtime_error(input.GetExceptionPrefix() + "Invalid AABB tree header.");
+        // Each node takes at least this many bytes, so a bogus capacity is rejected before we allocate anything.
+        if (std::size_t(capacity) > input.RemainingBytes() / (sizeof(NodeIndex) + sizeof(Node)))
+            throw std::runtime_error(input.GetExceptionPrefix() + "The AABB tree data is truncated.");
+
+        // Restore the exact element order, since it determines which indices `AddNode()` hands out next.
+        // Inserting the elements in the saved order reproduces it, then erasing the trailing ones from the end doesn't reorder anything.
+        std::vector<NodeIndex> order(capacity);
+        input.ReadLittle(order.data(), order.size());
+        Reserve(capacity);
+        for (NodeIndex elem : order)
+        {
+            if (elem < 0 || elem >= capacity || !node_set.Insert(elem))
+                throw std::runtime_error(input.GetExceptionPrefix() + "Invalid AABB tree node list.");
+        }
+        for (NodeIndex i = capacity; i-- > count;)
+            node_set.EraseUnordered(order[i]);
+
+        input.Read(reinterpret_cast<std::uint8_t *>(nodes.data()), capacity * sizeof(Node));
+
+        // Check the nodes, same as `Validate()` but without recursion. Each non-root node must be a child of its parent, and the heights must match,
+        //   which together rule out cycles and unreachable nodes.
+        for (NodeIndex i = 0; i < count; i++)
+        {
+            NodeIndex index = node_set.GetElem(i);
+            const Node &node = nodes[index];
+
+            bool ok = true;
+            if (index == new_root_index)
+            {
+                ok = node.parent == null_index;
+            }
+            else
+            {
+                ok = node_set.Contains(node.parent) &&
+                    (nodes[node.parent].children[0] == index || nodes[node.parent].children[1] == index) &&
+                    nodes[node.parent].height > node.height;
+            }
+
+            if (ok && node.IsLeaf())
+            {
+                ok = node.children[1] == null_index && node.height == 0;
+            }
+            else if (ok)
+            {
+                ok = node.children[0] != node.children[1] && node_set.Contains(node.children[0]) && node_set.Contains(node.children[1]) &&
+                    nodes[node.children[0]].parent == index && nodes[node.children[1]].parent == index &&
+                    node.height == 1 + max(nodes[node.children[0]].height, nodes[node.children[1]].height) &&
+                    node.aabb == nodes[node.children[0]].aabb.combine(nodes[node.children[1]].aabb);
+            }
+
+            if (!ok)
+                throw std::runtime_error(input.GetExceptionPrefix() + "Invalid AABB tree node " + std::to_string(index) + ".");
+        }
+
+        root_index = new_root_index;
+        optimize_cursor = min(new_optimize_cursor, count);
+
+        for (NodeIndex i = 0; i < count; i++)
+        {
+            NodeIndex index = node_set.GetElem(i);
+            Node &node = nodes[index];
+            node.moved = false;
+            if (node.IsLeaf())
+                MarkMoved(index);
+            else
+                UpdateChildBounds(index);
+        }
+
+        #if IMP_AUTO_VALIDATE_AABB_TREES
+        Validate();
+        #endif
+    }
+
     // Performs some internal tests. Throws on failure.
     // In the debug builds this is called automatically as needed.
     void Validate()
@@ -389,6 +1360,8 @@ class AabbTree
 
         node_set.Reserve(new_capacity);
         nodes.resize(new_capacity);
+        if (params.soa_child_bounds)
+            child_bounds.resize(new_capacity);
     }
     // Lets you look at the node set, mostly for debug purposes.
     [[nodiscard]] const SparseSet<NodeIndex> &Nodes() const
@@ -424,6 +1397,15 @@ class AabbTree
 
     NodeIndex root_index = null_index;
 
+    // Identifies blobs written by `Save()`.
+    static constexpr std::uint32_t save_magic = 0x54424141; // "AABT" in little-endian.
+
+    // A hash of everything that affects the layout of the saved nodes.
+    [[nodiscard]] static constexpr std::uint32_t SaveFormatSignature()
+    {
+        return std::uint32_t(ByteOrder::native) | std::uint32_t(T::size) << 1 | std::uint32_t(sizeof(scalar)) << 4 | std::uint32_t(std::is_floating_point_v<scalar>) << 8 | std::uint32_t(sizeof(Node)) << 9 | std::uint32_t(Math2::fixed_point_scalar<scalar>) << 24;
+    }
+
     struct Node
     {
         rect aabb;
@@ -431,8 +1413,8 @@ class AabbTree
         int height = 0;
 
         // Box2d sets this to true when a leaf node is created or moved.
-        // I don't see any use for it yet, so it's commented out.
-        // bool moved = false;
+        // We only do this if `params.track_moved_nodes` is true. The node is then also added to `moved_nodes`.
+        bool moved = false;
 
         NodeIndex parent = null_index;
         NodeIndex children[2] = {null_index, null_index};
@@ -447,6 +1429,254 @@ class AabbTree
     };
     std::vector<Node> nodes;
 
+    // A position in `node_set` where the next `Optimize()` call continues scanning.
+    NodeIndex optimize_cursor = 0;
+
+    // The AABBs of both children of a node, in the structure-of-arrays form.
+    struct ChildBounds
+    {
+        // `a[i * 2 + j]` is the `i`-th coordinate of the `a` corner of the `j`-th child. Same for `b`.
+        scalar a[T::size * 2]{};
+        scalar b[T::size * 2]{};
+    };
+    // If `params.soa_child_bounds` is true, this has the same size as `nodes`. Otherwise it's empty.
+    // Only the elements for the internal nodes are meaningful.
+    std::vector<ChildBounds> child_bounds;
+
+    // If enabled in the parameters, copies the AABBs of the children of this internal node to `child_bounds`.
+    void UpdateChildBounds(NodeIndex index)
+    {
+        if (!params.soa_child_bounds)
+            return;
+
+        ChildBounds &bounds = child_bounds[index];
+        for (int j = 0; j < 2; j++)
+        {
+            const rect &child_aabb = nodes[nodes[index].children[j]].aabb;
+            for (int i = 0; i < T::size; i++)
+            {
+                bounds.a[i * 2 + j] = child_aabb.a[i];
+                bounds.b[i * 2 + j] = child_aabb.b[i];
+            }
+        }
+    }
+
+    // A collision test using `child_bounds`, which must be enabled.
+    // `check_children` is `void check_children(const ChildBounds &bounds, bool (&result)[2])`. It must set `result[j]` to false if child `j` doesn't collide.
+    // `check_root` is `bool check_root(const rect &aabb)`, it's the same test for the root node, which has no parent to store its bounds.
+    // `func` is same as in `CollideCustom()`.
+    template <typename C, typename R, typename F>
+    bool CollideChildBounds(C &&check_children, R &&check_root, F &&func) const
+    {
+        ASSERT(params.soa_child_bounds);
+
+        if (root_index == null_index || !check_root(std::as_const(nodes[root_index].aabb)))
+            return false;
+
+        static constexpr bool (*lambda)(const AabbTree &, NodeIndex, C &, F &) =
+        [](const AabbTree &self, NodeIndex index, C &check_children, F &func) -> bool
+        {
+            const Node &node = self.nodes[index];
+            if (node.IsLeaf())
+                return bool(func(std::as_const(index)));
+
+            bool result[2] = {true, true};
+            check_children(self.child_bounds[index], result);
+            for (int j = 0; j < 2; j++)
+            {
+                if (result[j] && lambda(self, node.children[j], check_children, func))
+                    return true;
+            }
+            return false;
+        };
+        return lambda(*this, root_index, check_children, func);
+    }
+
+    // Returns the inverse of the ray direction, for the ray casts.
+    // Zero components are replaced with a tiny value first, to avoid NaNs in `RayTouchesAabb()`. The huge finite inverse handles those axes correctly.
+    [[nodiscard]] static fvector RayInvDir(fvector dir)
+    {
+        fvector ret;
+        for (int i = 0; i < T::size; i++)
+            ret[i] = 1 / (dir[i] == 0 ? std::numeric_limits<fscalar>::min() : dir[i]);
+        return ret;
+    }
+
+    // The slab test for the ray casts. Returns true if the ray hits the AABB before `max_fraction`, and writes the entry fraction to `entry`.
+    [[nodiscard]] static bool RayTouchesAabb(const rect &aabb, fvector origin, fvector inv_dir, fscalar max_fraction, fscalar &entry)
+    {
+        fscalar t_enter = 0;
+        fscalar t_exit = max_fraction;
+        for (int i = 0; i < T::size; i++)
+        {
+            fscalar t1 = (fscalar(aabb.a[i]) - origin[i]) * inv_dir[i];
+            fscalar t2 = (fscalar(aabb.b[i]) - origin[i]) * inv_dir[i];
+            sort_two_var(t1, t2);
+            clamp_var_min(t_enter, t1);
+            clamp_var_max(t_exit, t2);
+        }
+        entry = t_enter;
+        return t_enter <= t_exit;
+    }
+
+    // Implementation of `SegmentCast()` and `RayCast()`.
+    template <typename F>
+    fscalar CastImpl(fvector origin, fvector dir, fscalar max_fraction, F &func) const
+    {
+        fvector inv_dir = RayInvDir(dir);
+        fscalar root_entry{};
+        if (root_index == null_index || !RayTouchesAabb(nodes[root_index].aabb, origin, inv_dir, max_fraction, root_entry))
+            return max_fraction;
+
+        // Returns true on stop.
+        static constexpr bool (*lambda)(const AabbTree &, NodeIndex, const fvector &, const fvector &, fscalar &, F &) =
+        [](const AabbTree &self, NodeIndex index, const fvector &origin, const fvector &inv_dir, fscalar &max_fraction, F &func) -> bool
+        {
+            const Node &node = self.nodes[index];
+            if (node.IsLeaf())
+            {
+                fscalar new_max_fraction = func(std::as_const(index), std::as_const(max_fraction));
+                clamp_var_max(max_fraction, new_max_fraction);
+                return max_fraction <= 0;
+            }
+
+            bool hits[2];
+            fscalar entries[2];
+            for (int j = 0; j < 2; j++)
+                hits[j] = RayTouchesAabb(self.nodes[node.children[j]].aabb, origin, inv_dir, max_fraction, entries[j]);
+
+            // Visit the closest child first.
+            int first = hits[1] && (!hits[0] || entries[1] < entries[0]);
+            for (int j : {first, 1 - first})
+            {
+                // Using `<=` rather than `<` to be able to land exactly on the max fraction. The second check is needed because the first child could've reduced it.
+                if (hits[j] && entries[j] <= max_fraction && lambda(self, node.children[j], origin, inv_dir, max_fraction, func))
+                    return true;
+            }
+            return false;
+        };
+        lambda(*this, root_index, origin, inv_dir, max_fraction, func);
+        return max_fraction;
+    }
+
+    using cast_lanes = Math::vec<cast_packet_size, fscalar>;
+    using cast_lane_mask = Math::vec<cast_packet_size, bool>;
+
+    // A packet of segments for `SegmentCastBatch()`. The segments are stored in the structure-of-arrays form, one lane per segment.
+    struct CastPacket
+    {
+        std::size_t base_index = 0;
+        cast_lanes origin[T::size];
+        cast_lanes inv_dir[T::size];
+        cast_lanes max_fraction = cast_lanes(1);
+        cast_lane_mask active = cast_lane_mask(true);
+    };
+
+    // The slab test for a whole packet. Returns the mask of active lanes that hit the AABB. Optionally writes the entry fractions to `entry`.
+    [[nodiscard]] static cast_lane_mask PacketTouchesAabb(const CastPacket &packet, const rect &aabb, cast_lanes *entry = nullptr)
+    {
+        cast_lanes t_enter{};
+        cast_lanes t_exit = packet.max_fraction;
+        for (int i = 0; i < T::size; i++)
+        {
+            cast_lanes t1 = (fscalar(aabb.a[i]) - packet.origin[i]) * packet.inv_dir[i];
+            cast_lanes t2 = (fscalar(aabb.b[i]) - packet.origin[i]) * packet.inv_dir[i];
+            t_enter = max(t_enter, min(t1, t2));
+            t_exit = min(t_exit, max(t1, t2));
+        }
+        if (entry)
+            *entry = t_enter;
+        return packet.active && t_enter <= t_exit;
+    }
+
+    // Implementation of `SegmentCastBatch()`. Returns true if all lanes are stopped.
+    template <typename F>
+    bool CastPacketImpl(NodeIndex index, CastPacket &packet, F &func) const
+    {
+        const Node &node = nodes[index];
+        if (node.IsLeaf())
+        {
+            cast_lane_mask mask = PacketTouchesAabb(packet, node.aabb);
+            for (int lane = 0; lane < cast_packet_size; lane++)
+            {
+                if (!mask[lane])
+                    continue;
+                fscalar new_max_fraction = func(packet.base_index + lane, std::as_const(index), std::as_const(packet.max_fraction[lane]));
+                clamp_var_max(packet.max_fraction[lane], new_max_fraction);
+                if (packet.max_fraction[lane] <= 0)
+                    packet.active[lane] = false;
+            }
+            return packet.active.none();
+        }
+
+        cast_lane_mask masks[2];
+        fscalar entries[2];
+        for (int j = 0; j < 2; j++)
+        {
+            cast_lanes lane_entries;
+            masks[j] = PacketTouchesAabb(packet, nodes[node.children[j]].aabb, &lane_entries);
+            entries[j] = std::numeric_limits<fscalar>::infinity();
+            for (int lane = 0; lane < cast_packet_size; lane++)
+            {
+                if (masks[j][lane])
+                    clamp_var_max(entries[j], lane_entries[lane]);
+            }
+        }
+
+        // Visit the closest child first, as judged by the closest lane.
+        int first = masks[1].any() && (masks[0].none() || entries[1] < entries[0]);
+        for (int j : {first, 1 - first})
+        {
+            // Re-testing the second child, since the first one could've reduced the max fractions.
+            if (masks[j].any() && (j == first || PacketTouchesAabb(packet, nodes[node.children[j]].aabb).any()) && CastPacketImpl(node.children[j], packet, func))
+                return true;
+        }
+        return false;
+    }
+
+    // The leaves that were created or reinserted, if `params.track_moved_nodes` is true.
+    // Can contain duplicates and destroyed nodes, check `Node::moved` to filter them out.
+    std::vector<NodeIndex> moved_nodes;
+
+    // If enabled in the parameters, marks a leaf as moved, see `CollideMovedPairs()`.
+    void MarkMoved(NodeIndex index)
+    {
+        if (!params.track_moved_nodes)
+            return;
+        nodes[index].moved = true;
+        moved_nodes.push_back(index);
+    }
+
+    // Reports all colliding leaf pairs between two subtrees. A helper for `CollideAllPairs()`.
+    template <typename F>
+    bool CollideSubtreePair(NodeIndex index_a, NodeIndex index_b, F &func) const
+    {
+        const Node &node_a = nodes[index_a];
+        const Node &node_b = nodes[index_b];
+        if (!node_a.aabb.touches(node_b.aabb))
+            return false;
+
+        bool a_is_leaf = node_a.IsLeaf();
+        bool b_is_leaf = node_b.IsLeaf();
+
+        if (a_is_leaf && b_is_leaf)
+            return bool(func(std::as_const(index_a), std::as_const(index_b)));
+
+        // Descend into the larger node, this prunes more pairs.
+        if (b_is_leaf || (!a_is_leaf && RectWeight(node_a.aabb) >= RectWeight(node_b.aabb)))
+        {
+            return
+                CollideSubtreePair(node_a.children[0], index_b, func) ||
+                CollideSubtreePair(node_a.children[1], index_b, func);
+        }
+        else
+        {
+            return
+                CollideSubtreePair(index_a, node_b.children[0], func) ||
+                CollideSubtreePair(index_a, node_b.children[1], func);
+        }
+    }
+
     // Increases the capacity if we're full.
     void ReserveMoreIfFull()
     {
@@ -602,7 +1832,14 @@ class AabbTree
     {
         while (index != null_index)
         {
-            index = BalanceNode(index);
+            NodeIndex balanced_index = BalanceNode(index);
+            if (balanced_index != index)
+            {
+                // The old node was rotated down and got different children.
+                UpdateChildBounds(index);
+                index = balanced_index;
+            }
+
             Node &node = nodes[index];
 
             const Node &child0 = nodes[node.children[0]];
@@ -610,11 +1847,198 @@ class AabbTree
 
             node.height = 1 + max(child0.height, child1.height);
             node.aabb = child0.aabb.combine(child1.aabb);
+            UpdateChildBounds(index);
 
             index = node.parent;
         }
     }
 
+    // Swaps a child of this node with a grandchild (from the other child), if this reduces the total `RectWeight()`.
+    // This is the tree rotation from "Fast, Effective BVH Updates for Animated Scenes" by Kopta et al.
+    // The AABB and height of `index` itself are not updated, but its children are.
+    void RotateForCost(NodeIndex index)
+    {
+        Node &node = nodes[index];
+        if (node.IsLeaf())
+            return;
+
+        // `j` is the child that gets swapped with the grandchild `k` of the other child.
+        int best_j = -1, best_k = -1;
+        double best_delta = 0;
+        for (int j = 0; j < 2; j++)
+        {
+            const Node &other = nodes[node.children[1 - j]];
+            if (other.IsLeaf())
+                continue;
+
+            for (int k = 0; k < 2; k++)
+            {
+                // The other child would contain our child `j` and its own child `1-k`.
+                double delta = double(RectWeight(nodes[node.children[j]].aabb.combine(nodes[other.children[1 - k]].aabb))) - double(RectWeight(other.aabb));
+                if (delta < best_delta)
+                {
+                    best_j = j;
+                    best_k = k;
+                    best_delta = delta;
+                }
+            }
+        }
+
+        if (best_j == -1)
+            return;
+
+        NodeIndex child_index = node.children[best_j];
+        NodeIndex other_index = node.children[1 - best_j];
+        Node &other = nodes[other_index];
+        NodeIndex grandchild_index = other.children[best_k];
+
+        node.children[best_j] = grandchild_index;
+        other.children[best_k] = child_index;
+        nodes[grandchild_index].parent = index;
+        nodes[child_index].parent = other_index;
+
+        other.height = 1 + max(nodes[other.children[0]].height, nodes[other.children[1]].height);
+        other.aabb = nodes[other.children[0]].aabb.combine(nodes[other.children[1]].aabb);
+        UpdateChildBounds(other_index);
+    }
+
+    // Counts the leaves in a subtree, but stops as soon as the count exceeds `limit`, then returns `limit + 1`.
+    [[nodiscard]] int CountLeaves(NodeIndex index, int limit) const
+    {
+        const Node &node = nodes[index];
+        if (node.IsLeaf())
+            return 1;
+        if (limit < 2)
+            return limit + 1;
+        int count = CountLeaves(node.children[0], limit - 1);
+        if (count >= limit)
+            return limit + 1;
+        return count + CountLeaves(node.children[1], limit - count);
+    }
+
+    // Returns the doubled center of a node AABB. Doubled to avoid dividing integers.
+    [[nodiscard]] T GetNodeDoubleCentroid(NodeIndex index) const
+    {
+        return nodes[index].aabb.a + nodes[index].aabb.b;
+    }
+
+    // Builds a subtree from the specified leaves, returns its root. This is a helper for `Build()` and `Optimize()`.
+    // The leaves must already exist, and there must be enough free capacity for `leaves.size() - 1` internal nodes.
+    // The `leaves` list gets reordered in the process. The parent of the returned node is left unchanged.
+    [[nodiscard]] NodeIndex BuildSubtree(std::span<NodeIndex> leaves)
+    {
+        ASSERT(!leaves.empty());
+        if (leaves.size() == 1)
+            return leaves.front();
+
+        // Find the centroid bounds, and the longest axis.
+        T centroid_min = GetNodeDoubleCentroid(leaves.front());
+        T centroid_max = centroid_min;
+        for (NodeIndex leaf : leaves)
+        {
+            T centroid = GetNodeDoubleCentroid(leaf);
+            centroid_min = min(centroid_min, centroid);
+            centroid_max = max(centroid_max, centroid);
+        }
+        T centroid_extent = centroid_max - centroid_min;
+
+        int axis = 0;
+        for (int i = 1; i < T::size; i++)
+        {
+            if (centroid_extent[i] > centroid_extent[axis])
+                axis = i;
+        }
+
+        std::size_t split = leaves.size() / 2;
+
+        // If all centroids match, we just split in the middle.
+        double axis_extent = double(centroid_extent[axis]);
+        if (axis_extent > 0)
+        {
+            static constexpr int num_bins = 16;
+
+            auto GetBinIndex = [&](NodeIndex leaf)
+            {
+                return clamp(int((double(GetNodeDoubleCentroid(leaf)[axis]) - double(centroid_min[axis])) / axis_extent * num_bins), 0, num_bins - 1);
+            };
+
+            struct Bin
+            {
+                rect aabb;
+                std::size_t count = 0;
+            };
+            Bin bins[num_bins];
+
+            for (NodeIndex leaf : leaves)
+            {
+                Bin &bin = bins[GetBinIndex(leaf)];
+                bin.aabb = bin.count == 0 ? nodes[leaf].aabb : bin.aabb.combine(nodes[leaf].aabb);
+                bin.count++;
+            }
+
+            // `right_costs[i]` is the cost of bins `i+1..num_bins-1`.
+            double right_costs[num_bins - 1]{};
+            {
+                rect aabb;
+                std::size_t count = 0;
+                for (int i = num_bins - 1; i > 0; i--)
+                {
+                    if (bins[i].count > 0)
+                    {
+                        aabb = count == 0 ? bins[i].aabb : aabb.combine(bins[i].aabb);
+                        count += bins[i].count;
+                    }
+                    right_costs[i - 1] = count == 0 ? -1 : double(RectWeight(aabb)) * double(count);
+                }
+            }
+
+            // Find the split with the smallest cost. The split `i` is between bins `i` and `i+1`.
+            int best_split = -1;
+            double best_cost = 0;
+            {
+                rect aabb;
+                std::size_t count = 0;
+                for (int i = 0; i < num_bins - 1; i++)
+                {
+                    if (bins[i].count > 0)
+                    {
+                        aabb = count == 0 ? bins[i].aabb : aabb.combine(bins[i].aabb);
+                        count += bins[i].count;
+                    }
+                    if (count == 0 || right_costs[i] < 0)
+                        continue;
+
+                    double cost = double(RectWeight(aabb)) * double(count) + right_costs[i];
+                    if (best_split == -1 || cost < best_cost)
+                    {
+                        best_split = i;
+                        best_cost = cost;
+                    }
+                }
+            }
+
+            // There should always be a valid split, since the extreme centroids must land in the first and the last bins.
+            ASSERT(best_split != -1);
+            if (best_split != -1)
+                split = std::size_t(std::partition(leaves.begin(), leaves.end(), [&](NodeIndex leaf){return GetBinIndex(leaf) <= best_split;}) - leaves.begin());
+        }
+
+        NodeIndex child_a = BuildSubtree(leaves.first(split));
+        NodeIndex child_b = BuildSubtree(leaves.subspan(split));
+
+        NodeIndex index = node_set.InsertAny(); // We've reserved enough capacity in advance.
+        Node &node = nodes[index];
+        node = {};
+        node.children[0] = child_a;
+        node.children[1] = child_b;
+        node.aabb = nodes[child_a].aabb.combine(nodes[child_b].aabb);
+        node.height = 1 + max(nodes[child_a].height, nodes[child_b].height);
+        nodes[child_a].parent = index;
+        nodes[child_b].parent = index;
+        UpdateChildBounds(index);
+        return index;
+    }
+
     // Performs some internal tests on a node, recursively. Throws on failure.
     // Don't call direclty, use the `Validate()` function.
     void ValidateNode(NodeIndex index) const
@@ -645,6 +2069,17 @@ class AabbTree
             ASSERT_ALWAYS(node.height == 1 + max(child0.height, child1.height));
             ASSERT_ALWAYS(node.aabb == child0.aabb.combine(child1.aabb));
 
+            if (params.soa_child_bounds)
+            {
+                const ChildBounds &bounds = child_bounds[index];
+                for (int j = 0; j < 2; j++)
+                for (int i = 0; i < T::size; i++)
+                {
+                    ASSERT_ALWAYS(bounds.a[i * 2 + j] == nodes[node.children[j]].aabb.a[i]);
+                    ASSERT_ALWAYS(bounds.b[i * 2 + j] == nodes[node.children[j]].aabb.b[i]);
+                }
+            }
+
             ValidateNode(node.children[0]);
             ValidateNode(node.children[1]);
         }
@@ -0,0 +1,546 @@
+#include "aabb_tree.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+template class AabbTree<ivec2, int>;
+template class AabbTree<fvec2>;
+template class AabbTree<vec2<fixed16>>;
+
+namespace
+{
+    // Makes `count` random rects in a `size`x`size` square.
+    [[nodiscard]] std::vector<irect2> MakeRandomRects(std::mt19937 &gen, int count, int size)
+    {
+        std::uniform_int_distribution<int> pos_dist(0, size - 1), size_dist(1, 16);
+        std::vector<irect2> ret;
+        for (int i = 0; i < count; i++)
+        {
+            ivec2 pos(pos_dist(gen), pos_dist(gen));
+            ret.push_back(pos.rect_size(ivec2(size_dist(gen), size_dist(gen))));
+        }
+        return ret;
+    }
+
+    // Returns the sorted list of nodes colliding with `query`.
+    [[nodiscard]] std::vector<int> CollectAabbCollisions(const AabbTree<ivec2, int> &tree, irect2 query)
+    {
+        std::vector<int> ret;
+        tree.CollideAabb(query, [&](int node){ret.push_back(node); return false;});
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    }
+
+    // Same as `CollectAabbCollisions()`, but brute-forces the nodes.
+    [[nodiscard]] std::vector<int> CollectAabbCollisionsBruteForce(const AabbTree<ivec2, int> &tree, const std::vector<int> &leaves, irect2 query)
+    {
+        std::vector<int> ret;
+        for (int leaf : leaves)
+        {
+            if (tree.GetNodeAabb(leaf).touches(query))
+                ret.push_back(leaf);
+        }
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    }
+}
+
+TEST_CASE("aabb_tree.build")
+{
+    std::mt19937 gen(42);
+
+    for (bool soa : {false, true})
+    for (int count : {0, 1, 2, 3, 10, 1000})
+    {
+        CAPTURE(soa);
+        CAPTURE(count);
+
+        std::vector<irect2> rects = MakeRandomRects(gen, count, 256);
+        std::vector<int> userdata(count);
+        for (int i = 0; i < count; i++)
+            userdata[i] = i * 10;
+
+        AabbTree<ivec2, int>::Params params(ivec2(2));
+        params.soa_child_bounds = soa;
+        AabbTree<ivec2, int> tree(params, rects, userdata);
+        tree.Validate();
+
+        REQUIRE(tree.IsEmpty() == (count == 0));
+        REQUIRE(tree.Nodes().ElemCount() == (count == 0 ? 0 : count * 2 - 1));
+
+        std::vector<int> leaves;
+        for (int i = 0; i < count; i++)
+        {
+            REQUIRE(tree.GetNodeAabb(i) == rects[i].expand(2));
+            REQUIRE(tree.GetNodeUserData(i) == i * 10);
+            leaves.push_back(i);
+        }
+
+        for (irect2 query : MakeRandomRects(gen, 100, 256))
+        {
+            REQUIRE(CollectAabbCollisions(tree, query) == CollectAabbCollisionsBruteForce(tree, leaves, query));
+
+            std::vector<int> point_hits, point_hits_brute_force;
+            tree.CollidePoint(query.a, [&](int node){point_hits.push_back(node); return false;});
+            for (int leaf : leaves)
+            {
+                if (tree.GetNodeAabb(leaf).contains(query.a))
+                    point_hits_brute_force.push_back(leaf);
+            }
+            std::sort(point_hits.begin(), point_hits.end());
+            REQUIRE(point_hits == point_hits_brute_force);
+        }
+
+        // The tree should remain modifiable.
+        if (count > 1)
+        {
+            std::uniform_int_distribution<int> leaf_dist(0, count - 1);
+            for (int i = 0; i < 100; i++)
+            {
+                int leaf = leaf_dist(gen);
+                tree.ModifyNode(leaf, MakeRandomRects(gen, 1, 256).front(), ivec2());
+            }
+            REQUIRE(tree.RemoveNode(0));
+            leaves.erase(leaves.begin());
+            leaves.push_back(tree.AddNode(ivec2(10).rect_size(4), -1));
+            tree.Validate();
+
+            for (irect2 query : MakeRandomRects(gen, 100, 256))
+                REQUIRE(CollectAabbCollisions(tree, query) == CollectAabbCollisionsBruteForce(tree, leaves, query));
+        }
+    }
+
+    // Identical centroids.
+    std::vector<irect2> same_rects(50, ivec2(5).rect_size(3));
+    AabbTree<ivec2, int> tree(AabbTree<ivec2, int>::Params{}, same_rects);
+    tree.Validate();
+    REQUIRE(tree.Nodes().ElemCount() == 99);
+}
+
+TEST_CASE("aabb_tree.pairs")
+{
+    std::mt19937 gen(43);
+
+    using Tree = AabbTree<ivec2, int>;
+    Tree::Params params(ivec2(1));
+    params.track_moved_nodes = true;
+
+    std::vector<irect2> rects = MakeRandomRects(gen, 300, 128);
+    Tree tree(params, rects);
+
+    auto SortedPair = [](int a, int b) {return a < b ? std::pair(a, b) : std::pair(b, a);};
+
+    auto BruteForcePairs = [&](auto &&filter)
+    {
+        std::vector<std::pair<int, int>> ret;
+        for (std::size_t i = 0; i < rects.size(); i++)
+        for (std::size_t j = i + 1; j < rects.size(); j++)
+        {
+            if (filter(int(i), int(j)) && tree.GetNodeAabb(i).touches(tree.GetNodeAabb(j)))
+                ret.push_back(SortedPair(i, j));
+        }
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    };
+
+    { // All pairs.
+        std::vector<std::pair<int, int>> pairs;
+        tree.CollideAllPairs([&](int a, int b){pairs.push_back(SortedPair(a, b)); return false;});
+        std::sort(pairs.begin(), pairs.end());
+        REQUIRE(std::adjacent_find(pairs.begin(), pairs.end()) == pairs.end());
+        REQUIRE(pairs == BruteForcePairs([](int, int){return true;}));
+    }
+
+    { // Moved pairs. Everything is initially marked as moved.
+        std::vector<std::pair<int, int>> pairs;
+        tree.CollideMovedPairs([&](int a, int b){pairs.push_back(SortedPair(a, b)); return false;});
+        std::sort(pairs.begin(), pairs.end());
+        REQUIRE(pairs == BruteForcePairs([](int, int){return true;}));
+
+        pairs.clear();
+        tree.CollideMovedPairs([&](int a, int b){pairs.push_back(SortedPair(a, b)); return false;});
+        REQUIRE(pairs.empty());
+    }
+
+    { // Move some nodes far enough to reinsert them.
+        std::vector<bool> moved(rects.size());
+        for (int i = 0; i < 300; i += 7)
+        {
+            rects[i] = MakeRandomRects(gen, 1, 128).front();
+            tree.ModifyNode(i, rects[i], ivec2());
+            tree.ModifyNode(i, rects[i], ivec2()); // Produces no duplicates.
+            moved[i] = true;
+        }
+
+        std::vector<std::pair<int, int>> pairs;
+        tree.CollideMovedPairs([&](int a, int b){pairs.push_back(SortedPair(a, b)); return false;});
+        std::sort(pairs.begin(), pairs.end());
+        REQUIRE(std::adjacent_find(pairs.begin(), pairs.end()) == pairs.end());
+        REQUIRE(pairs == BruteForcePairs([&](int a, int b){return moved[a] || moved[b];}));
+    }
+}
+
+TEST_CASE("aabb_tree.ray_cast")
+{
+    std::mt19937 gen(44);
+    std::uniform_real_distribution<float> pos_dist(0, 256);
+
+    using Tree = AabbTree<ivec2, int>;
+    std::vector<irect2> rects = MakeRandomRects(gen, 200, 256);
+    Tree tree(Tree::Params(ivec2(1)), rects);
+
+    // Returns the entry fraction of a segment into a rect, or a negative number on a miss.
+    auto SegmentRectEntry = [](fvec2 a, fvec2 b, frect2 r) -> float
+    {
+        float t_enter = 0, t_exit = 1;
+        for (int i = 0; i < 2; i++)
+        {
+            float d = b[i] - a[i];
+            if (d == 0)
+            {
+                if (a[i] < r.a[i] || a[i] > r.b[i])
+                    return -1;
+                continue;
+            }
+            float t1 = (r.a[i] - a[i]) / d, t2 = (r.b[i] - a[i]) / d;
+            sort_two_var(t1, t2);
+            t_enter = max(t_enter, t1);
+            t_exit = min(t_exit, t2);
+        }
+        return t_enter <= t_exit ? t_enter : -1;
+    };
+
+    std::vector<Tree::Segment> segments;
+    for (int i = 0; i < 100; i++)
+    {
+        fvec2 a(pos_dist(gen), pos_dist(gen));
+        fvec2 b(pos_dist(gen), pos_dist(gen));
+        if (i % 10 == 0)
+            b.x = a.x; // Axis-aligned segments.
+        segments.push_back({a, b});
+    }
+
+    std::vector<float> expected;
+    for (const Tree::Segment &segment : segments)
+    {
+        float best = 1;
+        for (int leaf = 0; leaf < int(rects.size()); leaf++)
+        {
+            float entry = SegmentRectEntry(segment.a, segment.b, tree.GetNodeAabb(leaf));
+            if (entry >= 0)
+                best = min(best, entry);
+        }
+        expected.push_back(best);
+    }
+
+    for (std::size_t i = 0; i < segments.size(); i++)
+    {
+        float result = tree.SegmentCast(segments[i].a, segments[i].b, [&](int node, float max_fraction)
+        {
+            float entry = SegmentRectEntry(segments[i].a, segments[i].b, tree.GetNodeAabb(node));
+            return entry >= 0 ? min(entry, max_fraction) : max_fraction;
+        });
+        REQUIRE(result == doctest::Approx(expected[i]));
+    }
+
+    std::vector<float> batch_results(segments.size());
+    tree.SegmentCastBatch(segments, [&](std::size_t i, int node, float max_fraction)
+    {
+        float entry = SegmentRectEntry(segments[i].a, segments[i].b, tree.GetNodeAabb(node));
+        return entry >= 0 ? min(entry, max_fraction) : max_fraction;
+    }, batch_results);
+    for (std::size_t i = 0; i < segments.size(); i++)
+        REQUIRE(batch_results[i] == doctest::Approx(expected[i]));
+
+    // Stopping early.
+    int num_calls = 0;
+    float result = tree.RayCast(fvec2(-10, 128), fvec2(1, 0), [&](int, float){num_calls++; return 0.f;});
+    REQUIRE(num_calls == 1);
+    REQUIRE(result == 0);
+}
+
+TEST_CASE("aabb_tree.snapshot")
+{
+    std::mt19937 gen(45);
+
+    using Tree = AabbTree<ivec2, int>;
+    std::vector<irect2> rects = MakeRandomRects(gen, 500, 256);
+    std::vector<int> userdata(rects.size());
+    for (std::size_t i = 0; i < rects.size(); i++)
+        userdata[i] = int(i) + 1000;
+    Tree tree(Tree::Params(ivec2(1)), rects, userdata);
+
+    Tree::Snapshot snapshot = tree.MakeSnapshot();
+    REQUIRE(snapshot.Bounds() == tree.Bounds());
+    REQUIRE(Tree{}.MakeSnapshot().IsEmpty());
+
+    std::vector<irect2> queries = MakeRandomRects(gen, 200, 256);
+
+    // The snapshot must be unaffected by the later changes.
+    std::vector<std::vector<int>> expected;
+    for (irect2 query : queries)
+        expected.push_back(CollectAabbCollisions(tree, query));
+    for (int i = 0; i < 100; i++)
+        tree.ModifyNode(i, MakeRandomRects(gen, 1, 256).front(), ivec2());
+
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        std::vector<int> hits;
+        snapshot.CollideAabb(queries[i], [&](int node, int data){REQUIRE(data == node + 1000); hits.push_back(node); return false;});
+        std::sort(hits.begin(), hits.end());
+        REQUIRE(hits == expected[i]);
+    }
+
+    for (int num_threads : {1, 3})
+    {
+        std::vector<std::vector<int>> hits(queries.size());
+        snapshot.CollideAabbParallel(queries, [&](int thread_index, std::size_t query_index, int node)
+        {
+            (void)thread_index;
+            hits[query_index].push_back(node);
+        }, num_threads);
+        for (std::size_t i = 0; i < queries.size(); i++)
+        {
+            std::sort(hits[i].begin(), hits[i].end());
+            REQUIRE(hits[i] == expected[i]);
+        }
+    }
+}
+
+TEST_CASE("aabb_tree.quantized_snapshot")
+{
+    std::mt19937 gen(49);
+
+    auto Check = [&]<typename Tree>(Tree &tree, const std::vector<typename Tree::rect> &queries)
+    {
+        typename Tree::QuantizedSnapshot snapshot = tree.MakeQuantizedSnapshot();
+        REQUIRE(snapshot.Bounds() == tree.Bounds());
+
+        std::size_t num_exact = 0, num_hits = 0;
+        for (const auto &query : queries)
+        {
+            std::vector<int> exact;
+            tree.CollideAabb(query, [&](int node){exact.push_back(node); return false;});
+            std::sort(exact.begin(), exact.end());
+
+            std::vector<int> hits;
+            snapshot.CollideAabb(query, [&](int node, int data){REQUIRE(data == tree.GetNodeUserData(node)); hits.push_back(node); return false;});
+            std::sort(hits.begin(), hits.end());
+            REQUIRE(std::adjacent_find(hits.begin(), hits.end()) == hits.end());
+            // The bounds are rounded outwards, so we can only get extra hits.
+            REQUIRE(std::includes(hits.begin(), hits.end(), exact.begin(), exact.end()));
+
+            num_exact += exact.size();
+            num_hits += hits.size();
+        }
+        // But not too many.
+        REQUIRE(num_hits <= num_exact + num_exact / 10 + 10);
+    };
+
+    { // Integral.
+        using Tree = AabbTree<ivec2, int>;
+        std::vector<irect2> rects = MakeRandomRects(gen, 1000, 100000);
+        std::vector<int> userdata(rects.size());
+        for (std::size_t i = 0; i < rects.size(); i++)
+            userdata[i] = int(i) + 1000;
+        Tree tree(Tree::Params(ivec2(1)), rects, userdata);
+        Check(tree, MakeRandomRects(gen, 200, 100000));
+
+        REQUIRE(Tree{}.MakeQuantizedSnapshot().IsEmpty());
+        Tree single(Tree::Params{});
+        (void)single.AddNode(ivec2(1).rect_to(ivec2(3)), 1000);
+        Check(single, std::vector{ivec2(0).rect_to(ivec2(1)), ivec2(4).rect_to(ivec2(5))});
+    }
+
+    { // Floating-point, built incrementally, far from the origin.
+        using Tree = AabbTree<fvec2, int>;
+        Tree tree(Tree::Params(fvec2(0.1f)));
+        for (int i = 0; i < 1000; i++)
+        {
+            irect2 rect = MakeRandomRects(gen, 1, 1000).front();
+            (void)tree.AddNode((fvec2(rect.a + 50000) / 3).rect_to(fvec2(rect.b + 50000) / 3), i + 1000);
+        }
+        std::vector<frect2> queries;
+        for (irect2 rect : MakeRandomRects(gen, 200, 1000))
+            queries.push_back((fvec2(rect.a + 50000) / 3).rect_to(fvec2(rect.b + 50000) / 3));
+        Check(tree, queries);
+    }
+
+    { // Fixed-point.
+        using Tree = AabbTree<vec2<fixed16>, int>;
+        Tree tree(Tree::Params(vec2<fixed16>(fixed16(0.1))));
+        for (int i = 0; i < 1000; i++)
+        {
+            irect2 rect = MakeRandomRects(gen, 1, 1000).front();
+            (void)tree.AddNode((rect.a.to<fixed16>() / 3).rect_to(rect.b.to<fixed16>() / 3), i + 1000);
+        }
+        std::vector<rect2<fixed16>> queries;
+        for (irect2 rect : MakeRandomRects(gen, 200, 1000))
+            queries.push_back((rect.a.to<fixed16>() / 3).rect_to(rect.b.to<fixed16>() / 3));
+        Check(tree, queries);
+    }
+}
+
+TEST_CASE("aabb_tree.nearest")
+{
+    std::mt19937 gen(46);
+    std::uniform_real_distribution<float> pos_dist(-20, 280);
+
+    using Tree = AabbTree<ivec2, int>;
+    std::vector<irect2> rects = MakeRandomRects(gen, 300, 256);
+    Tree tree(Tree::Params(ivec2(1)), rects);
+
+    REQUIRE(Tree{}.FindNearestLeaf(fvec2()) == Tree::null_index);
+
+    std::vector<int> result;
+    for (int i = 0; i < 50; i++)
+    {
+        fvec2 point(pos_dist(gen), pos_dist(gen));
+
+        std::vector<std::pair<float, int>> expected;
+        for (int leaf = 0; leaf < int(rects.size()); leaf++)
+            expected.emplace_back(Tree::PointToRectDistSq(point, tree.GetNodeAabb(leaf)), leaf);
+        std::sort(expected.begin(), expected.end());
+
+        for (int count : {1, 5, 20})
+        {
+            tree.FindNearestLeaves(point, count, result);
+            REQUIRE(int(result.size()) == count);
+            // Compare the distances rather than indices, since there can be ties.
+            for (int j = 0; j < count; j++)
+                REQUIRE(Tree::PointToRectDistSq(point, tree.GetNodeAabb(result[j])) == expected[j].first);
+        }
+
+        REQUIRE(Tree::PointToRectDistSq(point, tree.GetNodeAabb(tree.FindNearestLeaf(point))) == expected.front().first);
+
+        // Limited distance.
+        tree.FindNearestLeaves(point, 1000, result, 10);
+        std::size_t expected_count = std::count_if(expected.begin(), expected.end(), [](const auto &e){return e.first < 100;});
+        REQUIRE(result.size() == expected_count);
+    }
+}
+
+TEST_CASE("aabb_tree.optimize")
+{
+    std::mt19937 gen(47);
+
+    using Tree = AabbTree<ivec2, int>;
+    Tree tree(Tree::Params(ivec2(1)));
+    REQUIRE(tree.Optimize() == 0);
+    REQUIRE(tree.SahCost() == 0);
+
+    // Build the tree incrementally, and then shuffle it a lot.
+    std::vector<int> leaves;
+    for (irect2 rect : MakeRandomRects(gen, 1000, 512))
+        leaves.push_back(tree.AddNode(rect, int(leaves.size())));
+    for (int i = 0; i < 5000; i++)
+        tree.ModifyNode(leaves[i % leaves.size()], MakeRandomRects(gen, 1, 512).front(), ivec2());
+
+    double initial_cost = tree.SahCost();
+    REQUIRE(initial_cost > 0);
+
+    for (int i = 0; i < 200; i++)
+        REQUIRE(tree.Optimize(32) <= 32);
+    REQUIRE(tree.SahCost() < initial_cost);
+
+    // The leaves are preserved.
+    for (std::size_t i = 0; i < leaves.size(); i++)
+        REQUIRE(tree.GetNodeUserData(leaves[i]) == int(i));
+    for (irect2 query : MakeRandomRects(gen, 100, 512))
+        REQUIRE(CollectAabbCollisions(tree, query) == CollectAabbCollisionsBruteForce(tree, leaves, query));
+}
+
+TEST_CASE("aabb_tree.save_load")
+{
+    std::mt19937 gen(48);
+
+    using Tree = AabbTree<ivec2, int>;
+    Tree tree(Tree::Params(ivec2(1)));
+
+    std::vector<int> leaves;
+    for (irect2 rect : MakeRandomRects(gen, 500, 256))
+        leaves.push_back(tree.AddNode(rect, int(leaves.size())));
+    // Leave some holes in the node list.
+    for (int i = 0; i < 100; i++)
+    {
+        tree.RemoveNode(leaves.back());
+        leaves.pop_back();
+    }
+
+    std::string blob;
+    Stream::Output output = Stream::Output::Container(blob);
+    tree.Save(output);
+    output.Flush();
+
+    for (bool soa : {false, true})
+    {
+        CAPTURE(soa);
+
+        Tree::Params params(ivec2(1));
+        params.soa_child_bounds = soa;
+        Tree loaded(params);
+        loaded.Load(Stream::ReadOnlyData::mem_reference(blob));
+        loaded.Validate();
+
+        REQUIRE(loaded.DebugToString() == tree.DebugToString());
+        for (std::size_t i = 0; i < leaves.size(); i++)
+            REQUIRE(loaded.GetNodeUserData(leaves[i]) == int(i));
+        for (irect2 query : MakeRandomRects(gen, 50, 256))
+            REQUIRE(CollectAabbCollisions(loaded, query) == CollectAabbCollisionsBruteForce(tree, leaves, query));
+
+        // New nodes get the same indices as in the original tree.
+        Tree copy = tree;
+        REQUIRE(loaded.AddNode(irect2(), -1) == copy.AddNode(irect2(), -1));
+    }
+
+    // Rejects garbage.
+    Tree loaded(Tree::Params(ivec2(1)));
+    std::string garbage = "not a tree, definitely not";
+    REQUIRE_THROWS(loaded.Load(Stream::ReadOnlyData::mem_reference(garbage)));
+    REQUIRE(loaded.IsEmpty());
+
+    // Corrupted data either throws or loads a consistent tree, and never accesses out of bounds.
+    // Half of the iterations corrupt the header and the node order list, the other half corrupt the nodes.
+    std::size_t header_offset = 8;
+    int capacity = 0;
+    std::memcpy(&capacity, blob.data() + header_offset, sizeof capacity);
+    std::size_t nodes_offset = header_offset + 4 * sizeof(int) + std::size_t(capacity) * sizeof(int);
+    REQUIRE((blob.size() - nodes_offset) % std::size_t(capacity) == 0);
+    for (int i = 0; i < 2000; i++)
+    {
+        std::string corrupted = blob;
+        int value = std::array{-2, -1, 0, 1, capacity - 1, capacity, 1 << 30}[gen() % 7];
+        std::size_t begin = i % 2 ? header_offset : nodes_offset;
+        std::size_t end = i % 2 ? nodes_offset : blob.size();
+        std::size_t offset = begin + gen() % ((end - begin) / sizeof(int)) * sizeof(int);
+        std::memcpy(corrupted.data() + offset, &value, sizeof value);
+        CAPTURE(offset);
+        CAPTURE(value);
+
+        try
+        {
+            loaded.Load(Stream::ReadOnlyData::mem_reference(corrupted));
+        }
+        catch (std::exception &)
+        {
+            REQUIRE(loaded.IsEmpty());
+            continue;
+        }
+        REQUIRE_NOTHROW(loaded.Validate());
+    }
+
+    // Truncated data.
+    for (std::size_t size : {std::size_t(12), nodes_offset - 1, nodes_offset, blob.size() - 1})
+    {
+        CAPTURE(size);
+        REQUIRE_THROWS(loaded.Load(Stream::ReadOnlyData::mem_reference(std::string_view(blob).substr(0, size))));
+        REQUIRE(loaded.IsEmpty());
+    }
+}
@@ -0,0 +1,339 @@
+#include "alloc_tracker.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#include <fmt/format.h>
+
+#if defined(__GLIBC__)
+#include <cxxabi.h>
+#include <execinfo.h>
+#endif
+
+// All globals here must be constant-initialized, since `operator new` can be called before the dynamic initialization, or after the destruction.
+
+namespace AllocTracker
+{
+    namespace
+    {
+        struct TagData
+        {
+            std::atomic<const char *> name = nullptr; // Null if this tag isn't used yet.
+            std::atomic<std::int64_t> live_bytes = 0;
+            std::atomic<std::int64_t> live_count = 0;
+            std::atomic<std::uint64_t> total_count = 0;
+            std::atomic<std::uint64_t> cur_frame_count = 0;
+            std::atomic<std::uint64_t> cur_frame_bytes = 0;
+            std::atomic<std::uint64_t> last_frame_count = 0;
+            std::atomic<std::uint64_t> last_frame_bytes = 0;
+        };
+
+        constinit std::array<TagData, max_tags> tags{};
+        constinit std::atomic<int> num_tags = 1; // The `untagged` tag is always there, see `TagName()`.
+        constinit std::mutex tags_mutex; // Only for registering the tags.
+        constinit std::atomic<std::uint64_t> num_frames = 0;
+
+        [[nodiscard]] const char *TagName(int index)
+        {
+            return index == 0 ? "untagged" : tags[std::size_t(index)].name.load(std::memory_order_acquire);
+        }
+
+
+        struct CallSiteData
+        {
+            static constexpr int max_frames = 6;
+
+            std::array<void *, max_frames> frames{};
+            int num_frames = 0; // 0 if this slot is free.
+            int tag = 0;
+            std::uint64_t count = 0;
+            std::uint64_t bytes = 0;
+        };
+
+        // An open addressing hash table, since we can't allocate while recording.
+        constexpr std::size_t max_call_sites = 4096;
+        constinit std::array<CallSiteData, max_call_sites> call_sites{};
+        constinit std::mutex call_sites_mutex;
+        constinit std::atomic<bool> recording_call_sites = false;
+
+        // Doesn't get inlined, to have a predictable number of frames to skip.
+        [[gnu::noinline]] void RecordCallSite(int tag, std::size_t size)
+        {
+            CallSiteData site;
+            #if defined(__GLIBC__)
+            // Skip this function and `operator new`.
+            constexpr int num_skipped = 2;
+            void *buffer[CallSiteData::max_frames + num_skipped];
+            int n = backtrace(buffer, CallSiteData::max_frames + num_skipped) - num_skipped;
+            if (n <= 0)
+                return;
+            std::copy_n(buffer + num_skipped, n, site.frames.begin());
+            site.num_frames = n;
+            #else
+            site.frames[0] = __builtin_return_address(1); // The caller of `operator new`.
+            site.num_frames = 1;
+            #endif
+
+            std::size_t hash = 0;
+            for (int i = 0; i < site.num_frames; i++)
+                hash = (hash ^ std::size_t(site.frames[std::size_t(i)])) * 0x100000001b3;
+
+            std::lock_guard lock(call_sites_mutex);
+            for (std::size_t i = 0; i < max_call_sites; i++)
+            {
+                CallSiteData &slot = call_sites[(hash + i) % max_call_sites];
+                if (slot.num_frames == 0)
+                {
+                    slot = site;
+                    slot.tag = tag;
+                }
+                else if (slot.num_frames != site.num_frames || slot.frames != site.frames)
+                {
+                    continue;
+                }
+                slot.count++;
+                slot.bytes += size;
+                return;
+            }
+            // The table is full, drop this call site.
+        }
+
+        [[nodiscard]] std::string SymbolizeFrame(void *address)
+        {
+            #if defined(__GLIBC__)
+            // Looks like `path(mangled+0x12) [0x...]`. The symbol names are only known with `-rdynamic`, otherwise use `addr2line` on the addresses.
+            char **symbols = backtrace_symbols(&address, 1);
+            if (!symbols)
+                return fmt::format("{}", address);
+            std::string ret = symbols[0];
+            std::free(symbols);
+
+            std::size_t name_begin = ret.find('(');
+            std::size_t name_end = ret.find_first_of("+)", name_begin);
+            if (name_begin != std::string::npos && name_end != std::string::npos && name_end > name_begin + 1)
+            {
+                std::string mangled = ret.substr(name_begin + 1, name_end - name_begin - 1);
+                int status = 0;
+                char *demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+                if (demangled)
+                {
+                    ret.replace(name_begin + 1, name_end - name_begin - 1, demangled);
+                    std::free(demangled);
+                }
+            }
+            return ret;
+            #else
+            return fmt::format("{}", address);
+            #endif
+        }
+    }
+
+    int RegisterTag(const char *name)
+    {
+        if (std::strcmp(name, "untagged") == 0)
+            return 0;
+
+        std::lock_guard lock(tags_mutex);
+        int count = num_tags.load(std::memory_order_relaxed);
+        for (int i = 1; i < count; i++)
+        {
+            if (std::strcmp(tags[std::size_t(i)].name.load(std::memory_order_relaxed), name) == 0)
+                return i;
+        }
+        if (count == max_tags)
+            return 0;
+        tags[std::size_t(count)].name.store(name, std::memory_order_release);
+        num_tags.store(count + 1, std::memory_order_release);
+        return count;
+    }
+
+    Stats GetStats()
+    {
+        Stats ret;
+        ret.total.name = "total";
+        ret.num_frames = num_frames.load(std::memory_order_relaxed);
+
+        int count = num_tags.load(std::memory_order_acquire);
+        ret.tags.reserve(std::size_t(count));
+        for (int i = 0; i < count; i++)
+        {
+            const TagData &data = tags[std::size_t(i)];
+            TagStats &stats = ret.tags.emplace_back();
+            stats.name = TagName(i);
+            stats.live_bytes = data.live_bytes.load(std::memory_order_relaxed);
+            stats.live_count = data.live_count.load(std::memory_order_relaxed);
+            stats.total_count = data.total_count.load(std::memory_order_relaxed);
+            stats.frame_count = data.last_frame_count.load(std::memory_order_relaxed);
+            stats.frame_bytes = data.last_frame_bytes.load(std::memory_order_relaxed);
+
+            ret.total.live_bytes += stats.live_bytes;
+            ret.total.live_count += stats.live_count;
+            ret.total.total_count += stats.total_count;
+            ret.total.frame_count += stats.frame_count;
+            ret.total.frame_bytes += stats.frame_bytes;
+        }
+        return ret;
+    }
+
+    std::uint64_t TotalAllocationCount()
+    {
+        std::uint64_t ret = 0;
+        int count = num_tags.load(std::memory_order_acquire);
+        for (int i = 0; i < count; i++)
+            ret += tags[std::size_t(i)].total_count.load(std::memory_order_relaxed);
+        return ret;
+    }
+
+    void EndFrame()
+    {
+        int count = num_tags.load(std::memory_order_acquire);
+        for (int i = 0; i < count; i++)
+        {
+            TagData &data = tags[std::size_t(i)];
+            data.last_frame_count.store(data.cur_frame_count.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+            data.last_frame_bytes.store(data.cur_frame_bytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        num_frames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void SetRecordCallSites(bool enable)
+    {
+        recording_call_sites.store(enable, std::memory_order_relaxed);
+    }
+
+    bool IsRecordingCallSites()
+    {
+        return recording_call_sites.load(std::memory_order_relaxed);
+    }
+
+    void ResetCallSites()
+    {
+        std::lock_guard lock(call_sites_mutex);
+        call_sites.fill({});
+    }
+
+    std::vector<CallSite> GetTopCallSites(std::size_t max_count)
+    {
+        // Copy the raw data first, to not allocate while holding the lock.
+        std::vector<CallSiteData> raw;
+        raw.reserve(max_call_sites);
+        {
+            std::lock_guard lock(call_sites_mutex);
+            for (const CallSiteData &site : call_sites)
+            {
+                if (site.num_frames > 0)
+                    raw.push_back(site);
+            }
+        }
+
+        max_count = std::min(max_count, raw.size());
+        std::partial_sort(raw.begin(), raw.begin() + std::ptrdiff_t(max_count), raw.end(), [](const CallSiteData &a, const CallSiteData &b){return a.count > b.count;});
+
+        std::vector<CallSite> ret;
+        ret.reserve(max_count);
+        for (std::size_t i = 0; i < max_count; i++)
+        {
+            CallSite &site = ret.emplace_back();
+            site.tag = TagName(raw[i].tag);
+            site.count = raw[i].count;
+            site.bytes = raw[i].bytes;
+            for (int j = 0; j < raw[i].num_frames; j++)
+                site.frames.push_back(SymbolizeFrame(raw[i].frames[std::size_t(j)]));
+        }
+        return ret;
+    }
+
+    #if IMP_ALLOC_TRACKING
+    namespace
+    {
+        // Precedes every allocation.
+        struct alignas(std::max_align_t) Header
+        {
+            std::size_t size = 0;
+            int tag = 0;
+        };
+
+        // The allocation functions are force-inlined into `operator new`, so `RecordCallSite()` knows how many frames to skip.
+        [[nodiscard, gnu::always_inline]] inline void *Allocate(std::size_t size) noexcept
+        {
+            if (size > std::size_t(-1) - sizeof(Header))
+                return nullptr;
+            void *raw = std::malloc(sizeof(Header) + size);
+            if (!raw)
+                return nullptr;
+
+            int tag = impl::current_tag;
+            ::new(raw) Header{.size = size, .tag = tag};
+
+            TagData &data = tags[std::size_t(tag)];
+            data.live_bytes.fetch_add(std::int64_t(size), std::memory_order_relaxed);
+            data.live_count.fetch_add(1, std::memory_order_relaxed);
+            data.total_count.fetch_add(1, std::memory_order_relaxed);
+            data.cur_frame_count.fetch_add(1, std::memory_order_relaxed);
+            data.cur_frame_bytes.fetch_add(size, std::memory_order_relaxed);
+
+            if (recording_call_sites.load(std::memory_order_relaxed))
+                RecordCallSite(tag, size);
+
+            return static_cast<Header *>(raw) + 1;
+        }
+
+        [[nodiscard, gnu::always_inline]] inline void *AllocateOrThrow(std::size_t size)
+        {
+            while (true)
+            {
+                if (void *ret = Allocate(size))
+                    return ret;
+                std::new_handler handler = std::get_new_handler();
+                if (!handler)
+                    throw std::bad_alloc();
+                handler();
+            }
+        }
+
+        [[nodiscard, gnu::always_inline]] inline void *AllocateOrNull(std::size_t size) noexcept
+        {
+            try
+            {
+                return AllocateOrThrow(size);
+            }
+            catch (...)
+            {
+                return nullptr;
+            }
+        }
+
+        void Free(void *ptr) noexcept
+        {
+            if (!ptr)
+                return;
+            Header *header = static_cast<Header *>(ptr) - 1;
+
+            TagData &data = tags[std::size_t(header->tag)];
+            data.live_bytes.fetch_sub(std::int64_t(header->size), std::memory_order_relaxed);
+            data.live_count.fetch_sub(1, std::memory_order_relaxed);
+
+            std::free(header);
+        }
+    }
+    #endif
+}
+
+#if IMP_ALLOC_TRACKING
+// The overaligned versions are left alone. The standard library implements them separately, on top of `aligned_alloc()` or similar.
+void *operator new(std::size_t size) {return AllocTracker::AllocateOrThrow(size);}
+void *operator new[](std::size_t size) {return AllocTracker::AllocateOrThrow(size);}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {return AllocTracker::AllocateOrNull(size);}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {return AllocTracker::AllocateOrNull(size);}
+void operator delete(void *ptr) noexcept {AllocTracker::Free(ptr);}
+void operator delete[](void *ptr) noexcept {AllocTracker::Free(ptr);}
+void operator delete(void *ptr, std::size_t) noexcept {AllocTracker::Free(ptr);}
+void operator delete[](void *ptr, std::size_t) noexcept {AllocTracker::Free(ptr);}
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {AllocTracker::Free(ptr);}
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {AllocTracker::Free(ptr);}
+#endif
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "program/platform.h"
+
+// Counts the heap allocations, grouped by subsystem, to find who allocates what, and what allocates every frame.
+// Usage:
+//     void LoadLevel()
+//     {
+//         IMP_ALLOC_SCOPE("level"); // The allocations on this thread are attributed to this tag, until the end of the scope.
+//         ...
+//     }
+//
+//     // Once per frame:
+//     AllocTracker::EndFrame();
+//     GameUtils::AllocTrackerOverlay(); // Or look at `AllocTracker::GetStats()` manually.
+//
+//     AllocTracker::SetRecordCallSites(true); // Slow. Also remembers the call stacks of the allocations, see `GetTopCallSites()`.
+//
+// The scopes nest, the innermost one wins. The allocations outside of any scope go to the `untagged` tag.
+// The tag names must be string literals (or have static storage duration in general). The same name in different places refers to the same tag.
+// Freeing the memory subtracts it from the tag that allocated it, regardless of the current scope.
+// Only the plain `operator new` is tracked, not the overaligned one, and not `malloc()`. Every allocation gets a 16-byte header.
+//
+// Enabled by `IMP_ALLOC_TRACKING`, which defaults to 1 except in release builds (with `IMP_PLATFORM_FLAG_prod`)
+//   and with the address sanitizer (which has its own `operator new`).
+// When it's 0, `operator new` isn't replaced, `IMP_ALLOC_SCOPE` expands to nothing, and the stats are always empty.
+
+#ifndef IMP_ALLOC_TRACKING
+#  if IMP_PLATFORM_IS(prod) || defined(__SANITIZE_ADDRESS__)
+#    define IMP_ALLOC_TRACKING 0
+#  elif defined(__has_feature)
+#    if __has_feature(address_sanitizer)
+#      define IMP_ALLOC_TRACKING 0
+#    else
+#      define IMP_ALLOC_TRACKING 1
+#    endif
+#  else
+#    define IMP_ALLOC_TRACKING 1
+#  endif
+#endif
+
+namespace AllocTracker
+{
+    inline constexpr bool enabled = IMP_ALLOC_TRACKING;
+
+    // The max number of distinct tags, including `untagged`. The scopes with the tags past this limit count as `untagged`.
+    inline constexpr int max_tags = 64;
+
+    namespace impl
+    {
+        // The tag of the innermost scope on this thread.
+        inline thread_local int current_tag = 0;
+    }
+
+    // Returns the index of the tag with this name, adding it if it doesn't exist yet. `IMP_ALLOC_SCOPE` calls this once per scope.
+    [[nodiscard]] int RegisterTag(const char *name);
+
+    // Attributes the allocations on this thread to a tag, until it's destroyed.
+    class Scope
+    {
+        int prev_tag = 0;
+
+      public:
+        explicit Scope(int tag) : prev_tag(std::exchange(impl::current_tag, tag)) {}
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope()
+        {
+            impl::current_tag = prev_tag;
+        }
+    };
+
+    struct TagStats
+    {
+        const char *name = nullptr;
+        std::int64_t live_bytes = 0; // Allocated with this tag and not freed yet.
+        std::int64_t live_count = 0;
+        std::uint64_t total_count = 0; // Since the start of the program.
+        std::uint64_t frame_count = 0; // In the last complete frame, see `EndFrame()`.
+        std::uint64_t frame_bytes = 0;
+    };
+
+    struct Stats
+    {
+        TagStats total; // The sum of all tags.
+        std::vector<TagStats> tags; // The first one is `untagged`, then the others in the order of registration.
+        std::uint64_t num_frames = 0; // The number of `EndFrame()` calls.
+    };
+
+    // Returns the current numbers. They are updated with relaxed atomics, so can be slightly inconsistent while other threads allocate.
+    [[nodiscard]] Stats GetStats();
+    // The number of allocations since the start of the program, same as `GetStats().total.total_count`, but doesn't allocate.
+    [[nodiscard]] std::uint64_t TotalAllocationCount();
+
+    // Finishes a frame: moves the per-frame counters to `TagStats::frame_{count,bytes}` and resets them. Call this once per frame.
+    void EndFrame();
+
+    struct CallSite
+    {
+        std::vector<std::string> frames; // The call stack, the innermost frame first. Symbolized if possible, otherwise the addresses.
+        const char *tag = nullptr; // The tag of the first allocation from here.
+        std::uint64_t count = 0;
+        std::uint64_t bytes = 0;
+    };
+
+    // Starts or stops remembering the call stacks of the allocations. This is slow, so only enable it while looking for something.
+    // The call stacks are only available with glibc. Elsewhere only the immediate callers of `operator new` are recorded.
+    void SetRecordCallSites(bool enable);
+    [[nodiscard]] bool IsRecordingCallSites();
+    // Forgets the recorded call sites.
+    void ResetCallSites();
+    // Returns up to `max_count` call sites with the most allocations, since the last `ResetCallSites()`.
+    // If there are too many distinct call sites, the ones past the limit are not recorded.
+    [[nodiscard]] std::vector<CallSite> GetTopCallSites(std::size_t max_count);
+}
+
+#define IMP_ALLOC_TRACKER_impl_cat(a, b) IMP_ALLOC_TRACKER_impl_cat_(a, b)
+#define IMP_ALLOC_TRACKER_impl_cat_(a, b) a##b
+
+#if IMP_ALLOC_TRACKING
+#  define IMP_ALLOC_SCOPE(name) ::AllocTracker::Scope IMP_ALLOC_TRACKER_impl_cat(_alloc_scope_, __LINE__)([]{static const int tag = ::AllocTracker::RegisterTag(name); return tag;}())
+#else
+#  define IMP_ALLOC_SCOPE(name) void()
+#endif
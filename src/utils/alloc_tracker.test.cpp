@@ -0,0 +1,87 @@
+#include "alloc_tracker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    [[nodiscard]] AllocTracker::TagStats FindTag(const AllocTracker::Stats &stats, const char *name)
+    {
+        auto it = std::find_if(stats.tags.begin(), stats.tags.end(), [&](const AllocTracker::TagStats &tag){return std::strcmp(tag.name, name) == 0;});
+        REQUIRE(it != stats.tags.end());
+        return *it;
+    }
+
+    // Stops the compiler from optimizing away a `new`-`delete` pair.
+    void Escape(void *ptr)
+    {
+        asm volatile("" : : "r"(ptr) : "memory");
+    }
+}
+
+TEST_CASE("alloc_tracker")
+{
+    if constexpr (!AllocTracker::enabled)
+        return;
+
+    CHECK(AllocTracker::RegisterTag("untagged") == 0);
+    CHECK(AllocTracker::RegisterTag("test.a") == AllocTracker::RegisterTag("test.a"));
+    CHECK(AllocTracker::RegisterTag("test.a") != AllocTracker::RegisterTag("test.b"));
+
+    AllocTracker::EndFrame();
+    AllocTracker::TagStats before_a = FindTag(AllocTracker::GetStats(), "test.a");
+    AllocTracker::TagStats before_b = FindTag(AllocTracker::GetStats(), "test.b");
+
+    std::unique_ptr<char[]> kept;
+    {
+        IMP_ALLOC_SCOPE("test.a");
+        kept = std::make_unique<char[]>(100);
+        {
+            IMP_ALLOC_SCOPE("test.b"); // The innermost scope wins.
+            std::vector<char> temp(50);
+            Escape(temp.data());
+        }
+        Escape(std::make_unique<char[]>(10).get());
+    }
+    AllocTracker::EndFrame();
+
+    AllocTracker::TagStats a = FindTag(AllocTracker::GetStats(), "test.a");
+    AllocTracker::TagStats b = FindTag(AllocTracker::GetStats(), "test.b");
+    CHECK(a.live_bytes - before_a.live_bytes == 100);
+    CHECK(a.live_count - before_a.live_count == 1);
+    CHECK(a.total_count - before_a.total_count == 2);
+    CHECK(a.frame_count == 2);
+    CHECK(a.frame_bytes == 110);
+    CHECK(b.live_bytes == before_b.live_bytes);
+    CHECK(b.frame_count == 1);
+    CHECK(b.frame_bytes == 50);
+
+    // Freeing outside of the scope is still attributed to the tag.
+    kept = nullptr;
+    AllocTracker::EndFrame();
+    a = FindTag(AllocTracker::GetStats(), "test.a");
+    CHECK(a.live_bytes == before_a.live_bytes);
+    CHECK(a.frame_count == 0);
+
+    // Call sites.
+    AllocTracker::ResetCallSites();
+    AllocTracker::SetRecordCallSites(true);
+    {
+        IMP_ALLOC_SCOPE("test.a");
+        for (int i = 0; i < 20; i++)
+            Escape(std::make_unique<int>(i).get());
+    }
+    AllocTracker::SetRecordCallSites(false);
+    std::vector<AllocTracker::CallSite> sites = AllocTracker::GetTopCallSites(1);
+    REQUIRE(sites.size() == 1);
+    CHECK(std::strcmp(sites[0].tag, "test.a") == 0);
+    CHECK(sites[0].count == 20);
+    CHECK(sites[0].bytes == 20 * sizeof(int));
+    CHECK(!sites[0].frames.empty());
+    AllocTracker::ResetCallSites();
+    CHECK(AllocTracker::GetTopCallSites(10).empty());
+}
@@ -1,9 +1,14 @@
 #include "archive.h"
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
 #include <type_traits>
 
 #include <zlib.h>
 
+#include "program/errors.h"
+#include "utils/jobs.h"
 #include "utils/robust_math.h"
 
 namespace Archive
@@ -15,10 +20,10 @@ namespace Archive
             return compressBound(src_end - src_begin);
         }
 
-        uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end)
+        uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end, int level)
         {
-            uLong dst_size = dst_end - dst_begin; // compress() changes this value.
-            int status = compress(dst_begin, &dst_size, src_begin, src_end - src_begin);
+            uLong dst_size = dst_end - dst_begin; // compress2() changes this value.
+            int status = compress2(dst_begin, &dst_size, src_begin, src_end - src_begin, level);
             if (status != Z_OK)
                 throw std::runtime_error("Compression failure.");
             return dst_begin + dst_size;
@@ -31,20 +36,54 @@ namespace Archive
             if (status != Z_OK || dst_size != uLong(dst_end - dst_begin))
                 throw std::runtime_error("Uncompression failure.");
         }
+
+        void UncompressZlibOrGzip(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end)
+        {
+            if (std::size_t(src_end - src_begin) > std::numeric_limits<uInt>::max() || std::size_t(dst_end - dst_begin) > std::numeric_limits<uInt>::max())
+                throw std::runtime_error("Uncompression failure: the data is too large.");
+
+            z_stream stream{};
+            stream.next_in = const_cast<uint8_t *>(src_begin); // Old zlib versions don't have `const` here.
+            stream.avail_in = uInt(src_end - src_begin);
+            stream.next_out = dst_begin;
+            stream.avail_out = uInt(dst_end - dst_begin);
+
+            if (inflateInit2(&stream, 32 + MAX_WBITS) != Z_OK) // `+ 32` enables the header detection.
+                throw std::runtime_error("Uncompression failure.");
+            int status = inflate(&stream, Z_FINISH);
+            inflateEnd(&stream);
+
+            if (status != Z_STREAM_END || stream.next_out != dst_end)
+                throw std::runtime_error("Uncompression failure.");
+        }
     }
 
 
     using size_type = uint64_t;
     static_assert(std::is_unsigned_v<size_type> && sizeof(size_type) >= sizeof(std::size_t), "`size_type` must be an unsigned type not smaller than `std::size_t`.");
 
-    [[nodiscard]] std::size_t MaxCompressedSize(const uint8_t *src_begin, const uint8_t *src_end)
+    // The size is followed by this many bytes of the codec id.
+    static constexpr std::size_t codec_id_size = 1;
+    // This is the first byte of a zlib stream that `compress()` produces. If it's where the codec id should be, the data predates the codec ids.
+    static constexpr uint8_t legacy_zlib_header_byte = 0x78;
+
+    [[nodiscard]] std::size_t MaxCompressedSize(const uint8_t *src_begin, const uint8_t *src_end, Codec codec)
     {
-        return sizeof(size_type) + Raw::MaxCompressedSize(src_begin, src_end);
+        std::size_t header_size = sizeof(size_type) + codec_id_size;
+        switch (codec)
+        {
+          case Codec::zlib:
+          case Codec::zlib_fast:
+            return header_size + Raw::MaxCompressedSize(src_begin, src_end);
+          case Codec::stored:
+            return header_size + (src_end - src_begin);
+        }
+        throw std::runtime_error("Compression failure: Unknown codec.");
     }
 
-    [[nodiscard]] uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end)
+    [[nodiscard]] uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end, Codec codec)
     {
-        if (dst_end - dst_begin < std::ptrdiff_t(sizeof(size_type)))
+        if (dst_end - dst_begin < std::ptrdiff_t(sizeof(size_type) + codec_id_size))
             throw std::runtime_error("Compression failure.");
 
         std::size_t size = src_end - src_begin;
@@ -54,8 +93,21 @@ namespace Archive
 
         for (std::size_t i = 0; i < sizeof(size_type); i++)
             dst_begin[i] = (size >> (i * 8)) & 0xff;
+        dst_begin[sizeof(size_type)] = uint8_t(codec);
+        dst_begin += sizeof(size_type) + codec_id_size;
 
-        return Raw::Compress(src_begin, src_end, dst_begin + sizeof(size_type), dst_end);
+        switch (codec)
+        {
+          case Codec::zlib:
+            return Raw::Compress(src_begin, src_end, dst_begin, dst_end);
+          case Codec::zlib_fast:
+            return Raw::Compress(src_begin, src_end, dst_begin, dst_end, Z_BEST_SPEED);
+          case Codec::stored:
+            if (dst_end - dst_begin < src_end - src_begin)
+                throw std::runtime_error("Compression failure.");
+            return std::copy(src_begin, src_end, dst_begin);
+        }
+        throw std::runtime_error("Compression failure: Unknown codec.");
     }
 
     [[nodiscard]] std::size_t UncompressedSize(const uint8_t *src_begin, const uint8_t *src_end)
@@ -74,9 +126,174 @@ namespace Archive
         return ret;
     }
 
+    [[nodiscard]] Codec GetCodec(const uint8_t *src_begin, const uint8_t *src_end)
+    {
+        if (src_end - src_begin < std::ptrdiff_t(sizeof(size_type) + codec_id_size))
+            throw std::runtime_error("Uncompression failure.");
+
+        uint8_t id = src_begin[sizeof(size_type)];
+        if (id == legacy_zlib_header_byte)
+            return Codec::zlib;
+        if (id > uint8_t(Codec::stored))
+            throw std::runtime_error("Uncompression failure: Unknown codec.");
+        return Codec(id);
+    }
+
     void Uncompress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin)
     {
         std::size_t size = UncompressedSize(src_begin, src_end);
-        Raw::Uncompress(src_begin + sizeof(size_type), src_end, dst_begin, dst_begin + size);
+        Codec codec = GetCodec(src_begin, src_end);
+        bool legacy = src_begin[sizeof(size_type)] == legacy_zlib_header_byte;
+        src_begin += sizeof(size_type) + (legacy ? 0 : codec_id_size);
+
+        switch (codec)
+        {
+          case Codec::zlib:
+          case Codec::zlib_fast:
+            Raw::Uncompress(src_begin, src_end, dst_begin, dst_begin + size);
+            return;
+          case Codec::stored:
+            if (std::size_t(src_end - src_begin) != size)
+                throw std::runtime_error("Uncompression failure.");
+            std::copy(src_begin, src_end, dst_begin);
+            return;
+        }
+    }
+
+
+    namespace Chunked
+    {
+        // Calls `func(i)` for each `i` in `[0, count)`, in at most `num_threads` jobs on `Jobs::GlobalPool()`.
+        // If anything throws, waits for all jobs to finish, then rethrows the first exception.
+        static void ParallelFor(std::size_t count, int num_threads, auto &&func)
+        {
+            Jobs::ThreadPool &pool = Jobs::GlobalPool();
+            if (num_threads <= 0)
+                num_threads = pool.Concurrency();
+            num_threads = int(std::clamp(count, std::size_t(1), std::size_t(num_threads)));
+
+            // The chunks can take different time to process, so the jobs grab them one by one.
+            std::atomic<std::size_t> next_index = 0;
+            Jobs::ParallelFor(pool, 0, std::size_t(num_threads), [&](std::size_t)
+            {
+                try
+                {
+                    std::size_t i;
+                    while ((i = next_index++) < count)
+                        func(i);
+                }
+                catch (...)
+                {
+                    next_index = count; // Stop the other jobs early.
+                    throw;
+                }
+            });
+        }
+
+        static void WriteSize(uint8_t *dst, size_type value)
+        {
+            for (std::size_t i = 0; i < sizeof(size_type); i++)
+                dst[i] = (value >> (i * 8)) & 0xff;
+        }
+
+        [[nodiscard]] static std::size_t ReadSize(const uint8_t *&src_begin, const uint8_t *src_end)
+        {
+            if (src_end - src_begin < std::ptrdiff_t(sizeof(size_type)))
+                throw std::runtime_error("Uncompression failure.");
+
+            size_type value = 0;
+            for (std::size_t i = 0; i < sizeof(size_type); i++)
+                value |= (size_type(src_begin[i]) << (i * 8));
+            src_begin += sizeof(size_type);
+
+            std::size_t ret;
+            if (Robust::conversion_fails(value, ret))
+                throw std::runtime_error("Unable to uncompress: The object is too large.");
+            return ret;
+        }
+
+        std::vector<uint8_t> Compress(const uint8_t *src_begin, const uint8_t *src_end, std::size_t chunk_size, int num_threads)
+        {
+            ASSERT(chunk_size > 0, "The chunk size can't be zero.");
+
+            std::size_t size = src_end - src_begin;
+            std::size_t num_chunks = (size + chunk_size - 1) / chunk_size;
+
+            std::vector<std::vector<uint8_t>> chunks(num_chunks);
+            ParallelFor(num_chunks, num_threads, [&](std::size_t i)
+            {
+                const uint8_t *chunk_begin = src_begin + i * chunk_size;
+                const uint8_t *chunk_end = chunk_begin + std::min(chunk_size, size - i * chunk_size);
+                chunks[i].resize(Raw::MaxCompressedSize(chunk_begin, chunk_end));
+                uint8_t *compressed_end = Raw::Compress(chunk_begin, chunk_end, chunks[i].data(), chunks[i].data() + chunks[i].size());
+                chunks[i].resize(std::size_t(compressed_end - chunks[i].data()));
+            });
+
+            std::size_t header_size = sizeof(size_type) * (2 + num_chunks);
+            std::size_t total_size = header_size;
+            for (const auto &chunk : chunks)
+                total_size += chunk.size();
+
+            std::vector<uint8_t> ret(total_size);
+            WriteSize(ret.data(), size);
+            WriteSize(ret.data() + sizeof(size_type), chunk_size);
+            uint8_t *pos = ret.data() + header_size;
+            for (std::size_t i = 0; i < num_chunks; i++)
+            {
+                WriteSize(ret.data() + sizeof(size_type) * (2 + i), chunks[i].size());
+                pos = std::copy(chunks[i].begin(), chunks[i].end(), pos);
+            }
+            return ret;
+        }
+
+        std::size_t UncompressedSize(const uint8_t *src_begin, const uint8_t *src_end)
+        {
+            return ReadSize(src_begin, src_end);
+        }
+
+        void Uncompress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, int num_threads)
+        {
+            Index index(src_begin, src_end);
+            ParallelFor(index.NumChunks(), num_threads, [&](std::size_t i)
+            {
+                index.UncompressChunk(i, dst_begin + i * index.ChunkSize());
+            });
+        }
+
+        Index::Index(const uint8_t *src_begin, const uint8_t *src_end)
+        {
+            uncompressed_size = ReadSize(src_begin, src_end);
+            chunk_size = ReadSize(src_begin, src_end);
+            if (chunk_size == 0 && uncompressed_size > 0)
+                throw std::runtime_error("Uncompression failure.");
+
+            std::size_t num_chunks = uncompressed_size == 0 ? 0 : (uncompressed_size - 1) / chunk_size + 1;
+            if (std::size_t(src_end - src_begin) / sizeof(size_type) < num_chunks)
+                throw std::runtime_error("Uncompression failure.");
+
+            chunk_offsets.resize(num_chunks + 1);
+            for (std::size_t i = 0; i < num_chunks; i++)
+            {
+                std::size_t chunk_compressed_size = ReadSize(src_begin, src_end);
+                if (Robust::addition_fails(chunk_offsets[i], chunk_compressed_size, chunk_offsets[i + 1]))
+                    throw std::runtime_error("Uncompression failure.");
+            }
+
+            data_begin = src_begin;
+            if (chunk_offsets.back() != std::size_t(src_end - src_begin))
+                throw std::runtime_error("Uncompression failure.");
+        }
+
+        std::size_t Index::ChunkUncompressedSize(std::size_t index) const
+        {
+            ASSERT(index < NumChunks(), "Chunk index is out of range.");
+            return std::min(chunk_size, uncompressed_size - index * chunk_size);
+        }
+
+        void Index::UncompressChunk(std::size_t index, uint8_t *dst_begin) const
+        {
+            ASSERT(index < NumChunks(), "Chunk index is out of range.");
+            Raw::Uncompress(data_begin + chunk_offsets[index], data_begin + chunk_offsets[index + 1], dst_begin, dst_begin + ChunkUncompressedSize(index));
+        }
     }
 }
@@ -2,20 +2,69 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <vector>
 
 namespace Archive
 {
     namespace Raw // Those are thin wrappers around zlib.
     {
         [[nodiscard]] std::size_t MaxCompressedSize(const uint8_t *src_begin, const uint8_t *src_end); // Determines max destination buffer size.
-        [[nodiscard]] uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end); // Compresses and returns compressed data end. Throws on failure.
+        [[nodiscard]] uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end, int level = -1); // Compresses and returns compressed data end. Throws on failure. `level` is from 0 to 9, or -1 for the default.
         void Uncompress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end); // Decompresses. Throws on failure. Also throws if buffer is too large.
+        void UncompressZlibOrGzip(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end); // Same, but also accepts the gzip format, detecting it automatically. For third-party data.
     }
 
-    // Those functions prefix compressed data with size.
+    // How the data is compressed. The id is stored in the header, so `Uncompress()` picks the codec automatically.
+    // Only zlib is available for now, so the faster codecs are zlib with a lower compression level, and no compression.
+    enum class Codec : uint8_t
+    {
+        zlib = 0, // The default balanced codec.
+        zlib_fast = 1, // Faster compression, worse ratio.
+        stored = 2, // No compression, the fastest to decompress. For data that's already compressed, or when the load speed matters most.
+    };
+
+    // Those functions prefix compressed data with size and the codec id.
+    // For compatibility, the data written before the codec ids were added (with no id) is still accepted, as zlib.
 
-    [[nodiscard]] std::size_t MaxCompressedSize(const uint8_t *src_begin, const uint8_t *src_end); // Determines max destination buffer size.
-    [[nodiscard]] uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end); // Compresses and returns compressed data end. Throws on failure.
+    [[nodiscard]] std::size_t MaxCompressedSize(const uint8_t *src_begin, const uint8_t *src_end, Codec codec = Codec::zlib); // Determines max destination buffer size.
+    [[nodiscard]] uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end, Codec codec = Codec::zlib); // Compresses and returns compressed data end. Throws on failure.
     [[nodiscard]] std::size_t UncompressedSize(const uint8_t *src_begin, const uint8_t *src_end); // Extracts size from decompressed data. Throws on failure.
+    [[nodiscard]] Codec GetCodec(const uint8_t *src_begin, const uint8_t *src_end); // Extracts the codec from compressed data. Throws on failure.
     void Uncompress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin); // Decompresses. Throws on failure. The buffer must have size returned by `UncompressedSize()`.
+
+    // A format that splits the data into independent fixed-size chunks, compressed in parallel, with an index that allows decompressing individual chunks.
+    // The format: the uncompressed size, the chunk size, then the compressed size of each chunk (all of those are little-endian `uint64_t`), then the chunks themselves.
+    // The chunks are processed on `Jobs::GlobalPool()`. `num_threads` is the max number of jobs running at once. If it's zero, uses the concurrency of the pool.
+    namespace Chunked
+    {
+        inline constexpr std::size_t default_chunk_size = 1 << 20;
+
+        [[nodiscard]] std::vector<uint8_t> Compress(const uint8_t *src_begin, const uint8_t *src_end, std::size_t chunk_size = default_chunk_size, int num_threads = 0); // Compresses. Throws on failure.
+        [[nodiscard]] std::size_t UncompressedSize(const uint8_t *src_begin, const uint8_t *src_end); // Extracts size from compressed data. Throws on failure.
+        void Uncompress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, int num_threads = 0); // Decompresses. Throws on failure. The buffer must have size returned by `UncompressedSize()`.
+
+        // Parses the index, for random access to the chunks. Doesn't copy the data, so it must remain alive.
+        class Index
+        {
+            const uint8_t *data_begin = nullptr;
+            std::size_t uncompressed_size = 0;
+            std::size_t chunk_size = 0;
+            std::vector<std::size_t> chunk_offsets; // Relative to `data_begin`. Has one more element than there are chunks.
+
+          public:
+            Index() {}
+            Index(const uint8_t *src_begin, const uint8_t *src_end); // Throws if the index is malformed.
+
+            [[nodiscard]] std::size_t UncompressedSize() const {return uncompressed_size;}
+            [[nodiscard]] std::size_t ChunkSize() const {return chunk_size;}
+            [[nodiscard]] std::size_t NumChunks() const {return chunk_offsets.empty() ? 0 : chunk_offsets.size() - 1;}
+
+            // The chunk of uncompressed data that contains this offset.
+            [[nodiscard]] std::size_t ChunkAt(std::size_t offset) const {return offset / chunk_size;}
+            // All chunks have the same uncompressed size, except possibly for the last one.
+            [[nodiscard]] std::size_t ChunkUncompressedSize(std::size_t index) const;
+            // Decompresses a single chunk. Throws on failure. The buffer must have size returned by `ChunkUncompressedSize()`.
+            void UncompressChunk(std::size_t index, uint8_t *dst_begin) const;
+        };
+    }
 }
@@ -0,0 +1,226 @@
+#include "archive_streams.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+#include "meta/common.h"
+#include "strings/format.h"
+#include "utils/robust_math.h"
+
+namespace Archive
+{
+    // The size of the intermediate buffers for the compressed data.
+    static constexpr std::size_t chunk_size = 1 << 14;
+
+    struct CompressingOutput::State
+    {
+        z_stream zstream{};
+        Stream::Output *target = nullptr;
+        std::uint64_t uncompressed_size = 0;
+        bool finished = false;
+        std::vector<std::uint8_t> buffer;
+        Stream::Output output; // Must be the last member, to be destroyed before `zstream`.
+
+        State() {}
+        State(const State &) = delete;
+        State &operator=(const State &) = delete;
+
+        ~State()
+        {
+            output = {};
+            deflateEnd(&zstream);
+        }
+
+        // Feeds the bytes to zlib, and writes whatever it returns to the target stream.
+        void Deflate(const std::uint8_t *data, std::size_t size, int flush)
+        {
+            while (true)
+            {
+                uInt part_size = uInt(std::min(size, std::size_t(std::numeric_limits<uInt>::max())));
+                zstream.next_in = const_cast<std::uint8_t *>(data);
+                zstream.avail_in = part_size;
+                int part_flush = part_size == size ? flush : Z_NO_FLUSH;
+
+                int status = Z_OK;
+                do
+                {
+                    zstream.next_out = buffer.data();
+                    zstream.avail_out = uInt(buffer.size());
+                    status = deflate(&zstream, part_flush);
+                    if (status == Z_STREAM_ERROR)
+                        throw std::runtime_error(output.GetExceptionPrefix() + "Compression failure.");
+                    target->WriteBytes(buffer.data(), buffer.size() - zstream.avail_out);
+                }
+                while (zstream.avail_out == 0 || (part_flush == Z_FINISH && status != Z_STREAM_END));
+
+                data += part_size;
+                size -= part_size;
+                if (size == 0)
+                    break;
+            }
+        }
+    };
+
+    CompressingOutput::CompressingOutput() {}
+
+    CompressingOutput::CompressingOutput(Stream::Output &target, int level, Stream::capacity_t capacity)
+        : state(std::make_unique<State>())
+    {
+        if (deflateInit(&state->zstream, level) != Z_OK)
+            throw std::runtime_error(target.GetExceptionPrefix() + "Unable to initialize the compressor.");
+        state->target = &target;
+        state->buffer.resize(chunk_size);
+        state->output = Stream::Output(FMT("Compressor for `{}`", target.GetTarget()),
+            [state = state.get()](Stream::Output &object, const std::uint8_t *data, std::size_t size)
+            {
+                if (state->finished)
+                    throw std::runtime_error(object.GetExceptionPrefix() + "Attempt to write to a compressor after finishing it.");
+                state->Deflate(data, size, Z_NO_FLUSH);
+                state->uncompressed_size += size;
+            },
+            capacity);
+    }
+
+    CompressingOutput::CompressingOutput(CompressingOutput &&other) noexcept = default;
+    CompressingOutput &CompressingOutput::operator=(CompressingOutput other) noexcept
+    {
+        std::swap(state, other.state);
+        return *this;
+    }
+    CompressingOutput::~CompressingOutput() = default;
+
+    CompressingOutput::operator bool() const
+    {
+        return bool(state);
+    }
+
+    Stream::Output &CompressingOutput::Get()
+    {
+        ASSERT(state, "This compressor is null.");
+        return state->output;
+    }
+
+    void CompressingOutput::Finish()
+    {
+        ASSERT(state, "This compressor is null.");
+        if (state->finished)
+            throw std::runtime_error(state->output.GetExceptionPrefix() + "The compressor is already finished.");
+
+        state->output.Flush();
+        state->Deflate(nullptr, 0, Z_FINISH);
+        state->finished = true;
+        state->target->WriteLittle<std::uint64_t>(state->uncompressed_size);
+    }
+
+
+    namespace
+    {
+        struct DecompressionState
+        {
+            z_stream zstream{};
+            bool zstream_initialized = false;
+            Stream::Input source;
+            std::size_t compressed_begin = 0, compressed_end = 0;
+            std::size_t position = 0; // The uncompressed position.
+            std::vector<std::uint8_t> buffer;
+            std::vector<std::uint8_t> skip_buffer; // Lazily allocated.
+
+            DecompressionState() {}
+            DecompressionState(const DecompressionState &) = delete;
+            DecompressionState &operator=(const DecompressionState &) = delete;
+
+            ~DecompressionState()
+            {
+                if (zstream_initialized)
+                    inflateEnd(&zstream);
+            }
+
+            void Restart(Stream::Input &stream)
+            {
+                if (inflateReset(&zstream) != Z_OK)
+                    throw std::runtime_error(stream.GetExceptionPrefix() + "Unable to restart the decompression.");
+                zstream.avail_in = 0;
+                source.Seek(compressed_begin, Stream::absolute);
+                position = 0;
+            }
+
+            void Inflate(Stream::Input &stream, std::uint8_t *dst, std::size_t size)
+            {
+                while (size > 0)
+                {
+                    if (zstream.avail_in == 0)
+                    {
+                        std::size_t part_size = std::min(buffer.size(), compressed_end - source.Position());
+                        if (part_size == 0)
+                            throw std::runtime_error(stream.GetExceptionPrefix() + "Unexpected end of the compressed data.");
+                        source.Read(buffer.data(), part_size);
+                        zstream.next_in = buffer.data();
+                        zstream.avail_in = uInt(part_size);
+                    }
+
+                    uInt part_size = uInt(std::min(size, std::size_t(std::numeric_limits<uInt>::max())));
+                    zstream.next_out = dst;
+                    zstream.avail_out = part_size;
+                    int status = inflate(&zstream, Z_NO_FLUSH);
+                    std::size_t produced = part_size - zstream.avail_out;
+                    dst += produced;
+                    size -= produced;
+                    position += produced;
+
+                    if (status == Z_STREAM_END && size > 0)
+                        throw std::runtime_error(stream.GetExceptionPrefix() + "The compressed data is shorter than expected.");
+                    if (status != Z_OK && status != Z_STREAM_END)
+                        throw std::runtime_error(stream.GetExceptionPrefix() + "Decompression failure.");
+                }
+            }
+
+            void Read(Stream::Input &stream, std::size_t offset, std::size_t size, std::uint8_t *dst)
+            {
+                if (offset < position)
+                    Restart(stream);
+
+                // Decompress and discard everything before the requested offset.
+                if (offset > position && skip_buffer.empty())
+                    skip_buffer.resize(chunk_size);
+                while (offset > position)
+                    Inflate(stream, skip_buffer.data(), std::min(offset - position, skip_buffer.size()));
+
+                Inflate(stream, dst, size);
+            }
+        };
+    }
+
+    Stream::Input DecompressingInput(Stream::Input source, Stream::capacity_t capacity)
+    {
+        auto state = std::make_unique<DecompressionState>();
+
+        state->compressed_begin = source.Position();
+        if (source.RemainingBytes() < sizeof(std::uint64_t))
+            throw std::runtime_error(source.GetExceptionPrefix() + "The compressed data is too short.");
+        state->compressed_end = source.Size() - sizeof(std::uint64_t);
+
+        source.Seek(state->compressed_end, Stream::absolute);
+        std::size_t size = 0;
+        if (Robust::conversion_fails(source.ReadLittle<std::uint64_t>(), size))
+            throw std::runtime_error(source.GetExceptionPrefix() + "Unable to decompress: The object is too large.");
+        source.Seek(state->compressed_begin, Stream::absolute);
+
+        if (inflateInit(&state->zstream) != Z_OK)
+            throw std::runtime_error(source.GetExceptionPrefix() + "Unable to initialize the decompressor.");
+        state->zstream_initialized = true;
+        state->buffer.resize(chunk_size);
+
+        std::string name = FMT("Decompressed `{}`", source.GetTarget());
+        state->source = std::move(source);
+
+        return Stream::Input(std::move(name), size, Meta::fake_copyable([state = std::move(state)](Stream::Input &stream, std::size_t offset, std::size_t size, std::uint8_t *dst)
+        {
+            state->Read(stream, offset, size, dst);
+        }), capacity);
+    }
+}
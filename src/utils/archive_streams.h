@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "stream/input.h"
+#include "stream/output.h"
+
+// Streaming compression with bounded memory usage, for data that doesn't fit in memory comfortably.
+// This uses zlib, like `archive.h`, but the format is different: a zlib stream,
+// followed by the uncompressed size as a little-endian `uint64_t` (so the reader knows the size in advance).
+// Usage:
+//   Stream::Output file("save.bin");
+//   Archive::CompressingOutput compressor(file);
+//   compressor.Get().WriteString("...");
+//   compressor.Finish();
+//   file.Flush();
+//
+//   Stream::Input input = Archive::DecompressingInput(Stream::Input("save.bin"));
+
+namespace Archive
+{
+    // Compresses everything written to `Get()`, incrementally, into another stream.
+    class CompressingOutput
+    {
+        struct State;
+        std::unique_ptr<State> state;
+
+      public:
+        // Constructs a null object.
+        CompressingOutput();
+        // `target` must outlive this object. `level` is the zlib compression level, from 0 to 9, or -1 for the default.
+        // `capacity` is the buffer size of `Get()`, the compressed data is written to `target` in chunks of a fixed size.
+        explicit CompressingOutput(Stream::Output &target, int level = -1, Stream::capacity_t capacity = Stream::Output::default_capacity);
+
+        CompressingOutput(CompressingOutput &&other) noexcept;
+        CompressingOutput &operator=(CompressingOutput other) noexcept;
+        ~CompressingOutput();
+
+        [[nodiscard]] explicit operator bool() const;
+
+        // The stream to write the uncompressed data to. Flushing it doesn't flush the compressor, use `Finish()` for that.
+        [[nodiscard]] Stream::Output &Get();
+
+        // Compresses the remaining data and writes the trailer to the target stream. Doesn't flush the target stream.
+        // Must be called exactly once, after writing everything. Throws on failure.
+        void Finish();
+    };
+
+    // Returns a stream that decompresses the data written by `CompressingOutput`, from the current position of `source` to its end.
+    // Seeking backwards restarts the decompression from the beginning, so prefer reading sequentially. Throws on failure.
+    [[nodiscard]] Stream::Input DecompressingInput(Stream::Input source, Stream::capacity_t capacity = Stream::Input::default_capacity);
+}
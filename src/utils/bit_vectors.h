@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
 #include <climits>
 #include <concepts>
 #include <cstddef>
@@ -143,4 +145,153 @@ namespace BitVec
             c.resize(loc.index + 1);
         op.Apply(c, loc);
     }
+
+
+    namespace impl
+    {
+        // Calls `func(elem, mask)` for every element overlapping the bit range `[begin, end)`, where `mask` selects the bits in the range.
+        // The range must be valid.
+        template <Container T, typename F>
+        constexpr void ForEachElemInRange(T &c, std::size_t begin, std::size_t end, F &&func)
+        {
+            using elem_t = std::remove_const_t<ContainerElem<T>>;
+            if (begin >= end)
+                return;
+
+            std::size_t first = begin / bit_width<elem_t>, last = (end - 1) / bit_width<elem_t>;
+            elem_t first_mask = elem_t(~elem_t(0) << begin % bit_width<elem_t>);
+            elem_t last_mask = elem_t(elem_t(~elem_t(0)) >> (bit_width<elem_t> - 1 - (end - 1) % bit_width<elem_t>));
+
+            auto it = std::begin(c);
+            if (first == last)
+            {
+                func(it[first], elem_t(first_mask & last_mask));
+                return;
+            }
+            func(it[first], first_mask);
+            for (std::size_t i = first + 1; i < last; i++)
+                func(it[i], elem_t(~elem_t(0)));
+            func(it[last], last_mask);
+        }
+    }
+
+    // Returns the index of the first bit equal to `value`, starting from `i` inclusive.
+    // Returns `Size(c)` if there's no such bit.
+    // Checks a whole element at a time, so this is much faster than calling `GetBitOrZero()` in a loop.
+    template <Container T>
+    [[nodiscard]] constexpr std::size_t FindBit(const T &c, std::size_t i, bool value = true)
+    {
+        using elem_t = std::remove_const_t<ContainerElem<T>>;
+        std::size_t size = std::size(c);
+        std::size_t index = i / bit_width<elem_t>;
+        if (index >= size)
+            return Size(c);
+
+        elem_t flip = value ? 0 : ~elem_t(0);
+        auto it = std::begin(c);
+
+        // Mask out the bits before `i` in the first element.
+        elem_t elem = elem_t((it[index] ^ flip) & ~elem_t(0) << i % bit_width<elem_t>);
+        while (elem == 0)
+        {
+            if (++index == size)
+                return Size(c);
+            elem = it[index] ^ flip;
+        }
+        return index * bit_width<elem_t> + std::size_t(std::countr_zero(elem));
+    }
+
+    // Returns the number of set bits.
+    template <Container T>
+    [[nodiscard]] constexpr std::size_t CountOnes(const T &c)
+    {
+        std::size_t ret = 0;
+        for (auto elem : c)
+            ret += std::size_t(std::popcount(elem));
+        return ret;
+    }
+
+    // Returns the number of set bits in the range `[begin, end)`, or throws if the range is invalid.
+    template <Container T>
+    [[nodiscard]] constexpr std::size_t CountOnesInRange(const T &c, std::size_t begin, std::size_t end)
+    {
+        if (begin > end || end > Size(c))
+            throw std::runtime_error("Bit range is out of range.");
+
+        std::size_t ret = 0;
+        impl::ForEachElemInRange(c, begin, end, [&](auto elem, auto mask){ret += std::size_t(std::popcount(decltype(mask)(elem & mask)));});
+        return ret;
+    }
+
+    // Modifies the bits in range `[begin, end)` (sets them to 1 by default), or throws if the range is invalid.
+    // Modifies a whole element at a time when possible.
+    template <MutableContainer T>
+    constexpr void SetBitRangeOrThrow(T &c, std::size_t begin, std::size_t end, OpParam op = true)
+    {
+        if (begin > end || end > Size(c))
+            throw std::runtime_error("Bit range is out of range.");
+
+        impl::ForEachElemInRange(c, begin, end, [&](auto &elem, auto mask)
+        {
+            switch (op.op)
+            {
+              case zero:
+                elem &= ~mask;
+                break;
+              case one:
+                elem |= mask;
+                break;
+              case toggle:
+                elem ^= mask;
+                break;
+            }
+        });
+    }
+
+
+    // Bitwise operations on whole containers: `target op= source`.
+    // If `source` is shorter, it's treated as padded with zeroes. If it's longer, the extra bits are ignored.
+    // Those are simple loops over elements, the compiler vectorizes them.
+
+    template <MutableContainer T, Container U> requires std::same_as<std::remove_const_t<ContainerElem<T>>, std::remove_const_t<ContainerElem<U>>>
+    constexpr void BitwiseAnd(T &target, const U &source)
+    {
+        std::size_t n = std::min(std::size(target), std::size(source));
+        auto t = std::begin(target);
+        auto s = std::begin(source);
+        for (std::size_t i = 0; i < n; i++)
+            t[i] &= s[i];
+        std::fill(t + n, std::end(target), 0);
+    }
+
+    template <MutableContainer T, Container U> requires std::same_as<std::remove_const_t<ContainerElem<T>>, std::remove_const_t<ContainerElem<U>>>
+    constexpr void BitwiseOr(T &target, const U &source)
+    {
+        std::size_t n = std::min(std::size(target), std::size(source));
+        auto t = std::begin(target);
+        auto s = std::begin(source);
+        for (std::size_t i = 0; i < n; i++)
+            t[i] |= s[i];
+    }
+
+    template <MutableContainer T, Container U> requires std::same_as<std::remove_const_t<ContainerElem<T>>, std::remove_const_t<ContainerElem<U>>>
+    constexpr void BitwiseXor(T &target, const U &source)
+    {
+        std::size_t n = std::min(std::size(target), std::size(source));
+        auto t = std::begin(target);
+        auto s = std::begin(source);
+        for (std::size_t i = 0; i < n; i++)
+            t[i] ^= s[i];
+    }
+
+    // `target &= ~source`, i.e. clears the bits that are set in `source`.
+    template <MutableContainer T, Container U> requires std::same_as<std::remove_const_t<ContainerElem<T>>, std::remove_const_t<ContainerElem<U>>>
+    constexpr void BitwiseAndNot(T &target, const U &source)
+    {
+        std::size_t n = std::min(std::size(target), std::size(source));
+        auto t = std::begin(target);
+        auto s = std::begin(source);
+        for (std::size_t i = 0; i < n; i++)
+            t[i] &= ~s[i];
+    }
 }
@@ -0,0 +1,58 @@
+#include "bit_vectors.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("bit_vectors.bulk")
+{
+    // Compare against the bit-at-a-time functions, with a small element type to hit more edge cases.
+    std::vector<std::uint8_t> bits(5);
+    for (std::size_t i : {1, 7, 8, 9, 20, 39})
+        BitVec::SetBitOrThrow(bits, i);
+
+    auto FindSlow = [&](std::size_t i, bool value)
+    {
+        while (i < BitVec::Size(bits) && BitVec::GetBitOrZero(bits, i) != value)
+            i++;
+        return std::min(i, BitVec::Size(bits));
+    };
+    for (std::size_t i = 0; i <= 41; i++)
+    {
+        REQUIRE(BitVec::FindBit(bits, i) == FindSlow(i, true));
+        REQUIRE(BitVec::FindBit(bits, i, false) == FindSlow(i, false));
+    }
+
+    CHECK(BitVec::CountOnes(bits) == 6);
+    CHECK(BitVec::CountOnesInRange(bits, 7, 9) == 2);
+    CHECK(BitVec::CountOnesInRange(bits, 2, 2) == 0);
+    CHECK(BitVec::CountOnesInRange(bits, 0, 40) == 6);
+    REQUIRE_THROWS(BitVec::CountOnesInRange(bits, 0, 41));
+
+    for (std::size_t begin = 0; begin <= 40; begin++)
+    for (std::size_t end = begin; end <= 40; end++)
+    for (BitVec::Op op : {BitVec::zero, BitVec::one, BitVec::toggle})
+    {
+        auto expected = bits;
+        for (std::size_t i = begin; i < end; i++)
+            BitVec::SetBitOrThrow(expected, i, op);
+        auto actual = bits;
+        BitVec::SetBitRangeOrThrow(actual, begin, end, op);
+        REQUIRE(actual == expected);
+    }
+
+    std::vector<std::uint64_t> a = {0b1100, 0b1010, 1}, b = {0b1010, 0b0110};
+    auto c = a;
+    BitVec::BitwiseAnd(c, b);
+    CHECK(c == std::vector<std::uint64_t>{0b1000, 0b0010, 0});
+    c = a;
+    BitVec::BitwiseOr(c, b);
+    CHECK(c == std::vector<std::uint64_t>{0b1110, 0b1110, 1});
+    c = a;
+    BitVec::BitwiseXor(c, b);
+    CHECK(c == std::vector<std::uint64_t>{0b0110, 0b1100, 1});
+    c = a;
+    BitVec::BitwiseAndNot(c, b);
+    CHECK(c == std::vector<std::uint64_t>{0b0100, 0b1000, 1});
+}
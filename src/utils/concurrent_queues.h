@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+// Lock-free primitives for passing data between threads.
+//
+// `SpscQueue<T>` - a bounded ring buffer with one producer thread and one consumer thread. Both sides are wait-free.
+// `MpscQueue<T>` - an unbounded intrusive queue with any number of producer threads and one consumer thread. Pushing is wait-free.
+// `TripleBuffer<T>` (in `triple_buffer.h`) - publishes the latest value from one thread to another.
+
+namespace Concurrent
+{
+    // The padding used to keep the variables written by different threads in different cache lines.
+    // Not `std::hardware_destructive_interference_size`, because GCC warns that it can change between compiler flags, which breaks the ABI.
+    inline constexpr std::size_t cache_line_size = 64;
+
+    // A bounded single-producer single-consumer queue.
+    // `TryPush()` must only be called from one thread, and `TryPop()` from one (possibly different) thread.
+    template <typename T>
+    class SpscQueue
+    {
+        struct Slot
+        {
+            alignas(T) unsigned char bytes[sizeof(T)];
+        };
+
+        std::size_t mask = 0;
+        std::unique_ptr<Slot[]> slots;
+
+        // The positions grow indefinitely, and are masked when indexing the slots.
+        // Each side caches the last seen position of the other side, to avoid touching its cache line on every call.
+
+        // Written by the producer.
+        alignas(cache_line_size) std::atomic<std::size_t> write_pos{0};
+        std::size_t cached_read_pos = 0;
+
+        // Written by the consumer.
+        alignas(cache_line_size) std::atomic<std::size_t> read_pos{0};
+        std::size_t cached_write_pos = 0;
+
+        [[nodiscard]] T *SlotPtr(std::size_t pos)
+        {
+            return std::launder(reinterpret_cast<T *>(slots[pos & mask].bytes));
+        }
+
+      public:
+        // The capacity is rounded up to a power of two.
+        explicit SpscQueue(std::size_t min_capacity)
+        {
+            if (min_capacity == 0)
+                throw std::runtime_error("The capacity of a `SpscQueue` can't be zero.");
+            std::size_t capacity = std::bit_ceil(min_capacity);
+            mask = capacity - 1;
+            slots = std::make_unique<Slot[]>(capacity);
+        }
+
+        SpscQueue(const SpscQueue &) = delete;
+        SpscQueue &operator=(const SpscQueue &) = delete;
+
+        ~SpscQueue()
+        {
+            std::size_t end = write_pos.load(std::memory_order_acquire);
+            for (std::size_t pos = read_pos.load(std::memory_order_relaxed); pos != end; pos++)
+                SlotPtr(pos)->~T();
+        }
+
+        [[nodiscard]] std::size_t Capacity() const
+        {
+            return mask + 1;
+        }
+
+        // The number of elements in the queue. Only approximate if the other thread is working with the queue at the same time.
+        [[nodiscard]] std::size_t SizeApprox() const
+        {
+            std::size_t r = read_pos.load(std::memory_order_acquire);
+            std::size_t w = write_pos.load(std::memory_order_acquire);
+            return w - r;
+        }
+
+        // Producer only. Constructs an element in place from the parameters.
+        // Returns false and does nothing if the queue is full.
+        template <typename ...P>
+        bool TryPush(P &&... params)
+        {
+            std::size_t pos = write_pos.load(std::memory_order_relaxed);
+            if (pos - cached_read_pos > mask)
+            {
+                cached_read_pos = read_pos.load(std::memory_order_acquire);
+                if (pos - cached_read_pos > mask)
+                    return false;
+            }
+
+            ::new((void *)slots[pos & mask].bytes) T(std::forward<P>(params)...);
+            write_pos.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only. Returns null if the queue is empty.
+        [[nodiscard]] std::optional<T> TryPop()
+        {
+            std::size_t pos = read_pos.load(std::memory_order_relaxed);
+            if (pos == cached_write_pos)
+            {
+                cached_write_pos = write_pos.load(std::memory_order_acquire);
+                if (pos == cached_write_pos)
+                    return {};
+            }
+
+            T *ptr = SlotPtr(pos);
+            std::optional<T> ret(std::move(*ptr));
+            ptr->~T();
+            read_pos.store(pos + 1, std::memory_order_release);
+            return ret;
+        }
+    };
+
+    // Inherit the element type of `MpscQueue` from this.
+    struct MpscNode
+    {
+        std::atomic<MpscNode *> next{nullptr};
+
+        MpscNode() {}
+        MpscNode(const MpscNode &) {} // Don't copy the link.
+        MpscNode &operator=(const MpscNode &) {return *this;}
+    };
+
+    // An unbounded intrusive multiple-producer single-consumer queue. `T` must inherit from `MpscNode`.
+    // The queue doesn't own the elements, and doesn't allocate. An element must stay alive until it's popped, and can only be in one queue at a time.
+    // `Push()` can be called from any number of threads at once, and `TryPop()` only from one thread at a time.
+    // This is the Vyukov's queue: a producer atomically swaps itself into the head, then links the previous head to itself.
+    template <typename T>
+    requires std::derived_from<T, MpscNode>
+    class MpscQueue
+    {
+        // Written by the producers. The most recently pushed node.
+        alignas(cache_line_size) std::atomic<MpscNode *> head;
+
+        // Written by the consumer. The next node to pop, or the stub.
+        alignas(cache_line_size) MpscNode *tail;
+        // Sits in the queue when it's empty, so that the head is never null.
+        MpscNode stub;
+
+        void PushNode(MpscNode &node)
+        {
+            node.next.store(nullptr, std::memory_order_relaxed);
+            MpscNode *prev = head.exchange(&node, std::memory_order_acq_rel);
+            // Between these two lines, the consumer can't see `node` or anything pushed after it.
+            prev->next.store(&node, std::memory_order_release);
+        }
+
+      public:
+        MpscQueue() : head(&stub), tail(&stub) {}
+
+        MpscQueue(const MpscQueue &) = delete;
+        MpscQueue &operator=(const MpscQueue &) = delete;
+
+        // Any thread. Adds the element to the queue, it must not be in a queue already.
+        void Push(T &elem)
+        {
+            PushNode(elem);
+        }
+
+        // Consumer only. Returns null if the queue is empty.
+        // Can also return null if a producer is in the middle of `Push()`, even if there are other elements after it. Try again later in that case.
+        [[nodiscard]] T *TryPop()
+        {
+            MpscNode *node = tail;
+            MpscNode *next = node->next.load(std::memory_order_acquire);
+
+            // Skip the stub.
+            if (node == &stub)
+            {
+                if (!next)
+                    return nullptr;
+                tail = next;
+                node = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+
+            if (next)
+            {
+                tail = next;
+                return static_cast<T *>(node);
+            }
+
+            // `node` is the last one. We can only take it if we push the stub after it, since the queue can't be left without nodes.
+            if (node != head.load(std::memory_order_acquire))
+                return nullptr; // A producer has swapped the head, but hasn't linked it yet.
+
+            PushNode(stub);
+            next = node->next.load(std::memory_order_acquire);
+            if (next)
+            {
+                tail = next;
+                return static_cast<T *>(node);
+            }
+            return nullptr; // Some producer pushed right before the stub, and hasn't linked it yet.
+        }
+
+        // Consumer only. Returns true if there's nothing to pop. Same caveats as with `TryPop()`.
+        [[nodiscard]] bool IsEmptyApprox() const
+        {
+            return tail == &stub && !stub.next.load(std::memory_order_acquire);
+        }
+    };
+}
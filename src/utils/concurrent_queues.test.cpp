@@ -0,0 +1,146 @@
+#include "concurrent_queues.h"
+#include "triple_buffer.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("concurrent_queues.spsc")
+{
+    Concurrent::SpscQueue<std::unique_ptr<int>> queue(5);
+    CHECK(queue.Capacity() == 8);
+    REQUIRE_THROWS(Concurrent::SpscQueue<int>(0));
+
+    // Single-threaded.
+    for (int i = 0; i < 8; i++)
+        CHECK(queue.TryPush(std::make_unique<int>(i)));
+    CHECK(!queue.TryPush(std::make_unique<int>(8)));
+    CHECK(queue.SizeApprox() == 8);
+    for (int i = 0; i < 5; i++)
+        CHECK(**queue.TryPop() == i);
+    // The remaining elements are destroyed with the queue.
+
+    // Stress test.
+    constexpr int count = 200000;
+    Concurrent::SpscQueue<int> ints(64);
+    std::jthread producer([&]
+    {
+        for (int i = 0; i < count; i++)
+        {
+            while (!ints.TryPush(i))
+                std::this_thread::yield();
+        }
+    });
+
+    bool ok = true;
+    for (int i = 0; i < count; i++)
+    {
+        std::optional<int> value;
+        while (!(value = ints.TryPop()))
+            std::this_thread::yield();
+        ok = ok && *value == i;
+    }
+    CHECK(ok);
+    CHECK(!ints.TryPop());
+}
+
+TEST_CASE("concurrent_queues.mpsc")
+{
+    struct Node : Concurrent::MpscNode
+    {
+        int producer = 0;
+        int value = 0;
+    };
+
+    constexpr int num_producers = 4, count = 50000;
+    std::vector<std::vector<Node>> nodes(num_producers, std::vector<Node>(count));
+
+    Concurrent::MpscQueue<Node> queue;
+    CHECK(queue.IsEmptyApprox());
+    CHECK(!queue.TryPop());
+
+    std::vector<std::jthread> producers;
+    for (int p = 0; p < num_producers; p++)
+    {
+        producers.emplace_back([&, p]
+        {
+            for (int i = 0; i < count; i++)
+            {
+                nodes[p][i].producer = p;
+                nodes[p][i].value = i;
+                queue.Push(nodes[p][i]);
+            }
+        });
+    }
+
+    // The elements of each producer must arrive in order.
+    std::vector<int> next_value(num_producers);
+    bool ok = true;
+    for (int received = 0; received < num_producers * count;)
+    {
+        Node *node = queue.TryPop();
+        if (!node)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        ok = ok && node->value == next_value[node->producer]++;
+        received++;
+    }
+    CHECK(ok);
+    CHECK(!queue.TryPop());
+    CHECK(queue.IsEmptyApprox());
+
+    // Can push again after the queue becomes empty.
+    queue.Push(nodes[0][0]);
+    CHECK(queue.TryPop() == &nodes[0][0]);
+}
+
+TEST_CASE("concurrent_queues.triple_buffer")
+{
+    struct State
+    {
+        int a = 0;
+        int b = 0;
+    };
+
+    Concurrent::TripleBuffer<State> buffer;
+    CHECK(!buffer.Update());
+    CHECK(buffer.Read().a == 0);
+
+    buffer.Write() = {1, 2};
+    buffer.Publish();
+    buffer.Write() = {2, 4};
+    buffer.Publish();
+    CHECK(buffer.Update());
+    CHECK(buffer.Read().a == 2); // The older value is skipped.
+    CHECK(!buffer.Update());
+
+    // Stress test. The reader must always see complete values, and never go back in time.
+    constexpr int count = 200000;
+    std::jthread writer([&]
+    {
+        for (int i = 3; i <= count; i++)
+        {
+            buffer.Write() = {i, i * 2};
+            buffer.Publish();
+        }
+    });
+
+    bool ok = true;
+    int last = 2;
+    while (last < count)
+    {
+        if (!buffer.Update())
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        const State &state = buffer.Read();
+        ok = ok && state.b == state.a * 2 && state.a > last;
+        last = state.a;
+    }
+    CHECK(ok);
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "utils/coroutines.h"
+
+// Runs many `Coroutine<>`s in sync with the game ticks, e.g. once per `Metronome` tick.
+// Usage:
+//     CoroutineScheduler scheduler;
+//     CoroutineScheduler::Signal door_opened;
+//
+//     scheduler.Add([](CoroutineScheduler &s, CoroutineScheduler::Signal &door_opened) -> Coroutine<>
+//     {
+//         co_await s.WaitTicks(60); // Sleep for 60 ticks.
+//         co_await s.WaitSignal(door_opened); // Sleep until `s.Notify(door_opened)`.
+//         co_await std::suspend_always{}; // Any other suspension resumes on the next tick.
+//     }(scheduler, door_opened));
+//
+//     while (metronome.Tick(delta))
+//         scheduler.Tick();
+//
+// The sleeping coroutines are stored in a timing wheel, so each tick only touches the coroutines that wake up on it, plus the ones
+//   sleeping for more than `wheel_size` ticks that happen to share the bucket.
+// Coroutines that wait for signals aren't touched at all until the signal is notified.
+class CoroutineScheduler
+{
+  public:
+    // The number of buckets in the timing wheel.
+    static constexpr std::size_t wheel_size = 256;
+
+    // Identifies a coroutine added to the scheduler. Stays unique even after the coroutine finishes.
+    struct TaskId
+    {
+        std::uint32_t index = std::uint32_t(-1);
+        std::uint32_t generation = 0;
+
+        [[nodiscard]] friend bool operator==(const TaskId &, const TaskId &) = default;
+    };
+
+    // Coroutines can wait for it, until it's passed to `Notify()`.
+    // If this is destroyed while coroutines are waiting for it, they stay asleep until the scheduler is destroyed.
+    class Signal
+    {
+        friend CoroutineScheduler;
+        std::vector<TaskId> waiters;
+
+      public:
+        Signal() {}
+
+        // Returns true if any coroutines are waiting for this signal. Some of them might be already cancelled.
+        [[nodiscard]] bool HasWaiters() const
+        {
+            return !waiters.empty();
+        }
+    };
+
+  private:
+    struct Task
+    {
+        Coroutine<> coroutine;
+        std::uint32_t generation = 0;
+        bool alive = false;
+    };
+
+    struct Sleeper
+    {
+        TaskId id;
+        std::uint64_t wake_tick = 0;
+    };
+
+    std::vector<Task> tasks;
+    std::vector<std::uint32_t> free_task_indices;
+    std::size_t num_tasks = 0;
+
+    std::array<std::vector<Sleeper>, wheel_size> wheel;
+    std::vector<TaskId> due_tasks; // Reused between ticks.
+    std::uint64_t current_tick = 0;
+
+    // The coroutine that's currently running, if any.
+    TaskId running_task;
+    bool is_running = false;
+
+    // The awaitables write here what the running coroutine waits for.
+    std::uint64_t requested_ticks = 1;
+    Signal *requested_signal = nullptr;
+
+    void Schedule(TaskId id, std::uint64_t wake_tick)
+    {
+        wheel[wake_tick % wheel_size].push_back({id, wake_tick});
+    }
+
+    void RemoveTask(TaskId id)
+    {
+        Task &task = tasks[id.index];
+        task.alive = false;
+        task.generation++;
+        free_task_indices.push_back(id.index);
+        num_tasks--;
+    }
+
+    void Run(TaskId id)
+    {
+        requested_ticks = 1;
+        requested_signal = nullptr;
+
+        // Move the coroutine out of the vector, since it can reallocate if the coroutine adds more tasks.
+        Coroutine<> coroutine = std::move(tasks[id.index].coroutine);
+        running_task = id;
+        is_running = true;
+        bool suspended;
+        try
+        {
+            suspended = coroutine();
+        }
+        catch (...)
+        {
+            is_running = false;
+            RemoveTask(id);
+            throw;
+        }
+        is_running = false;
+
+        if (!suspended)
+        {
+            RemoveTask(id);
+            return;
+        }
+
+        tasks[id.index].coroutine = std::move(coroutine);
+        if (requested_signal)
+            requested_signal->waiters.push_back(id);
+        else
+            Schedule(id, current_tick + requested_ticks);
+    }
+
+  public:
+    CoroutineScheduler() {}
+
+    CoroutineScheduler(const CoroutineScheduler &) = delete;
+    CoroutineScheduler &operator=(const CoroutineScheduler &) = delete;
+
+    // Adds a coroutine. It first runs on the next `Tick()`.
+    // Null coroutines are accepted, and finish immediately.
+    TaskId Add(Coroutine<> coroutine)
+    {
+        TaskId id;
+        if (free_task_indices.empty())
+        {
+            id.index = std::uint32_t(tasks.size());
+            tasks.emplace_back();
+        }
+        else
+        {
+            id.index = free_task_indices.back();
+            free_task_indices.pop_back();
+        }
+
+        Task &task = tasks[id.index];
+        task.coroutine = std::move(coroutine);
+        task.alive = true;
+        id.generation = task.generation;
+        num_tasks++;
+
+        Schedule(id, current_tick + 1);
+        return id;
+    }
+
+    // Returns true if the coroutine is still running (it didn't finish and wasn't cancelled).
+    [[nodiscard]] bool IsAlive(TaskId id) const
+    {
+        return id.index < tasks.size() && tasks[id.index].alive && tasks[id.index].generation == id.generation;
+    }
+
+    // Destroys the coroutine. Does nothing if it's not alive.
+    // Throws if called by the coroutine on itself, use `co_return` instead.
+    void Cancel(TaskId id)
+    {
+        if (!IsAlive(id))
+            return;
+        if (is_running && running_task == id)
+            throw std::runtime_error("A coroutine can't cancel itself.");
+
+        // The stale entries in the wheel and in the signals are skipped later, since the generation doesn't match.
+        tasks[id.index].coroutine = {};
+        RemoveTask(id);
+    }
+
+    // Wakes up all coroutines waiting for the signal. They run on the next tick.
+    void Notify(Signal &signal)
+    {
+        for (TaskId id : signal.waiters)
+        {
+            if (IsAlive(id))
+                Schedule(id, current_tick + 1);
+        }
+        signal.waiters.clear();
+    }
+
+    // Resumes the coroutines that should wake up on this tick.
+    void Tick()
+    {
+        current_tick++;
+
+        // Extract the due tasks first, since running them can schedule more tasks into the same bucket.
+        std::vector<Sleeper> &bucket = wheel[current_tick % wheel_size];
+        due_tasks.clear();
+        std::erase_if(bucket, [&](const Sleeper &sleeper)
+        {
+            if (sleeper.wake_tick != current_tick)
+                return false;
+            due_tasks.push_back(sleeper.id);
+            return true;
+        });
+
+        for (TaskId id : due_tasks)
+        {
+            if (IsAlive(id))
+                Run(id);
+        }
+    }
+
+    // The number of `Tick()` calls so far.
+    [[nodiscard]] std::uint64_t CurrentTick() const
+    {
+        return current_tick;
+    }
+
+    // The number of alive coroutines.
+    [[nodiscard]] std::size_t TaskCount() const
+    {
+        return num_tasks;
+    }
+
+    // Awaitables, only usable from the coroutines running in this scheduler.
+
+    struct WaitTicksAwaitable
+    {
+        CoroutineScheduler *scheduler = nullptr;
+        std::uint64_t ticks = 0;
+
+        [[nodiscard]] bool await_ready() const noexcept {return ticks == 0;}
+        void await_suspend(std::coroutine_handle<>) const noexcept {scheduler->requested_ticks = ticks;}
+        void await_resume() const noexcept {}
+    };
+
+    struct WaitSignalAwaitable
+    {
+        CoroutineScheduler *scheduler = nullptr;
+        Signal *signal = nullptr;
+
+        [[nodiscard]] bool await_ready() const noexcept {return false;}
+        void await_suspend(std::coroutine_handle<>) const noexcept {scheduler->requested_signal = signal;}
+        void await_resume() const noexcept {}
+    };
+
+    // Sleeps for `n` ticks. 1 means resuming on the next tick. 0 doesn't suspend at all.
+    [[nodiscard]] WaitTicksAwaitable WaitTicks(std::uint64_t n)
+    {
+        return {this, n};
+    }
+
+    // Sleeps until `Notify()` is called on the signal.
+    [[nodiscard]] WaitSignalAwaitable WaitSignal(Signal &signal)
+    {
+        return {this, &signal};
+    }
+};
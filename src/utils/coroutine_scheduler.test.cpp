@@ -0,0 +1,79 @@
+#include "coroutine_scheduler.h"
+
+#include <string>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("coroutine_scheduler")
+{
+    CoroutineScheduler scheduler;
+    CoroutineScheduler::Signal signal;
+    std::string log;
+
+    auto Script = [](CoroutineScheduler &s, CoroutineScheduler::Signal &signal, std::string &log, char name) -> Coroutine<>
+    {
+        log += name;
+        co_await s.WaitTicks(2);
+        log += name;
+        co_await s.WaitTicks(0); // Doesn't suspend.
+        co_await s.WaitSignal(signal);
+        log += name;
+        co_await std::suspend_always{}; // Resumes on the next tick.
+        log += name;
+    };
+
+    auto a = scheduler.Add(Script(scheduler, signal, log, 'a'));
+    scheduler.Tick();
+    auto b = scheduler.Add(Script(scheduler, signal, log, 'b'));
+    CHECK(log == "a");
+    scheduler.Tick();
+    CHECK(log == "ab");
+    scheduler.Tick();
+    CHECK(log == "aba");
+    scheduler.Tick();
+    CHECK(log == "abab");
+    CHECK(signal.HasWaiters());
+
+    // Nothing happens until the signal is notified.
+    for (int i = 0; i < 10; i++)
+        scheduler.Tick();
+    CHECK(log == "abab");
+
+    scheduler.Notify(signal);
+    CHECK(!signal.HasWaiters());
+    CHECK(log == "abab");
+    scheduler.Tick();
+    CHECK(log == "ababab");
+    scheduler.Cancel(b);
+    CHECK(!scheduler.IsAlive(b));
+    CHECK(scheduler.TaskCount() == 1);
+    scheduler.Tick();
+    CHECK(log == "abababa");
+    CHECK(!scheduler.IsAlive(a));
+    CHECK(scheduler.TaskCount() == 0);
+
+    // Long sleeps wrap around the timing wheel.
+    std::uint64_t woke_at = 0;
+    scheduler.Add([](CoroutineScheduler &s, std::uint64_t &woke_at) -> Coroutine<>
+    {
+        co_await s.WaitTicks(CoroutineScheduler::wheel_size * 2 + 5);
+        woke_at = s.CurrentTick();
+    }(scheduler, woke_at));
+    std::uint64_t start = scheduler.CurrentTick();
+    while (scheduler.TaskCount() > 0)
+        scheduler.Tick();
+    CHECK(woke_at == start + 1 + CoroutineScheduler::wheel_size * 2 + 5);
+
+    // Coroutines can add more coroutines, and the exceptions propagate.
+    scheduler.Add([](CoroutineScheduler &s) -> Coroutine<>
+    {
+        for (int i = 0; i < 100; i++)
+            s.Add([]() -> Coroutine<> {co_return;}());
+        co_await s.WaitTicks(1);
+        throw std::runtime_error("Blah!");
+    }(scheduler));
+    scheduler.Tick();
+    CHECK(scheduler.TaskCount() == 101);
+    REQUIRE_THROWS(scheduler.Tick());
+    CHECK(scheduler.TaskCount() <= 100);
+}
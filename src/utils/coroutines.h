@@ -1,9 +1,11 @@
 #pragma once
 
+#include <array>
 #include <cassert>
 #include <coroutine>
 #include <cstddef>
 #include <memory>
+#include <new>
 #include <optional>
 #include <utility>
 
@@ -25,8 +27,103 @@ How to use:
 
   The handle is move-only, but you can make a copyable handle of type `Coroutine<R>::Shared` by calling `.shared()`.
   It has the same interface as the regular handle, but is copyable.
+
+  The coroutine frames are allocated from `CoroutineFramePool`, see below.
+  See `utils/coroutine_scheduler.h` for running many coroutines in sync with the game ticks.
 */
 
+// Caches the freed coroutine frames, grouped by size, to avoid hitting the global allocator every time a coroutine is created.
+// The cache is per thread, and frames can be freed on a different thread than the one they were allocated on.
+namespace CoroutineFramePool
+{
+    // Frames larger than this use the global `operator new` directly.
+    inline constexpr std::size_t max_pooled_size = 2048;
+    // Frame sizes are rounded up to a multiple of this.
+    inline constexpr std::size_t size_class_step = 64;
+    // At most this many free frames of each size are cached per thread, the rest are returned to the global allocator.
+    inline constexpr std::size_t max_cached_per_class = 1024;
+
+    inline constexpr std::size_t num_size_classes = max_pooled_size / size_class_step;
+
+    namespace impl
+    {
+        struct FreeFrame
+        {
+            FreeFrame *next = nullptr;
+        };
+
+        struct State
+        {
+            std::array<FreeFrame *, num_size_classes> lists{};
+            std::array<std::size_t, num_size_classes> counts{};
+
+            State() {}
+            State(const State &) = delete;
+            State &operator=(const State &) = delete;
+
+            ~State()
+            {
+                for (FreeFrame *frame : lists)
+                {
+                    while (frame)
+                        ::operator delete(std::exchange(frame, frame->next));
+                }
+                lists = {};
+                Destroyed() = true;
+            }
+
+            // Whether the state for this thread was already destroyed. This is trivially destructible, so it's safe to check even after that.
+            [[nodiscard]] static bool &Destroyed()
+            {
+                thread_local bool ret = false;
+                return ret;
+            }
+        };
+
+        [[nodiscard]] inline State &ThreadState()
+        {
+            thread_local State ret;
+            return ret;
+        }
+    }
+
+    [[nodiscard]] inline void *Allocate(std::size_t size)
+    {
+        if (size == 0 || size > max_pooled_size || impl::State::Destroyed())
+            return ::operator new(size);
+
+        std::size_t size_class = (size - 1) / size_class_step;
+        impl::State &state = impl::ThreadState();
+        if (impl::FreeFrame *frame = state.lists[size_class])
+        {
+            state.lists[size_class] = frame->next;
+            state.counts[size_class]--;
+            return frame;
+        }
+        return ::operator new((size_class + 1) * size_class_step);
+    }
+
+    // `size` must be the same as passed to `Allocate()`.
+    inline void Deallocate(void *ptr, std::size_t size) noexcept
+    {
+        if (size == 0 || size > max_pooled_size || impl::State::Destroyed())
+        {
+            ::operator delete(ptr);
+            return;
+        }
+
+        std::size_t size_class = (size - 1) / size_class_step;
+        impl::State &state = impl::ThreadState();
+        if (state.counts[size_class] >= max_cached_per_class)
+        {
+            ::operator delete(ptr);
+            return;
+        }
+        state.lists[size_class] = ::new(ptr) impl::FreeFrame{state.lists[size_class]};
+        state.counts[size_class]++;
+    }
+}
+
 template <typename R = void>
 class Coroutine
 {
@@ -74,6 +171,16 @@ class Coroutine
     {
         Coroutine *coro = nullptr;
 
+        // The frames are allocated from the pool.
+        [[nodiscard]] static void *operator new(std::size_t size)
+        {
+            return CoroutineFramePool::Allocate(size);
+        }
+        static void operator delete(void *ptr, std::size_t size) noexcept
+        {
+            CoroutineFramePool::Deallocate(ptr, size);
+        }
+
         // If we return by value, this points to `std::optional<R>` where we should construct the return value.
         // If we return by reference, we write the address of the reference here.
         // Lastly, if we return void, this is a bool, where `true` indicates a successful return.
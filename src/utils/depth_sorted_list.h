@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "program/errors.h"
+
+// A list of objects kept sorted by a 32-bit key, e.g. the sprites sorted by the layer and the Y coordinate.
+// Made for the case where a few keys change each frame, or many keys change slightly:
+//   `SetKey()` only stores the new key, and `Sort()` then fixes the order, reusing the previous one.
+// `Sort()` runs an insertion sort, which is linear on nearly sorted data. If it needs too many moves, it switches to a radix sort.
+// Both are stable, so the objects with equal keys keep their relative order (and don't flicker).
+// `T` is stored by value and is copied around, so it should be small, e.g. a pointer or an ID.
+// Usage:
+//   DepthSortedList<Sprite *> list;
+//   auto handle = list.Insert(&sprite, DepthSortedList<Sprite *>::LayeredKey(layer, sprite.pos.y));
+//   list.SetKey(handle, ...); // When the sprite moves.
+//   list.Erase(handle); // When it's destroyed.
+//   list.Sort(); // Once per frame, before drawing.
+//   list.ForEach([](Sprite *sprite){...});
+template <typename T>
+class DepthSortedList
+{
+  public:
+    using Handle = std::uint32_t;
+    static constexpr Handle null_handle = Handle(-1);
+
+    // If the insertion sort makes more than this many moves per element, `Sort()` falls back to the radix sort.
+    static constexpr std::size_t max_insertion_sort_moves_per_elem = 2;
+
+  private:
+    struct Entry
+    {
+        std::uint32_t key = 0;
+        Handle handle = null_handle; // `null_handle` if erased, those are removed by `Sort()`.
+    };
+
+    struct Slot
+    {
+        T value{};
+        std::uint32_t pos = std::uint32_t(-1); // The index in `entries`, or -1 if the slot is free.
+    };
+
+    std::vector<Entry> entries; // Sorted by the key, unless `!is_sorted`. The new elements are appended to the end.
+    std::vector<Entry> radix_buffer; // Reused by `RadixSort()`.
+    std::vector<Slot> slots; // Indexed by handles.
+    std::vector<Handle> free_slots;
+    std::size_t num_erased_entries = 0;
+    bool is_sorted = true;
+
+    // Returns false and stops early if it needs more than `max_moves` moves. The elements are left in some valid order then.
+    [[nodiscard]] bool InsertionSort(std::size_t max_moves)
+    {
+        std::size_t num_moves = 0;
+        for (std::size_t i = 1; i < entries.size(); i++)
+        {
+            Entry entry = entries[i];
+            std::size_t j = i;
+            while (j > 0 && entries[j - 1].key > entry.key)
+            {
+                entries[j] = entries[j - 1];
+                j--;
+                if (++num_moves > max_moves)
+                {
+                    entries[j] = entry;
+                    return false;
+                }
+            }
+            entries[j] = entry;
+        }
+        return true;
+    }
+
+    // A least-significant-digit radix sort by 8-bit digits. Skips the digits that are the same in all keys (e.g. a fixed layer).
+    void RadixSort()
+    {
+        std::uint32_t counts[4][256]{};
+        for (const Entry &entry : entries)
+        {
+            for (int i = 0; i < 4; i++)
+                counts[i][entry.key >> (i * 8) & 0xff]++;
+        }
+
+        radix_buffer.resize(entries.size());
+        for (int i = 0; i < 4; i++)
+        {
+            std::uint32_t (&digit_counts)[256] = counts[i];
+            if (digit_counts[entries.front().key >> (i * 8) & 0xff] == entries.size())
+                continue; // All keys have the same digit.
+
+            std::uint32_t offset = 0;
+            for (std::uint32_t &count : digit_counts)
+                offset += std::exchange(count, offset);
+            for (const Entry &entry : entries)
+                radix_buffer[digit_counts[entry.key >> (i * 8) & 0xff]++] = entry;
+            std::swap(entries, radix_buffer);
+        }
+    }
+
+  public:
+    DepthSortedList() {}
+
+    // Maps a float to a key with the same order. Negative zero is ordered before positive zero.
+    [[nodiscard]] static std::uint32_t FloatKey(float value)
+    {
+        std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+        return bits & 0x80000000 ? ~bits : bits | 0x80000000;
+    }
+
+    // Sorts by the layer first, and then by `depth`. `depth` loses the 8 lowest bits of precision.
+    [[nodiscard]] static std::uint32_t LayeredKey(std::uint8_t layer, float depth)
+    {
+        return std::uint32_t(layer) << 24 | FloatKey(depth) >> 8;
+    }
+
+    // The number of elements.
+    [[nodiscard]] std::size_t Size() const
+    {
+        return slots.size() - free_slots.size();
+    }
+
+    // Whether the order is up to date, i.e. nothing was changed since the last `Sort()`.
+    [[nodiscard]] bool IsSorted() const
+    {
+        return is_sorted && num_erased_entries == 0;
+    }
+
+    // Adds a new element. It's placed at the end until the next `Sort()`.
+    [[nodiscard]] Handle Insert(T value, std::uint32_t key)
+    {
+        entries.reserve(entries.size() + 1); // Do this first, to not have to roll back.
+        Handle handle = 0;
+        if (free_slots.empty())
+        {
+            ASSERT(slots.size() < null_handle, "Too many elements in a depth-sorted list.");
+            slots.emplace_back();
+            // This makes sure `Erase()` never allocates.
+            free_slots.reserve(slots.capacity());
+            handle = Handle(slots.size() - 1);
+        }
+        else
+        {
+            handle = free_slots.back();
+            free_slots.pop_back();
+        }
+
+        slots[handle] = {.value = std::move(value), .pos = std::uint32_t(entries.size())};
+        if (!entries.empty() && entries.back().key > key)
+            is_sorted = false;
+        entries.push_back({.key = key, .handle = handle});
+        return handle;
+    }
+
+    // Removes an element. Its entry stays in the list (and is skipped when iterating) until the next `Sort()`.
+    void Erase(Handle handle) noexcept
+    {
+        ASSERT(handle < slots.size() && slots[handle].pos != std::uint32_t(-1), "Invalid depth-sorted list handle.");
+        Slot &slot = slots[handle];
+        entries[slot.pos].handle = null_handle;
+        slot = {};
+        free_slots.push_back(handle);
+        num_erased_entries++;
+    }
+
+    [[nodiscard]] const T &Get(Handle handle) const
+    {
+        ASSERT(handle < slots.size() && slots[handle].pos != std::uint32_t(-1), "Invalid depth-sorted list handle.");
+        return slots[handle].value;
+    }
+
+    [[nodiscard]] std::uint32_t GetKey(Handle handle) const
+    {
+        ASSERT(handle < slots.size() && slots[handle].pos != std::uint32_t(-1), "Invalid depth-sorted list handle.");
+        return entries[slots[handle].pos].key;
+    }
+
+    // Changes the key of an element. The order is fixed by the next `Sort()`.
+    void SetKey(Handle handle, std::uint32_t key)
+    {
+        ASSERT(handle < slots.size() && slots[handle].pos != std::uint32_t(-1), "Invalid depth-sorted list handle.");
+        std::uint32_t &cur_key = entries[slots[handle].pos].key;
+        if (cur_key != key)
+        {
+            cur_key = key;
+            is_sorted = false;
+        }
+    }
+
+    // Removes the erased elements, and restores the order. Does nothing if nothing changed since the last call.
+    void Sort()
+    {
+        if (IsSorted())
+            return;
+
+        if (num_erased_entries > 0)
+        {
+            std::erase_if(entries, [](const Entry &entry){return entry.handle == null_handle;});
+            num_erased_entries = 0;
+        }
+
+        if (!is_sorted)
+        {
+            if (!InsertionSort(entries.size() * max_insertion_sort_moves_per_elem))
+                RadixSort();
+            is_sorted = true;
+        }
+
+        for (std::size_t i = 0; i < entries.size(); i++)
+            slots[entries[i].handle].pos = std::uint32_t(i);
+    }
+
+    // Calls `func(const T &value)` for each element, in the order of the keys as of the last `Sort()`.
+    // The elements inserted since then are visited last, and the erased ones are skipped.
+    template <typename F>
+    void ForEach(F &&func) const
+    {
+        for (const Entry &entry : entries)
+        {
+            if (entry.handle != null_handle)
+                func(std::as_const(slots[entry.handle].value));
+        }
+    }
+
+    // Removes all elements.
+    void Clear()
+    {
+        entries.clear();
+        slots.clear();
+        free_slots.clear();
+        num_erased_entries = 0;
+        is_sorted = true;
+    }
+};
@@ -0,0 +1,113 @@
+#include "depth_sorted_list.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    using List = DepthSortedList<int>;
+
+    // Returns the values in the order of iteration, and checks that the keys are sorted.
+    [[nodiscard]] std::vector<int> GetSortedValues(const List &list, const std::vector<List::Handle> &handles, const std::vector<int> &alive)
+    {
+        std::vector<int> ret;
+        list.ForEach([&](int value){ret.push_back(value);});
+        for (std::size_t i = 1; i < ret.size(); i++)
+            REQUIRE(list.GetKey(handles[std::size_t(ret[i - 1])]) <= list.GetKey(handles[std::size_t(ret[i])]));
+        REQUIRE(ret.size() == alive.size());
+        return ret;
+    }
+}
+
+TEST_CASE("depth_sorted_list.keys")
+{
+    REQUIRE(List::FloatKey(-2.f) < List::FloatKey(-1.f));
+    REQUIRE(List::FloatKey(-1.f) < List::FloatKey(-0.f));
+    REQUIRE(List::FloatKey(-0.f) < List::FloatKey(0.f));
+    REQUIRE(List::FloatKey(0.f) < List::FloatKey(0.5f));
+    REQUIRE(List::FloatKey(0.5f) < List::FloatKey(100.f));
+
+    REQUIRE(List::LayeredKey(0, 1000.f) < List::LayeredKey(1, -1000.f));
+    REQUIRE(List::LayeredKey(1, -1.f) < List::LayeredKey(1, 1.f));
+}
+
+TEST_CASE("depth_sorted_list.stability")
+{
+    List list;
+    std::vector<List::Handle> handles;
+    for (int i = 0; i < 6; i++)
+        handles.push_back(list.Insert(i, std::uint32_t(i % 2)));
+    REQUIRE(!list.IsSorted());
+    list.Sort();
+    REQUIRE(list.IsSorted());
+    std::vector<int> values;
+    list.ForEach([&](int value){values.push_back(value);});
+    REQUIRE(values == std::vector{0, 2, 4, 1, 3, 5});
+
+    // Erased elements are skipped right away, and removed by `Sort()`.
+    list.Erase(handles[2]);
+    REQUIRE(!list.IsSorted());
+    values.clear();
+    list.ForEach([&](int value){values.push_back(value);});
+    REQUIRE(values == std::vector{0, 4, 1, 3, 5});
+    list.Sort();
+    REQUIRE(list.Size() == 5);
+    REQUIRE(list.GetKey(handles[3]) == 1);
+
+    // Changing a key keeps the other equal keys in order.
+    list.SetKey(handles[5], 0);
+    list.Sort();
+    values.clear();
+    list.ForEach([&](int value){values.push_back(value);});
+    REQUIRE(values == std::vector{0, 4, 5, 1, 3});
+}
+
+TEST_CASE("depth_sorted_list.random")
+{
+    std::mt19937 gen(42);
+    for (int small_changes = 0; small_changes < 2; small_changes++)
+    {
+        // Small changes should use the insertion sort, large ones should fall back to the radix sort.
+        List list;
+        std::vector<List::Handle> handles;
+        std::vector<int> alive;
+        std::vector<std::uint32_t> keys;
+        for (int i = 0; i < 2000; i++)
+        {
+            keys.push_back(std::uint32_t(gen()));
+            handles.push_back(list.Insert(i, keys.back()));
+            alive.push_back(i);
+        }
+
+        for (int frame = 0; frame < 10; frame++)
+        {
+            for (int value : alive)
+            {
+                std::uint32_t &key = keys[std::size_t(value)];
+                key = small_changes ? key + gen() % 16 : std::uint32_t(gen());
+                list.SetKey(handles[std::size_t(value)], key);
+            }
+
+            // Erase some elements, and reinsert them with new keys. The handles get reused.
+            for (int j = 0; j < 20; j++)
+            {
+                int value = alive[gen() % alive.size()];
+                list.Erase(handles[std::size_t(value)]);
+                keys[std::size_t(value)] = std::uint32_t(gen());
+                handles[std::size_t(value)] = list.Insert(value, keys[std::size_t(value)]);
+            }
+
+            list.Sort();
+            REQUIRE(list.Size() == alive.size());
+            std::vector<int> values = GetSortedValues(list, handles, alive);
+            std::sort(values.begin(), values.end());
+            REQUIRE(values == alive);
+            for (int value : alive)
+                REQUIRE(list.GetKey(handles[std::size_t(value)]) == keys[std::size_t(value)]);
+        }
+    }
+}
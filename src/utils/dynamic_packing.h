@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "program/errors.h"
+#include "utils/mat.h"
+
+namespace Packing
+{
+    // Packs rectangles into a box one at a time, and lets you free them later. Unlike `PackRects()`, doesn't need to know all rects in advance.
+    // Uses the guillotine algorithm: the free space is a list of non-overlapping rects. An allocation is cut from the best fitting one,
+    //   and the remainder is split in two along the shorter leftover axis. Freed rects are merged back with their neighbors when possible.
+    class DynamicPacker
+    {
+        ivec2 box_size = ivec2(0);
+        std::vector<irect2> free_rects;
+        long long used_area = 0;
+
+        // Merges the free rects that share a whole edge, until there's nothing left to merge.
+        void MergeFreeRects()
+        {
+            bool merged = true;
+            while (merged)
+            {
+                merged = false;
+                for (std::size_t i = 0; i < free_rects.size() && !merged; i++)
+                {
+                    for (std::size_t j = i + 1; j < free_rects.size(); j++)
+                    {
+                        irect2 &a = free_rects[i];
+                        const irect2 &b = free_rects[j];
+
+                        bool same_x = a.a.x == b.a.x && a.b.x == b.b.x;
+                        bool same_y = a.a.y == b.a.y && a.b.y == b.b.y;
+                        if (same_x && (a.b.y == b.a.y || b.b.y == a.a.y))
+                        {
+                            a.a.y = min(a.a.y, b.a.y);
+                            a.b.y = max(a.b.y, b.b.y);
+                        }
+                        else if (same_y && (a.b.x == b.a.x || b.b.x == a.a.x))
+                        {
+                            a.a.x = min(a.a.x, b.a.x);
+                            a.b.x = max(a.b.x, b.b.x);
+                        }
+                        else
+                        {
+                            continue;
+                        }
+
+                        free_rects.erase(free_rects.begin() + std::ptrdiff_t(j));
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+      public:
+        DynamicPacker() {}
+
+        explicit DynamicPacker(ivec2 box_size) : box_size(box_size)
+        {
+            Clear();
+        }
+
+        [[nodiscard]] ivec2 Size() const
+        {
+            return box_size;
+        }
+
+        // The total area of the allocated rects.
+        [[nodiscard]] long long UsedArea() const
+        {
+            return used_area;
+        }
+
+        // How many free rects there are. Grows with fragmentation.
+        [[nodiscard]] std::size_t FreeRectCount() const
+        {
+            return free_rects.size();
+        }
+
+        // Frees everything.
+        void Clear()
+        {
+            free_rects.clear();
+            if (box_size(all) > 0)
+                free_rects.push_back(ivec2().rect_size(box_size));
+            used_area = 0;
+        }
+
+        // Returns the position of the allocated rect, or null if there's no space for it.
+        [[nodiscard]] std::optional<ivec2> Allocate(ivec2 size)
+        {
+            ASSERT(size(all) > 0, "Invalid rect size.");
+
+            // Pick the free rect with the smallest leftover along the shorter side.
+            std::size_t best_index = free_rects.size();
+            int best_short_side = 0, best_long_side = 0;
+            for (std::size_t i = 0; i < free_rects.size(); i++)
+            {
+                ivec2 leftover = free_rects[i].size() - size;
+                if (leftover(any) < 0)
+                    continue;
+                int short_side = min(leftover.x, leftover.y);
+                int long_side = max(leftover.x, leftover.y);
+                if (best_index == free_rects.size() || short_side < best_short_side || (short_side == best_short_side && long_side < best_long_side))
+                {
+                    best_index = i;
+                    best_short_side = short_side;
+                    best_long_side = long_side;
+                }
+            }
+            if (best_index == free_rects.size())
+                return {};
+
+            irect2 free_rect = free_rects[best_index];
+            free_rects.erase(free_rects.begin() + std::ptrdiff_t(best_index));
+
+            // Split the remaining L-shaped space into two rects. The cut goes along the shorter leftover axis, which keeps the larger piece bigger.
+            ivec2 leftover = free_rect.size() - size;
+            irect2 right, bottom;
+            if (leftover.x < leftover.y)
+            {
+                right = ivec2(free_rect.a.x + size.x, free_rect.a.y).rect_size(ivec2(leftover.x, size.y));
+                bottom = ivec2(free_rect.a.x, free_rect.a.y + size.y).rect_size(ivec2(free_rect.size().x, leftover.y));
+            }
+            else
+            {
+                right = ivec2(free_rect.a.x + size.x, free_rect.a.y).rect_size(ivec2(leftover.x, free_rect.size().y));
+                bottom = ivec2(free_rect.a.x, free_rect.a.y + size.y).rect_size(ivec2(size.x, leftover.y));
+            }
+            if (right.has_area())
+                free_rects.push_back(right);
+            if (bottom.has_area())
+                free_rects.push_back(bottom);
+
+            used_area += (long long)size.x * size.y;
+            return free_rect.a;
+        }
+
+        // Frees a rect returned by `Allocate()`.
+        void Free(irect2 rect)
+        {
+            ASSERT(rect.has_area() && ivec2().rect_size(box_size).contains(rect), "Invalid rect.");
+            used_area -= (long long)rect.size().x * rect.size().y;
+            ASSERT(used_area >= 0, "Freed more than was allocated.");
+
+            // If everything is free, start from scratch to undo any fragmentation.
+            if (used_area == 0)
+            {
+                Clear();
+                return;
+            }
+
+            free_rects.push_back(rect);
+            MergeFreeRects();
+        }
+    };
+}
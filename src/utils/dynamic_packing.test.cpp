@@ -0,0 +1,44 @@
+#include "dynamic_packing.h"
+
+#include <vector>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("dynamic_packing")
+{
+    Packing::DynamicPacker packer(ivec2(64, 32));
+
+    // Fill the box with 8x8 rects, and check that they don't overlap.
+    std::vector<irect2> rects;
+    while (auto pos = packer.Allocate(ivec2(8)))
+    {
+        irect2 rect = pos->rect_size(ivec2(8));
+        REQUIRE(ivec2().rect_size(packer.Size()).contains(rect));
+        for (irect2 other : rects)
+            REQUIRE(!rect.touches(other));
+        rects.push_back(rect);
+    }
+    REQUIRE(rects.size() == 32);
+    REQUIRE(packer.UsedArea() == 64 * 32);
+    REQUIRE(!packer.Allocate(ivec2(1)));
+
+    // Free two neighboring rects, and allocate a rect that only fits into both of them together.
+    irect2 first = ivec2(0).rect_size(ivec2(8)), second = ivec2(8,0).rect_size(ivec2(8));
+    packer.Free(first);
+    packer.Free(second);
+    REQUIRE(!packer.Allocate(ivec2(17, 8)));
+    auto pos = packer.Allocate(ivec2(16, 8));
+    REQUIRE(pos);
+    REQUIRE(*pos == ivec2(0));
+
+    // Freeing everything restores the whole box.
+    packer.Free(pos->rect_size(ivec2(16, 8)));
+    for (irect2 rect : rects)
+    {
+        if (rect != first && rect != second)
+            packer.Free(rect);
+    }
+    REQUIRE(packer.UsedArea() == 0);
+    REQUIRE(packer.FreeRectCount() == 1);
+    REQUIRE(packer.Allocate(ivec2(64, 32)));
+}
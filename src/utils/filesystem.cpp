@@ -1,12 +1,21 @@
 #include "filesystem.h"
 
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string_view>
 #include <utility>
 
 #include <dirent.h>
 #include <sys/stat.h>
 
 #include "macros/finally.h"
+#include "stream/input.h"
+#include "stream/output.h"
+#include "stream/readonly_data.h"
+#include "stream/save_to_file.h"
 #include "strings/format.h"
+#include "utils/jobs.h"
 
 namespace Filesystem
 {
@@ -38,6 +47,8 @@ namespace Filesystem
         }
 
         ret.time_modified = info.st_mtime; // `struct stat` also contains last access time and last parameter change time, but we don't really need those.
+        if (ret.category == file)
+            ret.size = std::uint64_t(info.st_size);
 
         if (ok)
             *ok = true;
@@ -74,7 +85,9 @@ namespace Filesystem
         return ret;
     }
 
-    static TreeNode GetObjectTreeLow(const std::string &name, const std::string &path, int max_depth, bool *ok)
+    // If `cached` isn't null, it's the cached version of this node, possibly outdated. `cache_time` is the time when the cache was made.
+    // If `pool` isn't null, the entries of the directories are examined in parallel.
+    static TreeNode GetObjectTreeLow(const std::string &name, const std::string &path, int max_depth, const TreeNode *cached, std::time_t cache_time, Jobs::ThreadPool *pool, bool *ok)
     {
         if (ok)
             *ok = false;
@@ -91,28 +104,71 @@ namespace Filesystem
         ret.time_modified_recursive = ret.info.time_modified;
         if (ret.info.category == directory && max_depth != 0)
         {
-            std::vector<std::string> contents;
+            // The entries that need to be examined, and their cached versions (if any).
+            std::vector<std::pair<std::string, const TreeNode *>> entries;
 
-            bool directory_contents_ok;
-            contents = GetDirectoryContents(path, &directory_contents_ok);
-            (void)directory_contents_ok;
-            // Silently ignore the error if we can no longer access the directory.
-
-            for (const std::string &sub_name : contents)
+            // The times have a one second precision, so we can't trust the directories modified during the same second as the cache was made.
+            if (cached && cached->info.category == directory && cached->info.time_modified == ret.info.time_modified && ret.info.time_modified < cache_time)
+            {
+                // The directory didn't change, so neither did the list of its entries. Only the subdirectories need to be examined.
+                for (const TreeNode &sub_cached : cached->contents)
+                {
+                    if (sub_cached.info.category == directory)
+                        entries.emplace_back(sub_cached.name, &sub_cached);
+                    else
+                        ret.contents.push_back(sub_cached);
+                }
+            }
+            else
             {
-                if (sub_name == "." || sub_name == "..")
-                    continue;
+                std::map<std::string_view, const TreeNode *> cached_entries;
+                if (cached)
+                {
+                    for (const TreeNode &sub_cached : cached->contents)
+                        cached_entries.try_emplace(sub_cached.name, &sub_cached);
+                }
+
+                bool directory_contents_ok;
+                std::vector<std::string> contents = GetDirectoryContents(path, &directory_contents_ok);
+                (void)directory_contents_ok;
+                // Silently ignore the error if we can no longer access the directory.
 
+                for (std::string &sub_name : contents)
+                {
+                    if (sub_name == "." || sub_name == "..")
+                        continue;
+                    auto it = cached_entries.find(sub_name);
+                    entries.emplace_back(std::move(sub_name), it != cached_entries.end() ? it->second : nullptr);
+                }
+            }
+
+            std::vector<TreeNode> subtrees(entries.size());
+            auto ExamineEntry = [&](std::size_t i)
+            {
                 bool subtree_ok;
-                TreeNode subtree = GetObjectTreeLow(sub_name, path + '/' + sub_name, max_depth-1, &subtree_ok);
+                subtrees[i] = GetObjectTreeLow(entries[i].first, path + '/' + entries[i].first, max_depth-1, entries[i].second, cache_time, pool, &subtree_ok);
                 (void)subtree_ok;
                 // Silently ignore this entry if something goes wrong.
+            };
+            if (pool && subtrees.size() > 1)
+            {
+                Jobs::ParallelFor(*pool, 0, subtrees.size(), ExamineEntry);
+            }
+            else
+            {
+                for (std::size_t i = 0; i < subtrees.size(); i++)
+                    ExamineEntry(i);
+            }
 
+            ret.contents.reserve(ret.contents.size() + subtrees.size());
+            for (TreeNode &subtree : subtrees)
+                ret.contents.push_back(std::move(subtree));
+
+            for (const TreeNode &subtree : ret.contents)
+            {
                 std::time_t time_modified = subtree.time_modified_recursive;
                 if (time_modified > ret.time_modified_recursive)
                     ret.time_modified_recursive = time_modified;
-
-                ret.contents.push_back(std::move(subtree));
             }
         }
 
@@ -121,8 +177,128 @@ namespace Filesystem
         return ret;
     }
 
+    // The tree cache format: the magic, the format version (`uint32_t`), `max_depth` (`int32_t`), the time when the scan started (`int64_t`), then the root node.
+    // Each node is: the name (a size as `uint32_t`, then the bytes), the category (`uint8_t`), the modification time (`int64_t`), the size (`uint64_t`),
+    //   and for directories the number of the nested nodes (`uint32_t`) followed by them. All numbers are little-endian.
+    static constexpr std::string_view tree_cache_magic = "imp.ftre";
+    static constexpr std::uint32_t tree_cache_version = 1; // Increment when changing the format.
+
+    static void WriteTreeCacheNode(Stream::Output &output, const TreeNode &node)
+    {
+        output.WriteLittle<std::uint32_t>(node.name.size());
+        output.WriteString(node.name);
+        output.WriteLittle<std::uint8_t>(node.info.category);
+        output.WriteLittle<std::int64_t>(node.info.time_modified);
+        output.WriteLittle<std::uint64_t>(node.info.size);
+        if (node.info.category == directory)
+        {
+            output.WriteLittle<std::uint32_t>(node.contents.size());
+            for (const TreeNode &sub_node : node.contents)
+                WriteTreeCacheNode(output, sub_node);
+        }
+    }
+
+    [[nodiscard]] static TreeNode ReadTreeCacheNode(Stream::Input &input, const std::string *parent_path)
+    {
+        TreeNode ret;
+        std::uint32_t name_size = input.ReadLittle<std::uint32_t>();
+        if (name_size > input.RemainingBytes())
+            throw std::runtime_error(input.GetExceptionPrefix() + "String size is out of bounds.");
+        ret.name.resize(name_size);
+        input.Read(ret.name.data(), name_size);
+        ret.path = parent_path ? *parent_path + '/' + ret.name : ret.name;
+
+        std::uint8_t category = input.ReadLittle<std::uint8_t>();
+        if (category > other)
+            throw std::runtime_error(input.GetExceptionPrefix() + "Invalid object category.");
+        ret.info.category = ObjCategory(category);
+        ret.info.time_modified = std::time_t(input.ReadLittle<std::int64_t>());
+        ret.info.size = input.ReadLittle<std::uint64_t>();
+
+        ret.time_modified_recursive = ret.info.time_modified;
+        if (ret.info.category == directory)
+        {
+            std::uint32_t count = input.ReadLittle<std::uint32_t>();
+            if (count > input.RemainingBytes())
+                throw std::runtime_error(input.GetExceptionPrefix() + "Entry count is out of bounds.");
+            ret.contents.reserve(count);
+            for (std::uint32_t i = 0; i < count; i++)
+            {
+                ret.contents.push_back(ReadTreeCacheNode(input, &ret.path));
+                if (ret.contents.back().time_modified_recursive > ret.time_modified_recursive)
+                    ret.time_modified_recursive = ret.contents.back().time_modified_recursive;
+            }
+        }
+        return ret;
+    }
+
+    [[nodiscard]] static std::vector<std::uint8_t> SerializeTreeCache(const TreeNode &tree, int max_depth, std::time_t scan_time)
+    {
+        std::vector<std::uint8_t> ret;
+        Stream::Output output = Stream::Output::Container(ret);
+        output.WriteString(tree_cache_magic.data(), tree_cache_magic.size());
+        output.WriteLittle<std::uint32_t>(tree_cache_version);
+        output.WriteLittle<std::int32_t>(max_depth);
+        output.WriteLittle<std::int64_t>(scan_time);
+        WriteTreeCacheNode(output, tree);
+        output.Flush();
+        return ret;
+    }
+
     TreeNode GetObjectTree(const std::string &entry_name, int max_depth, bool *ok)
     {
-        return GetObjectTreeLow(entry_name, entry_name, max_depth, ok);
+        return GetObjectTreeLow(entry_name, entry_name, max_depth, nullptr, 0, nullptr, ok);
+    }
+
+    TreeNode GetObjectTree(const std::string &entry_name, int max_depth, const ScanParams &params, bool *ok)
+    {
+        if (params.cache_file.empty())
+            return GetObjectTreeLow(entry_name, entry_name, max_depth, nullptr, 0, params.pool, ok);
+
+        Stream::ReadOnlyData cache_data;
+        TreeNode cached;
+        std::time_t cache_time = 0;
+        bool have_cache = false;
+        bool cache_exists = false;
+        (void)GetObjectInfo(params.cache_file, &cache_exists);
+        if (cache_exists)
+        {
+            try
+            {
+                cache_data = Stream::ReadOnlyData(params.cache_file);
+                Stream::Input input(cache_data);
+                input.WantLocationStyle(Stream::byte_offset);
+                if (input.DiscardChars<Stream::if_present>(tree_cache_magic) && input.ReadLittle<std::uint32_t>() == tree_cache_version && input.ReadLittle<std::int32_t>() == max_depth)
+                {
+                    cache_time = std::time_t(input.ReadLittle<std::int64_t>());
+                    cached = ReadTreeCacheNode(input, nullptr);
+                    have_cache = cached.name == entry_name;
+                }
+            }
+            catch (...)
+            {
+                // The cache is broken, scan everything.
+            }
+        }
+
+        std::time_t scan_time = std::time(nullptr);
+        TreeNode ret = GetObjectTreeLow(entry_name, entry_name, max_depth, have_cache ? &cached : nullptr, cache_time, params.pool, ok);
+        if (ok && !*ok)
+            return ret;
+
+        std::vector<std::uint8_t> new_cache_data = SerializeTreeCache(ret, max_depth, scan_time);
+        if (!std::equal(new_cache_data.begin(), new_cache_data.end(), cache_data.begin(), cache_data.end()))
+        {
+            try
+            {
+                Stream::SaveFileAtomic(params.cache_file, new_cache_data);
+            }
+            catch (...)
+            {
+                // Failing to write the cache isn't fatal, we'll just scan everything next time.
+            }
+        }
+
+        return ret;
     }
 }
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <ctime>
 #include <string>
 #include <vector>
 
+namespace Jobs {class ThreadPool;}
+
 namespace Filesystem
 {
     enum ObjCategory {file, directory, other}; // Symlinks can't be detected due to MinGW-w64 `sys/stat.h` limitations.
@@ -12,6 +15,7 @@ namespace Filesystem
     {
         ObjCategory category = ObjCategory::other;
         std::time_t time_modified = 0; // Modification of files in nested directories doesn't affect this time.
+        std::uint64_t size = 0; // Only meaningful for files.
     };
 
     // Throws if the file or directory can't be accessed.
@@ -39,6 +43,22 @@ namespace Filesystem
     // Using a negative `max_depth` disables depth limit. But then a circular symlink might cause stack overflow.
     TreeNode GetObjectTree(const std::string &entry_name, int max_depth, bool *ok = nullptr);
 
+    struct ScanParams
+    {
+        // Optional. If not null, the directory entries are examined in parallel on this pool. This helps a lot on network drives and on Windows.
+        Jobs::ThreadPool *pool = nullptr;
+
+        // Optional. If not empty, the tree is cached in this file, and the next scans don't touch the entries of the directories
+        //   with unchanged modification times, except for the subdirectories. The cache is rewritten when the tree changes.
+        // Modifying a file in place doesn't change the modification time of its directory, so the cached `ObjInfo` of such files will be outdated.
+        //   Creating, removing, renaming or atomically replacing files is detected.
+        // Failing to read or write the cache isn't an error.
+        std::string cache_file;
+    };
+
+    // Same as above, but with extra parameters.
+    TreeNode GetObjectTree(const std::string &entry_name, int max_depth, const ScanParams &params, bool *ok = nullptr);
+
     template <typename F> void ForEachObject(const TreeNode &tree, F &&func) // `func` should be `void func(const TreeNode &node)`.
     {
         func(tree);
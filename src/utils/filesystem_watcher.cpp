@@ -0,0 +1,362 @@
+#include "filesystem_watcher.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+#include "program/platform.h"
+#include "strings/format.h"
+#include "utils/filesystem.h"
+
+#if IMP_PLATFORM_IS(windows)
+#define IMP_FILESYSTEM_WATCHER_MODE_windows
+#include <filesystem>
+#include <windows.h>
+#elif IMP_PLATFORM_IS(linux) || IMP_PLATFORM_IS(android)
+#define IMP_FILESYSTEM_WATCHER_MODE_inotify
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#define IMP_FILESYSTEM_WATCHER_MODE_polling
+#endif
+
+namespace Filesystem
+{
+    // Returns the files in `dir_name` (recursively), with the paths relative to it, and their modification times.
+    [[nodiscard]] static std::map<std::string, std::time_t> ScanFiles(const std::string &dir_name, int max_depth)
+    {
+        std::map<std::string, std::time_t> ret;
+        bool ok;
+        TreeNode tree = GetObjectTree(dir_name, max_depth < 0 ? -1 : max_depth + 1, &ok);
+        if (!ok)
+            return ret;
+        ForEachObject(tree, [&](const TreeNode &node)
+        {
+            if (node.info.category == file && node.path.size() > dir_name.size())
+                ret.try_emplace(node.path.substr(dir_name.size() + 1), node.info.time_modified);
+        });
+        return ret;
+    }
+
+    // Returns the depth of a relative path, i.e. the number of directories in it.
+    [[nodiscard, maybe_unused]] static int PathDepth(const std::string &path)
+    {
+        return int(std::count(path.begin(), path.end(), '/'));
+    }
+
+    struct Watcher::Data
+    {
+        std::string dir_name;
+        int max_depth = -1;
+
+        #if defined(IMP_FILESYSTEM_WATCHER_MODE_inotify)
+        int fd = -1;
+        std::map<int, std::string> watched_dirs; // Maps the watch descriptors to the relative paths of the directories.
+        std::set<std::string> known_files; // The relative paths of the files we know about, to report them when their directory is removed or moved out.
+
+        // Starts watching a directory and its subdirectories. Adds all files in them to `files`.
+        void WatchDirectory(const std::string &rel_path, std::vector<std::string> &files)
+        {
+            std::string path = rel_path.empty() ? dir_name : dir_name + '/' + rel_path;
+            int wd = inotify_add_watch(fd, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ONLYDIR);
+            if (wd == -1)
+                return; // Silently ignore the directories we can't access, like `GetObjectTree()` does.
+            watched_dirs.insert_or_assign(wd, rel_path);
+
+            bool ok;
+            std::vector<std::string> contents = GetDirectoryContents(path, &ok);
+            for (const std::string &name : contents)
+            {
+                if (name == "." || name == "..")
+                    continue;
+                std::string sub_rel_path = rel_path.empty() ? name : rel_path + '/' + name;
+                ObjInfo info = GetObjectInfo(path + '/' + name, &ok);
+                if (!ok)
+                    continue;
+                if (info.category == file)
+                {
+                    known_files.insert(sub_rel_path);
+                    files.push_back(std::move(sub_rel_path));
+                }
+                else if (info.category == directory && (max_depth < 0 || PathDepth(sub_rel_path) < max_depth))
+                    WatchDirectory(sub_rel_path, files);
+            }
+        }
+
+        // Stops watching a directory that was removed or moved out, and its subdirectories. Adds the files that were in them to `files`.
+        void ForgetDirectory(const std::string &rel_path, std::vector<std::string> &files)
+        {
+            std::string prefix = rel_path + '/';
+            for (auto it = known_files.lower_bound(prefix); it != known_files.end() && it->starts_with(prefix);)
+            {
+                files.push_back(*it);
+                it = known_files.erase(it);
+            }
+
+            // If the directory was moved out, the watches are still active, and would report its new contents under the old path.
+            std::erase_if(watched_dirs, [&](const auto &elem)
+            {
+                if (elem.second != rel_path && !elem.second.starts_with(prefix))
+                    return false;
+                inotify_rm_watch(fd, elem.first);
+                return true;
+            });
+        }
+        #elif defined(IMP_FILESYSTEM_WATCHER_MODE_windows)
+        HANDLE dir_handle = INVALID_HANDLE_VALUE;
+        OVERLAPPED overlapped{};
+        std::vector<DWORD> buffer = std::vector<DWORD>(16384); // `ReadDirectoryChangesW()` wants it to be `DWORD`-aligned.
+        bool pending = false;
+
+        // Returns false on failure.
+        [[nodiscard]] bool StartRead()
+        {
+            pending = ReadDirectoryChangesW(dir_handle, buffer.data(), DWORD(buffer.size() * sizeof(DWORD)), TRUE,
+                FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+                nullptr, &overlapped, nullptr);
+            return pending;
+        }
+        #else
+        std::map<std::string, std::time_t> files;
+        #endif
+
+        Data(std::string new_dir_name, int new_max_depth) : dir_name(std::move(new_dir_name)), max_depth(new_max_depth)
+        {
+            while (dir_name.size() > 1 && dir_name.back() == '/')
+                dir_name.pop_back();
+
+            if (GetObjectInfo(dir_name).category != directory)
+                throw std::runtime_error(FMT("Unable to watch `{}`, because it's not a directory.", dir_name));
+
+            #if defined(IMP_FILESYSTEM_WATCHER_MODE_inotify)
+            fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (fd == -1)
+                throw std::runtime_error(FMT("Unable to watch `{}`: `inotify_init1()` failed.", dir_name));
+            std::vector<std::string> files;
+            WatchDirectory("", files);
+            #elif defined(IMP_FILESYSTEM_WATCHER_MODE_windows)
+            dir_handle = CreateFileW(std::filesystem::u8path(dir_name).c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+            if (dir_handle == INVALID_HANDLE_VALUE)
+                throw std::runtime_error(FMT("Unable to watch `{}`: can't open the directory.", dir_name));
+            overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            if (!overlapped.hEvent || !StartRead())
+            {
+                if (overlapped.hEvent)
+                    CloseHandle(overlapped.hEvent);
+                CloseHandle(dir_handle);
+                throw std::runtime_error(FMT("Unable to watch `{}`: `ReadDirectoryChangesW()` failed.", dir_name));
+            }
+            #else
+            files = ScanFiles(dir_name, max_depth);
+            #endif
+        }
+
+        Data(const Data &) = delete;
+        Data &operator=(const Data &) = delete;
+
+        ~Data()
+        {
+            #if defined(IMP_FILESYSTEM_WATCHER_MODE_inotify)
+            close(fd);
+            #elif defined(IMP_FILESYSTEM_WATCHER_MODE_windows)
+            if (pending)
+            {
+                // Must wait for the cancellation, since the OS writes to `buffer` and `overlapped`.
+                DWORD bytes;
+                if (CancelIoEx(dir_handle, &overlapped) || GetLastError() != ERROR_NOT_FOUND)
+                    GetOverlappedResult(dir_handle, &overlapped, &bytes, TRUE);
+            }
+            CloseHandle(overlapped.hEvent);
+            CloseHandle(dir_handle);
+            #endif
+        }
+
+        // Returns all existing files. This is used when the OS drops the notifications.
+        [[nodiscard]] std::vector<std::string> AllFiles() const
+        {
+            std::vector<std::string> ret;
+            for (auto &elem : ScanFiles(dir_name, max_depth))
+                ret.push_back(elem.first);
+            return ret;
+        }
+    };
+
+    Watcher::Watcher() {}
+
+    Watcher::Watcher(std::string dir_name, int max_depth) : data(std::make_unique<Data>(std::move(dir_name), max_depth)) {}
+
+    Watcher::Watcher(Watcher &&other) noexcept : data(std::move(other.data)) {}
+
+    Watcher &Watcher::operator=(Watcher other) noexcept
+    {
+        std::swap(data, other.data);
+        return *this;
+    }
+
+    Watcher::~Watcher() = default;
+
+    std::vector<std::string> Watcher::GetChangedFiles()
+    {
+        std::vector<std::string> ret;
+        if (!data)
+            return ret;
+
+        #if defined(IMP_FILESYSTEM_WATCHER_MODE_inotify)
+        bool overflow = false;
+        alignas(inotify_event) char buffer[4096];
+        while (true)
+        {
+            ssize_t size = read(data->fd, buffer, sizeof buffer);
+            if (size <= 0)
+                break; // `EAGAIN` means there's nothing more to read.
+
+            for (ssize_t offset = 0; offset < size;)
+            {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+                offset += ssize_t(sizeof(inotify_event) + event->len);
+
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    overflow = true;
+                    continue;
+                }
+                if (event->mask & IN_IGNORED)
+                {
+                    data->watched_dirs.erase(event->wd); // The directory was removed.
+                    continue;
+                }
+
+                auto it = data->watched_dirs.find(event->wd);
+                if (it == data->watched_dirs.end() || event->len == 0)
+                    continue;
+                std::string path = it->second.empty() ? std::string(event->name) : it->second + '/' + event->name;
+
+                if (event->mask & IN_ISDIR)
+                {
+                    // A directory was removed or moved out, report everything that was in it.
+                    if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                        data->ForgetDirectory(path, ret);
+                    // A directory was created or moved in, watch it and report everything in it.
+                    if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && (data->max_depth < 0 || PathDepth(path) < data->max_depth))
+                        data->WatchDirectory(path, ret);
+                }
+                else
+                {
+                    if (event->mask & (IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO))
+                        data->known_files.insert(path);
+                    else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                        data->known_files.erase(path);
+
+                    // Not reporting `IN_CREATE` for files, since it's followed by `IN_CLOSE_WRITE` when the file is actually written.
+                    if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE))
+                        ret.push_back(std::move(path));
+                }
+            }
+        }
+        if (overflow)
+        {
+            // Re-adding the existing watches is harmless, and this catches the directories we've missed.
+            ret.clear();
+            data->known_files.clear();
+            data->WatchDirectory("", ret);
+        }
+        #elif defined(IMP_FILESYSTEM_WATCHER_MODE_windows)
+        bool overflow = false;
+        if (!data->pending)
+        {
+            // The last `StartRead()` failed, so we don't know what changed.
+            overflow = true;
+            (void)data->StartRead();
+        }
+        while (data->pending)
+        {
+            DWORD size = 0;
+            if (!GetOverlappedResult(data->dir_handle, &data->overlapped, &size, FALSE))
+            {
+                if (GetLastError() == ERROR_IO_INCOMPLETE)
+                    break; // Nothing more to read.
+                overflow = true;
+            }
+            else if (size == 0)
+            {
+                overflow = true; // The buffer was too small for all the changes.
+            }
+            else
+            {
+                const std::uint8_t *cur = reinterpret_cast<const std::uint8_t *>(data->buffer.data());
+                while (true)
+                {
+                    const FILE_NOTIFY_INFORMATION *info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(cur);
+                    std::u8string u8_path = std::filesystem::path(std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR))).generic_u8string();
+                    std::string path(u8_path.begin(), u8_path.end());
+
+                    if (data->max_depth < 0 || PathDepth(path) <= data->max_depth)
+                    {
+                        if (info->Action == FILE_ACTION_REMOVED || info->Action == FILE_ACTION_RENAMED_OLD_NAME)
+                        {
+                            ret.push_back(std::move(path)); // Can't tell if this was a directory or not.
+                        }
+                        else
+                        {
+                            bool ok;
+                            ObjInfo obj_info = GetObjectInfo(data->dir_name + '/' + path, &ok);
+                            if (ok && obj_info.category == file)
+                            {
+                                ret.push_back(std::move(path));
+                            }
+                            else if (ok && obj_info.category == directory && info->Action != FILE_ACTION_MODIFIED && (data->max_depth < 0 || PathDepth(path) < data->max_depth))
+                            {
+                                // A directory was created or moved in, report everything in it. Modified directories only mean that their contents changed.
+                                for (auto &elem : ScanFiles(data->dir_name + '/' + path, data->max_depth < 0 ? -1 : data->max_depth - PathDepth(path) - 1))
+                                    ret.push_back(path + '/' + elem.first);
+                            }
+                        }
+                    }
+
+                    if (info->NextEntryOffset == 0)
+                        break;
+                    cur += info->NextEntryOffset;
+                }
+            }
+
+            if (!data->StartRead())
+                overflow = true; // Will try again on the next call.
+        }
+        if (overflow)
+            ret = data->AllFiles();
+        #else
+        std::map<std::string, std::time_t> new_files = ScanFiles(data->dir_name, data->max_depth);
+        for (const auto &[path, time] : new_files)
+        {
+            auto it = data->files.find(path);
+            if (it == data->files.end() || it->second != time)
+                ret.push_back(path);
+        }
+        for (const auto &elem : data->files)
+        {
+            if (!new_files.contains(elem.first))
+                ret.push_back(elem.first);
+        }
+        data->files = std::move(new_files);
+        #endif
+
+        std::sort(ret.begin(), ret.end());
+        ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+        return ret;
+    }
+
+    bool Watcher::UsesPolling()
+    {
+        #if defined(IMP_FILESYSTEM_WATCHER_MODE_polling)
+        return true;
+        #else
+        return false;
+        #endif
+    }
+}
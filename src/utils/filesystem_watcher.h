@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Filesystem
+{
+    // Watches a directory recursively, and reports which files were changed.
+    // Uses inotify on Linux and Android, `ReadDirectoryChangesW()` on Windows, and re-scans the whole tree on the other platforms.
+    // When re-scanning, the changes are detected by the modification times, which only have a one second precision.
+    // This is much cheaper than re-scanning the tree with `GetObjectTree()`, and reports exactly which files to reload.
+    // Usage:
+    //     Filesystem::Watcher watcher("assets/images");
+    //     // Once per frame, or less often:
+    //     for (const std::string &path : watcher.GetChangedFiles())
+    //         ...; // E.g. `path == "ui/button.png"`, pass it to `Graphics::GlobalData::Reload()` without the extension.
+    class Watcher
+    {
+        struct Data;
+        std::unique_ptr<Data> data;
+
+      public:
+        // Constructs a null watcher.
+        Watcher();
+
+        // Starts watching `dir_name`. Throws if it can't be accessed.
+        // A negative `max_depth` disables the depth limit, zero watches only the files directly in `dir_name`.
+        explicit Watcher(std::string dir_name, int max_depth = -1);
+
+        Watcher(Watcher &&other) noexcept;
+        Watcher &operator=(Watcher other) noexcept;
+        ~Watcher();
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(data);
+        }
+
+        // Returns the files that were created, modified, removed or renamed since the last call (or since the construction). Never blocks.
+        // The paths are relative to `dir_name`, use `/` as the separator, and have no duplicates. They are sorted.
+        // Files that were removed are reported too, so check that they exist if you care.
+        // If the OS drops the notifications (e.g. when too many files change at once), reports all existing files.
+        [[nodiscard]] std::vector<std::string> GetChangedFiles();
+
+        // Returns true if this platform has no change notifications, and `GetChangedFiles()` re-scans the whole tree.
+        [[nodiscard]] static bool UsesPolling();
+    };
+}
@@ -2,9 +2,14 @@
 
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <initializer_list>
+#include <span>
+#include <string_view>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 
 #include "meta/common.h"
@@ -43,6 +48,110 @@ namespace Hash
         return hash;
     }
 
+    // Multiplies two numbers into 128 bits, and xors the two halves.
+    // This is the mixing function from wyhash, it's fast and well-distributed. `std::hash` for vectors in `mat.h` uses the same function.
+    [[nodiscard]] constexpr std::uint64_t Mix(std::uint64_t a, std::uint64_t b)
+    {
+        #ifdef __SIZEOF_INT128__
+        __extension__ using u128 = unsigned __int128;
+        u128 r = u128(a) * b;
+        return std::uint64_t(r) ^ std::uint64_t(r >> 64);
+        #else
+        std::uint64_t a_lo = std::uint32_t(a), a_hi = a >> 32, b_lo = std::uint32_t(b), b_hi = b >> 32;
+        std::uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+        std::uint64_t cross = (lo_lo >> 32) + std::uint32_t(hi_lo) + lo_hi;
+        return ((cross << 32) | std::uint32_t(lo_lo)) ^ (hi_hi + (hi_lo >> 32) + (cross >> 32));
+        #endif
+    }
+
+    namespace impl
+    {
+        inline constexpr std::uint64_t wyhash_secret[4] = {0x2d358dccaa6c78a5, 0x8bb84b93962eacc9, 0x4b33a62ed433d4a3, 0x4d5a2da51de1aa47};
+
+        [[nodiscard]] inline std::uint64_t Read8(const unsigned char *p) {std::uint64_t ret; std::memcpy(&ret, p, 8); return ret;}
+        [[nodiscard]] inline std::uint64_t Read4(const unsigned char *p) {std::uint32_t ret; std::memcpy(&ret, p, 4); return ret;}
+    }
+
+    // Hashes a byte range, using the wyhash algorithm (the "final4" version) by Wang Yi.
+    // Much faster than hashing the bytes one by one, or than `std::hash<std::string_view>` on some standard libraries.
+    // The result depends on the byte order of the platform, so don't store it.
+    [[nodiscard]] inline std::uint64_t Bytes(const void *data, std::size_t size, std::uint64_t seed = 0)
+    {
+        const std::uint64_t *secret = impl::wyhash_secret;
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+
+        seed ^= Mix(seed ^ secret[0], secret[1]);
+        std::uint64_t a = 0, b = 0;
+
+        if (size <= 16)
+        {
+            if (size >= 4)
+            {
+                std::size_t offset = (size >> 3) << 2;
+                a = (impl::Read4(p) << 32) | impl::Read4(p + offset);
+                b = (impl::Read4(p + size - 4) << 32) | impl::Read4(p + size - 4 - offset);
+            }
+            else if (size > 0)
+            {
+                a = std::uint64_t(p[0]) << 16 | std::uint64_t(p[size >> 1]) << 8 | p[size - 1];
+            }
+        }
+        else
+        {
+            std::size_t i = size;
+            if (i > 48)
+            {
+                std::uint64_t seed1 = seed, seed2 = seed;
+                do
+                {
+                    seed = Mix(impl::Read8(p) ^ secret[1], impl::Read8(p + 8) ^ seed);
+                    seed1 = Mix(impl::Read8(p + 16) ^ secret[2], impl::Read8(p + 24) ^ seed1);
+                    seed2 = Mix(impl::Read8(p + 32) ^ secret[3], impl::Read8(p + 40) ^ seed2);
+                    p += 48;
+                    i -= 48;
+                }
+                while (i > 48);
+                seed ^= seed1 ^ seed2;
+            }
+            while (i > 16)
+            {
+                seed = Mix(impl::Read8(p) ^ secret[1], impl::Read8(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = impl::Read8(p + i - 16);
+            b = impl::Read8(p + i - 8);
+        }
+
+        a ^= secret[1];
+        b ^= seed;
+        // This is `Mix()` without the final xor.
+        std::uint64_t lo = a * b;
+        std::uint64_t hi = Mix(a, b) ^ lo;
+        return Mix(lo ^ secret[0] ^ size, hi ^ secret[1]);
+    }
+
+    // Hashes the contents of a span of trivially copyable objects.
+    template <typename T> requires std::is_trivially_copyable_v<T>
+    [[nodiscard]] std::uint64_t Bytes(std::span<const T> span, std::uint64_t seed = 0)
+    {
+        return Bytes(span.data(), span.size_bytes(), seed);
+    }
+
+    // Hashes a string.
+    [[nodiscard]] inline std::uint64_t String(std::string_view str, std::uint64_t seed = 0)
+    {
+        return Bytes(str.data(), str.size(), seed);
+    }
+
+    // A transparent string hasher for hash maps, using `Hash::String()`.
+    struct StringHasher
+    {
+        using is_transparent = void;
+
+        [[nodiscard]] std::size_t operator()(std::string_view str) const {return std::size_t(String(str));}
+    };
+
     // A functor that extends `std::hash` with more supported types.
     template <typename T = void>
     struct Hasher {};
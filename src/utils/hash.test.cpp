@@ -0,0 +1,44 @@
+#include "hash.h"
+
+#include <string>
+#include <unordered_set>
+
+#include <doctest/doctest.h>
+
+#include "utils/mat.h"
+
+TEST_CASE("hash.bytes")
+{
+    // Every length takes a different code path, make sure they all depend on every byte.
+    std::string str(100, 'a');
+    std::unordered_set<std::uint64_t> hashes;
+    for (std::size_t len = 0; len <= str.size(); len++)
+    {
+        std::string_view view(str.data(), len);
+        REQUIRE(hashes.insert(Hash::String(view)).second);
+        for (std::size_t i = 0; i < len; i++)
+        {
+            std::string copy(view);
+            copy[i] = 'b';
+            REQUIRE(Hash::String(copy) != Hash::String(view));
+        }
+    }
+
+    CHECK(Hash::String("foo") == Hash::String(std::string("foo")));
+    CHECK(Hash::String("foo", 1) != Hash::String("foo", 2));
+}
+
+TEST_CASE("hash.vectors")
+{
+    // No collisions on a grid, and the low bits are distributed like random numbers.
+    std::unordered_set<std::size_t> hashes, low_bits;
+    for (ivec2 pos : ivec2(-50) <= vector_range < ivec2(50))
+    {
+        std::size_t hash = std::hash<ivec2>{}(pos);
+        REQUIRE(hashes.insert(hash).second);
+        low_bits.insert(hash & 0xffff);
+    }
+    CHECK(low_bits.size() > 9000); // About 9270 is expected for 10000 random numbers.
+
+    CHECK(std::hash<fvec3>{}(fvec3(1, 2, 3)) != std::hash<fvec3>{}(fvec3(3, 2, 1)));
+}
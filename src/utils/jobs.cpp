@@ -0,0 +1,288 @@
+#include "jobs.h"
+
+#include "program/errors.h"
+#include "program/platform.h"
+
+namespace Jobs
+{
+    namespace
+    {
+        // The pool and the queue index of the current worker thread, if any.
+        thread_local const ThreadPool *current_pool = nullptr;
+        thread_local std::size_t current_queue_index = 0;
+    }
+
+    bool Counter::Finish(std::exception_ptr job_exception)
+    {
+        std::vector<Continuation> ready;
+        bool is_last;
+
+        {
+            std::lock_guard lock(mutex);
+            if (job_exception && !exception)
+                exception = job_exception;
+
+            is_last = pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+            if (is_last)
+            {
+                ready = std::move(continuations);
+                continuations.clear();
+            }
+        }
+
+        // Not touching `*this` below this point, since `Wait()` can return and destroy the counter as soon as the lock is released.
+        for (Continuation &continuation : ready)
+            continuation.pool->Submit(*continuation.counter, std::move(continuation.job));
+        return is_last;
+    }
+
+    std::size_t ThreadPool::CurrentQueueIndex() const
+    {
+        if (current_pool == this)
+            return current_queue_index;
+        else
+            return state->queues.size() - 1;
+    }
+
+    void ThreadPool::Push(Job job)
+    {
+        Queue &queue = *state->queues[CurrentQueueIndex()];
+        {
+            std::lock_guard lock(queue.mutex);
+            queue.jobs.push_back(std::move(job));
+        }
+
+        state->num_queued.fetch_add(1, std::memory_order_release);
+        {
+            // Lock to avoid racing with a thread that's about to sleep.
+            std::lock_guard lock(state->sleep_mutex);
+        }
+        // Not `notify_one()`, since it could wake a thread in `Wait()` that doesn't care.
+        state->sleep_cond.notify_all();
+    }
+
+    void ThreadPool::WakeAll()
+    {
+        {
+            std::lock_guard lock(state->sleep_mutex);
+        }
+        state->sleep_cond.notify_all();
+    }
+
+    void ThreadPool::FinishJob(Counter &counter, std::exception_ptr exception)
+    {
+        // If this was the last job of the counter, wake the threads waiting for it.
+        if (counter.Finish(std::move(exception)))
+            WakeAll();
+    }
+
+    void ThreadPool::Execute(Job &job)
+    {
+        std::exception_ptr exception;
+        try
+        {
+            job.func();
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+        job.func = nullptr; // Destroy the captures before reporting the completion.
+        FinishJob(*job.counter, std::move(exception));
+    }
+
+    bool ThreadPool::TryRunOneJob(std::size_t own_queue)
+    {
+        if (state->num_queued.load(std::memory_order_acquire) == 0)
+            return false;
+
+        Job job;
+        bool found = false;
+
+        // Our own queue, from the back.
+        {
+            Queue &queue = *state->queues[own_queue];
+            std::lock_guard lock(queue.mutex);
+            if (!queue.jobs.empty())
+            {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+                found = true;
+            }
+        }
+
+        // Steal from the other queues, from the front.
+        for (std::size_t i = 1; !found && i < state->queues.size(); i++)
+        {
+            Queue &queue = *state->queues[(own_queue + i) % state->queues.size()];
+            std::lock_guard lock(queue.mutex);
+            if (!queue.jobs.empty())
+            {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+                found = true;
+            }
+        }
+
+        if (!found)
+            return false;
+
+        state->num_queued.fetch_sub(1, std::memory_order_relaxed);
+        Execute(job);
+        return true;
+    }
+
+    void ThreadPool::WorkerLoop(std::size_t index)
+    {
+        current_pool = this;
+        current_queue_index = index;
+
+        while (true)
+        {
+            if (TryRunOneJob(index))
+                continue;
+
+            std::unique_lock lock(state->sleep_mutex);
+            state->sleep_cond.wait(lock, [&]{return state->stop || state->num_queued.load(std::memory_order_acquire) > 0;});
+            if (state->stop)
+                return;
+        }
+    }
+
+    ThreadPool::ThreadPool(int num_workers)
+    {
+        state->main_thread_id = std::this_thread::get_id();
+
+        #if IMP_PLATFORM_IS(emscripten) && !defined(__EMSCRIPTEN_PTHREADS__)
+        num_workers = 0;
+        #else
+        if (num_workers <= 0)
+            num_workers = std::max(1, int(std::thread::hardware_concurrency())) - 1;
+        #endif
+
+        state->queues.reserve(std::size_t(num_workers) + 1);
+        for (int i = 0; i <= num_workers; i++)
+            state->queues.push_back(std::make_unique<Queue>());
+
+        state->threads.reserve(std::size_t(num_workers));
+        for (int i = 0; i < num_workers; i++)
+            state->threads.emplace_back([this, i]{WorkerLoop(std::size_t(i));});
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard lock(state->sleep_mutex);
+            state->stop = true;
+        }
+        state->sleep_cond.notify_all();
+        state->threads.clear(); // Join.
+    }
+
+    void ThreadPool::Submit(Counter &counter, std::function<void()> func)
+    {
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        Job job{.counter = &counter, .func = std::move(func)};
+
+        if (state->threads.empty())
+            Execute(job); // No workers, run immediately.
+        else
+            Push(std::move(job));
+    }
+
+    void ThreadPool::SubmitAfter(Counter &dependency, Counter &counter, std::function<void()> func)
+    {
+        {
+            std::lock_guard lock(dependency.mutex);
+            if (!dependency.IsDone())
+            {
+                // Make `counter` wait for this job right away, even though it's not submitted yet.
+                // `Submit()` will increment it again, so we decrement it in the continuation.
+                counter.pending.fetch_add(1, std::memory_order_relaxed);
+                dependency.continuations.push_back({.pool = this, .counter = &counter, .job = [this, &counter, func = std::move(func)]() mutable
+                {
+                    // Let the exceptions propagate normally, but release the extra reference in any case.
+                    struct Guard
+                    {
+                        ThreadPool &pool;
+                        Counter &counter;
+                        ~Guard() {pool.FinishJob(counter, nullptr);}
+                    };
+                    Guard guard{*this, counter};
+                    func();
+                }});
+                return;
+            }
+        }
+
+        Submit(counter, std::move(func));
+    }
+
+    void ThreadPool::SubmitToMainThread(Counter &counter, std::function<void()> func)
+    {
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard lock(state->main_thread_queue.mutex);
+            state->main_thread_queue.jobs.push_back({.counter = &counter, .func = std::move(func)});
+        }
+        state->num_main_thread_queued.fetch_add(1, std::memory_order_release);
+        WakeAll(); // In case the main thread is in `Wait()`.
+    }
+
+    void ThreadPool::RunMainThreadJobs()
+    {
+        ASSERT(IsMainThread(), "`RunMainThreadJobs()` must be called on the main thread.");
+
+        while (true)
+        {
+            Job job;
+            {
+                std::lock_guard lock(state->main_thread_queue.mutex);
+                if (state->main_thread_queue.jobs.empty())
+                    return;
+                job = std::move(state->main_thread_queue.jobs.front());
+                state->main_thread_queue.jobs.pop_front();
+            }
+            state->num_main_thread_queued.fetch_sub(1, std::memory_order_relaxed);
+            Execute(job);
+        }
+    }
+
+    void ThreadPool::Wait(Counter &counter)
+    {
+        std::size_t own_queue = CurrentQueueIndex();
+        bool is_main_thread = IsMainThread();
+
+        while (!counter.IsDone())
+        {
+            if (is_main_thread)
+                RunMainThreadJobs();
+
+            if (TryRunOneJob(own_queue))
+                continue;
+
+            // Nothing to run, the remaining jobs are running on other threads. Sleep until they finish, or until there's more work to help with.
+            std::unique_lock lock(state->sleep_mutex);
+            state->sleep_cond.wait(lock, [&]
+            {
+                return counter.IsDone() || state->num_queued.load(std::memory_order_acquire) > 0 ||
+                    (is_main_thread && state->num_main_thread_queued.load(std::memory_order_acquire) > 0);
+            });
+        }
+
+        // Make sure the last `Finish()` no longer touches the counter, and take the exception.
+        std::exception_ptr exception;
+        {
+            std::lock_guard lock(counter.mutex);
+            exception = std::exchange(counter.exception, nullptr);
+        }
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+
+    ThreadPool &GlobalPool()
+    {
+        static ThreadPool ret;
+        return ret;
+    }
+}
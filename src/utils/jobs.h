@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A thread pool with work stealing, meant to be shared by everything that wants to run work in parallel,
+//   instead of every subsystem spawning its own threads (which oversubscribes the CPU when several of them run at once).
+//
+// Usage:
+//     Jobs::ThreadPool &pool = Jobs::GlobalPool();
+//
+//     Jobs::Counter counter;
+//     pool.Submit(counter, []{...});
+//     pool.Submit(counter, []{...});
+//     pool.SubmitAfter(counter, other_counter, []{...}); // Runs after all jobs of `counter` finish.
+//     pool.Wait(counter); // Runs the pending jobs on this thread while waiting. Rethrows the first exception thrown by the jobs.
+//
+//     Jobs::ParallelFor(pool, 0, n, [&](std::size_t i){...});
+//
+//     pool.SubmitToMainThread(counter, []{...}); // E.g. for the GL/AL calls. Runs in `RunMainThreadJobs()`, or when the main thread `Wait()`s.
+//     GLuint tex = Jobs::RunOnMainThread(pool, [&]{return ...;}); // Same, but blocks until it's done.
+//
+// Every worker has its own deque of jobs. A worker takes the jobs from the back of its own deque (LIFO, this keeps the recently touched data in the cache),
+//   and when it runs out of them, it steals from the front of the other deques (FIFO, this takes the largest remaining chunks of work).
+// The jobs submitted from outside the workers go to a separate shared queue.
+// The deques are protected by mutexes rather than being lock-free. The jobs are expected to be coarse enough for this to not matter.
+//
+// On Emscripten without pthreads, the pool has no workers, and `Submit()` runs the jobs immediately.
+// On Emscripten with pthreads (see the `release_web_mt` mode), the WebGL context belongs to the browser main thread, so the workers must use `RunOnMainThread()` for the GL calls.
+
+namespace Jobs
+{
+    class ThreadPool;
+
+    // Tracks a group of jobs. Must outlive them, so call `ThreadPool::Wait()` before destroying it.
+    // A counter can be reused after waiting for it.
+    class Counter
+    {
+        friend ThreadPool;
+
+        struct Continuation
+        {
+            ThreadPool *pool = nullptr;
+            Counter *counter = nullptr;
+            std::function<void()> job;
+        };
+
+        std::atomic<std::size_t> pending{0};
+
+        // Protects the fields below. Also `Wait()` locks it before returning, to make sure that nobody is touching this counter anymore.
+        std::mutex mutex;
+        std::exception_ptr exception;
+        std::vector<Continuation> continuations;
+
+        // Marks one job as finished, possibly with an exception. Returns true if it was the last pending job.
+        bool Finish(std::exception_ptr job_exception);
+
+      public:
+        Counter() {}
+        Counter(const Counter &) = delete;
+        Counter &operator=(const Counter &) = delete;
+        ~Counter() {}
+
+        // True if all jobs of this counter have finished.
+        [[nodiscard]] bool IsDone() const
+        {
+            return pending.load(std::memory_order_acquire) == 0;
+        }
+    };
+
+    class ThreadPool
+    {
+        struct Job
+        {
+            Counter *counter = nullptr;
+            std::function<void()> func;
+        };
+
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+        };
+
+        struct State
+        {
+            // One queue per worker, and the last one is for the jobs submitted from outside.
+            std::vector<std::unique_ptr<Queue>> queues;
+            Queue main_thread_queue;
+            std::thread::id main_thread_id;
+
+            // The number of jobs in `queues` (not counting `main_thread_queue`). The workers sleep when this is zero.
+            std::atomic<std::size_t> num_queued{0};
+            // The number of jobs in `main_thread_queue`.
+            std::atomic<std::size_t> num_main_thread_queued{0};
+            // The sleeping workers and the threads in `Wait()` wait on this.
+            std::mutex sleep_mutex;
+            std::condition_variable sleep_cond;
+            bool stop = false; // Protected by `sleep_mutex`.
+
+            std::vector<std::jthread> threads;
+        };
+        std::unique_ptr<State> state = std::make_unique<State>();
+
+        // Returns the index of the queue belonging to the current thread, or the index of the shared queue if it's not our worker.
+        [[nodiscard]] std::size_t CurrentQueueIndex() const;
+
+        void Push(Job job);
+        void Execute(Job &job);
+        void FinishJob(Counter &counter, std::exception_ptr exception);
+        void WakeAll();
+
+        // Runs one job, preferably from the queue number `own_queue`. Returns false if there's nothing to run.
+        bool TryRunOneJob(std::size_t own_queue);
+
+        void WorkerLoop(std::size_t index);
+
+      public:
+        // Creates the specified number of worker threads. If it's zero or negative, uses one less than `std::thread::hardware_concurrency()`,
+        //   since the thread calling `Wait()` also runs the jobs.
+        // The thread calling the constructor is considered the main thread, see `SubmitToMainThread()`.
+        explicit ThreadPool(int num_workers = 0);
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        // Waits for the workers to finish the current jobs. The remaining queued jobs are discarded, so you should `Wait()` for them first.
+        ~ThreadPool();
+
+        // The number of worker threads, not counting the threads that call `Wait()`.
+        [[nodiscard]] int NumWorkers() const
+        {
+            return int(state->threads.size());
+        }
+        // The number of threads that can run jobs at once, including the one calling `Wait()`.
+        [[nodiscard]] int Concurrency() const
+        {
+            return NumWorkers() + 1;
+        }
+
+        [[nodiscard]] bool IsMainThread() const
+        {
+            return std::this_thread::get_id() == state->main_thread_id;
+        }
+
+        // Queues a job. It runs on an arbitrary thread.
+        // If the job throws, the exception is rethrown by `Wait(counter)` (only the first one per counter is kept).
+        void Submit(Counter &counter, std::function<void()> func);
+
+        // Queues a job that starts after all jobs of `dependency` finish (including the ones submitted after this call, if any).
+        // If `dependency` has no pending jobs, this is equivalent to `Submit()`.
+        void SubmitAfter(Counter &dependency, Counter &counter, std::function<void()> func);
+
+        // Queues a job that only runs on the main thread, in `RunMainThreadJobs()` or while the main thread is in `Wait()`.
+        void SubmitToMainThread(Counter &counter, std::function<void()> func);
+
+        // Runs the queued main thread jobs. Call this from the main loop, once per frame or so.
+        void RunMainThreadJobs();
+
+        // Waits for all jobs of the counter to finish, running other jobs on this thread in the meantime.
+        // Then rethrows the first exception thrown by those jobs, if any.
+        // Can be called from inside of the jobs, this is how you fork and join.
+        void Wait(Counter &counter);
+    };
+
+    // The pool shared by the whole program. Created on the first call.
+    [[nodiscard]] ThreadPool &GlobalPool();
+
+    // Calls `func()` on the main thread of the pool, and returns the result. Blocks until it's done, running other jobs in the meantime.
+    // If this is the main thread, calls it directly. Otherwise the main thread must eventually call `RunMainThreadJobs()` or `Wait()`.
+    template <typename F>
+    std::invoke_result_t<F &> RunOnMainThread(ThreadPool &pool, F &&func)
+    {
+        if (pool.IsMainThread())
+            return func();
+
+        using R = std::invoke_result_t<F &>;
+        Counter counter;
+        if constexpr (std::is_void_v<R>)
+        {
+            pool.SubmitToMainThread(counter, [&func]{func();});
+            pool.Wait(counter);
+        }
+        else
+        {
+            std::optional<R> result;
+            pool.SubmitToMainThread(counter, [&]{result.emplace(func());});
+            pool.Wait(counter);
+            return std::move(*result);
+        }
+    }
+
+    // Calls `func(i)` for every `i` in `[begin, end)`, splitting the range between the threads of the pool.
+    // The ranges given to each job are at least `min_chunk_size` long (unless the whole range is shorter), so adjust it if the calls are very cheap.
+    // Blocks until everything is done, running the jobs on this thread too. Rethrows the first exception, if any.
+    template <typename F>
+    void ParallelFor(ThreadPool &pool, std::size_t begin, std::size_t end, F &&func, std::size_t min_chunk_size = 1)
+    {
+        if (begin >= end)
+            return;
+
+        std::size_t size = end - begin;
+        min_chunk_size = std::max(min_chunk_size, std::size_t(1));
+        // A few chunks per thread, so that stealing can balance uneven workloads.
+        // Rounding down here, since the chunks are spread evenly, and rounding up would make most of them shorter than `min_chunk_size`.
+        std::size_t num_chunks = std::clamp(size / min_chunk_size, std::size_t(1), std::size_t(pool.Concurrency()) * 4);
+
+        auto RunChunk = [&func, begin, size, num_chunks](std::size_t chunk)
+        {
+            std::size_t chunk_end = begin + size * (chunk + 1) / num_chunks;
+            for (std::size_t i = begin + size * chunk / num_chunks; i < chunk_end; i++)
+                func(i);
+        };
+
+        if (num_chunks == 1)
+        {
+            RunChunk(0);
+            return;
+        }
+
+        Counter counter;
+        for (std::size_t chunk = 1; chunk < num_chunks; chunk++)
+            pool.Submit(counter, [&RunChunk, chunk]{RunChunk(chunk);});
+
+        // Run the first chunk on this thread. If it throws, we still have to wait for the rest, since they reference the local variables.
+        std::exception_ptr exception;
+        try
+        {
+            RunChunk(0);
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+
+        try
+        {
+            pool.Wait(counter);
+        }
+        catch (...)
+        {
+            if (!exception)
+                exception = std::current_exception();
+        }
+
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+}
@@ -0,0 +1,120 @@
+#include "jobs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("jobs.thread_pool")
+{
+    for (int num_workers : {3, 1})
+    {
+        Jobs::ThreadPool pool(num_workers);
+        CHECK(pool.NumWorkers() == num_workers);
+
+        // Basic jobs.
+        std::atomic<int> sum = 0;
+        Jobs::Counter counter;
+        for (int i = 1; i <= 100; i++)
+            pool.Submit(counter, [&sum, i]{sum += i;});
+        pool.Wait(counter);
+        CHECK(counter.IsDone());
+        CHECK(sum == 5050);
+
+        // Nested fork/join, the counter is reused.
+        sum = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            pool.Submit(counter, [&]
+            {
+                Jobs::Counter inner;
+                for (int j = 0; j < 8; j++)
+                    pool.Submit(inner, [&]{sum++;});
+                pool.Wait(inner);
+            });
+        }
+        pool.Wait(counter);
+        CHECK(sum == 64);
+
+        // Dependencies.
+        std::vector<int> order;
+        std::mutex order_mutex;
+        Jobs::Counter first, second;
+        pool.Submit(first, [&]
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            std::lock_guard lock(order_mutex);
+            order.push_back(1);
+        });
+        pool.SubmitAfter(first, second, [&]
+        {
+            std::lock_guard lock(order_mutex);
+            order.push_back(2);
+        });
+        pool.Wait(second);
+        CHECK(order == std::vector{1, 2});
+        pool.Wait(first);
+        pool.SubmitAfter(first, second, [&]{order.push_back(3);}); // Already done, runs normally.
+        pool.Wait(second);
+        CHECK(order == std::vector{1, 2, 3});
+
+        // Main thread jobs.
+        bool ran_on_main_thread = false;
+        pool.Submit(counter, [&]
+        {
+            Jobs::Counter main_counter;
+            pool.SubmitToMainThread(main_counter, [&]{ran_on_main_thread = pool.IsMainThread();});
+            pool.Wait(main_counter);
+        });
+        pool.Wait(counter);
+        CHECK(ran_on_main_thread);
+
+        // Exceptions.
+        for (int i = 0; i < 10; i++)
+            pool.Submit(counter, [i]{if (i == 5) throw std::runtime_error("Blah!");});
+        REQUIRE_THROWS(pool.Wait(counter));
+        pool.Wait(counter); // The exception is consumed.
+
+        // Parallel for.
+        std::vector<int> values(10000);
+        Jobs::ParallelFor(pool, 0, values.size(), [&](std::size_t i){values[i] = int(i);}, 100);
+        CHECK(std::accumulate(values.begin(), values.end(), 0ll) == 9999ll * 10000 / 2);
+        REQUIRE_THROWS(Jobs::ParallelFor(pool, 0, 100, [&](std::size_t i){if (i == 77) throw std::runtime_error("Blah!");}));
+
+        // Every chunk is at least `min_chunk_size` long. A thread can run several adjacent chunks in a row, that only makes the runs longer.
+        for (std::size_t size : {3, 10, 17, 1000})
+        {
+            std::mutex mutex;
+            std::map<std::thread::id, std::vector<std::size_t>> indices_per_thread;
+            Jobs::ParallelFor(pool, 0, size, [&](std::size_t i)
+            {
+                std::lock_guard lock(mutex);
+                indices_per_thread[std::this_thread::get_id()].push_back(i);
+            }, 4);
+
+            std::size_t total = 0;
+            for (const auto &[id, indices] : indices_per_thread)
+            {
+                std::size_t run_len = 1;
+                for (std::size_t j = 1; j <= indices.size(); j++)
+                {
+                    if (j < indices.size() && indices[j] == indices[j - 1] + 1)
+                    {
+                        run_len++;
+                        continue;
+                    }
+                    CHECK(run_len >= std::min(size, std::size_t(4)));
+                    run_len = 1;
+                }
+                total += indices.size();
+            }
+            CHECK(total == size);
+        }
+    }
+}
@@ -1,21 +1,89 @@
 #include "json.h"
 
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdlib>
 #include <cstring>
 #include <limits>
 #include <ostream>
 
+#include "program/compiler.h"
 #include "strings/format.h"
 #include "strings/symbol_position.h"
+#include "utils/alloc_tracker.h"
 
-void Json::ParseSkipWhitespace(const char *&cur)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
 {
+    // Returns the first byte at or after `cur` that isn't a whitespace (or a control character, which we treat the same way).
+    // Only processes full 16-byte blocks, so the result can be followed by more whitespace if it's close to `end`.
+    [[nodiscard]] const char *SkipWhitespaceBlocks(const char *cur, const char *end)
+    {
+        #if defined(__SSE2__)
+        // `x` is a whitespace if `x - 1 <= ' ' - 1`, unsigned.
+        const __m128i one = _mm_set1_epi8(1), max_offset = _mm_set1_epi8(' ' - 1);
+        while (end - cur >= 16)
+        {
+            __m128i offset = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cur)), one);
+            unsigned int mismatches = ~unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(offset, max_offset), max_offset))) & 0xffff;
+            if (mismatches)
+                return cur + std::countr_zero(mismatches);
+            cur += 16;
+        }
+        #else
+        (void)end;
+        #endif
+        return cur;
+    }
+
+    // Returns the first byte at or after `cur` that needs special handling in a string: `"`, `\`, or a control character (including the null terminator).
+    // Only processes full 16-byte blocks, like `SkipWhitespaceBlocks()`.
+    [[nodiscard]] const char *SkipPlainStringCharsBlocks(const char *cur, const char *end)
+    {
+        #if defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), max_control = _mm_set1_epi8(' ' - 1);
+        while (end - cur >= 16)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+            __m128i special = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)),
+                _mm_cmpeq_epi8(_mm_max_epu8(bytes, max_control), max_control)
+            );
+            unsigned int mask = unsigned(_mm_movemask_epi8(special));
+            if (mask)
+                return cur + std::countr_zero(mask);
+            cur += 16;
+        }
+        #else
+        (void)end;
+        #endif
+        return cur;
+    }
+}
+
+// This is called very often, and is otherwise not inlined because of the block loop.
+IMP_ALWAYS_INLINE inline void Json::ParseSkipWhitespace(const char *&cur, const char *end)
+{
+    // Most runs of whitespace are short, so check a few bytes directly before switching to the blocks.
+    for (int i = 0; i < 4; i++)
+    {
+        if (!(*cur > '\0' && *cur <= ' '))
+            return;
+        cur++;
+    }
+
+    cur = SkipWhitespaceBlocks(cur, end);
     while (*cur > '\0' && *cur <= ' ')
         cur++;
 }
 
-std::string Json::ParseStringLow(const char *&cur)
+void Json::ParseStringLow(const char *&cur, const char *end, std::string &ret)
 {
-    ParseSkipWhitespace(cur);
+    ParseSkipWhitespace(cur, end);
 
     if (*cur != '"')
         throw std::runtime_error("Expected `\"`.");
@@ -26,6 +94,10 @@ std::string Json::ParseStringLow(const char *&cur)
 
     while (true)
     {
+        // Skip the bytes that need no handling.
+        if (!backslash_preceding)
+            cur = SkipPlainStringCharsBlocks(cur, end);
+
         // Stop on `"`.
         if (*cur == '"' && !backslash_preceding)
             break;
@@ -47,19 +119,21 @@ std::string Json::ParseStringLow(const char *&cur)
         cur++;
     }
 
-    const char *end = cur;
+    const char *string_end = cur;
 
-    std::string ret;
-    for (cur = begin; cur != end; cur++)
+    for (cur = begin; cur != string_end; cur++)
     {
         if (*cur != '\\')
         {
-            ret += *cur;
+            // Append everything up to the next escape at once.
+            const char *run_end = std::find(cur, string_end, '\\');
+            ret.append(cur, run_end);
+            cur = run_end - 1; // This is needed because of the auto increment at the end of loop.
         }
         else
         {
             cur++;
-            if (cur == end)
+            if (cur == string_end)
                 throw std::runtime_error("Expected an escape character before `\"`.");
             switch (*cur)
             {
@@ -86,7 +160,7 @@ std::string Json::ParseStringLow(const char *&cur)
               case 'u':
                 {
                     cur++;
-                    if (end - cur < 4)
+                    if (string_end - cur < 4)
                         throw std::runtime_error("Expected four hex digits after `\\u`.");
                     int value = 0;
                     for (int i = 0; i < 4; i++)
@@ -125,10 +199,80 @@ std::string Json::ParseStringLow(const char *&cur)
     }
 
     cur++; // Skip the `"`.
-    return ret;
 }
 
-Json Json::ParseLow(const char *&cur, int allowed_depth)
+bool Json::ParseNumberLow(const char *&cur, int &num_int, double &num_real)
+{
+    const char *begin = cur;
+    bool real = false;
+
+    if (*cur == '-')
+        cur++;
+
+    const char *digits_begin = cur;
+    while (*cur >= '0' && *cur <= '9')
+        cur++;
+
+    if (cur == digits_begin && *cur != '.')
+        throw std::runtime_error("Unable to parse a number.");
+
+    if (*cur == '.')
+    {
+        cur++;
+        real = true;
+
+        if (!(*cur >= '0' && *cur <= '9'))
+            throw std::runtime_error("Expected a digit after decimal point.");
+        while (*cur >= '0' && *cur <= '9')
+            cur++;
+    }
+
+    if (*cur == 'e' || *cur == 'E')
+    {
+        cur++;
+        real = true;
+
+        if (*cur == '+' || *cur == '-')
+            cur++;
+
+        if (!(*cur >= '0' && *cur <= '9'))
+            throw std::runtime_error("Expected a digit after `e`, possibly after a sign.");
+        while (*cur >= '0' && *cur <= '9')
+            cur++;
+    }
+
+    if (real)
+    {
+        auto [end, ec] = std::from_chars(begin, cur, num_real);
+        if (ec == std::errc::result_out_of_range)
+        {
+            // `from_chars()` rejects those, but we want infinities and zeroes, like `strtod()` gives.
+            char *strtod_end = 0;
+            num_real = std::strtod(begin, &strtod_end);
+            end = strtod_end;
+        }
+        else if (ec != std::errc{})
+        {
+            throw std::runtime_error("Unable to parse a number.");
+        }
+        if (end != cur)
+            throw std::runtime_error("Unable to parse a number.");
+    }
+    else
+    {
+        long num = 0;
+        auto [end, ec] = std::from_chars(begin, cur, num);
+        if (ec == std::errc::result_out_of_range || (sizeof(int) < sizeof(long) && (num < std::numeric_limits<int>::min() || num > std::numeric_limits<int>::max())))
+            throw std::runtime_error("Overflow in integral constant.");
+        if (ec != std::errc{} || end != cur)
+            throw std::runtime_error("Unable to parse a number.");
+        num_int = int(num);
+    }
+
+    return real;
+}
+
+Json Json::ParseLow(const char *&cur, const char *end, int allowed_depth)
 {
     if (allowed_depth < 0)
         throw std::runtime_error("Too many nested elements.");
@@ -146,7 +290,7 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
         }
     };
 
-    ParseSkipWhitespace(cur);
+    ParseSkipWhitespace(cur, end);
 
     switch (*cur)
     {
@@ -166,80 +310,23 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
         break;
 
       default: // number
+        if (*cur == '-' || (*cur >= '0' && *cur <= '9'))
         {
-            std::string str;
-            bool real = false;
-
-            if (*cur == '-')
-            {
-                str += '-';
-                cur++;
-            }
-
-            while (*cur >= '0' && *cur <= '9')
-                str += *cur++;
-
-            if (str.empty())
-                break;
-
-            if (*cur == '.')
-            {
-                cur++;
-
-                real = true;
-                str += '.';
-
-                while (*cur >= '0' && *cur <= '9')
-                    str += *cur++;
-
-                if (str.back() == '.')
-                    throw std::runtime_error("Expected a digit after decimal point.");
-            }
-
-            if (*cur == 'e' || *cur == 'E')
-            {
-                cur++;
-
-                real = true;
-                str += 'e';
-
-                if (*cur == '+' || *cur == '-')
-                    str += *cur++;
-
-                while (*cur >= '0' && *cur <= '9')
-                    str += *cur++;
-
-                if (str.back() == 'e' || str.back() == '+' || str.back() == '-')
-                    throw std::runtime_error("Expected a digit after `e`, possibly after a sign.");
-            }
-
-            if (real)
-            {
-                char *end = 0;
-                double num = std::strtod(str.c_str(), &end);
-                if (end == str.c_str())
-                    throw std::runtime_error("Unable to parse a number.");
-
-                return FromVariant(num);
-            }
+            int num_int = 0;
+            double num_real = 0;
+            if (ParseNumberLow(cur, num_int, num_real))
+                return FromVariant(num_real);
             else
-            {
-                char *end = 0;
-                long num = std::strtol(str.c_str(), &end, 10);
-                if (end == str.c_str())
-                    throw std::runtime_error("Unable to parse a number.");
-
-                if constexpr (sizeof(int) < sizeof(long))
-                    if (num < std::numeric_limits<int>::min() || num > std::numeric_limits<int>::max())
-                        throw std::runtime_error("Overflow in integral constant.");
-
-                return FromVariant(int(num));
-            }
+                return FromVariant(num_int);
         }
         break;
 
       case '"': // string
-        return FromVariant(ParseStringLow(cur));
+        {
+            std::string str;
+            ParseStringLow(cur, end, str);
+            return FromVariant(std::move(str));
+        }
         break;
 
       case '[': // array
@@ -252,7 +339,7 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
             bool first = true;
             while (true)
             {
-                ParseSkipWhitespace(cur);
+                ParseSkipWhitespace(cur, end);
 
                 if (*cur == ']')
                     break;
@@ -266,7 +353,7 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
                     if (*cur != ',')
                         throw std::runtime_error("Expected `,`.");
                     cur++;
-                    ParseSkipWhitespace(cur);
+                    ParseSkipWhitespace(cur, end);
 
                     if (*cur == ']')
                         break;
@@ -278,7 +365,7 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
                     throw std::runtime_error("This array lacks a terminating `]` character.");
                 }
 
-                vec.push_back(ParseLow(cur, allowed_depth-1));
+                vec.push_back(ParseLow(cur, end, allowed_depth-1));
             }
 
             cur++; // Skip `]`.
@@ -296,7 +383,7 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
             bool first = true;
             while (true)
             {
-                ParseSkipWhitespace(cur);
+                ParseSkipWhitespace(cur, end);
 
                 if (*cur == '}')
                     break;
@@ -310,7 +397,7 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
                     if (*cur != ',')
                         throw std::runtime_error("Expected `,`.");
                     cur++;
-                    ParseSkipWhitespace(cur);
+                    ParseSkipWhitespace(cur, end);
 
                     if (*cur == '}')
                         break;
@@ -322,9 +409,10 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
                     throw std::runtime_error("This array lacks a terminating `]` character.");
                 }
 
-                std::string name = ParseStringLow(cur);
+                std::string name;
+                ParseStringLow(cur, end, name);
 
-                ParseSkipWhitespace(cur);
+                ParseSkipWhitespace(cur, end);
 
                 if (*cur != ':')
                     throw std::runtime_error("Expected `:`.");
@@ -332,7 +420,7 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
 
                 // No need to skip whitespace here, nested ParseLow() will do that.
 
-                map.insert({name, ParseLow(cur, allowed_depth-1)});
+                map.insert({name, ParseLow(cur, end, allowed_depth-1)});
             }
 
             cur++; // Skip `}`.
@@ -346,11 +434,12 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
 
 Json::Json(const char *string, int allowed_depth)
 {
-    const char *begin = string;
+    IMP_ALLOC_SCOPE("json");
+    const char *begin = string, *end = string + std::strlen(string);
     try
     {
-        *this = ParseLow(string, allowed_depth);
-        ParseSkipWhitespace(string);
+        *this = ParseLow(string, end, allowed_depth);
+        ParseSkipWhitespace(string, end);
         if (*string != '\0')
             throw std::runtime_error("Unexpected data after JSON.");
     }
@@ -361,6 +450,449 @@ Json::Json(const char *string, int allowed_depth)
     }
 }
 
+struct Json::SaxParser
+{
+    JsonSaxHandler &handler;
+    const char *cur = nullptr;
+    const char *end = nullptr; // Points to the null terminator.
+    std::string buffer; // Reused for all strings.
+
+    SaxParser(JsonSaxHandler &handler, const char *cur) : handler(handler), cur(cur), end(cur + std::strlen(cur)) {}
+
+    bool TryGetString(std::string_view string)
+    {
+        if (std::strncmp(string.data(), cur, string.size()) == 0)
+        {
+            cur += string.size();
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    std::string_view ParseString()
+    {
+        buffer.clear();
+        ParseStringLow(cur, end, buffer);
+        return buffer;
+    }
+
+    void ParseLow(int allowed_depth)
+    {
+        if (allowed_depth < 0)
+            throw std::runtime_error("Too many nested elements.");
+
+        ParseSkipWhitespace(cur, end);
+
+        switch (*cur)
+        {
+          case 'n': // null
+            if (TryGetString("null"))
+            {
+                handler.Null();
+                return;
+            }
+            break;
+
+          case 'f': // boolean, false
+            if (TryGetString("false"))
+            {
+                handler.Bool(false);
+                return;
+            }
+            break;
+
+          case 't': // boolean, true
+            if (TryGetString("true"))
+            {
+                handler.Bool(true);
+                return;
+            }
+            break;
+
+          case '"': // string
+            handler.String(ParseString());
+            return;
+
+          case '[': // array
+            {
+                const char *begin = cur;
+                cur++; // Skip `[`.
+
+                handler.BeginArray();
+
+                bool first = true;
+                while (true)
+                {
+                    ParseSkipWhitespace(cur, end);
+
+                    if (*cur == ']')
+                        break;
+
+                    if (first)
+                    {
+                        first = false;
+                    }
+                    else
+                    {
+                        if (*cur != ',')
+                            throw std::runtime_error("Expected `,`.");
+                        cur++;
+                        ParseSkipWhitespace(cur, end);
+
+                        if (*cur == ']')
+                            break;
+                    }
+
+                    if (*cur == '\0')
+                    {
+                        cur = begin; // We do this to get a better error message.
+                        throw std::runtime_error("This array lacks a terminating `]` character.");
+                    }
+
+                    ParseLow(allowed_depth-1);
+                }
+
+                cur++; // Skip `]`.
+
+                handler.EndArray();
+            }
+            return;
+
+          case '{': // object
+            {
+                const char *begin = cur;
+                cur++; // Skip `{`.
+
+                handler.BeginObject();
+
+                bool first = true;
+                while (true)
+                {
+                    ParseSkipWhitespace(cur, end);
+
+                    if (*cur == '}')
+                        break;
+
+                    if (first)
+                    {
+                        first = false;
+                    }
+                    else
+                    {
+                        if (*cur != ',')
+                            throw std::runtime_error("Expected `,`.");
+                        cur++;
+                        ParseSkipWhitespace(cur, end);
+
+                        if (*cur == '}')
+                            break;
+                    }
+
+                    if (*cur == '\0')
+                    {
+                        cur = begin; // We do this to get a better error message.
+                        throw std::runtime_error("This array lacks a terminating `]` character.");
+                    }
+
+                    std::string_view name = ParseString();
+
+                    ParseSkipWhitespace(cur, end);
+
+                    if (*cur != ':')
+                        throw std::runtime_error("Expected `:`.");
+                    cur++;
+
+                    handler.Key(name);
+
+                    // No need to skip whitespace here, nested ParseLow() will do that.
+
+                    ParseLow(allowed_depth-1);
+                }
+
+                cur++; // Skip `}`.
+
+                handler.EndObject();
+            }
+            return;
+
+          default: // number
+            if (*cur == '-' || (*cur >= '0' && *cur <= '9'))
+            {
+                int num_int = 0;
+                double num_real = 0;
+                if (ParseNumberLow(cur, num_int, num_real))
+                    handler.Real(num_real);
+                else
+                    handler.Int(num_int);
+                return;
+            }
+            break;
+        }
+
+        throw std::runtime_error("Unknown entity.");
+    }
+};
+
+void Json::ParseSax(const char *string, int allowed_depth, JsonSaxHandler &handler)
+{
+    const char *begin = string;
+    SaxParser parser(handler, string);
+    try
+    {
+        parser.ParseLow(allowed_depth);
+        ParseSkipWhitespace(parser.cur, parser.end);
+        if (*parser.cur != '\0')
+            throw std::runtime_error("Unexpected data after JSON.");
+    }
+    catch (std::exception &e)
+    {
+        auto pos = Strings::GetSymbolPosition(begin, parser.cur);
+        throw std::runtime_error(FMT("JSON parsing failed, at {}: {}", pos.ToString(), e.what()));
+    }
+}
+
+struct FlatJson::Parser
+{
+    FlatJson &doc;
+    const char *cur = nullptr;
+    const char *end = nullptr; // Points to the null terminator.
+
+    // The elements and members of the containers being parsed. Each container moves its range to the document when finished.
+    std::vector<std::uint32_t> element_stack;
+    std::vector<Member> member_stack;
+
+    Parser(FlatJson &doc, const char *cur) : doc(doc), cur(cur), end(cur + std::strlen(cur)) {}
+
+    bool TryGetString(std::string_view string)
+    {
+        if (std::strncmp(string.data(), cur, string.size()) == 0)
+        {
+            cur += string.size();
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // Appends a string to `doc.strings`. Returns the offset and sets `size`.
+    std::uint32_t ParseString(std::uint32_t &size)
+    {
+        std::uint32_t offset = doc.strings.size();
+        Json::ParseStringLow(cur, end, doc.strings);
+        size = doc.strings.size() - offset;
+        doc.strings += '\0';
+        return offset;
+    }
+
+    // Parses a value into `doc.nodes[index]`, which must already exist.
+    // Note that `doc.nodes` can be reallocated by nested calls, so we don't hold references to it.
+    void ParseLow(std::uint32_t index, int allowed_depth)
+    {
+        if (allowed_depth < 0)
+            throw std::runtime_error("Too many nested elements.");
+
+        Json::ParseSkipWhitespace(cur, end);
+
+        switch (*cur)
+        {
+          case 'n': // null
+            if (TryGetString("null"))
+            {
+                doc.nodes[index].type = Json::null;
+                return;
+            }
+            break;
+
+          case 'f': // boolean, false
+            if (TryGetString("false"))
+            {
+                doc.nodes[index].type = Json::boolean;
+                doc.nodes[index].boolean = false;
+                return;
+            }
+            break;
+
+          case 't': // boolean, true
+            if (TryGetString("true"))
+            {
+                doc.nodes[index].type = Json::boolean;
+                doc.nodes[index].boolean = true;
+                return;
+            }
+            break;
+
+          case '"': // string
+            {
+                std::uint32_t size = 0;
+                std::uint32_t offset = ParseString(size);
+                doc.nodes[index].type = Json::string;
+                doc.nodes[index].offset = offset;
+                doc.nodes[index].size = size;
+            }
+            return;
+
+          case '[': // array
+            {
+                const char *begin = cur;
+                cur++; // Skip `[`.
+
+                std::size_t stack_begin = element_stack.size();
+
+                bool first = true;
+                while (true)
+                {
+                    Json::ParseSkipWhitespace(cur, end);
+
+                    if (*cur == ']')
+                        break;
+
+                    if (first)
+                    {
+                        first = false;
+                    }
+                    else
+                    {
+                        if (*cur != ',')
+                            throw std::runtime_error("Expected `,`.");
+                        cur++;
+                        Json::ParseSkipWhitespace(cur, end);
+
+                        if (*cur == ']')
+                            break;
+                    }
+
+                    if (*cur == '\0')
+                    {
+                        cur = begin; // We do this to get a better error message.
+                        throw std::runtime_error("This array lacks a terminating `]` character.");
+                    }
+
+                    std::uint32_t elem_index = doc.nodes.size();
+                    doc.nodes.emplace_back();
+                    element_stack.push_back(elem_index);
+                    ParseLow(elem_index, allowed_depth-1);
+                }
+
+                cur++; // Skip `]`.
+
+                doc.nodes[index].type = Json::array;
+                doc.nodes[index].offset = doc.elements.size();
+                doc.nodes[index].size = element_stack.size() - stack_begin;
+                doc.elements.insert(doc.elements.end(), element_stack.begin() + stack_begin, element_stack.end());
+                element_stack.resize(stack_begin);
+            }
+            return;
+
+          case '{': // object
+            {
+                const char *begin = cur;
+                cur++; // Skip `{`.
+
+                std::size_t stack_begin = member_stack.size();
+
+                bool first = true;
+                while (true)
+                {
+                    Json::ParseSkipWhitespace(cur, end);
+
+                    if (*cur == '}')
+                        break;
+
+                    if (first)
+                    {
+                        first = false;
+                    }
+                    else
+                    {
+                        if (*cur != ',')
+                            throw std::runtime_error("Expected `,`.");
+                        cur++;
+                        Json::ParseSkipWhitespace(cur, end);
+
+                        if (*cur == '}')
+                            break;
+                    }
+
+                    if (*cur == '\0')
+                    {
+                        cur = begin; // We do this to get a better error message.
+                        throw std::runtime_error("This array lacks a terminating `]` character.");
+                    }
+
+                    Member member;
+                    member.name_offset = ParseString(member.name_size);
+
+                    Json::ParseSkipWhitespace(cur, end);
+
+                    if (*cur != ':')
+                        throw std::runtime_error("Expected `:`.");
+                    cur++;
+
+                    // No need to skip whitespace here, nested ParseLow() will do that.
+
+                    member.node = doc.nodes.size();
+                    doc.nodes.emplace_back();
+                    member_stack.push_back(member);
+                    ParseLow(member.node, allowed_depth-1);
+                }
+
+                cur++; // Skip `}`.
+
+                // Sort by name. On duplicate names, keep the first one, like `Json` does.
+                auto members_begin = member_stack.begin() + stack_begin;
+                auto ByName = [&](const Member &a, const Member &b){return doc.StringAt(a.name_offset, a.name_size) < doc.StringAt(b.name_offset, b.name_size);};
+                std::stable_sort(members_begin, member_stack.end(), ByName);
+                auto members_end = std::unique(members_begin, member_stack.end(), [&](const Member &a, const Member &b){return !ByName(a, b) && !ByName(b, a);});
+
+                doc.nodes[index].type = Json::object;
+                doc.nodes[index].offset = doc.members.size();
+                doc.nodes[index].size = members_end - members_begin;
+                doc.members.insert(doc.members.end(), members_begin, members_end);
+                member_stack.resize(stack_begin);
+            }
+            return;
+
+          default: // number
+            if (*cur == '-' || (*cur >= '0' && *cur <= '9'))
+            {
+                Node &node = doc.nodes[index];
+                if (Json::ParseNumberLow(cur, node.num_int, node.num_real))
+                    node.type = Json::num_real;
+                else
+                    node.type = Json::num_int;
+                return;
+            }
+            break;
+        }
+
+        throw std::runtime_error("Unknown entity.");
+    }
+};
+
+FlatJson::FlatJson(const char *string, int allowed_depth) : nodes(1)
+{
+    IMP_ALLOC_SCOPE("json");
+    const char *begin = string;
+    Parser parser(*this, string);
+    try
+    {
+        parser.ParseLow(0, allowed_depth);
+        Json::ParseSkipWhitespace(parser.cur, parser.end);
+        if (*parser.cur != '\0')
+            throw std::runtime_error("Unexpected data after JSON.");
+    }
+    catch (std::exception &e)
+    {
+        auto pos = Strings::GetSymbolPosition(begin, parser.cur);
+        throw std::runtime_error(FMT("JSON parsing failed, at {}: {}", pos.ToString(), e.what()));
+    }
+}
+
 void Json::View::DebugPrint(std::ostream &stream) const
 {
     switch (Type())
@@ -381,6 +913,21 @@ void Json::View::DebugPrint(std::ostream &stream) const
         stream << '"' << GetString() << '"';
         break;
       case array:
+        if (flat)
+        {
+            bool first = true;
+            stream << '[';
+            ForEachArrayElement([&](const View &elem)
+            {
+                if (first)
+                    first = false;
+                else
+                    stream << ',';
+                elem.DebugPrint(stream);
+            });
+            stream << ']';
+        }
+        else
         {
             const array_t &obj = *std::get_if<int(array)>(&ptr->variant);
             bool first = true;
@@ -397,6 +944,24 @@ void Json::View::DebugPrint(std::ostream &stream) const
         }
         break;
       case object:
+        if (flat)
+        {
+            const FlatJson::Node &node = FlatNode();
+            bool first = true;
+            stream << '{';
+            for (std::uint32_t i = 0; i < node.size; i++)
+            {
+                const FlatJson::Member &member = flat->members[node.offset + i];
+                if (first)
+                    first = false;
+                else
+                    stream << ',';
+                stream << "\"" << flat->StringAt(member.name_offset, member.name_size) << "\":";
+                View(*flat, member.node, "").DebugPrint(stream);
+            }
+            stream << '}';
+        }
+        else
         {
             const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
             bool first = true;
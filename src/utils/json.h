@@ -1,14 +1,98 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <iosfwd>
 #include <exception>
 #include <map>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 #include "strings/format.h"
 
+class Json;
+
+// Receives the events from `Json::ParseSax()`. Override the ones you need.
+// The strings are only valid until the function returns.
+class JsonSaxHandler
+{
+  public:
+    virtual ~JsonSaxHandler() = default;
+
+    virtual void BeginArray() {}
+    virtual void EndArray() {}
+    virtual void BeginObject() {}
+    virtual void EndObject() {}
+    virtual void Key(std::string_view key) {(void)key;} // Precedes every object member.
+
+    virtual void Null() {}
+    virtual void Bool(bool value) {(void)value;}
+    virtual void Int(int value) {(void)value;}
+    virtual void Real(double value) {(void)value;}
+    virtual void String(std::string_view value) {(void)value;}
+};
+
+// A read-only JSON document that stores all nodes in a few flat arrays, instead of allocating every node separately like `Json` does.
+// Parsing this is a lot cheaper for large files (e.g. Tiled maps). Access it through the same `Json::View`, see `GetView()` below.
+class FlatJson
+{
+    friend class Json;
+
+    struct Node
+    {
+        std::uint8_t type = 0; // `Json::type_t`.
+        std::uint32_t size = 0; // For strings, arrays, and objects.
+        union
+        {
+            bool boolean;
+            int num_int;
+            double num_real;
+            std::uint32_t offset; // For strings, into `strings`. For arrays, into `elements`. For objects, into `members`.
+        };
+
+        Node() : offset(0) {}
+    };
+
+    struct Member
+    {
+        std::uint32_t name_offset = 0; // Into `strings`.
+        std::uint32_t name_size = 0;
+        std::uint32_t node = 0;
+    };
+
+    std::vector<Node> nodes; // `nodes[0]` is the root.
+    std::vector<std::uint32_t> elements; // Array elements, each array is a contiguous range.
+    std::vector<Member> members; // Object members, each object is a contiguous range sorted by name.
+    std::string strings; // All strings and member names, each followed by a `\0`.
+
+    struct Parser;
+
+    [[nodiscard]] std::string_view StringAt(std::uint32_t offset, std::uint32_t size) const
+    {
+        return std::string_view(strings.data() + offset, size);
+    }
+
+    // Returns null if there is no such member.
+    [[nodiscard]] const Member *FindMember(const Node &node, std::string_view name) const
+    {
+        const Member *begin = members.data() + node.offset, *end = begin + node.size;
+        const Member *it = std::lower_bound(begin, end, name, [&](const Member &m, std::string_view name){return StringAt(m.name_offset, m.name_size) < name;});
+        if (it == end || StringAt(it->name_offset, it->name_size) != name)
+            return nullptr;
+        return it;
+    }
+
+  public:
+    // Contains a single null.
+    FlatJson() : nodes(1) {}
+    FlatJson(const char *string, int allowed_depth);
+
+    // See below.
+    [[nodiscard]] auto GetView() const;
+};
+
 class Json
 {
   public:
@@ -39,19 +123,40 @@ class Json
         return ret;
     }
 
-    static void ParseSkipWhitespace(const char *&cur);
-    static std::string ParseStringLow(const char *&cur);
-    static Json ParseLow(const char *&cur, int allowed_depth);
+    friend FlatJson;
+
+    // `end` points to the null terminator. The parsing functions rely on the terminator, `end` is only used for bulk reads.
+    static void ParseSkipWhitespace(const char *&cur, const char *end);
+    static void ParseStringLow(const char *&cur, const char *end, std::string &ret); // Appends to `ret`.
+    static bool ParseNumberLow(const char *&cur, int &num_int, double &num_real); // Returns true and sets `num_real` if the number is real, otherwise sets `num_int`.
+    static Json ParseLow(const char *&cur, const char *end, int allowed_depth);
+
+    struct SaxParser;
 
   public:
     Json() {}
     Json(const char *string, int allowed_depth);
 
+    // Parses JSON without building a document, reporting the elements to `handler` as they are encountered.
+    // The handler can throw to stop parsing, the exception is then wrapped like the parsing errors.
+    static void ParseSax(const char *string, int allowed_depth, JsonSaxHandler &handler);
+
     class View
     {
+        friend FlatJson;
+
         const Json *ptr = 0;
+        const FlatJson *flat = 0; // If not null, we're viewing `flat->nodes[flat_index]` instead of `*ptr`.
+        std::uint32_t flat_index = 0;
         std::string path;
 
+        View(const FlatJson &doc, std::uint32_t index, std::string name) : flat(&doc), flat_index(index), path(std::move(name)) {}
+
+        const FlatJson::Node &FlatNode() const
+        {
+            return flat->nodes[flat_index];
+        }
+
         void ThrowExpectedType(std::string type) const
         {
             throw std::runtime_error(FMT("Expected JSON element `{}` to be {}.", path, type));
@@ -83,37 +188,46 @@ class Json
 
         explicit operator bool() const
         {
-            return bool(ptr);
+            return ptr || flat;
         }
 
+        // Throws if this views a `FlatJson`.
         const Json &Target() const
         {
+            if (flat)
+                throw std::runtime_error(FMT("JSON element `{}` is a part of a `FlatJson`, it can't be accessed as `Json`.", path));
             return *ptr;
         }
 
         type_t Type() const
         {
+            if (flat)
+                return type_t(FlatNode().type);
             return type_t(ptr->variant.index());
         }
 
-        bool IsNull()   const {return !ptr || Type() == null;}
-        bool IsBool()   const {return ptr && Type() == boolean;}
-        bool IsInt()    const {return ptr && Type() == num_int;}
-        bool IsReal()   const {return ptr && (Type() == num_real || IsInt());}
-        bool IsString() const {return ptr && Type() == string;}
-        bool IsArray()  const {return ptr && Type() == array;}
-        bool IsObject() const {return ptr && Type() == object;}
+        bool IsNull()   const {return !*this || Type() == null;}
+        bool IsBool()   const {return *this && Type() == boolean;}
+        bool IsInt()    const {return *this && Type() == num_int;}
+        bool IsReal()   const {return *this && (Type() == num_real || IsInt());}
+        bool IsString() const {return *this && Type() == string;}
+        bool IsArray()  const {return *this && Type() == array;}
+        bool IsObject() const {return *this && Type() == object;}
 
         bool GetBool() const
         {
             if (!IsBool())
                 ThrowExpectedType("a boolean");
+            if (flat)
+                return FlatNode().boolean;
             return *std::get_if<int(boolean)>(&ptr->variant);
         }
         int GetInt() const
         {
             if (!IsInt())
                 ThrowExpectedType("an integer");
+            if (flat)
+                return FlatNode().num_int;
             return *std::get_if<int(num_int)>(&ptr->variant);
         }
         double GetReal() const
@@ -123,12 +237,16 @@ class Json
 
             if (!IsReal())
                 ThrowExpectedType("a real number");
+            if (flat)
+                return FlatNode().num_real;
             return *std::get_if<int(num_real)>(&ptr->variant);
         }
         std::string GetString() const
         {
             if (!IsString())
                 ThrowExpectedType("a string");
+            if (flat)
+                return std::string(flat->StringAt(FlatNode().offset, FlatNode().size));
             return *std::get_if<int(string)>(&ptr->variant);
         }
 
@@ -136,21 +254,32 @@ class Json
         {
             if (!IsArray())
                 ThrowExpectedType("an array");
+            if (flat)
+                return FlatNode().size;
             return std::get_if<int(array)>(&ptr->variant)->size();
         }
         View GetElement(int index) const
         {
             if (!IsArray())
                 ThrowExpectedType("an array");
-            const array_t &arr = *std::get_if<int(array)>(&ptr->variant);
-            if (index < 0 || decltype(arr.size())(index) >= arr.size())
-                throw std::runtime_error(FMT("Attempt to access element #{} of JSON object `{}`, but it only contains {} elements.", index, path, arr.size()));
-            return View(arr[index], AppendElementIndexToPath(index));
+            std::size_t size = flat ? FlatNode().size : std::get_if<int(array)>(&ptr->variant)->size();
+            if (index < 0 || std::size_t(index) >= size)
+                throw std::runtime_error(FMT("Attempt to access element #{} of JSON object `{}`, but it only contains {} elements.", index, path, size));
+            if (flat)
+                return View(*flat, flat->elements[FlatNode().offset + index], AppendElementIndexToPath(index));
+            return View((*std::get_if<int(array)>(&ptr->variant))[index], AppendElementIndexToPath(index));
         }
         template <typename F> void ForEachArrayElement(F &&func) const // `func` should be `void func(const View &elem)`.
         {
             if (!IsArray())
                 ThrowExpectedType("an array");
+            if (flat)
+            {
+                const FlatJson::Node &node = FlatNode();
+                for (std::uint32_t i = 0; i < node.size; i++)
+                    func(View(*flat, flat->elements[node.offset + i], AppendElementIndexToPath(i)));
+                return;
+            }
             const array_t &arr = *std::get_if<int(array)>(&ptr->variant);
             for (array_t::size_type i = 0; i < arr.size(); i++)
                 func(View(arr[i], AppendElementIndexToPath(i)));
@@ -164,12 +293,21 @@ class Json
         {
             if (!IsObject())
                 ThrowExpectedType("an object");
+            if (flat)
+                return FlatNode().size;
             return std::get_if<int(object)>(&ptr->variant)->size();
         }
         View GetElement(std::string key) const
         {
             if (!IsObject())
                 ThrowExpectedType("an object");
+            if (flat)
+            {
+                const FlatJson::Member *member = flat->FindMember(FlatNode(), key);
+                if (!member)
+                    throw std::runtime_error(FMT("Attempt to access nonexistent element `{}` of JSON object `{}`.", key, path));
+                return View(*flat, member->node, AppendElementNameToPath(key));
+            }
             const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
             auto it = obj.find(key);
             if (it == obj.end())
@@ -180,6 +318,16 @@ class Json
         {
             if (!IsObject())
                 ThrowExpectedType("an object");
+            if (flat)
+            {
+                const FlatJson::Node &node = FlatNode();
+                for (std::uint32_t i = 0; i < node.size; i++)
+                {
+                    const FlatJson::Member &member = flat->members[node.offset + i];
+                    func(View(*flat, member.node, AppendElementNameToPath(std::string(flat->StringAt(member.name_offset, member.name_size)))));
+                }
+                return;
+            }
             const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
             for (const auto &elem : obj)
                 func(View(elem.second, AppendElementNameToPath(elem.first)));
@@ -188,6 +336,8 @@ class Json
         {
             if (!IsObject())
                 ThrowExpectedType("an object");
+            if (flat)
+                return flat->FindMember(FlatNode(), key);
             const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
             auto it = obj.find(key);
             return it != obj.end();
@@ -211,3 +361,8 @@ class Json
         return View(*this);
     }
 };
+
+[[nodiscard]] inline auto FlatJson::GetView() const
+{
+    return Json::View(*this, 0, "");
+}
@@ -1,6 +1,6 @@
 // mat.h
 // Vector and matrix math
-// Version 3.27
+// Version 3.30
 // Generated, don't touch.
 
 #pragma once
@@ -46,6 +46,26 @@
 #  endif
 #endif
 
+// Define to 1 to use SIMD intrinsics for some `float` operations: `vec4` arithmetic and dot products, `mat4` products and inverse.
+// Uses SSE on x86, NEON on ARM64, and SIMD128 on WebAssembly (needs `-msimd128`). Does nothing on other targets.
+// The layout and the API of the types stay the same, but the results can differ from the scalar code in the last bits.
+#ifndef IMP_MATH_SIMD
+#  define IMP_MATH_SIMD 0
+#endif
+
+#if IMP_MATH_SIMD
+#  if defined(__wasm_simd128__) // Before SSE, since Emscripten also defines `__SSE__` with `-msse`, but emulates it.
+#    define IMP_MATH_SIMD_WASM
+#    include <wasm_simd128.h>
+#  elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#    define IMP_MATH_SIMD_SSE
+#    include <xmmintrin.h>
+#  elif defined(__ARM_NEON) && defined(__aarch64__)
+#    define IMP_MATH_SIMD_NEON
+#    include <arm_neon.h>
+#  endif
+#endif
+
 // Vectors and matrices
 
 namespace Math
@@ -54,7 +74,7 @@ namespace Math
     {
         template <typename T> concept cvref_unqualified = std::is_same_v<T, std::remove_cvref_t<T>>;
 
-        // Whether a type is a scalar.
+        // Whether a type is a scalar. Specialize this for custom scalar types, such as fixed-point numbers.
         template <typename T> struct helper_is_scalar : std::is_arithmetic<T> {}; // Not `std::is_scalar`, because that includes pointers.
         template <typename T> concept scalar = cvref_unqualified<T> && helper_is_scalar<T>::value;
         template <typename T> concept scalar_maybe_const = scalar<std::remove_const_t<T>>;
@@ -459,6 +479,9 @@ namespace Math
                 return std::partial_ordering::unordered;
             else if constexpr (vec_size_v<A> != vec_size_v<B>)
                 return std::partial_ordering::unordered;
+            else if constexpr (std::is_arithmetic_v<vec_base_t<A>> != std::is_arithmetic_v<vec_base_t<B>>)
+                // Custom scalar types are larger than the integral types, and don't mix with the floating-point ones.
+                return integral_vector_or_scalar<A> ? std::partial_ordering::less : integral_vector_or_scalar<B> ? std::partial_ordering::greater : std::partial_ordering::unordered;
             else if constexpr (floating_point_vector_or_scalar<A> < floating_point_vector_or_scalar<B>)
                 return std::partial_ordering::less;
             else if constexpr (floating_point_vector_or_scalar<A> > floating_point_vector_or_scalar<B>)
@@ -585,18 +608,161 @@ namespace Math
         }
     }
 
+    namespace Simd // SIMD helpers
+    {
+        // SIMD implementations of some `float` operations, enabled with `IMP_MATH_SIMD`.
+        // They operate on unaligned arrays, so the vectors and matrices don't need any special alignment. The matrices are column-major, like `mat::as_array()`.
+
+        #if defined(IMP_MATH_SIMD_SSE) || defined(IMP_MATH_SIMD_NEON) || defined(IMP_MATH_SIMD_WASM)
+        inline constexpr bool enabled = true;
+        #else
+        inline constexpr bool enabled = false;
+        #endif
+
+        // Those are only defined if `enabled` is true, and must only be called from `if constexpr (enabled)` branches in templates.
+        IMP_MATH_SMALL_FUNC void add4(const float *a, const float *b, float *out);
+        IMP_MATH_SMALL_FUNC void sub4(const float *a, const float *b, float *out);
+        IMP_MATH_SMALL_FUNC void mul4(const float *a, const float *b, float *out);
+        IMP_MATH_SMALL_FUNC void div4(const float *a, const float *b, float *out);
+        IMP_MATH_SMALL_FUNC float dot4(const float *a, const float *b);
+        IMP_MATH_SMALL_FUNC void mul_mat4_vec4(const float *m, const float *v, float *out);
+        inline void mul_mat4_mat4(const float *a, const float *b, float *out);
+        // Returns false if the matrix is not invertible, without writing to `out`.
+        inline bool inverse_mat4(const float *m, float *out);
+
+        #if defined(IMP_MATH_SIMD_SSE)
+        using f4 = __m128;
+        IMP_MATH_SMALL_FUNC f4 load(const float *p) {return _mm_loadu_ps(p);}
+        IMP_MATH_SMALL_FUNC void store(float *p, f4 v) {_mm_storeu_ps(p, v);}
+        IMP_MATH_SMALL_FUNC f4 splat(float x) {return _mm_set1_ps(x);}
+        IMP_MATH_SMALL_FUNC f4 make(float x, float y, float z, float w) {return _mm_setr_ps(x, y, z, w);}
+        IMP_MATH_SMALL_FUNC f4 add(f4 a, f4 b) {return _mm_add_ps(a, b);}
+        IMP_MATH_SMALL_FUNC f4 sub(f4 a, f4 b) {return _mm_sub_ps(a, b);}
+        IMP_MATH_SMALL_FUNC f4 mul(f4 a, f4 b) {return _mm_mul_ps(a, b);}
+        IMP_MATH_SMALL_FUNC f4 div(f4 a, f4 b) {return _mm_div_ps(a, b);}
+        IMP_MATH_SMALL_FUNC float sum(f4 v) {f4 s = _mm_add_ps(v, _mm_movehl_ps(v, v)); return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));}
+        template <int X, int Y, int Z, int W> IMP_MATH_SMALL_FUNC f4 permute(f4 v) {return _mm_shuffle_ps(v, v, _MM_SHUFFLE(W, Z, Y, X));}
+        IMP_MATH_SMALL_FUNC void transpose(f4 &a, f4 &b, f4 &c, f4 &d) {_MM_TRANSPOSE4_PS(a, b, c, d);}
+        #elif defined(IMP_MATH_SIMD_NEON)
+        using f4 = float32x4_t;
+        IMP_MATH_SMALL_FUNC f4 load(const float *p) {return vld1q_f32(p);}
+        IMP_MATH_SMALL_FUNC void store(float *p, f4 v) {vst1q_f32(p, v);}
+        IMP_MATH_SMALL_FUNC f4 splat(float x) {return vdupq_n_f32(x);}
+        IMP_MATH_SMALL_FUNC f4 make(float x, float y, float z, float w) {const float array[4] = {x, y, z, w}; return vld1q_f32(array);}
+        IMP_MATH_SMALL_FUNC f4 add(f4 a, f4 b) {return vaddq_f32(a, b);}
+        IMP_MATH_SMALL_FUNC f4 sub(f4 a, f4 b) {return vsubq_f32(a, b);}
+        IMP_MATH_SMALL_FUNC f4 mul(f4 a, f4 b) {return vmulq_f32(a, b);}
+        IMP_MATH_SMALL_FUNC f4 div(f4 a, f4 b) {return vdivq_f32(a, b);}
+        IMP_MATH_SMALL_FUNC float sum(f4 v) {return vaddvq_f32(v);}
+        template <int X, int Y, int Z, int W> IMP_MATH_SMALL_FUNC f4 permute(f4 v) {return __builtin_shufflevector(v, v, X, Y, Z, W);}
+        IMP_MATH_SMALL_FUNC void transpose(f4 &a, f4 &b, f4 &c, f4 &d)
+        {
+            float32x4x2_t ab = vtrnq_f32(a, b), cd = vtrnq_f32(c, d);
+            a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+            b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+            c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+            d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+        }
+        #elif defined(IMP_MATH_SIMD_WASM)
+        using f4 = v128_t;
+        IMP_MATH_SMALL_FUNC f4 load(const float *p) {return wasm_v128_load(p);}
+        IMP_MATH_SMALL_FUNC void store(float *p, f4 v) {wasm_v128_store(p, v);}
+        IMP_MATH_SMALL_FUNC f4 splat(float x) {return wasm_f32x4_splat(x);}
+        IMP_MATH_SMALL_FUNC f4 make(float x, float y, float z, float w) {return wasm_f32x4_make(x, y, z, w);}
+        IMP_MATH_SMALL_FUNC f4 add(f4 a, f4 b) {return wasm_f32x4_add(a, b);}
+        IMP_MATH_SMALL_FUNC f4 sub(f4 a, f4 b) {return wasm_f32x4_sub(a, b);}
+        IMP_MATH_SMALL_FUNC f4 mul(f4 a, f4 b) {return wasm_f32x4_mul(a, b);}
+        IMP_MATH_SMALL_FUNC f4 div(f4 a, f4 b) {return wasm_f32x4_div(a, b);}
+        IMP_MATH_SMALL_FUNC float sum(f4 v) {return wasm_f32x4_extract_lane(v, 0) + wasm_f32x4_extract_lane(v, 1) + wasm_f32x4_extract_lane(v, 2) + wasm_f32x4_extract_lane(v, 3);}
+        template <int X, int Y, int Z, int W> IMP_MATH_SMALL_FUNC f4 permute(f4 v) {return wasm_i32x4_shuffle(v, v, X, Y, Z, W);}
+        IMP_MATH_SMALL_FUNC void transpose(f4 &a, f4 &b, f4 &c, f4 &d)
+        {
+            f4 ab_lo = wasm_i32x4_shuffle(a, b, 0, 4, 1, 5), cd_lo = wasm_i32x4_shuffle(c, d, 0, 4, 1, 5);
+            f4 ab_hi = wasm_i32x4_shuffle(a, b, 2, 6, 3, 7), cd_hi = wasm_i32x4_shuffle(c, d, 2, 6, 3, 7);
+            a = wasm_i32x4_shuffle(ab_lo, cd_lo, 0, 1, 4, 5);
+            b = wasm_i32x4_shuffle(ab_lo, cd_lo, 2, 3, 6, 7);
+            c = wasm_i32x4_shuffle(ab_hi, cd_hi, 0, 1, 4, 5);
+            d = wasm_i32x4_shuffle(ab_hi, cd_hi, 2, 3, 6, 7);
+        }
+        #endif
+
+        #if defined(IMP_MATH_SIMD_SSE) || defined(IMP_MATH_SIMD_NEON) || defined(IMP_MATH_SIMD_WASM)
+        // The cross product of the first three components. The fourth one is zero, unless the inputs are not finite.
+        IMP_MATH_SMALL_FUNC f4 cross3(f4 a, f4 b) {return sub(mul(permute<1,2,0,3>(a), permute<2,0,1,3>(b)), mul(permute<2,0,1,3>(a), permute<1,2,0,3>(b)));}
+
+        IMP_MATH_SMALL_FUNC void add4(const float *a, const float *b, float *out) {store(out, add(load(a), load(b)));}
+        IMP_MATH_SMALL_FUNC void sub4(const float *a, const float *b, float *out) {store(out, sub(load(a), load(b)));}
+        IMP_MATH_SMALL_FUNC void mul4(const float *a, const float *b, float *out) {store(out, mul(load(a), load(b)));}
+        IMP_MATH_SMALL_FUNC void div4(const float *a, const float *b, float *out) {store(out, div(load(a), load(b)));}
+        IMP_MATH_SMALL_FUNC float dot4(const float *a, const float *b) {return sum(mul(load(a), load(b)));}
+
+        IMP_MATH_SMALL_FUNC void mul_mat4_vec4(const float *m, const float *v, float *out)
+        {
+            // Same summation order as the scalar code.
+            f4 ret = mul(load(m), splat(v[0]));
+            ret = add(ret, mul(load(m + 4), splat(v[1])));
+            ret = add(ret, mul(load(m + 8), splat(v[2])));
+            ret = add(ret, mul(load(m + 12), splat(v[3])));
+            store(out, ret);
+        }
+
+        inline void mul_mat4_mat4(const float *a, const float *b, float *out)
+        {
+            for (int i = 0; i < 4; i++)
+                mul_mat4_vec4(a, b + i * 4, out + i * 4);
+        }
+
+        inline bool inverse_mat4(const float *m, float *out)
+        {
+            // From "Foundations of Game Engine Development, Volume 1" by Eric Lengyel.
+            // The columns `a`,`b`,`c`,`d` are treated as 3D vectors, and `x`,`y`,`z`,`w` is the bottom row.
+            f4 a = load(m), b = load(m + 4), c = load(m + 8), d = load(m + 12);
+            float x = m[3], y = m[7], z = m[11], w = m[15];
+
+            f4 s = cross3(a, b);
+            f4 t = cross3(c, d);
+            f4 u = sub(mul(a, splat(y)), mul(b, splat(x)));
+            f4 v = sub(mul(c, splat(w)), mul(d, splat(z)));
+
+            // The fourth components of `s` and `t` are zero, so 4D dot products can be used everywhere.
+            float det = sum(mul(s, v)) + sum(mul(t, u));
+            if (det == 0)
+                return false;
+            f4 inv_det = splat(1 / det);
+            s = mul(s, inv_det);
+            t = mul(t, inv_det);
+            u = mul(u, inv_det);
+            v = mul(v, inv_det);
+
+            // The rows of the result. Their fourth components are zero, and get replaced after transposing.
+            f4 r0 = add(cross3(b, v), mul(t, splat(y)));
+            f4 r1 = sub(cross3(v, a), mul(t, splat(x)));
+            f4 r2 = add(cross3(d, u), mul(s, splat(w)));
+            f4 r3 = sub(cross3(u, c), mul(s, splat(z)));
+            transpose(r0, r1, r2, r3);
+            r3 = make(-sum(mul(b, t)), sum(mul(a, t)), -sum(mul(d, s)), sum(mul(c, s)));
+
+            store(out, r0);
+            store(out + 4, r1);
+            store(out + 8, r2);
+            store(out + 12, r3);
+            return true;
+        }
+        #endif
+    }
+
     inline namespace Vector // Operators
     {
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator+(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() + std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a + b;}, a, b);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator-(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() - std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a - b;}, a, b);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator*(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() * std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a * b;}, a, b);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator/(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() / std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a / b;}, a, b);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator%(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() % std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a % b;}, a, b);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator^(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() ^ std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a ^ b;}, a, b);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator&(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() & std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a & b;}, a, b);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator|(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() | std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a | b;}, a, b);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator<<(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() << std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a << b;}, a, b);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator>>(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() >> std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a >> b;}, a, b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator+(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() + std::declval<vec_base_t<B>>())> {if constexpr (Simd::enabled && std::is_same_v<A, vec4<float>> && std::is_same_v<B, vec4<float>>) {if (!std::is_constant_evaluated()) {A ret(uninit{}); Simd::add4(a.as_array(), b.as_array(), ret.as_array()); return ret;}} return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a + b;}, a, b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator-(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() - std::declval<vec_base_t<B>>())> {if constexpr (Simd::enabled && std::is_same_v<A, vec4<float>> && std::is_same_v<B, vec4<float>>) {if (!std::is_constant_evaluated()) {A ret(uninit{}); Simd::sub4(a.as_array(), b.as_array(), ret.as_array()); return ret;}} return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a - b;}, a, b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator*(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() * std::declval<vec_base_t<B>>())> {if constexpr (Simd::enabled && std::is_same_v<A, vec4<float>> && std::is_same_v<B, vec4<float>>) {if (!std::is_constant_evaluated()) {A ret(uninit{}); Simd::mul4(a.as_array(), b.as_array(), ret.as_array()); return ret;}} return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a * b;}, a, b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator/(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() / std::declval<vec_base_t<B>>())> {if constexpr (Simd::enabled && std::is_same_v<A, vec4<float>> && std::is_same_v<B, vec4<float>>) {if (!std::is_constant_evaluated()) {A ret(uninit{}); Simd::div4(a.as_array(), b.as_array(), ret.as_array()); return ret;}} return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a / b;}, a, b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator%(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() % std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a % b;}, a, b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator^(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() ^ std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a ^ b;}, a, b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator&(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() & std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a & b;}, a, b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator|(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() | std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a | b;}, a, b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator<<(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() << std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a << b;}, a, b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator>>(const A &a, const B &b) -> vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, decltype(std::declval<vec_base_t<A>>() >> std::declval<vec_base_t<B>>())> {return apply_elementwise([](vec_base_t<A> a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {return a >> b;}, a, b);}
         template <vector V> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator~(const V &v) -> change_vec_base_t<V, decltype(~v.x)> {return apply_elementwise([](vec_base_t<V> v) IMP_MATH_SMALL_LAMBDA {return ~v;}, v);}
         template <vector V> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator+(const V &v) -> change_vec_base_t<V, decltype(+v.x)> {return apply_elementwise([](vec_base_t<V> v) IMP_MATH_SMALL_LAMBDA {return +v;}, v);}
         template <vector V> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr auto operator-(const V &v) -> change_vec_base_t<V, decltype(-v.x)> {return apply_elementwise([](vec_base_t<V> v) IMP_MATH_SMALL_LAMBDA {return -v;}, v);}
@@ -615,7 +781,7 @@ namespace Math
         template <vector A, safely_convertible_to<A> B> IMP_MATH_SMALL_FUNC constexpr auto operator|=(A &a, const B &b) -> decltype(std::enable_if_t<vector<A> && vector_or_scalar<B>>(), void(std::declval<vec_base_t<A> &>() |= std::declval<vec_base_t<B>>()), std::declval<A &>()) {apply_elementwise([](vec_base_t<A> &a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {a |= b;}, a, b); return a;}
         template <vector A, safely_convertible_to<A> B> IMP_MATH_SMALL_FUNC constexpr auto operator<<=(A &a, const B &b) -> decltype(std::enable_if_t<vector<A> && vector_or_scalar<B>>(), void(std::declval<vec_base_t<A> &>() <<= std::declval<vec_base_t<B>>()), std::declval<A &>()) {apply_elementwise([](vec_base_t<A> &a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {a <<= b;}, a, b); return a;}
         template <vector A, safely_convertible_to<A> B> IMP_MATH_SMALL_FUNC constexpr auto operator>>=(A &a, const B &b) -> decltype(std::enable_if_t<vector<A> && vector_or_scalar<B>>(), void(std::declval<vec_base_t<A> &>() >>= std::declval<vec_base_t<B>>()), std::declval<A &>()) {apply_elementwise([](vec_base_t<A> &a, vec_base_t<B> b) IMP_MATH_SMALL_LAMBDA {a >>= b;}, a, b); return a;}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator<(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) < b; else return a < compare_elemwise(b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator<(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) < b; else return a < compare_elemwise(b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator<(compare_any<A> &&a, const B &b) {return any_nonzero_elements(apply_elementwise(std::less{}, a.value, b));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator<(const A &a, compare_any<B> &&b) {return any_nonzero_elements(apply_elementwise(std::less{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator<(compare_all<A> &&a, const B &b) {return all_nonzero_elements(apply_elementwise(std::less{}, a.value, b));}
@@ -626,7 +792,7 @@ namespace Math
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator<(const A &a, compare_not_all<B> &&b) {return not_all_nonzero_elements(apply_elementwise(std::less{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator<(compare_elemwise<A> &&a, const B &b) {return apply_elementwise(std::less{}, a.value, b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator<(const A &a, compare_elemwise<B> &&b) {return apply_elementwise(std::less{}, a, b.value);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator>(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) > b; else return a > compare_elemwise(b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator>(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) > b; else return a > compare_elemwise(b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator>(compare_any<A> &&a, const B &b) {return any_nonzero_elements(apply_elementwise(std::greater{}, a.value, b));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator>(const A &a, compare_any<B> &&b) {return any_nonzero_elements(apply_elementwise(std::greater{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator>(compare_all<A> &&a, const B &b) {return all_nonzero_elements(apply_elementwise(std::greater{}, a.value, b));}
@@ -637,7 +803,7 @@ namespace Math
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator>(const A &a, compare_not_all<B> &&b) {return not_all_nonzero_elements(apply_elementwise(std::greater{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator>(compare_elemwise<A> &&a, const B &b) {return apply_elementwise(std::greater{}, a.value, b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator>(const A &a, compare_elemwise<B> &&b) {return apply_elementwise(std::greater{}, a, b.value);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator<=(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) <= b; else return a <= compare_elemwise(b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator<=(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) <= b; else return a <= compare_elemwise(b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator<=(compare_any<A> &&a, const B &b) {return any_nonzero_elements(apply_elementwise(std::less_equal{}, a.value, b));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator<=(const A &a, compare_any<B> &&b) {return any_nonzero_elements(apply_elementwise(std::less_equal{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator<=(compare_all<A> &&a, const B &b) {return all_nonzero_elements(apply_elementwise(std::less_equal{}, a.value, b));}
@@ -648,7 +814,7 @@ namespace Math
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator<=(const A &a, compare_not_all<B> &&b) {return not_all_nonzero_elements(apply_elementwise(std::less_equal{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator<=(compare_elemwise<A> &&a, const B &b) {return apply_elementwise(std::less_equal{}, a.value, b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator<=(const A &a, compare_elemwise<B> &&b) {return apply_elementwise(std::less_equal{}, a, b.value);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator>=(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) >= b; else return a >= compare_elemwise(b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator>=(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) >= b; else return a >= compare_elemwise(b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator>=(compare_any<A> &&a, const B &b) {return any_nonzero_elements(apply_elementwise(std::greater_equal{}, a.value, b));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator>=(const A &a, compare_any<B> &&b) {return any_nonzero_elements(apply_elementwise(std::greater_equal{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator>=(compare_all<A> &&a, const B &b) {return all_nonzero_elements(apply_elementwise(std::greater_equal{}, a.value, b));}
@@ -659,7 +825,7 @@ namespace Math
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator>=(const A &a, compare_not_all<B> &&b) {return not_all_nonzero_elements(apply_elementwise(std::greater_equal{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator>=(compare_elemwise<A> &&a, const B &b) {return apply_elementwise(std::greater_equal{}, a.value, b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator>=(const A &a, compare_elemwise<B> &&b) {return apply_elementwise(std::greater_equal{}, a, b.value);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator==(const A &a, const B &b) {if constexpr (vector<A>) return compare_all(a) == b; else return a == compare_all(b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator==(const A &a, const B &b) {if constexpr (vector<A>) return compare_all(a) == b; else return a == compare_all(b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator==(compare_any<A> &&a, const B &b) {return any_nonzero_elements(apply_elementwise(std::equal_to{}, a.value, b));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator==(const A &a, compare_any<B> &&b) {return any_nonzero_elements(apply_elementwise(std::equal_to{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator==(compare_all<A> &&a, const B &b) {return all_nonzero_elements(apply_elementwise(std::equal_to{}, a.value, b));}
@@ -670,7 +836,7 @@ namespace Math
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator==(const A &a, compare_not_all<B> &&b) {return not_all_nonzero_elements(apply_elementwise(std::equal_to{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator==(compare_elemwise<A> &&a, const B &b) {return apply_elementwise(std::equal_to{}, a.value, b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator==(const A &a, compare_elemwise<B> &&b) {return apply_elementwise(std::equal_to{}, a, b.value);}
-        template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator!=(const A &a, const B &b) {if constexpr (vector<A>) return compare_any(a) != b; else return a != compare_any(b);}
+        template <vector_or_scalar A, vector_or_scalar B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator!=(const A &a, const B &b) {if constexpr (vector<A>) return compare_any(a) != b; else return a != compare_any(b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator!=(compare_any<A> &&a, const B &b) {return any_nonzero_elements(apply_elementwise(std::not_equal_to{}, a.value, b));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator!=(const A &a, compare_any<B> &&b) {return any_nonzero_elements(apply_elementwise(std::not_equal_to{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator!=(compare_all<A> &&a, const B &b) {return all_nonzero_elements(apply_elementwise(std::not_equal_to{}, a.value, b));}
@@ -681,7 +847,7 @@ namespace Math
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator!=(const A &a, compare_not_all<B> &&b) {return not_all_nonzero_elements(apply_elementwise(std::not_equal_to{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator!=(compare_elemwise<A> &&a, const B &b) {return apply_elementwise(std::not_equal_to{}, a.value, b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator!=(const A &a, compare_elemwise<B> &&b) {return apply_elementwise(std::not_equal_to{}, a, b.value);}
-        template <vector_or_scalar_with_base<bool> A, vector_or_scalar_with_base<bool> B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator&&(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) && b; else return a && compare_elemwise(b);}
+        template <vector_or_scalar_with_base<bool> A, vector_or_scalar_with_base<bool> B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator&&(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) && b; else return a && compare_elemwise(b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator&&(compare_any<A> &&a, const B &b) {return any_nonzero_elements(apply_elementwise(std::logical_and{}, a.value, b));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator&&(const A &a, compare_any<B> &&b) {return any_nonzero_elements(apply_elementwise(std::logical_and{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator&&(compare_all<A> &&a, const B &b) {return all_nonzero_elements(apply_elementwise(std::logical_and{}, a.value, b));}
@@ -692,7 +858,7 @@ namespace Math
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator&&(const A &a, compare_not_all<B> &&b) {return not_all_nonzero_elements(apply_elementwise(std::logical_and{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator&&(compare_elemwise<A> &&a, const B &b) {return apply_elementwise(std::logical_and{}, a.value, b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator&&(const A &a, compare_elemwise<B> &&b) {return apply_elementwise(std::logical_and{}, a, b.value);}
-        template <vector_or_scalar_with_base<bool> A, vector_or_scalar_with_base<bool> B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator||(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) || b; else return a || compare_elemwise(b);}
+        template <vector_or_scalar_with_base<bool> A, vector_or_scalar_with_base<bool> B> requires any_vectors_v<A, B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr vec<common_vec_size_v<vec_size_v<A>, vec_size_v<B>>, bool> operator||(const A &a, const B &b) {if constexpr (vector<A>) return compare_elemwise(a) || b; else return a || compare_elemwise(b);}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator||(compare_any<A> &&a, const B &b) {return any_nonzero_elements(apply_elementwise(std::logical_or{}, a.value, b));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator||(const A &a, compare_any<B> &&b) {return any_nonzero_elements(apply_elementwise(std::logical_or{}, a, b.value));}
         template <vector_or_scalar A, vector_or_scalar B> [[nodiscard]] IMP_MATH_SMALL_FUNC constexpr bool operator||(compare_all<A> &&a, const B &b) {return all_nonzero_elements(apply_elementwise(std::logical_or{}, a.value, b));}
@@ -762,7 +928,7 @@ namespace Math
         template <typename A, typename B> [[nodiscard]] constexpr vec3<larger_t<A,B>> operator*(const mat4x3<A> &a, const vec4<B> &b) {return {a.x.x*b.x + a.y.x*b.y + a.z.x*b.z + a.w.x*b.w, a.x.y*b.x + a.y.y*b.y + a.z.y*b.z + a.w.y*b.w, a.x.z*b.x + a.y.z*b.y + a.z.z*b.z + a.w.z*b.w};}
         template <typename A, typename B> [[nodiscard]] constexpr vec4<larger_t<A,B>> operator*(const mat2x4<A> &a, const vec2<B> &b) {return {a.x.x*b.x + a.y.x*b.y, a.x.y*b.x + a.y.y*b.y, a.x.z*b.x + a.y.z*b.y, a.x.w*b.x + a.y.w*b.y};}
         template <typename A, typename B> [[nodiscard]] constexpr vec4<larger_t<A,B>> operator*(const mat3x4<A> &a, const vec3<B> &b) {return {a.x.x*b.x + a.y.x*b.y + a.z.x*b.z, a.x.y*b.x + a.y.y*b.y + a.z.y*b.z, a.x.z*b.x + a.y.z*b.y + a.z.z*b.z, a.x.w*b.x + a.y.w*b.y + a.z.w*b.z};}
-        template <typename A, typename B> [[nodiscard]] constexpr vec4<larger_t<A,B>> operator*(const mat4x4<A> &a, const vec4<B> &b) {return {a.x.x*b.x + a.y.x*b.y + a.z.x*b.z + a.w.x*b.w, a.x.y*b.x + a.y.y*b.y + a.z.y*b.z + a.w.y*b.w, a.x.z*b.x + a.y.z*b.y + a.z.z*b.z + a.w.z*b.w, a.x.w*b.x + a.y.w*b.y + a.z.w*b.z + a.w.w*b.w};}
+        template <typename A, typename B> [[nodiscard]] constexpr vec4<larger_t<A,B>> operator*(const mat4x4<A> &a, const vec4<B> &b) {if constexpr (Simd::enabled && std::is_same_v<A, float> && std::is_same_v<B, float>) {if (!std::is_constant_evaluated()) {vec4<larger_t<A,B>> ret(uninit{}); Simd::mul_mat4_vec4(a.as_array(), b.as_array(), ret.as_array()); return ret;}} return {a.x.x*b.x + a.y.x*b.y + a.z.x*b.z + a.w.x*b.w, a.x.y*b.x + a.y.y*b.y + a.z.y*b.z + a.w.y*b.w, a.x.z*b.x + a.y.z*b.y + a.z.z*b.z + a.w.z*b.w, a.x.w*b.x + a.y.w*b.y + a.z.w*b.z + a.w.w*b.w};}
         template <typename A, typename B> [[nodiscard]] constexpr vec2<larger_t<A,B>> operator*(const vec2<A> &a, const mat2x2<B> &b) {return {a.x*b.x.x + a.y*b.x.y, a.x*b.y.x + a.y*b.y.y};}
         template <typename A, typename B> [[nodiscard]] constexpr vec2<larger_t<A,B>> operator*(const vec3<A> &a, const mat2x3<B> &b) {return {a.x*b.x.x + a.y*b.x.y + a.z*b.x.z, a.x*b.y.x + a.y*b.y.y + a.z*b.y.z};}
         template <typename A, typename B> [[nodiscard]] constexpr vec2<larger_t<A,B>> operator*(const vec4<A> &a, const mat2x4<B> &b) {return {a.x*b.x.x + a.y*b.x.y + a.z*b.x.z + a.w*b.x.w, a.x*b.y.x + a.y*b.y.y + a.z*b.y.z + a.w*b.y.w};}
@@ -798,7 +964,7 @@ namespace Math
         template <typename A, typename B> [[nodiscard]] constexpr mat4x3<larger_t<A,B>> operator*(const mat4x3<A> &a, const mat4x4<B> &b) {return {a.x.x*b.x.x + a.y.x*b.x.y + a.z.x*b.x.z + a.w.x*b.x.w, a.x.x*b.y.x + a.y.x*b.y.y + a.z.x*b.y.z + a.w.x*b.y.w, a.x.x*b.z.x + a.y.x*b.z.y + a.z.x*b.z.z + a.w.x*b.z.w, a.x.x*b.w.x + a.y.x*b.w.y + a.z.x*b.w.z + a.w.x*b.w.w, a.x.y*b.x.x + a.y.y*b.x.y + a.z.y*b.x.z + a.w.y*b.x.w, a.x.y*b.y.x + a.y.y*b.y.y + a.z.y*b.y.z + a.w.y*b.y.w, a.x.y*b.z.x + a.y.y*b.z.y + a.z.y*b.z.z + a.w.y*b.z.w, a.x.y*b.w.x + a.y.y*b.w.y + a.z.y*b.w.z + a.w.y*b.w.w, a.x.z*b.x.x + a.y.z*b.x.y + a.z.z*b.x.z + a.w.z*b.x.w, a.x.z*b.y.x + a.y.z*b.y.y + a.z.z*b.y.z + a.w.z*b.y.w, a.x.z*b.z.x + a.y.z*b.z.y + a.z.z*b.z.z + a.w.z*b.z.w, a.x.z*b.w.x + a.y.z*b.w.y + a.z.z*b.w.z + a.w.z*b.w.w};}
         template <typename A, typename B> [[nodiscard]] constexpr mat4x4<larger_t<A,B>> operator*(const mat2x4<A> &a, const mat4x2<B> &b) {return {a.x.x*b.x.x + a.y.x*b.x.y, a.x.x*b.y.x + a.y.x*b.y.y, a.x.x*b.z.x + a.y.x*b.z.y, a.x.x*b.w.x + a.y.x*b.w.y, a.x.y*b.x.x + a.y.y*b.x.y, a.x.y*b.y.x + a.y.y*b.y.y, a.x.y*b.z.x + a.y.y*b.z.y, a.x.y*b.w.x + a.y.y*b.w.y, a.x.z*b.x.x + a.y.z*b.x.y, a.x.z*b.y.x + a.y.z*b.y.y, a.x.z*b.z.x + a.y.z*b.z.y, a.x.z*b.w.x + a.y.z*b.w.y, a.x.w*b.x.x + a.y.w*b.x.y, a.x.w*b.y.x + a.y.w*b.y.y, a.x.w*b.z.x + a.y.w*b.z.y, a.x.w*b.w.x + a.y.w*b.w.y};}
         template <typename A, typename B> [[nodiscard]] constexpr mat4x4<larger_t<A,B>> operator*(const mat3x4<A> &a, const mat4x3<B> &b) {return {a.x.x*b.x.x + a.y.x*b.x.y + a.z.x*b.x.z, a.x.x*b.y.x + a.y.x*b.y.y + a.z.x*b.y.z, a.x.x*b.z.x + a.y.x*b.z.y + a.z.x*b.z.z, a.x.x*b.w.x + a.y.x*b.w.y + a.z.x*b.w.z, a.x.y*b.x.x + a.y.y*b.x.y + a.z.y*b.x.z, a.x.y*b.y.x + a.y.y*b.y.y + a.z.y*b.y.z, a.x.y*b.z.x + a.y.y*b.z.y + a.z.y*b.z.z, a.x.y*b.w.x + a.y.y*b.w.y + a.z.y*b.w.z, a.x.z*b.x.x + a.y.z*b.x.y + a.z.z*b.x.z, a.x.z*b.y.x + a.y.z*b.y.y + a.z.z*b.y.z, a.x.z*b.z.x + a.y.z*b.z.y + a.z.z*b.z.z, a.x.z*b.w.x + a.y.z*b.w.y + a.z.z*b.w.z, a.x.w*b.x.x + a.y.w*b.x.y + a.z.w*b.x.z, a.x.w*b.y.x + a.y.w*b.y.y + a.z.w*b.y.z, a.x.w*b.z.x + a.y.w*b.z.y + a.z.w*b.z.z, a.x.w*b.w.x + a.y.w*b.w.y + a.z.w*b.w.z};}
-        template <typename A, typename B> [[nodiscard]] constexpr mat4x4<larger_t<A,B>> operator*(const mat4x4<A> &a, const mat4x4<B> &b) {return {a.x.x*b.x.x + a.y.x*b.x.y + a.z.x*b.x.z + a.w.x*b.x.w, a.x.x*b.y.x + a.y.x*b.y.y + a.z.x*b.y.z + a.w.x*b.y.w, a.x.x*b.z.x + a.y.x*b.z.y + a.z.x*b.z.z + a.w.x*b.z.w, a.x.x*b.w.x + a.y.x*b.w.y + a.z.x*b.w.z + a.w.x*b.w.w, a.x.y*b.x.x + a.y.y*b.x.y + a.z.y*b.x.z + a.w.y*b.x.w, a.x.y*b.y.x + a.y.y*b.y.y + a.z.y*b.y.z + a.w.y*b.y.w, a.x.y*b.z.x + a.y.y*b.z.y + a.z.y*b.z.z + a.w.y*b.z.w, a.x.y*b.w.x + a.y.y*b.w.y + a.z.y*b.w.z + a.w.y*b.w.w, a.x.z*b.x.x + a.y.z*b.x.y + a.z.z*b.x.z + a.w.z*b.x.w, a.x.z*b.y.x + a.y.z*b.y.y + a.z.z*b.y.z + a.w.z*b.y.w, a.x.z*b.z.x + a.y.z*b.z.y + a.z.z*b.z.z + a.w.z*b.z.w, a.x.z*b.w.x + a.y.z*b.w.y + a.z.z*b.w.z + a.w.z*b.w.w, a.x.w*b.x.x + a.y.w*b.x.y + a.z.w*b.x.z + a.w.w*b.x.w, a.x.w*b.y.x + a.y.w*b.y.y + a.z.w*b.y.z + a.w.w*b.y.w, a.x.w*b.z.x + a.y.w*b.z.y + a.z.w*b.z.z + a.w.w*b.z.w, a.x.w*b.w.x + a.y.w*b.w.y + a.z.w*b.w.z + a.w.w*b.w.w};}
+        template <typename A, typename B> [[nodiscard]] constexpr mat4x4<larger_t<A,B>> operator*(const mat4x4<A> &a, const mat4x4<B> &b) {if constexpr (Simd::enabled && std::is_same_v<A, float> && std::is_same_v<B, float>) {if (!std::is_constant_evaluated()) {mat4x4<larger_t<A,B>> ret(uninit{}); Simd::mul_mat4_mat4(a.as_array(), b.as_array(), ret.as_array()); return ret;}} return {a.x.x*b.x.x + a.y.x*b.x.y + a.z.x*b.x.z + a.w.x*b.x.w, a.x.x*b.y.x + a.y.x*b.y.y + a.z.x*b.y.z + a.w.x*b.y.w, a.x.x*b.z.x + a.y.x*b.z.y + a.z.x*b.z.z + a.w.x*b.z.w, a.x.x*b.w.x + a.y.x*b.w.y + a.z.x*b.w.z + a.w.x*b.w.w, a.x.y*b.x.x + a.y.y*b.x.y + a.z.y*b.x.z + a.w.y*b.x.w, a.x.y*b.y.x + a.y.y*b.y.y + a.z.y*b.y.z + a.w.y*b.y.w, a.x.y*b.z.x + a.y.y*b.z.y + a.z.y*b.z.z + a.w.y*b.z.w, a.x.y*b.w.x + a.y.y*b.w.y + a.z.y*b.w.z + a.w.y*b.w.w, a.x.z*b.x.x + a.y.z*b.x.y + a.z.z*b.x.z + a.w.z*b.x.w, a.x.z*b.y.x + a.y.z*b.y.y + a.z.z*b.y.z + a.w.z*b.y.w, a.x.z*b.z.x + a.y.z*b.z.y + a.z.z*b.z.z + a.w.z*b.z.w, a.x.z*b.w.x + a.y.z*b.w.y + a.z.z*b.w.z + a.w.z*b.w.w, a.x.w*b.x.x + a.y.w*b.x.y + a.z.w*b.x.z + a.w.w*b.x.w, a.x.w*b.y.x + a.y.w*b.y.y + a.z.w*b.y.z + a.w.w*b.y.w, a.x.w*b.z.x + a.y.w*b.z.y + a.z.w*b.z.z + a.w.w*b.z.w, a.x.w*b.w.x + a.y.w*b.w.y + a.z.w*b.w.z + a.w.w*b.w.w};}
 
         template <typename A, typename B, int D> constexpr vec<D,A> &operator*=(vec<D,A> &a, const mat<D,D,B> &b) {a = a * b; return a;}
         template <typename A, typename B, int W, int H> constexpr mat<W,H,A> &operator*=(mat<W,H,A> &a, const mat<W,W,B> &b) {a = a * b; return a;}
@@ -1816,7 +1982,7 @@ namespace Math
             [[nodiscard]] constexpr auto approx_norm() const {return *this * approx_inv_len();} // Guaranteed to converge to `len()==1` eventually, when starting from any finite `len_sq()`.
             [[nodiscard]] static constexpr vec axis(int a, type len = 1) {vec ret{}; ret[mod_ex(a,4)] = len; return ret;}
             [[nodiscard]] constexpr vec only_component(int a) {vec ret{}; a = mod_ex(a,4); ret[a] = (*this)[a]; return ret;}
-            template <typename U> [[nodiscard]] constexpr auto dot(const vec4<U> &o) const {return x * o.x + y * o.y + z * o.z + w * o.w;}
+            template <typename U> [[nodiscard]] constexpr auto dot(const vec4<U> &o) const {if constexpr (Simd::enabled && std::is_same_v<type, float> && std::is_same_v<U, float>) {if (!std::is_constant_evaluated()) return Simd::dot4(as_array(), o.as_array());} return x * o.x + y * o.y + z * o.z + w * o.w;}
             [[nodiscard]] constexpr auto tie() & {return std::tie(x,y,z,w);}
             [[nodiscard]] constexpr auto tie() const & {return std::tie(x,y,z,w);}
             template <int I> [[nodiscard]] constexpr type &get() & {return std::get<I>(tie());}
@@ -2296,6 +2462,17 @@ namespace Math
             [[nodiscard]] constexpr mat4x4<T> transpose() const {return {x.x,x.y,x.z,x.w,y.x,y.y,y.z,y.w,z.x,z.y,z.z,z.w,w.x,w.y,w.z,w.w};}
             [[nodiscard]] constexpr mat inverse() const requires is_floating_point
             {
+                if constexpr (Simd::enabled && std::is_same_v<type, float>)
+                {
+                    if (!std::is_constant_evaluated())
+                    {
+                        mat ret(uninit{});
+                        if (!Simd::inverse_mat4(as_array(), ret.as_array()))
+                        return {};
+                        return ret;
+                    }
+                }
+
                 mat ret;
 
                 ret.x.x =  y.y * z.z * w.w - y.y * z.w * w.z - z.y * y.z * w.w + z.y * y.w * w.z + w.y * y.z * z.w - w.y * y.w * z.z;
@@ -2504,12 +2681,38 @@ namespace std
 
     template <int D, typename T> struct hash<Math::vec<D,T>>
     {
+        // Multiplies the numbers into 128 bits, and xors the two halves. This is the mixing function from wyhash.
+        [[nodiscard]] static constexpr std::uint64_t mix(std::uint64_t a, std::uint64_t b)
+        {
+            #ifdef __SIZEOF_INT128__
+            __extension__ using u128 = unsigned __int128;
+            u128 r = u128(a) * b;
+            return std::uint64_t(r) ^ std::uint64_t(r >> 64);
+            #else
+            std::uint64_t a_lo = std::uint32_t(a), a_hi = a >> 32, b_lo = std::uint32_t(b), b_hi = b >> 32;
+            std::uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+            std::uint64_t cross = (lo_lo >> 32) + std::uint32_t(hi_lo) + lo_hi;
+            return ((cross << 32) | std::uint32_t(lo_lo)) ^ (hi_hi + (hi_lo >> 32) + (cross >> 32));
+            #endif
+        }
+
         std::size_t operator()(const Math::vec<D,T> &v) const
         {
-            std::size_t ret = std::hash<decltype(v.x)>{}(v.x);
-            for (int i = 1; i < D; i++)
-                ret ^= std::hash<decltype(v.x)>{}(v[i]) + std::size_t(0x9E3779B97F4A7C16) + (ret << 6) + (ret >> 2); // Boost uses something similar.
-            return ret;
+            if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool> && sizeof(T) * D <= 8)
+            {
+                // Small integral vectors (e.g. `ivec2`) are packed into a single 64-bit number, and mixed once.
+                std::uint64_t packed = 0;
+                for (int i = 0; i < D; i++)
+                    packed |= std::uint64_t(std::make_unsigned_t<T>(v[i])) << (i * sizeof(T) * 8);
+                return std::size_t(mix(packed ^ 0x2d358dccaa6c78a5, 0x8bb84b93962eacc9));
+            }
+            else
+            {
+                std::uint64_t ret = 0x4b33a62ed433d4a3;
+                for (int i = 0; i < D; i++)
+                    ret = mix(ret ^ std::hash<T>{}(v[i]), 0x8bb84b93962eacc9);
+                return std::size_t(ret);
+            }
         }
     };
 }
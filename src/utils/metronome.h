@@ -1,12 +1,27 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 
 #include "utils/clock.h"
 
 class Metronome
 {
+  public:
+    // What to do when the ticks can't keep up with the real time.
+    enum class CatchUp
+    {
+        // Run up to `MaxTicksPerFrame()` ticks per frame. If the ticks are consistently slower than the real time,
+        //   this runs the max number of ticks every frame, which makes the frames even longer (the "death spiral").
+        clamp,
+        // Additionally measure how long the ticks take, and only run as many ticks per frame as fit into `TickBudget()` of the frame time.
+        // The rest of the time is dropped, i.e. the game slows down instead of freezing.
+        dilate,
+    };
+
+  private:
     // Desired tick length, measured in clock ticks.
     std::uint64_t tick_len = 0;
     // Max ticks per frame. 0 = no limit.
@@ -27,6 +42,16 @@ class Metronome
     float comp_amount = 0;
     int comp_dir = 0; // 1 = forward, -1 = backward, 0 = away from `tick_len`.
 
+    // Adaptive catch-up.
+    CatchUp catch_up = CatchUp::clamp;
+    float tick_budget = 0.8f; // The fraction of the frame time that the ticks can use.
+    double tick_cost = 0; // The average tick duration in clock ticks, or 0 if unknown. Only measured with `CatchUp::dilate`.
+    std::uint64_t tick_start = 0; // When the last tick started, if `measuring_tick` is true.
+    bool measuring_tick = false;
+    std::uint64_t frame_delta = 0;
+    int ticks_this_frame = 0;
+    std::uint64_t dilated_time = 0; // The total time dropped by `CatchUp::dilate`.
+
   public:
     // Tick counter.
     std::uint64_t ticks = 0;
@@ -58,6 +83,15 @@ class Metronome
         comp_th = threshold;
         comp_amount = amount;
     }
+    // `budget` is the fraction of the frame time that the ticks are allowed to take, only used with `CatchUp::dilate`.
+    void SetCatchUp(CatchUp policy, float budget = 0.8f)
+    {
+        catch_up = policy;
+        tick_budget = budget;
+        tick_cost = 0;
+        measuring_tick = false;
+    }
+
     void Reset()
     {
         accumulator = 0;
@@ -65,6 +99,10 @@ class Metronome
         lag = false;
         comp_dir = 0;
         ticks = 0;
+        tick_cost = 0;
+        measuring_tick = false;
+        ticks_this_frame = 0;
+        dilated_time = 0;
     }
 
     [[nodiscard]] bool Lag() // Flag resets after this function is called. The flag is set to 1 if the amount of ticks per last frame is at maximum value.
@@ -96,8 +134,20 @@ class Metronome
     // The `delta` is the frame delta. It's only used on the first iteration.
     bool Tick(std::uint64_t delta)
     {
+        // Measure how long the previous tick took.
+        if (measuring_tick)
+        {
+            double cost = double(Clock::Time() - tick_start);
+            tick_cost = tick_cost == 0 ? cost : tick_cost + (cost - tick_cost) * 0.1;
+            measuring_tick = false;
+        }
+
         if (new_frame)
+        {
             accumulator += delta;
+            frame_delta = delta;
+            ticks_this_frame = 0;
+        }
 
         // Compensate.
         if (std::abs(int64_t(accumulator - tick_len)) < tick_len * comp_th)
@@ -115,6 +165,17 @@ class Metronome
         // Decide whether to tick.
         if (accumulator >= tick_len)
         {
+            // Drop the time if the ticks don't fit into the budget. At least one tick per frame is always allowed.
+            if (catch_up == CatchUp::dilate && tick_cost > 0 && ticks_this_frame > 0 && (ticks_this_frame + 1) * tick_cost > frame_delta * double(tick_budget))
+            {
+                std::uint64_t dropped = accumulator - accumulator % tick_len; // Keep the fractional part for the interpolation.
+                accumulator -= dropped;
+                dilated_time += dropped;
+                lag = true;
+                new_frame = true;
+                return false;
+            }
+
             // Do tick.
             if (max_ticks && accumulator > tick_len * max_ticks)
             {
@@ -124,6 +185,13 @@ class Metronome
             accumulator -= tick_len;
             new_frame = false;
             ticks++;
+            ticks_this_frame++;
+
+            if (catch_up == CatchUp::dilate)
+            {
+                tick_start = Clock::Time();
+                measuring_tick = true;
+            }
             return true;
         }
         else
@@ -139,4 +207,48 @@ class Metronome
     {
         return accumulator / double(tick_len);
     }
+
+    // How far the real time is between the last tick and the next one, in `[0,1)`.
+    // Render the state interpolated between the previous and the last tick with this factor, then the tick rate can be lowered without visible stutter.
+    // Note that this means rendering one tick in the past.
+    [[nodiscard]] double InterpolationAlpha() const
+    {
+        return std::clamp(Time(), 0., 1.);
+    }
+
+    [[nodiscard]] CatchUp CatchUpPolicy() const
+    {
+        return catch_up;
+    }
+    [[nodiscard]] float TickBudget() const
+    {
+        return tick_budget;
+    }
+
+    // The average duration of a tick in clock ticks, or 0 if unknown. Only measured with `CatchUp::dilate`.
+    [[nodiscard]] double TickCost() const
+    {
+        return tick_cost;
+    }
+
+    // True if the ticks currently take more real time than they simulate.
+    // Use this to skip or spread out the optional work, e.g. with `EveryNthTick()`.
+    [[nodiscard]] bool IsOverloaded() const
+    {
+        return tick_cost > double(tick_len) * double(tick_budget);
+    }
+
+    // The total time dropped by `CatchUp::dilate` since the last `Reset()`, in clock ticks.
+    [[nodiscard]] std::uint64_t DilatedTime() const
+    {
+        return dilated_time;
+    }
+
+    // Returns true once every `n` ticks. Use different `offset`s to spread expensive subsystems across ticks:
+    //     if (metronome.EveryNthTick(4, 0)) UpdatePathfinding();
+    //     if (metronome.EveryNthTick(4, 2)) UpdateVisibility();
+    [[nodiscard]] bool EveryNthTick(std::uint64_t n, std::uint64_t offset = 0) const
+    {
+        return n <= 1 || ticks % n == offset % n;
+    }
 };
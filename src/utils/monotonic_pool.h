@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <memory_resource>
 #include <span>
 #include <type_traits>
 #include <vector>
@@ -205,4 +206,87 @@ namespace Storage
         [[nodiscard]] MonotonicPool &Pool() const noexcept {return *pool;}
         [[nodiscard]] MonotonicPool *operator->() const noexcept {return pool;}
     };
+
+    // Adapts a `MonotonicPool` to `std::pmr::memory_resource`, so that the `std::pmr` containers can allocate from it.
+    // Unlike `MonotonicPool::AllocateOne()`, this works for any element types, since the containers destroy their elements themselves.
+    // Deallocation does nothing, the memory is reclaimed by `DestroyContent()`, which must not be called while any containers still use the pool.
+    // Overaligned allocations, which the pool doesn't support, are forwarded to `upstream`.
+    class MonotonicPoolResource : public std::pmr::memory_resource
+    {
+        MonotonicPool *pool = nullptr;
+        std::pmr::memory_resource *upstream = nullptr;
+
+      public:
+        explicit MonotonicPoolResource(MonotonicPool &pool, std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+            : pool(&pool), upstream(upstream)
+        {}
+
+        // Intentionally doesn't propagate const.
+        [[nodiscard]] MonotonicPool &Pool() const noexcept {return *pool;}
+
+      private:
+        void *do_allocate(std::size_t size, std::size_t alignment) override
+        {
+            switch (alignment)
+            {
+                case 1: return pool->AllocateRawMemory<1>(size);
+                case 2: return pool->AllocateRawMemory<2>(size);
+                case 4: return pool->AllocateRawMemory<4>(size);
+                case 8: return pool->AllocateRawMemory<8>(size);
+                case __STDCPP_DEFAULT_NEW_ALIGNMENT__: return pool->AllocateRawMemory<__STDCPP_DEFAULT_NEW_ALIGNMENT__>(size);
+                default: return upstream->allocate(size, alignment);
+            }
+        }
+
+        void do_deallocate(void *ptr, std::size_t size, std::size_t alignment) override
+        {
+            if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+                upstream->deallocate(ptr, size, alignment);
+        }
+
+        [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    // A per-thread pool for the temporary allocations that only live until the end of the current frame.
+    // Call `ResetFrameArena()` at the end of every frame, on every thread that used it.
+    // That frees everything at once, but keeps the largest block of memory, so after a few frames the arena stops allocating completely.
+    // Usage:
+    //     std::pmr::vector<int> temp(Storage::FrameArenaResource());
+    //     std::pmr::string str(Storage::FrameArenaResource());
+
+    namespace impl
+    {
+        struct FrameArenaState
+        {
+            MonotonicPool pool;
+            MonotonicPoolResource resource{pool};
+        };
+
+        [[nodiscard]] inline FrameArenaState &ThisThreadFrameArena()
+        {
+            thread_local FrameArenaState ret;
+            return ret;
+        }
+    }
+
+    // The frame arena of the current thread.
+    [[nodiscard]] inline MonotonicPool &FrameArena()
+    {
+        return impl::ThisThreadFrameArena().pool;
+    }
+
+    // The frame arena of the current thread, as a memory resource for the `std::pmr` containers.
+    [[nodiscard]] inline std::pmr::memory_resource *FrameArenaResource()
+    {
+        return &impl::ThisThreadFrameArena().resource;
+    }
+
+    // Frees everything allocated in the frame arena of the current thread. Nothing allocated from it can be used after this.
+    inline void ResetFrameArena()
+    {
+        impl::ThisThreadFrameArena().pool.DestroyContent();
+    }
 }
@@ -0,0 +1,65 @@
+#include "monotonic_pool.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("monotonic_pool.memory_resource")
+{
+    Storage::MonotonicPool pool;
+    Storage::MonotonicPoolResource resource(pool);
+
+    // Allocate a few frames worth of temporaries. After the first few frames, the pool should stop growing.
+    std::size_t capacity = 0;
+    for (int frame = 0; frame < 10; frame++)
+    {
+        {
+            std::pmr::vector<std::pmr::string> strings(&resource);
+            for (int i = 0; i < 100; i++)
+                strings.emplace_back(40, char('a' + i % 26));
+            CHECK(strings[27] == std::pmr::string(40, 'b'));
+        }
+        CHECK(pool.HasContent());
+        pool.DestroyContent();
+
+        if (frame == 4)
+            capacity = pool.PermanentCapacity();
+        if (frame > 4)
+            CHECK(pool.PermanentCapacity() == capacity);
+    }
+
+    // Alignment.
+    void *a = resource.allocate(1, 1);
+    void *b = resource.allocate(8, 8);
+    CHECK(std::uintptr_t(b) % 8 == 0);
+    CHECK(std::uintptr_t(b) - std::uintptr_t(a) < 16);
+
+    // Overaligned allocations don't use the pool.
+    std::size_t usage = pool.CurrentMemoryUsage();
+    void *c = resource.allocate(64, 256);
+    CHECK(std::uintptr_t(c) % 256 == 0);
+    CHECK(pool.CurrentMemoryUsage() == usage);
+    resource.deallocate(c, 64, 256);
+
+    CHECK(resource.is_equal(resource));
+    CHECK(!resource.is_equal(*std::pmr::new_delete_resource()));
+}
+
+TEST_CASE("monotonic_pool.frame_arena")
+{
+    Storage::ResetFrameArena();
+    CHECK(!Storage::FrameArena().HasContent());
+
+    std::pmr::vector<int> vec({1, 2, 3}, Storage::FrameArenaResource());
+    CHECK(Storage::FrameArena().HasContent());
+
+    // Other threads have their own arenas.
+    std::thread([]{CHECK(!Storage::FrameArena().HasContent());}).join();
+
+    vec = {};
+    Storage::ResetFrameArena();
+    CHECK(!Storage::FrameArena().HasContent());
+}
@@ -2,7 +2,9 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
 #include <type_traits>
 #include <vector>
 #include <utility>
@@ -12,9 +14,197 @@
 #include "program/errors.h"
 #include "strings/format.h"
 #include "utils/mat.h"
+#include "utils/robust_math.h"
 
+// Memory layouts for `MultiArray`.
+// A layout maps positions to offsets in the storage, possibly with padding (then the storage is larger than the array size).
+// Each layout has following static functions, where `padded_size` is the result of `PaddedSize()`:
+//     vec<D, Index> PaddedSize(vec<D, Index> size); // The size is positive.
+//     Index Offset(vec<D, Index> pos, vec<D, Index> padded_size);
+//     vec<D, Index> Pos(Index offset, vec<D, Index> padded_size); // The inverse of `Offset()`.
+//     void ForEach(vec<D, Index> size, vec<D, Index> padded_size, auto &&func); // Calls `func(pos, offset)` for every non-padding element, in the storage order.
+namespace MultiArrayLayouts
+{
+    // The default layout, without padding. X is the fastest changing coordinate.
+    // Nice for iterating in rows, but the cells directly above and below are far apart in memory.
+    struct RowMajor
+    {
+        template <int D, typename Index>
+        [[nodiscard]] static constexpr vec<D, Index> PaddedSize(vec<D, Index> size)
+        {
+            return size;
+        }
+
+        template <int D, typename Index>
+        [[nodiscard]] static constexpr Index Offset(vec<D, Index> pos, vec<D, Index> padded_size)
+        {
+            Index ret = 0;
+            Index factor = 1;
+            for (int i = 0; i < D; i++)
+            {
+                ret += factor * pos[i];
+                factor *= padded_size[i];
+            }
+            return ret;
+        }
+
+        template <int D, typename Index>
+        [[nodiscard]] static constexpr vec<D, Index> Pos(Index offset, vec<D, Index> padded_size)
+        {
+            vec<D, Index> ret;
+            for (int i = 0; i < D; i++)
+            {
+                ret[i] = offset % padded_size[i];
+                offset /= padded_size[i];
+            }
+            return ret;
+        }
+
+        template <int D, typename Index, typename F>
+        static constexpr void ForEach(vec<D, Index> size, vec<D, Index>, F &&func)
+        {
+            Index offset = 0;
+            for (vec<D, Index> pos : vec<D, Index>{} <= vector_range < size)
+                func(std::as_const(pos), offset++);
+        }
+    };
+
+    // Stores the array as a row-major grid of tiles of size `TileSize^D`, each tile being row-major internally.
+    // The neighbors in all directions are usually in the same tile, which is friendlier to the cache.
+    // The size is padded to a multiple of `TileSize` in every dimension.
+    template <int TileSize = 8>
+    struct Tiled
+    {
+        static_assert(TileSize > 0 && std::has_single_bit(unsigned(TileSize)), "The tile size must be a power of two.");
+
+        static constexpr int tile_size = TileSize;
+        static constexpr int tile_shift = std::countr_zero(unsigned(TileSize));
+
+        template <int D, typename Index>
+        [[nodiscard]] static constexpr vec<D, Index> PaddedSize(vec<D, Index> size)
+        {
+            return (size + (TileSize - 1)) & ~Index(TileSize - 1);
+        }
+
+        template <int D, typename Index>
+        [[nodiscard]] static constexpr Index Offset(vec<D, Index> pos, vec<D, Index> padded_size)
+        {
+            Index tile = RowMajor::Offset(pos >> tile_shift, padded_size >> tile_shift);
+            Index offset_in_tile = RowMajor::Offset(pos & (TileSize - 1), vec<D, Index>(TileSize));
+            return tile << (tile_shift * D) | offset_in_tile;
+        }
+
+        template <int D, typename Index>
+        [[nodiscard]] static constexpr vec<D, Index> Pos(Index offset, vec<D, Index> padded_size)
+        {
+            vec<D, Index> ret = RowMajor::Pos(offset >> (tile_shift * D), padded_size >> tile_shift) << tile_shift;
+            for (int i = 0; i < D; i++)
+                ret[i] |= offset >> (tile_shift * i) & (TileSize - 1);
+            return ret;
+        }
+
+        template <int D, typename Index, typename F>
+        static constexpr void ForEach(vec<D, Index> size, vec<D, Index> padded_size, F &&func)
+        {
+            constexpr Index elems_per_tile = Index(1) << (tile_shift * D);
+            Index offset = 0;
+            for (vec<D, Index> tile : vec<D, Index>{} <= vector_range < padded_size >> tile_shift)
+            {
+                vec<D, Index> tile_start = tile << tile_shift;
+                bool is_full = (tile_start + TileSize <= size).all();
+                for (Index i = 0; i < elems_per_tile; i++, offset++)
+                {
+                    vec<D, Index> pos = tile_start;
+                    for (int j = 0; j < D; j++)
+                        pos[j] |= i >> (tile_shift * j) & (TileSize - 1);
+                    if (is_full || (pos < size).all())
+                        func(std::as_const(pos), offset);
+                }
+            }
+        }
+    };
+
+    // Z-order (Morton order), 2D only. Interleaves the bits of the coordinates, so the nearby cells stay close in memory at all scales.
+    // The size is padded to powers of two. If one dimension is larger than the other, its extra high bits go after the interleaved ones,
+    // so non-square arrays don't get padded to a square.
+    struct ZOrder
+    {
+        // Spreads the low 32 bits of `x` to the even bits.
+        [[nodiscard]] static constexpr std::uint64_t SpreadBits(std::uint64_t x)
+        {
+            x &= 0xffffffff;
+            x = (x | x << 16) & 0x0000ffff0000ffff;
+            x = (x | x << 8) & 0x00ff00ff00ff00ff;
+            x = (x | x << 4) & 0x0f0f0f0f0f0f0f0f;
+            x = (x | x << 2) & 0x3333333333333333;
+            x = (x | x << 1) & 0x5555555555555555;
+            return x;
+        }
+        // The inverse of `SpreadBits()`, ignores the odd bits.
+        [[nodiscard]] static constexpr std::uint64_t CompactBits(std::uint64_t x)
+        {
+            x &= 0x5555555555555555;
+            x = (x | x >> 1) & 0x3333333333333333;
+            x = (x | x >> 2) & 0x0f0f0f0f0f0f0f0f;
+            x = (x | x >> 4) & 0x00ff00ff00ff00ff;
+            x = (x | x >> 8) & 0x0000ffff0000ffff;
+            x = (x | x >> 16) & 0x00000000ffffffff;
+            return x;
+        }
+
+        // The number of low bits that are interleaved.
+        template <typename Index>
+        [[nodiscard]] static constexpr int InterleavedBits(vec2<Index> padded_size)
+        {
+            return std::countr_zero(std::uint64_t(padded_size.min()));
+        }
 
-template <int D, typename T, std::signed_integral Index = std::ptrdiff_t>
+        template <int D, typename Index>
+        [[nodiscard]] static constexpr vec<D, Index> PaddedSize(vec<D, Index> size)
+        {
+            static_assert(D == 2, "Z-order layout is only supported for 2D arrays.");
+            return {Index(std::bit_ceil(std::uint64_t(size.x))), Index(std::bit_ceil(std::uint64_t(size.y)))};
+        }
+
+        template <int D, typename Index>
+        [[nodiscard]] static constexpr Index Offset(vec<D, Index> pos, vec<D, Index> padded_size)
+        {
+            int bits = InterleavedBits(padded_size);
+            std::uint64_t low_mask = (std::uint64_t(1) << bits) - 1;
+            std::uint64_t x = std::uint64_t(pos.x), y = std::uint64_t(pos.y);
+            std::uint64_t high = (x | y) >> bits; // Only one of them can have the high bits.
+            return Index(SpreadBits(x & low_mask) | SpreadBits(y & low_mask) << 1 | high << (bits * 2));
+        }
+
+        template <int D, typename Index>
+        [[nodiscard]] static constexpr vec<D, Index> Pos(Index offset, vec<D, Index> padded_size)
+        {
+            int bits = InterleavedBits(padded_size);
+            std::uint64_t low = std::uint64_t(offset) & ((std::uint64_t(1) << (bits * 2)) - 1);
+            std::uint64_t high = std::uint64_t(offset) >> (bits * 2) << bits;
+            vec<D, Index> ret(Index(CompactBits(low)), Index(CompactBits(low >> 1)));
+            if (padded_size.x > padded_size.y)
+                ret.x |= Index(high);
+            else
+                ret.y |= Index(high);
+            return ret;
+        }
+
+        template <int D, typename Index, typename F>
+        static constexpr void ForEach(vec<D, Index> size, vec<D, Index> padded_size, F &&func)
+        {
+            for (Index offset = 0; offset < padded_size.prod(); offset++)
+            {
+                vec<D, Index> pos = Pos(offset, padded_size);
+                if ((pos < size).all())
+                    func(std::as_const(pos), offset);
+            }
+        }
+    };
+}
+
+
+template <int D, typename T, std::signed_integral Index = std::ptrdiff_t, typename Layout = MultiArrayLayouts::RowMajor>
 class MultiArray
 {
   public:
@@ -24,6 +214,7 @@ class MultiArray
 
     using type = T;
     using index_t = Index;
+    using layout_t = Layout;
     using index_vec_t = vec<D, index_t>;
     using index_rect_t = vec<D, index_t>::rect_type;
 
@@ -33,21 +224,39 @@ class MultiArray
     index_vec_t size_vec{};
     std::vector<type> storage;
 
+    // The number of elements for this size, including the padding. Throws on overflow. Returns 0 if any of the sizes isn't positive.
+    [[nodiscard]] static std::size_t StorageSize(index_vec_t size_vec)
+    {
+        if (size_vec(any) <= 0)
+            return 0;
+        index_vec_t padded_size = Layout::PaddedSize(size_vec);
+        std::size_t ret = 1;
+        for (int i = 0; i < D; i++)
+            ret = Robust::checked_mul<std::size_t>(ret, padded_size[i]);
+        return ret;
+    }
+
+    [[nodiscard]] index_vec_t PaddedSize() const
+    {
+        return Layout::PaddedSize(size_vec);
+    }
+
   public:
     constexpr MultiArray() {}
 
-    explicit MultiArray(index_vec_t size_vec) : size_vec(size_vec), storage(size_vec.prod())
+    explicit MultiArray(index_vec_t size_vec) : size_vec(size_vec), storage(StorageSize(size_vec))
     {
         ASSERT(size_vec.min() >= 0, "Invalid multiarray size.");
         if (size_vec(any) <= 0)
             size_vec = {};
     }
-    MultiArray(index_vec_t size_vec, const T &init) : size_vec(size_vec), storage(size_vec.prod(), init)
+    MultiArray(index_vec_t size_vec, const T &init) : size_vec(size_vec), storage(StorageSize(size_vec), init)
     {
         ASSERT(size_vec.min() >= 0, "Invalid multiarray size.");
         if (size_vec(any) <= 0)
             size_vec = {};
     }
+    // `data` is in the row-major order, regardless of the layout.
     template <typename A, A ...I>
     MultiArray(Meta::value_list<I...>, const std::array<type, index_vec_t(I...).prod()> &data) : size_vec(I...), storage(data.begin(), data.end())
     {
@@ -55,6 +264,17 @@ class MultiArray
         static_assert(((I >= 0) && ...), "Invalid multiarray size.");
         if (size_vec(any) <= 0)
             size_vec = {};
+
+        if constexpr (!std::is_same_v<Layout, MultiArrayLayouts::RowMajor>)
+        {
+            storage = std::vector<type>(StorageSize(size_vec));
+            if (size_vec(all) > 0)
+            {
+                index_t i = 0;
+                for (index_vec_t pos : index_vec_t{} <= vector_range < size_vec)
+                    at(pos) = data[i++];
+            }
+        }
     }
 
     [[nodiscard]] friend bool operator==(const MultiArray &a, const MultiArray &b)
@@ -82,16 +302,7 @@ class MultiArray
     {
         ASSERT(self.pos_in_range(pos), FMT("Multiarray indices out of range. Indices are {} but the array size is {}.", pos, self.size_vec));
 
-        index_t index = 0;
-        index_t factor = 1;
-
-        for (int i = 0; i < dimensions; i++)
-        {
-            index += factor * pos[i];
-            factor *= self.size_vec[i];
-        }
-
-        return static_cast<Meta::copy_cvref<decltype(self), type>>(self.storage[index]);
+        return static_cast<Meta::copy_cvref<decltype(self), type>>(self.storage[Layout::Offset(pos, self.PaddedSize())]);
     }
     [[nodiscard]] auto at_or_throw(this auto &&self, index_vec_t pos) -> Meta::copy_cvref<decltype(self), type>
     {
@@ -129,6 +340,7 @@ class MultiArray
         at(pos) = std::move(obj);
     }
 
+    // The storage size. Unless the layout is row-major, this includes the padding, and the elements are not in the row-major order.
     [[nodiscard]] index_t element_count() const
     {
         return storage.size();
@@ -142,6 +354,27 @@ class MultiArray
         return storage.data();
     }
 
+    // Calls `func(pos, elem)` for every element (excluding the padding), in the storage order. This is the most cache-friendly order.
+    template <typename F>
+    void for_each_element(this auto &&self, F &&func)
+    {
+        if (self.storage.empty())
+            return;
+        Layout::ForEach(self.size_vec, self.PaddedSize(), [&](index_vec_t pos, index_t offset)
+        {
+            func(pos, static_cast<Meta::copy_cvref<decltype(self), type>>(self.storage[offset]));
+        });
+    }
+
+    // Returns a copy of the array with a different layout.
+    template <typename NewLayout>
+    [[nodiscard]] MultiArray<D, T, Index, NewLayout> to_layout(this auto &&self)
+    {
+        MultiArray<D, T, Index, NewLayout> ret(self.size_vec);
+        decltype(self)(self).for_each_element([&](index_vec_t pos, auto &&elem){ret.at(pos) = decltype(elem)(elem);});
+        return ret;
+    }
+
     // Resizes the array and/or offsets it by the specified amount.
     // Any out-of-range elements are destroyed.
     void resize(index_vec_t new_size, index_vec_t offset = {})
@@ -177,6 +410,6 @@ class MultiArray
     }
 };
 
-template <typename T, typename Index = std::ptrdiff_t> using Array2D = MultiArray<2, T, Index>;
-template <typename T, typename Index = std::ptrdiff_t> using Array3D = MultiArray<3, T, Index>;
-template <typename T, typename Index = std::ptrdiff_t> using Array4D = MultiArray<4, T, Index>;
+template <typename T, typename Index = std::ptrdiff_t, typename Layout = MultiArrayLayouts::RowMajor> using Array2D = MultiArray<2, T, Index, Layout>;
+template <typename T, typename Index = std::ptrdiff_t, typename Layout = MultiArrayLayouts::RowMajor> using Array3D = MultiArray<3, T, Index, Layout>;
+template <typename T, typename Index = std::ptrdiff_t, typename Layout = MultiArrayLayouts::RowMajor> using Array4D = MultiArray<4, T, Index, Layout>;
@@ -0,0 +1,59 @@
+#include "multiarray.h"
+
+#include <doctest/doctest.h>
+
+TEST_CASE("multiarray.layouts")
+{
+    auto Check = [&]<typename Layout>(Layout, ivec2 size)
+    {
+        Array2D<int, std::ptrdiff_t> row_major(size);
+        for (auto pos : xvec2{} <= vector_range < row_major.size())
+            row_major.at(pos) = int(pos.x * 1000 + pos.y);
+
+        auto arr = row_major.to_layout<Layout>();
+        REQUIRE(arr.size() == row_major.size());
+        REQUIRE(arr.element_count() >= row_major.element_count());
+
+        // The offsets must be unique, and `Pos()` must invert them.
+        xvec2 padded = Layout::PaddedSize(arr.size());
+        REQUIRE(padded.prod() == arr.element_count());
+        std::vector<bool> used(std::size_t(arr.element_count()));
+        for (auto pos : xvec2{} <= vector_range < padded)
+        {
+            auto offset = Layout::Offset(pos, padded);
+            REQUIRE(offset >= 0);
+            REQUIRE(offset < arr.element_count());
+            REQUIRE(!used[std::size_t(offset)]);
+            used[std::size_t(offset)] = true;
+            REQUIRE(Layout::Pos(offset, padded) == pos);
+        }
+
+        int count = 0;
+        arr.for_each_element([&](xvec2 pos, int elem)
+        {
+            REQUIRE(elem == pos.x * 1000 + pos.y);
+            count++;
+        });
+        REQUIRE(count == size.prod());
+
+        REQUIRE(arr.template to_layout<MultiArrayLayouts::RowMajor>() == row_major);
+
+        auto resized = arr;
+        resized.resize(size + 3, xvec2(1, 2));
+        REQUIRE(resized.at(xvec2(1, 2)) == arr.at(xvec2()));
+        REQUIRE(resized.at(xvec2(0, 0)) == 0);
+    };
+
+    for (ivec2 size : {ivec2(1, 1), ivec2(5, 3), ivec2(16, 16), ivec2(37, 9), ivec2(4, 70)})
+    {
+        CAPTURE(size);
+        Check(MultiArrayLayouts::RowMajor{}, size);
+        Check(MultiArrayLayouts::Tiled<>{}, size);
+        Check(MultiArrayLayouts::Tiled<4>{}, size);
+        Check(MultiArrayLayouts::ZOrder{}, size);
+    }
+
+    Array2D<int, std::ptrdiff_t, MultiArrayLayouts::ZOrder> arr(Meta::value_list<3, 2>{}, {1, 2, 3, 4, 5, 6});
+    CHECK(arr.at(xvec2(2, 1)) == 6);
+    CHECK(arr.element_count() == 8);
+}
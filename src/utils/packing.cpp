@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <optional>
 #include <vector>
 
 #include <stb_rect_pack.h>
@@ -50,3 +51,191 @@ namespace Packing
         return rects_not_packed;
     }
 }
+
+namespace Packing
+{
+    namespace
+    {
+        // A single page of the MaxRects packer. The free space is a list of maximal free rects, which can overlap.
+        class MaxRectsPage
+        {
+            std::vector<irect2> free_rects;
+            long long used_area = 0;
+
+            // Cuts `used` out of the free rects, replacing each intersecting free rect with up to four maximal rects around `used`.
+            void SplitFreeRects(irect2 used)
+            {
+                std::size_t old_count = free_rects.size();
+                for (std::size_t i = 0; i < old_count;)
+                {
+                    irect2 free = free_rects[i];
+                    if (!free.touches(used))
+                    {
+                        i++;
+                        continue;
+                    }
+
+                    if (used.a.x > free.a.x)
+                        free_rects.push_back(free.a.rect_to(ivec2(used.a.x, free.b.y)));
+                    if (used.b.x < free.b.x)
+                        free_rects.push_back(ivec2(used.b.x, free.a.y).rect_to(free.b));
+                    if (used.a.y > free.a.y)
+                        free_rects.push_back(free.a.rect_to(ivec2(free.b.x, used.a.y)));
+                    if (used.b.y < free.b.y)
+                        free_rects.push_back(ivec2(free.a.x, used.b.y).rect_to(free.b));
+
+                    free_rects[i] = free_rects[old_count - 1];
+                    free_rects[old_count - 1] = free_rects.back();
+                    free_rects.pop_back();
+                    old_count--;
+                }
+
+                // Remove the free rects that are contained in other free rects.
+                for (std::size_t i = 0; i < free_rects.size(); i++)
+                {
+                    for (std::size_t j = i + 1; j < free_rects.size();)
+                    {
+                        if (free_rects[i].contains(free_rects[j]))
+                        {
+                            free_rects[j] = free_rects.back();
+                            free_rects.pop_back();
+                        }
+                        else if (free_rects[j].contains(free_rects[i]))
+                        {
+                            free_rects[i] = free_rects[j];
+                            free_rects[j] = free_rects.back();
+                            free_rects.pop_back();
+                            j = i + 1;
+                        }
+                        else
+                        {
+                            j++;
+                        }
+                    }
+                }
+            }
+
+          public:
+            struct Placement
+            {
+                ivec2 pos;
+                bool rotated = false;
+                int short_side = 0;
+                int long_side = 0;
+            };
+
+            MaxRectsPage(ivec2 size)
+            {
+                free_rects.push_back(ivec2().rect_size(size));
+            }
+
+            [[nodiscard]] long long UsedArea() const
+            {
+                return used_area;
+            }
+
+            // Finds the best place for a rect, using the "best short side fit" heuristic.
+            [[nodiscard]] std::optional<Placement> FindPlacement(ivec2 size, bool allow_rotation) const
+            {
+                std::optional<Placement> ret;
+                auto Try = [&](irect2 free, ivec2 rect_size, bool rotated)
+                {
+                    ivec2 leftover = free.size() - rect_size;
+                    if (leftover(any) < 0)
+                        return;
+                    Placement placement{.pos = free.a, .rotated = rotated, .short_side = min(leftover.x, leftover.y), .long_side = max(leftover.x, leftover.y)};
+                    if (!ret || placement.short_side < ret->short_side || (placement.short_side == ret->short_side && placement.long_side < ret->long_side))
+                        ret = placement;
+                };
+
+                for (irect2 free : free_rects)
+                {
+                    Try(free, size, false);
+                    if (allow_rotation && size.x != size.y)
+                        Try(free, ivec2(size.y, size.x), true);
+                }
+                return ret;
+            }
+
+            void Place(irect2 rect, long long area)
+            {
+                SplitFreeRects(rect);
+                used_area += area;
+            }
+        };
+    }
+
+    MultiPageResult PackRectsMultiPage(ivec2 page_size, Rect *data, int count, const MultiPageParams &params)
+    {
+        // Adjust size, same as in `PackRects()`.
+        ivec2 inner_size = page_size - 2 * params.outer_gaps + params.inner_gaps;
+
+        // Place the larger rects first, they are the hardest to fit.
+        std::vector<int> order(count);
+        for (int i = 0; i < count; i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+        {
+            ivec2 size_a = data[a].size, size_b = data[b].size;
+            int max_a = max(size_a.x, size_a.y), max_b = max(size_b.x, size_b.y);
+            if (max_a != max_b)
+                return max_a > max_b;
+            return size_a.prod() > size_b.prod();
+        });
+
+        MultiPageResult ret;
+        std::vector<MaxRectsPage> pages;
+
+        for (int index : order)
+        {
+            Rect &rect = data[index];
+            rect.was_packed = false;
+            rect.rotated = false;
+            rect.page = 0;
+
+            ivec2 padded_size = rect.size + params.inner_gaps;
+
+            // Try the existing pages first.
+            std::optional<MaxRectsPage::Placement> placement;
+            int page_index = 0;
+            for (; page_index < int(pages.size()); page_index++)
+            {
+                placement = pages[page_index].FindPlacement(padded_size, params.allow_rotation);
+                if (placement)
+                    break;
+            }
+
+            // Start a new page.
+            if (!placement && (params.max_pages <= 0 || int(pages.size()) < params.max_pages))
+            {
+                MaxRectsPage new_page(inner_size);
+                placement = new_page.FindPlacement(padded_size, params.allow_rotation);
+                if (placement)
+                {
+                    pages.push_back(std::move(new_page));
+                    page_index = int(pages.size()) - 1;
+                }
+            }
+
+            if (!placement)
+            {
+                ret.rects_not_packed++;
+                continue;
+            }
+
+            ivec2 placed_size = placement->rotated ? ivec2(padded_size.y, padded_size.x) : padded_size;
+            pages[page_index].Place(placement->pos.rect_size(placed_size), (long long)rect.size.x * rect.size.y);
+
+            rect.pos = placement->pos + params.outer_gaps;
+            rect.was_packed = true;
+            rect.rotated = placement->rotated;
+            rect.page = page_index;
+        }
+
+        ret.occupancy.reserve(pages.size());
+        for (const MaxRectsPage &page : pages)
+            ret.occupancy.push_back(float(double(page.UsedArea()) / (double(page_size.x) * page_size.y)));
+
+        return ret;
+    }
+}
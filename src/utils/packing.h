@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "utils/mat.h"
 
 namespace Packing
@@ -12,6 +14,8 @@ namespace Packing
         // Output:
         ivec2 pos = ivec2(0);
         bool was_packed = 0;
+        int page = 0; // Only set by `PackRectsMultiPage()`.
+        bool rotated = false; // Only set by `PackRectsMultiPage()`. If true, the rect occupies `ivec2(size.y, size.x)` instead of `size`.
 
         Rect() {}
         Rect(ivec2 size) : size(size) {}
@@ -20,4 +24,23 @@ namespace Packing
     // Returns 0 on success. On failure returns the amount of rectangles that didn't fit into the box.
     // Note that coordinates outside of [0;65535] range are not supported by default. This can be changed in `stb_rect_pack.h`.
     int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps = 0, int outer_gaps = 0);
+
+    struct MultiPageParams
+    {
+        int inner_gaps = 0;
+        int outer_gaps = 0;
+        bool allow_rotation = false; // Allow rotating the rects by 90 degrees, see `Rect::rotated`.
+        int max_pages = 0; // Zero means unlimited.
+    };
+
+    struct MultiPageResult
+    {
+        int rects_not_packed = 0; // Those are either larger than a page, or didn't fit into `max_pages`.
+        std::vector<float> occupancy; // For each page, the fraction of its area covered by the rects (not counting the gaps).
+    };
+
+    // Packs the rects into one or more pages of size `page_size`. Packs more densely than `PackRects()`, but is slower.
+    // Uses the MaxRects algorithm with the "best short side fit" heuristic. The rects are placed from the largest to the smallest,
+    //   and the ones that don't fit into the existing pages start a new page. There's no limit on the coordinates.
+    [[nodiscard]] MultiPageResult PackRectsMultiPage(ivec2 page_size, Rect *data, int count, const MultiPageParams &params = {});
 }
@@ -0,0 +1,48 @@
+#include "packing.h"
+
+#include <vector>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("packing.multi_page")
+{
+    // Without rotation, only 3 rects of 40x20 (plus the gap) fit into a 64x64 page. With rotation, one more fits on the side.
+    for (bool allow_rotation : {false, true})
+    {
+        std::vector<Packing::Rect> rects(12, Packing::Rect(ivec2(40, 20)));
+        rects.push_back(ivec2(100, 1)); // Doesn't fit into a page.
+
+        auto result = Packing::PackRectsMultiPage(ivec2(64), rects.data(), rects.size(), {.inner_gaps = 1, .allow_rotation = allow_rotation});
+        REQUIRE(result.rects_not_packed == 1);
+        REQUIRE(!rects.back().was_packed);
+        rects.pop_back();
+
+        REQUIRE(int(result.occupancy.size()) == (allow_rotation ? 3 : 4));
+        for (float occupancy : result.occupancy)
+            REQUIRE((occupancy > 0 && occupancy <= 1));
+
+        for (std::size_t i = 0; i < rects.size(); i++)
+        {
+            REQUIRE(rects[i].was_packed);
+            ivec2 size = rects[i].rotated ? ivec2(rects[i].size.y, rects[i].size.x) : rects[i].size;
+            irect2 rect = rects[i].pos.rect_size(size);
+            REQUIRE(ivec2().rect_size(ivec2(64)).contains(rect));
+            if (!allow_rotation)
+                REQUIRE(!rects[i].rotated);
+
+            for (std::size_t j = 0; j < i; j++)
+            {
+                if (rects[j].page != rects[i].page)
+                    continue;
+                ivec2 other_size = rects[j].rotated ? ivec2(rects[j].size.y, rects[j].size.x) : rects[j].size;
+                REQUIRE(!rect.expand(1).touches(rects[j].pos.rect_size(other_size)));
+            }
+        }
+    }
+
+    // Respects the page limit.
+    std::vector<Packing::Rect> rects(10, Packing::Rect(ivec2(32)));
+    auto result = Packing::PackRectsMultiPage(ivec2(64), rects.data(), rects.size(), {.max_pages = 2});
+    REQUIRE(result.rects_not_packed == 2);
+    REQUIRE(result.occupancy == std::vector<float>{1, 1});
+}
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 #include <stdexcept>
 #include <type_traits>
 #include <utility>
 
+#include "macros/conditional_member_var.h"
 #include "macros/finally.h"
 #include "meta/common.h"
 
@@ -28,6 +30,10 @@ namespace Poly
      *
      * You can also assign to an existing object via `.assign<MyDerived>(...)`. The template parameter is optional. A reference to the resulting derived object is returned.
      *
+     * The third template parameter is the inline buffer size, 0 by default. Derived classes that fit into it (and have non-throwing move constructors)
+     *   are stored in place instead of the heap. This saves allocations, but makes moves more expensive (they move the object instead of a pointer),
+     *   and the objects are no longer at a stable address when the storage is moved.
+     *
      * Conversion from `Poly::Storage<Derived>` to `Poly::Storage<Base>` is not supported.
      * Storing arrays is not supported.
      *
@@ -103,9 +109,9 @@ namespace Poly
     template <typename T> inline constexpr derived_tag<T> derived;
 
 
-    template <typename T, typename UserData = DefaultData<T>>
+    template <typename T, typename UserData = DefaultData<T>, std::size_t InlineSize = 0>
     class Storage
-        : Meta::copyable_if<Storage<T, UserData>, impl::assume_copy_constructible<T>>
+        : Meta::copyable_if<Storage<T, UserData, InlineSize>, impl::assume_copy_constructible<T>>
     {
         static_assert(!std::is_const_v<T> && !std::is_volatile_v<T>, "The template parameter has to have no cv-qualifiers.");
         static_assert(std::is_class_v<T>, "The template parameter has to be a structure or a class.");
@@ -119,11 +125,12 @@ namespace Poly
         {
             class Unique
             {
-                // A poor man's `std::unique_ptr`.
+                // A poor man's `std::unique_ptr`, optionally with a small buffer optimization.
                 // Unlike `unique_ptr`, it also stores a downcasted pointer so that we don't have to use `dynamic_cast` every time if the base turns out to be virtual.
                 // This also allows for a relatively graceful deletion even if base doesn't have a virtual destructor.
                 // (If multiple inheritance is involved and the base doesn't have a virtual destructor, `unique_ptr` could attempt to `free` an invalid (not adjusted) pointer, causing a crash.
                 // This is caused by naively calling `delete` on a pointer to base. We don't do that. Instead, we call the destructor via the base pointer, and then `delete` the downcasted pointer as `char` array.)
+                // The small objects are stored in `buffer` instead of the heap. Moving them requires knowing their type, so this class isn't movable, `Low` handles that.
 
                 struct Data
                 {
@@ -132,29 +139,72 @@ namespace Poly
                 };
                 Data data;
 
+                struct Buffer
+                {
+                    alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) unsigned char bytes[InlineSize > 0 ? InlineSize : 1];
+                };
+                IMP_COND_MEMBER_VAR((InlineSize > 0), Buffer) buffer;
+
               public:
-                Unique() {}
+                // Whether `D` is stored in the buffer rather than on the heap.
+                // We require a non-throwing move constructor, to keep the moves of `Poly::Storage` non-throwing.
+                template <typename D>
+                static constexpr bool fits_inline = sizeof(D) <= InlineSize && alignof(D) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ && std::is_nothrow_move_constructible_v<D>;
 
-                template <typename D, typename ...P> static Unique make(P &&... params)
-                {
-                    Unique ret;
+                Unique() {}
 
-                    ret.data.bytes = new unsigned char[sizeof(D)];
-                    FINALLY_ON_THROW{delete[] ret.data.bytes; ret.data.bytes = nullptr;}; // Zeroing the pointer is important, because the destructor of `ret` will look at it.
+                Unique(const Unique &) = delete;
+                Unique &operator=(const Unique &) = delete;
 
-                    D *derived = new(ret.data.bytes) D(std::forward<P>(params)...);
-                    // Not needed because nothing below this point can throw:
-                    // FINALLY_ON_THROW{derived->~D();};
+                ~Unique()
+                {
+                    reset();
+                }
 
-                    ret.data.base = derived;
+                // Constructs an object. Must be empty before calling this.
+                template <typename D, typename ...P> void emplace(P &&... params)
+                {
+                    D *derived;
+                    if constexpr (fits_inline<D>)
+                    {
+                        derived = ::new((void *)buffer.bytes) D(std::forward<P>(params)...);
+                        data.bytes = buffer.bytes;
+                    }
+                    else
+                    {
+                        unsigned char *bytes = new unsigned char[sizeof(D)];
+                        FINALLY_ON_THROW{delete[] bytes;};
+                        derived = ::new((void *)bytes) D(std::forward<P>(params)...);
+                        // Not needed because nothing below this point can throw:
+                        // FINALLY_ON_THROW{derived->~D();};
+                        data.bytes = bytes;
+                    }
 
-                    return ret;
+                    data.base = derived;
                 }
 
-                Unique(Unique &&other) noexcept : data(std::exchange(other.data, {})) {}
-                Unique &operator=(Unique other) noexcept {std::swap(data, other.data); return *this;}
+                // Moves an object from `other`, making it empty. Must be empty before calling this.
+                // `relocate(from, to)` must move-construct the object of the correct type and destroy the old one. It's only called if the object is stored inline.
+                void move_from(Unique &other, void (*relocate)(unsigned char *, unsigned char *) noexcept) noexcept
+                {
+                    if (other.is_inline())
+                    {
+                        if constexpr (InlineSize > 0)
+                        {
+                            std::ptrdiff_t base_offset = reinterpret_cast<unsigned char *>(other.data.base) - other.data.bytes;
+                            relocate(other.data.bytes, buffer.bytes);
+                            data.bytes = buffer.bytes;
+                            data.base = reinterpret_cast<T *>(buffer.bytes + base_offset);
+                            other.data = {};
+                        }
+                    }
+                    else
+                    {
+                        data = std::exchange(other.data, {});
+                    }
+                }
 
-                ~Unique()
+                void reset()
                 {
                     if (data.bytes)
                     {
@@ -162,10 +212,20 @@ namespace Poly
                             data.base->~T();
                         else
                             data.base->T::~T(); // This silences some warnings about the destructor being non-virtual. We insteal have some static assertions to catch common mistakes.
-                        delete[] data.bytes;
+                        if (!is_inline())
+                            delete[] data.bytes;
+                        data = {};
                     }
                 }
 
+                [[nodiscard]] bool is_inline() const
+                {
+                    if constexpr (InlineSize > 0)
+                        return data.bytes == buffer.bytes;
+                    else
+                        return false;
+                }
+
                 explicit operator bool() const
                 {
                     return bool(data.bytes);
@@ -180,7 +240,10 @@ namespace Poly
 
             struct Table : UserData
             {
-                Unique (*_copy)(const Storage::Low &);
+                // Copies an object from the first parameter into the second one, which must be empty.
+                void (*_copy)(const Storage::Low &, Unique &);
+                // Moves an object stored inline from the first pointer to the second one, and destroys the original.
+                void (*_relocate)(unsigned char *, unsigned char *) noexcept;
 
                 template <typename D> constexpr void _make()
                 {
@@ -188,15 +251,29 @@ namespace Poly
 
                     if constexpr (is_copyable)
                     {
-                        _copy = [](const Storage::Low &param) -> Unique
+                        _copy = [](const Storage::Low &param, Unique &target)
                         {
-                            return Unique::template make<D>(param.template derived_or_assert<D>());
+                            target.template emplace<D>(param.template derived_or_assert<D>());
                         };
                     }
                     else
                     {
                         _copy = 0;
                     }
+
+                    if constexpr (Unique::template fits_inline<D>)
+                    {
+                        _relocate = [](unsigned char *from, unsigned char *to) noexcept
+                        {
+                            D &source = *reinterpret_cast<D *>(from);
+                            ::new((void *)to) D(std::move(source));
+                            source.~D();
+                        };
+                    }
+                    else
+                    {
+                        _relocate = 0;
+                    }
                 }
             };
 
@@ -209,8 +286,16 @@ namespace Poly
 
             Low() {}
 
-            Low(Low &&other) noexcept : data(std::exchange(other.data, {})) {}
-            Low &operator=(Low other) noexcept {std::swap(data, other.data); return *this;}
+            Low(Low &&other) noexcept
+            {
+                move_from(other);
+            }
+            Low &operator=(Low other) noexcept
+            {
+                reset();
+                move_from(other);
+                return *this;
+            }
 
             ~Low() {}
 
@@ -218,12 +303,28 @@ namespace Poly
             {
                 if (other)
                 {
-                    data.pointers = other.data.table->_copy(other);
+                    other.data.table->_copy(other, data.pointers);
                     data.table = other.data.table;
                 }
             }
 
-            template <typename D, typename ...P> static Low make(D **out_ptr, P &&... params)
+            // Must be empty before calling this.
+            void move_from(Low &other) noexcept
+            {
+                if (other)
+                {
+                    data.pointers.move_from(other.data.pointers, other.data.table->_relocate);
+                    data.table = std::exchange(other.data.table, nullptr);
+                }
+            }
+
+            void reset()
+            {
+                data.pointers.reset();
+                data.table = nullptr;
+            }
+
+            template <typename D, typename ...P> static Low make(P &&... params)
             {
                 static_assert(!std::is_const_v<D> && !std::is_volatile_v<D>, "The template parameter has to have no cv-qualifiers.");
                 static_assert(std::is_base_of_v<T, D>, "The template parameter has to be equal to T or to be derived from T.");
@@ -233,12 +334,8 @@ namespace Poly
                 static_assert(alignof(D) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "Overaligned types are not supported.");
 
                 Low ret;
-                ret.data.pointers = Unique::template make<D>(std::forward<P>(params)...);
+                ret.data.pointers.template emplace<D>(std::forward<P>(params)...);
                 ret.data.table = &impl::type_erasure_data_storage<Table, D>;
-
-                if (out_ptr)
-                    *out_ptr = reinterpret_cast<D *>(ret.data.pointers.bytes());
-
                 return ret;
             }
 
@@ -259,7 +356,7 @@ namespace Poly
             {
                 if (!contains<D>())
                     throw std::runtime_error("Invalid `Poly::Storage` access.");
-                return reinterpret_cast<const D &>(data.pointers.bytes());
+                return *reinterpret_cast<const D *>(data.pointers.bytes());
             }
 
             template <typename D> D &derived_or_assert()
@@ -281,24 +378,23 @@ namespace Poly
         Storage(decltype(nullptr) = nullptr) {}
 
         template <typename ...P, typename = decltype(T(std::declval<P>()...), void())>
-        Storage(base_tag, P &&... params) : low(Low::template make<T>(nullptr, std::forward<P>(params)...)) {}
+        Storage(base_tag, P &&... params) : low(Low::template make<T>(std::forward<P>(params)...)) {}
 
         template <typename D, typename ...P, typename = decltype(D(std::declval<P>()...), void())>
-        Storage(derived_tag<D>, P &&... params) : low(Low::template make<D>(nullptr, std::forward<P>(params)...)) {}
+        Storage(derived_tag<D>, P &&... params) : low(Low::template make<D>(std::forward<P>(params)...)) {}
 
         template <typename D = T, typename ...P, typename = decltype(D(std::declval<P>()...), void())>
         D &assign(P &&... params)
         {
-            D *ret;
-            low = Low::template make<D>(&ret, std::forward<P>(params)...);
-            return *ret;
+            low = Low::template make<D>(std::forward<P>(params)...);
+            return low.template derived_or_assert<D>(); // Not a pointer from `make()`, since the inline objects are relocated when moving.
         }
 
         template <typename D = T, typename ...P, typename = decltype(D(std::declval<P>()...), void())>
         [[nodiscard]] static Storage make(P &&... params)
         {
             Storage ret;
-            ret.low = Low::template make<D>(nullptr, std::forward<P>(params)...);
+            ret.low = Low::template make<D>(std::forward<P>(params)...);
             return ret;
         }
 
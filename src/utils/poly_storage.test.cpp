@@ -0,0 +1,93 @@
+#include "poly_storage.h"
+
+#include <memory>
+#include <string>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    struct Base
+    {
+        int x = 1;
+        Base() {}
+        Base(int x) : x(x) {}
+        Base(const Base &) = default;
+        Base &operator=(const Base &) = default;
+        virtual ~Base() {}
+        virtual std::string Name() const {return "base";}
+    };
+
+    struct Small : Base
+    {
+        std::string str;
+        Small(std::string str) : str(std::move(str)) {}
+        std::string Name() const override {return "small:" + str;}
+    };
+
+    struct Large : Base
+    {
+        char padding[256]{};
+        std::string Name() const override {return "large";}
+    };
+
+    // Multiple inheritance, to check that the base pointer is adjusted after moving.
+    struct Other {int y = 2; virtual ~Other() {}};
+    struct Multi : Other, Base
+    {
+        Multi() : Base(42) {}
+        std::string Name() const override {return "multi";}
+    };
+}
+
+TEST_CASE("poly_storage.inline")
+{
+    using Storage = Poly::Storage<Base, Poly::DefaultData<Base>, 64>;
+
+    Storage a = Storage::make<Small>("a string long enough to not fit into the SSO buffer");
+    CHECK(a->Name() == "small:a string long enough to not fit into the SSO buffer");
+    CHECK(a.bytes() >= reinterpret_cast<unsigned char *>(&a));
+    CHECK(a.bytes() < reinterpret_cast<unsigned char *>(&a + 1));
+
+    Storage b = Storage::make<Large>();
+    CHECK(b->Name() == "large");
+    CHECK((b.bytes() < reinterpret_cast<unsigned char *>(&b) || b.bytes() >= reinterpret_cast<unsigned char *>(&b + 1)));
+
+    Storage c = Storage::make<Multi>();
+    CHECK(c->x == 42);
+    CHECK(c.derived<Multi>().y == 2);
+
+    // Moves and copies, for both inline and heap objects.
+    for (Storage *source : {&a, &b, &c})
+    {
+        std::string name = (*source)->Name();
+        Storage copy = *source;
+        CHECK(copy->Name() == name);
+        Storage moved = std::move(copy);
+        CHECK(!copy);
+        CHECK(moved->Name() == name);
+        CHECK(&*moved == &moved.base());
+        Storage assigned;
+        assigned = std::move(moved);
+        CHECK(assigned->Name() == name);
+        assigned = *source;
+        CHECK(assigned->Name() == name);
+    }
+    Storage moved_multi = std::move(c);
+    CHECK(moved_multi->x == 42);
+    CHECK(moved_multi.derived_or_throw<Multi>().y == 2);
+    CHECK(moved_multi->Name() == "multi");
+    REQUIRE_THROWS(moved_multi.derived_or_throw<Small>());
+
+    Small &small = a.assign<Small>("b");
+    CHECK(&small == &a.derived<Small>());
+    CHECK(small.Name() == "small:b");
+    a = nullptr;
+    CHECK(!a);
+
+    // Without the inline buffer, moves keep the object at the same address.
+    auto heap = Poly::Storage<Base>::make<Small>("c");
+    const Base *ptr = &*heap;
+    auto heap_moved = std::move(heap);
+    CHECK(&*heap_moved == ptr);
+}
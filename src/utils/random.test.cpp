@@ -0,0 +1,96 @@
+#include "random.h"
+
+#include <vector>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // Sets the xoshiro state to `{1, 2, 3, 4}`.
+    struct TestSeedSeq
+    {
+        void generate(std::uint32_t *begin, std::uint32_t *end)
+        {
+            for (std::uint32_t i = 0; begin != end; i++)
+                *begin++ = i % 2 ? 0 : i / 2 + 1;
+        }
+    };
+}
+
+TEST_CASE("random.generators")
+{
+    // Compare with the reference implementations.
+    Random::Pcg32 pcg(42, 54);
+    CHECK(pcg() == 0xa15c02b7);
+    CHECK(pcg() == 0x7b47f409);
+    CHECK(pcg() == 0xba1d3330);
+
+    TestSeedSeq seq;
+    Random::Xoshiro256pp xoshiro(seq);
+    CHECK(xoshiro() == 41943041);
+    CHECK(xoshiro() == 58720359);
+
+    Random::Xoshiro256pp xoshiro_copy = xoshiro;
+    CHECK(xoshiro() == xoshiro_copy());
+    xoshiro_copy.jump();
+    CHECK(xoshiro != xoshiro_copy);
+
+    // Usable with the standard distributions and with `MakeGenerator`.
+    auto gen = Random::MakeGenerator(4, []{return std::uint32_t(7);});
+    Random::DefaultInterfaces ra(gen);
+    for (int i = 0; i < 100; i++)
+    {
+        int x = 3 <= ra.i <= 5;
+        REQUIRE(x >= 3);
+        REQUIRE(x <= 5);
+    }
+}
+
+TEST_CASE("random.fill")
+{
+    auto Check = [](auto &&gen)
+    {
+        std::vector<float> values(1001, -1);
+        Random::Fill(gen, values, 2, 4);
+        float sum = 0;
+        for (float x : values)
+        {
+            REQUIRE(x >= 2);
+            REQUIRE(x <= 4);
+            sum += x;
+        }
+        // The mean is close to 3.
+        CHECK(sum / values.size() > 2.9f);
+        CHECK(sum / values.size() < 3.1f);
+    };
+
+    Check(Random::Xoshiro256pp(10));
+    Check(Random::Pcg32(10));
+    Check(std::mt19937(10));
+}
+
+TEST_CASE("random.counter_based")
+{
+    // Known answers from the Random123 library.
+    CHECK(Random::Philox4x32({0, 0, 0, 0}, {0, 0}) == std::array<std::uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+    CHECK(Random::Philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}) == std::array<std::uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+
+    Random::CounterGenerator a(1, 2, 3), b(1, 2, 3), c(1, 2, 4);
+    std::vector<std::uint32_t> values;
+    for (int i = 0; i < 10; i++)
+    {
+        values.push_back(a());
+        REQUIRE(values.back() == b());
+    }
+    CHECK(values.front() != c());
+
+    // Discarding matches generating.
+    for (int skip = 0; skip < 9; skip++)
+    {
+        Random::CounterGenerator d(1, 2, 3);
+        d();
+        d.discard(skip);
+        CAPTURE(skip);
+        CHECK(d() == values[skip + 1]);
+    }
+}
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <iterator>
 #include <initializer_list>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include <parallel_hashmap/btree.h>
+
 #include "utils/simple_iterator.h"
 
 template <typename T>
@@ -179,3 +183,247 @@ class RangeSet
         return range_iter != ranges.end() && range_iter->Contains(value);
     }
 };
+
+// Like `RangeSet`, but stores the ranges in a B-tree, keyed by their beginning.
+// `Add()`, `Remove()` and `Contains()` are O(log n) and can be interleaved freely, while `RangeSet` re-sorts on the first `Contains()` after an `Add()`.
+// Prefer `RangeSet` if you add everything first, and only then query it.
+template <typename T>
+class RangeTreeSet
+{
+    static_assert(std::is_integral_v<T>, "The template parameter must be integral.");
+
+  public:
+    using elem_type = T;
+    using Range = typename RangeSet<T>::Range;
+
+  private:
+    // Maps `begin` to the inclusive `end`. The ranges are never empty, never overlap, and never touch (they're merged instead).
+    using tree_t = phmap::btree_map<T, T>;
+    tree_t tree;
+
+    // Whether a range ending at `end` touches or overlaps a range starting at `begin`, if `end` comes first.
+    [[nodiscard]] static constexpr bool Touches(T end, T begin)
+    {
+        return end >= begin || end + 1 == begin; // The first condition also prevents the overflow.
+    }
+
+  public:
+    // Iterates over the ranges, in the ascending order.
+    class RangeIterator
+    {
+        typename tree_t::const_iterator iter{};
+
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Range;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Range;
+
+        RangeIterator() {}
+        RangeIterator(typename tree_t::const_iterator iter) : iter(iter) {}
+
+        [[nodiscard]] Range operator*() const {return Range::Inclusive(iter->first, iter->second);}
+        RangeIterator &operator++() {++iter; return *this;}
+        RangeIterator operator++(int) {RangeIterator ret = *this; ++iter; return ret;}
+        [[nodiscard]] bool operator==(const RangeIterator &other) const {return iter == other.iter;}
+    };
+
+    struct RangeView
+    {
+        RangeIterator begin_iter, end_iter;
+        [[nodiscard]] RangeIterator begin() const {return begin_iter;}
+        [[nodiscard]] RangeIterator end() const {return end_iter;}
+    };
+
+    RangeTreeSet() {}
+
+    RangeTreeSet(const Range &range) {Add(range);}
+    explicit RangeTreeSet(const RangeSet<T> &set)
+    {
+        for (const Range &range : set.Ranges())
+            tree.emplace_hint(tree.end(), range.begin, range.end);
+    }
+
+    [[nodiscard]] bool IsEmpty() const {return tree.empty();}
+    // The number of ranges, not elements.
+    [[nodiscard]] std::size_t NumRanges() const {return tree.size();}
+
+    void Clear() {tree.clear();}
+
+    // Returns the list of ranges, sorted and without overlapping.
+    [[nodiscard]] RangeView Ranges() const {return {tree.begin(), tree.end()};}
+
+    // Returns the ranges overlapping `range`. They're not clamped to it.
+    [[nodiscard]] RangeView RangesOverlapping(Range range) const
+    {
+        if (!range)
+            return {tree.end(), tree.end()};
+        auto first = tree.upper_bound(range.begin);
+        if (first != tree.begin() && std::prev(first)->second >= range.begin)
+            --first;
+        return {first, tree.upper_bound(range.end)};
+    }
+
+    RangeTreeSet &Add(Range range)
+    {
+        if (!range)
+            return *this;
+
+        auto iter = tree.upper_bound(range.begin);
+
+        // Merge with the previous range, if it touches this one.
+        if (iter != tree.begin())
+        {
+            auto prev = std::prev(iter);
+            if (Touches(prev->second, range.begin))
+            {
+                if (prev->second >= range.end)
+                    return *this; // Already contained.
+                range.begin = prev->first;
+                iter = prev;
+            }
+        }
+
+        // Absorb the following ranges.
+        while (iter != tree.end() && Touches(range.end, iter->first))
+        {
+            range.end = std::max(range.end, iter->second);
+            iter = tree.erase(iter);
+        }
+
+        tree.emplace_hint(iter, range.begin, range.end);
+        return *this;
+    }
+
+    RangeTreeSet &Remove(Range range)
+    {
+        if (!range)
+            return *this;
+
+        auto iter = tree.upper_bound(range.begin);
+
+        // Trim the previous range, if it overlaps this one.
+        if (iter != tree.begin())
+        {
+            auto prev = std::prev(iter);
+            if (prev->second >= range.begin)
+            {
+                T old_end = prev->second;
+                if (prev->first < range.begin)
+                    prev->second = range.begin - 1;
+                else
+                    tree.erase(prev); // This can only happen if `prev->first == range.begin`.
+
+                if (old_end > range.end)
+                {
+                    // `range` is in the middle of this one, there's nothing more to remove.
+                    tree.emplace(range.end + 1, old_end);
+                    return *this;
+                }
+
+                iter = tree.upper_bound(range.begin); // The erasure could've invalidated `iter`.
+            }
+        }
+
+        // Remove the following ranges, possibly trimming the last one.
+        while (iter != tree.end() && iter->first <= range.end)
+        {
+            T old_end = iter->second;
+            iter = tree.erase(iter);
+            if (old_end > range.end)
+            {
+                tree.emplace_hint(iter, range.end + 1, old_end);
+                break;
+            }
+        }
+
+        return *this;
+    }
+
+    [[nodiscard]] bool Contains(T value) const
+    {
+        auto iter = tree.upper_bound(value);
+        if (iter == tree.begin())
+            return false;
+        return std::prev(iter)->second >= value;
+    }
+
+    // Set algebra. Those are linear in the number of ranges.
+
+    [[nodiscard]] friend RangeTreeSet operator|(const RangeTreeSet &a, const RangeTreeSet &b)
+    {
+        RangeTreeSet ret;
+        auto iter_a = a.tree.begin(), iter_b = b.tree.begin();
+        while (iter_a != a.tree.end() || iter_b != b.tree.end())
+        {
+            // Take the range that begins first.
+            bool use_a = iter_b == b.tree.end() || (iter_a != a.tree.end() && iter_a->first < iter_b->first);
+            auto &iter = use_a ? iter_a : iter_b;
+
+            if (!ret.tree.empty() && Touches(std::prev(ret.tree.end())->second, iter->first))
+                std::prev(ret.tree.end())->second = std::max(std::prev(ret.tree.end())->second, iter->second);
+            else
+                ret.tree.emplace_hint(ret.tree.end(), iter->first, iter->second);
+            ++iter;
+        }
+        return ret;
+    }
+
+    [[nodiscard]] friend RangeTreeSet operator&(const RangeTreeSet &a, const RangeTreeSet &b)
+    {
+        RangeTreeSet ret;
+        auto iter_a = a.tree.begin(), iter_b = b.tree.begin();
+        while (iter_a != a.tree.end() && iter_b != b.tree.end())
+        {
+            T begin = std::max(iter_a->first, iter_b->first);
+            T end = std::min(iter_a->second, iter_b->second);
+            if (begin <= end)
+                ret.tree.emplace_hint(ret.tree.end(), begin, end);
+
+            // Advance the range that ends first.
+            if (iter_a->second < iter_b->second)
+                ++iter_a;
+            else
+                ++iter_b;
+        }
+        return ret;
+    }
+
+    [[nodiscard]] friend RangeTreeSet operator-(const RangeTreeSet &a, const RangeTreeSet &b)
+    {
+        RangeTreeSet ret;
+        auto iter_b = b.tree.begin();
+        for (const auto &range : a.tree)
+        {
+            T begin = range.first, end = range.second;
+
+            // Skip the ranges of `b` that end before this one.
+            while (iter_b != b.tree.end() && iter_b->second < begin)
+                ++iter_b;
+
+            bool fully_removed = false;
+            for (auto iter = iter_b; iter != b.tree.end() && iter->first <= end; ++iter)
+            {
+                if (iter->first > begin)
+                    ret.tree.emplace_hint(ret.tree.end(), begin, iter->first - 1);
+                if (iter->second >= end)
+                {
+                    fully_removed = true;
+                    break;
+                }
+                begin = iter->second + 1;
+            }
+
+            if (!fully_removed)
+                ret.tree.emplace_hint(ret.tree.end(), begin, end);
+        }
+        return ret;
+    }
+
+    RangeTreeSet &operator|=(const RangeTreeSet &other) {return *this = *this | other;}
+    RangeTreeSet &operator&=(const RangeTreeSet &other) {return *this = *this & other;}
+    RangeTreeSet &operator-=(const RangeTreeSet &other) {return *this = *this - other;}
+
+    [[nodiscard]] friend bool operator==(const RangeTreeSet &, const RangeTreeSet &) = default;
+};
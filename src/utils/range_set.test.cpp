@@ -0,0 +1,102 @@
+#include "range_set.h"
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // Converts the set to a list of inclusive `[begin, end]` pairs.
+    template <typename T>
+    [[nodiscard]] std::vector<std::pair<T, T>> RangeList(const RangeTreeSet<T> &set)
+    {
+        std::vector<std::pair<T, T>> ret;
+        for (auto range : set.Ranges())
+            ret.emplace_back(range.begin, range.end);
+        return ret;
+    }
+}
+
+TEST_CASE("range_set.tree")
+{
+    using Set = RangeTreeSet<int>;
+    using Range = Set::Range;
+    using List = std::vector<std::pair<int, int>>;
+
+    Set set;
+    set.Add(Range::Inclusive(10, 20)).Add(Range::Inclusive(30, 40)).Add(Range::Inclusive(21, 25));
+    CHECK(RangeList(set) == List{{10, 25}, {30, 40}});
+    set.Add(Range::Inclusive(26, 29));
+    CHECK(RangeList(set) == List{{10, 40}});
+    set.Remove(Range::Inclusive(15, 16)).Remove(40).Remove(10);
+    CHECK(RangeList(set) == List{{11, 14}, {17, 39}});
+    CHECK(set.Contains(11));
+    CHECK(!set.Contains(15));
+    CHECK(!set.Contains(40));
+
+    // Overlapping ranges.
+    set.Add(Range::Inclusive(50, 60));
+    List overlapping;
+    for (auto range : set.RangesOverlapping(Range::Inclusive(39, 50)))
+        overlapping.emplace_back(range.begin, range.end);
+    CHECK(overlapping == List{{17, 39}, {50, 60}});
+
+    // Set algebra.
+    Set a = Set(Range::Inclusive(0, 10)).Add(Range::Inclusive(20, 30));
+    Set b = Set(Range::Inclusive(5, 19)).Add(Range::Inclusive(25, 25));
+    CHECK(RangeList(a | b) == List{{0, 30}});
+    CHECK(RangeList(a & b) == List{{5, 10}, {25, 25}});
+    CHECK(RangeList(a - b) == List{{0, 4}, {20, 24}, {26, 30}});
+    CHECK(RangeList(b - a) == List{{11, 19}});
+
+    // Extreme values.
+    RangeTreeSet<std::uint8_t> bytes;
+    bytes.Add(RangeTreeSet<std::uint8_t>::Range::Inclusive(0, 255)).Remove(255).Remove(0);
+    CHECK(RangeList(bytes) == std::vector<std::pair<std::uint8_t, std::uint8_t>>{{1, 254}});
+    bytes.Add(255).Add(0);
+    CHECK(bytes.NumRanges() == 1);
+
+    // Compare with `std::set` on random operations.
+    std::mt19937 gen(42);
+    Set x, y;
+    std::set<int> ref_x, ref_y;
+    for (int i = 0; i < 2000; i++)
+    {
+        int begin = int(gen() % 200), end = begin + int(gen() % 10);
+        Set &target = gen() % 2 ? x : y;
+        std::set<int> &ref = &target == &x ? ref_x : ref_y;
+        if (gen() % 3)
+        {
+            target.Add(Range::Inclusive(begin, end));
+            for (int j = begin; j <= end; j++)
+                ref.insert(j);
+        }
+        else
+        {
+            target.Remove(Range::Inclusive(begin, end));
+            for (int j = begin; j <= end; j++)
+                ref.erase(j);
+        }
+
+        if (i % 100 == 0)
+        {
+            Set set_union = x | y, set_intersection = x & y, set_difference = x - y;
+            for (int j = -1; j <= 210; j++)
+            {
+                REQUIRE(x.Contains(j) == ref_x.contains(j));
+                REQUIRE(set_union.Contains(j) == (ref_x.contains(j) || ref_y.contains(j)));
+                REQUIRE(set_intersection.Contains(j) == (ref_x.contains(j) && ref_y.contains(j)));
+                REQUIRE(set_difference.Contains(j) == (ref_x.contains(j) && !ref_y.contains(j)));
+            }
+            // The ranges must stay merged.
+            auto list = RangeList(set_union);
+            for (std::size_t j = 1; j < list.size(); j++)
+                REQUIRE(list[j - 1].second + 1 < list[j].first);
+            REQUIRE(set_union == (Set(y) |= x));
+        }
+    }
+}
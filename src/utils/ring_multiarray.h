@@ -4,13 +4,17 @@
 #include "utils/multiarray.h"
 #include "utils/mat.h"
 
+#include <algorithm>
+#include <span>
+#include <utility>
+
 namespace TileGrids
 {
     // A simple ring buffer multidimensional array.
     // Maintains a capacity value that can be larger than size, but the unused elements are zeroed rather than destroyed, for simplicity.
     // Maintains a range of valid indices as a `rect2`, which can become arbitrarily large as the ring rotates.
     template <int D, typename T, std::signed_integral Index = std::ptrdiff_t>
-    requires (D == 2) // Only 2D for now, because `RectDiffIterator` only supports 2D at this point.
+    requires (D == 2) // Only 2D for now, because `RectDiffRects` only supports 2D at this point.
     class RingMultiarray
     {
       public:
@@ -60,6 +64,29 @@ namespace TileGrids
             return decltype(self)(self).underlying.at(mod_ex(pos, self.underlying.size()));
         }
 
+        // Calls `func` for every contiguous run of elements in `rect`, row by row. `rect` must be inside of `bounds()`.
+        // `func` is `(index_vec_t pos, std::span<T> run) -> void` (`std::span<const T>` for const arrays), where `pos` is the position of the first element in the run.
+        // Each row is split into at most two runs, where the ring wraps around.
+        // Use `Math2::RectDiffRects` to get the rects that were added or removed when the bounds change.
+        void for_each_run(this auto &&self, index_rect_t rect, auto &&func)
+        {
+            if (!rect.has_area())
+                return;
+            ASSERT(self.bounds().contains(rect), "The rect is not inside of the RingMultiarray bounds.");
+
+            index_t capacity_x = self.capacity().x;
+            for (index_t y = rect.a.y; y < rect.b.y; y++)
+            {
+                for (index_t x = rect.a.x; x < rect.b.x;)
+                {
+                    index_vec_t pos(x, y);
+                    index_t len = std::min(rect.b.x - x, capacity_x - mod_ex(x, capacity_x));
+                    func(std::as_const(pos), std::span(&self.underlying.at(mod_ex(pos, self.underlying.size())), std::size_t(len)));
+                    x += len;
+                }
+            }
+        }
+
         // Resize with automatic capacity management. (See `capacity_*` constants above.)
         void resize(index_rect_t new_bounds)
         {
@@ -117,8 +144,14 @@ namespace TileGrids
             ASSERT(new_bounds.size()(all) <= capacity(), "Resizing a ring array beyond its capacity.");
 
             // Zero the old elements.
-            for (index_vec_t pos : Math2::RectDiffIterator(bounds(), new_bounds))
-                at(pos) = type{};
+            for (index_rect_t rect : Math2::RectDiffRects(bounds(), new_bounds))
+            {
+                for_each_run(rect, [](index_vec_t, std::span<type> run)
+                {
+                    for (type &elem : run)
+                        elem = type{};
+                });
+            }
 
             // Assume the new elements are already zeroed.
 
@@ -3,7 +3,9 @@
 #include <cmath>
 #include <compare>
 #include <concepts>
+#include <cstddef>
 #include <limits>
+#include <span>
 #include <stdexcept>
 #include <type_traits>
 
@@ -16,6 +18,8 @@
  * The `int x int` comparisons should also be reliable, as the comparison algorithm is simple.
  * The `int x float` comparisons, on the other hand, rely on a complicated algorithm. Even though they were tested,
  *     it's hard to guarantee complete robustness here. Also they might be slow.
+ *     Except when every value of the integral type is exactly representable in the floating-point type (e.g. `short x float` or `int x double`),
+ *     then we simply convert the integer and use the builtin comparison, which is both fast and reliable.
  */
 
 namespace Robust
@@ -25,6 +29,20 @@ namespace Robust
 
     namespace impl
     {
+        // Whether every value of `I` can be converted to `F` exactly.
+        template <typename I, typename F>
+        concept int_exactly_representable_in = std::is_integral_v<I> && std::is_floating_point_v<F> && std::numeric_limits<F>::radix == 2 &&
+            std::numeric_limits<I>::digits <= std::numeric_limits<F>::digits;
+
+        // If one of the types is integral and the other is floating-point, and the first can be exactly represented by the second,
+        //   this is the floating-point type. Otherwise it's `void`.
+        template <typename A, typename B>
+        struct FastIntFloatComparisonType {using type = void;};
+        template <typename A, typename B> requires int_exactly_representable_in<A, B>
+        struct FastIntFloatComparisonType<A, B> {using type = B;};
+        template <typename A, typename B> requires int_exactly_representable_in<B, A>
+        struct FastIntFloatComparisonType<A, B> {using type = A;};
+
         // Compares an integral and a floating-point value.
         // Despite the parameter names, it doesn't matter which one is which.
         // Follows a so-called 'partial ordering': for some pairs of values you get a special 'undefined' result (i.e. for NaNs compared with any number).
@@ -37,6 +55,11 @@ namespace Robust
             {
                 return 0 <=> compare_int_float_three_way(f, i);
             }
+            else if constexpr (int_exactly_representable_in<I, F>)
+            {
+                // The conversion is exact, so the builtin comparison is enough.
+                return F(i) <=> f;
+            }
             else
             {
                 static_assert(std::is_integral_v<I> && std::is_floating_point_v<F>);
@@ -102,7 +125,11 @@ namespace Robust
         }
         else if constexpr (a_is_int != b_is_int)
         {
-            return impl::compare_int_float_three_way(a, b) == 0;
+            using F = typename impl::FastIntFloatComparisonType<A, B>::type;
+            if constexpr (!std::is_void_v<F>)
+                return F(a) == F(b);
+            else
+                return impl::compare_int_float_three_way(a, b) == 0;
         }
         else // a_is_int && b_is_int
         {
@@ -137,7 +164,11 @@ namespace Robust
         }
         else if constexpr (a_is_int != b_is_int)
         {
-            return impl::compare_int_float_three_way(a, b) < 0;
+            using F = typename impl::FastIntFloatComparisonType<A, B>::type;
+            if constexpr (!std::is_void_v<F>)
+                return F(a) < F(b);
+            else
+                return impl::compare_int_float_three_way(a, b) < 0;
         }
         else // a_is_int && b_is_int
         {
@@ -226,6 +257,39 @@ namespace Robust
     };
 
 
+    // Returns true if `min <= value <= max`. Returns false if any of them is NaN.
+    template <arithmetic T, arithmetic A, arithmetic B>
+    [[nodiscard]] constexpr bool in_range(T value, A min, B max)
+    {
+        return compare_three_way(min, value) <= 0 && compare_three_way(value, max) <= 0;
+    }
+
+    // Batch versions of `in_range()`.
+    // Those vectorize well when the comparisons reduce to the builtin operators: for `float x float`, `int x int`,
+    //   and for `int x float` when the integral type fits into the floating-point one exactly.
+
+    // Returns the number of elements that are `min <= x <= max`.
+    template <arithmetic T, arithmetic A, arithmetic B>
+    [[nodiscard]] constexpr std::size_t count_in_range(std::span<const T> values, A min, B max)
+    {
+        std::size_t ret = 0;
+        for (T value : values)
+            ret += std::size_t(compare_three_way(min, value) <= 0) & std::size_t(compare_three_way(value, max) <= 0);
+        return ret;
+    }
+
+    // Returns true if every element is `min <= x <= max`.
+    template <arithmetic T, arithmetic A, arithmetic B>
+    [[nodiscard]] constexpr bool all_in_range(std::span<const T> values, A min, B max)
+    {
+        // No early exit, to let the loop vectorize.
+        bool ret = true;
+        for (T value : values)
+            ret &= (compare_three_way(min, value) <= 0) & (compare_three_way(value, max) <= 0);
+        return ret;
+    }
+
+
     // Returns true if `value` can be represented as `A`.
     template <arithmetic A, Meta::deduce..., arithmetic B>
     [[nodiscard]] constexpr bool representable_as(B value)
@@ -257,11 +321,21 @@ namespace Robust
     template <Meta::deduce..., arithmetic A, arithmetic B>
     [[nodiscard]] constexpr bool conversion_fails(A src, B &dst)
     {
-        dst = src;
         if constexpr (std::is_same_v<A, B>)
+        {
+            dst = src;
             return false;
+        }
+        else if constexpr (std::is_integral_v<A> && std::is_integral_v<B> && !std::is_same_v<A, bool> && !std::is_same_v<B, bool>)
+        {
+            // This compiles to a range check, and also wraps around on failure.
+            return __builtin_add_overflow(src, A{}, &dst);
+        }
         else
+        {
+            dst = src;
             return not_equal(src, dst);
+        }
     }
 
 
@@ -334,6 +408,36 @@ namespace Robust
     }
 
 
+    // Mixed-type arithmetic for integral types, for computing buffer sizes and such.
+    // The result is computed as if with infinite precision, and then converted to `T`. Throws if it's not representable as `T`.
+    // Those compile to the operation itself followed by a single flag check.
+    // Usage: `Robust::checked_mul<std::size_t>(width, height)`.
+    template <integral_non_bool T, Meta::deduce..., integral_non_bool A, integral_non_bool B>
+    [[nodiscard]] constexpr T checked_add(A a, B b)
+    {
+        T ret;
+        if (__builtin_add_overflow(a, b, &ret))
+            throw std::runtime_error("Overflow in an addition.");
+        return ret;
+    }
+    template <integral_non_bool T, Meta::deduce..., integral_non_bool A, integral_non_bool B>
+    [[nodiscard]] constexpr T checked_sub(A a, B b)
+    {
+        T ret;
+        if (__builtin_sub_overflow(a, b, &ret))
+            throw std::runtime_error("Overflow in a subtraction.");
+        return ret;
+    }
+    template <integral_non_bool T, Meta::deduce..., integral_non_bool A, integral_non_bool B>
+    [[nodiscard]] constexpr T checked_mul(A a, B b)
+    {
+        T ret;
+        if (__builtin_mul_overflow(a, b, &ret))
+            throw std::runtime_error("Overflow in a multiplication.");
+        return ret;
+    }
+
+
     // Integer wrapper, with safe overloaded operators.
     //
     // Example minimal usage:
@@ -0,0 +1,53 @@
+#include "robust_math.h"
+
+#include <limits>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+TEST_CASE("robust_math.int_float")
+{
+    constexpr double nan = std::numeric_limits<double>::quiet_NaN(), inf = std::numeric_limits<double>::infinity();
+
+    // Those take the fast path.
+    CHECK(Robust::less(short(-3), -2.5f));
+    CHECK(Robust::equal(short(7), 7.f));
+    CHECK(Robust::less(2147483647, 2147483647.5));
+    CHECK(!Robust::less(short(1), float(nan)));
+    CHECK(!Robust::less(float(nan), short(1)));
+    CHECK(Robust::less(short(32767), float(inf)));
+    CHECK(Robust::less(-inf, -2147483647 - 1));
+
+    // Those don't.
+    CHECK(Robust::less(16777217, 16777218.f));
+    CHECK(!Robust::equal(16777217, 16777216.f));
+    CHECK(Robust::less(9007199254740993ll, 9007199254740994.));
+    CHECK(!Robust::less(1ll, nan));
+
+    std::vector<int> values = {-3, -2, 0, 5, 6, 10};
+    CHECK(Robust::count_in_range(std::span<const int>(values), -2.5, 5.5) == 3);
+    CHECK(Robust::count_in_range(std::span<const int>(values), 0u, 10.f) == 4);
+    CHECK(!Robust::all_in_range(std::span<const int>(values), -2.5, 5.5));
+    CHECK(Robust::all_in_range(std::span<const int>(values), -3.f, 10ll));
+    CHECK(!Robust::all_in_range(std::span<const int>(values), nan, 10));
+    CHECK(!Robust::in_range(nan, 0, 1));
+}
+
+TEST_CASE("robust_math.checked_arithmetic")
+{
+    CHECK(Robust::checked_mul<std::size_t>(3, 4u) == 12);
+    CHECK(Robust::checked_add<int>(-5, 3u) == -2);
+    CHECK(Robust::checked_sub<unsigned>(5ll, 3) == 2);
+    REQUIRE_THROWS((void)Robust::checked_sub<unsigned>(3, 5));
+    REQUIRE_THROWS((void)Robust::checked_mul<std::size_t>(std::numeric_limits<std::size_t>::max() / 2, 3));
+    REQUIRE_THROWS((void)Robust::checked_add<short>(32767, 1));
+
+    short s;
+    CHECK(!Robust::conversion_fails(-5, s));
+    CHECK(s == -5);
+    CHECK(Robust::conversion_fails(70000, s));
+    unsigned u;
+    CHECK(Robust::conversion_fails(-1, u));
+    CHECK(!Robust::conversion_fails(4000000000ll, u));
+    CHECK(u == 4000000000u);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <numeric>
 #include <ostream>
 #include <span>
@@ -8,6 +10,7 @@
 #include <utility>
 #include <vector>
 
+#include "macros/conditional_member_var.h"
 #include "macros/finally.h"
 #include "meta/common.h"
 #include "program/errors.h"
@@ -30,7 +33,12 @@
 //     void SparseSet_SetValue(T loc, T new_value);
 //     T SparseSet_GetIndex(T loc) const;
 //     void SparseSet_SetIndex(T loc, T new_value);
+//     const T *SparseSet_GetValues() const; // The contiguous array of all values.
 // Where `loc` is `0 <= loc < SparseSet_GetCapacity()`.
+// Optionally, they can also track the occupancy separately, then `Contains()` uses that instead of the indices:
+//     bool SparseSet_GetOccupied(T value) const;
+//     void SparseSet_SetOccupied(T value, bool occupied);
+//     void SparseSet_ClearOccupied();
 // "values" and "indices" lists have the same size.
 // Both contain unique sequental integers starting from 0 (you must initially fill them with incremental integers,
 //   and when you increase capacity, you can safely add more incremental integers).
@@ -68,6 +76,13 @@ class BasicSparseSetInterface
         GetDerived().SparseSet_SetIndex(b_value, tmp);
     }
 
+    // Updates the optional occupancy tracking, if the derived class has it.
+    void SetOccupied(elem_t elem, bool occupied)
+    {
+        if constexpr (requires{GetDerived().SparseSet_SetOccupied(elem, occupied);})
+            GetDerived().SparseSet_SetOccupied(elem, occupied);
+    }
+
   public:
     // The maximum number of elements.
     [[nodiscard]] elem_t Capacity() const
@@ -96,7 +111,10 @@ class BasicSparseSetInterface
     {
         if (elem < 0 || elem >= Capacity())
             return false;
-        return GetDerived().SparseSet_GetIndex(elem) < ElemCount();
+        if constexpr (requires{GetDerived().SparseSet_GetOccupied(elem);})
+            return GetDerived().SparseSet_GetOccupied(elem);
+        else
+            return GetDerived().SparseSet_GetIndex(elem) < ElemCount();
     }
 
     // Adds a new element to the set, a one that wasn't there before.
@@ -108,7 +126,25 @@ class BasicSparseSetInterface
 
         elem_t old_pos = ElemCount();
         GetDerived().SparseSet_SetPos(old_pos + 1);
-        return GetDerived().SparseSet_GetValue(old_pos);
+        elem_t ret = GetDerived().SparseSet_GetValue(old_pos);
+        SetOccupied(ret, true);
+        return ret;
+    }
+
+    // Adds `n` new elements to the set, the ones that weren't there before. Returns them.
+    // The returned span is invalidated by the next modification of the set.
+    // Throws if not enough free capacity, then the set is unchanged.
+    [[nodiscard]] std::span<const elem_t> InsertMany(elem_t n)
+    {
+        if (n < 0 || n > RemainingCapacity())
+            throw std::runtime_error("Attempt to insert too many elements into a `SparseSet`.");
+
+        elem_t old_pos = ElemCount();
+        GetDerived().SparseSet_SetPos(old_pos + n);
+        std::span<const elem_t> ret(GetDerived().SparseSet_GetValues() + old_pos, std::size_t(n));
+        for (elem_t elem : ret)
+            SetOccupied(elem, true);
+        return ret;
     }
 
     // Adds a new element to the set, returns true on success.
@@ -120,6 +156,7 @@ class BasicSparseSetInterface
 
         SwapElements<false, true>(elem, ElemCount());
         GetDerived().SparseSet_SetPos(ElemCount() + 1);
+        SetOccupied(elem, true);
         return true;
     }
 
@@ -133,6 +170,7 @@ class BasicSparseSetInterface
 
         GetDerived().SparseSet_SetPos(ElemCount() - 1);
         SwapElements<false, true>(elem, ElemCount());
+        SetOccupied(elem, false);
         return true;
     }
 
@@ -156,14 +194,83 @@ class BasicSparseSetInterface
         }
         GetDerived().SparseSet_SetValue(ElemCount(), elem);
         GetDerived().SparseSet_SetIndex(elem, ElemCount());
+        SetOccupied(elem, false);
 
         return true;
     }
 
+    // Erases several elements, returns the number of erased ones. Skips the missing elements and duplicates.
+    // Might change the element order.
+    // `elems` must not point into this set (e.g. it can't be a part of `Elems()`).
+    std::size_t EraseManyUnordered(std::span<const elem_t> elems)
+    {
+        std::size_t ret = 0;
+        for (elem_t elem : elems)
+            ret += EraseUnordered(elem);
+        return ret;
+    }
+
+    // Erases several elements, returns the number of erased ones. Skips the missing elements and duplicates.
+    // Preserves the element order. Unlike calling `EraseOrdered()` for each element, this shifts the remaining elements only once.
+    // `elems` must not point into this set (e.g. it can't be a part of `Elems()`).
+    std::size_t EraseManyOrdered(std::span<const elem_t> elems)
+    {
+        std::vector<elem_t> erased;
+        for (elem_t elem : elems)
+        {
+            if (Contains(elem))
+                erased.push_back(GetDerived().SparseSet_GetIndex(elem));
+        }
+        if (erased.empty())
+            return 0;
+        std::sort(erased.begin(), erased.end());
+        erased.erase(std::unique(erased.begin(), erased.end()), erased.end());
+
+        // Shift the remaining elements, starting from the first erased one.
+        // `erased` initially contains the indices, and we replace them with the values as we go.
+        elem_t old_pos = ElemCount();
+        elem_t write_index = erased.front();
+        std::size_t num_erased = 0;
+        for (elem_t i = erased.front(); i < old_pos; i++)
+        {
+            elem_t value = GetDerived().SparseSet_GetValue(i);
+            if (num_erased < erased.size() && erased[num_erased] == i)
+            {
+                erased[num_erased++] = value;
+                continue;
+            }
+            GetDerived().SparseSet_SetValue(write_index, value);
+            GetDerived().SparseSet_SetIndex(value, write_index);
+            write_index++;
+        }
+
+        // Put the erased elements right after the remaining ones.
+        GetDerived().SparseSet_SetPos(write_index);
+        for (elem_t value : erased)
+        {
+            GetDerived().SparseSet_SetValue(write_index, value);
+            GetDerived().SparseSet_SetIndex(value, write_index);
+            write_index++;
+            SetOccupied(value, false);
+        }
+
+        return num_erased;
+    }
+
     // Erases all elements while maintaining capacity.
     void EraseAllElements()
     {
         GetDerived().SparseSet_SetPos(0);
+        if constexpr (requires{GetDerived().SparseSet_ClearOccupied();})
+            GetDerived().SparseSet_ClearOccupied();
+    }
+
+    // Returns all elements, in the same order as `GetElem()`.
+    // This is contiguous, prefer it to calling `GetElem()` in a loop.
+    // The span is invalidated by the next modification of the set.
+    [[nodiscard]] std::span<const elem_t> Elems() const
+    {
+        return {GetDerived().SparseSet_GetValues(), std::size_t(ElemCount())};
     }
 
     // Returns i-th element.
@@ -212,14 +319,20 @@ class BasicSparseSetInterface
 };
 
 // An implementation of sparse set that owns its underlying storage.
-template <typename T>
-class SparseSet : public BasicSparseSetInterface<SparseSet<T>, T>
+// If `OccupancyBits` is true, additionally stores a bit per element, and uses it in `Contains()`.
+// That's 1/64 of the memory used by the indices, so it's friendlier to the cache when checking random elements in huge sets.
+template <typename T, bool OccupancyBits = false>
+class SparseSet : public BasicSparseSetInterface<SparseSet<T, OccupancyBits>, T>
 {
-    friend BasicSparseSetInterface<SparseSet<T>, T>;
+    friend BasicSparseSetInterface<SparseSet<T, OccupancyBits>, T>;
+
+    using word_t = std::uint64_t;
+    static constexpr std::size_t word_bits = 64;
 
     Meta::ResetIfMovedFrom<T> pos = 0;
 
     std::vector<T> values, indices;
+    IMP_COND_MEMBER_VAR(OccupancyBits, std::vector<word_t>) occupancy;
 
     T SparseSet_GetCapacity() const {return values.size(); /* Sic. */}
     T SparseSet_GetPos() const {return pos.value;}
@@ -228,6 +341,22 @@ class SparseSet : public BasicSparseSetInterface<SparseSet<T>, T>
     void SparseSet_SetValue(T loc, T new_value) {values[loc] = new_value;}
     T SparseSet_GetIndex(T loc) const {return indices[loc];}
     void SparseSet_SetIndex(T loc, T new_value) {indices[loc] = new_value;}
+    const T *SparseSet_GetValues() const {return values.data();}
+
+    bool SparseSet_GetOccupied(T value) const requires OccupancyBits
+    {
+        return occupancy[std::size_t(value) / word_bits] >> (std::size_t(value) % word_bits) & 1;
+    }
+    void SparseSet_SetOccupied(T value, bool occupied) requires OccupancyBits
+    {
+        word_t mask = word_t(1) << (std::size_t(value) % word_bits);
+        word_t &word = occupancy[std::size_t(value) / word_bits];
+        word = occupied ? word | mask : word & ~mask;
+    }
+    void SparseSet_ClearOccupied() requires OccupancyBits
+    {
+        std::fill(occupancy.begin(), occupancy.end(), 0);
+    }
 
   public:
     constexpr SparseSet() {}
@@ -245,6 +374,9 @@ class SparseSet : public BasicSparseSetInterface<SparseSet<T>, T>
 
         std::size_t old_capacity = this->Capacity();
 
+        if constexpr (OccupancyBits)
+            occupancy.resize((std::size_t(new_capacity) + word_bits - 1) / word_bits); // The new bits are zero. This can stay even if we throw below.
+
         values.resize(new_capacity);
         FINALLY_ON_THROW{values.resize(old_capacity);};
 
@@ -274,6 +406,7 @@ class SparseSetNonOwning : public BasicSparseSetInterface<SparseSetNonOwning<T>,
     void SparseSet_SetValue(T loc, T new_value) {storage.value[loc] = new_value;}
     T SparseSet_GetIndex(T loc) const {return storage.value[capacity.value + loc];}
     void SparseSet_SetIndex(T loc, T new_value) {storage.value[capacity.value + loc] = new_value;}
+    const T *SparseSet_GetValues() const {return storage.value;}
 
   public:
     constexpr SparseSetNonOwning() {}
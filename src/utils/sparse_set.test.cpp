@@ -104,3 +104,41 @@ TEST_CASE("sparse_set.non_owning")
     SparseSetNonOwning<int> set2({storage.begin(), storage.size() - 1});
     REQUIRE_EQ(set2.Capacity(), 4);
 }
+
+template class SparseSet<int, true>;
+TEST_CASE("sparse_set.bulk")
+{
+    auto ToVector = [](std::span<const int> span){return std::vector<int>(span.begin(), span.end());};
+
+    SparseSet<int, true> set(8);
+    REQUIRE(ToVector(set.InsertMany(3)) == std::vector{0,1,2});
+    REQUIRE(ToVector(set.InsertMany(0)).empty());
+    REQUIRE_THROWS(set.InsertMany(6));
+    REQUIRE(set.ElemCount() == 3);
+    REQUIRE(set.Insert(6));
+    REQUIRE(set.Insert(4));
+    REQUIRE(ToVector(set.Elems()) == std::vector{0,1,2,6,4});
+    for (int i = -1; i <= 8; i++)
+        REQUIRE(set.Contains(i) == (i == 0 || i == 1 || i == 2 || i == 4 || i == 6));
+
+    // Duplicates and missing elements are ignored.
+    REQUIRE(set.EraseManyOrdered(std::vector{6,1,1,3,9,0}) == 3);
+    REQUIRE(ToVector(set.Elems()) == std::vector{2,4});
+    for (int i = 0; i < 8; i++)
+        REQUIRE(set.Contains(i) == (i == 2 || i == 4));
+    // The erased elements are reused first, in their former order.
+    REQUIRE(set.InsertAny() == 0);
+    REQUIRE(ToVector(set.Elems()) == std::vector{2,4,0});
+
+    REQUIRE(set.EraseManyUnordered(std::vector{4,5,4}) == 1);
+    REQUIRE(set.ElemCount() == 2);
+    REQUIRE(!set.Contains(4));
+
+    set.EraseAllElements();
+    for (int i = 0; i < 8; i++)
+        REQUIRE(!set.Contains(i));
+    set.Reserve(100);
+    REQUIRE(ToVector(set.InsertMany(100)).size() == 100);
+    for (int i = 0; i < 100; i++)
+        REQUIRE(set.Contains(i));
+}
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "math/fixed_point.h"
+#include "utils/mat.h"
+
+// A uniform grid broadphase, an alternative to `AabbTree` for many objects of similar size that move every tick (bullets, colliding particles, etc).
+// Unlike the tree, it can't be modified incrementally. Instead it's rebuilt from scratch with `Build()` each tick, which takes linear time.
+// The cells are hashed into a power-of-two bucket table, and the objects are counting-sorted by the bucket, so the objects of one cell end up next to each other in memory.
+// An object is added to every cell it touches, so keep the cells not much smaller than the objects (see `Params::cell_size`).
+// The query interface mirrors `AabbTree`: `CollidePoint()`, `CollideAabb()`, `CollideAllPairs()`, each object is reported at most once per query.
+// `T` is a vector type, either integral, floating-point, or fixed-point (see `math/fixed_point.h`).
+// `UserData` is an arbitrary type, an instance of which will be stored for each object.
+template <Math::vector T, typename UserDataT = void>
+class SpatialHashGrid
+{
+    struct Empty {};
+  public:
+    using scalar = typename T::type;
+    using vector = T;
+    using rect = typename T::rect_type;
+    using ObjectIndex = int;
+    using UserData = std::conditional_t<std::is_void_v<UserDataT>, Empty, UserDataT>;
+
+    // The integral cell coordinates.
+    using cell_vector = Math::change_vec_base_t<T, int>;
+
+    struct Params
+    {
+        // The size of one cell. If it's not positive in any dimension, it's computed in each `Build()` instead,
+        //   as the average object size multiplied by `auto_cell_size_factor`.
+        // For same-sized objects, a cell slightly larger than an object usually works best: each object then touches at most 2^N cells.
+        T cell_size;
+
+        float auto_cell_size_factor = 1.5f;
+    };
+
+  private:
+    struct Entry
+    {
+        cell_vector cell; // Several cells can share a bucket, so we remember the exact one.
+        ObjectIndex object = 0;
+    };
+
+    Params params;
+
+    T cell_size; // The one that's actually used.
+    std::vector<rect> aabbs;
+    std::vector<UserData> userdata;
+    std::vector<cell_vector> first_cells; // The first cell of each object, to report each object once per query.
+
+    std::uint32_t bucket_mask = 0;
+    std::vector<std::uint32_t> bucket_begin; // `bucket_mask + 2` elements. Bucket `i` is `entries[bucket_begin[i] .. bucket_begin[i+1]]`.
+    std::vector<Entry> entries;
+
+    [[nodiscard]] static int CellCoord(scalar value, scalar size)
+    {
+        if constexpr (std::integral<scalar>)
+            return int(Math::div_ex(value, size));
+        else if constexpr (std::floating_point<scalar>)
+            return int(std::floor(value / size));
+        else
+            return int(value / size); // Fixed-point numbers round down when converted to integers.
+    }
+
+    [[nodiscard]] cell_vector CellOf(vector point) const
+    {
+        cell_vector ret;
+        for (int i = 0; i < T::size; i++)
+            ret[i] = CellCoord(point[i], cell_size[i]);
+        return ret;
+    }
+
+    [[nodiscard]] std::uint32_t BucketOf(cell_vector cell) const
+    {
+        std::uint32_t hash = 0;
+        for (int i = 0; i < T::size; i++)
+            hash = (hash ^ std::uint32_t(cell[i])) * 0x9e3779b1;
+        hash ^= hash >> 16;
+        return hash & bucket_mask;
+    }
+
+    // Calls `func(cell_vector cell)` for every cell in the inclusive range. If it returns true, stops and also returns true.
+    template <typename F>
+    static bool ForEachCell(cell_vector a, cell_vector b, F &&func)
+    {
+        cell_vector cell = a;
+        while (true)
+        {
+            if (func(std::as_const(cell)))
+                return true;
+
+            int i = 0;
+            while (i < T::size && cell[i] == b[i])
+            {
+                cell[i] = a[i];
+                i++;
+            }
+            if (i == T::size)
+                return false;
+            cell[i]++;
+        }
+    }
+
+    [[nodiscard]] static std::size_t CellCount(cell_vector a, cell_vector b)
+    {
+        std::size_t ret = 1;
+        for (int i = 0; i < T::size; i++)
+            ret *= std::size_t(std::int64_t(b[i]) - a[i] + 1);
+        return ret;
+    }
+
+    void ComputeCellSize()
+    {
+        cell_size = params.cell_size;
+        if (cell_size(all) > 0)
+            return;
+
+        double sum[T::size] = {};
+        for (const rect &aabb : aabbs)
+        {
+            for (int i = 0; i < T::size; i++)
+                sum[i] += double(aabb.b[i] - aabb.a[i]);
+        }
+        for (int i = 0; i < T::size; i++)
+        {
+            double size = aabbs.empty() ? 0 : sum[i] / aabbs.size() * params.auto_cell_size_factor;
+            if constexpr (std::integral<scalar>)
+                cell_size[i] = std::max(scalar(size), scalar(1));
+            else
+                cell_size[i] = size > 0 ? scalar(size) : scalar(1);
+        }
+    }
+
+  public:
+    // Constructs an empty grid.
+    SpatialHashGrid() {}
+
+    SpatialHashGrid(Params params) : params(std::move(params)) {}
+
+    // Makes a grid from a list of AABBs. See `Build()` for details.
+    SpatialHashGrid(Params params, std::span<const rect> aabbs, std::span<const UserData> userdata = {}) : params(std::move(params))
+    {
+        Build(aabbs, userdata);
+    }
+
+    [[nodiscard]] const Params &GetParams() const
+    {
+        return params;
+    }
+    // The new parameters are used in the next `Build()`.
+    void SetParams(Params new_params)
+    {
+        params = std::move(new_params);
+    }
+
+    // The cell size used by the last `Build()`.
+    [[nodiscard]] T CellSize() const
+    {
+        return cell_size;
+    }
+
+    // Replaces the contents. The object `i` will have the AABB `aabbs[i]` and the user data `userdata[i]`.
+    // `userdata` must be either empty (then it's default-constructed) or have the same size as `aabbs`.
+    // Takes linear time in the number of touched cells. The memory is reused between calls.
+    void Build(std::span<const rect> new_aabbs, std::span<const UserData> new_userdata = {})
+    {
+        if (!new_userdata.empty() && new_userdata.size() != new_aabbs.size())
+            throw std::runtime_error("The number of user data elements doesn't match the number of AABBs.");
+
+        aabbs.assign(new_aabbs.begin(), new_aabbs.end());
+        for (rect &aabb : aabbs)
+            sort_two_var(aabb.a, aabb.b);
+        if (new_userdata.empty())
+            userdata.assign(aabbs.size(), UserData{});
+        else
+            userdata.assign(new_userdata.begin(), new_userdata.end());
+
+        ComputeCellSize();
+
+        // Compute the cell ranges, and count the entries to size the bucket table.
+        first_cells.resize(aabbs.size());
+        std::size_t entry_count = 0;
+        for (std::size_t i = 0; i < aabbs.size(); i++)
+        {
+            first_cells[i] = CellOf(aabbs[i].a);
+            entry_count += CellCount(first_cells[i], CellOf(aabbs[i].b));
+        }
+        if (entry_count > std::size_t(std::numeric_limits<std::uint32_t>::max() / 2))
+            throw std::runtime_error("Too many cells in a spatial hash grid, the cell size is probably too small.");
+
+        bucket_mask = std::uint32_t(std::bit_ceil(std::max(entry_count, std::size_t(1)))) - 1;
+
+        // Counting sort by the bucket. First count the entries in each bucket (shifted by one), then compute the prefix sums.
+        bucket_begin.assign(std::size_t(bucket_mask) + 2, 0);
+        for (std::size_t i = 0; i < aabbs.size(); i++)
+        {
+            ForEachCell(first_cells[i], CellOf(aabbs[i].b), [&](cell_vector cell)
+            {
+                bucket_begin[BucketOf(cell) + 1]++;
+                return false;
+            });
+        }
+        for (std::size_t i = 1; i < bucket_begin.size(); i++)
+            bucket_begin[i] += bucket_begin[i - 1];
+
+        // Then scatter the entries. This moves each `bucket_begin[i]` to the end of the bucket, which we fix afterwards.
+        entries.resize(entry_count);
+        for (std::size_t i = 0; i < aabbs.size(); i++)
+        {
+            ForEachCell(first_cells[i], CellOf(aabbs[i].b), [&](cell_vector cell)
+            {
+                entries[bucket_begin[BucketOf(cell)]++] = {.cell = cell, .object = ObjectIndex(i)};
+                return false;
+            });
+        }
+        for (std::size_t i = bucket_begin.size() - 1; i > 0; i--)
+            bucket_begin[i] = bucket_begin[i - 1];
+        bucket_begin[0] = 0;
+    }
+
+    // Removes all objects. Keeps the memory.
+    void Clear()
+    {
+        Build({});
+    }
+
+    [[nodiscard]] bool IsEmpty() const
+    {
+        return aabbs.empty();
+    }
+
+    [[nodiscard]] ObjectIndex ObjectCount() const
+    {
+        return ObjectIndex(aabbs.size());
+    }
+
+    // The total number of object-cell pairs. If this is much larger than `ObjectCount()`, the cells are too small.
+    [[nodiscard]] std::size_t EntryCount() const
+    {
+        return entries.size();
+    }
+
+    [[nodiscard]] const rect &GetAabb(ObjectIndex index) const
+    {
+        return aabbs[index];
+    }
+
+    [[nodiscard]] const UserData &GetUserData(ObjectIndex index) const
+    {
+        return userdata[index];
+    }
+    [[nodiscard]] UserData &GetUserData(ObjectIndex index)
+    {
+        return userdata[index];
+    }
+
+    // A point collision test.
+    // `func` is `bool func(ObjectIndex object)`. It's called for all colliding objects. If it returns true, the function stops immediately and also returns true.
+    template <typename F>
+    bool CollidePoint(vector point, F &&func) const
+    {
+        if (aabbs.empty())
+            return false;
+
+        cell_vector cell = CellOf(point);
+        std::uint32_t bucket = BucketOf(cell);
+        for (std::uint32_t i = bucket_begin[bucket]; i < bucket_begin[bucket + 1]; i++)
+        {
+            const Entry &entry = entries[i];
+            if (entry.cell == cell && aabbs[entry.object].contains(point))
+            {
+                if (func(std::as_const(entry.object)))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // An AABB collision test.
+    // `func` is `bool func(ObjectIndex object)`. It's called for all colliding objects. If it returns true, the function stops immediately and also returns true.
+    // If the query covers more cells than there are buckets, this checks all objects instead.
+    template <typename F>
+    bool CollideAabb(rect aabb, F &&func) const
+    {
+        if (aabbs.empty())
+            return false;
+
+        sort_two_var(aabb.a, aabb.b);
+        cell_vector query_a = CellOf(aabb.a), query_b = CellOf(aabb.b);
+
+        if (CellCount(query_a, query_b) > bucket_mask + std::size_t(1))
+        {
+            for (ObjectIndex i = 0; i < ObjectIndex(aabbs.size()); i++)
+            {
+                if (aabb.touches(aabbs[i]) && func(std::as_const(i)))
+                    return true;
+            }
+            return false;
+        }
+
+        return ForEachCell(query_a, query_b, [&](cell_vector cell)
+        {
+            std::uint32_t bucket = BucketOf(cell);
+            for (std::uint32_t i = bucket_begin[bucket]; i < bucket_begin[bucket + 1]; i++)
+            {
+                const Entry &entry = entries[i];
+                // An object overlapping the query in several cells is only reported from the first of them.
+                if (entry.cell == cell && max(first_cells[entry.object], query_a) == cell && aabb.touches(aabbs[entry.object]))
+                {
+                    if (func(std::as_const(entry.object)))
+                        return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    // Finds all pairs of colliding objects. Each pair is reported exactly once, in an arbitrary order.
+    // `func` is `bool func(ObjectIndex a, ObjectIndex b)`. If it returns true, the function stops immediately and also returns true.
+    // This only compares the objects sharing a cell, so it's much faster than calling `CollideAabb()` for every object.
+    template <typename F>
+    bool CollideAllPairs(F &&func) const
+    {
+        for (std::size_t bucket = 0; bucket + 1 < bucket_begin.size(); bucket++)
+        {
+            std::uint32_t end = bucket_begin[bucket + 1];
+            for (std::uint32_t i = bucket_begin[bucket]; i < end; i++)
+            {
+                const Entry &a = entries[i];
+                for (std::uint32_t j = i + 1; j < end; j++)
+                {
+                    const Entry &b = entries[j];
+                    // A pair sharing several cells is only reported from the first of them.
+                    if (a.cell == b.cell && max(first_cells[a.object], first_cells[b.object]) == a.cell && aabbs[a.object].touches(aabbs[b.object]))
+                    {
+                        if (func(std::as_const(a.object), std::as_const(b.object)))
+                            return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,129 @@
+#include "spatial_hash_grid.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+template class SpatialHashGrid<ivec2, int>;
+template class SpatialHashGrid<fvec2>;
+template class SpatialHashGrid<vec2<fixed16>>;
+
+namespace
+{
+    // Makes `count` random rects in a `size`x`size` square, some of them at negative coordinates.
+    [[nodiscard]] std::vector<irect2> MakeRandomRects(std::mt19937 &gen, int count, int size, int max_rect_size)
+    {
+        std::uniform_int_distribution<int> pos_dist(-size / 2, size / 2 - 1), size_dist(1, max_rect_size);
+        std::vector<irect2> ret;
+        for (int i = 0; i < count; i++)
+        {
+            ivec2 pos(pos_dist(gen), pos_dist(gen));
+            ret.push_back(pos.rect_size(ivec2(size_dist(gen), size_dist(gen))));
+        }
+        return ret;
+    }
+}
+
+TEST_CASE("spatial_hash_grid.queries")
+{
+    std::mt19937 gen(42);
+
+    using Grid = SpatialHashGrid<ivec2, int>;
+
+    for (ivec2 cell_size : {ivec2(0), ivec2(1), ivec2(8), ivec2(1000)})
+    for (int count : {0, 1, 10, 500})
+    {
+        CAPTURE(cell_size);
+        CAPTURE(count);
+
+        std::vector<irect2> rects = MakeRandomRects(gen, count, 256, 16);
+        std::vector<int> userdata(count);
+        for (int i = 0; i < count; i++)
+            userdata[i] = i * 10;
+
+        Grid grid(Grid::Params{.cell_size = cell_size}, rects, userdata);
+        REQUIRE(grid.IsEmpty() == (count == 0));
+        REQUIRE(grid.ObjectCount() == count);
+        REQUIRE(grid.CellSize()(all) > 0);
+        for (int i = 0; i < count; i++)
+        {
+            REQUIRE(grid.GetAabb(i) == rects[i]);
+            REQUIRE(grid.GetUserData(i) == i * 10);
+        }
+
+        // Some small queries, and some covering more cells than there are buckets.
+        std::vector<irect2> queries = MakeRandomRects(gen, 100, 256, 16);
+        for (irect2 query : MakeRandomRects(gen, 10, 256, 300))
+            queries.push_back(query);
+
+        for (irect2 query : queries)
+        {
+            std::vector<int> hits, hits_brute_force;
+            grid.CollideAabb(query, [&](int object){hits.push_back(object); return false;});
+            for (int i = 0; i < count; i++)
+            {
+                if (rects[i].touches(query))
+                    hits_brute_force.push_back(i);
+            }
+            std::sort(hits.begin(), hits.end());
+            REQUIRE(hits == hits_brute_force); // This also checks that there are no duplicates.
+
+            std::vector<int> point_hits, point_hits_brute_force;
+            grid.CollidePoint(query.a, [&](int object){point_hits.push_back(object); return false;});
+            for (int i = 0; i < count; i++)
+            {
+                if (rects[i].contains(query.a))
+                    point_hits_brute_force.push_back(i);
+            }
+            std::sort(point_hits.begin(), point_hits.end());
+            REQUIRE(point_hits == point_hits_brute_force);
+        }
+
+        // All pairs.
+        std::vector<std::pair<int, int>> pairs, pairs_brute_force;
+        grid.CollideAllPairs([&](int a, int b){pairs.push_back(a < b ? std::pair(a, b) : std::pair(b, a)); return false;});
+        for (int i = 0; i < count; i++)
+        for (int j = i + 1; j < count; j++)
+        {
+            if (rects[i].touches(rects[j]))
+                pairs_brute_force.emplace_back(i, j);
+        }
+        std::sort(pairs.begin(), pairs.end());
+        REQUIRE(pairs == pairs_brute_force);
+
+        // Stopping early.
+        if (!pairs.empty())
+        {
+            int calls = 0;
+            REQUIRE(grid.CollideAllPairs([&](int, int){calls++; return true;}));
+            REQUIRE(calls == 1);
+        }
+    }
+}
+
+TEST_CASE("spatial_hash_grid.rebuild")
+{
+    SpatialHashGrid<fvec2> grid(SpatialHashGrid<fvec2>::Params{.cell_size = fvec2(4)});
+
+    std::vector<frect2> rects = {fvec2(-1.5f).rect_size(fvec2(1)), fvec2(2, 3).rect_size(fvec2(3))};
+    grid.Build(rects);
+    REQUIRE(grid.EntryCount() == 5); // The second rect touches 4 cells.
+
+    int hits = 0;
+    grid.CollidePoint(fvec2(-1, -1), [&](int object){REQUIRE(object == 0); hits++; return false;});
+    REQUIRE(hits == 1);
+
+    // Rebuilding replaces the old objects.
+    rects.erase(rects.begin());
+    grid.Build(rects);
+    REQUIRE(grid.ObjectCount() == 1);
+    REQUIRE_FALSE(grid.CollidePoint(fvec2(-1, -1), [](int){return true;}));
+    REQUIRE(grid.CollidePoint(fvec2(4, 4), [](int){return true;}));
+
+    grid.Clear();
+    REQUIRE(grid.IsEmpty());
+    REQUIRE(grid.EntryCount() == 0);
+}
@@ -0,0 +1,320 @@
+#pragma once
+
+#include "math/rect_diff_iteration.h"
+#include "program/errors.h"
+#include "utils/jobs.h"
+#include "utils/mat.h"
+#include "utils/multiarray.h"
+#include "utils/ring_multiarray.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace TileGrids
+{
+    // A `RingMultiarray` window into a large (possibly infinite) world, where the cells are filled on background threads.
+    // The window is split into blocks. When the bounds move, the blocks that entered the window (found with `Math2::RectDiffRects`)
+    //   are queued for filling on a `Jobs::ThreadPool`, nearest to the center of the window first. The blocks that left the window are forgotten,
+    //   including the pending jobs for them.
+    // The filled blocks are copied into the window on the calling thread, in `Update()`, so reading the cells never races with the workers.
+    // Use `IsReady()` to check if a cell was filled, or `WaitUntilReady()` to block until it is.
+    // Usage:
+    //     TileGrids::StreamingRingMultiarray<int> window(ivec2(32), [&](irect2 rect, auto &block)
+    //     {
+    //         for (ivec2 pos : vector_range(rect))
+    //             block.at(pos - rect.a) = GenerateTile(pos); // Must be thread-safe.
+    //     });
+    //     ...
+    //     window.SetBounds(camera_rect.expand(64)); // When the camera moves.
+    //     window.Update(); // Once per frame.
+    template <typename T, std::signed_integral Index = std::ptrdiff_t>
+    class StreamingRingMultiarray
+    {
+      public:
+        using array_t = RingMultiarray<2, T, Index>;
+        using type = typename array_t::type;
+        using index_vec_t = typename array_t::index_vec_t;
+        using index_rect_t = typename array_t::index_rect_t;
+        using block_t = MultiArray<2, T, Index>;
+
+        // Fills `block` (which has the same size as `rect`) with the cells in `rect`: `block.at(pos - rect.a)` is the cell at `pos`.
+        // This is called on the worker threads, possibly on several of them at once.
+        // If it throws, the exception is rethrown from `Update()`.
+        using fill_func_t = std::function<void(index_rect_t rect, block_t &block)>;
+
+      private:
+        struct BlockState
+        {
+            // The pending job for this block, or 0 if none. Must be zero-initialized, since `RingMultiarray` zeroes the new elements.
+            std::uint32_t job = 0;
+            bool ready = false;
+        };
+
+        struct Job
+        {
+            index_vec_t block;
+            std::uint32_t id = 0;
+        };
+
+        struct Result
+        {
+            index_vec_t block;
+            std::uint32_t id = 0;
+            block_t cells;
+        };
+
+        struct State
+        {
+            index_vec_t block_size;
+            fill_func_t fill;
+
+            Jobs::ThreadPool *pool = nullptr;
+            Jobs::Counter counter; // Tracks the running `RunJobs()` calls.
+            int max_runners = 1;
+
+            std::mutex mutex;
+            std::deque<Job> jobs;
+            std::vector<Result> results;
+            std::exception_ptr error;
+            int num_runners = 0; // The number of `RunJobs()` calls submitted to the pool and not finished yet.
+            bool stop = false;
+        };
+
+        array_t cells; // The bounds are always aligned to blocks.
+        RingMultiarray<2, BlockState, Index> blocks; // In block coordinates.
+        std::uint32_t next_job_id = 1;
+
+        std::unique_ptr<State> state;
+
+        // Runs on the pool. Fills the queued blocks until the queue is empty.
+        static void RunJobs(State &state)
+        {
+            std::unique_lock lock(state.mutex);
+            while (true)
+            {
+                if (state.stop || state.jobs.empty())
+                {
+                    state.num_runners--;
+                    return;
+                }
+
+                Job job = state.jobs.front();
+                state.jobs.pop_front();
+                lock.unlock();
+
+                Result result{.block = job.block, .id = job.id, .cells = block_t(state.block_size)};
+                std::exception_ptr new_error;
+                try
+                {
+                    state.fill((job.block * state.block_size).rect_size(state.block_size), result.cells);
+                }
+                catch (...)
+                {
+                    new_error = std::current_exception();
+                }
+
+                lock.lock();
+                if (new_error)
+                {
+                    if (!state.error)
+                        state.error = new_error;
+                }
+                else
+                {
+                    state.results.push_back(std::move(result));
+                }
+            }
+        }
+
+        // Submits more `RunJobs()` calls to the pool if there are enough queued jobs, up to `max_runners` at once.
+        void StartRunners()
+        {
+            int num_new_runners = 0;
+            {
+                std::lock_guard lock(state->mutex);
+                num_new_runners = std::min(state->max_runners - state->num_runners, int(std::min(state->jobs.size(), std::size_t(state->max_runners))));
+                state->num_runners += num_new_runners;
+            }
+            // Outside of the lock, since the pool can run the jobs immediately if it has no workers.
+            for (int i = 0; i < num_new_runners; i++)
+                state->pool->Submit(state->counter, [state = state.get()]{RunJobs(*state);});
+        }
+
+        [[nodiscard]] index_vec_t BlockOf(index_vec_t pos) const
+        {
+            return div_ex(pos, state->block_size);
+        }
+
+        [[nodiscard]] index_rect_t BlocksOf(index_rect_t rect) const
+        {
+            return BlockOf(rect.a).rect_to(BlockOf(max(rect.b - 1, rect.a)) + 1);
+        }
+
+      public:
+        // Creates a null window.
+        StreamingRingMultiarray() {}
+
+        // The blocks are filled on `pool`, which must outlive this object.
+        // `num_threads` is the max number of blocks filled at once, or 0 to use the number of the pool workers.
+        StreamingRingMultiarray(index_vec_t block_size, fill_func_t fill, int num_threads = 0, Jobs::ThreadPool &pool = Jobs::GlobalPool())
+            : state(std::make_unique<State>())
+        {
+            ASSERT(block_size(all) > 0, "The block size must be positive.");
+            state->block_size = block_size;
+            state->fill = std::move(fill);
+            state->pool = &pool;
+            state->max_runners = num_threads > 0 ? num_threads : std::max(1, pool.NumWorkers());
+        }
+
+        StreamingRingMultiarray(const StreamingRingMultiarray &) = delete;
+        StreamingRingMultiarray &operator=(const StreamingRingMultiarray &) = delete;
+
+        ~StreamingRingMultiarray()
+        {
+            if (!state)
+                return;
+            {
+                std::lock_guard lock(state->mutex);
+                state->stop = true;
+            }
+            // The running jobs finish their current blocks, the rest are dropped.
+            try
+            {
+                state->pool->Wait(state->counter);
+            }
+            catch (...) {} // `RunJobs()` doesn't throw, this is just in case.
+        }
+
+        [[nodiscard]] explicit operator bool() const {return bool(state);}
+
+        [[nodiscard]] index_vec_t block_size() const {return state->block_size;}
+
+        // The cells that are currently in the window (filled or not). Those are aligned to blocks.
+        [[nodiscard]] index_rect_t bounds() const {return cells.bounds();}
+
+        // Returns a cell, which must be in `bounds()`. If it's not filled yet (see `IsReady()`), it's zero.
+        [[nodiscard]] const type &at(index_vec_t pos) const {return cells.at(pos);}
+
+        // Returns the underlying ring array, e.g. to read the cells with `for_each_run()`.
+        [[nodiscard]] const array_t &array() const {return cells;}
+
+        // Whether the cell is filled. Returns false outside of `bounds()`.
+        [[nodiscard]] bool IsReady(index_vec_t pos) const
+        {
+            index_vec_t block = BlockOf(pos);
+            return blocks.bounds().contains(block) && blocks.at(block).ready;
+        }
+        // Whether all cells in `rect` are filled. Returns false if `rect` is not fully in `bounds()`.
+        [[nodiscard]] bool IsReady(index_rect_t rect) const
+        {
+            if (!rect.has_area())
+                return true;
+            index_rect_t block_rect = BlocksOf(rect);
+            if (!blocks.bounds().contains(block_rect))
+                return false;
+            for (index_vec_t block : vector_range(block_rect))
+            {
+                if (!blocks.at(block).ready)
+                    return false;
+            }
+            return true;
+        }
+
+        // Moves the window to cover `rect` (rounded outwards to blocks).
+        // Queues the blocks that entered the window for filling, and drops the ones that left it (including the pending jobs).
+        void SetBounds(index_rect_t rect)
+        {
+            index_rect_t new_blocks = BlocksOf(rect);
+            index_rect_t old_blocks = blocks.bounds();
+            if (new_blocks == old_blocks)
+                return;
+
+            blocks.resize(new_blocks);
+            cells.resize(new_blocks * state->block_size);
+
+            std::vector<Job> new_jobs;
+            for (index_rect_t added : Math2::RectDiffRects(new_blocks, old_blocks))
+            {
+                for (index_vec_t block : vector_range(added))
+                {
+                    std::uint32_t id = next_job_id++;
+                    if (id == 0)
+                        id = next_job_id++; // Zero means no job.
+                    blocks.at(block).job = id;
+                    new_jobs.push_back({.block = block, .id = id});
+                }
+            }
+
+            // Fill the blocks closest to the center first.
+            index_vec_t center = new_blocks.a + new_blocks.b;
+            std::sort(new_jobs.begin(), new_jobs.end(), [&](const Job &a, const Job &b){return (a.block * 2 - center).len_sq() < (b.block * 2 - center).len_sq();});
+
+            {
+                std::lock_guard lock(state->mutex);
+                std::erase_if(state->jobs, [&](const Job &job){return !new_blocks.contains(job.block);});
+                state->jobs.insert(state->jobs.end(), new_jobs.begin(), new_jobs.end());
+            }
+            StartRunners();
+        }
+
+        // Copies the blocks filled in the background into the window. Call this once per frame.
+        // Rethrows the exceptions from the fill function.
+        void Update()
+        {
+            std::vector<Result> new_results;
+            {
+                std::lock_guard lock(state->mutex);
+                if (state->error)
+                    std::rethrow_exception(state->error);
+                std::swap(new_results, state->results);
+            }
+
+            for (Result &result : new_results)
+            {
+                // The block could've left the window (and maybe returned) while it was being filled.
+                if (!blocks.bounds().contains(result.block))
+                    continue;
+                BlockState &block_state = blocks.at(result.block);
+                if (block_state.job != result.id)
+                    continue;
+
+                index_rect_t rect = (result.block * state->block_size).rect_size(state->block_size);
+                cells.for_each_run(rect, [&](index_vec_t pos, std::span<type> run)
+                {
+                    const type *source = &result.cells.at(pos - rect.a);
+                    std::move(source, source + run.size(), run.begin());
+                });
+                block_state.job = 0;
+                block_state.ready = true;
+            }
+        }
+
+        // Blocks until all cells in `rect` are filled, calling `Update()`. `rect` must be in `bounds()`.
+        void WaitUntilReady(index_rect_t rect)
+        {
+            ASSERT(!rect.has_area() || bounds().contains(rect), "Waiting for cells outside of the streaming window.");
+            while (true)
+            {
+                Update();
+                if (IsReady(rect))
+                    return;
+
+                // This also runs the queued jobs on this thread, so it makes progress even if the pool workers are busy.
+                state->pool->Wait(state->counter);
+            }
+        }
+        // Blocks until the whole window is filled.
+        void WaitUntilReady()
+        {
+            WaitUntilReady(bounds());
+        }
+    };
+}
@@ -0,0 +1,109 @@
+#include "streaming_ring_multiarray.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    using Window = TileGrids::StreamingRingMultiarray<int>;
+    using vec_t = Window::index_vec_t;
+    using rect_t = Window::index_rect_t;
+
+    [[nodiscard]] int CellValue(vec_t pos)
+    {
+        return int(pos.x * 1000 + pos.y);
+    }
+}
+
+TEST_CASE("streaming_ring_multiarray")
+{
+    std::atomic<int> num_filled = 0;
+    Window window(vec_t(4, 3), [&](rect_t rect, Window::block_t &block)
+    {
+        for (vec_t pos : vector_range(rect))
+            block.at(pos - rect.a) = CellValue(pos);
+        num_filled++;
+    }, 2);
+
+    // Rounded outwards to blocks.
+    window.SetBounds(vec_t(-3, 1).rect_to(vec_t(5, 4)));
+    CHECK(window.bounds() == vec_t(-4, 0).rect_to(vec_t(8, 6)));
+    CHECK(!window.IsReady(vec_t(0, 0)));
+
+    window.WaitUntilReady();
+    CHECK(num_filled == 6);
+    for (vec_t pos : vector_range(window.bounds()))
+    {
+        REQUIRE(window.IsReady(pos));
+        REQUIRE(window.at(pos) == CellValue(pos));
+    }
+    CHECK(!window.IsReady(vec_t(8, 0)));
+    CHECK(!window.IsReady(vec_t(-4, 0).rect_to(vec_t(9, 1))));
+
+    // Moving the window only fills the new blocks.
+    window.SetBounds(vec_t(0, -3).rect_to(vec_t(12, 3)));
+    CHECK(window.IsReady(vec_t(0, 0).rect_to(vec_t(8, 3))));
+    CHECK(!window.IsReady(vec_t(8, 0)));
+    CHECK(!window.IsReady(vec_t(0, -1)));
+    window.WaitUntilReady(vec_t(8, 0).rect_to(vec_t(12, 3)));
+    CHECK(window.IsReady(vec_t(8, 0)));
+
+    window.WaitUntilReady();
+    CHECK(num_filled == 10);
+    for (vec_t pos : vector_range(window.bounds()))
+        REQUIRE(window.at(pos) == CellValue(pos));
+
+    // Moving back and forth quickly, the stale jobs must not overwrite anything.
+    for (int i = 0; i < 20; i++)
+        window.SetBounds(vec_t(i * 4, 0).rect_size(vec_t(8, 6)));
+    window.WaitUntilReady();
+    for (vec_t pos : vector_range(window.bounds()))
+        REQUIRE(window.at(pos) == CellValue(pos));
+}
+
+TEST_CASE("streaming_ring_multiarray.errors")
+{
+    Window window(vec_t(2), [](rect_t, Window::block_t &){throw std::runtime_error("Fill failed.");}, 1);
+    window.SetBounds(vec_t().rect_to(vec_t(2)));
+    REQUIRE_THROWS(window.WaitUntilReady());
+}
+
+TEST_CASE("streaming_ring_multiarray.pool")
+{
+    // At most `num_threads` blocks are filled at once, even if the pool has more workers.
+    Jobs::ThreadPool pool(4);
+    std::atomic<int> num_running = 0, max_running = 0;
+    Window window(vec_t(2), [&](rect_t rect, Window::block_t &block)
+    {
+        int n = ++num_running;
+        int old_max = max_running;
+        while (old_max < n && !max_running.compare_exchange_weak(old_max, n)) {}
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        for (vec_t pos : vector_range(rect))
+            block.at(pos - rect.a) = CellValue(pos);
+        num_running--;
+    }, 2, pool);
+
+    window.SetBounds(vec_t().rect_to(vec_t(16)));
+    window.WaitUntilReady();
+    CHECK(max_running <= 2);
+    for (vec_t pos : vector_range(window.bounds()))
+        REQUIRE(window.at(pos) == CellValue(pos));
+
+    // Without workers, the blocks are filled by `WaitUntilReady()` or immediately.
+    Jobs::ThreadPool no_workers(0);
+    Window sync_window(vec_t(2), [&](rect_t rect, Window::block_t &block)
+    {
+        for (vec_t pos : vector_range(rect))
+            block.at(pos - rect.a) = CellValue(pos);
+    }, 0, no_workers);
+    sync_window.SetBounds(vec_t().rect_to(vec_t(6)));
+    sync_window.WaitUntilReady();
+    for (vec_t pos : vector_range(sync_window.bounds()))
+        REQUIRE(sync_window.at(pos) == CellValue(pos));
+}
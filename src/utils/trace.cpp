@@ -0,0 +1,228 @@
+#include "trace.h"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace Trace
+{
+    namespace
+    {
+        struct Event
+        {
+            const char *name = nullptr;
+            std::int64_t time = 0;
+            std::int64_t duration = -1; // -1 for counters.
+            double value = 0; // For counters.
+        };
+
+        // The events are stored in a linked list of fixed-size chunks. Only the owning thread appends to it,
+        //   while the exporter can read it concurrently, up to the published counts.
+        struct Chunk
+        {
+            static constexpr std::size_t capacity = 4096;
+
+            std::array<Event, capacity> events;
+            std::atomic<std::size_t> count = 0;
+            std::atomic<Chunk *> next = nullptr;
+        };
+
+        struct ThreadBuffer
+        {
+            std::size_t thread_index = 0;
+            std::uint64_t generation = 0; // Matches `Registry::generation` until `Clear()` is called.
+
+            std::unique_ptr<Chunk> first = std::make_unique<Chunk>();
+            Chunk *last = first.get(); // Only touched by the owning thread.
+
+            ThreadBuffer() {}
+            ThreadBuffer(const ThreadBuffer &) = delete;
+            ThreadBuffer &operator=(const ThreadBuffer &) = delete;
+
+            ~ThreadBuffer()
+            {
+                // Avoid recursion when destroying long lists.
+                Chunk *chunk = first.release();
+                while (chunk)
+                    delete std::exchange(chunk, chunk->next.load(std::memory_order_relaxed));
+            }
+
+            void Append(const Event &event)
+            {
+                std::size_t count = last->count.load(std::memory_order_relaxed);
+                if (count == Chunk::capacity)
+                {
+                    Chunk *chunk = new Chunk;
+                    last->next.store(chunk, std::memory_order_release);
+                    last = chunk;
+                    count = 0;
+                }
+                last->events[count] = event;
+                last->count.store(count + 1, std::memory_order_release);
+            }
+        };
+
+        struct Registry
+        {
+            std::mutex mutex;
+            // The buffers of the current generation. The threads hold them too, so they outlive the threads.
+            std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+            std::vector<std::string> thread_names; // Indexed by `ThreadBuffer::thread_index`.
+            std::atomic<std::uint64_t> generation = 0;
+        };
+
+        [[nodiscard]] Registry &GetRegistry()
+        {
+            static Registry ret;
+            return ret;
+        }
+
+        struct ThreadState
+        {
+            std::size_t thread_index = std::size_t(-1);
+            std::shared_ptr<ThreadBuffer> buffer;
+        };
+        thread_local ThreadState this_thread;
+
+        // Assumes the registry mutex is locked.
+        [[nodiscard]] std::size_t ThreadIndexLow(Registry &registry)
+        {
+            if (this_thread.thread_index == std::size_t(-1))
+            {
+                this_thread.thread_index = registry.thread_names.size();
+                registry.thread_names.push_back(fmt::format("Thread {}", this_thread.thread_index));
+            }
+            return this_thread.thread_index;
+        }
+
+        [[nodiscard]] ThreadBuffer &GetThreadBuffer()
+        {
+            Registry &registry = GetRegistry();
+
+            // If `Clear()` was called, start a new buffer. The old one is destroyed when neither the thread nor the registry needs it.
+            if (!this_thread.buffer || this_thread.buffer->generation != registry.generation.load(std::memory_order_acquire))
+            {
+                std::lock_guard lock(registry.mutex);
+                auto buffer = std::make_shared<ThreadBuffer>();
+                buffer->thread_index = ThreadIndexLow(registry);
+                buffer->generation = registry.generation.load(std::memory_order_relaxed);
+                registry.buffers.push_back(buffer);
+                this_thread.buffer = std::move(buffer);
+            }
+
+            return *this_thread.buffer;
+        }
+
+        void AppendJsonString(std::string &out, const char *str)
+        {
+            out += '"';
+            for (; *str; str++)
+            {
+                unsigned char ch = *str;
+                if (ch == '"' || ch == '\\')
+                {
+                    out += '\\';
+                    out += char(ch);
+                }
+                else if (ch < ' ')
+                {
+                    out += fmt::format("\\u{:04x}", ch);
+                }
+                else
+                {
+                    out += char(ch);
+                }
+            }
+            out += '"';
+        }
+    }
+
+    namespace impl
+    {
+        void RecordZone(const char *name, std::int64_t begin, std::int64_t end)
+        {
+            GetThreadBuffer().Append({.name = name, .time = begin, .duration = end - begin});
+        }
+
+        void RecordCounter(const char *name, std::int64_t time, double value)
+        {
+            GetThreadBuffer().Append({.name = name, .time = time, .value = value});
+        }
+    }
+
+    void Start()
+    {
+        impl::recording.store(true, std::memory_order_relaxed);
+    }
+
+    void Stop()
+    {
+        impl::recording.store(false, std::memory_order_relaxed);
+    }
+
+    void Clear()
+    {
+        Registry &registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+        registry.buffers.clear();
+        registry.generation.fetch_add(1, std::memory_order_release);
+    }
+
+    void SetThreadName(std::string name)
+    {
+        Registry &registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+        registry.thread_names[ThreadIndexLow(registry)] = std::move(name);
+    }
+
+    std::string ToChromeJson()
+    {
+        Registry &registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+
+        std::string ret = "{\"traceEvents\":[\n";
+        bool first_event = true;
+        auto BeginEvent = [&]
+        {
+            if (!first_event)
+                ret += ",\n";
+            first_event = false;
+        };
+
+        for (std::size_t i = 0; i < registry.thread_names.size(); i++)
+        {
+            BeginEvent();
+            ret += fmt::format(R"({{"ph":"M","pid":1,"tid":{},"name":"thread_name","args":{{"name":)", i);
+            AppendJsonString(ret, registry.thread_names[i].c_str());
+            ret += "}}";
+        }
+
+        // The timestamps are in microseconds.
+        for (const auto &buffer : registry.buffers)
+        {
+            for (const Chunk *chunk = buffer->first.get(); chunk; chunk = chunk->next.load(std::memory_order_acquire))
+            {
+                std::size_t count = chunk->count.load(std::memory_order_acquire);
+                for (std::size_t j = 0; j < count; j++)
+                {
+                    const Event &event = chunk->events[j];
+                    BeginEvent();
+                    ret += "{\"name\":";
+                    AppendJsonString(ret, event.name);
+                    if (event.duration >= 0)
+                        ret += fmt::format(R"(,"ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})", buffer->thread_index, event.time / 1000., event.duration / 1000.);
+                    else
+                        ret += fmt::format(R"(,"ph":"C","pid":1,"tid":{},"ts":{:.3f},"args":{{"value":{}}}}})", buffer->thread_index, event.time / 1000., event.value);
+                }
+            }
+        }
+
+        ret += "\n]}\n";
+        return ret;
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "program/platform.h"
+
+// Lightweight CPU instrumentation, to see the timelines of all threads instead of flat profiles.
+// Usage:
+//     void Foo()
+//     {
+//         IMP_TRACE_ZONE("Foo"); // Measures until the end of the scope.
+//         IMP_TRACE_COUNTER("enemies", enemies.size()); // Plots a value over time.
+//     }
+//     IMP_TRACE_THREAD_NAME("Loader"); // Once per thread, optional.
+//
+//     Trace::Start();
+//     ...
+//     Trace::Stop();
+//     std::string json = Trace::ToChromeJson(); // Save to a file and open in `chrome://tracing` or `ui.perfetto.dev`.
+//
+// The names must be string literals (or have static storage duration in general), since only the pointers are stored.
+// While not recording, a zone costs one relaxed atomic load. While recording, each thread appends to its own buffer without locking.
+//
+// Enabled by `IMP_TRACE`, which defaults to 1 except in release builds (with `IMP_PLATFORM_FLAG_prod`). When it's 0, the macros expand to nothing.
+// If `IMP_TRACE_TRACY` is 1, the macros forward to Tracy instead (the Tracy client must be linked and `TRACY_ENABLE` defined),
+//   and the built-in recording does nothing.
+
+#ifndef IMP_TRACE
+#  define IMP_TRACE !IMP_PLATFORM_IS(prod)
+#endif
+
+#ifndef IMP_TRACE_TRACY
+#  define IMP_TRACE_TRACY 0
+#endif
+
+namespace Trace
+{
+    namespace impl
+    {
+        inline std::atomic<bool> recording = false;
+
+        // Nanoseconds, from an arbitrary starting point.
+        [[nodiscard]] inline std::int64_t Now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void RecordZone(const char *name, std::int64_t begin, std::int64_t end);
+        void RecordCounter(const char *name, std::int64_t time, double value);
+    }
+
+    // Starts or resumes recording. The events recorded earlier are kept, see `Clear()`.
+    void Start();
+    // Pauses recording. The zones that are already open are still recorded when they close.
+    void Stop();
+    [[nodiscard]] inline bool IsRecording()
+    {
+        return impl::recording.load(std::memory_order_relaxed);
+    }
+
+    // Discards all recorded events. Can be called while recording, but the events recorded concurrently with this can be lost.
+    void Clear();
+
+    // Names the current thread in the exported traces.
+    void SetThreadName(std::string name);
+
+    // Exports the recorded events in the Chrome trace event format.
+    // Can be called while recording, then it exports the events recorded so far.
+    [[nodiscard]] std::string ToChromeJson();
+
+    // Measures the time until it's destroyed.
+    class Zone
+    {
+        const char *name = nullptr;
+        std::int64_t begin = -1; // -1 if not recording.
+
+      public:
+        explicit Zone(const char *name) : name(name)
+        {
+            if (IsRecording())
+                begin = impl::Now();
+        }
+
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+
+        ~Zone()
+        {
+            if (begin >= 0)
+                impl::RecordZone(name, begin, impl::Now());
+        }
+    };
+
+    // Records a value of a counter at the current time.
+    inline void Counter(const char *name, double value)
+    {
+        if (IsRecording())
+            impl::RecordCounter(name, impl::Now(), value);
+    }
+}
+
+#define IMP_TRACE_impl_cat(a, b) IMP_TRACE_impl_cat_(a, b)
+#define IMP_TRACE_impl_cat_(a, b) a##b
+
+#if IMP_TRACE_TRACY
+#  include <tracy/Tracy.hpp>
+#  define IMP_TRACE_ZONE(name) ZoneScopedN(name)
+#  define IMP_TRACE_COUNTER(name, value) TracyPlot(name, double(value))
+#  define IMP_TRACE_THREAD_NAME(name) ::tracy::SetThreadName(name)
+#elif IMP_TRACE
+#  define IMP_TRACE_ZONE(name) ::Trace::Zone IMP_TRACE_impl_cat(_trace_zone_, __LINE__)(name)
+#  define IMP_TRACE_COUNTER(name, value) ::Trace::Counter(name, double(value))
+#  define IMP_TRACE_THREAD_NAME(name) ::Trace::SetThreadName(name)
+#else
+#  define IMP_TRACE_ZONE(name) void()
+#  define IMP_TRACE_COUNTER(name, value) void()
+#  define IMP_TRACE_THREAD_NAME(name) void()
+#endif
@@ -0,0 +1,69 @@
+#include "trace.h"
+
+#include <thread>
+
+#include <doctest/doctest.h>
+
+#include "utils/json.h"
+
+TEST_CASE("trace")
+{
+    Trace::Clear();
+
+    {
+        IMP_TRACE_ZONE("not recorded");
+    }
+
+    Trace::Start();
+    IMP_TRACE_THREAD_NAME("Main \"thread\"");
+    {
+        IMP_TRACE_ZONE("outer");
+        {
+            IMP_TRACE_ZONE("inner");
+            IMP_TRACE_COUNTER("counter", 42);
+        }
+        std::jthread([]
+        {
+            IMP_TRACE_THREAD_NAME("Worker");
+            for (int i = 0; i < 5000; i++) // More than one chunk.
+                IMP_TRACE_ZONE("worker zone");
+        }).join();
+    }
+    Trace::Stop();
+
+    std::string json_string = Trace::ToChromeJson();
+    Json json(json_string.c_str(), 8);
+    Json::View events = json.GetView()["traceEvents"];
+
+    int num_zones = 0, num_counters = 0, num_thread_names = 0;
+    bool found_names = false;
+    for (int i = 0; i < events.GetArraySize(); i++)
+    {
+        Json::View event = events[i];
+        std::string ph = event["ph"].GetString();
+        if (ph == "X")
+        {
+            num_zones++;
+            CHECK(event["name"].GetString() != "not recorded");
+        }
+        else if (ph == "C")
+        {
+            num_counters++;
+            CHECK(event["args"]["value"].GetReal() == 42);
+        }
+        else if (ph == "M")
+        {
+            num_thread_names++;
+            if (event["args"]["name"].GetString() == "Main \"thread\"")
+                found_names = true;
+        }
+    }
+    CHECK(num_zones == 5002);
+    CHECK(num_counters == 1);
+    CHECK(num_thread_names >= 2);
+    CHECK(found_names);
+
+    Trace::Clear();
+    json_string = Trace::ToChromeJson();
+    CHECK(json_string.find("\"ph\":\"X\"") == std::string::npos);
+}
@@ -1,9 +1,13 @@
 #include "transitive_closure.h"
 
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
 #include <iostream>
 
 #include "program/errors.h"
+#include "utils/jobs.h"
 
 namespace TransitiveClosure
 {
@@ -36,121 +40,187 @@ namespace TransitiveClosure
         return ret;
     }
 
-    [[nodiscard]] Data Compute(std::size_t n, func_t for_each_connected_node)
+    [[nodiscard]] Data Compute(std::size_t n, func_t for_each_connected_node, int num_threads)
     {
-        // Implementation of the 'STACK_TC' algorithm, described by Esko Nuutila (1995), in
-        // 'Efficient Transitive Closure Computation in Large Digraphs'.
+        return Compute(n, [&](std::size_t a, auto &&func){for_each_connected_node(a, func);}, num_threads);
+    }
 
-        constexpr std::size_t nil = -1;
+    namespace impl
+    {
+        [[nodiscard]] Data ComputeFromCsr(const Csr &graph, int num_threads)
+        {
+            constexpr std::size_t nil = -1;
+            const std::size_t n = graph.offsets.size() - 1;
 
-        Data ret;
-        ret.nodes.resize(n);
-        std::vector<std::size_t> vstack, cstack; // Vertex and component stacks.
-        vstack.reserve(n);
-        cstack.reserve(n);
+            Data ret;
+            ret.nodes.resize(n);
 
-        auto StackTc = [&](auto &StackTc, std::size_t v)
-        {
-            if (ret.nodes[v].root != nil)
-                return; // We already visited `v`.
-            ret.nodes[v].root = v;
-            ret.nodes[v].comp = nil;
-            vstack.push_back(v);
-            std::size_t saved_height = cstack.size();
-            bool self_loop = false;
-            [[maybe_unused]] std::size_t prev_w = nil; // Used only to check that the callback is sane.
-            for_each_connected_node(v, [&](std::size_t w)
-            {
-                ASSERT(w < n && (w > prev_w || prev_w == nil) && (prev_w = w, true), "Bad callback.");
+            { // Find the strongly connected components, using the Tarjan's algorithm without recursion.
+                // The components are found in the reverse topological order, which is what we want.
+                std::vector<std::size_t> index(n, nil), low_link(n);
+                std::vector<unsigned char/*boolean*/> on_stack(n);
+                std::vector<std::size_t> node_stack;
 
-                if (v == w)
-                {
-                    self_loop = true;
-                }
-                else
+                struct Frame
                 {
-                    StackTc(StackTc, w);
-                    if (ret.nodes[w].comp == nil)
-                        ret.nodes[v].root = std::min(ret.nodes[v].root, ret.nodes[w].root);
-                    else
-                        cstack.push_back(ret.nodes[w].comp);
-
-                    // The paper that this is based on had an extra condition on this last `else` branch,
-                    // which I wasn't able to understand: `if (v,w) is not a forward edge`.
-                    // However! Ivo Gabe de Wolff (2019) in "Higher ranked region inference for compile-time garbage collection"
-                    // says that it doesn't affect correctness:
-                    // > In the loop over the successors, the original algorithm Stack_TC checks whether
-                    // > an edge is a so called forward edge. We do not perform this check, which may cause
-                    // > that a component is pushed multiple times to cstack. As duplicates are removed in the
-                    // > topological sort, these will be removed later on and not cause problems with correctness.
-                }
-            });
-            if (ret.nodes[v].root == v)
-            {
-                std::size_t c = ret.components.size();
-                ret.components.emplace_back();
-                Data::Component &this_comp = ret.components.back();
+                    std::size_t node = 0;
+                    std::size_t edge = 0; // The next index in `graph.targets`.
+                };
+                std::vector<Frame> frames;
 
-                this_comp.next_flags.assign(ret.components.size(), false); // Sic.
+                std::size_t next_index = 0;
 
-                if (vstack.back() != v || self_loop)
+                for (std::size_t start = 0; start < n; start++)
                 {
-                    this_comp.next.push_back(c);
-                    this_comp.next_flags[c] = true;
-                }
+                    if (index[start] != nil)
+                        continue;
 
-                // Topologically sort a part of the component stack.
-                std::sort(cstack.begin() + saved_height, cstack.end(), [&comp = ret.components](std::size_t a, std::size_t b) -> bool
-                {
-                    if (a == b)
-                        return false; // This can happen when we have cycles. Libstdc++ sometiems checks this in debug mode, it seems.
-                    if (b >= comp[a].next_flags.size())
-                        return false;
-                    return comp[a].next_flags[b];
-                });
-                // Remove duplicates.
-                cstack.erase(std::unique(cstack.begin() + saved_height, cstack.end()), cstack.end());
-
-                while (cstack.size() != saved_height)
-                {
-                    std::size_t x = cstack.back();
-                    cstack.pop_back();
-                    if (!this_comp.next_flags[x])
+                    frames.push_back({.node = start, .edge = graph.offsets[start]});
+                    index[start] = low_link[start] = next_index++;
+                    node_stack.push_back(start);
+                    on_stack[start] = true;
+
+                    while (!frames.empty())
                     {
-                        if (!this_comp.next_flags[x])
+                        Frame &frame = frames.back();
+                        std::size_t v = frame.node;
+
+                        if (frame.edge < graph.offsets[v + 1])
                         {
-                            this_comp.next.push_back(x);
-                            this_comp.next_flags[x] = true;
+                            std::size_t w = graph.targets[frame.edge++];
+                            if (index[w] == nil)
+                            {
+                                frames.push_back({.node = w, .edge = graph.offsets[w]}); // This invalidates `frame`.
+                                index[w] = low_link[w] = next_index++;
+                                node_stack.push_back(w);
+                                on_stack[w] = true;
+                            }
+                            else if (on_stack[w])
+                            {
+                                low_link[v] = std::min(low_link[v], index[w]);
+                            }
+                            continue;
                         }
 
-                        this_comp.next.reserve(this_comp.next.size() + ret.components[x].next.size());
-                        for (std::size_t c : ret.components[x].next)
+                        // Done with `v`.
+                        if (low_link[v] == index[v])
                         {
-                            if (!this_comp.next_flags[c])
+                            std::size_t c = ret.components.size();
+                            Data::Component &comp = ret.components.emplace_back();
+                            std::size_t w;
+                            do
                             {
-                                this_comp.next.push_back(c);
-                                this_comp.next_flags[c] = true;
+                                w = node_stack.back();
+                                node_stack.pop_back();
+                                on_stack[w] = false;
+                                ret.nodes[w] = {.root = v, .comp = c};
+                                comp.nodes.push_back(w);
                             }
+                            while (w != v);
+                        }
+
+                        frames.pop_back();
+                        if (!frames.empty())
+                        {
+                            std::size_t parent = frames.back().node;
+                            low_link[parent] = std::min(low_link[parent], low_link[v]);
                         }
                     }
                 }
+            }
+
+            { // Compute the reachability between the components.
+                // `reach` stores a bitset for each component (a triangular matrix), the one for component `c` has `c+1` bits.
+                // Since the components only reach the ones with smaller indices, the bitset of `c` is the union of the bitsets of its direct successors.
+                // The components are handed out to the jobs in the ascending order, and wait for their successors if they're not ready yet.
+                // This can't deadlock, since a component is only taken by an already running job, and the smallest unfinished component never waits.
+
+                using word_t = std::uint64_t;
+                constexpr std::size_t word_bits = 64;
+                const std::size_t num_comps = ret.components.size();
+
+                std::vector<std::size_t> row_offsets(num_comps + 1);
+                for (std::size_t c = 0; c < num_comps; c++)
+                    row_offsets[c + 1] = row_offsets[c] + c / word_bits + 1;
+                std::vector<word_t> reach(row_offsets.back());
+                std::vector<std::atomic<bool>> done(num_comps);
 
-                std::size_t w;
-                do
+                // Threads aren't worth it for small graphs.
+                constexpr std::size_t min_comps_per_thread = 256;
+                Jobs::ThreadPool &pool = Jobs::GlobalPool();
+                if (num_threads <= 0)
+                    num_threads = pool.Concurrency();
+                num_threads = int(std::clamp(num_comps / min_comps_per_thread, std::size_t(1), std::size_t(num_threads)));
+
+                std::atomic<std::size_t> next_comp = 0;
+
+                auto ProcessThread = [&](std::size_t)
                 {
-                    w = vstack.back();
-                    vstack.pop_back();
-                    ret.nodes[w].comp = c;
-                    this_comp.nodes.push_back(w);
-                }
-                while (w != v);
-            }
-        };
+                    std::vector<std::size_t> successors;
 
-        for (std::size_t v = 0; v < n; v++)
-            StackTc(StackTc, v);
+                    while (true)
+                    {
+                        std::size_t c = next_comp++;
+                        if (c >= num_comps)
+                            break;
 
-        return ret;
+                        Data::Component &comp = ret.components[c];
+                        word_t *row = reach.data() + row_offsets[c];
+
+                        successors.clear();
+                        bool has_cycle = comp.nodes.size() > 1;
+                        for (std::size_t v : comp.nodes)
+                        {
+                            for (std::size_t e = graph.offsets[v]; e < graph.offsets[v + 1]; e++)
+                            {
+                                std::size_t d = ret.nodes[graph.targets[e]].comp;
+                                if (d == c)
+                                    has_cycle = true;
+                                else
+                                    successors.push_back(d);
+                            }
+                        }
+                        std::sort(successors.begin(), successors.end());
+                        successors.erase(std::unique(successors.begin(), successors.end()), successors.end());
+
+                        if (has_cycle)
+                            row[c / word_bits] |= word_t(1) << (c % word_bits);
+
+                        for (std::size_t d : successors)
+                        {
+                            done[d].wait(false);
+                            const word_t *d_row = reach.data() + row_offsets[d];
+                            for (std::size_t i = 0; i <= d / word_bits; i++)
+                                row[i] |= d_row[i];
+                            row[d / word_bits] |= word_t(1) << (d % word_bits);
+                        }
+
+                        done[c] = true;
+                        done[c].notify_all();
+
+                        // Fill the output.
+                        std::size_t num_next = 0;
+                        for (std::size_t i = 0; i <= c / word_bits; i++)
+                            num_next += std::size_t(std::popcount(row[i]));
+                        comp.next.reserve(num_next);
+                        comp.next_flags.assign(c + 1, false);
+                        for (std::size_t i = 0; i <= c / word_bits; i++)
+                        {
+                            for (word_t word = row[i]; word; word &= word - 1)
+                            {
+                                std::size_t x = i * word_bits + std::size_t(std::countr_zero(word));
+                                comp.next.push_back(x);
+                                comp.next_flags[x] = true;
+                            }
+                        }
+                    }
+                };
+
+                Jobs::ParallelFor(pool, 0, std::size_t(num_threads), ProcessThread);
+            }
+
+            return ret;
+        }
     }
 
     namespace Tests
@@ -196,7 +266,7 @@ namespace TransitiveClosure
                     {0,0,0,0,0,1,0,0},
                 };
                 return arr[a][b];
-            }, "{nodes=[(0,3),(0,3),(0,3),(3,2),(4,0),(5,1),(4,0),(5,1)],components=[{nodes=[6,4],next=[0],next_flags=[1]},{nodes=[7,5],next=[1,0],next_flags=[1,1]},{nodes=[3],next=[0,1],next_flags=[1,1,0]},{nodes=[2,1,0],next=[3,2,0,1],next_flags=[1,1,1,1]}]}");
+            }, "{nodes=[(0,3),(0,3),(0,3),(3,2),(4,0),(5,1),(4,0),(5,1)],components=[{nodes=[6,4],next=[0],next_flags=[1]},{nodes=[7,5],next=[0,1],next_flags=[1,1]},{nodes=[3],next=[0,1],next_flags=[1,1,0]},{nodes=[2,1,0],next=[0,1,2,3],next_flags=[1,1,1,1]}]}");
 
 
             test(10, [](std::size_t a, std::size_t b)
@@ -215,7 +285,7 @@ namespace TransitiveClosure
                     /* j */{0,0,0,0,0,0,0,0,0,0},
                 };
                 return arr[a][b];
-            }, "{nodes=[(0,3),(0,3),(0,3),(3,0),(3,0),(5,1),(5,1),(0,3),(0,3),(9,2)],components=[{nodes=[4,3],next=[0],next_flags=[1]},{nodes=[6,5],next=[1,0],next_flags=[1,1]},{nodes=[9],next=[],next_flags=[0,0,0]},{nodes=[8,7,2,1,0],next=[3,2,0,1],next_flags=[1,1,1,1]}]}");
+            }, "{nodes=[(0,3),(0,3),(0,3),(3,0),(3,0),(5,1),(5,1),(0,3),(0,3),(9,2)],components=[{nodes=[4,3],next=[0],next_flags=[1]},{nodes=[6,5],next=[0,1],next_flags=[1,1]},{nodes=[9],next=[],next_flags=[0,0,0]},{nodes=[8,7,2,1,0],next=[0,1,2,3],next_flags=[1,1,1,1]}]}");
 
             std::cout << "All tests passed.\n";
         }
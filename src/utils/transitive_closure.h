@@ -1,9 +1,11 @@
 #pragma once
 
+#include <concepts>
 #include <cstddef>
 #include <functional>
 #include <vector>
 
+#include "program/errors.h"
 #include "strings/format.h"
 
 // A 'transitive closure' of an oriented graph is a similar graph with edges added.
@@ -19,6 +21,7 @@ namespace TransitiveClosure
         // Otherwise there will be less components.
         // The components form a graph called 'condensation graph', which is always acyclic.
         // The components are numbered in a way that 'B is reachable from A' implies `B <= A`.
+        // The numbering is deterministic and doesn't depend on the number of threads.
 
         struct Node
         {
@@ -40,12 +43,11 @@ namespace TransitiveClosure
             // Nodes that are a part of this component.
             std::vector<std::size_t> nodes;
             // Which components are reachable (possibly indirectly) from this one.
-            // Unordered, but has no duplicates. May or may not contain itself.
+            // Sorted, with no duplicates. Contains itself only if the component has a cycle, see `FindComponentsWithCycles()`.
             std::vector<std::size_t> next;
             // A convenience array.
             // `next_flags[i]` is 1 if and only if `next` contains `i`.
-            // Some trailing zeroes might be missing, check the size before accessing it.
-            // More specifically, i-th component has i+1 numbers in this array.
+            // The i-th component has i+1 numbers in this array, since it can't reach components with larger indices.
             std::vector<unsigned char/*boolean*/> next_flags;
 
             // Returns true if component `i` is reachable from this one, possibly indirectly.
@@ -94,12 +96,46 @@ namespace TransitiveClosure
 
     using next_func_t = const std::function<void(std::size_t b)> &;
 
-    // Given node index `a`, this must call `func` with the index of every node directly reachable from `a`, IN ASCENDING ORDER.
-    // Unsure if a different order would break the algorithm or not.
+    // Given node index `a`, this must call `func` with the index of every node directly reachable from `a`, in any order.
     using func_t = std::function<void(std::size_t a, next_func_t func)>;
 
+    namespace impl
+    {
+        // The graph in the compressed sparse row format: edges of node `i` are `targets[offsets[i]..offsets[i+1]]`.
+        struct Csr
+        {
+            std::vector<std::size_t> offsets;
+            std::vector<std::size_t> targets;
+        };
+
+        [[nodiscard]] Data ComputeFromCsr(const Csr &graph, int num_threads);
+    }
+
     // Performs the calculations.
-    [[nodiscard]] Data Compute(std::size_t n, func_t for_each_connected_node);
+    // `for_each_connected_node` is `(std::size_t a, auto &&func) -> void`, see `func_t` for details. It's called exactly once per node.
+    // `num_threads` is the max number of jobs computing the reachability on `Jobs::GlobalPool()`, 0 means the concurrency of the pool. Small graphs always use one thread.
+    // The result doesn't depend on the number of threads.
+    template <typename F>
+    requires std::invocable<F &, std::size_t, void (&)(std::size_t)>
+    [[nodiscard]] Data Compute(std::size_t n, F &&for_each_connected_node, int num_threads = 0)
+    {
+        impl::Csr graph;
+        graph.offsets.reserve(n + 1);
+        graph.offsets.push_back(0);
+        for (std::size_t a = 0; a < n; a++)
+        {
+            for_each_connected_node(a, [&](std::size_t b)
+            {
+                ASSERT(b < n, "Bad callback.");
+                graph.targets.push_back(b);
+            });
+            graph.offsets.push_back(graph.targets.size());
+        }
+        return impl::ComputeFromCsr(graph, num_threads);
+    }
+
+    // Same, but with a type-erased callback.
+    [[nodiscard]] Data Compute(std::size_t n, func_t for_each_connected_node, int num_threads = 0);
 
     namespace Tests
     {
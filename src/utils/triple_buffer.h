@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "utils/concurrent_queues.h"
+
+namespace Concurrent
+{
+    // Publishes the latest value from one writer thread to one reader thread, without either of them ever waiting.
+    // E.g. the simulation thread publishes the render state, and the render thread always draws the latest complete one.
+    // Usage:
+    //     // Writer thread:
+    //     buffer.Write() = ...;
+    //     buffer.Publish();
+    //
+    //     // Reader thread:
+    //     buffer.Update(); // Returns false if nothing new was published.
+    //     use(buffer.Read());
+    //
+    // The intermediate values are dropped if the writer publishes faster than the reader updates.
+    // Note that `Write()` returns a buffer with some older value, not necessarily the last published one. Overwrite it completely.
+    template <typename T>
+    class TripleBuffer
+    {
+        struct alignas(cache_line_size) Buffer
+        {
+            T value;
+        };
+        std::array<Buffer, 3> buffers;
+
+        // A buffer index, plus this bit if the buffer was published and the reader hasn't taken it yet.
+        static constexpr std::uint8_t dirty_bit = 4;
+        static constexpr std::uint8_t index_mask = 3;
+
+        // The buffer that's not used by either thread at the moment.
+        alignas(cache_line_size) std::atomic<std::uint8_t> shared_index{1};
+        // Owned by the writer.
+        alignas(cache_line_size) std::uint8_t write_index = 0;
+        // Owned by the reader.
+        alignas(cache_line_size) std::uint8_t read_index = 2;
+
+      public:
+        // Initializes all buffers to `value`.
+        explicit TripleBuffer(const T &value = T{})
+            : buffers{Buffer{value}, Buffer{value}, Buffer{value}}
+        {}
+
+        TripleBuffer(const TripleBuffer &) = delete;
+        TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+        // Writer only. The buffer to write the next value to.
+        [[nodiscard]] T &Write()
+        {
+            return buffers[write_index].value;
+        }
+
+        // Writer only. Makes the value written to `Write()` available to the reader, and gives the writer another buffer.
+        void Publish()
+        {
+            write_index = shared_index.exchange(write_index | dirty_bit, std::memory_order_acq_rel) & index_mask;
+        }
+
+        // Reader only. Switches `Read()` to the last published value, if there's a new one. Returns true on success.
+        bool Update()
+        {
+            if (!(shared_index.load(std::memory_order_relaxed) & dirty_bit))
+                return false;
+            read_index = shared_index.exchange(read_index, std::memory_order_acq_rel) & index_mask;
+            return true;
+        }
+
+        // Reader only. The value that was last obtained by `Update()`, or the initial one.
+        [[nodiscard]] const T &Read() const
+        {
+            return buffers[read_index].value;
+        }
+    };
+}
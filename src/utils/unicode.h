@@ -1,10 +1,17 @@
 #pragma once
 
+#include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <iterator>
 #include <string>
 #include <string_view>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace Unicode
 {
@@ -186,6 +193,166 @@ namespace Unicode
     }
 
 
+    // Bulk routines for long strings. They skip the ASCII parts 16 bytes at a time (with SSE2, or 8 bytes otherwise).
+
+    // Returns the number of ASCII bytes at the beginning of the range.
+    [[nodiscard]] inline std::size_t AsciiPrefixLength(const char *begin, const char *end)
+    {
+        const char *cur = begin;
+
+        #if defined(__SSE2__)
+        while (end - cur >= 16)
+        {
+            unsigned int non_ascii = unsigned(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cur))));
+            if (non_ascii)
+                return std::size_t(cur - begin) + std::size_t(std::countr_zero(non_ascii));
+            cur += 16;
+        }
+        #else
+        while (end - cur >= 8)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, cur, 8);
+            if (word & 0x8080808080808080)
+                break;
+            cur += 8;
+        }
+        #endif
+
+        while (cur != end && (unsigned char)*cur < 0x80)
+            cur++;
+        return std::size_t(cur - begin);
+    }
+
+    // Returns true if the string is valid UTF8.
+    // This is stricter than `Decode()`: overlong encodings, surrogates and the codes above 0x10ffff are rejected.
+    [[nodiscard]] inline bool IsValid(std::string_view str)
+    {
+        const char *cur = str.data();
+        const char *end = cur + str.size();
+
+        while (true)
+        {
+            cur += AsciiPrefixLength(cur, end);
+            if (cur == end)
+                return true;
+
+            // The allowed ranges of the second byte depend on the first one, see RFC 3629.
+            unsigned char first = *cur;
+            unsigned char second_min = 0x80, second_max = 0xbf;
+            int len;
+            if (first >= 0xc2 && first <= 0xdf)
+            {
+                len = 2;
+            }
+            else if (first >= 0xe0 && first <= 0xef)
+            {
+                len = 3;
+                if (first == 0xe0)
+                    second_min = 0xa0; // Overlong.
+                else if (first == 0xed)
+                    second_max = 0x9f; // Surrogates.
+            }
+            else if (first >= 0xf0 && first <= 0xf4)
+            {
+                len = 4;
+                if (first == 0xf0)
+                    second_min = 0x90; // Overlong.
+                else if (first == 0xf4)
+                    second_max = 0x8f; // Above 0x10ffff.
+            }
+            else
+            {
+                return false;
+            }
+
+            if (end - cur < len)
+                return false;
+            unsigned char second = cur[1];
+            if (second < second_min || second > second_max)
+                return false;
+            for (int i = 2; i < len; i++)
+            {
+                if (((unsigned char)cur[i] & 0b11000000) != 0b10000000)
+                    return false;
+            }
+            cur += len;
+        }
+    }
+
+    // Returns the number of characters in the string, the same as iterating over it with `Iterator` would produce (even if the string is invalid).
+    [[nodiscard]] inline std::size_t CountChars(std::string_view str)
+    {
+        const char *cur = str.data();
+        const char *end = cur + str.size();
+
+        std::size_t ret = 0;
+        while (cur != end)
+        {
+            std::size_t ascii = AsciiPrefixLength(cur, end);
+            ret += ascii;
+            cur += ascii;
+
+            // Decode the non-ASCII characters one by one, until the next ASCII byte.
+            while (cur != end && (unsigned char)*cur >= 0x80)
+            {
+                (void)Decode(cur, end, &cur);
+                ret++;
+            }
+        }
+        return ret;
+    }
+
+    // Decodes the whole string into `out`, which must have room for `CountChars(str)` characters (`str.size()` is always enough).
+    // Invalid characters are decoded the same way as with `Decode()`. Returns the number of characters written.
+    inline std::size_t DecodeString(std::string_view str, Char *out)
+    {
+        const char *cur = str.data();
+        const char *end = cur + str.size();
+        Char *out_begin = out;
+
+        while (cur != end)
+        {
+            #if defined(__SSE2__)
+            // Widen 16 ASCII bytes at a time.
+            while (end - cur >= 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+                if (_mm_movemask_epi8(bytes))
+                    break;
+                const __m128i zero = _mm_setzero_si128();
+                __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+                __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out     ), _mm_unpacklo_epi16(lo, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out +  4), _mm_unpackhi_epi16(lo, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out +  8), _mm_unpacklo_epi16(hi, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 12), _mm_unpackhi_epi16(hi, zero));
+                cur += 16;
+                out += 16;
+            }
+            #endif
+
+            if (cur == end)
+                break;
+
+            if ((unsigned char)*cur < 0x80)
+                *out++ = (unsigned char)*cur++;
+            else
+                *out++ = Decode(cur, end, &cur);
+        }
+
+        return std::size_t(out - out_begin);
+    }
+
+    // Same, but returns a new vector.
+    [[nodiscard]] inline std::vector<Char> DecodeString(std::string_view str)
+    {
+        std::vector<Char> ret(str.size());
+        ret.resize(DecodeString(str, ret.data()));
+        return ret;
+    }
+
+
     class Iterator
     {
         const char *cur = nullptr;
@@ -0,0 +1,49 @@
+#include "unicode.h"
+
+#include <string>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+namespace
+{
+    // The reference implementation, one character at a time.
+    std::vector<Unicode::Char> DecodeSlow(std::string_view str)
+    {
+        std::vector<Unicode::Char> ret;
+        for (Unicode::Char ch : Unicode::Iterator(str))
+            ret.push_back(ch);
+        return ret;
+    }
+}
+
+TEST_CASE("unicode.bulk")
+{
+    CHECK(Unicode::IsValid(""));
+    CHECK(Unicode::IsValid("Hello, world! This string is longer than 16 bytes."));
+    CHECK(Unicode::IsValid("\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 \xe2\x82\xac \xf0\x9f\x98\x80"));
+    CHECK(!Unicode::IsValid("abc\x80"));
+    CHECK(!Unicode::IsValid("\xc0\xaf")); // Overlong.
+    CHECK(!Unicode::IsValid("\xe0\x80\xaf")); // Overlong.
+    CHECK(!Unicode::IsValid("\xed\xa0\x80")); // Surrogate.
+    CHECK(!Unicode::IsValid("\xf4\x90\x80\x80")); // Above 0x10ffff.
+    CHECK(!Unicode::IsValid("0123456789abcdef\xe2\x82")); // Truncated.
+
+    // Compare with the iterator on valid and invalid strings, with the non-ASCII bytes at different positions.
+    std::vector<std::string> strings = {"", "a", "\xd0\x9f", "\x80\x80x", "\xc3", "\xc3\x80\x80", "\xff\xfe", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "a\xf0\x9f\x98"};
+    std::uint32_t seed = 1;
+    for (int i = 0; i < 200; i++)
+    {
+        std::string str;
+        int num_parts = i % 10;
+        for (int j = 0; j < num_parts; j++)
+        {
+            seed = seed * 1664525 + 1013904223;
+            str += std::string(seed >> 27, 'x') + strings[(seed >> 8) % strings.size()];
+        }
+
+        std::vector<Unicode::Char> expected = DecodeSlow(str);
+        CHECK(Unicode::CountChars(str) == expected.size());
+        CHECK(Unicode::DecodeString(str) == expected);
+    }
+}